@@ -255,6 +255,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.avg_discharge; }, ith_timestep);
 		}
+		cell_feature_matrix discharge_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.avg_discharge); });
+		}
 		double discharge_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -270,6 +275,11 @@ namespace shyft {
                 catchment_feature(*cells, catchment_indexes,
                     [](const cell& c) { return c.rc.charge_m3s; }, ith_timestep);
         }
+        cell_feature_matrix charge_matrix(const vector<int>& catchment_indexes) const {
+            return shyft::core::cell_statistics::
+                catchment_feature_matrix(*cells, catchment_indexes,
+                [](const cell& c) -> decltype(auto) { return (c.rc.charge_m3s); });
+        }
         double charge_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
             return shyft::core::cell_statistics::
                 sum_catchment_feature_value(*cells, catchment_indexes,
@@ -286,6 +296,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.env_ts.temperature; }, ith_timestep);
 		}
+		cell_feature_matrix temperature_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.env_ts.temperature); });
+		}
 		double temperature_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -302,6 +317,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.env_ts.precipitation; }, ith_timestep);
 		}
+		cell_feature_matrix precipitation_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.env_ts.precipitation); });
+		}
 		double precipitation_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -318,6 +338,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.env_ts.radiation; }, ith_timestep);
 		}
+		cell_feature_matrix radiation_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.env_ts.radiation); });
+		}
 		double radiation_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -334,6 +359,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.env_ts.wind_speed; }, ith_timestep);
 		}
+		cell_feature_matrix wind_speed_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.env_ts.wind_speed); });
+		}
 		double wind_speed_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -350,6 +380,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.env_ts.rel_hum; }, ith_timestep);
 		}
+		cell_feature_matrix rel_hum_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.env_ts.rel_hum); });
+		}
 		double rel_hum_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -372,6 +407,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.kirchner_discharge; }, ith_timestep);
 		}
+		cell_feature_matrix discharge_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.kirchner_discharge); });
+		}
 		double discharge_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -394,6 +434,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 					[](const cell& c) { return c.sc.soil_moisture; }, ith_timestep);
 		}
+		cell_feature_matrix discharge_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.soil_moisture); });
+		}
 		double discharge_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -416,6 +461,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 					[](const cell& c) { return c.sc.tank_uz; }, ith_timestep);		//to be modified
 		}
+		cell_feature_matrix discharge_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.tank_uz); });
+		}
 		double discharge_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -440,6 +490,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_albedo; }, ith_timestep);
 		}
+		cell_feature_matrix albedo_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_albedo); });
+		}
 		double albedo_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -456,6 +511,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_lwc; }, ith_timestep);
 		}
+		cell_feature_matrix lwc_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_lwc); });
+		}
 		double lwc_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -472,6 +532,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_surface_heat; }, ith_timestep);
 		}
+		cell_feature_matrix surface_heat_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_surface_heat); });
+		}
 		double surface_heat_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -488,6 +553,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_alpha; }, ith_timestep);
 		}
+		cell_feature_matrix alpha_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_alpha); });
+		}
 		double alpha_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -504,6 +574,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_sdc_melt_mean; }, ith_timestep);
 		}
+		cell_feature_matrix sdc_melt_mean_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_sdc_melt_mean); });
+		}
 		double sdc_melt_mean_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -520,6 +595,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_acc_melt; }, ith_timestep);
 		}
+		cell_feature_matrix acc_melt_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_acc_melt); });
+		}
 		double acc_melt_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -536,6 +616,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_iso_pot_energy; }, ith_timestep);
 		}
+		cell_feature_matrix iso_pot_energy_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_iso_pot_energy); });
+		}
 		double iso_pot_energy_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -552,6 +637,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.gs_temp_swe; }, ith_timestep);
 		}
+		cell_feature_matrix temp_swe_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.gs_temp_swe); });
+		}
 		double temp_swe_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -575,6 +665,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_sca; }, ith_timestep);
 		}
+		cell_feature_matrix sca_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_sca); });
+		}
 		double sca_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -591,6 +686,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_swe; }, ith_timestep);
 		}
+		cell_feature_matrix swe_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_swe); });
+		}
 		double swe_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -607,6 +707,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_outflow; }, ith_timestep);
 		}
+		cell_feature_matrix outflow_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_outflow); });
+		}
 		double outflow_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -626,6 +731,11 @@ namespace shyft {
                 catchment_feature(*cells, catchment_indexes,
                     [](const cell& c) { return c.rc.glacier_melt; }, ith_timestep);
         }
+        cell_feature_matrix glacier_melt_matrix(const vector<int>& catchment_indexes) const {
+            return shyft::core::cell_statistics::
+                catchment_feature_matrix(*cells, catchment_indexes,
+                [](const cell& c) -> decltype(auto) { return (c.rc.glacier_melt); });
+        }
         double glacier_melt_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
             return shyft::core::cell_statistics::
                 sum_catchment_feature_value(*cells, catchment_indexes,
@@ -650,6 +760,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_alpha; }, ith_timestep);
 		}
+		cell_feature_matrix alpha_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_alpha); });
+		}
 		double alpha_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -666,6 +781,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_nu; }, ith_timestep);
 		}
+		cell_feature_matrix nu_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_nu); });
+		}
 		double nu_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -682,6 +802,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_lwc; }, ith_timestep);
 		}
+		cell_feature_matrix lwc_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_lwc); });
+		}
 		double lwc_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -698,6 +823,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_residual; }, ith_timestep);
 		}
+		cell_feature_matrix residual_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_residual); });
+		}
 		double residual_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -714,6 +844,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_swe; }, ith_timestep);
 		}
+		cell_feature_matrix swe_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_swe); });
+		}
 		double swe_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -730,6 +865,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_sca; }, ith_timestep);
 		}
+		cell_feature_matrix sca_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_sca); });
+		}
 		double sca_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -753,6 +893,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_outflow; }, ith_timestep);
 		}
+		cell_feature_matrix outflow_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_outflow); });
+		}
 		double outflow_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -769,6 +914,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_total_stored_water; }, ith_timestep);
 		}
+		cell_feature_matrix total_stored_water_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_total_stored_water); });
+		}
 		double total_stored_water_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -788,6 +938,11 @@ namespace shyft {
                 catchment_feature(*cells, catchment_indexes,
                     [](const cell& c) { return c.rc.glacier_melt; }, ith_timestep);
         }
+        cell_feature_matrix glacier_melt_matrix(const vector<int>& catchment_indexes) const {
+            return shyft::core::cell_statistics::
+                catchment_feature_matrix(*cells, catchment_indexes,
+                [](const cell& c) -> decltype(auto) { return (c.rc.glacier_melt); });
+        }
         double glacier_melt_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
             return shyft::core::cell_statistics::
                 sum_catchment_feature_value(*cells, catchment_indexes,
@@ -812,6 +967,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_swe; }, ith_timestep);
 		}
+		cell_feature_matrix swe_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_swe); });
+		}
 		double swe_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -828,6 +988,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.sc.snow_sca; }, ith_timestep);
 		}
+		cell_feature_matrix sca_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.sc.snow_sca); });
+		}
 		double sca_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -851,6 +1016,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.snow_outflow; }, ith_timestep);
 		}
+		cell_feature_matrix outflow_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.snow_outflow); });
+		}
 		double outflow_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -871,6 +1041,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.glacier_melt; }, ith_timestep);
 		}
+		cell_feature_matrix glacier_melt_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.glacier_melt); });
+		}
 		double glacier_melt_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				sum_catchment_feature_value(*cells, catchment_indexes,
@@ -894,6 +1069,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.pe_output; }, ith_timestep);
 		}
+		cell_feature_matrix output_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.pe_output); });
+		}
 		double output_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -916,6 +1096,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 					[](const cell& c) { return c.rc.soil_outflow; }, ith_timestep);
 		}
+		cell_feature_matrix output_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.soil_outflow); });
+		}
 		double output_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -943,6 +1128,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 				[](const cell& c) { return c.rc.ae_output; }, ith_timestep);
 		}
+		cell_feature_matrix output_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.ae_output); });
+		}
 		double output_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -984,6 +1174,18 @@ namespace shyft {
                     return pot_ratio_single_value_ts{pot_ratio_value}; 
                 }, ith_timestep);
 		}
+		cell_feature_matrix pot_ratio_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) {
+                    vector<double>  v; v.reserve(c.sc.kirchner_discharge.size());
+                    auto scale_factor = c.parameter->ae.ae_scale_factor;
+                    auto area_m2 = c.geo.area();
+                    for(size_t i=0;i<c.sc.kirchner_discharge.size();++i)
+                        v.emplace_back(shyft::core::actual_evapotranspiration::calc_pot_ratio(m3s_to_mmh(c.sc.kirchner_discharge.value(i),area_m2),scale_factor));
+                    return shyft::core::pts_t(c.sc.kirchner_discharge.time_axis(),move(v),c.sc.kirchner_discharge.point_interpretation());
+                });
+		}
 		double pot_ratio_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -1013,6 +1215,11 @@ namespace shyft {
 				catchment_feature(*cells, catchment_indexes,
 					[](const cell& c) { return c.rc.ae_output; }, ith_timestep);
 		}
+		cell_feature_matrix output_matrix(const vector<int>& catchment_indexes) const {
+			return shyft::core::cell_statistics::
+				catchment_feature_matrix(*cells, catchment_indexes,
+				[](const cell& c) -> decltype(auto) { return (c.rc.ae_output); });
+		}
 		double output_value(const vector<int>& catchment_indexes, size_t ith_timestep) const {
 			return shyft::core::cell_statistics::
 				average_catchment_feature_value(*cells, catchment_indexes,
@@ -0,0 +1,490 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+
+#include <dlib/server.h>
+#include <dlib/iosockstream.h>
+
+#include "api/api.h"
+#include "api/api_state.h"
+#include "api/api_windowed_run.h"
+#include "core/core_serialization.h"
+#include "core/core_archive.h"
+#include "core/dtss_msg.h"
+
+/**
+ * \file
+ * a forecast service that keeps region-models resident, so that a forecast update is a message to the server,
+ * instead of building the cells, reading the states and importing python for each forecast cycle.
+ * The message loop follows the dtss::server, one thread for each connection, reading a message and writing the reply.
+ */
+
+namespace shyft {
+  namespace api {
+    namespace model_srv {
+        /** \brief model-server message-types, the wire-communication of model_server and model_client */
+        enum class message_type : uint8_t {
+            SERVER_EXCEPTION,
+            GET_MODEL_IDS, ///< request without payload, replied by the ids of the resident models
+            SET_ENVIRONMENT, ///< <mid> string, the sources of the region_environment, kept for the following runs
+            RUN, ///< <mid> string, time-axis, best_effort and from_initial_state, run_interpolation and run_cells, replied by the interpolation result
+            GET_DISCHARGES, ///< <mid> string, catchment ids, replied by the discharge of each catchment of the last run
+            GET_STATES, ///< <mid> string, catchment ids, replied by the serialized cell states with id, ref. serialize_to_bytes
+            SET_STATES, ///< <mid> string, serialized cell states with id, catchment ids, applied as the current and initial state, replied by the missing
+            GET_LOCAL_INFLOWS, ///< <mid> string, replied by the river ids, and the local inflow from the cells of the model to each, of the last run
+        };
+
+        namespace msg {
+            template <class T>
+            message_type read_type(T& in) {
+                int32_t mtype;
+                in.read((char*)&mtype, sizeof(mtype));
+                if (!in)
+                    throw std::runtime_error("model_server: failed to read message type");
+                return (message_type)mtype;
+            }
+
+            template <class T>
+            void write_type(message_type mt, T& out) {
+                int32_t mtype = (int32_t)mt;
+                out.write((const char *)&mtype, sizeof(mtype));
+            }
+
+            template <class T>
+            void send_exception(const std::exception& e, T& out) {
+                write_type(message_type::SERVER_EXCEPTION, out);
+                dtss::msg::write_exception(e, out);
+            }
+
+            /** append the mid-points, x,y,z for each, and the series of the sources s */
+            template <class S>
+            void append_sources(const std::shared_ptr<std::vector<S>>& s, std::vector<int>& n, std::vector<double>& xyz, ats_vector& tsv) {
+                n.push_back(s ? int(s->size()) : 0);
+                if (!s) return;
+                for (const auto& x : *s) {
+                    xyz.push_back(x.mid_point_.x); xyz.push_back(x.mid_point_.y); xyz.push_back(x.mid_point_.z);
+                    tsv.push_back(x.ts);
+                }
+            }
+
+            template <class S>
+            std::shared_ptr<std::vector<S>> make_sources(int n, const std::vector<double>& xyz, const ats_vector& tsv, size_t& j) {
+                auto s = std::make_shared<std::vector<S>>();
+                s->reserve(size_t(n));
+                for (int k = 0; k < n; ++k, ++j)
+                    s->emplace_back(geo_point(xyz[3*j], xyz[3*j + 1], xyz[3*j + 2]), tsv[j]);
+                return s;
+            }
+
+            /** the environment as the number of sources of each kind, the mid-points and the series, in one object each,
+             * since the archives write an object at an already written address as a reference to it */
+            template <class A>
+            void write_environment(A& oa, const a_region_environment& env) {
+                std::vector<int> n;
+                std::vector<double> xyz;
+                ats_vector tsv;
+                append_sources(env.temperature, n, xyz, tsv);
+                append_sources(env.precipitation, n, xyz, tsv);
+                append_sources(env.radiation, n, xyz, tsv);
+                append_sources(env.wind_speed, n, xyz, tsv);
+                append_sources(env.rel_hum, n, xyz, tsv);
+                oa << n << xyz << tsv;
+            }
+
+            template <class A>
+            a_region_environment read_environment(A& ia) {
+                std::vector<int> n;
+                std::vector<double> xyz;
+                ats_vector tsv;
+                ia >> n >> xyz >> tsv;
+                size_t n_sources = 0;
+                for (auto x : n) n_sources += size_t(std::max(0, x));
+                if (n.size() != 5 || tsv.size() != n_sources || xyz.size() != 3*n_sources)
+                    throw std::runtime_error("model_server: the environment has " + std::to_string(tsv.size()) + " series, and "
+                                             + std::to_string(xyz.size()) + " coordinates, for " + std::to_string(n_sources) + " sources");
+                a_region_environment env;
+                size_t j = 0;
+                env.temperature = make_sources<TemperatureSource>(n[0], xyz, tsv, j);
+                env.precipitation = make_sources<PrecipitationSource>(n[1], xyz, tsv, j);
+                env.radiation = make_sources<RadiationSource>(n[2], xyz, tsv, j);
+                env.wind_speed = make_sources<WindSpeedSource>(n[3], xyz, tsv, j);
+                env.rel_hum = make_sources<RelHumSource>(n[4], xyz, tsv, j);
+                return env;
+            }
+        }
+    }
+
+    /** \brief a server keeping region-models resident in memory, serving forecast runs by messages
+     *
+     * Each model is added by the hosting process, with an id and the interpolation parameter to use.
+     * The clients, ref. model_client, then sets the environment, runs and reads the results and states by the id.
+     * A run of a resident model is run_interpolation followed by run_cells, so only the sources changed since the previous run
+     * are interpolated again, and the cells, the routing and the cached neighbours are kept from run to run.
+     * The requests for one model are serialized, the requests for different models run concurrently.
+     *
+     * If read is set, the unbound series of an environment, like shyft:// references, are read for the period of each run,
+     * ref. dtss_reader and window_environment, so the clients can send the references instead of the series.
+     *
+     * \tparam M the region-model type, like region_model<pt_gs_k::cell_discharge_response_t, a_region_environment>
+     */
+    template <class M>
+    struct model_server : dlib::server_iostream {
+        typedef typename M::cell_t cell_t;
+        typedef cell_state_with_id<typename cell_t::state_t> cell_state_id_t;
+
+        /** a resident model, with the parameter and the environment of its runs */
+        struct model_slot {
+            std::shared_ptr<M> model;
+            interpolation_parameter ip;
+            a_region_environment env;
+            std::mutex mx;///< serializes the requests of the model
+        };
+
+        ts_reader_t read;///< if set, used to read the unbound series of the environment for each run
+
+        /** \brief add, or replace, the resident model mid */
+        void add_model(const std::string& mid, const std::shared_ptr<M>& m, const interpolation_parameter& ip) {
+            if (!m)
+                throw std::runtime_error("model_server: add_model " + mid + " with a null model");
+            auto s = std::make_shared<model_slot>();
+            s->model = m;
+            s->ip = ip;
+            std::lock_guard<std::mutex> guard(mx);
+            models[mid] = s;
+        }
+
+        /** \return true if a model mid was removed, a request in progress keeps its model until done */
+        bool remove_model(const std::string& mid) {
+            std::lock_guard<std::mutex> guard(mx);
+            return models.erase(mid) > 0;
+        }
+
+        /** \return the ids of the resident models, ascending */
+        std::vector<std::string> model_ids() const {
+            std::lock_guard<std::mutex> guard(mx);
+            std::vector<std::string> r;
+            for (const auto& m : models) r.push_back(m.first);
+            return r;
+        }
+
+        void set_environment(const std::string& mid, const a_region_environment& env) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            s->env = env;
+        }
+
+        /** \brief run the model mid over ta, with the current environment
+         *
+         * \param from_initial_state if true, and the model has an initial_state, the run starts from it, as a repeated forecast,
+         *        otherwise from the current state, as a continued simulation
+         * \return the result of run_interpolation
+         */
+        bool run(const std::string& mid, const time_axis::fixed_dt& ta, bool best_effort, bool from_initial_state) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            auto& m = *s->model;
+            if (from_initial_state && m.initial_state.size())
+                m.revert_to_initial_state();
+            bool ok = false;
+            if (read) {
+                const auto p = ta.total_period();
+                ok = m.run_interpolation(s->ip, ta, window_environment(s->env, utcperiod(p.start - ta.delta(), p.end + ta.delta()), read), best_effort);
+            } else {
+                ok = m.run_interpolation(s->ip, ta, s->env, best_effort);
+            }
+            m.run_cells();
+            return ok;
+        }
+
+        /** \return the discharge of each catchment of cids from the last run, all catchments, in catchment index order, if empty */
+        ats_vector catchment_discharges(const std::string& mid, const std::vector<int>& cids) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            const auto& m = *s->model;
+            std::vector<pts_t> q;
+            m.catchment_discharges(q);
+            ats_vector r;
+            auto as_ts = [&m](const pts_t& x) {
+                return apoint_ts(time_axis::generic_dt(m.time_axis), x.v, time_series::POINT_AVERAGE_VALUE);
+            };
+            if (cids.empty()) {
+                for (const auto& x : q) r.push_back(as_ts(x));
+            } else {
+                for (auto cid : cids) r.push_back(as_ts(q[m.cix_from_cid(size_t(cid))]));
+            }
+            return r;
+        }
+
+        /** \brief the local inflow of the last run to each river that cells of the model mid are routed to
+         *
+         * These are the contributions of the model to the routing of a river network shared with other models,
+         * ref. partitioned_region_model, so the rivers are those of the cells, in ascending id order, not the ones of the network.
+         * \param rids set to the river ids of the returned series
+         */
+        ats_vector local_inflows(const std::string& mid, std::vector<int>& rids) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            const auto& m = *s->model;
+            std::set<int> routed;
+            for (const auto& c : *m.get_cells())
+                if (routing::valid_routing_id(int(c.geo.routing.id)))
+                    routed.insert(int(c.geo.routing.id));
+            rids.assign(routed.begin(), routed.end());
+            ats_vector r;
+            if (rids.empty())
+                return r;
+            auto f = m.routing_flows();
+            for (auto rid : rids) {
+                auto i = f->local_inflow.find(rid);
+                if (i == f->local_inflow.end())
+                    throw std::runtime_error("model_server: the cells of model " + mid + " are routed to river " + std::to_string(rid) + ", that is not in its river network");
+                r.push_back(apoint_ts(time_axis::generic_dt(m.time_axis), i->second.v, time_series::POINT_AVERAGE_VALUE));
+            }
+            return r;
+        }
+
+        /** \return the state of the cells of cids, all if empty */
+        std::shared_ptr<std::vector<cell_state_id_t>> get_states(const std::string& mid, const std::vector<int>& cids) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            return state_io_handler<cell_t>(s->model->get_cells()).extract_state(cids);
+        }
+
+        /** \brief apply the states to the cells of cids, all if empty, as the current and the initial state of the model
+         * \return the indices of the states that did not match a cell
+         */
+        std::vector<int> set_states(const std::string& mid, const std::shared_ptr<std::vector<cell_state_id_t>>& states, const std::vector<int>& cids) {
+            auto s = slot(mid);
+            std::lock_guard<std::mutex> guard(s->mx);
+            auto& m = *s->model;
+            auto missing = state_io_handler<cell_t>(m.get_cells()).apply_state(states, cids);
+            m.get_states(m.initial_state);
+            return missing;
+        }
+
+        /** \brief decode the request t of in, do it, and write the reply to out, or the exception if it fails */
+        void handle_message(model_srv::message_type t, std::istream& in, std::ostream& out) {
+            using model_srv::message_type;
+            namespace mmsg = model_srv::msg;
+            try {
+                switch (t) {
+                case message_type::GET_MODEL_IDS: {
+                    auto r = model_ids();
+                    mmsg::write_type(message_type::GET_MODEL_IDS, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << r;
+                } break;
+                case message_type::SET_ENVIRONMENT: {
+                    auto mid = dtss::msg::read_string(in);
+                    core_iarchive ia(in, core_arch_flags);
+                    auto env = mmsg::read_environment(ia);
+                    set_environment(mid, env);
+                    mmsg::write_type(message_type::SET_ENVIRONMENT, out);
+                } break;
+                case message_type::RUN: {
+                    auto mid = dtss::msg::read_string(in);
+                    time_axis::fixed_dt ta;
+                    bool best_effort{ true }, from_initial_state{ true };
+                    core_iarchive ia(in, core_arch_flags);
+                    ia >> ta >> best_effort >> from_initial_state;
+                    bool ok = run(mid, ta, best_effort, from_initial_state);
+                    mmsg::write_type(message_type::RUN, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << ok;
+                } break;
+                case message_type::GET_DISCHARGES: {
+                    auto mid = dtss::msg::read_string(in);
+                    std::vector<int> cids;
+                    core_iarchive ia(in, core_arch_flags);
+                    ia >> cids;
+                    auto r = catchment_discharges(mid, cids);
+                    mmsg::write_type(message_type::GET_DISCHARGES, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << r;
+                } break;
+                case message_type::GET_STATES: {
+                    auto mid = dtss::msg::read_string(in);
+                    std::vector<int> cids;
+                    core_iarchive ia(in, core_arch_flags);
+                    ia >> cids;
+                    auto b = serialize_to_bytes(get_states(mid, cids));
+                    mmsg::write_type(message_type::GET_STATES, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << b;
+                } break;
+                case message_type::SET_STATES: {
+                    auto mid = dtss::msg::read_string(in);
+                    std::vector<char> b;
+                    std::vector<int> cids;
+                    core_iarchive ia(in, core_arch_flags);
+                    ia >> b >> cids;
+                    std::shared_ptr<std::vector<cell_state_id_t>> states;
+                    deserialize_from_bytes(b, states);
+                    auto missing = set_states(mid, states, cids);
+                    mmsg::write_type(message_type::SET_STATES, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << missing;
+                } break;
+                case message_type::GET_LOCAL_INFLOWS: {
+                    auto mid = dtss::msg::read_string(in);
+                    std::vector<int> rids;
+                    auto r = local_inflows(mid, rids);
+                    mmsg::write_type(message_type::GET_LOCAL_INFLOWS, out);
+                    core_oarchive oa(out, core_arch_flags);
+                    oa << rids << r;
+                } break;
+                default:
+                    throw std::runtime_error("model_server: got unknown message type " + std::to_string((int)t));
+                }
+            } catch (const std::exception& e) {
+                mmsg::send_exception(e, out);
+            }
+        }
+
+        void on_connect(std::istream& in, std::ostream& out, const std::string& /*foreign_ip*/, const std::string& /*local_ip*/,
+                        unsigned short /*foreign_port*/, unsigned short /*local_port*/, dlib::uint64 /*connection_id*/) override {
+            while (in.peek() != EOF) {
+                auto t = model_srv::msg::read_type(in);
+                std::ostringstream reply;// the complete reply is written at once, also when the request fails half-way
+                handle_message(t, in, reply);
+                const auto r = reply.str();
+                out.write(r.data(), r.size());
+                out.flush();
+            }
+        }
+
+      private:
+        std::shared_ptr<model_slot> slot(const std::string& mid) const {
+            std::lock_guard<std::mutex> guard(mx);
+            auto f = models.find(mid);
+            if (f == models.end())
+                throw std::runtime_error("model_server: no model with id " + mid);
+            return f->second;
+        }
+        mutable std::mutex mx;///< protects models
+        std::map<std::string, std::shared_ptr<model_slot>> models;
+    };
+
+    /** \brief a client of the model_server, one connection, opened on construction
+     *
+     * The states are passed as serialized cell states with id, ref. serialize_to_bytes, so the client is independent of the model type.
+     * \note not thread-safe, use one client for each thread
+     */
+    struct model_client {
+        std::string host_port;
+        int timeout_ms;
+        dlib::iosockstream io;
+
+        explicit model_client(const std::string& host_port, int timeout_ms = 1000) : host_port(host_port), timeout_ms(timeout_ms) {
+            io.open(host_port, timeout_ms);
+        }
+        void close() { io.close(timeout_ms); }
+        void reopen() { io.open(host_port, timeout_ms); }
+
+        std::vector<std::string> model_ids() {
+            model_srv::msg::write_type(model_srv::message_type::GET_MODEL_IDS, io);
+            io.flush();
+            std::vector<std::string> r;
+            read_reply(model_srv::message_type::GET_MODEL_IDS, [&r](core_iarchive& ia) { ia >> r; });
+            return r;
+        }
+
+        void set_environment(const std::string& mid, const a_region_environment& env) {
+            model_srv::msg::write_type(model_srv::message_type::SET_ENVIRONMENT, io);
+            dtss::msg::write_string(mid, io);
+            {
+                core_oarchive oa(io, core_arch_flags);
+                model_srv::msg::write_environment(oa, env);
+            }
+            io.flush();
+            read_reply(model_srv::message_type::SET_ENVIRONMENT);
+        }
+
+        /** \brief run the model mid over ta, ref. model_server::run \return the result of the interpolation */
+        bool run(const std::string& mid, const time_axis::fixed_dt& ta, bool best_effort = true, bool from_initial_state = true) {
+            model_srv::msg::write_type(model_srv::message_type::RUN, io);
+            dtss::msg::write_string(mid, io);
+            {
+                core_oarchive oa(io, core_arch_flags);
+                oa << ta << best_effort << from_initial_state;
+            }
+            io.flush();
+            bool ok = false;
+            read_reply(model_srv::message_type::RUN, [&ok](core_iarchive& ia) { ia >> ok; });
+            return ok;
+        }
+
+        ats_vector catchment_discharges(const std::string& mid, const std::vector<int>& cids) {
+            ats_vector r;
+            request(model_srv::message_type::GET_DISCHARGES, mid, cids, [&r](core_iarchive& ia) { ia >> r; });
+            return r;
+        }
+
+        std::vector<char> get_states(const std::string& mid, const std::vector<int>& cids) {
+            std::vector<char> r;
+            request(model_srv::message_type::GET_STATES, mid, cids, [&r](core_iarchive& ia) { ia >> r; });
+            return r;
+        }
+
+        /** \return the indices of the states that did not match a cell */
+        std::vector<int> set_states(const std::string& mid, const std::vector<char>& states, const std::vector<int>& cids) {
+            model_srv::msg::write_type(model_srv::message_type::SET_STATES, io);
+            dtss::msg::write_string(mid, io);
+            {
+                core_oarchive oa(io, core_arch_flags);
+                oa << states << cids;
+            }
+            io.flush();
+            std::vector<int> r;
+            read_reply(model_srv::message_type::SET_STATES, [&r](core_iarchive& ia) { ia >> r; });
+            return r;
+        }
+
+        /** \return the local inflow to each river of rids, set to the rivers of the cells, ref. model_server::local_inflows */
+        ats_vector local_inflows(const std::string& mid, std::vector<int>& rids) {
+            model_srv::msg::write_type(model_srv::message_type::GET_LOCAL_INFLOWS, io);
+            dtss::msg::write_string(mid, io);
+            io.flush();
+            ats_vector r;
+            read_reply(model_srv::message_type::GET_LOCAL_INFLOWS, [&r, &rids](core_iarchive& ia) { ia >> rids >> r; });
+            return r;
+        }
+
+      private:
+        template <class F>
+        void request(model_srv::message_type t, const std::string& mid, const std::vector<int>& cids, F&& read_result) {
+            model_srv::msg::write_type(t, io);
+            dtss::msg::write_string(mid, io);
+            {
+                core_oarchive oa(io, core_arch_flags);
+                oa << cids;
+            }
+            io.flush();
+            read_reply(t, read_result);
+        }
+        void read_reply(model_srv::message_type t) {// a reply without payload
+            auto r = model_srv::msg::read_type(io);
+            if (r == model_srv::message_type::SERVER_EXCEPTION)
+                throw dtss::msg::read_exception(io);
+            if (r != t)
+                throw std::runtime_error("model_client: got unexpected response " + std::to_string((int)r));
+        }
+        template <class F>
+        void read_reply(model_srv::message_type t, F&& read_result) {
+            read_reply(t);
+            core_iarchive ia(io, core_arch_flags);
+            read_result(ia);
+        }
+    };
+  }
+}
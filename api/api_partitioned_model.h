@@ -0,0 +1,296 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <future>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include "api/api_model_server.h"
+#include "core/routing.h"
+
+/**
+ * \file
+ * a region-model decomposed by catchments over several processes, each a model_server with the cells of its partition,
+ * so that the cells of a national model do not need to fit in the memory of one process.
+ */
+
+namespace shyft {
+  namespace api {
+
+    /** \brief the catchment ids of the cells split in n partitions of about the same number of cells
+     *
+     * The catchments are taken largest first, each to the partition with the fewest cells so far,
+     * so a partition is never more than the largest catchment above the even share.
+     * \return the ascending catchment ids of each partition, fewer than n if there are fewer catchments
+     */
+    template <class C>
+    std::vector<std::vector<int>> partition_catchments(const std::vector<C>& cells, size_t n) {
+        if (n == 0)
+            throw std::runtime_error("partition_catchments: the number of partitions must be > 0");
+        std::map<int, size_t> n_cells;
+        for (const auto& c : cells)
+            ++n_cells[int(c.geo.catchment_id())];
+        std::vector<std::pair<size_t, int>> by_size;// n cells, cid
+        for (const auto& x : n_cells)
+            by_size.emplace_back(x.second, x.first);
+        std::stable_sort(by_size.begin(), by_size.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        std::vector<std::vector<int>> r(std::min(n, by_size.size()));
+        std::vector<size_t> load(r.size(), 0);
+        for (const auto& x : by_size) {
+            const size_t k = size_t(std::min_element(load.begin(), load.end()) - load.begin());
+            r[k].push_back(x.second);
+            load[k] += x.first;
+        }
+        for (auto& p : r)
+            std::sort(p.begin(), p.end());
+        return r;
+    }
+
+    /** \return the cells of the catchments cids, in the order of cells, as the cells of the model of a partition */
+    template <class C>
+    std::shared_ptr<std::vector<C>> cells_of_catchments(const std::vector<C>& cells, const std::vector<int>& cids) {
+        const std::set<int> s(cids.begin(), cids.end());
+        auto r = std::make_shared<std::vector<C>>();
+        for (const auto& c : cells)
+            if (s.count(int(c.geo.catchment_id())))
+                r->push_back(c);
+        return r;
+    }
+
+    /** \brief a region-model where the cells are split by catchment over model_servers, with the routing at the master
+     *
+     * Each partition is a model, resident in a model_server, with the cells of its catchments, the interpolation parameter,
+     * and the river network of the region, or at least the rivers its cells are routed to, ref. partition_catchments and cells_of_catchments.
+     * A run sends the environment to all partitions, runs them concurrently, and gathers the catchment discharges and
+     * the local inflow of the cells of each partition to the rivers. The rivers are then routed at the master, with the sum
+     * of the local inflows of all partitions, so rivers receiving cells of several partitions, and river networks crossing
+     * the partition boundaries, are routed as in one region-model.
+     *
+     * The run, result and state functions mirror those of region_model, so the code driving a region_model carries over,
+     * except that the interpolation is done by the partitions as part of run_cells, ref. interpolation_ok.
+     * \note not thread-safe, as the model_client
+     * \tparam M the region-model type of the partitions, like region_model<pt_gs_k::cell_discharge_response_t, a_region_environment>
+     */
+    template <class M>
+    struct partitioned_region_model {
+        typedef typename M::cell_t cell_t;
+        typedef shyft::core::pts_t pts_t;
+        typedef shyft::time_axis::fixed_dt timeaxis_t;
+        typedef cell_state_with_id<typename cell_t::state_t> cell_state_id_t;
+        typedef typename routing::model<cell_t>::flows routing_flows_t;
+
+        /** \brief a model of the region, hosted by a model_server */
+        struct partition {
+            std::string host_port;///< the model_server, as host:port
+            std::string mid;///< the id of the model at the server
+            std::vector<int> catchment_ids;///< the catchments of the cells of the model
+        };
+
+        routing::river_network river_network;///< the rivers of the whole region, routed at the master
+        timeaxis_t time_axis;///< of the last run_interpolation
+        bool interpolation_ok{true};///< the result of the interpolation by the partitions in the last run_cells
+
+        partitioned_region_model(const std::vector<partition>& partitions, const routing::river_network& rn, int timeout_ms = 1000)
+          : river_network(rn), parts(partitions) {
+            if (parts.empty())
+                throw std::runtime_error("partitioned_region_model: no partitions");
+            for (size_t k = 0; k < parts.size(); ++k) {
+                for (auto cid : parts[k].catchment_ids)
+                    if (!part_of_cid.emplace(cid, k).second)
+                        throw std::runtime_error("partitioned_region_model: catchment " + std::to_string(cid) + " is in more than one partition");
+                clients.push_back(std::make_unique<model_client>(parts[k].host_port, timeout_ms));
+            }
+            for (const auto& x : part_of_cid) {// cix_to_cid ascending, as the region_model
+                cid_to_cix[x.first] = cix_to_cid.size();
+                cix_to_cid.push_back(x.first);
+            }
+        }
+
+        size_t number_of_partitions() const { return parts.size(); }
+        size_t number_of_catchments() const { return cix_to_cid.size(); }
+        const std::vector<int>& catchment_ids() const { return cix_to_cid; }
+
+        size_t cix_from_cid(size_t cid) const {
+            auto cix = cid_to_cix.find(int(cid));
+            if (cix == cid_to_cix.end())
+                throw std::runtime_error("partitioned_region_model: no match for cid in map lookup");
+            return cix->second;
+        }
+
+        /** \brief set the environment of the partitions, interpolated by each of them at the next run_cells
+         * \return true, the result of the interpolation is interpolation_ok after run_cells
+         */
+        bool run_interpolation(const timeaxis_t& ta, const a_region_environment& env, bool best_effort = true) {
+            for_each_partition([&env](size_t /*k*/, model_client& c, const partition& p) { c.set_environment(p.mid, env); });
+            time_axis = ta;
+            run_best_effort = best_effort;
+            return true;
+        }
+
+        /** \brief the next run_cells starts from the initial state of each partition */
+        void revert_to_initial_state() { from_initial_state = true; }
+
+        /** \brief run the partitions over the time-axis, then route the rivers with the local inflows of all partitions */
+        void run_cells() {
+            if (time_axis.size() == 0)
+                throw std::runtime_error("partitioned_region_model: run_interpolation must be called before run_cells");
+            std::vector<char> ok(parts.size(), 0);
+            std::vector<ats_vector> q(parts.size()), inflow(parts.size());
+            std::vector<std::vector<int>> rids(parts.size());
+            for_each_partition([&](size_t k, model_client& c, const partition& p) {
+                ok[k] = c.run(p.mid, time_axis, run_best_effort, from_initial_state) ? 1 : 0;
+                q[k] = c.catchment_discharges(p.mid, p.catchment_ids);
+                inflow[k] = c.local_inflows(p.mid, rids[k]);
+            });
+            from_initial_state = false;
+            interpolation_ok = std::all_of(ok.begin(), ok.end(), [](char x) { return x != 0; });
+            discharges.assign(cix_to_cid.size(), pts_t(time_axis, 0.0, time_series::POINT_AVERAGE_VALUE));
+            std::map<int, pts_t> lateral;
+            for (size_t k = 0; k < parts.size(); ++k) {
+                for (size_t i = 0; i < q[k].size(); ++i)
+                    discharges[cix_from_cid(size_t(parts[k].catchment_ids[i]))] = as_pts(q[k][i]);
+                for (size_t i = 0; i < rids[k].size(); ++i) {
+                    auto l = lateral.find(rids[k][i]);
+                    if (l == lateral.end())
+                        l = lateral.emplace(rids[k][i], pts_t(time_axis, 0.0, time_series::POINT_AVERAGE_VALUE)).first;
+                    const auto v = inflow[k][i].values();
+                    for (size_t t = 0; t < time_axis.size(); ++t)
+                        l->second.v[t] += v[t];
+                }
+            }
+            routing::model<cell_t> rn(river_network, std::make_shared<std::vector<cell_t>>(), time_axis);
+            routing::state s;
+            flows = rn.evaluate_from(nullptr, 0, s, nullptr, &lateral);
+        }
+
+        /** \brief the discharge of each catchment of the last run, in catchment index order, ref. cix_from_cid */
+        template <class TSV>
+        void catchment_discharges(TSV& r) const {
+            r.clear();
+            for (const auto& x : discharges)
+                r.emplace_back(x);
+        }
+
+        /** \brief the output of the rivers of the last run, by ascending river id, empty if no routing */
+        template <class TSV>
+        void routing_discharges(TSV& r) const {
+            r.clear();
+            if (flows)
+                for (const auto& x : flows->output_m3s)
+                    r.emplace_back(x.second);
+        }
+        std::shared_ptr<pts_t> river_output_flow_m3s(int rid) const { return river_flow(&routing_flows_t::output_m3s, rid); }
+        std::shared_ptr<pts_t> river_upstream_inflow_m3s(int rid) const { return river_flow(&routing_flows_t::upstream_inflow, rid); }
+        std::shared_ptr<pts_t> river_local_inflow_m3s(int rid) const { return river_flow(&routing_flows_t::local_inflow, rid); }
+
+        /** \return the state of the cells of cids, all if empty, gathered from the partitions */
+        std::shared_ptr<std::vector<cell_state_id_t>> get_states(const std::vector<int>& cids = std::vector<int>{}) {
+            auto by_part = split_cids(cids);
+            std::vector<std::vector<char>> b(parts.size());
+            for_each_partition([&](size_t k, model_client& c, const partition& p) {
+                if (cids.empty() || by_part[k].size())
+                    b[k] = c.get_states(p.mid, by_part[k]);// empty for all the cells of the partition
+            });
+            auto r = std::make_shared<std::vector<cell_state_id_t>>();
+            for (const auto& x : b) {
+                if (x.empty())
+                    continue;
+                std::shared_ptr<std::vector<cell_state_id_t>> s;
+                deserialize_from_bytes(x, s);
+                if (s)
+                    r->insert(r->end(), s->begin(), s->end());
+            }
+            return r;
+        }
+
+        /** \brief apply the states to the cells of their partitions, as the current and the initial state
+         * \return the indices of the states that did not match a cell, also those of catchments not in any partition
+         */
+        std::vector<int> set_states(const std::shared_ptr<std::vector<cell_state_id_t>>& states) {
+            std::vector<int> missing;
+            if (!states)
+                return missing;
+            std::vector<std::shared_ptr<std::vector<cell_state_id_t>>> s(parts.size());
+            std::vector<std::vector<int>> ix(parts.size());// the index in states of each state of a partition
+            for (size_t i = 0; i < states->size(); ++i) {
+                auto k = part_of_cid.find(int((*states)[i].id.cid));
+                if (k == part_of_cid.end()) {
+                    missing.push_back(int(i));
+                    continue;
+                }
+                if (!s[k->second])
+                    s[k->second] = std::make_shared<std::vector<cell_state_id_t>>();
+                s[k->second]->push_back((*states)[i]);
+                ix[k->second].push_back(int(i));
+            }
+            std::vector<std::vector<int>> m(parts.size());
+            for_each_partition([&](size_t k, model_client& c, const partition& p) {
+                if (s[k])
+                    m[k] = c.set_states(p.mid, serialize_to_bytes(s[k]), p.catchment_ids);
+            });
+            for (size_t k = 0; k < parts.size(); ++k)
+                for (auto i : m[k])
+                    missing.push_back(ix[k][size_t(i)]);
+            std::sort(missing.begin(), missing.end());
+            return missing;
+        }
+
+        /** \return the flows of all rivers of the last run, null before the first run */
+        std::shared_ptr<const routing_flows_t> routing_flows() const { return flows; }
+
+      private:
+        std::vector<partition> parts;
+        std::vector<std::unique_ptr<model_client>> clients;///< one for each partition
+        std::map<int, size_t> part_of_cid;
+        std::map<int, size_t> cid_to_cix;
+        std::vector<int> cix_to_cid;
+        bool run_best_effort{true};
+        bool from_initial_state{false};
+        std::vector<pts_t> discharges;///< of the last run, by cix
+        std::shared_ptr<const routing_flows_t> flows;///< of the last run
+
+        /** fx(k, client, partition) for each partition concurrently, rethrowing the first failure when all are done */
+        template <class F>
+        void for_each_partition(F&& fx) {
+            std::vector<std::future<void>> w;
+            for (size_t k = 0; k < parts.size(); ++k)
+                w.push_back(std::async(std::launch::async, [&fx, this, k]() { fx(k, *clients[k], parts[k]); }));
+            for (auto& f : w)
+                f.wait();
+            for (auto& f : w)
+                f.get();
+        }
+
+        /** \return the catchments of cids for each partition, throws if one is not in any partition */
+        std::vector<std::vector<int>> split_cids(const std::vector<int>& cids) const {
+            std::vector<std::vector<int>> r(parts.size());
+            for (auto cid : cids) {
+                auto k = part_of_cid.find(cid);
+                if (k == part_of_cid.end())
+                    throw std::runtime_error("partitioned_region_model: no partition with catchment " + std::to_string(cid));
+                r[k->second].push_back(cid);
+            }
+            return r;
+        }
+
+        pts_t as_pts(const apoint_ts& ts) const {
+            auto v = ts.values();
+            v.resize(time_axis.size(), shyft::nan);
+            return pts_t(time_axis, v, time_series::POINT_AVERAGE_VALUE);
+        }
+
+        std::shared_ptr<pts_t> river_flow(const std::map<int, pts_t> routing_flows_t::* m, int rid) const {
+            auto r = std::make_shared<pts_t>(time_axis, 0.0, time_series::POINT_AVERAGE_VALUE);
+            if (flows && river_network.rid_map.size()) {
+                river_network.check_rid(rid);
+                r = std::make_shared<pts_t>((flows.get()->*m).find(rid)->second);
+            }
+            return r;
+        }
+    };
+  }
+}
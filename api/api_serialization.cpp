@@ -102,5 +102,21 @@ namespace shyft {
         template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_gs_k::state>>>&states);// { deserialize_from_bytes_impl(bytes, states); }
         template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_hs_k::state>>>&states);// { deserialize_from_bytes_impl(bytes, states); }
         template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_ss_k::state>>>&states);// { deserialize_from_bytes_impl(bytes, states); }
+
+        std::vector<char> serialize_to_bytes(const shyft::core::routing::state& s) {
+            std::ostringstream xmls;
+            core_oarchive oa(xmls,core_arch_flags);
+            oa << core_nvp("routing_state",s);
+            xmls.flush();
+            auto b = xmls.str();
+            return std::vector<char>(b.begin(), b.end());
+        }
+
+        void deserialize_from_bytes(const std::vector<char>& bytes, shyft::core::routing::state& s) {
+            std::string str_bin(bytes.begin(), bytes.end());
+            std::istringstream xmli(str_bin);
+            core_iarchive ia(xmli,core_arch_flags);
+            ia >> core_nvp("routing_state",s);
+        }
     }
 }
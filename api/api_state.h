@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <stdexcept>
+#include <cstdint>
+#include <cstring>
 #include "core/core_serialization.h"
 
 #include "core/geo_cell_data.h"
@@ -13,6 +15,7 @@
 #include "core/pt_gs_k.h"
 #include "core/pt_hs_k.h"
 #include "core/pt_ss_k.h"
+#include "core/routing.h"
 
 namespace shyft {
     namespace api {
@@ -82,6 +85,164 @@ namespace shyft {
           extern  template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_gs_k::state>>>&states);
           extern  template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_hs_k::state>>>&states);
           extern  template void deserialize_from_bytes(const std::vector<char>& bytes, std::shared_ptr<std::vector<cell_state_with_id<shyft::core::pt_ss_k::state>>>&states);
+        /** \brief the routing state, ref. region_model::routing_state, to and from a blob, saved along with the cell states */
+        std::vector<char> serialize_to_bytes(const shyft::core::routing::state& s);
+        void deserialize_from_bytes(const std::vector<char>& bytes, shyft::core::routing::state& s);
+
+        /** the state_soa type of the method stack state S, ref. state_soa_base, giving the layout of the bulk state arrays */
+        template <class S> struct state_soa_of;
+        template <> struct state_soa_of<shyft::core::pt_gs_k::state> { typedef shyft::core::pt_gs_k::state_soa type; };
+        template <> struct state_soa_of<shyft::core::pt_hs_k::state> { typedef shyft::core::pt_hs_k::state_soa type; };
+        template <> struct state_soa_of<shyft::core::pt_ss_k::state> { typedef shyft::core::pt_ss_k::state_soa type; };
+        template <> struct state_soa_of<shyft::core::hbv_stack::state> { typedef shyft::core::hbv_stack::state_soa type; };
+
+        /** \brief flat, versioned snapshot of cell states with id, an alternative to the boost archives of serialize_to_bytes
+         *
+         * The snapshot is a fixed header, followed by each member of the ids and each field of the states,
+         * in state_soa order, as a contiguous column over the cells,
+         *   <snapshot> -> <header> <cid> int64_t[n] <x> int64_t[n] <y> int64_t[n] <area> int64_t[n] <field> double[n_fields][n]
+         *   <header>   -> <magic> uint64_t <version> uint32_t <n_fields> uint32_t <layout> uint64_t <n> uint64_t
+         * where layout is a hash of the field names of the stack, so a snapshot of one stack is not read as another.
+         * The header alone tells the size of the snapshot, so it is validated in O(1) before anything is read.
+         *
+         * \note like the ts_db format, this assumes the writer and the reader share the byte order
+         */
+        namespace state_snapshot {
+            constexpr std::uint64_t magic = 0x3130535453594853ull;///< "SHYSTS01"
+            constexpr std::uint32_t version = 1;
+
+            struct header {
+                std::uint64_t magic;
+                std::uint32_t version;
+                std::uint32_t n_fields;
+                std::uint64_t layout;
+                std::uint64_t n;
+            };
+
+            /** \return fnv-1a hash of the field names of the state_soa of S */
+            template <class S>
+            std::uint64_t layout() {
+                std::uint64_t h = 0xcbf29ce484222325ull;
+                for (const auto& name : state_soa_of<S>::type::field_names()) {
+                    for (char c : name) { h ^= std::uint8_t(c); h *= 0x100000001b3ull; }
+                    h ^= std::uint8_t(','); h *= 0x100000001b3ull;
+                }
+                return h;
+            }
+
+            inline size_t size_of(size_t n_fields, size_t n) { return sizeof(header) + n*(4 + n_fields)*sizeof(std::int64_t); }
+
+            /** \return the header of the snapshot d[0..sz) of S, throws if it is not a valid snapshot of S */
+            template <class S>
+            header read_header(const char* d, size_t sz) {
+                typedef typename state_soa_of<S>::type soa_t;
+                header h;
+                if (sz < sizeof(header))
+                    throw std::runtime_error("state snapshot: too short for the header");
+                std::memcpy(&h, d, sizeof(header));
+                if (h.magic != magic)
+                    throw std::runtime_error("state snapshot: not a state snapshot");
+                if (h.version != version)
+                    throw std::runtime_error("state snapshot: unsupported version " + std::to_string(h.version));
+                if (h.n_fields != soa_t::n_fields || h.layout != layout<S>())
+                    throw std::runtime_error("state snapshot: the state fields do not match those of this method stack");
+                if (h.n > (sz - sizeof(header))/((4 + soa_t::n_fields)*sizeof(std::int64_t)) || size_of(h.n_fields, size_t(h.n)) != sz)
+                    throw std::runtime_error("state snapshot: size does not match the number of states");
+                return h;
+            }
+
+            /** \return the snapshot of the n states, where id_of(i) is the cell_state_id and state_of(i) the state of i */
+            template <class S, class IdOf, class StateOf>
+            std::vector<char> write(size_t n, IdOf&& id_of, StateOf&& state_of) {
+                typedef typename state_soa_of<S>::type soa_t;
+                constexpr size_t nf = soa_t::n_fields;
+                std::vector<char> r(size_of(nf, n));
+                const header h{ magic, version, std::uint32_t(nf), layout<S>(), std::uint64_t(n) };
+                std::memcpy(r.data(), &h, sizeof(header));
+                char* ids = r.data() + sizeof(header);
+                char* fields = ids + 4*n*sizeof(std::int64_t);
+                for (size_t i = 0; i < n; ++i) {
+                    const cell_state_id& id = id_of(i);
+                    const std::int64_t iv[4] = { id.cid, id.x, id.y, id.area };
+                    for (size_t k = 0; k < 4; ++k)
+                        std::memcpy(ids + (k*n + i)*sizeof(std::int64_t), &iv[k], sizeof(std::int64_t));
+                    double v[nf];
+                    soa_t::pack(state_of(i), v);
+                    for (size_t k = 0; k < nf; ++k)
+                        std::memcpy(fields + (k*n + i)*sizeof(double), &v[k], sizeof(double));
+                }
+                return r;
+            }
+
+            /** \brief read the states of the snapshot d[0..sz), calling fx(i,id,state) for each, in order
+             *  \return the number of states, throws if it is not a valid snapshot of S
+             */
+            template <class S, class Fx>
+            size_t read(const char* d, size_t sz, Fx&& fx) {
+                typedef typename state_soa_of<S>::type soa_t;
+                constexpr size_t nf = soa_t::n_fields;
+                const size_t n = size_t(read_header<S>(d, sz).n);
+                const char* ids = d + sizeof(header);
+                const char* fields = ids + 4*n*sizeof(std::int64_t);
+                for (size_t i = 0; i < n; ++i) {
+                    std::int64_t iv[4];
+                    for (size_t k = 0; k < 4; ++k)
+                        std::memcpy(&iv[k], ids + (k*n + i)*sizeof(std::int64_t), sizeof(std::int64_t));
+                    double v[nf];
+                    for (size_t k = 0; k < nf; ++k)
+                        std::memcpy(&v[k], fields + (k*n + i)*sizeof(double), sizeof(double));
+                    S s;
+                    soa_t::unpack(v, s);
+                    fx(i, cell_state_id(iv[0], iv[1], iv[2], iv[3]), s);
+                }
+                return n;
+            }
+
+            /** \return the snapshot of the states */
+            template <class S>
+            std::vector<char> of_states(const std::vector<cell_state_with_id<S>>& states) {
+                return write<S>(states.size(),
+                    [&states](size_t i) -> const cell_state_id& { return states[i].id; },
+                    [&states](size_t i) -> const S& { return states[i].state; });
+            }
+
+            /** \return the states of the snapshot d[0..sz) */
+            template <class S>
+            std::vector<cell_state_with_id<S>> to_states(const char* d, size_t sz) {
+                std::vector<cell_state_with_id<S>> r(size_t(read_header<S>(d, sz).n));
+                read<S>(d, sz, [&r](size_t i, const cell_state_id& id, const S& s) { r[i].id = id; r[i].state = s; });
+                return r;
+            }
+
+            /** \return the snapshot of the states of the cells, identified by their geo, ref. cell_state_id_of */
+            template <class C>
+            std::vector<char> of_cells(const std::vector<C>& cells) {
+                typedef typename C::state_t S;
+                return write<S>(cells.size(),
+                    [&cells](size_t i) { return cell_state_id_of(cells[i].geo); },
+                    [&cells](size_t i) -> const S& { return cells[i].state; });
+            }
+
+            /** \brief the states of the cells, from the snapshot d[0..sz) of of_cells
+             *
+             * Requires a state for each cell, in cell order, with the cell_state_id of the cell,
+             * else throws, and leaves the cells unchanged.
+             */
+            template <class C>
+            std::vector<typename C::state_t> to_cell_states(const char* d, size_t sz, const std::vector<C>& cells) {
+                typedef typename C::state_t S;
+                if (size_t(read_header<S>(d, sz).n) != cells.size())
+                    throw std::runtime_error("state snapshot: the number of states must equal the number of cells");
+                std::vector<S> r(cells.size());
+                read<S>(d, sz, [&r, &cells](size_t i, const cell_state_id& id, const S& s) {
+                    if (id != cell_state_id_of(cells[i].geo))
+                        throw std::runtime_error("state snapshot: the state " + std::to_string(i) + " does not have the id of cell " + std::to_string(i));
+                    r[i] = s;
+                });
+                return r;
+            }
+        }
+
         /** \brief state_io_handler for efficient handling of cell-identified states
         *
         * This class provides functionality to extract/apply state based on a
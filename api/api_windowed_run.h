@@ -0,0 +1,141 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <stdexcept>
+
+#include "api/api.h"
+#include "core/dtss_client.h"
+
+/**
+ * \file
+ * running a region-model window by window over a long time-axis, with the sources read as needed,
+ * so that the memory used is bounded by the window, not by the time-axis.
+ */
+
+namespace shyft {
+  namespace api {
+    using shyft::time_series::dd::ats_vector;
+
+    /** \brief reads, or evaluates, the series of tsv for the period p, one result for each series */
+    typedef std::function<std::vector<apoint_ts>(const ats_vector&, utcperiod)> ts_reader_t;
+
+    /** \return a reader that evaluates the series at the dtss of c, that must outlive the reader */
+    inline ts_reader_t dtss_reader(dtss::client& c, bool use_ts_cached_read = true, bool update_ts_cache = false) {
+        return [&c, use_ts_cached_read, update_ts_cache](const ats_vector& tsv, utcperiod p) {
+            return c.evaluate(tsv, p, use_ts_cached_read, update_ts_cache);
+        };
+    }
+
+    namespace detail {
+        template <class S>
+        void collect_unbound(const shared_ptr<vector<S>>& v, ats_vector& tsv) {
+            if (!v) return;
+            for (const auto& s : *v)
+                if (s.ts.ts && s.ts.needs_bind())
+                    tsv.push_back(s.ts);
+        }
+        template <class S>
+        shared_ptr<vector<S>> with_read(const shared_ptr<vector<S>>& v, const std::vector<apoint_ts>& r, size_t& j) {
+            auto w = make_shared<vector<S>>();
+            if (!v) return w;
+            w->reserve(v->size());
+            for (const auto& s : *v) {
+                w->push_back(s);
+                if (s.ts.ts && s.ts.needs_bind())
+                    w->back().ts = r[j++];
+            }
+            return w;
+        }
+    }
+
+    /** \brief the sources of env, with the unbound series, like the shyft:// references of a dtss, read for the period p
+     *
+     * The bound sources are kept as they are, sharing the series with env.
+     * \throw runtime_error if the reader does not return one series for each unbound series
+     */
+    inline a_region_environment window_environment(const a_region_environment& env, utcperiod p, const ts_reader_t& read) {
+        ats_vector tsv;
+        detail::collect_unbound(env.temperature, tsv);
+        detail::collect_unbound(env.precipitation, tsv);
+        detail::collect_unbound(env.radiation, tsv);
+        detail::collect_unbound(env.wind_speed, tsv);
+        detail::collect_unbound(env.rel_hum, tsv);
+        std::vector<apoint_ts> r;
+        if (tsv.size()) {
+            r = read(tsv, p);
+            if (r.size() != tsv.size())
+                throw std::runtime_error("window_environment: the reader returned " + std::to_string(r.size()) + " series, expected " + std::to_string(tsv.size()));
+        }
+        a_region_environment w;
+        size_t j = 0;
+        w.temperature = detail::with_read(env.temperature, r, j);
+        w.precipitation = detail::with_read(env.precipitation, r, j);
+        w.radiation = detail::with_read(env.radiation, r, j);
+        w.wind_speed = detail::with_read(env.wind_speed, r, j);
+        w.rel_hum = detail::with_read(env.rel_hum, r, j);
+        return w;
+    }
+
+    /** \brief run the region-model m over ta, window by window, and return the catchment discharges over ta
+     *
+     * For each window of window_steps steps, the unbound sources of env are read for the window,
+     * extended by one step at each end, then m is interpolated and run for the window only,
+     * continuing from the states, and routing state, where the previous window ended.
+     * The sources of the next window are read while the cells of the current window run.
+     * Thus the cell env_ts and the collected series of m are of the window size, and the memory used is bounded
+     * by the window, while the result, like m.catchment_discharges, covers the complete ta.
+     * After the run, m has the time-axis, the environment and the responses of the last window, and the end states.
+     *
+     * \param m the region-model, with the states set to the states at the start of ta
+     * \param ip the interpolation parameter
+     * \param ta the time-axis of the complete run
+     * \param env the sources, typically with unbound series, like apoint_ts("shyft://container/id")
+     * \param read the reader of the unbound series, ref. dtss_reader
+     * \param window_steps the number of steps of each window, the last can be shorter
+     * \param best_effort passed to run_interpolation
+     * \return the discharge of each catchment, in the order of m.catchment_discharges
+     */
+    template <class M>
+    ats_vector windowed_run(M& m, const interpolation_parameter& ip, const time_axis::fixed_dt& ta, const a_region_environment& env,
+                            const ts_reader_t& read, size_t window_steps, bool best_effort = true) {
+        if (window_steps == 0)
+            throw std::runtime_error("windowed_run: window_steps must be > 0");
+        if (ta.size() == 0)
+            throw std::runtime_error("windowed_run: the time-axis is empty");
+        const size_t n_windows = (ta.size() + window_steps - 1)/window_steps;
+        auto window_ta = [&ta, window_steps](size_t w) {
+            const size_t i0 = w*window_steps;
+            return time_axis::fixed_dt(ta.time(i0), ta.delta(), std::min(window_steps, ta.size() - i0));
+        };
+        auto fetch = [&env, &read, &window_ta](size_t w) {
+            const auto p = window_ta(w).total_period();
+            return window_environment(env, utcperiod(p.start - window_ta(w).delta(), p.end + window_ta(w).delta()), read);
+        };
+        std::vector<std::vector<double>> q;
+        auto next = std::async(std::launch::async, fetch, size_t(0));
+        for (size_t w = 0; w < n_windows; ++w) {
+            auto env_w = next.get();
+            if (w + 1 < n_windows)
+                next = std::async(std::launch::async, fetch, w + 1);
+            const auto wta = window_ta(w);
+            m.run_interpolation(ip, wta, env_w, best_effort);
+            m.run_cells();
+            std::vector<result_ts_t> qw;
+            m.catchment_discharges(qw);
+            if (q.empty())
+                q.assign(qw.size(), std::vector<double>(ta.size(), shyft::nan));
+            const size_t i0 = w*window_steps;
+            for (size_t k = 0; k < qw.size(); ++k)
+                for (size_t i = 0; i < wta.size(); ++i)
+                    q[k][i0 + i] = qw[k].value(i);
+        }
+        ats_vector r;
+        r.reserve(q.size());
+        for (auto& v : q)
+            r.push_back(apoint_ts(time_axis::generic_dt(ta), std::move(v), time_series::POINT_AVERAGE_VALUE));
+        return r;
+    }
+  }
+}
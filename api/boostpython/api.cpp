@@ -31,6 +31,7 @@ namespace expose {
 	extern void dtss();
     extern void dtss_finalize();
     extern void api_cell_state_id();
+    extern void method_stack();
 
 
     static std::vector<char> byte_vector_from_file(std::string path) {
@@ -84,6 +85,7 @@ namespace expose {
 		glacier_melt();
 		routing();
         api_cell_state_id();
+        method_stack();
         using namespace boost::python;
         def("byte_vector_from_file", byte_vector_from_file, (arg("path")), "reads specified file and returns its contents as a ByteVector");
         def("byte_vector_to_file", byte_vector_to_file, (arg("path"), arg("byte_vector")), "write the supplied ByteVector to file as specified by path");
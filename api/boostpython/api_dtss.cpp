@@ -55,6 +55,14 @@ namespace shyft {
                 }
             }
             ~py_server() {
+                {
+                    scoped_gil_release gil;
+                    set_read_batching(std::chrono::microseconds(0));// stop the batch threads, that might wait for the gil
+                    set_cache_hot_set_recording(std::string{}, std::chrono::milliseconds(0));
+                    wait_warm_cache();// the warm up might call cb
+                    set_read_ahead(0);
+                    wait_read_ahead();// the read ahead might call cb
+                }
                 cb = boost::python::object();
                 fcb = boost::python::object();
 				scb = boost::python::object();
@@ -125,7 +133,10 @@ namespace shyft {
                 if (cb.ptr()!=Py_None) {
                     scoped_gil_aquire gil;
                     try {
-                        r = boost::python::call<ts_vector_t>(cb.ptr(), ts_ids, p);
+                        auto o = boost::python::call<boost::python::object>(cb.ptr(), ts_ids, p);
+                        if (PyObject_HasAttrString(o.ptr(), "result"))// a future, like concurrent.futures.Future
+                            o = o.attr("result")();
+                        r = boost::python::extract<ts_vector_t>(o);
                     } catch  (const boost::python::error_already_set&) {
                         handle_pyerror();
                     }
@@ -137,6 +148,27 @@ namespace shyft {
                 }
                 return r;
             }
+            void set_read_batching_us(int window_us, size_t n_threads) {
+                scoped_gil_release gil;// stopping the old batch threads might wait for a callback
+                set_read_batching(std::chrono::microseconds(window_us), n_threads);
+            }
+            int get_read_batch_window_us() const { return int(get_read_batch_window().count()); }
+            void set_cache_hot_set_recording_ms(const std::string& file, int interval_ms, size_t max_ids) {
+                scoped_gil_release gil;// stopping the old recorder waits for its last record
+                set_cache_hot_set_recording(file, std::chrono::milliseconds(interval_ms), max_ids);
+            }
+            size_t warm_cache_py(const std::string& file) {
+                scoped_gil_release gil;
+                return warm_cache(file);
+            }
+            size_t wait_warm_cache_py() {
+                scoped_gil_release gil;
+                return wait_warm_cache();
+            }
+            void flush_replication_py() {
+                scoped_gil_release gil;
+                flush_replication();
+            }
             void process_messages(int msec) {
                 scoped_gil_release gil;
                 if(!is_running()) start_async();
@@ -169,14 +201,74 @@ namespace shyft {
                 std::vector<int64_t> p_spec;for(auto p:percentile_spec) p_spec.push_back(p);
                 return impl.percentiles(tsv,p,ta,p_spec,use_ts_cached_read,update_ts_cache);
             }
+            ts_vector_t aggregates(const ts_vector_t & tsv, core::utcperiod p,const gta_t &ta,const std::vector<int>& aggregate_spec,const std::vector<double>& weights,const std::vector<double>& bins,bool use_ts_cached_read,bool update_ts_cache) {
+                scoped_gil_release gil;
+                std::vector<int64_t> a_spec;for(auto a:aggregate_spec) a_spec.push_back(a);
+                return impl.aggregates(tsv,p,ta,a_spec,weights,bins,use_ts_cached_read,update_ts_cache);
+            }
             ts_vector_t evaluate(const ts_vector_t& tsv, core::utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
                 scoped_gil_release gil;
                 return ts_vector_t(impl.evaluate(tsv,p,use_ts_cached_read,update_ts_cache));
             }
+            std::int64_t evaluate_async(const ts_vector_t& tsv, core::utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
+                scoped_gil_release gil;
+                auto f=impl.evaluate_async(tsv,p,use_ts_cached_read,update_ts_cache);
+                std::lock_guard<std::mutex> guard(async_mx);
+                auto id=++async_id;
+                async_results.emplace(id,std::move(f));
+                return id;
+            }
+            ts_vector_t evaluate_result(std::int64_t request_id) {
+                std::future<std::vector<apoint_ts>> f;
+                {
+                    std::lock_guard<std::mutex> guard(async_mx);
+                    auto it=async_results.find(request_id);
+                    if(it==async_results.end())
+                        throw std::runtime_error("no pending async request with id "+std::to_string(request_id));
+                    f=std::move(it->second);
+                    async_results.erase(it);
+                }
+                scoped_gil_release gil;
+                return ts_vector_t(f.get());
+            }
+            void evaluate_stream(const ts_vector_t& tsv, core::utcperiod p,size_t chunk_size,boost::python::object fx,bool use_ts_cached_read,bool update_ts_cache) {
+                scoped_gil_release gil;
+                impl.evaluate_stream(tsv,p,use_ts_cached_read,update_ts_cache,chunk_size,[&fx](size_t i0,ts_vector_t&& r) {
+                    scoped_gil_aquire agil;
+                    boost::python::call<void>(fx.ptr(), i0, r);// a python exception propagates as error_already_set
+                });
+            }
+            boost::python::tuple subscribe(const ts_vector_t& tsv, core::utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
+                ts_vector_t r;
+                std::uint64_t sid{0};
+                {
+                    scoped_gil_release gil;
+                    sid=impl.subscribe(tsv,p,use_ts_cached_read,update_ts_cache,r);
+                }
+                return boost::python::make_tuple(std::int64_t(sid),r);
+            }
+            boost::python::tuple read_subscription(std::int64_t sid,int max_wait_ms) {
+                ts_vector_t r;
+                std::vector<int> ix;
+                {
+                    scoped_gil_release gil;
+                    for(auto i:impl.read_subscription(std::uint64_t(sid),std::chrono::milliseconds(max_wait_ms),r))
+                        ix.push_back(int(i));
+                }
+                return boost::python::make_tuple(ix,r);
+            }
+            void unsubscribe(std::int64_t sid) {
+                scoped_gil_release gil;
+                impl.unsubscribe(std::uint64_t(sid));
+            }
             ts_info_vector_t find(const std::string& search_expression) {
                 scoped_gil_release gil;
                 return impl.find(search_expression);
             }
+            ts_info_vector_t get_ts_info(const vector<string>& ids) {
+                scoped_gil_release gil;
+                return impl.get_ts_info(ids);
+            }
             void store_ts(const ts_vector_t&tsv, bool overwrite_on_write, bool cache_on_write) {
                 scoped_gil_release gil;
                 impl.store_ts(tsv, overwrite_on_write, cache_on_write);
@@ -191,12 +283,33 @@ namespace shyft {
                 return impl.cache_flush();
             }
 
+            scheduler_stats get_scheduler_stats() {
+                scoped_gil_release gil;
+                return impl.get_scheduler_stats();
+            }
+            vector<string> get_metrics() {
+                scoped_gil_release gil;
+                return impl.get_metrics();
+            }
             cache_stats get_cache_stats() {
                 scoped_gil_release gil;
                 return impl.get_cache_stats();
             }
             bool get_compress_expressions() const {return impl.compress_expressions;}
             void set_compress_expressions(bool v) {impl.compress_expressions=v;}
+            bool get_dedup_expressions() const {return impl.dedup_expressions;}
+            void set_dedup_expressions(bool v) {impl.dedup_expressions=v;}
+            bool get_flat_replies() const {return impl.flat_replies;}
+            void set_flat_replies(bool v) {impl.flat_replies=v;}
+            bool get_compress_replies() const {return impl.compress_replies;}
+            void set_compress_replies(bool v) {impl.compress_replies=v;}
+            size_t get_validated_cache_size() const {return impl.get_validated_cache_size();}
+            void set_validated_cache_size(size_t n) {impl.set_validated_cache_size(n);}
+            void set_cluster(size_t replication) {impl.set_cluster(replication);}
+          private:
+            std::mutex async_mx;///< protects the async members
+            std::int64_t async_id{0};
+            std::map<std::int64_t,std::future<std::vector<apoint_ts>>> async_results;///< request_id -> result of evaluate_async
         };
     }
 }
@@ -314,6 +427,8 @@ namespace expose {
                 doc_intro("callback for binding unresolved time-series references to concrete time-series.")
                 doc_intro("Called *if* the incoming messages contains unbound time-series.")
                 doc_intro("The signature of the callback function should be TsVector cb(StringVector,utcperiod)")
+                doc_intro("The callback can also return a future of the TsVector, e.g. a concurrent.futures.Future, then its .result() is returned")
+                doc_see_also("set_read_batching")
                 doc_intro("\nExamples\n--------\n")
                 doc_intro(
                     "from shyft import api as sa\n\n"
@@ -376,6 +491,90 @@ namespace expose {
                 )
             )
 
+            .def("set_read_batching",&DtsServer::set_read_batching_us,(py::arg("self"),py::arg("window_us"),py::arg("threads")=1),
+                doc_intro("batch the cb reads of concurrent requests.")
+                doc_intro("The reads of the same period that arrives within window_us are joined into one cb call, with each ts-id once,")
+                doc_intro("made on one of the dedicated threads of the server, while the requests waits for their part of the result.")
+                doc_intro("So concurrent requests are not serialized through the GIL, one cb call each.")
+                doc_parameters()
+                doc_parameter("window_us","int","time in micro seconds a batch waits for more reads, from its first read, 0 means no batching, the default")
+                doc_parameter("threads","int","number of threads calling cb for the batches, use more than one if cb returns futures, default 1")
+                doc_see_also("cb,get_read_batch_window")
+            )
+            .def("set_read_ahead",&DtsServer::set_read_ahead,(py::arg("self"),py::arg("min_run")),
+                doc_intro("read the next window into the cache, in the background, for clients reading the same series window after window.")
+                doc_intro("When a client has evaluated the same series for adjacent periods min_run times in a row, like month after month,")
+                doc_intro("the next window of the same length is read into the cache, so the sequential scan is served from the cache.")
+                doc_intro("Only requests using the cache are tracked.")
+                doc_parameters()
+                doc_parameter("min_run","int","adjacent reads before reading ahead, 0 turns it off, the default")
+                doc_see_also("get_read_ahead,cache")
+            )
+            .def("get_read_ahead",&DtsServer::get_read_ahead,(py::arg("self")),
+                doc_intro("returns the adjacent reads before reading ahead, 0 if off")
+                doc_see_also("set_read_ahead")
+            )
+            .def("get_read_batch_window",&DtsServer::get_read_batch_window_us,(py::arg("self")),
+                doc_intro("returns the read batch window in micro seconds, 0 if batching is off")
+                doc_see_also("set_read_batching")
+            )
+            .def("set_cluster",&DtsServer::set_cluster,(py::arg("self"),py::arg("host_ports"),py::arg("self_index"),py::arg("replication")=2),
+                doc_intro("run the server as a node of a cluster, before it is started.")
+                doc_intro("The shyft:// time-series are partitioned on the nodes by a consistent hash of the ts-url,")
+                doc_intro("each stored on replication nodes. A store is forwarded to the primary node of each series,")
+                doc_intro("that replicates it asynchronously to the other nodes of the series.")
+                doc_intro("Reads of series on other nodes are read from one of their nodes, so any node can evaluate any expression.")
+                doc_intro("All nodes must have the same host_ports, replication and containers.")
+                doc_parameters()
+                doc_parameter("host_ports","StringVector","the 'host:port' of each node of the cluster")
+                doc_parameter("self_index","int","the index in host_ports of this server")
+                doc_parameter("replication","int","number of nodes that keeps each series, default 2")
+                doc_see_also("flush_replication,DtsClient.set_cluster")
+            )
+            .def("set_scheduling",&DtsServer::set_scheduling,(py::arg("self"),py::arg("workers"),py::arg("max_queued")=0),
+                doc_intro("limit the costly requests, evaluate, percentiles, aggregates and stores, running at the same time.")
+                doc_intro("The requests waiting are dispatched fair-share among the clients, by their estimated cost,")
+                doc_intro("series times hours of the period, or points stored, so a batch job does not starve interactive users.")
+                doc_parameters()
+                doc_parameter("workers","int","max costly requests running, 0 turns scheduling off, the default")
+                doc_parameter("max_queued","int","max requests waiting, more are rejected with an exception to the client, 0 means no limit")
+                doc_see_also("set_client_weight,scheduler_stats")
+            )
+            .def("set_client_weight",&DtsServer::set_client_weight,(py::arg("self"),py::arg("foreign_ip"),py::arg("weight")),
+                doc_intro("set the fair-share weight of the client connecting from foreign_ip, default 1.")
+                doc_intro("a client with weight 4 gets four times the share of a client with weight 1 when both are waiting.")
+                doc_see_also("set_scheduling")
+            )
+            .add_property("scheduler_stats",&DtsServer::get_scheduler_stats,
+                doc_intro("the request scheduler metrics, queue depth, running, admitted and rejected requests")
+            )
+            .add_property("metrics",&DtsServer::get_metrics,
+                doc_intro("the server metrics in the prometheus text format: latency histograms by message type,")
+                doc_intro("of the bind, evaluate and serialize phases, of the container reads and writes and the callbacks,")
+                doc_intro("bytes in and out, connections, and the cache, scheduler and replication counters")
+            )
+            .def("start_metrics_http",&DtsServer::start_metrics_http,(py::arg("self"),py::arg("port"),py::arg("ip")=std::string{}),
+                doc_intro("serve the metrics as text over http, GET /metrics, so prometheus can scrape the server")
+                doc_parameters()
+                doc_parameter("port","int","the listening port of the http endpoint")
+                doc_parameter("ip","str","the listening ip, empty means any, the default")
+                doc_returns("port","int","the listening port")
+                doc_see_also("metrics,stop_metrics_http")
+            )
+            .def("stop_metrics_http",&DtsServer::stop_metrics_http,(py::arg("self")),
+                doc_intro("stop the http endpoint of the metrics")
+                doc_see_also("start_metrics_http")
+            )
+            .def("flush_replication",&DtsServer::flush_replication_py,(py::arg("self")),
+                doc_intro("wait until the stores replicated so far are sent to the replicas")
+                doc_see_also("set_cluster")
+            )
+            .def("get_replication_pending",&DtsServer::get_replication_pending,(py::arg("self")),
+                doc_intro("returns the number of stores queued for replication, or in progress")
+            )
+            .def("get_replication_failures",&DtsServer::get_replication_failures,(py::arg("self")),
+                doc_intro("returns the number of replications that failed, so the replica missed the store")
+            )
             .def("fire_cb",&DtsServer::fire_cb,(py::arg("self"),py::arg("msg"),py::arg("rp")),"testing fire cb from c++")
             .def("process_messages",&DtsServer::process_messages,(py::arg("self"),py::arg("msec")),
                 doc_intro("wait and process messages for specified number of msec before returning")
@@ -387,18 +586,33 @@ namespace expose {
                     "dtss-threads perform the callback ")
                 doc_see_also("cb,start_async(),is_running,clear()")
             )
-            .def("set_container",&DtsServer::add_container,(py::arg("self"),py::arg("name"),py::arg("root_dir")),
+            .def("set_container",&DtsServer::add_container,(py::arg("self"),py::arg("name"),py::arg("root_dir"),py::arg("compress")=false,py::arg("wal")=false,py::arg("packed")=false,py::arg("normalize_time_axis")=false),
                  doc_intro("set ( or replaces) an internal shyft store container to the dtss-server.")
                  doc_intro("All ts-urls with shyft://<container>/ will resolve")
                  doc_intro("to this internal time-series storage for find/read/store operations")
                  doc_parameters()
                  doc_parameter("name","str","Name of the container as pr. url definition above")
                  doc_parameter("root_dir","str","A valid directory root for the container")
+                 doc_parameter("compress","bool","if True, values of fixed and calendar time-axis series are written xor-delta compressed, default False")
+                 doc_parameter("wal","bool","if True, stores are acknowledged when appended to a write-ahead log in the container, and written to the ts-files in the background, default False")
+                 doc_parameter("packed","bool","if True, the series are appended to a few large pack files in the container, with an in-memory index, for containers of many small series, compress and wal can not be used with it, default False")
+                 doc_parameter("normalize_time_axis","bool","if True, stored series with a point time-axis that is regularly spaced, or calendar months, quarters or years, are saved with a fixed or calendar time-axis, with the same values, unless merged into a stored point series, can not be used with packed, default False")
                  doc_notes()
-                 doc_note("currently this call should only be used when the server is not processing messages\n"
-                          "- before starting, or after stopping listening operations\n"
-                          )
-
+                 doc_note("containers can be set while the server is processing messages,\n"
+                          "requests in progress completes with the container they started with")
+                 doc_see_also("remove_container,get_container_names")
+            )
+            .def("remove_container",&DtsServer::remove_container,(py::arg("self"),py::arg("name")),
+                 doc_intro("remove an internal shyft store container from the dtss-server, the files are kept.")
+                 doc_intro("can be called while the server is processing messages.")
+                 doc_parameters()
+                 doc_parameter("name","str","Name of the container")
+                 doc_returns("removed","bool","True if the container was there")
+                 doc_see_also("set_container")
+            )
+            .def("get_container_names",&DtsServer::get_container_names,(py::arg("self")),
+                 doc_intro("returns the names of the internal shyft store containers, sorted")
+                 doc_see_also("set_container")
             )
             .def("set_auto_cache",&DtsServer::set_auto_cache,(py::arg("self"),py::arg("active")),
                 doc_intro("set auto caching all reads active or passive.")
@@ -407,6 +621,35 @@ namespace expose {
                 doc_parameters()
                 doc_parameter("active","bool","if set True, all reads will be put into cache")
             )
+            .def("set_max_eval_threads",&DtsServer::set_max_eval_threads,(py::arg("self"),py::arg("n")),
+                doc_intro("limit the number of threads one evaluate request can use.")
+                doc_intro("The expressions of a request are evaluated in parallel on a shared pool,")
+                doc_intro("the limit leaves threads for the other connections.")
+                doc_parameters()
+                doc_parameter("n","int","max threads for each request, 0 means half of the available threads")
+            )
+            .def("get_max_eval_threads",&DtsServer::get_max_eval_threads,(py::arg("self")),
+                doc_intro("returns the max number of threads one evaluate request can use")
+            )
+            .def("set_autotune_eval_threads",&DtsServer::set_autotune_eval_threads,(py::arg("self"),py::arg("on")),
+                doc_intro("turn on/off tuning of the threads one evaluate request can use, for the number of expressions, on this machine.")
+                doc_intro("The first requests of each size each measure one thread count, then the fastest is used,")
+                doc_intro("ref. autotune_set_file to keep the choice. When on, it takes precedence over set_max_eval_threads.")
+                doc_parameters()
+                doc_parameter("on","bool","default off")
+            )
+            .def("get_autotune_eval_threads",&DtsServer::get_autotune_eval_threads,(py::arg("self")),
+                doc_intro("returns True if the threads of the evaluate requests are tuned")
+            )
+            .def("set_max_io_threads",&DtsServer::set_max_io_threads,(py::arg("self"),py::arg("n")),
+                doc_intro("set the number of threads one read request use to read the shyft:// containers.")
+                doc_intro("The reads are i/o bound, and runs on a separate pool shared by the connections.")
+                doc_parameters()
+                doc_parameter("n","int","max threads for each read request, default 8, 1 reads sequentially")
+            )
+            .def("get_max_io_threads",&DtsServer::get_max_io_threads,(py::arg("self")),
+                doc_intro("returns the max number of threads one read request use to read the shyft:// containers")
+            )
             .def("cache",&DtsServer::add_to_cache,(py::arg("self"),py::arg("ts_ids"),py::arg("ts_vector")),
                 doc_intro("add/update specified ts_ids with corresponding ts to cache")
                 doc_intro("please notice that there is no validation of the tds_ids, they")
@@ -439,6 +682,82 @@ namespace expose {
                 doc_intro("algorithm. Notice that assigning a lower value than the existing value will also flush out")
                 doc_intro("time-series from cache in the least recently used order.")
             )
+            .add_property("cache_max_bytes",&DtsServer::get_cache_byte_size,&DtsServer::set_cache_byte_size,
+                doc_intro("cache_max_bytes is an approximate memory budget for the cache, 0 means no budget(default).")
+                doc_intro("The size of each cached time-series is estimated from its values and time-points, and")
+                doc_intro("when the budget is exceeded, time-series are elided in the least recently used order.")
+                doc_intro("The cache_max_items limit still applies, set it high to limit the cache by bytes only.")
+            )
+            .add_property("result_cache_max_items",&DtsServer::get_result_cache_size,&DtsServer::set_result_cache_size,
+                doc_intro("the maximum number of evaluated expressions kept by the result cache, 0 turns it off(default).")
+                doc_intro("Evaluate requests with use_ts_cached_read, and not update_ts_cache, get the result of an identical")
+                doc_intro("expression and period evaluated before, until one of the series it references is stored.")
+                doc_intro("Only expressions referencing shyft:// series alone are cached.")
+            )
+            .add_property("cache_policy",&DtsServer::get_cache_policy,&DtsServer::set_cache_policy,
+                doc_intro("the eviction policy of the cache, CachePolicy.LRU(default) or the scan resistant CachePolicy.TWO_Q.")
+                doc_intro("With TWO_Q, time-series read once, like a large ad-hoc read of historic series, goes to a probation")
+                doc_intro("segment, and are evicted before the time-series that are read repeatedly.")
+                doc_intro("Changing the policy keeps the cached items.")
+            )
+            .def("cache_policy_stats",&DtsServer::get_cache_policy_stats,(py::arg("self"),py::arg("policy")),
+                doc_intro("return hits, misses and coverage_misses accumulated while policy was active,")
+                doc_intro("so that the hit-ratio of the policies can be compared, the other fields are 0")
+                doc_parameters()
+                doc_parameter("policy","CachePolicy","the policy to get the stats for")
+                doc_returns("cache_stats","CacheStats","the accumulated stats of the policy, cleared by clear_cache_stats")
+            )
+            .def("save_cache_hot_set",&DtsServer::save_cache_hot_set,(py::arg("self"),py::arg("file"),py::arg("max_ids")=0),
+                doc_intro("write the hot set of the cache, the ts-ids and periods cached, most recently used first, to file.")
+                doc_intro("The file is text, a line '<start> <end> <ts-id>' for each cached fragment, periods in seconds since epoch.")
+                doc_parameters()
+                doc_parameter("file","str","the file to write, replaced as a whole")
+                doc_parameter("max_ids","int","max ts-ids written, the most recently used, 0 means all, the default")
+                doc_see_also("set_cache_hot_set_recording,warm_cache")
+            )
+            .def("set_cache_hot_set_recording",&DtsServer::set_cache_hot_set_recording_ms,(py::arg("self"),py::arg("file"),py::arg("interval_ms"),py::arg("max_ids")=0),
+                doc_intro("record the hot set of the cache to file every interval_ms, and when stopped, or the server is destroyed,")
+                doc_intro("so a restarted server can warm its cache with warm_cache(file).")
+                doc_parameters()
+                doc_parameter("file","str","the file to record to, ref. save_cache_hot_set")
+                doc_parameter("interval_ms","int","milliseconds between the records, 0 stops recording")
+                doc_parameter("max_ids","int","max ts-ids recorded, the most recently used, 0 means all, the default")
+                doc_see_also("save_cache_hot_set,start_warm_cache")
+            )
+            .def("warm_cache",&DtsServer::warm_cache_py,(py::arg("self"),py::arg("file")),
+                doc_intro("read the time-series of a hot set file into the cache, the least recently used first,")
+                doc_intro("with the parallel reads of the server. Series that fails to read are skipped, as is a missing file.")
+                doc_parameters()
+                doc_parameter("file","str","the hot set file, ref. save_cache_hot_set")
+                doc_returns("n","int","number of ts-id and period entries read into the cache")
+                doc_see_also("start_warm_cache,set_cache_hot_set_recording")
+            )
+            .def("start_warm_cache",&DtsServer::start_warm_cache,(py::arg("self"),py::arg("file")),
+                doc_intro("start warm_cache(file) in the background, so the server can accept connections meanwhile")
+                doc_see_also("wait_warm_cache,warm_cache")
+            )
+            .def("wait_warm_cache",&DtsServer::wait_warm_cache_py,(py::arg("self")),
+                doc_intro("wait for the warm up started by start_warm_cache")
+                doc_returns("n","int","the result of warm_cache, 0 if no warm up was started")
+                doc_see_also("start_warm_cache")
+            )
+            .def("set_cache_snapshot",&DtsServer::set_cache_snapshot,(py::arg("self"),py::arg("file")),
+                doc_intro("load the cache snapshot file, if there is one, and save the cache to it when the server is destroyed,")
+                doc_intro("so a restarted server has the cache it had, without reading the time-series again.")
+                doc_parameters()
+                doc_parameter("file","str","the binary snapshot file, empty turns saving off")
+                doc_returns("n","int","number of ts-ids loaded into the cache")
+                doc_see_also("save_cache_snapshot,load_cache_snapshot")
+            )
+            .def("save_cache_snapshot",&DtsServer::save_cache_snapshot,(py::arg("self"),py::arg("file")),
+                doc_intro("write the time-series fragments of the cache, and the least recently used order, to a binary snapshot file")
+                doc_see_also("set_cache_snapshot,load_cache_snapshot")
+            )
+            .def("load_cache_snapshot",&DtsServer::load_cache_snapshot,(py::arg("self"),py::arg("file")),
+                doc_intro("add the time-series fragments of a snapshot file to the cache, in the order of the snapshot")
+                doc_returns("n","int","number of ts-ids loaded, 0 if there is no file")
+                doc_see_also("set_cache_snapshot,save_cache_snapshot")
+            )
             ;
 
     }
@@ -458,7 +777,7 @@ namespace expose {
 				doc_intro("a connection is immediately done to the server at specified port.")
 				doc_intro("If no such connection can be made, it raises a RuntimeError.")
 				doc_parameter("host_port", "string", "a string of the format 'host:portnumber', e.g. 'localhost:20000'")
-                doc_parameter("auto_connect","bool","default True, connection pr. call. if false, connection last lifetime of object unless explicitely closed/reopened")
+                doc_parameter("auto_connect","bool","default True, connections are made as needed, and kept in a pool for reuse by the next calls. if false, connection last lifetime of object unless explicitely closed/reopened")
                 doc_parameter("timeout_ms","int","defalt 1000ms, used for timeout connect/reconnect/close operations" )
 				)
 			)
@@ -469,7 +788,7 @@ namespace expose {
                 doc_intro("If several servers are passed, the .evaluate and .percentile function will partition the ts-vector between the")
                 doc_intro("provided servers and scale out the computation")
 				doc_parameter("host_ports", "StringVector", "a a list of string of the format 'host:portnumber', e.g. 'localhost:20000'")
-                doc_parameter("auto_connect","bool","default True, connection pr. call. if false, connection last lifetime of object unless explicitely closed/reopened")
+                doc_parameter("auto_connect","bool","default True, connections are made as needed, and kept in a pool for reuse by the next calls. if false, connection last lifetime of object unless explicitely closed/reopened")
                 doc_parameter("timeout_ms","int","defalt 1000ms, used for timeout connect/reconnect/close operations" )
 				)
 			)
@@ -495,6 +814,22 @@ namespace expose {
                 doc_returns("tsvector","TsVector","an evaluated list of percentile time-series in the same order as the percentile input list")
                 doc_see_also(".evaluate(), DtsServer")
             )
+            .def("aggregates",&DtsClient::aggregates, (py::arg("self"),py::arg("ts_vector"), py::arg("utcperiod"), py::arg("time_axis"), py::arg("aggregate_list"),py::arg("weights"),py::arg("bins"),py::arg("use_ts_cached_read")=true,py::arg("update_ts_cache")=false),
+                doc_intro("Evaluates aggregates across the ts_vector, for each step of the time_axis, at the server,")
+                doc_intro("close to the data, so that only the aggregated time-series are sent back.")
+                doc_intro("Each time-series is averaged over the steps of the time_axis, and nan values are ignored.")
+                doc_parameters()
+                doc_parameter("ts_vector","TsVector","a list of time-series (expressions), including unresolved symbolic references")
+                doc_parameter("utcperiod","UtcPeriod","the period that the binding service should read from the backing ts-store/ts-service")
+                doc_parameter("time_axis","TimeAxis","the time_axis for the aggregates, e.g. a daily time_axis")
+                doc_parameter("aggregate_list","IntVector","a list of aggregate_property, like aggregate_property.SUM, .MEAN, .WEIGHTED_MEAN or .HISTOGRAM")
+                doc_parameter("weights","DoubleVector","one weight for each time-series, e.g. the area, used by WEIGHTED_SUM and WEIGHTED_MEAN, otherwise empty")
+                doc_parameter("bins","DoubleVector","the ascending bin edges used by HISTOGRAM, otherwise empty")
+                doc_parameter("use_ts_cached_read","bool","allow use of server-side cached results, use it for immutable data-reads!")
+                doc_parameter("update_ts_cache","bool","when reading time-series, also update the cache with the data, use it for immutable data-reads!")
+                doc_returns("tsvector","TsVector","one time-series for each aggregate, in order, but HISTOGRAM gives one count for each bin")
+                doc_see_also(".percentiles(),aggregate_property")
+            )
             .def("evaluate", &DtsClient::evaluate, (py::arg("self"),py::arg("ts_vector"), py::arg("utcperiod"),py::arg("use_ts_cached_read")=true,py::arg("update_ts_cache")=false ),
                 doc_intro("Evaluates the expressions in the ts_vector for the specified utcperiod.")
                 doc_intro("If the expression includes unbound symbolic references to time-series,")
@@ -508,6 +843,68 @@ namespace expose {
                 doc_returns("tsvector","TsVector","an evaluated list of point time-series in the same order as the input list")
                 doc_see_also(".percentiles(),DtsServer")
             )
+            .def("evaluate_async", &DtsClient::evaluate_async, (py::arg("self"),py::arg("ts_vector"), py::arg("utcperiod"),py::arg("use_ts_cached_read")=true,py::arg("update_ts_cache")=false ),
+                doc_intro("Sends the evaluate request, without waiting for the result.")
+                doc_intro("The requests in flight are pipelined on one connection pr. server,")
+                doc_intro("and handled concurrently by the server, so many independent evaluations")
+                doc_intro("costs one round-trip, rather than one each.")
+                doc_parameters()
+                doc_parameter("ts_vector","TsVector","a list of time-series (expressions), including unresolved symbolic references")
+                doc_parameter("utcperiod","UtcPeriod","the period that the binding service should read from the backing ts-store/ts-service")
+                doc_parameter("use_ts_cached_read","bool","allow use of server-side cached results, use it for immutable data-reads!")
+                doc_parameter("update_ts_cache","bool","when reading time-series, also update the cache with the data, use it for immutable data-reads!")
+                doc_returns("request_id","int","pass to .evaluate_result() to get the result")
+                doc_see_also(".evaluate_result(),.evaluate()")
+            )
+            .def("evaluate_result", &DtsClient::evaluate_result, (py::arg("self"),py::arg("request_id")),
+                doc_intro("Waits for, and returns the result of an .evaluate_async() request, in any order.")
+                doc_intro("Raises the exception of the request, if it failed.")
+                doc_parameters()
+                doc_parameter("request_id","int","the request id returned by .evaluate_async()")
+                doc_returns("tsvector","TsVector","an evaluated list of point time-series in the same order as the input list")
+                doc_see_also(".evaluate_async()")
+            )
+            .def("evaluate_stream", &DtsClient::evaluate_stream, (py::arg("self"),py::arg("ts_vector"), py::arg("utcperiod"),py::arg("chunk_size"),py::arg("callback"),py::arg("use_ts_cached_read")=true,py::arg("update_ts_cache")=false ),
+                doc_intro("Evaluates the expressions as .evaluate(), receiving the result in chunks, as the server evaluates them.")
+                doc_intro("The server reads and evaluates one chunk at the time, and waits while the callback is behind,")
+                doc_intro("so a large evaluation, e.g. an export of many series, is not held in memory at once.")
+                doc_parameters()
+                doc_parameter("ts_vector","TsVector","a list of time-series (expressions), including unresolved symbolic references")
+                doc_parameter("utcperiod","UtcPeriod","the period that the binding service should read from the backing ts-store/ts-service")
+                doc_parameter("chunk_size","int","number of series in each chunk")
+                doc_parameter("callback","Callable[[int,TsVector],None]","called with (i0,chunk) for each chunk in order, chunk holding the results of ts_vector[i0:i0+len(chunk)]")
+                doc_parameter("use_ts_cached_read","bool","allow use of server-side cached results, use it for immutable data-reads!")
+                doc_parameter("update_ts_cache","bool","when reading time-series, also update the cache with the data, use it for immutable data-reads!")
+                doc_see_also(".evaluate()")
+            )
+            .def("subscribe", &DtsClient::subscribe, (py::arg("self"),py::arg("ts_vector"), py::arg("utcperiod"),py::arg("use_ts_cached_read")=true,py::arg("update_ts_cache")=false ),
+                doc_intro("Subscribe to the evaluated expressions, to get the changes with .read_subscription() instead of polling with .evaluate().")
+                doc_intro("The server evaluates the expressions, and keeps them with the time-series they reference,")
+                doc_intro("so that stores to those time-series marks the expressions referencing them as changed.")
+                doc_intro("The subscription is kept until .unsubscribe(), or the connection is closed.")
+                doc_parameters()
+                doc_parameter("ts_vector","TsVector","a list of time-series (expressions), including unresolved symbolic references")
+                doc_parameter("utcperiod","UtcPeriod","the period that the binding service should read from the backing ts-store/ts-service")
+                doc_parameter("use_ts_cached_read","bool","allow use of server-side cached results for the first evaluation")
+                doc_parameter("update_ts_cache","bool","when reading time-series, also update the cache with the data")
+                doc_returns("(sid,tsv)","Tuple[int,TsVector]","the subscription id, and the evaluated ts_vector, as .evaluate()")
+                doc_see_also(".read_subscription(),.unsubscribe()")
+            )
+            .def("read_subscription", &DtsClient::read_subscription, (py::arg("self"),py::arg("sid"),py::arg("max_wait_ms")),
+                doc_intro("Wait for expressions of the subscription to change, the server replies when any of them changes,")
+                doc_intro("with the changed expressions only, evaluated again.")
+                doc_parameters()
+                doc_parameter("sid","int","the subscription id, from .subscribe()")
+                doc_parameter("max_wait_ms","int","max time in milliseconds to wait for changes")
+                doc_returns("(ix,tsv)","Tuple[IntVector,TsVector]","the index in the subscribed ts_vector of each changed expression, and their new results, empty if none changed")
+                doc_see_also(".subscribe(),.unsubscribe()")
+            )
+            .def("unsubscribe", &DtsClient::unsubscribe, (py::arg("self"),py::arg("sid")),
+                doc_intro("Remove the subscription at the server")
+                doc_parameters()
+                doc_parameter("sid","int","the subscription id, from .subscribe()")
+                doc_see_also(".subscribe()")
+            )
             .def("find",&DtsClient::find,(py::arg("self"),py::arg("search_expression")),
                 doc_intro("find ts information that matches the search-expression")
                 doc_parameters()
@@ -515,6 +912,15 @@ namespace expose {
                 doc_returns("ts_info_vector","TsInfoVector","The search result, as vector of TsInfo objects")
                 doc_see_also("TsInfo,TsInfoVector")
             )
+            .def("get_ts_info",&DtsClient::get_ts_info,(py::arg("self"),py::arg("ts_ids")),
+                doc_intro("get the ts information of each of ts_ids, in one request, without a search")
+                doc_intro("The shyft:// series are served from the container catalogue, the others from the server cache,")
+                doc_intro("where data_period is the period cached.")
+                doc_parameters()
+                doc_parameter("ts_ids","StringVector","a list of time-series ids")
+                doc_returns("ts_info_vector","TsInfoVector","the TsInfo of each id, in order, an unknown id has only the name, and an invalid data_period")
+                doc_see_also("find,TsInfo,TsInfoVector")
+            )
             .def("store_ts", &DtsClient::store_ts,
                 (   py::arg("self"),
                     py::arg("tsv"),
@@ -564,17 +970,60 @@ namespace expose {
             .add_property("cache_stats",&DtsClient::get_cache_stats,
                  doc_intro("get the cache_stats (including statistics) on the server.")
             )
+            .add_property("scheduler_stats",&DtsClient::get_scheduler_stats,
+                 doc_intro("get the request scheduler metrics of the server, summed if several.")
+            )
+            .def("get_metrics",&DtsClient::get_metrics,(py::arg("self")),
+                 doc_intro("get the metrics of each server, latency histograms, bytes, connections and cache counters,")
+                 doc_intro("in the prometheus text format")
+                 doc_returns("metrics","StringVector","the metrics text of each server, in the order of the host_ports")
+            )
             .add_property("compress_expressions",&DtsClient::get_compress_expressions,&DtsClient::set_compress_expressions,
                 doc_intro("if True, the expressions are compressed before sending to the server.")
                 doc_intro("for expressions of any size, like 100 elements, with expression")
                 doc_intro("depth 100 (e.g. nested sums), this can speed up")
                 doc_intro("the transmission by a factor or 3.")
             )
+            .add_property("dedup_expressions",&DtsClient::get_dedup_expressions,&DtsClient::set_dedup_expressions,
+                doc_intro("if True, and compress_expressions, structurally equal nodes of the expressions are sent once,")
+                doc_intro("like the same average(TimeSeries('shyft://x'),ta) built separately for many series,")
+                doc_intro("so the message size, and the server decompress time, scales with the unique nodes.")
+                doc_intro("it costs some client time to find the equal nodes, so it pays off for heavily shared expressions.")
+            )
+            .add_property("flat_replies",&DtsClient::get_flat_replies,&DtsClient::set_flat_replies,
+                doc_intro("if True, evaluate results are sent with a flat wire encoding, without boost archives,")
+                doc_intro("from the servers that supports it, speeding up large replies.")
+                doc_intro("older servers are detected, and replies the usual way.")
+            )
+            .def("set_cluster",&DtsClient::set_cluster,(py::arg("self"),py::arg("replication")),
+                doc_intro("route the requests to the host_ports as the nodes of a cluster, ref. DtsServer.set_cluster")
+                doc_intro("stores are sent to the primary node of each series, and evaluations are partitioned")
+                doc_intro("so each expression goes to a node that has the series it reads, balancing the cost on the replicas.")
+                doc_parameters()
+                doc_parameter("replication","int","the replication of the cluster, 0 routes to independent servers as before")
+            )
+            .add_property("compress_replies",&DtsClient::get_compress_replies,&DtsClient::set_compress_replies,
+                doc_intro("if True, the servers compresses the values of large series in flat replies.")
+                doc_intro("useful when the client and server talk over a slow link, e.g. a WAN,")
+                doc_intro("otherwise the cpu-time of the compression outweighs the bandwidth saved.")
+            )
+            .add_property("validated_cache_size",&DtsClient::get_validated_cache_size,&DtsClient::set_validated_cache_size,
+                doc_intro("max evaluated results kept by the client, by expression and period, 0, the default, turns it off.")
+                doc_intro("with one server, the next evaluate of a kept result sends the version it got from the server,")
+                doc_intro("and the server replies the result only if the shyft:// series it reads changed since.")
+            )
             ;
 
     }
     void dtss_cache_stats() {
         using CacheStats = shyft::dtss::cache_stats;
+        enum_<shyft::dtss::cache_policy>("CachePolicy",
+            doc_intro("The eviction policy of the DtsServer cache")
+            )
+            .value("LRU", shyft::dtss::cache_policy::lru)
+            .value("TWO_Q", shyft::dtss::cache_policy::two_q)
+            .export_values()
+            ;
         class_<CacheStats>("CacheStats",
             doc_intro("Cache statistics for the DtsServer."),
 			init<>(py::arg("self"))
@@ -598,6 +1047,30 @@ namespace expose {
             .def_readwrite("fragment_count", &CacheStats::fragment_count,
                 doc_intro("number of time-series fragments in the cache, (greater or equal to id_count)")
             )
+            .def_readwrite("byte_count", &CacheStats::byte_count,
+                doc_intro("approx. bytes of the time-series fragments in the cache, ids and bookkeeping included")
+            )
+            .def_readwrite("result_count", &CacheStats::result_count,
+                doc_intro("number of evaluated expressions in the result cache, ref. DtsServer.result_cache_max_items")
+            )
+            .def_readwrite("result_byte_count", &CacheStats::result_byte_count,
+                doc_intro("approx. bytes of the result cache")
+            )
+            ;
+        using SchedulerStats = shyft::dtss::scheduler_stats;
+        class_<SchedulerStats>("SchedulerStats",
+            doc_intro("Request scheduler statistics for the DtsServer, ref. DtsServer.set_scheduling."),
+            init<>(py::arg("self"))
+            )
+            .def_readwrite("workers", &SchedulerStats::workers, doc_intro("max requests running, 0 if scheduling is off"))
+            .def_readwrite("running", &SchedulerStats::running, doc_intro("number of requests running"))
+            .def_readwrite("queued", &SchedulerStats::queued, doc_intro("number of requests waiting"))
+            .def_readwrite("max_queued", &SchedulerStats::max_queued, doc_intro("max requests waiting, more are rejected, 0 means no limit"))
+            .def_readwrite("admitted", &SchedulerStats::admitted, doc_intro("accumulated number of requests admitted"))
+            .def_readwrite("rejected", &SchedulerStats::rejected, doc_intro("accumulated number of requests rejected since the queue was full"))
+            .def_readwrite("clients", &SchedulerStats::clients, doc_intro("number of clients with requests running or waiting"))
+            .def_readwrite("queued_cost", &SchedulerStats::queued_cost, doc_intro("estimated cost of the requests waiting"))
+            .def_readwrite("wait_ms", &SchedulerStats::wait_ms, doc_intro("accumulated milliseconds the admitted requests waited"))
             ;
 
     }
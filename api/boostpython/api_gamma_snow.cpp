@@ -31,6 +31,7 @@ namespace expose {
             .def_readwrite("calculate_iso_pot_energy", &parameter::calculate_iso_pot_energy,"Whether or not to calculate the potential energy flux,default=false")
             .def_readwrite("snow_cv_forest_factor", &parameter::snow_cv_forest_factor,"default=0.0, [ratio]\n\tthe effective snow_cv gets an additional value of geo.forest_fraction()*snow_cv_forest_factor")
             .def_readwrite("snow_cv_altitude_factor", &parameter::snow_cv_altitude_factor,"default=0.0, [1/m]\n\t the effective snow_cv gets an additional value of altitude[m]* snow_cv_altitude_factor")
+            .def_readwrite("fast_math", &parameter::fast_math,"default=false\n\t use a fast approximation of the incomplete gamma function, absolute error < 1e-8, instead of the boost implementation")
             .def("effective_snow_cv",&parameter::effective_snow_cv,(py::arg("self"),py::arg("forest_fraction"),py::arg("altitude")),"returns the effective snow cv, taking the forest_fraction and altitude into the equations using corresponding factors")
             .def("is_snow_season",&parameter::is_snow_season,(py::arg("self"),py::args("t")),"returns true if specified t is within the snow season, e.g. sept.. winder_end_day_of_year")
             .def("is_start_melt_season",&parameter::is_start_melt_season,(py::arg("self"),py::arg("t")),"true if specified interval t day of year is wind_end_day_of_year")
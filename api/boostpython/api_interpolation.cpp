@@ -3,6 +3,7 @@
 #include "core/inverse_distance.h"
 #include "core/bayesian_kriging.h"
 #include "core/kriging.h"
+#include "core/grid_remap.h"
 #include "core/region_model.h"
 
 namespace expose {
@@ -159,6 +160,21 @@ namespace expose {
             .def_readwrite("z_scale", &ok_parameter::z_scale,"z_scale to be used for range|distance calculations")
             ;
 
+        typedef shyft::core::kriging::ordinary::local_parameter OKLocalParameter;
+        class_<OKLocalParameter>("OKLocalParameter",
+            "Local Ordinary Kriging Parameter, for kriging with a small system of the nearest sources for each destination,\n"
+            "using an exponential covariance with nugget. Values are reduced to z=0 using z_gradient before kriging.\n"
+            )
+            .def(init<double,double,double,double,size_t,double,optional<double>>(args("sill","nug","range","zscale","max_members","max_distance","z_gradient")))
+            .def_readwrite("sill",&OKLocalParameter::sill,"value of the semi-variogram at range, default=25.0")
+            .def_readwrite("nug",&OKLocalParameter::nug,"nugget, must be less than sill, default=0.5")
+            .def_readwrite("range",&OKLocalParameter::range,"[m] practical range of the covariance, default=200000.0")
+            .def_readwrite("zscale",&OKLocalParameter::zscale,"height scale used in distance computations, default=20.0")
+            .def_readwrite("max_members",&OKLocalParameter::max_members,"max number of sources in each local system, default=16")
+            .def_readwrite("max_distance",&OKLocalParameter::max_distance,"[m] only sources within this zscaled distance are used, default=200000.0")
+            .def_readwrite("z_gradient",&OKLocalParameter::z_gradient,"[unit/m] gradient used to detrend values by elevation, default=-0.006")
+            ;
+
         def("ordinary_kriging",ordinary_kriging,
             "Runs ordinary kriging for geo sources and project the source out to the destination geo-timeseries\n"
             "\n\n\tNotice that kriging is currently not very efficient for large grid inputs,\n"
@@ -432,6 +448,35 @@ namespace expose {
 
     }
 
+    static void grid_remap_interpolation() {
+        namespace gr = shyft::core::grid_remap;
+        enum_<gr::remap_method>("GridRemapMethod")
+            .value("NONE", gr::remap_method::none)
+            .value("BILINEAR", gr::remap_method::bilinear)
+            .value("CONSERVATIVE", gr::remap_method::conservative)
+            .export_values()
+            ;
+        class_<gr::regular_grid>("RegularGrid",
+            "The layout of sources on a regular grid, like NWP output, with nodes at (x0 + ix*dx, y0 + iy*dy)\n"
+            "The sources can be in any order, each source is matched to its node by location\n"
+            )
+            .def(init<double,double,double,double,size_t,size_t>(args("x0","y0","dx","dy","nx","ny")))
+            .def_readwrite("x0",&gr::regular_grid::x0,"[m] x of the first node")
+            .def_readwrite("y0",&gr::regular_grid::y0,"[m] y of the first node")
+            .def_readwrite("dx",&gr::regular_grid::dx,"[m] node spacing along x")
+            .def_readwrite("dy",&gr::regular_grid::dy,"[m] node spacing along y")
+            .def_readwrite("nx",&gr::regular_grid::nx,"number of nodes along x")
+            .def_readwrite("ny",&gr::regular_grid::ny,"number of nodes along y")
+            ;
+        class_<gr::parameter>("GridRemapParameter",
+            "Selects remapping of regular grid sources to the cells, by bilinear or conservative weights, instead of neighbour search\n"
+            )
+            .def(init<gr::remap_method,const gr::regular_grid&>(args("method","grid")))
+            .def_readwrite("method",&gr::parameter::method,"NONE, BILINEAR or CONSERVATIVE, default NONE")
+            .def_readwrite("grid",&gr::parameter::grid,"the grid layout of the sources")
+            ;
+    }
+
 	static void interpolation_parameter() {
         typedef shyft::core::interpolation_parameter InterpolationParameter;
         namespace idw = shyft::core::inverse_distance;
@@ -446,16 +491,24 @@ namespace expose {
             .def_readwrite("use_idw_for_temperature",&InterpolationParameter::use_idw_for_temperature,"if true, the IDW temperature is used instead of BTK, useful for grid-input scenarios")
             .def_readwrite("temperature",&InterpolationParameter::temperature,"BTK for temperature (in case .use_idw_for_temperature is false)")
             .def_readwrite("temperature_idw",&InterpolationParameter::temperature_idw,"IDW for temperature(in case .use_idw_for_temperature is true)")
+            .def_readwrite("use_kriging_for_temperature",&InterpolationParameter::use_kriging_for_temperature,"if true, local ordinary kriging is used for temperature, overriding .use_idw_for_temperature")
+            .def_readwrite("temperature_kriging",&InterpolationParameter::temperature_kriging,"local ordinary kriging for temperature(in case .use_kriging_for_temperature is true)")
             .def_readwrite("precipitation",&InterpolationParameter::precipitation,"IDW parameters for precipitation")
             .def_readwrite("wind_speed", &InterpolationParameter::wind_speed,"IDW parameters for wind_speed")
             .def_readwrite("radiation", &InterpolationParameter::radiation,"IDW parameters for radiation")
             .def_readwrite("rel_hum",&InterpolationParameter::rel_hum,"IDW parameters for relative humidity")
+            .def_readwrite("temperature_grid",&InterpolationParameter::temperature_grid,"if enabled, grid remap for temperature, using .temperature_idw for the height adjustment")
+            .def_readwrite("precipitation_grid",&InterpolationParameter::precipitation_grid,"if enabled, grid remap for precipitation")
+            .def_readwrite("wind_speed_grid",&InterpolationParameter::wind_speed_grid,"if enabled, grid remap for wind_speed")
+            .def_readwrite("radiation_grid",&InterpolationParameter::radiation_grid,"if enabled, grid remap for radiation")
+            .def_readwrite("rel_hum_grid",&InterpolationParameter::rel_hum_grid,"if enabled, grid remap for relative humidity")
             ;
     }
 
 	void interpolation() {
         idw_interpolation();
         btk_interpolation();
+        grid_remap_interpolation();
         interpolation_parameter();
         ok_kriging();
     }
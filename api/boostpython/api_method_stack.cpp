@@ -0,0 +1,115 @@
+#include "boostpython_pch.h"
+
+#include "core/method_stack.h"
+#include "core/timeline_trace.h"
+#include "core/memory_usage.h"
+#include "core/autotune.h"
+
+namespace expose {
+    using namespace shyft::core::method_stack::profiling;
+    namespace py=boost::python;
+    using namespace std;
+
+    static size_t routine_ix(const string& name) {
+        for (size_t r = 0; r < n_routines; ++r)
+            if (name == routine_name(r)) return r;
+        throw runtime_error("MethodStackCounters: unknown routine " + name);
+    }
+    static uint64_t counters_cycles(const counters& c, const string& name) { return c.cycles[routine_ix(name)]; }
+    static uint64_t counters_calls(const counters& c, const string& name) { return c.calls[routine_ix(name)]; }
+    static py::list routine_names() {
+        py::list r;
+        for (size_t i = 0; i < n_routines; ++i) r.append(string(routine_name(i)));
+        return r;
+    }
+    static bool profiling_enabled() { return enabled; }
+
+    static void trace_start(size_t capacity) { shyft::core::trace::tracer::instance().start(capacity); }
+    static void trace_stop() { shyft::core::trace::tracer::instance().stop(); }
+    static void trace_clear() { shyft::core::trace::tracer::instance().clear(); }
+    static bool trace_enabled() { return shyft::core::trace::tracer::instance().enabled(); }
+    static string trace_chrome_json() { return shyft::core::trace::tracer::instance().chrome_json(); }
+    static void trace_save(const string& file_path) { shyft::core::trace::tracer::instance().save(file_path); }
+    static py::tuple trace_size() {
+        auto s = shyft::core::trace::tracer::instance().size();
+        return py::make_tuple(s.first, s.second);
+    }
+
+    static void autotune_set_file(const string& file_path) { shyft::core::autotune_store::instance().set_file(file_path); }
+    static string autotune_get_file() { return shyft::core::autotune_store::instance().get_file(); }
+    static void autotune_clear() { shyft::core::autotune_store::instance().clear(); }
+    static size_t autotune_size() { return shyft::core::autotune_store::instance().size(); }
+
+    void method_stack() {
+        py::class_<counters>("MethodStackCounters",
+            doc_intro("The cycles and calls of each routine of the method stacks, summed over the threads of a run")
+            doc_intro("Only counted when the core is compiled with SHYFT_METHOD_STACK_PROFILING, ref. method_stack_profiling_enabled()")
+            )
+            .def("cycles", counters_cycles, (py::arg("self"), py::arg("routine")),
+                doc_intro("cycles used by the routine, time-stamp counter cycles, or ns on platforms without one")
+                doc_parameters()
+                doc_parameter("routine","str","one of the MethodStackCounters.routine_names()")
+                doc_returns("cycles","int","the cycle count")
+            )
+            .def("calls", counters_calls, (py::arg("self"), py::arg("routine")),
+                doc_intro("number of calls of the routine, usually one for each cell and time-step")
+                doc_parameters()
+                doc_parameter("routine","str","one of the MethodStackCounters.routine_names()")
+                doc_returns("calls","int","the call count")
+            )
+            .def("total_cycles", &counters::total_cycles, (py::arg("self")), "sum of cycles of all routines")
+            .def("clear", &counters::clear, (py::arg("self")), "set all counters to zero")
+            .def("routine_names", routine_names, "the names of the counted routines")
+            .staticmethod("routine_names")
+            ;
+        using shyft::core::model_memory_usage;
+        py::class_<model_memory_usage>("ModelMemoryUsage",
+            doc_intro("approx. bytes used by a region-model, by part, ref. the memory_usage() of the region-models")
+            doc_intro("The values shared by several cells are split among them, the caches shared with the copies of a model are counted in full by each copy")
+            )
+            .def_readonly("cells", &model_memory_usage::cells, "the cell objects, without the values of their series")
+            .def_readonly("env_ts", &model_memory_usage::env_ts, "the values of the env_ts of the cells")
+            .def_readonly("response_collectors", &model_memory_usage::response_collectors, "the values of the response collectors, and the catchment sums")
+            .def_readonly("state_collectors", &model_memory_usage::state_collectors, "the values of the state collectors")
+            .def_readonly("states", &model_memory_usage::states, "the initial state and the state checkpoints")
+            .def_readonly("interpolation_caches", &model_memory_usage::interpolation_caches, "the idw neighbour tables")
+            .def_readonly("routing_caches", &model_memory_usage::routing_caches, "the river flows of the last run, and the uhgs")
+            .def("total", &model_memory_usage::total, (py::arg("self")), "the sum of the parts")
+            ;
+        py::def("method_stack_profiling_enabled", profiling_enabled, "True if the method stacks are compiled with profiling counters");
+
+        py::def("timeline_trace_start", trace_start, (py::arg("capacity") = size_t(shyft::core::trace::tracer::default_capacity)),
+            doc_intro("clear the timeline trace, and start recording the phases of the region-models, interpolation and calibration")
+            doc_intro("each thread keeps its latest capacity events, the interpolation tasks, the cell batches of run_cells,")
+            doc_intro("routing, idw/btk and the goal function evaluations, with the cell range of the batch")
+            doc_parameters()
+            doc_parameter("capacity","int","events kept for each thread")
+        );
+        py::def("timeline_trace_stop", trace_stop, "stop recording the timeline trace, the events are kept until the next start or clear");
+        py::def("timeline_trace_clear", trace_clear, "remove the events of the timeline trace");
+        py::def("timeline_trace_enabled", trace_enabled, "True if the timeline trace is recording");
+        py::def("timeline_trace_size", trace_size,
+            doc_intro("the events of the timeline trace")
+            doc_returns("size","(int,int)","the events kept, and the events dropped as the thread rings wrapped around")
+        );
+        py::def("timeline_trace_chrome_json", trace_chrome_json,
+            doc_intro("the timeline trace as chrome trace json, for chrome://tracing or https://ui.perfetto.dev")
+            doc_returns("json","str","the trace events, ts and dur in us")
+        );
+        py::def("timeline_trace_save", trace_save, (py::arg("file_path")),
+            doc_intro("save the timeline trace as chrome trace json")
+            doc_parameters()
+            doc_parameter("file_path","str","the file to write")
+        );
+
+        py::def("autotune_set_file", autotune_set_file, (py::arg("file_path")),
+            doc_intro("keep the thread-count/chunk-size settings tuned by RegionModel.autotune_threads and DtsServer.set_autotune_eval_threads in a file,")
+            doc_intro("the settings already in the file are loaded, and used instead of tuning again")
+            doc_parameters()
+            doc_parameter("file_path","str","the file, rewritten when a setting is tuned, empty string turns off the file")
+        );
+        py::def("autotune_get_file", autotune_get_file, "the file of the tuned settings, empty if none");
+        py::def("autotune_clear", autotune_clear, "forget the tuned settings of the process, so they are tuned again, the file is rewritten on the next tuned setting");
+        py::def("autotune_size", autotune_size, "the number of tuned settings, by kind of work, size and machine");
+    }
+}
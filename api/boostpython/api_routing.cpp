@@ -1,6 +1,7 @@
 #include "boostpython_pch.h"
 #include "api/api.h"
 #include "core/routing.h"
+#include "api/api_state.h"
 
 namespace expose {
     using namespace shyft::core;
@@ -97,10 +98,36 @@ namespace expose {
             ;
     }
 
+    static routing::state routing_state_from_bytes(const std::vector<char>& bytes) {
+        routing::state s;
+        shyft::api::deserialize_from_bytes(bytes, s);
+        return s;
+    }
+
+    void routing_state() {
+        std::vector<char> (*serialize_state)(const routing::state&) = &shyft::api::serialize_to_bytes;
+        class_<routing::state>("RoutingState",
+            "The routing state at time t, the pending convolution tails of all the rivers of a region model.\n"
+            "It is left at the end of the time-axis by run_cells, and can be saved along with the cell states.\n"
+            "Set as the region_model.routing_state, before run_cells with a time-axis starting at t,\n"
+            "the routing continues from t, without routing the history before it.\n"
+            )
+            .def(init<>("an empty state, routing from a cold start"))
+            .def_readwrite("t",&routing::state::t,"the time where the state is valid, the start of the first step to continue with")
+            .def_readwrite("dt",&routing::state::dt,"the time-step of the state")
+            .def("empty",&routing::state::empty,"true if the state is empty, i.e. a cold start")
+            .def("serialize",serialize_state,args("self"),"make a blob out of the state")
+            .def("deserialize",&routing_state_from_bytes,args("blob"),"the state from a blob, as returned by .serialize()").staticmethod("deserialize")
+            .def(self==self)
+            .def(self!=self)
+            ;
+    }
+
     void routing() {
         routing_path_info();
         routing_ugh_parameter();
         routing_river();
         routing_river_network();
+        routing_state();
     }
 }
@@ -5,6 +5,7 @@
 #include "core/time_series.h"
 #include "api/api.h"
 #include "core/model_calibration.h"
+#include "core/calibration_batch.h"
 
 #include "py_convertible.h"
 
@@ -135,7 +136,39 @@ namespace expose {
             .value("CELL_CHARGE",model_calibration::CELL_CHARGE)
             .export_values()
             ;
+        enum_<model_calibration::optimizer_method>("OptimizerMethod")
+            .value("BOBYQA", model_calibration::BOBYQA)
+            .value("SCEUA", model_calibration::SCEUA)
+            .value("DREAM", model_calibration::DREAM)
+            .value("PATTERN_SEARCH", model_calibration::PATTERN_SEARCH)
+            .export_values()
+            ;
+        enum_<model_calibration::calibration_status>("CalibrationStatus")
+            .value("PENDING", model_calibration::PENDING)
+            .value("RUNNING", model_calibration::RUNNING)
+            .value("DONE", model_calibration::DONE)
+            .value("CANCELLED", model_calibration::CANCELLED)
+            .value("FAILED", model_calibration::FAILED)
+            .export_values()
+            ;
         using  pyarg=boost::python::arg;
+        typedef model_calibration::calibration_stage CalibrationStage;
+        class_<CalibrationStage>("CalibrationStage",
+            "A stage of Optimizer.optimize_staged, that optimizes on the first period_length of the model time-axis,\n"
+            "with the targets averaged to target_dt, so early stages can be short and coarse, and the last the full period\n"
+            )
+            .def(init<utctimespan, utctimespan, model_calibration::optimizer_method, size_t>(
+                (pyarg("period_length"), pyarg("target_dt"), pyarg("method"), pyarg("max_n_evaluations")),
+                "a stage, period_length=0 is the full time-axis, and target_dt=0 the targets as given"))
+            .def_readwrite("period_length", &CalibrationStage::period_length, "of the model time-axis, from its start, 0 means the full time-axis")
+            .def_readwrite("target_dt", &CalibrationStage::target_dt, "the resolution of the targets during the stage, 0 means as given")
+            .def_readwrite("method", &CalibrationStage::method, "the OptimizerMethod of the stage")
+            .def_readwrite("max_n_evaluations", &CalibrationStage::max_n_evaluations, "max number of goal function evaluations of the stage")
+            ;
+        typedef vector<CalibrationStage> CalibrationStageVector;
+        class_<CalibrationStageVector>("CalibrationStageVector", "the stages of Optimizer.optimize_staged, in order")
+            .def(vector_indexing_suite<CalibrationStageVector>())
+            ;
         class_<TargetSpecificationPts>("TargetSpecificationPts",
             "To guide the model calibration, we have a goal-function that we try to minimize\n"
             "This class contains the needed specification of this goal-function so that we can\n"
@@ -99,6 +99,8 @@ namespace expose {
                 ;
             e_time_axis_std<calendar_dt>(c_dt);
         }
+        static std::vector<utctime> point_dt_t(shyft::time_axis::point_dt const&ta) { return ta.t.vec(); }
+
         static void e_point_dt() {
             using namespace shyft::time_axis;
             auto p_dt=class_<point_dt>("TimeAxisByPoints",
@@ -124,7 +126,7 @@ namespace expose {
                         doc_parameter("time_points","UtcTimeVector","ordered set of unique utc-time points, 0..n-2:the start of each consecutive period,n-1: end of last period")
                         )
                 )
-                .def_readonly("t",&point_dt::t,"UtcTimeVector,time_points except end of last period, see t_end")
+                .add_property("t",&point_dt_t,"UtcTimeVector,time_points except end of last period, see t_end")
                 .def_readonly("t_end",&point_dt::t_end,"utctime: end of time-axis")
                 ;
                 e_time_axis_std<point_dt>(p_dt);
@@ -140,6 +142,17 @@ namespace expose {
             return r;
         }
 
+        // only the active representation of the TimeAxis is alive, the others are presented as empty
+        static shyft::time_axis::fixed_dt generic_dt_fixed_dt(shyft::time_axis::generic_dt const&ta) {
+            return ta.gt == ta.FIXED ? ta.f : shyft::time_axis::fixed_dt();
+        }
+        static shyft::time_axis::calendar_dt generic_dt_calendar_dt(shyft::time_axis::generic_dt const&ta) {
+            return ta.gt == ta.CALENDAR ? ta.c : shyft::time_axis::calendar_dt();
+        }
+        static shyft::time_axis::point_dt generic_dt_point_dt(shyft::time_axis::generic_dt const&ta) {
+            return ta.gt == ta.POINT ? ta.p : shyft::time_axis::point_dt();
+        }
+
         static void e_generic_dt() {
             using namespace shyft::time_axis;
             namespace py = boost::python;
@@ -212,9 +225,9 @@ namespace expose {
                      )
                 )
                 .def_readonly("timeaxis_type",&generic_dt::gt,"describes what time-axis representation type this is,e.g (fixed|calendar|point)_dt ")
-                .def_readonly("fixed_dt",&generic_dt::f,"The fixed dt representation (if active)")
-                .def_readonly("calendar_dt",&generic_dt::c,"The calendar dt representation(if active)")
-                .def_readonly("point_dt",&generic_dt::p,"The point_dt representation(if active)")
+                .add_property("fixed_dt",&generic_dt_fixed_dt,"The fixed dt representation (if active)")
+                .add_property("calendar_dt",&generic_dt_calendar_dt,"The calendar dt representation(if active)")
+                .add_property("point_dt",&generic_dt_point_dt,"The point_dt representation(if active)")
                 .def("total_period", &generic_dt::total_period,
                     doc_returns("total_period", "UtcPeriod", "the period that covers the entire time-axis")
                 )
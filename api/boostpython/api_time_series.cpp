@@ -6,6 +6,7 @@
 #include "core/predictions.h"
 #include "api/api.h"
 #include "core/time_series_dd.h"
+#include "numpy_view.h"
 
 namespace expose {
     using namespace shyft;
@@ -18,13 +19,35 @@ namespace expose {
 	using namespace shyft::time_series::dd;
     namespace py = boost::python;
 
+    namespace {
+        /** releases the python GIL while in scope, for the bulk ts-vector operations, that do not touch python objects,
+         * the result is converted to python after the GIL is reacquired */
+        struct scoped_gil_release {
+            scoped_gil_release() noexcept : py_thread_state(PyEval_SaveThread()) {}
+            ~scoped_gil_release() noexcept { PyEval_RestoreThread(py_thread_state); }
+            scoped_gil_release(const scoped_gil_release&) = delete;
+            scoped_gil_release& operator=(const scoped_gil_release&) = delete;
+        private:
+            PyThreadState* py_thread_state;
+        };
+    }
+
+    static ats_vector tsv_evaluate(const ats_vector& tsv, size_t max_threads) { scoped_gil_release gil; return tsv.evaluate(max_threads); }
+    static vector<double> tsv_values_at_time(const ats_vector& tsv, utctime t) { scoped_gil_release gil; return tsv.values_at_time(t); }
+    static ats_vector tsv_percentiles(const ats_vector& tsv, gta_t const& ta, vector<int> const& p) { scoped_gil_release gil; return tsv.percentiles(ta, p); }
+    static ats_vector tsv_percentiles_f(const ats_vector& tsv, time_axis::fixed_dt const& ta, vector<int> const& p) { scoped_gil_release gil; return tsv.percentiles_f(ta, p); }
+    static ats_vector tsv_average(const ats_vector& tsv, gta_t const& ta) { scoped_gil_release gil; return tsv.average(ta); }
+
     ats_vector quantile_map_forecast_5(vector<ats_vector> const & forecast_set, vector<double> const& set_weights, ats_vector const& historical_data, shyft::time_series::dd::gta_t const&time_axis, utctime interpolation_start ) {
+        scoped_gil_release gil;
         return quantile_map_forecast(forecast_set, set_weights, historical_data, time_axis, interpolation_start);
     }
     ats_vector quantile_map_forecast_6(vector<ats_vector> const & forecast_set, vector<double> const& set_weights, ats_vector const& historical_data, shyft::time_series::dd::gta_t const&time_axis, utctime interpolation_start, utctime interpolation_end) {
+        scoped_gil_release gil;
         return quantile_map_forecast(forecast_set, set_weights, historical_data, time_axis, interpolation_start, interpolation_end);
     }
     ats_vector quantile_map_forecast_7(vector<ats_vector> const & forecast_set, vector<double> const& set_weights, ats_vector const& historical_data, shyft::time_series::dd::gta_t const&time_axis, utctime interpolation_start, utctime interpolation_end, bool interpolated_quantiles) {
+        scoped_gil_release gil;
         return quantile_map_forecast(forecast_set, set_weights, historical_data, time_axis, interpolation_start, interpolation_end, interpolated_quantiles);
     }
 	static string nice_str(const gta_t & ta) {
@@ -67,6 +90,7 @@ namespace expose {
 	static string nice_str(const shared_ptr<time_series::dd::rating_curve_ts>&b) { return "rating_curve_ts(" + nice_str(b->ts.level_ts) + ",..)"; }
 	static string nice_str(const shared_ptr<time_series::dd::krls_interpolation_ts>&b) { return "krls(" + nice_str(b->ts) + ",..)"; }
 	static string nice_str(const shared_ptr<time_series::dd::qac_ts>&b) { return "qac_ts(" + nice_str(apoint_ts(b->ts)) + ", "+nice_str(apoint_ts(b->cts))+"..)"; }
+	static string nice_str(const shared_ptr<time_series::dd::sum_ts>&b) { return "sum(" + (b->tsv.size() ? nice_str(b->tsv.front()) : string("")) + (b->tsv.size() > 1 ? ",.." : "") + ")"; }
 
 
 	static string nice_str(const apoint_ts&ats) {
@@ -88,10 +112,39 @@ namespace expose {
 		if (const auto& b = dynamic_pointer_cast<time_series::dd::rating_curve_ts>(ats.ts)) return nice_str(b);
 		if (const auto& b = dynamic_pointer_cast<time_series::dd::krls_interpolation_ts>(ats.ts)) return nice_str(b);
 		if (const auto& b = dynamic_pointer_cast<time_series::dd::qac_ts>(ats.ts)) return nice_str(b);
+		if (const auto& b = dynamic_pointer_cast<time_series::dd::sum_ts>(ats.ts)) return nice_str(b);
 
 		return "not_yet_stringified_ts";
 	}
     static string ts_stringify(const apoint_ts&ats) { return nice_str(ats); }
+    /** \return one ts for each row of the 2-d array values, all with the time-axis ta, that shares its points between the copies */
+    static ats_vector ats_vector_from_numpy(const gta_t& ta, const py::object& values, time_series::ts_point_fx point_fx) {
+        size_t cols = 0;
+        auto rows = np_rows(values, cols);
+        if (cols != ta.size())
+            throw std::runtime_error("TsVector.from_numpy: the rows of values should have the length of the time-axis");
+        ats_vector r; r.reserve(rows.size());
+        for (auto& v : rows)
+            r.emplace_back(ta, std::move(v), point_fx);
+        return r;
+    }
+
+    /** \return the values of the ts of tsv as the rows of a 2-d array, evaluated directly into it */
+    static py::object ats_vector_to_numpy(const ats_vector& tsv) {
+        const size_t rows = tsv.size();
+        const size_t cols = rows ? tsv[0].size() : 0;
+        vector<double> v(rows*cols);
+        eval_buffers b;
+        for (size_t i = 0; i < rows; ++i) {
+            if (!tsv[i].ts || tsv[i].needs_bind())
+                throw std::runtime_error("TsVector.to_numpy: ts " + std::to_string(i) + " is empty or unbound");
+            if (tsv[i].size() != cols)
+                throw std::runtime_error("TsVector.to_numpy: the time-series must be of the same size, ts " + std::to_string(i) + " is not");
+            tsv[i].ts->values_into(v.data() + i*cols, b);
+        }
+        return np_array(std::move(v), rows, cols);
+    }
+
     static void expose_ats_vector() {
         using namespace shyft::api;
         typedef ats_vector(ats_vector::*m_double)(double)const;
@@ -114,43 +167,63 @@ namespace expose {
             )
             .def(vector_indexing_suite<ats_vector>())
             .def(init<ats_vector const&>(args("clone_me")))
-            .def("values_at",&ats_vector::values_at_time,args("t"),
+            .def("values_at",&tsv_values_at_time,args("t"),
                  doc_intro("Computes the value at specified time t for all time-series")
+                 doc_intro("The members are evaluated in parallel, with the python GIL released")
                  doc_parameters()
                  doc_parameter("t","int","seconds since epoch 1970 UTC")
             )
-            .def("percentiles",&ats_vector::percentiles,args("time_axis","percentiles"),
+            .def("percentiles",&tsv_percentiles,args("time_axis","percentiles"),
                 doc_intro("Calculate the percentiles, NIST R7, excel,R definition, of the timeseries")
                 doc_intro("over the specified time-axis.")
                 doc_intro("The time-series point_fx interpretation is used when performing")
                 doc_intro("the true-average over the time_axis periods.")
+                doc_intro("The members are evaluated in parallel, with the python GIL released")
                 doc_parameters()
                 doc_parameter("percentiles","IntVector","A list of numbers,[ 0, 25,50,-1,75,100] will return 6 time-series,\n -1 -> arithmetic average\n -1000 -> min extreme value\n +1000 max extreme value")
                 doc_parameter("time_axis","TimeAxis","The time-axis used when applying true-average to the time-series")
                 doc_returns("calculated_percentiles","TsVector","Time-series list with evaluated percentile results, same length as input")
             )
-            .def("percentiles",&ats_vector::percentiles_f,args("time_axis","percentiles"),
+            .def("percentiles",&tsv_percentiles_f,args("time_axis","percentiles"),
                 doc_intro("Calculate the percentiles, NIST R7, excel,R definition, of the timeseries")
                 doc_intro("over the specified time-axis.")
                 doc_intro("The time-series point_fx interpretation is used when performing")
                 doc_intro("the true-average over the time_axis periods.")
+                doc_intro("The members are evaluated in parallel, with the python GIL released")
                 doc_parameters()
                 doc_parameter("percentiles","IntVector","A list of numbers,[ 0, 25,50,-1,75,100] will return 6 time-series,\n -1 -> arithmetic average\n -1000 -> min extreme value\n +1000 max extreme value")
                 doc_parameter("time_axis","TimeAxisFixedDeltaT","The time-axis used when applying true-average to the time-series")
                 doc_returns("calculated_percentiles","TsVector","Time-series list with evaluated percentile results, same length as input")
             )
+            .def("evaluate",&tsv_evaluate,(py::arg("self"),py::arg("max_threads")=0),
+                doc_intro("evaluate the expressions of self into concrete time-series, in parallel on the shared thread pool,")
+                doc_intro("with the python GIL released, so other python threads are not blocked")
+                doc_parameters()
+                doc_parameter("max_threads","int","limits the threads used, 0 means all of the pool")
+                doc_returns("tsv","TsVector","the concrete time-series, with the time-axis, values and point interpretation of each expression")
+            )
             .def("slice",&ats_vector::slice,args("indexes"),
                  doc_intro("returns a slice of self, specified by indexes")
                  doc_parameters()
                  doc_parameter("indexes","IntVector","the indicies to pick out from self, if indexes is empty, then all is returned")
                  doc_returns("slice","TsVector","a new TsVector, with content according to indexes specified")
             )
+            .def("sum", &ats_vector::sum, (py::arg("self"), py::arg("compensated") = false),
+                doc_intro("create a new time-series expression, that is the sum of the members of self,")
+                doc_intro("as one node, instead of the chain self[0]+self[1]+...")
+                doc_intro("The time-axis is the combined time-axis of the members, as for the chain.")
+                doc_intro("When evaluated, the members are summed in groups in parallel, and the result")
+                doc_intro("does not depend on the number of threads.")
+                doc_parameters()
+                doc_parameter("compensated", "bool", "if True, use Kahan compensated summation, for many members of different magnitude")
+                doc_returns("sum", "TimeSeries", "a new time-series expression, the sum of the members")
+            )
             .def("abs", &ats_vector::abs,
                 doc_intro("create a new ts-vector, with all members equal to abs(self")
                 doc_returns("tsv", "TsVector", "a new TsVector expression, that will provide the abs-values of self.values")
             )
 
-            .def("average", &ats_vector::average, args("ta"),
+            .def("average", &tsv_average, args("ta"),
                 doc_intro("create a new vector of ts that is the true average of self")
                 doc_intro("over the specified time-axis ta.")
                 doc_parameters()
@@ -252,6 +325,38 @@ namespace expose {
                   doc_notes()
                   doc_see_also("nash_sutcliffe,forecast_merge")
              )
+            .def("serialize_indexed",&ats_vector::serialize_indexed,(py::arg("self"),py::arg("max_threads")=0),
+                doc_intro("convert the ts-vector into a binary blob, each ts serialized in parallel into a blob of its own,")
+                doc_intro("concatenated with an offset table, so a single ts can be read back without reading the others")
+                doc_parameters()
+                doc_parameter("max_threads","int","limits the threads used, 0 means all")
+                doc_returns("blob","ByteVector","as read by deserialize_indexed, and deserialize_indexed_at")
+            )
+            .def("from_numpy", &ats_vector_from_numpy, (py::arg("ta"), py::arg("values"), py::arg("point_fx")),
+                doc_intro("construct a TsVector from the rows of a 2-d numpy array, like the members of an ensemble,")
+                doc_intro("in one call, each row copied once into its time-series, and the time-axis points shared by all of them")
+                doc_parameters()
+                doc_parameter("ta","TimeAxis","the time-axis, of the length of the rows of values")
+                doc_parameter("values","np.ndarray","the values, shape(n_ts, len(ta)), preferably float64 and c-contiguous, other arrays are converted")
+                doc_parameter("point_fx","point_interpretation_policy","how to interpret the points")
+                doc_returns("tsv","TsVector","n_ts time-series")
+                doc_see_also("to_numpy,TimeSeries.from_numpy")
+            ).staticmethod("from_numpy")
+            .def("to_numpy", &ats_vector_to_numpy, (py::arg("self")),
+                doc_intro("return the values of the time-series as the rows of a 2-d numpy array, the expressions evaluated directly into it")
+                doc_intro("The time-series must be bound, and of the same size")
+                doc_returns("values","np.ndarray","shape(len(self), n), float64")
+                doc_see_also("from_numpy")
+            )
+            .def("deserialize_indexed",&ats_vector::deserialize_indexed,(py::arg("blob"),py::arg("max_threads")=0),
+                doc_intro("convert a blob, as returned by .serialize_indexed(), into a TsVector, deserializing the ts in parallel")
+            ).staticmethod("deserialize_indexed")
+            .def("indexed_size",&ats_vector::indexed_size,(py::arg("blob")),
+                doc_intro("the number of ts of a blob, as returned by .serialize_indexed()")
+            ).staticmethod("indexed_size")
+            .def("deserialize_indexed_at",&ats_vector::deserialize_indexed_at,(py::arg("blob"),py::arg("i")),
+                doc_intro("the i'th ts of a blob, as returned by .serialize_indexed(), without reading the others")
+            ).staticmethod("deserialize_indexed_at")
             // defining vector math-operations goes here
             .def(-self)
             .def(self*double())
@@ -319,6 +424,8 @@ namespace expose {
                 doc_parameter("interpolation_end", "int", "time where the interpolation should end, if no_utctime, use end of forecast-set")
                 doc_parameter("interpolated_quantiles", "bool", "whether the quantile values should be interpolated or assigned the values lower than or equal to the current quantile")
                 doc_returns("qm_forecast", "TsVector", "quantile mapped forecast with the requested time-axis")
+                doc_notes()
+                doc_note("the members are sampled and ranked in parallel, with the python GIL released")
                 ;
 
             def("quantile_map_forecast",quantile_map_forecast_5,
@@ -348,9 +455,15 @@ namespace expose {
             .def("size",&pts_t::size,(py::arg("self")),"returns number of points")\
             .def("index_of", (size_t (pts_t::*)(utctime t) const) &pts_t::index_of,(py::arg("self"),py::arg("t")),"return the index of the intervall that contains t, or npos if not found")\
             .def("total_period",&pts_t::total_period,(py::arg("self")),"returns the total period covered by the time-axis of this time-series")\
-            .def("__call__",&pts_t::operator(),(py::arg("self"),py::arg("t")),"return the f(t) value for the time-series")
+            .def("__call__",(double (pts_t::*)(utctime) const) &pts_t::operator(),(py::arg("self"),py::arg("t")),"return the f(t) value for the time-series")
 
 
+    /** \return a writable numpy view of the values of ts, kept alive by the view */
+    template <class TA>
+    static py::object point_ts_values_view(shared_ptr<time_series::point_ts<TA>> ts) {
+        return np_view(ts->v.data(), ts->v.size(), ts, true);
+    }
+
     template <class TA>
     static void point_ts(const char *ts_type_name,const char *doc) {
         typedef time_series::point_ts<TA> pts_t;
@@ -372,6 +485,12 @@ namespace expose {
 			.def("get_time_axis", &pts_t::time_axis,(py::arg("self")),
 				"returns the time-axis", return_internal_reference<>()
 			) // have to use func plus init.py fixup due to boost py policy
+            .def("values_view",&point_ts_values_view<TA>,(py::arg("self")),
+                doc_intro("return a numpy array viewing the values, not a copy, so changes by either are seen by both,")
+                doc_intro("e.g. the cell response series after a run. The view keeps the time-series alive,")
+                doc_intro("and is valid while the time-series keeps its size, take a new view after a model is re-initialized")
+                doc_returns("values","np.ndarray","the values, float64, a view")
+            )
             ;
     }
 
@@ -393,6 +512,36 @@ namespace expose {
     }
 
 
+    /** \return a read-only numpy view of the values of a point ts, or of a bound reference to one, else the evaluated values */
+    static py::object apoint_ts_values_view(const apoint_ts& ts) {
+        if (ts.ts) {
+            auto g = dynamic_pointer_cast<gpoint_ts>(ts.ts);
+            if (!g)
+                if (auto r = dynamic_pointer_cast<aref_ts>(ts.ts))
+                    g = r->rep;
+            if (g)
+                return np_view(g->rep.v.data(), g->rep.v.size(), g, false);
+        }
+        return np_array(ts.values());// evaluated, the array owns the result
+    }
+
+    /** \return the values of ts, evaluated in parallel blocks of the time-axis with the GIL released, as a numpy array owning them */
+    static py::object apoint_ts_parallel_values(const apoint_ts& ts, size_t max_threads) {
+        vector<double> v;
+        {
+            scoped_gil_release gil;
+            v = ts.parallel_values(max_threads);
+        }
+        return np_array(std::move(v));
+    }
+
+    static apoint_ts apoint_ts_from_numpy(const gta_t& ta, const py::object& values, time_series::ts_point_fx point_fx) {
+        auto v = np_values(values);
+        if (v.size() != ta.size())
+            throw std::runtime_error("TimeSeries.from_numpy: the values should have the length of the time-axis");
+        return apoint_ts(ta, std::move(v), point_fx);
+    }
+
     static void expose_apoint_ts() {
         using namespace shyft::api;
 
@@ -552,6 +701,35 @@ namespace expose {
 
 			.def("get_time_axis", &apoint_ts::time_axis,(py::arg("self")), "returns the time-axis", return_internal_reference<>())
 			.add_property("values", &apoint_ts::values,"return the values (possibly calculated on the fly)")
+            .def("values_view", &apoint_ts_values_view, (py::arg("self")),
+                doc_intro("return the values as a numpy array, without the copies of .values.to_numpy()")
+                doc_intro("For a concrete time-series the array is a read-only view of its values, kept alive by the view,")
+                doc_intro("since the values might be shared by other time-series, for an expression it is the evaluated values.")
+                doc_intro("Make a copy, values_view().copy(), to modify the values")
+                doc_returns("values","np.ndarray","the values, float64")
+                doc_see_also("values,from_numpy")
+            )
+            .def("parallel_values", &apoint_ts_parallel_values, (py::arg("self"), py::arg("max_threads")=0),
+                doc_intro("return the values of the expression as a numpy array, as values_view(), with the time-axis split")
+                doc_intro("in blocks that are evaluated in parallel on the shared thread pool, with the python GIL released.")
+                doc_intro("Useful for one long expression, e.g. decades of 15 minute values, where .values uses one thread.")
+                doc_intro("Nodes with state across time, like average, integral and accumulate, are evaluated once each, concurrently,")
+                doc_intro("and the point-wise operations over them in parallel blocks, the result equals .values")
+                doc_parameters()
+                doc_parameter("max_threads","int","limits the threads used, 0 means all of the pool")
+                doc_returns("values","np.ndarray","the values, float64")
+                doc_see_also("values,values_view")
+            )
+            .def("from_numpy", &apoint_ts_from_numpy, (py::arg("ta"), py::arg("values"), py::arg("point_fx")),
+                doc_intro("construct a time-series from a numpy array, copied once into the time-series,")
+                doc_intro("as one block for a contiguous float64 array, instead of through a DoubleVector")
+                doc_parameters()
+                doc_parameter("ta","TimeAxis","the time-axis, of the length of values")
+                doc_parameter("values","np.ndarray","the values, preferably float64 and contiguous, other arrays are converted")
+                doc_parameter("point_fx","point_interpretation_policy","how to interpret the points")
+                doc_returns("ts","TimeSeries","the new time-series")
+            )
+            .staticmethod("from_numpy")
 			// operators
 			.def(self * self)
 			.def(double() * self)
@@ -574,6 +752,21 @@ namespace expose {
             .def("abs", &apoint_ts::abs,(py::arg("self")),
                 doc_intro("create a new ts, abs(self")
                 doc_returns("ts", "TimeSeries", "a new time-series expression, that will provide the abs-values of self.values")
+            )
+            .def("run_length_encoded", &apoint_ts::run_length_encoded,(py::arg("self")),
+                doc_intro("create a concrete copy of self, where the values are stored as runs of equal values.")
+                doc_intro("Use it for piecewise constant series, like restrictions and flags, to reduce the memory use.")
+                doc_returns("ts", "TimeSeries", "a new concrete time-series, with read-only values")
+                doc_notes()
+                doc_note("when serialized, e.g. stored to the dtss, it is a dense time-series")
+            )
+            .def("memoized", &apoint_ts::memoized,(py::arg("self")),
+                doc_intro("create a copy of self where the values of an average, integral, accumulate or convolve_w")
+                doc_intro("expression are computed once, at first access, so that repeated element access is fast.")
+                doc_intro("Other expressions are returned as is.")
+                doc_returns("ts", "TimeSeries", "a new time-series expression, that caches its values")
+                doc_notes()
+                doc_note("the values are not updated if the terminals of the expression are modified later")
             )
 			.def("average", &apoint_ts::average, (py::arg("self"),py::arg("ta")),
                 doc_intro("create a new ts that is the true average of self")
@@ -1276,6 +1469,15 @@ namespace expose {
             .value("MIN_EXTREME",time_series::statistics_property::MIN_EXTREME)
             .value("MAX_EXTREME",time_series::statistics_property::MAX_EXTREME)
             ;
+        enum_<time_series::aggregate_property>("aggregate_property")
+            .value("SUM",time_series::aggregate_property::SUM)
+            .value("MEAN",time_series::aggregate_property::MEAN)
+            .value("MINIMUM",time_series::aggregate_property::MINIMUM)
+            .value("MAXIMUM",time_series::aggregate_property::MAXIMUM)
+            .value("WEIGHTED_SUM",time_series::aggregate_property::WEIGHTED_SUM)
+            .value("WEIGHTED_MEAN",time_series::aggregate_property::WEIGHTED_MEAN)
+            .value("HISTOGRAM",time_series::aggregate_property::HISTOGRAM)
+            ;
 
         enum_<time_series::dd::extend_ts_fill_policy>(
             "extend_fill_policy",
@@ -8,6 +8,25 @@ namespace expose {
     using namespace std;
 
     typedef std::vector<utcperiod> UtcPeriodVector;
+    typedef std::vector<YMDhms> YMDhmsVector;
+
+    /** extract one of the YMDhms members of v, as an IntVector */
+    template <int YMDhms::*m>
+    static vector<int> ymdhms_member(const YMDhmsVector& v) {
+        vector<int> r;r.reserve(v.size());
+        for(const auto& c:v) r.push_back(c.*m);
+        return r;
+    }
+
+    static YMDhmsVector ymdhms_from_arrays(const vector<int>& Y,const vector<int>& M,const vector<int>& D,const vector<int>& h,const vector<int>& m,const vector<int>& s) {
+        const auto n=Y.size();
+        if(!(M.size()==n && D.size()==n && h.size()==n && m.size()==n && s.size()==n))
+            throw std::runtime_error("Y,M,D,h,m,s vectors need to have same number of elements");
+        YMDhmsVector r;r.reserve(n);
+        for(size_t i=0;i<n;++i)
+            r.emplace_back(Y[i],M[i],D[i],h[i],m[i],s[i]);
+        return r;
+    }
 
 
     BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(calendar_time_overloads,calendar::time,1,6);
@@ -22,6 +41,13 @@ namespace expose {
         utctime (calendar::*time_YWdhms)(YWdhms) const = &calendar::time;
         utctime (calendar::*time_6)(int,int,int,int,int,int) const = &calendar::time;
         utctime (calendar::*time_from_week_6)(int, int, int, int, int, int) const = &calendar::time_from_week;
+        vector<utctime> (calendar::*time_v)(const YMDhmsVector&) const = &calendar::time;
+        YMDhms (calendar::*calendar_units_t)(utctime) const = &calendar::calendar_units;
+        YMDhmsVector (calendar::*calendar_units_v)(const vector<utctime>&) const = &calendar::calendar_units;
+        utctime (calendar::*trim_t)(utctime, utctimespan) const = &calendar::trim;
+        vector<utctime> (calendar::*trim_v)(const vector<utctime>&, utctimespan) const = &calendar::trim;
+        utctime (calendar::*add_t)(utctime, utctimespan, long) const = &calendar::add;
+        vector<utctime> (calendar::*add_v)(const vector<utctime>&, utctimespan, long) const = &calendar::add;
         class_<calendar, shared_ptr<calendar>>("Calendar",
             doc_intro("Calendar deals with the concept of human calendar")
             doc_intro(" In SHyFT we practice the 'utctime-perimeter' principle,")
@@ -77,12 +103,19 @@ namespace expose {
                 doc_notes()
                 doc_note("the list is currently static and reflects tz-rules approx as of 2014")
             ).staticmethod("region_id_list")
-            .def("calendar_units", &calendar::calendar_units, args("t"),
+            .def("calendar_units", calendar_units_t, args("t"),
                 doc_intro("returns YMDhms for specified t, in the time-zone as given by the calendar")
                 doc_parameters()
                 doc_parameter("t", "int", "timestamp utc seconds since epoch")
                 doc_returns("calendar_units","YMDhms","calendar units as in year-month-day hour-minute-second")
             )
+            .def("calendar_units", calendar_units_v, args("t"),
+                doc_intro("returns YMDhms for each of the specified t, in the time-zone as given by the calendar")
+                doc_intro("the dst-rules are looked up once for each dst period, so ordered t, like time_axis.time_points, is fast")
+                doc_parameters()
+                doc_parameter("t", "UtcTimeVector", "timestamps utc seconds since epoch, e.g. from numpy int64 array")
+                doc_returns("calendar_units","YMDhmsVector","calendar units for each t, use .year,.month etc. to get them as IntVector")
+            )
             .def("calendar_week_units", &calendar::calendar_week_units, args("t"), 
                 doc_intro("returns iso YWdhms for specified t, in the time-zone as given by the calendar")
                 doc_parameters()
@@ -95,6 +128,12 @@ namespace expose {
                 doc_parameter("YMDhms","YMDhms","calendar cooordinate structure containg year,month,day, hour,minute,second")
                 doc_returns("timestamp","int","timestamp as in seconds utc since epoch")                
             )
+            .def("time", time_v, args("YMDhms"),
+                doc_intro("convert each of the calendar coordinates into time using the calendar time-zone")
+                doc_parameters()
+                doc_parameter("YMDhms","YMDhmsVector","calendar coordinates, e.g. from YMDhmsVector.create_from_arrays(Y,M,D,h,m,s)")
+                doc_returns("timestamps","UtcTimeVector","timestamps as in seconds utc since epoch, use .to_numpy() for numpy array")
+            )
             .def("time", time_YWdhms, args("YWdhms"),
                 doc_intro("convert calendar iso week coordinates structure into time using the calendar time-zone")
                 doc_parameters()
@@ -132,7 +171,15 @@ namespace expose {
                 )
             )
 
-            .def("add", &calendar::add, args("t", "delta_t", "n"),
+            .def("add", add_v, args("t", "delta_t", "n"),
+                doc_intro("calendar semantic add, as for add(t,delta_t,n), for each of the specified t")
+                doc_parameters()
+                doc_parameter("t","UtcTimeVector","timestamps utc seconds since epoch, e.g. from numpy int64 array")
+                doc_parameter("delta_t","int","timestep in seconds, with semantic interpretation of DAY,WEEK,MONTH,YEAR")
+                doc_parameter("n","int","number of timesteps to add")
+                doc_returns("t","UtcTimeVector","new timestamps with the added time-steps, seconds utc since epoch")
+            )
+            .def("add", add_t, args("t", "delta_t", "n"),
                 doc_intro("calendar semantic add")
                 doc_intro("conceptually this is similar to t + deltaT*n")
                 doc_intro(" but with deltaT equal to calendar::DAY,WEEK,MONTH,YEAR")
@@ -162,7 +209,13 @@ namespace expose {
              doc_see_also("add(t,delta_t,n),trim(t,delta_t)")
 
              )
-        .def("trim",&calendar::trim,args("t","delta_t"),
+        .def("trim",trim_v,args("t","delta_t"),
+            doc_intro("round each of the times t down to the nearest calendar time-unit delta_t, as for trim(t,delta_t)")
+            doc_parameter("t", "UtcTimeVector", "timestamps utc seconds since epoch, e.g. from numpy int64 array")
+            doc_parameter("delta_t", "int", "timestep in seconds, with semantic interpretation of Calendar.(DAY,WEEK,MONTH,YEAR)")
+            doc_returns("t", "UtcTimeVector", "new trimmed timestamps, seconds utc since epoch")
+        )
+        .def("trim",trim_t,args("t","delta_t"),
             doc_intro("round time t down to the nearest calendar time-unit delta_t")
             doc_intro("taking the calendar time-zone and dst into account")
             doc_parameter("t", "int", "timestamp utc seconds since epoch")
@@ -203,6 +256,20 @@ namespace expose {
         .def(self!=self)
            ;
 
+        class_<YMDhmsVector>("YMDhmsVector","A vector, list, of YMDhms, the result of Calendar.calendar_units(UtcTimeVector)")
+        .def(vector_indexing_suite<YMDhmsVector>())
+        .def(init<const YMDhmsVector&>(args("const_ref_v")))
+        .def("create_from_arrays",ymdhms_from_arrays,args("Y","M","D","h","m","s"),
+            doc_intro("Create a YMDhmsVector from Y,M,D,h,m,s IntVectors of equal length, e.g. from numpy int32 arrays")
+        ).staticmethod("create_from_arrays")
+        .add_property("year",&ymdhms_member<&YMDhms::year>,"IntVector with the year of each element")
+        .add_property("month",&ymdhms_member<&YMDhms::month>,"IntVector with the month of each element")
+        .add_property("day",&ymdhms_member<&YMDhms::day>,"IntVector with the day of each element")
+        .add_property("hour",&ymdhms_member<&YMDhms::hour>,"IntVector with the hour of each element")
+        .add_property("minute",&ymdhms_member<&YMDhms::minute>,"IntVector with the minute of each element")
+        .add_property("second",&ymdhms_member<&YMDhms::second>,"IntVector with the second of each element")
+        ;
+
         class_<YWdhms>("YWdhms", "Defines calendar coordinates as iso Year Week week-day hour minute second")
             .def(init<int, optional<int, int, int, int, int>>(args("Y", "W", "wd", "h", "m", "s"), 
                 doc_intro("Creates calendar coordinates specifying iso Y,W,wd,h,m,s")
@@ -229,6 +296,7 @@ namespace expose {
             .def(self != self)
             ;
 
+        utctimespan (time_zone::tz_info_t::*utc_offset_t)(utctime) const = &time_zone::tz_info_t::utc_offset;
         class_<time_zone::tz_info_t,bases<>,time_zone::tz_info_t_,boost::noncopyable>("TzInfo",
             "TzInfo class is responsible for providing information about the\n"
             " time-zone of the calendar.\n"
@@ -241,7 +309,7 @@ namespace expose {
         .def(init<utctimespan>(args("base_tz"),"creates a TzInfo with a fixed utc-offset(no dst-rules)"))
         .def("name",&time_zone::tz_info_t::name,"returns the olson time-zone identifier or name for the TzInfo")
         .def("base_offset",&time_zone::tz_info_t::base_offset,"returnes the time-invariant part of the utc-offset")
-        .def("utc_offset",&time_zone::tz_info_t::utc_offset,args("t"),"returns the utc_offset at specified utc-time, takes DST into account if applicable")
+        .def("utc_offset",utc_offset_t,args("t"),"returns the utc_offset at specified utc-time, takes DST into account if applicable")
         .def("is_dst",&time_zone::tz_info_t::is_dst,args("t"),"returns true if DST is observed at given utc-time t")
         ;
     }
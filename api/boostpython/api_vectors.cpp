@@ -5,6 +5,7 @@
 #include "numpy_boost_python.hpp"
 
 #include "py_convertible.h"
+#include "numpy_view.h"
 #include "core/utctime_utilities.h"
 #include "core/geo_point.h"
 #include "core/geo_cell_data.h"
@@ -62,6 +63,8 @@ namespace expose {
 
     template<class T>
     static vector<T> FromNdArray(const numpy_boost<T,1>& npv) {
+        if (npv.strides()[0] == 1) // contiguous, one block
+            return vector<T>(npv.data(), npv.data() + npv.shape()[0]);
         vector<T> r;r.reserve(npv.shape()[0]);
         for(size_t i=0;i<npv.shape()[0];++i) {
             r.push_back(npv[i]);
@@ -69,21 +72,101 @@ namespace expose {
         return r;
     }
 
-    template<class T>
-    static numpy_boost<T,1> ToNpArray(const vector<T>&v) {
-        int dims[]={int(v.size())};
-        numpy_boost<T,1> r(dims);
-        for(size_t i=0;i<r.size();++i) {
-            r[i]=v[i];
+    /** the owner of the values of a numpy view, the base object of the array */
+    struct np_owner {
+        std::shared_ptr<void> keep;
+        static void destroy(PyObject* c) { delete static_cast<np_owner*>(PyCapsule_GetPointer(c, "shyft.np_owner")); }
+    };
+
+    /** \return a c-contiguous numpy array of shape dims[0..nd) over the doubles at d, with base as its base object, stolen */
+    static py::object np_view_of(double* d, int nd, npy_intp* dims, PyObject* base, bool writable) {
+        PyObject* a = PyArray_New(&PyArray_Type, nd, dims, NPY_DOUBLE, nullptr, d, 0, writable ? NPY_ARRAY_CARRAY : NPY_ARRAY_CARRAY_RO, nullptr);
+        if (!a) {
+            Py_DECREF(base);
+            py::throw_error_already_set();
         }
+        py::object r{ py::handle<>(a) };
+        if (PyArray_SetBaseObject((PyArrayObject*)a, base) != 0)// steals base, also on failure
+            py::throw_error_already_set();
+        return r;
+    }
+
+    static py::object np_view_of(double* d, size_t n, PyObject* base, bool writable) {
+        npy_intp dims[1] = { npy_intp(n) };
+        return np_view_of(d, 1, dims, base, writable);
+    }
+
+    /** \return a capsule keeping keep alive, as the base object of a view */
+    static PyObject* np_owner_of(std::shared_ptr<void> keep) {
+        PyObject* c = PyCapsule_New(new np_owner{ std::move(keep) }, "shyft.np_owner", &np_owner::destroy);
+        if (!c)
+            py::throw_error_already_set();
+        return c;
+    }
+
+    py::object np_view(double* d, size_t n, std::shared_ptr<void> keep, bool writable) {
+        return np_view_of(d, n, np_owner_of(std::move(keep)), writable);
+    }
+
+    py::object np_array(vector<double>&& v) {
+        auto o = std::make_shared<vector<double>>(std::move(v));
+        return np_view(o->data(), o->size(), o, true);
+    }
+
+    py::object np_array(vector<double>&& v, size_t rows, size_t cols) {
+        if (v.size() != rows*cols)
+            throw std::runtime_error("np_array: the number of values must be rows x cols");
+        auto o = std::make_shared<vector<double>>(std::move(v));
+        npy_intp dims[2] = { npy_intp(rows), npy_intp(cols) };
+        return np_view_of(o->data(), 2, dims, np_owner_of(o), true);
+    }
+
+    vector<double> np_values(const py::object& a) {
+        PyObject* c = PyArray_FROMANY(a.ptr(), NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);// a itself if a contiguous float64 array
+        if (!c)
+            py::throw_error_already_set();
+        py::handle<> h(c);
+        const double* d = (const double*)PyArray_DATA((PyArrayObject*)c);
+        return vector<double>(d, d + PyArray_SIZE((PyArrayObject*)c));
+    }
+
+    vector<double> np_values(const py::object& a, size_t& rows, size_t& cols) {
+        PyObject* c = PyArray_FROMANY(a.ptr(), NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY);// a itself if a contiguous float64 array
+        if (!c)
+            py::throw_error_already_set();
+        py::handle<> h(c);
+        rows = size_t(PyArray_DIM((PyArrayObject*)c, 0));
+        cols = size_t(PyArray_DIM((PyArrayObject*)c, 1));
+        const double* d = (const double*)PyArray_DATA((PyArrayObject*)c);
+        return vector<double>(d, d + rows*cols);
+    }
+
+    vector<vector<double>> np_rows(const py::object& a, size_t& cols) {
+        PyObject* c = PyArray_FROMANY(a.ptr(), NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY);// a itself if a contiguous float64 array
+        if (!c)
+            py::throw_error_already_set();
+        py::handle<> h(c);
+        const size_t rows = size_t(PyArray_DIM((PyArrayObject*)c, 0));
+        cols = size_t(PyArray_DIM((PyArrayObject*)c, 1));
+        const double* d = (const double*)PyArray_DATA((PyArrayObject*)c);
+        vector<vector<double>> r; r.reserve(rows);
+        for (size_t i = 0; i < rows; ++i)
+            r.emplace_back(d + i*cols, d + (i + 1)*cols);
         return r;
     }
 
+    /** \return a writable numpy view of the vector self, with self as the base object */
+    static py::object double_vector_view(py::object self) {
+        vector<double>& v = py::extract<vector<double>&>(self);
+        Py_INCREF(self.ptr());
+        return np_view_of(v.data(), v.size(), self.ptr(), true);
+    }
+
     template <class T>
-    static void expose_vector(const char *name) {
+    static class_<std::vector<T>> expose_vector(const char *name) {
         typedef std::vector<T> XVector;
 
-        class_<XVector>(name)
+        auto c = class_<XVector>(name)
         .def(vector_indexing_suite<XVector>()) // meaning it get all it needs to appear as python list
         .def(init<const XVector&>(args("const_ref_v"))) // so we can copy construct
         .def("FromNdArray",FromNdArray<T>).staticmethod("FromNdArray") // BW compatible
@@ -92,6 +175,7 @@ namespace expose {
         ;
         numpy_boost_python_register_type<T, 1>(); // register the numpy object so we can access it in C++
         py_api::iterable_converter().from_python<XVector>();
+        return c;
     }
     static void expose_str_vector(const char *name) {
         typedef std::vector<std::string> XVector;
@@ -199,7 +283,14 @@ namespace expose {
     void vectors() {
         np_import();
         expose_str_vector("StringVector");
-        expose_vector<double>("DoubleVector");
+        expose_vector<double>("DoubleVector")
+            .def("view", double_vector_view, (py::arg("self")),
+                doc_intro("return a numpy array viewing the values of the vector, not a copy,")
+                doc_intro("so changes by either are seen by both.")
+                doc_intro("The view keeps the vector alive, and is valid while the vector keeps its size,")
+                doc_intro("take a new view after append, or other changes of the size")
+                doc_returns("values","np.ndarray","the values of the vector, float64, a view")
+            );
         expose_vector<int>("IntVector");
         expose_vector<char>("ByteVector");
         expose_vector<utctime>("UtcTimeVector");
@@ -2,12 +2,40 @@
 #include "expose_statistics.h"
 #include "api/api.h"
 #include "api/api_state.h"
+#include "core/calibration_batch.h"
 
 namespace expose {
     using namespace boost::python;
     namespace py=boost::python;
     using namespace std;
 
+    /** releases the python GIL while in scope, so that long running c++ work does not block other python threads */
+    struct gil_release {
+        gil_release() noexcept : py_thread_state(PyEval_SaveThread()) {}
+        ~gil_release() noexcept { PyEval_RestoreThread(py_thread_state); }
+        gil_release(const gil_release&) = delete;
+        gil_release& operator=(const gil_release&) = delete;
+    private:
+        PyThreadState* py_thread_state;
+    };
+
+    /** \brief without_gil<F,f>::call(o,args..) calls the member function f of o with the GIL released
+     *
+     * Use it for the long running methods that do not touch python objects, e.g.
+     *  .def("run_cells",&without_gil<decltype(&M::run_cells),&M::run_cells>::call,...)
+     * The arguments are converted before, and the result after, the call, with the GIL held.
+     */
+    template <class F, F f>
+    struct without_gil;
+
+    template <class R, class C, class... A, R (C::*f)(A...)>
+    struct without_gil<R (C::*)(A...), f> {
+        static R call(C& o, A... a) {
+            gil_release gil;
+            return (o.*f)(std::forward<A>(a)...);
+        }
+    };
+
     template <class StateIo,class state>
     static void state_io(const char *state_io_name) {
         std::string (StateIo::*to_string1)(const state& ) const = &StateIo::to_string;
@@ -40,6 +68,31 @@ namespace expose {
         return r;
     }
 
+    /** \return python bytes copied from v */
+    static py::object py_bytes(const vector<char>& v) {
+        return py::object(py::handle<>(PyBytes_FromStringAndSize(v.data(), Py_ssize_t(v.size()))));
+    }
+
+    /** \return fx(d,sz) of the contiguous bytes d[0..sz) of o, any object with the buffer protocol, like bytes */
+    template <class Fx>
+    static auto with_bytes(const py::object& o, Fx&& fx) -> decltype(fx((const char*)nullptr, size_t(0))) {
+        Py_buffer b;
+        if (PyObject_GetBuffer(o.ptr(), &b, PyBUF_SIMPLE) != 0)
+            py::throw_error_already_set();
+        struct buffer_release { Py_buffer& b; ~buffer_release() { PyBuffer_Release(&b); } } r{ b };
+        return fx((const char*)b.buf, size_t(b.len));
+    }
+
+    template <class CS>
+    static py::object states_to_flat_bytes(const std::vector<CS>& states) {
+        return py_bytes(shyft::api::state_snapshot::of_states(states));
+    }
+
+    template <class CS>
+    static std::vector<CS> states_from_flat_bytes(const py::object& b) {
+        return with_bytes(b, [](const char* d, size_t sz) { return shyft::api::state_snapshot::to_states<typename CS::cell_state_t>(d, sz); });
+    }
+
     template<class C>
     static void cell_state_etc(const char *stack_name) {
         typedef typename C::state_t cstate_t;
@@ -58,6 +111,13 @@ namespace expose {
             ;
         def("serialize", shyft::api::serialize_to_bytes<CellState>, args("states"), "make a blob out of the states");
         def("deserialize", shyft::api::deserialize_from_bytes<CellState>, args("bytes", "states"), "from a blob, fill in states");
+        def("serialize_flat", states_to_flat_bytes<CellState>, args("states"),
+            "make a flat, versioned snapshot of the states, as bytes, ref. deserialize_flat\n"
+            "a header, followed by each member of the ids and each state field as a contiguous column,\n"
+            "much faster and smaller than serialize for many cells");
+        def("deserialize_flat", states_from_flat_bytes<CellState>, args("bytes"),
+            "the states of a snapshot made by serialize_flat, from bytes or any object with the buffer protocol\n"
+            "throws runtime-error if it is not a valid snapshot of the states of this method stack");
     }
 
     template <class C>
@@ -132,6 +192,62 @@ namespace expose {
     }
 
 
+    /** the cell states and initial_state can be changed from python, so the python revert always copies all the states */
+    template <class M>
+    static void model_revert_to_initial_state(M& m) {
+        m.forget_state_changes();
+        m.revert_to_initial_state();
+    }
+
+    /** \return the current states of the cells, a 2-d numpy array, cells x state fields, in the order of state_soa pack */
+    template <class M>
+    static py::object model_get_states_array(const M& m) {
+        typedef typename shyft::api::state_soa_of<typename M::state_t>::type soa_t;
+        const auto& cells = *m.get_cells();
+        const size_t nf = soa_t::n_fields;
+        vector<double> v(cells.size()*nf);
+        for (size_t i = 0; i < cells.size(); ++i)
+            soa_t::pack(cells[i].state, v.data() + i*nf);
+        return np_array(std::move(v), cells.size(), nf);
+    }
+
+    /** set the current states of the cells from a 2-d array, as model_get_states_array, ref. region_model::set_states */
+    template <class M>
+    static void model_set_states_array(M& m, const py::object& a) {
+        typedef typename shyft::api::state_soa_of<typename M::state_t>::type soa_t;
+        size_t n = 0, nf = 0;
+        const auto v = np_values(a, n, nf);
+        if (nf != soa_t::n_fields)
+            throw runtime_error("set_states_array: the states array must have " + to_string(soa_t::n_fields) + " columns, one for each state field");
+        vector<typename M::state_t> states(n);
+        for (size_t i = 0; i < n; ++i)
+            soa_t::unpack(v.data() + i*nf, states[i]);
+        m.set_states(states);
+    }
+
+    /** \return the snapshot, as python bytes, of the current states of the cells, ref. state_snapshot::of_cells */
+    template <class M>
+    static py::object model_get_states_snapshot(const M& m) {
+        return py_bytes(shyft::api::state_snapshot::of_cells(*m.get_cells()));
+    }
+
+    /** set the current states of the cells from the snapshot of model_get_states_snapshot, ref. region_model::set_states */
+    template <class M>
+    static void model_set_states_snapshot(M& m, const py::object& b) {
+        m.set_states(with_bytes(b, [&m](const char* d, size_t sz) { return shyft::api::state_snapshot::to_cell_states(d, sz, *m.get_cells()); }));
+    }
+
+    /** \return the original_cell_index of the model, as int, ref. region_model::order_cells_spatially */
+    template <class M>
+    static vector<int> model_original_cell_index(const M& m) {
+        return vector<int>(m.original_cell_index.begin(), m.original_cell_index.end());
+    }
+
+    template <class M>
+    static vector<string> model_state_array_fields() {
+        return shyft::api::state_soa_of<typename M::state_t>::type::field_names();
+    }
+
     template <class M>
     static void model(const char *model_name,const char *model_doc) {
         char m_doc[5000];
@@ -159,12 +275,28 @@ namespace expose {
                         "determines how many core to utilize during run_cell processing,\n"
                         "0(=default) means detect by hardware probe"
                         )
+         .def_readwrite("autotune_threads",&M::autotune_threads,
+                        "if true, run_cells with use_ncore=0 tunes ncore and the cell chunk size for the cell type, number of cells and machine,\n"
+                        "each of the first runs measures one thread-count/chunk-size combination, then the fastest is used, default false,\n"
+                        "ref. autotune_set_file to keep the choice between the processes"
+                        )
+         .def_readwrite("hru_deduplication",&M::hru_deduplication,
+                        "if true, run_cells simulates each set of identical cells (same parameter, geo, environment and state) once,\n"
+                        "and copies, or for catchment collectors scales by area, the result to the others, default false"
+                        )
+         .def_readonly("stack_counters",&M::stack_counters,
+                        "MethodStackCounters, cycles and calls of the method stack routines of the last run_cells,\n"
+                        "counted only if method_stack_profiling_enabled()"
+                        )
          .def_readwrite("region_env",&M::region_env,"empty or the region_env as passed to run_interpolation() or interpolate()")
          .def_readwrite("river_network",&M::river_network,
                         "river network that when enabled do the routing part of the region-model\n"
                         "See also RiverNetwork class for how to build a working river network\n"
                         "Then use the connect_catchment_to_river(cid,rid) method\n"
                         "to route cell discharge into the river-network\n")
+         .def_readwrite("routing_state",&M::routing_state,
+                        "RoutingState at the end of the last run_cells, set it before run_cells to continue the routing\n"
+                        "from the time of the state, or set an empty RoutingState() to route from a cold start\n")
          .def("has_routing",&M::has_routing,(py::arg("self")),"true if some cells routes to river-network")
          .def("river_output_flow_m3s",&M::river_output_flow_m3s,(py::arg("self"),py::arg("rid")),"returns the routed output flow of the specified river id (rid))")
          .def("river_upstream_inflow_m3s",&M::river_upstream_inflow_m3s, (py::arg("self"), py::arg("rid")),"returns the routed upstream inflow to the specified river id (rid))")
@@ -180,6 +312,10 @@ namespace expose {
          "\t river identifier, can be set to 0 to indicate disconnect from routing"
          )
          .def("number_of_catchments",&M::number_of_catchments, (py::arg("self")),"compute and return number of catchments using info in cells.geo.catchment_id()")
+         .def("memory_usage",&M::memory_usage,(py::arg("self")),
+                doc_intro("approx. bytes used by the model, by part, the cells, env_ts, collectors, states and caches")
+                doc_returns("memory_usage","ModelMemoryUsage","the bytes of each part")
+         )
 		 .def("extract_geo_cell_data",&M::extract_geo_cell_data,(py::arg("self")),
              "extracts the geo_cell_data and return it as GeoCellDataVector that can\n"
              "be passed into a the constructor of a new region-model (clone-operation)\n"
@@ -201,7 +337,7 @@ namespace expose {
                 doc_parameter("time_axis","TimeAxisFixedDeltaT","specifies the time-axis for the region-model, and thus the cells")
                 doc_returns("nothing","","")
 		 )
-		 .def("interpolate", interpolate_f, (py::arg("self"),py::arg("interpolation_parameter"),py::arg("env"),py::arg("best_effort")=true),
+		 .def("interpolate", &without_gil<decltype(interpolate_f), &M::interpolate>::call, (py::arg("self"),py::arg("interpolation_parameter"),py::arg("env"),py::arg("best_effort")=true),
                 doc_intro("do interpolation interpolates region_environment temp,precip,rad.. point sources")
                 doc_intro("to a value representative for the cell.mid_point().")
                 doc_intro("")
@@ -216,17 +352,18 @@ namespace expose {
                 doc_parameter("best_effort","bool","default=True, don't throw, just return True/False if problem, with best_effort, unfilled values is nan")
                 doc_returns("success","bool","True if interpolation runs with no exceptions(btk,raises if to few neighbours)")
 		 )
-         .def("run_cells",&M::run_cells,(py::arg("self"),py::arg("use_ncore")=0,py::arg("start_step")=0,py::arg("n_steps")=0),
+         .def("run_cells",&without_gil<decltype(&M::run_cells),&M::run_cells>::call,(py::arg("self"),py::arg("use_ncore")=0,py::arg("start_step")=0,py::arg("n_steps")=0),
                 doc_intro("run_cells calculations over specified time_axis,optionally with thread_cell_count, start_step and n_steps")
                 doc_intro("require that initialize(time_axis) or run_interpolation is done first")
                 doc_intro("If start_step and n_steps are specified, only the specified part of the time-axis is covered.")
                 doc_intro("notice that in any case, the current model state is used as a starting point")
+                doc_intro("The python GIL is released while running, so other python threads, e.g. running other models, are not blocked")
                 doc_parameters()
                 doc_parameter("use_ncore","int","number of worker threads, or cores to use, if 0 is passed, the the core-count is used to determine the count")
                 doc_parameter("start_step","int","start_step in the time-axis to start at, default=0, meaning start at the beginning")
                 doc_parameter("n_steps","int","number of steps to run in a partial run, default=0 indicating the complete time-axis is covered")
          )
-         .def("run_interpolation",run_interpolation_f,(py::arg("self"),py::arg("interpolation_parameter"),py::arg("time_axis"),py::arg("env"),py::arg("best_effort")=true),
+         .def("run_interpolation",&without_gil<decltype(run_interpolation_f),&M::run_interpolation>::call,(py::arg("self"),py::arg("interpolation_parameter"),py::arg("time_axis"),py::arg("env"),py::arg("best_effort")=true),
                 doc_intro("run_interpolation interpolates region_environment temp,precip,rad.. point sources")
                 doc_intro("to a value representative for the cell.mid_point().")
                 doc_intro("")
@@ -273,6 +410,23 @@ namespace expose {
                  "param catchment_id_list is a catchment id vector\n"
                 "param river_id_list is a river id vector\n"
          )
+         .def("fork",&M::fork,(py::arg("self")),
+                    "returns a what-if scenario fork of the model, with its own parameters and states,\n"
+                    "that runs with the interpolated environment of the cells of this model, instead of a copy.\n"
+                    "Forks can run concurrently, as long as this model is not changed meanwhile.\n"
+                    "Interpolation on the fork gives it its own environment, like a copy.\n"
+         )
+         .def("shares_environment",&M::shares_environment,(py::arg("self")),"true if the model is a fork that runs with the environment of its base model")
+         .def("order_cells_spatially",&M::order_cells_spatially,(py::arg("self")),
+                    "reorder the cells, grouped by catchment, along a hilbert curve over their mid-points,\n"
+                    "so that nearby cells are close in memory, improving the speed of interpolation and run_cells.\n"
+                    "The cells are permuted in place, the states and calculation filter follow the cells,\n"
+                    "the checkpoints and cached idw-neighbours are dropped.\n"
+                    "Results by cell, like get_states, are in the new order, ref. original_cell_index.\n"
+         )
+         .add_property("original_cell_index",&model_original_cell_index<M>,
+                    "IntVector, empty, or after order_cells_spatially, the index, in the cells as passed, of each cell\n"
+         )
          .def("is_calculated",&M::is_calculated,(py::arg("self"),py::arg("catchment_id")),"true if catchment id is calculated during runs, ref set_catchment_calculation_filter")
          .def("get_states",&M::get_states,(py::arg("self"),py::arg("end_states")),
                     "collects current state from all the cells\n"
@@ -285,7 +439,33 @@ namespace expose {
                     "states is a vector<state_t> of all states, must match size/order of cells.\n"
                     "note throws runtime-error if states.size is different from cells.size\n"
         )
-        .def("revert_to_initial_state",&M::revert_to_initial_state,(py::arg("self")),
+        .def("get_states_array",&model_get_states_array<M>,(py::arg("self")),
+                doc_intro("collects the current state of all the cells, in one call, as a 2-d numpy array")
+                doc_intro("with a row for each cell, in order of appearance, and a column for each state field, ref. state_array_fields()")
+                doc_returns("states","np.ndarray","float64 array of shape (cells, state fields)")
+        )
+        .def("set_states_array",&model_set_states_array<M>,(py::arg("self"),py::arg("states")),
+                doc_intro("set the current state of all the cells, in one call, from a 2-d array, as given by get_states_array()")
+                doc_intro("note throws runtime-error if the number of rows is different from cells.size, like set_states")
+                doc_parameters()
+                doc_parameter("states","np.ndarray","array of shape (cells, state fields), ref. state_array_fields()")
+        )
+        .def("get_states_snapshot",&model_get_states_snapshot<M>,(py::arg("self")),
+                doc_intro("collects the current state of all the cells as a flat, versioned snapshot, ref. serialize_flat")
+                doc_intro("with the cell state id of each cell, so it can only be applied to the same cells")
+                doc_returns("snapshot","bytes","the states of the cells, in order of appearance")
+        )
+        .def("set_states_snapshot",&model_set_states_snapshot<M>,(py::arg("self"),py::arg("snapshot")),
+                doc_intro("set the current state of all the cells from a snapshot of get_states_snapshot()")
+                doc_intro("note throws runtime-error if the snapshot is not of this method stack, or not of these cells, in this order")
+                doc_parameters()
+                doc_parameter("snapshot","bytes","as returned by get_states_snapshot()")
+        )
+        .def("state_array_fields",&model_state_array_fields<M>,
+                doc_intro("the names of the state fields, the columns of get_states_array() and set_states_array()")
+        )
+        .staticmethod("state_array_fields")
+        .def("revert_to_initial_state",&model_revert_to_initial_state<M>,(py::arg("self")),
              "Given that the cell initial_states are established, these are \n"
              "copied back into the cells\n"
              "Note that the cell initial_states vector is established at the first call to \n"
@@ -347,6 +527,18 @@ namespace expose {
 			 doc_parameter("cids","IntVector"," catchments, represented by catchment-ids that should be adjusted")
 			 doc_returns("obtained flow in m3/s units.","float","note: this can deviate from wanted flow due to model and state constraints")
         )
+        .def("adjust_state_to_target_flows",&M::adjust_state_to_target_flows,(py::arg("self"),py::arg("wanted_flow_m3s"),py::arg("cids"),py::arg("start_step")=0),
+             doc_intro("state adjustment to achieve the wanted/observed flow of each catchment")
+             doc_intro("")
+             doc_intro("As adjust_state_to_target_flow, but each catchment of cids is tuned to its own flow,")
+             doc_intro("and all catchments are solved together, so that each iteration of the search is")
+             doc_intro("one time-step run of the selected cells, using a bracketing secant search for each catchment.")
+             doc_parameters()
+             doc_parameter("wanted_flow_m3s","DoubleVector","the average flow first time-step we want to achieve, one for each of cids")
+             doc_parameter("cids","IntVector","catchments, represented by catchment-ids that should be adjusted")
+             doc_parameter("start_step","int","the time_axis start-step/period to use during adjustment")
+             doc_returns("obtained flows in m3/s units","DoubleVector","one for each of cids, this can deviate from wanted flow due to model and state constraints")
+        )
         .def("get_cells",&M::get_cells, (py::arg("self")),"cells as shared_ptr<vector<cell_t>>")
         .def("size",&M::size,(py::arg("self")),"return number of cells")
         .add_property("cells",&M::get_cells,"cells of the model")
@@ -362,6 +554,7 @@ namespace expose {
         o.region_env = f.region_env;
         o.initial_state = f.initial_state;
         o.river_network = f.river_network;
+        o.routing_state = f.routing_state;
         auto fc = f.get_cells();
         auto oc = o.get_cells();
         for (size_t i = 0;i < f.size();++i) {
@@ -385,6 +578,73 @@ namespace expose {
     }
 
 
+    template <class Batch>
+    static void calibration_batch_run(Batch& b, size_t n_parallel) {
+        gil_release gil;
+        b.run(n_parallel);
+    }
+
+    /** set_warm_start from the parameter sets concatenated in p_flat, like a saved copy of the trace_parameter values */
+    template <class Optimizer>
+    static void optimizer_set_warm_start(Optimizer& o, const std::vector<double>& p_flat, const std::vector<double>& fs, bool reuse_fs) {
+        typedef typename Optimizer::parameter_t parameter_t;
+        const size_t n = parameter_t().size();
+        if (p_flat.size() % n)
+            throw std::runtime_error("set_warm_start: the size of the parameter values must be a multiple of the parameter size");
+        std::vector<parameter_t> ps(p_flat.size()/n);
+        for (size_t j = 0; j < ps.size(); ++j)
+            ps[j].set(std::vector<double>(p_flat.begin() + j*n, p_flat.begin() + (j + 1)*n));
+        o.set_warm_start(ps, fs, reuse_fs);
+    }
+
+    template <class Optimizer>
+    static void calibration_batch(const char* batch_name) {
+        typedef shyft::core::model_calibration::calibration_batch<typename Optimizer::region_model_t,
+            typename Optimizer::parameter_t, typename Optimizer::target_time_series_t> Batch;
+        class_<Batch, boost::noncopyable>(batch_name,
+            doc_intro("Runs a batch of independent calibrations, like a multi-start search, concurrently on the shyft thread pool.")
+            doc_intro("Each job has its own model, target specification, parameter bounds, start point and OptimizerMethod,")
+            doc_intro("and is done by its own optimizer. Use .run(n_parallel) to run the pending jobs, at most n_parallel at the time.")
+            doc_intro("The python GIL is released while running, so other python threads can follow the progress")
+            doc_intro("with .n_evaluations(i) and .status(i), and .cancel(i) jobs.")
+        )
+        .def("add_job", &Batch::add_job, with_custodian_and_ward<1, 2>(),
+            (py::arg("self"), py::arg("model"), py::arg("targets"), py::arg("p_min"), py::arg("p_max"), py::arg("p_start"),
+             py::arg("method"), py::arg("max_n_evaluations")=1500),
+            doc_intro("add a calibration job to the batch, the model is kept as a reference, and can not be shared with other jobs")
+            doc_intro("Use clone_to_similar_model to get one model for each job.")
+            doc_parameters()
+            doc_parameter("model", "XXXXOptModel", "the model to calibrate, the interpolation step done")
+            doc_parameter("targets", "TargetSpecificationVector", "the target specification of the goal function")
+            doc_parameter("p_min", "XXXXParameter", "lower bound of the parameters, parameters with p_min==p_max are not optimized")
+            doc_parameter("p_max", "XXXXParameter", "upper bound of the parameters")
+            doc_parameter("p_start", "XXXXParameter", "start point of the search")
+            doc_parameter("method", "OptimizerMethod", "BOBYQA, SCEUA, DREAM or PATTERN_SEARCH, with the default stop criteria")
+            doc_parameter("max_n_evaluations", "int", "max number of goal function evaluations")
+            doc_returns("index", "int", "the index of the job")
+        )
+        .def("run", &calibration_batch_run<Batch>, (py::arg("self"), py::arg("n_parallel")=0),
+            doc_intro("run the pending jobs, at most n_parallel at the same time, 0 means the size of the thread pool")
+            doc_intro("Returns when all jobs are done, failed or cancelled.")
+        )
+        .def("cancel", &Batch::cancel, (py::arg("self"), py::arg("i")),
+            doc_intro("cancel job i, a pending job is skipped, a running job stops at its next goal function evaluation")
+        )
+        .def("cancel_all", &Batch::cancel_all, doc_intro("cancel all jobs"))
+        .def("size", &Batch::size, doc_intro("the number of jobs"))
+        .def("status", &Batch::status, (py::arg("self"), py::arg("i")), doc_intro("the CalibrationStatus of job i"))
+        .def("n_evaluations", &Batch::n_evaluations, (py::arg("self"), py::arg("i")),
+            doc_intro("the number of goal function evaluations done by job i, the progress")
+        )
+        .def("max_n_evaluations", &Batch::max_n_evaluations, (py::arg("self"), py::arg("i")), doc_intro("the max number of evaluations of job i"))
+        .def("result", &Batch::result, (py::arg("self"), py::arg("i")), doc_intro("the optimized parameters of job i, when DONE"))
+        .def("goal_function", &Batch::goal_function, (py::arg("self"), py::arg("i")),
+            doc_intro("the goal function value of the result of job i, nan unless DONE")
+        )
+        .def("error", &Batch::error, (py::arg("self"), py::arg("i")), doc_intro("the error message of job i, when FAILED"))
+        .def("best", &Batch::best, doc_intro("the index of the done job with the smallest goal function, or size() if none is done"))
+        ;
+    }
 
     template<class RegionModel>
     static void
@@ -405,6 +665,9 @@ namespace expose {
         std::vector<double> (Optimizer::*optimize_sceua_v)(const std::vector<double>&,size_t,double,double)=&Optimizer::optimize_sceua;
         parameter_t(Optimizer::*optimize_sceua_p)(const parameter_t&, size_t, double, double) = &Optimizer::optimize_sceua;
 
+        std::vector<double>(Optimizer::*optimize_pattern_search_v)(const std::vector<double>&, size_t, double, double) = &Optimizer::optimize_pattern_search;
+        parameter_t(Optimizer::*optimize_pattern_search_p)(const parameter_t&, size_t, double, double) = &Optimizer::optimize_pattern_search;
+
         double (Optimizer::*calculate_goal_function_v)(const std::vector<double>&) = &Optimizer::calculate_goal_function;
         double (Optimizer::*calculate_goal_function_p)(const parameter_t&) = &Optimizer::calculate_goal_function;
 
@@ -423,6 +686,7 @@ namespace expose {
             "The search for optimium starts with the current parameter-set, the current start state, over the specified model time-axis.\n"
             "After a run, the goal function is calculated and returned back to the minbobyqa algorithm that continue searching for the minimum\n"
             "value until tolerances/iterations area reached.\n"
+            "The python GIL is released while optimizing, so other python threads are not blocked.\n"
             ,no_init
         )
         .def(init< RegionModel&,
@@ -467,7 +731,7 @@ namespace expose {
             "call one of the optimize methods.\n"
         )
         .def("get_initial_state",&Optimizer::get_initial_state,args("i"),"get a copy of the i'th cells initial state")
-        .def("optimize",optimize_v,args("p","max_n_evaluations","tr_start","tr_stop"),
+        .def("optimize",&without_gil<decltype(optimize_v),&Optimizer::optimize>::call,args("p","max_n_evaluations","tr_start","tr_stop"),
                 "(deprecated)Call to optimize model, starting with p parameter set, using p_min..p_max as boundaries.\n"
                 "where p is the full parameter vector.\n"
                 "the p_min,p_max specified in constructor is used to reduce the parameterspace for the optimizer\n"
@@ -478,7 +742,7 @@ namespace expose {
                 "param tr_stop is the trust region stop, default 1e-5, ref bobyqa\n"
                 "return the optimized parameter vector\n"
         )
-        .def("optimize", optimize_p, args("p", "max_n_evaluations", "tr_start", "tr_stop"),
+        .def("optimize", &without_gil<decltype(optimize_p), &Optimizer::optimize>::call, args("p", "max_n_evaluations", "tr_start", "tr_stop"),
             "Call to optimize model, starting with p parameters\n"
             "as the start point\n"
             "The current target specification, parameter lower and upper bound\n"
@@ -490,7 +754,7 @@ namespace expose {
             "return the optimized parameters\n"
         )
 
-        .def("optimize_dream",optimize_dream_v,args("p","max_n_evaluations"),
+        .def("optimize_dream",&without_gil<decltype(optimize_dream_v),&Optimizer::optimize_dream>::call,args("p","max_n_evaluations"),
                 "Call to optimize model, using DREAM alg., find p, using p_min..p_max as boundaries.\n"
                 "where p is the full parameter vector.\n"
                 "the p_min,p_max specified in constructor is used to reduce the parameterspace for the optimizer\n"
@@ -499,7 +763,7 @@ namespace expose {
                 "param max_n_evaluations stop after n calls of the objective functions, i.e. simulations.\n"
                 "return the optimized parameter vector\n"
         )
-        .def("optimize_dream", optimize_dream_p, args("p", "max_n_evaluations"),
+        .def("optimize_dream", &without_gil<decltype(optimize_dream_p), &Optimizer::optimize_dream>::call, args("p", "max_n_evaluations"),
             "Call to optimize model with the DREAM algorithm.\n"
             "Currently, the supplied p is ignored (DREAM selects starting point randomly)\n"
             "The current target specification, parameter lower and upper bound\n"
@@ -509,7 +773,7 @@ namespace expose {
             "return the optimized parameter vector\n"
         )
 
-        .def("optimize_sceua",optimize_sceua_v,args("p","max_n_evaluations","x_eps","y_eps"),
+        .def("optimize_sceua",&without_gil<decltype(optimize_sceua_v),&Optimizer::optimize_sceua>::call,args("p","max_n_evaluations","x_eps","y_eps"),
                 "Call to optimize model, using SCE UA, using p as startpoint, find p, using p_min..p_max as boundaries.\n"
                 "where p is the full parameter vector.\n"
                 "the p_min,p_max specified in constructor is used to reduce the parameter-space for the optimizer\n"
@@ -520,7 +784,7 @@ namespace expose {
                 "param y_eps is stop condition, and search is stopped when goal function does not improve anymore within this range\n"
                 "return the optimized parameter vector\n"
         )
-        .def("optimize_sceua", optimize_sceua_p, args("p", "max_n_evaluations", "x_eps", "y_eps"),
+        .def("optimize_sceua", &without_gil<decltype(optimize_sceua_p), &Optimizer::optimize_sceua>::call, args("p", "max_n_evaluations", "x_eps", "y_eps"),
             "Call to optimize model using SCE UA algorithm, starting with p parameters\n"
             "as the start point\n"
             "The current target specification, parameter lower and upper bound\n"
@@ -531,11 +795,77 @@ namespace expose {
             "param y_eps is stop condition, and search is stopped when goal function does not improve anymore within this range\n"
             "return the optimized parameter vector\n"
         )
+        .def("optimize_pattern_search", &without_gil<decltype(optimize_pattern_search_v), &Optimizer::optimize_pattern_search>::call, args("p", "max_n_evaluations", "tr_start", "tr_stop"),
+            "Call to optimize model with the parallel pattern search, a local method like optimize, starting at p\n"
+            "Each iteration polls 2n points around the current best, for n optimized parameters, and runs them\n"
+            "concurrently on the model and its replicas, ref. set_concurrent_evaluations, so unlike optimize,\n"
+            "that runs one simulation at the time, all the replicas are busy.\n"
+            "param p contains the starting point for the parameters\n"
+            "param max_n_evaluations stop after n calls of the objective functions, i.e. simulations.\n"
+            "param tr_start is the initial step, in the scaled 0..1 parameter range, default 0.1\n"
+            "param tr_stop stop when the step is below this, default 1e-5\n"
+            "return the optimized parameter vector\n"
+        )
+        .def("optimize_pattern_search", &without_gil<decltype(optimize_pattern_search_p), &Optimizer::optimize_pattern_search>::call, args("p", "max_n_evaluations", "tr_start", "tr_stop"),
+            "Call to optimize model with the parallel pattern search, starting with p parameters as the start point\n"
+            "The current target specification, parameter lower and upper bound is taken into account\n"
+            "param p contains the starting point for the parameters\n"
+            "param max_n_evaluations stop after n calls of the objective functions, i.e. simulations.\n"
+            "param tr_start is the initial step, in the scaled 0..1 parameter range, default 0.1\n"
+            "param tr_stop stop when the step is below this, default 1e-5\n"
+            "return the optimized parameters\n"
+        )
 
         .def("reset_states",&Optimizer::reset_states,"reset the state of the model to the initial state before starting the run/optimize")
         .def("set_parameter_ranges",&Optimizer::set_parameter_ranges,args("p_min","p_max"),"set the parameter ranges, set min=max=wanted parameter value for those not subject to change during optimization")
         .def("set_verbose_level",&Optimizer::set_verbose_level,args("level"),"set verbose level on stdout during calibration,0 is silent,1 is more etc.")
-        .def("calculate_goal_function",calculate_goal_function_v,args("full_vector_of_parameters"),
+        .def("set_concurrent_evaluations",&Optimizer::set_concurrent_evaluations,args("k"),
+            "set the number of parameter sets that optimize_dream, optimize_sceua and optimize_pattern_search evaluate concurrently, default 1\n"
+            "With k > 1, the model is copied into k-1 replicas when optimization starts, and the candidates\n"
+            "of the sceua complexes, dream chains, or pattern search polls, are evaluated k at the time, one on each model.\n"
+            "Notice that the replicas are full copies of the model, so memory use grows with k.\n"
+        )
+        .def("set_early_termination",&Optimizer::set_early_termination,args("n"),
+            "let optimize_sceua stop the runs of candidates that can not be accepted, default 0(off)\n"
+            "With n > 1, the candidates are run n segments of the time-axis at the time, and stopped as soon as\n"
+            "the goal function of the completed target periods shows that they can not beat the worst point of the complex.\n"
+            "The result of the optimization is unchanged, but the goal_fn_trace of stopped candidates holds a lower bound.\n"
+        )
+        .def("set_surrogate_screening",&Optimizer::set_surrogate_screening,(py::arg("self"),py::arg("min_samples"),py::arg("margin")=0.1,py::arg("max_samples")=200),
+            "let a surrogate of the goal function screen out candidates of optimize_sceua and optimize, without running the model, default off\n"
+            "When the trace holds min_samples evaluations, a cubic rbf surrogate is fitted to the latest max_samples of them,\n"
+            "and candidates predicted worse than needed, by margin x the range of the fitted goal function values, are not run.\n"
+            "Screened candidates are not traced. min_samples=0 turns screening off.\n"
+        )
+        .def("set_warm_start_from_trace",&Optimizer::set_warm_start_from_trace,(py::arg("self"),py::arg("reuse_goal_function_values")=false),
+            "warm start the following optimize_sceua and optimize_dream calls from the current trace, before it is cleared by them\n"
+            "Up to half of the initial sceua sample, or of the dream chains, then start at the best distinct parameters of the trace,\n"
+            "and the rest are random as usual, so re-calibrations after small changes, like a longer period, converge faster.\n"
+            "With reuse_goal_function_values=True, the model and targets must be unchanged, and the picked points are not run again.\n"
+        )
+        .def("set_warm_start",&optimizer_set_warm_start<Optimizer>,(py::arg("self"),py::arg("parameter_values"),py::arg("goal_function_values"),py::arg("reuse_goal_function_values")=false),
+            "warm start the following optimize_sceua and optimize_dream calls, as set_warm_start_from_trace, from saved trace values\n"
+            "parameter_values are the full parameter vectors concatenated, goal_function_values the corresponding values, or empty if unknown\n"
+        )
+        .def("clear_warm_start",&Optimizer::clear_warm_start,"clear the warm start, so the optimizers start from random points again")
+        .def("surrogate_screened",&Optimizer::surrogate_screened,"the number of candidates screened out by the surrogate since the optimization started")
+        .def("optimize_staged",&without_gil<decltype(&Optimizer::optimize_staged),&Optimizer::optimize_staged>::call,(py::arg("self"),py::arg("p"),py::arg("stages")),
+            "optimize in stages, each on a shorter period, or coarser targets, than the next, ending with the full period\n"
+            "Each stage, ref. CalibrationStage, runs its optimizer method on the stage period and target resolution,\n"
+            "starting at the result of the previous stage, and sceua and dream are warm started from its trace.\n"
+            "The targets and parameter bounds stay as set, the traces are those of the last stage.\n"
+            "returns the optimized parameters of the last stage\n"
+        )
+        .def("set_evaluation_cache",&Optimizer::set_evaluation_cache,(py::arg("self"),py::arg("resolution"),py::arg("max_size")=100000),
+            "let the optimizers reuse the goal function of parameter sets already evaluated, default off\n"
+            "The values are kept by the scaled [0..1] optimized parameters, rounded to multiples of resolution, e.g. 1e-6,\n"
+            "and candidates with the same key are not run, nor traced, again. The cache is cleared when an optimization starts,\n"
+            "and at most max_size values are kept. resolution=0 turns the cache off.\n"
+        )
+        .def("evaluation_cache_hits",&Optimizer::evaluation_cache_hits,"the number of evaluations answered by the cache since the optimization started")
+        .def("evaluation_cache_misses",&Optimizer::evaluation_cache_misses,"the number of evaluations not found in the cache since the optimization started")
+        .def("evaluation_cache_size",&Optimizer::evaluation_cache_size,"the number of goal function values in the cache")
+        .def("calculate_goal_function",&without_gil<decltype(calculate_goal_function_v),&Optimizer::calculate_goal_function>::call,args("full_vector_of_parameters"),
                 "(deprecated)calculate the goal_function as used by minbobyqa,etc.,\n"
                 "using the full set of  parameters vectors (as passed to optimize())\n"
                 "and also ensures that the shyft state/cell/catchment result is consistent\n"
@@ -543,7 +873,7 @@ namespace expose {
                 "param full_vector_of_parameters contains all parameters that will be applied to the run.\n"
                 "returns the goal-function, weigthed nash_sutcliffe|Kling-Gupta sum \n"
         )
-        .def("calculate_goal_function", calculate_goal_function_p, args("parameters"),
+        .def("calculate_goal_function", &without_gil<decltype(calculate_goal_function_p), &Optimizer::calculate_goal_function>::call, args("parameters"),
             "calculate the goal_function as used by minbobyqa,etc.,\n"
             "using the supplied set of parameters\n"
             "and also ensures that the shyft state/cell/catchment result is consistent\n"
@@ -573,7 +903,20 @@ namespace expose {
             doc_intro("i'th trace_goal_function value")
             doc_see_also("trace_goal_function,trace_size")
         )
+        .def("optimize_pareto",&Optimizer::optimize_pareto,(py::arg("self"),py::arg("p"),py::arg("max_n_evaluations")=1500,py::arg("epsilon")=vector<double>(),py::arg("population_size")=0),
+            doc_intro("multi-objective optimization, searching the trade-offs between the targets in one optimization")
+            doc_intro("The goal function of each target, computed from the same run, is one objective, and the eps-moea")
+            doc_intro("optimizer keeps the non-dominated parameters, at the resolution epsilon, in the pareto front.")
+            doc_intro("epsilon is one value for all targets, or one for each, default 0.01, and population_size=0 means")
+            doc_intro("10 times the number of optimized parameters, at least 20. Returns the size of the pareto front.")
+            doc_see_also("pareto_parameter,pareto_goal_function,pareto_size")
+        )
+        .def("pareto_size",&Optimizer::pareto_size,doc_intro("returns the size of the pareto front of the last optimize_pareto"))
+        .def("pareto_parameter",&Optimizer::pareto_parameter,args("i"),doc_intro("returns the i'th parameter of the pareto front"))
+        .def("pareto_goal_function",&Optimizer::pareto_goal_function,args("i"),
+            doc_intro("returns the goal function of each target of the i'th parameter of the pareto front")
+        )
         ;
-
+        calibration_batch<Optimizer>((std::string(optimizer_name) + "Batch").c_str());
     }
 }
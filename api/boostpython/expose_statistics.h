@@ -1,4 +1,5 @@
 #pragma once
+#include "numpy_view.h"
 
 namespace expose {
     namespace statistics {
@@ -8,6 +9,13 @@ namespace expose {
         typedef size_t ix_;
         using namespace boost::python;
 
+        /** \return the matrix of the feature f, a 2-d numpy array, cells x timesteps, ref. cell_statistics::catchment_feature_matrix */
+        template<class S, shyft::core::cell_feature_matrix (S::*f)(cids_) const>
+        static object feature_matrix(const S& s, cids_ catchment_indexes) {
+            auto m = (s.*f)(catchment_indexes);
+            return np_array(std::move(m.v), m.n_cells, m.n_steps);
+        }
+
         template<class cell>
         static void kirchner(const char *cell_name) {
             char state_name[200];sprintf(state_name,"%sKirchnerStateStatistics",cell_name);
@@ -19,6 +27,7 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct Kirchner cell response statistics object"))
                 .def("discharge",discharge_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("discharge",discharge_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("discharge_matrix",&feature_matrix<sc_stat,&sc_stat::discharge_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("discharge_value",&sc_stat::discharge_value, args("catchment_indexes", "i"), "returns sum discharge[m3/s]  for cells matching catchments_ids at the i'th timestep")
             ;
         }
@@ -34,6 +43,7 @@ namespace expose {
 				.def(init<std::shared_ptr<std::vector<cell>> >(args("cells"), "construct Kirchner cell response statistics object"))
 				.def("discharge", discharge_ts, args("catchment_indexes"), "returns sum  for catcment_ids")
 				.def("discharge", discharge_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
+				.def("discharge_matrix",&feature_matrix<sc_stat,&sc_stat::discharge_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("discharge_value", &sc_stat::discharge_value, args("catchment_indexes", "i"), "returns sum discharge[m3/s]  for cells matching catchments_ids at the i'th timestep")
 				;
 		}
@@ -49,6 +59,7 @@ namespace expose {
 				.def(init<std::shared_ptr<std::vector<cell>> >(args("cells"), "construct Kirchner cell response statistics object"))
 				.def("discharge", discharge_ts, args("catchment_indexes"), "returns sum  for catcment_ids")
 				.def("discharge", discharge_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
+				.def("discharge_matrix",&feature_matrix<sc_stat,&sc_stat::discharge_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("discharge_value", &sc_stat::discharge_value, args("catchment_indexes", "i"), "returns sum discharge[m3/s]  for cells matching catchments_ids at the i'th timestep")
 				;
 		}
@@ -64,6 +75,7 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct PriestleyTaylor cell response statistics object"))
                 .def("output",output_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("output",output_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("output_matrix",&feature_matrix<rc_stat,&rc_stat::output_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("output_value", &rc_stat::output_value, args("catchment_indexes", "i"), "returns for cells matching catchments_ids at the i'th timestep")
             ;
         }
@@ -81,9 +93,11 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct ActualEvapotranspiration cell response statistics object"))
                 .def("output",output_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("output",output_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("output_matrix",&feature_matrix<rc_stat,&rc_stat::output_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("output_value", &rc_stat::output_value, args("catchment_indexes", "i"), "returns for cells matching catchments_ids at the i'th timestep")
                 .def("pot_ratio",pot_ratio_ts,args("catchment_indexes"), "returns the avg ratio (1-exp(-water_level*3/scale_factor)) for catcment_ids")
                 .def("pot_ratio",pot_ratio_vd,args("catchment_indexes","i"),"returns the ratio the ratio (1-exp(-water_level*3/scale_factor)) for cells matching catchments_ids at the i'th timestep")
+                .def("pot_ratio_matrix",&feature_matrix<rc_stat,&rc_stat::pot_ratio_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("pot_ratio_value", &rc_stat::pot_ratio_value, args("catchment_indexes", "i"), "returns the ratio avg (1-exp(-water_level*3/scale_factor)) value for cells matching catchments_ids at the i'th timestep")
 				;
         }
@@ -98,6 +112,7 @@ namespace expose {
 				.def(init<std::shared_ptr<std::vector<cell>> >(args("cells"), "construct HbvActualEvapotranspiration cell response statistics object"))
 				.def("output", output_ts, args("catchment_indexes"), "returns sum  for catcment_ids")
 				.def("output", output_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
+				.def("output_matrix",&feature_matrix<rc_stat,&rc_stat::output_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("output_value", &rc_stat::output_value, args("catchment_indexes", "i"), "returns for cells matching catchments_ids at the i'th timestep")
 				;
 		}
@@ -138,27 +153,35 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct GammaSnow cell state statistics object"))
                 .def("albedo",albedo_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("albedo",albedo_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("albedo_matrix",&feature_matrix<sc_stat,&sc_stat::albedo_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("albedo_value", &sc_stat::albedo_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("lwc",lwc_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("lwc",lwc_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("lwc_matrix",&feature_matrix<sc_stat,&sc_stat::lwc_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("lwc_value", &sc_stat::lwc_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("surface_heat",surface_heat_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("surface_heat",surface_heat_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("surface_heat_matrix",&feature_matrix<sc_stat,&sc_stat::surface_heat_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("surface_heat_value", &sc_stat::surface_heat_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("alpha",alpha_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("alpha",alpha_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("alpha_matrix",&feature_matrix<sc_stat,&sc_stat::alpha_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("alpha_value", &sc_stat::alpha_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("sdc_melt_mean",sdc_melt_mean_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("sdc_melt_mean",sdc_melt_mean_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("sdc_melt_mean_matrix",&feature_matrix<sc_stat,&sc_stat::sdc_melt_mean_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("sdc_melt_mean_value", &sc_stat::sdc_melt_mean_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("acc_melt",acc_melt_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("acc_melt",acc_melt_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("acc_melt_matrix",&feature_matrix<sc_stat,&sc_stat::acc_melt_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("acc_melt_value", &sc_stat::acc_melt_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("iso_pot_energy",iso_pot_energy_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("iso_pot_energy",iso_pot_energy_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("iso_pot_energy_matrix",&feature_matrix<sc_stat,&sc_stat::iso_pot_energy_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("iso_pot_energy_value", &sc_stat::iso_pot_energy_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("temp_swe",temp_swe_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("temp_swe",temp_swe_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("temp_swe_matrix",&feature_matrix<sc_stat,&sc_stat::temp_swe_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("temp_swe_value", &sc_stat::temp_swe_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
             ;
 
@@ -179,15 +202,19 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct GammaSnow cell response statistics object"))
                 .def("outflow",outflow_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("outflow",outflow_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("outflow_matrix",&feature_matrix<rc_stat,&rc_stat::outflow_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("outflow_value", &rc_stat::outflow_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("swe",swe_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("swe",swe_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("swe_matrix",&feature_matrix<rc_stat,&rc_stat::swe_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("swe_value", &rc_stat::swe_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("sca",sca_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("sca",sca_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("sca_matrix",&feature_matrix<rc_stat,&rc_stat::sca_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("sca_value", &rc_stat::sca_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("glacier_melt", glacier_melt_ts, args("catchment_indexes"), "returns sum  for catcment_ids[m3/s]")
                 .def("glacier_melt", glacier_melt_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep [m3/s]")
+                .def("glacier_melt_matrix",&feature_matrix<rc_stat,&rc_stat::glacier_melt_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
                 .def("glacier_melt_value", &rc_stat::glacier_melt_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep[m3/s]")
 
                 ;
@@ -210,9 +237,11 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct HBVSnow cell state statistics object"))
                 .def("swe",swe_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("swe",swe_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("swe_matrix",&feature_matrix<sc_stat,&sc_stat::swe_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("swe_value", &sc_stat::swe_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("sca",sca_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("sca",sca_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("sca_matrix",&feature_matrix<sc_stat,&sc_stat::sca_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("sca_value", &sc_stat::sca_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
             ;
 
@@ -226,9 +255,11 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct HBVSnow cell response statistics object"))
                 .def("outflow",outflow_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("outflow",outflow_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("outflow_matrix",&feature_matrix<rc_stat,&rc_stat::outflow_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("outflow_value", &rc_stat::outflow_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("glacier_melt", glacier_melt_ts, args("catchment_indexes"), "returns sum  for catcment_ids[m3/s]")
                 .def("glacier_melt", glacier_melt_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep [m3/s]")
+                .def("glacier_melt_matrix",&feature_matrix<rc_stat,&rc_stat::glacier_melt_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
                 .def("glacier_melt_value", &rc_stat::glacier_melt_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep[m3/s]")
                 ;
         }
@@ -257,21 +288,27 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct Skaugen snow cell state statistics object"))
                 .def("alpha",alpha_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("alpha",alpha_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("alpha_matrix",&feature_matrix<sc_stat,&sc_stat::alpha_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("alpha_value", &sc_stat::alpha_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("nu",nu_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("nu",nu_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("nu_matrix",&feature_matrix<sc_stat,&sc_stat::nu_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("nu_value",&sc_stat::nu_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("lwc",lwc_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("lwc",lwc_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("lwc_matrix",&feature_matrix<sc_stat,&sc_stat::lwc_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("lwc_value", &sc_stat::lwc_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("residual",residual_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("residual",residual_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("residual_matrix",&feature_matrix<sc_stat,&sc_stat::residual_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("residual_value", &sc_stat::residual_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("swe",swe_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("swe",swe_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("swe_matrix",&feature_matrix<sc_stat,&sc_stat::swe_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("swe_value", &sc_stat::swe_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("sca",sca_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("sca",sca_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("sca_matrix",&feature_matrix<sc_stat,&sc_stat::sca_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("sca_value", &sc_stat::sca_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
             ;
 
@@ -287,12 +324,15 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct Skaugen snow cell response statistics object"))
                 .def("outflow",outflow_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("outflow",outflow_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("outflow_matrix",&feature_matrix<rc_stat,&rc_stat::outflow_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("outflow_value", &rc_stat::outflow_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("total_stored_water",total_stored_water_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("total_stored_water",total_stored_water_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("total_stored_water_matrix",&feature_matrix<rc_stat,&rc_stat::total_stored_water_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("total_stored_water_value", &rc_stat::total_stored_water_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("glacier_melt", glacier_melt_ts, args("catchment_indexes"), "returns sum  for catcment_ids[m3/s]")
                 .def("glacier_melt", glacier_melt_vd, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep [m3/s]")
+                .def("glacier_melt_matrix",&feature_matrix<rc_stat,&rc_stat::glacier_melt_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
                 .def("glacier_melt_value", &rc_stat::glacier_melt_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep[m3/s]")
                 ;
         }
@@ -329,24 +369,31 @@ namespace expose {
                 .def(init<std::shared_ptr<std::vector<cell>> >(args("cells"),"construct basic cell statistics object"))
                 .def("discharge",discharge_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("discharge",discharge_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("discharge_matrix",&feature_matrix<bc_stat,&bc_stat::discharge_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("discharge_value", &bc_stat::discharge_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("charge", charge_ts, args("catchment_indexes"), "returns sum charge[m^3/s] for catcment_ids")
                 .def("charge", charge_vd, args("catchment_indexes", "i"), "returns charge[m^3/s]  for cells matching catchments_ids at the i'th timestep")
+                .def("charge_matrix",&feature_matrix<bc_stat,&bc_stat::charge_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
                 .def("charge_value", &bc_stat::charge_value, args("catchment_indexes", "i"), "returns charge[m^3/s] for cells matching catchments_ids at the i'th timestep")
                 .def("temperature",temperature_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("temperature",temperature_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("temperature_matrix",&feature_matrix<bc_stat,&bc_stat::temperature_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("temperature_value", &bc_stat::temperature_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("precipitation",precipitation_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("precipitation",precipitation_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("precipitation_matrix",&feature_matrix<bc_stat,&bc_stat::precipitation_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("precipitation_value", &bc_stat::precipitation_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("radiation",radiation_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("radiation",radiation_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("radiation_matrix",&feature_matrix<bc_stat,&bc_stat::radiation_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("radiation_value", &bc_stat::radiation_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("wind_speed",wind_speed_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("wind_speed",wind_speed_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("wind_speed_matrix",&feature_matrix<bc_stat,&bc_stat::wind_speed_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("wind_speed_value", &bc_stat::wind_speed_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
                 .def("rel_hum",rel_hum_ts,args("catchment_indexes"), "returns sum  for catcment_ids")
                 .def("rel_hum",rel_hum_vd,args("catchment_indexes","i"),"returns  for cells matching catchments_ids at the i'th timestep")
+                .def("rel_hum_matrix",&feature_matrix<bc_stat,&bc_stat::rel_hum_matrix>,args("catchment_indexes"),"returns a 2-d numpy array, cells x timesteps, for the cells matching catchment_ids")
 				.def("rel_hum_value", &bc_stat::rel_hum_value, args("catchment_indexes", "i"), "returns  for cells matching catchments_ids at the i'th timestep")
 				.def("total_area", &bc_stat::total_area, args("catchment_indexes"), "returns total area[m2] for cells matching catchments_ids")
 				.def("forest_area", &bc_stat::forest_area, args("catchment_indexes"), "returns forest area[m2] for cells matching catchments_ids")
@@ -0,0 +1,28 @@
+#pragma once
+// you need boost python, and the vector/memory headers before this one is included..
+// implemented in api_vectors.cpp, the one place the numpy c-api is imported
+namespace expose {
+    /** \brief a 1-d float64 numpy array over the n doubles at d, not a copy
+     *
+     * The array keeps keep, the owner of d, alive, so the view can outlive the python object it was taken from.
+     * It is valid as long as the owner keeps the number of values, an owner that resizes moves the values,
+     * take a new view after that.
+     * \param writable if false, the array is read-only, for values that might be shared by other series
+     */
+    boost::python::object np_view(double* d, std::size_t n, std::shared_ptr<void> keep, bool writable);
+
+    /** \return a 1-d float64 numpy array owning v, moved, not copied */
+    boost::python::object np_array(std::vector<double>&& v);
+
+    /** \return the values of the 1-d numpy array, or sequence, a, a contiguous float64 array is copied as one block */
+    std::vector<double> np_values(const boost::python::object& a);
+
+    /** \return a 2-d float64 numpy array, rows x cols, owning v, moved, with the values row-major */
+    boost::python::object np_array(std::vector<double>&& v, std::size_t rows, std::size_t cols);
+
+    /** \return the values, row-major, of the 2-d numpy array, or nested sequence, a, and sets rows and cols to its shape */
+    std::vector<double> np_values(const boost::python::object& a, std::size_t& rows, std::size_t& cols);
+
+    /** \return the rows of the 2-d numpy array, or nested sequence, a, each copied as one block, and sets cols to its number of columns */
+    std::vector<std::vector<double>> np_rows(const boost::python::object& a, std::size_t& cols);
+}
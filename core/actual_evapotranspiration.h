@@ -18,6 +18,7 @@
 ///
 #pragma once
 #include <cmath>
+#include <cstddef>
 #include "utctime_utilities.h"
 /**
 contains the actual evatransporation parameters and algorithm
@@ -58,6 +59,28 @@ namespace shyft {
 				const utctime ) {
 				return potential_evapotranspiration*calc_pot_ratio(water_level,scale_factor)*(1.0 - snow_fraction);
 			}
+
+			/** \brief actual_evapotranspiration for n cells, the batch version of calculate_step
+			 *
+			 * Used by the timestep-major execution, with the inputs of one time-step stored contiguous,
+			 * written as a plain loop the compiler can vectorize.
+			 *
+			 * \param water_level n values
+			 * \param potential_evapotranspiration n values
+			 * \param scale_factor typically 1.5, common to the cells
+			 * \param snow_fraction n values 0..1
+			 * \param actual_evapotranspiration output, n values
+			 * \param n number of cells
+			 */
+			inline void calculate_step_batch(const double* water_level,
+				const double* potential_evapotranspiration,
+				const double scale_factor,
+				const double* snow_fraction,
+				double* actual_evapotranspiration,
+				const size_t n) {
+				for (size_t i = 0; i < n; ++i)
+					actual_evapotranspiration[i] = potential_evapotranspiration[i]*calc_pot_ratio(water_level[i], scale_factor)*(1.0 - snow_fraction[i]);
+			}
 		};
 	};
 };
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace shyft {
+    namespace core {
+        using std::size_t;
+
+        /** \brief the thread-count and chunk-size of a parallel_for, 0 means the default of the caller */
+        struct autotune_setting {
+            size_t n_threads{ 0 };
+            size_t chunk_size{ 0 };
+            bool operator==(const autotune_setting& o) const { return n_threads == o.n_threads && chunk_size == o.chunk_size; }
+            bool operator!=(const autotune_setting& o) const { return !operator==(o); }
+        };
+
+        /** \return the host name and the hardware concurrency, identifying the machine of the tuned settings */
+        inline std::string autotune_machine_key() {
+            static const std::string machine = []() {
+                std::string host;
+#ifdef _WIN32
+                if (const char* h = std::getenv("COMPUTERNAME")) host = h;
+#else
+                char buf[256] = { 0 };
+                if (gethostname(buf, sizeof(buf) - 1) == 0) host = buf;
+#endif
+                if (host.empty()) host = "localhost";
+                return host + "/" + std::to_string(std::thread::hardware_concurrency());
+            }();
+            return machine;
+        }
+
+        /** \brief the key of the tuned setting for the kind of work, e.g. the cell type, with n_items rounded up to a power of 2, on this machine
+         * \note whitespace is replaced by '_', so the key is one word in the file of autotune_store
+         */
+        inline std::string autotune_key(const std::string& kind, size_t n_items) {
+            size_t n = 1;
+            while (n < n_items) n <<= 1;
+            std::string k = kind + "/" + std::to_string(n) + "/" + autotune_machine_key();
+            for (auto& c : k)
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r') c = '_';
+            return k;
+        }
+
+        /** \brief the settings measured by the autotuner: {max, max/2, max/4} threads, each with the automatic chunk size,
+         * 1 item, and 1/16 of the items of each thread per chunk
+         */
+        inline std::vector<autotune_setting> autotune_candidates(size_t max_threads, size_t n_items) {
+            std::vector<autotune_setting> r;
+            if (max_threads == 0) max_threads = 1;
+            for (size_t t : { max_threads, max_threads / 2, max_threads / 4 }) {
+                if (t == 0) continue;
+                for (size_t c : { size_t(0), size_t(1), n_items / (t * 16) }) {
+                    autotune_setting s{ t, c };
+                    if (std::find(r.begin(), r.end(), s) == r.end())
+                        r.push_back(s);
+                }
+            }
+            return r;
+        }
+
+        /** \brief the process-wide tuned settings, by autotune_key, optionally persisted to a file
+         *
+         * The file has one line for each key: `key n_threads chunk_size`,
+         * and is rewritten on each put, so the choice survives the process, and is shared by the processes on the same machine
+         * when they use the same file.
+         */
+        class autotune_store {
+        public:
+            static autotune_store& instance() {
+                static autotune_store s;
+                return s;
+            }
+
+            /** \brief persist the settings to file_path, loading the settings already there, an empty path turns off the persistence
+             * \throw runtime_error if the file exists, and can not be parsed
+             */
+            void set_file(const std::string& file_path) {
+                std::lock_guard<std::mutex> lock(mx);
+                file = file_path;
+                if (file.empty()) return;
+                std::ifstream f(file);
+                std::string line;
+                while (f && std::getline(f, line)) {
+                    if (line.empty()) continue;
+                    std::istringstream is(line);
+                    std::string k; autotune_setting s;
+                    if (!(is >> k >> s.n_threads >> s.chunk_size))
+                        throw std::runtime_error("autotune_store: can not parse '" + line + "' in " + file);
+                    settings[k] = s;
+                }
+            }
+            std::string get_file() const { std::lock_guard<std::mutex> lock(mx); return file; }
+
+            /** \return true, and the setting of key in s, if it is tuned */
+            bool get(const std::string& key, autotune_setting& s) const {
+                std::lock_guard<std::mutex> lock(mx);
+                auto f = settings.find(key);
+                if (f == settings.end()) return false;
+                s = f->second;
+                return true;
+            }
+
+            void put(const std::string& key, const autotune_setting& s) {
+                std::lock_guard<std::mutex> lock(mx);
+                settings[key] = s;
+                if (file.empty()) return;
+                std::ofstream f(file, std::ios::trunc);
+                for (const auto& e : settings)
+                    f << e.first << ' ' << e.second.n_threads << ' ' << e.second.chunk_size << '\n';
+            }
+
+            /** \brief forget the tuned settings, the file is not changed until the next put */
+            void clear() { std::lock_guard<std::mutex> lock(mx); settings.clear(); }
+            size_t size() const { std::lock_guard<std::mutex> lock(mx); return settings.size(); }
+        private:
+            autotune_store() = default;
+            mutable std::mutex mx;
+            std::string file;
+            std::map<std::string, autotune_setting> settings;
+        };
+
+        /** \brief tunes the setting of one kind of parallel work by measuring the real runs
+         *
+         * Each run asks next for its setting, and reports its cost, e.g. seconds per time-step, with measured.
+         * Until the key is tuned, next hands out the candidates not yet measured, ref. autotune_candidates,
+         * so the tuning costs no extra runs, only the first runs of a slower setting.
+         * When all candidates are measured, the cheapest is put in the autotune_store, and used from then on,
+         * also by the other autotuners of the process, or of processes sharing the file of the store.
+         * \note not thread-safe, concurrent users must guard it, while the runs between next and measured can be concurrent
+         */
+        class autotuner {
+        public:
+            /** \return the setting for the next run of kind with n_items, using at most max_threads
+             * \param with_chunks if false, only the number of threads is tuned, and the chunk_size is 0
+             */
+            autotune_setting next(const std::string& kind, size_t n_items, size_t max_threads, bool with_chunks = true) {
+                auto k = autotune_key(kind, n_items);
+                if (k != key || max_threads != max_threads_) {
+                    key = k;
+                    max_threads_ = max_threads;
+                    candidates = autotune_candidates(max_threads, with_chunks ? n_items : 0);
+                    if (!with_chunks)
+                        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [](const autotune_setting& s) { return s.chunk_size != 0; }), candidates.end());
+                    cost.assign(candidates.size(), std::numeric_limits<double>::quiet_NaN());
+                }
+                autotune_setting s;
+                if (autotune_store::instance().get(key, s))
+                    return s;
+                for (size_t i = 0; i < candidates.size(); ++i)
+                    if (std::isnan(cost[i]))
+                        return candidates[i];
+                return autotune_setting{};
+            }
+
+            /** \brief the cost of a run of kind with n_items using s from next, the lowest cost of each candidate is kept
+             *
+             * Ignored if the key is tuned, or s is not a candidate of the current key of next.
+             */
+            void measured(const std::string& kind, size_t n_items, const autotune_setting& s, double run_cost) {
+                if (std::isnan(run_cost) || autotune_key(kind, n_items) != key)
+                    return;
+                autotune_setting t;
+                if (autotune_store::instance().get(key, t))
+                    return;
+                auto f = std::find(candidates.begin(), candidates.end(), s);
+                if (f == candidates.end())
+                    return;
+                double& c = cost[f - candidates.begin()];
+                c = std::isnan(c) ? run_cost : std::min(c, run_cost);
+                if (std::any_of(cost.begin(), cost.end(), [](double v) { return std::isnan(v); }))
+                    return;
+                autotune_store::instance().put(key, candidates[std::min_element(cost.begin(), cost.end()) - cost.begin()]);
+            }
+
+            /** \return true if next has a candidate left to measure for the key of the last next */
+            bool tuning() const {
+                autotune_setting t;
+                return !key.empty() && !autotune_store::instance().get(key, t)
+                    && std::any_of(cost.begin(), cost.end(), [](double v) { return std::isnan(v); });
+            }
+        private:
+            std::string key;
+            size_t max_threads_{ 0 };
+            std::vector<autotune_setting> candidates;
+            std::vector<double> cost;
+        };
+    }
+}
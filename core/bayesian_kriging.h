@@ -3,12 +3,17 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
 //#include <cmath>
 //#include <limits>
 #include <stdexcept>
 #include <armadillo>
 
 #include "time_series.h"
+#include "timeline_trace.h"
 
 /**
  * contains all BayesianKriging stuff, like concrete useful Parameters and the templated BTK algorithm
@@ -158,8 +163,93 @@ namespace shyft {
 	                                                                 { f.at(1, i++) = dest.mid_point().z; });
 
 	            }
+
+	            /** \brief solve K X = B for the symmetric covariance matrix K
+	             *
+	             * Uses the Cholesky factorisation K = R'R and two triangular solves, that is cheaper and numerically
+	             * more stable than the explicit inverse. Falls back to a general solve if K is not positive definite,
+	             * like when two sources share the same location.
+	             */
+	            inline arma::mat covariance_solve(const arma::mat& K, const arma::mat& B) {
+	                arma::mat R;
+	                if (arma::chol(R, K))
+	                    return arma::solve(arma::trimatu(R), arma::solve(arma::trimatl(R.t()), B));
+	                return arma::solve(K, B);
+	            }
 	        } // End namespace btk_utils
 
+	        /** \brief the btk time-step operators for one set of valid sources, ref. btk_interpolation */
+	        struct btk_operators {
+	            arma::mat F, E_beta_w, omega, GH_inv, BM;
+	        };
+
+	        /** \brief compute the btk_operators for the rows sub_idx of the full source matrices, or all rows if sub_idx is nullptr
+	         * \param gradient_sd prior standard deviation of the temperature gradient
+	         */
+	        inline std::shared_ptr<const btk_operators> make_operators(const arma::mat& K, const arma::mat& k, const arma::mat& F, const arma::mat& f,
+	                                                                  const arma::uvec* sub_idx, double gradient_sd) {
+	            auto r = std::make_shared<btk_operators>();
+	            arma::mat K_r, k_r;
+	            if (sub_idx) {
+	                r->F = F.rows(*sub_idx);
+	                K_r = K.submat(*sub_idx, *sub_idx);
+	                k_r = k.rows(*sub_idx);
+	            } else {
+	                r->F = F;
+	                K_r = K;
+	                k_r = k;
+	            }
+	            arma::mat22 eye22 = arma::diagmat(arma::vec(2, arma::fill::ones));
+	            arma::mat Kinv_F = utils::covariance_solve(K_r, r->F);
+	            arma::mat Kinv_k = utils::covariance_solve(K_r, k_r);
+	            arma::mat22 H_inv = r->F.t()*Kinv_F;
+	            if (!sub_idx && arma::rank(H_inv) == 1) {
+	                throw std::runtime_error("The bayestian temperature kriging algorithm needs at least two sources at different heights.");
+	            }
+	            arma::mat22 H = H_inv.i();
+	            arma::mat22 G_inv = H_inv;
+	            G_inv.at(1, 1) += 1/(gradient_sd*gradient_sd);
+	            arma::mat22 G = G_inv.i();
+	            r->GH_inv = G*H_inv;
+	            r->BM = (f - r->F.t()*Kinv_k).t()*(eye22 - r->GH_inv);
+	            r->E_beta_w = H*Kinv_F.t(); // beta_est_weights, K symmetric
+	            r->omega = Kinv_k.t();    // krig_weights
+	            return r;
+	        }
+
+	        const size_t operator_cache_size = 16; ///< default number of reduced btk_operators kept by btk_interpolation
+
+	        /** \brief least recently used cache of btk_operators, keyed by the indices of the valid sources
+	         *
+	         * The memory of one entry is dominated by omega and BM, (n_sources+2) x n_destinations doubles.
+	         */
+	        class operator_cache {
+	            typedef std::pair<std::vector<arma::uword>, std::shared_ptr<const btk_operators>> entry_t;
+	            std::list<entry_t> entries;///< most recently used first
+	            size_t capacity;
+	          public:
+	            explicit operator_cache(size_t capacity = operator_cache_size) : capacity(capacity) {}
+	            size_t size() const { return entries.size(); }
+
+	            /** \return the operators for valid_inds, moved to front, or nullptr if not found */
+	            std::shared_ptr<const btk_operators> find(const std::vector<arma::uword>& valid_inds) {
+	                for (auto i = entries.begin(); i != entries.end(); ++i) {
+	                    if (i->first == valid_inds) {
+	                        entries.splice(entries.begin(), entries, i);
+	                        return entries.front().second;
+	                    }
+	                }
+	                return nullptr;
+	            }
+
+	            void insert(const std::vector<arma::uword>& valid_inds, std::shared_ptr<const btk_operators> ops) {
+	                if (capacity == 0) return;
+	                entries.emplace_front(valid_inds, std::move(ops));
+	                if (entries.size() > capacity)
+	                    entries.pop_back();
+	            }
+	        };
+
 	        /** \brief Simple BTKParameter class with constant temperature gradient
 	         * \sa BayesianKriging
 	         */
@@ -225,6 +315,11 @@ namespace shyft {
 	            double nug() const { return nug_value; }
 	            double range() const { return range_value; }
 	            double zscale() const { return zscale_value; }
+	            bool operator==(const parameter& o) const {
+	                return gradient_sd == o.gradient_sd && sill_value == o.sill_value && nug_value == o.nug_value
+	                    && range_value == o.range_value && zscale_value == o.zscale_value;
+	            }
+	            bool operator!=(const parameter& o) const { return !operator==(o); }
 	        };
 
 
@@ -274,128 +369,101 @@ namespace shyft {
 	         *       TODO: Should this be a time series?
 	         *   \sa BTKConstParameter \sa BTKParameter
 	         *
+	         * The time-steps are processed in windows of batch_size(n_destinations) steps, and within a window, steps with
+	         * the same set of valid sources are evaluated together, as matrix-matrix products over sources x time-steps.
+	         *
 	         */
+	        const size_t batch_values = 1 << 22; ///< max destinations x time-steps evaluated in one window of btk_interpolation
+
+	        /** \return number of time-steps in each window of btk_interpolation */
+	        inline size_t batch_size(size_t n_destinations) {
+	            return std::max(size_t(1), batch_values/std::max(size_t(1), n_destinations));
+	        }
+
 	        template<class TSA, class S, class D, class T, class P>
 	        void btk_interpolation(S source_begin, S source_end,
 	                              D destination_begin, D destination_end,
-	                              const T& time_axis, const P& parameter)
+	                              const T& time_axis, const P& parameter, size_t cache_size = operator_cache_size)
 	        {
-	            // Armadillo's notion of submatrix views are used for slicing out portions of F, k, and K
-	            // to minimize the number of matrix allocations.
-
-	            // Allocate matrices of known sizes:
-	            arma::mat22 H, H_inv, G, G_inv, GH_inv;
-	            arma::mat::fixed<2,1> E_beta_pri, E_beta_w_pri,/* E_beta_post,*/ beta_hat;
+	            trace::scope ts("btk", 0, std::distance(destination_begin, destination_end));
 	            // These matrices sizes vary with the number valid sources and the number of destinations.
-	            arma::mat K, k, F, f, K_inv, E_beta_w, omega, BM, T_obs, E_temp_post;
-
-	            // Prior data
-	            E_beta_pri(0, 0) = 0.0; // Old code says this is ok. TODO: Check assumption.
-	            arma::mat22 eye22 = arma::diagmat(arma::vec(2, arma::fill::ones));
+	            arma::mat K, k, F, f;
 
 	            // Gather spatial data for all stations and destinations
 	            utils::build_elevation_matrices(source_begin, source_end, destination_begin, destination_end, F, f);
 	            utils::build_covariance_matrices(source_begin, source_end, destination_begin, destination_end, parameter, K, k);
+	            const arma::mat f_t = f.t();
 
-	            // Build full operators
-
-	            K_inv = K.i();
-	            H_inv = F.t()*K_inv*F;
-	            if (arma::rank(H_inv) == 1) {
-	                throw std::runtime_error("The bayestian temperature kriging algorithm needs at least two sources at different heights.");
-	            }
-	            H = H_inv.i();
-	            G_inv = H_inv;
-	            G_inv.at(1, 1) += 1/(parameter.temperature_gradient_sd()*parameter.temperature_gradient_sd());
-	            G = G_inv.i();
-	            GH_inv = G*H_inv;
-	            BM = (f - F.t()*K_inv*k).t()*(eye22 - GH_inv);
-	            E_beta_w = H*F.t()*K_inv; // beta_est_weights
-	            omega = k.t()*K_inv;    // krig_weights
-	            // Reduced matrices
-	            arma::mat F_r, E_beta_w_r, omega_r, GH_inv_r, BM_r;
-
-	            // Matrix pointers used in the time loop
-	            arma::mat *F_p=nullptr, *E_beta_w_p=nullptr, *omega_p=nullptr, *GH_inv_p=nullptr, *BM_p=nullptr;
+	            // Build full operators, and keep the reduced ones, for sources dropping in and out, in a lru cache
+	            auto full = make_operators(K, k, F, f, nullptr, parameter.temperature_gradient_sd());
+	            operator_cache reduced(cache_size);
 
 	            const size_t num_sources = std::distance(source_begin, source_end);
+	            const size_t num_destinations = std::distance(destination_begin, destination_end);
 	            std::vector<TSA> source_accessors;
 	            source_accessors.reserve(num_sources);
 	            std::for_each(source_begin, source_end, [&] (const typename S::value_type& source)
 	                          { source_accessors.emplace_back(TSA(source.temperatures(), time_axis)); });
-	            // Time step loop
+	            // Time step loop, one window at the time
 	            const size_t num_timesteps = time_axis.size();
-	            std::vector<double> temperatures;
-	            temperatures.reserve(num_sources);
-
-	            std::vector<arma::uword> valid_inds, prev_valid_inds;
+	            const size_t window = batch_size(num_destinations);
+	            std::vector<double> values(num_sources*std::min(window, num_timesteps));// [step*num_sources + source]
+	            std::map<std::vector<arma::uword>, std::vector<size_t>> groups;// valid source indices -> steps
+	            std::vector<arma::uword> valid_inds;
 	            valid_inds.reserve(num_sources);
-	            for (size_t t_step=0; t_step < num_timesteps; ++t_step) {
-	                temperatures.clear();
-	                prev_valid_inds = valid_inds;
-	                valid_inds.clear();
-	                size_t idx = 0;
-	                for (auto& a: source_accessors) {
-	                    double v = a.value(t_step);
-	                    if (std::isfinite(v)) {
-	                        valid_inds.push_back((arma::uword)idx);
-	                        temperatures.push_back(v);
+	            for (size_t w0 = 0; w0 < num_timesteps; w0 += window) {
+	                const size_t w1 = std::min(num_timesteps, w0 + window);
+	                groups.clear();
+	                for (size_t t_step = w0; t_step < w1; ++t_step) {
+	                    valid_inds.clear();
+	                    double* v = values.data() + (t_step - w0)*num_sources;
+	                    for (size_t idx = 0; idx < num_sources; ++idx) {
+	                        v[idx] = source_accessors[idx].value(t_step);
+	                        if (std::isfinite(v[idx]))
+	                            valid_inds.push_back((arma::uword)idx);
 	                    }
-	                    ++idx;
-	                }
-	                if (valid_inds != prev_valid_inds || valid_inds.size()==0) {
 	                    if (valid_inds.size() == 0) {
-	                        //std::cout << "period("<< t_step <<"| " << num_timesteps << ") = " << time_axis.period(t_step) << std::endl;
 	                        throw std::runtime_error(std::string("bayesian kriging temperature: No valid sources for time period, giving up.") + calendar().to_string(time_axis.period(t_step)));
 	                    }
-	                    if (valid_inds.size() == num_sources) {
-	                        // Use full operators
-	                        F_p = &F;
-	                        E_beta_w_p = &E_beta_w;
-	                        omega_p = &omega;
-	                        GH_inv_p = &GH_inv;
-	                        BM_p = &BM;
+	                    groups[valid_inds].push_back(t_step);
+	                }
+	                for (const auto& g : groups) {
+	                    const auto& inds = g.first;
+	                    const auto& steps = g.second;
+	                    std::shared_ptr<const btk_operators> ops;
+	                    if (inds.size() == num_sources) {
+	                        ops = full;
 	                    } else {
-	                        // Build new reduced operators from full operators
-	                        arma::uvec sub_idx(valid_inds);
-	                        F_r = F.rows(sub_idx);
-							K_inv = K.submat(sub_idx, sub_idx).i();
-	                        H_inv = F_r.t()*K_inv*F_r;
-	                        H = H_inv.i();
-	                        G_inv = H_inv;
-	                        G_inv(1, 1) += 1/(parameter.temperature_gradient_sd()*parameter.temperature_gradient_sd());
-	                        G = G_inv.i();
-	                        GH_inv_r = G*H_inv;
-	                        arma::mat k_red = k.rows(sub_idx);
-	                        BM_r = (f - F_r.t()*K_inv*k_red).t()*(eye22 - GH_inv_r);
-	                        E_beta_w_r = H*F_r.t()*K_inv; // beta_est_weights
-	                        omega_r = k_red.t()*K_inv;    // krieg_weights
-	                        // Assign pointers
-	                        F_p = &F_r;
-	                        E_beta_w_p = &E_beta_w_r;
-	                        omega_p = &omega_r;
-	                        GH_inv_p = &GH_inv_r;
-	                        BM_p = &BM_r;
+	                        ops = reduced.find(inds);
+	                        if (!ops) {
+	                            arma::uvec sub_idx(inds);
+	                            ops = make_operators(K, k, F, f, &sub_idx, parameter.temperature_gradient_sd());
+	                            reduced.insert(inds, ops);
+	                        }
+	                    }
+	                    // Fill T_obs with valid temperatures, and the prior data, one column for each time step
+	                    const arma::uword n_steps = (arma::uword)steps.size();
+	                    arma::mat T_obs((arma::uword)inds.size(), n_steps);
+	                    arma::mat E_beta_pri(2, n_steps);
+	                    for (arma::uword c = 0; c < n_steps; ++c) {
+	                        const double* v = values.data() + (steps[c] - w0)*num_sources;
+	                        for (arma::uword r = 0; r < (arma::uword)inds.size(); ++r)
+	                            T_obs.at(r, c) = v[inds[r]];
+	                        E_beta_pri.at(0, c) = 0.0; // Old code says this is ok. TODO: Check assumption.
+	                        E_beta_pri.at(1, c) = parameter.temperature_gradient(time_axis.period(steps[c]));
+	                    }
+	                    // Core computational work here:
+	                    arma::mat beta_hat = ops->E_beta_w*T_obs;
+	                    arma::mat T_hat = f_t*beta_hat + ops->omega*(T_obs - ops->F*beta_hat);
+	                    //E_beta_post = ops->GH_inv*beta_hat + (eye22 - ops->GH_inv)*E_beta_pri;
+	                    arma::mat E_temp_post = T_hat - ops->BM*(beta_hat - E_beta_pri);
+
+	                    for (arma::uword c = 0; c < n_steps; ++c) {
+	                        arma::uword dist = 0;
+	                        for (D d=destination_begin; d != destination_end; ++d)
+	                            d->set_temperature(steps[c], E_temp_post.at(dist++, c));
 	                    }
 	                }
-
-	                // Build prior data for time step:
-	                E_beta_pri(1, 0) = parameter.temperature_gradient(time_axis.period(t_step));
-	                E_beta_w_pri = ((eye22 - *GH_inv_p)*E_beta_pri);
-
-	                // Fill T_obs with valid temperatures
-	                T_obs.set_size((arma::uword)valid_inds.size(), 1);
-	                std::copy(std::begin(temperatures), std::end(temperatures), T_obs.begin_col(0));
-	                // Core computational work here:
-	                beta_hat = (*E_beta_w_p)*T_obs;
-	                arma::mat T_hat = f.t()*beta_hat + (*omega_p)*(T_obs - (*F_p)*beta_hat);
-	                //E_beta_post = (*GH_inv_p)*beta_hat + E_beta_w_pri;
-	                E_temp_post = arma::vec(T_hat - (*BM_p)*(beta_hat - E_beta_pri));
-
-	                arma::uword dist = 0;
-	                for (D d=destination_begin; d != destination_end; ++d)
-	                    d->set_temperature(t_step, E_temp_post.at(dist++));
-
 	            }
 	        }
 		}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <stdexcept>
+#include <exception>
+
+#include "thread_pool.h"
+#include "model_calibration.h"
+
+/**
+ * Contains the batch driver that runs several independent calibrations, like a multi-start search, concurrently
+ */
+
+namespace shyft {
+    namespace core {
+        namespace model_calibration {
+            using namespace std;
+
+            /** \brief the status of a calibration job, ref. calibration_batch */
+            enum calibration_status {
+                PENDING,///< waiting to be run
+                RUNNING,
+                DONE,///< the result is available
+                CANCELLED,///< cancelled before, or while running, the model has the parameters of the last evaluation
+                FAILED///< the optimization raised an exception, ref. calibration_batch::error
+            };
+
+            /** \brief raised by the trace callback of a cancelled job, to stop the running optimization */
+            struct calibration_cancelled : runtime_error {
+                calibration_cancelled() : runtime_error("calibration_batch: the job is cancelled") {}
+            };
+
+            /** \brief runs a batch of independent calibration jobs on the shared executor, a bounded number at the time
+             *
+             * Each job is a (model, targets, p_min, p_max, p_start, method) calibration, done by its own optimizer,
+             * so each job must have its own model, e.g. a clone of the model to calibrate for each start point.
+             * The jobs are run by run(n_parallel), at most n_parallel of them at the same time, while their model
+             * runs still use the executor, so the cells of a job are run in parallel as usual.
+             *
+             * The progress, that is the number of goal function evaluations, and the status of each job can be read,
+             * and jobs cancelled, from other threads while run() is working.
+             * A cancelled job is stopped at its next goal function evaluation, and a pending job is skipped.
+             *
+             * \tparam M region model type, as for the optimizer
+             * \tparam PA parameter type
+             * \tparam PS target time-series type
+             */
+            template <class M, class PA, class PS>
+            class calibration_batch {
+            public:
+                typedef optimizer<M, PA, PS> optimizer_t;
+                typedef typename optimizer_t::target_specification_t target_specification_t;
+
+            private:
+                struct job {
+                    shared_ptr<optimizer_t> opt;
+                    optimizer_method method;
+                    PA p_start;
+                    size_t max_n_evaluations;
+                    atomic<int> status{PENDING};
+                    atomic<size_t> n_evaluations{0};
+                    atomic<bool> cancelled{false};
+                    PA result;///< valid when DONE
+                    double goal_function = shyft::nan;///< of the result, valid when DONE
+                    string error;///< valid when FAILED
+                };
+                vector<unique_ptr<job>> jobs;
+                atomic<bool> running{false};
+
+                job& at(size_t i) const {
+                    if (i >= jobs.size())
+                        throw runtime_error("calibration_batch: job index out of range");
+                    return *jobs[i];
+                }
+
+                void run_job(job& j) {
+                    int pending = PENDING;
+                    if (!j.status.compare_exchange_strong(pending, RUNNING))
+                        return;// cancelled before it started
+                    try {
+                        auto& opt = *j.opt;
+                        opt.set_trace_callback([&j](const PA&, double) {
+                            ++j.n_evaluations;
+                            if (j.cancelled)
+                                throw calibration_cancelled();
+                        });
+                        PA r;
+                        switch (j.method) {
+                            case BOBYQA: r = opt.optimize(j.p_start, j.max_n_evaluations); break;
+                            case SCEUA: r = opt.optimize_sceua(j.p_start, j.max_n_evaluations); break;
+                            case DREAM: r = opt.optimize_dream(j.p_start, j.max_n_evaluations); break;
+                            case PATTERN_SEARCH: r = opt.optimize_pattern_search(j.p_start, j.max_n_evaluations); break;
+                        }
+                        opt.set_trace_callback(nullptr);
+                        j.goal_function = opt.calculate_goal_function(r);// leaves the model with the result
+                        j.result = r;
+                        j.status = DONE;
+                    } catch (const calibration_cancelled&) {
+                        j.status = CANCELLED;
+                    } catch (const exception& e) {
+                        j.error = e.what();
+                        j.status = FAILED;
+                    } catch (...) {
+                        j.error = "unknown exception";
+                        j.status = FAILED;
+                    }
+                    j.opt->set_trace_callback(nullptr);
+                }
+
+            public:
+                calibration_batch() = default;
+                calibration_batch(const calibration_batch&) = delete;
+                calibration_batch& operator=(const calibration_batch&) = delete;
+
+                /** \brief add a calibration job to the batch
+                 *
+                 * \param model the model to calibrate, kept as a reference(!), and not shared with other jobs of the batch
+                 * \param targets the target specification of the goal function
+                 * \param p_min the lower bound of the parameters, parameters with p_min == p_max are not optimized
+                 * \param p_max the upper bound of the parameters
+                 * \param p_start the start point of the search
+                 * \param method the optimization method, with its default stop criteria
+                 * \param max_n_evaluations max number of goal function evaluations
+                 * \return the index of the job
+                 * \throw runtime_error if the model is used by another job, or the batch is running
+                 */
+                size_t add_job(M& model, const vector<target_specification_t>& targets, const PA& p_min, const PA& p_max,
+                               const PA& p_start, optimizer_method method, size_t max_n_evaluations = 1500) {
+                    if (running)
+                        throw runtime_error("calibration_batch: jobs can not be added while running");
+                    for (const auto& j : jobs)
+                        if (&j->opt->model == &model)
+                            throw runtime_error("calibration_batch: each job needs its own model, e.g. a clone");
+                    unique_ptr<job> j(new job());
+                    j->opt = make_shared<optimizer_t>(model);
+                    j->opt->set_target_specification(targets, p_min, p_max);
+                    j->method = method;
+                    j->p_start = p_start;
+                    j->max_n_evaluations = max_n_evaluations;
+                    jobs.push_back(move(j));
+                    return jobs.size() - 1;
+                }
+
+                /** \brief run the pending jobs, at most n_parallel at the same time, returns when all jobs are done
+                 * \param n_parallel max number of concurrent jobs, 0 means the size of the executor
+                 * \note failed jobs do not stop the batch, ref. status() and error()
+                 */
+                void run(size_t n_parallel = 0) {
+                    bool idle = false;
+                    if (!running.compare_exchange_strong(idle, true))
+                        throw runtime_error("calibration_batch: the batch is already running");
+                    try {
+                        executor::instance()->parallel_for(jobs.size(), 1, [this](size_t i0, size_t i1) {
+                            for (size_t i = i0; i < i1; ++i)
+                                run_job(*jobs[i]);
+                        }, n_parallel);
+                    } catch (...) {
+                        running = false;
+                        throw;
+                    }
+                    running = false;
+                }
+
+                /** \brief cancel job i, a pending job is skipped, a running job stops at its next evaluation */
+                void cancel(size_t i) {
+                    auto& j = at(i);
+                    j.cancelled = true;
+                    int pending = PENDING;
+                    j.status.compare_exchange_strong(pending, CANCELLED);
+                }
+
+                /** \brief cancel all jobs of the batch */
+                void cancel_all() {
+                    for (size_t i = 0; i < jobs.size(); ++i)
+                        cancel(i);
+                }
+
+                size_t size() const { return jobs.size(); }
+                calibration_status status(size_t i) const { return calibration_status(at(i).status.load()); }
+                /** \return the number of goal function evaluations done by job i, thread-safe progress indicator */
+                size_t n_evaluations(size_t i) const { return at(i).n_evaluations; }
+                /** \return the max number of evaluations of job i, ref. add_job */
+                size_t max_n_evaluations(size_t i) const { return at(i).max_n_evaluations; }
+                /** \return the optimized parameters of job i, valid when status(i) is DONE */
+                PA result(size_t i) const { return at(i).result; }
+                /** \return the goal function value of the result of job i, nan unless status(i) is DONE */
+                double goal_function(size_t i) const { return status(i) == DONE ? at(i).goal_function : shyft::nan; }
+                string error(size_t i) const { return status(i) == FAILED ? at(i).error : string(); }
+                /** \return the optimizer of job i, e.g. to set concurrent evaluations or inspect the traces after the run */
+                shared_ptr<optimizer_t> get_optimizer(size_t i) const { return at(i).opt; }
+
+                /** \return the index of the done job with the smallest goal function, or size() if none is done */
+                size_t best() const {
+                    size_t r = jobs.size();
+                    double f = numeric_limits<double>::infinity();
+                    for (size_t i = 0; i < jobs.size(); ++i) {
+                        if (status(i) == DONE && jobs[i]->goal_function < f) {
+                            f = jobs[i]->goal_function;
+                            r = i;
+                        }
+                    }
+                    return r;
+                }
+            };
+        }
+    }
+}
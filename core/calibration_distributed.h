@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/serialization/vector.hpp>
+
+#include <dlib/server.h>
+#include <dlib/iosockstream.h>
+
+#include "core_serialization.h"
+#include "core_archive.h"
+#include "dtss_msg.h"
+#include "dtss_client.h"
+
+/**
+ * Contains the distributed evaluation of calibration candidates, workers on other nodes evaluating the batches of an optimizer
+ */
+
+namespace shyft {
+    namespace core {
+        namespace model_calibration {
+            using namespace std;
+
+            /** \brief the message-types of calibration_worker and calibration_dispatcher, framed as the dtss messages */
+            enum class calibration_message_type : uint8_t {
+                SERVER_EXCEPTION,
+                EVALUATE,///< <n_steps> uint64_t, the full parameter vectors, replied by the goal function of each
+                PING///< request without payload, replied by a PING
+            };
+
+            namespace calibration_msg {
+                template <class T>
+                calibration_message_type read_type(T& in) {
+                    int32_t mtype;
+                    in.read((char*)&mtype, sizeof(mtype));
+                    if (!in)
+                        throw runtime_error("calibration: failed to read message type");
+                    return (calibration_message_type)mtype;
+                }
+                template <class T>
+                void write_type(calibration_message_type mt, T& out) {
+                    int32_t mtype = (int32_t)mt;
+                    out.write((const char*)&mtype, sizeof(mtype));
+                }
+            }
+
+            /** \brief a server evaluating calibration candidates for a remote optimizer
+             *
+             * The worker process holds its own replica of the region-model, with the same cells, environment, initial state and targets
+             * as the master, typically an optimizer made as on the master, with prepare_optimize done, where the evaluate is
+             * optimizer::evaluate_parameter_sets, so the goal functions are those the master would compute.
+             * One evaluation runs at the time, since each uses the cores of the node, ref. optimizer::set_concurrent_evaluations.
+             */
+            struct calibration_worker : dlib::server_iostream {
+                typedef function<vector<double>(const vector<vector<double>>&, size_t)> evaluate_t;
+                evaluate_t evaluate;///< the goal function of each full parameter vector, run the given time-steps, 0 means all
+                atomic<size_t> n_evaluated{0};///< the parameter vectors evaluated
+
+                explicit calibration_worker(evaluate_t f) : evaluate(std::move(f)) {}
+
+                void on_connect(istream& in, ostream& out, const string& /*foreign_ip*/, const string& /*local_ip*/,
+                                unsigned short /*foreign_port*/, unsigned short /*local_port*/, dlib::uint64 /*connection_id*/) override {
+                    while (in.peek() != EOF) {
+                        auto t = calibration_msg::read_type(in);
+                        try {
+                            switch (t) {
+                            case calibration_message_type::EVALUATE: {
+                                uint64_t n_steps{0};
+                                vector<vector<double>> ps;
+                                {
+                                    core_iarchive ia(in, core_arch_flags);
+                                    ia >> n_steps >> ps;
+                                }
+                                vector<double> fx;
+                                {
+                                    lock_guard<mutex> guard(mx);
+                                    fx = evaluate(ps, size_t(n_steps));
+                                }
+                                n_evaluated += ps.size();
+                                calibration_msg::write_type(calibration_message_type::EVALUATE, out);
+                                core_oarchive oa(out, core_arch_flags);
+                                oa << fx;
+                            } break;
+                            case calibration_message_type::PING:
+                                calibration_msg::write_type(calibration_message_type::PING, out);
+                                break;
+                            default:
+                                throw runtime_error("calibration_worker: got unknown message type " + to_string((int)t));
+                            }
+                        } catch (const exception& e) {
+                            calibration_msg::write_type(calibration_message_type::SERVER_EXCEPTION, out);
+                            dtss::msg::write_exception(e, out);
+                        }
+                        out.flush();
+                    }
+                }
+              private:
+                mutex mx;///< one evaluation at the time
+            };
+
+            /** \brief distributes the candidates of an optimizer batch to calibration_workers, ref. optimizer::set_remote_evaluation
+             *
+             * A batch is split in chunks of chunk_size candidates, and each worker takes the next chunk as soon as it has replied
+             * to the previous, so faster nodes take more of the batch.
+             * A chunk is lost if the worker can not be connected, fails, or does not reply within timeout_ms, then it is
+             * re-dispatched to the other workers, and the worker is not used for the rest of the batch.
+             * Each batch tries all the workers again, so a restarted worker is used from the next batch.
+             * An exception raised by the evaluation of a worker, that would be the same on any worker, is passed to the caller.
+             */
+            struct calibration_dispatcher {
+                vector<string> host_ports;///< the workers, as host:port
+                int timeout_ms;///< max time for a worker to evaluate a chunk
+                size_t chunk_size;///< candidates sent at the time, 0 means the batch split in two chunks for each worker
+                size_t n_redispatched{0};///< chunks re-dispatched, since construction
+                size_t n_alive{0};///< workers that completed their last chunk of the last batch
+
+                explicit calibration_dispatcher(const vector<string>& host_ports, int timeout_ms = 600000, size_t chunk_size = 0)
+                  : host_ports(host_ports), timeout_ms(timeout_ms), chunk_size(chunk_size) {
+                    if (host_ports.empty())
+                        throw runtime_error("calibration_dispatcher: no workers");
+                }
+
+                /** \return the goal function of each full parameter vector of ps, run n_steps, as the workers evaluate them */
+                vector<double> operator()(const vector<vector<double>>& ps, size_t n_steps) {
+                    vector<double> fx(ps.size(), shyft::nan);
+                    if (ps.empty())
+                        return fx;
+                    const size_t n_chunk = chunk_size ? chunk_size : std::max(size_t(1), (ps.size() + 2*host_ports.size() - 1)/(2*host_ports.size()));
+                    deque<pair<size_t, size_t>> pending;// [i0,i1) of ps
+                    for (size_t i0 = 0; i0 < ps.size(); i0 += n_chunk)
+                        pending.emplace_back(i0, std::min(ps.size(), i0 + n_chunk));
+                    mutex mx;
+                    size_t n_done = 0, n_lost = 0;
+                    string evaluation_error;// the first exception from an evaluation, that is not a lost chunk
+                    auto work = [&](const string& host_port) {
+                        dtss::srv_connection c{make_unique<dlib::iosockstream>(), host_port, timeout_ms};
+                        for (;;) {
+                            pair<size_t, size_t> chunk;
+                            {
+                                lock_guard<mutex> guard(mx);
+                                if (pending.empty() || evaluation_error.size())
+                                    return true;
+                                chunk = pending.front();
+                                pending.pop_front();
+                            }
+                            try {
+                                auto r = evaluate_chunk(c, ps, chunk, n_steps);
+                                lock_guard<mutex> guard(mx);
+                                std::copy(r.begin(), r.end(), fx.begin() + chunk.first);
+                                n_done += chunk.second - chunk.first;
+                            } catch (const evaluation_failed& e) {
+                                lock_guard<mutex> guard(mx);
+                                if (evaluation_error.empty())
+                                    evaluation_error = e.what();
+                                return true;
+                            } catch (...) {// lost, to the other workers
+                                lock_guard<mutex> guard(mx);
+                                pending.push_back(chunk);
+                                ++n_lost;
+                                return false;
+                            }
+                        }
+                    };
+                    for (;;) {// the workers of a round run until the chunks are done, or they are lost
+                        vector<future<bool>> w;
+                        for (const auto& hp : host_ports)
+                            w.push_back(async(launch::async, work, hp));
+                        size_t alive = 0;
+                        for (auto& f : w)
+                            alive += f.get() ? 1 : 0;
+                        n_alive = alive;
+                        n_redispatched += n_lost;
+                        n_lost = 0;
+                        if (evaluation_error.size())
+                            throw runtime_error(evaluation_error);
+                        if (n_done == ps.size())
+                            return fx;
+                        if (alive == 0)
+                            throw runtime_error("calibration_dispatcher: all workers are lost, " + to_string(ps.size() - n_done) + " candidates not evaluated");
+                        // a chunk was lost after the others were done, so try all the workers again for the rest
+                    }
+                }
+
+              private:
+                /** an exception raised by the evaluation at the worker, not by the connection */
+                struct evaluation_failed : runtime_error {
+                    explicit evaluation_failed(const runtime_error& e) : runtime_error(e) {}
+                };
+
+                vector<double> evaluate_chunk(dtss::srv_connection& c, const vector<vector<double>>& ps, pair<size_t, size_t> chunk, size_t n_steps) {
+                    c.open();
+                    struct closed_at_exit {
+                        dtss::srv_connection& c;
+                        ~closed_at_exit() { try { c.close(); } catch (...) {} }
+                    } closed{c};
+                    auto& io = *c.io;
+                    io.terminate_connection_after_timeout(timeout_ms);// a hanging worker loses the chunk
+                    calibration_msg::write_type(calibration_message_type::EVALUATE, io);
+                    {
+                        core_oarchive oa(io, core_arch_flags);
+                        uint64_t n = n_steps;
+                        vector<vector<double>> p(ps.begin() + chunk.first, ps.begin() + chunk.second);
+                        oa << n << p;
+                    }
+                    io.flush();
+                    auto t = calibration_msg::read_type(io);
+                    if (t == calibration_message_type::SERVER_EXCEPTION)
+                        throw evaluation_failed(dtss::msg::read_exception(io));
+                    if (t != calibration_message_type::EVALUATE)
+                        throw runtime_error("calibration_dispatcher: got unexpected response " + to_string((int)t));
+                    vector<double> fx;
+                    core_iarchive ia(io, core_arch_flags);
+                    ia >> fx;
+                    if (fx.size() != chunk.second - chunk.first)
+                        throw runtime_error("calibration_dispatcher: got " + to_string(fx.size()) + " goal functions, expected " + to_string(chunk.second - chunk.first));
+                    return fx;
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+namespace shyft {
+    namespace core {
+
+        /** \brief per-catchment sums of cell responses, accumulated while the cells run
+         *
+         * The usual response collectors keep one time-series for each response of each cell,
+         * so memory scales with the number of cells, and catchment_discharges then sums it up afterwards.
+         * A collector that uses this class instead adds its contribution directly to catchment sums,
+         * so memory scales with number of catchments x number of threads.
+         *
+         * Each thread that runs cells gets its own slab of partial sums, obtained through local_slab(),
+         * thus collect() is a plain, lock-free add. The slabs are merged by sum() when the result is requested.
+         *
+         * The slab layout is [(cix*n_steps + i)*n_responses + r], so that one cell collecting
+         * all responses for a time-step touches one cache-line.
+         *
+         * \note reset() must be called before the cells are run, as region_model::run_cells does, and
+         *       no cells may run while reset() or sum() executes.
+         */
+        class catchment_accumulator {
+        public:
+            enum response_ix { discharge = 0, charge = 1, snow_sca = 2, snow_swe = 3, n_responses = 4 };///< snow_sca and snow_swe are summed as value x cell area
+        private:
+            size_t n_catchments_ = 0;
+            size_t n_steps_ = 0;
+            size_t generation = 0;///< unique over all accumulators, changes on each reset, invalidates the thread-local slab cache
+            size_t n_used = 0;///< slabs handed out since last reset
+            std::deque<std::vector<double>> slabs;///< deque, so that handed out slabs stays in place when we add more
+            std::mutex mx;
+
+            static size_t next_generation() {
+                static std::atomic<size_t> g{0};
+                return ++g;
+            }
+
+            size_t slab_size() const { return n_catchments_*n_steps_*n_responses; }
+
+        public:
+            catchment_accumulator() = default;
+            catchment_accumulator(const catchment_accumulator&) = delete;
+            catchment_accumulator& operator=(const catchment_accumulator&) = delete;
+
+            size_t n_catchments() const { return n_catchments_; }
+            size_t n_steps() const { return n_steps_; }
+            size_t n_slabs() const { return slabs.size(); }
+            /** \return approx. heap bytes of the slabs */
+            size_t heap_bytes() const { size_t b = 0; for (const auto& s : slabs) b += sizeof(s) + s.capacity()*sizeof(double); return b; }
+
+            /** \brief prepare for a run covering time-steps [i0..i1)
+             *
+             * If the dimensions changes, all sums are cleared, otherwise only the range [i0..i1) is cleared,
+             * keeping the results from earlier runs outside the range, similar to ts_init for the cell collectors.
+             */
+            void reset(size_t n_catchments, size_t n_steps, size_t i0, size_t i1) {
+                std::lock_guard<std::mutex> lock(mx);
+                if (n_catchments != n_catchments_ || n_steps != n_steps_) {
+                    n_catchments_ = n_catchments;
+                    n_steps_ = n_steps;
+                    slabs.clear();
+                } else {
+                    i1 = std::min(i1, n_steps_);
+                    for (auto& s : slabs)
+                        for (size_t c = 0; c < n_catchments_; ++c)
+                            std::fill(s.begin() + (c*n_steps_ + i0)*n_responses, s.begin() + (c*n_steps_ + i1)*n_responses, 0.0);
+                }
+                n_used = 0;
+                generation = next_generation();
+            }
+
+            /** \return the partial sum slab of the calling thread, valid until next reset() */
+            double* local_slab() {
+                struct slab_cache { size_t generation = 0; double* slab = nullptr; };
+                static thread_local slab_cache tc;
+                if (tc.generation == generation && tc.slab)
+                    return tc.slab;
+                std::lock_guard<std::mutex> lock(mx);
+                if (n_used == slabs.size())
+                    slabs.emplace_back(slab_size(), 0.0);
+                tc.slab = slabs[n_used++].data();
+                tc.generation = generation;
+                return tc.slab;
+            }
+
+            /** \brief add the responses of one cell at time-step i into slab */
+            void add(double* slab, size_t cix, size_t i, double discharge_m3s, double charge_m3s) const {
+                double* p = slab + (cix*n_steps_ + i)*n_responses;
+                p[discharge] += discharge_m3s;
+                p[charge] += charge_m3s;
+            }
+
+            /** \brief add the area weighted snow responses of one cell at time-step i into slab */
+            void add_snow(double* slab, size_t cix, size_t i, double sca_x_area, double swe_x_area) const {
+                double* p = slab + (cix*n_steps_ + i)*n_responses;
+                p[snow_sca] += sca_x_area;
+                p[snow_swe] += swe_x_area;
+            }
+
+            /** \brief add the merged sum over all threads, for catchment cix and response r, to v[0..n_steps) */
+            void add_sum_to(size_t cix, response_ix r, double* v) const {
+                for (auto const& s : slabs) {
+                    const double* p = s.data() + cix*n_steps_*n_responses + r;
+                    for (size_t i = 0; i < n_steps_; ++i)
+                        v[i] += p[i*n_responses];
+                }
+            }
+
+            /** \return the merged sum over all threads, for catchment cix and response r */
+            std::vector<double> sum(size_t cix, response_ix r) const {
+                std::vector<double> v(n_steps_, 0.0);
+                add_sum_to(cix, r, v.data());
+                return v;
+            }
+        };
+
+        /** \brief detects response collectors that aggregate into a catchment_accumulator,
+         * i.e. that have an .accumulator member, like pt_gs_k::catchment_collector
+         */
+        template <class RC, class = void>
+        struct has_catchment_accumulator : std::false_type {};
+
+        template <class RC>
+        struct has_catchment_accumulator<RC, decltype(void(std::declval<RC&>().accumulator))> : std::true_type {};
+    }
+}
@@ -12,8 +12,10 @@
 #include <stdexcept>
 
 #include "core/core_serialization.h"
+#include "core/thread_pool.h"
 
 #include "time_series.h"
+#include "memory_usage.h"
 #include "geo_cell_data.h"
 
 namespace shyft {
@@ -22,6 +24,8 @@ namespace shyft {
 		using namespace shyft;
 		// and typedefs for commonly used types in the model
 		typedef point_ts<time_axis::fixed_dt> pts_t;
+		typedef point_ts<time_axis::fixed_dt, float> pts_f32_t;///< float storage, for large ensembles where footprint matters more than precision
+		typedef shared_point_ts<time_axis::fixed_dt> spts_t;///< copies share the values, ref. environment_shared_t
 		typedef constant_timeseries<time_axis::fixed_dt> cts_t;
 		typedef time_axis::fixed_dt timeaxis_t;
 
@@ -74,6 +78,10 @@ namespace shyft {
 		typedef environment<timeaxis_t, pts_t, pts_t, pts_t, cts_t, cts_t> environment_const_rhum_and_wind_t;
 		///< environment type with all properties as general time_series
 		typedef environment<timeaxis_t, pts_t, pts_t, pts_t, pts_t, pts_t> environment_t;
+		///< environment type with all properties as float storage time_series, the calculations are still done in double
+		typedef environment<timeaxis_t, pts_f32_t, pts_f32_t, pts_f32_t, pts_f32_t, pts_f32_t> environment_f32_t;
+		///< environment type where cells can share one series, like the single source broadcast of region_model::run_interpolation
+		typedef environment<timeaxis_t, spts_t, spts_t, spts_t, spts_t, spts_t> environment_shared_t;
 
 		///< utility function to create an instance of a environment based on function (auto-template by arguments)
 		template<class timeaxis, class temperature_ts, class precipitation_ts, class radiation_ts, class relhum_ts, class windspeed_ts>
@@ -141,6 +149,14 @@ namespace shyft {
 			void set_state_collection(bool on) {}
 			///< collecting the snow sca and swe on for calibration scenarios, default throws
 			void set_snow_sca_swe_collection(bool on) {/*default simply ignore*/}
+			/** \brief run a batch of cells timestep-major, to be specialized by cell types that support stepping
+			 *
+			 * The default falls back to running each cell cell-major, so any cell type can be used with
+			 * region_model::run_cells_timestep_major.
+			 */
+			static void run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+				for (size_t j = 0; j < n; ++j) batch[j]->run(time_axis, start_step, n_steps);
+			}
 			/// run the cell method stack for  a specified time-axis, to be specialized by cell type
 			void run(const timeaxis_t& t, int start_step, int n_steps) {}
 			///< operator equal if same midpoint and catchment-id
@@ -150,16 +166,25 @@ namespace shyft {
 		};
         /**Utility function used to  initialize a pts_t in the core, typically making space, fill a ts
         *  prior to a run to ensure values are zero */
-        inline void ts_init(pts_t&ts, time_axis::fixed_dt const& ta, int start_step, int n_steps, ts_point_fx fx_policy) {
+        template <class V>
+        inline void ts_init(point_ts<time_axis::fixed_dt, V>&ts, time_axis::fixed_dt const& ta, int start_step, int n_steps, ts_point_fx fx_policy) {
             double const fill_value=shyft::nan;
             if (ts.ta != ta || ta.size()==0 ) {
-                ts = pts_t(ta, fill_value, fx_policy);
+                ts = point_ts<time_axis::fixed_dt, V>(ta, fill_value, fx_policy);
             } else {
                 ts.fill_range(fill_value, start_step, n_steps);
             }
         }
 
         using namespace std;
+
+        /** \brief the feature values of a set of cells, for all the time-steps, ref. cell_statistics::catchment_feature_matrix */
+        struct cell_feature_matrix {
+            size_t n_cells{0};///< number of rows
+            size_t n_steps{0};///< number of columns, the time-steps of the feature ts
+            vector<double> v;///< row-major, v[i*n_steps + j] is the value of cell i at time-step j
+        };
+
         /** \brief cell statistics provides ts feature summation over cells
          *
          * Since the cells are different, like different features, based on
@@ -185,6 +210,114 @@ namespace shyft {
 						throw runtime_error(string("one or more supplied catchment_indexes does not exist:") + to_string(cid));
 			}
 
+			/** \brief the indices of the cells of each catchment of catchment_indexes, in one pass over the cells
+			 *
+			 * \param cells the cells to index
+			 * \param catchment_indexes list of catchment-id, if zero length, one list with all the cells is returned
+			 * \throw runtime_error if catchment_indexes contains cid that's not part of cells
+			 * \return r[k] is the ascending indices of the cells of catchment_indexes[k]
+			 */
+			template<typename cell>
+			static vector<vector<size_t>> catchment_cell_lists(const vector<cell>& cells, const vector<int>& catchment_indexes) {
+				vector<vector<size_t>> r(std::max<size_t>(1, catchment_indexes.size()));
+				if (catchment_indexes.size() == 0) {
+					r[0].resize(cells.size());
+					for (size_t i = 0; i < cells.size(); ++i) r[0][i] = i;
+					return r;
+				}
+				map<size_t, size_t> slot;// first k of each cid, duplicates are copied at the end
+				for (size_t k = 0; k < catchment_indexes.size(); ++k)
+					slot.emplace(size_t(catchment_indexes[k]), k);
+				for (size_t i = 0; i < cells.size(); ++i) {
+					auto f = slot.find(cells[i].geo.catchment_id());
+					if (f != slot.end()) r[f->second].push_back(i);
+				}
+				for (size_t k = 0; k < catchment_indexes.size(); ++k) {
+					const size_t k0 = slot[size_t(catchment_indexes[k])];
+					if (k0 != k) r[k] = r[k0];
+					if (r[k].empty())
+						throw runtime_error(string("one or more supplied catchment_indexes does not exist:") + to_string(catchment_indexes[k]));
+				}
+				return r;
+			}
+
+			/** \return the ascending indices of the cells that are in any of catchment_indexes, all if zero length
+			 * \throw runtime_error if catchment_indexes contains cid that's not part of cells
+			 */
+			template<typename cell>
+			static vector<size_t> catchment_cells(const vector<cell>& cells, const vector<int>& catchment_indexes) {
+				auto l = catchment_cell_lists(cells, catchment_indexes);
+				if (l.size() == 1) return std::move(l[0]);
+				vector<size_t> r;
+				for (const auto& x : l) r.insert(r.end(), x.begin(), x.end());
+				std::sort(r.begin(), r.end());
+				r.erase(std::unique(r.begin(), r.end()), r.end());
+				return r;
+			}
+
+			/** \brief the sum of the feature of the cells ix, optionally area-weighted, as a parallel reduction
+			 *
+			 * The cells are split in at most max_parts contiguous parts, by size only, each summed on the executor pool,
+			 * and the parts are added in order, so the result does not depend on the number of threads.
+			 * \param sum_area if not null, set to the sum of the area of the cells ix
+			 * \return the sum, with the time-axis of the feature of the first cell, null if ix is empty
+			 */
+			template<typename cell, typename cell_feature_ts>
+			static shared_ptr<pts_t> sum_cells(const vector<cell>& cells, const vector<size_t>& ix, cell_feature_ts&& cell_ts,
+				bool area_weighted, double* sum_area = nullptr) {
+				if (sum_area) {
+					*sum_area = 0.0;
+					for (auto i : ix) *sum_area += cells[i].geo.area();
+				}
+				if (ix.empty()) return nullptr;
+				constexpr size_t min_part_cells = 64, max_parts = 32;
+				const size_t n_parts = std::min(max_parts, (ix.size() + min_part_cells - 1)/min_part_cells);
+				const size_t part = (ix.size() + n_parts - 1)/n_parts;
+				const auto ta = cell_ts(cells[ix[0]]).ta;
+				vector<pts_t> s(n_parts, pts_t(ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE));
+				auto sum_part = [&](size_t p0, size_t p1) {
+					for (size_t p = p0; p < p1; ++p)
+						for (size_t j = p*part; j < std::min(ix.size(), (p + 1)*part); ++j) {
+							const auto& c = cells[ix[j]];
+							if (area_weighted) s[p].add_scale(cell_ts(c), c.geo.area());
+							else s[p].add(cell_ts(c));
+						}
+				};
+				if (n_parts == 1) sum_part(0, 1);
+				else executor::instance()->parallel_for(n_parts, 1, sum_part);
+				auto r = make_shared<pts_t>(std::move(s[0]));
+				for (size_t p = 1; p < n_parts; ++p) r->add(s[p]);
+				return r;
+			}
+
+			/** \brief sum_catchment_features returns the sum of cell-features for each catchment, from one indexing pass over the cells
+			 *
+			 * Instead of one scan of the cells for each catchment, as with sum_catchment_feature, the cells are indexed once,
+			 * ref. catchment_cell_lists, and the catchments are summed in parallel.
+			 * \param cells that we want to perform calculation on
+			 * \param catchment_indexes list of catchment-id, if zero length, one sum of all cells is returned
+			 * \param cell_ts a callable that fetches the cell feature we want to sum
+			 * \param area_weighted_average if true, the area-weighted average of each catchment, as average_catchment_feature
+			 * \throw runtime_error if number of cells are zero, or a catchment-id is not part of cells
+			 * \return r[k] is the sum, or average, of catchment_indexes[k]
+			 */
+			template<typename cell, typename cell_feature_ts>
+			static vector<shared_ptr<pts_t>> sum_catchment_features(const vector<cell>& cells, const vector<int>& catchment_indexes,
+				cell_feature_ts&& cell_ts, bool area_weighted_average = false) {
+				if (cells.size() == 0)
+					throw runtime_error("no cells to make statistics on");
+				const auto l = catchment_cell_lists(cells, catchment_indexes);
+				vector<shared_ptr<pts_t>> r(l.size());
+				executor::instance()->parallel_for(l.size(), 1, [&](size_t k0, size_t k1) {
+					for (size_t k = k0; k < k1; ++k) {
+						double a = 0.0;
+						r[k] = sum_cells(cells, l[k], cell_ts, area_weighted_average, &a);
+						if (area_weighted_average) r[k]->scale_by(1/a);
+					}
+				});
+				return r;
+			}
+
             /** \brief average_catchment_feature returns the area-weighted average
              *
              * \tparam cell the cell type, assumed to have .geo.area(), and geo.catchment_id()
@@ -200,26 +333,8 @@ namespace shyft {
                                                                cell_feature_ts&& cell_ts) {
                 if (cells.size() == 0)
                     throw runtime_error("no cells to make statistics on");
-				verify_cids_exist(cells, catchment_indexes);
-                shared_ptr<pts_t> r;
 				double sum_area = 0.0;
-				bool match_all = catchment_indexes.size() == 0;
-				for (const auto& c : cells) {
-                    if (match_all) {
-                        if(!r) r= make_shared<pts_t>(cell_ts(c).ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
-                        r->add_scale(cell_ts(c), c.geo.area());  // c.env_ts.temperature, could be a feature(c) func return ref to ts
-                        sum_area += c.geo.area();
-                    } else {
-                        for (auto cid : catchment_indexes) {
-                            if ( c.geo.catchment_id() == (size_t) cid) { // criteria
-                                if (!r) r = make_shared<pts_t>(cell_ts(c).ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
-                                r->add_scale(cell_ts(c), c.geo.area());  // c.env_ts.temperature, could be a feature(c) func return ref to ts
-                                sum_area += c.geo.area();
-                                break;
-                            }
-                        }
-                    }
-				}
+				auto r = sum_cells(cells, catchment_cells(cells, catchment_indexes), cell_ts, true, &sum_area);
 				r->scale_by(1/sum_area); // sih: if no match, then you will get nan here, and I think thats reasonable
 				return r;
 			}
@@ -240,23 +355,12 @@ namespace shyft {
 				cell_feature_ts&& cell_ts,size_t i) {
 				if (cells.size() == 0)
 					throw runtime_error("no cells to make statistics on");
-				verify_cids_exist(cells, catchment_indexes);
 				double r = 0.0;
 				double sum_area = 0.0;
-				bool match_all = catchment_indexes.size() == 0;
-				for (const auto& c : cells) {
-					if (match_all) {
-						r += cell_ts(c).value(i)*c.geo.area();  // c.env_ts.temperature, could be a feature(c) func return ref to ts
-						sum_area += c.geo.area();
-					} else {
-						for (auto cid : catchment_indexes) {
-							if (c.geo.catchment_id() == (size_t)cid) { // criteria
-								r += cell_ts(c).value(i)*c.geo.area();  // c.env_ts.temperature, could be a feature(c) func return ref to ts
-								sum_area += c.geo.area();
-								break;
-							}
-						}
-					}
+				for (auto ix : catchment_cells(cells, catchment_indexes)) {
+					const auto& c = cells[ix];
+					r += cell_ts(c).value(i)*c.geo.area();
+					sum_area += c.geo.area();
 				}
 				r= r/ sum_area; // sih: if no match, then you will get nan here, and I think thats reasonable
 				return r;
@@ -278,25 +382,7 @@ namespace shyft {
                                                            cell_feature_ts && cell_ts) {
                 if (cells.size() == 0)
                     throw runtime_error("no cells to make statistics on");
-				verify_cids_exist(cells, catchment_indexes);
-                shared_ptr<pts_t> r;
-				bool match_all = catchment_indexes.size() == 0;
-
-				for (const auto& c : cells) {
-                    if (match_all) {
-                        if(!r) r= make_shared<pts_t>(cell_ts(c).ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
-                        r->add(cell_ts(c));
-                    } else {
-                        for (auto cid : catchment_indexes) {
-                            if (c.geo.catchment_id() == (size_t)cid) { //criteria
-                                if (!r) r = make_shared<pts_t>(cell_ts(c).ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
-                                r->add(cell_ts(c));  //c.env_ts.temperature, could be a feature(c) func return ref to ts
-                                break;
-                            }
-                        }
-                    }
-				}
-				return r;
+				return sum_cells(cells, catchment_cells(cells, catchment_indexes), cell_ts, false);
 			}
 			/** \brief sum_catchment_feature_value returns the sum of cell-features(discharge etc) value at the i'th timestep
 			*
@@ -314,22 +400,9 @@ namespace shyft {
 				cell_feature_ts && cell_ts, size_t i) {
 				if (cells.size() == 0)
 					throw runtime_error("no cells to make statistics on");
-				verify_cids_exist(cells, catchment_indexes);
 				double r = 0.0;
-				bool match_all = catchment_indexes.size() == 0;
-
-				for (const auto& c : cells) {
-					if (match_all) {
-						r += cell_ts(c).value(i);
-					} else {
-						for (auto cid : catchment_indexes) {
-							if (c.geo.catchment_id() == (size_t)cid) { //criteria
-								r+=cell_ts(c).value(i);  //c.env_ts.temperature, could be a feature(c) func return ref to ts
-								break;
-							}
-						}
-					}
-				}
+				for (auto ix : catchment_cells(cells, catchment_indexes))
+					r += cell_ts(cells[ix]).value(i);
 				return r;
 			}
 
@@ -349,21 +422,42 @@ namespace shyft {
 				cell_feature_ts && cell_ts,size_t i) {
 				if (cells.size() == 0)
 					throw runtime_error("no cells to make extract from");
-				verify_cids_exist(cells, catchment_indexes);
-				vector<double> r; r.reserve(cells.size());
-				bool match_all = catchment_indexes.size() == 0;
-
-				for (const auto& c : cells) {
-					if (match_all) {
-						r.push_back(cell_ts(c).value(i));
-					} else {
-						for (auto cid : catchment_indexes) {
-							if (c.geo.catchment_id() == (size_t)cid) { //criteria
-								r.push_back(cell_ts(c).value(i));  //c.env_ts.temperature, could be a feature(c) func return ref to ts
-								break;
-							}
-						}
+				const auto cix = catchment_cells(cells, catchment_indexes);
+				vector<double> r; r.reserve(cix.size());
+				for (auto ix : cix)
+					r.push_back(cell_ts(cells[ix]).value(i));
+				return r;
+			}
+
+			/** \brief catchment_feature_matrix extracts cell-features(discharge etc) for all time-steps of the timeaxis
+			*
+			* One call gives the values of all the matching cells, instead of one call for each time-step, or cell.
+			* \tparam cell the cell type, assumed to have geo.catchment_id()
+			* \tparam cell_feature_ts a callable that takes a const cell ref, returns a ts, preferably a reference, to avoid a copy
+			* \param cells that we want to extract feature from
+			* \param catchment_indexes list of catchment-id that identifies the cells, if zero length, all are extracted
+			* \param cell_ts a callable that fetches the cell feature ts
+			* \throw runtime_error if number of cells are zero, or the feature ts of the cells differ in size
+			* \return matrix with a row for each matching cell, in order of appearance, and a column for each time-step
+			*/
+			template<typename cell, typename cell_feature_ts>
+			static cell_feature_matrix catchment_feature_matrix(const vector<cell>& cells, const vector<int>& catchment_indexes,
+				cell_feature_ts && cell_ts) {
+				if (cells.size() == 0)
+					throw runtime_error("no cells to make extract from");
+				const auto cix = catchment_cells(cells, catchment_indexes);
+				cell_feature_matrix r;
+				for (auto ix : cix) {
+					const auto& ts = cell_ts(cells[ix]);
+					if (r.n_cells == 0) {
+						r.n_steps = ts.size();
+						r.v.reserve(cix.size()*r.n_steps);
+					} else if (ts.size() != r.n_steps) {
+						throw runtime_error("catchment_feature_matrix: the feature time-series of the cells differ in size");
 					}
+					for (size_t j = 0; j < r.n_steps; ++j)
+						r.v.push_back(ts.value(j));
+					++r.n_cells;
 				}
 				return r;
 			}
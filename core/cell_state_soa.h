@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace shyft {
+    namespace core {
+
+        /** \brief structure-of-arrays storage for the states of a set of cells
+         *
+         * The region_model keeps a std::vector<cell_t>, where each cell is a large aggregate
+         * of geo, parameter, state, env_ts and collectors. Iterating over the state of many cells
+         * thus jumps across memory. This template keeps each double valued state field of the
+         * method stack in a separate contiguous vector, so that a state field for cell i, i+1...
+         * is adjacent, and loops over cells can be vectorized.
+         *
+         * The cell vector remains the primary storage. The timestep-major runs
+         * (cell::run_batch, used by region_model::run_cells_timestep_major) gather the states of
+         * a batch of cells sharing the parameter into the arrays, step all cells on them, ref.
+         * pt_gs_k::batch_stepper and hbv_stack::batch_stepper, and scatter them back at the end.
+         * region_model::get_states_soa/set_states_soa moves all cell states in and out of it, and
+         * pt_gs_k::run_batch_offload stages the states of a batch in it for run_batch_soa.
+         *
+         * The method stacks specialize this by deriving from it, providing
+         *  - S the state type of the stack
+         *  - N the number of double fields in S
+         *  - static void pack(const S&s, double *v)  writes the N fields of s to v[0..N), stride 1
+         *  - static void unpack(const double*v, S&s)  reads the N fields from v
+         *  - static vector<string> field_names()  the names of the N fields, in pack order
+         * and named accessors to the field vectors (e.g. .q() for kirchner q), ref. pt_gs_k::state_soa.
+         *
+         * \tparam D the derived stack specific type (CRTP), supplying pack/unpack
+         * \tparam S the state type
+         * \tparam N number of double fields in the state
+         */
+        template <class D, class S, size_t N>
+        struct state_soa_base {
+            typedef S state_t;
+            static constexpr size_t n_fields = N;
+            std::array<std::vector<double>, N> f;///< f[k][i] is field k of cell i
+
+            size_t size() const { return f[0].size(); }
+            void resize(size_t n) { for (auto& v : f) v.resize(n); }
+            void clear() { for (auto& v : f) v.clear(); }
+
+            /** \return the i'th state, assembled from the field vectors */
+            S get(size_t i) const {
+                double v[N];
+                for (size_t k = 0; k < N; ++k) v[k] = f[k][i];
+                S s;
+                D::unpack(v, s);
+                return s;
+            }
+
+            /** \brief scatter state s into position i of the field vectors */
+            void set(size_t i, const S& s) {
+                double v[N];
+                D::pack(s, v);
+                for (size_t k = 0; k < N; ++k) f[k][i] = v[k];
+            }
+
+            /** \brief assign from a vector of states */
+            void assign(const std::vector<S>& states) {
+                resize(states.size());
+                for (size_t i = 0; i < states.size(); ++i) set(i, states[i]);
+            }
+
+            /** \return the content as a vector of states */
+            std::vector<S> to_vector() const {
+                std::vector<S> r; r.reserve(size());
+                for (size_t i = 0; i < size(); ++i) r.emplace_back(get(i));
+                return r;
+            }
+
+            /** \return contiguous vector of field k */
+            std::vector<double>& field(size_t k) { return f[k]; }
+            const std::vector<double>& field(size_t k) const { return f[k]; }
+        };
+
+        /** \brief gather the states of a range of cells into a state_soa
+         * \tparam SOA a state_soa type, ref. state_soa_base
+         * \tparam CI cell iterator type, where *CI  have a .state member
+         */
+        template <class SOA, class CI>
+        void gather_states(CI beg, CI end, SOA& soa) {
+            soa.resize(std::distance(beg, end));
+            size_t i = 0;
+            for (auto c = beg; c != end; ++c) soa.set(i++, c->state);
+        }
+
+        /** \brief scatter the states of a state_soa back into a range of cells
+         * \throw runtime_error if the size differs
+         */
+        template <class SOA, class CI>
+        void scatter_states(const SOA& soa, CI beg, CI end) {
+            if (size_t(std::distance(beg, end)) != soa.size())
+                throw std::runtime_error("scatter_states: size of state_soa (" + std::to_string(soa.size()) + ") must equal number of cells");
+            size_t i = 0;
+            for (auto c = beg; c != end; ++c) c->state = soa.get(i++);
+        }
+    }
+}
@@ -30,6 +30,7 @@
 #include "pt_gs_k.h"
 #include "pt_ss_k.h"
 #include "pt_hs_k.h"
+#include "routing.h"
 
 // then include stuff you need like vector,shared, base_obj,nvp etc.
 
@@ -90,6 +91,15 @@ void shyft::time_axis::fixed_dt::serialize(Archive & ar, const unsigned int vers
     ;
 }
 
+template <class Archive>
+void shyft::time_axis::fixed_dt_us::serialize(Archive & ar, const unsigned int version) {
+    ar
+    & core_nvp("t", t)
+    & core_nvp("dt",dt)
+    & core_nvp("n",n)
+    ;
+}
+
 template <class Archive>
 void shyft::time_axis::calendar_dt::serialize(Archive & ar, const unsigned int version) {
     ar
@@ -98,21 +108,27 @@ void shyft::time_axis::calendar_dt::serialize(Archive & ar, const unsigned int v
     & core_nvp("dt",dt)
     & core_nvp("n",n)
     ;
+    if (Archive::is_loading::value)
+        tbl = make_table(cal, t, dt, n);
 }
 
 template <class Archive>
 void shyft::time_axis::point_dt::serialize(Archive & ar, const unsigned int version) {
+    // same format as the plain vector, and no private copy when saving shared points
+    auto& tv = Archive::is_loading::value ? t.mut() : const_cast<std::vector<utctime>&>(t.vec());
     ar
-    & core_nvp("t", t)
+    & core_nvp("t", tv)
     & core_nvp("dt",t_end)
     ;
 }
 
 template <class Archive>
 void shyft::time_axis::generic_dt::serialize(Archive & ar,const unsigned int version) {
+    auto t = gt;
     ar
-    & core_nvp("gt", gt)
+    & core_nvp("gt", t)
     ;
+    set_type(t);// on load, switch the active member before reading it
     if (gt == shyft::time_axis::generic_dt::FIXED)
         ar & core_nvp("f", f);
     else if (gt == shyft::time_axis::generic_dt::CALENDAR)
@@ -243,6 +259,16 @@ void shyft::core::pt_hs_k::state::serialize(Archive & ar, const unsigned int fil
         ;
 }
 
+template <class Archive>
+void shyft::core::routing::state::serialize(Archive & ar, const unsigned int file_version) {
+    ar
+        & core_nvp("t", t)
+        & core_nvp("dt", dt)
+        & core_nvp("local_tail", local_tail)
+        & core_nvp("output_tail", output_tail)
+        ;
+}
+
 
 //-- export geo stuff
 x_serialize_implement(shyft::core::geo_point);
@@ -258,6 +284,7 @@ x_serialize_implement(shyft::core::calendar);
 
 //-- export time-axis
 x_serialize_implement(shyft::time_axis::fixed_dt);
+x_serialize_implement(shyft::time_axis::fixed_dt_us);
 x_serialize_implement(shyft::time_axis::calendar_dt);
 x_serialize_implement(shyft::time_axis::point_dt);
 x_serialize_implement(shyft::time_axis::generic_dt);
@@ -277,6 +304,7 @@ x_serialize_implement(shyft::core::pt_gs_k::state);
 x_serialize_implement(shyft::core::pt_hs_k::state);
 x_serialize_implement(shyft::core::pt_ss_k::state);
 x_serialize_implement(shyft::core::hbv_stack::state);
+x_serialize_implement(shyft::core::routing::state);
 
 //-- export predictors
 
@@ -291,6 +319,7 @@ x_arch(shyft::core::time_zone::tz_table);
 x_arch(shyft::core::calendar);
 
 x_arch(shyft::time_axis::fixed_dt);
+x_arch(shyft::time_axis::fixed_dt_us);
 x_arch(shyft::time_axis::calendar_dt);
 x_arch(shyft::time_axis::point_dt);
 x_arch(shyft::time_axis::generic_dt);
@@ -312,4 +341,5 @@ x_arch(shyft::core::pt_gs_k::state);
 x_arch(shyft::core::pt_hs_k::state);
 x_arch(shyft::core::pt_ss_k::state);
 x_arch(shyft::core::hbv_stack::state);
+x_arch(shyft::core::routing::state);
 
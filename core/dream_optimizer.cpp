@@ -8,7 +8,8 @@ namespace optimizer {
     double dream::find_max(
             ifx &fx,
             vector<double>& x,	// 0 < x < 1 The [input]initial/[output]current/optimal n parameter values
-            size_t max_iterations) const {
+            size_t max_iterations,
+            const warm_start* seed) const {
 
         const size_t n_parameters = x.size();
         double fx_optimal = -numeric_limits<double>::max();
@@ -42,7 +43,12 @@ namespace optimizer {
             chain_states[chain].resize(n_parameters);
         }
 
-        vector<double> x_candidates(n_parameters,0.0);	// Temporary vector containing parameter proposals to be evaluated
+        const size_t n_group = max(size_t(1), min(n_chains, fx.concurrency()));// Number of chains developed together, their candidates evaluated as one batch
+        vector<vector<double>> x_candidates(n_group, vector<double>(n_parameters,0.0));	// Temporary vectors containing parameter proposals to be evaluated, one for each chain of the group
+        vector<size_t> group_cr(n_group, 0);		// The cr index drawn for each chain of the group
+        vector<bool> group_reject(n_group, false);	// True if the proposal of the chain of the group is outside the box
+        vector<vector<double>> eval_candidates;	// The proposals inside the box, evaluated as one batch
+        vector<double> eval_prob;					// The posterior log-densities of eval_candidates
         vector<double> omega(n_chains,0.0);	// Last-half average log-post-densities for each chain
         vector<int> cr_L(n_cr,0);			// Number of candidates generated for each cr value
         vector<double> cr_D(n_cr,0.0);		// Sum of sq.norm.dist achieved for each cr value
@@ -52,13 +58,38 @@ namespace optimizer {
         size_t iteration_count = 0;
         double log_x_limit;
 
-        for (size_t i = 0; i < n_chains; ++i) {
+        // Start up to half of the chains from the best distinct points of the warm start, if any
+        size_t n_seeded = 0;
+        vector<bool> known(n_chains, false);// true if chain_prob[i] is given by the warm start
+        if (seed) {
+            const vector<double> x_lo(n_parameters, 0.0), x_hi(n_parameters, 1.0);
+            for (auto k : seed->pick(n_parameters, (n_chains + 1)/2, true, x_lo.data(), x_hi.data(), vector<vector<double>>{})) {
+                chain_states[n_seeded] = warm_start::clamped(seed->x[k], x_lo.data(), x_hi.data());
+                if (seed->reuse_fx && k < seed->fx.size() && std::isfinite(seed->fx[k])) {
+                    chain_prob[n_seeded] = seed->fx[k];
+                    known[n_seeded] = true;
+                }
+                ++n_seeded;
+            }
+        }
+        for (size_t i = n_seeded; i < n_chains; ++i) {
             // Generate random parameter values in their normalized range
             for (size_t p = 0; p < n_parameters; ++p) {
                 chain_states[i][p] = random01();
             }
-            chain_prob[i] = fx.evaluate(chain_states[i]);
-
+        }
+        if (n_seeded == 0) {
+            fx.evaluate_batch(chain_states, chain_prob);
+        } else {
+            vector<vector<double>> x_eval;
+            vector<double> prob_eval;
+            for (size_t i = 0; i < n_chains; ++i)
+                if (!known[i]) x_eval.push_back(chain_states[i]);
+            fx.evaluate_batch(x_eval, prob_eval);
+            for (size_t i = 0, j = 0; i < n_chains; ++i)
+                if (!known[i]) chain_prob[i] = prob_eval[j++];
+        }
+        for (size_t i = 0; i < n_chains; ++i) {
             // Store the best parameter set achieved so far, to serve as diagnostic output,
             // and to replace outlier states during burn-in with the HPD parameter set achieved so far.
             if (chain_prob[i] > fx_optimal) {
@@ -137,26 +168,16 @@ namespace optimizer {
                 x_variance[parameter] -= pow(mean, 2); // Variance of par[j] over chains
             }
 
-            // Develop the MCMC chain with index 'chain'
-            for (size_t chain = 0; chain < n_chains; ++chain) {
-                double jump_distance = 0; // The distance between previous (existing) parameter set and the new parameter set (accepted candidate) - squared and scaled by the previous-iter inter-chain posterior variance.
-                if (doing_burnin && outliers && omega[chain] < log_x_limit) {
-                    // This chain is an outlier; replace the chain states with the currently best parameter set and prob.
-                    // Chains with both current and average llh (log-likelihood) lower than Q1-2*(Q3-Q1) will be aborted and
-                    // restarted at the highest-probability state found so far in any chain.
-                    for (size_t i = 0; i < n_parameters; ++i) {
-                        // First calculate jump distance between the new candidates (the currently best
-                        // parameter set) and the existing parameter set for the chain.
-                        jump_distance += pow(chain_states[chain][i] - x[i], 2) / x_variance[i];
-                        // Then set the new candidate (current best) as the current values.
-                        chain_states[chain][i] = x[i];
-                    }
-                    chain_prob[chain] = fx_optimal;
-                    n_burnins = iteration_count + min_burnins;
-                    ++n_outliers;
-                } else {
-                    // No outlier, perform as normal.
-
+            // Develop the MCMC chains in groups of n_group chains: first generate the proposals of the group, then evaluate those
+            // inside the box as one batch, and finally accept or reject them in chain order.
+            // The proposals of a group are generated from the chain states at the start of the group.
+            for (size_t chain0 = 0; chain0 < n_chains; chain0 += n_group) {
+                const size_t chain1 = min(n_chains, chain0 + n_group);
+                eval_candidates.clear();
+                for (size_t chain = chain0; chain < chain1; ++chain) {
+                    const size_t k = chain - chain0;
+                    if (doing_burnin && outliers && omega[chain] < log_x_limit)
+                        continue;// replaced below
                     // Draw a random cross-over probability (cr).
                     // First draw a random index between 1 and n_cr, inclusive.
                     // The multinomial probability distribution is provided in the cr_M.
@@ -172,80 +193,110 @@ namespace optimizer {
                         ++i_cr;
                     }
                     double cr = (double) (i_cr + 1) / (double) n_cr; // Individual-parameter cross-over probability (the cr value)
+                    group_cr[k] = i_cr;
 
                     // Generate a candidate point for chain chain by adding up k difference-vectors
                     // between randomly selected pairs of the other chains
                     size_t d_eff = 0; // Number of actually changed parameter components
-                    generate_candidate_parameters(x_candidates, chain, n_chains, n_parameters, cr, d_eff, chain_states);
+                    generate_candidate_parameters(x_candidates[k], chain, n_chains, n_parameters, cr, d_eff, chain_states);
 
                     // Check if the candidate point is legal or must be rejected
                     bool reject = false;
                     for (size_t i = 0; i < n_parameters; ++i) {
-                        if (x_candidates[i] < 0 || x_candidates[i] > 1) {
+                        if (x_candidates[k][i] < 0 || x_candidates[k][i] > 1) {
                             // Parameter value is outside it's limits
                             reject = true;
                             break;
                         }
                     }
-
-                    // A proposed parameter value was outside range.
-                    // Probability is 0 without evaluation, but the rejected parameter
-                    // vector is still written out to the text file for diagnostics.
-                    if (reject) {
-                        ++n_pri_rejected;
+                    group_reject[k] = reject;
+                    if (!reject)
+                        eval_candidates.push_back(x_candidates[k]);
+                }
+                // The proposals inside the allowed box, we must run the model to evaluate likelihood
+                // Evaluate the posterior log-density for the candidate parameters, EvalModel provides the likelihood part.
+                if (eval_candidates.size())
+                    fx.evaluate_batch(eval_candidates, eval_prob);
+
+                size_t i_eval = 0;
+                for (size_t chain = chain0; chain < chain1; ++chain) {
+                    const size_t k = chain - chain0;
+                    double jump_distance = 0; // The distance between previous (existing) parameter set and the new parameter set (accepted candidate) - squared and scaled by the previous-iter inter-chain posterior variance.
+                    if (doing_burnin && outliers && omega[chain] < log_x_limit) {
+                        // This chain is an outlier; replace the chain states with the currently best parameter set and prob.
+                        // Chains with both current and average llh (log-likelihood) lower than Q1-2*(Q3-Q1) will be aborted and
+                        // restarted at the highest-probability state found so far in any chain.
+                        for (size_t i = 0; i < n_parameters; ++i) {
+                            // First calculate jump distance between the new candidates (the currently best
+                            // parameter set) and the existing parameter set for the chain.
+                            jump_distance += pow(chain_states[chain][i] - x[i], 2) / x_variance[i];
+                            // Then set the new candidate (current best) as the current values.
+                            chain_states[chain][i] = x[i];
+                        }
+                        chain_prob[chain] = fx_optimal;
+                        n_burnins = iteration_count + min_burnins;
+                        ++n_outliers;
                     } else {
-                        // The proposal is inside the allowed box, we must run the model to evaluate likelihood
-                        // Evaluate the posterior log-density for the candidate parameters, EvalModel provides the likelihood part.
-                        double cand_prob = fx.evaluate(x_candidates);
-
-                        // If the new candidate parameters results in better results (higher posterior log-density) than
-                        // the previous results for the same chain, the candidates will be accepted and become the
-                        // next item in the sequence. But if it has worse results (lower posterior log-density) it
-                        // can still be accepted - with a probability given by the ratio between the density of the
-                        // new (candidate) and the existing parameter set. This ratio between the density of the
-                        // candidate parameter set and the existing parameter set is calculated by using the exp function
-                        // on the log densities that the fx evaluation returns. Since exp is the the inverse of log, this
-                        // converts the log-density to density values. And exp(a-b) is the same as exp(a)/exp(b), so this
-                        // gives the ratio. To keep all candidates with better density and a randomized rejection of worse,
-                        // we compare the ratio to a random [0,1) value. If exp(a), the density of candidate, is larger
-                        // than exp(b), the density of existing, the result is larger than 1 and it will never be less
-                        // than a random [0,1) value. But if the density of the candidate is less than the density of
-                        // the existing it will be in the range [0,1], and therefore it may be rejected depending on
-                        // how it compares to a random [0,1) value!
-                        //    If the candidate is not accepted we call it post-rejected (rejected after evaluation),
-                        // and the existing parameter vector and results will be repeated for this chain (same as when pri-rejected).
-                        if (exp(cand_prob - chain_prob[chain]) < random01()) { // Using the ratio between the density of the candidate parameter vector and the existing compared to random [0,1) number to randomly reject candidates that are not better than the existing.
-                            // The proposal is a posteriori rejected chainstates[chain] already holds the values.
-                            n_post_rejected++;
+                        // No outlier, perform as normal.
+                        const size_t i_cr = group_cr[k];
+
+                        // A proposed parameter value was outside range.
+                        // Probability is 0 without evaluation, but the rejected parameter
+                        // vector is still written out to the text file for diagnostics.
+                        if (group_reject[k]) {
+                            ++n_pri_rejected;
                         } else {
-                            // The proposal is accepted. This will also happen when d_eff==0, since then candp==curprob[chain].
-                            ++n_accepted;
-                            chain_prob[chain] = cand_prob;
-                            for (size_t i = 0; i < n_parameters; ++i) {
-                                // Calculate jump distance between the new (now accepted) candidate parameter set
-                                // and the existing (previous) parameter set for the chain.
-                                jump_distance += pow(chain_states[chain][i] - x_candidates[i], 2) / x_variance[i];
-                                // Make the accepted candidate parameter set the current parameter set for the chain
-                                chain_states[chain][i] = x_candidates[i];
-                            }
-
-                            // Store the best parameter set achieved so far, to serve as diagnostic output,
-                            // and to replace outlier states during burn-in with the HPD parameter set achieved so far.
-                            if (chain_prob[chain] > fx_optimal) {
-                                fx_optimal = chain_prob[chain];
-                                x=chain_states[chain];
-                            }
-                        } // accepted (exp(candp-curprob[chain]) >= unif01())
-                    } // A posteriori evaluated block
-
-                    // Update the count and dist for cr value m.
-                    if (doing_burnin) {
-                        cr_L[i_cr]++; // Number of candidates generated for cr value m (i_cr)
-                        cr_D[i_cr] += jump_distance; // If accepted (only then jump_distance is > 0), alter sum of sq.norm.dist achieved for cr value m (i_cr)
-                    }
+                            double cand_prob = eval_prob[i_eval++];
+
+                            // If the new candidate parameters results in better results (higher posterior log-density) than
+                            // the previous results for the same chain, the candidates will be accepted and become the
+                            // next item in the sequence. But if it has worse results (lower posterior log-density) it
+                            // can still be accepted - with a probability given by the ratio between the density of the
+                            // new (candidate) and the existing parameter set. This ratio between the density of the
+                            // candidate parameter set and the existing parameter set is calculated by using the exp function
+                            // on the log densities that the fx evaluation returns. Since exp is the the inverse of log, this
+                            // converts the log-density to density values. And exp(a-b) is the same as exp(a)/exp(b), so this
+                            // gives the ratio. To keep all candidates with better density and a randomized rejection of worse,
+                            // we compare the ratio to a random [0,1) value. If exp(a), the density of candidate, is larger
+                            // than exp(b), the density of existing, the result is larger than 1 and it will never be less
+                            // than a random [0,1) value. But if the density of the candidate is less than the density of
+                            // the existing it will be in the range [0,1], and therefore it may be rejected depending on
+                            // how it compares to a random [0,1) value!
+                            //    If the candidate is not accepted we call it post-rejected (rejected after evaluation),
+                            // and the existing parameter vector and results will be repeated for this chain (same as when pri-rejected).
+                            if (exp(cand_prob - chain_prob[chain]) < random01()) { // Using the ratio between the density of the candidate parameter vector and the existing compared to random [0,1) number to randomly reject candidates that are not better than the existing.
+                                // The proposal is a posteriori rejected chainstates[chain] already holds the values.
+                                n_post_rejected++;
+                            } else {
+                                // The proposal is accepted. This will also happen when d_eff==0, since then candp==curprob[chain].
+                                ++n_accepted;
+                                chain_prob[chain] = cand_prob;
+                                for (size_t i = 0; i < n_parameters; ++i) {
+                                    // Calculate jump distance between the new (now accepted) candidate parameter set
+                                    // and the existing (previous) parameter set for the chain.
+                                    jump_distance += pow(chain_states[chain][i] - x_candidates[k][i], 2) / x_variance[i];
+                                    // Make the accepted candidate parameter set the current parameter set for the chain
+                                    chain_states[chain][i] = x_candidates[k][i];
+                                }
+
+                                // Store the best parameter set achieved so far, to serve as diagnostic output,
+                                // and to replace outlier states during burn-in with the HPD parameter set achieved so far.
+                                if (chain_prob[chain] > fx_optimal) {
+                                    fx_optimal = chain_prob[chain];
+                                    x=chain_states[chain];
+                                }
+                            } // accepted (exp(candp-curprob[chain]) >= unif01())
+                        } // A posteriori evaluated block
+
+                        // Update the count and dist for cr value m.
+                        if (doing_burnin) {
+                            cr_L[i_cr]++; // Number of candidates generated for cr value m (i_cr)
+                            cr_D[i_cr] += jump_distance; // If accepted (only then jump_distance is > 0), alter sum of sq.norm.dist achieved for cr value m (i_cr)
+                        }
 
-                } // Non-outlier block
-            } // for (int chain=0; chain<n_chains; chain++) // End single-chain development.
+                    } // Non-outlier block
+                } // for chain in group, accept or reject
+            } // for (chain0..) // End chain development.
 
 
             if (doing_burnin) {
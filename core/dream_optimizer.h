@@ -68,11 +68,12 @@ namespace shyft {
                  *  \param fx callable of type ifx
                  *  \param  x (in,out) [0..1] normalized starting point for the x-vector
                  *  \param  max_iterations stop at max iterations
+                 *  \param  seed if set, up to half of the chains start at the best distinct points of the seed, in the [0..1] space
                  *
                  *  \return the found maximum value
                  *  \throw runtime_exception if wrong parameters, or no convergence
                  */
-                double find_max(ifx &fx,vector<double>& x,size_t max_iterations) const;
+                double find_max(ifx &fx,vector<double>& x,size_t max_iterations,const warm_start* seed=nullptr) const;
 
             private:
                 void generate_candidate_parameters(vector<double> &cand,// Returned vector of length d
@@ -1,7 +1,16 @@
+#include <deque>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <sstream>
 #include <boost/functional/hash.hpp>
 #include "dtss.h"
+#include "dtss_client.h"
+#include "dtss_msg_flat.h"
 #include "core_serialization.h"
 #include "expression_serialization.h"
+#include "expression_simplify.h"
 #include "core_archive.h"
 namespace shyft {
 namespace dtss {
@@ -15,9 +24,12 @@ using std::size_t;
 using shyft::core::core_iarchive;
 using shyft::core::core_oarchive;
 using shyft::time_series::dd::ts_bind_info;
+using shyft::time_series::dd::ts_bind_set;
 using shyft::time_series::dd::deflate_ts_vector;
 using shyft::time_series::dd::expression_decompressor;
 using shyft::time_series::dd::compressed_ts_expression;
+using shyft::time_series::dd::expression_cse;
+using shyft::time_series::dd::expression_simplifier;
 
 struct utcperiod_hasher {
     size_t operator()(const utcperiod&k) const {
@@ -32,12 +44,325 @@ struct utcperiod_hasher {
 
 std::string shyft_prefix{ "shyft://" };
 
+/** \brief the cluster state of a server, ref. server::set_cluster
+ *
+ * Holds a client for each of the other nodes, and the queue of stores to replicate,
+ * sent to the replicas, in order, by one thread.
+ */
+struct cluster_node {
+    hash_ring ring;
+    size_t self;
+    size_t replication;
+    vector<unique_ptr<client>> peers;///< client of each node, null for self
+
+    cluster_node(const vector<string>& host_ports, size_t self, size_t replication)
+        :ring(host_ports.size()), self(self), replication(std::max<size_t>(1, std::min(replication, host_ports.size()))) {
+        if (self >= host_ports.size())
+            throw runtime_error("dtss: cluster node " + std::to_string(self) + " is not one of the " + std::to_string(host_ports.size()) + " host_ports");
+        for (size_t i = 0; i < host_ports.size(); ++i)
+            peers.push_back(i == self ? nullptr : make_unique<client>(host_ports[i], true, 1000));
+        worker = std::thread([this]() { work(); });
+    }
+    ~cluster_node() {
+        {
+            std::lock_guard<std::mutex> guard(mx);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    /** \return the nodes of id, the primary first, none if it is not a shyft:// series */
+    vector<size_t> nodes_of(const string& id) const {
+        if (extract_shyft_url_container(id).empty())
+            return vector<size_t>{};
+        return ring.nodes_of(id, replication);
+    }
+    bool is_local(const string& id) const {
+        auto n = nodes_of(id);
+        return n.empty() || std::find(n.begin(), n.end(), self) != n.end();
+    }
+    /** \return the node to read the remote id from, round-robin on its nodes */
+    size_t read_node(const string& id) {
+        auto n = ring.nodes_of(id, replication);
+        return n[next_read++ % n.size()];
+    }
+
+    /** \return the series of tsv that another node is primary of, by the node, the others are appended to local */
+    std::map<size_t, ts_vector_t> split_by_primary(const ts_vector_t& tsv, ts_vector_t& local) const {
+        std::map<size_t, ts_vector_t> r;
+        for (const auto& ts : tsv) {
+            auto rts = dynamic_pointer_cast<aref_ts>(ts.ts);
+            auto n = rts ? nodes_of(rts->id) : vector<size_t>{};
+            if (n.empty() || n.front() == self)
+                local.push_back(ts);
+            else
+                r[n.front()].push_back(ts);
+        }
+        return r;
+    }
+
+    /** read ts_ids[i] for i in ix, all remote, into r[i], from the nodes of each, one evaluate for each node */
+    void read(const id_vector_t& ts_ids, const vector<size_t>& ix, utcperiod p, ts_vector_t& r) {
+        std::map<size_t, vector<size_t>> by_node;
+        for (auto i : ix)
+            by_node[read_node(ts_ids[i])].push_back(i);
+        auto read_node_ix = [&](size_t node, const vector<size_t>& nix) {
+            ts_vector_t refs; refs.reserve(nix.size());
+            for (auto i : nix)
+                refs.push_back(apoint_ts(ts_ids[i]));
+            auto o = peers[node]->evaluate(refs, p, false, false);
+            if (o.size() != nix.size())
+                throw runtime_error("dtss: cluster node " + std::to_string(node) + " returned " + std::to_string(o.size()) + " time-series for " + std::to_string(nix.size()) + " ids");
+            for (size_t k = 0; k < nix.size(); ++k)
+                r[nix[k]] = o[k];
+        };
+        if (by_node.size() == 1) {
+            read_node_ix(by_node.begin()->first, by_node.begin()->second);
+            return;
+        }
+        vector<std::future<void>> reads;
+        for (const auto& x : by_node)
+            reads.push_back(std::async(std::launch::async, [&read_node_ix, &x]() { read_node_ix(x.first, x.second); }));
+        for (auto& f : reads)
+            f.get();
+    }
+
+    /** queue the series of tsv with this node as primary, saved, for replication to their other nodes */
+    void replicate(const ts_vector_t& tsv, bool overwrite_on_write, bool cache_on_write) {
+        std::map<size_t, ts_vector_t> by_node;
+        for (const auto& ts : tsv) {
+            auto rts = dynamic_pointer_cast<aref_ts>(ts.ts);
+            auto n = nodes_of(rts->id);
+            if (n.empty() || n.front() != self)
+                continue;
+            for (size_t k = 1; k < n.size(); ++k)
+                by_node[n[k]].push_back(ts);
+        }
+        if (by_node.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> guard(mx);
+            for (auto& x : by_node)
+                queue.push_back(replication_item{ x.first, std::move(x.second), overwrite_on_write, cache_on_write });
+        }
+        cv.notify_all();
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> guard(mx);
+        return queue.size() + in_progress;
+    }
+    size_t failed() const {
+        std::lock_guard<std::mutex> guard(mx);
+        return failures;
+    }
+    void flush() {
+        std::unique_lock<std::mutex> lock(mx);
+        cv.wait(lock, [this]() { return queue.empty() && in_progress == 0; });
+    }
+
+private:
+    struct replication_item {
+        size_t node;
+        ts_vector_t tsv;
+        bool overwrite_on_write;
+        bool cache_on_write;
+    };
+
+    /** the replication loop, sends the queued stores in order, a failed replication is counted, not retried */
+    void work() {
+        std::unique_lock<std::mutex> lock(mx);
+        for (;;) {
+            cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;// stopping
+            auto item = std::move(queue.front());
+            queue.pop_front();
+            ++in_progress;
+            lock.unlock();
+            bool ok = true;
+            try {
+                peers[item.node]->replicate_ts(item.tsv, item.overwrite_on_write, item.cache_on_write);
+            } catch (...) {
+                ok = false;
+            }
+            lock.lock();
+            --in_progress;
+            if (!ok)
+                ++failures;
+            cv.notify_all();// the flushers
+        }
+    }
+
+    mutable std::mutex mx;///< protects the members below
+    std::condition_variable cv;///< signals the queue, and its progress
+    std::deque<replication_item> queue;///< stores to replicate, in order
+    size_t in_progress{0};
+    size_t failures{0};
+    bool stopping{false};
+    std::atomic<size_t> next_read{0};
+    std::thread worker;
+};
+
+void server::set_cluster(const vector<string>& host_ports, size_t self, size_t replication) {
+    cluster = host_ports.size() ? std::make_shared<cluster_node>(host_ports, self, replication) : nullptr;
+}
+size_t server::get_replication_pending() const { return cluster ? cluster->pending() : 0; }
+size_t server::get_replication_failures() const { return cluster ? cluster->failed() : 0; }
+void server::flush_replication() { if (cluster) cluster->flush(); }
+
+/** the http endpoint of the metrics of a server, ref. server::start_metrics_http */
+struct metrics_http : dlib::server_iostream {
+    const server& s;
+    explicit metrics_http(const server& s) :s(s) {}
+    void on_connect(std::istream& in, std::ostream& out, const string&, const string&, unsigned short, unsigned short, dlib::uint64) override {
+        string request_line;
+        std::getline(in, request_line);
+        for (string h; std::getline(in, h) && h != "\r" && !h.empty();) {}// the headers are not used
+        std::istringstream rl(request_line);
+        string method, path;
+        rl >> method >> path;
+        string status = "200 OK", body;
+        if (method != "GET")
+            status = "405 Method Not Allowed";
+        else if (path != "/metrics" && path != "/")
+            status = "404 Not Found";
+        else
+            body = s.get_metrics();
+        out << "HTTP/1.0 " << status << "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.size()
+            << "\r\nConnection: close\r\n\r\n" << body;
+        out.flush();
+    }
+};
+
+server::~server() {
+    wait_read_ahead();
+    metrics_endpoint.reset();
+    if (cache_snapshot_file.empty())
+        return;
+    try {
+        save_cache_snapshot(cache_snapshot_file);
+    } catch (const std::exception&) {} // a destructor must not throw, the next start just has a cold cache
+}
+
+void server::save_cache_snapshot(const string& file) const {
+    auto items = ts_cache.get_mru_items();
+    vector<pair<string,ts_vector_t>> entries; entries.reserve(items.size());
+    for (auto i = items.rbegin(); i != items.rend(); ++i) {// least recently used first
+        ts_vector_t frags; frags.reserve(i->second.f.size());
+        for (const auto& f : i->second.f)
+            frags.push_back(f.ts());
+        entries.emplace_back(i->first, std::move(frags));
+    }
+    write_cache_snapshot(file, entries);
+}
+
+size_t server::load_cache_snapshot(const string& file) {
+    return read_cache_snapshot(file, [this](const string& id, const ts_vector_t& frags) {
+        for (const auto& f : frags)
+            ts_cache.add(id, f);
+    });
+}
+
+void server::set_cache_hot_set_recording(const string& file, std::chrono::milliseconds interval, size_t max_ids) {
+    std::lock_guard<std::mutex> guard(hot_set_mx);
+    hot_set_recorder.reset();// records once more as it stops
+    if (interval.count() > 0)
+        hot_set_recorder = std::make_unique<periodic_task>(interval, [this, file, max_ids]() { save_cache_hot_set(file, max_ids); });
+}
+
+size_t server::warm_cache(const string& file) {
+    auto hs = read_hot_set(file);
+    std::reverse(hs.begin(), hs.end());// least recently used first, so the hottest are the most recent when done
+    const size_t chunk = 1000;// the lru order is kept between chunks, the ids of a period within one are read together
+    size_t n = 0;
+    for (size_t i0 = 0; i0 < hs.size(); i0 += chunk) {
+        map<pair<utctime,utctime>,id_vector_t> by_period;
+        for (size_t i = i0; i < std::min(hs.size(), i0 + chunk); ++i)
+            by_period[std::make_pair(hs[i].second.start, hs[i].second.end)].push_back(hs[i].first);
+        for (const auto& bp : by_period) {
+            const utcperiod p(bp.first.first, bp.first.second);
+            try {
+                do_read(bp.second, p, true, true);
+                n += bp.second.size();
+            } catch (const std::exception&) { // one of them failed, read them one by one, skipping the failures
+                for (const auto& id : bp.second) {
+                    try {
+                        do_read(id_vector_t{id}, p, true, true);
+                        ++n;
+                    } catch (const std::exception&) {}
+                }
+            }
+        }
+    }
+    return n;
+}
+
+void server::start_warm_cache(const string& file) {
+    std::lock_guard<std::mutex> guard(hot_set_mx);
+    cache_warm_up = std::async(std::launch::async, [this, file]() { return warm_cache(file); });
+}
+
+size_t server::wait_warm_cache() {
+    std::future<size_t> w;
+    {
+        std::lock_guard<std::mutex> guard(hot_set_mx);
+        w = std::move(cache_warm_up);
+    }
+    return w.valid() ? w.get() : 0;
+}
+
+string server::get_metrics() const {
+    std::ostringstream os;
+    metrics.write(os);
+    auto cs = get_cache_stats();
+    server_metrics::counter(os, "dtss_cache_hits_total", "cache lookups of cached ids", cs.hits);
+    server_metrics::counter(os, "dtss_cache_misses_total", "cache lookups of ids not cached", cs.misses);
+    server_metrics::counter(os, "dtss_cache_coverage_misses_total", "cache lookups of cached ids, missing the period", cs.coverage_misses);
+    server_metrics::gauge(os, "dtss_cache_ids", "ids in the cache", double(cs.id_count));
+    server_metrics::gauge(os, "dtss_cache_points", "points in the cache", double(cs.point_count));
+    server_metrics::gauge(os, "dtss_cache_fragments", "fragments in the cache", double(cs.fragment_count));
+    server_metrics::gauge(os, "dtss_cache_bytes", "approx. bytes of the cache", double(cs.byte_count));
+    server_metrics::gauge(os, "dtss_result_cache_bytes", "approx. bytes of the result cache", double(cs.result_byte_count));
+    server_metrics::counter(os, "dtss_result_cache_hits_total", "evaluated expressions found in the result cache", result_cache.hits());
+    server_metrics::counter(os, "dtss_result_cache_misses_total", "cacheable expressions evaluated", result_cache.misses());
+    server_metrics::gauge(os, "dtss_result_cache_results", "results in the result cache", double(result_cache.size()));
+    auto ss = scheduler.stats();
+    server_metrics::gauge(os, "dtss_scheduler_running", "scheduled requests running", double(ss.running));
+    server_metrics::gauge(os, "dtss_scheduler_queued", "scheduled requests waiting", double(ss.queued));
+    server_metrics::counter(os, "dtss_scheduler_rejected_total", "requests rejected by a full queue", ss.rejected);
+    server_metrics::gauge(os, "dtss_replication_pending", "replications queued or in progress", double(get_replication_pending()));
+    server_metrics::counter(os, "dtss_replication_failures_total", "replications that failed", get_replication_failures());
+    server_metrics::gauge(os, "dtss_subscriptions", "current subscriptions", double(subscriptions.size()));
+    return os.str();
+}
+
+int server::start_metrics_http(int port, const string& ip) {
+    stop_metrics_http();
+    auto m = std::make_shared<metrics_http>(*this);
+    m->set_listening_port(port);
+    if (ip.size())
+        m->set_listening_ip(ip);
+    m->start_async();
+    port = m->get_listening_port();
+    metrics_endpoint = std::move(m);
+    return port;
+}
+
+void server::stop_metrics_http() {
+    if (metrics_endpoint)
+        metrics_endpoint->clear();
+    metrics_endpoint.reset();
+}
+
 ts_info_vector_t server::do_find_ts(const string& search_expression) {
     // 1. filter shyft://<container>/
     auto c=extract_shyft_url_container(search_expression);
     if(c.size()) {
-        return internal(c).find(search_expression.substr(shyft_prefix.size()+c.size()+1));
+        return internal(c)->find(search_expression.substr(shyft_prefix.size()+c.size()+1));
     } else if (find_ts_cb) {
+        scoped_latency l(metrics.find_ts_cb);
         return find_ts_cb(search_expression);
     } else {
         return ts_info_vector_t();
@@ -45,43 +370,127 @@ ts_info_vector_t server::do_find_ts(const string& search_expression) {
 }
 
 
-void server::do_cache_update_on_write(const ts_vector_t&tsv) {
-    for (size_t i = 0; i<tsv.size(); ++i) {
-        auto rts = dynamic_pointer_cast<aref_ts>(tsv[i].ts);
-        ts_cache.add(rts->id, apoint_ts(rts->rep));
+/** \return the ts_info of id, as known from the cached fragments mf, with data_period the period cached */
+static ts_info cached_ts_info(const string& id, const server::ts_cache_t::value_type& mf) {
+    ts_info i;
+    i.name = id;
+    if (mf.f.empty())
+        return i;
+    const auto ts = mf.f.front().ts();
+    i.point_fx = ts.point_interpretation();
+    const auto& ta = ts.time_axis();
+    if (ta.gt == time_axis::generic_dt::FIXED) {
+        i.delta_t = ta.f.dt;
+    } else if (ta.gt == time_axis::generic_dt::CALENDAR) {
+        i.delta_t = ta.c.dt;
+        i.olson_tz_id = ta.c.cal->tz_info->name();
+    }
+    i.data_period = utcperiod(mf.f.front().total_period().start, mf.f.back().total_period().end);
+    return i;
+}
+
+ts_info_vector_t server::do_get_ts_info(const id_vector_t& ids) {
+    ts_info_vector_t r(ids.size());
+    map<string, pair<vector<size_t>, id_vector_t>> own;// container -> (ix, names)
+    id_vector_t other;
+    vector<size_t> other_i;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        r[i].name = ids[i];
+        auto c = extract_shyft_url_container(ids[i]);
+        if (c.size()) {
+            auto& o = own[c];
+            o.first.push_back(i);
+            o.second.push_back(ids[i].substr(shyft_prefix.size() + c.size() + 1));
+        } else {
+            other.push_back(ids[i]);
+            other_i.push_back(i);
+        }
+    }
+    for (const auto& c : own) {
+        auto db = container.find(c.first);
+        if (!db)
+            continue;// not found, as a missing series
+        auto infos = db->get_ts_infos(c.second.second);
+        for (size_t j = 0; j < infos.size(); ++j) {
+            auto& x = r[c.second.first[j]];
+            infos[j].name = std::move(x.name);
+            x = std::move(infos[j]);
+        }
     }
+    if (other.size()) {
+        auto cached = ts_cache.peek(other);
+        for (size_t j = 0; j < other.size(); ++j) {
+            auto f = cached.find(other[j]);
+            if (f != cached.end())
+                r[other_i[j]] = cached_ts_info(other[j], f->second);
+        }
+    }
+    return r;
+}
+
+void server::do_cache_update_on_write(const ts_vector_t&tsv, const vector<size_t>* ix) {
+    const size_t n = ix ? ix->size() : tsv.size();
+    id_vector_t ids; ids.reserve(n);
+    ts_vector_t tss; tss.reserve(n);
+    for (size_t k = 0; k < n; ++k) {
+        auto rts = dynamic_pointer_cast<aref_ts>(tsv[ix ? (*ix)[k] : k].ts);
+        ids.push_back(rts->id);
+        tss.push_back(apoint_ts(rts->rep));
+    }
+    ts_cache.add(ids, tss);// sorted by shard, each shard locked once, and the fragments of its ids merged in order
 }
 
 
-void server::do_store_ts(const ts_vector_t & tsv, bool overwrite_on_write, bool cache_on_write) {
+void server::do_store_ts(const ts_vector_t & tsv, bool overwrite_on_write, bool cache_on_write, bool replicated) {
     if(tsv.size()==0) return;
+    // 0. in a cluster, the series of other primary nodes are stored there
+    auto cn = cluster;
+    if (cn && !replicated) {
+        ts_vector_t local;
+        auto remote = cn->split_by_primary(tsv, local);
+        for (const auto& x : remote) {
+            cn->peers[x.first]->store_ts(x.second, overwrite_on_write, cache_on_write);
+            if (cache_on_write) do_cache_update_on_write(x.second);
+            id_vector_t ids; for (const auto& ts : x.second) ids.push_back(ts.id());
+            notify_changed(ids);
+        }
+        if (remote.size()) {
+            do_store_ts(local, overwrite_on_write, cache_on_write, false);
+            return;
+        }
+    }
     // 1. filter out all shyft://<container>/<ts-path> elements
     //    and route these to the internal storage controller (threaded)
     //    map<string, ts_db> shyft_internal;
     //
     vector<size_t> other;
     other.reserve(tsv.size());
+    vector<size_t> own_i; // idx of the shyft:// ts
+    std::map<string, vector<std::pair<string, const gts_t*>>> own; // container -> (path, ts to save), saved as one batch
+    id_vector_t ids;ids.reserve(tsv.size());
     for(size_t i=0;i<tsv.size();++i) {
         auto rts = dynamic_pointer_cast<aref_ts>(tsv[i].ts);
         if(!rts) throw runtime_error("dtss store: require ts with url-references");
+        ids.push_back(rts->id);
         auto c= extract_shyft_url_container(rts->id);
         if(c.size()) {
-            internal(c).save(
-                rts->id.substr(shyft_prefix.size()+c.size()+1),  // path
-                rts->core_ts(),  // ts to save
-                overwrite_on_write  // should do overwrite instead of merge
-            );
-            if ( cache_on_write ) { // ok, this ends up in a copy, and lock for each item(can be optimized if many)
-                ts_cache.add(rts->id, apoint_ts(rts->rep));
-            }
+            own[c].emplace_back(rts->id.substr(shyft_prefix.size()+c.size()+1), &rts->core_ts());
+            own_i.push_back(i);
         } else {
             other.push_back(i); // keep idx of those we have not saved
         }
     }
+    for(const auto& c:own) {
+        scoped_latency l(metrics.ts_db_write);
+        internal(c.first)->save(c.second, overwrite_on_write); // overwrite_on_write: should do overwrite instead of merge
+    }
+    if (cache_on_write && own_i.size())
+        do_cache_update_on_write(tsv, &own_i);
 
     // 2. for all non shyft:// forward those to the
     //    store_ts_cb
     if(store_ts_cb && other.size()) {
+        scoped_latency l(metrics.store_ts_cb);
         if(other.size()==tsv.size()) { //avoid copy/move if possible
             store_ts_cb(tsv);
             if (cache_on_write) do_cache_update_on_write(tsv);
@@ -92,10 +501,25 @@ void server::do_store_ts(const ts_vector_t & tsv, bool overwrite_on_write, bool
             if (cache_on_write) do_cache_update_on_write(r);
         }
     }
+    // 3. the results referencing the stored series are removed, and their subscriptions notified, also for merge_store
+    notify_changed(ids);
+    // 4. the primary replicates the saved series to their other nodes
+    if (cn && !replicated)
+        cn->replicate(tsv, overwrite_on_write, cache_on_write);
 }
 
 void server::do_merge_store_ts(const ts_vector_t& tsv,bool cache_on_write) {
     if(tsv.size()==0) return;
+    if (cluster) { // the series of other primary nodes are merged there, so each series is merged at one node
+        ts_vector_t local;
+        auto remote = cluster->split_by_primary(tsv, local);
+        for (const auto& x : remote)
+            cluster->peers[x.first]->merge_store_ts(x.second, cache_on_write);
+        if (remote.size()) {
+            do_merge_store_ts(local, cache_on_write);
+            return;
+        }
+    }
     //
     // 0. check&prepare the read time-series in tsv for the specified period of each ts
     // (we optimize a little bit grouping on common period, and reading in batches with equal periods)
@@ -123,7 +547,7 @@ void server::do_merge_store_ts(const ts_vector_t& tsv,bool cache_on_write) {
     //
     ts_vector_t tsv_store;tsv_store.reserve(tsv.size());
     for(auto rr=read_map.begin();rr!=read_map.end();++rr) {
-        auto read_ts= do_read(rr->second,rr->first,cache_on_write,cache_on_write);
+        auto read_ts= do_read(rr->second,rr->first,cache_on_write,cache_on_write,false);// not coalesced, the read is modified by the merge
         // read_ts is in the order of the ts-id-list rr->second
         for(size_t i=0;i<read_ts.size();++i) {
             auto ts_id =rr->second[i];
@@ -139,83 +563,177 @@ void server::do_merge_store_ts(const ts_vector_t& tsv,bool cache_on_write) {
     
 }
 
-ts_vector_t server::do_read(const id_vector_t& ts_ids,utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
+ts_vector_t server::do_read(const id_vector_t& ts_ids,utcperiod p,bool use_ts_cached_read,bool update_ts_cache,bool coalesce_reads) {
     if(ts_ids.size()==0) return ts_vector_t{};
     bool cache_read_results=update_ts_cache || cache_all_reads;
     // 0. filter out ts we can get from cache, given we are allowed to use cache
+    //    and those partly in the cache, where we only need to read the gaps
     unordered_map<string,apoint_ts> cc;
+    unordered_map<string,ts_cache_t::partial_hit> pc;
     if(use_ts_cached_read)
-        cc = ts_cache.get(ts_ids,p);
+        cc = ts_cache.get(ts_ids,p,pc);
     ts_vector_t r(ts_ids.size());
-    vector<size_t> other;
     if (cc.size() == ts_ids.size()) { // if we got all from cache, just go ahead and map in the results
         for(size_t i=0;i<ts_ids.size();++i)
             r[i] = cc[ts_ids[i]];
-    } else {
-        // 1. filter out shyft://
-        //    if all shyft: return internal read
-        other.reserve(ts_ids.size()); // only reserve space when needed
-        for (size_t i = 0; i < ts_ids.size(); ++i) {
-            if (cc.find(ts_ids[i]) == cc.end()) {
-                auto c = extract_shyft_url_container(ts_ids[i]);
-                if (c.size()) {
-                    r[i] = apoint_ts(make_shared<gpoint_ts>(internal(c).read(ts_ids[i].substr(shyft_prefix.size() + c.size() + 1), p)));
-                    if (cache_read_results) ts_cache.add(ts_ids[i], r[i]);
-                } else
-                    other.push_back(i);
-            } else {
-                r[i] = cc[ts_ids[i]];
+        return r;
+    }
+    vector<size_t> miss;
+    vector<size_t> part;
+    miss.reserve(ts_ids.size() - cc.size()); // only reserve space when needed
+    map<pair<utctime,utctime>,vector<size_t>> gap_reads;// gap -> ix, so ids missing the same sub-period are read together
+    for (size_t i = 0; i < ts_ids.size(); ++i) {
+        auto f = cc.find(ts_ids[i]);
+        if (f != cc.end()) {
+            r[i] = f->second;
+            continue;
+        }
+        auto h = pc.find(ts_ids[i]);
+        if (h == pc.end()) {
+            miss.push_back(i);
+            continue;
+        }
+        part.push_back(i);
+        for (const auto& g : h->second.gaps)
+            gap_reads[std::make_pair(g.start, g.end)].push_back(i);
+    }
+    if (part.size()) {
+        // 1. read the gaps only, and stitch them with the cached fragments,
+        //    those that are still not covered, e.g. a gap without data, are read for the full period
+        ts_vector_t g(ts_ids.size());
+        for (const auto& gr : gap_reads) {
+            do_read_missing(ts_ids, gr.second, utcperiod(gr.first.first, gr.first.second), cache_read_results, coalesce_reads, g);
+            for (auto i : gr.second) {
+                if (g[i].ts && g[i].size())
+                    pc[ts_ids[i]].frags.add(apoint_ts_frag{g[i]});
+                g[i] = apoint_ts{};
             }
         }
+        for (auto i : part) {
+            const auto& frags = pc[ts_ids[i]].frags;
+            auto ix = frags.get_ix(p);
+            if (ix != string::npos)
+                r[i] = frags.get_by_ix(ix).ts();
+            else
+                miss.push_back(i);
+        }
+    }
+    do_read_missing(ts_ids, miss, p, cache_read_results, coalesce_reads, r);
+    return r;
+}
+
+void server::do_read_missing(const id_vector_t& ts_ids,const vector<size_t>& miss,utcperiod p,bool cache_read_results,bool coalesce_reads,ts_vector_t& r) {
+    if (miss.empty())
+        return;
+    if (!coalesce_reads) {
+        do_read_sources(ts_ids, miss, p, cache_read_results, r);
+        return;
+    }
+    // join the reads in progress, we read those we lead, then wait for the others
+    vector<ts_read_key> keys; keys.reserve(miss.size());
+    for (auto i : miss)
+        keys.push_back(ts_read_key{ts_ids[i], p});
+    vector<bool> lead;
+    auto flights = ts_reads.join(keys, lead);
+    vector<size_t> led; led.reserve(miss.size());
+    for (size_t k = 0; k < miss.size(); ++k)
+        if (lead[k]) led.push_back(miss[k]);
+    try {
+        do_read_sources(ts_ids, led, p, cache_read_results, r);
+    } catch (...) {
+        auto e = std::current_exception();
+        for (size_t k = 0; k < miss.size(); ++k)
+            if (lead[k]) ts_reads.fail(keys[k], flights[k], e);
+        throw;
+    }
+    for (size_t k = 0; k < miss.size(); ++k)
+        if (lead[k]) ts_reads.complete(keys[k], flights[k], r[miss[k]]);
+    for (size_t k = 0; k < miss.size(); ++k)
+        if (!lead[k]) r[miss[k]] = flights[k]->f.get();// rethrows if the leader failed
+}
+
+void server::do_read_sources(const id_vector_t& ts_ids,const vector<size_t>& ix,utcperiod p,bool cache_read_results,ts_vector_t& r) {
+    // 1. filter out shyft://
+    //    and read those from the internal containers, in parallel on the io pool
+    vector<size_t> other;
+    vector<size_t> own;
+    vector<string> own_c;
+    vector<size_t> remote;// in a cluster, the shyft:// series not on this node
+    auto cn = cluster;
+    for (auto i : ix) {
+        auto c = extract_shyft_url_container(ts_ids[i]);
+        if (c.size() && cn && !cn->is_local(ts_ids[i])) {
+            remote.push_back(i);
+        } else if (c.size()) {
+            own.push_back(i);
+            own_c.push_back(c);
+        } else
+            other.push_back(i);
+    }
+    auto read_own = [&](size_t k0, size_t k1) {
+        for (size_t k = k0; k < k1; ++k) {
+            const auto i = own[k];
+            const auto& c = own_c[k];
+            scoped_latency l(metrics.ts_db_read);
+            r[i] = apoint_ts(make_shared<gpoint_ts>(internal(c)->read(ts_ids[i].substr(shyft_prefix.size() + c.size() + 1), p)));
+        }
+    };
+    // the read series are added to the cache in one batch, each shard locked once
+    auto cache_results = [&](const vector<size_t>& ixs) {
+        id_vector_t c_ids; c_ids.reserve(ixs.size());
+        ts_vector_t c_ts; c_ts.reserve(ixs.size());
+        for (auto i : ixs) { c_ids.push_back(ts_ids[i]); c_ts.push_back(r[i]); }
+        ts_cache.add(c_ids, c_ts);
+    };
+    if (own.size() > 1 && max_io_threads > 1)
+        get_io_pool()->parallel_for(own.size(), 1, read_own);// results are placed by index, so they stay in request order
+    else
+        read_own(0, own.size());
+    if (cache_read_results && own.size())
+        cache_results(own);
+    if (remote.size()) {
+        cn->read(ts_ids, remote, p, r);
+        if (cache_read_results)
+            cache_results(remote);
     }
     // 2. if other/more than shyft
     //    get all those
     if(other.size()) {
         if(!bind_ts_cb)
             throw runtime_error("dtss: read-request to external ts, without external handler");
-        if(other.size()==ts_ids.size()) {// only other series, just return result
-            auto rts= bind_ts_cb(ts_ids,p);
-            if(cache_read_results) ts_cache.add(ts_ids,rts);
-            return rts;
-        }
         vector<string> o_ts_ids;o_ts_ids.reserve(other.size());
         for(auto i:other) o_ts_ids.push_back(ts_ids[i]);
-        auto o=bind_ts_cb(o_ts_ids,p);
+        auto batcher=get_read_batcher();
+        ts_vector_t o;
+        {
+            scoped_latency l(metrics.bind_ts_cb);
+            o=batcher?batcher->read(o_ts_ids,p).get():bind_ts_cb(o_ts_ids,p);
+        }
+        if(o.size()!=o_ts_ids.size())
+            throw runtime_error("dtss: external read returned "+std::to_string(o.size())+" time-series for "+std::to_string(o_ts_ids.size())+" ids");
         if(cache_read_results) ts_cache.add(o_ts_ids,o);
         // if both shyft&cached plus other, merge into one ordered result vector
         //
         for(size_t i=0;i<o.size();++i)
             r[other[i]]=o[i];
     }
-    return r;
 }
 
 void
 server::do_bind_ts(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache)  {
-    unordered_map<string, vector<ts_bind_info>> ts_bind_map;
-    vector<string> ts_id_list;
-    // step 1: bind not yet bound time-series ( ts with only symbol, needs to be resolved using bind_cb)
-    for (auto& ats : atsv) {
-        auto ts_refs = ats.find_ts_bind_info();
-        for (const auto& bi : ts_refs) {
-            if (ts_bind_map.find(bi.reference) == ts_bind_map.end()) { // maintain unique set
-                ts_id_list.push_back(bi.reference);
-                ts_bind_map[bi.reference] = vector<ts_bind_info>();
-            }
-            ts_bind_map[bi.reference].push_back(bi);
-        }
-    }
+    scoped_latency l(metrics.bind);
+    // step 1: collect the not yet bound time-series ( ts with only symbol, needs to be resolved using bind_cb)
+    //         in one pass over all the expressions, each id once
+    ts_bind_set bs(atsv);
 
     // step 2: (optional) bind_ts callback should resolve symbol time-series with content
-    if (ts_bind_map.size()) {
-        auto bts = do_read(ts_id_list, bind_period,use_ts_cached_read,update_ts_cache);
-        if (bts.size() != ts_id_list.size())
+    if (bs.size()) {
+        auto bts = do_read(bs.ids, bind_period,use_ts_cached_read,update_ts_cache);
+        if (bts.size() != bs.size())
             throw runtime_error(string("failed to bind all of ") + std::to_string(bts.size()) + string(" ts"));
 
-        for ( size_t i = 0; i < ts_id_list.size(); ++i ) {
-            for ( auto & bi : ts_bind_map[ts_id_list[i]] )
-                bi.ts.bind(bts[i]);
-        }
+        for ( size_t i = 0; i < bs.size(); ++i )
+            bs.bind(i, bts[i]);
     }
     // step 3: after the symbolic ts are read and bound, we iterate over the
     //         expression tree and calls .do_bind() so that
@@ -223,123 +741,635 @@ server::do_bind_ts(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_r
     //         ready for evaluate with everything const so threading is safe.
     for (auto& ats : atsv)
         ats.do_bind();
+    // step 4: merge and remove the redundant nodes of the bound expressions, ref. expression_simplifier
+    if (simplify_expressions)
+        expression_simplifier::simplify(atsv);
 }
 
 
 
+void server::read_ahead_of(std::uint64_t connection_id,const ts_vector_t& atsv,utcperiod bind_period,bool use_ts_cached_read) {
+    if (!use_ts_cached_read || read_ahead.min_run() == 0)
+        return;
+    id_vector_t ids;
+    for (const auto& ats : atsv) {
+        if (!ats.ts)
+            continue;
+        for (const auto& b : ats.find_ts_bind_info())
+            ids.push_back(b.reference);
+    }
+    if (ids.empty())
+        return;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    const auto next = read_ahead.observe(connection_id, ids, bind_period);
+    if (!next.valid())
+        return;
+    std::lock_guard<std::mutex> guard(read_ahead_mx);
+    read_aheads.erase(std::remove_if(read_aheads.begin(), read_aheads.end(), [](std::future<void>& f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), read_aheads.end());
+    if (read_aheads.size() >= max_read_aheads) {
+        ++n_read_ahead_dropped;
+        return;
+    }
+    ++n_read_ahead;
+    read_aheads.push_back(std::async(std::launch::async, [this, ids{std::move(ids)}, next]() {
+        try {
+            do_read(ids, next, true, true);// joins, or is joined by, a read of the client of the same window
+        } catch (...) {}// the client reads the window, and gets the error, if it is still there
+    }));
+}
+
+void server::wait_read_ahead() {
+    std::vector<std::future<void>> w;
+    {
+        std::lock_guard<std::mutex> guard(read_ahead_mx);
+        w.swap(read_aheads);
+    }
+    for (auto& f : w)
+        f.wait();
+}
+
+/** \return the result cache key of the unbound expression ts for p, the period and the serialized expression */
+static string result_key(utcperiod p, const apoint_ts& ts) {
+    std::ostringstream os;
+    os.write((const char*)&p.start, sizeof(p.start));
+    os.write((const char*)&p.end, sizeof(p.end));
+    core_oarchive oa(os, core_arch_flags);
+    oa << ts;
+    return os.str();
+}
+
 ts_vector_t
 server::do_evaluate_ts_vector(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache) {
+    // the cached results are as of the ts-cache, a request reading the sources, or updating the cache, is evaluated
+    if (!use_ts_cached_read || update_ts_cache || result_cache.get_capacity() == 0 || cluster)
+        return do_evaluate_ts_vector_uncached(bind_period, atsv, use_ts_cached_read, update_ts_cache);
+    const auto gen = result_cache.generation();// before reading, so a store meanwhile drops the results, ref. expression_result_cache::add
+    ts_vector_t r(atsv.size());
+    vector<size_t> miss;
+    vector<string> keys;
+    vector<id_vector_t> deps;
+    for (size_t i = 0; i < atsv.size(); ++i) {
+        id_vector_t ids;
+        bool cacheable = atsv[i].ts != nullptr;
+        if (cacheable) {
+            for (const auto& b : atsv[i].find_ts_bind_info()) {
+                if (b.reference.rfind(shyft_prefix, 0) != 0) {// an external series might change unseen
+                    cacheable = false;
+                    break;
+                }
+                ids.push_back(b.reference);
+            }
+        }
+        if (!cacheable || ids.empty()) {
+            miss.push_back(i);
+            keys.emplace_back();
+            deps.emplace_back();
+            continue;
+        }
+        auto key = result_key(bind_period, atsv[i]);
+        if (result_cache.try_get(key, r[i]))
+            continue;
+        miss.push_back(i);
+        keys.push_back(std::move(key));
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        deps.push_back(std::move(ids));
+    }
+    if (miss.empty())
+        return r;
+    ts_vector_t c; c.reserve(miss.size());
+    for (auto i : miss)
+        c.push_back(std::move(atsv[i]));
+    auto cr = do_evaluate_ts_vector_uncached(bind_period, c, use_ts_cached_read, update_ts_cache);
+    for (size_t j = 0; j < miss.size(); ++j) {
+        if (keys[j].size())
+            result_cache.add(keys[j], cr[j], std::move(deps[j]), gen);
+        r[miss[j]] = std::move(cr[j]);
+    }
+    return r;
+}
+
+vector<std::uint64_t>
+server::do_get_versions(const ts_vector_t& atsv) {
+    vector<std::uint64_t> r(atsv.size(), 0);
+    if (cluster)
+        return r;
+    vector<id_vector_t> ids(atsv.size());
+    id_vector_t all;
+    for (size_t i = 0; i < atsv.size(); ++i) {
+        if (!atsv[i].ts)
+            continue;
+        bool versioned = true;
+        for (const auto& b : atsv[i].find_ts_bind_info()) {
+            if (b.reference.rfind(shyft_prefix, 0) != 0) {// an external series might change unseen
+                versioned = false;
+                break;
+            }
+            ids[i].push_back(b.reference);
+        }
+        if (!versioned) {
+            ids[i].clear();
+            continue;
+        }
+        std::sort(ids[i].begin(), ids[i].end());
+        ids[i].erase(std::unique(ids[i].begin(), ids[i].end()), ids[i].end());
+        all.insert(all.end(), ids[i].begin(), ids[i].end());
+    }
+    if (all.empty())
+        return r;
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    const auto infos = do_get_ts_info(all);
+    for (size_t i = 0; i < atsv.size(); ++i) {
+        if (ids[i].empty())
+            continue;
+        vector<std::int64_t> modified; modified.reserve(ids[i].size());
+        for (const auto& id : ids[i]) {
+            const auto j = size_t(std::lower_bound(all.begin(), all.end(), id) - all.begin());
+            modified.push_back(std::int64_t(infos[j].modified));
+        }
+        r[i] = versions.version(ids[i], modified);
+    }
+    return r;
+}
+
+vector<size_t>
+server::do_evaluate_validated(utcperiod bind_period, ts_vector_t& atsv, vector<std::uint64_t>& version, bool use_ts_cached_read, bool update_ts_cache, ts_vector_t& result) {
+    if (version.size() != atsv.size())
+        throw runtime_error("dtss: validated evaluate got " + std::to_string(version.size()) + " versions for " + std::to_string(atsv.size()) + " expressions");
+    auto current = do_get_versions(atsv);// before reading, so a store meanwhile gives a new version next time
+    vector<size_t> ix;
+    ts_vector_t c;
+    for (size_t i = 0; i < atsv.size(); ++i) {
+        if (current[i] != 0 && current[i] == version[i])
+            continue;
+        ix.push_back(i);
+        c.push_back(std::move(atsv[i]));
+    }
+    version = std::move(current);
+    result = c.size() ? do_evaluate_ts_vector(bind_period, c, use_ts_cached_read, update_ts_cache) : ts_vector_t{};
+    return ix;
+}
+
+ts_vector_t
+server::do_evaluate_ts_vector_uncached(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache) {
     do_bind_ts(bind_period, atsv,use_ts_cached_read,update_ts_cache);
-    return ts_vector_t{deflate_ts_vector<apoint_ts>(atsv)};
+    scoped_latency l(metrics.evaluate);
+    auto ctsv=expression_cse::eliminate(atsv);// shared sub-expressions evaluated once
+    if(!autotune_eval_threads)
+        return ts_vector_t{deflate_ts_vector<apoint_ts>(ctsv,get_max_eval_threads())};// in parallel, limited so that other connections are served
+    static const string kind{"dtss_evaluate"};
+    core::autotune_setting s;
+    {
+        std::lock_guard<std::mutex> guard(eval_tuner_mx);
+        s=eval_tuner.next(kind,ctsv.size(),std::max<size_t>(1,core::executor::size()),false);
+    }
+    const auto t0=std::chrono::steady_clock::now();
+    ts_vector_t r{deflate_ts_vector<apoint_ts>(ctsv,s.n_threads?s.n_threads:get_max_eval_threads())};
+    const double dt=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    std::lock_guard<std::mutex> guard(eval_tuner_mx);
+    eval_tuner.measured(kind,ctsv.size(),s,dt/double(std::max<size_t>(1,ctsv.size())));
+    return r;
+}
+
+void
+server::do_evaluate_stream(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache,size_t chunk_size,const std::function<void(const ts_vector_t&)>& fx) {
+    chunk_size=std::max(size_t(1),chunk_size);
+    for(size_t i0=0;i0<atsv.size();i0+=chunk_size) {
+        const size_t i1=std::min(atsv.size(),i0+chunk_size);
+        ts_vector_t c;c.reserve(i1-i0);
+        for(size_t i=i0;i<i1;++i) {
+            c.push_back(std::move(atsv[i]));// so the bound series are released with the chunk
+            atsv[i]=apoint_ts{};
+        }
+        fx(do_evaluate_ts_vector(bind_period,c,use_ts_cached_read,update_ts_cache));
+    }
 }
 
 ts_vector_t
 server::do_evaluate_percentiles(utcperiod bind_period, ts_vector_t& atsv, gta_t const&ta, vector<int64_t> const& percentile_spec,bool use_ts_cached_read,bool update_ts_cache) {
     do_bind_ts(bind_period, atsv,use_ts_cached_read,update_ts_cache);
     vector<int> p_spec;for(const auto p:percentile_spec) p_spec.push_back(int(p));// convert
-    return percentiles(atsv, ta, p_spec);// we can assume the result is trivial to serialize
+    return percentiles(expression_cse::eliminate(atsv), ta, p_spec);// shared sub-expressions evaluated once, we can assume the result is trivial to serialize
+}
+
+ts_vector_t
+server::do_evaluate_aggregates(utcperiod bind_period, ts_vector_t& atsv, gta_t const&ta, vector<int64_t> const& aggregate_spec, vector<double> const& weights, vector<double> const& bins,bool use_ts_cached_read,bool update_ts_cache) {
+    do_bind_ts(bind_period, atsv,use_ts_cached_read,update_ts_cache);
+    vector<int> a_spec;for(const auto a:aggregate_spec) a_spec.push_back(int(a));// convert
+    return ts_vector_t{aggregates(expression_cse::eliminate(atsv), ta, a_spec, weights, bins)};// only the reduced series are sent
+}
+
+/** read the EVALUATE_TS_VECTOR or EVALUATE_EXPRESSION request msg_type from in */
+static void read_evaluate_request(message_type msg_type, std::istream& in, utcperiod& bind_period, ts_vector_t& rtsv, bool& use_ts_cached_read, bool& update_ts_cache) {
+    core_iarchive ia(in,core_arch_flags);
+    ia>>bind_period;
+    if(msg_type==message_type::EVALUATE_EXPRESSION) {
+        compressed_ts_expression c_expr;
+        ia>>c_expr;
+        rtsv=expression_decompressor::decompress(c_expr);
+    } else {
+        ia>>rtsv;
+    }
+    ia>>use_ts_cached_read>>update_ts_cache;
+}
+
+ts_vector_t server::do_evaluate_subscription(const subscription_request& req, const vector<size_t>& ix) {
+    ts_vector_t tsv;
+    {
+        std::istringstream is(req.tsv);
+        core_iarchive ia(is,core_arch_flags);
+        ia>>tsv;
+    }
+    ts_vector_t c;c.reserve(ix.size());
+    for(auto i:ix) {
+        if(i>=tsv.size())
+            throw runtime_error("dtss: subscription expression index out of range");
+        c.push_back(tsv[i]);
+    }
+    return do_evaluate_ts_vector(req.p,c,false,req.update_ts_cache);
+}
+
+/** \return the estimated cost of evaluating tsv for p, the series to read times the hours of p, at least 1 */
+static double evaluate_cost(const ts_vector_t& tsv, utcperiod p) {
+    double n = 0.0;
+    for (const auto& ts : tsv)
+        n += ts.ts ? std::max<double>(1.0, double(ts.find_ts_bind_info().size())) : 1.0;
+    const double hours = p.valid() ? double(p.timespan())/double(core::deltahours(1)) : 1.0;
+    return std::max(1.0, n*std::max(1.0, hours));
+}
+
+/** \return the estimated cost of storing tsv, the points */
+static double store_cost(const ts_vector_t& tsv) {
+    double n = 0.0;
+    for (const auto& ts : tsv)
+        n += ts.ts ? double(ts.size()) : 0.0;
+    return std::max(1.0, n);
+}
+
+void server::handle_message(message_type msg_type, std::istream& in, std::ostream& out, std::uint32_t wire_options, std::uint64_t connection_id) {
+    scoped_latency timed(msg_type != message_type::WIRE_OPTIONS ? &metrics.requests[size_t(msg_type)] : nullptr);// wire options are timed as the message they wrap
+    try { // scoping the binary-archive could be ok, since it forces destruction time (considerable) to taken immediately, reduce memory foot-print early
+          //  at the cost of early& fast response. I leave the commented scopes in there for now, and aim for fastest response-time
+        switch (msg_type) { // currently switch, later maybe table[msg_type]=msg_handler
+        case message_type::WIRE_VERSION: {
+            msg::write_type(message_type::WIRE_VERSION,out);
+            const uint32_t version=msg::flat_wire_version;
+            out.write((const char*)&version,sizeof(version));
+        } break;
+        case message_type::WIRE_OPTIONS: {
+            uint32_t options{0};
+            in.read((char*)&options,sizeof(options));
+            auto t=msg::read_type(in);
+            if(t==message_type::WIRE_OPTIONS || t==message_type::TAGGED_REQUEST)
+                throw runtime_error("Server got nested wire options");
+            handle_message(t,in,out,options,connection_id);
+        } break;
+        case message_type::EVALUATE_FLAT:
+        case message_type::EVALUATE_TS_VECTOR:
+        case message_type::EVALUATE_EXPRESSION:{
+            const bool flat= msg_type==message_type::EVALUATE_FLAT;
+            if(flat) {
+                msg_type=msg::read_type(in);// the request, replied flat
+                if(msg_type!=message_type::EVALUATE_TS_VECTOR && msg_type!=message_type::EVALUATE_EXPRESSION)
+                    throw runtime_error(string("Server got unknown flat request type:") + std::to_string((int)msg_type));
+            }
+            utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
+            ts_vector_t rtsv;
+            read_evaluate_request(msg_type,in,bind_period,rtsv,use_ts_cached_read,update_ts_cache);
+            read_ahead_of(connection_id,rtsv,bind_period,use_ts_cached_read);
+            ts_vector_t result; {
+                auto slot=scheduler.admit(connection_id,evaluate_cost(rtsv,bind_period));// released before the reply, so a slow client does not hold it
+                result=do_evaluate_ts_vector(bind_period, rtsv,use_ts_cached_read,update_ts_cache);//first get result
+            }
+            scoped_latency l(metrics.serialize);
+            if(flat) {
+                msg::write_flat_ts_vector(result,out,(wire_options&msg::wire_compress_values)!=0);// then send
+            } else {
+                msg::write_type(message_type::EVALUATE_TS_VECTOR,out);// then send
+                core_oarchive oa(out,core_arch_flags);
+                oa<<result;
+            }
+
+        } break;
+        case message_type::EVALUATE_STREAM: {
+            uint64_t chunk_size{0};
+            in.read((char*)&chunk_size,sizeof(chunk_size));
+            msg_type=msg::read_type(in);// the request, replied in chunks
+            if(msg_type!=message_type::EVALUATE_TS_VECTOR && msg_type!=message_type::EVALUATE_EXPRESSION)
+                throw runtime_error(string("Server got unknown stream request type:") + std::to_string((int)msg_type));
+            utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
+            ts_vector_t rtsv;
+            read_evaluate_request(msg_type,in,bind_period,rtsv,use_ts_cached_read,update_ts_cache);
+            read_ahead_of(connection_id,rtsv,bind_period,use_ts_cached_read);
+            const uint64_t n=rtsv.size();
+            const bool compress_values=(wire_options&msg::wire_compress_values)!=0;
+            auto slot=scheduler.admit(connection_id,evaluate_cost(rtsv,bind_period));
+            do_evaluate_stream(bind_period,rtsv,use_ts_cached_read,update_ts_cache,size_t(chunk_size),[this,&out,compress_values](const ts_vector_t& chunk) {
+                scoped_latency l(metrics.serialize);
+                msg::write_flat_ts_vector(chunk,out,compress_values);
+                out.flush();// blocks while the client is behind
+            });
+            msg::write_type(message_type::STREAM_END,out);
+            out.write((const char*)&n,sizeof(n));
+        } break;
+        case message_type::EVALUATE_EXPRESSION_PERCENTILES:
+        case message_type::EVALUATE_TS_VECTOR_PERCENTILES: {
+            utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
+            ts_vector_t rtsv;
+            vector<int64_t> percentile_spec;
+            gta_t ta;
+            core_iarchive ia(in,core_arch_flags);
+            ia >> bind_period;
+            if(msg_type==message_type::EVALUATE_EXPRESSION_PERCENTILES) {
+                compressed_ts_expression c_expr;
+                ia>>c_expr;
+                rtsv=expression_decompressor::decompress(c_expr);
+            } else {
+                ia>>rtsv;
+            }
+
+            ia>>ta>>percentile_spec>>use_ts_cached_read>>update_ts_cache;
+            read_ahead_of(connection_id,rtsv,bind_period,use_ts_cached_read);
+            ts_vector_t result; {
+                auto slot=scheduler.admit(connection_id,evaluate_cost(rtsv,bind_period));
+                result = do_evaluate_percentiles(bind_period, rtsv,ta,percentile_spec,use_ts_cached_read,update_ts_cache);
+            }
+            scoped_latency l(metrics.serialize);
+            msg::write_type(message_type::EVALUATE_TS_VECTOR_PERCENTILES, out);
+            core_oarchive oa(out,core_arch_flags);
+            oa << result;
+        } break;
+        case message_type::EVALUATE_EXPRESSION_AGGREGATE:
+        case message_type::EVALUATE_TS_VECTOR_AGGREGATE: {
+            utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
+            ts_vector_t rtsv;
+            gta_t ta;
+            vector<int64_t> aggregate_spec;
+            vector<double> weights,bins;
+            core_iarchive ia(in,core_arch_flags);
+            ia >> bind_period;
+            if(msg_type==message_type::EVALUATE_EXPRESSION_AGGREGATE) {
+                compressed_ts_expression c_expr;
+                ia>>c_expr;
+                rtsv=expression_decompressor::decompress(c_expr);
+            } else {
+                ia>>rtsv;
+            }
+            ia>>ta>>aggregate_spec>>weights>>bins>>use_ts_cached_read>>update_ts_cache;
+            read_ahead_of(connection_id,rtsv,bind_period,use_ts_cached_read);
+            ts_vector_t result; {
+                auto slot=scheduler.admit(connection_id,evaluate_cost(rtsv,bind_period));
+                result = do_evaluate_aggregates(bind_period, rtsv,ta,aggregate_spec,weights,bins,use_ts_cached_read,update_ts_cache);
+            }
+            scoped_latency l(metrics.serialize);
+            msg::write_flat_ts_vector(result,out,(wire_options&msg::wire_compress_values)!=0);
+        } break;
+        case message_type::SUBSCRIBE: {
+            msg_type=msg::read_type(in);// the request of the subscription
+            if(msg_type!=message_type::EVALUATE_TS_VECTOR && msg_type!=message_type::EVALUATE_EXPRESSION)
+                throw runtime_error(string("Server got unknown subscribe request type:") + std::to_string((int)msg_type));
+            subscription_request req;
+            ts_vector_t rtsv;
+            read_evaluate_request(msg_type,in,req.p,rtsv,req.use_ts_cached_read,req.update_ts_cache);
+            vector<vector<string>> ids(rtsv.size());
+            for(size_t i=0;i<rtsv.size();++i) {
+                if(!rtsv[i].ts) continue;
+                for(const auto& bi:rtsv[i].find_ts_bind_info())
+                    ids[i].push_back(bi.reference);
+            }
+            {
+                std::ostringstream os;
+                core_oarchive oa(os,core_arch_flags);
+                oa<<rtsv;// before bind, so it can be bound again
+                req.tsv=os.str();
+            }
+            const auto cached=req.use_ts_cached_read,update=req.update_ts_cache;
+            const auto bind_period=req.p;
+            const std::uint64_t sid=subscriptions.add(connection_id,ids,std::move(req));// before the evaluate, so the stores meanwhile are seen
+            ts_vector_t result;
+            try {
+                result=do_evaluate_ts_vector(bind_period,rtsv,cached,update);
+            } catch (...) {
+                subscriptions.remove(sid);
+                throw;
+            }
+            msg::write_type(message_type::SUBSCRIBE,out);
+            out.write((const char*)&sid,sizeof(sid));
+            msg::write_flat_ts_vector(result,out,(wire_options&msg::wire_compress_values)!=0);
+        } break;
+        case message_type::EVALUATE_VALIDATED: {
+            std::uint64_t n{0};
+            in.read((char*)&n,sizeof(n));
+            vector<std::uint64_t> version(n);
+            in.read((char*)version.data(),sizeof(std::uint64_t)*n);
+            msg_type=msg::read_type(in);// the request, replied with the modified results only
+            if(msg_type!=message_type::EVALUATE_TS_VECTOR && msg_type!=message_type::EVALUATE_EXPRESSION)
+                throw runtime_error(string("Server got unknown validated request type:") + std::to_string((int)msg_type));
+            utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
+            ts_vector_t rtsv;
+            read_evaluate_request(msg_type,in,bind_period,rtsv,use_ts_cached_read,update_ts_cache);
+            read_ahead_of(connection_id,rtsv,bind_period,use_ts_cached_read);
+            ts_vector_t result;
+            vector<size_t> ix; {
+                auto slot=scheduler.admit(connection_id,evaluate_cost(rtsv,bind_period));
+                ix=do_evaluate_validated(bind_period,rtsv,version,use_ts_cached_read,update_ts_cache,result);
+            }
+            scoped_latency l(metrics.serialize);
+            msg::write_type(message_type::EVALUATE_VALIDATED,out);
+            out.write((const char*)&n,sizeof(n));
+            out.write((const char*)version.data(),sizeof(std::uint64_t)*n);
+            const std::uint64_t m=ix.size();
+            out.write((const char*)&m,sizeof(m));
+            for(auto i:ix) {
+                const std::uint64_t i64=i;
+                out.write((const char*)&i64,sizeof(i64));
+            }
+            msg::write_flat_ts_vector(result,out,(wire_options&msg::wire_compress_values)!=0);
+        } break;
+        case message_type::READ_SUBSCRIPTION: {
+            std::uint64_t sid{0},max_wait_ms{0};
+            in.read((char*)&sid,sizeof(sid));
+            in.read((char*)&max_wait_ms,sizeof(max_wait_ms));
+            subscription_request req;
+            auto ix=subscriptions.wait(sid,std::chrono::milliseconds(max_wait_ms),req);
+            ts_vector_t result;
+            if(ix.size())
+                result=do_evaluate_subscription(req,ix);
+            msg::write_type(message_type::SUBSCRIPTION_CHANGES,out);
+            const std::uint64_t n=ix.size();
+            out.write((const char*)&n,sizeof(n));
+            for(auto i:ix) {
+                const std::uint64_t i64=i;
+                out.write((const char*)&i64,sizeof(i64));
+            }
+            msg::write_flat_ts_vector(result,out,(wire_options&msg::wire_compress_values)!=0);
+        } break;
+        case message_type::UNSUBSCRIBE: {
+            std::uint64_t sid{0};
+            in.read((char*)&sid,sizeof(sid));
+            subscriptions.remove(sid);
+            msg::write_type(message_type::UNSUBSCRIBE,out);
+        } break;
+        case message_type::FIND_TS: {
+            string search_expression; //{
+            search_expression = msg::read_string(in);// >> search_expression;
+            auto find_result = do_find_ts(search_expression);
+            msg::write_type(message_type::FIND_TS, out);
+            core_oarchive oa(out,core_arch_flags);
+            oa << find_result;
+        } break;
+        case message_type::GET_TS_INFO: {
+            id_vector_t ids;
+            {
+                core_iarchive ia(in,core_arch_flags);
+                ia >> ids;
+            }
+            auto infos = do_get_ts_info(ids);
+            msg::write_type(message_type::GET_TS_INFO, out);
+            core_oarchive oa(out,core_arch_flags);
+            oa << infos;
+        } break;
+        case message_type::STORE_TS: {
+            ts_vector_t rtsv;
+            bool overwrite_on_write{ true };
+            bool cache_on_write{ false };
+            core_iarchive ia(in,core_arch_flags);
+            ia >> rtsv >> overwrite_on_write >> cache_on_write;
+            auto slot=scheduler.admit(connection_id,store_cost(rtsv));
+            do_store_ts(rtsv, overwrite_on_write, cache_on_write);
+            msg::write_type(message_type::STORE_TS, out);
+        } break;
+        case message_type::REPLICATE_TS: {
+            ts_vector_t rtsv;
+            bool overwrite_on_write{ true };
+            bool cache_on_write{ false };
+            core_iarchive ia(in,core_arch_flags);
+            ia >> rtsv >> overwrite_on_write >> cache_on_write;
+            do_store_ts(rtsv, overwrite_on_write, cache_on_write, true);
+            msg::write_type(message_type::REPLICATE_TS, out);
+        } break;
+        case message_type::MERGE_STORE_TS: {
+            ts_vector_t rtsv;
+            bool cache_on_write{ false };
+            core_iarchive ia(in,core_arch_flags);
+            ia >> rtsv >> cache_on_write;
+            auto slot=scheduler.admit(connection_id,store_cost(rtsv));
+            do_merge_store_ts(rtsv, cache_on_write);
+            msg::write_type(message_type::MERGE_STORE_TS, out);
+        } break;
+        case message_type::CACHE_FLUSH: {
+            flush_cache();
+            clear_cache_stats();
+            msg::write_type(message_type::CACHE_FLUSH,out);
+        } break;
+        case message_type::CACHE_STATS: {
+            auto cs = get_cache_stats();
+            msg::write_type(message_type::CACHE_STATS,out);
+            core_oarchive oa(out,core_arch_flags);
+            oa<<cs;
+        } break;
+        case message_type::SCHEDULER_STATS: {
+            auto ss = get_scheduler_stats();
+            msg::write_type(message_type::SCHEDULER_STATS,out);
+            core_oarchive oa(out,core_arch_flags);
+            oa<<ss;
+        } break;
+        case message_type::METRICS: {
+            auto text = get_metrics();
+            msg::write_type(message_type::METRICS,out);
+            msg::write_string(text,out);
+        } break;
+        default:
+            throw runtime_error(string("Server got unknown message type:") + std::to_string((int)msg_type));
+        }
+    } catch (std::exception const& e) {
+        if (msg_type != message_type::WIRE_OPTIONS)
+            metrics.requests_failed.fetch_add(1, std::memory_order_relaxed);
+        msg::send_exception(e,out);
+    }
 }
 
 void server::on_connect(
-    std::istream& in,
-    std::ostream& out,
+    std::istream& socket_in,
+    std::ostream& socket_out,
     const string& foreign_ip,
     const string& local_ip,
     unsigned short foreign_port,
     unsigned short local_port,
     dlib::uint64 connection_id
     ) {
+    // the bytes are counted by the buffers of in and out, added to the metrics for each message
+    counting_streambuf in_buf(socket_in.rdbuf()), out_buf(socket_out.rdbuf());
+    std::istream in(&in_buf);
+    std::ostream out(&out_buf);
+    // tagged requests are handled concurrently, each reply written when done, so the replies are written
+    // under out_mx, and flushed explicitly, in is not tied to out, that would flush without the lock
+    std::mutex out_mx;
+    std::deque<std::future<void>> in_flight;
+    struct subscriptions_of_connection { // removed when the connection ends, also by an exception
+        subscription_manager& s;
+        std::uint64_t connection_id;
+        ~subscriptions_of_connection() { s.remove_owner(connection_id); }
+    } subscribed{subscriptions,connection_id};
+    struct scheduled_connection { // the requests of the connection are scheduled as the foreign_ip client
+        request_scheduler& s;
+        std::uint64_t connection_id;
+        scheduled_connection(request_scheduler& s, std::uint64_t connection_id, const string& client):s(s),connection_id(connection_id) { s.connect(connection_id,client); }
+        ~scheduled_connection() { s.disconnect(connection_id); }
+    } scheduled{scheduler,connection_id,foreign_ip};
+    struct read_ahead_of_connection { // the reads of the connection are forgotten when it ends
+        read_ahead_detector& r;
+        std::uint64_t connection_id;
+        ~read_ahead_of_connection() { r.disconnect(connection_id); }
+    } read_ahead_tracked{read_ahead,connection_id};
+    struct counted_connection { // the current connections
+        server_metrics& m;
+        explicit counted_connection(server_metrics& m):m(m) { ++m.connections; }
+        ~counted_connection() { --m.connections; }
+    } counted{metrics};
+    auto count_bytes = [&]() {
+        std::lock_guard<std::mutex> guard(out_mx);// the tagged replies are written under it
+        metrics.bytes_received.fetch_add(in_buf.n_in, std::memory_order_relaxed);
+        metrics.bytes_sent.fetch_add(out_buf.n_out, std::memory_order_relaxed);
+        in_buf.n_in = out_buf.n_out = 0;
+    };
+    auto wait_for = [&in_flight](size_t n) { // until at most n are in flight
+        while (in_flight.size() > n) {
+            in_flight.front().get();
+            in_flight.pop_front();
+        }
+    };
     while (in.peek() != EOF) {
         auto msg_type= msg::read_type(in);
-        try { // scoping the binary-archive could be ok, since it forces destruction time (considerable) to taken immediately, reduce memory foot-print early
-              //  at the cost of early& fast response. I leave the commented scopes in there for now, and aim for fastest response-time
-            switch (msg_type) { // currently switch, later maybe table[msg_type]=msg_handler
-            case message_type::EVALUATE_TS_VECTOR:
-            case message_type::EVALUATE_EXPRESSION:{
-                utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
-                ts_vector_t rtsv;
-                core_iarchive ia(in,core_arch_flags);
-                ia>>bind_period;
-                if(msg_type==message_type::EVALUATE_EXPRESSION) {
-                    compressed_ts_expression c_expr;
-                    ia>>c_expr;
-                    rtsv=expression_decompressor::decompress(c_expr);
-                } else {
-                    ia>>rtsv;
-                }
-                ia>>use_ts_cached_read>>update_ts_cache;
-                auto result=do_evaluate_ts_vector(bind_period, rtsv,use_ts_cached_read,update_ts_cache);//first get result
-                msg::write_type(message_type::EVALUATE_TS_VECTOR,out);// then send
-                core_oarchive oa(out,core_arch_flags);
-                oa<<result;
-
-            } break;
-            case message_type::EVALUATE_EXPRESSION_PERCENTILES:
-            case message_type::EVALUATE_TS_VECTOR_PERCENTILES: {
-                utcperiod bind_period;bool use_ts_cached_read,update_ts_cache;
-                ts_vector_t rtsv;
-                vector<int64_t> percentile_spec;
-                gta_t ta;
-                core_iarchive ia(in,core_arch_flags);
-                ia >> bind_period;
-                if(msg_type==message_type::EVALUATE_EXPRESSION_PERCENTILES) {
-                    compressed_ts_expression c_expr;
-                    ia>>c_expr;
-                    rtsv=expression_decompressor::decompress(c_expr);
-                } else {
-                    ia>>rtsv;
-                }
-
-                ia>>ta>>percentile_spec>>use_ts_cached_read>>update_ts_cache;
-
-                auto result = do_evaluate_percentiles(bind_period, rtsv,ta,percentile_spec,use_ts_cached_read,update_ts_cache);//{
-                msg::write_type(message_type::EVALUATE_TS_VECTOR_PERCENTILES, out);
-                core_oarchive oa(out,core_arch_flags);
-                oa << result;
-            } break;
-            case message_type::FIND_TS: {
-                string search_expression; //{
-                search_expression = msg::read_string(in);// >> search_expression;
-                auto find_result = do_find_ts(search_expression);
-                msg::write_type(message_type::FIND_TS, out);
-                core_oarchive oa(out,core_arch_flags);
-                oa << find_result;
-            } break;
-            case message_type::STORE_TS: {
-                ts_vector_t rtsv;
-                bool overwrite_on_write{ true };
-                bool cache_on_write{ false };
-                core_iarchive ia(in,core_arch_flags);
-                ia >> rtsv >> overwrite_on_write >> cache_on_write;
-                do_store_ts(rtsv, overwrite_on_write, cache_on_write);
-                msg::write_type(message_type::STORE_TS, out);
-            } break;
-            case message_type::MERGE_STORE_TS: {
-                ts_vector_t rtsv;
-                bool cache_on_write{ false };
-                core_iarchive ia(in,core_arch_flags);
-                ia >> rtsv >> cache_on_write;
-                do_merge_store_ts(rtsv, cache_on_write);
-                msg::write_type(message_type::MERGE_STORE_TS, out);
-            } break;
-            case message_type::CACHE_FLUSH: {
-                flush_cache();
-                clear_cache_stats();
-                msg::write_type(message_type::CACHE_FLUSH,out);
-            } break;
-            case message_type::CACHE_STATS: {
-                auto cs = get_cache_stats();
-                msg::write_type(message_type::CACHE_STATS,out);
-                core_oarchive oa(out,core_arch_flags);
-                oa<<cs;
-            } break;
-            default:
-                throw runtime_error(string("Server got unknown message type:") + std::to_string((int)msg_type));
-            }
-        } catch (std::exception const& e) {
-            msg::send_exception(e,out);
+        if (msg_type == message_type::TAGGED_REQUEST) {
+            std::uint64_t tag{0};
+            string m = msg::read_tagged(in, tag);
+            wait_for(msg::max_tagged_in_flight - 1);
+            in_flight.push_back(std::async(std::launch::async, [this, tag, m{std::move(m)}, &out, &out_mx, connection_id]() {
+                std::istringstream rin(m);
+                std::ostringstream rout;
+                auto t = msg::read_type(rin);
+                if (t == message_type::TAGGED_REQUEST)
+                    msg::send_exception(runtime_error("Server got nested tagged request"), rout);
+                else
+                    handle_message(t, rin, rout, 0, connection_id);
+                std::lock_guard<std::mutex> guard(out_mx);
+                msg::write_tagged(tag, rout.str(), out);
+                out.flush();
+            }));
+        } else {
+            wait_for(0); // untagged requests are replied in order, after the tagged ones
+            handle_message(msg_type, in, out, 0, connection_id);
+            out.flush();
         }
+        count_bytes();
     }
+    wait_for(0);
+    count_bytes();
 }
 
 
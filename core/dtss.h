@@ -6,12 +6,15 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <memory>
 #include <utility>
 #include <functional>
 #include <cstring>
 #include <regex>
+#include <mutex>
+#include <future>
 
 
 
@@ -30,7 +33,22 @@
 #include "core/time_series_dd.h"
 #include "time_series_info.h"
 #include "utctime_utilities.h"
+#include "thread_pool.h"
+#include "autotune.h"
 #include "dtss_cache.h"
+#include "dtss_single_flight.h"
+#include "dtss_read_batcher.h"
+#include "dtss_subscription.h"
+#include "dtss_cluster.h"
+#include "dtss_container_registry.h"
+#include "dtss_db_pack.h"
+#include "dtss_read_ahead.h"
+#include "dtss_scheduler.h"
+#include "dtss_hot_set.h"
+#include "dtss_cache_snapshot.h"
+#include "dtss_metrics.h"
+#include "dtss_result_cache.h"
+#include "dtss_validated_cache.h"
 #include "dtss_url.h"
 #include "dtss_msg.h"
 #include "dtss_db.h"
@@ -62,6 +80,8 @@ using read_call_back_t = std::function<ts_vector_t(const id_vector_t& ts_ids, ut
 using store_call_back_t = std::function<void(const ts_vector_t&)>;
 using find_call_back_t = std::function<ts_info_vector_t(std::string search_expression)>;
 
+struct cluster_node;
+struct metrics_http;
 
 /** \brief A dtss server with time-series server-side functions
  *
@@ -77,8 +97,7 @@ using find_call_back_t = std::function<ts_info_vector_t(std::string search_expre
  *   shyft://<container>/<local_ts_name>
  * resolves to the internal implementation.
  *
- * TODO: container and thread-safety, given user changes the containers after
- *       the server is started.
+ * The containers can be added and removed while the server is running, ref. container_registry.
  *
  */
 struct server : dlib::server_iostream {
@@ -88,9 +107,39 @@ struct server : dlib::server_iostream {
     find_call_back_t find_ts_cb; ///< called for all non shyft:// find operations
     store_call_back_t store_ts_cb;///< called for all non shyft:// store operations
     // shyft-internal implementation
-    std::unordered_map<std::string, ts_db> container;///< mapping of internal shyft <container> -> ts_db
+    container_registry container;///< mapping of internal shyft <container> -> ts_db, lock-free lookups
     ts_cache_t ts_cache{1000000};// default 1 mill ts in cache
+    expression_result_cache<apoint_ts> result_cache;///< evaluated expressions, off by default, ref. set_result_cache_size
+    series_versions versions;///< the versions of the series, for the validated evaluate of the clients, ref. do_evaluate_validated
+    single_flight<ts_read_key, apoint_ts, ts_read_key_hasher> ts_reads;///< coalesce concurrent reads of the same (id,period), ref. do_read
     bool cache_all_reads{false};
+    std::size_t max_eval_threads{0};///< threads used by one evaluate request, 0 means half of the core::executor, ref. set_max_eval_threads
+    bool autotune_eval_threads{false};///< tune the threads of the evaluate requests, ref. set_autotune_eval_threads
+    core::autotuner eval_tuner;///< the threads of the evaluate requests, when autotune_eval_threads
+    std::mutex eval_tuner_mx;///< protects eval_tuner
+    bool simplify_expressions{true};///< the bound expressions are simplified before evaluation, ref. set_simplify_expressions
+    std::size_t max_io_threads{8};///< threads reading shyft:// containers for one read request, ref. set_max_io_threads
+    std::shared_ptr<core::work_stealing_pool> io_pool;///< created on first use, ref. get_io_pool
+    std::mutex io_pool_mx;///< protects io_pool
+    std::chrono::microseconds read_batch_window{0};///< time external reads waits to be batched, 0 means off, ref. set_read_batching
+    std::size_t read_batch_threads{1};///< threads calling bind_ts_cb for the batches
+    std::shared_ptr<read_batcher<ts_vector_t>> read_batch;///< created on first use, ref. get_read_batcher
+    std::mutex read_batch_mx;///< protects read_batch
+    read_ahead_detector read_ahead;///< the clients reading window after window, off by default, ref. set_read_ahead
+    std::vector<std::future<void>> read_aheads;///< the windows being read ahead, ref. read_ahead_of
+    std::uint64_t n_read_ahead{0};///< windows read ahead
+    std::uint64_t n_read_ahead_dropped{0};///< windows not read ahead, as max_read_aheads were in progress
+    std::mutex read_ahead_mx;///< protects read_aheads and the counters
+    static constexpr std::size_t max_read_aheads=4;///< windows read ahead at the same time
+    subscription_manager subscriptions;///< the expressions clients subscribe to, notified by stores, ref. SUBSCRIBE
+    std::shared_ptr<cluster_node> cluster;///< the cluster this server is a node of, null if none, ref. set_cluster
+    request_scheduler scheduler;///< admission and fair-share dispatch of the costly requests, off by default, ref. set_scheduling
+    std::unique_ptr<periodic_task> hot_set_recorder;///< records the hot set of ts_cache, null if off, ref. set_cache_hot_set_recording
+    std::future<std::size_t> cache_warm_up;///< the warm up in progress, if any, ref. start_warm_cache
+    std::mutex hot_set_mx;///< protects hot_set_recorder and cache_warm_up
+    std::string cache_snapshot_file;///< the cache is saved to it when the server is destroyed, empty if none, ref. set_cache_snapshot
+    server_metrics metrics;///< counters of the hot paths, ref. get_metrics
+    std::shared_ptr<metrics_http> metrics_endpoint;///< serves get_metrics over http, null if off, ref. start_metrics_http, the last member, so it stops first
     // constructors
 
     server()=default;
@@ -116,32 +165,271 @@ struct server : dlib::server_iostream {
         store_ts_cb(std::forward<SCB>(scb)) {
     }
 
-    ~server() =default;
+    /** saves the cache snapshot, if set, ref. set_cache_snapshot */
+    ~server();
 
     //-- container management
-    void add_container(const std::string &container_name,const std::string& root_dir) {
-        container[container_name]=ts_db(root_dir); // TODO: This is not thread-safe(so needs to be done before starting)
+    /** \brief add, or replace, the container container_name, also while the server is running
+     *
+     * Requests in progress keeps the ts_db they use, a replaced container is closed when they are done.
+     * \param packed if true, the series are kept in pack files, ref. ts_db_pack, for containers of many small series,
+     *        then compress_values is not used, and write_ahead_log is not supported
+     * \param normalize_time_axis if true, stored point_dt series that are regularly spaced, or calendar months, quarters or years,
+     *        are saved with a fixed_dt or calendar_dt time-axis, ref. ts_db::normalized, not supported for packed containers
+     */
+    void add_container(const std::string &container_name,const std::string& root_dir,bool compress_values=false,bool write_ahead_log=false,bool packed=false,bool normalize_time_axis=false) {
+        if(packed) {
+            if(write_ahead_log)
+                throw runtime_error("dtss: a packed container can not have a write-ahead log:"+container_name);
+            if(normalize_time_axis)
+                throw runtime_error("dtss: a packed container can not normalize the time-axis:"+container_name);
+            container.add(container_name,std::make_shared<ts_db_pack>(root_dir));
+        } else {
+            auto db=std::make_shared<ts_db>(root_dir,compress_values?ts_db_encoding::xor_delta:ts_db_encoding::raw);
+            db->normalize_time_axis=normalize_time_axis;
+            if(write_ahead_log)
+                db->enable_wal();
+            container.add(container_name,std::move(db));
+        }
+        result_cache.flush();// the results might be of the replaced container
+        versions.flush();
     }
 
-    const ts_db& internal(const std::string& container_name) const {
-        auto f=container.find(container_name);
-        if(f == end(container))
+    /** remove the container container_name, the files are kept, \return true if it was there */
+    bool remove_container(const std::string &container_name) { result_cache.flush(); versions.flush(); return container.remove(container_name);}
+
+    /** \return the names of the containers, ascending */
+    std::vector<std::string> get_container_names() const { return container.names();}
+
+    /** \return the ts_db of container_name, kept by the caller while used, throws if there is none */
+    std::shared_ptr<const its_db> internal(const std::string& container_name) const {
+        auto db=container.find(container_name);
+        if(!db)
             throw runtime_error(std::string("Failed to find shyft container:")+container_name);
-        return f->second;
+        return db;
     }
 
 	//-- expose cache functions
 
-    void add_to_cache(id_vector_t&ids, ts_vector_t& tss) { ts_cache.add(ids,tss);}
+    void add_to_cache(id_vector_t&ids, ts_vector_t& tss) { ts_cache.add(ids,tss); notify_changed(ids);}
     void remove_from_cache(id_vector_t &ids) { ts_cache.remove(ids);}
-    cache_stats get_cache_stats() { return ts_cache.get_cache_stats();}
+    /** the stats of the ts cache, with the size of the expression result cache */
+    cache_stats get_cache_stats() const {
+        auto cs = ts_cache.get_cache_stats();
+        cs.result_count = result_cache.size();
+        cs.result_byte_count = result_cache.estimate_bytes([](const apoint_ts& ts) { return apoint_ts_frag{ ts }.estimate_bytes(); });
+        return cs;
+    }
     void clear_cache_stats() { ts_cache.clear_cache_stats();}
-    void flush_cache() { return ts_cache.flush();}
+    void flush_cache() { ts_cache.flush(); result_cache.flush(); versions.flush();}
     void set_cache_size(std::size_t max_size) { ts_cache.set_capacity(max_size);}
     void set_auto_cache(bool active) { cache_all_reads=active;}
     std::size_t get_cache_size() const {return ts_cache.get_capacity();}
+    void set_cache_byte_size(std::size_t max_bytes) { ts_cache.set_byte_capacity(max_bytes);}
+    std::size_t get_cache_byte_size() const {return ts_cache.get_byte_capacity();}
+    void set_cache_policy(cache_policy policy) { ts_cache.set_policy(policy);}
+    cache_policy get_cache_policy() const {return ts_cache.get_policy();}
+    cache_stats get_cache_policy_stats(cache_policy policy) const { return ts_cache.get_policy_stats(policy);}
+
+    /** \brief set the max results of the expression result cache, 0, the default, turns it off
+     *
+     * Evaluate requests using the ts-cache, and not updating it, get the results of identical expressions
+     * and periods evaluated before, until a series they reference is stored, ref. expression_result_cache.
+     * Only expressions referencing shyft:// series alone are cached, since the server is not told when
+     * the external series change, and a server in a cluster does not cache, since the stores of the other nodes are not seen.
+     */
+    void set_result_cache_size(std::size_t max_items) { result_cache.set_capacity(max_items);}
+    std::size_t get_result_cache_size() const { return result_cache.get_capacity();}
+
+    /** \brief limit the threads, from the shared core::executor pool, that one evaluate request can use
+     *
+     * The expressions of a request are evaluated in parallel, in result order, and the limit ensures
+     * that a request with thousands of expressions leaves threads for other connections.
+     * \param n max threads for each request, 0 means half of the executor threads
+     */
+    void set_max_eval_threads(std::size_t n) { max_eval_threads=n;}
+    std::size_t get_max_eval_threads() const { return max_eval_threads?max_eval_threads:std::max<std::size_t>(1,core::executor::size()/2);}
+
+    /** \brief turn on/off tuning of the threads of the evaluate requests, for the number of expressions, on this machine
+     *
+     * The first requests of each size each use one of the executor size, half and a quarter of it as max eval threads,
+     * and measure the time per expression. When all are measured, the fastest is kept, and used by the following requests,
+     * ref. core::autotune_store, that can persist the choice to a file.
+     * When on, it takes precedence over set_max_eval_threads.
+     */
+    void set_autotune_eval_threads(bool on) { autotune_eval_threads=on;}
+    bool get_autotune_eval_threads() const { return autotune_eval_threads;}
+
+    /** \brief turn on/off the algebraic simplification of the bound expressions, on by default, ref. expression_simplifier
+     *
+     * Nodes like time_shift(time_shift(x,a),b), abs(abs(x)) and x*1.0 are merged or removed before the evaluation,
+     * turn it off to evaluate the expressions exactly as sent, e.g. when debugging an expression.
+     */
+    void set_simplify_expressions(bool on) { simplify_expressions=on;}
+    bool get_simplify_expressions() const { return simplify_expressions;}
+
+    /** \brief set the threads, including the connection thread, that one read request use to read shyft:// containers
+     *
+     * The reads are i/o bound, so they run on a separate pool, not on the core::executor used for evaluation.
+     * The pool is shared by the connections, and created on first use.
+     * \param n max threads for each read request, 1 reads sequentially on the connection thread
+     */
+    void set_max_io_threads(std::size_t n) {
+        std::lock_guard<std::mutex> guard(io_pool_mx);
+        max_io_threads=std::max<std::size_t>(1,n);
+        io_pool.reset();// requests in progress keeps the old one
+    }
+    std::size_t get_max_io_threads() const { return max_io_threads;}
+    std::shared_ptr<core::work_stealing_pool> get_io_pool() {
+        std::lock_guard<std::mutex> guard(io_pool_mx);
+        if(!io_pool)
+            io_pool=std::make_shared<core::work_stealing_pool>(max_io_threads-1);// the calling thread participates
+        return io_pool;
+    }
+
+    /** \brief batch the bind_ts_cb reads of concurrent requests
+     *
+     * The external reads of the same period that arrives within window are joined into one bind_ts_cb call,
+     * with each id once, made on one of the n_threads of the batcher, while the connection threads waits.
+     * So a callback that serialize the calls, like a python callback taking the GIL, is called once
+     * for the concurrent requests, not once for each.
+     * \param window time a batch waits for more reads, from its first read, 0 calls bind_ts_cb directly as before
+     * \param n_threads threads calling bind_ts_cb for the batches, at least 1
+     */
+    void set_read_batching(std::chrono::microseconds window, std::size_t n_threads=1) {
+        std::shared_ptr<read_batcher<ts_vector_t>> old;
+        std::lock_guard<std::mutex> guard(read_batch_mx);
+        read_batch_window=window;
+        read_batch_threads=std::max<std::size_t>(1,n_threads);
+        old.swap(read_batch);// requests in progress keeps the old one, the last to leave stops it
+    }
+    std::chrono::microseconds get_read_batch_window() const { return read_batch_window;}
+    std::size_t get_read_batch_threads() const { return read_batch_threads;}
+    /** \return the read batcher, or null if read batching is off */
+    std::shared_ptr<read_batcher<ts_vector_t>> get_read_batcher() {
+        std::lock_guard<std::mutex> guard(read_batch_mx);
+        if(!read_batch && read_batch_window.count()>0)
+            read_batch=std::make_shared<read_batcher<ts_vector_t>>([this](const id_vector_t& ids,utcperiod p){return bind_ts_cb(ids,p);},read_batch_window,read_batch_threads);
+        return read_batch;
+    }
+
+    /** \brief read the next window into the cache, in the background, for clients reading the same series window after window
+     *
+     * A client paging through long series, like month after month, reads each window from the containers or bind_ts_cb.
+     * When a client has read the same series for adjacent periods min_run times in a row, the next window,
+     * of the same length and direction, is read into ts_cache while the client works on the current one,
+     * so the sequential scan is served from the cache, ref. read_ahead_detector.
+     * Only the requests that use the cache are tracked, and at most max_read_aheads windows are read at the same time.
+     * \param min_run sequential reads before reading ahead, 0 turns it off, the default
+     */
+    void set_read_ahead(std::size_t min_run) { read_ahead.configure(min_run);}
+    std::size_t get_read_ahead() const { return read_ahead.min_run();}
+    /** \return the number of windows read ahead, and the number dropped as too many were in progress */
+    std::pair<std::uint64_t,std::uint64_t> get_read_ahead_stats() {
+        std::lock_guard<std::mutex> guard(read_ahead_mx);
+        return std::make_pair(n_read_ahead,n_read_ahead_dropped);
+    }
+    /** wait for the windows being read ahead */
+    void wait_read_ahead();
+
+    /** \brief run the server as node self of a cluster of the servers at host_ports
+     *
+     * The shyft:// series are partitioned on the nodes by a consistent hash of the ts-url, ref. hash_ring,
+     * each on replication nodes, the first its primary.
+     * A store of a series is forwarded to its primary, that saves it, and replicates it asynchronously
+     * to the other nodes of the series, ref. REPLICATE_TS, so the replicas are eventually consistent.
+     * A read of a series that is not on this node is read from one of its nodes, round-robin,
+     * so any node can evaluate any expression, and the reads are spread on the replicas.
+     * All nodes must have the same host_ports and replication, and the containers, before they are started.
+     * \param host_ports the host:port of each node of the cluster
+     * \param self the index in host_ports of this server
+     * \param replication the number of nodes of each series, at most the number of nodes
+     */
+    void set_cluster(const std::vector<std::string>& host_ports, std::size_t self, std::size_t replication=2);
+    /** \return number of replications queued, or in progress */
+    std::size_t get_replication_pending() const;
+    /** \return number of replications that failed, the replica missed the store */
+    std::size_t get_replication_failures() const;
+    /** wait until the replications queued so far are done */
+    void flush_replication();
+
+    /** \brief limit the costly requests running at the same time, and share the workers fairly among the clients
+     *
+     * The evaluate, percentile, aggregate and store requests wait for one of the workers, and are dispatched
+     * with fair shares by their estimated cost, series times hours of the period, or points stored,
+     * so a client sending many large requests does not starve the others, ref. request_scheduler.
+     * \note in a cluster, the reads from other nodes are requests there, so use enough workers to cover them
+     * \param workers max costly requests running, 0 turns scheduling off, the default
+     * \param max_queued max requests waiting, more are rejected with an exception to the client, 0 means no limit
+     */
+    void set_scheduling(std::size_t workers, std::size_t max_queued=0) { scheduler.configure(workers,max_queued);}
+    /** set the fair-share weight of the client with the foreign ip, default 1, so interactive users can get a larger share than batch jobs */
+    void set_client_weight(const std::string& foreign_ip, double weight) { scheduler.set_weight(foreign_ip,weight);}
+    scheduler_stats get_scheduler_stats() const { return scheduler.stats();}
+
+    //-- cache warm up
+    /** \brief write the hot set of the cache, the ids and periods of the fragments, most recently used first, to file, ref. write_hot_set
+     * \param max_ids max ids written, the most recently used, 0 means all
+     */
+    void save_cache_hot_set(const std::string& file, std::size_t max_ids=0) const { write_hot_set(file,ts_cache.get_hot_set(max_ids));}
+    /** \brief record the hot set of the cache to file every interval, and when stopped, so a restarted server can warm its cache from it
+     * \param interval time between the records, 0 stops recording
+     * \param max_ids max ids recorded, the most recently used, 0 means all
+     */
+    void set_cache_hot_set_recording(const std::string& file, std::chrono::milliseconds interval, std::size_t max_ids=0);
+    /** \brief read the series of the hot set file into the cache
+     *
+     * The entries are read the least recently used first, grouped by period, with the parallel reads of do_read,
+     * so the hottest series are the most recent of the cache. A series that fails to read is skipped,
+     * as is a missing file, so a changed container, or the first start, is not an error.
+     * \return number of (id,period) entries read into the cache
+     */
+    std::size_t warm_cache(const std::string& file);
+    /** start warm_cache(file) in the background, so the server can accept connections meanwhile */
+    void start_warm_cache(const std::string& file);
+    /** wait for the warm up started by start_warm_cache, \return its warm_cache result, 0 if none was started */
+    std::size_t wait_warm_cache();
+    /** \brief write the fragments of the cache, and the lru order, to the binary snapshot file, ref. write_cache_snapshot */
+    void save_cache_snapshot(const std::string& file) const;
+    /** \brief add the fragments of the snapshot file to the cache, in the lru order of the snapshot
+     * \return number of ids added, 0 if there is no file, throws if the file is not a valid snapshot
+     */
+    std::size_t load_cache_snapshot(const std::string& file);
+    /** \brief load the cache snapshot file, if there is one, and save the cache to it when the server is destroyed
+     *
+     * So a restarted server has the cache it had, without reading the series again, ref. save_cache_snapshot.
+     * \param file the snapshot file, empty turns saving off
+     * \return number of ids loaded
+     */
+    std::size_t set_cache_snapshot(const std::string& file) {
+        cache_snapshot_file=file;
+        return file.empty()?0:load_cache_snapshot(file);
+    }
+
+    //-- metrics
+    /** \brief the metrics of the server, in the prometheus text format
+     *
+     * The latency histograms of each message type, of the bind, evaluate and serialize phases, of the container
+     * reads and writes, and of the callbacks, the bytes in and out, the connections,
+     * and the cache, scheduler and replication counters, ref. server_metrics.
+     */
+    std::string get_metrics() const;
+    /** \brief serve get_metrics as text over http, GET /metrics, on port, so prometheus can scrape it
+     * \param port the listening port, 0 picks a free one where the socket layer supports it
+     * \param ip the listening ip, empty means any
+     * \return the port
+     */
+    int start_metrics_http(int port, const std::string& ip="");
+    void stop_metrics_http();
 
     ts_info_vector_t do_find_ts(const std::string& search_expression);
+    /** \brief the ts_info of each of ids, in order, ref. GET_TS_INFO
+     *
+     * The shyft:// series are served from the catalogues of the containers, ref. ts_db::get_ts_infos,
+     * the others from the fragments in the cache, where data_period is the period cached.
+     * An id not found gets a ts_info with only the name, the id, set, and an invalid data_period.
+     */
+    ts_info_vector_t do_get_ts_info(const id_vector_t& ids);
 
     std::string extract_url(const apoint_ts&ats) const {
         auto rts = dynamic_pointer_cast<aref_ts>(ats.ts);
@@ -150,23 +438,69 @@ struct server : dlib::server_iostream {
         throw runtime_error("dtss store.extract_url:supplied type must be of type ref_ts");
     }
 
-    void do_cache_update_on_write(const ts_vector_t&tsv);
+    /** \brief add the stored series of tsv to the cache, in one ts_cache.add, so each shard is locked once for its ids
+     * \param tsv the stored series, aref_ts with the stored points
+     * \param ix if not null, only the series at these positions of tsv
+     */
+    void do_cache_update_on_write(const ts_vector_t&tsv, const std::vector<size_t>* ix=nullptr);
 
-    void do_store_ts(const ts_vector_t & tsv, bool overwrite_on_write, bool cache_on_write);
+    /** \brief store tsv, in a cluster the series of other primary nodes are forwarded to those, unless replicated, as from the primary */
+    void do_store_ts(const ts_vector_t & tsv, bool overwrite_on_write, bool cache_on_write, bool replicated=false);
 
     void do_merge_store_ts(const ts_vector_t & tsv, bool cache_on_write);
     /** \brief Read the time-series from providers for specified period
     *
     * \param ts_ids identifiers, url form, where shyft://.. is specially filtered
     * \param p the period to read
-    * \param use_ts_cached_read allow reading results from already existing cached results
+    * \param use_ts_cached_read allow reading results from already existing cached results,
+    *        an id where the cache covers parts of p is completed by reading only the sub-periods that are missing
     * \param update_ts_cache when reading, also update the ts-cache with the results
+    * \param coalesce_reads if true, a (id,period) that another request is already reading is not read again,
+    *        the result of the other read is shared instead, so the ts_db or bind_ts_cb is hit once for concurrent requests.
+    *        The results of coalesced reads are shared, like results from the cache, so they must not be modified.
     * \return read ts-vector in the order of the ts_ids
     */
-    ts_vector_t do_read(const id_vector_t& ts_ids,utcperiod p,bool use_ts_cached_read,bool update_ts_cache);
+    ts_vector_t do_read(const id_vector_t& ts_ids,utcperiod p,bool use_ts_cached_read,bool update_ts_cache,bool coalesce_reads=true);
+    /** read ts_ids[i] for i in miss into r[i], for period p, joining the reads in progress if coalesce_reads, ref. do_read */
+    void do_read_missing(const id_vector_t& ts_ids,const std::vector<std::size_t>& miss,utcperiod p,bool cache_read_results,bool coalesce_reads,ts_vector_t& r);
+    /** read ts_ids[i] for i in ix into r[i], from the shyft containers, or the bind_ts_cb */
+    void do_read_sources(const id_vector_t& ts_ids,const std::vector<std::size_t>& ix,utcperiod p,bool cache_read_results,ts_vector_t& r);
     void do_bind_ts(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache);
+    /** track the read of the series of atsv for bind_period by the client connection_id, and read the next window ahead, ref. set_read_ahead */
+    void read_ahead_of(std::uint64_t connection_id,const ts_vector_t& atsv,utcperiod bind_period,bool use_ts_cached_read);
+    /** evaluate atsv for bind_period, the results of the expressions in the result_cache are not evaluated again, ref. set_result_cache_size */
     ts_vector_t do_evaluate_ts_vector(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache);
+    ts_vector_t do_evaluate_ts_vector_uncached(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache);
+    /** the series ids are changed, the reads in progress and the results referencing them are removed, and their subscriptions notified */
+    void notify_changed(const id_vector_t& ids) { forget_reads(ids); versions.changed(ids); result_cache.invalidate(ids); subscriptions.notify(ids);}
+    /** the reads in progress of ids are forgotten, so a read after a store does not join a read started before it, ref. ts_reads */
+    void forget_reads(const id_vector_t& ids) {
+        if (ts_reads.size() == 0) return;
+        std::unordered_set<string> s(ids.begin(), ids.end());
+        ts_reads.forget_if([&s](const ts_read_key& k) { return s.count(k.id) > 0; });
+    }
+    /** \brief the versions of the expressions of atsv, ref. series_versions, before they are bound
+     *
+     * Only expressions referencing shyft:// series alone get a version, the others, and all in a cluster,
+     * where the stores of the other nodes are not seen, get 0, and are always evaluated.
+     */
+    std::vector<std::uint64_t> do_get_versions(const ts_vector_t& atsv);
+    /** \brief evaluate the expressions of atsv that are not of version[i], \return their indices, and sets result to them, ref. EVALUATE_VALIDATED
+     * \param version in: the version the client has of each expression, 0 if none, out: the current version
+     */
+    std::vector<std::size_t> do_evaluate_validated(utcperiod bind_period, ts_vector_t& atsv, std::vector<std::uint64_t>& version, bool use_ts_cached_read, bool update_ts_cache, ts_vector_t& result);
+    /** evaluate atsv in chunks of chunk_size series, read and evaluated one at the time, passing the result of each to fx, atsv is released as it goes */
+    void do_evaluate_stream(utcperiod bind_period, ts_vector_t& atsv,bool use_ts_cached_read,bool update_ts_cache,size_t chunk_size,const std::function<void(const ts_vector_t&)>& fx);
     ts_vector_t do_evaluate_percentiles(utcperiod bind_period, ts_vector_t& atsv, gta_t const&ta,std::vector<int64_t> const& percentile_spec,bool use_ts_cached_read,bool update_ts_cache);
+    ts_vector_t do_evaluate_aggregates(utcperiod bind_period, ts_vector_t& atsv, gta_t const&ta,std::vector<int64_t> const& aggregate_spec,std::vector<double> const& weights,std::vector<double> const& bins,bool use_ts_cached_read,bool update_ts_cache);
+
+    /** \brief evaluate the expressions ix of the subscription request
+     *
+     * The changed series are read from the sources, not the cache, so a store without cache_on_write is seen.
+     */
+    ts_vector_t do_evaluate_subscription(const subscription_request& req, const std::vector<std::size_t>& ix);
+    /** handle the message of msg_type, read from in, writing the reply, or the exception it got, to out, with the WIRE_OPTIONS wire_options */
+    void handle_message(message_type msg_type, std::istream& in, std::ostream& out, std::uint32_t wire_options = 0, std::uint64_t connection_id = 0);
 
     // ref. dlib, all connection calls are directed here
     void on_connect(
@@ -7,6 +7,8 @@
 #include <map>
 #include <unordered_map>
 #include <list>
+#include <functional>
+#include <cassert>
 #include <algorithm>
 #include <memory>
 #include <utility>
@@ -47,6 +49,20 @@ namespace shyft {
         using shyft::time_series::dd::gta_t;
         using shyft::time_series::dd::gpoint_ts;
 
+        /** \brief eviction policy of the lru_cache
+         *
+         *  lru: the least recently used item is evicted.
+         *  two_q: a scan resistant 2Q variant (segmented lru), new items enters a probation segment,
+         *         and are promoted to the protected segment on their second access. Items are evicted from
+         *         probation first, so a scan of many items used once only replaces the probation segment,
+         *         keeping the frequently used items of the protected segment.
+         */
+        enum class cache_policy : int8_t {
+            lru = 0,
+            two_q = 1
+        };
+        constexpr size_t cache_policy_count = 2;
+
         /** \brief lru-cache
          *
          *  Based on https://timday.bitbucket.io/lru.html#x1-8007r1 and other that
@@ -59,6 +75,11 @@ namespace shyft {
          *  In the dtss context we use it as *tool* for the thread-safe and more specific
          *  caching, including sparse ts cache, possibly update with merge.
          *
+         *  The eviction policy is lru by default, or two_q, ref. cache_policy.
+         *  With two_q the probation segment is evicted first, and the protected segment keeps
+         *  at most 3/4 of the capacity, demoting its least recently used items to probation,
+         *  so a full cache has at least 1/4 of the capacity for new items.
+         *
          */
         template <
             typename K,
@@ -70,18 +91,25 @@ namespace shyft {
             using value_type = V;
             using key_tracker_type = list<key_type>;///< Key access history, most recent at back
 
+            /** value, its position in the key history, and if that's the probation segment */
+            struct item_type {
+                value_type v;
+                typename key_tracker_type::iterator it;
+                bool probation;
+            };
                                                          /** Key to value and key history iterator */
             using key_to_value_type = MAP<
                 key_type,
-                pair<value_type, typename key_tracker_type::iterator>
+                item_type
             >;
 
             /** Constructor specifies the cached function and
              *  the maximum number of records to be stored
              *  \param c maximum id-count in the cache, required to be > 0
+             *  \param policy the eviction policy
              *
              */
-            lru_cache(size_t c) :_capacity(c) {
+            lru_cache(size_t c, cache_policy policy = cache_policy::lru) :_capacity(c), _policy(policy) {
                 assert(_capacity != 0);
             }
 
@@ -100,8 +128,8 @@ namespace shyft {
                     throw runtime_error(string("attempt to get non-existing key:")+k);
                 }
                 else { // We do have it, rotate the element into front of list
-                    _key_tracker.splice(_key_tracker.end(), _key_tracker, (*it).second.second);
-                    return (*it).second.first;// Return the retrieved value
+                    touch((*it).second);
+                    return (*it).second.v;// Return the retrieved value
                 }
             }
 
@@ -121,8 +149,8 @@ namespace shyft {
                     insert(k, v);
                 }
                 else {
-                    (*it).second.first = v;
-                    _key_tracker.splice(_key_tracker.end(), _key_tracker, (*it).second.second);// rotate into 1st position
+                    (*it).second.v = v;
+                    touch((*it).second);// rotate into 1st position
                 }
             }
 
@@ -130,80 +158,452 @@ namespace shyft {
             void remove_item(const key_type&k) {
                 const auto it = _key_to_value.find(k);
                 if (it != _key_to_value.end()) { // We do have it:
-                    _key_tracker.erase((*it).second.second);
+                    tracker_of((*it).second).erase((*it).second.it);
                     _key_to_value.erase(it);
                 }
             }
 
             /** Obtain the cached keys, most recently used element
-            *  at head, least recently used at tail.
+            *  at head, least recently used at tail, with two_q the protected segment first.
             *  This method is provided purely to support testing. */
             template <typename IT>
             void get_mru_keys(IT dst) const {
                 auto src = _key_tracker.rbegin();
                 while (src != _key_tracker.rend()) *dst++ = *src++;
+                auto psrc = _probation.rbegin();
+                while (psrc != _probation.rend()) *dst++ = *psrc++;
             }
 
 			/** scan items calling fx(key,vale) for each */
 			template <typename Fx>
 			void apply_to_items(Fx &&fx) const {
 				for (const auto& kv : _key_to_value) {
-					fx(kv.first, kv.second.first);
+					fx(kv.first, kv.second.v);
 				}
 			}
             /**adjust capacity, evict excessive items as needed */
             void set_capacity(size_t cap) {
                 if(cap==0) throw runtime_error("cache capacity must be >0");
-                if(cap<_capacity) {
-                    while(_key_to_value.size()>cap)
-                        evict();
-                }
                 _capacity=cap;
+                while(_key_to_value.size()>cap)
+                    evict();
+                demote();
             }
             size_t get_capacity() const {return _capacity;}
+            size_t size() const {return _key_to_value.size();}
+
+            /** change the eviction policy, the items are kept, with two_q as protected, with lru the probation items are the least recent */
+            void set_policy(cache_policy policy) {
+                if (policy == _policy)
+                    return;
+                if (policy == cache_policy::lru) {
+                    for (auto& k : _probation)
+                        _key_to_value.find(k)->second.probation = false;
+                    _key_tracker.splice(_key_tracker.begin(), _probation);
+                }
+                _policy = policy;
+                demote();
+            }
+            cache_policy get_policy() const {return _policy;}
+
+            /** evict items in eviction-order while fx(key,value) of the next item to evict returns true */
+            template <typename Fx>
+            void evict_while(Fx &&fx) {
+                while (!_key_to_value.empty()) {
+                    const auto it = _key_to_value.find(victim());
+                    if (!fx(it->first, it->second.v))
+                        return;
+                    evict();
+                }
+            }
 
 			/** Flush cache */
 			void flush() {
 				_key_tracker.clear();
+				_probation.clear();
 				_key_to_value.clear();
 			}
             private:
+                key_tracker_type& tracker_of(const item_type& i) { return i.probation ? _probation : _key_tracker; }
+
+                /** max size of the protected segment with two_q */
+                size_t protected_capacity() const { return _capacity - _capacity/4; }
+
+                /** record an access, with two_q a probation item is promoted to protected */
+                void touch(item_type& i) {
+                    if (i.probation) {
+                        _key_tracker.splice(_key_tracker.end(), _probation, i.it);
+                        i.probation = false;
+                        demote();
+                    } else {
+                        _key_tracker.splice(_key_tracker.end(), _key_tracker, i.it);
+                    }
+                }
+
+                /** with two_q, move the least recently used protected items to probation, keeping protected_capacity */
+                void demote() {
+                    if (_policy != cache_policy::two_q)
+                        return;
+                    while (_key_tracker.size() > protected_capacity()) {
+                        auto i = _key_tracker.begin();
+                        _key_to_value.find(*i)->second.probation = true;
+                        _probation.splice(_probation.end(), _key_tracker, i);
+                    }
+                }
 
                 /** Record a fresh key-value pair in the cache */
                 void insert(const key_type& k, const value_type& v) {
                     assert(_key_to_value.find(k) == _key_to_value.end());// Method is only called on cache misses
                     if (_key_to_value.size() >= _capacity) // Make space if necessary
                         evict();
-
+                    const bool probation = _policy == cache_policy::two_q;
+                    auto& tracker = probation ? _probation : _key_tracker;
                     // Record k as most-recently-used key
-                    auto it = _key_tracker.insert(_key_tracker.end(), k);
+                    auto it = tracker.insert(tracker.end(), k);
                     // Create the key-value entry, linked to the usage record.
                     _key_to_value.insert(
                         std::make_pair(
                             k,
-                            std::make_pair(v, it)
+                            item_type{v, it, probation}
                         )
                     );
                 }
 
-                /** Purge the least-recently-used element in the cache */
+                /** the key of next item to evict, the cache must be non-empty */
+                const key_type& victim() const {
+                    return _probation.empty() ? _key_tracker.front() : _probation.front();
+                }
+
+                /** Purge the next item to evict, the least-recently-used element of the segment in turn */
                 void evict() {
-                    assert(!_key_tracker.empty());// Assert method is never called when cache is empty
-                                                  // Identify least recently used key
-                    const auto it = _key_to_value.find(_key_tracker.front());
+                    assert(!_key_to_value.empty());// Assert method is never called when cache is empty
+                    const auto it = _key_to_value.find(victim());
                     assert(it != _key_to_value.end());
                     // Erase both elements to completely purge record
+                    tracker_of(it->second).erase(it->second.it);
                     _key_to_value.erase(it);
-                    _key_tracker.pop_front();
                 }
 
 
                 size_t _capacity;///< Maximum number of key-value pairs to be retained
-                key_tracker_type _key_tracker;///< Key access history
+                cache_policy _policy;///< the eviction policy
+                key_tracker_type _key_tracker;///< Key access history, the protected segment with two_q
+                key_tracker_type _probation;///< Key access history of the probation segment, only used with two_q
                 key_to_value_type _key_to_value; ///< Key-to-value lookup
         };
 
 
+        /** \brief flat lru-cache, same interface and policies as lru_cache, without node allocations
+         *
+         *  The items are kept in one open-addressing hash table (linear probing), storing each key once,
+         *  and the lru order(s) are doubly-linked lists of slot indexes inside the table.
+         *  So an insert allocates nothing, except when the table grows, and an access that updates the
+         *  lru order only relinks indexes within the table.
+         *
+         *  Erased slots are marked deleted, and reused by later inserts. The table is rebuilt,
+         *  keeping the lru order, when used and deleted slots exceeds 3/4 of it,
+         *  sized to twice the used slots.
+         *
+         *  \note references returned by get_item are invalidated by the next add_item
+         *
+         * \sa lru_cache
+         * \sa cache_policy
+         */
+        template <
+            typename K,
+            typename V,
+            typename H = std::hash<K>
+        >
+        struct flat_lru_cache {
+            using key_type = K;
+            using value_type = V;
+
+            /** \param c maximum id-count in the cache, required to be > 0
+             *  \param policy the eviction policy
+             */
+            flat_lru_cache(size_t c, cache_policy policy = cache_policy::lru) :_capacity(c), _policy(policy) {
+                assert(_capacity != 0);
+            }
+
+            bool item_exists(const key_type& k) const { return find(k) != npos; }
+
+            /**\return a reference to item with key k, or throws */
+            value_type& get_item(const key_type& k) {
+                const auto i = find(k);
+                if (i == npos)
+                    throw runtime_error(string("attempt to get non-existing key:")+k);
+                touch(i);
+                return _slots[i].v;
+            }
+
+            /** \return the item with key k, or null, without changing the lru order */
+            const value_type* peek_item(const key_type& k) const {
+                const auto i = find(k);
+                return i == npos ? nullptr : &_slots[i].v;
+            }
+
+            /**  try to get a value of the cached function for k */
+            bool try_get_item(const key_type& k, value_type&r) {
+                const auto i = find(k);
+                if (i == npos)
+                    return false;
+                touch(i);
+                r = _slots[i].v;
+                return true;
+            }
+
+            /** add an item(that does not exists) into cache, or if exist, update its value */
+            void add_item(const key_type&k, const value_type&v) {
+                const auto i = find(k);
+                if (i == npos) {
+                    insert(k, v);
+                } else {
+                    _slots[i].v = v;
+                    touch(i);
+                }
+            }
+
+            /** remove and item that *might* exist */
+            void remove_item(const key_type&k) {
+                const auto i = find(k);
+                if (i != npos)
+                    erase(i);
+            }
+
+            /** Obtain the cached keys, most recently used element
+            *  at head, least recently used at tail, with two_q the protected segment first.
+            *  This method is provided purely to support testing. */
+            template <typename IT>
+            void get_mru_keys(IT dst) const {
+                for (const auto& l : _lists)
+                    for (auto i = l.tail; i != npos; i = _slots[i].prev)
+                        *dst++ = _slots[i].key;
+            }
+
+            /** scan items in the order of get_mru_keys, calling fx(key,value) for each */
+            template <typename Fx>
+            void apply_to_items_mru(Fx &&fx) const {
+                for (const auto& l : _lists)
+                    for (auto i = l.tail; i != npos; i = _slots[i].prev)
+                        fx(_slots[i].key, _slots[i].v);
+            }
+
+            /** scan items calling fx(key,vale) for each */
+            template <typename Fx>
+            void apply_to_items(Fx &&fx) const {
+                for (const auto& s : _slots)
+                    if (s.state == used)
+                        fx(s.key, s.v);
+            }
+
+            /**adjust capacity, evict excessive items as needed */
+            void set_capacity(size_t cap) {
+                if(cap==0) throw runtime_error("cache capacity must be >0");
+                _capacity = cap;
+                while (_n_used > cap)
+                    evict();
+                demote();
+            }
+            size_t get_capacity() const {return _capacity;}
+            size_t size() const {return _n_used;}
+
+            /** change the eviction policy, the items are kept, with two_q as protected, with lru the probation items are the least recent */
+            void set_policy(cache_policy policy) {
+                if (policy == _policy)
+                    return;
+                if (policy == cache_policy::lru) {
+                    auto& p = _lists[probation_list];
+                    for (auto i = p.tail; i != npos; i = p.tail) {
+                        unlink(i);
+                        push_front(protected_list, i);
+                    }
+                }
+                _policy = policy;
+                demote();
+            }
+            cache_policy get_policy() const {return _policy;}
+
+            /** evict items in eviction-order while fx(key,value) of the next item to evict returns true */
+            template <typename Fx>
+            void evict_while(Fx &&fx) {
+                while (_n_used) {
+                    const auto i = victim();
+                    if (!fx(_slots[i].key, _slots[i].v))
+                        return;
+                    erase(i);
+                }
+            }
+
+            /** Flush cache */
+            void flush() {
+                _slots.clear();
+                _slots.shrink_to_fit();
+                _n_used = _n_deleted = 0;
+                _lists[0] = _lists[1] = link_list{};
+            }
+
+            private:
+                using ix_t = std::uint32_t;
+                static constexpr ix_t npos = ix_t(-1);
+                enum : std::uint8_t { empty = 0, used = 1, deleted = 2 };
+                enum : std::uint8_t { protected_list = 0, probation_list = 1 };
+
+                struct slot {
+                    key_type key;
+                    value_type v;
+                    size_t h{0};///< hash of key
+                    ix_t prev{npos};///< towards the least recently used
+                    ix_t next{npos};///< towards the most recently used
+                    std::uint8_t state{empty};
+                    std::uint8_t list{protected_list};
+                };
+                struct link_list {
+                    ix_t head{npos};///< least recently used
+                    ix_t tail{npos};///< most recently used
+                    size_t n{0};
+                };
+
+                ix_t find(const key_type& k) const {
+                    if (_slots.empty())
+                        return npos;
+                    const size_t mask = _slots.size() - 1;
+                    const size_t h = H{}(k);
+                    for (size_t i = h & mask;; i = (i + 1) & mask) {
+                        const auto& s = _slots[i];
+                        if (s.state == empty)
+                            return npos;
+                        if (s.state == used && s.h == h && s.key == k)
+                            return ix_t(i);
+                    }
+                }
+
+                void unlink(ix_t i) {
+                    auto& s = _slots[i];
+                    auto& l = _lists[s.list];
+                    if (s.prev != npos) _slots[s.prev].next = s.next; else l.head = s.next;
+                    if (s.next != npos) _slots[s.next].prev = s.prev; else l.tail = s.prev;
+                    s.prev = s.next = npos;
+                    --l.n;
+                }
+
+                void push_back(std::uint8_t li, ix_t i) {
+                    auto& l = _lists[li];
+                    auto& s = _slots[i];
+                    s.list = li;
+                    s.prev = l.tail; s.next = npos;
+                    if (l.tail != npos) _slots[l.tail].next = i; else l.head = i;
+                    l.tail = i;
+                    ++l.n;
+                }
+
+                void push_front(std::uint8_t li, ix_t i) {
+                    auto& l = _lists[li];
+                    auto& s = _slots[i];
+                    s.list = li;
+                    s.next = l.head; s.prev = npos;
+                    if (l.head != npos) _slots[l.head].prev = i; else l.tail = i;
+                    l.head = i;
+                    ++l.n;
+                }
+
+                /** max size of the protected segment with two_q */
+                size_t protected_capacity() const { return _capacity - _capacity/4; }
+
+                /** record an access, with two_q a probation item is promoted to protected */
+                void touch(ix_t i) {
+                    const bool promote = _slots[i].list == probation_list;
+                    unlink(i);
+                    push_back(protected_list, i);
+                    if (promote)
+                        demote();
+                }
+
+                /** with two_q, move the least recently used protected items to probation, keeping protected_capacity */
+                void demote() {
+                    if (_policy != cache_policy::two_q)
+                        return;
+                    while (_lists[protected_list].n > protected_capacity()) {
+                        auto i = _lists[protected_list].head;
+                        unlink(i);
+                        push_back(probation_list, i);
+                    }
+                }
+
+                /** the slot of next item to evict, the cache must be non-empty */
+                ix_t victim() const {
+                    return _lists[probation_list].n ? _lists[probation_list].head : _lists[protected_list].head;
+                }
+
+                void evict() {
+                    assert(_n_used);// never called when cache is empty
+                    erase(victim());
+                }
+
+                void erase(ix_t i) {
+                    unlink(i);
+                    auto& s = _slots[i];
+                    s.state = deleted;
+                    s.key = key_type{};// release the resources now
+                    s.v = value_type{};
+                    --_n_used;
+                    ++_n_deleted;
+                }
+
+                /** rebuild the table with size slots, a power of 2, keeping the lists order */
+                void rehash(size_t size) {
+                    vector<slot> old(size);
+                    old.swap(_slots);
+                    link_list old_lists[2] = {_lists[0], _lists[1]};
+                    _lists[0] = _lists[1] = link_list{};
+                    const size_t mask = size - 1;
+                    for (std::uint8_t li = 0; li < 2; ++li) {
+                        for (auto j = old_lists[li].head; j != npos; j = old[j].next) {
+                            auto& o = old[j];
+                            size_t i = o.h & mask;
+                            while (_slots[i].state != empty) i = (i + 1) & mask;
+                            auto& s = _slots[i];
+                            s.key = std::move(o.key);
+                            s.v = std::move(o.v);
+                            s.h = o.h;
+                            s.state = used;
+                            push_back(li, ix_t(i));
+                        }
+                    }
+                    _n_deleted = 0;
+                }
+
+                /** Record a fresh key-value pair in the cache */
+                void insert(const key_type& k, const value_type& v) {
+                    assert(find(k) == npos);// Method is only called on cache misses
+                    if (_n_used >= _capacity) // Make space if necessary
+                        evict();
+                    if (4*(_n_used + _n_deleted + 1) > 3*_slots.size()) {
+                        size_t size = 16;
+                        while (size < 2*(_n_used + 1)) size *= 2;
+                        rehash(size);
+                    }
+                    const size_t mask = _slots.size() - 1;
+                    const size_t h = H{}(k);
+                    size_t i = h & mask;
+                    while (_slots[i].state == used) i = (i + 1) & mask;
+                    auto& s = _slots[i];
+                    if (s.state == deleted) --_n_deleted;
+                    s.key = k;
+                    s.v = v;
+                    s.h = h;
+                    s.state = used;
+                    push_back(_policy == cache_policy::two_q ? probation_list : protected_list, ix_t(i));
+                    ++_n_used;
+                }
+
+                size_t _capacity;///< Maximum number of key-value pairs to be retained
+                cache_policy _policy;///< the eviction policy
+                vector<slot> _slots;///< the hash table, size a power of 2, or empty
+                size_t _n_used{0};///< slots with items
+                size_t _n_deleted{0};///< erased slots, still part of probe sequences
+                link_list _lists[2];///< protected (the lru order with policy lru), and probation
+        };
+
         /** \brief mini_frag provides a container that minimizes the set of time-series fragments
          *
          *  The purpose of this class is to provide a container that keeps
@@ -239,12 +639,42 @@ namespace shyft {
 
             const ts_frag& get_by_ix(size_t i) const { return f[i]; }
 
+            /** \return the sub-periods of p not covered by any fragment, ordered by start */
+            vector<utcperiod> gaps(const utcperiod& p) const {
+                vector<utcperiod> r;
+                auto t = p.start;
+                auto i = lower_bound(begin(f), end(f), p.start, [](const ts_frag& x, utctime t) { return x.total_period().end <= t; });
+                for (; i != end(f) && t < p.end; ++i) {
+                    const auto fp = i->total_period();
+                    if (fp.start >= p.end)
+                        break;
+                    if (fp.start > t)
+                        r.emplace_back(t, fp.start);
+                    t = max(t, fp.end);
+                }
+                if (t < p.end)
+                    r.emplace_back(t, p.end);
+                return r;
+            }
+
+            /** \return a mini_frag with the fragments that overlaps p */
+            mini_frag overlapping(const utcperiod& p) const {
+                mini_frag r;
+                auto i = lower_bound(begin(f), end(f), p.start, [](const ts_frag& x, utctime t) { return x.total_period().end <= t; });
+                for (; i != end(f) && i->total_period().start < p.end; ++i)
+                    r.f.push_back(*i);
+                return r;
+            }
+
             /** return number of fragments */
             size_t count_fragments() const { return f.size(); }
 
             /**\return the accumulated .size() for all fragments, x8 ~ approx. bytes */
             size_t estimate_size() const { size_t s = 0; for (const auto&x:f) s += x.size(); return s; }
 
+            /**\return the accumulated .estimate_bytes() for all fragments, requires ts_frag to provide it */
+            size_t estimate_bytes() const { size_t s = 0; for (const auto&x:f) s += x.estimate_bytes(); return s; }
+
             /**\brief add a new fragment to the container
             *
             * ensures that the internal container remains ordered by .total_period().start
@@ -310,6 +740,18 @@ namespace shyft {
             /** the point size() of the underlying time-series */
             size_t size() const { return ats.size(); }
 
+            /** approx. bytes of the fragment, the values, the time-points if any, and the ts object itself */
+            size_t estimate_bytes() const {
+                auto pts = dynamic_pointer_cast<gpoint_ts>(ats.ts);
+                if (!pts)
+                    return sizeof(apoint_ts);
+                const size_t n = pts->rep.v.size();
+                size_t b = sizeof(gpoint_ts) + 2*sizeof(void*) + n*sizeof(double);// the ts, the shared_ptr control block, and the values
+                if (pts->rep.ta.gt == gta_t::POINT)
+                    b += n*sizeof(utctime);
+                return b;
+            }
+
             /** merge returns a NEW apoint_ts_frag
             *
             * Performs a ts_merge of this fragment (high priority) with the other
@@ -325,9 +767,11 @@ namespace shyft {
                 auto s_pts = dynamic_pointer_cast<gpoint_ts>(ats.ts);
                 auto o_pts = dynamic_pointer_cast<gpoint_ts>(o.ats.ts);
                 if (s_pts && o_pts) {
+                    auto m = ts::merge(s_pts->rep,o_pts->rep);
+                    m.ta = time_axis::intern(m.ta);// the fragments of equal series shares the points
                     return apoint_ts_frag{
                         apoint_ts(
-                            make_shared<gpoint_ts>(ts::merge(s_pts->rep,o_pts->rep))
+                            make_shared<gpoint_ts>(std::move(m))
                         )
                     };// move ct to shared
                 }
@@ -344,6 +788,9 @@ namespace shyft {
             size_t id_count{ 0 };///< current count of disticnt ts-ids in the cache
             size_t point_count{ 0 };///< current estimate of ts-points in the cache, one point ~8 bytes
             size_t fragment_count{ 0 };///< current count of ts-fragments, equal or larger than id_count
+            size_t byte_count{ 0 };///< current approx. bytes of the ts-fragments, ids and bookkeeping, ref. set_byte_capacity
+            size_t result_count{ 0 };///< current count of results in the expression result cache of the server
+            size_t result_byte_count{ 0 };///< current approx. bytes of the expression result cache of the server
         /** nice to have summary function */
             friend inline cache_stats operator + (cache_stats l, const cache_stats& r) {
                 l.hits += r.hits;
@@ -352,6 +799,9 @@ namespace shyft {
                 l.id_count += r.id_count;
                 l.point_count += r.point_count;
                 l.fragment_count += r.fragment_count;
+                l.byte_count += r.byte_count;
+                l.result_count += r.result_count;
+                l.result_byte_count += r.result_byte_count;
                 return l;
             }
 
@@ -374,8 +824,13 @@ namespace shyft {
          *
          * maintain by lru, - where the value-type (ts_frag) is maintained as a
          *                    minimal set of non-overlapping disjoint ts-fragments.
+         * or by the scan resistant two_q policy, ref. set_policy.
          *
-         * \sa lru_cache
+         * The ids are spread by hash over a number of shards, each a flat_lru_cache with its own mutex and stats,
+         * so threads working on different ids rarely wait for each other. The capacity is spread evenly over the shards,
+         * and the lru-order, and eviction, is per shard. The stats are the sum of the shards.
+         *
+         * \sa flat_lru_cache
          * \sa cache_stats
          * \sa apoints_ts_frag
          *
@@ -383,60 +838,261 @@ namespace shyft {
         template<class ts_frag, class ts_t>
         struct cache {
             using value_type = mini_frag<ts_frag>;
-            using internal_cache = lru_cache<string, value_type, unordered_map>;
+            using internal_cache = flat_lru_cache<string, value_type>;
+            static constexpr size_t max_shard_count = 16;///< default upper limit of shards
+            static constexpr size_t min_shard_capacity = 1024;///< default shard count keeps at least this many ids in each shard
+            /** the cached fragments of an id that partly covers a period, ref. get with partial */
+            struct partial_hit {
+                value_type frags;///< the fragments that overlaps the period
+                vector<utcperiod> gaps;///< the sub-periods not covered by frags, ordered by start
+            };
         private:
-            mutable mutex mx; ///< mutex to protect access to c and cs
-            internal_cache c;///< internal cache implementation
-            cache_stats cs;///< internal cache stats to collect misses/hits
-
-                           /** get one single item from cache, if exists, and matches period, record hits/misses */
-            bool internal_try_get(const string& id, const utcperiod& p, ts_t& ts) {
-                if (!c.item_exists(id)) {
-                    ++cs.misses;
-                    return false;
+            /** one lock-striped part of the cache */
+            struct shard {
+                mutable mutex mx; ///< mutex to protect access to c and cs
+                internal_cache c;///< internal cache implementation
+                cache_stats cs;///< internal cache stats to collect misses/hits
+                cache_stats policy_cs[cache_policy_count];///< hits/misses while each policy was active
+                size_t bytes{0};///< approx. bytes of the entries in c, ref. entry_bytes
+                size_t max_bytes{0};///< byte budget of the shard, 0 means no byte limit
+                explicit shard(size_t capacity) :c(capacity) {}
+
+                /** get one single item from cache, if exists, and matches period, record hits/misses,
+                 * on a coverage miss, if partial, set it to the fragments overlapping p, and the gaps of p, if any overlaps
+                 */
+                bool try_get(const string& id, const utcperiod& p, ts_t& ts, partial_hit* partial = nullptr) {
+                    auto& pcs = policy_cs[size_t(c.get_policy())];
+                    if (!c.item_exists(id)) {
+                        ++cs.misses; ++pcs.misses;
+                        return false;
+                    }
+                    ++cs.hits; ++pcs.hits;
+                    const auto& mf = c.get_item(id);
+                    size_t ix = mf.get_ix(p);
+                    if (ix==string::npos) {
+                        ++cs.coverage_misses; ++pcs.coverage_misses;
+                        if (partial) {
+                            auto g = mf.gaps(p);
+                            if (!(g.size() == 1 && g[0] == p)) {
+                                partial->gaps = std::move(g);
+                                partial->frags = mf.overlapping(p);
+                            }
+                        }
+                        return false;
+                    }
+                    ts = mf.get_by_ix(ix).ts();
+                    return true;
                 }
-                ++cs.hits;
-                const auto& mf = c.get_item(id);
-                size_t ix = mf.get_ix(p);
-                if (ix==string::npos) {
-                    ++cs.coverage_misses;
-                    return false;
+
+                /** approx. bytes of one entry, the id, the lru bookkeeping and the fragments */
+                static size_t entry_bytes(const string& id, const value_type& mf) {
+                    return 2*(sizeof(string) + id.size()) + 8*sizeof(void*) + mf.estimate_bytes();
                 }
-                ts = mf.get_by_ix(ix).ts();
-                return true;
+
+                /** evict in lru-order until at most id_max_count ids, and, if set, at most byte budget */
+                void evict_to(size_t id_max_count) {
+                    c.evict_while([this, id_max_count](const string& k, const value_type& v) {
+                        if (c.size() <= id_max_count && (max_bytes == 0 || bytes <= max_bytes))
+                            return false;
+                        bytes -= entry_bytes(k, v);
+                        return true;
+                    });
+                }
+
+                /** add one single item to cache, defrag if already there, an entry above the byte budget by itself is dropped */
+                void add(const string &id, const ts_t &ts) {
+                    if (!c.item_exists(id)) {
+                        value_type mf; mf.add(ts_frag{ ts });
+                        const size_t eb = entry_bytes(id, mf);
+                        if (max_bytes && eb > max_bytes)
+                            return;
+                        evict_to(c.get_capacity() - 1);// make room, keeping the byte count
+                        bytes += eb;
+                        c.add_item(id, mf);
+                    }
+                    else {
+                        auto&mf = c.get_item(id);
+                        bytes -= entry_bytes(id, mf);
+                        mf.add(ts_frag{ ts });
+                        const size_t eb = entry_bytes(id, mf);
+                        bytes += eb;
+                        if (max_bytes && eb > max_bytes) {
+                            remove(id);
+                            return;
+                        }
+                    }
+                    if (max_bytes && bytes > max_bytes)
+                        evict_to(c.get_capacity());// the just added entry is the most recently used, and fits, so it is kept
+                }
+
+                void remove(const string& id) {
+                    if (c.item_exists(id)) {
+                        bytes -= entry_bytes(id, c.get_item(id));
+                        c.remove_item(id);
+                    }
+                }
+
+                void flush() {
+                    c.flush();
+                    bytes = 0;
+                }
+
+                void set_capacity(size_t id_max_count) {
+                    evict_to(id_max_count);
+                    c.set_capacity(id_max_count);
+                }
+
+                void set_byte_capacity(size_t max_bytes_) {
+                    max_bytes = max_bytes_;
+                    evict_to(c.get_capacity());
+                }
+            };
+            vector<std::unique_ptr<shard>> shards;///< fixed at construction, so the shard of an id never changes
+            size_t capacity;///< the total capacity, as passed to set_capacity
+            size_t byte_capacity{0};///< the total byte budget, as passed to set_byte_capacity, 0 means no byte limit
+            mutable mutex capacity_mx;///< serialize set_capacity and set_byte_capacity, so the shards gets capacities of the same call
+
+            /** capacity of shard i of n, when the total is spread evenly, at least one */
+            static size_t shard_capacity(size_t total, size_t i, size_t n) {
+                return max(size_t(1), total/n + (i < total%n ? 1 : 0));
+            }
+
+            size_t shard_ix(const string& id) const {
+                size_t h = std::hash<string>{}(id);
+                return (h ^ (h >> 29)) % shards.size();// the shard uses the low bits of h for its own buckets
             }
+            shard& shard_of(const string& id) const { return *shards[shard_ix(id)]; }
 
-            /** add one single item to cache, defrag if already there */
-            void internal_add(const string &id, const ts_t &ts) {
-                if (!c.item_exists(id)) {
-                    value_type mf; mf.add(ts_frag{ ts });
-                    c.add_item(id, mf);
+            /** calls fx(shard, ix) once for each shard that has ids, with the shard locked, and ix the positions of its ids */
+            template<class Fx>
+            void for_each_shard_of(const vector<string>& ids, Fx&& fx) const {
+                if (shards.size() == 1) {
+                    vector<size_t> ix(ids.size());
+                    for (size_t i = 0; i < ix.size(); ++i) ix[i] = i;
+                    lock_guard<mutex> guard(shards[0]->mx);
+                    fx(*shards[0], ix);
+                    return;
                 }
-                else {
-                    auto&mf = c.get_item(id);
-                    mf.add(ts_frag{ ts });
+                vector<vector<size_t>> ix(shards.size());
+                for (size_t i = 0; i < ids.size(); ++i)
+                    ix[shard_ix(ids[i])].push_back(i);
+                for (size_t s = 0; s < shards.size(); ++s) {
+                    if (ix[s].empty())
+                        continue;
+                    lock_guard<mutex> guard(shards[s]->mx);
+                    fx(*shards[s], ix[s]);
                 }
             }
 
         public:
-            /** construct a cache with max ts-id count */
-            cache(size_t id_max_count) :c(id_max_count) {}
+            /** the default shard count for a capacity, one shard for small caches, keeping exact lru-order */
+            static size_t default_shard_count(size_t id_max_count) {
+                return max(size_t(1), min(size_t(max_shard_count), id_max_count/size_t(min_shard_capacity)));
+            }
+
+            /** construct a cache with max ts-id count, sharded by default_shard_count */
+            cache(size_t id_max_count) :cache(id_max_count, default_shard_count(id_max_count)) {}
+
+            /** construct a cache with max ts-id count spread over shard_count shards, required to be > 0 */
+            cache(size_t id_max_count, size_t shard_count) :capacity(id_max_count) {
+                if (shard_count == 0)
+                    throw runtime_error("cache shard count must be >0");
+                if (id_max_count == 0)
+                    throw runtime_error("cache capacity must be >0");
+                shards.reserve(shard_count);
+                for (size_t i = 0; i < shard_count; ++i)
+                    shards.emplace_back(new shard(shard_capacity(id_max_count, i, shard_count)));
+            }
+
+            size_t get_shard_count() const { return shards.size(); }
 
             /** \brief adjust the cache capacity
             *
-            * Set the capacity related to unique ts-ids to specified count.
-            * If adjusting down, elements are evicted from cache in lru-order.
+            * Set the capacity related to unique ts-ids to specified count, spread evenly over the shards.
+            * If adjusting down, elements are evicted from each shard in lru-order.
+            *
+            * \note each shard keeps at least one id, so a capacity less than the shard count is rounded up to it
             *
             * \param id_max_count the new maximium number of unique ts-ids to keep
             *
             */
             void set_capacity(size_t id_max_count) {
-                lock_guard<mutex> guard(mx);
-                c.set_capacity(id_max_count);
+                if (id_max_count == 0) throw runtime_error("cache capacity must be >0");
+                lock_guard<mutex> cguard(capacity_mx);
+                for (size_t i = 0; i < shards.size(); ++i) {
+                    lock_guard<mutex> guard(shards[i]->mx);
+                    shards[i]->set_capacity(shard_capacity(id_max_count, i, shards.size()));
+                }
+                capacity = id_max_count;
             }
             size_t get_capacity() const {
-                lock_guard<mutex> guard(mx);
-                return c.get_capacity();
+                lock_guard<mutex> cguard(capacity_mx);
+                return capacity;
+            }
+
+            /** \brief set a memory budget for the cache
+            *
+            * With a budget, the cache keeps an approx. byte count of each entry, the id, and for the fragments
+            * the values, the time-points of point time-axis, and the ts overhead, ref. ts_frag::estimate_bytes.
+            * When an add brings the count above the budget, entries are evicted in lru-order until it's met.
+            * An entry that alone exceeds the budget of its shard is not cached.
+            * The id capacity, ref. set_capacity, still applies, set it high to limit by bytes only.
+            * The budget is spread evenly over the shards.
+            *
+            * \note time-points shared by equal time-axis are counted for each of them
+            *
+            * \param max_bytes the new budget in bytes, 0 removes the byte limit
+            */
+            void set_byte_capacity(size_t max_bytes) {
+                lock_guard<mutex> cguard(capacity_mx);
+                for (size_t i = 0; i < shards.size(); ++i) {
+                    lock_guard<mutex> guard(shards[i]->mx);
+                    shards[i]->set_byte_capacity(max_bytes ? shard_capacity(max_bytes, i, shards.size()) : 0);
+                }
+                byte_capacity = max_bytes;
+            }
+            size_t get_byte_capacity() const {
+                lock_guard<mutex> cguard(capacity_mx);
+                return byte_capacity;
+            }
+
+            /** \brief set the eviction policy of all shards
+            *
+            * The cached items are kept, and the hits and misses from now on are also counted for the new policy,
+            * ref. get_policy_stats, so the hit-ratio of the policies can be compared on the same workload.
+            *
+            * \param policy lru, or the scan resistant two_q, ref. cache_policy
+            */
+            void set_policy(cache_policy policy) {
+                lock_guard<mutex> cguard(capacity_mx);
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    s->c.set_policy(policy);
+                }
+            }
+            cache_policy get_policy() const {
+                lock_guard<mutex> guard(shards[0]->mx);
+                return shards[0]->c.get_policy();
+            }
+
+            /** \return accumulated hits, misses and coverage_misses while policy was active, the other fields are 0 */
+            cache_stats get_policy_stats(cache_policy policy) const {
+                cache_stats r;
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    r = r + s->policy_cs[size_t(policy)];
+                }
+                return r;
+            }
+
+            /** \return the current approx. bytes of the cache entries, ref. set_byte_capacity */
+            size_t get_byte_count() const {
+                size_t r = 0;
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    r += s->bytes;
+                }
+                return r;
             }
 
             /** try get a ts that matches id and period.
@@ -449,13 +1105,15 @@ namespace shyft {
             * \return true if  found and matches period, with ts set to found ts-frag, otherwise false and untouched ts
             */
             bool try_get(const string& id, const utcperiod& p, ts_t& ts) {
-                lock_guard<mutex> guard(mx);
-                return internal_try_get(id, p, ts);
+                auto& s = shard_of(id);
+                lock_guard<mutex> guard(s.mx);
+                return s.try_get(id, p, ts);
             }
 
             /** \brief get out a list of ts by specified id and period from cache
              *
-             * thread-safe get out cache content by ts-id and period specification
+             * thread-safe get out cache content by ts-id and period specification,
+             * locking each shard once for its ids.
              *
              * \sa try_get
              *
@@ -464,14 +1122,42 @@ namespace shyft {
              * \return a map<string,ts_t> with the time-series from cache that matches the criteria
              */
             unordered_map<string, ts_t> get(const vector<string>& ids, const utcperiod& p) {
-                lock_guard<mutex> guard(mx);
                 unordered_map<string, ts_t> r;
-                for (const auto&id:ids) {
-                    ts_t x;
-                    if (internal_try_get(id, p, x)) {
-                        r[id] = x;
+                for_each_shard_of(ids, [&](shard& s, const vector<size_t>& ix) {
+                    for (auto i : ix) {
+                        ts_t x;
+                        if (s.try_get(ids[i], p, x)) {
+                            r[ids[i]] = x;
+                        }
                     }
-                }
+                });
+                return r;
+            }
+
+            /** \brief get out a list of ts by specified id and period from cache, and the parts of those partly covered
+             *
+             * As get, and in addition the ids that are in the cache with fragments that covers
+             * parts of p, are placed in partial with those fragments and the sub-periods that are missing,
+             * so the caller can read the gaps only, and stitch them into the fragments with .add.
+             *
+             * \param ids a vector of ts-ids to be fetched
+             * \param p specifies the period requirement
+             * \param partial receives id->partial_hit for ids not in the result, but partly covered by fragments in the cache
+             * \return a map<string,ts_t> with the time-series from cache that matches the criteria
+             */
+            unordered_map<string, ts_t> get(const vector<string>& ids, const utcperiod& p, unordered_map<string, partial_hit>& partial) {
+                unordered_map<string, ts_t> r;
+                for_each_shard_of(ids, [&](shard& s, const vector<size_t>& ix) {
+                    for (auto i : ix) {
+                        ts_t x;
+                        partial_hit h;
+                        if (s.try_get(ids[i], p, x, &h)) {
+                            r[ids[i]] = x;
+                        } else if (h.gaps.size()) {
+                            partial[ids[i]] = std::move(h);
+                        }
+                    }
+                });
                 return r;
             }
 
@@ -488,14 +1174,15 @@ namespace shyft {
              *
              */
             void add(const string &id, const ts_t &ts) {
-                lock_guard<mutex> guard(mx);
-                internal_add(id, ts);
+                auto& s = shard_of(id);
+                lock_guard<mutex> guard(s.mx);
+                s.add(id, ts);
             }
 
             /** \brief add a vector of time-series to cache
              *
              * Ensures size of ids and tss are equal, then iterate over the pairs
-             * and add/replace those items to cache in the ascending index order.
+             * and add/replace those items to cache in the ascending index order of each shard.
              *
              * \param ids a vector of valid time-series identifiers
              * \param tss a vector with time-series corresponding by position to ids
@@ -505,10 +1192,10 @@ namespace shyft {
             void add(const vector<string>& ids, const TSV& tss) {
                 if (ids.size()!=tss.size())
                     throw runtime_error("attempt to add mismatched size for ts-ids and ts to cache");
-                lock_guard<mutex> guard(mx);
-                for (size_t i = 0; i<ids.size(); ++i) {
-                    internal_add(ids[i], tss[i]);
-                }
+                for_each_shard_of(ids, [&](shard& s, const vector<size_t>& ix) {
+                    for (auto i : ix)
+                        s.add(ids[i], tss[i]);
+                });
             }
 
             /** remove a specified ts-id from cache
@@ -518,8 +1205,9 @@ namespace shyft {
              * \param id any valid time-series id
              */
             void remove(const string& id) {
-                lock_guard<mutex> guard(mx);
-                c.remove_item(id);
+                auto& s = shard_of(id);
+                lock_guard<mutex> guard(s.mx);
+                s.remove(id);
             }
 
             /** \brief remove specified ts-ids from cache
@@ -529,9 +1217,10 @@ namespace shyft {
              * \param ids a list of valid time-series id
              */
             void remove(const vector<string>& ids) {
-                lock_guard<mutex> guard(mx);
-                for (const auto& id:ids)
-                    c.remove_item(id);
+                for_each_shard_of(ids, [&](shard& s, const vector<size_t>& ix) {
+                    for (auto i : ix)
+                        s.remove(ids[i]);
+                });
             }
 
             /** \brief flushes the cache
@@ -541,30 +1230,104 @@ namespace shyft {
              * \note the accumulated cache-statistics is not cleared
              */
             void flush() {
-                lock_guard<mutex> guard(mx);
-				c.flush();
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    s->flush();
+                }
+            }
+
+            /** \brief the cached items, most recently used first
+             *
+             * The shards are interleaved, so the order is the lru order of the cache as a whole
+             * when the ids are spread evenly by the shards.
+             * Each shard is locked in turn, as with get_cache_stats.
+             * The fragments are copied, for ts_frag like apoint_ts_frag, that shares the series, it is cheap.
+             *
+             * \param max_ids max ids of the result, the most recently used, 0 means all
+             */
+            vector<pair<string, value_type>> get_mru_items(size_t max_ids = 0) const {
+                vector<vector<pair<string, value_type>>> mru(shards.size());
+                for (size_t i = 0; i < shards.size(); ++i) {
+                    lock_guard<mutex> guard(shards[i]->mx);
+                    shards[i]->c.apply_to_items_mru([&](const string& k, const value_type& v) {
+                        if (!max_ids || mru[i].size() < max_ids)
+                            mru[i].emplace_back(k, v);
+                    });
+                }
+                vector<pair<string, value_type>> r;
+                for (size_t rank = 0; ; ++rank) {
+                    bool any = false;
+                    for (auto& m : mru) {
+                        if (rank >= m.size())
+                            continue;
+                        any = true;
+                        if (max_ids && r.size() >= max_ids)
+                            return r;
+                        r.push_back(std::move(m[rank]));
+                    }
+                    if (!any)
+                        return r;
+                }
+            }
+
+            /** \brief the cached fragments of ids, without recording hits or misses, or changing the lru order
+             *
+             * For inspecting the cache, like the metadata of the cached series, ref. server::do_get_ts_info.
+             * \return id -> fragments, for the ids in the cache
+             */
+            unordered_map<string, value_type> peek(const vector<string>& ids) const {
+                unordered_map<string, value_type> r;
+                for_each_shard_of(ids, [&](const shard& s, const vector<size_t>& ix) {
+                    for (auto i : ix)
+                        if (auto v = s.c.peek_item(ids[i]))
+                            r[ids[i]] = *v;
+                });
+                return r;
+            }
+
+            /** \brief the hot set of the cache, the ids with the periods of their fragments, ordered as get_mru_items
+             *
+             * \param max_ids max ids of the result, the most recently used, 0 means all
+             * \return (id,period) for each fragment, the fragments of an id ordered by period
+             */
+            vector<pair<string, utcperiod>> get_hot_set(size_t max_ids = 0) const {
+                vector<pair<string, utcperiod>> r;
+                for (const auto& x : get_mru_items(max_ids))
+                    for (const auto& f : x.second.f)
+                        r.emplace_back(x.first, f.total_period());
+                return r;
             }
 
             /** Provide cache-statistics
+             *
+             * Each shard is locked in turn, so with concurrent updates the sum is not a snapshot of one instant.
              *
              * \return cache_stats with accumulated hits/misses as well as current id-count and point-count
              */
-            cache_stats get_cache_stats() {
-                lock_guard<mutex> guard(mx);
-                cache_stats r{ cs };
-				auto fx = [&r](const string&key,const value_type& ci )->void {
-					r.point_count += ci.estimate_size();
-					r.fragment_count += ci.count_fragments();
-					++r.id_count;
-				};
-				c.apply_to_items(fx);
+            cache_stats get_cache_stats() const {
+                cache_stats r;
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    r = r + s->cs;
+                    r.byte_count += s->bytes;
+                    auto fx = [&r](const string&key,const value_type& ci )->void {
+                        r.point_count += ci.estimate_size();
+                        r.fragment_count += ci.count_fragments();
+                        ++r.id_count;
+                    };
+                    s->c.apply_to_items(fx);
+                }
                 return r;
             }
 
-            /** clear accumulated cache-stats */
+            /** clear accumulated cache-stats, including the policy stats */
             void clear_cache_stats() {
-                lock_guard<mutex> guard(mx);
-                cs = cache_stats{};
+                for (auto& s : shards) {
+                    lock_guard<mutex> guard(s->mx);
+                    s->cs = cache_stats{};
+                    for (auto& pcs : s->policy_cs)
+                        pcs = cache_stats{};
+                }
             }
 
         };
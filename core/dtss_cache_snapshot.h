@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <functional>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include "core/time_series_dd.h"
+#include "dtss_msg_flat.h"
+#include "dtss_db.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::pair;
+
+        /** \brief binary snapshot of the series of a cache, written at shutdown, and read back at startup
+         *
+         * The snapshot keeps the fragments of each id, and the lru order, the least recently used first,
+         * so adding the entries in file order makes the most recently used the most recent again.
+         *   <snapshot> -> <magic> uint64_t <n> uint64_t <entry>[<n>]
+         *   <entry>    -> <id> string <fragments> FLAT_TS_VECTOR
+         * The fragments use the flat wire encoding, with compressed values, ref. write_flat_ts_vector,
+         * so a snapshot is read with one pass, without boost archives.
+         * It is read through a read-only memory map, where available, so the file is paged in as it is decoded.
+         *
+         * \note like the ts_db format, this assumes the writer and the reader share the byte order
+         */
+        constexpr std::uint64_t cache_snapshot_magic = 0x3130504e53435444ull;///< "DTCSNP01"
+
+        /** write the entries, (id,fragments) least recently used first, to file, replacing it as a whole */
+        inline void write_cache_snapshot(const string& file, const vector<pair<string, time_series::dd::ats_vector>>& entries) {
+            const string tmp = file + ".tmp";
+            {
+                std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                const std::uint64_t n = entries.size();
+                out.write((const char*)&cache_snapshot_magic, sizeof(cache_snapshot_magic));
+                out.write((const char*)&n, sizeof(n));
+                for (const auto& e : entries) {
+                    msg::write_string(e.first, out);
+                    msg::write_flat_ts_vector(e.second, out, true);
+                }
+                out.flush();
+                if (!out)
+                    throw std::runtime_error("dtss: failed to write cache snapshot " + tmp);
+            }
+            boost::filesystem::rename(tmp, file);
+        }
+
+        /** read-only stream over a block of memory */
+        struct memory_streambuf : std::streambuf {
+            memory_streambuf(const char* d, size_t sz) {
+                char* b = const_cast<char*>(d);// only read, the get area is never written
+                setg(b, b, b + sz);
+            }
+        };
+
+        /** \brief read the cache snapshot of in, calling fx(id,fragments) for each entry, in file order
+         * \return number of entries, throws if the snapshot is not valid
+         */
+        inline size_t read_cache_snapshot(std::istream& in, const std::function<void(const string&, const time_series::dd::ats_vector&)>& fx) {
+            auto fail = []() { throw std::runtime_error("dtss: invalid cache snapshot"); };
+            std::uint64_t magic{ 0 }, n{ 0 };
+            in.read((char*)&magic, sizeof(magic));
+            in.read((char*)&n, sizeof(n));
+            if (!in || magic != cache_snapshot_magic)
+                fail();
+            for (std::uint64_t i = 0; i < n; ++i) {
+                std::int32_t sz{ -1 };
+                in.read((char*)&sz, sizeof(sz));
+                if (!in || sz < 0)
+                    fail();
+                string id(size_t(sz), '\0');
+                in.read(&id[0], sz);
+                if (!in || msg::read_type(in) != message_type::FLAT_TS_VECTOR)
+                    fail();
+                fx(id, msg::read_flat_ts_vector(in));
+            }
+            return size_t(n);
+        }
+
+        /** \brief read the cache snapshot file, as read_cache_snapshot
+         * \return number of entries, 0 if there is no file
+         */
+        inline size_t read_cache_snapshot(const string& file, const std::function<void(const string&, const time_series::dd::ats_vector&)>& fx) {
+            if (!boost::filesystem::exists(file))
+                return 0;
+#ifndef _WIN32
+            mapped_file m(file);
+            if (m.d) {
+                memory_streambuf buf(m.d, m.sz);
+                std::istream in(&buf);
+                return read_cache_snapshot(in, fx);
+            }
+#endif
+            std::ifstream in(file, std::ios::binary);
+            if (!in)
+                throw std::runtime_error("dtss: failed to open cache snapshot " + file);
+            return read_cache_snapshot(in, fx);
+        }
+    }
+}
@@ -7,10 +7,12 @@
 #include <regex>
 #include <future>
 #include <utility>
+#include <sstream>
 
 #include "dtss_client.h"
 #include "dtss_url.h"
 #include "dtss_msg.h"
+#include "dtss_msg_flat.h"
 
 #include "core_serialization.h"
 #include "core_archive.h"
@@ -35,53 +37,232 @@ using shyft::time_series::dd::apoint_ts;
 using shyft::time_series::dd::aref_ts;
 using shyft::time_series::dd::gta_t;
 using shyft::time_series::dd::expression_compressor;
+using shyft::time_series::dd::compressed_ts_expression;
 using shyft::time_series::statistics_property;
 
 void srv_connection::open(int timeout_ms) {
+    wire_version = -1;// the server could be another version now
     io->open(host_port,max(timeout_ms,this->timeout_ms));
 }
 void srv_connection::close(int timeout_ms) {
+    wire_version = -1;
     io->close(max(timeout_ms,this->timeout_ms));
 }
 void srv_connection::reopen(int timeout_ms) {
+    wire_version = -1;
     io->open(host_port,max(timeout_ms,this->timeout_ms));
 }
 
 
-//--helper-class to enable autoconnect/close
+/** \return the compressed tsv, with the structurally equal nodes written once if dedup, ref. expression_compressor::compress_shared */
+static compressed_ts_expression compress_tsv(const ts_vector_t& tsv,bool dedup) {
+    return dedup?expression_compressor::compress_shared(tsv):expression_compressor::compress(tsv);
+}
+
+/** close io, ignoring errors, as it is dropped anyway */
+static void close_quietly(dlib::iosockstream& io, int timeout_ms) {
+    try {
+        io.close(timeout_ms);
+    } catch (...) {
+    }
+}
+
+unique_ptr<dlib::iosockstream> srv_connection_pool::acquire(bool& reused) {
+    vector<std::pair<unique_ptr<dlib::iosockstream>, clock_t::time_point>> dropped;// closed after the lock is released
+    {
+        std::lock_guard<std::mutex> guard(mx);
+        const auto now = clock_t::now();
+        while (idle.size()) {
+            auto e = std::move(idle.back());
+            idle.pop_back();
+            if (e.first->good() && now - e.second <= max_idle_time) {
+                reused = true;
+                return std::move(e.first);
+            }
+            dropped.push_back(std::move(e));
+        }
+    }
+    for (auto& e : dropped)
+        close_quietly(*e.first, timeout_ms);
+    reused = false;
+    auto io = make_unique<dlib::iosockstream>();
+    io->open(host_port, timeout_ms);
+    return io;
+}
+
+void srv_connection_pool::release(unique_ptr<dlib::iosockstream> io) {
+    if (io->good()) {
+        std::lock_guard<std::mutex> guard(mx);
+        if (idle.size() < max_idle) {
+            idle.emplace_back(std::move(io), clock_t::now());
+            return;
+        }
+    }
+    close_quietly(*io, timeout_ms);
+}
+
+void srv_connection_pool::clear() {
+    vector<std::pair<unique_ptr<dlib::iosockstream>, clock_t::time_point>> dropped;
+    {
+        std::lock_guard<std::mutex> guard(mx);
+        dropped.swap(idle);
+    }
+    for (auto& e : dropped)
+        close_quietly(*e.first, timeout_ms);
+}
+
+size_t srv_connection_pool::idle_count() const {
+    std::lock_guard<std::mutex> guard(mx);
+    return idle.size();
+}
+
+/** \return the flat wire version of the server at io, 0 if it does not know the WIRE_VERSION request */
+static std::uint32_t negotiate_wire_version(dlib::iosockstream& io) {
+    msg::write_type(message_type::WIRE_VERSION, io);
+    auto response_type = msg::read_type(io);
+    if (response_type == message_type::SERVER_EXCEPTION) {
+        msg::read_exception(io);// an older server, that replies with the boost archive only
+        return 0;
+    } else if (response_type == message_type::WIRE_VERSION) {
+        std::uint32_t version{0};
+        io.read((char*)&version, sizeof(version));
+        return version;
+    }
+    throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+}
+
+srv_pipeline::srv_pipeline(const string& host_port, int timeout_ms):io(make_unique<dlib::iosockstream>()) {
+    io->open(host_port, timeout_ms);
+    version = negotiate_wire_version(*io);
+    io_thread = std::thread([this]() { io_loop(); });
+}
+
+srv_pipeline::~srv_pipeline() {
+    {
+        std::lock_guard<std::mutex> guard(mx);
+        stopping = true;
+    }
+    cv.notify_all();
+    if(io_thread.joinable())
+        io_thread.join();
+}
+
+std::future<string> srv_pipeline::send(string request) {
+    std::promise<string> p;
+    auto f = p.get_future();
+    {
+        std::lock_guard<std::mutex> guard(mx);
+        if(failed) {
+            p.set_exception(std::make_exception_ptr(runtime_error("dtss: the pipelined connection failed")));
+            return f;
+        }
+        auto tag = next_tag++;
+        pending.emplace(tag, std::move(p));
+        queue.emplace_back(tag, std::move(request));
+    }
+    cv.notify_all();
+    return f;
+}
+
+bool srv_pipeline::broken() const {
+    std::lock_guard<std::mutex> guard(mx);
+    return failed;
+}
+
+void srv_pipeline::fail_all(std::exception_ptr e) {
+    std::unordered_map<std::uint64_t, std::promise<string>> p;
+    {
+        std::lock_guard<std::mutex> guard(mx);
+        failed = true;
+        queue.clear();
+        outstanding = 0;
+        p.swap(pending);
+    }
+    for(auto& x:p)
+        x.second.set_exception(e);
+}
+
+void srv_pipeline::io_loop() {
+    try {
+        for(;;) {
+            vector<std::pair<std::uint64_t, string>> batch;
+            {
+                std::unique_lock<std::mutex> lk(mx);
+                cv.wait(lk, [this]() { return outstanding > 0 || queue.size() || stopping; });
+                if(outstanding == 0 && queue.empty())
+                    break;// stopping, and all replied
+                while(queue.size() && outstanding < msg::max_tagged_in_flight) { // send before reading, but not more than the server handles
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                    ++outstanding;
+                }
+            }
+            if(batch.size()) {
+                for(const auto& b:batch)
+                    msg::write_tagged(b.first, b.second, *io);
+                io->flush();
+                if(!*io)
+                    throw runtime_error("dtss: failed to send pipelined request");
+                continue;
+            }
+            auto response_type = msg::read_type(*io);
+            if(!*io || response_type != message_type::TAGGED_REQUEST)
+                throw runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            std::uint64_t tag{0};
+            auto reply = msg::read_tagged(*io, tag);
+            std::promise<string> p;
+            {
+                std::lock_guard<std::mutex> guard(mx);
+                auto it = pending.find(tag);
+                if(it == pending.end())
+                    throw runtime_error("dtss: got reply to unknown request " + std::to_string(tag));
+                p = std::move(it->second);
+                pending.erase(it);
+                --outstanding;
+            }
+            p.set_value(std::move(reply));
+        }
+    } catch(...) {
+        fail_all(std::current_exception());
+    }
+    try {
+        io->close();
+    } catch(...) {
+    }
+}
+
+//--helper-class to enable autoconnect, leasing one connection pr. server from the pools of the client
 struct scoped_connect {
     client& c;
-    scoped_connect (client& c):c(c){
-        bool rethrow=false;
-        runtime_error rt_re("");
+    bool& stale; ///< set if the call failed on a reused connection, that could have been closed by the server while idle
+    bool reused{false};
+    vector<unique_ptr<dlib::iosockstream>> leased;
+    scoped_connect (client& c, bool& stale):c(c),stale(stale){
         if (c.auto_connect) {
-            for(auto&sc:c.srv_con) {
-                try {
-                    sc.open();
-                } catch(const runtime_error&re) {
-                    rt_re=re;
-                    rethrow=true;
-                }
+            leased.reserve(c.srv_pool.size());
+            for(auto&sp:c.srv_pool) {
+                bool r=false;
+                leased.push_back(sp->acquire(r));
+                reused = reused || r;
             }
-            if(rethrow)
-                throw rt_re;
         }
     }
-    ~scoped_connect() noexcept(false) {
-        if(c.auto_connect) {
-            bool rethrow=false;
-            runtime_error rt_re("");
-            for(auto&sc:c.srv_con) {
-                try {
-                    sc.close();
-                } catch(const exception& re) {
-                    rt_re=runtime_error(re.what());
-                    rethrow=true;
-                }
+    /** \return the connection to server i */
+    dlib::iosockstream& io(size_t i) {
+        return c.auto_connect ? *leased[i] : *(c.srv_con[i].io);
+    }
+    ~scoped_connect() {
+        if(!c.auto_connect)
+            return;
+        if(std::uncaught_exception()) { // the connections could be out of sync with the servers, so drop them
+            for(size_t i=0;i<leased.size();++i) {
+                stale = stale || (reused && !leased[i]->good());
+                close_quietly(*leased[i], c.srv_pool[i]->timeout_ms);
             }
-            if(rethrow)
-                throw rt_re;
+            return;
         }
+        for(size_t i=0;i<leased.size();++i)
+            c.srv_pool[i]->release(std::move(leased[i]));
     }
     scoped_connect (const scoped_connect&) = delete;
     scoped_connect ( scoped_connect&&) = delete;
@@ -90,10 +271,30 @@ struct scoped_connect {
     scoped_connect& operator=(scoped_connect&&)=delete;
 };
 
+/** run f(scoped_connect&), retrying once on new connections if it failed on a reused connection */
+template <class F>
+static auto with_connect(client& c, F&& f) -> decltype(f(std::declval<scoped_connect&>())) {
+    for (int attempt=0;;++attempt) {
+        bool stale=false;
+        try {
+            scoped_connect ac(c,stale);
+            return f(ac);
+        } catch (...) {
+            if (!stale || attempt>0)
+                throw;
+            for(auto&sp:c.srv_pool) // likely a server restart, so the other idle connections are stale as well
+                sp->clear();
+            for(auto&sc:c.srv_con) // and the server could be another version
+                sc.wire_version=-1;
+        }
+    }
+}
+
 client::client ( const string& host_port, bool auto_connect, int timeout_ms )
     :auto_connect(auto_connect)
 {
     srv_con.push_back(srv_connection{make_unique<dlib::iosockstream>(),host_port,timeout_ms});
+    srv_pool.push_back(make_unique<srv_connection_pool>(host_port,timeout_ms));
     if(!auto_connect)
         srv_con[0].open();
 }
@@ -103,6 +304,7 @@ client::client(const vector<string>& host_ports,bool auto_connect,int timeout_ms
         throw runtime_error("host_ports must contain at least one element");
     for(const auto &hp:host_ports) {
         srv_con.push_back(srv_connection{make_unique<dlib::iosockstream>(),hp,timeout_ms});
+        srv_pool.push_back(make_unique<srv_connection_pool>(hp,timeout_ms));
     }
     if(!auto_connect)
         reopen(timeout_ms);
@@ -113,7 +315,23 @@ void client::reopen(int timeout_ms) {
         sc.reopen(timeout_ms);
 }
 
+std::shared_ptr<srv_pipeline> client::next_pipeline() {
+    std::lock_guard<std::mutex> guard(srv_pipe_mx);
+    if(srv_pipe.size()!=srv_con.size())
+        srv_pipe.resize(srv_con.size());
+    auto i = next_pipe++ % srv_con.size();
+    if(!srv_pipe[i] || srv_pipe[i]->broken())
+        srv_pipe[i] = std::make_shared<srv_pipeline>(srv_con[i].host_port,srv_con[i].timeout_ms);
+    return srv_pipe[i];
+}
+
 void client::close(int timeout_ms) {
+    for(auto&sp:srv_pool)
+        sp->clear();
+    {
+        std::lock_guard<std::mutex> guard(srv_pipe_mx);
+        srv_pipe.clear();// waits for the replies in flight
+    }
     bool rethrow = false;
     runtime_error rt_re("");
     for(auto&sc:srv_con) {
@@ -138,30 +356,31 @@ client::percentiles(ts_vector_t const& tsv, utcperiod p, gta_t const&ta, const v
         throw std::runtime_error("percentiles require a valid period-specification");
     if (ta.size() == 0)
         throw std::runtime_error("percentile function require a time-axis with more than 0 steps");
-    scoped_connect ac(*this);
 
     if(srv_con.size()==1) {
-        dlib::iosockstream& io = *(srv_con[0].io);
-        msg::write_type(compress_expressions?message_type::EVALUATE_EXPRESSION_PERCENTILES:message_type::EVALUATE_TS_VECTOR_PERCENTILES, io);
-        core_oarchive oa(io,core_arch_flags);
-        oa << p;
-        if (compress_expressions) {
-            oa<< expression_compressor::compress(tsv);
-        } else {
-            oa<< tsv;
-        }
-        oa<< ta << percentile_spec<<use_ts_cached_read<<update_ts_cache;
-        auto response_type = msg::read_type(io);
-        if (response_type == message_type::SERVER_EXCEPTION) {
-            auto re = msg::read_exception(io);
-            throw re;
-        } else if (response_type == message_type::EVALUATE_TS_VECTOR_PERCENTILES) {
-            ts_vector_t r;
-            core_iarchive ia(io,core_arch_flags);
-            ia >> r;
-            return r;
-        }
-        throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+        return with_connect(*this,[&](scoped_connect& ac) -> vector<apoint_ts> {
+            dlib::iosockstream& io = ac.io(0);
+            msg::write_type(compress_expressions?message_type::EVALUATE_EXPRESSION_PERCENTILES:message_type::EVALUATE_TS_VECTOR_PERCENTILES, io);
+            core_oarchive oa(io,core_arch_flags);
+            oa << p;
+            if (compress_expressions) {
+                oa<< compress_tsv(tsv,dedup_expressions);
+            } else {
+                oa<< tsv;
+            }
+            oa<< ta << percentile_spec<<use_ts_cached_read<<update_ts_cache;
+            auto response_type = msg::read_type(io);
+            if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else if (response_type == message_type::EVALUATE_TS_VECTOR_PERCENTILES) {
+                ts_vector_t r;
+                core_iarchive ia(io,core_arch_flags);
+                ia >> r;
+                return r;
+            }
+            throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+        });
     } else {
         vector<int> p_spec;
         bool can_do_server_side_average=true; // in case we are searching for min-max extreme, we can not do server-side average
@@ -175,187 +394,643 @@ client::percentiles(ts_vector_t const& tsv, utcperiod p, gta_t const&ta, const v
     }
 }
 
+/** \return true if the server of sc replies flat, negotiated on io on the first call */
+static bool server_replies_flat(srv_connection& sc, dlib::iosockstream& io) {
+    if (sc.wire_version < 0)
+        sc.wire_version = int(negotiate_wire_version(io));
+    return sc.wire_version >= int(msg::wire_version_flat);
+}
+
+/** write the WIRE_OPTIONS of the next request to a server of wire_version, if it handles them, and any are set */
+static void write_wire_options(std::ostream& out,bool compress_replies,int wire_version) {
+    if(!compress_replies || wire_version < int(msg::wire_version_options))
+        return;
+    msg::write_type(message_type::WIRE_OPTIONS, out);
+    const std::uint32_t options = msg::wire_compress_values;
+    out.write((const char*)&options, sizeof(options));
+}
+
+/** write the evaluate request of tsv to out, asking for a FLAT_TS_VECTOR reply if flat */
+static void write_evaluate_request(std::ostream& out,const ts_vector_t& tsv,const utcperiod& p,bool compress_expressions,bool dedup,bool use_ts_cached_read,bool update_ts_cache,bool flat) {
+    if(flat)
+        msg::write_type(message_type::EVALUATE_FLAT, out);
+    msg::write_type(compress_expressions?message_type::EVALUATE_EXPRESSION:message_type::EVALUATE_TS_VECTOR, out);
+    core_oarchive oa(out,core_arch_flags);
+    oa << p ;
+    if(compress_expressions) { // notice that we stream out all in once here
+        // .. just in case the destruction of the compressed expr take time (it could..)
+        oa<< compress_tsv(tsv,dedup)<<use_ts_cached_read<<update_ts_cache;
+    } else {
+        oa<< tsv<<use_ts_cached_read<<update_ts_cache;
+    }
+}
+
+/** \return the evaluated ts-vector of the reply read from in, throws the server exception */
+static ts_vector_t read_evaluate_reply(std::istream& in) {
+    auto response_type = msg::read_type(in);
+    if (response_type == message_type::SERVER_EXCEPTION) {
+        auto re = msg::read_exception(in);
+        throw re;
+    } else if (response_type == message_type::FLAT_TS_VECTOR) {
+        return msg::read_flat_ts_vector(in);
+    } else if (response_type == message_type::EVALUATE_TS_VECTOR) {
+        ts_vector_t r; {
+            core_iarchive ia(in,core_arch_flags);
+            ia >> r;
+        }
+        return r;
+    }
+    throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+}
+
+double estimated_cost(const apoint_ts& ts) {
+    if(!ts.ts)
+        return 1.0;
+    return 1.0 + double(ts.find_ts_bind_info().size());
+}
+
+vector<vector<size_t>> partition_by_cost(const vector<double>& cost, size_t n) {
+    return partition_by_cost(cost,n,vector<vector<size_t>>{});
+}
+
+vector<vector<size_t>> partition_by_cost(const vector<double>& cost, size_t n, const vector<vector<size_t>>& candidates) {
+    vector<vector<size_t>> r(n);
+    if(n==0)
+        return r;
+    vector<size_t> order(cost.size());
+    for(size_t i=0;i<order.size();++i) order[i]=i;
+    std::stable_sort(order.begin(),order.end(),[&cost](size_t a,size_t b) {return cost[a]>cost[b];});
+    vector<double> load(n,0.0);
+    for(auto i:order) { // most costly first, to the least loaded
+        size_t k = size_t(std::min_element(load.begin(),load.end())-load.begin());
+        if(i<candidates.size() && candidates[i].size()) {
+            k = candidates[i].front();
+            for(auto c:candidates[i])
+                if(load[c]<load[k]) k=c;
+        }
+        r[k].push_back(i);
+        load[k]+=cost[i];
+    }
+    for(auto& x:r)
+        std::sort(x.begin(),x.end());
+    return r;
+}
+
 std::vector<apoint_ts>
 client::evaluate(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
     if (tsv.size() == 0)
         throw std::runtime_error("evaluate requires a source ts-vector with more than 0 time-series");
     if (!p.valid())
         throw std::runtime_error("percentiles require a valid period-specification");
-    scoped_connect ac(*this);
     // local lambda to ensure one definition of communication with the server
-    auto eval_io = [this] (dlib::iosockstream&io,const ts_vector_t& tsv,const utcperiod& p,bool use_ts_cached_read,bool update_ts_cache) {
-            msg::write_type(compress_expressions?message_type::EVALUATE_EXPRESSION:message_type::EVALUATE_TS_VECTOR, io); {
+    auto eval_io = [this] (dlib::iosockstream&io,srv_connection& sc,const ts_vector_t& tsv,const utcperiod& p,bool use_ts_cached_read,bool update_ts_cache) {
+        const bool flat = flat_replies && server_replies_flat(sc,io);
+        if(flat)
+            write_wire_options(io,compress_replies,sc.wire_version);
+        write_evaluate_request(io,tsv,p,compress_expressions,dedup_expressions,use_ts_cached_read,update_ts_cache,flat);
+        return read_evaluate_reply(io);
+    };
+
+    return with_connect(*this,[&](scoped_connect& ac) -> vector<apoint_ts> {
+        if(srv_con.size()==1 || (tsv.size() == 1 && !cluster_replication)) { // one server, or just one ts, do it easy
+            dlib::iosockstream& io = ac.io(0);
+            if(srv_con.size()==1 && validated_cache.get_capacity() && flat_replies && server_replies_flat(srv_con[0],io)
+               && srv_con[0].wire_version >= int(msg::wire_version_validated))
+                return evaluate_validated(io,srv_con[0],tsv,p,use_ts_cached_read,update_ts_cache);
+            return eval_io(io,srv_con[0],tsv,p,use_ts_cached_read,update_ts_cache);
+        } else {
+            ts_vector_t rt(tsv.size()); // make place for the result contributions from threads
+            vector<double> cost;cost.reserve(tsv.size());
+            for(const auto& ts:tsv)
+                cost.push_back(estimated_cost(ts));
+            auto parts = cluster_replication ? partition_by_cost(cost,srv_con.size(),cluster_candidates(tsv)) : partition_by_cost(cost,srv_con.size());
+            // lamda to eval partition on server, placing the results in the order of tsv
+            auto eval_partition= [&rt,&tsv,&eval_io,p,use_ts_cached_read,update_ts_cache]
+                (dlib::iosockstream& io,srv_connection& sc,const vector<size_t>& ix) {
+                    ts_vector_t ptsv;ptsv.reserve(ix.size());
+                    for(auto i:ix) ptsv.push_back(tsv[i]);
+                    auto pt = eval_io(io,sc,ptsv,p,use_ts_cached_read,update_ts_cache);
+                    if(pt.size()!=ix.size())
+                        throw std::runtime_error("evaluate: server returned "+std::to_string(pt.size())+" time-series, expected "+std::to_string(ix.size()));
+                    for(size_t i=0;i<pt.size();++i)
+                        rt[ix[i]]=pt[i];
+            };
+            vector<future<void>> calcs;
+            for(size_t i=0;i<srv_con.size();++i) {
+                if(parts[i].empty())
+                    continue;// more servers than series
+                calcs.push_back(std::async(
+                                std::launch::async,
+                                [this,&ac,i,&parts,&eval_partition] () {
+                                    eval_partition (ac.io(i),srv_con[i],parts[i]);
+                                }
+                               )
+                      );
+            }
+            for (auto &f : calcs)
+                f.get();
+
+            return rt;
+        }
+    });
+}
+
+/** \return the validated cache key of the unbound expression ts for p, and the read flags */
+static string validated_key(utcperiod p, const apoint_ts& ts, bool use_ts_cached_read, bool update_ts_cache) {
+    std::ostringstream os;
+    os.write((const char*)&p.start, sizeof(p.start));
+    os.write((const char*)&p.end, sizeof(p.end));
+    const char flags = char((use_ts_cached_read ? 1 : 0) | (update_ts_cache ? 2 : 0));
+    os.write(&flags, 1);
+    core_oarchive oa(os, core_arch_flags);
+    oa << ts;
+    return os.str();
+}
+
+/** \return a copy of the values of the evaluated ts, so the cached results are not shared with the caller */
+static apoint_ts copy_of(const apoint_ts& ts) {
+    return ts.ts ? apoint_ts(ts.time_axis(), ts.values(), ts.point_interpretation()) : ts;
+}
+
+vector<apoint_ts>
+client::evaluate_validated(dlib::iosockstream& io, srv_connection& sc, ts_vector_t const& tsv, utcperiod p, bool use_ts_cached_read, bool update_ts_cache) {
+    const std::uint64_t n = tsv.size();
+    vector<string> keys(n);
+    vector<std::uint64_t> version(n, 0);
+    ts_vector_t r(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!tsv[i].ts)
+            continue;
+        keys[i] = validated_key(p, tsv[i], use_ts_cached_read, update_ts_cache);
+        version[i] = validated_cache.get(keys[i], r[i]);
+    }
+    write_wire_options(io, compress_replies, sc.wire_version);
+    msg::write_type(message_type::EVALUATE_VALIDATED, io);
+    io.write((const char*)&n, sizeof(n));
+    io.write((const char*)version.data(), sizeof(std::uint64_t)*n);
+    write_evaluate_request(io, tsv, p, compress_expressions, dedup_expressions, use_ts_cached_read, update_ts_cache, false);
+    auto response_type = msg::read_type(io);
+    if (response_type == message_type::SERVER_EXCEPTION) {
+        auto re = msg::read_exception(io);
+        throw re;
+    } else if (response_type != message_type::EVALUATE_VALIDATED) {
+        throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    }
+    std::uint64_t rn{0}, m{0};
+    io.read((char*)&rn, sizeof(rn));
+    if (rn != n)
+        throw std::runtime_error("evaluate: got " + std::to_string(rn) + " versions for " + std::to_string(n) + " series");
+    io.read((char*)version.data(), sizeof(std::uint64_t)*n);
+    io.read((char*)&m, sizeof(m));
+    vector<std::uint64_t> ix(m);
+    io.read((char*)ix.data(), sizeof(std::uint64_t)*m);
+    auto modified = read_evaluate_reply(io);
+    if (modified.size() != m)
+        throw std::runtime_error("evaluate: got " + std::to_string(modified.size()) + " series for " + std::to_string(m) + " modified");
+    vector<bool> is_modified(n, false);
+    for (size_t j = 0; j < m; ++j) {
+        const auto i = ix[j];
+        if (i >= n)
+            throw std::runtime_error("evaluate: got modified series index out of range");
+        is_modified[i] = true;
+        if (keys[i].size())
+            validated_cache.add(keys[i], version[i], copy_of(modified[j]));
+        r[i] = std::move(modified[j]);
+    }
+    for (size_t i = 0; i < n; ++i)
+        if (!is_modified[i])
+            r[i] = copy_of(r[i]);
+    validated_cache.count(n, n - m);
+    return r;
+}
+
+std::vector<apoint_ts>
+client::aggregates(ts_vector_t const& tsv, utcperiod p, gta_t const&ta, const vector<int64_t>& aggregate_spec, const vector<double>& weights, const vector<double>& bins,bool use_ts_cached_read,bool update_ts_cache) {
+    if (tsv.size() == 0)
+        throw std::runtime_error("aggregates requires a source ts-vector with more than 0 time-series");
+    if (!p.valid())
+        throw std::runtime_error("aggregates require a valid period-specification");
+    if (ta.size() == 0)
+        throw std::runtime_error("aggregates require a time-axis with more than 0 steps");
+    vector<int> a_spec;for(const auto a:aggregate_spec) a_spec.push_back(int(a));
+    if(srv_con.size()==1) {
+        auto r = with_connect(*this,[&](scoped_connect& ac) -> vector<apoint_ts> {
+            dlib::iosockstream& io = ac.io(0);
+            if(!server_replies_flat(srv_con[0],io) || srv_con[0].wire_version < int(msg::wire_version_aggregate))
+                return vector<apoint_ts>{};// an older server, aggregated below
+            write_wire_options(io,compress_replies,srv_con[0].wire_version);
+            msg::write_type(compress_expressions?message_type::EVALUATE_EXPRESSION_AGGREGATE:message_type::EVALUATE_TS_VECTOR_AGGREGATE, io);
             core_oarchive oa(io,core_arch_flags);
-            oa << p ;
-            if(compress_expressions) { // notice that we stream out all in once here
-                // .. just in case the destruction of the compressed expr take time (it could..)
-                oa<< expression_compressor::compress(tsv)<<use_ts_cached_read<<update_ts_cache;
+            oa << p;
+            if (compress_expressions) {
+                oa<< compress_tsv(tsv,dedup_expressions);
+            } else {
+                oa<< tsv;
+            }
+            oa<< ta << aggregate_spec << weights << bins << use_ts_cached_read<<update_ts_cache;
+            return read_evaluate_reply(io);
+        });
+        if(r.size())
+            return r;
+    }
+    auto atsv = evaluate(tsv.average(ta),p,use_ts_cached_read,update_ts_cache); // averaged by the servers, then aggregated here
+    return shyft::time_series::dd::aggregates(atsv, ta, a_spec, weights, bins);
+}
+
+std::future<vector<apoint_ts>>
+client::evaluate_async(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache) {
+    if (tsv.size() == 0)
+        throw std::runtime_error("evaluate requires a source ts-vector with more than 0 time-series");
+    if (!p.valid())
+        throw std::runtime_error("percentiles require a valid period-specification");
+    auto pipe = next_pipeline();
+    std::ostringstream request;
+    const bool flat = flat_replies && pipe->wire_version()>=msg::wire_version_flat;
+    if(flat)
+        write_wire_options(request,compress_replies,int(pipe->wire_version()));
+    write_evaluate_request(request,tsv,p,compress_expressions,dedup_expressions,use_ts_cached_read,update_ts_cache,flat);
+    auto reply = pipe->send(request.str());
+    return std::async(std::launch::deferred, [reply{std::move(reply)}]() mutable -> vector<apoint_ts> {
+        std::istringstream in(reply.get());
+        return read_evaluate_reply(in);
+    });
+}
+
+void
+client::evaluate_stream(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache,size_t chunk_size,const std::function<void(size_t,ts_vector_t&&)>& fx) {
+    if (tsv.size() == 0)
+        throw std::runtime_error("evaluate requires a source ts-vector with more than 0 time-series");
+    if (!p.valid())
+        throw std::runtime_error("evaluate_stream requires a valid period-specification");
+    chunk_size = max(size_t(1), chunk_size);
+    size_t i0 = 0;// series passed to fx
+    with_connect(*this,[&](scoped_connect& ac) {
+        if (i0)
+            throw std::runtime_error("evaluate_stream: connection lost after " + std::to_string(i0) + " series");// not retried, fx got them
+        dlib::iosockstream& io = ac.io(0);
+        const bool flat = flat_replies && server_replies_flat(srv_con[0], io);
+        if (!flat || srv_con[0].wire_version < int(msg::wire_version_stream)) {
+            if (flat)
+                write_wire_options(io,compress_replies,srv_con[0].wire_version);
+            write_evaluate_request(io,tsv,p,compress_expressions,dedup_expressions,use_ts_cached_read,update_ts_cache,flat);
+            auto r = read_evaluate_reply(io);
+            for (; i0 < r.size(); i0 += chunk_size) {
+                ts_vector_t c;
+                for (size_t i = i0; i < std::min(r.size(), i0 + chunk_size); ++i)
+                    c.push_back(std::move(r[i]));
+                fx(i0, std::move(c));
+            }
+            return;
+        }
+        write_wire_options(io,compress_replies,srv_con[0].wire_version);
+        msg::write_type(message_type::EVALUATE_STREAM, io);
+        const std::uint64_t cs = chunk_size;
+        io.write((const char*)&cs, sizeof(cs));
+        write_evaluate_request(io,tsv,p,compress_expressions,dedup_expressions,use_ts_cached_read,update_ts_cache,false);
+        for (;;) {
+            auto response_type = msg::read_type(io);
+            if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else if (response_type == message_type::FLAT_TS_VECTOR) {
+                auto c = msg::read_flat_ts_vector(io);
+                const size_t n = c.size();
+                fx(i0, std::move(c));
+                i0 += n;
+            } else if (response_type == message_type::STREAM_END) {
+                std::uint64_t n{0};
+                io.read((char*)&n, sizeof(n));
+                if (n != i0 || n != tsv.size())
+                    throw std::runtime_error("evaluate_stream: got " + std::to_string(i0) + " of " + std::to_string(tsv.size()) + " series");
+                return;
             } else {
-                oa<< tsv<<use_ts_cached_read<<update_ts_cache;
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
             }
         }
+    });
+}
+
+/** throws unless the server of sc handles subscriptions */
+static void require_subscriptions(srv_connection& sc, dlib::iosockstream& io) {
+    if (!server_replies_flat(sc, io) || sc.wire_version < int(msg::wire_version_subscribe))
+        throw std::runtime_error("dtss: the server does not support subscriptions");
+}
+
+std::uint64_t
+client::subscribe(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache,ts_vector_t& initial) {
+    if (tsv.size() == 0)
+        throw std::runtime_error("subscribe requires a source ts-vector with more than 0 time-series");
+    if (!p.valid())
+        throw std::runtime_error("subscribe requires a valid period-specification");
+    return with_connect(*this,[&](scoped_connect& ac) -> std::uint64_t {
+        dlib::iosockstream& io = ac.io(0);
+        require_subscriptions(srv_con[0], io);
+        write_wire_options(io,compress_replies,srv_con[0].wire_version);
+        msg::write_type(message_type::SUBSCRIBE, io);
+        write_evaluate_request(io,tsv,p,compress_expressions,dedup_expressions,use_ts_cached_read,update_ts_cache,false);
         auto response_type = msg::read_type(io);
         if (response_type == message_type::SERVER_EXCEPTION) {
             auto re = msg::read_exception(io);
             throw re;
-        } else if (response_type == message_type::EVALUATE_TS_VECTOR) {
-            ts_vector_t r; {
-                core_iarchive ia(io,core_arch_flags);
-                ia >> r;
-            }
-            return r;
+        } else if (response_type != message_type::SUBSCRIBE) {
+            throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
         }
-        throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
-    };
+        std::uint64_t sid{0};
+        io.read((char*)&sid, sizeof(sid));
+        initial = read_evaluate_reply(io);
+        return sid;
+    });
+}
 
-    if(srv_con.size()==1 || tsv.size() == 1) { // one server, or just one ts, do it easy
-        dlib::iosockstream& io = *(srv_con[0].io);
-        return eval_io(io,tsv,p,use_ts_cached_read,update_ts_cache);
-    } else {
-        ts_vector_t rt(tsv.size()); // make place for the result contributions from threads
-        // lamda to eval partition on server
-        auto eval_partition= [&rt,&tsv,&eval_io,p,use_ts_cached_read,update_ts_cache]
-            (dlib::iosockstream& io,size_t i0, size_t n) {
-                ts_vector_t ptsv;ptsv.reserve(tsv.size());
-                for(size_t i=i0;i<i0+n;++i) ptsv.push_back(tsv[i]);
-                auto pt = eval_io(io,ptsv,p,use_ts_cached_read,update_ts_cache);
-                for(size_t i=0;i<pt.size();++i)
-                    rt[i0+i]=pt[i];
-        };
-        size_t partition_size = 1+tsv.size()/srv_con.size();// if tsv.size() < srv_con.size() ->
-        vector<future<void>> calcs;
-        for(size_t i=0;i<srv_con.size();++i) {
-            size_t i0= i*partition_size;
-            size_t n = min(partition_size,tsv.size()-i0);
-            calcs.push_back(std::async(
-                            std::launch::async,
-                            [this,i,i0,n,&eval_partition] () {
-                                eval_partition (*(srv_con[i].io),i0,n);
-                            }
-                           )
-                  );
+vector<size_t>
+client::read_subscription(std::uint64_t sid, std::chrono::milliseconds max_wait, ts_vector_t& changed) {
+    return with_connect(*this,[&](scoped_connect& ac) -> vector<size_t> {
+        dlib::iosockstream& io = ac.io(0);
+        require_subscriptions(srv_con[0], io);
+        write_wire_options(io,compress_replies,srv_con[0].wire_version);
+        msg::write_type(message_type::READ_SUBSCRIPTION, io);
+        const std::uint64_t w = std::uint64_t(std::max<std::int64_t>(0, max_wait.count()));
+        io.write((const char*)&sid, sizeof(sid));
+        io.write((const char*)&w, sizeof(w));
+        auto response_type = msg::read_type(io);
+        if (response_type == message_type::SERVER_EXCEPTION) {
+            auto re = msg::read_exception(io);
+            throw re;
+        } else if (response_type != message_type::SUBSCRIPTION_CHANGES) {
+            throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
         }
-        for (auto &f : calcs)
-            f.get();
-
-        return rt;
-    }
+        std::uint64_t n{0};
+        io.read((char*)&n, sizeof(n));
+        vector<std::uint64_t> ix(n);
+        io.read((char*)ix.data(), sizeof(std::uint64_t)*n);
+        changed = read_evaluate_reply(io);
+        if (changed.size() != n)
+            throw std::runtime_error("read_subscription: got " + std::to_string(changed.size()) + " series for " + std::to_string(n) + " changes");
+        return vector<size_t>(ix.begin(), ix.end());
+    });
 }
 
 void
-client::store_ts(const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) {
-    if (tsv.size() == 0)
-        return; //trivial and considered valid case
-                // verify that each member of tsv is a gpoint_ts
+client::unsubscribe(std::uint64_t sid) {
+    with_connect(*this,[&](scoped_connect& ac) {
+        dlib::iosockstream& io = ac.io(0);
+        require_subscriptions(srv_con[0], io);
+        msg::write_type(message_type::UNSUBSCRIBE, io);
+        io.write((const char*)&sid, sizeof(sid));
+        auto response_type = msg::read_type(io);
+        if (response_type == message_type::SERVER_EXCEPTION) {
+            auto re = msg::read_exception(io);
+            throw re;
+        } else if (response_type == message_type::UNSUBSCRIBE) {
+            return;
+        }
+        throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    });
+}
+
+/** check that tsv are bound series with ts-url references, as required to store them */
+static void require_store_refs(const ts_vector_t &tsv) {
     for (auto const &ats : tsv) {
         auto rts = dynamic_cast<aref_ts*>(ats.ts.get());
         if (!rts) throw std::runtime_error(std::string("attempt to store a null ts"));
         if (rts->needs_bind()) throw std::runtime_error(std::string("attempt to store unbound ts:") + rts->id);
     }
-    scoped_connect ac(*this);
-    dlib::iosockstream& io = *(srv_con[0].io);
-    msg::write_type(message_type::STORE_TS, io);
+}
+
+/** write the store request of type, STORE_TS, REPLICATE_TS or MERGE_STORE_TS without overwrite_on_write, and read its reply */
+static void store_io(dlib::iosockstream& io, message_type type, const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) {
+    msg::write_type(type, io);
     {
         core_oarchive oa(io,core_arch_flags);
-        oa << tsv << overwrite_on_write << cache_on_write;
+        if (type == message_type::MERGE_STORE_TS)
+            oa << tsv << cache_on_write;
+        else
+            oa << tsv << overwrite_on_write << cache_on_write;
     }
     auto response_type = msg::read_type(io);
     if (response_type == message_type::SERVER_EXCEPTION) {
         auto re = msg::read_exception(io);
         throw re;
-    } else if (response_type == message_type::STORE_TS) {
+    } else if (response_type == type) {
         return;
     }
     throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
 }
 
-void
-client::merge_store_ts(const ts_vector_t &tsv,bool cache_on_write) {
+void client::set_cluster(size_t replication) {
+    cluster_replication = replication;
+    cluster_ring = replication ? hash_ring(srv_con.size()) : hash_ring();
+}
+
+vector<vector<size_t>> client::cluster_candidates(const ts_vector_t& tsv) const {
+    vector<vector<size_t>> r(tsv.size());
+    for (size_t i = 0; i < tsv.size(); ++i) {
+        if (!tsv[i].ts)
+            continue;
+        bool first = true;
+        for (const auto& bi : tsv[i].find_ts_bind_info()) {
+            if (extract_shyft_url_container(bi.reference).empty())
+                continue;
+            auto n = cluster_ring.nodes_of(bi.reference, cluster_replication);
+            if (first) {
+                r[i] = n;
+                first = false;
+            } else {
+                vector<size_t> both;
+                for (auto k : r[i])
+                    if (std::find(n.begin(), n.end(), k) != n.end()) both.push_back(k);
+                r[i] = both;
+            }
+            if (r[i].empty())
+                break;// no node has all, any node can evaluate it
+        }
+    }
+    return r;
+}
+
+void client::store_routed(message_type type, const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) {
     if (tsv.size() == 0)
         return; //trivial and considered valid case
-                // verify that each member of tsv is a gpoint_ts
-    for (auto const &ats : tsv) {
-        auto rts = dynamic_cast<aref_ts*>(ats.ts.get());
-        if (!rts) throw std::runtime_error(std::string("attempt to store a null ts"));
-        if (rts->needs_bind()) throw std::runtime_error(std::string("attempt to store unbound ts:") + rts->id);
-    }
-    scoped_connect ac(*this);
-    dlib::iosockstream& io = *(srv_con[0].io);
-    msg::write_type(message_type::MERGE_STORE_TS, io);
-    {
-        core_oarchive oa(io,core_arch_flags);
-        oa << tsv << cache_on_write;
-    }
-    auto response_type = msg::read_type(io);
-    if (response_type == message_type::SERVER_EXCEPTION) {
-        auto re = msg::read_exception(io);
-        throw re;
-    } else if (response_type == message_type::MERGE_STORE_TS) {
-        return;
-    }
-    throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    require_store_refs(tsv);
+    with_connect(*this,[&](scoped_connect& ac) {
+        if (!cluster_replication || srv_con.size() == 1 || type == message_type::REPLICATE_TS) {
+            store_io(ac.io(0), type, tsv, overwrite_on_write, cache_on_write);
+            return;
+        }
+        std::map<size_t, ts_vector_t> by_node;// each series to its primary, others to the first server
+        for (const auto& ts : tsv) {
+            auto id = ts.id();
+            by_node[extract_shyft_url_container(id).size() ? cluster_ring.primary_of(id) : 0].push_back(ts);
+        }
+        vector<future<void>> stores;
+        for (const auto& x : by_node)
+            stores.push_back(std::async(std::launch::async, [&ac, &x, type, overwrite_on_write, cache_on_write]() {
+                store_io(ac.io(x.first), type, x.second, overwrite_on_write, cache_on_write);
+            }));
+        for (auto& f : stores)
+            f.get();
+    });
+}
+
+void
+client::store_ts(const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) {
+    store_routed(message_type::STORE_TS, tsv, overwrite_on_write, cache_on_write);
+}
+
+void
+client::merge_store_ts(const ts_vector_t &tsv,bool cache_on_write) {
+    store_routed(message_type::MERGE_STORE_TS, tsv, false, cache_on_write);
+}
+
+void
+client::replicate_ts(const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) {
+    store_routed(message_type::REPLICATE_TS, tsv, overwrite_on_write, cache_on_write);
 }
 
 ts_info_vector_t
 client::find(const std::string& search_expression) {
-    scoped_connect ac(*this);
-    auto& io = *(srv_con[0].io);
-    msg::write_type(message_type::FIND_TS, io);
-    {
-        msg::write_string(search_expression, io);
-    }
-    auto response_type = msg::read_type(io);
-    if (response_type == message_type::SERVER_EXCEPTION) {
-        auto re = msg::read_exception(io);
-        throw re;
-    } else if (response_type == message_type::FIND_TS) {
-        ts_info_vector_t r;
+    return with_connect(*this,[&](scoped_connect& ac) -> ts_info_vector_t {
+        auto& io = ac.io(0);
+        msg::write_type(message_type::FIND_TS, io);
         {
-            core_iarchive ia(io,core_arch_flags);
-            ia >> r;
+            msg::write_string(search_expression, io);
+        }
+        auto response_type = msg::read_type(io);
+        if (response_type == message_type::SERVER_EXCEPTION) {
+            auto re = msg::read_exception(io);
+            throw re;
+        } else if (response_type == message_type::FIND_TS) {
+            ts_info_vector_t r;
+            {
+                core_iarchive ia(io,core_arch_flags);
+                ia >> r;
+            }
+            return r;
+        }
+        throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    });
+}
+
+ts_info_vector_t
+client::get_ts_info(const id_vector_t& ids) {
+    return with_connect(*this,[&](scoped_connect& ac) {
+        ts_info_vector_t r;
+        for(size_t i=0;i<srv_con.size();++i) {
+            auto& io = ac.io(i);
+            msg::write_type(message_type::GET_TS_INFO, io);
+            {
+                core_oarchive oa(io,core_arch_flags);
+                oa << ids;
+            }
+            auto response_type = msg::read_type(io);
+            if (response_type==message_type::GET_TS_INFO) {
+                ts_info_vector_t x;
+                core_iarchive ia(io,core_arch_flags);
+                ia>>x;
+                if (x.size() != ids.size())
+                    throw std::runtime_error("dtss: get_ts_info got "+std::to_string(x.size())+" ts_info for "+std::to_string(ids.size())+" ids");
+                if (i==0) {
+                    r=std::move(x);
+                } else {
+                    for(size_t j=0;j<x.size();++j)
+                        if(!r[j].data_period.valid() && x[j].data_period.valid())
+                            r[j]=std::move(x[j]);
+                }
+            } else if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else {
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            }
         }
         return r;
-    }
-    throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    });
 }
 
 void
 client::cache_flush() {
-    scoped_connect ac(*this);
-    for(auto& sc:srv_con) {
-        auto& io = *(sc.io);
-        msg::write_type(message_type::CACHE_FLUSH, io);
-        auto response_type = msg::read_type(io);
-        if (response_type == message_type::SERVER_EXCEPTION) {
-            auto re = msg::read_exception(io);
-            throw re;
-        } else if (response_type!=message_type::CACHE_FLUSH) {
-            throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    with_connect(*this,[&](scoped_connect& ac) {
+        for(size_t i=0;i<srv_con.size();++i) {
+            auto& io = ac.io(i);
+            msg::write_type(message_type::CACHE_FLUSH, io);
+            auto response_type = msg::read_type(io);
+            if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else if (response_type!=message_type::CACHE_FLUSH) {
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            }
         }
-    }
+    });
 }
 
 cache_stats
 client::get_cache_stats() {
-    scoped_connect ac(*this);
-    cache_stats s;
-    for(auto& sc:srv_con) {
-        auto& io = *(sc.io);
-        msg::write_type(message_type::CACHE_STATS, io);
-        auto response_type = msg::read_type(io);
-        if (response_type==message_type::CACHE_STATS) {
-            cache_stats r;
-            core_iarchive oa(io,core_arch_flags);
-            oa>>r;
-            s= s+r;
-        } else if (response_type == message_type::SERVER_EXCEPTION) {
-            auto re = msg::read_exception(io);
-            throw re;
-        } else {
-            throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+    return with_connect(*this,[&](scoped_connect& ac) {
+        cache_stats s;
+        for(size_t i=0;i<srv_con.size();++i) {
+            auto& io = ac.io(i);
+            msg::write_type(message_type::CACHE_STATS, io);
+            auto response_type = msg::read_type(io);
+            if (response_type==message_type::CACHE_STATS) {
+                cache_stats r;
+                core_iarchive oa(io,core_arch_flags);
+                oa>>r;
+                s= s+r;
+            } else if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else {
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            }
         }
-    }
-    return s;
+        return s;
+    });
+}
+
+scheduler_stats
+client::get_scheduler_stats() {
+    return with_connect(*this,[&](scoped_connect& ac) {
+        scheduler_stats s;
+        for(size_t i=0;i<srv_con.size();++i) {
+            auto& io = ac.io(i);
+            msg::write_type(message_type::SCHEDULER_STATS, io);
+            auto response_type = msg::read_type(io);
+            if (response_type==message_type::SCHEDULER_STATS) {
+                scheduler_stats r;
+                core_iarchive ia(io,core_arch_flags);
+                ia>>r;
+                s= s+r;
+            } else if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else {
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            }
+        }
+        return s;
+    });
+}
+
+vector<string>
+client::get_metrics() {
+    return with_connect(*this,[&](scoped_connect& ac) {
+        vector<string> r;
+        for(size_t i=0;i<srv_con.size();++i) {
+            auto& io = ac.io(i);
+            msg::write_type(message_type::METRICS, io);
+            auto response_type = msg::read_type(io);
+            if (response_type==message_type::METRICS) {
+                r.push_back(msg::read_string(io));
+            } else if (response_type == message_type::SERVER_EXCEPTION) {
+                auto re = msg::read_exception(io);
+                throw re;
+            } else {
+                throw std::runtime_error(std::string("Got unexpected response:") + std::to_string((int)response_type));
+            }
+        }
+        return r;
+    });
 }
 
 }
@@ -6,6 +6,15 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <utility>
+#include <deque>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <functional>
 
 #include <dlib/iosockstream.h>
 #include <dlib/misc_api.h>
@@ -14,6 +23,10 @@
 #include "time_series_info.h"
 #include "utctime_utilities.h"
 #include "dtss_cache.h"
+#include "dtss_cluster.h"
+#include "dtss_scheduler.h"
+#include "dtss_validated_cache.h"
+#include "dtss_msg.h"
 
 namespace shyft {
 namespace dtss {
@@ -50,11 +63,87 @@ struct srv_connection {
     unique_ptr<dlib::iosockstream> io;
     string host_port;
     int timeout_ms;
+    int wire_version{-1}; ///< the flat wire version of the server, negotiated on the first evaluate, -1 until then
     void open(int timeout_ms=1000);
     void close(int timeout_ms=1000);
     void reopen(int timeout_ms=1000);
 };
 
+/** \brief a bounded pool of idle connections to one dtss host
+ *
+ * Lets the auto_connect calls of a client reuse the connection of a previous call,
+ * instead of a new connect and close for each call.
+ * The most recently used connection is handed out first, and connections idle for longer than
+ * max_idle_time, or with a failed stream, are dropped rather than reused.
+ * Thread-safe, so concurrent calls of a client gets a connection each.
+ */
+struct srv_connection_pool {
+    using clock_t = std::chrono::steady_clock;
+    string host_port;
+    int timeout_ms;
+    size_t max_idle{4}; ///< max idle connections kept, connections released when full are closed
+    std::chrono::milliseconds max_idle_time{30000}; ///< connections idle for longer are closed rather than reused
+
+    srv_connection_pool(const string& host_port, int timeout_ms):host_port(host_port),timeout_ms(timeout_ms) {}
+
+    /** \return an idle connection, setting reused=true, or a new one, throws if it can not connect */
+    unique_ptr<dlib::iosockstream> acquire(bool& reused);
+
+    /** return a connection that is in sync with the server to the pool */
+    void release(unique_ptr<dlib::iosockstream> io);
+
+    /** close all idle connections */
+    void clear();
+
+    /** \return number of idle connections */
+    size_t idle_count() const;
+
+  private:
+    mutable std::mutex mx; ///< protects idle
+    vector<std::pair<unique_ptr<dlib::iosockstream>, clock_t::time_point>> idle; ///< idle connections, and when released, most recent last
+};
+
+/** \brief pipelined requests on one connection to a dtss host
+ *
+ * Requests are sent as tagged requests, without waiting for the replies to the previous ones,
+ * the server handles them concurrently, and the replies are matched to the requests by the tag, in any order.
+ * One i/o thread owns the connection, sending the queued requests, with at most msg::max_tagged_in_flight
+ * outstanding, and reading the replies.
+ * When the connection fails, all outstanding requests fails with the error, and the pipeline is broken().
+ */
+struct srv_pipeline {
+    srv_pipeline(const string& host_port, int timeout_ms);
+    /** waits for the replies to the requests sent */
+    ~srv_pipeline();
+    srv_pipeline(const srv_pipeline&) = delete;
+    srv_pipeline& operator=(const srv_pipeline&) = delete;
+
+    /** send the complete message request, \return future reply message */
+    std::future<string> send(string request);
+
+    /** \return true if the connection failed */
+    bool broken() const;
+
+    /** \return the flat wire version of the server, negotiated when connected */
+    std::uint32_t wire_version() const { return version; }
+
+  private:
+    void io_loop();
+    void fail_all(std::exception_ptr e);
+
+    unique_ptr<dlib::iosockstream> io; ///< only used by io_thread after construction
+    mutable std::mutex mx; ///< protects the members below
+    std::condition_variable cv; ///< signals io_thread
+    std::deque<std::pair<std::uint64_t, string>> queue; ///< requests to send
+    std::unordered_map<std::uint64_t, std::promise<string>> pending; ///< replies to come, by tag
+    std::uint64_t next_tag{1};
+    size_t outstanding{0}; ///< requests sent, not yet replied
+    bool stopping{false};
+    bool failed{false};
+    std::uint32_t version{0}; ///< the flat wire version of the server
+    std::thread io_thread;
+};
+
 /** \brief a dtss client
  *
  * This class implements the client side functionality of the dtss client-server.
@@ -67,10 +156,27 @@ struct client {
      */
     vector<srv_connection> srv_con;
 
-	bool auto_connect{true}; ///< if enabled, connections are made as needed, and kept short, otherwise externally managed.
+	bool auto_connect{true}; ///< if enabled, connections are made as needed, and pooled for reuse by the next calls, otherwise externally managed.
+
+    vector<unique_ptr<srv_connection_pool>> srv_pool; ///< the idle connections to each of the servers, used when auto_connect
+
+    vector<std::shared_ptr<srv_pipeline>> srv_pipe; ///< the pipelined connection to each of the servers, made on the first async request
+    std::mutex srv_pipe_mx; ///< protects srv_pipe
+    size_t next_pipe{0}; ///< server of the next async request
 
     bool compress_expressions{true};///< compress expressions to gain speed
 
+    bool dedup_expressions{false};///< compress with the structurally equal nodes written once, for heavily shared expressions, ref. expression_compressor::compress_shared
+
+    bool flat_replies{true};///< ask for flat evaluate replies, without boost archives, from the servers that supports them
+
+    bool compress_replies{false};///< ask for xor-delta compressed values in flat replies, for bandwidth bound links, ref. msg::wire_compress_values
+
+    size_t cluster_replication{0};///< if the servers are the nodes of a cluster, the replication of it, 0 if not, ref. set_cluster
+    hash_ring cluster_ring;///< the ring of the cluster nodes, ref. set_cluster
+
+    validated_result_cache<apoint_ts> validated_cache;///< the evaluated results, validated by the server, off by default, ref. set_validated_cache_size
+
 	client (const string& host_port, bool auto_connect = true, int timeout_ms=1000);
 
     client(const vector<string>& host_ports,bool auto_connect,int timeout_ms);
@@ -79,22 +185,130 @@ struct client {
 
 	void close(int timeout_ms=1000);
 
+    /** \brief route the requests as the nodes of a cluster, ref. server::set_cluster
+     *
+     * The servers, in order, are the nodes of a cluster with the given replication.
+     * The series of a store are sent to their primary node, and an evaluation is partitioned on the nodes so
+     * that each expression goes to one of the nodes of the series it references, balancing the cost,
+     * so the reads are local to the nodes, and spread on the replicas.
+     * \param replication the replication of the cluster, 0 to route as independent servers
+     */
+    void set_cluster(size_t replication);
+
+    /** \brief set the max results of the validated cache, 0, the default, turns it off
+     *
+     * With one server, the results of evaluate are kept by expression and period, with the version the server gave them,
+     * from the ts_info.modified of the series they reference, ref. server::do_get_versions.
+     * The next evaluate of the same expression and period sends the version, and the server replies the result
+     * only if the version changed, so repeated evaluations of unchanged series transfers the versions, not the values.
+     * Only expressions referencing shyft:// series alone are versioned, the others are always evaluated.
+     */
+    void set_validated_cache_size(size_t max_items) { validated_cache.set_capacity(max_items);}
+    size_t get_validated_cache_size() const { return validated_cache.get_capacity();}
+
+    /** \return the pipeline to the server of the next async request, a new one if it is broken */
+    std::shared_ptr<srv_pipeline> next_pipeline();
+
 	vector<apoint_ts> percentiles(ts_vector_t const& tsv, utcperiod p, gta_t const&ta, const vector<int64_t>& percentile_spec,bool use_ts_cached_read,bool update_ts_cache);
 
 	vector<apoint_ts> evaluate(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache) ;
 
+    /** \brief evaluate aggregates across tsv on the time-axis ta at the server, so that only the aggregates are sent back
+     *
+     * \param aggregate_spec list of time_series::aggregate_property, like SUM, MEAN or HISTOGRAM
+     * \param weights one for each series of tsv, used by the weighted aggregates, e.g. the areas
+     * \param bins the ascending bin edges, used by HISTOGRAM
+     * \return one series for each aggregate, but one for each bin of HISTOGRAM, ref. time_series::calculate_aggregates
+     * With several servers, or a server without aggregates, the series are evaluated averaged on ta, and aggregated here.
+     */
+    vector<apoint_ts> aggregates(ts_vector_t const& tsv, utcperiod p, gta_t const&ta, const vector<int64_t>& aggregate_spec, const vector<double>& weights, const vector<double>& bins,bool use_ts_cached_read,bool update_ts_cache);
+
+    /** \brief as evaluate, pipelined with the other async requests on one connection to a server
+     *
+     * Returns when the request is queued for sending, the server handles the requests in flight concurrently,
+     * and the future completes when the reply arrives, in any order.
+     * The requests are assigned to the servers round-robin.
+     */
+    std::future<vector<apoint_ts>> evaluate_async(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache);
+
+    /** \brief as evaluate, receiving the result in chunks of chunk_size series, as the server evaluates them
+     *
+     * fx(i0,chunk) is called for each chunk as it arrives, in order, chunk holding the results of tsv[i0..i0+chunk.size()).
+     * The server reads and evaluates one chunk at the time, and waits while the client is behind,
+     * so neither side holds all of the result of a large evaluation.
+     * The first server is used. A server without streaming replies all at once, passed to fx in chunks.
+     */
+    void evaluate_stream(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache,size_t chunk_size,const std::function<void(size_t,ts_vector_t&&)>& fx);
+
+    /** \brief subscribe to the evaluated tsv at the first server, to get the changes instead of polling with evaluate
+     *
+     * The server evaluates tsv, and keeps the expressions, with the ids each of them references,
+     * so that stores to those ids marks the expressions as changed, ref. read_subscription.
+     * The subscription is kept until unsubscribe, or the connection it was made on is closed.
+     * \param initial set to the evaluated tsv, as evaluate
+     * \return the subscription id
+     */
+    std::uint64_t subscribe(ts_vector_t const& tsv, utcperiod p,bool use_ts_cached_read,bool update_ts_cache,ts_vector_t& initial);
+
+    /** \brief wait at most max_wait for expressions of the subscription sid to change
+     *
+     * The server replies as soon as any of them changes, with the changed expressions only, evaluated again.
+     * \param changed set to the new results of the changed expressions
+     * \return the index in the subscribed tsv of each of changed, empty if none changed within max_wait
+     */
+    vector<size_t> read_subscription(std::uint64_t sid, std::chrono::milliseconds max_wait, ts_vector_t& changed);
+
+    /** remove the subscription sid at the server, ignored if it is not there */
+    void unsubscribe(std::uint64_t sid);
+
 	void store_ts(const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) ;
     
     void merge_store_ts(const ts_vector_t &tsv, bool cache_on_write) ;
 
+    /** as store_ts to the first server, sent by the primary node of a cluster to the other nodes of the series, saved without forwarding */
+    void replicate_ts(const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write) ;
+
 	ts_info_vector_t find(const string& search_expression) ;
 
+    /** \brief the ts_info of each of ids, in order, in one request to each server, ref. server::do_get_ts_info
+     *
+     * With several servers, like the nodes of a cluster, each is asked, and the first that has the id gives its ts_info.
+     * An id no server has gets a ts_info with only the name set, and an invalid data_period.
+     */
+    ts_info_vector_t get_ts_info(const id_vector_t& ids);
+
 	void cache_flush() ;
 
 	cache_stats get_cache_stats();
 
+    /** \return the request scheduler metrics, summed over the servers, ref. server::set_scheduling */
+    scheduler_stats get_scheduler_stats();
+
+    /** \return the metrics of each server, in the prometheus text format, ref. server::get_metrics */
+    vector<string> get_metrics();
+
+  private:
+    /** as evaluate, at the server of sc, sending the versions of the results in the validated cache, ref. set_validated_cache_size */
+    vector<apoint_ts> evaluate_validated(dlib::iosockstream& io, srv_connection& sc, ts_vector_t const& tsv, utcperiod p, bool use_ts_cached_read, bool update_ts_cache);
+    /** store tsv with the request type, to the primary node of each series if set_cluster, otherwise to the first server */
+    void store_routed(message_type type, const ts_vector_t &tsv, bool overwrite_on_write, bool cache_on_write);
+    /** \return the cluster nodes that have all the shyft:// series each expression of tsv references, empty if none */
+    vector<vector<size_t>> cluster_candidates(const ts_vector_t& tsv) const;
 };
 
+/** \return the estimated cost of evaluating ts at a server, 1 + the number of series it references, that must be read */
+double estimated_cost(const apoint_ts& ts);
+
+/** \brief partition the series with cost[i] on n servers, balancing the cost
+ *
+ * The series are assigned, most costly first, to the server with the least cost so far.
+ * \return the indices of the series of each server, ascending
+ */
+vector<vector<size_t>> partition_by_cost(const vector<double>& cost, size_t n);
+
+/** \brief as partition_by_cost, series i only to one of the servers candidates[i], or any if it is empty */
+vector<vector<size_t>> partition_by_cost(const vector<double>& cost, size_t n, const vector<vector<size_t>>& candidates);
+
 // ========================================
 
 inline vector<apoint_ts> dtss_evaluate(const string& host_port, const ts_vector_t& tsv, utcperiod p, int timeout_ms = 10000,bool use_ts_cached_read=false,bool update_ts_cache=false) {
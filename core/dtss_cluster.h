@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+
+        /** \brief consistent hash ring of the nodes of a dtss cluster
+         *
+         * Each node has virtual_nodes points on a ring of 64 bit hashes, and a key, the ts-url, belongs to
+         * the nodes of the first points clockwise from the hash of the key.
+         * So the keys are spread evenly on the nodes, and adding a node moves only the keys of its new points.
+         * The hash is FNV-1a, with a final mix to spread similar keys, so the ring is the same on all nodes and clients,
+         * independent of the platform.
+         */
+        struct hash_ring {
+            hash_ring() = default;
+            /** \brief a ring of n_nodes nodes, numbered 0..n_nodes-1 */
+            explicit hash_ring(size_t n_nodes, size_t virtual_nodes = 64) :n(n_nodes) {
+                points.reserve(n_nodes*virtual_nodes);
+                for (size_t i = 0; i < n_nodes; ++i)
+                    for (size_t v = 0; v < virtual_nodes; ++v)
+                        points.emplace_back(hash(std::to_string(i) + "#" + std::to_string(v)), i);
+                std::sort(points.begin(), points.end());
+            }
+
+            /** \return number of nodes */
+            size_t size() const { return n; }
+
+            /** \return the up to n_replicas distinct nodes of key, the primary node first */
+            vector<size_t> nodes_of(const string& key, size_t n_replicas) const {
+                vector<size_t> r;
+                if (points.empty())
+                    return r;
+                n_replicas = std::min(n_replicas, n);
+                auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(hash(key), size_t(0)));
+                for (size_t k = 0; k < points.size() && r.size() < n_replicas; ++k, ++it) {
+                    if (it == points.end())
+                        it = points.begin();
+                    if (std::find(r.begin(), r.end(), it->second) == r.end())
+                        r.push_back(it->second);
+                }
+                return r;
+            }
+
+            /** \return the primary node of key */
+            size_t primary_of(const string& key) const {
+                if (points.empty())
+                    throw std::runtime_error("dtss: empty hash ring");
+                return nodes_of(key, 1).front();
+            }
+
+            /** \return the 64 bit FNV-1a hash of s, mixed as the splitmix64 finalizer */
+            static std::uint64_t hash(const string& s) {
+                std::uint64_t h = 14695981039346656037ull;
+                for (unsigned char c : s) {
+                    h ^= c;
+                    h *= 1099511628211ull;
+                }
+                h = (h ^ (h >> 30))*0xbf58476d1ce4e5b9ull;
+                h = (h ^ (h >> 27))*0x94d049bb133111ebull;
+                return h ^ (h >> 31);
+            }
+
+        private:
+            size_t n{0};
+            vector<std::pair<std::uint64_t, size_t>> points;///< (hash,node), ascending
+        };
+    }
+}
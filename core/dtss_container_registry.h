@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include "dtss_db.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::unordered_map;
+        using std::shared_ptr;
+        using std::make_shared;
+
+        /** \brief the shyft:// containers of a server, that can be added and removed while it is serving
+         *
+         * The containers are kept in an immutable map, replaced as a whole, copy-on-write, when a container
+         * is added or removed. So a lookup is an atomic load of the current map, without locks shared with
+         * the writers, and a reader keeps the its_db it found, even if it is removed meanwhile.
+         * The writers are serialized, so concurrent adds are not lost.
+         */
+        struct container_registry {
+            using map_t = unordered_map<string, shared_ptr<const its_db>>;
+
+            container_registry() = default;
+            container_registry(const container_registry&) = delete;
+            container_registry& operator=(const container_registry&) = delete;
+
+            /** \return the container name, or null if there is none */
+            shared_ptr<const its_db> find(const string& name) const {
+                auto m = snapshot();
+                auto f = m->find(name);
+                return f == m->end() ? nullptr : f->second;
+            }
+
+            /** add, or replace, the container name */
+            void add(const string& name, shared_ptr<const its_db> db) {
+                std::lock_guard<std::mutex> guard(writer_mx);
+                auto m = make_shared<map_t>(*snapshot());
+                (*m)[name] = std::move(db);
+                std::atomic_store(&current, shared_ptr<const map_t>(std::move(m)));
+            }
+
+            /** remove the container name, \return true if it was there */
+            bool remove(const string& name) {
+                std::lock_guard<std::mutex> guard(writer_mx);
+                auto old = snapshot();
+                if (old->find(name) == old->end())
+                    return false;
+                auto m = make_shared<map_t>(*old);
+                m->erase(name);
+                std::atomic_store(&current, shared_ptr<const map_t>(std::move(m)));
+                return true;
+            }
+
+            /** \return the names of the containers, ascending */
+            vector<string> names() const {
+                auto m = snapshot();
+                vector<string> r; r.reserve(m->size());
+                for (const auto& x : *m)
+                    r.push_back(x.first);
+                std::sort(r.begin(), r.end());
+                return r;
+            }
+
+            size_t size() const { return snapshot()->size(); }
+
+            /** \return the current map, unchanged by later adds and removes */
+            shared_ptr<const map_t> snapshot() const { return std::atomic_load(&current); }
+
+        private:
+            shared_ptr<const map_t> current{ make_shared<map_t>() };///< replaced, never modified
+            std::mutex writer_mx;///< serializes add and remove
+        };
+    }
+}
@@ -10,6 +10,8 @@
 #include <utility>
 #include <functional>
 #include <cstring>
+#include <mutex>
+#include <shared_mutex>
 
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -23,10 +25,15 @@ namespace fs = boost::filesystem;
 #define O_BINARY 0
 #define O_SEQUENTIAL 0
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 #include <fcntl.h>
 
 #include "core/time_series_dd.h"
+#include "dtss_db_codec.h"
+#include "dtss_db_catalogue.h"
+#include "dtss_db_wal.h"
 #include "time_series_info.h"
 #include "utctime_utilities.h"
 
@@ -83,7 +90,31 @@ using gts_t = shyft::time_series::point_ts<gta_t>;
  *
  * <values>         -> double[<n>] // <n> from the header
  *
+ * The last signature byte gives the encoding of the <values>, '\0' for raw doubles as above, or
+ * 'X' for xor-delta encoded chunks of values, see codec::xor_encode:
+ * <values>         -> <chunk_n> uint32_t <n_chunks> uint32_t <chunk_end> uint64_t[<n_chunks>] <chunk>[<n_chunks>]
+ *      <chunk_end> -> the end of each chunk, in bytes from the first chunk
+ *          <chunk> -> xor-delta encoding of the values [k*<chunk_n>..min(<n>,(k+1)*<chunk_n>)>
+ *
+ * Format 'TS2' is used for point_dt series, storing the points in
+ * fixed size time-ordered blocks, followed by an index of the blocks:
+ *   <ts.db.file>   -> <header><block-info><block>[<n_blocks>]<index>
+ *       <header>   -> 'TS2' ... as above, ta_type == point_dt
+ *   <block-info>   -> <t_end> int64_t <block_n> uint32_t <n_blocks> uint32_t
+ *        <block>   -> int64_t[<block_n>] double[<block_n>] // time-points, then values
+ *        <index>   -> int64_t[<n_blocks>] // first time-point of each block
+ *
+ * All blocks except the last are full, the unused slots of the last block are undefined.
+ * The index follows the last block, so the file may have trailing bytes after it.
+ * A read touches the index and the blocks overlapping the read period only,
+ * and an append writes the last block, the new blocks and the index only.
+ * TS2 values are always raw.
  */
+enum class ts_db_encoding : char {
+	raw = '\0', ///< values as double[<n>]
+	xor_delta = 'X' ///< values as xor-delta encoded chunks
+};
+
 #pragma pack(push,1)
 struct ts_db_header {
 	char signature[4] = { 'T','S','1','\0' }; ///< signature header with version #
@@ -97,9 +128,98 @@ struct ts_db_header {
 		: point_fx(point_fx), ta_type(ta_type), n(n), data_period(data_period) {
 	}
 };
+
+/** \brief TS2 block layout, follows the header */
+struct ts_db_block_info {
+	core::utctime t_end = core::no_utctime; ///< end of the last interval
+	uint32_t block_n = 0; ///< capacity in points of each block
+	uint32_t n_blocks = 0; ///< number of blocks
+
+	ts_db_block_info() = default;
+	ts_db_block_info(core::utctime t_end, uint32_t block_n, uint32_t n_blocks)
+		: t_end(t_end), block_n(block_n), n_blocks(n_blocks) {
+	}
+};
 #pragma pack(pop)
 
 
+#ifndef _WIN32
+/** read-only memory map of a whole file, unmapped on destruction */
+struct mapped_file {
+	const char* d = nullptr;
+	std::size_t sz = 0;
+	explicit mapped_file(const std::string& ffp) {
+		int fd = ::open(ffp.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* m = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m != MAP_FAILED) {
+				d = static_cast<const char*>(m);
+				sz = std::size_t(st.st_size);
+			}
+		}
+		::close(fd);// the mapping keeps its own reference to the file
+	}
+	~mapped_file() {
+		if (d)
+			::munmap(const_cast<char*>(d), sz);
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	/** copy sz_ bytes at offset o to dst, throws if the file is too short */
+	void read(std::size_t o, void* dst, std::size_t sz_) const {
+		if (o > sz || sz_ > sz - o)
+			throw std::runtime_error("dtss_store: failed to read from disk");
+		std::memcpy(dst, d + o, sz_);
+	}
+};
+#endif
+
+/** \brief process wide reader/writer locks of the ts_db files, striped on the full path
+ *
+ * A save or remove of a file holds its lock exclusive, while read and get_ts_info holds it shared,
+ * so a reader sees either the old or the new version of a file being rewritten, while reads of
+ * other files only waits for a write if they happen to share the stripe.
+ * The locks are process wide, so they also cover ts_db copies, like the writer of the write-ahead log.
+ */
+struct ts_db_file_locks {
+	static constexpr std::size_t n_stripes = 1024;
+
+	/** \return the lock of the file ffp, the full path of the file */
+	static std::shared_timed_mutex& of(const std::string& ffp) {
+		static ts_db_file_locks locks;
+		return locks.mx[std::hash<std::string>{}(ffp) % n_stripes];
+	}
+private:
+	std::shared_timed_mutex mx[n_stripes];
+};
+
+/** \brief the storage of the series of a shyft:// container, as used by the dtss server
+ *
+ * Implemented by ts_db, a file per series, and ts_db_pack, many series in a few pack files,
+ * so the server can choose the layout per container, ref. server::add_container.
+ */
+struct its_db {
+	virtual ~its_db() = default;
+	/** save ts as fn, replacing it if overwrite, otherwise merged with the stored series */
+	virtual void save(const std::string& fn, const gts_t& ts, bool overwrite = true, bool win_thread_close = true) const = 0;
+	/** save the series tsv[i].second as tsv[i].first */
+	virtual void save(const std::vector<std::pair<std::string, const gts_t*>>& tsv, bool overwrite = true) const = 0;
+	/** \return the part of the series fn that overlaps p */
+	virtual gts_t read(const std::string& fn, core::utcperiod p) const = 0;
+	/** remove the series fn */
+	virtual void remove(const std::string& fn) const = 0;
+	/** \return the ts_info of the series fn */
+	virtual ts_info get_ts_info(const std::string& fn) const = 0;
+	/** \return the ts_info of each of fns, in order, for a name without a series only the name is set */
+	virtual std::vector<ts_info> get_ts_infos(const std::vector<std::string>& fns) const = 0;
+	/** \return the ts_info of the series with a name matching the regular expression match */
+	virtual std::vector<ts_info> find(const std::string& match) const = 0;
+};
+
 /** \brief A simple file-io based internal time-series storage for the dtss.
  *
  * Utilizing standard c++ libraries to store time-series
@@ -134,8 +254,13 @@ struct ts_db_header {
  *      internally managed as well as externally mapped ts-db
  *
  */
-struct ts_db {
+struct ts_db : its_db {
 	std::string root_dir; ///< root_dir points to the top of the container
+	bool mmap_read = true; ///< read fixed_dt and calendar_dt series through a read-only memory map (posix only)
+	uint32_t point_block_n = 4096; ///< points pr. block when writing point_dt series in the blocked TS2 format, 0 writes TS1
+	ts_db_encoding value_encoding = ts_db_encoding::raw; ///< encoding of the values when writing TS1, files are read with the encoding they are written with
+	uint32_t value_chunk_n = 4096; ///< values pr. chunk when writing encoded values, the unit of decoding on read
+	bool normalize_time_axis = false; ///< save regularly spaced point_dt series as fixed_dt, or calendar_dt, ref. normalized
   private:
 
   	/** helper class needed for win compensating code */
@@ -150,6 +275,7 @@ struct ts_db {
 		void operator()(std::FILE * fh) const {
 #ifdef _WIN32
 			if (win_thread_close && parent) {
+				std::fflush(fh);// so readers see the data when the file lock is released, before the close
 				parent->fclose_me(fh);
 				//std::thread(std::fclose, fh).detach();// allow time-consuming close to work in background
 			} else {
@@ -162,6 +288,8 @@ struct ts_db {
 	};
 
 	std::map<std::string, std::shared_ptr<core::calendar>> calendars;
+	std::shared_ptr<ts_db_catalogue> catalogue; ///< serves find, maintained by save and remove, shared with other ts_db of the root
+	std::shared_ptr<ts_db_wal> wal; ///< the write-ahead log of the batch save, if enabled, shared with copies of this ts_db
 
 	//--section dealing with windows and (postponing slow) closing files
 #ifdef _WIN32
@@ -191,8 +319,8 @@ public:
 
 	ts_db() = default;
 
-	/** constructs a ts_db with specified container root */
-	explicit ts_db(const std::string& root_dir) :root_dir(root_dir) {
+	/** constructs a ts_db with specified container root, writing values with the specified encoding */
+	explicit ts_db(const std::string& root_dir, ts_db_encoding value_encoding = ts_db_encoding::raw) :root_dir(root_dir), value_encoding(value_encoding) {
 		if (!fs::is_directory(root_dir)) {
 			if (!fs::exists(root_dir)) {
 				if (!fs::create_directory(root_dir)) {
@@ -203,6 +331,7 @@ public:
 			}
 		}
 		make_calendar_lookups();
+		catalogue = ts_db_catalogue::open(root_dir, [this](const std::string& ffp, const std::string& fn) { return read_ts_info(ffp, fn); });
 	}
 
 	~ts_db() {
@@ -211,13 +340,20 @@ public:
 
 	// note that we need special care(windows) for the operations below
 	// basically we don't copy/move the fclose_windows, rather just wait it out before overwrite.
-	ts_db(const ts_db&c) :root_dir(c.root_dir),calendars(c.calendars) {}
-	ts_db(ts_db&&c) :root_dir(c.root_dir), calendars(c.calendars) {};
+	ts_db(const ts_db&c) :root_dir(c.root_dir),mmap_read(c.mmap_read),point_block_n(c.point_block_n),value_encoding(c.value_encoding),value_chunk_n(c.value_chunk_n),normalize_time_axis(c.normalize_time_axis),calendars(c.calendars),catalogue(c.catalogue),wal(c.wal) {}
+	ts_db(ts_db&&c) :root_dir(c.root_dir),mmap_read(c.mmap_read),point_block_n(c.point_block_n),value_encoding(c.value_encoding),value_chunk_n(c.value_chunk_n),normalize_time_axis(c.normalize_time_axis), calendars(c.calendars),catalogue(c.catalogue),wal(c.wal) {};
 	ts_db & operator=(const ts_db&o) {
 		if (&o != this) {
 			wait_for_close_fh();
 			root_dir = o.root_dir;
+			mmap_read = o.mmap_read;
+			point_block_n = o.point_block_n;
+			value_encoding = o.value_encoding;
+			value_chunk_n = o.value_chunk_n;
+			normalize_time_axis = o.normalize_time_axis;
 			calendars = o.calendars;
+			catalogue = o.catalogue;
+			wal = o.wal;
 		}
 		return *this;
 	};
@@ -225,7 +361,14 @@ public:
 		if (&o != this) {
 			wait_for_close_fh();
 			root_dir = o.root_dir;
+			mmap_read = o.mmap_read;
+			point_block_n = o.point_block_n;
+			value_encoding = o.value_encoding;
+			value_chunk_n = o.value_chunk_n;
+			normalize_time_axis = o.normalize_time_axis;
 			calendars = o.calendars;
+			catalogue = o.catalogue;
+			wal = o.wal;
 		}
 		return *this;
 	};
@@ -236,48 +379,289 @@ public:
 	 *       handles and separate thread for the close-job for now.
 	 *
 	 * \param fn  Pathname to save the time-series at.
-	 * \param ts  Time-series to save.
+	 * \param ts  Time-series to save, with normalize_time_axis a regular point_dt is saved as fixed_dt or calendar_dt,
+	 *            unless merged into a stored point_dt series.
 	 * \param win_thread_close  Only meaningfull on the Windows platform.
 	 *                          Use a deatached background thread to close the file.
 	 *                          Defaults to true.
 	 */
 	void save(const std::string& fn, const gts_t& ts, bool overwrite = true, bool win_thread_close = true) const {
         wait_for_close_fh();
+		if (wal)
+			wal->flush(fn);// keep the order with the logged saves of fn
 
         std::string ffp = make_full_path(fn, true);
+		std::unique_lock<std::shared_timed_mutex> file_lock(ts_db_file_locks::of(ffp));// taken after the wal flush, that saves fn with this lock, released after fh is closed
 
 		std::unique_ptr<std::FILE, close_write_handle> fh;  // zero-initializes deleter
 		fh.get_deleter().win_thread_close = win_thread_close;
 		fh.get_deleter().parent = const_cast<ts_db*>(this);
 		ts_db_header old_header;
 
-		bool do_merge = false;
+		gts_t normalized_ts;
+		const gts_t* nts = normalize_time_axis && normalized(ts, normalized_ts) ? &normalized_ts : &ts;
+		bool do_merge = false, appended = false;
+		gts_t merged;// encoded values can not be merged in place, so merged in memory, and rewritten
 		if (!overwrite && save_path_exists(fn)) {
             fh.reset(std::fopen(ffp.c_str(), "r+b"));
 			old_header = read_header(fh.get());
+			if (old_header.ta_type != nts->ta.gt && !ts.total_period().contains(old_header.data_period))
+				nts = &ts;// merged with the time-axis type of the stored series
 			if (ts.total_period().contains(old_header.data_period)) {
 				// old data is completly contained in the new => start the file anew
 				//  - reopen, as there is no simple way to truncate an open file...
 				//std::fseek(fh.get(), 0, SEEK_SET);
                 wait_for_close_fh();
-                fh.reset(std::fopen(ffp.c_str(), "wb"));
+                fh.reset(std::fopen(ffp.c_str(), "w+b"));
+			} else if (append_tail(fh.get(), old_header, *nts)) {
+				appended = true;
+			} else if (!is_ts2(old_header) && encoding_of(old_header) != ts_db_encoding::raw) {
+				merged = merge_encoded(fh.get(), old_header, *nts);
+                wait_for_close_fh();
+                fh.reset(std::fopen(ffp.c_str(), "w+b"));
 			} else {
 				do_merge = true;
 			}
 		} else {
-            fh.reset(std::fopen(ffp.c_str(), "wb"));
+            fh.reset(std::fopen(ffp.c_str(), "w+b"));
 		}
-		if (!do_merge) {
-			write_ts(fh.get(), ts);
+		if (appended) {
+			// the new values are already at the end of the file
+		} else if (!do_merge) {
+			write_ts(fh.get(), merged.size() ? merged : *nts);
+		} else if (is_ts2(old_header)) {
+			merge_ts2(fh.get(), old_header, *nts);
 		} else {
-			merge_ts(fh.get(), old_header, ts);
+			merge_ts(fh.get(), old_header, *nts);
+		}
+		if (catalogue) {
+			auto name = catalogue_name(ffp);
+			if (name.size()) {
+				std::fflush(fh.get());
+				catalogue->put(make_ts_info(name, read_header(fh.get()), core::utctime_now()));
+			}
+		}
+	}
+
+	/** \brief save the time-series tsv[i].second at tsv[i].first, as save
+	 *
+	 * If the write-ahead log is enabled, the series are appended to it in one group commit,
+	 * and written to the files later in the background, otherwise they are saved one by one.
+	 */
+	void save(const std::vector<std::pair<std::string, const gts_t*>>& tsv, bool overwrite = true) const {
+		if (!wal) {
+			for (const auto& x : tsv)
+				save(x.first, *x.second, overwrite);
+			return;
+		}
+		std::vector<ts_db_wal::record> rs;
+		rs.reserve(tsv.size());
+		for (const auto& x : tsv) {
+			make_full_path(x.first);// validate the name now, as the client will not see errors of the background write
+			rs.push_back(ts_db_wal::record{ x.first, overwrite, wal_payload(*x.second) });
+		}
+		wal->append(rs);
+	}
+
+	/** \brief enable the write-ahead log for the batch save, applying the saves left in it by a crash
+	 *
+	 * The log applies the saves with the settings of this ts_db at the time of the call.
+	 * \param sync if true, each group commit is fsync'ed before the saves are acknowledged
+	 */
+	void enable_wal(bool sync = true) {
+		if (wal)
+			return;
+		auto writer = std::make_shared<ts_db>(*this);// without a log, so the logged saves goes to the files
+		wal = std::make_shared<ts_db_wal>(root_dir, [writer](const std::string& fn, bool overwrite, const std::string& payload) {
+			writer->save(fn, writer->wal_ts(payload), overwrite);
+		}, sync);
+	}
+
+	/** \return true if the write-ahead log is enabled */
+	bool wal_enabled() const { return wal != nullptr; }
+
+	/** write all saves pending in the write-ahead log to the files now */
+	void flush_wal() const {
+		if (wal)
+			wal->flush();
+	}
+
+	/** \return the latest errors of writing logged saves to the files, the client did not see these */
+	std::vector<std::string> wal_errors() const {
+		return wal ? wal->errors() : std::vector<std::string>{};
+	}
+
+	/** \return the write-ahead log payload of ts, laid out as a TS1 file with raw values */
+	std::string wal_payload(const gts_t& ts) const {
+		std::string b;
+		auto put = [&b](const void* d, std::size_t sz) { b.append(static_cast<const char*>(d), sz); };
+		const ts_db_header h = mk_header(ts);
+		put(&h, sizeof(h));
+		const gta_t& ta = ts.ta;
+		switch (ta.gt) {
+		case time_axis::generic_dt::FIXED: {
+			put(&ta.f.t, sizeof(core::utctime));
+			put(&ta.f.dt, sizeof(core::utctimespan));
+		} break;
+		case time_axis::generic_dt::CALENDAR: {
+			put(&ta.c.t, sizeof(core::utctime));
+			put(&ta.c.dt, sizeof(core::utctimespan));
+			std::string tz = ta.c.cal->tz_info->name();
+			uint32_t sz = tz.size();
+			put(&sz, sizeof(uint32_t));
+			put(tz.data(), sz);
+		} break;
+		case time_axis::generic_dt::POINT: {
+			put(&ta.p.t_end, sizeof(core::utctime));
+			put(ta.p.t.data(), sizeof(core::utctime)*ta.p.t.size());
+		} break;
 		}
+		put(ts.v.data(), sizeof(double)*ts.v.size());
+		return b;
+	}
+	/** \return the ts of the write-ahead log payload b */
+	gts_t wal_ts(const std::string& b) const {
+		std::size_t o = 0;
+		auto get = [&b, &o](void* d, std::size_t sz) {
+			if (sz > b.size() - o)
+				throw std::runtime_error("dtss_store: corrupt write-ahead log record");
+			std::memcpy(d, b.data() + o, sz);
+			o += sz;
+		};
+		ts_db_header h;
+		get(&h, sizeof(h));
+		gta_t ta;
+		ta.set_type(h.ta_type);
+		switch (h.ta_type) {
+		case time_axis::generic_dt::FIXED: {
+			get(&ta.f.t, sizeof(core::utctime));
+			get(&ta.f.dt, sizeof(core::utctimespan));
+			ta.f.n = h.n;
+		} break;
+		case time_axis::generic_dt::CALENDAR: {
+			get(&ta.c.t, sizeof(core::utctime));
+			get(&ta.c.dt, sizeof(core::utctimespan));
+			uint32_t sz{ 0 };
+			get(&sz, sizeof(uint32_t));
+			std::string tz(sz, '\0');
+			get(&tz[0], sz);
+			ta.c.cal = lookup_calendar(tz);
+			ta.c.n = h.n;
+		} break;
+		case time_axis::generic_dt::POINT: {
+			get(&ta.p.t_end, sizeof(core::utctime));
+			auto& tp = ta.p.t.mut();
+			tp.resize(h.n);
+			get(tp.data(), sizeof(core::utctime)*h.n);
+		} break;
+		}
+		std::vector<double> v(h.n);
+		get(v.data(), sizeof(double)*h.n);
+		return gts_t{ std::move(ta),std::move(v),h.point_fx };
+	}
+
+	/** \return the part of ts that overlaps p, sliced as read slices the series of a file */
+	gts_t slice(const gts_t& ts, core::utcperiod p) const {
+		const ts_db_header h = mk_header(ts);
+		gta_t ta;
+		ta.set_type(h.ta_type);
+		std::size_t skip_n = 0;
+		core::utctime t_start, t_end;
+		if (read_range(h, p, t_start, t_end)) {
+			switch (h.ta_type) {
+			case time_axis::generic_dt::FIXED: {
+				ta.f.dt = ts.ta.f.dt;
+				slice_fixed(h, ts.ta.f.t, t_start, t_end, ta.f, skip_n);
+			} break;
+			case time_axis::generic_dt::CALENDAR: {
+				ta.c.cal = ts.ta.c.cal;
+				ta.c.dt = ts.ta.c.dt;
+				slice_calendar(h, ts.ta.c.t, t_start, t_end, ta.c, skip_n);
+			} break;
+			case time_axis::generic_dt::POINT: {
+				const auto& tp = ts.ta.p.t;
+				auto it_b = tp.cbegin();
+				if (t_start > h.data_period.start) {
+					it_b = std::upper_bound(tp.cbegin(), tp.cend(), t_start);
+					if (it_b != tp.cbegin())
+						std::advance(it_b, -1);
+				}
+				auto it_e = tp.cend();
+				core::utctime f_time = ts.ta.p.t_end;
+				if (t_end < h.data_period.end) {
+					it_e = std::upper_bound(it_b, tp.cend(), t_end);
+					if (it_e != tp.cend())
+						f_time = *it_e;
+				}
+				skip_n = std::distance(tp.cbegin(), it_b);
+				ta.p.t.assign(it_b, it_e);
+				ta.p.t_end = f_time;
+				ta = time_axis::intern(ta);
+			} break;
+			}
+		}
+		std::vector<double> v(ts.v.cbegin() + skip_n, ts.v.cbegin() + skip_n + ta.size());
+		return gts_t{ std::move(ta),std::move(v),h.point_fx };
+	}
+
+	/** \brief ts as r, with the time-axis as fixed_dt, if the points of its point_dt are regularly spaced,
+	 * or as calendar_dt, if they are months, quarters or years of one of the calendars of the container
+	 *
+	 * The values, point_fx, and the time-points are the same, so the series reads back with the same values,
+	 * while the file does not keep the time-points, and reads use the arithmetic of the regular time-axis.
+	 * \return false, leaving r as is, if ts is not a point_dt, or it is not regular
+	 */
+	bool normalized(const gts_t& ts, gts_t& r) const {
+		if (ts.ta.gt != time_axis::generic_dt::POINT || ts.ta.size() == 0)
+			return false;
+		const auto& t = ts.ta.p.t;
+		const std::size_t n = t.size();
+		auto at = [&t, n, &ts](std::size_t i) { return i < n ? t[i] : ts.ta.p.t_end; };
+		const core::utctimespan dt = at(1) - t[0];
+		bool fixed = dt > 0;
+		for (std::size_t i = 2; fixed && i <= n; ++i)
+			fixed = at(i) - at(i - 1) == dt;
+		if (fixed) {
+			r = gts_t(gta_t(t[0], dt, n), ts.v, ts.fx_policy);
+			return true;
+		}
+		for (core::utctimespan cdt : { core::calendar::MONTH, core::calendar::QUARTER, core::calendar::YEAR }) {
+			for (const auto& c : calendars) {
+				if (c.second->trim(t[0], cdt) != t[0])
+					continue;
+				bool regular = true;
+				for (std::size_t i = 1; regular && i <= n; ++i)
+					regular = c.second->add(t[0], cdt, long(i)) == at(i);
+				if (regular) {
+					r = gts_t(gta_t(c.second, t[0], cdt, n), ts.v, ts.fx_policy);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/** \return the stored series o, with n merged into it, as a save without overwrite merges the series of a file */
+	gts_t merge(const gts_t& o, const gts_t& n) const {
+		if (n.total_period().contains(o.total_period()))
+			return n;
+		check_ta_alignment(nullptr, mk_header(o), o.ta, n);
+		return o.ta.gt == time_axis::generic_dt::POINT ? merge_points(o, n) : merge_regular(o, n);
 	}
 
 	/** read a ts from specified file */
 	gts_t read(const std::string& fn, core::utcperiod p) const {
-		wait_for_close_fh();
+		if (wal)
+			wal->flush(fn);
 		std::string ffp = make_full_path(fn);
+		std::shared_lock<std::shared_timed_mutex> file_lock(ts_db_file_locks::of(ffp));
+#ifndef _WIN32
+		if (mmap_read) {
+			gts_t r;
+			if (read_mapped(ffp, p, r))
+				return r;
+		}
+#endif
 		std::unique_ptr<std::FILE, decltype(&std::fclose)> fh{ std::fopen(ffp.c_str(), "rb"), &std::fclose };
 		if(!fh.get()) {
 			throw std::runtime_error(std::string("shyft-read time-series internal: Could not open file ")+ffp );
@@ -288,10 +672,15 @@ public:
 	/** removes a ts from the container */
 	void remove(const std::string& fn) const {
 		wait_for_close_fh();
+		if (wal)
+			wal->flush(fn);
 		auto fp = make_full_path(fn);
+		std::unique_lock<std::shared_timed_mutex> file_lock(ts_db_file_locks::of(fp));
 		for (std::size_t retry = 0; retry < 10; ++retry) {
 			try {
 				fs::remove(fp);
+				if (catalogue)
+					catalogue->remove(catalogue_name(fp));
 				return;
 			} catch (...) { // windows usually fails, due to delayed file-close/file-release so we retry 10 x 0.3 seconds
 				std::this_thread::sleep_for(std::chrono::duration<int, std::milli>(300));
@@ -302,17 +691,31 @@ public:
 
 	/** get minimal ts-information from specified fn */
 	ts_info get_ts_info(const std::string& fn) const {
-		wait_for_close_fh();
-		auto ffp = make_full_path(fn);
-		std::unique_ptr<std::FILE, decltype(&std::fclose)> fh{ std::fopen(ffp.c_str(), "rb"), &std::fclose };
-		auto h = read_header(fh.get());
-		ts_info i;
-		i.name = fn;
-		i.point_fx = h.point_fx;
-		i.modified = utctime(fs::last_write_time(ffp));
-		i.data_period = h.data_period;
-		// consider time-axis type info, dt.. as well
-		return i;
+		if (wal)
+			wal->flush(fn);
+		const auto ffp = make_full_path(fn);
+		std::shared_lock<std::shared_timed_mutex> file_lock(ts_db_file_locks::of(ffp));
+		return read_ts_info(ffp, fn);
+	}
+
+	/** \brief the ts_info of each of fns, from the catalogue, so without opening the files
+	 *
+	 * A name not in the catalogue, like a file written by other means, is read from its file.
+	 * \return ts_info for each of fns, in order, for a name without a file only the name is set, and the data_period is invalid
+	 */
+	std::vector<ts_info> get_ts_infos(const std::vector<std::string>& fns) const {
+		flush_wal();
+		std::vector<ts_info> r(fns.size());
+		for (std::size_t i = 0; i < fns.size(); ++i) {
+			if (catalogue && catalogue->get(fns[i], r[i]))
+				continue;
+			r[i].name = fns[i];
+			const auto ffp = make_full_path(fns[i]);
+			std::shared_lock<std::shared_timed_mutex> file_lock(ts_db_file_locks::of(ffp));
+			if (fs::is_regular_file(ffp))
+				r[i] = read_ts_info(ffp, fns[i]);
+		}
+		return r;
 	}
 
 	/** find all ts_info s that matches the specified re match string
@@ -321,14 +724,16 @@ public:
 	 *    would find all time-series /hydmet_station/xxx_id/temperature
 	 */
 	std::vector<ts_info> find(const std::string& match) const {
-		wait_for_close_fh();
+		flush_wal();
+		if (catalogue)
+			return catalogue->find(match);
 		fs::path root(root_dir);
 		std::vector<ts_info> r;
 		std::regex r_match(match, std::regex_constants::ECMAScript | std::regex_constants::icase);
 		for (auto&& x : fs::recursive_directory_iterator(root)) {
 			if (fs::is_regular(x.path())) {
 				std::string fn = x.path().lexically_relative(root).generic_string(); // x.path() except root-part
-				if (std::regex_search(fn, r_match)) {
+				if (!ts_db_catalogue::is_internal(fn) && std::regex_search(fn, r_match)) {
 					r.push_back(get_ts_info(fn)); // TODO: maybe multi-core this into a job-queue
 				}
 			} else if (fs::is_directory(x.path())) {
@@ -340,7 +745,35 @@ public:
 		return r;
 	}
 
+	/** rebuild the find catalogue by scanning the container, e.g. after files are added to it by other means */
+	void rebuild_catalogue() {
+		wait_for_close_fh();
+		if (catalogue)
+			catalogue->rebuild([this](const std::string& ffp, const std::string& fn) { return read_ts_info(ffp, fn); });
+	}
+
 private:
+	static ts_info make_ts_info(const std::string& fn, const ts_db_header& h, utctime modified) {
+		ts_info i;
+		i.name = fn;
+		i.point_fx = h.point_fx;
+		i.modified = modified;
+		i.data_period = h.data_period;
+		// consider time-axis type info, dt.. as well
+		return i;
+	}
+	ts_info read_ts_info(const std::string& ffp, const std::string& fn) const {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> fh{ std::fopen(ffp.c_str(), "rb"), &std::fclose };
+		if (!fh)
+			throw std::runtime_error("dtss_store: failed to open " + ffp);
+		return make_ts_info(fn, read_header(fh.get()), utctime(fs::last_write_time(ffp)));
+	}
+	/** \return the name of the full path ffp in the catalogue, empty if outside the container */
+	std::string catalogue_name(const std::string& ffp) const {
+		auto fn = fs::path(ffp).lexically_relative(fs::path(root_dir)).generic_string();
+		return fn.size() && fn.compare(0, 2, "..") != 0 ? fn : std::string{};
+	}
+
 	std::shared_ptr<core::calendar> lookup_calendar(const std::string& tz) const {
 		auto it = calendars.find(tz);
 		if (it == calendars.end())
@@ -427,10 +860,36 @@ private:
 		write(fh, static_cast<const void*>(v.data()), sizeof(double)*v.size());
 	}
 	void write_ts(std::FILE * fh, const gts_t& ats) const {
+		if (ats.ta.gt == time_axis::generic_dt::POINT && point_block_n > 0) {
+			write_ts2(fh, ats, point_block_n);
+			return;
+		}
+		if (value_encoding != ts_db_encoding::raw) {
+			ts_db_header h = mk_header(ats);
+			h.signature[3] = char(value_encoding);
+			write(fh, static_cast<const void*>(&h), sizeof(h));
+			write_time_axis(fh, ats.ta);
+			write_encoded_values(fh, ats.v);
+			return;
+		}
 		write_header(fh, ats);
 		write_time_axis(fh, ats.ta);
 		write_values(fh, ats.v);
 	}
+	void write_encoded_values(std::FILE * fh, const std::vector<double>& v) const {
+		const uint32_t chunk_n = std::max<uint32_t>(1, value_chunk_n);
+		const uint32_t n_chunks = uint32_t((v.size() + chunk_n - 1) / chunk_n);
+		std::vector<uint64_t> chunk_end; chunk_end.reserve(n_chunks);
+		std::vector<uint8_t> d;
+		for (std::size_t i = 0; i < v.size(); i += chunk_n) {
+			codec::xor_encode(v.data() + i, std::min<std::size_t>(chunk_n, v.size() - i), d);
+			chunk_end.push_back(d.size());
+		}
+		write(fh, static_cast<const void*>(&chunk_n), sizeof(uint32_t));
+		write(fh, static_cast<const void*>(&n_chunks), sizeof(uint32_t));
+		write(fh, static_cast<const void*>(chunk_end.data()), sizeof(uint64_t)*chunk_end.size());
+		write(fh, static_cast<const void*>(d.data()), d.size());
+	}
 
 	// ----------
 
@@ -723,6 +1182,28 @@ private:
 			}
 		}
 	}
+	/** \brief append the values of ats to the end of a raw TS1 fixed_dt file, if ats starts where it ends
+	 *
+	 * The fast path of the merge for the common store of the newest values of a series,
+	 * the contiguity is given by the header, so only the new values and the header are written, and no old data is read.
+	 * \return false, leaving the file as it is, if ats is not a contiguous append, to be merged by merge_ts
+	 */
+	bool append_tail(std::FILE * fh, const ts_db_header & old_header, const gts_t & ats) const {
+		if (is_ts2(old_header) || encoding_of(old_header) != ts_db_encoding::raw || old_header.ta_type != time_axis::generic_dt::FIXED
+			|| ats.ta.gt != time_axis::generic_dt::FIXED || ats.fx_policy != old_header.point_fx || old_header.n == 0 || ats.size() == 0)
+			return false;
+		const core::utcperiod old_p = old_header.data_period;
+		if (ats.ta.f.t != old_p.end || ats.ta.f.dt*old_header.n != old_p.end - old_p.start)
+			return false;// not contiguous, or another dt
+		const long values_end = long(sizeof(ts_db_header) + 2 * sizeof(int64_t) + old_header.n * sizeof(double));
+		if (std::fseek(fh, 0, SEEK_END) != 0 || std::ftell(fh) != values_end)
+			return false;// not the layout of the header, let the merge deal with it
+		write(fh, static_cast<const void*>(ats.v.data()), ats.v.size() * sizeof(double));
+		const ts_db_header new_header{ old_header.point_fx, old_header.ta_type, uint32_t(old_header.n + ats.size()), core::utcperiod{ old_p.start, ats.ta.total_period().end } };
+		std::fseek(fh, 0, SEEK_SET);
+		write(fh, static_cast<const void*>(&new_header), sizeof(ts_db_header));
+		return true;
+	}
 	void merge_ts(std::FILE * fh, const ts_db_header & old_header, const gts_t & ats) const {
 		// read time-axis
 		std::size_t ignored{};
@@ -745,23 +1226,58 @@ private:
 		read(fh, static_cast<void *>(&h), sizeof(ts_db_header));
 		return h;
 	}
+	/** resolve open ends of the read period p, and \return false if it does not overlap the stored data */
+	static bool read_range(const ts_db_header& h, const utcperiod p, core::utctime& t_start, core::utctime& t_end) {
+		t_start = p.start == core::no_utctime ? core::min_utctime : p.start;
+		t_end = p.end == core::no_utctime ? core::max_utctime : p.end;
+		return !(h.data_period.end <= t_start || h.data_period.start >= t_end);
+	}
+	/** slice the stored fixed time-axis starting at t0 to [t_start..t_end>, dt preset in f */
+	static void slice_fixed(const ts_db_header& h, core::utctime t0, core::utctime t_start, core::utctime t_end, time_axis::fixed_dt& f, std::size_t& skip_n) {
+		// handle various overlaping periods
+		if (t_start <= h.data_period.start && t_end >= h.data_period.end) {
+			// fully around or exact
+			f.t = t0;
+			f.n = h.n;
+		} else {
+			std::size_t drop_n = 0;
+			if (t_start > h.data_period.start)  // start inside
+				skip_n = (t_start - h.data_period.start) / f.dt;
+			if (t_end < h.data_period.end)  // end inside
+				drop_n = (h.data_period.end - t_end) / f.dt;
+			// -----
+			f.t = t0 + f.dt*skip_n;
+			f.n = h.n - skip_n - drop_n;
+		}
+	}
+	/** slice the stored calendar time-axis starting at t0 to [t_start..t_end>, cal and dt preset in c */
+	static void slice_calendar(const ts_db_header& h, core::utctime t0, core::utctime t_start, core::utctime t_end, time_axis::calendar_dt& c, std::size_t& skip_n) {
+		// handle various overlaping periods
+		if (t_start <= h.data_period.start && t_end >= h.data_period.end) {
+			// fully around or exact
+			c.t = t0;
+			c.n = h.n;
+		} else {
+			std::size_t drop_n = 0;
+			if (t_start > h.data_period.start)  // start inside
+				skip_n = c.cal->diff_units(h.data_period.start, t_start, c.dt);
+			if (t_end < h.data_period.end)  // end inside
+				drop_n = c.cal->diff_units(t_end, h.data_period.end, c.dt);
+			// -----
+			c.t = c.cal->add(t0, c.dt, skip_n);
+			c.n = h.n - skip_n - drop_n;
+		}
+	}
 	gta_t read_time_axis(std::FILE * fh, const ts_db_header& h, const utcperiod p, std::size_t& skip_n) const {
 
 		// seek to beginning of time-axis
 		std::fseek(fh, sizeof(ts_db_header), SEEK_SET);
 
 		gta_t ta;
-		ta.gt = h.ta_type;
+		ta.set_type(h.ta_type);
 
-		core::utctime t_start = p.start;
-		core::utctime t_end = p.end;
-		if (t_start == core::no_utctime)
-			t_start = core::min_utctime;
-		if (t_end == core::no_utctime)
-			t_end = core::max_utctime;
-
-		// no overlap?
-		if (h.data_period.end <= t_start || h.data_period.start >= t_end) {
+		core::utctime t_start, t_end;
+		if (!read_range(h, p, t_start, t_end)) { // no overlap?
 			return ta;
 		}
 
@@ -772,21 +1288,7 @@ private:
 			// read start & step
 			read(fh, static_cast<void *>(&t0), sizeof(core::utctime));
 			read(fh, static_cast<void *>(&ta.f.dt), sizeof(core::utctimespan));
-			// handle various overlaping periods
-			if (t_start <= h.data_period.start && t_end >= h.data_period.end) {
-				// fully around or exact
-				ta.f.t = t0;
-				ta.f.n = h.n;
-			} else {
-				std::size_t drop_n = 0;
-				if (t_start > h.data_period.start)  // start inside
-					skip_n = (t_start - h.data_period.start) / ta.f.dt;
-				if (t_end < h.data_period.end)  // end inside
-					drop_n = (h.data_period.end - t_end) / ta.f.dt;
-				// -----
-				ta.f.t = t0 + ta.f.dt*skip_n;
-				ta.f.n = h.n - skip_n - drop_n;
-			}
+			slice_fixed(h, t0, t_start, t_end, ta.f, skip_n);
 		} break;
 		case time_axis::generic_dt::CALENDAR: {
 			// read start & step
@@ -802,28 +1304,15 @@ private:
 				tz.replace(0, sz, tmp_ptr.get(), sz);
 			}
 			ta.c.cal = lookup_calendar(tz);
-			// handle various overlaping periods
-			if (t_start <= h.data_period.start && t_end >= h.data_period.end) {
-				// fully around or exact
-				ta.c.t = t0;
-				ta.c.n = h.n;
-			} else {
-				std::size_t drop_n = 0;
-				if (t_start > h.data_period.start)  // start inside
-					skip_n = ta.c.cal->diff_units(h.data_period.start, t_start, ta.c.dt);
-				if (t_end < h.data_period.end)  // end inside
-					drop_n = ta.c.cal->diff_units(t_end, h.data_period.end, ta.c.dt);
-				// -----
-				ta.c.t = ta.c.cal->add(t0, ta.c.dt, skip_n);
-				ta.c.n = h.n - skip_n - drop_n;
-			}
+			slice_calendar(h, t0, t_start, t_end, ta.c, skip_n);
 		} break;
 		case time_axis::generic_dt::POINT: {
 			if (t_start <= h.data_period.start && t_end >= h.data_period.end) {
 				// fully around or exact
-				ta.p.t.resize(h.n);
+				auto& tp = ta.p.t.mut();
+				tp.resize(h.n);
 				read(fh, static_cast<void *>(&ta.p.t_end), sizeof(core::utctime));
-				read(fh, static_cast<void *>(ta.p.t.data()), sizeof(core::utctime)*h.n);
+				read(fh, static_cast<void *>(tp.data()), sizeof(core::utctime)*h.n);
 			} else {
 				core::utctime f_time = 0;
 				std::vector<core::utctime> tmp(h.n, 0.);
@@ -851,6 +1340,7 @@ private:
 				ta.p.t.assign(it_b, it_e);
 				ta.p.t_end = f_time;
 			}
+			ta = time_axis::intern(ta);// equal point time-axis of the stored series, are stored once
 		} break;
 		}
 		return ta;
@@ -876,18 +1366,308 @@ private:
 
 		const std::size_t points_n = ta.size();
 		std::vector<double> val(points_n, 0.);
-		std::fseek(fh, sizeof(double)*skip_n, SEEK_CUR);
-		read(fh, static_cast<void *>(val.data()), sizeof(double)*points_n);
+		switch (encoding_of(h)) {
+		case ts_db_encoding::raw: {
+			std::fseek(fh, sizeof(double)*skip_n, SEEK_CUR);
+			read(fh, static_cast<void *>(val.data()), sizeof(double)*points_n);
+		} break;
+		case ts_db_encoding::xor_delta: {
+			read_encoded_values(fh, h.n, skip_n, val);
+		} break;
+		default:
+			throw std::runtime_error("dtss_store: unknown value encoding");
+		}
 		return val;
 	}
+	/** read and decode the chunks covering values [skip_n..skip_n+val.size()> of n, fh positioned at the values */
+	void read_encoded_values(std::FILE * fh, const std::size_t n, const std::size_t skip_n, std::vector<double>& val) const {
+		if (val.empty())
+			return;
+		uint32_t chunk_n{}, n_chunks{};
+		read(fh, static_cast<void*>(&chunk_n), sizeof(uint32_t));
+		read(fh, static_cast<void*>(&n_chunks), sizeof(uint32_t));
+		const std::size_t k0 = skip_n / chunk_n, k1 = (skip_n + val.size() - 1) / chunk_n;
+		if (chunk_n == 0 || k1 >= n_chunks)
+			throw std::runtime_error("dtss_store: corrupt encoded values");
+		std::vector<uint64_t> chunk_end(n_chunks);
+		read(fh, static_cast<void*>(chunk_end.data()), sizeof(uint64_t)*n_chunks);
+		const uint64_t b0 = k0 ? chunk_end[k0 - 1] : 0;
+		std::vector<uint8_t> d(chunk_end[k1] - b0);
+		std::fseek(fh, long(b0), SEEK_CUR);
+		read(fh, static_cast<void*>(d.data()), d.size());
+		std::vector<double> tmp(chunk_n);
+		for (std::size_t k = k0, o = 0; k <= k1; ++k) {
+			const uint64_t cb = (k ? chunk_end[k - 1] : 0) - b0, ce = chunk_end[k] - b0;
+			const std::size_t i0 = k*chunk_n;// first value of the chunk
+			codec::xor_decode(d.data() + cb, ce - cb, std::min<std::size_t>(chunk_n, n - i0), tmp.data());
+			const std::size_t j0 = std::max(skip_n, i0) - i0, j1 = std::min<std::size_t>(skip_n + val.size(), i0 + chunk_n) - i0;
+			std::copy(tmp.begin() + j0, tmp.begin() + j1, val.begin() + o);
+			o += j1 - j0;
+		}
+	}
 	gts_t read_ts(std::FILE * fh, const utcperiod p) const {
 		std::size_t skip_n = 0u;
 		ts_db_header h = read_header(fh);
+		if (is_ts2(h))
+			return read_ts2(fh, h, p);
 		gta_t ta = read_time_axis(fh, h, p, skip_n);
 		std::vector<double> v = read_values(fh, h, ta, skip_n);
 		return gts_t{ std::move(ta),move(v),h.point_fx };
 	}
 
+	// ---------- TS2, blocked point_dt
+
+	static bool is_ts2(const ts_db_header& h) { return h.signature[2] == '2'; }
+	static ts_db_encoding encoding_of(const ts_db_header& h) { return ts_db_encoding(h.signature[3]); }
+
+	static std::size_t ts2_block_offset(const ts_db_block_info& b, std::size_t k) {
+		return sizeof(ts_db_header) + sizeof(ts_db_block_info) + k*b.block_n*(sizeof(core::utctime) + sizeof(double));
+	}
+	static uint32_t ts2_blocks(std::size_t n, uint32_t block_n) {
+		return uint32_t((n + block_n - 1) / block_n);
+	}
+	ts_db_block_info read_block_info(std::FILE * fh) const {
+		ts_db_block_info b;
+		std::fseek(fh, sizeof(ts_db_header), SEEK_SET);
+		read(fh, static_cast<void*>(&b), sizeof(ts_db_block_info));
+		if (b.block_n == 0)
+			throw std::runtime_error("dtss_store: corrupt TS2 block info");
+		return b;
+	}
+	std::vector<core::utctime> read_block_index(std::FILE * fh, const ts_db_block_info& b) const {
+		std::vector<core::utctime> ix(b.n_blocks);
+		std::fseek(fh, ts2_block_offset(b, b.n_blocks), SEEK_SET);
+		if (ix.size())
+			read(fh, static_cast<void*>(ix.data()), sizeof(core::utctime)*ix.size());
+		return ix;
+	}
+	/** read the time-points(values if !times) [i0..i1> from the blocks, appending them to r */
+	template <class T>
+	void read_block_range(std::FILE * fh, const ts_db_block_info& b, std::size_t i0, std::size_t i1, bool times, std::vector<T>& r) const {
+		while (i0 < i1) {
+			std::size_t k = i0 / b.block_n, j = i0 % b.block_n;
+			std::size_t m = std::min<std::size_t>(i1 - i0, b.block_n - j);
+			std::fseek(fh, ts2_block_offset(b, k) + (times ? 0 : b.block_n*sizeof(core::utctime)) + j*sizeof(T), SEEK_SET);
+			std::size_t o = r.size();
+			r.resize(o + m);
+			read(fh, static_cast<void*>(r.data() + o), m*sizeof(T));
+			i0 += m;
+		}
+	}
+	/** write time-points t and values v to the blocks, starting at point i0 */
+	void write_block_range(std::FILE * fh, const ts_db_block_info& b, std::size_t i0, const std::vector<core::utctime>& t, const std::vector<double>& v) const {
+		for (std::size_t i = 0; i < t.size();) {
+			std::size_t k = (i0 + i) / b.block_n, j = (i0 + i) % b.block_n;
+			std::size_t m = std::min<std::size_t>(t.size() - i, b.block_n - j);
+			std::fseek(fh, ts2_block_offset(b, k) + j*sizeof(core::utctime), SEEK_SET);
+			write(fh, static_cast<const void*>(t.data() + i), m*sizeof(core::utctime));
+			std::fseek(fh, ts2_block_offset(b, k) + b.block_n*sizeof(core::utctime) + j*sizeof(double), SEEK_SET);
+			write(fh, static_cast<const void*>(v.data() + i), m*sizeof(double));
+			i += m;
+		}
+	}
+	void write_block_index(std::FILE * fh, const ts_db_block_info& b, const std::vector<core::utctime>& ix) const {
+		std::fseek(fh, ts2_block_offset(b, b.n_blocks), SEEK_SET);
+		write(fh, static_cast<const void*>(ix.data()), sizeof(core::utctime)*ix.size());
+	}
+	void write_ts2_head(std::FILE * fh, const ts_db_header& h, const ts_db_block_info& b) const {
+		ts_db_header h2 = h;
+		h2.signature[2] = '2';
+		std::fseek(fh, 0, SEEK_SET);
+		write(fh, static_cast<const void*>(&h2), sizeof(ts_db_header));
+		write(fh, static_cast<const void*>(&b), sizeof(ts_db_block_info));
+	}
+	void write_ts2(std::FILE * fh, const gts_t& ats, uint32_t block_n) const {
+		const auto& t = ats.ta.p.t;
+		ts_db_block_info b{ ats.ta.p.t_end, block_n, ts2_blocks(t.size(), block_n) };
+		write_ts2_head(fh, mk_header(ats), b);
+		std::vector<core::utctime> ix; ix.reserve(b.n_blocks);
+		for (std::size_t k = 0; k < b.n_blocks; ++k)
+			ix.push_back(t[k*b.block_n]);
+		write_block_range(fh, b, 0, t, ats.v);
+		write_block_index(fh, b, ix);
+	}
+	gts_t read_ts2(std::FILE * fh, const ts_db_header& h, const utcperiod p) const {
+		auto b = read_block_info(fh);
+		gta_t ta;
+		ta.set_type(time_axis::generic_dt::POINT);
+		core::utctime t_start, t_end;
+		if (!read_range(h, p, t_start, t_end) || b.n_blocks == 0) { // no overlap?
+			return gts_t{ std::move(ta),std::vector<double>{},h.point_fx };
+		}
+		auto ix = read_block_index(fh, b);
+		// same slicing as for TS1 point_dt, limited to the blocks [k0..k1] overlapping [t_start..t_end]
+		std::size_t k0 = 0, k1 = b.n_blocks - 1;
+		if (t_start > h.data_period.start)
+			k0 = std::distance(ix.begin(), std::upper_bound(ix.begin(), ix.end(), t_start)) - 1;
+		if (t_end < h.data_period.end)
+			k1 = std::distance(ix.begin(), std::upper_bound(ix.begin(), ix.end(), t_end)) - 1;
+		const std::size_t o = k0*b.block_n;
+		std::vector<core::utctime> tmp;
+		read_block_range(fh, b, o, std::min<std::size_t>((k1 + 1)*b.block_n, h.n), true, tmp);
+		core::utctime f_time = b.t_end;
+		auto it_b = tmp.begin();
+		if (t_start > h.data_period.start) {
+			it_b = std::upper_bound(tmp.begin(), tmp.end(), t_start);
+			if (it_b != tmp.begin())
+				std::advance(it_b, -1);
+		}
+		auto it_e = tmp.end();
+		if (t_end < h.data_period.end) {
+			it_e = std::upper_bound(it_b, tmp.end(), t_end);
+			if (it_e != tmp.end())
+				f_time = *it_e;
+			else if (k1 + 1 < b.n_blocks)
+				f_time = ix[k1 + 1];
+		}
+		const std::size_t skip_n = o + std::distance(tmp.begin(), it_b);
+		ta.p.t.assign(it_b, it_e);
+		ta.p.t_end = f_time;
+		std::vector<double> v; v.reserve(ta.p.t.size());
+		read_block_range(fh, b, skip_n, skip_n + ta.p.t.size(), false, v);
+		ta = time_axis::intern(ta);// equal point time-axis of the stored series, are stored once
+		return gts_t{ std::move(ta),move(v),h.point_fx };
+	}
+	/** \brief merge ats into the TS2 file
+	 *
+	 * When ats extends the end of the stored series, only the blocks from the
+	 * start of ats, and the index are written. Otherwise the series is read,
+	 * merged as for TS1 point_dt, and rewritten.
+	 */
+	void merge_ts2(std::FILE * fh, const ts_db_header& old_header, const gts_t& ats) const {
+		check_ta_alignment(fh, old_header, gta_t{}, ats);// only the point_fx and ta type applies to point_dt
+		const utcperiod old_p = old_header.data_period, new_p = ats.total_period();
+		auto b = read_block_info(fh);
+		if (!(old_p.start < new_p.start && new_p.end >= old_p.end)) {
+			write_ts2(fh, merge_points(read_ts2(fh, old_header, old_p), ats), b.block_n);
+			return;
+		}
+		auto ix = read_block_index(fh, b);
+		// keep the old points before the start of ats
+		std::size_t k = std::distance(ix.begin(), std::lower_bound(ix.begin(), ix.end(), new_p.start)) - 1;
+		std::vector<core::utctime> tk;
+		read_block_range(fh, b, k*b.block_n, std::min<std::size_t>((k + 1)*b.block_n, old_header.n), true, tk);
+		const std::size_t keep_n = k*b.block_n + std::distance(tk.begin(), std::lower_bound(tk.begin(), tk.end(), new_p.start));
+		std::vector<core::utctime> t; t.reserve(ats.size() + 1);
+		std::vector<double> v; v.reserve(ats.size() + 1);
+		if (keep_n == old_header.n && new_p.start > b.t_end) {
+			t.push_back(b.t_end);  // include the end point
+			v.push_back(shyft::nan); // nan for the gap
+		}
+		t.insert(t.end(), ats.ta.p.t.cbegin(), ats.ta.p.t.cend());
+		v.insert(v.end(), ats.v.cbegin(), ats.v.cend());
+		const std::size_t n = keep_n + t.size();
+		b.t_end = ats.ta.p.t_end;
+		b.n_blocks = ts2_blocks(n, b.block_n);
+		ix.resize(b.n_blocks);
+		for (std::size_t j = keep_n; j < n; ++j)
+			if (j%b.block_n == 0)
+				ix[j / b.block_n] = t[j - keep_n];
+		write_block_range(fh, b, keep_n, t, v);
+		write_block_index(fh, b, ix);
+		write_ts2_head(fh, ts_db_header{ old_header.point_fx, old_header.ta_type, uint32_t(n), utcperiod{ old_p.start, b.t_end } }, b);
+	}
+	/** merge ats into the series of a TS1 file with encoded values, \return the merged series */
+	gts_t merge_encoded(std::FILE * fh, const ts_db_header& old_header, const gts_t& ats) const {
+		auto old_ts = read_ts(fh, old_header.data_period);
+		check_ta_alignment(fh, old_header, old_ts.ta, ats);
+		return old_header.ta_type == time_axis::generic_dt::POINT ? merge_points(old_ts, ats) : merge_regular(old_ts, ats);
+	}
+	/** in memory variant of the fixed_dt and calendar_dt merge of do_merge, \return o, with n merged into it */
+	static gts_t merge_regular(const gts_t& o, const gts_t& n) {
+		const utcperiod old_p = o.total_period(), new_p = n.total_period();
+		const core::utctime t0 = std::min(old_p.start, new_p.start), tn = std::max(old_p.end, new_p.end);
+		gta_t ta = o.ta.gt == time_axis::generic_dt::FIXED ?
+			gta_t(t0, o.ta.f.dt, std::size_t((tn - t0) / o.ta.f.dt)) :
+			gta_t(o.ta.c.cal, t0, o.ta.c.dt, std::size_t(o.ta.c.cal->diff_units(t0, tn, o.ta.c.dt)));
+		std::vector<double> v(ta.size(), shyft::nan);// nan for the gap, if any
+		std::copy(o.v.cbegin(), o.v.cend(), v.begin() + ta.index_of(old_p.start));
+		std::copy(n.v.cbegin(), n.v.cend(), v.begin() + ta.index_of(new_p.start));
+		return gts_t{ std::move(ta),std::move(v),o.point_interpretation() };
+	}
+	/** in memory variant of the point_dt merge of do_merge, \return o, with n merged into it */
+	static gts_t merge_points(const gts_t& o, const gts_t& n) {
+		const utcperiod old_p = o.total_period(), new_p = n.total_period();
+		const auto& ot = o.ta.p.t;
+		std::vector<core::utctime> t; t.reserve(o.size() + n.size() + 1);
+		std::vector<double> v; v.reserve(o.size() + n.size() + 1);
+		if (old_p.start < new_p.start) {
+			auto old_end = std::lower_bound(ot.cbegin(), ot.cend(), new_p.start);
+			t.insert(t.end(), ot.cbegin(), old_end);
+			v.insert(v.end(), o.v.cbegin(), o.v.cbegin() + std::distance(ot.cbegin(), old_end));
+			if (old_end == ot.cend() && new_p.start > o.ta.p.t_end) {
+				t.push_back(o.ta.p.t_end);  // include the end point
+				v.push_back(shyft::nan);      // nan for the gap
+			}
+		}
+		t.insert(t.end(), n.ta.p.t.cbegin(), n.ta.p.t.cend());
+		v.insert(v.end(), n.v.cbegin(), n.v.cend());
+		core::utctime t_end = n.ta.p.t_end;
+		if (new_p.end < old_p.end) {
+			t.push_back(t_end);
+			if (new_p.end < old_p.start)
+				v.push_back(shyft::nan);
+			auto old_begin = std::upper_bound(ot.cbegin(), ot.cend(), n.ta.p.t_end);
+			t.insert(t.end(), old_begin, ot.cend());
+			std::size_t to_insert = std::distance(old_begin, ot.cend()) + (new_p.end >= old_p.start ? 1 : 0);
+			v.insert(v.end(), o.v.cend() - to_insert, o.v.cend());
+			t_end = o.ta.p.t_end;
+		}
+		return gts_t{ gta_t(time_axis::point_dt(std::move(t), t_end)),std::move(v),o.point_interpretation() };
+	}
+
+#ifndef _WIN32
+	/** \brief read fixed_dt or calendar_dt series through a memory map
+	 *
+	 * The read period is mapped to the byte range of the values it covers,
+	 * and exactly that range is copied, so only the pages touched by the
+	 * header, time-axis and the requested values are paged in.
+	 *
+	 * \return false if the file could not be mapped, or holds a point_dt series, leaving it to read_ts
+	 */
+	bool read_mapped(const std::string& ffp, const utcperiod p, gts_t& r) const {
+		mapped_file m(ffp);
+		if (!m.d)
+			return false;
+		ts_db_header h;
+		m.read(0, static_cast<void*>(&h), sizeof(ts_db_header));
+		if (is_ts2(h) || encoding_of(h) != ts_db_encoding::raw || (h.ta_type != time_axis::generic_dt::FIXED && h.ta_type != time_axis::generic_dt::CALENDAR))
+			return false;
+
+		gta_t ta;
+		ta.set_type(h.ta_type);
+		std::size_t o = sizeof(ts_db_header);
+		core::utctime t0 = core::no_utctime;
+		core::utctimespan dt{};
+		m.read(o, static_cast<void*>(&t0), sizeof(core::utctime)); o += sizeof(core::utctime);
+		m.read(o, static_cast<void*>(&dt), sizeof(core::utctimespan)); o += sizeof(core::utctimespan);
+		std::string tz;
+		if (h.ta_type == time_axis::generic_dt::CALENDAR) {
+			uint32_t sz{ 0 };
+			m.read(o, static_cast<void*>(&sz), sizeof(uint32_t)); o += sizeof(uint32_t);
+			tz.resize(sz);
+			m.read(o, &tz[0], sz); o += sz;
+		}
+		std::size_t skip_n = 0;
+		core::utctime t_start, t_end;
+		if (read_range(h, p, t_start, t_end)) {
+			if (h.ta_type == time_axis::generic_dt::FIXED) {
+				ta.f.dt = dt;
+				slice_fixed(h, t0, t_start, t_end, ta.f, skip_n);
+			} else {
+				ta.c.dt = dt;
+				ta.c.cal = lookup_calendar(tz);
+				slice_calendar(h, t0, t_start, t_end, ta.c, skip_n);
+			}
+		}
+		std::vector<double> v(ta.size(), 0.);
+		if (v.size())
+			m.read(o + sizeof(double)*skip_n, static_cast<void*>(v.data()), sizeof(double)*v.size());
+		r = gts_t{ std::move(ta),move(v),h.point_fx };
+		return true;
+	}
+#endif
+
 };
 
 }
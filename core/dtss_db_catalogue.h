@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <boost/filesystem.hpp>
+
+#include "time_series_info.h"
+
+namespace shyft {
+namespace dtss {
+
+/** \brief persistent catalogue of the ts_info of the files in a ts_db container
+ *
+ * Keeps name -> ts_info in memory, so ts_db::find is served without a directory scan,
+ * and without opening the files.
+ *
+ * The catalogue is persisted as an append-only log in the container root,
+ *   <log>    -> <record>*
+ *   <record> -> 'P' <name_sz> uint32_t <name> uint8_t[<name_sz>] <point_fx> uint8_t <data_period> int64_t int64_t <modified> int64_t
+ *            |  'R' <name_sz> uint32_t <name> uint8_t[<name_sz>]
+ * replayed on open, and compacted when it holds more than twice the live entries.
+ * If there is no log, the catalogue is built by scanning the container once.
+ *
+ * The entries are ordered by the lower case name, so a find with a '^' anchored pattern
+ * only visits the entries starting with the literal prefix of the pattern.
+ *
+ * \note one catalogue is shared by all ts_db of the same root in the process, ref. open.
+ *       Files written to the container by other means are not seen until rebuild().
+ */
+struct ts_db_catalogue {
+	/** \return name of the log file in the container root */
+	static const char* log_name() { return ".ts_db.catalogue"; }
+
+	/** \return true if fn is one of the files the ts_db keeps in the container root, like the log */
+	static bool is_internal(const std::string& fn) { return fn.compare(0, 7, ".ts_db.") == 0; }
+
+	/** \brief the catalogue of the container at root_dir, shared with other ts_db of the same root
+	 *
+	 * \param root_dir the container root
+	 * \param ts_info_of callable ts_info(full_path, name), used to build the catalogue if there is no log
+	 */
+	template <class F>
+	static std::shared_ptr<ts_db_catalogue> open(const std::string& root_dir, F&& ts_info_of) {
+		namespace fs = boost::filesystem;
+		const std::string key = fs::weakly_canonical(fs::path(root_dir)).generic_string();
+		auto& reg = registry();
+		std::lock_guard<std::mutex> guard(reg.mx);
+		auto c = reg.catalogues[key].lock();
+		if (!c) {
+			c = std::make_shared<ts_db_catalogue>(root_dir);
+			if (!c->replay())
+				c->rebuild(ts_info_of);
+			reg.catalogues[key] = c;
+		}
+		return c;
+	}
+
+	explicit ts_db_catalogue(const std::string& root_dir) :root(root_dir) {}
+	~ts_db_catalogue() {
+		if (log)
+			std::fclose(log);
+	}
+	ts_db_catalogue(const ts_db_catalogue&) = delete;
+	ts_db_catalogue& operator=(const ts_db_catalogue&) = delete;
+
+	/** add or replace the entry of i.name */
+	void put(const ts_info& i) {
+		std::lock_guard<std::mutex> guard(mx);
+		entries[key_of(i.name)] = i;
+		append('P', i);
+	}
+
+	/** remove the entry of name, if any */
+	void remove(const std::string& name) {
+		std::lock_guard<std::mutex> guard(mx);
+		if (entries.erase(key_of(name))) {
+			ts_info i; i.name = name;
+			append('R', i);
+		}
+	}
+
+	/** \return the ts_info of the entries that matches the regular expression match, as ts_db::find */
+	std::vector<ts_info> find(const std::string& match) const {
+		std::regex r_match(match, std::regex_constants::ECMAScript | std::regex_constants::icase);
+		const std::string prefix = to_lower(literal_prefix(match));
+		std::vector<ts_info> r;
+		std::lock_guard<std::mutex> guard(mx);
+		for (auto it = entries.lower_bound(prefix); it != entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+			if (std::regex_search(it->second.name, r_match))
+				r.push_back(it->second);
+		}
+		return r;
+	}
+
+	/** \return true and sets r to the entry of name, if any */
+	bool get(const std::string& name, ts_info& r) const {
+		std::lock_guard<std::mutex> guard(mx);
+		auto f = entries.find(key_of(name));
+		if (f == entries.end())
+			return false;
+		r = f->second;
+		return true;
+	}
+
+	/** \return number of entries */
+	std::size_t size() const {
+		std::lock_guard<std::mutex> guard(mx);
+		return entries.size();
+	}
+
+	/** rebuild the catalogue by scanning the container, reading the header of each file with ts_info_of(path,name) */
+	template <class F>
+	void rebuild(F&& ts_info_of) {
+		namespace fs = boost::filesystem;
+		std::map<std::string, ts_info> e;
+		fs::path root_path(root);
+		if (fs::is_directory(root_path)) {
+			for (auto&& x : fs::recursive_directory_iterator(root_path)) {
+				if (fs::is_regular(x.path())) {
+					std::string fn = x.path().lexically_relative(root_path).generic_string();
+					if (is_internal(fn))
+						continue;
+					try {
+						e[key_of(fn)] = ts_info_of(x.path().string(), fn);
+					} catch (...) { // not a ts_db file, skip it
+					}
+				}
+			}
+		}
+		std::lock_guard<std::mutex> guard(mx);
+		entries = std::move(e);
+		compact();
+	}
+
+	/** \return the literal prefix of a '^' anchored regular expression, or empty if not anchored */
+	static std::string literal_prefix(const std::string& match) {
+		if (match.empty() || match[0] != '^' || match.find('|') != std::string::npos)
+			return std::string{};
+		std::string p;
+		for (std::size_t i = 1; i < match.size(); ++i) {
+			const char c = match[i];
+			if (std::strchr(".[]{}()*+?^$\\", c)) {
+				if (p.size() && (c == '*' || c == '?' || c == '{'))
+					p.pop_back();// the last literal is optional
+				break;
+			}
+			p.push_back(c);
+		}
+		return p;
+	}
+
+	static std::string to_lower(std::string s) {
+		std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+		return s;
+	}
+	/** entries are ordered by the lower case name first, so a prefix of it gives a range, then by the name */
+	static std::string key_of(const std::string& name) {
+		std::string k = to_lower(name);
+		k.push_back('\0');
+		return k + name;
+	}
+
+private:
+	struct registry_t {
+		std::mutex mx;
+		std::map<std::string, std::weak_ptr<ts_db_catalogue>> catalogues;
+	};
+	static registry_t& registry() { static registry_t r; return r; }
+
+	std::string log_path() const { return (boost::filesystem::path(root) / log_name()).string(); }
+
+	static void write_record(std::FILE* f, char op, const ts_info& i) {
+		const uint32_t sz = uint32_t(i.name.size());
+		std::fwrite(&op, 1, 1, f);
+		std::fwrite(&sz, sizeof(sz), 1, f);
+		std::fwrite(i.name.data(), 1, sz, f);
+		if (op == 'P') {
+			const uint8_t fx = uint8_t(i.point_fx);
+			const int64_t d[3] = { int64_t(i.data_period.start), int64_t(i.data_period.end), int64_t(i.modified) };
+			std::fwrite(&fx, 1, 1, f);
+			std::fwrite(d, sizeof(d), 1, f);
+		}
+	}
+	void append(char op, const ts_info& i) {
+		if (!log)
+			log = std::fopen(log_path().c_str(), "ab");
+		if (!log)
+			return;// the catalogue is still valid in memory, and rebuilt by the next process
+		write_record(log, op, i);
+		std::fflush(log);
+		if (++n_records > 2 * entries.size() + 1000)
+			compact();
+	}
+	/** rewrite the log with the live entries only */
+	void compact() {
+		if (log) {
+			std::fclose(log);
+			log = nullptr;
+		}
+		const std::string fn = log_path(), tmp = fn + ".tmp";
+		std::FILE* f = std::fopen(tmp.c_str(), "wb");
+		if (!f)
+			return;
+		for (const auto& e : entries)
+			write_record(f, 'P', e.second);
+		std::fclose(f);
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmp, fn, ec);
+		n_records = entries.size();
+	}
+	/** replay the log, \return false if there is no log, or it is damaged, e.g. by a crash while writing it */
+	bool replay() {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen(log_path().c_str(), "rb"), &std::fclose };
+		if (!f)
+			return false;
+		char op;
+		while (std::fread(&op, 1, 1, f.get()) == 1) {
+			uint32_t sz{ 0 };
+			if (std::fread(&sz, sizeof(sz), 1, f.get()) != 1)
+				return false;
+			if (sz > 0xffff)
+				return false;
+			ts_info i;
+			i.name.resize(sz);
+			if (sz && std::fread(&i.name[0], 1, sz, f.get()) != sz)
+				return false;
+			if (op == 'P') {
+				uint8_t fx;
+				int64_t d[3];
+				if (std::fread(&fx, 1, 1, f.get()) != 1 || std::fread(d, sizeof(d), 1, f.get()) != 1)
+					return false;
+				i.point_fx = time_series::ts_point_fx(fx);
+				i.data_period = utcperiod(utctime(d[0]), utctime(d[1]));
+				i.modified = utctime(d[2]);
+				entries[key_of(i.name)] = i;
+			} else if (op == 'R') {
+				entries.erase(key_of(i.name));
+			} else {
+				return false;
+			}
+			++n_records;
+		}
+		return true;
+	}
+
+	std::string root; ///< the container root
+	mutable std::mutex mx; ///< protects entries and the log
+	std::map<std::string, ts_info> entries; ///< key_of(name) -> ts_info
+	std::FILE* log = nullptr; ///< the log, opened for append on the first change
+	std::size_t n_records = 0; ///< records in the log
+};
+
+}
+}
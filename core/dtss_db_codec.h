@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+namespace shyft {
+    namespace dtss {
+        /** \brief xor-delta value codec for the ts_db
+         *
+         * Each value is xor'ed with the previous one (the first with 0.0), so equal consecutive values gives 0,
+         * and slowly changing values shares sign, exponent and the upper mantissa bits, giving leading zero bytes.
+         * Values with few significant digits gives trailing zero bytes.
+         *
+         * A block of n values is encoded byte aligned as two streams,
+         *   <tag>     -> uint8_t[n] // (leading zero bytes) << 4 | (trailing zero bytes)
+         *   <payload> -> the remaining middle bytes of each xor, little endian
+         * so the payload position of each value is a prefix sum of the tags, and no bit-level unpacking is needed.
+         *
+         * \note like the rest of the ts_db format, this assumes a little-endian cpu-arch
+         */
+        namespace codec {
+            using std::size_t;
+
+            inline uint64_t bits_of(double x) { uint64_t b; std::memcpy(&b, &x, sizeof(b)); return b; }
+            inline double double_of(uint64_t b) { double x; std::memcpy(&x, &b, sizeof(x)); return x; }
+
+            /** \return number of leading zero bytes of x, x != 0 */
+            inline int leading_zero_bytes(uint64_t x) {
+#ifdef __GNUC__
+                return __builtin_clzll(x) >> 3;
+#else
+                int n = 0;
+                while ((x >> 56) == 0) { x <<= 8; ++n; }
+                return n;
+#endif
+            }
+            /** \return number of trailing zero bytes of x, x != 0 */
+            inline int trailing_zero_bytes(uint64_t x) {
+#ifdef __GNUC__
+                return __builtin_ctzll(x) >> 3;
+#else
+                int n = 0;
+                while ((x & 0xff) == 0) { x >>= 8; ++n; }
+                return n;
+#endif
+            }
+
+            /** append the xor-delta encoding of the n values v to out */
+            inline void xor_encode(const double* v, size_t n, std::vector<uint8_t>& out) {
+                const size_t tag_o = out.size();
+                out.resize(tag_o + n);
+                uint64_t prev = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t b = bits_of(v[i]);
+                    uint64_t x = b ^ prev;
+                    prev = b;
+                    if (x == 0) {
+                        out[tag_o + i] = uint8_t(8 << 4);
+                        continue;
+                    }
+                    int lz = leading_zero_bytes(x), tz = trailing_zero_bytes(x);
+                    int m = 8 - lz - tz;
+                    out[tag_o + i] = uint8_t(lz << 4 | tz);
+                    uint64_t y = x >> (8*tz);
+                    const size_t o = out.size();
+                    out.resize(o + m);
+                    std::memcpy(out.data() + o, &y, m);
+                }
+            }
+
+            /** decode n values from the sz bytes at d into v, throws if d is not a valid encoding of n values */
+            inline void xor_decode(const uint8_t* d, size_t sz, size_t n, double* v) {
+                if (sz < n)
+                    throw std::runtime_error("dtss_store: corrupt xor encoded values");
+                const uint8_t* p = d + n;
+                const uint8_t* e = d + sz;
+                uint64_t prev = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    const int lz = d[i] >> 4, tz = d[i] & 0x0f;
+                    const int m = 8 - lz - tz;
+                    if (m < 0 || p + m > e)
+                        throw std::runtime_error("dtss_store: corrupt xor encoded values");
+                    uint64_t y = 0;
+                    std::memcpy(&y, p, m);
+                    p += m;
+                    prev ^= m ? y << (8*tz) : 0;
+                    v[i] = double_of(prev);
+                }
+            }
+        }
+    }
+}
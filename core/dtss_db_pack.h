@@ -0,0 +1,458 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "dtss_db.h"
+
+namespace shyft {
+namespace dtss {
+
+/** \brief a ts_db container keeping its series in a few large append-only pack files, for millions of small series
+ *
+ * A file per series, as ts_db, costs a file-system entry, an open and a close per save and read,
+ * that dominates when the series are small, like the series of many stations.
+ * Here a save appends a record to the active pack, and the index of the series, name -> record,
+ * is kept in memory, so a read is a seek and one read in a pack, and find and get_ts_infos is served from the index.
+ *
+ * The packs are kept in the container root, as .ts_db.pack.<k>, k ascending,
+ *   <pack>   -> <record>*
+ *   <record> -> <op> uint8_t <name_sz> uint32_t <name> uint8_t[<name_sz>] <modified> int64_t
+ *               <payload_sz> uint64_t <payload> uint8_t[<payload_sz>] <check> uint64_t
+ * where op is 'P' for a save and 'R' for a remove, the payload of a save is the series laid out as
+ * in the write-ahead log of ts_db, ref. ts_db::wal_payload, and check is the fnv-1a hash of name and payload.
+ * The index is rebuilt on open by reading the packs in order, the last record of a name wins,
+ * and a record torn by a crash ends the pack it is in.
+ * A new pack is started when the active pack exceeds max_pack_size, and compact() rewrites
+ * the live records of the closed packs, when most of them are replaced or removed.
+ *
+ * A save without overwrite merges the series in memory, as ts_db merges the series of a file, and appends the result.
+ *
+ * \note only one ts_db_pack should be open for a container root, and the root should not be shared with a ts_db.
+ */
+struct ts_db_pack : its_db {
+	/** \return the prefix of the names of the pack files in the container root */
+	static const char* pack_prefix() { return ".ts_db.pack."; }
+
+	/** open the container at root_dir, creating it if needed, and read the index from the packs
+	 *
+	 * \param max_pack_size bytes of a pack, before the next is started
+	 * \param sync if true, each save is fsync'ed before it returns
+	 */
+	explicit ts_db_pack(const std::string& root_dir, uint64_t max_pack_size = uint64_t(1) << 30, bool sync = false)
+		:root_dir(root_dir), max_pack_size(std::min<uint64_t>(max_pack_size, uint64_t(1) << 30)), sync(sync) {
+		namespace fs = boost::filesystem;
+		if (!fs::is_directory(root_dir)) {
+			if (fs::exists(root_dir) || !fs::create_directories(root_dir))
+				throw std::runtime_error(std::string("ts_db_pack: failed to create root directory :") + root_dir);
+		}
+		open_packs();
+	}
+	~ts_db_pack() {
+		if (active)
+			std::fclose(active);
+	}
+	ts_db_pack(const ts_db_pack&) = delete;
+	ts_db_pack& operator=(const ts_db_pack&) = delete;
+
+	/** save ts as fn, as ts_db::save */
+	void save(const std::string& fn, const gts_t& ts, bool overwrite = true, bool /*win_thread_close*/ = true) const {
+		save(std::vector<std::pair<std::string, const gts_t*>>{ { fn, &ts } }, overwrite);
+	}
+
+	/** save the series tsv[i].second as tsv[i].first, appended as one write to the active pack */
+	void save(const std::vector<std::pair<std::string, const gts_t*>>& tsv, bool overwrite = true) const {
+		std::lock_guard<std::mutex> write_guard(write_mx);
+		const utctime modified = core::utctime_now();
+		std::vector<record> rs;
+		rs.reserve(tsv.size());
+		std::unordered_map<std::string, std::size_t> in_batch;// name -> last record of it in rs, for the merge
+		for (const auto& x : tsv) {
+			check_name(x.first);
+			if (overwrite) {
+				rs.push_back(record{ 'P', x.first, modified, codec.wal_payload(*x.second) });
+			} else {
+				gts_t old_ts;
+				bool exists = false;
+				auto b = in_batch.find(x.first);
+				if (b != in_batch.end()) {// saved earlier in the batch
+					old_ts = codec.wal_ts(rs[b->second].payload);
+					exists = true;
+				} else {
+					exists = read_stored(x.first, old_ts);
+				}
+				rs.push_back(record{ 'P', x.first, modified, codec.wal_payload(exists ? codec.merge(old_ts, *x.second) : *x.second) });
+			}
+			in_batch[x.first] = rs.size() - 1;
+		}
+		append(rs);
+	}
+
+	/** read the part of fn that overlaps p */
+	gts_t read(const std::string& fn, core::utcperiod p) const {
+		gts_t ts;
+		if (!read_stored(fn, ts))
+			throw std::runtime_error("ts_db_pack: no series " + fn + " in " + root_dir);
+		return codec.slice(ts, p);
+	}
+
+	/** remove fn from the container, if it is there */
+	void remove(const std::string& fn) const {
+		std::lock_guard<std::mutex> write_guard(write_mx);
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			if (index.find(ts_db_catalogue::key_of(fn)) == index.end())
+				return;
+		}
+		append(std::vector<record>{ record{ 'R', fn, core::utctime_now(), std::string{} } });
+	}
+
+	/** \return the ts_info of fn, throws if it is not there */
+	ts_info get_ts_info(const std::string& fn) const {
+		std::lock_guard<std::mutex> guard(mx);
+		auto f = index.find(ts_db_catalogue::key_of(fn));
+		if (f == index.end())
+			throw std::runtime_error("ts_db_pack: no series " + fn + " in " + root_dir);
+		return f->second.info;
+	}
+
+	/** \return the ts_info of each of fns, as ts_db::get_ts_infos */
+	std::vector<ts_info> get_ts_infos(const std::vector<std::string>& fns) const {
+		std::vector<ts_info> r(fns.size());
+		std::lock_guard<std::mutex> guard(mx);
+		for (std::size_t i = 0; i < fns.size(); ++i) {
+			auto f = index.find(ts_db_catalogue::key_of(fns[i]));
+			if (f != index.end())
+				r[i] = f->second.info;
+			else
+				r[i].name = fns[i];
+		}
+		return r;
+	}
+
+	/** find the series matching the regular expression match, as ts_db::find, a '^' anchored match visits only its literal prefix */
+	std::vector<ts_info> find(const std::string& match) const {
+		std::regex r_match(match, std::regex_constants::ECMAScript | std::regex_constants::icase);
+		const std::string prefix = ts_db_catalogue::to_lower(ts_db_catalogue::literal_prefix(match));
+		std::vector<ts_info> r;
+		std::lock_guard<std::mutex> guard(mx);
+		for (auto it = index.lower_bound(prefix); it != index.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+			if (std::regex_search(it->second.info.name, r_match))
+				r.push_back(it->second.info);
+		}
+		return r;
+	}
+
+	/** \brief rewrite the live records of the closed packs to the active pack, and delete them, if less than min_live of their bytes are live
+	 *
+	 * All closed packs are rewritten, not only the sparse ones, so a remove record is never dropped
+	 * while a pack with a save it overrides is kept. Reads in progress keeps the packs they use until they are done.
+	 * \return the number of packs deleted
+	 */
+	std::size_t compact(double min_live = 0.5) const {
+		std::lock_guard<std::mutex> write_guard(write_mx);
+		std::vector<std::shared_ptr<pack_file>> closed;
+		std::vector<std::pair<std::string, entry>> moved;
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			uint64_t bytes = 0, live = 0;
+			for (std::size_t k = 0; k + 1 < packs.size(); ++k) {
+				bytes += packs[k]->bytes;
+				live += packs[k]->live;
+			}
+			if (bytes == 0 || double(live) >= min_live*double(bytes))
+				return 0;
+			closed.assign(packs.begin(), packs.end() - 1);
+			for (const auto& x : index)
+				if (x.second.pack != packs.back())
+					moved.emplace_back(x.second.info.name, x.second);
+		}
+		std::vector<record> rs;
+		uint64_t rs_bytes = 0;
+		for (const auto& x : moved) {
+			rs.push_back(record{ 'P', x.first, x.second.info.modified, read_payload(x.second) });
+			rs_bytes += rs.back().payload.size();
+			if (rs_bytes > max_pack_size/16) {// bounded memory, the records are acknowledged by append
+				append(rs);
+				rs.clear();
+				rs_bytes = 0;
+			}
+		}
+		if (rs.size())
+			append(rs);
+		std::lock_guard<std::mutex> guard(mx);
+		for (auto& p : closed) {
+			p->obsolete = true;// deleted by the last reader of it
+			packs.erase(std::find(packs.begin(), packs.end(), p));
+		}
+		return closed.size();
+	}
+
+	/** \return the number of series */
+	std::size_t size() const {
+		std::lock_guard<std::mutex> guard(mx);
+		return index.size();
+	}
+
+	/** \return the number of pack files */
+	std::size_t pack_count() const {
+		std::lock_guard<std::mutex> guard(mx);
+		return packs.size();
+	}
+
+	std::string root_dir; ///< root_dir points to the top of the container
+
+private:
+	/** a pack file, deleted when the last user of it is done, if it is obsolete */
+	struct pack_file {
+		std::string path;
+		uint64_t bytes = 0; ///< bytes of the pack, protected by mx
+		uint64_t live = 0; ///< bytes of the records in the index, protected by mx
+		bool obsolete = false; ///< set by compact, protected by mx
+		explicit pack_file(std::string path) :path(std::move(path)) {}
+		~pack_file() {
+			if (obsolete) {
+				boost::system::error_code ec;
+				boost::filesystem::remove(path, ec);
+			}
+		}
+	};
+	/** the last record of a name */
+	struct entry {
+		std::shared_ptr<pack_file> pack;
+		uint64_t offset = 0; ///< of the payload in the pack
+		uint64_t payload_sz = 0;
+		uint64_t record_sz = 0;
+		ts_info info;
+	};
+	struct record {
+		char op;
+		std::string name;
+		utctime modified;
+		std::string payload;
+	};
+
+	static uint64_t fnv1a(const std::string& s, uint64_t h = 0xcbf29ce484222325ull) {
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+	template<class T>
+	static void put(std::string& b, const T& x) { b.append(reinterpret_cast<const char*>(&x), sizeof(T)); }
+	static std::size_t head_size(const std::string& name) { return 1 + sizeof(uint32_t) + name.size() + sizeof(int64_t) + sizeof(uint64_t); }
+
+	static void check_name(const std::string& fn) {
+		if (fn.empty() || fn.size() > 0xffff)
+			throw std::runtime_error("ts_db_pack: invalid series name '" + fn + "'");
+	}
+
+	static ts_info make_ts_info(const std::string& name, const std::string& payload, utctime modified) {
+		ts_db_header h;
+		if (payload.size() < sizeof(h))
+			throw std::runtime_error("ts_db_pack: corrupt record of " + name);
+		std::memcpy(&h, payload.data(), sizeof(h));
+		ts_info i;
+		i.name = name;
+		i.point_fx = h.point_fx;
+		i.modified = modified;
+		i.data_period = h.data_period;
+		return i;
+	}
+
+	/** put the record r, at offset o of pack p, in the index, mx must be held */
+	void apply(const record& r, const std::shared_ptr<pack_file>& p, uint64_t o) const {
+		const auto key = ts_db_catalogue::key_of(r.name);
+		auto f = index.find(key);
+		if (f != index.end()) {
+			f->second.pack->live -= f->second.record_sz;
+			if (r.op == 'R')
+				index.erase(f);
+		}
+		if (r.op != 'P')
+			return;
+		entry& e = index[key];
+		e.pack = p;
+		e.offset = o + head_size(r.name);
+		e.payload_sz = r.payload.size();
+		e.record_sz = head_size(r.name) + r.payload.size() + sizeof(uint64_t);
+		e.info = make_ts_info(r.name, r.payload, r.modified);
+		p->live += e.record_sz;
+	}
+
+	/** append the records rs to the active pack in one write, and put them in the index, write_mx must be held */
+	void append(const std::vector<record>& rs) const {
+		std::string b;
+		for (const auto& r : rs) {
+			b.push_back(r.op);
+			put(b, uint32_t(r.name.size()));
+			b += r.name;
+			put(b, int64_t(r.modified));
+			put(b, uint64_t(r.payload.size()));
+			b += r.payload;
+			put(b, fnv1a(r.payload, fnv1a(r.name)));
+		}
+		std::shared_ptr<pack_file> p;
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			if (packs.back()->bytes && packs.back()->bytes + b.size() > max_pack_size)
+				start_pack();
+			p = packs.back();
+		}
+		const uint64_t o = p->bytes;// only changed by the writer
+		if (std::fwrite(b.data(), 1, b.size(), active) != b.size() || std::fflush(active) != 0 || (sync && !sync_active())) {
+			boost::system::error_code ec;
+			boost::filesystem::resize_file(p->path, o, ec);// drop the partial write, the pack is opened for append
+			throw std::runtime_error("ts_db_pack: failed to write " + p->path);
+		}
+		std::lock_guard<std::mutex> guard(mx);
+		p->bytes = o + b.size();
+		uint64_t ro = o;
+		for (const auto& r : rs) {
+			apply(r, p, ro);
+			ro += head_size(r.name) + r.payload.size() + sizeof(uint64_t);
+		}
+	}
+	bool sync_active() const {
+#ifdef _WIN32
+		return _commit(_fileno(active)) == 0;
+#else
+		return fsync(fileno(active)) == 0;
+#endif
+	}
+
+	/** close the active pack, and start the next one, mx must be held */
+	void start_pack() const {
+		const std::size_t k = packs.empty() ? 0 : number_of(packs.back()->path) + 1;
+		auto p = std::make_shared<pack_file>((boost::filesystem::path(root_dir) / (pack_prefix() + std::to_string(k))).string());
+		std::FILE* f = std::fopen(p->path.c_str(), "ab");
+		if (!f)
+			throw std::runtime_error("ts_db_pack: failed to create " + p->path);
+		if (active)
+			std::fclose(active);
+		active = f;
+		packs.push_back(std::move(p));
+	}
+	static std::size_t number_of(const std::string& path) {
+		const std::string fn = boost::filesystem::path(path).filename().string();
+		return std::size_t(std::stoull(fn.substr(std::strlen(pack_prefix()))));
+	}
+
+	/** read the packs of the container, in order, into the index, and open the last for append */
+	void open_packs() {
+		namespace fs = boost::filesystem;
+		std::vector<std::pair<std::size_t, std::string>> found;
+		const std::string prefix = pack_prefix();
+		for (auto&& x : fs::directory_iterator(fs::path(root_dir))) {
+			const std::string fn = x.path().filename().string();
+			if (fs::is_regular_file(x.path()) && fn.compare(0, prefix.size(), prefix) == 0 && fn.size() > prefix.size()
+				&& std::all_of(fn.begin() + prefix.size(), fn.end(), [](unsigned char c) { return std::isdigit(c) != 0; }))
+				found.emplace_back(number_of(x.path().string()), x.path().string());
+		}
+		std::sort(found.begin(), found.end());
+		std::lock_guard<std::mutex> guard(mx);
+		for (const auto& x : found) {
+			packs.push_back(std::make_shared<pack_file>(x.second));
+			const uint64_t good = scan(packs.back());
+			packs.back()->bytes = good;
+			if (good != fs::file_size(x.second)) {// a torn record, from a crash
+				boost::system::error_code ec;
+				fs::resize_file(x.second, good, ec);
+			}
+		}
+		if (packs.empty()) {
+			start_pack();
+		} else {
+			active = std::fopen(packs.back()->path.c_str(), "ab");
+			if (!active)
+				throw std::runtime_error("ts_db_pack: failed to open " + packs.back()->path);
+		}
+	}
+	/** apply the records of p to the index, \return the bytes up to the first damaged record, mx must be held */
+	uint64_t scan(const std::shared_ptr<pack_file>& p) {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen(p->path.c_str(), "rb"), &std::fclose };
+		if (!f)
+			throw std::runtime_error("ts_db_pack: failed to open " + p->path);
+		std::FILE* fh = f.get();
+		uint64_t o = 0;
+		record r;
+		while (std::fread(&r.op, 1, 1, fh) == 1 && (r.op == 'P' || r.op == 'R')) {
+			uint32_t name_sz{ 0 };
+			int64_t modified{ 0 };
+			uint64_t payload_sz{ 0 }, check{ 0 };
+			if (std::fread(&name_sz, sizeof(name_sz), 1, fh) != 1 || name_sz > 0xffff)
+				break;
+			r.name.resize(name_sz);
+			if (name_sz && std::fread(&r.name[0], 1, name_sz, fh) != name_sz)
+				break;
+			if (std::fread(&modified, sizeof(modified), 1, fh) != 1 || std::fread(&payload_sz, sizeof(payload_sz), 1, fh) != 1 || payload_sz > (uint64_t(1) << 40))
+				break;
+			r.payload.resize(std::size_t(payload_sz));
+			if (payload_sz && std::fread(&r.payload[0], 1, std::size_t(payload_sz), fh) != payload_sz)
+				break;
+			if (std::fread(&check, sizeof(check), 1, fh) != 1 || check != fnv1a(r.payload, fnv1a(r.name)))
+				break;
+			r.modified = utctime(modified);
+			if (r.op == 'P' && r.payload.size() < sizeof(ts_db_header))
+				break;
+			apply(r, p, o);
+			o += head_size(r.name) + payload_sz + sizeof(uint64_t);
+		}
+		return o;
+	}
+
+	/** \return the payload of the record of e */
+	std::string read_payload(const entry& e) const {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen(e.pack->path.c_str(), "rb"), &std::fclose };
+		std::string b(std::size_t(e.payload_sz), '\0');
+		if (!f || std::fseek(f.get(), long(e.offset), SEEK_SET) != 0 || (b.size() && std::fread(&b[0], 1, b.size(), f.get()) != b.size()))
+			throw std::runtime_error("ts_db_pack: failed to read " + e.info.name + " from " + e.pack->path);
+		return b;
+	}
+	/** \return true and sets ts to the stored series fn, if it is there */
+	bool read_stored(const std::string& fn, gts_t& ts) const {
+		entry e;
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			auto f = index.find(ts_db_catalogue::key_of(fn));
+			if (f == index.end())
+				return false;
+			e = f->second;// keeps the pack while it is read
+		}
+		ts = codec.wal_ts(read_payload(e));
+		return true;
+	}
+
+	uint64_t max_pack_size; ///< start a new pack beyond this size
+	bool sync = false; ///< fsync each save
+	ts_db codec; ///< encodes, decodes, slices and merges the payloads, without a container
+
+	mutable std::mutex write_mx; ///< serializes save, remove and compact
+	mutable std::mutex mx; ///< protects the members below
+	mutable std::map<std::string, entry> index; ///< ts_db_catalogue::key_of(name) -> the last record of name
+	mutable std::vector<std::shared_ptr<pack_file>> packs; ///< ascending, the last is the active pack
+	mutable std::FILE* active = nullptr; ///< the last pack, opened for append, written under write_mx
+};
+
+}
+}
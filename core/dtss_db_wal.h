@@ -0,0 +1,359 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace shyft {
+namespace dtss {
+
+/** \brief write-ahead log with group commit for the stores to a ts_db container
+ *
+ * A store appends its records to the log, and is acknowledged when they are durable,
+ * the ts files are written later by a background compactor that applies the records in log order.
+ * Concurrent stores are committed as a group, the first waiting store leads the commit,
+ * writing the records of all waiting stores in one sequential write followed by one fsync,
+ * so the store latency depends on the log throughput, not on the number of files written.
+ *
+ * The log is kept in the container root,
+ *   <log>    -> <record>*
+ *   <record> -> 'W' <name_sz> uint32_t <name> uint8_t[<name_sz>] <overwrite> uint8_t
+ *               <payload_sz> uint64_t <payload> uint8_t[<payload_sz>] <check> uint64_t
+ * where check is the fnv-1a hash of name and payload, so a record torn by a crash is detected.
+ * The log is truncated each time the compactor has applied all records,
+ * and replayed on open, applying the records left by a crash.
+ *
+ * Readers of a name calls flush(name) first, applying the pending records of that name,
+ * so a read always sees the acknowledged stores.
+ *
+ * \note the compactor can not report apply errors to the client that stored the records,
+ *       they are kept in errors(). After a log write error, the log refuses new records.
+ *       Only one log should be open for a container root.
+ */
+struct ts_db_wal {
+	/** callable apply(name, overwrite, payload) that writes a record to the container */
+	using apply_fx_t = std::function<void(const std::string&, bool, const std::string&)>;
+
+	/** one record of the log */
+	struct record {
+		std::string name;
+		bool overwrite = true;
+		std::string payload;
+	};
+
+	/** \return name of the log file in the container root */
+	static const char* log_name() { return ".ts_db.wal"; }
+
+	/** open the log of the container at root_dir, applying the records left in it, and start the compactor */
+	ts_db_wal(const std::string& root_dir, apply_fx_t apply_fx, bool sync = true)
+		:path((boost::filesystem::path(root_dir) / log_name()).string()), apply_fx(std::move(apply_fx)), sync(sync) {
+		replay();
+		log = std::fopen(path.c_str(), "ab");
+		if (!log)
+			throw std::runtime_error("dtss_store: failed to open write-ahead log " + path);
+		compactor = std::thread([this]() { compact_loop(); });
+	}
+
+	/** stop the compactor after it has applied all records */
+	~ts_db_wal() {
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			stopping = true;
+		}
+		cv_work.notify_all();
+		if (compactor.joinable())
+			compactor.join();
+		if (log)
+			std::fclose(log);
+	}
+	ts_db_wal(const ts_db_wal&) = delete;
+	ts_db_wal& operator=(const ts_db_wal&) = delete;
+
+	/** \brief append the records to the log, returning when they are durable
+	 *
+	 * \param rs the records, in order, the payloads are moved from
+	 * \throw runtime_error if the log can not be written
+	 */
+	void append(std::vector<record>& rs) {
+		if (rs.empty())
+			return;
+		std::string b;
+		std::vector<std::shared_ptr<entry>> es;
+		es.reserve(rs.size());
+		for (auto& r : rs) {
+			encode(b, r);
+			auto e = std::make_shared<entry>();
+			e->r = std::move(r);
+			es.push_back(std::move(e));
+		}
+		std::unique_lock<std::mutex> lk(mx);
+		if (failed)
+			throw std::runtime_error("dtss_store: write-ahead log " + path + " failed");
+		staged_bytes += b;
+		staged.insert(staged.end(), es.begin(), es.end());
+		const uint64_t my_batch = open_batch;
+		while (durable_batch < my_batch) {
+			if (failed)
+				throw std::runtime_error("dtss_store: write-ahead log " + path + " failed");
+			if (writing) {
+				cv_commit.wait(lk);
+				continue;
+			}
+			writing = true;// lead the commit of the open batch
+			std::string w; w.swap(staged_bytes);
+			std::vector<std::shared_ptr<entry>> we; we.swap(staged);
+			const uint64_t batch = open_batch++;
+			lk.unlock();
+			const bool ok = write_durable(w);
+			lk.lock();
+			writing = false;
+			if (!ok) {
+				failed = true;
+				cv_commit.notify_all();
+				throw std::runtime_error("dtss_store: failed to write to write-ahead log " + path);
+			}
+			for (auto& e : we) {
+				queue.push_back(e);
+				by_name[e->r.name].push_back(e);
+			}
+			durable_batch = batch;
+			cv_commit.notify_all();
+			cv_work.notify_one();
+		}
+	}
+
+	/** apply the pending records of name now */
+	void flush(const std::string& name) {
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			if (by_name.find(name) == by_name.end())
+				return;// the common case, not waiting for the compactor
+		}
+		std::lock_guard<std::mutex> apply_guard(apply_mx);
+		std::vector<std::shared_ptr<entry>> es;
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			auto it = by_name.find(name);
+			if (it == by_name.end())
+				return;
+			es.assign(it->second.begin(), it->second.end());
+		}
+		for (auto& e : es)
+			apply(*e);
+		std::lock_guard<std::mutex> guard(mx);
+		forget_applied(name);
+	}
+
+	/** apply all pending records now */
+	void flush() {
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			if (by_name.empty())
+				return;
+		}
+		std::lock_guard<std::mutex> apply_guard(apply_mx);
+		std::vector<std::shared_ptr<entry>> es;
+		{
+			std::lock_guard<std::mutex> guard(mx);
+			es.assign(queue.begin(), queue.end());
+		}
+		for (auto& e : es)
+			apply(*e);
+		std::lock_guard<std::mutex> guard(mx);
+		for (auto& e : es)
+			forget_applied(e->r.name);
+	}
+
+	/** \return number of durable records not yet applied by the compactor */
+	std::size_t pending() const {
+		std::lock_guard<std::mutex> guard(mx);
+		return queue.size();
+	}
+
+	/** \return the latest errors of applying records, oldest first */
+	std::vector<std::string> errors() const {
+		std::lock_guard<std::mutex> guard(mx);
+		return std::vector<std::string>(apply_errors.begin(), apply_errors.end());
+	}
+
+	/** \return size in bytes of the log file */
+	std::uintmax_t log_size() const {
+		boost::system::error_code ec;
+		auto sz = boost::filesystem::file_size(path, ec);
+		return ec ? 0 : sz;
+	}
+
+private:
+	struct entry {
+		record r;
+		bool applied = false; ///< protected by apply_mx
+	};
+
+	static uint64_t fnv1a(const std::string& s, uint64_t h = 0xcbf29ce484222325ull) {
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+	template<class T>
+	static void put(std::string& b, const T& x) { b.append(reinterpret_cast<const char*>(&x), sizeof(T)); }
+	static void encode(std::string& b, const record& r) {
+		b.push_back('W');
+		put(b, uint32_t(r.name.size()));
+		b += r.name;
+		put(b, uint8_t(r.overwrite ? 1 : 0));
+		put(b, uint64_t(r.payload.size()));
+		b += r.payload;
+		put(b, fnv1a(r.payload, fnv1a(r.name)));
+	}
+
+	bool write_durable(const std::string& b) {
+		if (std::fwrite(b.data(), 1, b.size(), log) != b.size() || std::fflush(log) != 0)
+			return false;
+		if (!sync)
+			return true;
+#ifdef _WIN32
+		return _commit(_fileno(log)) == 0;
+#else
+		return fsync(fileno(log)) == 0;
+#endif
+	}
+
+	/** apply the record of e, if not already done, apply_mx must be held */
+	void apply(entry& e) {
+		if (e.applied)
+			return;
+		e.applied = true;
+		try {
+			apply_fx(e.r.name, e.r.overwrite, e.r.payload);
+		} catch (const std::exception& ex) {
+			add_error(e.r.name + ": " + ex.what());
+		} catch (...) {
+			add_error(e.r.name + ": unknown error");
+		}
+	}
+	void add_error(std::string msg) {
+		std::lock_guard<std::mutex> guard(mx);
+		apply_errors.push_back(std::move(msg));
+		if (apply_errors.size() > max_errors)
+			apply_errors.pop_front();
+	}
+	/** drop the applied records in front of the pending records of name, apply_mx and mx must be held */
+	void forget_applied(const std::string& name) {
+		auto it = by_name.find(name);
+		if (it == by_name.end())
+			return;
+		while (it->second.size() && it->second.front()->applied)
+			it->second.pop_front();
+		if (it->second.empty())
+			by_name.erase(it);
+	}
+
+	void compact_loop() {
+		for (;;) {
+			std::shared_ptr<entry> e;
+			{
+				std::unique_lock<std::mutex> lk(mx);
+				cv_work.wait(lk, [this]() { return stopping || queue.size(); });
+				if (queue.empty())
+					return;// stopping, and all applied
+				e = queue.front();
+			}
+			std::lock_guard<std::mutex> apply_guard(apply_mx);
+			apply(*e);
+			std::lock_guard<std::mutex> guard(mx);
+			queue.pop_front();
+			forget_applied(e->r.name);
+			if (queue.empty() && !writing)
+				truncate();
+		}
+	}
+	/** empty the log, all its records are applied, and no commit is in progress, mx must be held */
+	void truncate() {
+		if (failed)
+			return;
+		boost::system::error_code ec;
+		boost::filesystem::resize_file(path, 0, ec);// the log is opened for append, so the next write goes to the start
+	}
+
+	/** apply the records left in the log, up to the first damaged one, then empty it */
+	void replay() {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen(path.c_str(), "rb"), &std::fclose };
+		if (!f)
+			return;
+		std::FILE* fh = f.get();
+		char op;
+		while (std::fread(&op, 1, 1, fh) == 1 && op == 'W') {
+			entry e;
+			uint32_t name_sz{ 0 };
+			uint8_t overwrite{ 0 };
+			uint64_t payload_sz{ 0 }, check{ 0 };
+			if (std::fread(&name_sz, sizeof(name_sz), 1, fh) != 1 || name_sz > 0xffff)
+				break;
+			e.r.name.resize(name_sz);
+			if (name_sz && std::fread(&e.r.name[0], 1, name_sz, fh) != name_sz)
+				break;
+			if (std::fread(&overwrite, 1, 1, fh) != 1 || std::fread(&payload_sz, sizeof(payload_sz), 1, fh) != 1 || payload_sz > (uint64_t(1) << 40))
+				break;
+			try {
+				e.r.payload.resize(std::size_t(payload_sz));
+			} catch (...) {
+				break;
+			}
+			if (payload_sz && std::fread(&e.r.payload[0], 1, std::size_t(payload_sz), fh) != payload_sz)
+				break;
+			if (std::fread(&check, sizeof(check), 1, fh) != 1 || check != fnv1a(e.r.payload, fnv1a(e.r.name)))
+				break;
+			e.r.overwrite = overwrite != 0;
+			apply(e);
+		}
+		f.reset();
+		boost::system::error_code ec;
+		boost::filesystem::resize_file(path, 0, ec);
+	}
+
+	static constexpr std::size_t max_errors = 100;
+
+	std::string path; ///< full path of the log
+	apply_fx_t apply_fx; ///< writes a record to the container
+	bool sync = true; ///< fsync each commit
+	std::FILE* log = nullptr; ///< the log, opened for append
+
+	mutable std::mutex mx; ///< protects the members below
+	std::condition_variable cv_commit; ///< signals a completed commit
+	std::condition_variable cv_work; ///< signals the compactor
+	std::string staged_bytes; ///< encoded records of the open batch
+	std::vector<std::shared_ptr<entry>> staged; ///< records of the open batch
+	uint64_t open_batch = 1; ///< the batch new records are staged to
+	uint64_t durable_batch = 0; ///< the last committed batch
+	bool writing = false; ///< a commit is in progress
+	bool failed = false; ///< a commit failed, the log refuses new records
+	bool stopping = false; ///< the compactor should stop when all is applied
+	std::deque<std::shared_ptr<entry>> queue; ///< durable records, in log order, to be applied by the compactor
+	std::unordered_map<std::string, std::deque<std::shared_ptr<entry>>> by_name; ///< durable records not applied, by name
+	std::deque<std::string> apply_errors; ///< latest apply errors
+
+	std::mutex apply_mx; ///< serializes applying records, taken before mx
+	std::thread compactor; ///< applies the durable records
+};
+
+}
+}
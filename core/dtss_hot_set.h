@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::pair;
+
+        using shyft::core::utctime;
+        using shyft::core::utcperiod;
+
+        /** the hot set of a cache, (id,period) most recently used first, ref. cache::get_hot_set */
+        using hot_set_t = vector<pair<string, utcperiod>>;
+
+        /** \brief write the hot set hs to file, replacing it as a whole
+         *
+         * The file is text, a header line, then one line for each entry,
+         *   <start> <end> <id>
+         * with the period in seconds since epoch, so it can be inspected, or made by other tools.
+         * It is written to file.tmp and renamed, so a reader never sees a partial file.
+         */
+        inline void write_hot_set(const string& file, const hot_set_t& hs) {
+            const string tmp = file + ".tmp";
+            {
+                std::ofstream out(tmp, std::ios::trunc);
+                out << "# dtss hot-set v1\n";
+                for (const auto& x : hs)
+                    out << std::int64_t(x.second.start) << ' ' << std::int64_t(x.second.end) << ' ' << x.first << '\n';
+                out.flush();
+                if (!out)
+                    throw std::runtime_error("dtss: failed to write hot-set file " + tmp);
+            }
+            boost::filesystem::rename(tmp, file);
+        }
+
+        /** \return the hot set of file, as written by write_hot_set, empty if there is no file, throws if it is not valid */
+        inline hot_set_t read_hot_set(const string& file) {
+            hot_set_t r;
+            std::ifstream in(file);
+            if (!in)
+                return r;
+            string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+                std::istringstream ls(line);
+                std::int64_t t0{0}, t1{0};
+                string id;
+                if (!(ls >> t0 >> t1) || !std::getline(ls >> std::ws, id) || id.empty() || t1 < t0)
+                    throw std::runtime_error("dtss: invalid line in hot-set file " + file + ": " + line);
+                r.emplace_back(id, utcperiod(utctime(t0), utctime(t1)));
+            }
+            return r;
+        }
+
+        /** \brief calls fx every interval on a thread of its own, and once more when it is destroyed
+         *
+         * An exception from fx is ignored, the next interval tries again.
+         */
+        struct periodic_task {
+            periodic_task(std::chrono::milliseconds interval, std::function<void()> fx) :interval(interval), fx(std::move(fx)) {
+                worker = std::thread([this]() { run(); });
+            }
+            periodic_task(const periodic_task&) = delete;
+            periodic_task& operator=(const periodic_task&) = delete;
+            ~periodic_task() {
+                {
+                    std::lock_guard<std::mutex> guard(mx);
+                    stopping = true;
+                }
+                cv.notify_all();
+                worker.join();
+            }
+
+        private:
+            void run() {
+                std::unique_lock<std::mutex> lock(mx);
+                for (;;) {
+                    const bool stop = cv.wait_for(lock, interval, [this]() { return stopping; });
+                    lock.unlock();
+                    try { fx(); } catch (...) {}
+                    if (stop)
+                        return;
+                    lock.lock();
+                }
+            }
+
+            std::chrono::milliseconds interval;
+            std::function<void()> fx;
+            std::mutex mx;///< protects stopping
+            std::condition_variable cv;///< signals stopping
+            bool stopping{false};
+            std::thread worker;
+        };
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <streambuf>
+
+#include "dtss_msg.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::string;
+
+        /** \brief latency histogram with fixed buckets, updated with relaxed atomics, so observe is cheap and lock-free */
+        struct latency_histogram {
+            static constexpr size_t n_bounds = 18;
+            /** the upper bounds of the buckets, in micro seconds, a last bucket counts the larger */
+            static const std::uint64_t* bounds_us() {
+                static const std::uint64_t b[n_bounds] = {
+                    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000
+                };
+                return b;
+            }
+
+            void observe(std::chrono::steady_clock::duration d) {
+                const auto us = std::uint64_t(std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+                const auto b = bounds_us();
+                size_t i = 0;
+                while (i < n_bounds && us > b[i]) ++i;
+                buckets[i].fetch_add(1, std::memory_order_relaxed);
+                sum_us.fetch_add(us, std::memory_order_relaxed);
+            }
+
+            std::uint64_t count() const {
+                std::uint64_t n = 0;
+                for (const auto& b : buckets) n += b.load(std::memory_order_relaxed);
+                return n;
+            }
+
+            /** write the histogram as the prometheus series name{labels,le=..}, with cumulative buckets, in seconds */
+            void write(std::ostream& os, const string& name, const string& labels) const {
+                const auto b = bounds_us();
+                const string sep = labels.empty() ? "" : ",";
+                std::uint64_t n = 0;
+                for (size_t i = 0; i <= n_bounds; ++i) {
+                    n += buckets[i].load(std::memory_order_relaxed);
+                    os << name << "_bucket{" << labels << sep << "le=\"";
+                    if (i < n_bounds) os << double(b[i])/1e6; else os << "+Inf";
+                    os << "\"} " << n << '\n';
+                }
+                const string l = labels.empty() ? "" : "{" + labels + "}";
+                os << name << "_sum" << l << ' ' << double(sum_us.load(std::memory_order_relaxed))/1e6 << '\n';
+                os << name << "_count" << l << ' ' << n << '\n';
+            }
+
+        private:
+            std::atomic<std::uint64_t> buckets[n_bounds + 1] = {};
+            std::atomic<std::uint64_t> sum_us{ 0 };
+        };
+
+        /** observes the time from construction to destruction in h, if not null */
+        struct scoped_latency {
+            explicit scoped_latency(latency_histogram& h) :h(&h), t0(std::chrono::steady_clock::now()) {}
+            explicit scoped_latency(latency_histogram* h) :h(h), t0(std::chrono::steady_clock::now()) {}
+            ~scoped_latency() { if (h) h->observe(std::chrono::steady_clock::now() - t0); }
+            scoped_latency(const scoped_latency&) = delete;
+            scoped_latency& operator=(const scoped_latency&) = delete;
+        private:
+            latency_histogram* h;
+            std::chrono::steady_clock::time_point t0;
+        };
+
+        /** \brief the counters of the hot paths of a server, ref. server::get_metrics
+         *
+         * The counters are relaxed atomics, updated where the work is done, and read as a whole
+         * when the metrics are requested, so a scrape sees each counter consistent, not all of them at one instant.
+         */
+        struct server_metrics {
+            latency_histogram requests[256];///< by message_type, from the request is read until the reply is written
+            latency_histogram bind;///< reading and binding the series of the expressions
+            latency_histogram evaluate;///< evaluating the bound expressions
+            latency_histogram serialize;///< writing the evaluated replies
+            latency_histogram ts_db_read;///< reading one series from a shyft:// container
+            latency_histogram ts_db_write;///< saving the series of one request to a shyft:// container
+            latency_histogram bind_ts_cb;///< the external read callback, including the wait for a batch
+            latency_histogram find_ts_cb;///< the external find callback
+            latency_histogram store_ts_cb;///< the external store callback
+            std::atomic<std::uint64_t> bytes_received{ 0 };
+            std::atomic<std::uint64_t> bytes_sent{ 0 };
+            std::atomic<std::uint64_t> requests_failed{ 0 };///< requests replied with a SERVER_EXCEPTION
+            std::atomic<std::int64_t> connections{ 0 };///< current connections
+
+            /** write the counters in the prometheus text format */
+            void write(std::ostream& os) const {
+                os << "# HELP dtss_request_seconds time from a request is read until the reply is written, by message type\n"
+                      "# TYPE dtss_request_seconds histogram\n";
+                for (size_t i = 0; i < 256; ++i)
+                    if (requests[i].count())
+                        requests[i].write(os, "dtss_request_seconds", "type=\"" + message_type_name(message_type(i)) + "\"");
+                os << "# HELP dtss_phase_seconds time spent in the phases of the evaluate requests\n"
+                      "# TYPE dtss_phase_seconds histogram\n";
+                bind.write(os, "dtss_phase_seconds", "phase=\"bind\"");
+                evaluate.write(os, "dtss_phase_seconds", "phase=\"evaluate\"");
+                serialize.write(os, "dtss_phase_seconds", "phase=\"serialize\"");
+                os << "# HELP dtss_ts_db_seconds latency of the shyft:// container reads, per series, and writes, per request\n"
+                      "# TYPE dtss_ts_db_seconds histogram\n";
+                ts_db_read.write(os, "dtss_ts_db_seconds", "op=\"read\"");
+                ts_db_write.write(os, "dtss_ts_db_seconds", "op=\"write\"");
+                os << "# HELP dtss_callback_seconds latency of the external callbacks\n"
+                      "# TYPE dtss_callback_seconds histogram\n";
+                bind_ts_cb.write(os, "dtss_callback_seconds", "callback=\"bind_ts\"");
+                find_ts_cb.write(os, "dtss_callback_seconds", "callback=\"find_ts\"");
+                store_ts_cb.write(os, "dtss_callback_seconds", "callback=\"store_ts\"");
+                counter(os, "dtss_received_bytes_total", "bytes read from the connections", bytes_received.load());
+                counter(os, "dtss_sent_bytes_total", "bytes written to the connections", bytes_sent.load());
+                counter(os, "dtss_requests_failed_total", "requests replied with an exception", requests_failed.load());
+                gauge(os, "dtss_connections", "current connections", double(connections.load()));
+            }
+
+            static void counter(std::ostream& os, const string& name, const string& help, std::uint64_t v) {
+                os << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " counter\n" << name << ' ' << v << '\n';
+            }
+            static void gauge(std::ostream& os, const string& name, const string& help, double v) {
+                os << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " gauge\n" << name << ' ' << v << '\n';
+            }
+        };
+
+        /** \brief stream buffer that forwards to sb, counting the bytes read and written
+         *
+         * It has no buffer of its own, so the bulk reads and writes of the messages are forwarded as they are.
+         * The counts are plain, for one connection thread, added to the shared atomics once for each message.
+         */
+        struct counting_streambuf : std::streambuf {
+            explicit counting_streambuf(std::streambuf* sb) :sb(sb) {}
+            std::uint64_t n_in{ 0 };
+            std::uint64_t n_out{ 0 };
+        protected:
+            int_type underflow() override { return sb->sgetc(); }
+            int_type uflow() override {
+                auto c = sb->sbumpc();
+                if (c != traits_type::eof()) ++n_in;
+                return c;
+            }
+            std::streamsize xsgetn(char* s, std::streamsize n) override {
+                auto r = sb->sgetn(s, n);
+                n_in += std::uint64_t(r);
+                return r;
+            }
+            std::streamsize showmanyc() override { return sb->in_avail(); }
+            int_type overflow(int_type c) override {
+                if (c == traits_type::eof())
+                    return traits_type::not_eof(c);
+                auto r = sb->sputc(traits_type::to_char_type(c));
+                if (r != traits_type::eof()) ++n_out;
+                return r;
+            }
+            std::streamsize xsputn(const char* s, std::streamsize n) override {
+                auto r = sb->sputn(s, n);
+                n_out += std::uint64_t(r);
+                return r;
+            }
+            int sync() override { return sb->pubsync(); }
+        private:
+            std::streambuf* sb;
+        };
+    }
+}
@@ -2,6 +2,8 @@
 #include <string>
 #include <cstdint>
 #include <exception>
+#include <stdexcept>
+#include <cstring>
 
 namespace shyft {
 namespace dtss {
@@ -22,9 +24,41 @@ enum class message_type : uint8_t {
 	EVALUATE_EXPRESSION,
 	EVALUATE_EXPRESSION_PERCENTILES,
     MERGE_STORE_TS,
-	// EVALUATE_TS_VECTOR_HISTOGRAM //-- tsv,period,ta,bin_min,bin_max -> ts_vector[n_bins]
+	TAGGED_REQUEST, ///< <tag> uint64_t <sz> uint64_t <message> uint8_t[<sz>], a complete message, replied by a TAGGED_REQUEST with the same tag, in any order
+	WIRE_VERSION, ///< request without payload, replied by a WIRE_VERSION <version> uint32_t, the flat wire version of the server
+	EVALUATE_FLAT, ///< <request> message_type, an EVALUATE_TS_VECTOR or EVALUATE_EXPRESSION request, replied by a FLAT_TS_VECTOR
+	FLAT_TS_VECTOR, ///< evaluated ts-vector reply, ref. dtss_msg_flat.h
+	EVALUATE_STREAM, ///< <chunk_size> uint64_t <request> message_type, as EVALUATE_FLAT, replied by a FLAT_TS_VECTOR per chunk, then a STREAM_END, or a SERVER_EXCEPTION
+	STREAM_END, ///< <n> uint64_t, the last reply to an EVALUATE_STREAM of n series
+	WIRE_OPTIONS, ///< <options> uint32_t <message>, a complete message handled with the wire options, ref. wire_compress_values
+	EVALUATE_TS_VECTOR_AGGREGATE, ///< period,tsv,ta,aggregate_spec,weights,bins,.. -> FLAT_TS_VECTOR of the aggregates, ref. time_series::aggregate_property
+	EVALUATE_EXPRESSION_AGGREGATE, ///< as EVALUATE_TS_VECTOR_AGGREGATE, with the tsv as a compressed expression
+	SUBSCRIBE, ///< <request> message_type, an EVALUATE_TS_VECTOR or EVALUATE_EXPRESSION request, replied by a SUBSCRIBE <sid> uint64_t and a FLAT_TS_VECTOR
+	READ_SUBSCRIPTION, ///< <sid> uint64_t <max_wait_ms> uint64_t, waits for changes, replied by SUBSCRIPTION_CHANGES
+	SUBSCRIPTION_CHANGES, ///< <n> uint64_t <ix> uint64_t[<n>] and a FLAT_TS_VECTOR of the n changed expressions
+	UNSUBSCRIBE, ///< <sid> uint64_t, replied by an UNSUBSCRIBE
+	REPLICATE_TS, ///< as STORE_TS, a store the primary node of a cluster replicates, saved without routing, replied by a REPLICATE_TS
+	SCHEDULER_STATS, ///< request without payload, replied by a SCHEDULER_STATS and the archived scheduler_stats
+	METRICS, ///< request without payload, replied by a METRICS <text> string, the server metrics in the prometheus text format
+	GET_TS_INFO, ///< the archived ids, replied by a GET_TS_INFO and the archived ts_info of each id, in order
+	EVALUATE_VALIDATED, ///< <n> uint64_t <version> uint64_t[<n>] <request> message_type, as SUBSCRIBE, replied by EVALUATE_VALIDATED <n> uint64_t <version> uint64_t[<n>] <m> uint64_t <ix> uint64_t[<m>] and a FLAT_TS_VECTOR of the m modified expressions
 };
 
+/** \return the name of the message type t, as the enumerator, for logs and metrics */
+inline std::string message_type_name(message_type t) {
+	static const char* names[] = {
+		"SERVER_EXCEPTION", "EVALUATE_TS_VECTOR", "EVALUATE_TS_VECTOR_PERCENTILES", "FIND_TS", "STORE_TS", "CACHE_FLUSH",
+		"CACHE_STATS", "EVALUATE_EXPRESSION", "EVALUATE_EXPRESSION_PERCENTILES", "MERGE_STORE_TS", "TAGGED_REQUEST",
+		"WIRE_VERSION", "EVALUATE_FLAT", "FLAT_TS_VECTOR", "EVALUATE_STREAM", "STREAM_END", "WIRE_OPTIONS",
+		"EVALUATE_TS_VECTOR_AGGREGATE", "EVALUATE_EXPRESSION_AGGREGATE", "SUBSCRIBE", "READ_SUBSCRIPTION",
+		"SUBSCRIPTION_CHANGES", "UNSUBSCRIBE", "REPLICATE_TS", "SCHEDULER_STATS", "METRICS", "GET_TS_INFO",
+		"EVALUATE_VALIDATED"
+	};
+	static_assert(sizeof(names)/sizeof(names[0]) == size_t(message_type::EVALUATE_VALIDATED) + 1, "a name for each message type");
+	const auto i = size_t(t);
+	return i < sizeof(names)/sizeof(names[0]) ? names[i] : "TYPE_" + std::to_string(i);
+}
+
 // ========================================
 
 namespace msg {
@@ -46,6 +80,32 @@ void write_type(message_type mt, T& out) {
 	out.write((const char *)&mtype, sizeof(mtype));
 }
 
+/** max tagged requests in flight on one connection, the client sends no more before reading a reply */
+constexpr std::size_t max_tagged_in_flight = 16;
+
+/** write the message m as a TAGGED_REQUEST with the tag */
+template <class T>
+void write_tagged(std::uint64_t tag, const std::string& m, T& out) {
+	write_type(message_type::TAGGED_REQUEST, out);
+	std::uint64_t sz = m.size();
+	out.write((const char*)&tag, sizeof(tag));
+	out.write((const char*)&sz, sizeof(sz));
+	out.write(m.data(), sz);
+}
+/** read the tag and the message of a TAGGED_REQUEST, the type is already read */
+template <class T>
+std::string read_tagged(T& in, std::uint64_t& tag) {
+	std::uint64_t sz{ 0 };
+	in.read((char*)&tag, sizeof(tag));
+	in.read((char*)&sz, sizeof(sz));
+	if (!in)
+		throw std::runtime_error("dtss: failed to read tagged message");
+	std::string m(sz, '\0');
+	in.read(&m[0], sz);
+	if (!in)
+		throw std::runtime_error("dtss: failed to read tagged message");
+	return m;
+}
 template <class T>
 void write_string(const std::string& s, T& out) {
 	int32_t sz = s.size();
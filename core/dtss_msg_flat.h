@@ -0,0 +1,201 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+#include "core/time_series_dd.h"
+#include "dtss_msg.h"
+#include "dtss_db_codec.h"
+
+namespace shyft {
+namespace dtss {
+namespace msg {
+
+/** \brief flat wire encoding of evaluated ts-vectors
+ *
+ * A FLAT_TS_VECTOR reply is written without boost archives, as a header and one block per series,
+ *   <reply>  -> FLAT_TS_VECTOR <version> uint32_t <n> uint64_t <ts>[<n>]
+ *   <ts>     -> <fx> int8_t <ta_type> int8_t [<encoding> uint8_t] <sz> uint64_t <ta> <values>
+ *             | -1 int8_t // an empty ts
+ *   <values> -> double[<sz>] // version 1, or encoding 0
+ *             | <bytes> uint64_t uint8_t[<bytes>] // encoding 1, codec::xor_encode of the values
+ *   <ta>     -> FIXED:    <t> int64_t <dt> int64_t
+ *             | CALENDAR: <t> int64_t <dt> int64_t <tz_sz> uint32_t <tz_name> uint8_t[<tz_sz>]
+ *             | POINT:    <t_end> int64_t <t> int64_t[<sz>]
+ * so the values and the points of a series are written with one write, and read directly into the vector of the result.
+ * The series are written evaluated, as the time_axis(), values() and point_interpretation() of each.
+ * Version 2, written when the request has the wire_compress_values option, has the encoding of each series,
+ * where series of at least compress_min_values values are xor encoded, if that is smaller.
+ *
+ * \note like the ts_db format, this assumes client and server share the byte order
+ */
+constexpr std::uint32_t flat_format_version = 2;
+
+constexpr std::uint32_t wire_version_flat = 1; ///< the server replies EVALUATE_FLAT
+constexpr std::uint32_t wire_version_stream = 2; ///< the server replies EVALUATE_STREAM
+constexpr std::uint32_t wire_version_options = 3; ///< the server handles WIRE_OPTIONS
+constexpr std::uint32_t wire_version_aggregate = 4; ///< the server handles EVALUATE_TS_VECTOR_AGGREGATE
+constexpr std::uint32_t wire_version_subscribe = 5; ///< the server handles SUBSCRIBE
+constexpr std::uint32_t wire_version_cluster = 6; ///< the server handles REPLICATE_TS
+constexpr std::uint32_t wire_version_scheduler = 7; ///< the server handles SCHEDULER_STATS
+constexpr std::uint32_t wire_version_metrics = 8; ///< the server handles METRICS
+constexpr std::uint32_t wire_version_ts_info = 9; ///< the server handles GET_TS_INFO
+constexpr std::uint32_t wire_version_validated = 10; ///< the server handles EVALUATE_VALIDATED
+constexpr std::uint32_t flat_wire_version = wire_version_validated; ///< the wire version replied to WIRE_VERSION
+
+constexpr std::uint32_t wire_compress_values = 1; ///< WIRE_OPTIONS bit, the values of flat replies are compressed
+constexpr std::size_t compress_min_values = 64; ///< smaller series are not worth compressing
+
+static_assert(sizeof(core::utctime) == sizeof(std::int64_t), "flat wire encoding requires 64 bit utctime");
+
+/** \return the calendar of the tz name, a region, or a fixed offset name, as the ts_db lookup */
+inline std::shared_ptr<core::calendar> flat_calendar_of(const std::string& tz) {
+	for (int hour = -11; hour < 12; hour++) {
+		auto c = std::make_shared<core::calendar>(core::deltahours(hour));
+		if (c->tz_info->name() == tz)
+			return c;
+	}
+	return std::make_shared<core::calendar>(tz);
+}
+
+/** write tsv to out as a FLAT_TS_VECTOR reply, version 2 with compressed values if compress_values, otherwise version 1 */
+template <class T>
+void write_flat_ts_vector(const time_series::dd::ats_vector& tsv, T& out, bool compress_values = false) {
+	using time_axis::generic_dt;
+	write_type(message_type::FLAT_TS_VECTOR, out);
+	const std::uint32_t version = compress_values ? flat_format_version : 1;
+	std::vector<std::uint8_t> xv;
+	const std::uint64_t n = tsv.size();
+	out.write((const char*)&version, sizeof(version));
+	out.write((const char*)&n, sizeof(n));
+	for (const auto& ts : tsv) {
+		if (!ts.ts) {
+			const std::int8_t empty = -1;
+			out.write((const char*)&empty, sizeof(empty));
+			continue;
+		}
+		const auto& ta = ts.time_axis();
+		const auto v = ts.values();
+		const std::int8_t h[2] = { std::int8_t(ts.point_interpretation()), std::int8_t(ta.gt) };
+		const std::uint64_t sz = v.size();
+		out.write((const char*)h, sizeof(h));
+		std::uint8_t encoding = 0;
+		if (compress_values) {
+			xv.clear();
+			if (sz >= compress_min_values) {
+				codec::xor_encode(v.data(), sz, xv);
+				if (xv.size() + sizeof(std::uint64_t) < sizeof(double)*sz)
+					encoding = 1;
+			}
+			out.write((const char*)&encoding, sizeof(encoding));
+		}
+		out.write((const char*)&sz, sizeof(sz));
+		switch (ta.gt) {
+		case generic_dt::FIXED: {
+			out.write((const char*)&ta.f.t, sizeof(ta.f.t));
+			out.write((const char*)&ta.f.dt, sizeof(ta.f.dt));
+		} break;
+		case generic_dt::CALENDAR: {
+			out.write((const char*)&ta.c.t, sizeof(ta.c.t));
+			out.write((const char*)&ta.c.dt, sizeof(ta.c.dt));
+			write_string(ta.c.cal->tz_info->name(), out);
+		} break;
+		case generic_dt::POINT: {
+			out.write((const char*)&ta.p.t_end, sizeof(ta.p.t_end));
+			out.write((const char*)ta.p.t.data(), sizeof(core::utctime)*sz);
+		} break;
+		}
+		if (encoding) {
+			const std::uint64_t bytes = xv.size();
+			out.write((const char*)&bytes, sizeof(bytes));
+			out.write((const char*)xv.data(), bytes);
+		} else {
+			out.write((const char*)v.data(), sizeof(double)*sz);
+		}
+	}
+}
+
+/** \return the ts-vector of a FLAT_TS_VECTOR reply, the type is already read, throws if the reply is not valid */
+template <class T>
+time_series::dd::ats_vector read_flat_ts_vector(T& in) {
+	using time_axis::generic_dt;
+	auto fail = []() { throw std::runtime_error("dtss: failed to read flat ts-vector reply"); };
+	std::uint32_t version{ 0 };
+	std::uint64_t n{ 0 };
+	in.read((char*)&version, sizeof(version));
+	in.read((char*)&n, sizeof(n));
+	if (!in || version < 1 || version > flat_format_version)
+		fail();
+	time_series::dd::ats_vector r; r.reserve(n);
+	std::vector<std::uint8_t> xv;
+	std::map<std::string, std::shared_ptr<core::calendar>> calendars;// one per tz of the reply
+	for (std::uint64_t i = 0; i < n; ++i) {
+		std::int8_t fx{ -1 };
+		in.read((char*)&fx, sizeof(fx));
+		if (!in)
+			fail();
+		if (fx < 0) {
+			r.emplace_back();
+			continue;
+		}
+		std::int8_t gt{ 0 };
+		std::uint8_t encoding{ 0 };
+		std::uint64_t sz{ 0 };
+		in.read((char*)&gt, sizeof(gt));
+		if (version > 1)
+			in.read((char*)&encoding, sizeof(encoding));
+		in.read((char*)&sz, sizeof(sz));
+		if (!in || gt < generic_dt::FIXED || gt > generic_dt::POINT || encoding > 1)
+			fail();
+		generic_dt ta;
+		ta.set_type(generic_dt::generic_type(gt));
+		switch (gt) {
+		case generic_dt::FIXED: {
+			in.read((char*)&ta.f.t, sizeof(ta.f.t));
+			in.read((char*)&ta.f.dt, sizeof(ta.f.dt));
+			ta.f.n = sz;
+		} break;
+		case generic_dt::CALENDAR: {
+			in.read((char*)&ta.c.t, sizeof(ta.c.t));
+			in.read((char*)&ta.c.dt, sizeof(ta.c.dt));
+			auto tz = read_string(in);
+			auto& cal = calendars[tz];
+			if (!cal)
+				cal = flat_calendar_of(tz);
+			ta.c.cal = cal;
+			ta.c.n = sz;
+		} break;
+		case generic_dt::POINT: {
+			in.read((char*)&ta.p.t_end, sizeof(ta.p.t_end));
+			auto& tp = ta.p.t.mut();
+			tp.resize(sz);
+			in.read((char*)tp.data(), sizeof(core::utctime)*sz);
+		} break;
+		}
+		std::vector<double> v(sz);
+		if (encoding) {
+			std::uint64_t bytes{ 0 };
+			in.read((char*)&bytes, sizeof(bytes));
+			if (!in || bytes > sizeof(double)*sz + sz)
+				fail();
+			xv.resize(bytes);
+			in.read((char*)xv.data(), bytes);
+			if (!in)
+				fail();
+			codec::xor_decode(xv.data(), bytes, sz, v.data());
+		} else {
+			in.read((char*)v.data(), sizeof(double)*sz);
+		}
+		if (!in)
+			fail();
+		r.emplace_back(std::move(ta), std::move(v), time_series::ts_point_fx(fx));
+	}
+	return r;
+}
+
+}  // msg
+}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using shyft::core::utcperiod;
+        using shyft::core::utctime;
+
+        /** \brief detects the clients that read the same series window after window, so the next window can be read ahead
+         *
+         * The reads are tracked per (client, id-set), the id-set is a hash of the sorted, unique ids of a request.
+         * A read of p is sequential if it starts where the previous read of the same (client, id-set) ended,
+         * or, paging backwards, ends where it started. After min_run sequential reads in a row,
+         * the next window, of the length of p in the same direction, is given once, to be read into the cache,
+         * ref. server::set_read_ahead. The windows may vary in length, like months, as the cache
+         * reads only the part of a window that is not already there.
+         * At most max_entries are tracked, beyond that they are forgotten.
+         */
+        struct read_ahead_detector {
+            static constexpr size_t max_entries = 10000;///< (client, id-set) tracked, ref. observe
+
+            /** read ahead after min_run sequential reads, 0 turns it off */
+            void configure(size_t min_run) {
+                std::lock_guard<std::mutex> guard(mx);
+                n_min_run = min_run;
+                if (min_run == 0)
+                    entries.clear();
+            }
+            size_t min_run() const { std::lock_guard<std::mutex> guard(mx); return n_min_run; }
+
+            /** \brief the read of ids, sorted and unique, for p by client
+             * \return the window to read ahead, or an invalid period if none
+             */
+            utcperiod observe(std::uint64_t client, const vector<string>& ids, utcperiod p) {
+                std::lock_guard<std::mutex> guard(mx);
+                if (n_min_run == 0 || !p.valid() || p.timespan() <= 0 || p.start <= core::min_utctime || p.end >= core::max_utctime)
+                    return utcperiod{};
+                if (entries.size() >= max_entries)
+                    entries.clear();
+                auto& s = entries[std::make_pair(client, hash_of(ids))];
+                const bool forward = s.last.valid() && p.start == s.last.end;
+                const bool backward = s.last.valid() && p.end == s.last.start;
+                s.run = forward || backward ? s.run + 1 : 0;
+                s.last = p;
+                if (s.run < n_min_run)
+                    return utcperiod{};
+                const utcperiod next = forward ? utcperiod(p.end, p.end + p.timespan()) : utcperiod(p.start - p.timespan(), p.start);
+                if (s.ahead.contains(next))
+                    return utcperiod{};// already read ahead
+                s.ahead = next;
+                return next;
+            }
+
+            /** forget the reads of client, e.g. when it disconnects */
+            void disconnect(std::uint64_t client) {
+                std::lock_guard<std::mutex> guard(mx);
+                entries.erase(entries.lower_bound(std::make_pair(client, std::uint64_t(0))),
+                              entries.upper_bound(std::make_pair(client, ~std::uint64_t(0))));
+            }
+
+            size_t size() const { std::lock_guard<std::mutex> guard(mx); return entries.size(); }
+
+        private:
+            struct state {
+                utcperiod last;///< the period of the last read
+                size_t run{ 0 };///< sequential reads in a row
+                utcperiod ahead;///< the last window read ahead
+            };
+            static std::uint64_t hash_of(const vector<string>& ids) {
+                std::uint64_t h = 14695981039346656037ull;
+                for (const auto& id : ids) {
+                    for (unsigned char c : id) {
+                        h ^= c;
+                        h *= 1099511628211ull;
+                    }
+                    h ^= 0xff;// separates the ids
+                    h *= 1099511628211ull;
+                }
+                return h;
+            }
+
+            mutable std::mutex mx;///< protects the members below
+            size_t n_min_run{ 0 };
+            std::map<std::pair<std::uint64_t, std::uint64_t>, state> entries;///< (client, hash of ids) -> state
+        };
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::map;
+        using std::unordered_map;
+        using std::shared_ptr;
+        using std::make_shared;
+        using std::mutex;
+        using std::lock_guard;
+
+        using shyft::core::utcperiod;
+        using shyft::core::utctime;
+
+        /** \brief read batcher, joins the external reads of concurrent requests into one callback invocation
+         *
+         * A read of (ids,period) waits in a batch for the period for a time window from the first read of the batch,
+         * collecting the ids of the other reads of the same period. Then the batch is read with one call to the
+         * read function, with each id once, on one of the threads of the batcher, and the readers get their part
+         * of the result through a future.
+         *
+         * So a slow read function, like a callback that takes the python GIL, is called once for the
+         * requests of a window, not once for each, and it runs on the threads of the batcher,
+         * not on the connection threads. With more than one thread, batches are read concurrently.
+         *
+         * \tparam TSV the time-series vector type of the result, the series are shared by the readers of the same id
+         */
+        template <class TSV>
+        struct read_batcher {
+            using read_fx_t = std::function<TSV(const vector<string>& ids, utcperiod p)>;
+
+            /** \brief start a batcher
+             *
+             * \param fx the read function, called with the ids of a batch, returns one series for each id
+             * \param window the time a batch waits for more reads, from its first read
+             * \param n_threads number of threads reading batches, at least 1
+             */
+            read_batcher(read_fx_t fx, std::chrono::microseconds window, size_t n_threads) :fx(std::move(fx)), window(window) {
+                for (size_t i = 0; i < std::max<size_t>(1, n_threads); ++i)
+                    threads.emplace_back([this]() { work(); });
+            }
+
+            /** stops the threads, the batches not yet read fails */
+            ~read_batcher() {
+                {
+                    lock_guard<mutex> guard(mx);
+                    stopping = true;
+                }
+                cv.notify_all();
+                for (auto& t : threads)
+                    t.join();
+                for (auto& b : batches)
+                    fail(*b.second, std::make_exception_ptr(std::runtime_error("dtss: read batcher stopped")));
+            }
+            read_batcher(const read_batcher&) = delete;
+            read_batcher& operator=(const read_batcher&) = delete;
+
+            /** \return a future of the ids read for period p, in the order of ids, set when the batch of p is read */
+            std::future<TSV> read(const vector<string>& ids, utcperiod p) {
+                reader r;
+                auto f = r.p.get_future();
+                bool first = false;
+                {
+                    lock_guard<mutex> guard(mx);
+                    auto& b = batches[key_of(p)];
+                    if (!b) {
+                        b = make_shared<batch>();
+                        b->p = p;
+                        b->deadline = clock::now() + window;
+                        first = true;
+                    }
+                    r.ix.reserve(ids.size());
+                    for (const auto& id : ids) {
+                        auto it = b->ix.find(id);
+                        if (it == b->ix.end()) {
+                            it = b->ix.emplace(id, b->ids.size()).first;
+                            b->ids.push_back(id);
+                        }
+                        r.ix.push_back(it->second);
+                    }
+                    b->readers.push_back(std::move(r));
+                }
+                if (first)
+                    cv.notify_one();
+                return f;
+            }
+
+            /** \return number of batches waiting to be read */
+            size_t size() const {
+                lock_guard<mutex> guard(mx);
+                return batches.size();
+            }
+
+        private:
+            using clock = std::chrono::steady_clock;
+            /** one read waiting in a batch */
+            struct reader {
+                std::promise<TSV> p;
+                vector<size_t> ix;///< position of each id of the read in the batch
+            };
+            /** the reads of one period */
+            struct batch {
+                utcperiod p;
+                clock::time_point deadline;
+                vector<string> ids;///< each id once
+                unordered_map<string, size_t> ix;///< id -> position in ids
+                vector<reader> readers;
+            };
+            using batch_ = shared_ptr<batch>;
+            using key_t = std::pair<utctime, utctime>;
+            static key_t key_of(const utcperiod& p) { return key_t{ p.start, p.end }; }
+
+            static void fail(batch& b, std::exception_ptr e) {
+                for (auto& r : b.readers)
+                    r.p.set_exception(e);
+            }
+
+            /** the thread loop, take the first batch due, read it and release its readers */
+            void work() {
+                std::unique_lock<mutex> lock(mx);
+                while (!stopping) {
+                    if (batches.empty()) {
+                        cv.wait(lock);
+                        continue;
+                    }
+                    auto due = batches.begin();
+                    for (auto it = batches.begin(); it != batches.end(); ++it)
+                        if (it->second->deadline < due->second->deadline)
+                            due = it;
+                    if (clock::now() < due->second->deadline) {
+                        cv.wait_until(lock, due->second->deadline);
+                        continue;// the batches might be taken meanwhile
+                    }
+                    auto b = due->second;
+                    batches.erase(due);
+                    if (batches.size())
+                        cv.notify_one();// let another thread wait for the next
+                    lock.unlock();
+                    read_batch(*b);
+                    lock.lock();
+                }
+            }
+
+            void read_batch(batch& b) {
+                TSV o;
+                try {
+                    o = fx(b.ids, b.p);
+                    if (o.size() != b.ids.size())
+                        throw std::runtime_error("dtss: external read returned " + std::to_string(o.size()) + " time-series for " + std::to_string(b.ids.size()) + " ids");
+                } catch (...) {
+                    fail(b, std::current_exception());
+                    return;
+                }
+                for (auto& r : b.readers) {
+                    TSV v; v.reserve(r.ix.size());
+                    for (auto i : r.ix)
+                        v.push_back(o[i]);
+                    r.p.set_value(std::move(v));
+                }
+            }
+
+            read_fx_t fx;///< the read function
+            std::chrono::microseconds window;///< time a batch collects reads
+            mutable mutex mx;///< protects batches and stopping
+            std::condition_variable cv;///< signals new batches, and stop
+            map<key_t, batch_> batches;///< the batches collecting reads, by period
+            bool stopping{ false };
+            vector<std::thread> threads;///< the threads reading batches
+        };
+    }
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+
+#include "dtss_cache.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::unordered_map;
+
+        /** \brief the evaluated results of expressions, by expression and period, invalidated when the series they reference change
+         *
+         * The key of an entry is the serialized, unbound expression and the bind period, so identical requests
+         * from many clients, like dashboards sharing expressions, are evaluated once.
+         * Each entry keeps the ids the expression references, ref. find_ts_bind_info, and invalidate
+         * removes the entries referencing any of the changed ids.
+         * A result evaluated while one of its series changed might be stale, so add drops it if one of its ids
+         * was invalidated after the generation it was read at. The recent invalidations are kept for at most
+         * max_changed ids, beyond that they are forgotten, and the results read before are all dropped.
+         * The entries are evicted in lru order beyond the capacity, 0 turns the cache off.
+         */
+        template<class ts_t>
+        struct expression_result_cache {
+            static constexpr size_t max_changed = 100000;///< ids with a recent invalidation kept, ref. add
+            explicit expression_result_cache(size_t capacity = 0) :n_capacity(capacity), c(std::max<size_t>(1, capacity)) {}
+
+            /** set the max entries, 0 turns the cache off, and removes the entries */
+            void set_capacity(size_t capacity) {
+                std::lock_guard<std::mutex> guard(mx);
+                n_capacity = capacity;
+                if (capacity == 0) {
+                    c.flush();
+                    dependents.clear();
+                    return;
+                }
+                evict_to(capacity);
+                c.set_capacity(capacity);
+            }
+            size_t get_capacity() const { return n_capacity; }
+
+            /** \return the current generation, to pass to add for results evaluated from now */
+            std::uint64_t generation() const {
+                std::lock_guard<std::mutex> guard(mx);
+                return gen;
+            }
+
+            /** \return true and sets r to the result of key, if cached */
+            bool try_get(const string& key, ts_t& r) {
+                std::lock_guard<std::mutex> guard(mx);
+                entry e;
+                if (n_capacity && c.try_get_item(key, e)) {
+                    r = e.ts;
+                    ++n_hits;
+                    return true;
+                }
+                ++n_misses;
+                return false;
+            }
+
+            /** add the result ts of key, referencing ids, evaluated from the series as of generation at, dropped if any changed since */
+            void add(const string& key, const ts_t& ts, vector<string> ids, std::uint64_t at) {
+                std::lock_guard<std::mutex> guard(mx);
+                if (n_capacity == 0 || at < floor || c.item_exists(key))
+                    return;
+                for (const auto& id : ids) {
+                    auto f = changed_at.find(id);
+                    if (f != changed_at.end() && f->second > at)
+                        return;// changed while evaluated
+                }
+                evict_to(n_capacity - 1);// make room, keeping the dependents
+                for (const auto& id : ids)
+                    dependents[id].push_back(key);
+                c.add_item(key, entry{ ts, std::move(ids) });
+            }
+
+            /** remove the results referencing any of ids */
+            void invalidate(const vector<string>& ids) {
+                std::lock_guard<std::mutex> guard(mx);
+                ++gen;
+                if (changed_at.size() + ids.size() > max_changed) {
+                    changed_at.clear();
+                    floor = gen;
+                }
+                for (const auto& id : ids) {
+                    changed_at[id] = gen;
+                    auto f = dependents.find(id);
+                    if (f == dependents.end())
+                        continue;
+                    auto keys = std::move(f->second);
+                    dependents.erase(f);
+                    for (const auto& k : keys)
+                        remove(k);
+                }
+            }
+
+            /** remove all results */
+            void flush() {
+                std::lock_guard<std::mutex> guard(mx);
+                ++gen;
+                floor = gen;
+                changed_at.clear();
+                c.flush();
+                dependents.clear();
+            }
+
+            size_t size() const { std::lock_guard<std::mutex> guard(mx); return c.size(); }
+            std::uint64_t hits() const { std::lock_guard<std::mutex> guard(mx); return n_hits; }
+            std::uint64_t misses() const { std::lock_guard<std::mutex> guard(mx); return n_misses; }
+
+            /** \return approx. bytes of the entries, the keys, the ids and the results, with ts_bytes(ts) the bytes of a result */
+            template<class Fx>
+            size_t estimate_bytes(Fx&& ts_bytes) const {
+                std::lock_guard<std::mutex> guard(mx);
+                size_t b = 0;
+                c.apply_to_items([&b, &ts_bytes](const string& key, const entry& e) {
+                    b += 2*(sizeof(string) + key.size()) + 8*sizeof(void*) + ts_bytes(e.ts);
+                    for (const auto& id : e.ids)
+                        b += 2*(sizeof(string) + id.size());// in the entry, and as key of the dependents
+                });
+                return b;
+            }
+
+        private:
+            struct entry {
+                ts_t ts;
+                vector<string> ids;///< the ids the expression references
+            };
+
+            /** remove key, and its key from the dependents of its other ids */
+            void remove(const string& key) {
+                entry e;
+                if (!c.try_get_item(key, e))
+                    return;
+                unlink(key, e.ids);
+                c.remove_item(key);
+            }
+
+            void unlink(const string& key, const vector<string>& ids) {
+                for (const auto& id : ids) {
+                    auto f = dependents.find(id);
+                    if (f == dependents.end())
+                        continue;
+                    auto& v = f->second;
+                    v.erase(std::remove(v.begin(), v.end(), key), v.end());
+                    if (v.empty())
+                        dependents.erase(f);
+                }
+            }
+
+            void evict_to(size_t n) {
+                c.evict_while([this, n](const string& k, const entry& e) {
+                    if (c.size() <= n)
+                        return false;
+                    unlink(k, e.ids);
+                    return true;
+                });
+            }
+
+            mutable std::mutex mx;///< protects the members below
+            size_t n_capacity;
+            flat_lru_cache<string, entry> c;
+            unordered_map<string, vector<string>> dependents;///< id -> the keys of the results referencing it
+            unordered_map<string, std::uint64_t> changed_at;///< id -> the generation of its last invalidation
+            std::uint64_t gen{ 0 };///< incremented by each invalidate and flush
+            std::uint64_t floor{ 0 };///< results read before it are dropped, the invalidations before are forgotten
+            std::uint64_t n_hits{ 0 };
+            std::uint64_t n_misses{ 0 };
+        };
+    }
+}
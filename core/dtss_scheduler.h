@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "core_serialization.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::string;
+        using std::map;
+        using std::unordered_map;
+
+        /** \brief the queue metrics of the request_scheduler of a server, ref. SCHEDULER_STATS */
+        struct scheduler_stats {
+            scheduler_stats() = default;
+            size_t workers{ 0 };///< max requests running, 0 if the scheduler is off
+            size_t running{ 0 };///< current requests running
+            size_t queued{ 0 };///< current requests waiting
+            size_t max_queued{ 0 };///< max requests waiting, more are rejected, 0 means no limit
+            size_t admitted{ 0 };///< accumulated requests admitted
+            size_t rejected{ 0 };///< accumulated requests rejected since the queue was full
+            size_t clients{ 0 };///< current clients with requests running or waiting
+            double queued_cost{ 0.0 };///< current estimated cost of the requests waiting
+            double wait_ms{ 0.0 };///< accumulated milliseconds the admitted requests waited
+            /** summary of several servers */
+            friend inline scheduler_stats operator + (scheduler_stats l, const scheduler_stats& r) {
+                l.workers += r.workers;
+                l.running += r.running;
+                l.queued += r.queued;
+                l.max_queued += r.max_queued;
+                l.admitted += r.admitted;
+                l.rejected += r.rejected;
+                l.clients += r.clients;
+                l.queued_cost += r.queued_cost;
+                l.wait_ms += r.wait_ms;
+                return l;
+            }
+            x_serialize_decl();
+        };
+
+        /** \brief admission control and fair-share dispatch of the requests of a server
+         *
+         * At most workers requests run at the same time, the others wait in a queue, and with a
+         * max_queued limit, a request arriving at a full queue is rejected, so the client gets an error,
+         * instead of the server taking on more than it can do.
+         *
+         * The waiting requests are dispatched by start-time fair queueing: a request of a client gets the
+         * start tag max(the finish tag of the previous request of the client, the virtual time),
+         * and finishes, in virtual time, at start + cost/weight of the client. The request with the
+         * least start tag runs first. So each client gets a share of the workers in proportion to its weight,
+         * measured by the cost of its requests, and a client sending many large requests, like a batch job,
+         * does not starve a client sending a few small ones.
+         *
+         * The clients are the foreign ip of the connections, ref. connect, with weight 1 unless set_weight.
+         * With workers 0, the default, the scheduler is off and requests run as they arrive.
+         */
+        struct request_scheduler {
+            /** a running request, releases its worker when it goes out of scope */
+            struct ticket {
+                ticket() = default;
+                ticket(request_scheduler* s, string client) :s(s), client(std::move(client)) {}
+                ticket(ticket&& o) :s(o.s), client(std::move(o.client)) { o.s = nullptr; }
+                ticket& operator=(ticket&& o) { std::swap(s, o.s); std::swap(client, o.client); return *this; }
+                ticket(const ticket&) = delete;
+                ticket& operator=(const ticket&) = delete;
+                ~ticket() { if (s) s->release(client); }
+            private:
+                request_scheduler* s{ nullptr };
+                string client;
+            };
+
+            /** \brief set the max requests running, 0 turns the scheduler off, and the max waiting, 0 means no limit */
+            void configure(size_t workers, size_t max_queued = 0) {
+                {
+                    std::lock_guard<std::mutex> guard(mx);
+                    n_workers = workers;
+                    queue_limit = max_queued;
+                }
+                cv.notify_all();// more workers, or off, lets waiters run
+            }
+
+            /** set the fair-share weight of client, default 1, a higher weight gets a larger share */
+            void set_weight(const string& client, double weight) {
+                if (!(weight > 0.0))
+                    throw std::runtime_error("dtss: scheduler weight must be positive");
+                std::lock_guard<std::mutex> guard(mx);
+                weights[client] = weight;
+            }
+
+            /** the connection_id is a connection of client */
+            void connect(std::uint64_t connection_id, const string& client) {
+                std::lock_guard<std::mutex> guard(mx);
+                client_of[connection_id] = client;
+            }
+            void disconnect(std::uint64_t connection_id) {
+                std::lock_guard<std::mutex> guard(mx);
+                client_of.erase(connection_id);
+            }
+
+            /** \brief wait for a worker for a request of connection_id, with the estimated cost
+             *
+             * \return the ticket of the request, that releases the worker when it goes out of scope
+             * \throw runtime_error if the queue is full
+             */
+            ticket admit(std::uint64_t connection_id, double cost) {
+                std::unique_lock<std::mutex> lock(mx);
+                if (n_workers == 0)
+                    return ticket{};
+                const auto t0 = clock::now();
+                const string client = client_key(connection_id);
+                if (running < n_workers && waiting.empty()) { // nobody waits, run now
+                    vtime = std::max(vtime, start(client, cost));
+                    ++running;
+                    ++n_admitted;
+                    return ticket{ this, client };
+                }
+                if (queue_limit && waiting.size() >= queue_limit) {
+                    ++n_rejected;
+                    throw std::runtime_error("dtss: server busy, " + std::to_string(waiting.size()) + " requests queued");
+                }
+                const auto key = std::make_pair(start(client, cost), next_seq++);
+                waiting.emplace(key, cost);
+                queued_cost += cost;
+                cv.wait(lock, [&]() { return n_workers == 0 || (running < n_workers && waiting.begin()->first == key); });
+                waiting.erase(key);
+                queued_cost -= cost;
+                if (!waiting.empty())
+                    cv.notify_all();// the next might run as well
+                if (n_workers == 0) { // turned off while waiting
+                    idle(client);
+                    return ticket{};
+                }
+                vtime = std::max(vtime, key.first);
+                ++running;
+                ++n_admitted;
+                total_wait_ms += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+                return ticket{ this, client };
+            }
+
+            scheduler_stats stats() const {
+                std::lock_guard<std::mutex> guard(mx);
+                scheduler_stats s;
+                s.workers = n_workers;
+                s.running = running;
+                s.queued = waiting.size();
+                s.max_queued = queue_limit;
+                s.admitted = n_admitted;
+                s.rejected = n_rejected;
+                for (const auto& c : clients)
+                    if (c.second.active) ++s.clients;
+                s.queued_cost = std::max(0.0, queued_cost);
+                s.wait_ms = total_wait_ms;
+                return s;
+            }
+
+        private:
+            using clock = std::chrono::steady_clock;
+            struct client_state {
+                double finish{ 0.0 };///< virtual finish time of the last request
+                size_t active{ 0 };///< requests running or waiting
+            };
+
+            /** \return the start tag of a request of client with cost, and advances the finish tag of the client */
+            double start(const string& client, double cost) {
+                auto& c = clients[client];
+                auto w = weights.find(client);
+                const double s = std::max(c.finish, vtime);
+                c.finish = s + std::max(cost, 1.0)/(w == weights.end() ? 1.0 : w->second);
+                ++c.active;
+                return s;
+            }
+
+            /** a request of client is done, the state of an idle client behind the virtual time is dropped, it would start at vtime anyway */
+            void idle(const string& client) {
+                auto f = clients.find(client);
+                if (f == clients.end())
+                    return;
+                if (f->second.active) --f->second.active;
+                if (f->second.active == 0 && f->second.finish <= vtime)
+                    clients.erase(f);
+            }
+
+            string client_key(std::uint64_t connection_id) const {
+                auto f = client_of.find(connection_id);
+                return f == client_of.end() ? std::to_string(connection_id) : f->second;
+            }
+
+            void release(const string& client) {
+                {
+                    std::lock_guard<std::mutex> guard(mx);
+                    if (running) --running;
+                    idle(client);
+                }
+                cv.notify_all();
+            }
+
+            mutable std::mutex mx;///< protects the members below
+            std::condition_variable cv;///< signals released workers, and configuration
+            size_t n_workers{ 0 };
+            size_t queue_limit{ 0 };
+            size_t running{ 0 };
+            size_t n_admitted{ 0 };
+            size_t n_rejected{ 0 };
+            double total_wait_ms{ 0.0 };
+            double queued_cost{ 0.0 };
+            double vtime{ 0.0 };///< start tag of the last request dispatched
+            std::uint64_t next_seq{ 0 };///< orders equal start tags by arrival
+            map<std::pair<double, std::uint64_t>, double> waiting;///< (start tag,seq) -> cost, the least first
+            unordered_map<string, client_state> clients;///< the clients with requests running or waiting, or ahead of vtime
+            unordered_map<string, double> weights;
+            unordered_map<std::uint64_t, string> client_of;///< connection -> client
+        };
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <exception>
+#include <functional>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::unordered_map;
+        using std::shared_ptr;
+        using std::make_shared;
+        using std::mutex;
+        using std::lock_guard;
+
+        using shyft::core::utcperiod;
+
+        /** \brief single-flight, coalesce concurrent requests for the same keys
+         *
+         * The first caller to join a key leads the flight, does the work, and completes the flight with the result,
+         * or with the exception it got. Callers joining the key while the flight is in progress follows it,
+         * waiting for the result of the leader instead of doing the work again.
+         * When completed, or forgotten, the flight is removed, so the next caller for the key leads a new one.
+         *
+         * A caller should complete the flights it leads before waiting for those it follows,
+         * then two callers that leads and follows each others keys can not dead-lock.
+         *
+         * \tparam K key type, hashed by H
+         * \tparam V the result type, copied to each follower
+         */
+        template <class K, class V, class H = std::hash<K>>
+        struct single_flight {
+            /** one flight in progress */
+            struct flight {
+                std::promise<V> p;
+                std::shared_future<V> f;
+                flight() :f(p.get_future().share()) {}
+            };
+            using flight_ = shared_ptr<flight>;
+
+            /** \brief join the flights of keys
+             *
+             * \param keys to join
+             * \param lead set to true for the keys this caller leads, and must complete, false for the keys to follow
+             * \return the flight of each key
+             */
+            vector<flight_> join(const vector<K>& keys, vector<bool>& lead) {
+                vector<flight_> r; r.reserve(keys.size());
+                lead.assign(keys.size(), false);
+                lock_guard<mutex> guard(mx);
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    auto it = flights.find(keys[i]);
+                    if (it != flights.end()) {
+                        r.push_back(it->second);
+                    } else {
+                        auto f = make_shared<flight>();
+                        flights.emplace(keys[i], f);
+                        r.push_back(f);
+                        lead[i] = true;
+                    }
+                }
+                return r;
+            }
+
+            /** complete flight f of key k with the result v, followers are released */
+            void complete(const K& k, const flight_& f, const V& v) {
+                f->p.set_value(v);
+                leave(k, f);
+            }
+
+            /** complete flight f of key k with exception e, rethrown to the followers */
+            void fail(const K& k, const flight_& f, std::exception_ptr e) {
+                f->p.set_exception(e);
+                leave(k, f);
+            }
+
+            /** \brief forget the flights of the keys matching pred, so the next caller for such a key leads a new flight
+             *
+             * Used when the source of the keys is changed, so later callers do not get the result of a flight started before the change.
+             * The forgotten flights are still completed by their leaders, and their followers get the result as before.
+             * \return number of flights forgotten
+             */
+            template <class P>
+            size_t forget_if(P&& pred) {
+                lock_guard<mutex> guard(mx);
+                size_t n = 0;
+                for (auto it = flights.begin(); it != flights.end();) {
+                    if (pred(it->first)) {
+                        it = flights.erase(it);
+                        ++n;
+                    } else {
+                        ++it;
+                    }
+                }
+                return n;
+            }
+
+            /** \return number of flights in progress */
+            size_t size() const {
+                lock_guard<mutex> guard(mx);
+                return flights.size();
+            }
+
+        private:
+            void leave(const K& k, const flight_& f) {
+                lock_guard<mutex> guard(mx);
+                auto it = flights.find(k);
+                if (it != flights.end() && it->second == f)
+                    flights.erase(it);
+            }
+            mutable mutex mx;///< protects flights
+            unordered_map<K, flight_, H> flights;///< the flights in progress
+        };
+
+        /** key of a ts read, the id and the read period */
+        struct ts_read_key {
+            string id;
+            utcperiod p;
+            bool operator==(const ts_read_key& o) const { return p == o.p && id == o.id; }
+        };
+
+        struct ts_read_key_hasher {
+            size_t operator()(const ts_read_key& k) const {
+                size_t h = std::hash<string>{}(k.id);
+                h ^= std::hash<std::int64_t>{}(std::int64_t(k.p.start)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+                h ^= std::hash<std::int64_t>{}(std::int64_t(k.p.end)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+    }
+}
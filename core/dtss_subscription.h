@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::map;
+        using std::unordered_map;
+        using std::shared_ptr;
+        using std::make_shared;
+        using std::mutex;
+        using std::lock_guard;
+
+        using shyft::core::utcperiod;
+
+        /** the evaluate request of a subscription, kept to re-evaluate the changed expressions */
+        struct subscription_request {
+            utcperiod p;///< the bind period
+            string tsv;///< the expressions, unbound and serialized, so a fresh copy can be bound for each evaluation
+            bool use_ts_cached_read{true};
+            bool update_ts_cache{false};
+        };
+
+        /** \brief subscriptions to evaluated expressions, notified when the series they reference change
+         *
+         * A subscription keeps the ids each of its expressions reference. When a series is stored, or
+         * cached explicitly, notify marks the expressions referencing its id as changed, and
+         * wakes the waiters, so a client waiting for changes gets the changed expressions only,
+         * instead of polling with evaluate for all of them.
+         * Each subscription is owned by the connection that made it, and removed with it, ref. remove_owner.
+         */
+        struct subscription_manager {
+            /** \brief add a subscription
+             *
+             * \param owner the connection that makes the subscription
+             * \param ids_of_expr the ids referenced by each of the expressions
+             * \param req the evaluate request
+             * \return the id of the new subscription
+             */
+            std::uint64_t add(std::uint64_t owner, const vector<vector<string>>& ids_of_expr, subscription_request req) {
+                auto s = make_shared<subscription>();
+                s->owner = owner;
+                s->req = std::move(req);
+                s->changed.assign(ids_of_expr.size(), false);
+                for (size_t i = 0; i < ids_of_expr.size(); ++i)
+                    for (const auto& id : ids_of_expr[i])
+                        s->ix_of_id[id].push_back(i);
+                lock_guard<mutex> guard(mx);
+                const auto sid = next_id++;
+                for (const auto& x : s->ix_of_id)
+                    subs_of_id[x.first].push_back(sid);
+                subs.emplace(sid, std::move(s));
+                return sid;
+            }
+
+            /** mark the expressions referencing any of ids as changed, and wake their waiters */
+            void notify(const vector<string>& ids) {
+                bool any = false;
+                {
+                    lock_guard<mutex> guard(mx);
+                    if (subs_of_id.empty())
+                        return;
+                    for (const auto& id : ids) {
+                        auto f = subs_of_id.find(id);
+                        if (f == subs_of_id.end())
+                            continue;
+                        for (auto sid : f->second) {
+                            auto& s = *subs[sid];
+                            for (auto i : s.ix_of_id[id])
+                                if (!s.changed[i]) {
+                                    s.changed[i] = true;
+                                    any = true;
+                                }
+                        }
+                    }
+                }
+                if (any)
+                    cv.notify_all();
+            }
+
+            /** \brief wait at most max_wait for changes to subscription sid
+             *
+             * \param sid the subscription
+             * \param max_wait max time to wait for changes
+             * \param req set to the evaluate request of the subscription
+             * \return the ascending indices of the changed expressions, now cleared, empty if none changed within max_wait
+             */
+            vector<size_t> wait(std::uint64_t sid, std::chrono::milliseconds max_wait, subscription_request& req) {
+                std::unique_lock<mutex> lock(mx);
+                auto s = find(sid);
+                cv.wait_for(lock, max_wait, [&s]() { return s->removed || s->n_changed() > 0; });
+                vector<size_t> r;
+                for (size_t i = 0; i < s->changed.size(); ++i)
+                    if (s->changed[i]) {
+                        r.push_back(i);
+                        s->changed[i] = false;
+                    }
+                req = s->req;
+                return r;
+            }
+
+            /** remove subscription sid, \return true if it existed */
+            bool remove(std::uint64_t sid) {
+                {
+                    lock_guard<mutex> guard(mx);
+                    auto f = subs.find(sid);
+                    if (f == subs.end())
+                        return false;
+                    erase(f);
+                }
+                cv.notify_all();
+                return true;
+            }
+
+            /** remove the subscriptions of the connection owner */
+            void remove_owner(std::uint64_t owner) {
+                bool any = false;
+                {
+                    lock_guard<mutex> guard(mx);
+                    for (auto it = subs.begin(); it != subs.end();) {
+                        if (it->second->owner == owner) {
+                            it = erase(it);
+                            any = true;
+                        } else {
+                            ++it;
+                        }
+                    }
+                }
+                if (any)
+                    cv.notify_all();
+            }
+
+            /** \return number of subscriptions */
+            size_t size() const {
+                lock_guard<mutex> guard(mx);
+                return subs.size();
+            }
+
+        private:
+            struct subscription {
+                std::uint64_t owner{0};
+                subscription_request req;
+                unordered_map<string, vector<size_t>> ix_of_id;///< id -> the expressions referencing it
+                vector<bool> changed;///< changed[i] if expression i changed since the last wait
+                bool removed{false};
+                size_t n_changed() const { size_t n = 0; for (auto c : changed) n += c ? 1 : 0; return n; }
+            };
+            using subs_t = map<std::uint64_t, shared_ptr<subscription>>;
+
+            shared_ptr<subscription> find(std::uint64_t sid) const {
+                auto f = subs.find(sid);
+                if (f == subs.end())
+                    throw std::runtime_error("dtss: unknown subscription " + std::to_string(sid));
+                return f->second;
+            }
+            subs_t::iterator erase(subs_t::iterator it) {
+                it->second->removed = true;// a waiter holds it, and returns
+                for (const auto& x : it->second->ix_of_id) {
+                    auto& v = subs_of_id[x.first];
+                    v.erase(std::remove(v.begin(), v.end(), it->first), v.end());
+                    if (v.empty())
+                        subs_of_id.erase(x.first);
+                }
+                return subs.erase(it);
+            }
+
+            mutable mutex mx;///< protects the members below
+            std::condition_variable cv;///< signals changes and removals
+            subs_t subs;///< subscription id -> subscription
+            unordered_map<string, vector<std::uint64_t>> subs_of_id;///< id -> subscriptions referencing it
+            std::uint64_t next_id{1};
+        };
+    }
+}
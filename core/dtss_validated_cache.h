@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <random>
+#include <algorithm>
+
+#include "dtss_cache.h"
+
+namespace shyft {
+    namespace dtss {
+        using std::size_t;
+        using std::vector;
+        using std::string;
+        using std::unordered_map;
+
+        /** \brief the versions of the series of a server, for the validated evaluate of the clients, ref. EVALUATE_VALIDATED
+         *
+         * The version of an expression is a hash of the ids it references, with the ts_info.modified of each,
+         * the number of times the server has seen each of them change, and the epoch of the server.
+         * The change count covers the stores within the resolution of modified, and the epoch, random at start
+         * and renewed by flush, the restarts and replaced containers. The changes are counted for at most
+         * max_ids ids, beyond that they are forgotten, and a new epoch changes all the versions.
+         * Version 0 is never given, it is the version of a result the client does not have.
+         */
+        struct series_versions {
+            static constexpr size_t max_ids = 100000;///< ids with a change count kept, ref. changed
+
+            series_versions() :epoch(new_epoch()) {}
+
+            /** the series ids are changed */
+            void changed(const vector<string>& ids) {
+                std::lock_guard<std::mutex> guard(mx);
+                if (n_changed.size() + ids.size() > max_ids) {
+                    n_changed.clear();
+                    epoch = new_epoch();
+                }
+                for (const auto& id : ids)
+                    ++n_changed[id];
+            }
+
+            /** all series might have changed */
+            void flush() {
+                std::lock_guard<std::mutex> guard(mx);
+                n_changed.clear();
+                epoch = new_epoch();
+            }
+
+            /** \return the version of an expression referencing the sorted, unique ids, with modified[i] the ts_info.modified of ids[i] */
+            std::uint64_t version(const vector<string>& ids, const vector<std::int64_t>& modified) const {
+                std::lock_guard<std::mutex> guard(mx);
+                std::uint64_t h = fnv(fnv_basis, &epoch, sizeof(epoch));
+                for (size_t i = 0; i < ids.size(); ++i) {
+                    h = fnv(h, ids[i].data(), ids[i].size());
+                    h = fnv(h, &modified[i], sizeof(modified[i]));
+                    auto f = n_changed.find(ids[i]);
+                    const std::uint64_t n = f != n_changed.end() ? f->second : 0;
+                    h = fnv(h, &n, sizeof(n));
+                }
+                return h ? h : 1;
+            }
+
+        private:
+            static constexpr std::uint64_t fnv_basis = 14695981039346656037ull;
+            static std::uint64_t fnv(std::uint64_t h, const void* p, size_t n) {
+                const auto* b = static_cast<const unsigned char*>(p);
+                for (size_t i = 0; i < n; ++i) {
+                    h ^= b[i];
+                    h *= 1099511628211ull;
+                }
+                return h;
+            }
+            static std::uint64_t new_epoch() {
+                std::random_device rd;
+                return (std::uint64_t(rd()) << 32) ^ std::uint64_t(rd());
+            }
+
+            mutable std::mutex mx;///< protects the members below
+            unordered_map<string, std::uint64_t> n_changed;///< id -> the changes seen
+            std::uint64_t epoch;
+        };
+
+        /** \brief the results of the validated evaluate of a client, by expression and period, with the version the server gave them
+         *
+         * The key of a result is the period and the serialized expression, as for the expression_result_cache of the server.
+         * The client sends the version it has of each expression, and the server replies only the results
+         * that have a new version, ref. client::set_validated_cache_size.
+         * The entries are evicted in lru order beyond the capacity, 0 turns the cache off.
+         */
+        template<class ts_t>
+        struct validated_result_cache {
+            explicit validated_result_cache(size_t capacity = 0) :n_capacity(capacity), c(std::max<size_t>(1, capacity)) {}
+
+            /** set the max entries, 0 turns the cache off, and removes the entries */
+            void set_capacity(size_t capacity) {
+                std::lock_guard<std::mutex> guard(mx);
+                n_capacity = capacity;
+                if (capacity == 0) {
+                    c.flush();
+                    return;
+                }
+                c.set_capacity(capacity);
+            }
+            size_t get_capacity() const { return n_capacity; }
+
+            /** \return the version of the result of key, and sets ts to it, or 0 if it is not cached */
+            std::uint64_t get(const string& key, ts_t& ts) {
+                std::lock_guard<std::mutex> guard(mx);
+                entry e;
+                if (n_capacity == 0 || !c.try_get_item(key, e))
+                    return 0;
+                ts = e.ts;
+                return e.version;
+            }
+
+            /** add, or replace, the result ts of key, with the version the server gave it */
+            void add(const string& key, std::uint64_t version, const ts_t& ts) {
+                std::lock_guard<std::mutex> guard(mx);
+                if (n_capacity == 0 || version == 0)
+                    return;
+                c.add_item(key, entry{ version, ts });
+            }
+
+            /** count the results of a request, n_not_modified of n validated */
+            void count(size_t n, size_t n_not_modified) {
+                std::lock_guard<std::mutex> guard(mx);
+                n_validated += n;
+                n_hits += n_not_modified;
+            }
+
+            void flush() { std::lock_guard<std::mutex> guard(mx); c.flush(); }
+            size_t size() const { std::lock_guard<std::mutex> guard(mx); return c.size(); }
+            std::uint64_t hits() const { std::lock_guard<std::mutex> guard(mx); return n_hits; }
+            std::uint64_t validated() const { std::lock_guard<std::mutex> guard(mx); return n_validated; }
+
+        private:
+            struct entry {
+                std::uint64_t version{ 0 };
+                ts_t ts;
+            };
+            mutable std::mutex mx;///< protects the members below
+            size_t n_capacity;
+            flat_lru_cache<string, entry> c;
+            std::uint64_t n_hits{ 0 };///< results not modified, used from the cache
+            std::uint64_t n_validated{ 0 };///< results asked for with validation
+        };
+    }
+}
@@ -8,6 +8,8 @@
 #include <limits>
 #include <algorithm>
 #include <sstream>
+#include <fstream>
+#include <cstdint>
 
 #include <boost/filesystem.hpp>
 namespace fs=boost::filesystem;
@@ -82,6 +84,61 @@ namespace shyft {
                 return r;
 			}
 
+
+			namespace {
+				constexpr uint64_t gcd_file_magic = 0x3130444347594853ull;///< "SHYGCD01"
+				struct gcd_record {
+					double x, y, z, area, radiation_slope_factor;
+					double glacier, lake, reservoir, forest, routing_distance;
+					int64_t catchment_id, routing_id, catchment_ix;
+				};
+			}
+
+			void write_geo_cell_data(const string& file, const vector<ec::geo_cell_data>& gcd) {
+				vector<gcd_record> v; v.reserve(gcd.size());
+				for (const auto& g : gcd) {
+					const auto& p = g.mid_point();
+					const auto& f = g.land_type_fractions_info();
+					v.push_back(gcd_record{ p.x, p.y, p.z, g.area(), g.radiation_slope_factor(),
+						f.glacier(), f.lake(), f.reservoir(), f.forest(), g.routing.distance,
+						int64_t(g.catchment_id()), int64_t(g.routing.id), int64_t(g.catchment_ix) });
+				}
+				const string tmp = file + ".tmp";
+				{
+					std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+					const uint64_t n = v.size();
+					out.write((const char*)&gcd_file_magic, sizeof(gcd_file_magic));
+					out.write((const char*)&n, sizeof(n));
+					if (n) out.write((const char*)v.data(), std::streamsize(n*sizeof(gcd_record)));
+					out.flush();
+					if (!out)
+						throw runtime_error("write_geo_cell_data: failed to write " + tmp);
+				}
+				fs::rename(tmp, file);
+			}
+
+			bool read_geo_cell_data(const string& file, vector<ec::geo_cell_data>& gcd) {
+				if (!fs::is_regular_file(file))
+					return false;
+				std::ifstream in(file, std::ios::binary);
+				uint64_t magic{ 0 }, n{ 0 };
+				in.read((char*)&magic, sizeof(magic));
+				in.read((char*)&n, sizeof(n));
+				if (!in || magic != gcd_file_magic || n*sizeof(gcd_record) + 2*sizeof(uint64_t) != fs::file_size(file))
+					throw runtime_error("read_geo_cell_data: not a valid geo_cell_data file " + file);
+				vector<gcd_record> v(n);
+				if (n) in.read((char*)v.data(), std::streamsize(n*sizeof(gcd_record)));
+				if (!in)
+					throw runtime_error("read_geo_cell_data: failed to read " + file);
+				gcd.clear(); gcd.reserve(n);
+				for (const auto& r : v) {
+					ec::land_type_fractions ltf;
+					ltf.set_fractions(r.glacier, r.lake, r.reservoir, r.forest);
+					gcd.emplace_back(ec::geo_point(r.x, r.y, r.z), r.area, int(r.catchment_id), r.radiation_slope_factor, ltf, ec::routing_info(r.routing_id, r.routing_distance));
+					gcd.back().catchment_ix = size_t(r.catchment_ix);
+				}
+				return true;
+			}
 		}
 		namespace repository {
 		}
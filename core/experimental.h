@@ -1,6 +1,8 @@
 #pragma once
 
 #define BOOST_GEOMETRY_OVERLAY_NO_THROW
+#include <atomic>
+#include <mutex>
 
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point_xy.hpp>
@@ -16,6 +18,7 @@
 
 #include "region_model.h"
 #include "pt_gs_k_cell_model.h"
+#include "thread_pool.h"
 
 
 
@@ -346,6 +349,32 @@ namespace shyft {
             vector<double>  dtmz; ///<< vector containing all the elevations for the cells, computed index cell(i,j) is i*ny+j
         };
 
+        /** \brief a spatial index, a packed rtree of the envelopes, over the polygons of a multi_polygon
+         *
+         * A cell intersects just a few of the polygons of a feature, so the intersections of a cell
+         * is done with the polygons that touches its box, not with the whole feature.
+         */
+        struct polygon_index {
+            typedef pair<box,size_t> value_t;///< envelope, and the index of the polygon in mp
+            const multi_polygon& mp;
+            geo::index::rtree<value_t,geo::index::rstar<16>> rt;
+            explicit polygon_index(const multi_polygon& mp):mp(mp) {
+                vector<value_t> v;v.reserve(mp.size());
+                for(size_t i=0;i<mp.size();++i)
+                    v.emplace_back(geo::return_envelope<box>(mp[i]),i);
+                rt=geo::index::rtree<value_t,geo::index::rstar<16>>(v.begin(),v.end());// packing
+            }
+            /** \return the polygons of mp that intersects bx, in the order of mp */
+            multi_polygon near(const box& bx) const {
+                vector<value_t> hits;
+                rt.query(geo::index::intersects(bx),back_inserter(hits));
+                sort(begin(hits),end(hits),[](const value_t&a,const value_t&b){return a.second<b.second;});
+                multi_polygon r;r.reserve(hits.size());
+                for(const auto&h:hits) r.push_back(mp[h.second]);
+                return r;
+            }
+        };
+
         /** \brief A computer that given region_grid, and catchment + features, delivers geo_cell_data filled in back.
          * \note that this class uses the \ref region_grid class to provide the region grid geometry along with the elevation(z).
          */
@@ -354,6 +383,11 @@ namespace shyft {
             geo_cell_data_computer():area_errors(0),suppressed_exceptions(0) {
             }
 
+            /** \brief compute the geo_cell_data of the cells of grid that intersects catchm, in grid (i,j) order
+             *
+             * The rows, i, of the grid are computed in parallel, using max_threads of the shared executor (0 means all),
+             * and each cell is intersected with the polygons of the catchment and features that touches the cell, ref. polygon_index.
+             */
             vector<ec::geo_cell_data>
             catchment_geo_cell_data(const region_grid& grid,
                                     int catchm_id,
@@ -362,10 +396,9 @@ namespace shyft {
                                     const multi_polygon& rsvx,
                                     const multi_polygon& lakex,
                                     const multi_polygon& glacierx,
-                                    const multi_polygon& forestx
+                                    const multi_polygon& forestx,
+                                    size_t max_threads=0
                                     ) {
-                vector<ec::geo_cell_data> r;
-                r.reserve(grid.n_cells());
                 box bbox;
                 geo::envelope(catchm,bbox);
                 polygon pgbbox;
@@ -380,49 +413,49 @@ namespace shyft {
                 if(lakex.size()) geo::intersection(pgbbox,lakex,lake);
                 if(glacierx.size()) geo::intersection(pgbbox,glacierx,glacier);
                 if(forestx.size()) geo::intersection(pgbbox,forestx,forest);
-                //TODO: consider using multicore (not yet successful speedup)
-                // using a lambda, e.g. prepared for multicore
-                // a mutex for the result
-                // uncomment the next lines to prepare for multicore run on the cells.
-                //mutex r_mx;
-                //r.resize(grid.n_cells());
-                auto f_x=[&](size_t lower_i,size_t upper_i,vector<ec::geo_cell_data>&r ) {
-                    for(size_t i=lower_i;i<upper_i;++i) {
-                        for(size_t j=0;j<grid.n_y();++j) {
-                            box cell_bx(grid.cell_box(i,j));
-                            if(geo::intersects(cell_bx,bbox)) {
-                                multi_polygon cellx;
-                                geo::convert(cell_bx,cellx);
-                                try {
-                                    multi_polygon cell;
-                                    geo::intersection(cellx,catchm,cell);//cell_box throws exception, so avoid it.
-                                    if(cell.size() ) { // get rid of empty intersections
-                                        double a=geo::area(cell);
-                                        point_xy midpoint(0,0);
-                                        geo::centroid(cell,midpoint);//Could use cell_bx midpoint instead, ..faster
-                                        ec::geo_point pc(midpoint.x(),midpoint.y(),grid.dtm_z(i,j));
-                                        ec::land_type_fractions ltf(compute_land_type_fractions(a,cell,rsv,lake,glacier,forest));
-                                        ec::geo_cell_data gcd(pc,a,catchm_id,radiation_factor,ltf);
-                                        {
-                                            //lock_guard<mutex> lock(r_mx);
-                                            r.emplace_back(gcd);
-
-                                        }
-                                    }
-                                } catch(const exception &ex) { //geo::overlay_invalid_input_exception, the lake from neanidelv generates that.
-                                    cout<<"Sorry, at cell("<<i<<","<<j<<"), intersection ex: "<<ex.what()<<endl;
-                                    ++suppressed_exceptions;
+                const polygon_index catchm_ix(catchm),rsv_ix(rsv),lake_ix(lake),glacier_ix(glacier),forest_ix(forest);
+                mutex io_mx;// for the diagnostics below
+                vector<vector<ec::geo_cell_data>> rows(grid.n_x());
+                auto f_x=[&](size_t i,vector<ec::geo_cell_data>&r ) {
+                    for(size_t j=0;j<grid.n_y();++j) {
+                        box cell_bx(grid.cell_box(i,j));
+                        if(geo::intersects(cell_bx,bbox)) {
+                            multi_polygon cellx;
+                            geo::convert(cell_bx,cellx);
+                            try {
+                                multi_polygon cell;
+                                geo::intersection(cellx,catchm_ix.near(cell_bx),cell);//cell_box throws exception, so avoid it.
+                                if(cell.size() ) { // get rid of empty intersections
+                                    double a=geo::area(cell);
+                                    point_xy midpoint(0,0);
+                                    geo::centroid(cell,midpoint);//Could use cell_bx midpoint instead, ..faster
+                                    ec::geo_point pc(midpoint.x(),midpoint.y(),grid.dtm_z(i,j));
+                                    ec::land_type_fractions ltf(compute_land_type_fractions(a,cell,rsv_ix.near(cell_bx),lake_ix.near(cell_bx),glacier_ix.near(cell_bx),forest_ix.near(cell_bx)));
+                                    r.emplace_back(pc,a,catchm_id,radiation_factor,ltf);
                                 }
+                            } catch(const exception &ex) { //geo::overlay_invalid_input_exception, the lake from neanidelv generates that.
+                                lock_guard<mutex> lock(io_mx);
+                                cout<<"Sorry, at cell("<<i<<","<<j<<"), intersection ex: "<<ex.what()<<endl;
+                                ++suppressed_exceptions;
                             }
                         }
                     }
                 };
-                f_x(0,grid.n_x(),r);// invoke lambda for all cells
-                return r;//moved anyway?
+                ec::executor::instance()->parallel_for(grid.n_x(),1,[&](size_t i0,size_t i1) {
+                    for(size_t i=i0;i<i1;++i)
+                        f_x(i,rows[i]);
+                },max_threads);
+                size_t n=0;
+                for(const auto&row:rows) n+=row.size();
+                vector<ec::geo_cell_data> r;
+                r.reserve(n);
+                for(auto&row:rows)
+                    r.insert(r.end(),row.begin(),row.end());
+                return r;
             }
             // for debug/diagnostics ,needed when working with real data, (sorry, a GIS db may contain errors!)
-            mutable int area_errors;//< count number of errors during the .safe_area_of(..) function
-            mutable int suppressed_exceptions;//< count number of exceptions during boost::geo intersect etc..
+            mutable atomic<int> area_errors;//< count number of errors during the .safe_area_of(..) function
+            mutable atomic<int> suppressed_exceptions;//< count number of exceptions during boost::geo intersect etc..
           private:
 
             /** \brief calculates the area of the intersection between cell and a feature (like lake/forest),
@@ -493,6 +526,17 @@ namespace shyft {
              * read all files matching and provide them back as a shared pointer to a vector of \ref geo_xts_t */
             shared_ptr<vector<geo_xts_t>>
             load_from_directory(wkt_reader& wkt_io,function<ec::geo_point(int)> id_to_geo_point,const string& subdir,const string& suffix) ;
+            /** \brief write gcd to file as fixed size binary records, so that it is read back without geometry computations, ref. read_geo_cell_data
+             *
+             * <file> -> <magic> uint64_t <n> uint64_t <cell>[<n>], where each cell is the mid-point x,y,z, area, radiation slope factor,
+             * the glacier,lake,reservoir,forest fractions and routing distance as double, then catchment id, routing id and catchment ix as int64_t.
+             * \note assumes the writer and the reader share the byte order
+             */
+            void write_geo_cell_data(const string& file,const vector<ec::geo_cell_data>& gcd);
+            /** \brief read the geo_cell_data file written by write_geo_cell_data into gcd
+             * \return false if there is no file, throws if it is not a valid file
+             */
+            bool read_geo_cell_data(const string& file,vector<ec::geo_cell_data>& gcd);
         }
 
         /** \brief the repository namespace have some simple classes that helps the orchestrator delegate io/config stuff.
@@ -538,9 +582,32 @@ namespace shyft {
                  :subdir(path),x0(x0),y0(y0),nx(nx),ny(ny),dx(dx),dy(dy) {}
 
                 /** \brief read() does all needed stuff to get back a cell vector that can be used for region_model
+                 * \param cells the cells, with default state and parameters, in catchment and grid order
+                 * \param gcd_file if not empty, the geo_cell_data are read from this file if it exists,
+                 *       otherwise they are computed, and written to it, ref. write_geo_cell_data, so the next read is instant.
                  */
-                bool read(shared_ptr<vector<cell_t>> cells) {
+                bool read(shared_ptr<vector<cell_t>> cells,const string& gcd_file="") {
+                    vector<ec::geo_cell_data> gcd;
+                    if(gcd_file.empty() || !read_geo_cell_data(gcd_file,gcd)) {
+                        gcd=compute_geo_cell_data();
+                        if(gcd_file.size())
+                            write_geo_cell_data(gcd_file,gcd);
+                    }
+                    // Step 5. Finally, create the result as a vector of cell_t, with default state and parameters.
+                    cells->clear();//auto cells= make_shared< vector<cell_t> >();
+                    cells->reserve(gcd.size());
+                    state_t cell_state;// need a state to fill in first time
+                    cell_state.kirchner.q=100.0;
+                    auto global_parameter= make_shared<shyft::core::pt_gs_k::parameter_t>(); // do we need an initial
+                    for(const auto& g:gcd){
+                        cells->emplace_back(cell_t{g,global_parameter,cell_state});
+                    }
+                    // this is how we could create a : region_model_t rm(*global_parameter,cells);
+                    return cells->size()>0;
+                }
 
+                /** \brief compute the geo_cell_data of the cells from the files, in catchment and grid order */
+                vector<ec::geo_cell_data> compute_geo_cell_data() const {
                     // Step 1: get the files into maps/multi_polygons so that we can compute the cells.
                     wkt_reader wkt_io;
                     auto forests=wkt_io.read("forest",slurp(test_path(subdir+"/landtype_forest_wkt.txt")));
@@ -607,19 +674,10 @@ namespace shyft {
                         throw runtime_error("cell_file_repository: expected more than zero catchments in input data");
                     if(region.area_errors>0)
                         throw runtime_error("cell_file_repository: area_errors reported on geometry input data");
-                    // Step 5. Finally, create the result as a vector of cell_t, with default state and parameters.
-                    cells->clear();//auto cells= make_shared< vector<cell_t> >();
-                    cells->reserve(rg.n_cells());
-                    state_t cell_state;// need a state to fill in first time
-                    cell_state.kirchner.q=100.0;
-                    auto global_parameter= make_shared<shyft::core::pt_gs_k::parameter_t>(); // do we need an initial
-                    for(const auto& kv:gcd_map) {
-                        for(const auto& gcd:kv.second){
-                            cells->emplace_back(cell_t{gcd,global_parameter,cell_state});
-                        }
-                    }
-                    // this is how we could create a : region_model_t rm(*global_parameter,cells);
-                    return cells->size()>0;
+                    vector<ec::geo_cell_data> r;
+                    for(auto& kv:gcd_map)
+                        r.insert(r.end(),kv.second.begin(),kv.second.end());
+                    return r;
                 }
             };
 
@@ -103,6 +103,9 @@ void shyft::time_series::dd::srep::srating_curve_ts::serialize(Archive &ar, cons
 template<class Archive>
 void shyft::time_series::dd::srep::skrls_interpolation_ts::serialize(Archive &ar, const unsigned /*version*/) { ar & ts & predictor; }
 
+template<class Archive>
+void shyft::time_series::dd::srep::ssum_ts::serialize(Archive &ar, const unsigned /*version*/) { ar & tsv & compensated; }
+
 x_serialize_implement(shyft::time_series::dd::srep::saverage_ts);
 x_serialize_implement(shyft::time_series::dd::srep::sintegral_ts);
 x_serialize_implement(shyft::time_series::dd::srep::saccumulate_ts);
@@ -110,6 +113,7 @@ x_serialize_implement(shyft::time_series::dd::srep::speriodic_ts);
 x_serialize_implement(shyft::time_series::dd::srep::sconvolve_w_ts);
 x_serialize_implement(shyft::time_series::dd::srep::srating_curve_ts);
 x_serialize_implement(shyft::time_series::dd::srep::skrls_interpolation_ts);
+x_serialize_implement(shyft::time_series::dd::srep::ssum_ts);
 x_serialize_implement(shyft::time_series::dd::compressed_ts_expression);
 
 using shyft::core::core_oarchive;
@@ -122,4 +126,5 @@ x_serialize_archive(shyft::time_series::dd::srep::saccumulate_ts, core_oarchive,
 x_serialize_archive(shyft::time_series::dd::srep::speriodic_ts, core_oarchive, core_iarchive);
 x_serialize_archive(shyft::time_series::dd::srep::sconvolve_w_ts, core_oarchive, core_iarchive);
 x_serialize_archive(shyft::time_series::dd::srep::srating_curve_ts, core_oarchive, core_iarchive);
-x_serialize_archive(shyft::time_series::dd::srep::skrls_interpolation_ts, core_oarchive, core_iarchive);
\ No newline at end of file
+x_serialize_archive(shyft::time_series::dd::srep::skrls_interpolation_ts, core_oarchive, core_iarchive);
+x_serialize_archive(shyft::time_series::dd::srep::ssum_ts, core_oarchive, core_iarchive);
\ No newline at end of file
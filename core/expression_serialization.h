@@ -3,6 +3,7 @@
 #include <future>
 #include <utility>
 #include <tuple>
+#include <sstream>
 
 #include <boost/variant.hpp>
 
@@ -11,6 +12,7 @@
 #include "time_series_dd.h"
 
 #include "core_serialization.h"
+#include "core_archive.h"
 
 
 //-- notice that boost serialization require us to
@@ -67,6 +69,8 @@ namespace shyft { namespace time_series { namespace dd {
     *  3. ts_expr_converter, add if-then-else for your class (similar contents as for other, how to create srep::snew_ts_type from new_ts_type
     *
     *  4. in ts_expr_deserialize_visitor, add your make(...) method to construct new_ts_type from it serializable type snew_ts_type.
+    *
+    *  5. add fields(f) to snew_ts_type, and a make(...) method to ts_expression_cse, that rebuilds new_ts_type when its children changed.
     */
 
 
@@ -103,7 +107,8 @@ namespace shyft { namespace time_series { namespace dd {
         o_index<extend_ts>,
         o_index<rating_curve_ts>,
         o_index<krls_interpolation_ts>,
-        o_index<qac_ts>
+        o_index<qac_ts>,
+        o_index<sum_ts>
     >;
 
     namespace srep {
@@ -133,6 +138,8 @@ namespace shyft { namespace time_series { namespace dd {
             iop_t op; // + ..
             a_index lhs, rhs;
             bool operator==(const sbinop_op_ts& o) const { return op == o.op && lhs == o.lhs && rhs == o.rhs; }
+            /** visits the members that identify the node structurally, ref. ts_expression_cse */
+            template<class F> void fields(F&& f) const { f(op); f(lhs); f(rhs); }
         };
         template<> struct _type<abin_op_ts> { using rep_t = srep::sbinop_op_ts; };
 
@@ -142,6 +149,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index lhs;
             double rhs;
             bool operator==(const sbinop_ts_scalar& o) const { return op == o.op && lhs == o.lhs && rhs == o.rhs; }
+            template<class F> void fields(F&& f) const { f(op); f(lhs); f(rhs); }
         };
         template<> struct _type<abin_op_ts_scalar> { using rep_t = srep::sbinop_ts_scalar; };
 
@@ -151,6 +159,7 @@ namespace shyft { namespace time_series { namespace dd {
             double lhs;
             a_index rhs;
             bool operator==(const sbin_op_scalar_ts& o) const { return op == o.op && lhs == o.lhs && rhs == o.rhs; }
+            template<class F> void fields(F&& f) const { f(op); f(lhs); f(rhs); }
         };
         template<> struct _type<abin_op_scalar_ts> { using rep_t = srep::sbin_op_scalar_ts; };
 
@@ -158,6 +167,7 @@ namespace shyft { namespace time_series { namespace dd {
             using ts_t = abs_ts;
             a_index ts;
             bool operator==(const sabs_ts& o) const { return ts == o.ts; }
+            template<class F> void fields(F&& f) const { f(ts); }
         };
         template<> struct _type<abs_ts> { using rep_t = srep::sabs_ts; };
 
@@ -166,6 +176,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             gta_t ta;
             bool operator==(const saverage_ts& o) const { return ts == o.ts && ta == o.ta; }
+            template<class F> void fields(F&& f) const { f(ts); f(ta); }
             x_serialize_decl();// this class needs to serialize time-axis,
         };
         template<> struct _type<average_ts> { using rep_t = srep::saverage_ts; };
@@ -175,6 +186,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             gta_t ta;
             bool operator==(const sintegral_ts& o) const { return ts == o.ts && ta == o.ta; }
+            template<class F> void fields(F&& f) const { f(ts); f(ta); }
             x_serialize_decl();// this class needs to serialize time-axis,
         };
         template<> struct _type<integral_ts> { using rep_t = srep::sintegral_ts; };
@@ -184,6 +196,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             gta_t ta;
             bool operator==(const saccumulate_ts& o) const { return ts == o.ts && ta == o.ta; }
+            template<class F> void fields(F&& f) const { f(ts); f(ta); }
             x_serialize_decl();// this class needs to serialize time-axis,
         };
         template<> struct _type<accumulate_ts> { using rep_t = srep::saccumulate_ts; };
@@ -193,6 +206,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             utctimespan dt;
             bool operator==(const stime_shift_ts& o) const { return ts == o.ts && dt == o.dt; }
+            template<class F> void fields(F&& f) const { f(ts); f(dt); }
         };
         template<> struct _type<time_shift_ts> { using rep_t = srep::stime_shift_ts; };
 
@@ -200,6 +214,7 @@ namespace shyft { namespace time_series { namespace dd {
             using ts_t = periodic_ts;
             periodic_ts::pts_t ts;
             bool operator==(const speriodic_ts& o) const { return ts == o.ts; }
+            template<class F> void fields(F&& f) const { f(ts); }
             x_serialize_decl();// this class needs to serialize time-axis,
         };
         template<> struct _type<periodic_ts> { using rep_t = srep::speriodic_ts; };
@@ -210,6 +225,7 @@ namespace shyft { namespace time_series { namespace dd {
             vector<double> w;
             time_series::convolve_policy policy;
             bool operator==(const sconvolve_w_ts& o) const { return ts == o.ts && w == o.w && policy == o.policy; }
+            template<class F> void fields(F&& f) const { f(ts); f(w); f(policy); }
             x_serialize_decl();// this class needs to serialize time-axis,
         };
         template<> struct _type<convolve_w_ts> { using rep_t = srep::sconvolve_w_ts; };
@@ -226,6 +242,7 @@ namespace shyft { namespace time_series { namespace dd {
                 return lhs == o.lhs && rhs == o.rhs && ets_split_p == o.ets_split_p && split_at == o.split_at && ets_fill_p == o.ets_fill_p
                     && ((std::isfinite(fill_value) && std::isfinite(o.fill_value)) || (fill_value == o.fill_value));
             }
+            template<class F> void fields(F&& f) const { f(lhs); f(rhs); f(ets_split_p); f(split_at); f(ets_fill_p); f(fill_value); }
         };
         template<> struct _type<extend_ts> { using rep_t = srep::sextend_ts; };
 
@@ -234,6 +251,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             rating_curve_parameters rc_param;
             bool operator==(const srating_curve_ts& o) const { return ts == o.ts; } //TODO rc_param.equal(o.rc_param)
+            template<class F> void fields(F&& f) const { f(ts); f(rc_param); }
             x_serialize_decl();// needed because of rc_param
         };
         template<> struct _type<rating_curve_ts> { using rep_t = srep::srating_curve_ts; };
@@ -243,6 +261,7 @@ namespace shyft { namespace time_series { namespace dd {
             a_index ts;
             krls_interpolation_ts::krls_p predictor;
             bool operator==(const sconvolve_w_ts& o) const { return ts == o.ts; } //TODO predictor.equal(o.predictor)
+            template<class F> void fields(F&& f) const { f(ts); f(predictor); }
             x_serialize_decl();// needed because of predictor
         };
         template<> struct _type<krls_interpolation_ts> { using rep_t = srep::skrls_interpolation_ts; };
@@ -253,9 +272,41 @@ namespace shyft { namespace time_series { namespace dd {
             a_index cts;
             qac_parameter p;
             bool operator==(const sqac_ts& o) const { return ts == o.ts && cts == o.cts && p.equal(o.p, 1e-10); } //
+            template<class F> void fields(F&& f) const { f(ts); f(cts); f(p.max_timespan); f(p.min_x); f(p.max_x); }
         };
         template<> struct _type<qac_ts> { using rep_t = srep::sqac_ts; };
 
+        struct ssum_ts {
+            using ts_t = sum_ts;
+            vector<a_index> tsv;
+            bool compensated;
+            bool operator==(const ssum_ts& o) const { return tsv == o.tsv && compensated == o.compensated; }
+            template<class F> void fields(F&& f) const { f(compensated); f(tsv.size()); for (const auto& t : tsv) f(t); }
+            x_serialize_decl();// needed because of the vector of terms
+        };
+        template<> struct _type<sum_ts> { using rep_t = srep::ssum_ts; };
+
+        /** index value of a_index, 0 for blank */
+        struct index_value_visitor : boost::static_visitor<size_t> {
+            size_t operator()(boost::blank) const { return 0; }
+            template<class T> size_t operator()(o_index<T> i) const { return i.value; }
+        };
+
+        /** builds the structural key of a node from its fields(), a type tag followed by the binary serialized fields.
+         * a_index is written as which(),value, since the bitwise a_index includes padding.
+         */
+        struct key_writer {
+            std::ostringstream os;
+            core::core_oarchive oa;
+            explicit key_writer(int type_tag) : oa(os, core_arch_flags) { int64_t t = type_tag; oa << t; }
+            void operator()(const a_index& i) {
+                int64_t w = i.which();
+                size_t v = boost::apply_visitor(index_value_visitor(), i);
+                oa << w << v;
+            }
+            template<class T> void operator()(const T& x) { oa << x; }
+            string key() const { return os.str(); }
+        };
     } // namespace srep
 
 
@@ -272,6 +323,7 @@ namespace shyft { namespace time_series { namespace dd {
     struct ts_expression {
         tuple<vector<srep_types>...> ts_reps; // serialization, require tuple  supported.
         vector<gpoint_ts*> gts; //no ownership
+        vector<shared_ptr<gpoint_ts>> dense_gts; // ownership of the dense gts made from grle_ts terminals, not serialized
         vector<aref_ts*> rts; // no ownership
         vector<a_index> roots;// serialize
 
@@ -307,8 +359,19 @@ namespace shyft { namespace time_series { namespace dd {
         tuple< unordered_map< typename srep_types::ts_t*, o_index<typename srep_types::ts_t>> ...> ts_maps;
         unordered_map<gpoint_ts*, o_index<gpoint_ts>> gts_map; // terminal gpoint_ts is specially handled
         unordered_map<aref_ts *, o_index<aref_ts>> rts_map;// terminal aref_ts is also specially handled
+        unordered_map<grle_ts *, o_index<gpoint_ts>> rle_map;// terminal grle_ts is serialized as a dense gpoint_ts
         ts_expression<srep_types...> expr;
 
+        //-- structural mode, used by ts_expression_cse, where equal nodes, and aref_ts with equal id, get the same o_index
+        bool structural = false;
+        bool merge_bound_refs = true;///< in structural mode, if false, only unbound aref_ts are merged by id, ref. compress_shared
+        unordered_map<string, size_t> node_keys;///< type-tagged structural key of each node -> index
+        unordered_map<string, o_index<aref_ts>> rts_id_map;
+        tuple<vector<shared_ptr<typename srep_types::ts_t>>...> originals;///< the first node converted to each index
+        vector<shared_ptr<ipoint_ts>> gts_originals, rts_originals;
+
+        template <class ...> friend struct ts_expression_cse;
+
         /** given type of ts T, return the corresponding unordered_map from the tuple ts_map*/
         template<class T>
         auto & ts_map(const T*) {
@@ -316,6 +379,20 @@ namespace shyft { namespace time_series { namespace dd {
             return get< unordered_map<T*, o_index<T>>  >(ts_maps);
         }
 
+        /** append node o, converted from ts, to expr, in structural mode to the existing equal node if any */
+        template<class R, class T>
+        size_t append(const R& o, const apoint_ts& ats, T* ts) {
+            if (!structural)
+                return expr.append(o);
+            srep::key_writer kw(a_index(o_index<T>{0}).which());
+            o.fields(kw);
+            auto f = node_keys.find(kw.key());
+            if (f != end(node_keys))
+                return f->second;
+            get<vector<shared_ptr<T>>>(originals).emplace_back(ats.ts, ts);
+            return node_keys[kw.key()] = expr.append(o);
+        }
+
         /**recursive converter, that descends apoint_ts and building up the
         * internal expr type, along with the temporary ts_maps that ensures
         * we reference same object with same o_index.
@@ -331,58 +408,82 @@ namespace shyft { namespace time_series { namespace dd {
             #define _m_find_ts_map(ts) auto &m=ts_map(ts);auto f=m.find(ts);if(f!=end(m))return f->second
             if (auto ts = dynamic_cast<abin_op_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<abin_op_ts>{ expr.append(srep::_type<abin_op_ts>::rep_t{ ts->op,convert(ts->lhs),convert(ts->rhs) }) };
+                return m[ts] = o_index<abin_op_ts>{ append(srep::_type<abin_op_ts>::rep_t{ ts->op,convert(ts->lhs),convert(ts->rhs) }, ats, ts) };
             } else if (auto ts = dynamic_cast<abin_op_ts_scalar*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<abin_op_ts_scalar>{ expr.append(srep::_type<abin_op_ts_scalar>::rep_t{ ts->op,convert(ts->lhs),ts->rhs }) };
+                return m[ts] = o_index<abin_op_ts_scalar>{ append(srep::_type<abin_op_ts_scalar>::rep_t{ ts->op,convert(ts->lhs),ts->rhs }, ats, ts) };
             } else if (auto ts = dynamic_cast<abin_op_scalar_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<abin_op_scalar_ts>{ expr.append(srep::_type<abin_op_scalar_ts>::rep_t{ ts->op,ts->lhs,convert(ts->rhs) }) };
+                return m[ts] = o_index<abin_op_scalar_ts>{ append(srep::_type<abin_op_scalar_ts>::rep_t{ ts->op,ts->lhs,convert(ts->rhs) }, ats, ts) };
             } else if (auto ts = dynamic_cast<abs_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<abs_ts>{ expr.append(srep::_type<abs_ts>::rep_t{ convert(apoint_ts(ts->ts)) }) };
+                return m[ts] = o_index<abs_ts>{ append(srep::_type<abs_ts>::rep_t{ convert(apoint_ts(ts->ts)) }, ats, ts) };
             } else if (auto ts = dynamic_cast<average_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<average_ts>{ expr.append(srep::_type<average_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }) };
+                return m[ts] = o_index<average_ts>{ append(srep::_type<average_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }, ats, ts) };
             } else if (auto ts = dynamic_cast<integral_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<integral_ts>{ expr.append(srep::_type<integral_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }) };
+                return m[ts] = o_index<integral_ts>{ append(srep::_type<integral_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }, ats, ts) };
             } else if (auto ts = dynamic_cast<accumulate_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<accumulate_ts>{ expr.append(srep::_type<accumulate_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }) };
+                return m[ts] = o_index<accumulate_ts>{ append(srep::_type<accumulate_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->ta }, ats, ts) };
             } else if (auto ts = dynamic_cast<time_shift_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<time_shift_ts>{ expr.append(srep::_type<time_shift_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->dt }) };
+                return m[ts] = o_index<time_shift_ts>{ append(srep::_type<time_shift_ts>::rep_t{ convert(apoint_ts(ts->ts)),ts->dt }, ats, ts) };
             } else if (auto ts = dynamic_cast<periodic_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<periodic_ts>{ expr.append(srep::_type<periodic_ts>::rep_t{ ts->ts }) };
+                return m[ts] = o_index<periodic_ts>{ append(srep::_type<periodic_ts>::rep_t{ ts->ts }, ats, ts) };
             } else if (auto ts = dynamic_cast<convolve_w_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<convolve_w_ts>{ expr.append(srep::_type<convolve_w_ts>::rep_t{ convert(ts->ts_impl.ts),ts->ts_impl.w,ts->ts_impl.policy }) };
+                return m[ts] = o_index<convolve_w_ts>{ append(srep::_type<convolve_w_ts>::rep_t{ convert(ts->ts_impl.ts),ts->ts_impl.w,ts->ts_impl.policy }, ats, ts) };
             } else if (auto ts = dynamic_cast<extend_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<extend_ts>{ expr.append(srep::_type<extend_ts>::rep_t{ convert(ts->lhs),convert(ts->rhs),ts->ets_split_p,ts->split_at,ts->ets_fill_p,ts->fill_value }) };
+                return m[ts] = o_index<extend_ts>{ append(srep::_type<extend_ts>::rep_t{ convert(ts->lhs),convert(ts->rhs),ts->ets_split_p,ts->split_at,ts->ets_fill_p,ts->fill_value }, ats, ts) };
             } else if (auto ts = dynamic_cast<rating_curve_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<rating_curve_ts>{ expr.append(srep::_type<rating_curve_ts>::rep_t{ convert(ts->ts.level_ts),ts->ts.rc_param }) };
+                return m[ts] = o_index<rating_curve_ts>{ append(srep::_type<rating_curve_ts>::rep_t{ convert(ts->ts.level_ts),ts->ts.rc_param }, ats, ts) };
             } else if (auto ts = dynamic_cast<krls_interpolation_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts);
-                return m[ts] = o_index<krls_interpolation_ts>{ expr.append(srep::_type<krls_interpolation_ts>::rep_t{ convert(ts->ts),ts->predictor }) };
+                return m[ts] = o_index<krls_interpolation_ts>{ append(srep::_type<krls_interpolation_ts>::rep_t{ convert(ts->ts),ts->predictor }, ats, ts) };
             } else  if (auto ts = dynamic_cast<qac_ts*>(ats.ts.get())) {
                 _m_find_ts_map(ts); // NOTICE that qac_ts is so far the only ts that keeps optional time-series,
-                return m[ts] = o_index<qac_ts>{ expr.append(srep::_type<qac_ts>::rep_t{ convert(apoint_ts(ts->ts)),convert(apoint_ts(ts->cts)), ts->p }) };
+                return m[ts] = o_index<qac_ts>{ append(srep::_type<qac_ts>::rep_t{ convert(apoint_ts(ts->ts)),convert(apoint_ts(ts->cts)), ts->p }, ats, ts) };
+            } else if (auto ts = dynamic_cast<sum_ts*>(ats.ts.get())) {
+                _m_find_ts_map(ts);
+                srep::_type<sum_ts>::rep_t r{ vector<a_index>{}, ts->compensated };
+                r.tsv.reserve(ts->tsv.size());
+                for (const auto& t : ts->tsv)
+                    r.tsv.push_back(convert(t));
+                return m[ts] = o_index<sum_ts>{ append(r, ats, ts) };
             } else if (auto gts = dynamic_cast<gpoint_ts*>(ats.ts.get())) {
                 auto f = gts_map.find(gts);
                 if (f != end(gts_map))
                     return f->second;
                 expr.gts.emplace_back(gts);
+                if (structural) gts_originals.push_back(ats.ts);
                 return gts_map[gts] = o_index<gpoint_ts>{ expr.gts.size() - 1 };
+            } else if (auto rle = dynamic_cast<grle_ts*>(ats.ts.get())) {
+                auto f = rle_map.find(rle);
+                if (f != end(rle_map))
+                    return f->second;
+                expr.dense_gts.emplace_back(make_shared<gpoint_ts>(rle->time_axis(), rle->values(), rle->point_interpretation()));
+                expr.gts.emplace_back(expr.dense_gts.back().get());
+                if (structural) gts_originals.push_back(ats.ts);
+                return rle_map[rle] = o_index<gpoint_ts>{ expr.gts.size() - 1 };
             } else if (auto aref = dynamic_cast<aref_ts*>(ats.ts.get())) {
                 auto f = rts_map.find(aref);
                 if (f != end(rts_map))
                     return f->second;
+                if (structural && (merge_bound_refs || aref->needs_bind())) {
+                    auto g = rts_id_map.find(aref->id);
+                    if (g != end(rts_id_map))
+                        return rts_map[aref] = g->second;
+                    rts_originals.push_back(ats.ts);
+                }
                 expr.rts.emplace_back(aref);
-                return rts_map[aref] = o_index<aref_ts>{ expr.rts.size() - 1 };
+                auto i = rts_map[aref] = o_index<aref_ts>{ expr.rts.size() - 1 };
+                if (structural && (merge_bound_refs || aref->needs_bind())) rts_id_map[aref->id] = i;
+                return i;
             } else {
                 throw runtime_error("Not supported yet");
             }
@@ -402,6 +503,24 @@ namespace shyft { namespace time_series { namespace dd {
                 ec.expr.roots.push_back(ec.convert(ats));
             return ec.expr;
         }
+
+        /** \brief as compress, but structurally equal nodes are written once, not only the shared objects
+         *
+         * Expressions built separately, like average(ref_ts('shyft://x'),daily_ta) made for each of many series,
+         * are distinct objects, so compress writes them once for each object. Here they get the same node,
+         * as for ts_expression_cse, so the size, and the decompress time, scales with the unique nodes.
+         * Unbound aref_ts are merged by id, bound ones, and gpoint_ts terminals, by identity.
+         * The result is read by the decompressor as any other, where the merged nodes are shared objects.
+         */
+        template <class V>
+        static ts_expression<srep_types...> compress_shared(const V& atsv) {
+            ts_expression_compressor ec;
+            ec.structural = true;
+            ec.merge_bound_refs = false;
+            for (const auto &ats : atsv)
+                ec.expr.roots.push_back(ec.convert(ats));
+            return ec.expr;
+        }
     };
 
     using cxx_ext::for_each;
@@ -539,6 +658,14 @@ namespace shyft { namespace time_series { namespace dd {
             return make_shared<qac_ts>(src_ts, rx.p, cts);
         }
 
+        shared_ptr<sum_ts> make(o_index<sum_ts> i) {
+            const auto& rx = expr.at(i);
+            vector<apoint_ts> tsv; tsv.reserve(rx.tsv.size());
+            for (const auto& t : rx.tsv)
+                tsv.emplace_back(boost::apply_visitor(*this, t));
+            return make_shared<sum_ts>(tsv, rx.compensated);
+        }
+
     public: // required for the visitor callbacks
             /** generic callback called by visitor for any type
             * performs lookup in the table, then if missing
@@ -593,15 +720,214 @@ namespace shyft { namespace time_series { namespace dd {
 
 
 
+    /** \brief common sub-expression elimination for a vector of bound expressions
+     *
+     * The expressions are converted by the ts_expression_compressor in structural mode, where
+     * structurally equal nodes, e.g. the same average(ref_ts('shyft://x'),daily_ta) built for many of the series,
+     * and aref_ts with equal id, get the same o_index. Each node that is then referenced more than once
+     * is evaluated once, to a gpoint_ts with its own time-axis, and the expressions above it are rebuilt using that one.
+     * Expressions with no shared nodes are kept as they are.
+     *
+     * It evaluates as the input, except that the parents of a shared node see it through its evaluated points,
+     * e.g. f(t) between the points of a shared node with linear point interpretation is the linear interpolation of the values.
+     * The gpoint_ts terminals are compared by identity, not by values.
+     *
+     * \note the expressions must be bound, as in the dtss server after do_bind_ts
+     */
+    template<class ...srep_types>
+    struct ts_expression_cse {
+        using return_type = shared_ptr<ipoint_ts>;// needed for the boost::apply_visitor pattern
+    private:
+        static constexpr size_t n_types = boost::mpl::size<a_index::types>::value;
+        ts_expression_compressor<srep_types...> c;
+        vector<vector<size_t>> n_refs;///< [a_index.which()][index], the number of references from roots and nodes
+        vector<vector<return_type>> results;///< [a_index.which()][index], the evaluated, rebuilt or original node
+        vector<vector<char>> changed;///< [a_index.which()][index], true if the result is not the original node
+        size_t n_evaluated = 0;
+
+        ts_expression_cse() : n_refs(n_types), results(n_types), changed(n_types) { c.structural = true; }
+
+        static size_t index_of(const a_index& i) { return boost::apply_visitor(srep::index_value_visitor(), i); }
+
+        /** counts the references to the children in the fields() of a node */
+        struct ref_counter {
+            vector<vector<size_t>>& n;
+            void operator()(const a_index& i) {
+                if (i.which() == 0) return;
+                auto& ni = n[i.which()];
+                const size_t v = index_of(i);
+                if (ni.size() <= v) ni.resize(v + 1, 0);
+                ++ni[v];
+            }
+            template<class T> void operator()(const T&) {}
+        };
+        struct fx_count_refs {
+            ref_counter& rc;
+            template<class ts_srep_t>
+            void operator()(const vector<ts_srep_t>& v) { for (const auto& r : v) r.fields(rc); }
+        };
+
+        bool is_shared(const a_index& i) const {
+            const auto& ni = n_refs[i.which()];
+            const size_t v = index_of(i);
+            return v < ni.size() && ni[v] > 1;
+        }
+
+        /** result of child i, changed is set if the child result is not the original */
+        return_type visit(const a_index& i, bool& ch) {
+            auto r = boost::apply_visitor(*this, i);
+            const auto& chg = changed[i.which()];// empty for terminals, they are never changed
+            const size_t v = index_of(i);
+            if (v < chg.size() && chg[v])
+                ch = true;
+            return r;
+        }
+
+        template<class T>
+        return_type original(o_index<T> i) const { return get<vector<shared_ptr<T>>>(c.originals)[i]; }
+
+        //-- section for rebuilding the nodes from their (possibly evaluated) children, ref. ts_expression_decompressor
+        //-- the original node is returned if none of the children changed
+        return_type make(o_index<abin_op_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts lhs{ visit(r.lhs, ch) }, rhs{ visit(r.rhs, ch) };
+            return ch ? make_shared<abin_op_ts>(move(lhs), r.op, move(rhs)) : original(i);
+        }
+        return_type make(o_index<abin_op_scalar_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts rhs{ visit(r.rhs, ch) };
+            return ch ? make_shared<abin_op_scalar_ts>(r.lhs, r.op, move(rhs)) : original(i);
+        }
+        return_type make(o_index<abin_op_ts_scalar> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts lhs{ visit(r.lhs, ch) };
+            return ch ? make_shared<abin_op_ts_scalar>(move(lhs), r.op, r.rhs) : original(i);
+        }
+        return_type make(o_index<abs_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            auto ts = visit(r.ts, ch);
+            return ch ? make_shared<abs_ts>(ts) : original(i);
+        }
+        return_type make(o_index<average_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            auto ts = visit(r.ts, ch);
+            return ch ? make_shared<average_ts>(r.ta, ts) : original(i);
+        }
+        return_type make(o_index<integral_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            auto ts = visit(r.ts, ch);
+            return ch ? make_shared<integral_ts>(r.ta, ts) : original(i);
+        }
+        return_type make(o_index<accumulate_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            auto ts = visit(r.ts, ch);
+            return ch ? make_shared<accumulate_ts>(r.ta, ts) : original(i);
+        }
+        return_type make(o_index<time_shift_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            auto ts = visit(r.ts, ch);
+            return ch ? make_shared<time_shift_ts>(ts, r.dt) : original(i);
+        }
+        return_type make(o_index<periodic_ts> i) { return original(i); }
+        return_type make(o_index<convolve_w_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts ts{ visit(r.ts, ch) };
+            return ch ? make_shared<convolve_w_ts>(move(ts), r.w, r.policy) : original(i);
+        }
+        return_type make(o_index<extend_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts lhs{ visit(r.lhs, ch) }, rhs{ visit(r.rhs, ch) };
+            return ch ? make_shared<extend_ts>(lhs, rhs, r.ets_split_p, r.ets_fill_p, r.split_at, r.fill_value) : original(i);
+        }
+        return_type make(o_index<rating_curve_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts lts{ visit(r.ts, ch) };
+            return ch ? make_shared<rating_curve_ts>(move(lts), r.rc_param) : original(i);
+        }
+        return_type make(o_index<krls_interpolation_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts src_ts{ visit(r.ts, ch) };
+            return ch ? make_shared<krls_interpolation_ts>(move(src_ts), r.predictor) : original(i);
+        }
+        return_type make(o_index<qac_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            apoint_ts src_ts{ visit(r.ts, ch) };
+            apoint_ts cts;
+            if (r.cts.which() != 0)
+                cts = apoint_ts(visit(r.cts, ch));
+            return ch ? make_shared<qac_ts>(src_ts, r.p, cts) : original(i);
+        }
+        return_type make(o_index<sum_ts> i) {
+            const auto& r = c.expr.at(i); bool ch = false;
+            vector<apoint_ts> tsv; tsv.reserve(r.tsv.size());
+            for (const auto& t : r.tsv)
+                tsv.emplace_back(visit(t, ch));
+            return ch ? make_shared<sum_ts>(tsv, r.compensated) : original(i);
+        }
+
+    public: // required for the visitor callbacks
+        /** generic callback for the nodes, rebuilds node i if needed, then evaluates it if it is shared */
+        template<class T>
+        return_type operator()(o_index<T> i) {
+            const a_index ai{ i };
+            auto& res = results[ai.which()];
+            auto& chg = changed[ai.which()];
+            if (res.size() <= i) { res.resize(i + 1); chg.resize(i + 1, 0); }
+            if (res[i])
+                return res[i];
+            auto x = make(i);
+            bool ch = x != original(i);
+            if (ch)
+                x->do_bind();// the children are bound
+            if (is_shared(ai)) {
+                x = make_shared<gpoint_ts>(x->time_axis(), x->values(), x->point_interpretation());
+                ch = true;
+                ++n_evaluated;
+            }
+            chg[i] = ch;
+            return res[i] = x;
+        }
+        /** terminals are kept as they are */
+        return_type operator()(o_index<aref_ts> i) { return c.rts_originals[i]; }
+        return_type operator()(o_index<gpoint_ts> i) { return c.gts_originals[i]; }
+        return_type operator()(boost::blank) { return return_type{}; }
+
+    public: // interface to be used:
+        /** \brief returns atsv where each shared sub-expression is evaluated once
+         * \param atsv the bound expressions
+         * \param n_shared if not null, set to the number of shared nodes that was evaluated
+         * \return equivalent expressions, in the same order
+         */
+        template <class V>
+        static vector<apoint_ts> eliminate(const V& atsv, size_t* n_shared = nullptr) {
+            ts_expression_cse e;
+            for (const auto& ats : atsv)
+                e.c.expr.roots.push_back(e.c.convert(ats));
+            ref_counter rc{ e.n_refs };
+            for (const auto& root : e.c.expr.roots)
+                rc(root);
+            fx_count_refs cr{ rc };
+            for_each(e.c.expr.ts_reps, cr);
+            vector<apoint_ts> r; r.reserve(e.c.expr.roots.size());
+            for (const auto& root : e.c.expr.roots)
+                r.push_back(apoint_ts{ boost::apply_visitor(e, root) });
+            if (n_shared)
+                *n_shared = e.n_evaluated;
+            return r;
+        }
+    };
+
     //-- finally, concrete types that uses the tuple/variant based template framework above
     //--
     /**convinient macro to use for all know types, use as parameter-pack to ts_exp_rep, etc.*/
 #define all_srep_types  srep::sbinop_op_ts, srep::sbinop_ts_scalar, srep::sbin_op_scalar_ts, srep::sabs_ts, srep::saverage_ts, srep::sintegral_ts, srep::saccumulate_ts, \
-            srep::stime_shift_ts, srep::speriodic_ts, srep::sconvolve_w_ts, srep::sextend_ts, srep::srating_curve_ts, srep::skrls_interpolation_ts, srep::sqac_ts
+            srep::stime_shift_ts, srep::speriodic_ts, srep::sconvolve_w_ts, srep::sextend_ts, srep::srating_curve_ts, srep::skrls_interpolation_ts, srep::sqac_ts, \
+            srep::ssum_ts
 
     typedef ts_expression<all_srep_types> compressed_ts_expression;
     typedef ts_expression_compressor<all_srep_types> expression_compressor;
     typedef ts_expression_decompressor<all_srep_types> expression_decompressor;
+    typedef ts_expression_cse<all_srep_types> expression_cse;
 
 }}} // shyft.time_series::dd
 
@@ -622,6 +948,7 @@ x_serialize_export_key(shyft::time_series::dd::srep::speriodic_ts);
 x_serialize_export_key(shyft::time_series::dd::srep::sconvolve_w_ts);
 x_serialize_export_key(shyft::time_series::dd::srep::srating_curve_ts);
 x_serialize_export_key(shyft::time_series::dd::srep::skrls_interpolation_ts);
+x_serialize_export_key(shyft::time_series::dd::srep::ssum_ts);
 
 
 
@@ -642,4 +969,5 @@ x_serialize_binary(shyft::time_series::dd::o_index<shyft::time_series::dd::exten
 x_serialize_binary(shyft::time_series::dd::o_index<shyft::time_series::dd::rating_curve_ts>);
 x_serialize_binary(shyft::time_series::dd::o_index<shyft::time_series::dd::krls_interpolation_ts>);
 x_serialize_binary(shyft::time_series::dd::o_index<shyft::time_series::dd::qac_ts>);
+x_serialize_binary(shyft::time_series::dd::o_index<shyft::time_series::dd::sum_ts>);
 x_serialize_binary(boost::blank);
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include <unordered_map>
+#include <memory>
+#include <vector>
+
+#include "time_series_dd.h"
+
+namespace shyft {
+    namespace time_series {
+        namespace dd {
+
+    /** \brief algebraic simplification of bound expressions, removing nodes that do not change the result
+     *
+     * The rewrites are
+     *  - time_shift(time_shift(x,a),b) -> time_shift(x,a+b), and x if a+b is 0
+     *  - abs(abs(x)) -> abs(x)
+     *  - average(average(x,ta),ta) -> average(x,ta), with equal time-axis
+     *  - (x+a)+b -> x+(a+b), as well as the other add/sub chains, and likewise (x*a)*b -> x*(a*b) for the mul/div chains
+     *  - x+0, x-0, 0+x, x*1, x/1, 1*x -> x, if the point interpretation of the node is that of x
+     *
+     * The values are the same as for the input, except for the rounding of the folded scalars of the chains.
+     * The nodes are rewritten in place, so the expressions must be owned by the caller, as in the dtss server
+     * after do_bind_ts, and a node shared by several expressions is visited once, and stays shared.
+     * The arithmetic, abs, shift, average, integral, accumulate, extend and qac nodes are visited,
+     * the nodes below other kinds of nodes are kept as they are.
+     */
+    struct expression_simplifier {
+        size_t n_rewrites = 0;///< the number of nodes removed or merged
+
+        /** \brief simplify the expressions of atsv in place \return the number of rewrites */
+        template<class V>
+        static size_t simplify(V& atsv) {
+            expression_simplifier s;
+            for (auto& ats : atsv)
+                s.visit(ats.ts);
+            return s.n_rewrites;
+        }
+
+        /** \brief replace p by its simplified node */
+        void visit(std::shared_ptr<ipoint_ts>& p) {
+            if (!p)
+                return;
+            auto f = done.find(p.get());
+            if (f != done.end()) {
+                p = f->second;
+                return;
+            }
+            auto key = p.get();
+            auto r = rewrite(p);
+            done.emplace(key, r);
+            p = r;
+        }
+
+      private:
+        std::unordered_map<const ipoint_ts*, std::shared_ptr<ipoint_ts>> done;///< the simplified node of each visited node
+
+        template<class T>
+        static T* as(const std::shared_ptr<ipoint_ts>& p) { return dynamic_cast<T*>(p.get()); }
+
+        static bool is_add_sub(iop_t op) { return op == iop_t::OP_ADD || op == iop_t::OP_SUB; }
+        static bool is_mul_div(iop_t op) { return op == iop_t::OP_MUL || op == iop_t::OP_DIV; }
+
+        /** \return the node of p, after its children are simplified, or the node replacing it */
+        std::shared_ptr<ipoint_ts> rewrite(const std::shared_ptr<ipoint_ts>& p) {
+            if (auto b = as<abin_op_ts>(p)) {
+                visit(b->lhs.ts);
+                visit(b->rhs.ts);
+            } else if (auto b = as<abin_op_ts_scalar>(p)) {
+                visit(b->lhs.ts);
+                if (auto c = as<abin_op_ts_scalar>(b->lhs.ts)) {// (x op1 a) op2 b
+                    if (is_add_sub(b->op) && is_add_sub(c->op)) {
+                        b->rhs = (c->op == iop_t::OP_ADD ? c->rhs : -c->rhs) + (b->op == iop_t::OP_ADD ? b->rhs : -b->rhs);
+                        b->op = iop_t::OP_ADD;
+                        b->lhs = c->lhs;
+                        ++n_rewrites;
+                    } else if (is_mul_div(b->op) && is_mul_div(c->op)) {
+                        if (b->op == c->op) {
+                            b->rhs = c->rhs*b->rhs;// x*a*b = x*(a*b), x/a/b = x/(a*b)
+                        } else {
+                            b->rhs = b->op == iop_t::OP_MUL ? b->rhs/c->rhs : c->rhs/b->rhs;// x/a*b = x*(b/a), x*a/b = x*(a/b)
+                            b->op = iop_t::OP_MUL;
+                        }
+                        b->lhs = c->lhs;
+                        ++n_rewrites;
+                    }
+                }
+                const bool identity = ((b->op == iop_t::OP_ADD || b->op == iop_t::OP_SUB) && b->rhs == 0.0)
+                                   || ((b->op == iop_t::OP_MUL || b->op == iop_t::OP_DIV) && b->rhs == 1.0);
+                if (identity && b->bound && b->lhs.ts && b->lhs.ts->point_interpretation() == b->fx_policy) {
+                    ++n_rewrites;
+                    return b->lhs.ts;
+                }
+            } else if (auto b = as<abin_op_scalar_ts>(p)) {
+                visit(b->rhs.ts);
+                const bool identity = (b->op == iop_t::OP_ADD && b->lhs == 0.0) || (b->op == iop_t::OP_MUL && b->lhs == 1.0);
+                if (identity && b->bound && b->rhs.ts && b->rhs.ts->point_interpretation() == b->fx_policy) {
+                    ++n_rewrites;
+                    return b->rhs.ts;
+                }
+            } else if (auto a = as<abs_ts>(p)) {
+                visit(a->ts);
+                if (auto c = as<abs_ts>(a->ts)) {
+                    a->ts = c->ts;
+                    ++n_rewrites;
+                }
+            } else if (auto a = as<time_shift_ts>(p)) {
+                visit(a->ts);
+                if (auto c = as<time_shift_ts>(a->ts)) {
+                    a->dt += c->dt;
+                    a->ts = c->ts;
+                    ++n_rewrites;
+                }
+                if (a->dt == 0) {
+                    ++n_rewrites;
+                    return a->ts;
+                }
+            } else if (auto a = as<average_ts>(p)) {
+                visit(a->ts);
+                if (auto c = as<average_ts>(a->ts)) {
+                    if (c->ta == a->ta) {
+                        a->ts = c->ts;
+                        ++n_rewrites;
+                    }
+                }
+            } else if (auto a = as<integral_ts>(p)) {
+                visit(a->ts);
+            } else if (auto a = as<accumulate_ts>(p)) {
+                visit(a->ts);
+            } else if (auto e = as<extend_ts>(p)) {
+                visit(e->lhs.ts);
+                visit(e->rhs.ts);
+            } else if (auto q = as<qac_ts>(p)) {
+                visit(q->ts);
+                visit(q->cts);
+            } else if (auto a = as<sum_ts>(p)) {
+                for (auto& t : a->tsv)
+                    visit(t.ts);
+            }
+            return p;
+        }
+    };
+
+        }
+    }
+}
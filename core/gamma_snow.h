@@ -61,6 +61,7 @@ namespace shyft {
                 double snow_cv_forest_factor=0.0;///< [ratio] the effective snow_cv gets an additional value of geo.forest_fraction()*snow_cv_forest_factor
                 double snow_cv_altitude_factor=0.0;///< [1/m] the effective snow_cv gets an additional value of altitude[m]* snow_cv_altitude_factor
                 size_t n_winter_days=221;///< # winter is from [winter_end_day_of_year - n_winter_days, winter_end_day_of_year], default yyyy.09.01 yyyy+1.04.10
+                bool fast_math=false;///< use the fast_gamma_p approximation instead of boost::math::gamma_p for the snow distribution, ref. fast_gamma_p_eps
                 parameter(size_t winter_end_day_of_year = 100,double initial_bare_ground_fraction = 0.04,double snow_cv = 0.4,double tx = -0.5,
                           double wind_scale = 2.0,double wind_const = 1.0,double max_water = 0.1,double surface_magnitude = 30.0,double max_albedo = 0.9,
                           double min_albedo = 0.6,double fast_albedo_decay_rate = 5.0,double slow_albedo_decay_rate = 5.0,double snowfall_reset_depth = 5.0,
@@ -85,7 +86,11 @@ namespace shyft {
                 }
                 /** \returns true if specified t is within the snow season, e.g. sept.. winder_end_day_of_year */
                 bool is_snow_season(utctime t) const {
-                    utctime t_w_end = cal.trim(t,calendar::YEAR) + deltahours(winter_end_day_of_year*24);
+                    return is_snow_season_in_year(t, cal.trim(t, calendar::YEAR));
+                }
+                /** \returns is_snow_season(t), with the precomputed start of the year of t, ref. time_axis::calendar_terms */
+                bool is_snow_season_in_year(utctime t, utctime year_start) const {
+                    utctime t_w_end = year_start + deltahours(winter_end_day_of_year*24);
                     utcperiod snow_period{t_w_end - deltahours(n_winter_days*24),t_w_end};
                     return snow_period.contains(t);
                 }
@@ -96,6 +101,67 @@ namespace shyft {
             };
 
 
+            const double fast_gamma_p_eps = 1.0e-9;///< truncation error of the fast_gamma_p series and continued fraction
+            const int fast_gamma_p_max_iterations = 1000;
+
+            /** \returns ln(gamma(a)) for a > 0, Lanczos approximation (g=7,n=9), relative error < 1e-14 */
+            inline double fast_lgamma(double a) {
+                static const double c[9] = {0.99999999999980993, 676.5203681218851, -1259.1392167224028, 771.32342877765313,
+                                            -176.61502916214059, 12.507343278686905, -0.13857109526572012, 9.9843695780195716e-6, 1.5056327351493116e-7};
+                if (a < 0.5) // use gamma(a) = gamma(a+1)/a, keeping the approximation where it is accurate
+                    return fast_lgamma(a + 1.0) - log(a);
+                a -= 1.0;
+                double s = c[0];
+                for (int i = 1; i < 9; ++i) s += c[i]/(a + i);
+                const double t = a + 7.5;
+                return 0.91893853320467274 + (a + 0.5)*log(t) - t + log(s);// 0.9189.. = ln(sqrt(2 pi))
+            }
+
+            /** \brief the regularized lower incomplete gamma P(a,x), and P(a+1,x), as used by the snow distribution */
+            struct incomplete_gamma_pair {
+                double p = 0.0;///< P(a,x)
+                double p1 = 0.0;///< P(a+1,x) = P(a,x) - x^a exp(-x)/gamma(a+1)
+            };
+
+            /** \brief fast computation of P(a,x) and P(a+1,x) for a > 0, x >= 0
+             *
+             * Uses the power series of P for x < a+1, and the Lentz evaluated continued fraction of Q=1-P otherwise,
+             * both truncated at fast_gamma_p_eps relative change, so the absolute error is bounded by about 10*fast_gamma_p_eps.
+             * Both values share the prefix term, which is the quantity the snow distribution needs in addition to P(a,x).
+             */
+            inline incomplete_gamma_pair fast_gamma_p(double a, double x) {
+                incomplete_gamma_pair r;
+                if (!(x > 0.0)) return r;
+                const double prefix = exp(a*log(x) - x - fast_lgamma(a + 1.0));// x^a exp(-x)/gamma(a+1)
+                if (x < a + 1.0) {
+                    double term = 1.0, sum = 1.0, ap = a;
+                    for (int n = 0; n < fast_gamma_p_max_iterations; ++n) {
+                        ap += 1.0;
+                        term *= x/ap;
+                        sum += term;
+                        if (term < sum*fast_gamma_p_eps) break;
+                    }
+                    r.p = prefix*sum;
+                } else {
+                    const double tiny = 1.0e-300;
+                    double b = x + 1.0 - a, c = 1.0/tiny, d = 1.0/b, h = d;
+                    for (int i = 1; i < fast_gamma_p_max_iterations; ++i) {
+                        const double an = -i*(i - a);
+                        b += 2.0;
+                        d = an*d + b; if (fabs(d) < tiny) d = tiny;
+                        c = b + an/c; if (fabs(c) < tiny) c = tiny;
+                        d = 1.0/d;
+                        const double delta = d*c;
+                        h *= delta;
+                        if (fabs(delta - 1.0) < fast_gamma_p_eps) break;
+                    }
+                    r.p = 1.0 - prefix*a*h;// Q(a,x) = x^a exp(-x)/gamma(a) * cf
+                }
+                r.p = std::min(std::max(r.p, 0.0), 1.0);
+                r.p1 = std::max(0.0, r.p - prefix);
+                return r;
+            }
+
             struct state {
                 state (double albedo=0.4, double lwc=0.1, double surface_heat=30000.0,
                        double alpha=1.26, double sdc_melt_mean=0.0, double acc_melt=0.0,
@@ -204,20 +270,24 @@ namespace shyft {
                             - gamma_p(a, z/b);
                 }
                 */
-                inline double calc_q(const double a, const double b, const double z) const
+                inline double calc_q(const double a, const double b, const double z, const bool fast_math = false) const
                 {
+                    if (fast_math) {
+                        const auto g = fast_gamma_p(a, z/b);
+                        return a*b*g.p1 + z*(1.0 - g.p);
+                    }
                     return a*b*gamma_p(a + 1.0, z/b) + z*(1.0 - gamma_p(a, z/b));
                 }
 
                 double corr_lwc(const double z1, const double a1, const double b1,
-                    double z2, const double a2, const double b2) const {
+                    double z2, const double a2, const double b2, const bool fast_math = false) const {
                     using boost::math::tools::brent_find_minima;
                     uintmax_t iterations = 60;
                     auto digits = 12;// accurate enough,std::numeric_limits<double>::digits;
-                    double Q1 = calc_q(a1, b1, z1);
+                    double Q1 = calc_q(a1, b1, z1, fast_math);
                     auto result = brent_find_minima(
-                        [Q1, a2, b2, this](const double&z)->double {
-                            double f = this->calc_q(a2, b2, z) - Q1;
+                        [Q1, a2, b2, fast_math, this](const double&z)->double {
+                            double f = this->calc_q(a2, b2, z, fast_math) - Q1;
                             return f*f;
                         },
                         0.0, z1, digits, iterations);
@@ -227,7 +297,7 @@ namespace shyft {
 
                   void calc_snow_state(const double shape, const double scale, const double y0, const double lambda,
                                        const double lwd, const double max_water_frac, const double temp_swe,
-                                       double& swe, double& sca) const {
+                                       double& swe, double& sca, const bool fast_math = false) const {
                       double y = 0.0;
                       double y1 = 0.0;
                       const double m = shape*scale;
@@ -239,8 +309,14 @@ namespace shyft {
                           return;
                       } else {
                           const double x = lambda/scale;
-                          y = gamma_p(shape, x);
-                          y1 = y - exp(shape*log(x) - x - lgamma(shape))/shape;
+                          if (fast_math) {
+                              const auto g = fast_gamma_p(shape, x);
+                              y = g.p;
+                              y1 = g.p1;
+                          } else {
+                              y = gamma_p(shape, x);
+                              y1 = y - exp(shape*log(x) - x - lgamma(shape))/shape;
+                          }
                           swe = m*(1.0 - y1) - lambda*(1 - y);
                           sca = (1.0 - y)*(1.0 - y0);
                       }
@@ -248,8 +324,15 @@ namespace shyft {
                       else if (lwd > 0.0) {
                           const double sat = lwd/max_water_frac;
                           const double x = sat/scale;
-                          const double ssa = gamma_p(shape, x);
-                          const double ssa1 = ssa - exp(shape*log(x) - x - lgamma(shape))/shape;
+                          double ssa, ssa1;
+                          if (fast_math) {
+                              const auto g = fast_gamma_p(shape, x);
+                              ssa = g.p;
+                              ssa1 = g.p1;
+                          } else {
+                              ssa = gamma_p(shape, x);
+                              ssa1 = ssa - exp(shape*log(x) - x - lgamma(shape))/shape;
+                          }
                           const double liqwat = max_water_frac*(m*(ssa1 - y1) + sat*(1.0 - ssa) - lambda*(1.0 - y));
                           swe += liqwat;
                       }
@@ -289,6 +372,17 @@ namespace shyft {
                 void step(S& s, R& r, shyft::time_series::utctime t, shyft::time_series::utctimespan dt,
                           const P& p, const double T, const double rad, const double prec_mm_h,
                           const double wind_speed, const double rel_hum, const double forest_fraction,const double altitude) const {
+                    step_with_calendar_terms(s, r, t, dt, p, T, rad, prec_mm_h, wind_speed, rel_hum, forest_fraction, altitude, p.cal.day_of_year(t), p.cal.trim(t, calendar::YEAR));
+                }
+
+                /** \brief step as above, with the calendar terms of t precomputed, ref. time_axis::calendar_terms
+                 * \param day_of_year of t
+                 * \param year_start the start of the year of t
+                 */
+                void step_with_calendar_terms(S& s, R& r, shyft::time_series::utctime t, shyft::time_series::utctimespan dt,
+                          const P& p, const double T, const double rad, const double prec_mm_h,
+                          const double wind_speed, const double rel_hum, const double forest_fraction,const double altitude,
+                          const size_t day_of_year, const shyft::time_series::utctime year_start) const {
                     // Some special cases treated first for efficiency
 
                     // Read state vars needed early (possible early return)
@@ -297,7 +391,7 @@ namespace shyft {
                     double iso_pot_energy = s.iso_pot_energy;
                     const double prec = prec_mm_h*dt/calendar::HOUR;
 
-                    if( p.is_start_melt_season(t, dt))
+                    if (day_of_year == p.winter_end_day_of_year)// p.is_start_melt_season(t, dt)
                         acc_melt = iso_pot_energy = 0.0;
 
 
@@ -405,7 +499,7 @@ namespace shyft {
                     double sdc_scale = sdc_melt_mean/alpha;
 
                     calc_snow_state(alpha, sdc_scale, p.initial_bare_ground_fraction, acc_melt,
-                                    lwc, p.max_water, temp_swe, storage, sca);
+                                    lwc, p.max_water, temp_swe, storage, sca, p.fast_math);
 
                     double start_storage_value = storage;
 
@@ -426,10 +520,10 @@ namespace shyft {
                                 //double z1_guess = z1*0.5; // Alternative, simple initial guess
                                 if (z1_guess < gamma_snow::tol)
                                     z1_guess = z1*0.5;
-                                z1 = corr_lwc(z1, alpha_prev, sdc_scale_prev>0.0?sdc_scale_prev:sdc_scale, z1_guess, alpha, sdc_scale);
+                                z1 = corr_lwc(z1, alpha_prev, sdc_scale_prev>0.0?sdc_scale_prev:sdc_scale, z1_guess, alpha, sdc_scale, p.fast_math);
                                 lwc = z1*p.max_water;
                                 calc_snow_state(alpha, sdc_scale, p.initial_bare_ground_fraction,
-                                                acc_melt, lwc, p.max_water, temp_swe, storage, sca);
+                                                acc_melt, lwc, p.max_water, temp_swe, storage, sca, p.fast_math);
                             }
                         }
                         lwc += rain;
@@ -458,7 +552,7 @@ namespace shyft {
                         }
                         acc_melt += potential_melt;
                         lwc += rain + potential_melt;
-                        if (!p.calculate_iso_pot_energy || p.is_snow_season(t)) {
+                        if (!p.calculate_iso_pot_energy || p.is_snow_season_in_year(t, year_start)) {
                             if (storage < std::max(0.2, 2*temp_swe) || storage < 0.2*rain) {
                                 storage += snow;
                                 reset_snow_pack(sca, lwc, alpha, sdc_melt_mean, acc_melt, temp_swe, storage, p);
@@ -468,7 +562,7 @@ namespace shyft {
                     }
                     // Establish the snow pack state after this time step
                     calc_snow_state(alpha, sdc_scale, p.initial_bare_ground_fraction, acc_melt,
-                                    lwc, p.max_water, temp_swe, storage, sca);
+                                    lwc, p.max_water, temp_swe, storage, sca, p.fast_math);
 
                     outflow = prec + start_storage_value - storage;
 
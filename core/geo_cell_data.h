@@ -1,6 +1,8 @@
 #pragma once
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
+#include <vector>
 #include "core_serialization.h"
 #include "geo_point.h"
 
@@ -130,6 +132,69 @@ namespace shyft {
 			// geo-type  parts, interesting for some/most response routines, sum fractions should be <=1.0
 			x_serialize_decl();
 		};
+
+        /** \brief geo_cell_table is a packed, column-wise copy of the geo_cell_data of many cells
+         *
+         * Each property is kept in a contiguous array, with the fractions and the radiation slope factor as float,
+         * 32-bit catchment id and index, and the unspecified fraction precomputed, so a scan of one property
+         * of all cells, like the catchment checks, touches a few cache lines instead of one pr. cell.
+         * It is a copy, that must be rebuilt when the geo_cell_data of the cells changes, ref. region_model.
+         */
+        struct geo_cell_table {
+            std::vector<double> area;///< m2
+            std::vector<float> radiation_slope_factor;
+            std::vector<float> glacier;
+            std::vector<float> lake;
+            std::vector<float> reservoir;
+            std::vector<float> forest;
+            std::vector<float> unspecified;///< 1 - the sum of the other fractions
+            std::vector<int32_t> catchment_id;///< -1 if not set
+            std::vector<uint32_t> catchment_ix;
+
+            geo_cell_table() = default;
+            explicit geo_cell_table(const std::vector<geo_cell_data>& gcd) {
+                reserve(gcd.size());
+                for (const auto& g : gcd) push_back(g);
+            }
+            /** \return the table of the .geo of cells */
+            template <class C>
+            static geo_cell_table of_cells(const std::vector<C>& cells) {
+                geo_cell_table r;
+                r.reserve(cells.size());
+                for (const auto& c : cells) r.push_back(c.geo);
+                return r;
+            }
+
+            size_t size() const { return area.size(); }
+            void reserve(size_t n) {
+                area.reserve(n); radiation_slope_factor.reserve(n);
+                glacier.reserve(n); lake.reserve(n); reservoir.reserve(n); forest.reserve(n); unspecified.reserve(n);
+                catchment_id.reserve(n); catchment_ix.reserve(n);
+            }
+            void push_back(const geo_cell_data& g) {
+                const auto& f = g.land_type_fractions_info();
+                area.push_back(g.area());
+                radiation_slope_factor.push_back(float(g.radiation_slope_factor()));
+                glacier.push_back(float(f.glacier()));
+                lake.push_back(float(f.lake()));
+                reservoir.push_back(float(f.reservoir()));
+                forest.push_back(float(f.forest()));
+                unspecified.push_back(float(f.unspecified()));
+                catchment_id.push_back(int32_t(g.catchment_id()));
+                catchment_ix.push_back(uint32_t(g.catchment_ix));
+            }
+            /** \return the sum of the area of the cells ix */
+            double sum_area(const std::vector<size_t>& ix) const {
+                double s = 0.0;
+                for (auto i : ix) s += area[i];
+                return s;
+            }
+            /** \return approx. bytes allocated by the table */
+            size_t heap_bytes() const {
+                return area.capacity()*sizeof(double) + 6*radiation_slope_factor.capacity()*sizeof(float)
+                    + catchment_id.capacity()*sizeof(int32_t) + catchment_ix.capacity()*sizeof(uint32_t);
+            }
+        };
     }
 }
 //-- serialization support shyft
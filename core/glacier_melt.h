@@ -19,6 +19,8 @@
 /// Implemented by Felix Matt
 
 #pragma once
+#include <cstddef>
+
 namespace shyft {
     namespace core {
 		namespace glacier_melt {
@@ -49,6 +51,26 @@ namespace shyft {
                 return dtf*t*(glacier_area_m2-snow_covered_area_m2)* convert_m2_x_mm_d_to_m3_s;
             }
 
+            /** Glacier Melt model for a batch of n cells, out[j] equals step(dtf, t[j], cell_area_m2[j]*sca[j], glacier_area_m2[j])
+             *
+             * The loop is branch-free, so that the compiler can vectorize it.
+             *
+             * \param sca snow covered fraction of each cell [0..1]
+             *
+             * \param cell_area_m2 the area of each cell, in unit [m2]
+             *
+             * \param out glacier melt of each cell in [m3/s]
+             */
+            inline void step_batch(const double dtf, const double* t, const double* sca, const double* cell_area_m2, const double* glacier_area_m2,
+                                    double* out, const size_t n) {
+                const double convert_m2_x_mm_d_to_m3_s= 0.001/86400.0;
+                for (size_t j = 0; j < n; ++j) {
+                    const double uncovered_m2 = glacier_area_m2[j] - cell_area_m2[j]*sca[j];
+                    const double melt = dtf*t[j]*uncovered_m2*convert_m2_x_mm_d_to_m3_s;
+                    out[j] = uncovered_m2 <= 0.0 || t[j] <= 0.0 ? 0.0 : melt;// nan temperature gives nan, as step
+                }
+            }
+
 		} // glacier_melt
     } // core
 } // shyft
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "geo_point.h"
+#include "thread_pool.h"
+#include "inverse_distance.h"
+
+/**
+ * Contains the remapping of sources on a regular grid, like NWP model output, to the cells
+ */
+
+namespace shyft {
+    namespace core {
+        namespace grid_remap {
+            using namespace std;
+
+            /** \brief how the values of a regular grid are mapped to the destinations */
+            enum class remap_method : int8_t {
+                none,///< the sources are treated as scattered points, using the ordinary signal interpolation
+                bilinear,///< bilinear interpolation between the four grid nodes surrounding the destination mid-point
+                conservative///< area weighted average of the grid boxes overlapped by the destination footprint
+            };
+
+            /** \brief the layout of a regular grid in the x,y plane
+             *
+             * The nodes are at (x0 + ix*dx, y0 + iy*dy), for ix in [0..nx), iy in [0..ny),
+             * and each node represents the grid box of size dx x dy centered at the node.
+             * The order of the sources does not matter, each source is matched to its node by location.
+             */
+            struct regular_grid {
+                double x0 = 0.0;///< [m] x of the first node
+                double y0 = 0.0;///< [m] y of the first node
+                double dx = 1000.0;///< [m] node spacing along x
+                double dy = 1000.0;///< [m] node spacing along y
+                size_t nx = 0;
+                size_t ny = 0;
+
+                regular_grid() {}
+                regular_grid(double x0, double y0, double dx, double dy, size_t nx, size_t ny)
+                    : x0(x0), y0(y0), dx(dx), dy(dy), nx(nx), ny(ny) {}
+
+                size_t size() const { return nx*ny; }
+
+                bool operator==(const regular_grid& o) const {
+                    return x0 == o.x0 && y0 == o.y0 && dx == o.dx && dy == o.dy && nx == o.nx && ny == o.ny;
+                }
+                bool operator!=(const regular_grid& o) const { return !operator==(o); }
+            };
+
+            /** \brief parameter selecting the grid remapping of one signal */
+            struct parameter {
+                remap_method method = remap_method::none;
+                regular_grid grid;
+
+                parameter() {}
+                parameter(remap_method method, const regular_grid& grid) : method(method), grid(grid) {}
+
+                bool enabled() const { return method != remap_method::none; }
+
+                bool operator==(const parameter& o) const { return method == o.method && grid == o.grid; }
+                bool operator!=(const parameter& o) const { return !operator==(o); }
+            };
+
+            /** \brief match the sources to the grid nodes
+             * \return for node ix + iy*nx, the position of its source in api_sources
+             * \throw runtime_error if the sources does not cover the nodes of the grid exactly once
+             */
+            template <class ApiSource>
+            vector<uint32_t> node_sources(const regular_grid& g, ApiSource const& api_sources) {
+                if (g.nx == 0 || g.ny == 0 || !(g.dx > 0.0) || !(g.dy > 0.0))
+                    throw runtime_error("grid_remap: the regular grid must have nx,ny > 0 and dx,dy > 0");
+                if (size_t(distance(begin(api_sources), end(api_sources))) != g.size())
+                    throw runtime_error("grid_remap: the number of sources differs from the number of grid nodes");
+                const double tolerance = 1e-3;// in units of dx,dy
+                vector<uint32_t> r(g.size(), uint32_t(-1));
+                uint32_t i = 0;
+                for (const auto& s : api_sources) {
+                    const geo_point p = s.mid_point();
+                    const double fx = (p.x - g.x0)/g.dx, fy = (p.y - g.y0)/g.dy;
+                    const double rx = std::round(fx), ry = std::round(fy);
+                    if (fabs(fx - rx) > tolerance || fabs(fy - ry) > tolerance || rx < 0.0 || ry < 0.0 || rx >= double(g.nx) || ry >= double(g.ny))
+                        throw runtime_error("grid_remap: source location is not a node of the regular grid");
+                    uint32_t& k = r[size_t(rx) + size_t(ry)*g.nx];
+                    if (k != uint32_t(-1))
+                        throw runtime_error("grid_remap: more than one source at the same grid node");
+                    k = i++;
+                }
+                return r;
+            }
+
+            /** \brief append the bilinear weights of the point (x,y), clamped to the grid, to t */
+            inline void add_bilinear(const regular_grid& g, const vector<uint32_t>& node_source, double x, double y, inverse_distance::neighbour_table& t) {
+                auto axis = [](double f, size_t n, size_t& i, double& w) {
+                    f = std::min(std::max(f, 0.0), double(n - 1));
+                    i = n > 1 ? std::min(size_t(f), n - 2) : 0;
+                    w = n > 1 ? f - double(i) : 0.0;
+                };
+                size_t ix, iy; double wx, wy;
+                axis((x - g.x0)/g.dx, g.nx, ix, wx);
+                axis((y - g.y0)/g.dy, g.ny, iy, wy);
+                const double w[4] = {(1.0 - wx)*(1.0 - wy), wx*(1.0 - wy), (1.0 - wx)*wy, wx*wy};
+                const size_t node[4] = {ix + iy*g.nx, ix + 1 + iy*g.nx, ix + (iy + 1)*g.nx, ix + 1 + (iy + 1)*g.nx};
+                for (size_t k = 0; k < 4; ++k) {
+                    if (w[k] > 0.0) {// also skips nodes beyond the last for nx or ny = 1
+                        t.source_ix.push_back(node_source[node[k]]);
+                        t.weight.push_back(w[k]);
+                    }
+                }
+            }
+
+            /** \brief append the overlap area of the square footprint of the given area centered at (x,y), with the grid boxes, to t
+             * \return false if the footprint does not overlap the grid, and nothing was added
+             */
+            inline bool add_conservative(const regular_grid& g, const vector<uint32_t>& node_source, double x, double y, double area, inverse_distance::neighbour_table& t) {
+                if (!(area > 0.0)) return false;
+                const double h = 0.5*std::sqrt(area);
+                auto range = [h](double c, double c0, double d, size_t n, long& lo, long& hi) {
+                    lo = std::max(0L, long(std::floor((c - h - c0)/d + 0.5)));
+                    hi = std::min(long(n) - 1, long(std::floor((c + h - c0)/d + 0.5)));
+                };
+                auto overlap = [h](double c, double c0, double d, long i) {
+                    const double b0 = c0 + (double(i) - 0.5)*d;
+                    return std::max(0.0, std::min(c + h, b0 + d) - std::max(c - h, b0));
+                };
+                long ix0, ix1, iy0, iy1;
+                range(x, g.x0, g.dx, g.nx, ix0, ix1);
+                range(y, g.y0, g.dy, g.ny, iy0, iy1);
+                const size_t n0 = t.source_ix.size();
+                for (long iy = iy0; iy <= iy1; ++iy) {
+                    const double oy = overlap(y, g.y0, g.dy, iy);
+                    if (oy <= 0.0) continue;
+                    for (long ix = ix0; ix <= ix1; ++ix) {
+                        const double ox = overlap(x, g.x0, g.dx, ix);
+                        if (ox <= 0.0) continue;
+                        t.source_ix.push_back(node_source[size_t(ix) + size_t(iy)*g.nx]);
+                        t.weight.push_back(ox*oy);
+                    }
+                }
+                return t.source_ix.size() > n0;
+            }
+
+            /** \brief compute the remapping weights of the destinations, as a neighbour_table for inverse_distance::run_interpolation
+             *
+             * The weights are found directly from the grid index of the destination location, so no neighbour search is needed.
+             * Destinations with no footprint overlap with the grid, or no area, use the bilinear weights for the conservative method.
+             * \tparam D destination iterator, D.mid_point(), and for the conservative method, D.area() [m2]
+             */
+            template <class D>
+            inverse_distance::neighbour_table make_remap_table(const parameter& p, const vector<uint32_t>& node_source, D destination_begin, D destination_end) {
+                inverse_distance::neighbour_table t;
+                const size_t n = distance(destination_begin, destination_end);
+                t.row.reserve(n + 1);
+                const size_t n_per_row = p.method == remap_method::bilinear ? 4 : 9;
+                t.source_ix.reserve(n*n_per_row);
+                t.weight.reserve(n*n_per_row);
+                for (auto d = destination_begin; d != destination_end; ++d) {
+                    const geo_point m = d->mid_point();
+                    if (p.method != remap_method::conservative || !add_conservative(p.grid, node_source, m.x, m.y, d->area(), t))
+                        add_bilinear(p.grid, node_source, m.x, m.y, t);
+                    t.row.push_back(t.source_ix.size());
+                }
+                return t;
+            }
+
+            /** \brief run the remapping of the regular grid sources to the cells, for a given IDW model
+             *
+             * The model M, and its parameters, supplies the transform of source values to the destination,
+             * like the temperature height adjustment, exactly as for the idw of the same signal,
+             * only the weights are taken from the grid remapping instead of the distances.
+             * As for idw, sources with nan values are left out, and the weights of the remaining sources re-normalized.
+             *
+             * \tparam IDWModel IDW model class, ref. inverse_distance.h
+             * \tparam IDWModelSource IDW source class, ref inverse_distance.h for requirements.
+             * \param grid_parameter the grid layout of api_sources and the remap method, must be enabled
+             * \param model_parameters the idw parameters of the model, for the transform and scale computations
+             * \param ncore max number of threads to use, -1 means all threads of the pool
+             * \param pool the pool to run on, default the process-wide executor
+             */
+            template<typename IDWModel, typename IDWModelSource, typename ApiSource, typename P, typename D, typename ResultSetter, typename TimeAxis>
+            void run_interpolation(const TimeAxis& ta, ApiSource const& api_sources, const parameter& grid_parameter, const P& model_parameters,
+                                   D& cells, ResultSetter&& result_setter, int ncore = -1, shared_ptr<work_stealing_pool> pool = nullptr) {
+                if (!grid_parameter.enabled())
+                    throw runtime_error("grid_remap: the remap method is none");
+                const auto node_source = node_sources(grid_parameter.grid, api_sources);
+                const auto cells_begin = begin(cells);
+                const size_t n_cells = distance(begin(cells), end(cells));
+                const auto table = make_remap_table(grid_parameter, node_source, cells_begin, end(cells));
+                inverse_distance::idw_timeaxis<TimeAxis> idw_ta(ta);
+                if (!pool)
+                    pool = executor::instance();
+                if (ncore < 0)
+                    ncore = int(pool->size() + 1);
+                auto run_range = [cells_begin, &table, &api_sources, &ta, &idw_ta, &model_parameters, &result_setter](size_t i0, size_t i1) {
+                    vector<IDWModelSource> src; src.reserve(api_sources.size());// one source set pr. range, the accessors are not thread-safe
+                    for (auto& s : api_sources) src.emplace_back(s, ta);
+                    inverse_distance::run_interpolation<IDWModel>(begin(src), end(src), cells_begin + i0, cells_begin + i1, table, i0, idw_ta, model_parameters, result_setter);
+                };
+                if (ncore < 2)
+                    run_range(0, n_cells);
+                else
+                    pool->parallel_for(n_cells, std::max(size_t(1), n_cells/(4*size_t(ncore))), run_range, size_t(ncore));
+            }
+        }
+    }
+}
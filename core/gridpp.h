@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "utctime_utilities.h"
+#include "geo_point.h"
+#include "time_series.h"
+#include "thread_pool.h"
+#include "inverse_distance.h"
+#include "kalman.h"
+
+/**
+ * Contains the gridpp post-processing pipeline, correcting gridded forecasts with the kalman filtered bias at observation sites
+ */
+
+namespace shyft {
+    namespace core {
+        namespace gridpp {
+            using namespace std;
+            namespace idw = shyft::core::inverse_distance;
+
+            /** \brief a location, as source or destination of the idw weights of the pipeline */
+            struct located_point {
+                typedef geo_point geo_point_t;
+                geo_point p;
+                geo_point mid_point() const { return p; }
+            };
+
+            /** \brief the idw distance model of the pipeline, values are not transformed */
+            struct weight_model {
+                static inline double distance_measure(const geo_point& a, const geo_point& b, double f, double zscale) {
+                    return geo_point::distance_measure(a, b, f, zscale);
+                }
+            };
+
+            /** \return the idw neighbour_table from the points to the destinations */
+            inline shared_ptr<const idw::neighbour_table> make_weights(const vector<geo_point>& from, const vector<geo_point>& to, const idw::parameter& p) {
+                vector<located_point> s, d;
+                s.reserve(from.size()); d.reserve(to.size());
+                for (const auto& f : from) s.push_back(located_point{f});
+                for (const auto& t : to) d.push_back(located_point{t});
+                return make_shared<const idw::neighbour_table>(idw::make_neighbour_table<weight_model>(begin(s), end(s), begin(d), end(d), p));
+            }
+
+            const size_t sample_block_size = 1 << 20; ///< max number of values sampled into the time-step x points matrices of bias_correction::update
+
+            /** \brief gridpp style bias correction of gridded forecasts
+             *
+             * For each forecast time-step, the forecast grid is idw interpolated to the observation sites,
+             * and the observed bias, fc - obs, updates the kalman filter of each site, all sites in one batch_state.
+             * The daily bias profiles of the sites are then idw interpolated to the grid, and subtracted from the forecast.
+             *
+             * The grid and site locations are fixed when constructed, so the idw weights, both ways,
+             * are computed once and reused for every update and correction.
+             * Only the grid points used by the sites are sampled during update,
+             * and the work is split in ranges of sites, or grid points, run on the pool.
+             */
+            class bias_correction {
+            public:
+                kalman::filter f;///< the filter, common to all sites
+                kalman::batch_state s;///< the kalman state of each site
+            private:
+                vector<geo_point> grid;
+                vector<geo_point> sites;
+                shared_ptr<const idw::neighbour_table> grid_to_sites;///< idw weights of the grid points for each site
+                shared_ptr<const idw::neighbour_table> sites_to_grid;///< idw weights of the sites for each grid point
+                shared_ptr<work_stealing_pool> pool;
+
+                size_t chunk(size_t n) const { return std::max(size_t(1), n/(4*(pool->size() + 1))); }
+
+            public:
+                /** \brief construct the pipeline for the grid and sites
+                 * \param f the kalman filter used for the sites
+                 * \param grid locations of the forecast grid points
+                 * \param sites locations of the observations
+                 * \param p idw parameters, used for both directions
+                 * \param pool the pool to run on, default the process-wide executor
+                 */
+                bias_correction(const kalman::filter& f, const vector<geo_point>& grid, const vector<geo_point>& sites, const idw::parameter& p,
+                                shared_ptr<work_stealing_pool> pool = nullptr)
+                    : f(f), s(f.create_initial_state(), sites.size()), grid(grid), sites(sites),
+                      grid_to_sites(make_weights(grid, sites, p)), sites_to_grid(make_weights(sites, grid, p)),
+                      pool(pool ? pool : executor::instance()) {}
+
+                size_t grid_size() const { return grid.size(); }
+                size_t site_size() const { return sites.size(); }
+
+                /** \brief update the kalman states of the sites with forecast and observations
+                 *
+                 * Time-steps where the forecast at a site, or the observation, is nan are skipped for that site.
+                 * \tparam FcTs forecast time-series type, usable with average_accessor
+                 * \tparam ObsTs observation time-series type, usable with average_accessor
+                 * \param fc_grid forecast of each grid point
+                 * \param obs_sites observation of each site
+                 * \param ta the time-axis of the filter updates, fc and obs are projected to it as true averages
+                 */
+                template <class FcTs, class ObsTs, class TA>
+                void update(const vector<FcTs>& fc_grid, const vector<ObsTs>& obs_sites, const TA& ta) {
+                    if (fc_grid.size() != grid.size() || obs_sites.size() != sites.size())
+                        throw runtime_error("gridpp: forecast and observation sizes must match the grid and sites");
+                    const auto& t = *grid_to_sites;
+                    const size_t n_sites = sites.size();
+                    vector<uint32_t> column(grid.size(), uint32_t(-1));
+                    vector<uint32_t> used;// grid point of each column
+                    vector<uint32_t> entry_column(t.n_entries());
+                    for (size_t k = 0; k < t.n_entries(); ++k) {
+                        const uint32_t g = t.source_ix[k];
+                        if (column[g] == uint32_t(-1)) {
+                            column[g] = uint32_t(used.size());
+                            used.push_back(g);
+                        }
+                        entry_column[k] = column[g];
+                    }
+                    const size_t n_used = used.size();
+                    const size_t n_steps = ta.size();
+                    const size_t block_steps = std::max(size_t(1), std::min(n_steps, sample_block_size/(n_used + n_sites + 1)));
+                    vector<double> fc(block_steps*n_used), bias(block_steps*n_sites);
+                    for (size_t ib = 0; ib < n_steps; ib += block_steps) {
+                        const size_t ie = std::min(n_steps, ib + block_steps);
+                        pool->parallel_for(n_used, chunk(n_used), [&](size_t c0, size_t c1) {
+                            for (size_t c = c0; c < c1; ++c) {
+                                shyft::time_series::average_accessor<FcTs, TA> a(fc_grid[used[c]], ta);
+                                for (size_t i = ib; i < ie; ++i)
+                                    fc[(i - ib)*n_used + c] = a.value(i);
+                            }
+                        });
+                        pool->parallel_for(n_sites, chunk(n_sites), [&](size_t p0, size_t p1) {
+                            for (size_t p = p0; p < p1; ++p) {
+                                shyft::time_series::average_accessor<ObsTs, TA> obs(obs_sites[p], ta);
+                                for (size_t i = ib; i < ie; ++i) {
+                                    const double* fv = fc.data() + (i - ib)*n_used;
+                                    double sum_w = 0.0, sum_wv = 0.0;
+                                    for (size_t k = t.row[p]; k < t.row[p + 1]; ++k) {
+                                        const double v = fv[entry_column[k]];
+                                        if (isfinite(v)) { sum_wv += t.weight[k]*v; sum_w += t.weight[k]; }
+                                    }
+                                    bias[(i - ib)*n_sites + p] = sum_w > 0.0 ? sum_wv/sum_w - obs.value(i) : shyft::nan;
+                                }
+                            }
+                            for (size_t i = ib; i < ie; ++i)
+                                f.update_batch(bias.data() + (i - ib)*n_sites, ta.time(i), s, p0, p1);
+                        });
+                    }
+                }
+
+                /** \return the bias of each daily period at the grid points, [i*grid_size() + g], 0.0 where no site is within reach */
+                vector<double> grid_bias() const {
+                    const auto& t = *sites_to_grid;
+                    const size_t n_grid = grid.size();
+                    const int n = s.n;
+                    vector<double> r(size_t(n)*n_grid, 0.0);
+                    pool->parallel_for(n_grid, chunk(n_grid), [&](size_t g0, size_t g1) {
+                        for (size_t g = g0; g < g1; ++g) {
+                            double sum_w = 0.0;
+                            for (size_t k = t.row[g]; k < t.row[g + 1]; ++k) sum_w += t.weight[k];
+                            if (sum_w <= 0.0) continue;
+                            for (int i = 0; i < n; ++i) {
+                                double sum_wx = 0.0;
+                                for (size_t k = t.row[g]; k < t.row[g + 1]; ++k) sum_wx += t.weight[k]*s.x_at(i, t.source_ix[k]);
+                                r[i*n_grid + g] = sum_wx/sum_w;
+                            }
+                        }
+                    });
+                    return r;
+                }
+
+                /** \brief correct the forecasts of the grid, fc - bias, with the current bias profiles
+                 * \return the corrected forecast of each grid point, on the time-axis ta
+                 */
+                template <class FcTs, class TA>
+                vector<shyft::time_series::point_ts<TA>> correct(const vector<FcTs>& fc_grid, const TA& ta) const {
+                    if (fc_grid.size() != grid.size())
+                        throw runtime_error("gridpp: forecast size must match the grid");
+                    const size_t n_grid = grid.size();
+                    const auto b = grid_bias();
+                    vector<int> period(ta.size());
+                    for (size_t i = 0; i < ta.size(); ++i) period[i] = f.fold_to_daily_observation(ta.time(i));
+                    vector<shyft::time_series::point_ts<TA>> r(n_grid);
+                    pool->parallel_for(n_grid, chunk(n_grid), [&](size_t g0, size_t g1) {
+                        vector<double> v(ta.size());
+                        for (size_t g = g0; g < g1; ++g) {
+                            shyft::time_series::average_accessor<FcTs, TA> a(fc_grid[g], ta);
+                            for (size_t i = 0; i < ta.size(); ++i)
+                                v[i] = a.value(i) - b[period[i]*n_grid + g];
+                            r[g] = shyft::time_series::point_ts<TA>(ta, v, shyft::time_series::POINT_AVERAGE_VALUE);
+                        }
+                    });
+                    return r;
+                }
+            };
+        }
+    }
+}
@@ -21,9 +21,12 @@
 
 #include <string>
 #include <vector>
+#include <array>
+#include <type_traits>
 #include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <stdexcept>
 
 #include "core_serialization.h"
 
@@ -36,8 +39,11 @@ namespace shyft {
 
             /** \brief integrate function f given as linear interpolated between the f_i(x_i) from a to b for a, b in x.
              * If f_rhs_is_zero is set, f(b) = 0, unless b = x[i] for some i in [0,n).
+             * \tparam F indexable f values, like vector<double> or const double*
+             * \tparam X indexable x values
              */
-            inline double integrate(const vector<double>& f, const vector<double>& x, size_t n, double a, double b, bool f_b_is_zero=false) {
+            template <class F, class X>
+            inline double integrate(const F& f, const X& x, size_t n, double a, double b, bool f_b_is_zero=false) {
                 size_t left = 0;
                 double area = 0.0;
                 double f_l = 0.0;
@@ -138,49 +144,40 @@ namespace shyft {
              * \tparam R Respone type, implementing the interface:
              *    - S.set_outflow(double value) --> void, set the value of the outflow [mm]
              */
-            template<class P, class S>
-            struct calculator {
-
-                vector<double> sd;
-                vector<double> I;
-                vector<double> sp;
-                vector<double> sw;
-                size_t I_n;
-
-                calculator(const P& p,  S& state):I(p.intervals),I_n(p.intervals.size()) {
-                    // Simple trapezoidal rule to normalize the snow redistribution quartiles
-                    auto s = p.s;
-
-                    const double mean = hbv_snow::integrate(s, I, I_n, I[0], I[I_n - 1]);
-                    sd = s;
-                    for (auto &sd_: sd) sd_ /= mean;
-
-                    double swe = state.swe;
-                    double sca = state.sca;
-
-                    sp = vector<double>(I_n, 0.0);
-                    sw = vector<double>(I_n, 0.0);
+            /** \brief the snow distribution kernels, shared by calculator and batch_calculator
+             *
+             * The distribution of one cell is the snow pack sp and liquid water sw of each of the n quantiles I,
+             * with the normalized snowfall redistribution sd.
+             * The count n is either a size_t, or std::integral_constant<size_t,N> for a count known at compile time,
+             * letting the compiler unroll the loops over the quantiles.
+             */
+            struct distribution {
+                /** \brief initialize sp,sw from the swe and sca of the state, using the redistribution factors s */
+                template <class Nt>
+                static void initialize(const double* s, const double* I, const Nt I_n, const double lw, double& state_swe, double& state_sca, double* sp, double* sw) {
+                    double swe = state_swe;
+                    double sca = state_sca;
+                    for (size_t i = 0; i < I_n; ++i) sp[i] = sw[i] = 0.0;
                     if (swe <= 1.0e-3 || sca <= 1.0e-3) {
-                        state.swe = state.sca  = 0.0;
+                        state_swe = state_sca = 0.0;
                     } else {
                         for (size_t i = 0; i < I_n; ++i)
                             sp[i] = sca < I[i] ? 0.0 : s[i]*swe;
 
                         swe = integrate(sp, I, I_n, 0.0, sca, true);
 
-                        if (swe < state.swe) {
-                            const double corr1 = state.swe/swe*p.lw;
-                            const double corr2 = state.swe/swe*(1.0 - p.lw);
+                        if (swe < state_swe) {
+                            const double corr1 = state_swe/swe*lw;
+                            const double corr2 = state_swe/swe*(1.0 - lw);
                             for (size_t i = 0; i< I_n; ++i) {
                                 sw[i] = corr1*sp[i];
                                 sp[i] *= corr2;
                             }
-                        } else
-                            sw = vector<double>(I_n, 0.0);
+                        }
                     }
                 }
 
-                void refreeze(double &sp, double &sw, const double rain, const double potmelt, const double lw) {
+                static void refreeze(double &sp, double &sw, const double rain, const double potmelt, const double lw) {
                     // Note that the above calculations might violate the mass balance due to rounding errors. A fix might be to
                     // replace sw by a sw_fraction, sp with s_tot, and compute sw and sp based on these.
                     if (sp > 0.0) {
@@ -195,7 +192,7 @@ namespace shyft {
                     }
                 }
 
-                void update_state(double &sp, double &sw, const double rain, const double potmelt, const double lw) {
+                static void update_state(double &sp, double &sw, const double rain, const double potmelt, const double lw) {
                     if (sp > potmelt) {
                         sw += potmelt + rain;
                         sp -= potmelt;
@@ -204,23 +201,29 @@ namespace shyft {
                         sp = sw = 0.0;
                 }
 
-                size_t sca_index(double sca) const {
+                template <class Nt>
+                static size_t sca_index(const double* I, const Nt I_n, double sca) {
                     for (size_t i = 0;  i < I_n - 1; ++i)
                         if (sca >= I[i] && sca < I[i + 1])
                             return i;
                     return I_n - 1;
                 }
 
-                size_t melt_index(double potmelt) {
+                template <class Nt>
+                static size_t melt_index(const double* sp, const Nt I_n, double potmelt) {
                     for (size_t i = 0; i < I_n; ++i)
                         if (sp[i] < potmelt)
                             return i;
                     return I_n;
                 }
 
-                template <class R> void step(S& s, R& r, shyft::core::utctime t0, shyft::core::utctime t1, const P& p, double prec, double temp) {
-                    double swe = s.swe;
-                    double sca = s.sca;
+                /** \brief step the distribution sp,sw of one cell, updating state_swe, state_sca and outflow */
+                template <class P, class Nt>
+                static void step(const double* I, const double* sd, const Nt I_n, double* sp, double* sw,
+                                 double& state_swe, double& state_sca, double& outflow,
+                                 shyft::core::utctime t0, shyft::core::utctime t1, const P& p, double prec, double temp) {
+                    double swe = state_swe;
+                    double sca = state_sca;
                     const double total_water = prec + swe;
                     double snow,rain;
                     if( temp < p.tx ) {snow=prec;rain= 0.0;}
@@ -228,15 +231,14 @@ namespace shyft {
                     double step_in_days = (t1 - t0)/86400.0;
                     swe += snow + sca*rain;
                     if (swe < 0.1) {
-                        r.outflow = total_water;
-                        fill(begin(sp), end(sp), 0.0);
-                        fill(begin(sw), end(sw), 0.0);
-                        s.swe = 0.0;
-                        s.sca = 0.0;
+                        outflow = total_water;
+                        for (size_t i = 0; i < I_n; ++i) sp[i] = sw[i] = 0.0;
+                        state_swe = 0.0;
+                        state_sca = 0.0;
                         return;
                     }
                     if (snow > 0.0) {
-                        auto idx = sca_index(sca);
+                        auto idx = sca_index(I, I_n, sca);
                         if (sca > 1.0e-5 && sca < 1.0 - 1.0e-5) {
                             if (idx == 0) {
                                 sp[0] *= sca/(I[1] - I[0]);
@@ -264,7 +266,7 @@ namespace shyft {
                         for (size_t i = 0; i < I_n; ++i)
                             refreeze(sp[i], sw[i], rain, potmelt, lw);
                     } else {
-                        size_t idx = melt_index(potmelt);
+                        size_t idx = melt_index(sp, I_n, potmelt);
 
                         if (idx == 0) sca = 0.0;
                         else if (idx == I_n) sca = 1.0;
@@ -292,9 +294,97 @@ namespace shyft {
                         } else
                             swe = total_water;
                     }
-                    r.outflow = total_water - swe;
-                    s.swe = swe;
-                    s.sca = sca;
+                    outflow = total_water - swe;
+                    state_swe = swe;
+                    state_sca = sca;
+                }
+            };
+
+            /** \brief Generalized quantile based HBV Snow model method
+             *
+             * This algorithm uses arbitrary quartiles to model snow. No checks are performed to assert valid input. The starting points of the
+             * quantiles have to partition the unity, include the end points 0 and 1 and must be given in ascending order.
+             *
+             * \tparam P Parameter type, implementing the interface:
+             *    - P.s() const --> vector<double>, snowfall redistribution vector
+             *    - P.intervals() const --> vector<double>, starting points for the quantiles
+             *    - P.lw() const --> double, max liquid water content of the snow
+             *    - P.tx() const --> double, threshold temperature determining if precipitation is rain or snow
+             *    - P.cx() const --> double, temperature index, i.e., melt = cx(t - ts) in mm per degree C
+             *    - P.ts() const --> double, threshold temperature for melt onset
+             *    - P.cfr() const --> double, refreeze coefficient, refreeze = cfr*cx*(ts - t)
+             * \tparam S State type, implementing the interface:
+             *    - S.swe --> double, snow water equivalent of the snowpack [mm]
+             *    - S.sca --> double, fraction of area covered by the snowpack [0,1]
+             * \tparam R Respone type, implementing the interface:
+             *    - S.set_outflow(double value) --> void, set the value of the outflow [mm]
+             */
+            const size_t max_quantiles = 32;///< max number of snow quantiles of the calculator, the storage is kept in the calculator itself
+
+            template<class P, class S>
+            struct calculator {
+
+                array<double, max_quantiles> sd;
+                array<double, max_quantiles> I;
+                array<double, max_quantiles> sp;
+                array<double, max_quantiles> sw;
+                size_t I_n;
+
+                /** \brief construct for p.intervals, copied into the fixed storage of the calculator, so neither construct nor step allocates
+                 * \throw runtime_error if p has more than max_quantiles intervals, or s and intervals differ in size
+                 */
+                calculator(const P& p,  S& state):I_n(p.intervals.size()) {
+                    if (I_n > max_quantiles || p.s.size() != I_n)
+                        throw runtime_error("hbv_snow::calculator: the snow quantiles and redistribution factors must be of equal size, max 32");
+                    std::copy(begin(p.intervals), end(p.intervals), I.begin());
+                    // Simple trapezoidal rule to normalize the snow redistribution quartiles
+                    const double mean = hbv_snow::integrate(p.s, I, I_n, I[0], I[I_n - 1]);
+                    for (size_t i = 0; i < I_n; ++i) sd[i] = p.s[i]/mean;
+                    distribution::initialize(p.s.data(), I.data(), I_n, p.lw, state.swe, state.sca, sp.data(), sw.data());
+                }
+
+                template <class R> void step(S& s, R& r, shyft::core::utctime t0, shyft::core::utctime t1, const P& p, double prec, double temp) {
+                    distribution::step(I.data(), sd.data(), I_n, sp.data(), sw.data(), s.swe, s.sca, r.outflow, t0, t1, p, prec, temp);
+                }
+            };
+
+            /** \brief the hbv snow method for a batch of cells sharing the parameter, with N quantiles known at compile-time
+             *
+             * The distributions of all cells are kept in flat arrays, sp[j*N + i] for quantile i of cell j,
+             * and the quantile loops of the kernels have a compile-time count.
+             * Each cell gives the same result as the calculator with the same parameter.
+             * \tparam P parameter type, as for calculator, with P.intervals.size() == N
+             * \tparam N the number of quantiles
+             */
+            template<class P, size_t N>
+            struct batch_calculator {
+                typedef std::integral_constant<size_t, N> n_t;
+                array<double, N> sd;
+                array<double, N> I;
+                vector<double> sp;
+                vector<double> sw;
+
+                /** \brief construct for n cells, with zero snow, call initialize for each cell with snow */
+                batch_calculator(const P& p, size_t n) : sp(n*N, 0.0), sw(n*N, 0.0) {
+                    if (p.intervals.size() != N || p.s.size() != N)
+                        throw runtime_error("hbv_snow::batch_calculator: the number of quantiles of the parameter differs from N");
+                    for (size_t i = 0; i < N; ++i) I[i] = p.intervals[i];
+                    const double mean = hbv_snow::integrate(p.s, I, N, I[0], I[N - 1]);
+                    for (size_t i = 0; i < N; ++i) sd[i] = p.s[i]/mean;
+                }
+
+                size_t size() const { return sp.size()/N; }
+
+                /** \brief initialize the distribution of cell j from its swe and sca, as the calculator constructor */
+                void initialize(size_t j, const P& p, double& swe, double& sca) {
+                    distribution::initialize(p.s.data(), I.data(), n_t(), p.lw, swe, sca, sp.data() + j*N, sw.data() + j*N);
+                }
+
+                /** \brief step the cells [j0..j1), given the cell arrays prec, temp, swe, sca and outflow, indexed by cell */
+                void step(size_t j0, size_t j1, shyft::core::utctime t0, shyft::core::utctime t1, const P& p,
+                          const double* prec, const double* temp, double* swe, double* sca, double* outflow) {
+                    for (size_t j = j0; j < j1; ++j)
+                        distribution::step(I.data(), sd.data(), n_t(), sp.data() + j*N, sw.data() + j*N, swe[j], sca[j], outflow[j], t0, t1, p, prec[j], temp[j]);
                 }
             };
         }
@@ -60,6 +60,15 @@ namespace shyft {
                     r.outflow = outflow > temp ? temp : outflow;
 					s.sm = std::max(0.0,s.sm + insoil - r.outflow - act_evap);
 				}
+				/** \brief step n cells sharing the parameter, with the state sm and the responses in flat arrays, indexed by cell */
+				void step(const double* insoil, const double* act_evap, double* sm, double* outflow, size_t n) const {
+					for (size_t j = 0; j < n; ++j) {
+						double temp = sm[j] + insoil[j];
+						double q = insoil[j]*pow(temp/param.fc, param.beta);
+						outflow[j] = q > temp ? temp : q;
+						sm[j] = std::max(0.0, sm[j] + insoil[j] - outflow[j] - act_evap[j]);
+					}
+				}
 			};
 		}
 	} // core
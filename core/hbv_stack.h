@@ -18,6 +18,8 @@
 #include "glacier_melt.h"
 #include "unit_conversion.h"
 #include "routing.h"
+#include "cell_state_soa.h"
+#include "method_stack.h"
 namespace shyft {
 	namespace core {
 		namespace hbv_stack {
@@ -184,6 +186,19 @@ namespace shyft {
                 x_serialize_decl();
             };
 
+            /** \brief structure of arrays storage for hbv_stack::state, ref. state_soa_base
+             *
+             * The fields are ordered snow.swe, snow.sca, soil.sm, tank.uz, tank.lz
+             */
+            struct state_soa:state_soa_base<state_soa, state, 5> {
+                static void pack(const state& s, double* v) { v[0] = s.snow.swe; v[1] = s.snow.sca; v[2] = s.soil.sm; v[3] = s.tank.uz; v[4] = s.tank.lz; }
+                static void unpack(const double* v, state& s) { s.snow.swe = v[0]; s.snow.sca = v[1]; s.soil.sm = v[2]; s.tank.uz = v[3]; s.tank.lz = v[4]; }
+                /** \return the names of the fields, in order */
+                static std::vector<std::string> field_names() { return { "snow.swe", "snow.sca", "soil.sm", "tank.uz", "tank.lz" }; }
+                std::vector<double>& snow_swe() { return f[0]; }
+                std::vector<double>& soil_sm() { return f[2]; }
+            };
+
 
 			/** \brief Simple response struct for the hbv_stack method stack
 			*
@@ -308,28 +323,37 @@ namespace shyft {
 
                 size_t i_begin = n_steps > 0 ? start_step : 0;
                 size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
+                namespace prof = method_stack::profiling;
                 for (size_t i = i_begin; i < i_end; ++i) {
+					prof::timer tm(prof::input);
 					utcperiod period = time_axis.period(i);
 					double temp = temp_accessor.value(i);
 					double rad = rad_accessor.value(i);
 					double rel_hum = rel_hum_accessor.value(i);
 					double prec = p_corr.calc(prec_accessor.value(i));
-					state_collector.collect(i, state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
+					tm.next(prof::collect);
+					method_stack::collect(state_collector, i, state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
 
+					tm.next(prof::snow);
 					snow.step(state.snow, response.snow, period.start, period.end, parameter.snow, prec, temp);
 
+                    tm.next(prof::glacier_melt);
                     response.gm_melt_m3s = glacier_melt::step(parameter.gm.dtf,temp,geo_cell_data.area()*state.snow.sca,glacier_area_m2);// m3/s, that is, how much flow from the snow free glacier parts
+                    tm.next(prof::potential_evapotranspiration);
                     response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(temp, rad, rel_hum)*calendar::HOUR; // mm/h
+                    tm.next(prof::actual_evapotranspiration);
                     response.ae.ae = hbv_actual_evapotranspiration::calculate_step(
                         state.soil.sm, response.pt.pot_evapotranspiration,
 					    parameter.ae.lp, std::max(state.snow.sca,glacier_fraction), // a evap only on non-snow/non-glac area
                         period.timespan());
 
 					double gm_mmh= shyft::m3s_to_mmh(response.gm_melt_m3s, cell_area_m2);
+                    tm.next(prof::response);
                     soil.step(state.soil, response.soil, period.start, period.end, response.snow.outflow, response.ae.ae);
 
 					tank.step(state.tank, response.tank, period.start, period.end, response.soil.outflow + gm_routed*gm_mmh); // route glacier melt to the tank ?
 
+                    tm.next(prof::discharge);
                     response.total_discharge =
                           std::max(0.0, prec - response.ae.ae)*direct_response_fraction // when it rains, remove ae. from direct response
                          + gm_direct*gm_mmh  // glacier melt direct response
@@ -340,12 +364,125 @@ namespace shyft {
                         + response.gm_melt_m3s
                         - shyft::mmh_to_m3s(response.total_discharge, cell_area_m2);
 					// Possibly save the calculated values using the collector callbacks.
-					response_collector.collect(i, response);///< \note collect the response valid for the i'th period (current state is now at the end of period)
+					tm.next(prof::collect);
+					method_stack::collect(response_collector, i, response);///< \note collect the response valid for the i'th period (current state is now at the end of period)
 					if (i + 1 == i_end)
-						state_collector.collect(i + 1, state);///< \note last iteration,collect the  final state as well.
+						method_stack::collect(state_collector, i + 1, state);///< \note last iteration,collect the  final state as well.
 				}
 				response_collector.set_end_response(response);
 			}
+
+			/** \brief the hbv_stack method stack for a batch of cells sharing the parameter, stepped timestep-major
+			 *
+			 * The states, the snow distributions, and the inputs and responses of the current time-step,
+			 * are kept in flat arrays indexed by cell, and each method is applied to all cells of the batch
+			 * before the next, with the number of snow quantiles N known at compile time.
+			 * The caller fills the input arrays temp, prec, rad and rel_hum for each time-step, and calls step.
+			 * Each cell gives the same result as run_hbv_stack.
+			 * \tparam N the number of snow quantiles, parameter.snow.intervals.size()
+			 * \tparam P parameter type, as for run_hbv_stack
+			 * \sa hbv_stack::run_batch
+			 */
+			template<size_t N, class P>
+			struct batch_stepper {
+				const P& parameter;
+				precipitation_correction::calculator p_corr;
+				priestley_taylor::calculator pt;
+				hbv_snow::batch_calculator<typename P::snow_parameter_t, N> snow;
+				hbv_soil::calculator<typename P::soil_parameter_t> soil;
+				hbv_tank::calculator<typename P::tank_parameter_t> tank;
+				const double gm_direct;
+				const double gm_routed;
+				state_soa s;///< the states of the cells
+				// cell constants
+				vector<double> glacier_fraction, direct_response_fraction, land_fraction, cell_area_m2, glacier_area_m2;
+				// inputs of the current time-step
+				vector<double> temp, prec, rad, rel_hum;
+				// responses of the current time-step
+				vector<double> snow_outflow, gm_melt_m3s, pot_evapotranspiration, ae, soil_outflow, tank_outflow, total_discharge, charge_m3s;
+
+				/** \brief construct for the given cell geo and initial states
+				 * \param parameter common parameter of the cells, kept by reference
+				 * \param geo geo cell data of each cell
+				 * \param states initial state of each cell, as for the snow.calculator, the snow swe and sca could be adjusted
+				 */
+				template <class GCD>
+				batch_stepper(const P& parameter, const vector<const GCD*>& geo, vector<state>& states)
+					: parameter(parameter), p_corr(parameter.p_corr.scale_factor), pt(parameter.pt.albedo, parameter.pt.alpha),
+					  snow(parameter.snow, geo.size()), soil(parameter.soil), tank(parameter.tank),
+					  gm_direct(parameter.gm.direct_response), gm_routed(1 - gm_direct) {
+					if (geo.size() != states.size())
+						throw runtime_error("hbv_stack::batch_stepper: geo and states must have equal size");
+					const size_t n = geo.size();
+					for (auto v : {&glacier_fraction, &direct_response_fraction, &land_fraction, &cell_area_m2, &glacier_area_m2,
+								   &temp, &prec, &rad, &rel_hum,
+								   &snow_outflow, &gm_melt_m3s, &pot_evapotranspiration, &ae, &soil_outflow, &tank_outflow, &total_discharge, &charge_m3s})
+						v->resize(n, 0.0);
+					for (size_t j = 0; j < n; ++j) {
+						const auto& g = *geo[j];
+						snow.initialize(j, parameter.snow, states[j].snow.swe, states[j].snow.sca);
+						glacier_fraction[j] = g.land_type_fractions_info().glacier();
+						direct_response_fraction[j] = glacier_fraction[j]*gm_direct + g.land_type_fractions_info().reservoir();
+						land_fraction[j] = 1 - direct_response_fraction[j];
+						cell_area_m2[j] = g.area();
+						glacier_area_m2[j] = g.area()*glacier_fraction[j];
+					}
+					s.assign(states);
+				}
+
+				size_t size() const { return s.size(); }
+
+				/** \brief step all cells over the period, using the inputs temp, prec, rad and rel_hum */
+				void step(const utcperiod& period) {
+					namespace prof = method_stack::profiling;
+					const size_t n = size();
+					double* swe = s.f[0].data(); double* sca = s.f[1].data(); double* sm = s.f[2].data();
+					prof::timer tm(prof::input);
+					for (size_t j = 0; j < n; ++j) prec[j] = p_corr.calc(prec[j]);
+					tm.next(prof::snow);
+					snow.step(0, n, period.start, period.end, parameter.snow, prec.data(), temp.data(), swe, sca, snow_outflow.data());
+					tm.next(prof::potential_evapotranspiration);
+					pt.potential_evapotranspiration_batch(temp.data(), rad.data(), rel_hum.data(), pot_evapotranspiration.data(), n);
+					tm.next(prof::glacier_melt);
+					glacier_melt::step_batch(parameter.gm.dtf, temp.data(), sca, cell_area_m2.data(), glacier_area_m2.data(), gm_melt_m3s.data(), n);
+					tm.next(prof::actual_evapotranspiration);
+					for (size_t j = 0; j < n; ++j) {
+						pot_evapotranspiration[j] *= calendar::HOUR; // mm/h
+						ae[j] = hbv_actual_evapotranspiration::calculate_step(sm[j], pot_evapotranspiration[j],
+							parameter.ae.lp, std::max(sca[j], glacier_fraction[j]), period.timespan());
+					}
+					tm.next(prof::response);
+					soil.step(snow_outflow.data(), ae.data(), sm, soil_outflow.data(), n);
+					for (size_t j = 0; j < n; ++j) total_discharge[j] = soil_outflow[j] + gm_routed*shyft::m3s_to_mmh(gm_melt_m3s[j], cell_area_m2[j]);// tank input
+					tank.step(total_discharge.data(), s.f[3].data(), s.f[4].data(), tank_outflow.data(), n);
+					tm.next(prof::discharge);
+					for (size_t j = 0; j < n; ++j) {
+						const double gm_mmh = shyft::m3s_to_mmh(gm_melt_m3s[j], cell_area_m2[j]);
+						total_discharge[j] =
+							  std::max(0.0, prec[j] - ae[j])*direct_response_fraction[j]
+							+ gm_direct*gm_mmh
+							+ tank_outflow[j]*land_fraction[j];
+						charge_m3s[j] =
+							+ shyft::mmh_to_m3s(prec[j], cell_area_m2[j])
+							- shyft::mmh_to_m3s(ae[j], cell_area_m2[j])
+							+ gm_melt_m3s[j]
+							- shyft::mmh_to_m3s(total_discharge[j], cell_area_m2[j]);
+					}
+				}
+
+				/** \return the response of cell j for the current time-step, as passed to the response collector by run_hbv_stack */
+				template <class R>
+				void get_response(size_t j, R& r) const {
+					r.pt.pot_evapotranspiration = pot_evapotranspiration[j];
+					r.snow.outflow = snow_outflow[j];
+					r.gm_melt_m3s = gm_melt_m3s[j];
+					r.ae.ae = ae[j];
+					r.soil.outflow = soil_outflow[j];
+					r.tank.outflow = tank_outflow[j];
+					r.total_discharge = total_discharge[j];
+					r.charge_m3s = charge_m3s[j];
+				}
+			};
 		} // hbv_stack
 	} // core
 } // shyft
@@ -53,6 +53,12 @@ namespace shyft {
 					: destination_area(destination_area), pe_output(time_axis, 0.0), snow_outflow(time_axis, 0.0),glacier_melt(time_axis,0.0),snow_sca(time_axis,0.0),snow_swe(time_axis,0), ae_output(time_axis, 0.0),
 						soil_outflow(time_axis, 0.0), avg_discharge(time_axis, 0.0),charge_m3s(time_axis, 0.0) {}
 
+				/** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+				size_t heap_bytes() const {
+					return series_heap_bytes(pe_output, snow_outflow, glacier_melt, snow_sca, snow_swe,
+					                         ae_output, soil_outflow, avg_discharge, charge_m3s);
+				}
+
 				/**\brief called before run to allocate space for results */
 				void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
 					destination_area = area;
@@ -107,6 +113,9 @@ namespace shyft {
 					snow_sca(timeaxis_t(time_axis.start(), time_axis.delta(), 0), 0.0),
 					snow_swe(timeaxis_t(time_axis.start(), time_axis.delta(), 0), 0.0) {}
 
+				/** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+				size_t heap_bytes() const { return series_heap_bytes(avg_discharge, charge_m3s, snow_sca, snow_swe); }
+
 				void initialize(const timeaxis_t& time_axis, int start_step, int n_steps, double area) {
 					destination_area = area;
                     ts_init(avg_discharge, time_axis, start_step, n_steps, ts_point_fx::POINT_AVERAGE_VALUE);
@@ -135,6 +144,7 @@ namespace shyft {
 			* and we need all the RAM for useful purposes.
 			*/
 			struct null_collector {
+				typedef std::true_type is_null_collector;///< collect calls are removed at compile time, ref. method_stack::collect
 				void initialize(const timeaxis_t& time_axis,int start_step=0,int n_steps=0, double area = 0.0) {}
 				void collect(size_t i, const state_t& response) {}
 			};
@@ -157,6 +167,9 @@ namespace shyft {
 				explicit state_collector(const timeaxis_t& time_axis)
 					: collect_state(false), destination_area(0.0), snow_swe(time_axis, 0.0), snow_sca(time_axis, 0.0),
 						soil_moisture(time_axis, 0.0), tank_uz(time_axis, 0.0), tank_lz(time_axis, 0.0) { /* Do nothing */}
+				/** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+				size_t heap_bytes() const { return series_heap_bytes(snow_swe, snow_sca, soil_moisture, tank_uz, tank_lz); }
+
 				/** brief called before run, prepares state time-series
 				*
 				* with preallocated room for the supplied time-axis.
@@ -188,6 +201,96 @@ namespace shyft {
 			typedef cell<parameter_t, environment_t, state_t, state_collector, all_response_collector> cell_complete_response_t;
 			typedef cell<parameter_t, environment_t, state_t, null_collector, discharge_collector> cell_discharge_response_t;
 
+
+			/** \brief run a batch of cells sharing the parameter, timestep-major, using the flat batch_stepper<N>
+			 * \tparam N the number of snow quantiles of the parameter
+			 * \tparam C a hbv_stack cell type
+			 */
+			template <size_t N, class C>
+			void run_batch_n(const timeaxis_t& time_axis, int start_step, int n_steps, C* const* batch, size_t n) {
+				typedef typename C::env_ts_t env_t;
+				typedef direct_accessor<decltype(std::declval<env_t&>().temperature), timeaxis_t> temp_accessor_t;
+				typedef direct_accessor<decltype(std::declval<env_t&>().precipitation), timeaxis_t> prec_accessor_t;
+				typedef direct_accessor<decltype(std::declval<env_t&>().radiation), timeaxis_t> rad_accessor_t;
+				typedef direct_accessor<decltype(std::declval<env_t&>().rel_hum), timeaxis_t> rel_hum_accessor_t;
+				vector<temp_accessor_t> temp; vector<prec_accessor_t> prec; vector<rad_accessor_t> rad; vector<rel_hum_accessor_t> rel_hum;
+				vector<const geo_cell_data*> geo; vector<state_t> states;
+				for (size_t j = 0; j < n; ++j) {
+					auto& c = *batch[j];
+					c.begin_run(time_axis, start_step, n_steps);
+					temp.emplace_back(c.env_ts.temperature, time_axis);
+					prec.emplace_back(c.env_ts.precipitation, time_axis);
+					rad.emplace_back(c.env_ts.radiation, time_axis);
+					rel_hum.emplace_back(c.env_ts.rel_hum, time_axis);
+					geo.push_back(&c.geo);
+					states.push_back(c.state);
+				}
+				batch_stepper<N, parameter_t> stack(*batch[0]->parameter, geo, states);
+				const bool with_state = !method_stack::is_null_collector<decltype(batch[0]->sc)>::value;// skip unpacking the state for the null collector
+				response_t response;
+				size_t i_begin = n_steps > 0 ? start_step : 0;
+				size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
+				for (size_t i = i_begin; i < i_end; ++i) {
+					for (size_t j = 0; j < n; ++j) {
+						stack.temp[j] = temp[j].value(i);
+						stack.prec[j] = prec[j].value(i);
+						stack.rad[j] = rad[j].value(i);
+						stack.rel_hum[j] = rel_hum[j].value(i);
+						if (with_state) batch[j]->sc.collect(i, stack.s.get(j));
+					}
+					stack.step(time_axis.period(i));
+					for (size_t j = 0; j < n; ++j) {
+						stack.get_response(j, response);
+						batch[j]->rc.collect(i, response);
+						if (with_state && i + 1 == i_end)
+							batch[j]->sc.collect(i + 1, stack.s.get(j));
+					}
+				}
+				for (size_t j = 0; j < n; ++j) {
+					batch[j]->state = stack.s.get(j);
+					if (i_end > i_begin) stack.get_response(j, response);
+					batch[j]->rc.set_end_response(response);
+				}
+			}
+
+			/** \brief run a batch of hbv_stack cells timestep-major,
+			 *
+			 * The cells are grouped by their parameter, and each group sharing the parameter is run with
+			 * the flat batch_stepper, for the common snow quantile counts 2..10,
+			 * otherwise the cells are run one by one, by cell.run().
+			 * The results are the same as for cell.run().
+			 * \tparam C a hbv_stack cell type
+			 */
+			template <class C>
+			void run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, C* const* batch, size_t n) {
+				vector<C*> group; group.reserve(n);
+				vector<bool> done(n, false);
+				for (size_t k = 0; k < n; ++k) {
+					if (done[k]) continue;
+					if (batch[k]->parameter.get() == nullptr)
+						throw std::runtime_error("hbv_stack::run with null parameter attempted");
+					group.clear();
+					for (size_t j = k; j < n; ++j) {
+						if (!done[j] && batch[j]->parameter == batch[k]->parameter) {
+							group.push_back(batch[j]);
+							done[j] = true;
+						}
+					}
+					switch (batch[k]->parameter->snow.intervals.size()) {
+					case 2: run_batch_n<2>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 3: run_batch_n<3>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 4: run_batch_n<4>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 5: run_batch_n<5>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 6: run_batch_n<6>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 7: run_batch_n<7>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 8: run_batch_n<8>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 9: run_batch_n<9>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					case 10: run_batch_n<10>(time_axis, start_step, n_steps, group.data(), group.size()); break;
+					default:
+						for (auto c : group) c->run(time_axis, start_step, n_steps);
+					}
+				}
+			}
 		} // pt_hs_k
 
 		  //specialize run method for all_response_collector
@@ -74,6 +74,18 @@ namespace shyft {
 					r.outflow = q12 + q11 + q2;
 
 				}
+				/** \brief step n cells sharing the parameter, with the states uz, lz and the outflow in flat arrays, indexed by cell */
+				void step(const double* soil_outflow, double* uz, double* lz, double* outflow, size_t n) const {
+					for (size_t j = 0; j < n; ++j) {
+						double temp = uz[j] + soil_outflow[j];
+						double q12 = std::max(0.0, (temp - param.uz1)*param.kuz2);
+						double q11 = std::min(temp, param.uz1)*param.kuz1;
+						uz[j] = uz[j] + soil_outflow[j] - param.perc - (q12+q11);
+						double q2 = (lz[j] + param.perc) *param.klz;
+						lz[j] = lz[j] + param.perc - q2 ;
+						outflow[j] = q12 + q11 + q2;
+					}
+				}
 			};
 		}
 	} // core
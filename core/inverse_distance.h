@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#include <cstdint>
+#include <memory>
 #include <algorithm>
 #include <cmath>
 #include <thread>
@@ -16,6 +18,9 @@
 #endif // WIN32
 #include "utctime_utilities.h"
 #include "geo_point.h"
+#include "thread_pool.h"
+#include "timeline_trace.h"
+#include "spatial_index.h"
 /**
  * Contains all IDW related stuff, parameters, the IDW algorithm, IDW Models, and IDW Runner
  */
@@ -42,6 +47,11 @@ namespace shyft {
 					double distance_measure_factor = 2.0, double zscale = 1.0)
 					: max_members(max_members), max_distance(max_distance),
 					distance_measure_factor(distance_measure_factor), zscale(zscale) {}
+				bool operator==(const parameter& o) const {
+					return max_members == o.max_members && max_distance == o.max_distance
+						&& distance_measure_factor == o.distance_measure_factor && zscale == o.zscale;
+				}
+				bool operator!=(const parameter& o) const { return !operator==(o); }
 			};
 
 			/** \brief For temperature inverse distance, also provide default temperature gradient to be used
@@ -57,6 +67,10 @@ namespace shyft {
 				temperature_parameter(double default_gradient = -0.006, size_t max_members = 20, double max_distance = 200000.0, bool gradient_by_equation = false)
 					: parameter(max_members, max_distance), default_temp_gradient(default_gradient), gradient_by_equation(gradient_by_equation) {}
 				double default_gradient() const { return default_temp_gradient; }
+				bool operator==(const temperature_parameter& o) const {
+					return parameter::operator==(o) && default_temp_gradient == o.default_temp_gradient && gradient_by_equation == o.gradient_by_equation;
+				}
+				bool operator!=(const temperature_parameter& o) const { return !operator==(o); }
 			};
 
 			/*\brief For precipitation,the scaling model needs the increase in precipitation for each 100 meters.
@@ -69,8 +83,187 @@ namespace shyft {
 				precipitation_parameter(double scale_factor = 1.02, size_t max_members = 20, double max_distance = 200000.0)
 					: parameter(max_members, max_distance), scale_factor(scale_factor) {}
 				double precipitation_scale_factor() const { return scale_factor; }
+				bool operator==(const precipitation_parameter& o) const {
+					return parameter::operator==(o) && scale_factor == o.scale_factor;
+				}
+				bool operator!=(const precipitation_parameter& o) const { return !operator==(o); }
+			};
+
+
+			/** \brief a source, and its idw weight for one destination */
+			template <class SP>
+			struct source_weight {
+				source_weight(SP source = nullptr, double weight = 0) : source(source), weight(weight) {}
+				SP source;
+				double weight;
+			};
+
+			const double max_source_weight = 1.0; ///< Used in place of inf for weights
+			const size_t spatial_index_min_sources = 64; ///< with more sources than this, neighbours are found using a kd_tree_3d
+
+			/** \brief add source to swl if the weight is within reach (max_distance) of the destination point */
+			template <class M, class SWL, class G, class SP, class P>
+			inline void add_source_weight(SWL& swl, const G& destination_point, SP source, const P& parameter, double min_weight) {
+				double weight = std::min(max_source_weight, 1.0 / M::distance_measure(destination_point,
+					source->mid_point(), parameter.distance_measure_factor, parameter.zscale));
+				if (weight >= min_weight) // max distance value tranformed to minimum weight, so we only use those near enough
+					swl.emplace_back(source, weight);
+			}
+
+			/** \brief keep the max_entries sources with highest weight, ordered by weight descending, then by source position
+			 * \note the total order makes the result independent of how the candidates was found
+			 */
+			template <class SWL>
+			inline void keep_max_entries(SWL& swl, size_t max_entries) {
+				typedef typename SWL::value_type sw_t;
+				auto heavier = [](const sw_t& a, const sw_t &b) {
+					return a.weight > b.weight || (a.weight == b.weight && std::less<decltype(a.source)>()(a.source, b.source));
+				};
+				// TODO: fix rare issue that if we get NaNs, and there are more sources in range than max_entries
+				//      then this approach using partial sort + truncate at max_entries, will not promote those truncated
+				//      even if they are in range.
+				if (swl.size() > max_entries) {
+					partial_sort(begin(swl), begin(swl) + max_entries, end(swl), heavier);  // partial sort the list
+					swl.resize(max_entries); // get rid of left-overs
+				} else {
+					sort(begin(swl), end(swl), heavier);
+				}
+			}
+
+			/** \return the weight of a source at max_distance */
+			template <class M, class G, class P>
+			inline double min_source_weight(const P& parameter) {
+				return 1.0 / M::distance_measure(G(0.0), G(parameter.max_distance), parameter.distance_measure_factor, parameter.zscale);
+			}
+
+			/** \brief for each destination, the list of sources, with weights, that are within reaching distance
+			 *
+			 * Computes the distance from all destinations to all sources, O(n_destinations x n_sources).
+			 * \sa run_interpolation for the template parameters
+			 */
+			template <class M, class S, class D, class P>
+			void make_cell_neighbours(S source_begin, S source_end, D destination_begin, D destination_end, const P& parameter,
+				vector<vector<source_weight<typename S::value_type const *>>>& cell_neighbours) {
+				typedef typename S::value_type source_t;
+				typedef vector<source_weight<source_t const *>> source_weight_list;
+				const double min_weight = min_source_weight<M, typename source_t::geo_point_t>(parameter);
+				cell_neighbours.clear();
+				cell_neighbours.reserve(distance(destination_begin, destination_end));
+				source_weight_list swl;
+				swl.reserve(distance(source_begin, source_end));
+				for (auto destination = destination_begin; destination != destination_end; ++destination) { // for each destination, create a unique SourceWeightList
+					auto destination_point = destination->mid_point();
+					swl.clear();
+					for (auto source = source_begin; source != source_end; ++source)
+						add_source_weight<M>(swl, destination_point, &(*source), parameter, min_weight);
+					keep_max_entries(swl, parameter.max_members);
+					cell_neighbours.emplace_back(swl);  // done with this destination source, n_dest x n_source allocs
+				}
+			}
+
+			/** \brief as make_cell_neighbours, but using a kd_tree_3d of the sources, giving the same result
+			 *
+			 * The tree is built over (x, y, zscale*z) of the sources, and for each destination we
+			 * first find the distance to the max_members'th nearest source (bounded by max_distance), and then
+			 * evaluates only the sources within that distance, with the same weight and selection as the full search.
+			 * This requires that M::distance_measure is increasing with the zscaled distance, as geo_point::distance_measure.
+			 * The search radius is slightly widened, and never below 1.0 m, where weights are clamped to max_source_weight,
+			 * so that sources with equal weight at the boundary are all considered.
+			 */
+			template <class M, class S, class D, class P>
+			void make_cell_neighbours_indexed(S source_begin, S source_end, D destination_begin, D destination_end, const P& parameter,
+				vector<vector<source_weight<typename S::value_type const *>>>& cell_neighbours) {
+				typedef typename S::value_type source_t;
+				typedef vector<source_weight<source_t const *>> source_weight_list;
+				const double min_weight = min_source_weight<M, typename source_t::geo_point_t>(parameter);
+				const double zscale = parameter.zscale;
+				vector<source_t const *> sources;
+				vector<kd_tree_3d::point> pts;
+				for (auto source = source_begin; source != source_end; ++source) {
+					auto p = source->mid_point();
+					pts.push_back(kd_tree_3d::point{{{p.x, p.y, p.z*zscale}}, sources.size()});
+					sources.push_back(&(*source));
+				}
+				kd_tree_3d tree(std::move(pts));
+				const double widen = 1.0 + 1e-9;
+				const double md2 = parameter.max_distance*parameter.max_distance*widen + 1e-6;
+				const size_t max_entries = parameter.max_members;
+				cell_neighbours.clear();
+				cell_neighbours.reserve(distance(destination_begin, destination_end));
+				source_weight_list swl;
+				vector<size_t> candidates;
+				for (auto destination = destination_begin; destination != destination_end; ++destination) {
+					auto destination_point = destination->mid_point();
+					std::array<double, 3> q{{destination_point.x, destination_point.y, destination_point.z*zscale}};
+					double r2 = md2;
+					if (max_entries < sources.size())
+						r2 = std::min(md2, std::max(tree.kth_distance2(q, max_entries, md2)*widen + 1e-6, 1.0));
+					candidates.clear();
+					tree.within(q, r2, candidates);
+					swl.clear();
+					for (auto ix : candidates)
+						add_source_weight<M>(swl, destination_point, sources[ix], parameter, min_weight);
+					keep_max_entries(swl, max_entries);
+					cell_neighbours.emplace_back(swl);
+				}
+			}
+
+			/** \brief the idw neighbours and weights of a range of destinations, in compressed sparse row (CSR) form
+			 *
+			 * The sources of destination j are source_ix[row[j]..row[j+1]), with the corresponding weight,
+			 * where source_ix is the position of the source in the source range the table was made from.
+			 * Using positions rather than pointers allows the table to be kept, and reused with
+			 * other copies of the same sources, as long as the geometry and parameters are unchanged.
+			 */
+			struct neighbour_table {
+				vector<size_t> row{size_t(0)};///< size n_destinations+1, row[0]=0
+				vector<uint32_t> source_ix;
+				vector<double> weight;
+
+				size_t size() const { return row.size() - 1; }
+				size_t n_entries() const { return source_ix.size(); }
+
+				/** \brief append the rows of t to this table */
+				void append(const neighbour_table& t) {
+					const size_t offset = source_ix.size();
+					source_ix.insert(source_ix.end(), t.source_ix.begin(), t.source_ix.end());
+					weight.insert(weight.end(), t.weight.begin(), t.weight.end());
+					row.reserve(row.size() + t.size());
+					for (size_t j = 1; j < t.row.size(); ++j)
+						row.push_back(offset + t.row[j]);
+				}
 			};
 
+			/** \brief compute the neighbour_table for the destinations, using the indexed search for many sources
+			 * \note S must iterate over contiguous storage, like a vector, since the position of a source is computed from its address
+			 */
+			template <class M, class S, class D, class P>
+			neighbour_table make_neighbour_table(S source_begin, S source_end, D destination_begin, D destination_end, const P& parameter) {
+				vector<vector<source_weight<typename S::value_type const *>>> cell_neighbours;
+				if (size_t(distance(source_begin, source_end)) > spatial_index_min_sources && parameter.distance_measure_factor > 0.0)
+					make_cell_neighbours_indexed<M>(source_begin, source_end, destination_begin, destination_end, parameter, cell_neighbours);
+				else
+					make_cell_neighbours<M>(source_begin, source_end, destination_begin, destination_end, parameter, cell_neighbours);
+				neighbour_table t;
+				size_t n_entries = 0;
+				for (const auto& cn : cell_neighbours) n_entries += cn.size();
+				t.row.reserve(cell_neighbours.size() + 1);
+				t.source_ix.reserve(n_entries);
+				t.weight.reserve(n_entries);
+				if (source_begin == source_end) {
+					t.row.resize(cell_neighbours.size() + 1, size_t(0));
+					return t;
+				}
+				auto source_0 = &(*source_begin);
+				for (const auto& cn : cell_neighbours) {
+					for (const auto& sw : cn) {
+						t.source_ix.push_back(uint32_t(sw.source - source_0));
+						t.weight.push_back(sw.weight);
+					}
+					t.row.push_back(t.source_ix.size());
+				}
+				return t;
+			}
 
 			/** \brief Inverse Distance Weighted Interpolation
 			* The Inverse Distance Weighted algorithm.
@@ -144,62 +337,80 @@ namespace shyft {
 				F&& dest_set_value) // in short, a setter function for the result..
 				//std::function< void(typename D::value_type& ,size_t ,double ) > dest_set_value ) // in short, a setter function for the result..
 			{
-				typedef typename S::value_type const * source_pointer;
-				typedef typename S::value_type source_t;
+				// 1. create cell_ neighbors,
+				//    that is; for each destination cell,
+				//     - a list of sources with weights that are within reaching distance
+				auto cell_neighbours = make_neighbour_table<M>(source_begin, source_end, destination_begin, destination_end, parameter);
+				run_interpolation<M>(source_begin, source_end, destination_begin, destination_end, cell_neighbours, 0, timeAxis, parameter, dest_set_value);
+			}
 
-				struct source_weight {
-					source_weight(source_pointer source = nullptr, double weight = 0) : source(source), weight(weight) {}
-					source_pointer source;
-					double weight;
-					// Source::TsAccessor(S,TimeAxis) should go into this one..
-					// at least if we plan for parallel computing in this alg.
-				};
+			/** \brief a source with its value sampled at the current time-step, passed to source based scale computers
+			 * so that they do not evaluate the source time-series again
+			 */
+			template <class S>
+			struct sampled_source {
+				const S& source;
+				double v;
+				auto mid_point() const -> decltype(source.mid_point()) { return source.mid_point(); }
+				template <class T>
+				double value(const T&) const { return v; }
+			};
 
-				static const double max_weight = 1.0; // Used in place of inf for weights
+			/** \brief add the sampled source to the scale computer, if it accepts a sampled_source, otherwise the source itself */
+			template <class GC, class S, class T>
+			inline auto add_sampled(GC& gc, const S& s, double v, T tx, int) -> decltype(gc.add(sampled_source<S>{s, v}, tx), void()) {
+				gc.add(sampled_source<S>{s, v}, tx);
+			}
+			template <class GC, class S, class T>
+			inline void add_sampled(GC& gc, const S& s, double, T tx, long) { gc.add(s, tx); }
 
-				const double min_weight = 1.0 / M::distance_measure(typename source_t::geo_point_t(0.0),
-					typename source_t::geo_point_t(parameter.max_distance),
-					parameter.distance_measure_factor, parameter.zscale);
+			const size_t source_sample_block_size = 1 << 15; ///< max number of values in the time-step x source matrix of run_interpolation
 
-				const size_t source_count = distance(source_begin, source_end);
+			/** \brief run_interpolation using a precomputed neighbour_table
+			 *
+			 * The sources used by the destination range are first sampled onto the time-axis, block-wise, into a dense
+			 * time-step x source matrix, so that each source value is evaluated once, instead of once for each destination that uses it.
+			 * The weighted sums are then gathers from the matrix row of the time-step.
+			 *
+			 * \param cell_neighbours the table, computed for the same sources, and a range of destinations starting with destination_begin
+			 * \param row0 the row in cell_neighbours that corresponds to destination_begin, allowing one table for the whole range to be used by partitions
+			 */
+			template<class M, class S, class D, class T, class P, class F>
+			void run_interpolation(S source_begin, S source_end,
+				D destination_begin, D destination_end,
+				const neighbour_table& cell_neighbours, size_t row0,
+				const T& timeAxis, const P& parameter,
+				F&& dest_set_value)
+			{
 				const size_t destination_count = distance(destination_begin, destination_end);
-
-				typedef vector<source_weight> source_weight_list;
-				vector<source_weight_list> cell_neighbours;
-
-				cell_neighbours.reserve(destination_count);
-
-				// 1. create cell_ neighbors,
-				//    that is; for each destination cell,
-				//     - a list of sources with weights that are within reaching distance
-				source_weight_list swl;
-				swl.reserve(source_count);
-				size_t max_entries = parameter.max_members;
-				for (auto destination = destination_begin; destination != destination_end; ++destination) { // for each destination, create a unique SourceWeightList
-					auto destination_point = destination->mid_point();
-					swl.clear();
-					// First, just create unsorted SourceWeightList
-					for_each(source_begin, source_end, [&](const typename S::value_type& source) {
-						double weight = std::min(max_weight, 1.0 / M::distance_measure(destination_point,
-							source.mid_point(), parameter.distance_measure_factor, parameter.zscale));
-						if (weight >= min_weight) // max distance value tranformed to minimum weight, so we only use those near enough
-							swl.emplace_back(&source, weight);
-					});
-
-					// now source weight list,swl, contains only sources that can be used for this dest. cell.
-					// TODO: fix rare issue that if we get NaNs, and there are more sources in range than max_entries
-					//      then this approach using partial sort + truncate at max_entries, will not promote those truncated
-					//      even if they are in range.
-					if (swl.size() > max_entries) {   // drop sorting if less than needed elements.. (maybe thats already done in partial sort ?)
-						partial_sort(begin(swl), begin(swl) + max_entries, end(swl),
-							[](const source_weight& a, const source_weight &b) { return a.weight > b.weight; });  // partial sort the list (later: only if max_entries>usable_sources.size..)
-						swl.resize(max_entries); // get rid of left-overs
+				if (row0 + destination_count > cell_neighbours.size())
+					throw runtime_error("idw: neighbour table does not cover the destinations");
+				const size_t* row = cell_neighbours.row.data() + row0;
+				const double* weight = cell_neighbours.weight.data();
+				const size_t n_sources = distance(source_begin, source_end);
+
+				// 2. map the sources used by the destination range to columns of the sample matrix
+				vector<uint32_t> column(n_sources, uint32_t(-1));
+				vector<uint32_t> used;// source ix of each column
+				vector<uint32_t> entry_column(row[destination_count] - row[0]);
+				for (size_t k = row[0]; k < row[destination_count]; ++k) {
+					const uint32_t ix = cell_neighbours.source_ix[k];
+					if (ix >= n_sources)
+						throw runtime_error("idw: neighbour table does not match the sources");
+					if (column[ix] == uint32_t(-1)) {
+						column[ix] = uint32_t(used.size());
+						used.push_back(ix);
 					}
-					cell_neighbours.emplace_back(swl);  // done with this destination source, n_dest x n_source allocs
+					entry_column[k - row[0]] = column[ix];
 				}
+				const size_t k0 = row[0];
+				const size_t n_used = used.size();
+				const size_t n_steps = timeAxis.size();
+				const size_t block_steps = n_used ? std::max(size_t(1), std::min(n_steps, source_sample_block_size / n_used)) : n_steps;
+				vector<double> sample(block_steps*n_used);
 
 				//
-				// 2. for each destination, do the IDW
+				// 3. for each destination, do the IDW
 				//     using cell_neighbors that keeps a list of reachable sources
 				//     Only use sources that provides a valid value using isfinite()
 				//    if the supplied Model::scale_computer (gradient..) require it, also
@@ -209,40 +420,47 @@ namespace shyft {
 				bool first_time_scale_calc = true;
 				typename M::scale_computer gc(parameter);
 
-				for (size_t i = 0; i < timeAxis.size(); ++i) {
-					auto period_i = timeAxis(i);
-
-					// compute gradient, scale whatever, based on available sources..
-					if (M::scale_computer::is_source_based() || first_time_scale_calc) {
-						destination_scale.clear();
-						for (size_t j = 0; j < cell_neighbours.size(); ++j) {
-							const auto &cell_neighbor = cell_neighbours[j];
-							gc.clear();// reset the scale computer
-							for (const auto & sw : cell_neighbor) {
-								double source_value = sw.source->value(period_i);
-								if (isfinite(source_value)) // only use valid source values
-									gc.add(*(sw.source), period_i);
+				for (size_t ib = 0; ib < n_steps; ib += block_steps) {
+					const size_t ie = std::min(n_steps, ib + block_steps);
+					for (size_t c = 0; c < n_used; ++c) { // source by source, so the accessors moves forward in time
+						const auto& source = *(source_begin + used[c]);
+						for (size_t i = ib; i < ie; ++i)
+							sample[(i - ib)*n_used + c] = source.value(timeAxis(i));
+					}
+					for (size_t i = ib; i < ie; ++i) {
+						auto period_i = timeAxis(i);
+						const double* sv = sample.data() + (i - ib)*n_used;
+
+						// compute gradient, scale whatever, based on available sources..
+						if (M::scale_computer::is_source_based() || first_time_scale_calc) {
+							destination_scale.clear();
+							for (size_t j = 0; j < destination_count; ++j) {
+								gc.clear();// reset the scale computer
+								for (size_t k = row[j]; k < row[j + 1]; ++k) {
+									double source_value = sv[entry_column[k - k0]];
+									if (isfinite(source_value)) // only use valid source values
+										add_sampled(gc, *(source_begin + used[entry_column[k - k0]]), source_value, period_i, 0);
+								}
+								destination_scale.emplace_back(gc.compute());//could pass (destination_begin +j)->mid_point(), so we know the dest position ?
+								first_time_scale_calc = false;// all models except temperature(due to gradient) are one time only,
 							}
-							destination_scale.emplace_back(gc.compute());//could pass (destination_begin +j)->mid_point(), so we know the dest position ?
-							first_time_scale_calc = false;// all models except temperature(due to gradient) are one time only,
 						}
-					}
-					//
-					// Now that we got the destination_computer in place, we can just iterate over
-					//
-					for (size_t j = 0; j < cell_neighbours.size(); ++j) {
-						double sum_weights = 0, sum_weight_value = 0;
-						auto &cell_neighbor = cell_neighbours[j];
-						auto destination = destination_begin + j;
-						double computed_scale = destination_scale[j];
-						for (const auto& sw : cell_neighbor) {
-							double source_value = sw.source->value(period_i);
-							if (isfinite(source_value)) { // only use valid source values
-								sum_weight_value += sw.weight*M::transform(source_value, computed_scale, *(sw.source), *destination);
-								sum_weights += sw.weight;
+						//
+						// Now that we got the destination_computer in place, we can just iterate over
+						//
+						for (size_t j = 0; j < destination_count; ++j) {
+							double sum_weights = 0, sum_weight_value = 0;
+							auto destination = destination_begin + j;
+							double computed_scale = destination_scale[j];
+							for (size_t k = row[j]; k < row[j + 1]; ++k) {
+								double source_value = sv[entry_column[k - k0]];
+								if (isfinite(source_value)) { // only use valid source values
+									sum_weight_value += weight[k]*M::transform(source_value, computed_scale, *(source_begin + used[entry_column[k - k0]]), *destination);
+									sum_weights += weight[k];
+								}
 							}
+							dest_set_value(*destination, period_i, sum_weight_value / sum_weights);
 						}
-						dest_set_value(*destination, period_i, sum_weight_value / sum_weights);
 					}
 				}
 			}
@@ -480,10 +698,70 @@ namespace shyft {
 				size_t operator()(const size_t i) const { return i; }
 			};
 
+			/** \brief keeps a neighbour_table, with the source and destination geometry and the parameters it was computed for
+			 *
+			 * The table only depends on the locations and on the idw geometry parameters, not on the source values,
+			 * so repeated interpolations over the same setup, like the forecast and calibration loops, can reuse it.
+			 * The table is shared, so copies of the cache, like in cloned region-models, are cheap.
+			 */
+			struct neighbour_table_cache {
+				parameter geometry;///< the base idw parameters the table was computed with
+				vector<geo_point> source_points;
+				vector<geo_point> destination_points;
+				shared_ptr<const neighbour_table> table;
+
+				void clear() { table.reset(); source_points.clear(); destination_points.clear(); }
+
+				/** \return approx. heap bytes of the table and the points */
+				size_t heap_bytes() const {
+					size_t b = (source_points.capacity() + destination_points.capacity())*sizeof(geo_point);
+					if (table)
+						b += sizeof(neighbour_table) + table->row.capacity()*sizeof(size_t)
+						   + table->source_ix.capacity()*sizeof(uint32_t) + table->weight.capacity()*sizeof(double);
+					return b;
+				}
+
+				/** \return the cached table if computed for the same geometry, otherwise nullptr */
+				template <class ApiSource, class D, class P>
+				shared_ptr<const neighbour_table> find(ApiSource const& api_sources, const D& cells, const P& p) const {
+					if (!table || !(geometry == as_geometry(p))
+						|| !same_points(source_points, begin(api_sources), end(api_sources))
+						|| !same_points(destination_points, begin(cells), end(cells)))
+						return nullptr;
+					return table;
+				}
+
+				template <class ApiSource, class D, class P>
+				void store(ApiSource const& api_sources, const D& cells, const P& p, shared_ptr<const neighbour_table> t) {
+					geometry = as_geometry(p);
+					source_points.clear();
+					for (const auto& s : api_sources) source_points.push_back(s.mid_point());
+					destination_points.clear();
+					for (const auto& c : cells) destination_points.push_back(c.mid_point());
+					table = move(t);
+				}
+			private:
+				template <class P>
+				static parameter as_geometry(const P& p) { return parameter(p.max_members, p.max_distance, p.distance_measure_factor, p.zscale); }
+
+				template <class It>
+				static bool same_points(const vector<geo_point>& v, It b, It e) {
+					if (size_t(distance(b, e)) != v.size()) return false;
+					for (const auto& p : v) {
+						const geo_point q = b->mid_point(); ++b;
+						if (p.x != q.x || p.y != q.y || p.z != q.z) return false;// exact, geo_point::operator== is within 1 mm
+					}
+					return true;
+				}
+			};
+
 			/** \brief run interpolation step, for a given IDW model, sources and parameters.
 			*  run_idw_interpolation of supplied sources to destination locations/cells, over a range as specified by timeaxis, based on supplied templatized parameters.
 			*
 			*  \note this is run in multicore mode, and it it safe because each thread, works on private or const data, and writes to different cells.
+			*   The destinations are split in ranges, about four for each thread, that the pool threads steal, including the
+			*   per destination scale(temperature gradient) computation. Each destination is computed by one thread from the
+			*   same neighbour table and source values, so the result does not depend on the number of threads.
 			*
 			* \tparam IDWModel IDW model class, ref. IDW.h
 			* \tparam IDWModelSource IDW source class, ref IDW.h for requirements.
@@ -492,9 +770,12 @@ namespace shyft {
 			* \tparam D IDW destination ref IDW.h
 			* \tparam ResultSetter lambda for writing results back to destination, (Destination,size_t idx,double value)
 			*
+			* \param ncore max number of threads to use, -1 means all threads of the pool
+			* \param cache if supplied, the neighbour_table is taken from, or computed and stored into, the cache
+			* \param pool the pool to run on, default the process-wide executor
 			*/
 			template<typename IDWModel, typename IDWModelSource, typename ApiSource, typename P, typename D, typename ResultSetter, typename TimeAxis>
-			void run_interpolation(const TimeAxis &ta, ApiSource const & api_sources, const P& parameters, D &cells, ResultSetter&& result_setter,int ncore=-1) {
+			void run_interpolation(const TimeAxis &ta, ApiSource const & api_sources, const P& parameters, D &cells, ResultSetter&& result_setter,int ncore=-1, neighbour_table_cache* cache=nullptr, shared_ptr<work_stealing_pool> pool=nullptr) {
 				using namespace std;
 				/// 1. make a vector of ts-accessors for the sources. Notice that this vector needs to be modified, since the accessor 'remembers'
 				///    the last position. It is essential for performance, -but again-, then each thread needs it's own copy of the sources.
@@ -502,37 +783,59 @@ namespace shyft {
 
 
 				idw_timeaxis<TimeAxis> idw_ta(ta);
-				///    - and figure out a suitable ncore number. Using single cpu 4..8 core shows we can have more threads than cores, and gain speed.
-                if (ncore < 0) {
-                    ncore = (int) thread::hardware_concurrency();//in case of not available, default to 4,
-                    if (ncore < 2) ncore = 4;
-                    //ncore = 1; // we got unstable interpolation with ncore=auto and ncells=10 -> disable auto detection, and run one thread pr. interpolation
+				///    - and figure out a suitable ncore number, default all the threads of the pool.
+                if (!pool)
+                    pool = executor::instance();
+                if (ncore < 0)
+                    ncore = int(pool->size() + 1);
+                size_t n_cells = distance(begin(cells), end(cells));
+                size_t thread_cell_count = std::max(size_t(1), n_cells / (4*size_t(std::max(ncore, 1))));// some more ranges than threads, for load-balancing
+                auto cells_begin = begin(cells);
+                shared_ptr<const neighbour_table> nt;
+                if (cache) {
+                    nt = cache->find(api_sources, cells, parameters);
+                    if (!nt) { // compute the table for all cells, by partition, then join
+                        vector<neighbour_table> parts((n_cells + thread_cell_count - 1)/thread_cell_count);
+                        auto compute_part = [cells_begin, thread_cell_count, &parts, &api_sources, &ta, &parameters](size_t i0, size_t i1) {
+                            trace::scope ts("idw.neighbours", i0, i1);
+                            vector<IDWModelSource> src; src.reserve(api_sources.size());
+                            for (auto& s : api_sources) src.emplace_back(s, ta);
+                            parts[i0/thread_cell_count] = make_neighbour_table<IDWModel>(begin(src), end(src), cells_begin + i0, cells_begin + i1, parameters);
+                        };
+                        if (ncore < 2 || parts.size() < 2) {
+                            for (size_t i0 = 0; i0 < n_cells; i0 += thread_cell_count) compute_part(i0, std::min(n_cells, i0 + thread_cell_count));
+                        } else {
+                            pool->parallel_for(n_cells, thread_cell_count, compute_part, size_t(ncore));
+                        }
+                        auto t = make_shared<neighbour_table>();
+                        for (const auto& p : parts) t->append(p);
+                        cache->store(api_sources, cells, parameters, t);
+                        nt = t;
+                    }
                 }
                 if (ncore < 2) {
+                    trace::scope ts("idw.cells", 0, n_cells);
                     vector<IDWModelSource> src; src.reserve(api_sources.size());
                     for (auto& s : api_sources) src.emplace_back(s, ta);
-                    run_interpolation<IDWModel>(begin(src), end(src), begin(cells), end(cells), idw_ta, parameters, result_setter);
+                    if (nt)
+                        run_interpolation<IDWModel>(begin(src), end(src), begin(cells), end(cells), *nt, 0, idw_ta, parameters, result_setter);
+                    else
+                        run_interpolation<IDWModel>(begin(src), end(src), begin(cells), end(cells), idw_ta, parameters, result_setter);
                 } else {
-                    /// 2. Create a set of futures, for the threads that we want to run
-                    vector<future<void>> calcs;
-                    size_t n_cells = distance(begin(cells), end(cells));
-                    size_t thread_cell_count = 1 + n_cells / ncore;
-                    auto cells_iterator = begin(cells);
-                    for (size_t i = 0; i < n_cells;) {
-                        size_t n = thread_cell_count;
-                        if (i + n > n_cells) n = n_cells - i;// Figure out a cell-partition to compute
-                        vector<IDWModelSource> src; src.reserve(api_sources.size());// need one source set pr. thread, since src accessors is not threadsafe
-                        for (auto& s : api_sources) src.emplace_back(s, ta);
-                        calcs.emplace_back( /// spawn a thread to run IDW on this part of the cells, using *all* sources (later we could speculate in sources needed)
-                            async(launch::async, [src, cells_iterator, &idw_ta, &parameters, &result_setter, n]() { /// capture src by value, we *want* a copy of that..
-                            run_interpolation<IDWModel>(begin(src), end(src), cells_iterator, cells_iterator + n, idw_ta, parameters, result_setter);
-                        })
-                        );
-                        cells_iterator = cells_iterator + n;
-                        i = i + n;
-                    }
-                    ///3. wait for the IDW computation threads to end.
-                    for (auto&f : calcs) f.get();
+                    /// 2. partition the cells, and let the shared executor run the partitions, using max ncore threads
+                    const neighbour_table* ntp = nt.get();
+                    pool->parallel_for(n_cells, thread_cell_count,
+                        [cells_begin, ntp, &api_sources, &ta, &idw_ta, &parameters, &result_setter](size_t i0, size_t i1) {
+                            trace::scope ts("idw.cells", i0, i1);
+                            vector<IDWModelSource> src; src.reserve(api_sources.size());// need one source set pr. partition, since src accessors is not threadsafe
+                            for (auto& s : api_sources) src.emplace_back(s, ta);
+                            if (ntp)
+                                run_interpolation<IDWModel>(begin(src), end(src), cells_begin + i0, cells_begin + i1, *ntp, i0, idw_ta, parameters, result_setter);
+                            else
+                                run_interpolation<IDWModel>(begin(src), end(src), cells_begin + i0, cells_begin + i1, idw_ta, parameters, result_setter);
+                        },
+                        size_t(ncore)
+                    );
                 }
 			}
 		} // namespace  inverse_distance
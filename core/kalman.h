@@ -48,6 +48,57 @@ namespace shyft {
                 }
             };
 
+            /** \brief the kalman states of many points, like the sites of a grid post-processing, in SoA layout
+             *
+             * P is symmetric, and only the upper triangle is kept, packed by rows, so element (i,j), i<=j, of point p is
+             * at [packed_ix(i,j)*n_points + p], and x(i) at [i*n_points + p]. The update of one element for all points
+             * is then a contiguous loop, the points can be range-partitioned, and P takes n(n+1)/2, not n*n, doubles a point.
+             * W is common to all points.
+             */
+            struct batch_state {
+                size_t n_points = 0;
+                int n = 0;///< n_daily_observations
+                vector<double> x;
+                vector<double> k;
+                vector<double> P;///< the packed upper triangle, ref. packed_ix
+                arma::mat W;
+
+                batch_state() {}
+                /** \brief all points starts with state s0 */
+                batch_state(const state& s0, size_t n_points) : n_points(n_points), n(s0.size()), W(s0.W) {
+                    x.resize(n*n_points); k.resize(n*n_points); P.resize(packed_size()*n_points);
+                    for (int i = 0; i < n; ++i) {
+                        fill_n(x.begin() + i*n_points, n_points, s0.x(i));
+                        fill_n(k.begin() + i*n_points, n_points, s0.k(i));
+                        for (int j = i; j < n; ++j)
+                            fill_n(P.begin() + packed_ix(i, j)*n_points, n_points, s0.P.at(i, j));
+                    }
+                }
+                size_t size() const { return n_points; }
+                /** \return the number of elements of the packed upper triangle of P */
+                size_t packed_size() const { return size_t(n)*(n + 1)/2; }
+                /** \return the index of P(i,j) in the packed upper triangle, as P is symmetric, i and j can be in any order */
+                size_t packed_ix(int i, int j) const {
+                    if (i > j) std::swap(i, j);
+                    return size_t(i)*n - size_t(i)*(i - 1)/2 + (j - i);
+                }
+                double& x_at(int i, size_t p) { return x[i*n_points + p]; }
+                double x_at(int i, size_t p) const { return x[i*n_points + p]; }
+                double P_at(int i, int j, size_t p) const { return P[packed_ix(i, j)*n_points + p]; }
+
+                /** \return the state of point p */
+                state point_state(size_t p) const {
+                    state s;
+                    s.x = arma::vec(n); s.k = arma::vec(n); s.P = arma::mat(n, n); s.W = W;
+                    for (int i = 0; i < n; ++i) {
+                        s.x(i) = x[i*n_points + p]; s.k(i) = k[i*n_points + p];
+                        for (int j = 0; j < n; ++j)
+                            s.P.at(i, j) = P_at(i, j, p);
+                    }
+                    return s;
+                }
+            };
+
 
             /** \brief parameters to tune the kalman-filter
             */
@@ -141,6 +192,71 @@ namespace shyft {
                         /// TODO: Does the kalman gain need to be updated?
                     }
                 }
+
+                /** \brief update the points [p0..p1) of the batch_state s, with the observed_bias[p] for the period starting at t
+                 *
+                 * Equal to update(observed_bias[p],t,state p) for each point with a finite observed_bias, the loops are over points innermost.
+                 * Points with nan observed_bias are left unchanged, like bias_predictor, which only learns from the non-nan values.
+                 * The points are done in blocks that fit a fixed scratch area on the stack, so there are no heap allocations.
+                 */
+                void update_batch(const double* observed_bias, utctime t, batch_state& s, size_t p0, size_t p1) const {
+                    if (p1 <= p0) return;
+                    if (size_t(s.n) + 3 > update_scratch_size)
+                        throw runtime_error("kalman::filter::update_batch: too many daily observations for the batch update");
+                    double scratch[update_scratch_size];
+                    const size_t block = update_scratch_size/(size_t(s.n) + 3);
+                    const int ix = fold_to_daily_observation(t);
+                    for (size_t b0 = p0; b0 < p1; b0 += block)
+                        update_block(observed_bias, ix, s, b0, std::min(p1, b0 + block), scratch);
+                }
+
+            private:
+                static const size_t update_scratch_size = 4096;///< doubles, for the blocks of the batch update
+
+                /** update the points [p0..p1), (n+3)*(p1-p0) doubles of scratch is used */
+                void update_block(const double* observed_bias, int ix, batch_state& s, size_t p0, size_t p1, double* scratch) const {
+                    const size_t np = s.n_points, m = p1 - p0;
+                    const int n = s.n;
+                    const double v2 = p.std_error_bias_measurements*p.std_error_bias_measurements;
+                    double* valid = scratch;
+                    double* inv_tmp = valid + m;
+                    double* innovation = inv_tmp + m;
+                    double* pc = innovation + m;// P.col(ix) before the update, n x m
+                    for (size_t q = 0; q < m; ++q)
+                        valid[q] = isfinite(observed_bias[p0 + q]) ? 1.0 : 0.0;
+                    for (int i = 0; i < n; ++i)
+                        for (int j = i; j < n; ++j) {
+                            const double w = s.W.at(i, j);
+                            double* Pij = s.P.data() + s.packed_ix(i, j)*np + p0;
+                            for (size_t q = 0; q < m; ++q) Pij[q] += valid[q]*w;
+                        }
+                    const double* Pxx = s.P.data() + s.packed_ix(ix, ix)*np + p0;
+                    for (size_t q = 0; q < m; ++q) {
+                        inv_tmp[q] = valid[q] != 0.0 ? 1.0/(Pxx[q] + v2) : 0.0;// 0.0 leaves P, k and x unchanged
+                        innovation[q] = valid[q] != 0.0 ? observed_bias[p0 + q] - s.x[ix*np + p0 + q] : 0.0;
+                    }
+                    for (int i = 0; i < n; ++i) {
+                        const double* Pix = s.P.data() + s.packed_ix(i, ix)*np + p0;
+                        double* ki = s.k.data() + i*np + p0;
+                        double* xi = s.x.data() + i*np + p0;
+                        double* pci = pc + i*m;
+                        for (size_t q = 0; q < m; ++q) {
+                            pci[q] = Pix[q];
+                            if (inv_tmp[q] != 0.0) {
+                                ki[q] = Pix[q]*inv_tmp[q];
+                                xi[q] += ki[q]*innovation[q];
+                            }
+                        }
+                    }
+                    for (int i = 0; i < n; ++i)
+                        for (int j = i; j < n; ++j) {
+                            double* Pij = s.P.data() + s.packed_ix(i, j)*np + p0;
+                            const double* pci = pc + i*m;
+                            const double* pcj = pc + j*m;
+                            for (size_t q = 0; q < m; ++q)
+                                Pij[q] -= pci[q]*pcj[q]*inv_tmp[q];
+                        }
+                }
             };
 
             /** \brief bias_predictor for forecast-observation for solar-influenced signals
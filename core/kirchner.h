@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include <boost/numeric/odeint.hpp>
 
 #include "core_serialization.h"
@@ -108,6 +110,26 @@ namespace shyft {
             };
 
 
+            /** \brief Select the fixed-step exponential solver, computing the average using a simple trapezoidal rule
+             *
+             * Used as the AC argument of the kirchner::calculator, this replaces the adaptive dopri5 solver with
+             * a fixed number of exponential Rosenbrock-Euler sub-steps pr. hour of the same log transformed equation.
+             * The method is stable for any step length, and second order accurate, so a few sub-steps pr. hour suffice
+             * for the smooth time-steps typical for calibration runs.
+             * The average is the trapezoidal rule over the sub-step solutions, as for trapezoidal_average.
+             * \tparam S stepper, not used, kept for compatibility with the AC interface
+             */
+            template<class S>
+            class fixed_step_trapezoidal_average : public trapezoidal_average<S> {
+                public:
+                    static const size_t steps_per_hour = 2;
+                    explicit fixed_step_trapezoidal_average(S& stepper) : trapezoidal_average<S>(stepper) {}
+            };
+
+            /** \brief true if the average computer A selects the fixed-step solver */
+            template<class A> struct is_fixed_step : std::false_type {};
+            template<class S> struct is_fixed_step<fixed_step_trapezoidal_average<S>> : std::true_type {};
+
             /** \brief kirchner parameters as defined in reference
              *
              * In operation, these parameters could be estimated based on time
@@ -160,7 +182,7 @@ namespace shyft {
              *    - P.c1 --> double, first parameter in the Kirchner model
              *    - P.c2 --> double, second parameter in the Kirchner model
              *    - P.c3 --> double, third parameter in the Kirchner model
-             *    \sa kirchner::TrapezoidalAverage \sa kirchner::CompositeTrapezoidalAverage
+             *    \sa kirchner::trapezoidal_average \sa kirchner::composite_trapezoidal_average \sa kirchner::fixed_step_trapezoidal_average
              */
             template<template<class> class AC, class P>
             class calculator {
@@ -195,6 +217,53 @@ namespace shyft {
                     return gln_q >= 1.e-30 ? gln_q*((p - e)*std::exp(-ln_q) - 1.0) : 0.0;
                 }
 
+                /** \brief exponential Rosenbrock-Euler step of the log transformed equation
+                 *
+                 * Linearizing f around ln_q, with the analytic jacobian J=df/d(ln_q), gives
+                 * \f$ln_q + h\varphi_1(hJ)f(ln_q)\f$, where \f$\varphi_1(z)=(e^z-1)/z\f$,
+                 * exact for linear problems, second order, and stable for any h.
+                 */
+                double exponential_euler(double ln_q, double p, double e, double h) const {
+                    const double gln_q = g(ln_q);
+                    if (gln_q < 1.e-30) return ln_q;// as for log_transform_f
+                    const double r = (p - e)*std::exp(-ln_q);
+                    const double f = gln_q*(r - 1.0);
+                    const double z = h*gln_q*((param.c2 + 2.0*param.c3*ln_q)*(r - 1.0) - r);
+                    const double phi1 = std::fabs(z) < 1.e-5 ? 1.0 + 0.5*z : std::expm1(z)/z;
+                    return ln_q + h*phi1*f;
+                }
+
+                void integrate(double t1, double& q, double p, double e, double min_q, std::true_type) {
+                    const size_t n = std::max(size_t(1), size_t(std::ceil(t1*AC<dense_stepper_type>::steps_per_hour - 1e-9)));
+                    const double h = t1/n;
+                    const double ln_min_q = log(min_q);
+                    double ln_q = log(q);
+                    average_computer.initialize(q, 0.0);
+                    for (size_t i = 1; i <= n; ++i) {
+                        ln_q = std::max(ln_min_q, exponential_euler(ln_q, p, e, h));
+                        q = std::exp(ln_q);
+                        average_computer.add(q, i*h);
+                    }
+                }
+
+                void integrate(double t1, double& q, double p, double e, double, std::false_type) {
+                    state_type x_tmp = log(q); // Log transform
+                    const double t0 = 0.0;
+                    dense_stepper.initialize(x_tmp, t0, t1 - t0);
+                    average_computer.initialize(q, t0);
+                    double current_time = dense_stepper.current_time();
+                    while (current_time < t1) {
+                        dense_stepper.do_step([this, p, e](const state_type x, state_type& dxdt, double) {
+                                              dxdt = log_transform_f(x, p, e); });
+                        current_time = dense_stepper.current_time();
+                        if (current_time < t1)
+                            average_computer.add(exp(dense_stepper.current_state()), current_time);
+                    }
+                    dense_stepper.calc_state(t1, x_tmp);
+                    q = std::exp(x_tmp); // Invert log transform
+                    average_computer.add(q, t1);
+                }
+
               public:
                 explicit calculator(const P& param) : param(param) { /* Do nothing */ }
 
@@ -209,26 +278,10 @@ namespace shyft {
                  *       it is forced to min_q to ensure numerical stability
                  */
                 void step(shyft::core::utctime T0, shyft::core::utctime T1, double& q, double& q_avg, double p, double e) {
-                    state_type x_tmp;
                     const double min_q = 0.00001;// ref note above
                     if (q < min_q) q = min_q;
-                    x_tmp = log(q); // Log transform
-
-                    double t0 = 0.0;
-                    double t1 = double(T1 - T0)/deltahours(1); // Units in kirchner are mm/hour.
-                    dense_stepper.initialize(x_tmp, t0, t1 - t0);
-                    average_computer.initialize(q, t0);
-                    double current_time = dense_stepper.current_time();
-                    while (current_time < t1) {
-                        dense_stepper.do_step([this, p, e](const state_type x, state_type& dxdt, double) {
-                                              dxdt = log_transform_f(x, p, e); });
-                        current_time = dense_stepper.current_time();
-                        if (current_time < t1)
-                            average_computer.add(exp(dense_stepper.current_state()), current_time);
-                    }
-                    dense_stepper.calc_state(t1, x_tmp);
-                    q = std::exp(x_tmp); // Invert log transform
-                    average_computer.add(q, t1);
+                    const double t1 = double(T1 - T0)/deltahours(1); // Units in kirchner are mm/hour.
+                    integrate(t1, q, p, e, min_q, is_fixed_step<AC<dense_stepper_type>>());
                     q_avg = average_computer.result();
                 }
 
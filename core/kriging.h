@@ -1,9 +1,15 @@
 #pragma once
 
 #include <cmath>
+#include <limits>
+#include <vector>
+#include <memory>
 #include <stdexcept>
 #include <armadillo>
 
+#include "geo_point.h"
+#include "inverse_distance.h"
+
 
 namespace shyft {
     namespace core {
@@ -130,6 +136,199 @@ namespace shyft {
                     return c;
                 }
 
+
+                /** \brief parameters for the local ordinary kriging, ref. run_interpolation
+                 *
+                 * The covariance is exponential,  (sill-nug)*exp(-3h/range), of the zscaled distance h,
+                 * the nugget is added to the diagonal of the source-source covariance, as observation variance.
+                 */
+                struct local_parameter {
+                    double sill = 25.0;///< value of the semi-variogram at range
+                    double nug = 0.5;///< nugget, must be less than sill
+                    double range = 200000.0;///< [m] practical range of the covariance
+                    double zscale = 20.0;///< height scale used in distance computations
+                    size_t max_members = 16;///< max number of sources in each local kriging system
+                    double max_distance = 200000.0;///< [m] only sources within this zscaled distance are used
+                    double z_gradient = -0.006;///< [unit/m] values are reduced to z=0 with this gradient before kriging, and lifted to destination z after, default is the temperature lapse rate
+
+                    local_parameter() {}
+                    local_parameter(double sill, double nug, double range, double zscale, size_t max_members, double max_distance, double z_gradient = -0.006)
+                        : sill(sill), nug(nug), range(range), zscale(zscale), max_members(max_members), max_distance(max_distance), z_gradient(z_gradient) {}
+
+                    /** \return the idw neighbour search parameters, nearest by zscaled distance */
+                    inverse_distance::parameter neighbour_parameter() const { return inverse_distance::parameter(max_members, max_distance, 2.0, zscale); }
+
+                    bool operator==(const local_parameter& o) const {
+                        return sill == o.sill && nug == o.nug && range == o.range && zscale == o.zscale
+                            && max_members == o.max_members && max_distance == o.max_distance && z_gradient == o.z_gradient;
+                    }
+                    bool operator!=(const local_parameter& o) const { return !operator==(o); }
+                };
+
+                /** \brief the distance model for the idw neighbour search, ref. inverse_distance::make_neighbour_table */
+                struct neighbour_model {
+                    static inline double distance_measure(const geo_point& a, const geo_point& b, double f, double zscale) {
+                        return geo_point::distance_measure(a, b, f, zscale);
+                    }
+                };
+
+                /** \brief compute the ordinary kriging weights of sources p to the destination d
+                 * \return weights, one for each source, summing to 1.0
+                 */
+                inline std::vector<double> local_weights(const std::vector<geo_point>& p, const geo_point& d, const local_parameter& param) {
+                    const size_t n = p.size();
+                    if (n == 1) return std::vector<double>(1, 1.0);
+                    covariance::exponential cov(param.sill - param.nug, param.range);
+                    auto f_cov = [&cov, &param](const geo_point& a, const geo_point& b) { return cov(geo_point::zscaled_distance(a, b, param.zscale)); };
+                    arma::mat A = build(p.begin(), p.end(), f_cov);
+                    for (arma::uword i = 0; i < (arma::uword)n; ++i)
+                        A.at(i, i) += param.nug;
+                    std::vector<geo_point> dv(1, d);
+                    arma::mat b = build(p.begin(), p.end(), dv.begin(), dv.end(), f_cov);
+                    arma::mat x = arma::solve(A, b);
+                    std::vector<double> w(n);
+                    for (size_t i = 0; i < n; ++i) w[i] = x.at((arma::uword)i, 0);
+                    return w;
+                }
+
+                /** \brief local ordinary kriging of sources to destinations, using a precomputed idw neighbour table
+                 *
+                 * Each destination is kriged from its neighbours in the table, by solving a small
+                 * (n+1)x(n+1) system, so the cost scales with destinations x max_members^3, not with the number of sources.
+                 * The weights are kept for each destination, and only recomputed when the set of valid neighbours changes.
+                 * Sources are sampled block-wise into a time-step x source matrix, as for the idw.
+                 *
+                 * \tparam S source iterator, S.mid_point(), S.value(T(i)), contiguous storage
+                 * \tparam D destination iterator, D.mid_point()
+                 * \tparam T time-axis, T.size(), T(i), like inverse_distance::idw_timeaxis
+                 * \tparam F setter callable(D::value_type&, T(i), double value)
+                 * \param neighbours table made for the same sources, ref. local_parameter::neighbour_parameter
+                 * \param row0 the row of destination_begin in the table
+                 */
+                template <class S, class D, class T, class F>
+                void run_interpolation(S source_begin, S source_end, D destination_begin, D destination_end,
+                                       const inverse_distance::neighbour_table& neighbours, size_t row0,
+                                       const T& time_axis, const local_parameter& param, F&& dest_set_value) {
+                    const size_t destination_count = std::distance(destination_begin, destination_end);
+                    const size_t n_sources = std::distance(source_begin, source_end);
+                    if (row0 + destination_count > neighbours.size())
+                        throw std::runtime_error("kriging: neighbour table does not cover the destinations");
+                    const size_t* row = neighbours.row.data() + row0;
+                    const size_t k0 = row[0], k1 = row[destination_count];
+                    std::vector<uint32_t> column(n_sources, uint32_t(-1));
+                    std::vector<uint32_t> used;
+                    std::vector<uint32_t> entry_column(k1 - k0);
+                    for (size_t k = k0; k < k1; ++k) {
+                        const uint32_t ix = neighbours.source_ix[k];
+                        if (ix >= n_sources)
+                            throw std::runtime_error("kriging: neighbour table does not match the sources");
+                        if (column[ix] == uint32_t(-1)) {
+                            column[ix] = uint32_t(used.size());
+                            used.push_back(ix);
+                        }
+                        entry_column[k - k0] = column[ix];
+                    }
+                    const size_t n_used = used.size();
+                    std::vector<geo_point> used_point(n_used);
+                    for (size_t c = 0; c < n_used; ++c) used_point[c] = (source_begin + used[c])->mid_point();
+
+                    std::vector<double> weight(k1 - k0, 0.0);// current weights of each entry, 0.0 for invalid sources
+                    std::vector<char> valid(k1 - k0, 0), was_valid(k1 - k0, 2);// 2: no weights yet
+                    std::vector<geo_point> p;
+                    std::vector<size_t> p_entry;
+
+                    const size_t n_steps = time_axis.size();
+                    const size_t block_steps = n_used ? std::max(size_t(1), std::min(n_steps, inverse_distance::source_sample_block_size / n_used)) : n_steps;
+                    std::vector<double> sample(block_steps*n_used);
+                    for (size_t ib = 0; ib < n_steps; ib += block_steps) {
+                        const size_t ie = std::min(n_steps, ib + block_steps);
+                        for (size_t c = 0; c < n_used; ++c) {
+                            const auto& source = *(source_begin + used[c]);
+                            for (size_t i = ib; i < ie; ++i)  // residuals at z=0
+                                sample[(i - ib)*n_used + c] = source.value(time_axis(i)) - param.z_gradient*used_point[c].z;
+                        }
+                        for (size_t j = 0; j < destination_count; ++j) {
+                            auto destination = destination_begin + j;
+                            const geo_point dp = destination->mid_point();
+                            for (size_t i = ib; i < ie; ++i) {
+                                const double* sv = sample.data() + (i - ib)*n_used;
+                                bool changed = false;
+                                size_t n_valid = 0;
+                                for (size_t k = row[j]; k < row[j + 1]; ++k) {
+                                    valid[k - k0] = std::isfinite(sv[entry_column[k - k0]]) ? 1 : 0;
+                                    n_valid += valid[k - k0];
+                                    changed = changed || valid[k - k0] != was_valid[k - k0];
+                                }
+                                if (changed) {
+                                    p.clear(); p_entry.clear();
+                                    for (size_t k = row[j]; k < row[j + 1]; ++k) {
+                                        weight[k - k0] = 0.0;
+                                        was_valid[k - k0] = valid[k - k0];
+                                        if (valid[k - k0]) {
+                                            p.push_back(used_point[entry_column[k - k0]]);
+                                            p_entry.push_back(k - k0);
+                                        }
+                                    }
+                                    if (n_valid) {
+                                        auto w = local_weights(p, dp, param);
+                                        for (size_t q = 0; q < w.size(); ++q) weight[p_entry[q]] = w[q];
+                                    }
+                                }
+                                double v = std::numeric_limits<double>::quiet_NaN();
+                                if (n_valid) {
+                                    v = 0.0;
+                                    for (size_t k = row[j]; k < row[j + 1]; ++k)
+                                        if (valid[k - k0]) v += weight[k - k0]*sv[entry_column[k - k0]];
+                                    v += param.z_gradient*dp.z;
+                                }
+                                dest_set_value(*destination, time_axis(i), v);
+                            }
+                        }
+                    }
+                }
+
+                /** \brief local ordinary kriging of api sources to cells, partitioned over the threads of a pool
+                 *
+                 * As inverse_distance::run_interpolation for the api-sources, with the same neighbour_table_cache,
+                 * and the same partitioning of the cells.
+                 * \tparam SourceWrap source wrapper, like idw_compliant_geo_point_ts, constructed from(ApiSource::value_type, TimeAxis)
+                 */
+                template <class SourceWrap, class ApiSource, class D, class ResultSetter, class TimeAxis>
+                void run_interpolation(const TimeAxis& ta, ApiSource const& api_sources, const local_parameter& param, D& cells,
+                                       ResultSetter&& result_setter, int ncore = -1,
+                                       inverse_distance::neighbour_table_cache* cache = nullptr,
+                                       std::shared_ptr<work_stealing_pool> pool = nullptr) {
+                    using std::begin; using std::end;
+                    inverse_distance::idw_timeaxis<TimeAxis> k_ta(ta);
+                    if (!pool)
+                        pool = executor::instance();
+                    if (ncore < 0)
+                        ncore = int(pool->size() + 1);
+                    const auto np = param.neighbour_parameter();
+                    const size_t n_cells = std::distance(begin(cells), end(cells));
+                    auto make_sources = [&api_sources, &ta]() {
+                        std::vector<SourceWrap> src; src.reserve(api_sources.size());
+                        for (auto& s : api_sources) src.emplace_back(s, ta);
+                        return src;
+                    };
+                    std::shared_ptr<const inverse_distance::neighbour_table> nt = cache ? cache->find(api_sources, cells, np) : nullptr;
+                    if (!nt) {
+                        auto src = make_sources();
+                        nt = std::make_shared<inverse_distance::neighbour_table>(
+                            inverse_distance::make_neighbour_table<neighbour_model>(begin(src), end(src), begin(cells), end(cells), np));
+                        if (cache)
+                            cache->store(api_sources, cells, np, nt);
+                    }
+                    auto cells_begin = begin(cells);
+                    auto run_range = [&](size_t i0, size_t i1) {
+                        auto src = make_sources();// one set pr. range, the accessors are not thread-safe
+                        run_interpolation(begin(src), end(src), cells_begin + i0, cells_begin + i1, *nt, i0, k_ta, param, result_setter);
+                    };
+                    if (ncore < 2)
+                        run_range(0, n_cells);
+                    else
+                        pool->parallel_for(n_cells, std::max(size_t(1), n_cells/(4*size_t(ncore))), run_range, size_t(ncore));
+                }
             }
             // later maybe: namespace simple {}
             // later maybe: namespace trend {}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "time_series.h"
+
+namespace shyft {
+    namespace core {
+        using std::size_t;
+
+        /** \brief approx. bytes used by a region_model, by part, ref. region_model::memory_usage
+         *
+         * The bytes are those of the objects, and the heap of their vectors and series, without the allocator overhead.
+         * Values shared by several series, like the shared_point_ts of environment_shared_t, are split among them,
+         * while the caches shared with the copies of a model, like the idw tables and the uhgs, are counted in full by each copy.
+         */
+        struct model_memory_usage {
+            size_t cells{ 0 };///< the cell objects, geo, parameter reference, state, and the env_ts and collector objects, without their values
+            size_t env_ts{ 0 };///< the values of the env_ts of the cells
+            size_t response_collectors{ 0 };///< the values of the response collectors of the cells, and the catchment sums, ref. catchment_accumulator
+            size_t state_collectors{ 0 };///< the values of the state collectors of the cells
+            size_t states{ 0 };///< the initial state and the state checkpoints
+            size_t interpolation_caches{ 0 };///< the idw neighbour tables, ref. region_model::cache_idw_neighbours
+            size_t routing_caches{ 0 };///< the river flows of the last run, and the uhgs
+
+            size_t total() const { return cells + env_ts + response_collectors + state_collectors + states + interpolation_caches + routing_caches; }
+        };
+
+        template <class T, class = void>
+        struct has_heap_bytes : std::false_type {};
+        template <class T>
+        struct has_heap_bytes<T, decltype(void(std::declval<const T&>().heap_bytes()))> : std::true_type {};
+
+        template <class T>
+        inline size_t heap_bytes_of(const T& x, std::true_type) { return x.heap_bytes(); }
+        template <class T>
+        inline size_t heap_bytes_of(const T&, std::false_type) { return 0; }
+
+        /** \return the heap bytes of x, by its heap_bytes() member, or 0 if it has none, like the null_collector and constant_timeseries */
+        template <class T>
+        inline size_t heap_bytes(const T& x) { return heap_bytes_of(x, has_heap_bytes<T>{}); }
+
+        /** \return the heap bytes of the values of ts */
+        template <class TA, class V>
+        inline size_t heap_bytes(const time_series::point_ts<TA, V>& ts) { return ts.v.capacity()*sizeof(V); }
+
+        /** \return the sum of the heap bytes of the series, for the heap_bytes() of the collectors */
+        template <class... TS>
+        inline size_t series_heap_bytes(const TS&... ts) {
+            size_t s = 0;
+            for (size_t b : { size_t(0), heap_bytes(ts)... })
+                s += b;
+            return s;
+        }
+    }
+}
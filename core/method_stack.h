@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#if defined(SHYFT_METHOD_STACK_PROFILING)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+/**
+ * Contains the compile-time composition of method stacks, like pt_hs_k, from routines
+ */
+
+namespace shyft {
+    namespace core {
+        namespace method_stack {
+
+            /** \brief optional per-routine instrumentation of the method stacks
+             *
+             * When compiled with SHYFT_METHOD_STACK_PROFILING defined, the method stacks count the cycles,
+             * and the number of calls, of each routine into the counters of the running thread, ref. thread_counters().
+             * region_model::run_cells sums the counters of the threads into region_model::stack_counters.
+             * Otherwise the timers are empty, and the instrumentation is removed at compile time.
+             */
+            namespace profiling {
+#if defined(SHYFT_METHOD_STACK_PROFILING)
+                const bool enabled = true;
+#else
+                const bool enabled = false;
+#endif
+                /** \brief the routines of the method stacks, as counted */
+                enum routine : size_t {
+                    input,///< reading the input time-series, and precipitation correction
+                    snow,///< gamma_snow, skaugen or hbv_snow
+                    glacier_melt,
+                    potential_evapotranspiration,///< priestley_taylor
+                    actual_evapotranspiration,
+                    response,///< kirchner, or hbv soil and tank
+                    discharge,///< the total discharge and charge of the cell
+                    collect,///< the state and response collectors
+                    other,///< routines of composed stacks that do not declare a profile_routine
+                    n_routines
+                };
+
+                inline const char* routine_name(size_t r) {
+                    static const char* names[n_routines] = {"input", "snow", "glacier_melt", "potential_evapotranspiration",
+                        "actual_evapotranspiration", "response", "discharge", "collect", "other"};
+                    return r < n_routines ? names[r] : "";
+                }
+
+                /** \brief cycles and calls of each routine */
+                struct counters {
+                    std::array<uint64_t, n_routines> cycles;
+                    std::array<uint64_t, n_routines> calls;
+                    counters() { clear(); }
+                    void clear() { cycles.fill(0); calls.fill(0); }
+                    uint64_t total_cycles() const {
+                        uint64_t s = 0;
+                        for (auto c : cycles) s += c;
+                        return s;
+                    }
+                    counters& operator+=(const counters& o) {
+                        for (size_t r = 0; r < n_routines; ++r) { cycles[r] += o.cycles[r]; calls[r] += o.calls[r]; }
+                        return *this;
+                    }
+                    counters operator-(const counters& o) const {
+                        counters d(*this);
+                        for (size_t r = 0; r < n_routines; ++r) { d.cycles[r] -= o.cycles[r]; d.calls[r] -= o.calls[r]; }
+                        return d;
+                    }
+                    bool operator==(const counters& o) const { return cycles == o.cycles && calls == o.calls; }
+                };
+
+                /** \return the counters of the calling thread, accumulated over all stacks run by it */
+                inline counters& thread_counters() {
+                    static thread_local counters c;
+                    return c;
+                }
+
+                /** \return the cycle counter, the time-stamp counter when available, otherwise steady_clock ns */
+                inline uint64_t cycle_count() {
+#if defined(SHYFT_METHOD_STACK_PROFILING)
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+                    return __rdtsc();
+#else
+                    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+#else
+                    return 0;
+#endif
+                }
+
+                /** \brief times consecutive routines of a stack into the thread counters
+                 *
+                 * The timer starts on the first routine when constructed, and next(r) ends the current
+                 * routine and starts r, so there is one cycle_count() per routine boundary.
+                 * The last routine ends when the timer is destroyed.
+                 */
+                template <bool Enabled>
+                struct basic_timer {
+                    explicit basic_timer(routine) {}
+                    void next(routine) {}
+                };
+
+                template <>
+                struct basic_timer<true> {
+                    counters& c;
+                    routine r;
+                    uint64_t t0;
+                    explicit basic_timer(routine r) : c(thread_counters()), r(r), t0(cycle_count()) {}
+                    basic_timer(const basic_timer&) = delete;
+                    basic_timer& operator=(const basic_timer&) = delete;
+                    void next(routine n) {
+                        const uint64_t t = cycle_count();
+                        c.cycles[r] += t - t0;
+                        ++c.calls[r];
+                        r = n;
+                        t0 = t;
+                    }
+                    ~basic_timer() { next(r); }
+                };
+
+                typedef basic_timer<enabled> timer;
+
+                /** \brief sums the thread counters of the work-items run by measure(), thread-safe */
+                struct accumulator {
+                    counters sum;
+                    std::mutex mx;
+
+                    /** \brief run f(), and add the counts of the calling thread during f() to sum */
+                    template <class F>
+                    void measure(F&& f) {
+                        if (!enabled) {
+                            f();
+                            return;
+                        }
+                        const counters c0 = thread_counters();
+                        f();
+                        const counters d = thread_counters() - c0;
+                        std::lock_guard<std::mutex> lock(mx);
+                        sum += d;
+                    }
+                };
+
+                /** \brief the routine counted for routine type M, M::profile_routine::value if declared, like
+                 * \code
+                 *   typedef std::integral_constant<profiling::routine, profiling::snow> profile_routine;
+                 * \endcode
+                 * otherwise other.
+                 */
+                template <class M, class = void>
+                struct routine_of : std::integral_constant<routine, other> {};
+
+                template <class M>
+                struct routine_of<M, typename std::enable_if<(M::profile_routine::value, true)>::type>
+                    : std::integral_constant<routine, M::profile_routine::value> {};
+            }
+
+            /** \brief true_type if the collector C declares itself a no-op, by typedef std::true_type is_null_collector
+             *
+             * Collect calls to such collectors are removed at compile time, ref. collect(),
+             * so that calibration runs, with a null state collector, never touch the state for collection.
+             */
+            template <class C, class = void>
+            struct is_null_collector : std::false_type {};
+
+            template <class C>
+            struct is_null_collector<C, typename std::enable_if<C::is_null_collector::value>::type> : std::true_type {};
+
+            template <class C, class X>
+            inline void collect(C&, size_t, const X&, std::true_type) {}
+
+            template <class C, class X>
+            inline void collect(C& c, size_t i, const X& x, std::false_type) { c.collect(i, x); }
+
+            /** \brief c.collect(i,x), or nothing at all if C is a null collector */
+            template <class C, class X>
+            inline void collect(C& c, size_t i, const X& x) { collect(c, i, x, is_null_collector<C>()); }
+
+            template <class M, class I>
+            inline const I& init_of(const I& init) { return init; }
+
+            /** \brief a method stack composed of the routines M..., run in order for each time-step
+             *
+             * Each routine is constructed in place from the common init object of the stack,
+             * usually the step context, and implements:
+             *    - M(const I& init)
+             *    - template<class X> void step(X& x), advancing the routine one time-step,
+             *      reading the inputs and the responses of earlier routines from x, and writing its own.
+             *
+             * The routines are members of the stack, and the step of the stack is the sequence of the inlined
+             * routine steps, so the compiler sees the complete time-step as one fused kernel.
+             * New stacks are assembled by listing their routines, like
+             * \code
+             *   method_stack::stack<snow_routine, pt_routine, kirchner_routine> s(ctx);
+             *   for (..) { ctx.set_step(i); s.step(ctx); }
+             * \endcode
+             * \note the routines can keep references to the init object, and are not required to be copyable,
+             *  so the stack is not copyable.
+             */
+            template <class... M>
+            struct stack {
+                std::tuple<M...> routines;
+
+                template <class I>
+                explicit stack(const I& init) : routines(init_of<M>(init)...) {}
+                stack(const stack&) = delete;
+                stack& operator=(const stack&) = delete;
+
+                /** \brief  step all routines in order, with the step context x */
+                template <class X>
+                void step(X& x) {
+                    profiling::basic_timer<false> tm(profiling::other);
+                    step(x, tm);
+                }
+
+                /** \brief  step all routines in order, switching the timer tm to each routine, ref. profiling::routine_of */
+                template <class X, class Timer>
+                void step(X& x, Timer& tm) { step(x, tm, std::make_index_sequence<sizeof...(M)>()); }
+
+                template <size_t k>
+                typename std::tuple_element<k, std::tuple<M...>>::type& get() { return std::get<k>(routines); }
+
+              private:
+                template <class X, class Timer, size_t... k>
+                void step(X& x, Timer& tm, std::index_sequence<k...>) {
+                    const int in_order[] = {0, (tm.next(profiling::routine_of<M>::value), std::get<k>(routines).step(x), 0)...};
+                    (void)in_order;
+                }
+            };
+
+            /** \brief run the stack s over the time-steps [i_begin,i_end) of the context x, collecting state and responses
+             *
+             * The context x implements:
+             *    - x.set_step(size_t i), reading the inputs of time-step i
+             *    - x.state, the state of the stack, collected at the beginning of each step, and the end state
+             *    - x.response, the response of the stack, collected after each step
+             * \note collect calls to null collectors are removed at compile time, ref. is_null_collector
+             */
+            template <class Stack, class X, class SC, class RC>
+            void run(Stack& s, X& x, size_t i_begin, size_t i_end, SC& state_collector, RC& response_collector) {
+                for (size_t i = i_begin; i < i_end; ++i) {
+                    profiling::timer tm(profiling::input);
+                    x.set_step(i);
+                    tm.next(profiling::collect);
+                    collect(state_collector, i, x.state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
+                    s.step(x, tm);
+                    tm.next(profiling::collect);
+                    collect(response_collector, i, x.response);
+                    if (i + 1 == i_end)
+                        collect(state_collector, i + 1, x.state);///< \note last iteration,collect the  final state as well.
+                }
+                response_collector.set_end_response(x.response);
+            }
+        }
+    }
+}
@@ -2,12 +2,14 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <cmath>
 #include <limits>
 #include <future>
 #include <utility>
 #include <memory>
+#include <functional>
 #include <stdexcept>
 #include <iostream>
 #include <dlib/optimization/optimization_bobyqa.h>
@@ -18,6 +20,9 @@
 #include "region_model.h"
 #include "dream_optimizer.h"
 #include "sceua_optimizer.h"
+#include "surrogate.h"
+#include "pareto_optimizer.h"
+#include "pattern_search_optimizer.h"
 
 namespace shyft {
     namespace core {
@@ -68,6 +73,57 @@ namespace shyft {
                 x = model.from_scaled(_x);
                 return res;
             }
+            /** \brief true_type if the model M evaluates batches of parameter sets, like optimizer::evaluate_batch */
+            template<class M, class = void>
+            struct detect_evaluate_batch :false_type {};
+
+            template<class M>
+            struct detect_evaluate_batch<M, decltype(declval<M&>().evaluate_batch(declval<const vector<vector<double>>&>(), declval<vector<double>&>()), void())> :true_type {};
+
+            template<class M>
+            void evaluate_batch_of(M& m, const vector<vector<double>>& xs, vector<double>& fxs, true_type) { m.evaluate_batch(xs, fxs); }
+
+            template<class M>
+            void evaluate_batch_of(M& m, const vector<vector<double>>& xs, vector<double>& fxs, false_type) {
+                fxs.resize(xs.size());
+                for (size_t i = 0; i < xs.size(); ++i) fxs[i] = m(xs[i]);
+            }
+
+            /** \brief true_type if the model M evaluates bounded batches of parameter sets, like optimizer::evaluate_batch_bounded */
+            template<class M, class = void>
+            struct detect_evaluate_batch_bounded :false_type {};
+
+            template<class M>
+            struct detect_evaluate_batch_bounded<M, decltype(declval<M&>().evaluate_batch_bounded(declval<const vector<vector<double>>&>(), declval<const vector<double>&>(), declval<vector<double>&>()), void())> :true_type {};
+
+            template<class M>
+            void evaluate_batch_bounded_of(M& m, const vector<vector<double>>& xs, const vector<double>& f_bounds, vector<double>& fxs, true_type) { m.evaluate_batch_bounded(xs, f_bounds, fxs); }
+
+            template<class M>
+            void evaluate_batch_bounded_of(M& m, const vector<vector<double>>& xs, const vector<double>&, vector<double>& fxs, false_type) {
+                evaluate_batch_of(m, xs, fxs, detect_evaluate_batch<M>());
+            }
+
+            /** \brief the warm start seed, given in the parameter space of the model M, scaled by M::to_scaled, with fx negated if maximize */
+            template<class M>
+            shyft::core::optimizer::warm_start scaled_warm_start(M& model, const shyft::core::optimizer::warm_start& seed, bool maximize) {
+                shyft::core::optimizer::warm_start r;
+                r.x.reserve(seed.x.size());
+                for (auto x : seed.x)
+                    r.x.push_back(x.empty() ? x : model.to_scaled(x));
+                r.fx = seed.fx;
+                if (maximize)
+                    for (auto& f : r.fx) f = -f;
+                r.reuse_fx = seed.reuse_fx;
+                return r;
+            }
+
+            template<class M>
+            size_t concurrency_of(const M& m, true_type) { return m.concurrency(); }
+
+            template<class M>
+            size_t concurrency_of(const M&, false_type) { return 1; }
+
             ///<Template class to transform model evaluation into something that dream can run
             template<class M>
             struct dream_fx : public shyft::core::optimizer::ifx {
@@ -76,6 +132,11 @@ namespace shyft {
                 double evaluate(const vector<double> &x) {
                     return -m(x); // notice that dream find maximumvalue, so we need to negate the goal function, effectively finding the minimum value.
                 }
+                void evaluate_batch(const vector<vector<double>>& xs, vector<double>& fxs) override {
+                    evaluate_batch_of(m, xs, fxs, detect_evaluate_batch<M>());
+                    for (auto& f : fxs) f = -f;
+                }
+                size_t concurrency() const override { return concurrency_of(m, detect_evaluate_batch<M>()); }
             };
 
             /** \brief template function that find the x that minimizes the evaluated value of model M using DREAM algorithm
@@ -83,15 +144,19 @@ namespace shyft {
              * \param model a reference to the model to be evaluated
              * \param x     the initial x parameters to use (actually not, dream is completely random driven), filled in with the optimal values on return
              * \param max_n_evaluations is the maximum number of iterations, currently not used, the routine returns when convergence is reached
+             * \param seed if set, points to warm start the chains from, in the same space as x, with their goal function values, ref. dream::find_max
              * \return the goal function of m value, corresponding to the found x-vector
              */
             template  <class M>
-            double min_dream(M& model, vector<double>& x, int max_n_evaluations) {
+            double min_dream(M& model, vector<double>& x, int max_n_evaluations, const shyft::core::optimizer::warm_start* seed = nullptr) {
                 // Scale all parameter ranges to [0, 1]
                 std::vector<double> x_s = model.to_scaled(x);
                 dream_fx<M> fx_m(model);
                 shyft::core::optimizer::dream dr;
-                double res = dr.find_max(fx_m, x_s, max_n_evaluations);
+                shyft::core::optimizer::warm_start seed_s;
+                if (seed)
+                    seed_s = scaled_warm_start(model, *seed, true);
+                double res = dr.find_max(fx_m, x_s, max_n_evaluations, seed ? &seed_s : nullptr);
                 // Convert back to real parameter range
                 x = model.from_scaled(x_s);
                 return res;
@@ -105,6 +170,11 @@ namespace shyft {
                 double evaluate(const vector<double> &x) {
                     return m(x);
                 }
+                void evaluate_batch(const vector<vector<double>>& xs, vector<double>& fxs) override { evaluate_batch_of(m, xs, fxs, detect_evaluate_batch<M>()); }
+                void evaluate_batch_bounded(const vector<vector<double>>& xs, const vector<double>& f_bounds, vector<double>& fxs) override {
+                    evaluate_batch_bounded_of(m, xs, f_bounds, fxs, detect_evaluate_batch_bounded<M>());
+                }
+                size_t concurrency() const override { return concurrency_of(m, detect_evaluate_batch<M>()); }
             };
 
             /** \brief template for the function that finds the x that minimizes the evaluated value of model M using SCEUA algorithm
@@ -114,11 +184,13 @@ namespace shyft {
              * \param max_n_evaluations stop after max_n_interations reached(keep best x until then)
              * \param x_eps stop when all x's changes less than x_eps(recall range 0..1), convergence in x
              * \param y_eps stop when last y-values (model goal functions) seems to have converged (no improvements)
+             * \param seed if set, points to warm start the sample from, in the same space as x, with their goal function values, ref. sceua::find_min
              * \return the goal function of m value, and x is the corresponding parameter-set.
              * \throw runtime_error with text sceua: terminated before convergence or max iterations
              */
             template <class M>
-            double min_sceua(M& model, vector<double>& x, size_t max_n_evaluations, double x_eps = 0.0001, double y_eps = 0.0001) {
+            double min_sceua(M& model, vector<double>& x, size_t max_n_evaluations, double x_eps = 0.0001, double y_eps = 0.0001,
+                             const shyft::core::optimizer::warm_start* seed = nullptr) {
                 // Scale all parameter ranges to [0, 1]
                 vector<double> x_s = model.to_scaled(x);
                 vector<double> x_min(x_s.size(), 0.0);///normalized range is 0..1 so is min..max
@@ -130,8 +202,12 @@ namespace shyft {
                 sceua_fx<M> fx_m(model);
                 shyft::core::optimizer::sceua opt;
                 double y_result = 0;
+                shyft::core::optimizer::warm_start seed_s;
+                if (seed)
+                    seed_s = scaled_warm_start(model, *seed, false);
                 // optimize with no specific range for y-exit (max-less than min):
-                auto opt_state = opt.find_min(x_s.size(), x_min.data(), x_max.data(), xv, y_result, fx_m, y_eps, -1.0, -2.0, x_epsv.data(), max_n_evaluations);
+                auto opt_state = opt.find_min(x_s.size(), x_min.data(), x_max.data(), xv, y_result, fx_m, y_eps, -1.0, -2.0, x_epsv.data(), max_n_evaluations,
+                                              seed ? &seed_s : nullptr);
                 for (size_t i = 0; i < x_s.size(); ++i) x_s[i] = xv[i];//copy from raw vector
                 // Convert back to real parameter range
                 x = model.from_scaled(x_s);
@@ -141,6 +217,28 @@ namespace shyft {
 
             }
 
+            /** \brief find the x that minimizes model M with the parallel pattern search, a local method like min_bobyqa
+             *
+             * The poll points of each iteration are passed to the model as one batch, so a model that evaluates
+             * batches concurrently, like optimizer with concurrent evaluations, keeps all its replicas busy, ref. optimizer::pattern_search.
+             * \tparam M the model, that provide .to_scaled(x) and .from_scaled(x) to normalize the parameters to 0..1 range
+             * \param model a reference to the model evaluated
+             * \param x starting point for the parameters, set to the best point found on return
+             * \param max_n_evaluations stop after max_n_evaluations
+             * \param tr_start the initial step, in the scaled 0..1 range, as the trust region start of min_bobyqa
+             * \param tr_stop stop when the step is below this, as the trust region stop of min_bobyqa
+             * \return the goal function of m value, and x is the corresponding parameter-set.
+             */
+            template <class M>
+            double min_pattern_search(M& model, vector<double>& x, size_t max_n_evaluations, double tr_start = 0.1, double tr_stop = 1.0e-5) {
+                vector<double> x_s = model.to_scaled(x);
+                sceua_fx<M> fx_m(model);
+                shyft::core::optimizer::pattern_search opt;
+                double res = opt.find_min(fx_m, x_s, max_n_evaluations, tr_start, tr_stop);
+                x = model.from_scaled(x_s);
+                return res;
+            }
+
             /**\brief utility class to help transfrom time-series into suitable resolution
             */
             struct ts_transform {
@@ -164,6 +262,32 @@ namespace shyft {
                     return to_average<TS, TSS>(start, dt, n, *src);
                 }
             };
+            /** \brief the optimization methods of the optimizer, ref. optimizer::optimize, optimize_sceua and optimize_dream */
+            enum optimizer_method {
+                BOBYQA,
+                SCEUA,
+                DREAM,
+                PATTERN_SEARCH
+            };
+
+            /** \brief a stage of optimizer::optimize_staged
+             *
+             * The stage optimizes on the first period_length of the model time-axis, with the targets averaged
+             * to target_dt, so early stages can be short and coarse, and the last stage the full period as given.
+             */
+            struct calibration_stage {
+                utctimespan period_length = 0;///< of the model time-axis, from its start, 0 means the full time-axis
+                utctimespan target_dt = 0;///< the resolution of the targets during the stage, 0 means as given
+                optimizer_method method = SCEUA;
+                size_t max_n_evaluations = 1500;
+                calibration_stage() {}
+                calibration_stage(utctimespan period_length, utctimespan target_dt, optimizer_method method, size_t max_n_evaluations)
+                    : period_length(period_length), target_dt(target_dt), method(method), max_n_evaluations(max_n_evaluations) {}
+                bool operator==(const calibration_stage& o) const {
+                    return period_length == o.period_length && target_dt == o.target_dt && method == o.method && max_n_evaluations == o.max_n_evaluations;
+                }
+            };
+
             /** \brief calc_type to provide simple start of more than NS critera, first extension is diff of sum 2 */
             enum target_spec_calc_type {
                 NASH_SUTCLIFFE, //
@@ -330,6 +454,75 @@ namespace shyft {
                 }
             };
 
+            /** \brief the observations of a target, with its periods aligned to the model time-axis, computed once for the targets
+             *
+             * Only the target periods with a finite observation are kept, in order, so obs has no nans.
+             * The simulated value of kept period j is the time-weighted average of the finite model step values of
+             * step[row[j]..row[j+1]), weighted by dt, that is the same as the average_accessor of a stair-case series.
+             */
+            struct aligned_target {
+                vector<double> obs;///< the finite observations
+                vector<utctime> end;///< the end of the target period of each observation
+                vector<size_t> row;///< obs.size() + 1 offsets into step and dt
+                vector<size_t> step;///< model time-axis index
+                vector<utctimespan> dt;///< the overlap of the model step and the target period
+
+                /** \brief align the target ts to the model time-axis ta */
+                template <class TS, class TA>
+                aligned_target(const TS& ts, const TA& ta) {
+                    const auto& tta = ts.time_axis();
+                    const utctime t0 = ta.size() ? ta.time(0) : no_utctime;
+                    const utctime t_end = ta.size() ? ta.total_period().end : no_utctime;
+                    row.push_back(0);
+                    for (size_t i = 0; i < tta.size(); ++i) {
+                        const double o = ts.value(i);
+                        if (!isfinite(o))
+                            continue;
+                        const auto p = tta.period(i);
+                        obs.push_back(o);
+                        end.push_back(p.end);
+                        if (ta.size() && p.start < t_end && p.end > t0) {
+                            for (size_t k = p.start <= t0 ? 0 : ta.index_of(p.start); k < ta.size() && ta.time(k) < p.end; ++k) {
+                                const utctime s0 = std::max(ta.time(k), p.start);
+                                const utctime s1 = k + 1 < ta.size() ? std::min(ta.time(k + 1), p.end) : p.end;// the last step is extended flat
+                                if (s1 > s0) {
+                                    step.push_back(k);
+                                    dt.push_back(s1 - s0);
+                                }
+                            }
+                        }
+                        row.push_back(step.size());
+                    }
+                }
+                size_t size() const { return obs.size(); }
+
+                /** \brief the simulated values s[j] of the first n observations, from the model step values v */
+                template <class V>
+                void simulated(const vector<V>& v, size_t n, vector<double>& s) const {
+                    s.resize(n);
+                    for (size_t j = 0; j < n; ++j) {
+                        double area = 0.0;
+                        utctimespan tsum = 0;
+                        for (size_t e = row[j]; e < row[j + 1]; ++e) {
+                            const double x = v[step[e]];
+                            if (isfinite(x)) {
+                                area += x*dt[e];
+                                tsum += dt[e];
+                            }
+                        }
+                        s[j] = tsum > 0 ? area/tsum : shyft::nan;
+                    }
+                }
+            };
+
+            /** \brief accessor of contiguous values, for the goal functions */
+            struct values_accessor {
+                const double* v;
+                size_t n;
+                size_t size() const { return n; }
+                double value(size_t i) const { return v[i]; }
+            };
+
 
             /** \brief The optimizer for parameters in a shyft::core::region_model
              * provides needed functionality to orchestrate a search for the optimal parameters so that the goal function
@@ -364,11 +557,15 @@ namespace shyft {
                 typedef typename M::parameter_t parameter_t;
                 typedef typename M::cell_t cell_t;
                 typedef typename cell_t::response_collector_t response_collector_t;
+                /** the goal functions of the full parameter vectors, run the given time-steps, 0 means all, ref. set_remote_evaluation */
+                typedef std::function<vector<double>(const vector<vector<double>>&, size_t)> remote_evaluator_t;
             public:
                 PA parameter_lower_bound;///< current setting of parameter lower bound
                 PA parameter_upper_bound;///< current setting of parameter upper bound
                 vector<PA> parameters_trace;///< parameters_trace contains all parameters tried during optimization
                 vector<double> goal_fn_trace;///< goal-fn-value, corresponding to parameters_trace
+                vector<PA> pareto_parameters;///< the pareto front of the last optimize_pareto
+                vector<vector<double>> pareto_goal_functions;///< the goal function of each target, corresponding to pareto_parameters
                 PA& parameter_accessor; ///<  a *reference* to the model parameters in the target  model, all cells share this!
                 region_model_t& model; ///< a reference to the region model that we optimize
                 vector<target_specification_t> targets; ///<  list of targets ts& catchments indexes to be optimized, used to calculate goal function
@@ -379,6 +576,40 @@ namespace shyft {
                 vector<double> p_max;
                 int print_progress_level;
                 size_t n_catchments=0;///< optimized counted number of model.catchments available
+                vector<double> catchment_area;///< the area of each catchment, by internal index, for the area averages from catchment sums
+                size_t n_concurrent=1;///< number of parameter sets evaluated concurrently, ref. set_concurrent_evaluations
+                vector<shared_ptr<region_model_t>> replicas;///< copies of the model, used with the model for concurrent evaluations
+                remote_evaluator_t remote_evaluate;///< if set, evaluates the batches instead of the model and replicas, ref. set_remote_evaluation
+                size_t n_segments=0;///< number of segments of bounded evaluations, ref. set_early_termination
+                /** \brief the statistics of the finite observations of a target, for goal_function_lower_bound */
+                struct observed_stats {
+                    double ss=0.0;///< sum of squared deviations from the mean
+                    double min=shyft::nan;
+                    double max=shyft::nan;
+                    size_t n=0;
+                };
+                vector<observed_stats> target_observed;///< by target, set in prepare_optimize
+                vector<aligned_target> target_aligned;///< by target, set in prepare_optimize
+                size_t screen_min_samples=0;///< traced evaluations needed before the surrogate screens candidates, 0 is off, ref. set_surrogate_screening
+                double screen_margin=0.1;///< candidates are screened out if predicted worse than the bound by this fraction of the fitted range
+                size_t screen_max_samples=200;///< the surrogate is fitted to this many of the latest traced evaluations
+                const size_t screen_refit_interval=10;///< new traced evaluations before the surrogate is refitted
+                shyft::core::optimizer::rbf_surrogate surrogate;
+                size_t surrogate_trace_size=0;///< the size of the trace when the surrogate was fitted
+                size_t n_screened=0;///< candidates screened out since prepare_optimize
+                /** \brief a goal function value in the evaluation cache, exact, or a lower bound from a stopped run */
+                struct cached_goal_function {
+                    double f;
+                    bool exact;
+                };
+                double cache_resolution=0.0;///< the quantum of the scaled parameters of the cache keys, 0 is off, ref. set_evaluation_cache
+                size_t cache_max_size=0;///< max entries of the cache
+                map<vector<long long>, cached_goal_function> evaluation_cache;///< by the quantised scaled reduced parameters
+                size_t n_cache_hits=0;///< since prepare_optimize
+                size_t n_cache_misses=0;
+                size_t n_run_steps=0;///< the time-axis steps run by each evaluation, 0 means all, ref. optimize_staged
+                std::function<void(const PA&, double)> trace_callback;///< ref. set_trace_callback
+                shyft::core::optimizer::warm_start warm_start_p;///< full parameter vectors, ref. set_warm_start
                 //Need to handle expanded/reduced parameter vector based on min..max range to optimize speed for bobyqa
                 const double activate_limit = 0.000001;
                 bool is_active_parameter(size_t i) const { return fabs(p_max[i] - p_min[i]) > activate_limit; }
@@ -402,6 +633,15 @@ namespace shyft {
                     }
                     return r;
                 }
+                /** \return the warm start points reduced to the active parameters, ref. set_warm_start */
+                shyft::core::optimizer::warm_start reduced_warm_start() const {
+                    shyft::core::optimizer::warm_start r;
+                    for (const auto& p : warm_start_p.x)
+                        r.x.push_back(p.size() == p_min.size() ? reduce_p_vector(p) : vector<double>());// empty ones are skipped by warm_start::pick
+                    r.fx = warm_start_p.fx;
+                    r.reuse_fx = warm_start_p.reuse_fx;
+                    return r;
+                }
                 vector<double> p_vector(const PA&p) const { vector<double> r;r.reserve(p.size());for (size_t i = 0;i < p.size();++i)r.push_back(p.get(i));return r; }
                 PA vector_p(const vector<double>& v)const { PA p; p.set(v); return p; }
 
@@ -466,8 +706,12 @@ namespace shyft {
                     // 1. ensure vectors reflects current state of lower..upper bounds
                     p_min = p_vector(parameter_lower_bound);
                     p_max = p_vector(parameter_upper_bound);
-                    // 2. figure out n_catchments, asking the model
+                    // 2. figure out n_catchments, asking the model, and their areas
                     n_catchments = model.number_of_catchments();
+                    catchment_area.assign(n_catchments, 0.0);
+                    for (const auto& c : *model.get_cells())
+                        if (c.geo.catchment_ix < n_catchments)
+                            catchment_area[c.geo.catchment_ix] += c.geo.area();
                     // 3. figure out the catchment indexes to evaluate..
                     //    and if we need to turn on snow collection
                     vector<int> catchment_indexes;
@@ -495,8 +739,35 @@ namespace shyft {
                     model.set_catchment_calculation_filter(catchment_indexes); //Only calculate the catchments that we optimize
                     // 4. detects if initial state is established, if not it automatically do a copy of the current state
                     auto_initial_state_check();
+                    model.forget_state_changes();// the first revert copies all, the cells could be changed outside the model
                     parameters_trace.clear();// wipe out parameters_trace
                     goal_fn_trace.clear();// and the corresponding goal_fn values
+                    // 5. copy the prepared model, with initial state, filter and collection settings, to the replicas
+                    replicas.clear();
+                    for (size_t i = 1; i < n_concurrent && !remote_evaluate; ++i)
+                        replicas.push_back(make_shared<region_model_t>(model));
+                    surrogate = shyft::core::optimizer::rbf_surrogate();
+                    surrogate_trace_size = 0;
+                    n_screened = 0;
+                    evaluation_cache.clear();// the model or the targets could be changed
+                    n_cache_hits = n_cache_misses = 0;
+                    // 6. the observations aligned to the model time-axis, and their statistics, fixed for the session
+                    target_aligned.clear();
+                    target_observed.clear();
+                    for (const auto& t : targets) {
+                        target_aligned.emplace_back(t.ts, model.time_axis);
+                        observed_stats o;
+                        double avg = 0.0;
+                        for (auto v : target_aligned.back().obs) {
+                            ++o.n;
+                            const double d = v - avg;
+                            avg += d/double(o.n);
+                            o.ss += d*(v - avg);
+                            o.min = o.n == 1 ? v : std::min(o.min, v);
+                            o.max = o.n == 1 ? v : std::max(o.max, v);
+                        }
+                        target_observed.push_back(o);
+                    }
                 }
                 void auto_initial_state_check() {
                     if (model.initial_state.size() != model.get_cells()->size()) {
@@ -508,6 +779,9 @@ namespace shyft {
                 int trace_size() const {return goal_fn_trace.size();}
                 double trace_goal_fn(int i) const {return goal_fn_trace[size_t(i)];}
                 PA   trace_parameter(int i) const {return parameters_trace[size_t(i)];}
+                size_t pareto_size() const { return pareto_parameters.size(); }
+                PA pareto_parameter(size_t i) const { return pareto_parameters.at(i); }
+                vector<double> pareto_goal_function(size_t i) const { return pareto_goal_functions.at(i); }
                 /** returns the initial state for the i'th cell */
                 state_t get_initial_state(size_t idx) {
                     auto_initial_state_check();// in case it's not done, do it now
@@ -554,7 +828,8 @@ namespace shyft {
                     // reduce using min..max the parameter space,
                     p_expanded = p;//put all parameters into class scope so that we can reduce/expand as needed during optimization
                     auto rp = reduce_p_vector(p);
-                    min_dream<optimizer>(*this, rp, max_n_evaluations);
+                    auto seed = reduced_warm_start();
+                    min_dream<optimizer>(*this, rp, max_n_evaluations, seed.x.empty() ? nullptr : &seed);
                     return expand_p_vector(rp);// expand,put inplace p to return vector.
                 }
                 /** optimize using the dream algorithm, returning the new optimized parameter set*/
@@ -579,7 +854,8 @@ namespace shyft {
                     // reduce using min..max the parameter space,
                     p_expanded = p;//put all parameters into class scope so that we can reduce/expand as needed during optimization
                     auto rp = reduce_p_vector(p);
-                    min_sceua(*this, rp, max_n_evaluations, x_eps, y_eps);
+                    auto seed = reduced_warm_start();
+                    min_sceua(*this, rp, max_n_evaluations, x_eps, y_eps, seed.x.empty() ? nullptr : &seed);
                     return expand_p_vector(rp);				// expand,put inplace p to return vector.
                 }
 
@@ -590,6 +866,112 @@ namespace shyft {
                     return r;
                 }
 
+                /**\brief Call to optimize model with the parallel pattern search, a local method like optimize, starting at p
+                 *
+                 * Where optimize(bobyqa) runs one simulation at the time, the pattern search polls 2n points around the current
+                 * best in each iteration, for n optimized parameters, and runs them concurrently on the model and its replicas,
+                 * ref. set_concurrent_evaluations, and if there are more replicas than poll points, the polls of the smaller steps too.
+                 * The polls are bounded by the current best, so early termination and surrogate screening apply, as for sceua.
+                 * \param p the start point
+                 * \param max_n_evaluations stop after n calls of the objective functions, i.e. simulations.
+                 * \param tr_start the initial step, in the scaled 0..1 parameter range, default 0.1, like the trust region start of bobyqa
+                 * \param tr_stop stop when the step is below this, default 1e-5
+                 * \return the optimized parameter vector
+                 */
+                vector<double> optimize_pattern_search(const vector<double>& p, size_t max_n_evaluations = 1500, double tr_start = 0.1, double tr_stop = 1.0e-5) {
+                    prepare_optimize();
+                    p_expanded = p;
+                    auto rp = reduce_p_vector(p);
+                    min_pattern_search(*this, rp, max_n_evaluations, tr_start, tr_stop);
+                    return expand_p_vector(rp);
+                }
+
+                /** optimize using the parallel pattern search, returning the new optimized parameter set */
+                PA optimize_pattern_search(const PA& p, size_t max_n_evaluations = 1500, double tr_start = 0.1, double tr_stop = 1.0e-5) {
+                    PA r;
+                    r.set(optimize_pattern_search(p_vector(p), max_n_evaluations, tr_start, tr_stop));
+                    return r;
+                }
+
+                /** \brief optimize in stages, each on a shorter period, or coarser targets, than the next, ending with the full period
+                 *
+                 * Each stage runs the optimizer of its method, ref. calibration_stage, on the stage period and target resolution,
+                 * starting at the result of the previous stage, and sceua and dream are warm started from its trace,
+                 * ref. set_warm_start_from_trace. A few short, cheap stages then take most of the search, the last refines it.
+                 * The targets and p_min, p_max stay as set, and the traces are those of the last stage.
+                 * \param p the start point of the first stage, that uses the warm start set by the user, if any
+                 * \param stages in order, typically with growing period_length, and the last one 0, that is the full period
+                 * \return the result of the last stage
+                 * \throw runtime_error if there are no stages, or a target has no complete period within a stage
+                 */
+                PA optimize_staged(const PA& p, const vector<calibration_stage>& stages) {
+                    if (stages.empty())
+                        throw runtime_error("optimizer::optimize_staged: at least one stage is needed");
+                    const auto all_targets = targets;
+                    const auto user_warm_start = warm_start_p;
+                    auto restore = [&]() {
+                        targets = all_targets;
+                        warm_start_p = user_warm_start;
+                        n_run_steps = 0;
+                    };
+                    PA r = p;
+                    try {
+                        for (size_t s = 0; s < stages.size(); ++s) {
+                            const auto& stage = stages[s];
+                            targets = stage_targets(all_targets, stage);
+                            if (s > 0)
+                                set_warm_start_from_trace(false);// the goal function values of another period, not reused
+                            switch (stage.method) {
+                                case BOBYQA: r = optimize(r, stage.max_n_evaluations); break;
+                                case SCEUA: r = optimize_sceua(r, stage.max_n_evaluations); break;
+                                case DREAM: r = optimize_dream(r, stage.max_n_evaluations); break;
+                                case PATTERN_SEARCH: r = optimize_pattern_search(r, stage.max_n_evaluations); break;
+                            }
+                        }
+                    } catch (...) {
+                        restore();
+                        throw;
+                    }
+                    restore();
+                    return r;
+                }
+
+                /** \brief multi-objective optimization, searching the trade-offs between the targets, ref. pareto_parameters
+                 *
+                 * The goal function of each target, like the nash-sutcliffe of the discharge and the abs-diff of the sca,
+                 * is one objective, all computed from the same run, and the eps-moea optimizer, ref. optimizer::eps_moea,
+                 * keeps the non-dominated parameter sets, at a resolution of epsilon, in an archive.
+                 * The resulting pareto front holds the parameters of any weighting of the targets, found in one optimization.
+                 * The runs are traced with the weighted goal function as usual, and are concurrent, ref. set_concurrent_evaluations.
+                 * \param p the start point, a member of the initial population, the others are random
+                 * \param max_n_evaluations the number of runs
+                 * \param epsilon the resolution of the goal function of each target, or one for all, default 0.01
+                 * \param population_size the size of the population, 0 means 10 times the number of optimized parameters, and at least 20
+                 * \return the size of the pareto front
+                 */
+                size_t optimize_pareto(const PA& p, size_t max_n_evaluations = 1500, const vector<double>& epsilon = vector<double>(), size_t population_size = 0) {
+                    if (targets.empty())
+                        throw runtime_error("optimizer::optimize_pareto: the targets are not set");
+                    vector<double> eps = epsilon.size() ? epsilon : vector<double>{0.01};
+                    if (eps.size() == 1)
+                        eps.resize(targets.size(), eps[0]);
+                    if (eps.size() != targets.size())
+                        throw runtime_error("optimizer::optimize_pareto: there must be one epsilon, or one for each target");
+                    prepare_optimize();
+                    p_expanded = p_vector(p);
+                    auto x0 = to_scaled(reduce_p_vector(p_expanded));
+                    if (population_size == 0)
+                        population_size = std::max(size_t(20), 10*x0.size());
+                    shyft::core::optimizer::eps_moea moea;
+                    auto archive = moea.find_pareto(x0, [this](const vector<vector<double>>& p_s, vector<vector<double>>& fs) { evaluate_target_goal_functions(p_s, fs); },
+                                                    eps, population_size, max_n_evaluations, 1 + replicas.size());
+                    pareto_parameters.clear();
+                    pareto_goal_functions = archive.f();
+                    for (const auto& x : archive.x())
+                        pareto_parameters.push_back(vector_p(expand_p_vector(from_scaled(x))));
+                    return pareto_parameters.size();
+                }
+
                 /**\brief reset the state of the model to the initial state before starting the run/optimize*/
                 void reset_states() {
                     model.revert_to_initial_state();
@@ -601,6 +983,150 @@ namespace shyft {
                 }
 
                 void set_verbose_level(int level) { print_progress_level = level; }
+
+                /** \brief set the number of parameter sets that dream, sceua and the pattern search evaluate concurrently, default 1
+                 *
+                 * With k > 1, prepare_optimize copies the model into k-1 replicas, each with its private cells,
+                 * that is state, parameter and response, and the candidates of the complexes(sceua) or chains(dream)
+                 * are evaluated k at the time, each on its own model, ref. evaluate_batch.
+                 * \note the replicas are full copies of the model, including the cell environment, so memory grows with k.
+                 */
+                void set_concurrent_evaluations(size_t k) { n_concurrent = std::max(size_t(1), k); }
+                size_t concurrency() const { return n_concurrent; }
+
+                /** \brief let dream and sceua evaluate their batches by f, like a calibration_dispatcher to workers on other nodes, k at the time
+                 *
+                 * f is called with the full parameter vector of each candidate, and the number of time-steps to run, 0 means all,
+                 * ref. optimize_staged, and returns the goal function of each, as evaluate_parameter_sets of a prepared replica of this optimizer.
+                 * The traces, the cache and the surrogate screening are kept by this optimizer, as for local evaluations,
+                 * while the early termination bounds are not passed on, so the remote runs are complete runs.
+                 * No local replicas are made, and the single evaluations, like those of bobyqa, and pareto runs are still local.
+                 * The workers use their own targets, so the stages of optimize_staged, other than the time-steps run, are not passed on.
+                 * \param f the remote evaluation, an empty f turns it off
+                 * \param k the number of candidates dream and sceua passes in each batch, typically the total concurrency of the workers
+                 */
+                void set_remote_evaluation(remote_evaluator_t f, size_t k) {
+                    remote_evaluate = std::move(f);
+                    n_concurrent = std::max(size_t(1), k);
+                }
+
+                /** \brief the goal function of each full parameter vector of ps, run concurrency() at the time on the model and its replicas
+                 *
+                 * This is the evaluation a worker does for a remote optimizer, ref. set_remote_evaluation,
+                 * so there is no trace, cache or screening, and prepare_optimize must be done first.
+                 * \param n_steps the number of time-steps to run, 0 means all
+                 */
+                vector<double> evaluate_parameter_sets(const vector<vector<double>>& ps, size_t n_steps = 0) {
+                    const auto n_run_steps_0 = n_run_steps;
+                    n_run_steps = n_steps;
+                    vector<double> fx(ps.size());
+                    try {
+                        const size_t n_models = 1 + replicas.size();
+                        for (size_t j0 = 0; j0 < ps.size(); j0 += n_models)
+                            run_parameter_sets(ps, j0, std::min(n_models, ps.size() - j0), vector<double>(ps.size(), shyft::nan), fx);
+                    } catch (...) {
+                        n_run_steps = n_run_steps_0;
+                        throw;
+                    }
+                    n_run_steps = n_run_steps_0;
+                    return fx;
+                }
+
+                /** \brief let sceua give up on candidates that can not be accepted, evaluating them in n segments, default 0(off)
+                 *
+                 * The sceua reflection and contraction candidates are kept only if better than the worst point of
+                 * the sub-complex. With n > 1, such candidates are run n segments of the time-axis at the time, and
+                 * after each segment, the goal function of the completed target periods, goal_function_lower_bound,
+                 * is compared to the worst point, and the run is stopped as soon as the candidate can not beat it.
+                 * The optimization result is the same as without, only the simulation of hopeless candidates is cut short.
+                 * \note the goal_fn_trace of a stopped candidate holds the bound, not the goal function.
+                 * \note the bound uses the nash-sutcliffe, rmse and abs-diff targets, kling-gupta targets cannot be bounded.
+                 */
+                void set_early_termination(size_t n) { n_segments = n; }
+                size_t early_termination() const { return n_segments; }
+
+                /** \brief let a surrogate of the goal function screen out candidates before they are run, default off
+                 *
+                 * Once the trace holds min_samples evaluations, a cubic rbf surrogate, ref. optimizer::rbf_surrogate,
+                 * is fitted to the latest max_samples of them, in the scaled parameter space, and refitted as the trace grows.
+                 * Then the model is not run for candidates predicted worse than they need to be by more than
+                 * margin x (the range of the fitted goal function values), and the prediction is returned:
+                 *  - sceua: the reflection and contraction candidates, that must beat the worst point of the sub-complex
+                 *  - bobyqa: all candidates, that should beat the best evaluation so far
+                 * The screened candidates are not added to the trace, so the surrogate is fitted to real evaluations only.
+                 * \note unlike set_early_termination, this changes the path of the optimizer, as the surrogate can be wrong.
+                 * \param min_samples traced evaluations before screening starts, 0 turns screening off
+                 * \param margin the fraction of the fitted range a prediction must exceed the bound with
+                 * \param max_samples the max number of evaluations the surrogate is fitted to
+                 */
+                void set_surrogate_screening(size_t min_samples, double margin = 0.1, size_t max_samples = 200) {
+                    screen_min_samples = min_samples;
+                    screen_margin = margin;
+                    screen_max_samples = std::max(size_t(1), max_samples);
+                    surrogate = shyft::core::optimizer::rbf_surrogate();
+                    surrogate_trace_size = 0;
+                }
+                /** \return the number of candidates screened out by the surrogate since prepare_optimize */
+                size_t surrogate_screened() const { return n_screened; }
+
+                /** \brief let the optimizers reuse the goal function of parameter sets already evaluated, default off
+                 *
+                 * The goal function values are kept by the scaled reduced parameters, ref. to_scaled, rounded to
+                 * multiples of resolution, and a candidate with the same key is not run again, nor traced.
+                 * The optimizers revisit points, e.g. sceua candidates clamped at the bounds, or bobyqa steps
+                 * of parameters with a tiny range. The cache is cleared by prepare_optimize, that is for each optimize call.
+                 * \note calculate_goal_function always runs the model, so it leaves the model with the results of the parameters
+                 * \param resolution the quantum of the scaled [0..1] parameters, e.g. 1e-6, 0 turns the cache off
+                 * \param max_size max number of cached values, when full, new values are not cached
+                 */
+                void set_evaluation_cache(double resolution, size_t max_size = 100000) {
+                    if (!(resolution >= 0.0))
+                        throw runtime_error("optimizer::set_evaluation_cache: the resolution must be >= 0");
+                    cache_resolution = resolution;
+                    cache_max_size = max_size;
+                    evaluation_cache.clear();
+                }
+                size_t evaluation_cache_size() const { return evaluation_cache.size(); }
+                /** \return the number of evaluations answered by the cache since prepare_optimize */
+                size_t evaluation_cache_hits() const { return n_cache_hits; }
+                /** \return the number of evaluations not in the cache since prepare_optimize, with the cache on */
+                size_t evaluation_cache_misses() const { return n_cache_misses; }
+
+                /** \brief set a function called with each traced parameter set and goal function value, empty to clear
+                 *
+                 * The callback is called in the thread running the optimize call, after the value is added to the traces,
+                 * and can be used to report progress. An exception thrown by the callback stops the optimization,
+                 * and propagates out of the optimize call, leaving the model with the parameters of the last evaluation.
+                 */
+                void set_trace_callback(std::function<void(const PA&, double)> f) { trace_callback = std::move(f); }
+
+                /** \brief warm start the following optimize_sceua and optimize_dream calls from ps, like an earlier calibration
+                 *
+                 * Up to half of the initial sceua sample, or of the dream chains, then start at the best distinct points of ps,
+                 * ranked by fs when given, and the rest are random as usual. Re-calibrations after small changes, like a
+                 * longer period, then usually converge with far fewer evaluations.
+                 * \param ps parameter sets, e.g. the parameters_trace of an earlier calibration, or a saved copy of it
+                 * \param fs the goal function values of ps, e.g. the goal_fn_trace, empty if unknown
+                 * \param reuse_fs if true, fs are valid for the current model and targets, and the picked points are not run again
+                 * \note with early termination, ref. set_early_termination, the trace can hold lower bounds, do not reuse those
+                 */
+                void set_warm_start(const vector<PA>& ps, const vector<double>& fs = vector<double>(), bool reuse_fs = false) {
+                    if (fs.size() && fs.size() != ps.size())
+                        throw runtime_error("optimizer::set_warm_start: the goal function values must match the parameters");
+                    warm_start_p.x.clear();
+                    for (const auto& p : ps)
+                        warm_start_p.x.push_back(p_vector(p));
+                    warm_start_p.fx = fs;
+                    warm_start_p.reuse_fx = reuse_fs;
+                }
+
+                /** \brief set_warm_start from the current parameters_trace and goal_fn_trace, that the next optimize call clears */
+                void set_warm_start_from_trace(bool reuse_goal_function_values = false) {
+                    set_warm_start(parameters_trace, goal_fn_trace, reuse_goal_function_values);
+                }
+
+                void clear_warm_start() { warm_start_p = shyft::core::optimizer::warm_start(); }
+                size_t warm_start_size() const { return warm_start_p.x.size(); }
                 /**\brief calculate the goal_function as used by minbobyqa,
                  *   using the full set of  parameters vectors (as passed to optimize())
                  *   and also ensures that the shyft state/cell/catchment result is consistent
@@ -620,8 +1146,225 @@ namespace shyft {
 
                 friend class calibration_test;// to enable testing of individual methods
                 /** called by bobyqua: */
-                double operator() (const column_vector& p_s) { return run(from_scaled(p_s)); }
-                double operator() (const vector<double>&p_s) { return run(from_scaled(p_s)); }
+                double operator() (const column_vector& p_s) {
+                    if (screen_min_samples == 0 && cache_resolution == 0.0)
+                        return run(from_scaled(p_s));
+                    vector<double> x;
+                    x.reserve(p_s.nr());
+                    for (int i = 0; i < p_s.nr(); ++i) x.push_back(p_s(i));
+                    double f;
+                    if (cached(x, shyft::nan, f) || screened_out(x, best_goal_function(), f))
+                        return f;
+                    f = run(from_scaled(p_s));
+                    cache(x, shyft::nan, f);
+                    return f;
+                }
+                double operator() (const vector<double>&p_s) {
+                    double f;
+                    if (cached(p_s, shyft::nan, f))
+                        return f;
+                    f = run(from_scaled(p_s));
+                    cache(p_s, shyft::nan, f);
+                    return f;
+                }
+
+                /** called by dream and sceua: evaluate the scaled parameter sets p_s, concurrency() at the time, fx[i] is the goal function of p_s[i]
+                 *
+                 * The traces are updated in the order of p_s.
+                 */
+                void evaluate_batch(const vector<vector<double>>& p_s, vector<double>& fx) {
+                    evaluate_batch_bounded(p_s, vector<double>(p_s.size(), shyft::nan), fx);
+                }
+
+                /** called by sceua: as evaluate_batch, but the runs stop as soon as fx[i] > f_bounds[i] is certain, ref. set_early_termination
+                 *
+                 * A nan bound, or early_termination() < 2, means a complete run.
+                 */
+                void evaluate_batch_bounded(const vector<vector<double>>& p_s, const vector<double>& f_bounds, vector<double>& fx) {
+                    fx.resize(p_s.size());
+                    vector<size_t> run_ix;// the candidates not cached, or screened out by the surrogate
+                    run_ix.reserve(p_s.size());
+                    for (size_t i = 0; i < p_s.size(); ++i)
+                        if (!cached(p_s[i], f_bounds[i], fx[i]) && !screened_out(p_s[i], f_bounds[i], fx[i]))
+                            run_ix.push_back(i);
+                    if (remote_evaluate) {
+                        vector<vector<double>> ps;
+                        ps.reserve(run_ix.size());
+                        for (auto i : run_ix)
+                            ps.push_back(expand_p_vector(from_scaled(p_s[i])));
+                        if (ps.empty())
+                            return;
+                        auto rfx = remote_evaluate(ps, n_run_steps);
+                        if (rfx.size() != ps.size())
+                            throw runtime_error("optimizer: the remote evaluation returned " + to_string(rfx.size()) + " goal functions, expected " + to_string(ps.size()));
+                        for (size_t k = 0; k < ps.size(); ++k) {
+                            fx[run_ix[k]] = rfx[k];
+                            trace(vector_p(ps[k]), rfx[k]);
+                            cache(p_s[run_ix[k]], shyft::nan, rfx[k]);// a complete run, so an exact value
+                        }
+                        return;
+                    }
+                    const size_t n_models = 1 + replicas.size();
+                    if (n_models == 1) {
+                        for (auto i : run_ix) {
+                            fx[i] = run(from_scaled(p_s[i]), f_bounds[i]);
+                            cache(p_s[i], f_bounds[i], fx[i]);
+                        }
+                        return;
+                    }
+                    vector<vector<double>> ps(n_models);// the full parameter vector of each model
+                    vector<double> bounds(n_models), fxs(n_models);
+                    for (size_t j0 = 0; j0 < run_ix.size(); j0 += n_models) {
+                        const size_t n = std::min(n_models, run_ix.size() - j0);
+                        for (size_t k = 0; k < n; ++k) {
+                            ps[k] = expand_p_vector(from_scaled(p_s[run_ix[j0 + k]]));
+                            bounds[k] = f_bounds[run_ix[j0 + k]];
+                        }
+                        run_parameter_sets(ps, 0, n, bounds, fxs);
+                        for (size_t k = 0; k < n; ++k) {
+                            fx[run_ix[j0 + k]] = fxs[k];
+                            trace(vector_p(ps[k]), fxs[k]);
+                            cache(p_s[run_ix[j0 + k]], f_bounds[run_ix[j0 + k]], fxs[k]);
+                        }
+                    }
+                }
+
+                /** \brief run the full parameter vectors ps[j0..j0+n) concurrently, on the model and the replicas, n <= 1 + replicas.size()
+                 * \param f_bounds fx[j] is the goal function, or a bound of it > f_bounds[j], ref. run_bounded
+                 */
+                void run_parameter_sets(const vector<vector<double>>& ps, size_t j0, size_t n, const vector<double>& f_bounds, vector<double>& fx) {
+                    executor::instance()->parallel_for(n, 1, [&](size_t k0, size_t k1) {
+                        for (size_t k = k0; k < k1; ++k) {
+                            region_model_t& m = k == 0 ? model : *replicas[k - 1];
+                            m.get_region_parameter().set(ps[j0 + k]);
+                            m.revert_to_initial_state();
+                            fx[j0 + k] = run_bounded(m, f_bounds[j0 + k]);
+                        }
+                    });
+                }
+
+                /** \brief the targets ts clipped to the stage period, and averaged to the stage resolution, also sets n_run_steps */
+                vector<target_specification_t> stage_targets(const vector<target_specification_t>& ts, const calibration_stage& stage) {
+                    const auto& ta = model.time_axis;
+                    if (ta.size() == 0)
+                        throw runtime_error("optimizer::optimize_staged: the model time-axis is not set");
+                    const utctime t_end = stage.period_length > 0 ? std::min(ta.total_period().end, ta.time(0) + stage.period_length) : ta.total_period().end;
+                    n_run_steps = 0;
+                    if (stage.period_length > 0)
+                        while (n_run_steps < ta.size() && ta.time(n_run_steps) < t_end) ++n_run_steps;
+                    if (stage.period_length == 0 && stage.target_dt == 0)
+                        return ts;
+                    vector<target_specification_t> r;
+                    r.reserve(ts.size());
+                    for (auto t : ts) {
+                        const auto& tta = t.ts.time_axis();
+                        if (tta.size() == 0)
+                            throw runtime_error("optimizer::optimize_staged: empty target time-series");
+                        const utctimespan dt = stage.target_dt > 0 ? stage.target_dt : tta.period(0).timespan();
+                        const utctime t0 = tta.time(0);
+                        const utctime t1 = std::min(t_end, tta.total_period().end);
+                        const size_t n = t1 > t0 ? size_t((t1 - t0)/dt) : 0;
+                        if (n == 0)
+                            throw runtime_error("optimizer::optimize_staged: a target has no complete period within the stage");
+                        t.ts = *ts_transform().to_average<PS, PS>(t0, dt, n, t.ts);
+                        r.push_back(std::move(t));
+                    }
+                    return r;
+                }
+
+                /** \brief run the scaled parameter sets p_s, concurrency() at the time, fs[i] is the target_goal_functions of p_s[i] */
+                void evaluate_target_goal_functions(const vector<vector<double>>& p_s, vector<vector<double>>& fs) {
+                    fs.resize(p_s.size());
+                    const size_t n_models = 1 + replicas.size();
+                    vector<vector<double>> ps(n_models);// the full parameter vector of each model
+                    for (size_t j0 = 0; j0 < p_s.size(); j0 += n_models) {
+                        const size_t n = std::min(n_models, p_s.size() - j0);
+                        for (size_t k = 0; k < n; ++k)
+                            ps[k] = expand_p_vector(from_scaled(p_s[j0 + k]));
+                        executor::instance()->parallel_for(n, 1, [&](size_t k0, size_t k1) {
+                            for (size_t k = k0; k < k1; ++k) {
+                                region_model_t& m = k == 0 ? model : *replicas[k - 1];
+                                m.get_region_parameter().set(ps[k]);
+                                m.revert_to_initial_state();
+                                m.run_cells(0, 0, int(n_run_steps));
+                                fs[j0 + k] = target_goal_functions(m);
+                            }
+                        });
+                        for (size_t k = 0; k < n; ++k)
+                            trace(vector_p(ps[k]), weighted_goal_function(fs[j0 + k]));
+                    }
+                }
+
+                vector<long long> cache_key(const vector<double>& p_s) const {
+                    vector<long long> key;
+                    key.reserve(p_s.size());
+                    for (auto x : p_s) key.push_back(std::llround(x/cache_resolution));
+                    return key;
+                }
+
+                /** \brief true if the cache has the goal function of the scaled p_s, ref. set_evaluation_cache
+                 * \param f_bound as for evaluate_batch_bounded, a cached lower bound is used if it is above f_bound
+                 * \param f set to the cached value, if found
+                 */
+                bool cached(const vector<double>& p_s, double f_bound, double& f) {
+                    if (cache_resolution == 0.0)
+                        return false;
+                    auto c = evaluation_cache.find(cache_key(p_s));
+                    if (c == evaluation_cache.end() || !(c->second.exact || (isfinite(f_bound) && c->second.f > f_bound))) {
+                        ++n_cache_misses;
+                        return false;
+                    }
+                    f = c->second.f;
+                    ++n_cache_hits;
+                    return true;
+                }
+
+                /** \brief keep the goal function f of the scaled p_s, run with f_bound, in the cache */
+                void cache(const vector<double>& p_s, double f_bound, double f) {
+                    if (cache_resolution == 0.0)
+                        return;
+                    const bool exact = n_segments < 2 || !isfinite(f_bound) || !(f > f_bound);// else f can be the bound of a stopped run
+                    auto key = cache_key(p_s);
+                    auto c = evaluation_cache.find(key);
+                    if (c != evaluation_cache.end()) {
+                        if (exact) c->second = cached_goal_function{f, true};
+                    } else if (evaluation_cache.size() < cache_max_size) {
+                        evaluation_cache.emplace(std::move(key), cached_goal_function{f, exact});
+                    }
+                }
+
+                /** \brief true if the surrogate predicts the scaled candidate p_s to be worse than f_bound, by the margin, ref. set_surrogate_screening
+                 * \param f_hat set to the prediction, if screened out
+                 */
+                bool screened_out(const vector<double>& p_s, double f_bound, double& f_hat) {
+                    if (screen_min_samples == 0 || !isfinite(f_bound) || goal_fn_trace.size() < screen_min_samples)
+                        return false;
+                    if (surrogate_trace_size == 0 || goal_fn_trace.size() >= surrogate_trace_size + screen_refit_interval) {
+                        const size_t j0 = goal_fn_trace.size() > screen_max_samples ? goal_fn_trace.size() - screen_max_samples : 0;
+                        vector<vector<double>> xs;
+                        xs.reserve(goal_fn_trace.size() - j0);
+                        for (size_t j = j0; j < goal_fn_trace.size(); ++j)
+                            xs.push_back(to_scaled(reduce_p_vector(p_vector(parameters_trace[j]))));
+                        surrogate.fit(xs, vector<double>(begin(goal_fn_trace) + j0, end(goal_fn_trace)));
+                        surrogate_trace_size = goal_fn_trace.size();
+                    }
+                    if (!surrogate.valid() || surrogate.dimension() != p_s.size())
+                        return false;
+                    const double f = surrogate(p_s);
+                    if (!(f > f_bound + screen_margin*surrogate.range()))
+                        return false;
+                    f_hat = f;
+                    ++n_screened;
+                    return true;
+                }
+
+                /** \return the smallest goal function traced so far, nan if none */
+                double best_goal_function() const {
+                    double f_best = shyft::nan;
+                    for (auto f : goal_fn_trace)
+                        if (isfinite(f) && !(f >= f_best)) f_best = f;
+                    return f_best;
+                }
 
                 /** called by bobyqua:reduced parameter space p */
                 vector<double> to_scaled(const vector<double>& rp) const {
@@ -659,49 +1402,79 @@ namespace shyft {
                 }
             private:
 
-                pts_t compute_discharge_sum(const target_specification_t& t, vector<pts_t>& catchment_d) const {
+                pts_t compute_discharge_sum(region_model_t& m, const target_specification_t& t, vector<pts_t>& catchment_d) const {
                     if (catchment_d.empty())
-                        model.catchment_discharges(catchment_d);
-                    pts_t discharge_sum(model.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+                        m.catchment_discharges(catchment_d);
+                    pts_t discharge_sum(m.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
                     for (auto i : t.catchment_indexes)
-                        discharge_sum.add(catchment_d[model.cix_from_cid(i)]);// important! the catchment_d(ischarge) is in internal index order
+                        discharge_sum.add(catchment_d[m.cix_from_cid(i)]);// important! the catchment_d(ischarge) is in internal index order
                     return discharge_sum;
                 }
-                pts_t compute_charge_sum(const target_specification_t& t, vector<pts_t>& catchment_charges) const {
+                pts_t compute_charge_sum(region_model_t& m, const target_specification_t& t, vector<pts_t>& catchment_charges) const {
                     if (catchment_charges.empty())
-                        model.catchment_charges(catchment_charges);
-                    pts_t charge_sum(model.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+                        m.catchment_charges(catchment_charges);
+                    pts_t charge_sum(m.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
                     for (auto i : t.catchment_indexes)
-                        charge_sum.add(catchment_charges[model.cix_from_cid(i)]);// important! the catchment_charges is in internal index order
+                        charge_sum.add(catchment_charges[m.cix_from_cid(i)]);// important! the catchment_charges is in internal index order
                     return charge_sum;
                 }
 
+                /** \brief the calibration fast path for cells that aggregate to catchments, ref. has_catchment_accumulator
+                 *
+                 * The cells add their responses, and area weighted snow sca and swe, directly to the catchment sums
+                 * while running, so the property of the target is read from the sums of the target catchments,
+                 * with no time-series per cell or catchment, and no extra walk over the cells.
+                 * \return false if the property is not available from the catchment sums, then the usual path is used
+                 */
+                bool accumulated_property(region_model_t& m, const target_specification_t& t, pts_t& r, std::true_type) const {
+                    catchment_accumulator::response_ix ix;
+                    bool area_average = false;
+                    switch (t.catchment_property) {
+                    case DISCHARGE: ix = catchment_accumulator::discharge; break;
+                    case CELL_CHARGE: ix = catchment_accumulator::charge; break;
+                    case SNOW_COVERED_AREA: ix = catchment_accumulator::snow_sca; area_average = true; break;
+                    case SNOW_WATER_EQUIVALENT: ix = catchment_accumulator::snow_swe; area_average = true; break;
+                    default: return false;
+                    }
+                    vector<double> v;
+                    m.add_catchment_sum(t.catchment_indexes, ix, v);
+                    if (area_average) {
+                        double a_sum = 0.0;
+                        for (auto cid : t.catchment_indexes)
+                            a_sum += catchment_area[m.cix_from_cid(cid)];
+                        for (auto& x : v) x /= a_sum;
+                    }
+                    r = pts_t(m.time_axis, std::move(v), shyft::time_series::POINT_AVERAGE_VALUE);
+                    return true;
+                }
+                bool accumulated_property(region_model_t&, const target_specification_t&, pts_t&, std::false_type) const { return false; }
+
                 /** \brief extracts vector of area_ts for all calculated catchments using the
                  * given property function tsf that should have signature pts_t (const cell& c)
                  * \note that this function sum together contributions at cell-level.
                  * TODO: Avoid duplicate code, - use average_catchment_feature(*model.cells, catchment_index, []() return c.rc.snow_sca) but it returns a shared_ptr..
                  */
                 template<class property_ts_function>
-                vector<area_ts> extract_area_ts_property(property_ts_function && tsf) const {
-                    vector<area_ts> r(n_catchments, area_ts(0.0, pts_t(model.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE)));
-                    for (const auto& c : *model.get_cells()) {
-                        if (model.is_calculated_by_catchment_ix(c.geo.catchment_ix)) {
-                            r[c.geo.catchment_ix].ts.add_scale(tsf(c), c.geo.area());//the only ref. to snow_sca
-                            r[c.geo.catchment_ix].area += c.geo.area(); //using entire cell geo area for now.
-                        }
-                    }
+                vector<area_ts> extract_area_ts_property(region_model_t& m, property_ts_function && tsf) const {
+                    vector<area_ts> r(n_catchments, area_ts(0.0, pts_t(m.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE)));
+                    const auto& cells = *m.get_cells();
+                    m.for_each_calculated_cell([&](size_t i) {
+                        const auto& c = cells[i];
+                        r[c.geo.catchment_ix].ts.add_scale(tsf(c), c.geo.area());//the only ref. to snow_sca
+                        r[c.geo.catchment_ix].area += c.geo.area(); //using entire cell geo area for now.
+                    });
                     for (size_t i = 0;i < n_catchments;++i)
-                        if (model.is_calculated_by_catchment_ix(i))
+                        if (m.is_calculated_by_catchment_ix(i))
                             r[i].ts.scale_by(1 / r[i].area);
                     return r;
                 }
                 /** \brief returns the area weighted sum of vector<area_ts> according to t.catchment_indexes
                 */
-                pts_t compute_weighted_area_ts_average(const target_specification_t& t, const vector<area_ts>& ats) const {
-                    pts_t ts_sum(model.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+                pts_t compute_weighted_area_ts_average(region_model_t& m, const target_specification_t& t, const vector<area_ts>& ats) const {
+                    pts_t ts_sum(m.time_axis, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
                     double a_sum = 0.0;
                     for (auto cid : t.catchment_indexes) {
-                        auto i = model.cix_from_cid(cid); // need to get the catchment zero-based index here
+                        auto i = m.cix_from_cid(cid); // need to get the catchment zero-based index here
                         ts_sum.add_scale(ats[i].ts, ats[i].area);
                         a_sum += ats[i].area;
                     }
@@ -712,15 +1485,15 @@ namespace shyft {
 
                 template<class rc_t = response_collector_t> // finally,
                 enable_if_tx<detect_snow_sca<rc_t>::value, pts_t> // use enable_if_t  detect_snow_sca to enable this type
-                    compute_sca_sum(const target_specification_t& t, vector<area_ts>& catchment_sca) const {
+                    compute_sca_sum(region_model_t& m, const target_specification_t& t, vector<area_ts>& catchment_sca) const {
                     if (catchment_sca.empty())
-                        catchment_sca = extract_area_ts_property([](const cell_t&c) {return c.rc.snow_sca;});
-                    return compute_weighted_area_ts_average(t, catchment_sca);
+                        catchment_sca = extract_area_ts_property(m, [](const cell_t&c) {return c.rc.snow_sca;});
+                    return compute_weighted_area_ts_average(m, t, catchment_sca);
                 }
 
                 template<class rc_t = response_collector_t>
                 enable_if_tx<!detect_snow_sca<rc_t>::value, pts_t>
-                    compute_sca_sum(const target_specification_t& t, vector<area_ts>& catchment_d) const {
+                    compute_sca_sum(region_model_t& m, const target_specification_t& t, vector<area_ts>& catchment_d) const {
                     // To support dynamic typing and python: If a cell.rc do not have snow_sca, but we pass in a criteria/target
                     // function that do specify snow_sca, we throw a runtime error.
                     // TODO: verify this in the constructor and throw as early as possible
@@ -730,16 +1503,26 @@ namespace shyft {
 
 
                 template<class rc_t = response_collector_t>
-                enable_if_tx<detect_snow_swe<rc_t>::value, pts_t> compute_swe_sum(const target_specification_t& t, vector<area_ts>& catchment_swe) const {
+                enable_if_tx<detect_snow_swe<rc_t>::value, pts_t> compute_swe_sum(region_model_t& m, const target_specification_t& t, vector<area_ts>& catchment_swe) const {
                     if (catchment_swe.empty())
-                        catchment_swe = extract_area_ts_property([](const cell_t&c) {return c.rc.snow_swe;});
-                    return compute_weighted_area_ts_average(t, catchment_swe);
+                        catchment_swe = extract_area_ts_property(m, [](const cell_t&c) {return c.rc.snow_swe;});
+                    return compute_weighted_area_ts_average(m, t, catchment_swe);
                 }
                 template<class rc_t = response_collector_t>
-                enable_if_tx<!detect_snow_swe<rc_t>::value, pts_t> compute_swe_sum(const target_specification_t& t, vector<area_ts>& catchment_d) const {
+                enable_if_tx<!detect_snow_swe<rc_t>::value, pts_t> compute_swe_sum(region_model_t& m, const target_specification_t& t, vector<area_ts>& catchment_d) const {
                     throw runtime_error("resource collector doesn't have snow_swe");
                 }
 
+                template<class rc_t = response_collector_t>
+                enable_if_tx<!has_catchment_accumulator<rc_t>::value, pts_t> compute_routed_discharge(region_model_t& m, const target_specification_t& t) const {
+                    return *m.river_output_flow_m3s(t.river_id);
+                }
+                template<class rc_t = response_collector_t>
+                enable_if_tx<has_catchment_accumulator<rc_t>::value, pts_t> compute_routed_discharge(region_model_t& m, const target_specification_t& t) const {
+                    // routing convolves the discharge of each cell, that is only summed to catchments by this collector
+                    throw runtime_error("resource collector doesn't have cell discharge for routing");
+                }
+
                 /**\brief from operator(), called by min_bobyqa, for each iteration, so p is bobyqa parameter vector
                 * notice that the function returns the value of the goal function,
                 * as specified by the target specification. The flexibility is rather large:
@@ -747,75 +1530,214 @@ namespace shyft {
                 *  be a KG or NS, for a specified period/resolution.
                 *  E.g. we can specify targets that apply to specific catchments, and specified periods/resolutions.
                 */
-                double run(const vector<double>& rp) {
+                double run(const vector<double>& rp, double f_bound = shyft::nan) {
                     auto p = expand_p_vector(rp);// expand to full vector, then:
                     parameter_accessor.set(p); // Sets global parameters, all cells share a common pointer.
                     reset_states();
-                    model.run_cells();
-                    double goal_function_value = 0.0;// overall goal-function, intially zero
-                    double scale_factor_sum = 0.0; // each target-spec have a weight, -use this to sum up weights
-                    vector<pts_t> catchment_d;
-                    vector<area_ts> catchment_sca, catchment_swe;// "catchment" level simulated discharge,sca,swe
-                    for (const auto& t : targets) {
-                        shyft::time_series::direct_accessor<decltype(t.ts), typename PS::ta_t> target_accessor(t.ts, t.ts.time_axis());
-                        pts_t property_sum;
+                    double goal_function_value = run_bounded(model, f_bound);
+                    trace(parameter_accessor, goal_function_value);
+                    return goal_function_value;
+                }
+
+                /** \brief run the model m from its initial state, and return the goal function, or a bound of it > f_bound, ref. set_early_termination */
+                double run_bounded(region_model_t& m, double f_bound) const {
+                    shyft::core::trace::scope ts("goal_function");// qualified, trace is also a member
+                    const size_t n = n_run_steps > 0 ? n_run_steps : m.time_axis.size();
+                    if (n_segments < 2 || !isfinite(f_bound) || n < 2) {
+                        m.run_cells(0, 0, int(n_run_steps));
+                        return goal_function(m);
+                    }
+                    const size_t n_step = (n + n_segments - 1)/n_segments;
+                    for (size_t i0 = 0; i0 + n_step < n; i0 += n_step) {
+                        m.run_cells(0, int(i0), int(n_step));
+                        const double f_low = goal_function_lower_bound(m, i0 + n_step);
+                        if (f_low > f_bound)
+                            return f_low;
+                    }
+                    const size_t i_last = ((n - 1)/n_step)*n_step;
+                    m.run_cells(0, int(i_last), int(n - i_last));
+                    return goal_function(m);
+                }
+
+                /** \brief the simulated property of the target t, from the results of the model m
+                 * \param catchment_d,catchment_sca,catchment_swe the catchment results, computed on first use, and shared between the targets
+                 */
+                pts_t target_property(region_model_t& m, const target_specification_t& t, vector<pts_t>& catchment_d, vector<area_ts>& catchment_sca, vector<area_ts>& catchment_swe) const {
+                    pts_t property_sum;
+                    if (!accumulated_property(m, t, property_sum, has_catchment_accumulator<response_collector_t>())) {
                         switch (t.catchment_property) {
                         case DISCHARGE:
-                            property_sum = compute_discharge_sum(t, catchment_d);
+                            property_sum = compute_discharge_sum(m, t, catchment_d);
                             break;
                         case SNOW_COVERED_AREA:
-                            property_sum = compute_sca_sum(t, catchment_sca);
+                            property_sum = compute_sca_sum(m, t, catchment_sca);
                             break;
                         case SNOW_WATER_EQUIVALENT:
-                            property_sum = compute_swe_sum(t, catchment_swe);
+                            property_sum = compute_swe_sum(m, t, catchment_swe);
                             break;
                         case ROUTED_DISCHARGE:
-                            property_sum = *model.river_output_flow_m3s(t.river_id);
+                            property_sum = compute_routed_discharge(m, t);
                             break;
                         case CELL_CHARGE:
-                            property_sum = compute_charge_sum(t, catchment_d);
+                            property_sum = compute_charge_sum(m, t, catchment_d);
                         }
-                        shyft::time_series::average_accessor<pts_t, typename PS::ta_t> property_sum_accessor(property_sum, t.ts.time_axis());
+                    }
+                    return property_sum;
+                }
+
+                /** \brief the goal function of the target t, given accessors to the observed and simulated values */
+                template <class TSA1, class TSA2>
+                double target_goal_function(const target_specification_t& t, const TSA1& observed, const TSA2& simulated) const {
+                    if (t.calc_mode == target_spec_calc_type::NASH_SUTCLIFFE)
+                        return nash_sutcliffe_goal_function(observed, simulated);
+                    if (t.calc_mode == target_spec_calc_type::KLING_GUPTA)
+                        // ref. KLING-GUPTA Journal of Hydrology 377 (2009) 80–91, page 83, formula (10):
+                        // a=alpha, b=betha, q =sigma, u=my, s=simulated, o=observed
+                        return /* EDs */ kling_gupta_goal_function<dlib::running_scalar_covariance<double>>(observed, simulated, t.s_r, t.s_a, t.s_b);
+                    if (t.calc_mode == target_spec_calc_type::RMSE)
+                        return rmse_goal_function(observed, simulated);
+                    return abs_diff_sum_goal_function(observed, simulated);
+                }
+
+                /** \return true if the goal function of target j can use target_aligned[j] with the simulated property_sum */
+                template <class TA>
+                bool is_aligned(size_t j, const pts_t& property_sum, const TA& ta) const {
+                    const auto& t = targets[j];
+                    return j < target_aligned.size() && target_aligned[j].size() > 0
+                        && !(t.calc_mode == target_spec_calc_type::ABS_DIFF && t.catchment_property == CELL_CHARGE)// scaled by the max abs simulated
+                        && property_sum.point_interpretation() == shyft::time_series::POINT_AVERAGE_VALUE && property_sum.size() == ta.size();
+                }
+
+                /** \brief the goal function of the targets, evaluated on the results of the model m, that is the model or one of the replicas
+                 *
+                 * After prepare_optimize, the observations are read from the aligned targets, and the simulated values
+                 * are averaged over the target periods using the aligned steps, so each evaluation only reduces contiguous arrays.
+                 */
+                double goal_function(region_model_t& m) const {
+                    return weighted_goal_function(target_goal_functions(m));
+                }
+
+                /** \brief the goal functions of each of the targets, unweighted, evaluated on the results of the model m, ref. goal_function */
+                vector<double> target_goal_functions(region_model_t& m) const {
+                    vector<double> r;
+                    r.reserve(targets.size());
+                    vector<pts_t> catchment_d;
+                    vector<area_ts> catchment_sca, catchment_swe;// "catchment" level simulated discharge,sca,swe
+                    vector<double> sim;
+                    for (size_t j = 0; j < targets.size(); ++j) {
+                        const auto& t = targets[j];
+                        pts_t property_sum = target_property(m, t, catchment_d, catchment_sca, catchment_swe);
                         double partial_goal_function_value;
-                        if (t.calc_mode == target_spec_calc_type::NASH_SUTCLIFFE) {
-                            partial_goal_function_value = nash_sutcliffe_goal_function(target_accessor, property_sum_accessor);
-                        } else if(t.calc_mode == target_spec_calc_type::KLING_GUPTA) {
-                            // ref. KLING-GUPTA Journal of Hydrology 377 (2009) 80–91, page 83, formula (10):
-                            // a=alpha, b=betha, q =sigma, u=my, s=simulated, o=observed
-                            partial_goal_function_value /* EDs */ = kling_gupta_goal_function<dlib::running_scalar_covariance<double>>(target_accessor,
-                                property_sum_accessor,
-                                t.s_r,
-                                t.s_a,
-                                t.s_b);
-                        } else if(t.calc_mode == target_spec_calc_type::RMSE) {
-                            partial_goal_function_value = rmse_goal_function(target_accessor, property_sum_accessor);
+                        if (is_aligned(j, property_sum, m.time_axis)) {
+                            const auto& a = target_aligned[j];
+                            a.simulated(property_sum.v, a.size(), sim);
+                            partial_goal_function_value = target_goal_function(t, values_accessor{a.obs.data(), a.size()}, values_accessor{sim.data(), sim.size()});
                         } else {
-                            if(t.catchment_property == CELL_CHARGE) {
+                            shyft::time_series::direct_accessor<decltype(t.ts), typename PS::ta_t> target_accessor(t.ts, t.ts.time_axis());
+                            shyft::time_series::average_accessor<pts_t, typename PS::ta_t> property_sum_accessor(property_sum, t.ts.time_axis());
+                            if (t.calc_mode == target_spec_calc_type::ABS_DIFF && t.catchment_property == CELL_CHARGE) {
                                 shyft::time_series::max_abs_average_accessor<pts_t, typename PS::ta_t> abs_scale(property_sum, t.ts.time_axis());
                                 partial_goal_function_value = abs_diff_sum_goal_function_scaled(target_accessor,property_sum_accessor,abs_scale);
                             } else {
-                                partial_goal_function_value = abs_diff_sum_goal_function(target_accessor,property_sum_accessor);
+                                partial_goal_function_value = target_goal_function(t, target_accessor, property_sum_accessor);
                             }
                         }
-                        if (isfinite(partial_goal_function_value)) {
+                        r.push_back(partial_goal_function_value);
+                    }
+                    return r;
+                }
+
+                /** \brief the goal function, the scale_factor weighted average of the finite target goal functions g */
+                double weighted_goal_function(const vector<double>& g) const {
+                    double goal_function_value = 0.0;// overall goal-function, intially zero
+                    double scale_factor_sum = 0.0; // each target-spec have a weight, -use this to sum up weights
+                    for (size_t j = 0; j < targets.size(); ++j) {
+                        const auto& t = targets[j];
+                        if (isfinite(g[j])) {
                             scale_factor_sum += t.scale_factor;
-                            goal_function_value += t.scale_factor*partial_goal_function_value;
+                            goal_function_value += t.scale_factor*g[j];
                         } else if (print_progress_level > 0) {
                             cout << "warning: goal-function " << t.catchment_property << ": evaluated as nan" << endl;
                         }
                     }
                     goal_function_value /= scale_factor_sum;
-                    parameters_trace.push_back(parameter_accessor);// save to the parameters_trace
+                    return goal_function_value;
+                }
+
+                /** \brief a lower bound of goal_function(m), using the target periods completed by the first n_done steps of m
+                 *
+                 * The goal functions sum non-negative terms over the target periods, so the terms of the completed periods,
+                 * with the denominators at their largest, bound the final value from below:
+                 *  - nash-sutcliffe: squared errors over the variance of all the observations, once the completed ones vary
+                 *  - rmse: squared errors over the count, scaled by the max of all the observations, if they are all positive
+                 *  - abs-diff: the absolute differences, not scaled
+                 *  - others: 0
+                 * The bound is reduced by a small relative margin, as the summation order differs from goal_function.
+                 */
+                double goal_function_lower_bound(region_model_t& m, size_t n_done) const {
+                    if (target_observed.size() != targets.size() || n_done >= m.time_axis.size())
+                        return 0.0;
+                    const utctime t_done = m.time_axis.time(n_done);
+                    double f_low = 0.0;
+                    double scale_factor_sum = 0.0;
+                    vector<pts_t> catchment_d;
+                    vector<area_ts> catchment_sca, catchment_swe;
+                    vector<double> sim;
+                    for (size_t j = 0; j < targets.size(); ++j) {
+                        const auto& t = targets[j];
+                        const auto& o = target_observed[j];
+                        scale_factor_sum += t.scale_factor;
+                        const bool nse = t.calc_mode == target_spec_calc_type::NASH_SUTCLIFFE && o.ss > 0.0;
+                        const bool rmse = t.calc_mode == target_spec_calc_type::RMSE && o.n > 0 && o.min > 0.0;
+                        const bool abs_diff = t.calc_mode == target_spec_calc_type::ABS_DIFF && t.catchment_property != CELL_CHARGE;
+                        if (!(nse || rmse || abs_diff))
+                            continue;
+                        const auto& a = target_aligned[j];
+                        const size_t n_complete = std::upper_bound(begin(a.end), end(a.end), t_done) - begin(a.end);
+                        if (n_complete == 0)
+                            continue;
+                        pts_t property_sum = target_property(m, t, catchment_d, catchment_sca, catchment_swe);
+                        if (!is_aligned(j, property_sum, m.time_axis))
+                            continue;
+                        a.simulated(property_sum.v, n_complete, sim);
+                        double sum_diff = 0.0, sum_diff2 = 0.0, avg = 0.0, ss = 0.0;
+                        size_t n = 0;
+                        for (size_t i = 0; i < n_complete; ++i) {
+                            const double v_o = a.obs[i];
+                            const double v_m = sim[i];
+                            if (isfinite(v_m)) {
+                                sum_diff += std::fabs(v_o - v_m);
+                                sum_diff2 += (v_o - v_m)*(v_o - v_m);
+                                ++n;
+                                const double d = v_o - avg;
+                                avg += d/double(n);
+                                ss += d*(v_o - avg);
+                            }
+                        }
+                        if (nse && ss > 0.0)// then the final variance is positive too, and the target counts in goal_function
+                            f_low += t.scale_factor*sum_diff2/o.ss;
+                        else if (rmse && n > 0)
+                            f_low += t.scale_factor*sqrt(sum_diff2/double(o.n))/o.max;
+                        else if (abs_diff)
+                            f_low += t.scale_factor*sum_diff;
+                    }
+                    return scale_factor_sum > 0.0 ? (1.0 - 1.0e-9)*f_low/scale_factor_sum : 0.0;
+                }
+
+                /** \brief save the parameters p and the goal function value to the traces */
+                void trace(const PA& p, double goal_function_value) {
+                    parameters_trace.push_back(p);// save to the parameters_trace
                     goal_fn_trace.push_back(goal_function_value);//
                     if (print_progress_level > 0) {
                         cout << goal_function_value <<" : ParameterVector(";
-                        for (size_t i = 0; i < parameter_accessor.size(); ++i) {
-                            cout << parameter_accessor.get(i);
-                            if (i < parameter_accessor.size() - 1) cout << ", ";
+                        for (size_t i = 0; i < p.size(); ++i) {
+                            cout << p.get(i);
+                            if (i < p.size() - 1) cout << ", ";
                         }
                         cout << ")" << endl;
                     }
-                    return goal_function_value;
+                    if (trace_callback)
+                        trace_callback(p, goal_function_value);
                 }
             };
 
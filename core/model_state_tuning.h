@@ -1,5 +1,9 @@
 #pragma once
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include <dlib/optimization.h>
 #include "cell_model.h"
 
@@ -32,12 +36,21 @@ struct adjust_state_model {
 	size_t i0{ 0u };
     adjust_state_model()=delete;
 	state_vector_t  s0;///< the snap-shot of current state when starting the model
-	void revert_to_state_0() { rm.set_states(s0); }
+	std::vector<size_t> calc_ix;///< the cells of cids, the only cells with states changed by the tuning
+	/** restore the state 0 of the calculated cells, the others are not changed by the tuning */
+	void revert_to_state_0() {
+		auto& cells = *rm.get_cells();
+		for (auto i : calc_ix) {
+			cells[i].set_state(s0[i]);
+			rm.mark_state_changed(i);
+		}
+	}
     /**Construct a wrapper around the RM so that we can use multiple tune to flow*/
     adjust_state_model( RM&rm,const std::vector<int> &cids,size_t i0=0
 		) :rm(rm), cids(cids),i0(i0) {
         rm.set_catchment_calculation_filter(cids);// only calc for cells we are working on.
 		rm.get_states(s0);// important: get the state 0 snap-shot from the model as it is now
+		rm.for_each_calculated_cell([this](size_t i) { calc_ix.push_back(i); });
     }
 
     /** calculate the model response discharge, given a specified scale-factor
@@ -92,6 +105,119 @@ struct adjust_state_model {
         return q_result;
     }
 
+    /** \brief the slot of each cell, the index into cids of its catchment, or -1 if not selected */
+    std::vector<int> cell_slots() const {
+        std::unordered_map<int, int> slot_of;
+        for (size_t k = 0; k < cids.size(); ++k)
+            slot_of[cids[k]] = int(k);
+        std::vector<int> r;
+        r.reserve(rm.get_cells()->size());
+        for (const auto& c : *rm.get_cells()) {
+            auto f = slot_of.find(int(c.geo.catchment_id()));
+            r.push_back(f == slot_of.end() ? -1 : f->second);
+        }
+        return r;
+    }
+
+    /** \brief as discharge(q_scale), but with one scale-factor for each catchment of cids, in one run of all the cells
+     * \param q_scale the scale factor to apply to the initial-state of the cells of each catchment, q_scale[k] for cids[k]
+     * \param slots the cell slots, ref. cell_slots()
+     * \return discharge in m3/s for the first time-step, r[k] for catchment cids[k]
+     */
+    std::vector<double> discharges(const std::vector<double>& q_scale, const std::vector<int>& slots) {
+        revert_to_state_0();
+        auto& cells = *rm.get_cells();
+        for (size_t i = 0; i < cells.size(); ++i)
+            if (slots[i] >= 0) {
+                cells[i].state.adjust_q(q_scale[size_t(slots[i])]);
+                rm.mark_state_changed(i);
+            }
+        rm.run_cells(0, i0, 1);// one step for all the catchments
+        std::vector<double> q(cids.size(), 0.0);
+        for (size_t i = 0; i < cells.size(); ++i)
+            if (slots[i] >= 0)
+                q[size_t(slots[i])] += cells[i].rc.avg_discharge.value(i0);
+        return q;
+    }
+
+    /** \brief tune the flow of each catchment of cids to its own target value, all catchments in the same runs
+     *
+     * Like tune_flow, but with one scale factor for each catchment, found by a bracketing secant search (Illinois variant
+     * of regula falsi) run for all catchments together, so each iteration is one run_cells step for the selected cells,
+     * and the cost is proportional to the number of iterations, not catchments times iterations.
+     * The discharge is assumed to increase with the scale, and when the bracket scale_0/scale_range..scale_0*scale_range
+     * does not hold the wanted flow, the end with the closest flow is used.
+     *
+     * \param q_wanted flow in m3/s, q_wanted[k] for catchment cids[k]
+     * \param scale_range (default 3.0) the scale is bounded to scale_0/scale_range .. scale_0*scale_range, scale_0= q_wanted/q(1.0)
+     * \param scale_eps (default 0.001) a catchment is done when the search-bracket is less than scale_0*scale_eps
+     * \param max_iter  (default 300) max number of iterations
+     * \return tuned flow in m3/s achieved, r[k] for catchment cids[k]
+     * \throw runtime_error if cids is empty, or the sizes of q_wanted and cids differ
+     */
+    std::vector<double> tune_flows(const std::vector<double>& q_wanted, double scale_range = 3.0, double scale_eps = 1e-3, size_t max_iter = 300) {
+        const size_t n = cids.size();
+        if (n == 0 || q_wanted.size() != n)
+            throw std::runtime_error("adjust_state_model::tune_flows: need one wanted flow for each of the catchment ids");
+        rm.set_catchment_calculation_filter(cids);
+        const auto slots = cell_slots();
+        const auto q_0 = discharges(std::vector<double>(n, 1.0), slots);
+        std::vector<double> scale(n, 1.0), lo(n), hi(n), f_lo(n), f_hi(n), eps(n);
+        std::vector<int> side(n, 0);// -1 or +1: the end that was moved last, for the Illinois step
+        std::vector<bool> done(n, false);
+        for (size_t k = 0; k < n; ++k) {
+            if (!(q_0[k] > 0.0) || !std::isfinite(q_wanted[k])) {
+                done[k] = true;// nothing to scale, keep the state
+                continue;
+            }
+            const double s0 = q_wanted[k]/q_0[k];
+            lo[k] = s0/scale_range; hi[k] = s0*scale_range; eps[k] = s0*scale_eps;
+        }
+        auto q = discharges(lo, slots);
+        for (size_t k = 0; k < n; ++k) f_lo[k] = q[k] - q_wanted[k];
+        q = discharges(hi, slots);
+        for (size_t k = 0; k < n; ++k) {
+            if (done[k]) continue;
+            f_hi[k] = q[k] - q_wanted[k];
+            if (f_lo[k] >= 0.0 || f_hi[k] <= 0.0) {// not bracketed, or hit at the ends
+                scale[k] = std::fabs(f_lo[k]) < std::fabs(f_hi[k]) ? lo[k] : hi[k];
+                done[k] = true;
+            } else {
+                scale[k] = lo[k] - f_lo[k]*(hi[k] - lo[k])/(f_hi[k] - f_lo[k]);
+            }
+        }
+        for (size_t iter = 0; iter < max_iter && std::find(begin(done), end(done), false) != end(done); ++iter) {
+            q = discharges(scale, slots);
+            for (size_t k = 0; k < n; ++k) {
+                if (done[k]) continue;
+                const double f = q[k] - q_wanted[k];
+                if (f == 0.0) { done[k] = true; continue; }
+                if (f < 0.0) {
+                    lo[k] = scale[k]; f_lo[k] = f;
+                    if (side[k] < 0) f_hi[k] *= 0.5;// the same end moved twice, halve the other
+                    side[k] = -1;
+                } else {
+                    hi[k] = scale[k]; f_hi[k] = f;
+                    if (side[k] > 0) f_lo[k] *= 0.5;
+                    side[k] = +1;
+                }
+                const double s = lo[k] - f_lo[k]*(hi[k] - lo[k])/(f_hi[k] - f_lo[k]);
+                if (hi[k] - lo[k] < eps[k] || std::fabs(s - scale[k]) < 0.5*eps[k])
+                    done[k] = true;
+                scale[k] = s;
+            }
+        }
+        auto q_result = discharges(scale, slots);
+        revert_to_state_0();
+        auto& cells = *rm.get_cells();
+        for (size_t i = 0; i < cells.size(); ++i)
+            if (slots[i] >= 0) {
+                cells[i].state.adjust_q(scale[size_t(slots[i])]);
+                rm.mark_state_changed(i);
+            }
+        return q_result;
+    }
+
 };
 
 }
@@ -23,6 +23,8 @@
 
 #include <vector>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 namespace shyft {
     namespace core {
@@ -35,6 +37,81 @@ namespace shyft {
                     vector<double> xx(x,x+n);
                     return evaluate(xx);
                 }
+                /** \brief evaluate independent parameter sets, fxs[i]=evaluate(xs[i])
+                 *
+                 * The optimizers pass their independent candidates, like one for each sceua complex, or dream chain,
+                 * as one batch, so that implementations able to evaluate concurrently can override this.
+                 */
+                virtual void evaluate_batch(const vector<vector<double>>& xs, vector<double>& fxs) {
+                    fxs.resize(xs.size());
+                    for(size_t i=0;i<xs.size();++i)
+                        fxs[i]=evaluate(xs[i]);
+                }
+                /** \brief evaluate_batch, for callers that only need to know if fxs[i] < f_bounds[i]
+                 *
+                 * Like the sceua reflection and contraction steps, that are accepted only if better than the worst point.
+                 * Implementations can then give up on x[i] as soon as it is certain that f(x[i]) exceeds f_bounds[i],
+                 * and return any value in (f_bounds[i], f(x[i])], otherwise fxs[i]= f(x[i]).
+                 */
+                virtual void evaluate_batch_bounded(const vector<vector<double>>& xs, const vector<double>& f_bounds, vector<double>& fxs) {
+                    evaluate_batch(xs, fxs);
+                }
+                /** \return the number of parameter sets evaluate_batch evaluates concurrently, the optimizers batch up to this size */
+                virtual size_t concurrency() const { return 1; }
+            };
+
+            /** \brief points of a previous search, used to warm start sceua::find_min and dream::find_max
+             *
+             * Typically the parameters_trace and goal_fn_trace of an earlier calibration, converted to the parameter
+             * space and the sense(min or max) of the optimizer.
+             */
+            struct warm_start {
+                vector<vector<double>> x;///< the points, in the parameter space of the optimizer
+                vector<double> fx;///< the previous objective values of x, used to pick the best points, nan or missing if unknown
+                bool reuse_fx=false;///< if true, fx are valid for the current objective, and the picked points are not evaluated again
+
+                /** \brief pick up to n_max distinct points inside [x_min..x_max], the best(largest if maximize) known fx first
+                 *
+                 * Points of wrong dimension are skipped, and so are points closer than min_distance, relative to the range, to
+                 * those already picked, or to the points of taken. That keeps a converged trace from collapsing the
+                 * population. Points outside the range are clamped to it.
+                 * \return the indexes into x of the picked points, in order
+                 */
+                vector<size_t> pick(size_t n, size_t n_max, bool maximize, const double x_min[], const double x_max[],
+                                    const vector<vector<double>>& taken, double min_distance = 1.0e-3) const {
+                    vector<size_t> order;
+                    for (size_t j = 0; j < x.size(); ++j)
+                        if (x[j].size() == n) order.push_back(j);
+                    auto value = [this, maximize](size_t j) {
+                        double f = j < fx.size() ? fx[j] : NAN;
+                        return std::isfinite(f) ? (maximize ? -f : f) : HUGE_VAL;
+                    };
+                    stable_sort(begin(order), end(order), [&value](size_t a, size_t b) { return value(a) < value(b); });
+                    vector<size_t> r;
+                    vector<vector<double>> picked(taken);
+                    for (size_t k = 0; k < order.size() && r.size() < n_max; ++k) {
+                        const auto xj = clamped(x[order[k]], x_min, x_max);
+                        bool distinct = true;
+                        for (const auto& p : picked) {
+                            double d = 0.0;
+                            for (size_t i = 0; i < n; ++i)
+                                d = std::max(d, fabs(p[i] - xj[i])/std::max(x_max[i] - x_min[i], 1.0e-300));
+                            if (d < min_distance) { distinct = false; break; }
+                        }
+                        if (distinct) {
+                            picked.push_back(xj);
+                            r.push_back(order[k]);
+                        }
+                    }
+                    return r;
+                }
+
+                /** \return x clamped to [x_min..x_max] */
+                static vector<double> clamped(vector<double> x, const double x_min[], const double x_max[]) {
+                    for (size_t i = 0; i < x.size(); ++i)
+                        x[i] = std::min(x_max[i], std::max(x_min[i], x[i]));
+                    return x;
+                }
             };
 
             /// \brief  __autoalloc__ uses alloca and typecast to allocate an array on stack,
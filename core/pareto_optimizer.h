@@ -0,0 +1,228 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * Contains the epsilon-dominance pareto archive, and the eps-moea multi-objective optimizer that fills it
+ */
+
+namespace shyft {
+    namespace core {
+        namespace optimizer {
+            using namespace std;
+
+            /** \brief an archive of non-dominated points, by epsilon-box dominance, of a minimization problem
+             *
+             * The objective space is divided into boxes of size eps[i], and the archive keeps at most one point in each box,
+             * and only boxes not dominated by the box of any other point, ref. Laumanns et al. (2002).
+             * So the archive is a pareto front with a resolution of eps, and its size is bounded.
+             * Within a box, a point that dominates the other, or else the one closer to the lower corner of the box, is kept.
+             */
+            class epsilon_archive {
+                vector<double> eps;
+                vector<vector<double>> xs;
+                vector<vector<double>> fs;
+
+                vector<long long> box(const vector<double>& f) const {
+                    vector<long long> b(f.size());
+                    for (size_t i = 0; i < f.size(); ++i) b[i] = (long long)std::floor(f[i]/eps[i]);
+                    return b;
+                }
+                static bool box_dominates(const vector<long long>& a, const vector<long long>& b) {
+                    bool better = false;
+                    for (size_t i = 0; i < a.size(); ++i) {
+                        if (a[i] > b[i]) return false;
+                        if (a[i] < b[i]) better = true;
+                    }
+                    return better;
+                }
+                double corner_distance(const vector<double>& f, const vector<long long>& b) const {
+                    double s = 0.0;
+                    for (size_t i = 0; i < f.size(); ++i) {
+                        const double d = f[i] - double(b[i])*eps[i];
+                        s += d*d;
+                    }
+                    return s;
+                }
+
+            public:
+                epsilon_archive() {}
+                /** \param eps the box size of each objective, all > 0 */
+                explicit epsilon_archive(const vector<double>& eps) : eps(eps) {
+                    for (auto e : eps)
+                        if (!(e > 0.0))
+                            throw runtime_error("epsilon_archive: eps must be > 0");
+                }
+
+                /** \return true if f dominates g, that is no objective is worse, and one is better */
+                static bool dominates(const vector<double>& f, const vector<double>& g) {
+                    bool better = false;
+                    for (size_t i = 0; i < f.size(); ++i) {
+                        if (f[i] > g[i]) return false;
+                        if (f[i] < g[i]) better = true;
+                    }
+                    return better;
+                }
+
+                /** \brief add the point x with objectives f, if it is not epsilon-dominated by the archive
+                 * \return true if x is added, points of the archive it dominates are then removed
+                 */
+                bool add(const vector<double>& x, const vector<double>& f) {
+                    if (f.size() != eps.size())
+                        throw runtime_error("epsilon_archive: the number of objectives must match eps");
+                    for (auto v : f)
+                        if (!std::isfinite(v)) return false;
+                    const auto b = box(f);
+                    for (size_t k = 0; k < fs.size(); ++k) {
+                        const auto bk = box(fs[k]);
+                        if (box_dominates(bk, b))
+                            return false;
+                        if (bk == b) {// one point a box
+                            if (dominates(fs[k], f) || (!dominates(f, fs[k]) && corner_distance(fs[k], b) <= corner_distance(f, b)))
+                                return false;
+                            xs[k] = x;
+                            fs[k] = f;
+                            return true;
+                        }
+                    }
+                    size_t j = 0;
+                    for (size_t k = 0; k < fs.size(); ++k) {
+                        if (!box_dominates(b, box(fs[k]))) {
+                            if (j != k) {
+                                xs[j] = std::move(xs[k]);
+                                fs[j] = std::move(fs[k]);
+                            }
+                            ++j;
+                        }
+                    }
+                    xs.resize(j);
+                    fs.resize(j);
+                    xs.push_back(x);
+                    fs.push_back(f);
+                    return true;
+                }
+
+                size_t size() const { return xs.size(); }
+                const vector<vector<double>>& x() const { return xs; }
+                const vector<vector<double>>& f() const { return fs; }
+            };
+
+            /** \brief eps-moea, the steady state epsilon-dominance multi-objective evolutionary algorithm of Deb et al. (2005)
+             *
+             * A population, and an epsilon_archive, of points in the scaled [0..1] parameter space.
+             * Each offspring is the sbx crossover, and polynomial mutation, of a population member, picked by a
+             * dominance tournament, and an archive member. It replaces a population member it dominates, or a random one
+             * if neither dominates, and is added to the archive. The offspring are made and evaluated batch_size at the time,
+             * so the evaluation of a batch can be concurrent.
+             */
+            class eps_moea {
+                mutable std::mt19937 generator;
+                double random01() const { return uniform_real_distribution<double>(0.0, 1.0)(generator); }
+                size_t random_index(size_t n) const { return uniform_int_distribution<size_t>(0, n - 1)(generator); }
+
+                static vector<double> worst_if_nan(vector<double> f) {
+                    for (auto& v : f)
+                        if (!std::isfinite(v)) v = numeric_limits<double>::infinity();
+                    return f;
+                }
+
+                vector<double> offspring(const vector<double>& a, const vector<double>& b) const {
+                    const double eta_c = 15.0, eta_m = 20.0;
+                    const size_t n = a.size();
+                    const bool first = random01() < 0.5;
+                    vector<double> c(n);
+                    for (size_t i = 0; i < n; ++i) {// sbx crossover
+                        c[i] = first ? a[i] : b[i];
+                        if (random01() < 0.5 && std::fabs(a[i] - b[i]) > 1e-14) {
+                            const double u = random01();
+                            const double beta = u <= 0.5 ? std::pow(2.0*u, 1.0/(eta_c + 1.0)) : std::pow(1.0/(2.0*(1.0 - u)), 1.0/(eta_c + 1.0));
+                            c[i] = first ? 0.5*((1.0 + beta)*a[i] + (1.0 - beta)*b[i]) : 0.5*((1.0 - beta)*a[i] + (1.0 + beta)*b[i]);
+                        }
+                    }
+                    for (size_t i = 0; i < n; ++i) {// polynomial mutation
+                        if (random01() < 1.0/double(n)) {
+                            const double u = random01();
+                            c[i] += u < 0.5 ? std::pow(2.0*u, 1.0/(eta_m + 1.0)) - 1.0 : 1.0 - std::pow(2.0*(1.0 - u), 1.0/(eta_m + 1.0));
+                        }
+                        c[i] = std::min(1.0, std::max(0.0, c[i]));
+                    }
+                    return c;
+                }
+
+            public:
+                explicit eps_moea(unsigned seed = 5489u) : generator(seed) {}
+
+                /** \brief search the pareto front of fx
+                 * \param x0 the start point, scaled to [0..1], it is a member of the initial population, the rest are random
+                 * \param fx the objectives, called as fx(xs, fs), with fs[k] the objectives of xs[k]
+                 * \param eps the resolution of the front, ref. epsilon_archive, one for each objective
+                 * \param population_size the size of the population, at least 2
+                 * \param max_n_evaluations the number of points evaluated, including the initial population
+                 * \param batch_size the number of offspring evaluated in each call of fx
+                 * \return the archive, the pareto front
+                 */
+                template <class FX>
+                epsilon_archive find_pareto(const vector<double>& x0, FX&& fx, const vector<double>& eps,
+                                            size_t population_size, size_t max_n_evaluations, size_t batch_size = 1) const {
+                    if (x0.empty())
+                        throw runtime_error("eps_moea: no parameters to optimize");
+                    population_size = std::max(size_t(2), population_size);
+                    batch_size = std::max(size_t(1), batch_size);
+                    const size_t n = x0.size();
+                    epsilon_archive archive(eps);
+                    vector<vector<double>> pop_x, pop_f;
+                    vector<vector<double>> xs, fs;
+                    while (pop_x.size() < population_size && pop_x.size() < max_n_evaluations) {
+                        xs.clear();
+                        const size_t m = std::min(batch_size, std::min(population_size, max_n_evaluations) - pop_x.size());
+                        for (size_t k = 0; k < m; ++k) {
+                            vector<double> x(n);
+                            for (size_t i = 0; i < n; ++i) x[i] = pop_x.empty() && k == 0 ? std::min(1.0, std::max(0.0, x0[i])) : random01();
+                            xs.push_back(std::move(x));
+                        }
+                        fx(xs, fs);
+                        for (size_t k = 0; k < m; ++k) {
+                            archive.add(xs[k], fs[k]);
+                            pop_x.push_back(xs[k]);
+                            pop_f.push_back(worst_if_nan(fs[k]));
+                        }
+                    }
+                    for (size_t n_evaluations = pop_x.size(); n_evaluations < max_n_evaluations;) {
+                        const size_t m = std::min(batch_size, max_n_evaluations - n_evaluations);
+                        xs.clear();
+                        for (size_t k = 0; k < m; ++k) {
+                            size_t a = random_index(pop_x.size()), a2 = random_index(pop_x.size());// dominance tournament
+                            if (epsilon_archive::dominates(pop_f[a2], pop_f[a]) || (!epsilon_archive::dominates(pop_f[a], pop_f[a2]) && random01() < 0.5))
+                                a = a2;
+                            const auto& b = archive.size() ? archive.x()[random_index(archive.size())] : pop_x[random_index(pop_x.size())];
+                            xs.push_back(offspring(pop_x[a], b));
+                        }
+                        fx(xs, fs);
+                        n_evaluations += m;
+                        for (size_t k = 0; k < m; ++k) {
+                            const auto f = worst_if_nan(fs[k]);
+                            vector<size_t> dominated;
+                            bool is_dominated = false;
+                            for (size_t j = 0; j < pop_f.size(); ++j) {
+                                if (epsilon_archive::dominates(f, pop_f[j])) dominated.push_back(j);
+                                else if (epsilon_archive::dominates(pop_f[j], f)) is_dominated = true;
+                            }
+                            if (dominated.size() || !is_dominated) {
+                                const size_t j = dominated.size() ? dominated[random_index(dominated.size())] : random_index(pop_x.size());
+                                pop_x[j] = xs[k];
+                                pop_f[j] = f;
+                            }
+                            archive.add(xs[k], fs[k]);
+                        }
+                    }
+                    return archive;
+                }
+            };
+        }
+    }
+}
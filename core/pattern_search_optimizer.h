@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "optimizer_utils.h"
+
+/**
+ * Contains the parallel pattern search, a bound constrained local optimizer that polls many points at the time
+ */
+
+namespace shyft {
+    namespace core {
+        namespace optimizer {
+            using namespace std;
+
+            /** \brief a bound constrained local minimizer on [0..1]^n, that evaluates the poll points of each iteration as one batch
+             *
+             * A coordinate pattern search, ref. Kolda, Lewis and Torczon (2003), "Optimization by direct search":
+             * each iteration polls x +/- step along each axis, and moves to the best poll point if it improves f(x),
+             * otherwise the step is halved, until it is below step_stop. After a move, the pattern point x + the move
+             * is polled as well, so the search accelerates along a valley.
+             *
+             * Unlike bobyqa, that asks for one point at the time, the 2n poll points are independent, and passed to
+             * ifx::evaluate_batch_bounded together, with f(x) as the bound, so a model with concurrency k runs k at the time,
+             * and can give up early on points that can not improve f(x). When k exceeds the poll, the polls of the halved
+             * steps are added to the batch, so the evaluations that would otherwise be idle do the contractions ahead.
+             * The path of the search then depends on k, while for a given k it is deterministic.
+             */
+            class pattern_search {
+            public:
+                size_t n_evaluations = 0;///< the number of points evaluated by the last find_min
+                size_t n_iterations = 0;///< the number of batches of the last find_min
+
+                /** \brief find x in [0..1]^n that minimizes fx
+                 * \param fx the function, called with the poll of each iteration as one batch, sized by fx.concurrency()
+                 * \param x the start point, scaled to [0..1], set to the best point found on return
+                 * \param max_n_evaluations stop when this number of points are evaluated
+                 * \param step_start the initial step, like the initial trust region radius of bobyqa
+                 * \param step_stop stop when the step is below this, like the stopping trust region radius of bobyqa
+                 * \return f(x), the best value found
+                 * \throw runtime_error if the steps are not > 0
+                 */
+                double find_min(ifx& fx, vector<double>& x, size_t max_n_evaluations, double step_start = 0.1, double step_stop = 1.0e-5) {
+                    if (!(step_start > 0.0) || !(step_stop > 0.0))
+                        throw runtime_error("pattern_search: the steps must be > 0");
+                    const size_t n = x.size();
+                    const size_t k = std::max(size_t(1), fx.concurrency());
+                    for (auto& v : x) v = clamp01(v);
+                    n_evaluations = n_iterations = 0;
+                    double f_x = numeric_limits<double>::quiet_NaN();
+                    bool evaluated = false;// f(x) is known
+                    vector<double> d(n, 0.0);// the last move
+                    double step = step_start;
+                    vector<vector<double>> xs;
+                    vector<double> steps, bounds, fxs;// the step of each poll point, the bound passed with it, and the results
+                    auto add = [&](vector<double>&& y, double s) {
+                        for (auto& v : y) v = clamp01(v);
+                        if (y == x || std::find(xs.begin(), xs.end(), y) != xs.end())
+                            return;
+                        xs.push_back(std::move(y));
+                        steps.push_back(s);
+                    };
+                    while (step >= step_stop && n_evaluations < max_n_evaluations && n > 0) {
+                        xs.clear(); steps.clear();
+                        if (!evaluated) {
+                            xs.push_back(x);
+                            steps.push_back(step);
+                        }
+                        if (std::any_of(d.begin(), d.end(), [](double v) { return v != 0.0; })) {
+                            auto y = x;
+                            for (size_t i = 0; i < n; ++i) y[i] += d[i];
+                            add(std::move(y), step);
+                        }
+                        double s = step, s_last = step;
+                        do {
+                            for (size_t i = 0; i < n; ++i) {
+                                for (double sign : {1.0, -1.0}) {
+                                    auto y = x;
+                                    y[i] += sign*s;
+                                    add(std::move(y), s);
+                                }
+                            }
+                            s_last = s;
+                            s *= 0.5;
+                        } while (s >= step_stop && xs.size() + 2*n <= k);
+                        if (xs.size() > max_n_evaluations - n_evaluations) {
+                            xs.resize(max_n_evaluations - n_evaluations);
+                            steps.resize(xs.size());
+                        }
+                        bounds.assign(xs.size(), evaluated ? f_x : numeric_limits<double>::quiet_NaN());
+                        fx.evaluate_batch_bounded(xs, bounds, fxs);
+                        n_evaluations += xs.size();
+                        ++n_iterations;
+                        size_t j0 = 0;
+                        if (!evaluated) {
+                            f_x = fxs[0];
+                            evaluated = true;
+                            j0 = 1;
+                        }
+                        size_t best = xs.size();
+                        for (size_t j = j0; j < xs.size(); ++j)
+                            if (fxs[j] < f_x || (std::isnan(f_x) && !std::isnan(fxs[j])))
+                                f_x = fxs[best = j];
+                        if (best < xs.size()) {
+                            for (size_t i = 0; i < n; ++i) d[i] = xs[best][i] - x[i];
+                            x = xs[best];
+                            step = steps[best];
+                        } else {
+                            std::fill(d.begin(), d.end(), 0.0);
+                            step = s_last*0.5;
+                        }
+                    }
+                    return f_x;
+                }
+            private:
+                static double clamp01(double v) { return std::min(1.0, std::max(0.0, v)); }
+            };
+        }
+    }
+}
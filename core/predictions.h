@@ -6,11 +6,13 @@
 #include <algorithm>
 #include <utility>
 #include <limits>
+#include <stdexcept>
 #include <dlib/svm.h>
 
 
 #include "time_axis.h"
 #include "time_series.h"
+#include "thread_pool.h"
 
 namespace shyft {
 namespace prediction {
@@ -35,6 +37,7 @@ private:
     core::utctimespan _dt;
     dlib::krls<dlib::radial_basis_kernel<dlib::matrix<double, 1, 1>>> _krls = dlib::krls<kernel_type>{ kernel_type{} };
     ts::ts_point_fx train_point_fx=ts::ts_point_fx::POINT_AVERAGE_VALUE;
+    static constexpr std::size_t predict_chunk_size = 256u;///< points of predict_vec for each task
 public:  // con-/de-struction, move & copy
     krls_rbf_predictor() = default;
     // -----
@@ -96,32 +99,33 @@ public:
         const std::size_t iterations = 1u,
         const scalar_type mse_tol = 0.001
     ) {
-        std::size_t nan_count;
         scalar_type diff_v, mse = 0.;
         std::size_t dim = std::min(offset + count*stride, ts.size());
         krls_sample_type x;
         const scalar_type scaling_f = 1./_dt;  // compute time scaling factor
         train_point_fx = ts.point_interpretation();
+        // the samples are read once, not for each iteration, since ts.value(i) of an expression can be costly
+        std::vector<std::pair<scalar_type, scalar_type>> samples;
+        samples.reserve(offset < dim ? (dim - offset + stride - 1)/stride : 0u);
+        std::size_t nan_count = 0u;
+        for ( std::size_t i = offset; i < dim; i += stride ) {
+            const scalar_type pv = ts.value(i);
+            if ( ! std::isnan(pv) ) {
+                samples.emplace_back(static_cast<scalar_type>(ts.time(i)*scaling_f), pv);  // NB: utctime -> double conversion !!!
+            } else {
+                nan_count += 1;
+            }
+        }
         // training iteration
-        core::utctime tp;
-        scalar_type pv;
         std::size_t iter_count = 0u;
         while ( iter_count++ < iterations ) {
             mse = 0.;
-            nan_count = 0u;
-            for ( std::size_t i = offset; i < dim; i += stride ) {
-                tp = ts.time(i);
-                pv = ts.value(i);
+            for ( const auto & s : samples ) {
+                x(0) = s.first;
+                _krls.train(x, s.second);
 
-                if ( ! std::isnan(pv) ) {
-                    x(0) = static_cast<scalar_type>(tp*scaling_f);  // NB: utctime -> double conversion !!!
-                    _krls.train(x, pv);
-
-                    diff_v = pv - _krls(x);
-                    mse += diff_v * diff_v;
-                } else {
-                    nan_count += 1;
-                }
+                diff_v = s.second - _krls(x);
+                mse += diff_v * diff_v;
             }
 
             mse /= std::max(static_cast<scalar_type>(dim - nan_count), 1.);
@@ -131,6 +135,38 @@ public:
         }
         return mse;
     }
+    /** \brief Train each of the predictors on the corresponding series of tsv, in parallel, ref. train.
+     *
+     * The predictors are independent, so this is used to train the predictors of many series at once,
+     * e.g. when gap-filling a set of sensor series.
+     *
+     * \tparam TSV  A vector like type of series, each supporting the requirements of train.
+     *
+     * \param predictors   The predictors to train, one for each series of tsv.
+     * \param tsv          The series to train on.
+     * \param max_threads  Max threads to use, 0 means all of the shared executor.
+     * \return  The mse of each predictor, as returned by train.
+     */
+    template < typename TSV >
+    static std::vector<scalar_type> train_batch(
+        std::vector<krls_rbf_predictor> & predictors,
+        const TSV & tsv,
+        const std::size_t offset = 0u,
+        const std::size_t count = std::numeric_limits<std::size_t>::max(),
+        const std::size_t stride = 1u,
+        const std::size_t iterations = 1u,
+        const scalar_type mse_tol = 0.001,
+        const std::size_t max_threads = 0u
+    ) {
+        if ( predictors.size() != tsv.size() )
+            throw std::runtime_error("krls_rbf_predictor::train_batch: the number of predictors and series differ");
+        std::vector<scalar_type> mse(tsv.size(), 0.);
+        core::executor::instance()->parallel_for(tsv.size(), 1u, [&](std::size_t i0, std::size_t i1) {
+            for ( std::size_t i = i0; i < i1; ++i )
+                mse[i] = predictors[i].train(tsv[i], offset, count, stride, iterations, mse_tol);
+        }, max_threads);
+        return mse;
+    }
     /** \brief Given a time-axis generate a point_ts prediction.
     *
     * \tparam TA  Time-axis type. Must at least support:
@@ -139,21 +175,24 @@ public:
     *    * `TA::time(std::size_t )` to get the i'th time-point.
     *
     * \param ta  Time-axis with time-points to predict values at.
+    * \param max_threads  Max threads to use, 0 means all of the shared executor.
     * \return    A vector with predicted values. Is of equal leght as ta.
     */
     template < typename TA >
     std::vector<scalar_type> predict_vec(
-        const TA & ta
+        const TA & ta,
+        const std::size_t max_threads = 0u
     ) const {
-        std::vector<scalar_type> predictions;
-        predictions.reserve(ta.size());
+        std::vector<scalar_type> predictions(ta.size());
         const scalar_type scaling_f = 1./_dt;  // compute time scaling factor
-
-        krls_sample_type x_sample;
-        for ( std::size_t i = 0, dim = ta.size(); i < dim; ++i ) {
-            x_sample(0) = static_cast<scalar_type>(ta.time(i)*scaling_f);  // NB: utctime -> double conversion !!!
-            predictions.emplace_back(_krls(x_sample));
-        }
+        // each prediction is a sum over the dictionary, and the evaluation is read-only, so the points are done in parallel
+        core::executor::instance()->parallel_for(ta.size(), predict_chunk_size, [&](std::size_t i0, std::size_t i1) {
+            krls_sample_type x_sample;
+            for ( std::size_t i = i0; i < i1; ++i ) {
+                x_sample(0) = static_cast<scalar_type>(ta.time(i)*scaling_f);  // NB: utctime -> double conversion !!!
+                predictions[i] = _krls(x_sample);
+            }
+        }, max_threads);
 
         return predictions;
     }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
 
 
 namespace shyft {
@@ -71,16 +72,36 @@ namespace shyft {
 				 *
 				 */
 				double potential_evapotranspiration(double temperature, double global_radiation, double rhumidity) const {
-					int i = temperature < 0 ? 0 : 1;  //select negative or positive set of ck[] constants
-					double ctt_inv = 1 / (ck3[i] + temperature);
-					double sat_pressure = ck1*exp(ck2[i] * temperature*ctt_inv);
-					double delta = sat_pressure*ck2[i] * ck3[i] * ctt_inv*ctt_inv;
+					const bool negative = temperature < 0;  //select negative or positive set of ck[] constants
+					const double c2 = negative ? ck2[0] : ck2[1];
+					const double c3 = negative ? ck3[0] : ck3[1];
+					double ctt_inv = 1 / (c3 + temperature);
+					double sat_pressure = ck1*exp(c2 * temperature*ctt_inv);
+					double delta = sat_pressure*c2 * c3 * ctt_inv*ctt_inv;
 					double vapour_pressure = sat_pressure*rhumidity;// actual vapour pressure,[kPa]
 
 					double epot = alpha*delta*net_radiation(temperature, global_radiation, rhumidity, vapour_pressure) / (delta + psycr);// main P-T equation
-					if (epot < 0.0) return 0.0;
-					return epot /
-						(2500780 - 2361 * temperature); // Latent heat of vaporisation [J/kg], Energy required per water volume vaporized
+					return epot < 0.0 ? 0.0 :
+						epot / (2500780 - 2361 * temperature); // Latent heat of vaporisation [J/kg], Energy required per water volume vaporized
+				}
+
+				/** \brief Calculate PotentialEvapotranspiration for n cells, given specified parameters
+				 *
+				 * The batch version for the timestep-major execution, where the inputs of one time-step
+				 * are stored contiguous for the cells sharing this calculator.
+				 * The loop body is branch-free, so the compiler can vectorize it, and the results are
+				 * identical to the scalar potential_evapotranspiration.
+				 *
+				 * \param temperature in [degC], n values
+				 * \param global_radiation [W/m^2], n values
+				 * \param rhumidity in interval [0,1], n values
+				 * \param pot_evapotranspiration output, n values in [mm/s] units
+				 * \param n number of cells
+				 */
+				void potential_evapotranspiration_batch(const double* temperature, const double* global_radiation, const double* rhumidity,
+												  double* pot_evapotranspiration, size_t n) const {
+					for (size_t i = 0; i < n; ++i)
+						pot_evapotranspiration[i] = potential_evapotranspiration(temperature[i], global_radiation[i], rhumidity[i]);
 				}
 			private:
 				/** \brief calculate net radiation (long +short) given specfied parameters
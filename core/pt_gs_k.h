@@ -16,6 +16,9 @@
 #include "glacier_melt.h"
 #include "unit_conversion.h"
 #include "routing.h"
+#include "time_axis.h"
+#include "cell_state_soa.h"
+#include "method_stack.h"
 namespace shyft {
   namespace core {
     namespace pt_gs_k {
@@ -206,6 +209,29 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief structure of arrays storage for pt_gs_k::state, ref. state_soa_base
+         *
+         * The fields are ordered gs.albedo, gs.lwc, gs.surface_heat, gs.alpha, gs.sdc_melt_mean,
+         * gs.acc_melt, gs.iso_pot_energy, gs.temp_swe, kirchner.q
+         */
+        struct state_soa:state_soa_base<state_soa, state, 9> {
+            static void pack(const state& s, double* v) {
+                v[0] = s.gs.albedo; v[1] = s.gs.lwc; v[2] = s.gs.surface_heat; v[3] = s.gs.alpha;
+                v[4] = s.gs.sdc_melt_mean; v[5] = s.gs.acc_melt; v[6] = s.gs.iso_pot_energy; v[7] = s.gs.temp_swe;
+                v[8] = s.kirchner.q;
+            }
+            static void unpack(const double* v, state& s) {
+                s.gs.albedo = v[0]; s.gs.lwc = v[1]; s.gs.surface_heat = v[2]; s.gs.alpha = v[3];
+                s.gs.sdc_melt_mean = v[4]; s.gs.acc_melt = v[5]; s.gs.iso_pot_energy = v[6]; s.gs.temp_swe = v[7];
+                s.kirchner.q = v[8];
+            }
+            /** \return the names of the fields, in order */
+            static std::vector<std::string> field_names() { return { "gs.albedo", "gs.lwc", "gs.surface_heat", "gs.alpha", "gs.sdc_melt_mean", "gs.acc_melt", "gs.iso_pot_energy", "gs.temp_swe", "kirchner.q" }; }
+            std::vector<double>& gs_acc_melt() { return f[5]; }
+            std::vector<double>& gs_temp_swe() { return f[7]; }
+            std::vector<double>& q() { return f[8]; }
+        };
+
 
         /** \brief Simple response struct for the PTGSK method stack
          *
@@ -227,6 +253,120 @@ namespace shyft {
             double charge_m3s;
         };
 
+        /** \brief stepper for the PTGSK method stack, keeps the calculators and cell constants for one cell
+         *
+         * The stepper allows the method stack to be advanced one time-step at the time, so that
+         * a batch of cells can be run timestep-major (all cells step i, then all cells step i+1),
+         * as well as the ordinary cell-major run_pt_gs_k below, that is implemented using this class.
+         * Both execution orders thus gives identical results.
+         *
+         * \note the stepper keeps references to parameter, time_axis and input time-series, and
+         *  it is not copyable (the kirchner calculator keeps internal references), so keep it in place, or by pointer.
+         * \sa run_pt_gs_k for a description of the template parameters
+         */
+        template<template <typename, typename> class A, class R, class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T,
+        class S, class GCD, class P, template <class> class KAC = kirchner::trapezoidal_average>
+        struct stepper {
+            // Access time series input data through accessors of template A (typically a direct accessor).
+            A<T_TS, T> temp_accessor;
+            A<P_TS, T> prec_accessor;
+            A<WS_TS, T> wind_speed_accessor;
+            A<RH_TS, T> rel_hum_accessor;
+            A<RAD_TS, T> rad_accessor;
+            const P& parameter;
+            const T& time_axis;
+            shared_ptr<const shyft::time_axis::calendar_terms> cal_terms;///< day of year etc. of the time-axis, shared by all cells of the run
+            // the method stack
+            precipitation_correction::calculator p_corr;
+            priestley_taylor::calculator pt;
+            gamma_snow::calculator<typename P::gs_parameter_t, typename S::gs_state_t, typename R::gs_response_t> gs;
+            kirchner::calculator<KAC, typename P::kirchner_parameter_t> kirchner;
+            R response;
+            // cell constants
+            const double forest_fraction;
+            const double glacier_fraction;
+            const double gm_direct; //glacier melt directly out of cell
+            const double gm_routed; // glacier melt routed through kirchner
+            const double direct_response_fraction;// only direct response on reservoirs
+            const double kirchner_fraction;
+            const double cell_area_m2;
+            const double glacier_area_m2;
+            const double altitude;
+
+            stepper(const GCD& geo_cell_data, const P& parameter, const T& time_axis,
+                const T_TS& temp, const P_TS& prec, const WS_TS& wind_speed, const RH_TS& rel_hum, const RAD_TS& rad)
+                : temp_accessor(temp, time_axis), prec_accessor(prec, time_axis), wind_speed_accessor(wind_speed, time_axis),
+                  rel_hum_accessor(rel_hum, time_axis), rad_accessor(rad, time_axis),
+                  parameter(parameter), time_axis(time_axis), cal_terms(shyft::time_axis::calendar_terms::shared(time_axis)),
+                  p_corr(parameter.p_corr.scale_factor), pt(parameter.pt.albedo, parameter.pt.alpha), kirchner(parameter.kirchner),
+                  forest_fraction(geo_cell_data.land_type_fractions_info().forest()),
+                  glacier_fraction(geo_cell_data.land_type_fractions_info().glacier()),
+                  gm_direct(parameter.gm.direct_response),
+                  gm_routed(1 - gm_direct),
+                  direct_response_fraction(glacier_fraction*gm_direct + geo_cell_data.land_type_fractions_info().reservoir()),
+                  kirchner_fraction(1 - direct_response_fraction),
+                  cell_area_m2(geo_cell_data.area()),
+                  glacier_area_m2(geo_cell_data.area()*glacier_fraction),
+                  altitude(geo_cell_data.mid_point().z) {
+            }
+            stepper(const stepper&) = delete;
+            stepper& operator=(const stepper&) = delete;
+
+            /** \brief advance state one time-step, the i'th period of the time-axis
+             * \param i the time-axis index to compute
+             * \param i_end the end of the run, to collect the final state at the last step
+             */
+            template <class SC, class RC>
+            void step(size_t i, size_t i_end, S& state, SC& state_collector, RC& response_collector) {
+                namespace prof = method_stack::profiling;
+                prof::timer tm(prof::input);
+                utcperiod period = time_axis.period(i);
+                double temp = temp_accessor.value(i);
+                double rad = rad_accessor.value(i);
+                double rel_hum = rel_hum_accessor.value(i);
+                double prec = p_corr.calc(prec_accessor.value(i));
+                double wind_speed = wind_speed_accessor.value(i);
+                tm.next(prof::collect);
+                method_stack::collect(state_collector, i, state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
+
+                tm.next(prof::snow);
+                gs.step_with_calendar_terms(state.gs, response.gs, period.start, period.timespan(), parameter.gs,
+                        temp, rad, prec, wind_speed, rel_hum,forest_fraction,altitude,
+                        cal_terms->day_of_year[i], cal_terms->year_start[i]);
+                tm.next(prof::glacier_melt);
+                response.gm_melt_m3s = glacier_melt::step(parameter.gm.dtf, temp, cell_area_m2*response.gs.sca, glacier_area_m2);
+                tm.next(prof::potential_evapotranspiration);
+                response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(temp, rad, rel_hum)*calendar::HOUR; //mm/s -> mm/h
+                tm.next(prof::actual_evapotranspiration);
+                response.ae.ae = actual_evapotranspiration::calculate_step(
+                                  state.kirchner.q,
+                                  response.pt.pot_evapotranspiration,
+                                  parameter.ae.ae_scale_factor,
+                                  std::max(response.gs.sca,glacier_fraction), // a evap only on non-snow/non-glac area
+                                  period.timespan()
+                                );
+                double gm_mmh= shyft::m3s_to_mmh(response.gm_melt_m3s, cell_area_m2);
+                tm.next(prof::response);
+                kirchner.step(period.start, period.end, state.kirchner.q, response.kirchner.q_avg, response.gs.outflow + gm_routed*gm_mmh, response.ae.ae); // all units mm/h over 'same' area
+
+                tm.next(prof::discharge);
+                response.total_discharge =
+                      std::max(0.0,prec - response.ae.ae)*direct_response_fraction // when it rains, remove ae. from direct response
+                    + gm_direct*gm_mmh  // glacier melt direct response
+                    + response.kirchner.q_avg*kirchner_fraction;
+                response.charge_m3s =
+                    + shyft::mmh_to_m3s(prec, cell_area_m2)
+                    - shyft::mmh_to_m3s(response.ae.ae, cell_area_m2)
+                    + response.gm_melt_m3s
+                    - shyft::mmh_to_m3s(response.total_discharge, cell_area_m2);
+                // Possibly save the calculated values using the collector callbacks.
+                tm.next(prof::collect);
+                method_stack::collect(response_collector, i, response);///< \note collect the response valid for the i'th period (current state is now at the end of period)
+                if(i+1==i_end)
+                    method_stack::collect(state_collector, i+1, state);///< \note last iteration,collect the  final state as well.
+            }
+        };
+
         /** \brief Calculation Model using assembly of PriestleyTaylor, GammaSnow and Kirchner
          *
          * This model first uses PriestleyTaylor for calculating the potential
@@ -265,6 +405,8 @@ namespace shyft {
          *    - S::kirchner_state_type --> State type for the Kirchner method.
          *    - S.gs --> S::gs_state_type, - State variables for the GammaSnow method
          *    - S.kirchner --> S::kirchner_state_type, - State variables for the Kirchner method
+         * \tparam KAC Kirchner average computer, selecting the kirchner solver, e.g. kirchner::fixed_step_trapezoidal_average
+         *    for calibration runs, default kirchner::trapezoidal_average with the adaptive solver.
          * \tparam R Response type that implements:
          *    - R::gs_response_type --> Response type for the GammaSnow routine.
          *    - R.gs --> R::gs_response_type, -Response object passed to the GammaSnow routine.
@@ -282,7 +424,8 @@ namespace shyft {
          * \tparam RC Response collector type that implements:
          *    - RC.collect(utctime t, const R& response) --> Possibly save some responses at time t.
          */
-        template<template <typename, typename> class A, class R, class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T,
+        template<template <typename, typename> class A, class R, template <class> class KAC = kirchner::trapezoidal_average,
+        class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T,
         class S, class GCD, class P, class SC, class RC>
         void run_pt_gs_k(const GCD& geo_cell_data,
             const P& parameter,
@@ -296,77 +439,136 @@ namespace shyft {
             SC& state_collector,
             RC& response_collector
             ) {
-            // Access time series input data through accessors of template A (typically a direct accessor).
-            using temp_accessor_t = A<T_TS, T>;
-            using prec_accessor_t = A<P_TS, T>;
-            using wind_speed_accessor_t = A<WS_TS, T>;
-            using rel_hum_accessor_t = A<RH_TS, T>;
-            using rad_accessor_t = A<RAD_TS, T>;
-
-            auto temp_accessor = temp_accessor_t(temp, time_axis);
-            auto prec_accessor = prec_accessor_t(prec, time_axis);
-            auto wind_speed_accessor = wind_speed_accessor_t(wind_speed, time_axis);
-            auto rel_hum_accessor = rel_hum_accessor_t(rel_hum, time_axis);
-            auto rad_accessor = rad_accessor_t(rad, time_axis);
-
-            // Initialize the method stack
-            precipitation_correction::calculator p_corr(parameter.p_corr.scale_factor);
-            priestley_taylor::calculator pt(parameter.pt.albedo, parameter.pt.alpha);
-            gamma_snow::calculator<typename P::gs_parameter_t, typename S::gs_state_t, typename R::gs_response_t> gs;
-            kirchner::calculator<kirchner::trapezoidal_average, typename P::kirchner_parameter_t> kirchner(parameter.kirchner);
-            //
-            // Get the initial states
-            R response;
-            const double forest_fraction=geo_cell_data.land_type_fractions_info().forest();
-            const double glacier_fraction = geo_cell_data.land_type_fractions_info().glacier();
-            const double gm_direct = parameter.gm.direct_response; //glacier melt directly out of cell
-            const double gm_routed = 1-gm_direct; // glacier melt routed through kirchner
-            const double direct_response_fraction = glacier_fraction*gm_direct + geo_cell_data.land_type_fractions_info().reservoir();// only direct response on reservoirs
-            const double kirchner_fraction = 1 - direct_response_fraction;
-            const double cell_area_m2 = geo_cell_data.area();
-            const double glacier_area_m2 = geo_cell_data.area()*glacier_fraction;
-            const double altitude= geo_cell_data.mid_point().z;
+            stepper<A, R, T_TS, P_TS, WS_TS, RH_TS, RAD_TS, T, S, GCD, P, KAC> stack(geo_cell_data, parameter, time_axis, temp, prec, wind_speed, rel_hum, rad);
             // Step through times in axis
             size_t i_begin = n_steps > 0 ? start_step : 0;
             size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
-            for (size_t i = i_begin ; i < i_end ; ++i) {
-                utcperiod period = time_axis.period(i);
-                double temp = temp_accessor.value(i);
-                double rad = rad_accessor.value(i);
-                double rel_hum = rel_hum_accessor.value(i);
-                double prec = p_corr.calc(prec_accessor.value(i));
-                state_collector.collect(i, state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
+            for (size_t i = i_begin ; i < i_end ; ++i)
+                stack.step(i, i_end, state, state_collector, response_collector);
+            response_collector.set_end_response(stack.response);
+        }
 
-                gs.step(state.gs, response.gs, period.start, period.timespan(), parameter.gs,
-                        temp, rad, prec, wind_speed_accessor.value(i), rel_hum,forest_fraction,altitude);
-                response.gm_melt_m3s = glacier_melt::step(parameter.gm.dtf, temp, cell_area_m2*response.gs.sca, glacier_area_m2);
-                response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(temp, rad, rel_hum)*calendar::HOUR; //mm/s -> mm/h
-                response.ae.ae = actual_evapotranspiration::calculate_step(
-                                  state.kirchner.q,
-                                  response.pt.pot_evapotranspiration,
-                                  parameter.ae.ae_scale_factor,
-                                  std::max(response.gs.sca,glacier_fraction), // a evap only on non-snow/non-glac area
-                                  period.timespan()
-                                );
-                double gm_mmh= shyft::m3s_to_mmh(response.gm_melt_m3s, cell_area_m2);
-                kirchner.step(period.start, period.end, state.kirchner.q, response.kirchner.q_avg, response.gs.outflow + gm_routed*gm_mmh, response.ae.ae); // all units mm/h over 'same' area
+        /** \brief the pt_gs_k method stack for a batch of cells sharing the parameter, stepped timestep-major
+         *
+         * The states are kept in a state_soa, and the inputs and responses of the current time-step
+         * in flat arrays indexed by cell. Glacier melt, potential and actual evapotranspiration are applied as
+         * batch kernels over all cells of the batch, while gamma_snow and kirchner, that are branchy and
+         * iterative, are stepped cell by cell directly on the state_soa fields.
+         * The caller fills the input arrays temp, prec, wind_speed, rel_hum and rad for each time-step, and calls step.
+         * Each cell gives the same result as run_pt_gs_k.
+         * \tparam P parameter type, as for run_pt_gs_k
+         * \sa pt_gs_k::run_batch
+         */
+        template<class P>
+        struct batch_stepper {
+            const P& parameter;
+            precipitation_correction::calculator p_corr;
+            priestley_taylor::calculator pt;
+            gamma_snow::calculator<typename P::gs_parameter_t, gamma_snow::state, gamma_snow::response> gs;
+            kirchner::calculator<kirchner::trapezoidal_average, typename P::kirchner_parameter_t> kirchner;// reinitialized each step, so it can be shared by the cells
+            const double gm_direct;
+            const double gm_routed;
+            state_soa s;///< the states of the cells
+            // cell constants
+            vector<double> forest_fraction, glacier_fraction, direct_response_fraction, kirchner_fraction, cell_area_m2, glacier_area_m2, altitude;
+            // inputs of the current time-step
+            vector<double> temp, prec, wind_speed, rel_hum, rad;
+            // responses of the current time-step
+            vector<gamma_snow::response> gs_response;
+            vector<double> sca, snow_fraction, gm_melt_m3s, pot_evapotranspiration, ae, q_avg, total_discharge, charge_m3s;
 
-                response.total_discharge =
-                      std::max(0.0,prec - response.ae.ae)*direct_response_fraction // when it rains, remove ae. from direct response
-                    + gm_direct*gm_mmh  // glacier melt direct response
-                    + response.kirchner.q_avg*kirchner_fraction;
-                response.charge_m3s =
-                    + shyft::mmh_to_m3s(prec, cell_area_m2)
-                    - shyft::mmh_to_m3s(response.ae.ae, cell_area_m2)
-                    + response.gm_melt_m3s
-                    - shyft::mmh_to_m3s(response.total_discharge, cell_area_m2);
-                // Possibly save the calculated values using the collector callbacks.
-                response_collector.collect(i, response);///< \note collect the response valid for the i'th period (current state is now at the end of period)
-                if(i+1==i_end)
-                    state_collector.collect(i+1, state);///< \note last iteration,collect the  final state as well.
+            /** \brief construct for the given cell geo and initial states
+             * \param parameter common parameter of the cells, kept by reference
+             * \param geo geo cell data of each cell
+             * \param states initial state of each cell
+             */
+            template <class GCD>
+            batch_stepper(const P& parameter, const vector<const GCD*>& geo, const vector<state>& states)
+                : parameter(parameter), p_corr(parameter.p_corr.scale_factor), pt(parameter.pt.albedo, parameter.pt.alpha),
+                  kirchner(parameter.kirchner), gm_direct(parameter.gm.direct_response), gm_routed(1 - gm_direct) {
+                if (geo.size() != states.size())
+                    throw runtime_error("pt_gs_k::batch_stepper: geo and states must have equal size");
+                const size_t n = geo.size();
+                for (auto v : {&forest_fraction, &glacier_fraction, &direct_response_fraction, &kirchner_fraction, &cell_area_m2, &glacier_area_m2, &altitude,
+                               &temp, &prec, &wind_speed, &rel_hum, &rad,
+                               &sca, &snow_fraction, &gm_melt_m3s, &pot_evapotranspiration, &ae, &q_avg, &total_discharge, &charge_m3s})
+                    v->resize(n, 0.0);
+                gs_response.resize(n);
+                for (size_t j = 0; j < n; ++j) {
+                    const auto& g = *geo[j];
+                    forest_fraction[j] = g.land_type_fractions_info().forest();
+                    glacier_fraction[j] = g.land_type_fractions_info().glacier();
+                    direct_response_fraction[j] = glacier_fraction[j]*gm_direct + g.land_type_fractions_info().reservoir();
+                    kirchner_fraction[j] = 1 - direct_response_fraction[j];
+                    cell_area_m2[j] = g.area();
+                    glacier_area_m2[j] = g.area()*glacier_fraction[j];
+                    altitude[j] = g.mid_point().z;
+                }
+                s.assign(states);
             }
-            response_collector.set_end_response(response);
-        }
+
+            size_t size() const { return s.size(); }
+
+            /** \brief step all cells over the period, using the inputs temp, prec, wind_speed, rel_hum and rad
+             * \param period the period of the time-step
+             * \param day_of_year the calendar day of year of period.start, ref. time_axis::calendar_terms
+             * \param year_start the start of the year of period.start, ref. time_axis::calendar_terms
+             */
+            void step(const utcperiod& period, size_t day_of_year, utctime year_start) {
+                namespace prof = method_stack::profiling;
+                const size_t n = size();
+                double* q = s.f[8].data();
+                prof::timer tm(prof::input);
+                for (size_t j = 0; j < n; ++j) prec[j] = p_corr.calc(prec[j]);
+                tm.next(prof::snow);
+                gamma_snow::state gs_state;
+                for (size_t j = 0; j < n; ++j) {
+                    gs_state.albedo = s.f[0][j]; gs_state.lwc = s.f[1][j]; gs_state.surface_heat = s.f[2][j]; gs_state.alpha = s.f[3][j];
+                    gs_state.sdc_melt_mean = s.f[4][j]; gs_state.acc_melt = s.f[5][j]; gs_state.iso_pot_energy = s.f[6][j]; gs_state.temp_swe = s.f[7][j];
+                    gs.step_with_calendar_terms(gs_state, gs_response[j], period.start, period.timespan(), parameter.gs,
+                        temp[j], rad[j], prec[j], wind_speed[j], rel_hum[j], forest_fraction[j], altitude[j], day_of_year, year_start);
+                    s.f[0][j] = gs_state.albedo; s.f[1][j] = gs_state.lwc; s.f[2][j] = gs_state.surface_heat; s.f[3][j] = gs_state.alpha;
+                    s.f[4][j] = gs_state.sdc_melt_mean; s.f[5][j] = gs_state.acc_melt; s.f[6][j] = gs_state.iso_pot_energy; s.f[7][j] = gs_state.temp_swe;
+                    sca[j] = gs_response[j].sca;
+                    snow_fraction[j] = std::max(sca[j], glacier_fraction[j]);// a evap only on non-snow/non-glac area
+                }
+                tm.next(prof::glacier_melt);
+                glacier_melt::step_batch(parameter.gm.dtf, temp.data(), sca.data(), cell_area_m2.data(), glacier_area_m2.data(), gm_melt_m3s.data(), n);
+                tm.next(prof::potential_evapotranspiration);
+                pt.potential_evapotranspiration_batch(temp.data(), rad.data(), rel_hum.data(), pot_evapotranspiration.data(), n);
+                for (size_t j = 0; j < n; ++j) pot_evapotranspiration[j] *= calendar::HOUR; //mm/s -> mm/h
+                tm.next(prof::actual_evapotranspiration);
+                actual_evapotranspiration::calculate_step_batch(q, pot_evapotranspiration.data(), parameter.ae.ae_scale_factor, snow_fraction.data(), ae.data(), n);
+                tm.next(prof::response);
+                for (size_t j = 0; j < n; ++j)
+                    kirchner.step(period.start, period.end, q[j], q_avg[j], gs_response[j].outflow + gm_routed*shyft::m3s_to_mmh(gm_melt_m3s[j], cell_area_m2[j]), ae[j]);
+                tm.next(prof::discharge);
+                for (size_t j = 0; j < n; ++j) {
+                    const double gm_mmh = shyft::m3s_to_mmh(gm_melt_m3s[j], cell_area_m2[j]);
+                    total_discharge[j] =
+                          std::max(0.0, prec[j] - ae[j])*direct_response_fraction[j]
+                        + gm_direct*gm_mmh
+                        + q_avg[j]*kirchner_fraction[j];
+                    charge_m3s[j] =
+                        + shyft::mmh_to_m3s(prec[j], cell_area_m2[j])
+                        - shyft::mmh_to_m3s(ae[j], cell_area_m2[j])
+                        + gm_melt_m3s[j]
+                        - shyft::mmh_to_m3s(total_discharge[j], cell_area_m2[j]);
+                }
+            }
+
+            /** \return the response of cell j for the current time-step, as passed to the response collector by run_pt_gs_k */
+            template <class R>
+            void get_response(size_t j, R& r) const {
+                r.gs = gs_response[j];
+                r.gm_melt_m3s = gm_melt_m3s[j];
+                r.pt.pot_evapotranspiration = pot_evapotranspiration[j];
+                r.ae.ae = ae[j];
+                r.kirchner.q_avg = q_avg[j];
+                r.total_discharge = total_discharge[j];
+                r.charge_m3s = charge_m3s[j];
+            }
+        };
     } // pt_gs_k
   } // core
 } // shyft
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "pt_gs_k.h"
+#include "pt_gs_k_cell_model.h"
+
+/**
+ * Contains the pt_gs_k batch run on structure of arrays buffers, the layout of an offloaded kernel,
+ * where the forcing, the states and the collected responses of a batch are contiguous arrays,
+ * copied in before the run, and out only for the responses the collectors use.
+ */
+
+namespace shyft {
+    namespace core {
+        namespace pt_gs_k {
+
+            /** \brief the forcing of a batch of n cells over n_steps, step-major, v[k*n + j] is the value of cell j at step i_begin + k */
+            struct forcing_soa {
+                size_t n = 0;
+                size_t i_begin = 0;
+                size_t n_steps = 0;
+                std::array<std::vector<double>, 5> f;///< temperature, precipitation, wind_speed, rel_hum, radiation
+
+                /** \brief gather the env_ts of the cells of batch, steps [i_begin..i_end) */
+                template <class C>
+                void gather(const timeaxis_t& time_axis, size_t i_begin_, size_t i_end, C* const* batch, size_t n_) {
+                    n = n_;
+                    i_begin = i_begin_;
+                    n_steps = i_end - i_begin;
+                    for (auto& v : f)
+                        v.resize(n*n_steps);
+                    for (size_t j = 0; j < n; ++j) {
+                        const auto& e = batch[j]->env_ts;
+                        gather_ts(f[0], j, e.temperature, time_axis);
+                        gather_ts(f[1], j, e.precipitation, time_axis);
+                        gather_ts(f[2], j, e.wind_speed, time_axis);
+                        gather_ts(f[3], j, e.rel_hum, time_axis);
+                        gather_ts(f[4], j, e.radiation, time_axis);
+                    }
+                }
+              private:
+                template <class TS>
+                void gather_ts(std::vector<double>& v, size_t j, const TS& ts, const timeaxis_t& time_axis) {
+                    direct_accessor<TS, timeaxis_t> a(ts, time_axis);
+                    for (size_t k = 0; k < n_steps; ++k)
+                        v[k*n + j] = a.value(i_begin + k);
+                }
+            };
+
+            /** \brief one cell of a forcing_soa array, as the series of the stepper */
+            struct forcing_column {
+                const double* v;
+                size_t stride;
+                size_t i_begin;
+                double value(size_t i) const { return v[(i - i_begin)*stride]; }
+            };
+
+            /** \brief the stepper accessor of a forcing_column */
+            template <class S, class TA>
+            struct soa_accessor {
+                const S& s;
+                soa_accessor(const S& s, const TA&) : s(s) {}
+                double value(size_t i) const { return s.value(i); }
+            };
+
+            /** \brief the responses used by the discharge and catchment collectors, step-major as forcing_soa
+             *
+             * These are the only responses copied back from a batch run, ref. run_batch_soa.
+             */
+            struct response_soa {
+                size_t n = 0;
+                std::vector<double> total_discharge;///< [mm/h]
+                std::vector<double> charge_m3s;
+                std::vector<double> sca;
+                std::vector<double> storage;
+                void resize(size_t n_, size_t n_steps) {
+                    n = n_;
+                    for (auto v : {&total_discharge, &charge_m3s, &sca, &storage})
+                        v->resize(n*n_steps);
+                }
+            };
+
+            /** \brief collects the response of cell j of a batch into a response_soa */
+            struct response_soa_collector {
+                response_soa* r;
+                size_t j;
+                size_t i_begin;
+                void collect(size_t i, const response_t& x) {
+                    const size_t ix = (i - i_begin)*r->n + j;
+                    r->total_discharge[ix] = x.total_discharge;
+                    r->charge_m3s[ix] = x.charge_m3s;
+                    r->sca[ix] = x.gs.sca;
+                    r->storage[ix] = x.gs.storage;
+                }
+            };
+
+            /** \brief run the steps of the forcing of a batch timestep-major, on the states s, into the responses r
+             *
+             * The kernel of run_batch_offload, touching only the soa buffers, and the geo and parameter of the cells.
+             * \param end_response set to the response of the last step of each cell
+             */
+            template <class C>
+            void run_batch_soa(const timeaxis_t& time_axis, C* const* batch, const forcing_soa& x, state_soa& s, response_soa& r,
+                               std::vector<response_t>& end_response) {
+                typedef stepper<soa_accessor, response_t, forcing_column, forcing_column, forcing_column, forcing_column, forcing_column,
+                                timeaxis_t, state_t, geo_cell_data, parameter_t> stepper_t;
+                const size_t n = x.n;
+                const size_t i_end = x.i_begin + x.n_steps;
+                std::vector<std::array<forcing_column, 5>> cols(n);
+                std::vector<std::unique_ptr<stepper_t>> stack; stack.reserve(n);// stepper is not copyable
+                std::vector<state_t> state = s.to_vector();
+                std::vector<response_soa_collector> rc(n);
+                null_collector sc;
+                r.resize(n, x.n_steps);
+                for (size_t j = 0; j < n; ++j) {
+                    for (size_t k = 0; k < 5; ++k)
+                        cols[j][k] = forcing_column{x.f[k].data() + j, n, x.i_begin};
+                    const auto& c = *batch[j];
+                    stack.emplace_back(new stepper_t(c.geo, *c.parameter, time_axis, cols[j][0], cols[j][1], cols[j][2], cols[j][3], cols[j][4]));
+                    rc[j] = response_soa_collector{&r, j, x.i_begin};
+                }
+                for (size_t i = x.i_begin; i < i_end; ++i)
+                    for (size_t j = 0; j < n; ++j)
+                        stack[j]->step(i, i_end, state[j], sc, rc[j]);
+                s.assign(state);
+                end_response.resize(n);
+                for (size_t j = 0; j < n; ++j)
+                    end_response[j] = stack[j]->response;
+            }
+
+            /** \brief as run_batch, but with the forcing, states and responses of the batch staged in soa buffers, ref. run_batch_soa
+             *
+             * Gives the same result as cell.run() for the cells with a discharge_collector or catchment_collector,
+             * the collectors that only use the responses of response_soa, and a null state collector.
+             * \note the copies to and from the buffers is the cost of this layout on the host, so it is not the default run,
+             *  but the staging of a kernel on a device, that would replace run_batch_soa.
+             * \tparam C a pt_gs_k cell type with a null state collector
+             */
+            template <class C>
+            void run_batch_offload(const timeaxis_t& time_axis, int start_step, int n_steps, C* const* batch, size_t n) {
+                static_assert(method_stack::is_null_collector<decltype(std::declval<C&>().sc)>::value,
+                              "run_batch_offload: the state collector of the cells must be a null_collector");
+                for (size_t j = 0; j < n; ++j) {
+                    auto& c = *batch[j];
+                    if (c.parameter.get() == nullptr)
+                        throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+                    c.begin_run(time_axis, start_step, n_steps);
+                }
+                const size_t i_begin = n_steps > 0 ? start_step : 0;
+                const size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
+                forcing_soa x;
+                x.gather(time_axis, i_begin, i_end, batch, n);
+                state_soa s;
+                s.resize(n);
+                for (size_t j = 0; j < n; ++j)
+                    s.set(j, batch[j]->state);
+                response_soa r;
+                std::vector<response_t> end_response;
+                run_batch_soa(time_axis, batch, x, s, r, end_response);
+                for (size_t j = 0; j < n; ++j) {
+                    auto& c = *batch[j];
+                    c.state = s.get(j);
+                    response_t y;
+                    for (size_t i = i_begin; i < i_end; ++i) {
+                        const size_t ix = (i - i_begin)*n + j;
+                        y.total_discharge = r.total_discharge[ix];
+                        y.charge_m3s = r.charge_m3s[ix];
+                        y.gs.sca = r.sca[ix];
+                        y.gs.storage = r.storage[ix];
+                        c.rc.collect(i, y);
+                    }
+                    c.rc.set_end_response(end_response[j]);
+                }
+            }
+        }
+    }
+}
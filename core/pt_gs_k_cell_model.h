@@ -11,6 +11,7 @@
 #include "core_serialization.h"
 #include "cell_model.h"
 #include "pt_gs_k.h"
+#include "catchment_accumulator.h"
 
 namespace shyft {
     namespace core {
@@ -36,24 +37,31 @@ namespace shyft {
             *       both with respect to measurement unit, and also specifying if this
             *       a 'state in time' value or a average-value for the time-step.
             */
-            struct all_response_collector {
+            template <class TS>
+            struct basic_all_response_collector {
                 double destination_area;///< in [m^2]
                 // these are the one that we collects from the response, to better understand the model::
-                pts_t avg_discharge; ///< Kirchner Discharge given in [m^3/s] for the timestep
-                pts_t charge_m3s; ///< = precip + glacier - act_evap - avg_discharge [m^3/s] for the timestep
-                pts_t snow_sca; ///< gamma snow covered area fraction, sca.. 0..1 - at the end of timestep (state)
-                pts_t snow_swe;///< gamma snow swe, [mm] over the cell sca.. area, - at the end of timestep ?
-                pts_t snow_outflow;///< gamma snow output [m^3/s] for the timestep
-                pts_t glacier_melt;///< [m3/s] for the timestep
-                pts_t ae_output;///< actual evap mm/h
-                pts_t pe_output;///< actual evap mm/h
+                TS avg_discharge; ///< Kirchner Discharge given in [m^3/s] for the timestep
+                TS charge_m3s; ///< = precip + glacier - act_evap - avg_discharge [m^3/s] for the timestep
+                TS snow_sca; ///< gamma snow covered area fraction, sca.. 0..1 - at the end of timestep (state)
+                TS snow_swe;///< gamma snow swe, [mm] over the cell sca.. area, - at the end of timestep ?
+                TS snow_outflow;///< gamma snow output [m^3/s] for the timestep
+                TS glacier_melt;///< [m3/s] for the timestep
+                TS ae_output;///< actual evap mm/h
+                TS pe_output;///< actual evap mm/h
                 response_t end_reponse;///<< end_response, at the end of collected
 
-                all_response_collector() : destination_area(0.0) {}
-                explicit all_response_collector(const double destination_area) : destination_area(destination_area) {}
-                all_response_collector(const double destination_area, const timeaxis_t& time_axis)
+                basic_all_response_collector() : destination_area(0.0) {}
+                explicit basic_all_response_collector(const double destination_area) : destination_area(destination_area) {}
+                basic_all_response_collector(const double destination_area, const timeaxis_t& time_axis)
                     : destination_area(destination_area), avg_discharge(time_axis, 0.0),charge_m3s(time_axis,0.0), snow_sca(time_axis, 0.0), snow_swe(time_axis, 0.0), snow_outflow(time_axis, 0.0), glacier_melt(time_axis, 0.0), ae_output(time_axis, 0.0), pe_output(time_axis, 0.0) {}
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const {
+                    return series_heap_bytes(avg_discharge, charge_m3s, snow_sca, snow_swe,
+                                             snow_outflow, glacier_melt, ae_output, pe_output);
+                }
+
                 /**\brief called before run to allocate space for results */
                 void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
                     destination_area = area;
@@ -90,24 +98,30 @@ namespace shyft {
                 //template<class R>
                 void set_end_response(const response_t& r) {end_reponse=r;}
             };
+            typedef basic_all_response_collector<pts_t> all_response_collector;
+            typedef basic_all_response_collector<pts_f32_t> all_response_collector_f32;///< float storage of the response series
 
             /** \brief a collector that collects/keep discharge only */
-            struct discharge_collector {
+            template <class TS>
+            struct basic_discharge_collector {
                 double cell_area;///< in [m^2]
-                pts_t avg_discharge; ///< Discharge given in [m^3/s] as the average of the timestep
-                pts_t charge_m3s; ///< = precip + glacier - act_evap - avg_discharge [m^3/s] for the timestep
+                TS avg_discharge; ///< Discharge given in [m^3/s] as the average of the timestep
+                TS charge_m3s; ///< = precip + glacier - act_evap - avg_discharge [m^3/s] for the timestep
                 response_t end_response;///<< end_response, at the end of collected
                 bool collect_snow;
-                pts_t snow_sca;
-                pts_t snow_swe;
-                discharge_collector() : cell_area(0.0),collect_snow(false) {}
-                explicit discharge_collector(const double cell_area) : cell_area(cell_area),collect_snow(false) {}
-                discharge_collector(const double cell_area, const timeaxis_t& time_axis)
+                TS snow_sca;
+                TS snow_swe;
+                basic_discharge_collector() : cell_area(0.0),collect_snow(false) {}
+                explicit basic_discharge_collector(const double cell_area) : cell_area(cell_area),collect_snow(false) {}
+                basic_discharge_collector(const double cell_area, const timeaxis_t& time_axis)
                     : cell_area(cell_area),
                       avg_discharge(time_axis, 0.0), charge_m3s(time_axis, 0.0), collect_snow(false),
                       snow_sca(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0),
                       snow_swe(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0) {}
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const { return series_heap_bytes(avg_discharge, charge_m3s, snow_sca, snow_swe); }
+
                 void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
                     cell_area = area;
                     ts_init(avg_discharge, time_axis, start_step, n_steps, ts_point_fx::POINT_AVERAGE_VALUE);
@@ -127,12 +141,51 @@ namespace shyft {
                 }
                 void set_end_response(const response_t& response) {end_response=response;}
             };
+            typedef basic_discharge_collector<pts_t> discharge_collector;
+            typedef basic_discharge_collector<pts_f32_t> discharge_collector_f32;///< float storage of the response series
+
+            /** \brief a collector that adds discharge and charge directly to the catchment sums
+             *
+             * Keeps no time-series pr. cell, the region_model wires accumulator and catchment_ix
+             * before each run, and catchment_discharges/catchment_charges reads the merged sums.
+             * Useful for large regions where only catchment results are needed.
+             * If collect_snow is set, the area weighted snow sca and swe are summed as well,
+             * so that calibration on snow targets needs no per cell series.
+             */
+            struct catchment_collector {
+                double cell_area;///< in [m^2]
+                bool collect_snow;///< if true, also sum sca x area and swe x area, ref. catchment_accumulator::snow_sca
+                std::shared_ptr<catchment_accumulator> accumulator;///< the shared catchment sums, set by the region_model
+                size_t catchment_ix;///< the catchment index of the cell, set by the region_model
+                double* slab;///< the partial sums of the thread running the cell, taken at initialize()
+                double scale;///< multiplies the contributions, the area of the cells it represents over its own, ref. region_model::hru_deduplication
+                response_t end_response;///<< end_response, at the end of collected
+
+                catchment_collector() : cell_area(0.0), collect_snow(false), catchment_ix(0), slab(nullptr), scale(1.0) {}
+                explicit catchment_collector(const double cell_area) : cell_area(cell_area), collect_snow(false), catchment_ix(0), slab(nullptr), scale(1.0) {}
+
+                void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
+                    cell_area = area;
+                    slab = accumulator ? accumulator->local_slab() : nullptr;
+                }
+
+                void collect(size_t idx, const response_t& response) {
+                    if (slab) {
+                        accumulator->add(slab, catchment_ix, idx, scale*mmh_to_m3s(response.total_discharge, cell_area), scale*response.charge_m3s);
+                        if (collect_snow)
+                            accumulator->add_snow(slab, catchment_ix, idx, scale*response.gs.sca*cell_area, scale*response.gs.storage*cell_area);
+                    }
+                }
+                void set_end_response(const response_t& response) {end_response=response;}
+            };
+
             /**\brief a state null collector
              *
              * Used during calibration/optimization when there is no need for state,
              * and we need all the RAM for useful purposes.
              */
             struct null_collector {
+                typedef std::true_type is_null_collector;///< collect calls are removed at compile time, ref. method_stack::collect
                 void initialize(const timeaxis_t& time_axis,int start_step=0,int n_steps=0, double area=0.0) {}
                 void collect(size_t i, const state_t& response) {}
             };
@@ -141,22 +194,23 @@ namespace shyft {
              *
              *  \note that the state collected is instant in time, valid at the beginning of period
              */
-            struct state_collector {
+            template <class TS>
+            struct basic_state_collector {
                 bool collect_state;///< if true, collect state, otherwise ignore (and the state of time-series are undefined/zero)
                 // these are the one that we collects from the response, to better understand the model::
                 double destination_area;
-                pts_t kirchner_discharge; ///< Kirchner state instant Discharge given in m^3/s
-                pts_t gs_albedo;
-                pts_t gs_lwc;
-                pts_t gs_surface_heat;
-                pts_t gs_alpha;
-                pts_t gs_sdc_melt_mean;
-                pts_t gs_acc_melt;
-                pts_t gs_iso_pot_energy;
-                pts_t gs_temp_swe;
+                TS kirchner_discharge; ///< Kirchner state instant Discharge given in m^3/s
+                TS gs_albedo;
+                TS gs_lwc;
+                TS gs_surface_heat;
+                TS gs_alpha;
+                TS gs_sdc_melt_mean;
+                TS gs_acc_melt;
+                TS gs_iso_pot_energy;
+                TS gs_temp_swe;
 
-                state_collector() : collect_state(false), destination_area(0.0) { /* Do nothing */ }
-                explicit state_collector(const timeaxis_t& time_axis)
+                basic_state_collector() : collect_state(false), destination_area(0.0) { /* Do nothing */ }
+                explicit basic_state_collector(const timeaxis_t& time_axis)
                  : collect_state(false), destination_area(0.0),
                    kirchner_discharge(time_axis, 0.0),
                    gs_albedo(time_axis, 0.0),
@@ -169,6 +223,12 @@ namespace shyft {
                    gs_temp_swe(time_axis, 0.0)
                    { /* Do nothing */ }
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const {
+                    return series_heap_bytes(kirchner_discharge, gs_albedo, gs_lwc, gs_surface_heat, gs_alpha,
+                                             gs_sdc_melt_mean, gs_acc_melt, gs_iso_pot_energy, gs_temp_swe);
+                }
+
                 /** brief called before run, prepares state time-series
                  *
                  * with preallocated room for the supplied time-axis.
@@ -204,10 +264,95 @@ namespace shyft {
                     }
                 }
             };
+            typedef basic_state_collector<pts_t> state_collector;
+            typedef basic_state_collector<pts_f32_t> state_collector_f32;///< float storage of the state series
             // typedef the variants we need exported.
             typedef cell<parameter_t, environment_t, state_t, state_collector, all_response_collector> cell_complete_response_t;///< used for usual/explorative runs, where we would like all possible info, result and state
             typedef cell<parameter_t, environment_t, state_t, null_collector, discharge_collector> cell_discharge_response_t; ///<used for operational or calibration runs, only needed info is collected.
+            typedef cell<parameter_t, environment_f32_t, state_t, state_collector_f32, all_response_collector_f32> cell_complete_response_f32_t;///< as cell_complete_response_t, but with float storage of env_ts and collected series, for large ensembles
+            typedef cell<parameter_t, environment_f32_t, state_t, null_collector, discharge_collector_f32> cell_discharge_response_f32_t;///< as cell_discharge_response_t, but with float storage of env_ts and collected series
+            typedef cell<parameter_t, environment_shared_t, state_t, null_collector, discharge_collector> cell_discharge_response_shared_t;///< as cell_discharge_response_t, but cells with one common source share the env_ts values
+            typedef cell<parameter_t, environment_t, state_t, null_collector, catchment_collector> cell_catchment_response_t; ///<used for large regions, where only catchment sums of discharge and charge are needed.
+
+            /** \brief run a batch of cells sharing the parameter, timestep-major, using the flat batch_stepper
+             * \tparam C a pt_gs_k cell type
+             */
+            template <class C>
+            void run_batch_shared(const timeaxis_t& time_axis, int start_step, int n_steps, C* const* batch, size_t n) {
+                typedef typename C::env_ts_t env_t;
+                typedef direct_accessor<decltype(std::declval<env_t&>().temperature), timeaxis_t> temp_accessor_t;
+                typedef direct_accessor<decltype(std::declval<env_t&>().precipitation), timeaxis_t> prec_accessor_t;
+                typedef direct_accessor<decltype(std::declval<env_t&>().wind_speed), timeaxis_t> wind_speed_accessor_t;
+                typedef direct_accessor<decltype(std::declval<env_t&>().rel_hum), timeaxis_t> rel_hum_accessor_t;
+                typedef direct_accessor<decltype(std::declval<env_t&>().radiation), timeaxis_t> rad_accessor_t;
+                std::vector<temp_accessor_t> temp; std::vector<prec_accessor_t> prec; std::vector<wind_speed_accessor_t> wind_speed;
+                std::vector<rel_hum_accessor_t> rel_hum; std::vector<rad_accessor_t> rad;
+                std::vector<const geo_cell_data*> geo; std::vector<state_t> states;
+                for (size_t j = 0; j < n; ++j) {
+                    auto& c = *batch[j];
+                    c.begin_run(time_axis, start_step, n_steps);
+                    temp.emplace_back(c.env_ts.temperature, time_axis);
+                    prec.emplace_back(c.env_ts.precipitation, time_axis);
+                    wind_speed.emplace_back(c.env_ts.wind_speed, time_axis);
+                    rel_hum.emplace_back(c.env_ts.rel_hum, time_axis);
+                    rad.emplace_back(c.env_ts.radiation, time_axis);
+                    geo.push_back(&c.geo);
+                    states.push_back(c.state);
+                }
+                batch_stepper<parameter_t> stack(*batch[0]->parameter, geo, states);
+                auto cal_terms = shyft::time_axis::calendar_terms::shared(time_axis);
+                const bool with_state = !method_stack::is_null_collector<decltype(batch[0]->sc)>::value;// skip unpacking the state for the null collector
+                response_t response;
+                size_t i_begin = n_steps > 0 ? start_step : 0;
+                size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
+                for (size_t i = i_begin; i < i_end; ++i) {
+                    for (size_t j = 0; j < n; ++j) {
+                        stack.temp[j] = temp[j].value(i);
+                        stack.prec[j] = prec[j].value(i);
+                        stack.wind_speed[j] = wind_speed[j].value(i);
+                        stack.rel_hum[j] = rel_hum[j].value(i);
+                        stack.rad[j] = rad[j].value(i);
+                        if (with_state) batch[j]->sc.collect(i, stack.s.get(j));
+                    }
+                    stack.step(time_axis.period(i), cal_terms->day_of_year[i], cal_terms->year_start[i]);
+                    for (size_t j = 0; j < n; ++j) {
+                        stack.get_response(j, response);
+                        batch[j]->rc.collect(i, response);
+                        if (with_state && i + 1 == i_end)
+                            batch[j]->sc.collect(i + 1, stack.s.get(j));
+                    }
+                }
+                for (size_t j = 0; j < n; ++j) {
+                    batch[j]->state = stack.s.get(j);
+                    if (i_end > i_begin) stack.get_response(j, response);
+                    batch[j]->rc.set_end_response(response);
+                }
+            }
 
+            /** \brief run a batch of pt_gs_k cells timestep-major,
+             *
+             * The cells are grouped by their parameter, and each group sharing the parameter is run with
+             * the flat batch_stepper, giving the same result as cell.run().
+             * \tparam C a pt_gs_k cell type
+             */
+            template <class C>
+            void run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, C* const* batch, size_t n) {
+                std::vector<C*> group; group.reserve(n);
+                std::vector<bool> done(n, false);
+                for (size_t k = 0; k < n; ++k) {
+                    if (done[k]) continue;
+                    if (batch[k]->parameter.get() == nullptr)
+                        throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+                    group.clear();
+                    for (size_t j = k; j < n; ++j) {
+                        if (!done[j] && batch[j]->parameter == batch[k]->parameter) {
+                            group.push_back(batch[j]);
+                            done[j] = true;
+                        }
+                    }
+                    run_batch_shared(time_axis, start_step, n_steps, group.data(), group.size());
+                }
+            }
         }
         //specialize run method for all_response_collector
         template<>
@@ -236,6 +381,12 @@ namespace shyft {
             ::set_state_collection(bool on_or_off) {
             sc.collect_state = on_or_off;
         }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
+                         pt_gs_k::state_collector, pt_gs_k::all_response_collector>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
 
         //specialize run method for discharge_collector
         template<>
@@ -265,6 +416,12 @@ namespace shyft {
             ::set_state_collection(bool on_or_off) {
             /* not possible always off.*/
         }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
 
         template<>
         inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
@@ -273,5 +430,140 @@ namespace shyft {
             rc.collect_snow=on_or_off;// possible, if true, we do collect both swe and sca, default is off
         }
 
+        //specialize run method for catchment_collector
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::catchment_collector>
+            ::run(const timeaxis_t& time_axis, int start_step, int n_steps) {
+            if (parameter.get() == nullptr)
+                throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+            begin_run(time_axis, start_step, n_steps);
+            pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response_t>(
+                geo,
+                *parameter,
+                time_axis, start_step, n_steps,
+                env_ts.temperature,
+                env_ts.precipitation,
+                env_ts.wind_speed,
+                env_ts.rel_hum,
+                env_ts.radiation,
+                state,
+                sc,
+                rc);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::catchment_collector>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::catchment_collector>
+            ::set_snow_sca_swe_collection(bool on_or_off) {
+            rc.collect_snow=on_or_off;
+        }
+
+
+        //specialize run method for the float storage variants
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::state_collector_f32, pt_gs_k::all_response_collector_f32>
+            ::run(const timeaxis_t& time_axis, int start_step, int n_steps) {
+            if (parameter.get() == nullptr)
+                throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+            begin_run(time_axis, start_step, n_steps);
+            pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response_t>(
+                geo,
+                *parameter,
+                time_axis, start_step, n_steps,
+                env_ts.temperature,
+                env_ts.precipitation,
+                env_ts.wind_speed,
+                env_ts.rel_hum,
+                env_ts.radiation,
+                state,
+                sc,
+                rc);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::state_collector_f32, pt_gs_k::all_response_collector_f32>
+            ::set_state_collection(bool on_or_off) {
+            sc.collect_state = on_or_off;
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::state_collector_f32, pt_gs_k::all_response_collector_f32>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
+
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector_f32>
+            ::run(const timeaxis_t& time_axis, int start_step, int n_steps) {
+            if (parameter.get() == nullptr)
+                throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+            begin_run(time_axis, start_step, n_steps);
+            pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response_t>(
+                geo,
+                *parameter,
+                time_axis, start_step, n_steps,
+                env_ts.temperature,
+                env_ts.precipitation,
+                env_ts.wind_speed,
+                env_ts.rel_hum,
+                env_ts.radiation,
+                state,
+                sc,
+                rc);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector_f32>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_f32_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector_f32>
+            ::set_snow_sca_swe_collection(bool on_or_off) {
+            rc.collect_snow=on_or_off;
+        }
+
+        //specialize run method for the shared environment variant
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_shared_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector>
+            ::run(const timeaxis_t& time_axis, int start_step, int n_steps) {
+            if (parameter.get() == nullptr)
+                throw std::runtime_error("pt_gs_k::run with null parameter attempted");
+            begin_run(time_axis, start_step, n_steps);
+            pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response_t>(
+                geo,
+                *parameter,
+                time_axis, start_step, n_steps,
+                env_ts.temperature,
+                env_ts.precipitation,
+                env_ts.wind_speed,
+                env_ts.rel_hum,
+                env_ts.radiation,
+                state,
+                sc,
+                rc);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_shared_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector>
+            ::run_batch(const timeaxis_t& time_axis, int start_step, int n_steps, cell* const* batch, size_t n) {
+            pt_gs_k::run_batch(time_axis, start_step, n_steps, batch, n);
+        }
+        template<>
+        inline void cell<pt_gs_k::parameter_t, environment_shared_t, pt_gs_k::state_t,
+                         pt_gs_k::null_collector, pt_gs_k::discharge_collector>
+            ::set_snow_sca_swe_collection(bool on_or_off) {
+            rc.collect_snow=on_or_off;
+        }
     }
 }
@@ -17,6 +17,8 @@
 #include "precipitation_correction.h"
 #include "unit_conversion.h"
 #include "routing.h"
+#include "cell_state_soa.h"
+#include "method_stack.h"
 namespace shyft {
   namespace core {
     namespace pt_hs_k {
@@ -157,6 +159,20 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief structure of arrays storage for pt_hs_k::state, ref. state_soa_base
+         *
+         * The fields are ordered snow.swe, snow.sca, kirchner.q
+         */
+        struct state_soa:state_soa_base<state_soa, state, 3> {
+            static void pack(const state& s, double* v) { v[0] = s.snow.swe; v[1] = s.snow.sca; v[2] = s.kirchner.q; }
+            static void unpack(const double* v, state& s) { s.snow.swe = v[0]; s.snow.sca = v[1]; s.kirchner.q = v[2]; }
+            /** \return the names of the fields, in order */
+            static std::vector<std::string> field_names() { return { "snow.swe", "snow.sca", "kirchner.q" }; }
+            std::vector<double>& snow_swe() { return f[0]; }
+            std::vector<double>& snow_sca() { return f[1]; }
+            std::vector<double>& q() { return f[2]; }
+        };
+
         struct response {
             typedef priestley_taylor::response pt_response_t;
             typedef hbv_snow::response snow_response_t;
@@ -174,7 +190,168 @@ namespace shyft {
 
 
 
-        template<template <typename, typename> class A, class R, class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T,
+        /** \brief the step context of the pt_hs_k method stack, the inputs, cell constants, state and response of one cell
+         *
+         * The routines of the stack read and write the state and response through the context,
+         * ref. method_stack::stack, and the inputs of the current time-step are set by set_step(i).
+         */
+        template<template <typename, typename> class A, class R, class T_TS, class P_TS, class RH_TS, class RAD_TS, class T,
+        class S, class P>
+        struct step_context {
+            A<T_TS, T> temp_accessor;
+            A<P_TS, T> prec_accessor;
+            A<RH_TS, T> rel_hum_accessor;
+            A<RAD_TS, T> rad_accessor;
+            const T& time_axis;
+            const P& parameter;
+            S& state;
+            R response;
+            precipitation_correction::calculator p_corr;
+            // cell constants
+            const double glacier_fraction;
+            const double gm_direct; //glacier melt directly out of cell
+            const double gm_routed; // glacier melt routed through kirchner
+            const double direct_response_fraction;// only direct response on reservoirs
+            const double kirchner_fraction;
+            const double cell_area_m2;
+            const double glacier_area_m2;
+            // inputs of the current time-step
+            utcperiod period;
+            double temp = 0.0;
+            double rad = 0.0;
+            double rel_hum = 0.0;
+            double prec = 0.0;
+            double gm_mmh = 0.0;///< glacier melt [mm/h], set by the glacier_melt_routine
+
+            template <class GCD>
+            step_context(const GCD& geo_cell_data, const P& parameter, const T& time_axis,
+                         const T_TS& temp, const P_TS& prec, const RH_TS& rel_hum, const RAD_TS& rad, S& state)
+                : temp_accessor(temp, time_axis), prec_accessor(prec, time_axis),
+                  rel_hum_accessor(rel_hum, time_axis), rad_accessor(rad, time_axis),
+                  time_axis(time_axis), parameter(parameter), state(state),
+                  p_corr(parameter.p_corr.scale_factor),
+                  glacier_fraction(geo_cell_data.land_type_fractions_info().glacier()),
+                  gm_direct(parameter.gm.direct_response),
+                  gm_routed(1 - gm_direct),
+                  direct_response_fraction(glacier_fraction*gm_direct + geo_cell_data.land_type_fractions_info().reservoir()),
+                  kirchner_fraction(1 - direct_response_fraction),
+                  cell_area_m2(geo_cell_data.area()),
+                  glacier_area_m2(geo_cell_data.area()*glacier_fraction) {
+            }
+            step_context(const step_context&) = delete;
+            step_context& operator=(const step_context&) = delete;
+
+            void set_step(size_t i) {
+                period = time_axis.period(i);
+                temp = temp_accessor.value(i);
+                rad = rad_accessor.value(i);
+                rel_hum = rel_hum_accessor.value(i);
+                prec = p_corr.calc(prec_accessor.value(i));
+            }
+        };
+
+        /** \brief the hbv snow routine, outputs mm/h, interpreted as over the entire area */
+        template <class SnowP, class SnowS>
+        struct hbv_snow_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::snow> profile_routine;
+            hbv_snow::calculator<SnowP, SnowS> snow;
+            template <class X>
+            explicit hbv_snow_routine(const X& x) : snow(x.parameter.hs, x.state.snow) {}
+            template <class X>
+            void step(X& x) { snow.step(x.state.snow, x.response.snow, x.period.start, x.period.end, x.parameter.hs, x.prec, x.temp); }
+        };
+
+        /** \brief the glacier melt of the snow free glacier parts, m3/s, and mm/h over the cell area */
+        struct glacier_melt_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::glacier_melt> profile_routine;
+            template <class X>
+            explicit glacier_melt_routine(const X&) {}
+            template <class X>
+            void step(X& x) {
+                x.response.gm_melt_m3s = glacier_melt::step(x.parameter.gm.dtf, x.temp, x.cell_area_m2*x.state.snow.sca, x.glacier_area_m2);
+                x.gm_mmh = shyft::m3s_to_mmh(x.response.gm_melt_m3s, x.cell_area_m2);
+            }
+        };
+
+        /** \brief priestley-taylor potential evapotranspiration */
+        struct potential_evapotranspiration_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::potential_evapotranspiration> profile_routine;
+            priestley_taylor::calculator pt;
+            template <class X>
+            explicit potential_evapotranspiration_routine(const X& x) : pt(x.parameter.pt.albedo, x.parameter.pt.alpha) {}
+            template <class X>
+            void step(X& x) {
+                x.response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(x.temp, x.rad, x.rel_hum)*calendar::HOUR;// mm/s -> mm/h, interpreted as over the entire area(!)
+            }
+        };
+
+        /** \brief the actual evapotranspiration on the non-snow/non-glacier area */
+        struct actual_evapotranspiration_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::actual_evapotranspiration> profile_routine;
+            template <class X>
+            explicit actual_evapotranspiration_routine(const X&) {}
+            template <class X>
+            void step(X& x) {
+                x.response.ae.ae = actual_evapotranspiration::calculate_step(x.state.kirchner.q, x.response.pt.pot_evapotranspiration,
+                                    x.parameter.ae.ae_scale_factor, std::max(x.state.snow.sca, x.glacier_fraction),  // a evap only on non-snow/non-glac area
+                                    x.period.timespan());
+            }
+        };
+
+        /** \brief the kirchner routine, with the snow outflow and routed glacier melt as input, all units mm/h over 'same' area */
+        template <template <class> class KAC, class KP>
+        struct kirchner_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::response> profile_routine;
+            kirchner::calculator<KAC, KP> kirchner;
+            template <class X>
+            explicit kirchner_routine(const X& x) : kirchner(x.parameter.kirchner) {}
+            template <class X>
+            void step(X& x) {
+                kirchner.step(x.period.start, x.period.end, x.state.kirchner.q, x.response.kirchner.q_avg,
+                              x.response.snow.outflow + x.gm_routed*x.gm_mmh, x.response.ae.ae);
+            }
+        };
+
+        /** \brief the total discharge and charge of the cell */
+        struct discharge_routine {
+            typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::discharge> profile_routine;
+            template <class X>
+            explicit discharge_routine(const X&) {}
+            template <class X>
+            void step(X& x) {
+                auto& r = x.response;
+                r.total_discharge =
+                      std::max(0.0, x.prec - r.ae.ae)*x.direct_response_fraction // when it rains, remove ae. from direct response
+                    + x.gm_direct*x.gm_mmh  // glacier melt direct response
+                    + r.kirchner.q_avg*x.kirchner_fraction;
+                r.charge_m3s =
+                    + shyft::mmh_to_m3s(x.prec, x.cell_area_m2)
+                    - shyft::mmh_to_m3s(r.ae.ae, x.cell_area_m2)
+                    + r.gm_melt_m3s
+                    - shyft::mmh_to_m3s(r.total_discharge, x.cell_area_m2);
+                r.snow.snow_state = x.state.snow;//< note/sih: we need snow in the response due to calibration
+            }
+        };
+
+        /** \brief the pt_hs_k method stack, composed of its routines, ref. method_stack::stack */
+        template <template <class> class KAC, class P, class S>
+        using method_stack_t = method_stack::stack<
+            hbv_snow_routine<typename P::snow_parameter_t, typename S::snow_state_t>,
+            glacier_melt_routine,
+            potential_evapotranspiration_routine,
+            actual_evapotranspiration_routine,
+            kirchner_routine<KAC, typename P::kirchner_parameter_t>,
+            discharge_routine>;
+
+        /** \brief run the pt_hs_k method stack for one cell
+         *
+         * The stack is the composition, method_stack_t, of the hbv snow, glacier melt, evapotranspiration,
+         * kirchner and discharge routines, stepped as one fused kernel for each time-step.
+         * Calls to null collectors are removed at compile time, ref. method_stack::is_null_collector.
+         * \sa pt_gs_k::run_pt_gs_k for a description of the template parameters
+         */
+        template<template <typename, typename> class A, class R, template <class> class KAC = kirchner::trapezoidal_average,
+        class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T,
         class S, class GEOCELLDATA, class P, class SC, class RC >
         void run(const GEOCELLDATA& geo_cell_data,
             const P& parameter,
@@ -188,72 +365,11 @@ namespace shyft {
             SC& state_collector,
             RC& response_collector
             ) {
-            // Access time series input data through accessors of template A (typically a direct accessor).
-            using temp_accessor_t = A < T_TS, T > ;
-            using prec_accessor_t = A < P_TS, T > ;
-            using rel_hum_accessor_t = A < RH_TS, T > ;
-            using rad_accessor_t = A < RAD_TS, T > ;
-
-            auto temp_accessor = temp_accessor_t(temp, time_axis);
-            auto prec_accessor = prec_accessor_t(prec, time_axis);
-            auto rel_hum_accessor = rel_hum_accessor_t(rel_hum, time_axis);
-            auto rad_accessor = rad_accessor_t(rad, time_axis);
-
-
-            // Initialize the method stack
-            precipitation_correction::calculator p_corr(parameter.p_corr.scale_factor);
-            priestley_taylor::calculator pt(parameter.pt.albedo, parameter.pt.alpha);
-            hbv_snow::calculator<typename P::snow_parameter_t, typename S::snow_state_t> hbv_snow(parameter.hs, state.snow);
-            kirchner::calculator<kirchner::trapezoidal_average, typename P::kirchner_parameter_t> kirchner(parameter.kirchner);
-
-            R response;
-            const double glacier_fraction = geo_cell_data.land_type_fractions_info().glacier();
-            const double gm_direct = parameter.gm.direct_response; //glacier melt directly out of cell
-            const double gm_routed = 1-gm_direct; // glacier melt routed through kirchner
-            const double direct_response_fraction = glacier_fraction*gm_direct + geo_cell_data.land_type_fractions_info().reservoir();// only direct response on reservoirs
-            const double kirchner_fraction = 1 - direct_response_fraction;
-            const double cell_area_m2 = geo_cell_data.area();
-            const double glacier_area_m2 = geo_cell_data.area()*glacier_fraction;
-
+            step_context<A, R, T_TS, P_TS, RH_TS, RAD_TS, T, S, P> ctx(geo_cell_data, parameter, time_axis, temp, prec, rel_hum, rad, state);
+            method_stack_t<KAC, P, S> stack(ctx);
             size_t i_begin = n_steps > 0 ? start_step : 0;
             size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
-            for (size_t i = i_begin; i < i_end; ++i) {
-                utcperiod period = time_axis.period(i);
-                double temp = temp_accessor.value(i);
-                double rad = rad_accessor.value(i);
-                double rel_hum = rel_hum_accessor.value(i);
-                double prec = p_corr.calc(prec_accessor.value(i));
-                state_collector.collect(i, state);///< \note collect the state at the beginning of each period (the end state is saved anyway)
-
-                hbv_snow.step(state.snow, response.snow, period.start, period.end, parameter.hs, prec, temp); // outputs mm/h, interpreted as over the entire area
-
-                response.gm_melt_m3s = glacier_melt::step(parameter.gm.dtf,temp,cell_area_m2*state.snow.sca,glacier_area_m2);// m3/s, that is, how much flow from the snow free glacier parts
-
-                response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(temp, rad, rel_hum)*calendar::HOUR;// mm/s -> mm/h, interpreted as over the entire area(!)
-                response.ae.ae = actual_evapotranspiration::calculate_step(state.kirchner.q, response.pt.pot_evapotranspiration,
-                                    parameter.ae.ae_scale_factor,std::max(state.snow.sca,glacier_fraction),  // a evap only on non-snow/non-glac area
-                                    period.timespan());
-
-                double gm_mmh= shyft::m3s_to_mmh(response.gm_melt_m3s, cell_area_m2);
-                kirchner.step(period.start, period.end, state.kirchner.q, response.kirchner.q_avg, response.snow.outflow + gm_routed*gm_mmh, response.ae.ae); //all units mm/h over 'same' area
-                response.total_discharge =
-                      std::max(0.0, prec - response.ae.ae)*direct_response_fraction // when it rains, remove ae. from direct response
-                    + gm_direct*gm_mmh  // glacier melt direct response
-                    + response.kirchner.q_avg*kirchner_fraction;
-                response.charge_m3s =
-                    + shyft::mmh_to_m3s(prec, cell_area_m2)
-                    - shyft::mmh_to_m3s(response.ae.ae, cell_area_m2)
-                    + response.gm_melt_m3s
-                    - shyft::mmh_to_m3s(response.total_discharge, cell_area_m2);
-                response.snow.snow_state=state.snow;//< note/sih: we need snow in the response due to calibration
-
-                // Possibly save the calculated values using the collector callbacks.
-                response_collector.collect(i, response);
-                if(i+1==i_end)
-                    state_collector.collect(i+1, state);///< \note last iteration,collect the  final state as well.
-
-            }
-            response_collector.set_end_response(response);
+            method_stack::run(stack, ctx, i_begin, i_end, state_collector, response_collector);
         }
     }
   } // core
@@ -55,6 +55,12 @@ namespace shyft {
                  : destination_area(destination_area), avg_discharge(time_axis, 0.0),charge_m3s(time_axis,0.0),
                    snow_outflow(time_axis, 0.0), snow_sca(time_axis,0.0),snow_swe(time_axis,0.0),glacier_melt(time_axis, 0.0), ae_output(time_axis, 0.0), pe_output(time_axis, 0.0) {}
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const {
+                    return series_heap_bytes(avg_discharge, charge_m3s, snow_outflow, snow_sca,
+                                             snow_swe, glacier_melt, ae_output, pe_output);
+                }
+
                 /**\brief called before run to allocate space for results */
                 void initialize(const timeaxis_t& time_axis, int start_step, int n_steps, double area) {
                     destination_area = area;
@@ -107,6 +113,9 @@ namespace shyft {
                     snow_sca(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0),
                     snow_swe(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0) {}
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const { return series_heap_bytes(avg_discharge, charge_m3s, snow_sca, snow_swe); }
+
                 void initialize(const timeaxis_t& time_axis,int start_step, int n_steps, double area) {
                     destination_area = area;
                     auto ta = collect_snow ? time_axis : timeaxis_t(time_axis.start(), time_axis.delta(), 0);
@@ -135,6 +144,7 @@ namespace shyft {
              * and we need all the RAM for useful purposes.
              */
             struct null_collector {
+                typedef std::true_type is_null_collector;///< collect calls are removed at compile time, ref. method_stack::collect
                 void initialize(const timeaxis_t& time_axis,int start_step=0,int n_steps=0,double area=0.0) {}
                 void collect(size_t i, const state_t& response) {}
             };
@@ -155,6 +165,9 @@ namespace shyft {
                 explicit state_collector(const timeaxis_t& time_axis)
                  : collect_state(false), destination_area(0.0), kirchner_discharge(time_axis, 0.0),
                     snow_swe(time_axis, 0.0), snow_sca(time_axis, 0.0) { /* Do nothing */ }
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const { return series_heap_bytes(kirchner_discharge, snow_swe, snow_sca); }
+
                 /** brief called before run, prepares state time-series
                  *
                  * with preallocated room for the supplied time-axis.
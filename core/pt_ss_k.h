@@ -16,6 +16,8 @@
 #include "glacier_melt.h"
 #include "unit_conversion.h"
 #include "routing.h"
+#include "cell_state_soa.h"
+#include "method_stack.h"
 namespace shyft {
   namespace core {
     namespace pt_ss_k {
@@ -159,6 +161,29 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief structure of arrays storage for pt_ss_k::state, ref. state_soa_base
+         *
+         * The fields are ordered snow.nu, snow.alpha, snow.sca, snow.swe, snow.free_water,
+         * snow.residual, snow.num_units (stored as double), kirchner.q
+         */
+        struct state_soa:state_soa_base<state_soa, state, 8> {
+            static void pack(const state& s, double* v) {
+                v[0] = s.snow.nu; v[1] = s.snow.alpha; v[2] = s.snow.sca; v[3] = s.snow.swe;
+                v[4] = s.snow.free_water; v[5] = s.snow.residual; v[6] = double(s.snow.num_units);
+                v[7] = s.kirchner.q;
+            }
+            static void unpack(const double* v, state& s) {
+                s.snow.nu = v[0]; s.snow.alpha = v[1]; s.snow.sca = v[2]; s.snow.swe = v[3];
+                s.snow.free_water = v[4]; s.snow.residual = v[5]; s.snow.num_units = size_t(v[6]);
+                s.kirchner.q = v[7];
+            }
+            /** \return the names of the fields, in order */
+            static std::vector<std::string> field_names() { return { "snow.nu", "snow.alpha", "snow.sca", "snow.swe", "snow.free_water", "snow.residual", "snow.num_units", "kirchner.q" }; }
+            std::vector<double>& snow_sca() { return f[2]; }
+            std::vector<double>& snow_swe() { return f[3]; }
+            std::vector<double>& q() { return f[7]; }
+        };
+
 
         struct response {
             // Model responses
@@ -177,8 +202,13 @@ namespace shyft {
         };
 
 
-        template<template <typename, typename> class A, class R, class T_TS, class P_TS,
-                 class WS_TS, class RH_TS, class RAD_TS, class T, class S, class GCD,
+        /** \brief run the pt_ss_k method stack for one cell
+         * \tparam KAC the kirchner average computer, ref. pt_gs_k::run_pt_gs_k
+         * \tparam SST the skaugen statistics, skaugen::statistics, or the faster skaugen::float_statistics or skaugen::tabulated_statistics
+         */
+        template<template <typename, typename> class A, class R, template <class> class KAC = kirchner::trapezoidal_average,
+                 class SST = skaugen::statistics,
+                 class T_TS, class P_TS, class WS_TS, class RH_TS, class RAD_TS, class T, class S, class GCD,
                  class P, class SC, class RC>
         void run(const GCD& geo_cell_data,
             const P& parameter,
@@ -217,29 +247,38 @@ namespace shyft {
             // Initialize the method stack
             precipitation_correction::calculator p_corr(parameter.p_corr.scale_factor);
             priestley_taylor::calculator pt(parameter.pt.albedo, parameter.pt.alpha);
-            skaugen::calculator<typename P::snow_parameter_t, typename S::snow_state_t, typename R::snow_response_t> skaugen_snow;
-            kirchner::calculator<kirchner::trapezoidal_average, typename P::kirchner_parameter_t> kirchner(parameter.kirchner);
+            skaugen::calculator<typename P::snow_parameter_t, typename S::snow_state_t, typename R::snow_response_t, SST> skaugen_snow;
+            kirchner::calculator<KAC, typename P::kirchner_parameter_t> kirchner(parameter.kirchner);
 
             size_t i_begin = n_steps > 0 ? start_step : 0;
             size_t i_end = n_steps > 0 ? start_step + n_steps : time_axis.size();
+            namespace prof = method_stack::profiling;
             for (size_t i = i_begin; i < i_end; ++i) {
+                prof::timer tm(prof::input);
                 utcperiod period = time_axis.period(i);
                 double temp = temp_accessor.value(i);
                 double rad = rad_accessor.value(i);
                 double rel_hum = rel_hum_accessor.value(i);
                 double prec = p_corr.calc(prec_accessor.value(i));
                 double wind_speed = wind_speed_accessor.value(i);
-                state_collector.collect(i, state);
+                tm.next(prof::collect);
+                method_stack::collect(state_collector, i, state);
 
+                tm.next(prof::snow);
                 skaugen_snow.step(period.timespan(), parameter.ss, temp, prec, rad, wind_speed, state.snow, response.snow);
+                tm.next(prof::glacier_melt);
                 response.gm_melt_m3s = glacier_melt::step(parameter.gm.dtf, temp, geo_cell_data.area()*state.snow.sca, glacier_area_m2);// m3/s, that is, how much flow from the snow free glacier parts
+                tm.next(prof::potential_evapotranspiration);
                 response.pt.pot_evapotranspiration = pt.potential_evapotranspiration(temp, rad, rel_hum)*calendar::HOUR;// mm/s -> mm/h, interpreted as over the entire area(!)
+                tm.next(prof::actual_evapotranspiration);
                 response.ae.ae = actual_evapotranspiration::calculate_step(state.kirchner.q, response.pt.pot_evapotranspiration,
                     parameter.ae.ae_scale_factor, std::max(state.snow.sca, glacier_fraction),  // a evap only on non-snow/non-glac area
                     period.timespan());
                 double gm_mmh= shyft::m3s_to_mmh(response.gm_melt_m3s, cell_area_m2);
+                tm.next(prof::response);
                 kirchner.step(period.start, period.end, state.kirchner.q, response.kirchner.q_avg, response.snow.outflow + gm_routed*gm_mmh, response.ae.ae); //all units mm/h over 'same' area
 
+                tm.next(prof::discharge);
                 response.total_discharge =
                       std::max(0.0, prec - response.ae.ae)*direct_response_fraction // when it rains, remove ae. from direct response
                     + gm_direct*gm_mmh  // glacier melt direct response
@@ -250,10 +289,11 @@ namespace shyft {
                     + response.gm_melt_m3s
                     - shyft::mmh_to_m3s(response.total_discharge, cell_area_m2);
                 // Possibly save the calculated values using the collector callbacks.
-                response_collector.collect(i, response);
+                tm.next(prof::collect);
+                method_stack::collect(response_collector, i, response);
 
                 if(i+1==i_end)
-                    state_collector.collect(i+1, state);///< \note last iteration,collect the  final state as well.
+                    method_stack::collect(state_collector, i+1, state);///< \note last iteration,collect the  final state as well.
             }
             response_collector.set_end_response(response);
         }
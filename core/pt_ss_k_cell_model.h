@@ -53,6 +53,12 @@ namespace shyft {
                    snow_outflow(time_axis, 0.0), glacier_melt(time_axis,0.0),ae_output(time_axis, 0.0), pe_output(time_axis, 0.0) {}
 
                 /**\brief Called before run to allocate space for results */
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const {
+                    return series_heap_bytes(avg_discharge, charge_m3s, snow_total_stored_water, snow_outflow,
+                                             glacier_melt, ae_output, pe_output);
+                }
+
                 void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
                     destination_area = area;
                     ts_init(avg_discharge           ,time_axis, start_step, n_steps, ts_point_fx::POINT_AVERAGE_VALUE);
@@ -104,6 +110,9 @@ namespace shyft {
                     snow_sca(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0),
                     snow_swe(timeaxis_t(time_axis.start(),time_axis.delta(),0),0.0)  {}
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const { return series_heap_bytes(avg_discharge, charge_m3s, snow_sca, snow_swe); }
+
                 void initialize(const timeaxis_t& time_axis,int start_step,int n_steps, double area) {
                     destination_area = area;
                     auto ta = collect_snow ? time_axis : timeaxis_t(time_axis.start(), time_axis.delta(), 0);
@@ -132,6 +141,7 @@ namespace shyft {
              * and we need all the RAM for useful purposes.
              */
             struct null_collector {
+                typedef std::true_type is_null_collector;///< collect calls are removed at compile time, ref. method_stack::collect
                 void initialize(const timeaxis_t& time_axis,int start_step=0,int n_steps=0, double area=0.0) {}
                 void collect(size_t i, const state_t& response) {}
             };
@@ -166,6 +176,9 @@ namespace shyft {
                    snow_residual(time_axis, 0.0)
                    { /* Do nothing */ }
 
+                /** approx. heap bytes of the collected series, ref. region_model::memory_usage */
+                size_t heap_bytes() const { return series_heap_bytes(kirchner_discharge, snow_swe, snow_sca, snow_alpha, snow_nu, snow_lwc, snow_residual); }
+
                 /** brief called before run, prepares state time-series with preallocated room
                  *  for the supplied time-axis.
                  *
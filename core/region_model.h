@@ -1,11 +1,15 @@
 #pragma once
 
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <array>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <algorithm>
+#include <numeric>
 #include <cmath>
 #include <limits>
 #include <future>
@@ -14,9 +18,14 @@
 #include <stdexcept>
 #include <future>
 #include <mutex>
+#include <chrono>
+#include <typeinfo>
 
 #include "bayesian_kriging.h"
 #include "inverse_distance.h"
+#include "kriging.h"
+#include "grid_remap.h"
+#include "timeline_trace.h"
 #include "kirchner.h"
 #include "gamma_snow.h"
 #include "priestley_taylor.h"
@@ -25,6 +34,12 @@
 #include "geo_cell_data.h"
 #include "routing.h"
 #include "model_state_tuning.h"
+#include "thread_pool.h"
+#include "cell_state_soa.h"
+#include "state_checkpoint.h"
+#include "catchment_accumulator.h"
+#include "method_stack.h"
+#include "autotune.h"
 
 /**
  * This file now contains mostly things to provide the PTxxK model,or
@@ -69,10 +84,20 @@ namespace shyft {
             btk::parameter temperature;
             bool use_idw_for_temperature = false;
             idw::temperature_parameter temperature_idw;
+            bool use_kriging_for_temperature = false;///< if true, local ordinary kriging is used for temperature, takes precedence over use_idw_for_temperature
+            kriging::ordinary::local_parameter temperature_kriging;
             idw::precipitation_parameter precipitation;
             idw::parameter wind_speed;
             idw::parameter radiation;
             idw::parameter rel_hum;
+            /** \brief when enabled, the sources of the signal are the nodes of a regular grid, like NWP output,
+             * remapped to the cells by grid weights instead of neighbour search, using the idw model of the signal for the transform
+             */
+            grid_remap::parameter temperature_grid;///< takes precedence over the other temperature methods, uses temperature_idw for the gradient
+            grid_remap::parameter precipitation_grid;
+            grid_remap::parameter radiation_grid;
+            grid_remap::parameter wind_speed_grid;
+            grid_remap::parameter rel_hum_grid;
 
             interpolation_parameter() {}
             interpolation_parameter(const btk::parameter& temperature,
@@ -182,6 +207,29 @@ namespace shyft {
         };
         ///< needs definition of the core time-series
         typedef shyft::time_series::point_ts<shyft::time_axis::fixed_dt> pts_t;
+
+        /** \brief the distance of (x,y) along the hilbert curve filling the 2^n_bits x 2^n_bits grid
+         *
+         * Points close on the curve are close in the plane, so ordering cells by it keeps
+         * neighbouring cells close in memory, ref. region_model::order_cells_spatially.
+         */
+        inline std::uint64_t hilbert_index(std::uint32_t x, std::uint32_t y, unsigned n_bits = 16) {
+            std::uint64_t d = 0;
+            for (std::uint32_t s = std::uint32_t(1) << (n_bits - 1); s > 0; s >>= 1) {
+                const std::uint32_t rx = (x & s) ? 1 : 0;
+                const std::uint32_t ry = (y & s) ? 1 : 0;
+                d += std::uint64_t(s)*s*((3*rx) ^ ry);
+                if (ry == 0) {// rotate the quadrant
+                    if (rx == 1) {
+                        x = s - 1 - (x & (s - 1));
+                        y = s - 1 - (y & (s - 1));
+                    }
+                    std::swap(x, y);
+                }
+            }
+            return d;
+        }
+
         /** \brief region_model is the calculation model for a region, where we can have
         * one or more catchments.
         * The role of the region_model is to describe region, so that we can run the
@@ -219,12 +267,34 @@ namespace shyft {
         protected:
 
             cell_vec_t_ cells;///< a region consists of cells that orchestrate the distributed correlation
+            std::shared_ptr<const cell_vec_t> env_base;///< if set, the cells of the base model, that provides the env_ts of the cells, ref. fork
             parameter_t_ region_parameter;///< applies to all cells, except those with catchment override
             std::map<int, parameter_t_> catchment_parameters;///<  for each catchment (with cid) parameter is possible
 
             std::vector<bool> catchment_filter;///<if active (alias .size()>0), only calc if catchment_filter[catchment_id] is true.
+            std::vector<size_t> calc_cells;///< when catchment_filter is active, the ascending indices of the cells it calculates, ref. update_calc_cells
             std::vector<int> cix_to_cid;///< maps internal zero-based catchment index ix to externally supplied catchment id.
             std::map<int,int> cid_to_cix;///< map external catchment id to internal index
+            std::vector<std::vector<size_t>> catchment_cells;///< catchment_cells[cix] is the ascending indices of the cells of catchment cix, ref. update_catchment_cells
+            geo_cell_table geo_table;///< packed copy of the geo of the cells, rebuilt when the model maps or reorders the cells, ref. get_geo_cell_table
+
+            /** rebuild calc_cells from catchment_filter, ascending, so the cells are visited in memory order */
+            void update_calc_cells() {
+                calc_cells.clear();
+                if (catchment_filter.empty())
+                    return;
+                if (geo_table.size() != cells->size())
+                    update_geo_table();
+                const auto& cix = geo_table.catchment_ix;
+                for (size_t i = 0; i < cix.size(); ++i)
+                    if (catchment_filter[cix[i]])
+                        calc_cells.push_back(i);
+            }
+
+            /** rebuild geo_table from the geo of the cells */
+            void update_geo_table() {
+                geo_table = geo_cell_table::of_cells(*cells);
+            }
 
             void update_ix_to_id_mapping() {
                 // iterate over cell-vector
@@ -242,15 +312,54 @@ namespace shyft {
 						c.geo.catchment_ix = found->second;// assign corresponding ix.
 					}
                 }
+                update_geo_table();
+                update_catchment_cells();
             }
 
-            size_t n_catchments=0;///< optimized//extracted as max(cell.geo.catchment_id())+1 in run interpolate
+            /** rebuild catchment_cells from the catchment_ix of the cells, ascending, so each catchment is visited in memory order */
+            void update_catchment_cells() {
+                catchment_cells = make_catchment_cells();
+            }
+            std::vector<std::vector<size_t>> make_catchment_cells() const {
+                std::vector<std::vector<size_t>> r(cix_to_cid.size());
+                for (size_t i = 0; i < cells->size(); ++i)
+                    if ((*cells)[i].geo.catchment_ix < r.size())
+                        r[(*cells)[i].geo.catchment_ix].push_back(i);
+                return r;
+            }
+            /** \return true if catchment_cells agrees with the catchment_ix of the cells, that are public, and could be changed */
+            bool catchment_cells_current() const {
+                size_t n = 0;
+                for (size_t k = 0; k < catchment_cells.size(); ++k)
+                    for (auto i : catchment_cells[k]) {
+                        if (i >= cells->size() || (*cells)[i].geo.catchment_ix != k)
+                            return false;
+                        ++n;
+                    }
+                return n == cells->size();
+            }
 
-            void clone(const region_model& c) {
+            size_t n_catchments=0;///< optimized//extracted as max(cell.geo.catchment_id())+1 in run interpolate
+            std::shared_ptr<work_stealing_pool> pool;///< if set, a private pool used for cells and interpolation, otherwise the process-wide executor is used
+            std::shared_ptr<catchment_accumulator> catchment_sums;///< only used if the cell response collector aggregates to catchments, ref. has_catchment_accumulator
+            std::vector<char> state_changed;///< cells that might differ from initial_state, valid when states_tracked
+            bool states_tracked = false;///< true when the cell states equals initial_state, except the state_changed cells, ref. revert_to_initial_state
+            std::vector<size_t> hru_reps;///< the ascending indices of the cells run for each unit, valid when hru_rep_of is not empty, ref. update_hru
+            std::vector<size_t> hru_rep_of;///< the cell run for each cell, itself for the representatives, empty unless the run has duplicates
+
+            void clone(const region_model& c, bool share_environment = false) {
                 // First, clear own content
                 ncore = c.ncore;
+                cell_chunk_size = c.cell_chunk_size;
+                autotune_threads = c.autotune_threads;
+                numa_partitioning = c.numa_partitioning;
+                hru_deduplication = c.hru_deduplication;
+                cache_idw_neighbours = c.cache_idw_neighbours;
+                idw_neighbours = c.idw_neighbours;// the tables are shared, and immutable
                 time_axis = c.time_axis;
                 catchment_filter = c.catchment_filter;
+                calc_cells = c.calc_cells;
+                original_cell_index = c.original_cell_index;
                 n_catchments = c.n_catchments;
 				ip_parameter = c.ip_parameter;
                 region_env = c.region_env;// todo: verify it is deep or shallow copy
@@ -258,9 +367,31 @@ namespace shyft {
                 // Then, clone from c
                 cix_to_cid=c.cix_to_cid;
                 cid_to_cix=c.cid_to_cix;
+                catchment_cells=c.catchment_cells;
+                geo_table = c.geo_table;
                 initial_state = c.initial_state;
-                cells = cell_vec_t_(new cell_vec_t(*(c.cells)));
+                state_changed = c.state_changed;
+                states_tracked = c.states_tracked;
+                checkpoint_ix = c.checkpoint_ix;
+                checkpoints = c.checkpoints;
+                if (share_environment) {// only geo, parameter and state, the collectors are set up by the next run
+                    cells = cell_vec_t_(new cell_vec_t());
+                    cells->reserve(c.cells->size());
+                    for (const auto& b : *c.cells) {
+                        cell_t x;
+                        x.geo = b.geo;
+                        x.parameter = b.parameter;
+                        x.state = b.state;
+                        cells->push_back(std::move(x));
+                    }
+                    env_base = c.env_base ? c.env_base : c.cells;
+                } else {
+                    cells = cell_vec_t_(new cell_vec_t(*(c.cells)));
+                    env_base = c.env_base;
+                }
                 river_network=c.river_network;
+                routing_state = c.routing_state;
+                uhgs = c.uhgs;// shared, keyed by value
                 set_region_parameter(*(c.region_parameter));
                 for(const auto& pair:c.catchment_parameters)
                     set_catchment_parameter(pair.first, *(pair.second));
@@ -299,18 +430,96 @@ namespace shyft {
                 ncore = thread::hardware_concurrency();
             }
             region_model(const region_model& model) { clone(model); }
+            struct fork_tag {};
+            region_model(const region_model& base, fork_tag) { clone(base, true); }
 			region_model& operator=(const region_model& c) {
                 if (&c != this)
                     clone(c);
                 return *this;
             }
+
+            /** \brief a what-if scenario fork of this model, that shares the interpolated environment of the cells
+             *
+             * The fork copies the geo, state and parameters of the cells, and the settings of this model,
+             * but not the env_ts and the collected series, so a fork costs the states and the responses of its own runs.
+             * Each cell of the fork runs with the env_ts of the corresponding cell of this model,
+             * so forks can run concurrently, with changed parameters or states, as long as this model
+             * does not change its cells meanwhile.
+             * The environment is copy-on-write: interpolation, or initialize_cell_environment, on the fork gives it
+             * its own env_ts, as for a copy. Copies of a fork are forks of the same base.
+             * \note the cells of a fork have empty env_ts, while they share the environment
+             */
+            region_model fork() const { return region_model(*this, fork_tag()); }
+
+            /** \return true if the cells run with the env_ts of the base model, ref. fork */
+            bool shares_environment() const { return env_base != nullptr; }
             ///-- properties accessible to user
             timeaxis_t time_axis; ///<The time_axis as set from run_interpolation, determines the axis for run()..
             size_t ncore = 0; ///<< defaults to 4x hardware concurrency, controls number of threads used for cell processing
+            size_t cell_chunk_size = 0;///< number of cells in each work-item handed to the threads during run_cells, 0 means automatic
+            /** \brief if true, run_cells with use_ncore=0 tunes ncore and cell_chunk_size for this cell type, number of cells and machine
+             *
+             * Each of the first runs uses one of a few thread-count/chunk-size combinations, ref. autotune_candidates,
+             * and measures the run time per time-step. When all are measured, the fastest is kept in the autotune_store,
+             * and used by the following runs, also of other models of the same size, and of other processes if the store has a file.
+             * ncore and cell_chunk_size shows the setting of the last run.
+             * run_cells_timestep_major with batch_size=0 is tuned the same way, with the chunk size as batch_size.
+             */
+            bool autotune_threads = false;
+            /** \brief if true, cells are partitioned in one contiguous slab for each thread, that the thread owns.
+             *
+             * initialize_cell_environment and run_cells then processes each slab with the same thread, so the
+             * cell time-series are allocated (first-touched) and used on the same numa node.
+             * Other threads steal chunks of a slab only when they run out of work.
+             * Useful on multi-socket servers together with pinned threads, ref. executor::configure(n,true).
+             */
+            bool numa_partitioning = false;
+            /** \brief if true, run_cells simulates each set of identical cells, a hydrological response unit, once
+             *
+             * Cells are identical when they share the parameter, the land type fractions, elevation, radiation slope factor,
+             * the environment series and the state at the start of the run, as is common with coarse forcing.
+             * With the per cell response collectors they must also have the same area, and each duplicate gets
+             * the state and the collected series of its representative.
+             * With catchment aggregating collectors, ref. has_catchment_accumulator, they must be in the same catchment,
+             * while the area can differ, the representative adds the response of the whole unit, scaled by area.
+             * The units are found at the start of each run, a cost similar to reading the environment series once.
+             */
+            bool hru_deduplication = false;
+            /** \brief if true, the idw neighbour and weight tables are kept between run_interpolation calls
+             *
+             * The tables are recomputed only when the source or cell locations, or the idw parameters
+             * max_members, max_distance, distance_measure_factor or zscale changes.
+             * The memory used is about 12 bytes x max_members for each cell and idw signal.
+             */
+            bool cache_idw_neighbours = true;
 			interpolation_parameter ip_parameter;///< the interpolation parameter as passed to interpolate/run_interpolation
             region_env_t region_env;///< the region environment (shallow-copy?) as passed to the interpolation/run_interpolation
             std::vector<state_t> initial_state; ///< the initial state, set explicit, or by the first call to .set_states(..) or run_cells()
+            std::vector<size_t> checkpoint_ix;///< sorted time-axis indices where run_cells saves a checkpoint of all cell states, ref. set_checkpoints
+            state_checkpoint_ring<state_t> checkpoints;///< the checkpoints saved by run_cells, ref. run_cells_from_checkpoint
+            /** \brief the cycles and calls of each method stack routine, summed over the threads of the last run_cells
+             *
+             * Only counted when compiled with SHYFT_METHOD_STACK_PROFILING, ref. method_stack::profiling,
+             * otherwise all zero.
+             */
+            method_stack::profiling::counters stack_counters;
             routing::river_network river_network;///< the routing river_network, can be empty
+            /** \brief the routing state at the end of the last run, ref. routing::state
+             *
+             * Like the cell states, it can be saved, and set again before a later run, to continue the routing
+             * from the time of the state, without routing the history before it, ref. run_routing.
+             * Set it to an empty routing::state() to route from a cold start.
+             */
+            routing::state routing_state;
+            /** \brief the uhg weight vectors of cells and rivers, kept between runs, ref. routing::uhg_cache
+             *
+             * Shared with copies of the model, like those of the calibration, since the uhgs are immutable, and keyed by value.
+             */
+            std::shared_ptr<routing::uhg_cache> uhgs = std::make_shared<routing::uhg_cache>();
+            typedef typename routing::model<C>::flows routing_flows_t;
+        private:
+            mutable std::shared_ptr<const routing_flows_t> routing_cache;///< the flows of the last run, ref. routing_flows()
+        public:
             /** \brief compute and return number of catchments inspecting call cells.geo.catchment_id() */
             size_t number_of_catchments() const { return cix_to_cid.size(); }
 
@@ -332,6 +541,45 @@ namespace shyft {
                 }
                 return false;
             }
+            /** \brief approx. bytes used by the model, by part, ref. model_memory_usage
+             *
+             * To size a server, or choose between the float storage and the double cells, or the discharge and the complete collectors.
+             * The cells of a fork, ref. shares_environment, keep the env_ts of their base model, counted by the base.
+             */
+            model_memory_usage memory_usage() const {
+                model_memory_usage m;
+                if (cells) {
+                    m.cells = cells->capacity()*sizeof(cell_t) + geo_table.heap_bytes();
+                    for (const auto& c : *cells) {
+                        m.env_ts += heap_bytes(c.env_ts.temperature) + heap_bytes(c.env_ts.precipitation) + heap_bytes(c.env_ts.radiation)
+                                  + heap_bytes(c.env_ts.rel_hum) + heap_bytes(c.env_ts.wind_speed);
+                        m.response_collectors += heap_bytes(c.rc);
+                        m.state_collectors += heap_bytes(c.sc);
+                    }
+                }
+                if (catchment_sums)
+                    m.response_collectors += catchment_sums->heap_bytes();
+                m.states = initial_state.capacity()*sizeof(state_t) + checkpoints.heap_bytes();
+                for (const auto& t : idw_neighbours)
+                    m.interpolation_caches += t.heap_bytes();
+                if (auto f = std::atomic_load(&routing_cache)) {
+                    m.routing_caches += sizeof(*f) + f->routes.capacity()*sizeof(typename decltype(f->routes)::value_type);
+                    for (const auto* s : {&f->local_inflow, &f->upstream_inflow, &f->output_m3s})
+                        for (const auto& x : *s)
+                            m.routing_caches += sizeof(x) + 4*sizeof(void*) + heap_bytes(x.second);
+                }
+                if (uhgs)
+                    m.routing_caches += uhgs->heap_bytes();
+                return m;
+            }
+
+            /** \brief the packed geo of the cells, as of the last mapping of the catchments, or reordering of the cells
+             *
+             * Use it for scans of area, fractions or catchments over many cells, instead of touching each cell.
+             * \note if the geo of the cells are changed, call set_catchment_calculation_filter, or construct the model anew, to rebuild it
+             */
+            const geo_cell_table& get_geo_cell_table() const { return geo_table; }
+
             /**\brief extracts the geo-cell data part out from the cells */
             std::vector<geo_cell_data> extract_geo_cell_data() const {
                 std::vector<geo_cell_data> r; r.reserve(cells->size());
@@ -353,8 +601,15 @@ namespace shyft {
 			 * \return void
 			 */
 			void initialize_cell_environment(const timeaxis_t& time_axis) {
-				for (auto&c : *cells) {
-					c.init_env_ts(time_axis);
+				env_base.reset();// a fork gets its own environment, all of it set here
+				if (numa_partitioning) {
+					cell_pool()->parallel_for_partitioned(cells->size(), cell_chunk_size, [this, &time_axis](size_t i0, size_t i1) {
+						for (size_t i = i0; i < i1; ++i) (*cells)[i].init_env_ts(time_axis);
+					}, ncore);
+				} else {
+					for (auto&c : *cells) {
+						c.init_env_ts(time_axis);
+					}
 				}
 				n_catchments = number_of_catchments();// keep this/assume invariant..
 				this->time_axis = time_axis;
@@ -377,6 +632,20 @@ namespace shyft {
 			*/
 
 			bool interpolate(const interpolation_parameter& ip_parameter, const region_env_t& env, bool best_effort=true) {
+				ip_signal_mask_t ok;
+				return interpolate_signals(ip_parameter, env, best_effort, ip_signal_mask_t{{true, true, true, true, true}}, ok);
+			}
+
+            /** \brief signals of the interpolation step, index into ip_signal_mask_t */
+            enum ip_signal { ip_temperature = 0, ip_precipitation, ip_radiation, ip_wind_speed, ip_rel_hum, n_ip_signals };
+            typedef std::array<bool, n_ip_signals> ip_signal_mask_t;
+
+            /** \brief interpolate the signals in mask, leaving the other cell.env_ts signals untouched
+             * \param ok set to true for each signal in the mask that was interpolated without exceptions
+             * \sa interpolate
+             */
+			bool interpolate_signals(const interpolation_parameter& ip_parameter, const region_env_t& env, bool best_effort, const ip_signal_mask_t& mask, ip_signal_mask_t& ok) {
+				own_environment();
 				using namespace shyft::core;
 				using namespace std;
 				namespace idw = shyft::core::inverse_distance;
@@ -394,15 +663,14 @@ namespace shyft {
                     cell_t *cell;// ptr ok, because it's only within this scope, no life-time stuff needed, just ref
                     // support enough methods to make it look like a cell during idw/btk
                     geo_point mid_point()const {return cell->mid_point();}
+                    double area() const { return cell->geo.area(); }///< used by the conservative grid remap
                     //< support for the interpolation phase, executes before the cell-run
 			        void   set_temperature(size_t ix, double temperature_value) { cell->env_ts.temperature.set(ix, temperature_value); }
 			        ///< used by the radiation interpolation to adjust the local radiation with respect to idw sources.
 			        double slope_factor() const { return cell->geo.radiation_slope_factor(); }
                 };
                 std::vector<cell_proxy> cell_ps;cell_ps.reserve(cells->size());
-                for(auto&c:*cells)
-                    if(is_calculated_by_catchment_ix(c.geo.catchment_ix))
-                        cell_ps.emplace_back(&c);
+                for_each_calculated_cell([this, &cell_ps](size_t i) { cell_ps.emplace_back(&(*cells)[i]); });
 
 
 				typedef shyft::time_series::average_accessor<typename region_env_t::temperature_t::ts_t, timeaxis_t> temperature_tsa_t;
@@ -435,13 +703,28 @@ namespace shyft {
 				//  interpolated/distributed signal, e.g. temperature input from arome-data
 
 
-				auto btkx = async(launch::async, [&]() {
+				// each interpolation is an independent task, executed by the pool of the region-model
+				std::vector<std::function<void()>> ip_tasks;
+				ip_tasks.emplace_back([&]() {
 					if (env.temperature != nullptr) {
 						if (env.temperature->size()>1) {
-							if (ip_parameter.use_idw_for_temperature) {
+							if (ip_parameter.temperature_grid.enabled()) {
+								grid_remap::run_interpolation<idw_temperature_model_t, idw_compliant_temperature_gts_t>(
+									time_axis, *env.temperature, ip_parameter.temperature_grid, ip_parameter.temperature_idw, cell_ps,
+									[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.temperature.set(ix, value); },
+									idw_ncore(), cell_pool()
+								);
+							} else if (ip_parameter.use_kriging_for_temperature) {
+								kriging::ordinary::run_interpolation<idw_compliant_temperature_gts_t>(
+									time_axis, *env.temperature, ip_parameter.temperature_kriging, cell_ps,
+									[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.temperature.set(ix, value); },
+									idw_ncore(), idw_cache(ip_temperature), cell_pool()
+								);
+							} else if (ip_parameter.use_idw_for_temperature) {
 								idw::run_interpolation<idw_temperature_model_t, idw_compliant_temperature_gts_t>(
 									time_axis, *env.temperature, ip_parameter.temperature_idw, cell_ps,
-									[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.temperature.set(ix, value); }
+									[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.temperature.set(ix, value); },
+									idw_ncore(), idw_cache(ip_temperature), cell_pool()
 								);
 							} else {
 								btk::btk_interpolation<btk_tsa_t>(
@@ -450,59 +733,77 @@ namespace shyft {
 									);
 							}
 						} else {
-							// just one temperature ts. just a a clean copy to destinations
+							// just one temperature ts. just a a clean copy to destinations,
+							// for env_ts types like environment_shared_t, the cells share the values of temp_ts
 							btk_tsa_t tsa((*env.temperature)[0].ts, time_axis);
 							typename cell_t::env_ts_t::temperature_ts_t temp_ts(time_axis, 0.0);
 							for (size_t i = 0;i<time_axis.size();++i) {
 								temp_ts.set(i, tsa.value(i));
 							}
-							for (auto& c : *cells) {
-                                if(is_calculated_by_catchment_ix(c.geo.catchment_ix))
-								c.env_ts.temperature = temp_ts;
-							}
+							for_each_calculated_cell([this, &temp_ts](size_t i) { (*cells)[i].env_ts.temperature = temp_ts; });
 						}
 					}
 				});
 
-				auto idw_precip = async(launch::async, [&]() {
-					if (env.precipitation != nullptr)
+				ip_tasks.emplace_back([&]() {
+					if (env.precipitation == nullptr) return;
+					auto setter = [](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.precipitation.set(ix, value); };
+					if (ip_parameter.precipitation_grid.enabled())
+						grid_remap::run_interpolation<idw_precipitation_model_t, idw_compliant_precipitation_gts_t>(
+							time_axis, *env.precipitation, ip_parameter.precipitation_grid, ip_parameter.precipitation, cell_ps, setter, idw_ncore(), cell_pool());
+					else
 						idw::run_interpolation<idw_precipitation_model_t, idw_compliant_precipitation_gts_t>(
-							time_axis, *env.precipitation, ip_parameter.precipitation, cell_ps,
-							[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.precipitation.set(ix, value); }
-					);
+							time_axis, *env.precipitation, ip_parameter.precipitation, cell_ps, setter, idw_ncore(), idw_cache(ip_precipitation), cell_pool());
 				});
 
-				auto idw_radiation = async(launch::async, [&]() {
-					if (env.radiation != nullptr)
+				ip_tasks.emplace_back([&]() {
+					if (env.radiation == nullptr) return;
+					auto setter = [](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.radiation.set(ix, value); };
+					if (ip_parameter.radiation_grid.enabled())
+						grid_remap::run_interpolation<idw_radiation_model_t, idw_compliant_radiation_gts_t>(
+							time_axis, *env.radiation, ip_parameter.radiation_grid, ip_parameter.radiation, cell_ps, setter, idw_ncore(), cell_pool());
+					else
 						idw::run_interpolation<idw_radiation_model_t, idw_compliant_radiation_gts_t>(
-							time_axis, *env.radiation, ip_parameter.radiation, cell_ps,
-							[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.radiation.set(ix, value); }
-					);
+							time_axis, *env.radiation, ip_parameter.radiation, cell_ps, setter, idw_ncore(), idw_cache(ip_radiation), cell_pool());
 				});
 
-				auto idw_wind_speed = async(launch::async, [&]() {
-					if (env.wind_speed != nullptr)
+				ip_tasks.emplace_back([&]() {
+					if (env.wind_speed == nullptr) return;
+					auto setter = [](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.wind_speed.set(ix, value); };
+					if (ip_parameter.wind_speed_grid.enabled())
+						grid_remap::run_interpolation<idw_windspeed_model_t, idw_compliant_wind_speed_gts_t>(
+							time_axis, *env.wind_speed, ip_parameter.wind_speed_grid, ip_parameter.wind_speed, cell_ps, setter, idw_ncore(), cell_pool());
+					else
 						idw::run_interpolation<idw_windspeed_model_t, idw_compliant_wind_speed_gts_t>(
-							time_axis, *env.wind_speed, ip_parameter.wind_speed, cell_ps,
-							[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.wind_speed.set(ix, value); }
-					);
+							time_axis, *env.wind_speed, ip_parameter.wind_speed, cell_ps, setter, idw_ncore(), idw_cache(ip_wind_speed), cell_pool());
 				});
 
-				auto idw_rel_hum = async(launch::async, [&]() {
-					if (env.rel_hum != nullptr)
+				ip_tasks.emplace_back([&]() {
+					if (env.rel_hum == nullptr) return;
+					auto setter = [](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.rel_hum.set(ix, value); };
+					if (ip_parameter.rel_hum_grid.enabled())
+						grid_remap::run_interpolation<idw_relhum_model_t, idw_compliant_rel_hum_gts_t>(
+							time_axis, *env.rel_hum, ip_parameter.rel_hum_grid, ip_parameter.rel_hum, cell_ps, setter, idw_ncore(), cell_pool());
+					else
 						idw::run_interpolation<idw_relhum_model_t, idw_compliant_rel_hum_gts_t>(
-							time_axis, *env.rel_hum, ip_parameter.rel_hum, cell_ps,
-							[](cell_proxy &d, size_t ix, double value) { d.cell->env_ts.rel_hum.set(ix, value); }
-					);
+							time_axis, *env.rel_hum, ip_parameter.rel_hum, cell_ps, setter, idw_ncore(), idw_cache(ip_rel_hum), cell_pool());
 				});
-
-                bool btkx_ok=true,precip_ok=true,radiation_ok=true,wind_speed_ok=true,rel_hum_ok=true;
+				static const char* const ip_trace[] = {"interpolation.temperature", "interpolation.precipitation", "interpolation.radiation",
+				                                       "interpolation.wind_speed", "interpolation.rel_hum"};
+				std::vector<exception_ptr> ip_ex(ip_tasks.size());
+				cell_pool()->parallel_for(ip_tasks.size(), 1, [&ip_tasks, &ip_ex, &mask](size_t i0, size_t i1) {
+					for (size_t i = i0; i < i1; ++i) {
+						if (!mask[i]) continue;
+						trace::scope ts(ip_trace[i]);
+						try { ip_tasks[i](); } catch (...) { ip_ex[i] = current_exception(); }
+					}
+				});
+				for (size_t i = 0; i < ok.size(); ++i)
+					ok[i] = mask[i] && !ip_ex[i];
+                bool btkx_ok=!ip_ex[0],precip_ok=!ip_ex[1],radiation_ok=!ip_ex[2],wind_speed_ok=!ip_ex[3],rel_hum_ok=!ip_ex[4];
                 exception_ptr p_ex;
-				try {btkx.get();} catch(...) {p_ex=current_exception();btkx_ok=false;}
-				try {idw_precip.get();} catch(...) {p_ex=current_exception();precip_ok=false;}
-				try {idw_radiation.get();} catch(...) {p_ex=current_exception();radiation_ok=false;}
-				try {idw_wind_speed.get();} catch(...) {p_ex=current_exception();wind_speed_ok=false;}
-				try {idw_rel_hum.get();} catch(...) {p_ex=current_exception();rel_hum_ok=false;}
+                for (auto const& ex : ip_ex)
+                    if (ex) p_ex = ex;
 				if(!best_effort && p_ex)
 				    rethrow_exception(p_ex);
 				return btkx_ok && precip_ok && radiation_ok && wind_speed_ok && rel_hum_ok;
@@ -526,10 +827,51 @@ namespace shyft {
             *
             */
             bool run_interpolation(const interpolation_parameter& ip_parameter, const timeaxis_t& time_axis, const region_env_t& env, bool best_effort=true) {
-				initialize_cell_environment(time_axis);
-				return interpolate(ip_parameter, env);
+                if (!incremental_interpolation) {
+                    ip_fingerprint = interpolation_fingerprint();
+                    initialize_cell_environment(time_axis);
+                    return interpolate(ip_parameter, env);
+                }
+                own_environment();
+                auto fp = make_interpolation_fingerprint(ip_parameter, time_axis, env);
+                ip_signal_mask_t dirty;
+                const bool all_dirty = !ip_fingerprint.valid || time_axis != this->time_axis || fp.catchment_filter != ip_fingerprint.catchment_filter;
+                for (size_t k = 0; k < n_ip_signals; ++k)
+                    dirty[k] = all_dirty || !ip_fingerprint.ok[k] || fp.sources[k] != ip_fingerprint.sources[k]
+                               || !same_interpolation_parameter(ip_signal(k), ip_parameter, ip_fingerprint.ip);
+                ip_fingerprint.valid = false;// until the dirty signals are interpolated
+                if (all_dirty) {
+                    initialize_cell_environment(time_axis);
+                } else {
+                    for (auto& c : *cells) {
+                        if (dirty[ip_temperature]) c.env_ts.temperature.fill(shyft::nan);
+                        if (dirty[ip_precipitation]) c.env_ts.precipitation.fill(shyft::nan);
+                        if (dirty[ip_radiation]) c.env_ts.radiation.fill(shyft::nan);
+                        if (dirty[ip_wind_speed]) c.env_ts.wind_speed.fill(shyft::nan);
+                        if (dirty[ip_rel_hum]) c.env_ts.rel_hum.fill(shyft::nan);
+                    }
+                }
+                ip_signal_mask_t ok;
+                bool r = interpolate_signals(ip_parameter, env, best_effort, dirty, ok);
+                for (size_t k = 0; k < n_ip_signals; ++k)
+                    fp.ok[k] = dirty[k] ? ok[k] : ip_fingerprint.ok[k];
+                fp.valid = true;
+                ip_fingerprint = std::move(fp);
+                return r;
             }
 
+            /** \brief if true, run_interpolation only re-interpolates the signals where the sources or parameters changed
+             *
+             * The region_model keeps a fingerprint (a copy of the source locations, time-points and values, plus the
+             * interpolation parameters) for each of temperature, precipitation, radiation, wind_speed and rel_hum.
+             * When the time-axis and catchment calculation filter is unchanged, only signals where any of these
+             * differ are reset and interpolated, leaving the other cell.env_ts signals as they are.
+             * The incremental path passes best_effort on to the interpolation of the changed signals.
+             * \note if the cell.env_ts signals are modified outside run_interpolation, turn this off (default),
+             *       or call run_interpolation with a modified time-axis to force a complete interpolation.
+             */
+            bool incremental_interpolation = false;
+
             /** \brief run_cells calculations over specified time_axis
             *  the cell method stack is invoked for all the cells, using multicore up to a maximum number of
             *  tasks/cores. Notice that this implies that executing the cell method stack should have no
@@ -553,6 +895,314 @@ namespace shyft {
             *
             */
             void run_cells(size_t use_ncore=0, int start_step=0, int  n_steps=0) {
+                const bool tune = autotune_threads && use_ncore == 0;
+                const string kind = typeid(cell_t).name();
+                autotune_setting s;
+                if (tune) {
+                    s = tuner.next(kind, cells->size(), cell_pool()->size() + 1);
+                    if (s.n_threads) ncore = s.n_threads;
+                    cell_chunk_size = s.chunk_size;
+                }
+                use_ncore = prepare_run(use_ncore, start_step, n_steps);
+                const auto t0 = std::chrono::steady_clock::now();
+                run_segmented(start_step, n_steps, [this, use_ncore](int s0, int n) {
+                    parallel_run(time_axis, s0, n, begin(*cells), end(*cells), use_ncore);
+                    hru_fan_out(use_ncore);
+                });
+                if (tune) autotune_measured(kind, s, t0, start_step, n_steps);
+                run_routing(start_step,n_steps);
+            }
+
+            /** \brief configure checkpoints of the complete cell state during run_cells
+             *
+             * When set, run_cells (and run_cells_timestep_major) stops at each of the specified time-axis
+             * indices that are within the run, and saves the state of all cells in a fixed capacity
+             * ring-buffer. A later run can then resume from the nearest checkpoint using run_cells_from_checkpoint,
+             * e.g. to re-run the last days when new observations arrive, without re-running the spin-up period.
+             *
+             * \param ix_list time-axis indices where to take checkpoints, the state is valid at the start of the time-step,
+             *        so ix == time_axis.size() means the end-state.
+             * \param capacity max number of checkpoints to keep, 0 means ix_list.size()
+             * \note existing checkpoints are dropped. An empty ix_list turns off checkpointing.
+             */
+            void set_checkpoints(const std::vector<size_t>& ix_list, size_t capacity = 0) {
+                checkpoint_ix = ix_list;
+                std::sort(begin(checkpoint_ix), end(checkpoint_ix));
+                checkpoint_ix.erase(std::unique(begin(checkpoint_ix), end(checkpoint_ix)), end(checkpoint_ix));
+                checkpoints.reset(capacity ? capacity : checkpoint_ix.size());
+            }
+
+            /** \brief restore the cell states from the latest checkpoint at or before time-axis index ix, and run from there
+             *
+             * \param ix the time-axis index where the we need to (re)start, typically the first step with changed input
+             * \param use_ncore as for run_cells
+             * \return the time-axis index of the checkpoint used, the run is from there to the end of the time-axis
+             * \throw runtime_error if there is no usable checkpoint
+             */
+            size_t run_cells_from_checkpoint(size_t ix, size_t use_ncore = 0) {
+                if (ix > time_axis.size())
+                    throw runtime_error("region_model::run_cells_from_checkpoint: ix must be in range [0..time-axis size]");
+                auto cp = checkpoints.nearest(checkpoint_time(ix), time_axis.time(0));
+                if (!cp)
+                    throw runtime_error("region_model::run_cells_from_checkpoint: no checkpoint available at or before time-axis index " + to_string(ix));
+                if (cp->states.size() != cells->size())
+                    throw runtime_error("region_model::run_cells_from_checkpoint: checkpoint size does not match number of cells");
+                size_t cix = cp->t >= time_axis.total_period().end ? time_axis.size() : time_axis.index_of(cp->t);
+                if (checkpoint_time(cix) != cp->t)
+                    throw runtime_error("region_model::run_cells_from_checkpoint: checkpoint time is not aligned to the time-axis");
+                auto state_iter = begin(cp->states);
+                for (auto& cell : *cells) cell.set_state(*(state_iter++));
+                states_tracked = false;
+                if (cix < time_axis.size())
+                    run_cells(use_ncore, int(cix), int(time_axis.size() - cix));
+                return cix;
+            }
+
+            /** \brief run_cells using timestep-major execution over batches of cells
+             *
+             * Instead of running the complete time-axis for one cell before moving to the next,
+             * each worker takes a batch of cells, and advances all of them one time-step at the time.
+             * For long forecasts with many cells, this keeps the input and state of the batch hot in the cache.
+             * The cells of a batch sharing the parameter are stepped on their states in a structure of arrays,
+             * with the per time-step methods applied to all of them, ref. pt_gs_k::batch_stepper.
+             * The results are identical to run_cells, as the batch steppers do the same arithmetic as
+             * the cell steppers. Cell types that do not provide a batch stepper (cell::run_batch)
+             * are executed cell-major within the batch.
+             *
+             * \param use_ncore as for run_cells
+             * \param start_step as for run_cells
+             * \param n_steps as for run_cells
+             * \param batch_size number of cells in each batch, 0 means default (64)
+             */
+            void run_cells_timestep_major(size_t use_ncore=0, int start_step=0, int n_steps=0, size_t batch_size=0) {
+                const bool tune = autotune_threads && use_ncore == 0 && batch_size == 0;
+                const string kind = string(typeid(cell_t).name()) + "/timestep_major";
+                autotune_setting s;
+                if (tune) {
+                    s = tuner.next(kind, cells->size(), cell_pool()->size() + 1);
+                    if (s.n_threads) ncore = s.n_threads;
+                    batch_size = s.chunk_size;
+                }
+                use_ncore = prepare_run(use_ncore, start_step, n_steps);
+                if (batch_size == 0) batch_size = 64;
+                const auto t0 = std::chrono::steady_clock::now();
+                run_segmented(start_step, n_steps, [this, use_ncore, batch_size](int s0, int n) {
+                    method_stack::profiling::accumulator acc;
+                    const auto rl = run_list();
+                    cell_pool()->parallel_for(rl ? rl->size() : cells->size(), batch_size,
+                        [this, &acc, s0, n, rl](size_t i0, size_t i1) {
+                            std::vector<cell_t*> batch; batch.reserve(i1 - i0);
+                            for (size_t i = i0; i < i1; ++i) {
+                                const size_t ix = rl ? (*rl)[i] : i;
+                                batch.push_back(&(*cells)[ix]);
+                                if (env_base) batch.back()->env_ts = (*env_base)[ix].env_ts;
+                            }
+                            if (batch.size())
+                                acc.measure([&]() { cell_t::run_batch(time_axis, s0, n, batch.data(), batch.size()); });
+                            if (env_base)
+                                for (auto c : batch) c->env_ts = typename cell_t::env_ts_t();
+                        },
+                        use_ncore
+                    );
+                    stack_counters += acc.sum;
+                    hru_fan_out(use_ncore);
+                });
+                if (tune) autotune_measured(kind, s, t0, start_step, n_steps);
+                run_routing(start_step,n_steps);
+            }
+
+            /** \brief run an ensemble of region environments through the model, return the catchment discharges of each member
+             *
+             * Each member is run as run_interpolation(ip,time_axis,member), set from initial states, then run_cells.
+             * Members are executed concurrently on the shared executor. Each concurrent slot works on its own
+             * fork of this model, ref. fork, created on first need and reused for the following members, so the number of
+             * cell vector copies is bounded by max_concurrent, not by the number of members, and the collected series
+             * of this model are not copied.
+             * The parameters and geo_cell_data are the same for all members, and the state of this model is not changed.
+             *
+             * \tparam TSV vector of time-series type to receive the discharges, ref. catchment_discharges
+             * \param ip the interpolation parameter to use for all members
+             * \param members the region environment for each member
+             * \param s0 initial state for all cells, used at the start of each member
+             * \param max_concurrent max number of members to run at the same time, 0 means the size of the executor
+             * \param best_effort passed to run_interpolation
+             * \return catchment discharges, r[i] is the catchment_discharges for members[i]
+             * \throw runtime_error if s0 does not match the cells, or time_axis is not set
+             */
+            template <class TSV = std::vector<pts_t>>
+            std::vector<TSV> run_ensemble(const interpolation_parameter& ip, const std::vector<region_env_t>& members,
+                                          const std::vector<state_t>& s0, size_t max_concurrent = 0, bool best_effort = true) const {
+                if (s0.size() != cells->size())
+                    throw runtime_error("region_model::run_ensemble: length of the state vector must equal number of cells");
+                if (time_axis.size() == 0)
+                    throw runtime_error("region_model::run_ensemble: time_axis must be set, e.g. by .initialize_cell_environment");
+                std::vector<TSV> r(members.size());
+                if (members.size() == 0)
+                    return r;
+                if (max_concurrent == 0)
+                    max_concurrent = executor::size();
+                std::mutex mx;
+                std::vector<std::unique_ptr<region_model>> idle;// slot models ready for next member, bounded by max_concurrent
+                executor::instance()->parallel_for(members.size(), 1, [&](size_t i0, size_t i1) {
+                    std::unique_ptr<region_model> m;
+                    {
+                        std::lock_guard<std::mutex> lock(mx);
+                        if (idle.size()) {
+                            m = std::move(idle.back());
+                            idle.pop_back();
+                        }
+                    }
+                    if (!m)
+                        m.reset(new region_model(*this, fork_tag()));// the interpolation gives it its own environment
+                    for (size_t i = i0; i < i1; ++i) {
+                        m->set_states(s0);
+                        m->initial_state = s0;
+                        m->run_interpolation(ip, time_axis, members[i], best_effort);
+                        m->run_cells();
+                        m->catchment_discharges(r[i]);
+                    }
+                    std::lock_guard<std::mutex> lock(mx);
+                    idle.push_back(std::move(m));
+                }, max_concurrent);
+                return r;
+            }
+
+        private:
+            /** \brief the inputs of one signal for run_interpolation, compared exactly, nan equal to nan */
+            struct source_inputs {
+                bool given = false;///< the source vector was supplied
+                std::vector<double> v;///< x, y, z and the values of each source
+                std::vector<utctime> t;///< the number of points, the time-points and the end of the series of each source
+                bool operator==(const source_inputs& o) const {
+                    return given == o.given && t == o.t && v.size() == o.v.size()
+                        && std::equal(v.begin(), v.end(), o.v.begin(), [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); });
+                }
+                bool operator!=(const source_inputs& o) const { return !operator==(o); }
+            };
+
+            /** \brief keeps what was used for the most recent run_interpolation, ref. incremental_interpolation */
+            struct interpolation_fingerprint {
+                bool valid = false;
+                std::array<source_inputs, n_ip_signals> sources;
+                ip_signal_mask_t ok{{false, false, false, false, false}};///< signal was successfully interpolated
+                interpolation_parameter ip;
+                std::vector<int> catchment_filter;
+            };
+            interpolation_fingerprint ip_fingerprint;
+            std::array<idw::neighbour_table_cache, n_ip_signals> idw_neighbours;///< ref. cache_idw_neighbours
+
+            /** \return the number of threads each idw signal can use, all of them, the signals share the pool */
+            int idw_ncore() const { return ncore ? int(ncore) : -1; }
+
+            idw::neighbour_table_cache* idw_cache(ip_signal k) {
+                if (!cache_idw_neighbours) {
+                    idw_neighbours[k].clear();
+                    return nullptr;
+                }
+                return &idw_neighbours[k];
+            }
+
+            static void hash_combine(size_t& h, size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); }
+
+            /** \return a copy of the source locations, and the time-points and values of their series, empty for nullptr */
+            template <class V>
+            static source_inputs copy_source_inputs(const shared_ptr<V>& v) {
+                source_inputs r;
+                if (!v) return r;
+                r.given = true;
+                for (auto const& s : *v) {
+                    auto p = s.mid_point();
+                    r.v.push_back(p.x); r.v.push_back(p.y); r.v.push_back(p.z);
+                    auto const& ts = s.ts;
+                    const size_t n = ts.size();
+                    r.t.push_back(utctime(n));
+                    if (n == 0) continue;
+                    for (size_t i = 0; i < n; ++i) {
+                        const auto pt = ts.get(i);
+                        r.t.push_back(pt.t);
+                        r.v.push_back(pt.v);
+                    }
+                    r.t.push_back(ts.total_period().end);
+                }
+                return r;
+            }
+
+            interpolation_fingerprint make_interpolation_fingerprint(const interpolation_parameter& ip, const timeaxis_t& ta, const region_env_t& env) const {
+                interpolation_fingerprint fp;
+                fp.sources[ip_temperature] = copy_source_inputs(env.temperature);
+                fp.sources[ip_precipitation] = copy_source_inputs(env.precipitation);
+                fp.sources[ip_radiation] = copy_source_inputs(env.radiation);
+                fp.sources[ip_wind_speed] = copy_source_inputs(env.wind_speed);
+                fp.sources[ip_rel_hum] = copy_source_inputs(env.rel_hum);
+                fp.ip = ip;
+                for (size_t cix = 0; cix < catchment_filter.size(); ++cix)
+                    if (catchment_filter[cix]) fp.catchment_filter.push_back(int(cix));
+                return fp;
+            }
+
+            static bool same_interpolation_parameter(ip_signal k, const interpolation_parameter& a, const interpolation_parameter& b) {
+                switch (k) {
+                case ip_temperature: return a.use_idw_for_temperature == b.use_idw_for_temperature && a.temperature == b.temperature && a.temperature_idw == b.temperature_idw
+                                            && a.use_kriging_for_temperature == b.use_kriging_for_temperature && a.temperature_kriging == b.temperature_kriging
+                                            && a.temperature_grid == b.temperature_grid;
+                case ip_precipitation: return a.precipitation == b.precipitation && a.precipitation_grid == b.precipitation_grid;
+                case ip_radiation: return a.radiation == b.radiation && a.radiation_grid == b.radiation_grid;
+                case ip_wind_speed: return a.wind_speed == b.wind_speed && a.wind_speed_grid == b.wind_speed_grid;
+                case ip_rel_hum: return a.rel_hum == b.rel_hum && a.rel_hum_grid == b.rel_hum_grid;
+                default: return false;
+                }
+            }
+
+            /** \return the time where the state at the start of time-axis index ix is valid */
+            utctime checkpoint_time(size_t ix) const {
+                return ix < time_axis.size() ? time_axis.time(ix) : time_axis.total_period().end;
+            }
+
+            /** \brief run the cells from start_step, n_steps, split at the checkpoint_ix, saving the checkpoints
+             * \param run_segment callable(int start_step,int n_steps) that runs the cells for the specified range
+             */
+            template <class F>
+            void run_segmented(int start_step, int n_steps, F&& run_segment) {
+                if (checkpoint_ix.empty()) {
+                    run_segment(start_step, n_steps);
+                    return;
+                }
+                const size_t i_end = n_steps > 0 ? size_t(start_step + n_steps) : time_axis.size();
+                size_t i = size_t(start_step);
+                for (auto cix : checkpoint_ix) {
+                    if (cix < i) continue;
+                    if (cix > i_end) break;
+                    if (cix > i) {
+                        run_segment(int(i), int(cix - i));
+                        i = cix;
+                    }
+                    std::vector<state_t> s;
+                    get_states(s);
+                    checkpoints.put(checkpoint_time(cix), std::move(s));
+                }
+                if (i < i_end)
+                    run_segment(int(i), int(i_end - i));
+            }
+
+            /** the cell states now equals initial_state */
+            void track_states_from_initial_state() {
+                state_changed.assign(cells->size(), 0);
+                states_tracked = true;
+            }
+
+            autotuner tuner;///< ref. autotune_threads
+
+            /** \brief report the run time per time-step of the run with setting s, started at t0, to the tuner */
+            void autotune_measured(const string& kind, const autotune_setting& s, std::chrono::steady_clock::time_point t0, int start_step, int n_steps) {
+                const double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                const size_t n = n_steps ? size_t(n_steps) : time_axis.size() - size_t(start_step);
+                tuner.measured(kind, cells->size(), s, dt / double(std::max(size_t(1), n)));
+            }
+
+            /** \brief common checks for run_cells, and snap of initial state
+             * \return the number of threads to use
+             */
+            size_t prepare_run(size_t use_ncore, int start_step, int n_steps) {
                 if(use_ncore == 0) {
                     if(ncore==0) ncore=4;// a reasonable minimum..
                     use_ncore = ncore;
@@ -567,12 +1217,228 @@ namespace shyft {
                     throw runtime_error("region_model::run n_steps must be range[0..time-axis-steps]");
                 if (size_t(start_step + n_steps) > time_axis.size())
                     throw runtime_error("region_model::run start_step+n_steps must be within time-axis range");
-                if (initial_state.size() != cells->size())
+                if (initial_state.size() != cells->size()) {
                     get_states(initial_state); // snap the initial state here, unless it's already set by the user
-                parallel_run(time_axis,start_step,n_steps, begin(*cells), end(*cells),use_ncore);
-                run_routing(start_step,n_steps);
+                    track_states_from_initial_state();
+                }
+                if (states_tracked)
+                    for_each_calculated_cell([this](size_t i) { state_changed[i] = 1; });
+                stack_counters.clear();
+                prepare_catchment_sums(start_step, n_steps);
+                update_hru(use_ncore);
+                return use_ncore;
             }
 
+            /** \return the env_ts cell i runs with, that of the base model for a fork */
+            const typename cell_t::env_ts_t& env_of(size_t i) const { return env_base ? (*env_base)[i].env_ts : (*cells)[i].env_ts; }
+
+            /** \brief run cell i, for a fork with a copy of the env_ts of the base cell, released after the run */
+            void run_cell(size_t i, const timeaxis_t& time_axis, int start_step, int n_steps) {
+                auto& c = (*cells)[i];
+                if (!env_base) {
+                    c.run(time_axis, start_step, n_steps);
+                    return;
+                }
+                c.env_ts = (*env_base)[i].env_ts;
+                c.run(time_axis, start_step, n_steps);
+                c.env_ts = typename cell_t::env_ts_t();
+            }
+
+            /** \brief copy the environment of the base model to the cells, before the cells of a fork change it, ref. fork */
+            void own_environment() {
+                if (!env_base)
+                    return;
+                for (size_t i = 0; i < cells->size(); ++i)
+                    (*cells)[i].env_ts = (*env_base)[i].env_ts;
+                env_base.reset();
+            }
+
+            /** \return the cells to run, the unit representatives, or the filtered cells, nullptr for all */
+            const std::vector<size_t>* run_list() const {
+                if (hru_rep_of.size())
+                    return &hru_reps;
+                return catchment_filter.size() ? &calc_cells : nullptr;
+            }
+
+            /** \brief find the units of identical calculated cells for the run, ref. hru_deduplication */
+            void update_hru(size_t use_ncore) {
+                hru_reps.clear();
+                hru_rep_of.clear();
+                if (!hru_deduplication)
+                    return;
+                const bool by_area = !has_catchment_accumulator<typename cell_t::response_collector_t>::value;
+                std::vector<size_t> ix;
+                for_each_calculated_cell([&ix](size_t i) { ix.push_back(i); });
+                std::vector<size_t> h(ix.size());
+                cell_pool()->parallel_for(ix.size(), 0, [this, &ix, &h, by_area](size_t i0, size_t i1) {
+                    for (size_t k = i0; k < i1; ++k)
+                        h[k] = hru_hash((*cells)[ix[k]], env_of(ix[k]), by_area);
+                }, use_ncore);
+                std::vector<size_t> rep_of(cells->size());
+                std::iota(rep_of.begin(), rep_of.end(), size_t(0));
+                std::vector<double> unit_area(cells->size(), 0.0);
+                std::unordered_map<size_t, std::vector<size_t>> units;// hash -> the representatives
+                for (size_t k = 0; k < ix.size(); ++k) {
+                    const auto& c = (*cells)[ix[k]];
+                    const auto& e = env_of(ix[k]);
+                    auto& u = units[h[k]];
+                    auto r = std::find_if(u.begin(), u.end(), [this, &c, &e, by_area](size_t j) { return same_hru((*cells)[j], env_of(j), c, e, by_area); });
+                    if (r == u.end()) {
+                        u.push_back(ix[k]);
+                        hru_reps.push_back(ix[k]);
+                    } else {
+                        rep_of[ix[k]] = *r;
+                    }
+                    unit_area[rep_of[ix[k]]] += c.geo.area();
+                }
+                if (hru_reps.size() == ix.size()) {// no duplicates, run as usual
+                    hru_reps.clear();
+                    return;
+                }
+                hru_rep_of = std::move(rep_of);
+                set_hru_scale(unit_area);
+            }
+
+            /** \return hash of the properties compared by same_hru, except the state */
+            static size_t hru_hash(const cell_t& c, const typename cell_t::env_ts_t& env, bool by_area) {
+                size_t h = std::hash<const void*>()(c.parameter.get());
+                const auto& g = c.geo;
+                const auto& f = g.land_type_fractions_info();
+                std::hash<double> hd;
+                for (auto v : {g.mid_point().z, g.radiation_slope_factor(), f.glacier(), f.lake(), f.reservoir(), f.forest(), by_area ? g.area() : double(g.catchment_ix)})
+                    hash_combine(h, hd(v));
+                auto hash_ts = [&h, &hd](const auto& ts) {
+                    const size_t n = ts.size();
+                    hash_combine(h, n);
+                    for (size_t i = 0; i < n; ++i) {
+                        const double v = ts.value(i);
+                        hash_combine(h, std::isnan(v) ? size_t(0x7ff8) : hd(v));
+                    }
+                };
+                hash_ts(env.temperature);
+                hash_ts(env.precipitation);
+                hash_ts(env.radiation);
+                hash_ts(env.rel_hum);
+                hash_ts(env.wind_speed);
+                return h;
+            }
+
+            /** \return true if a and b gives the same response, ref. hru_deduplication */
+            static bool same_hru(const cell_t& a, const typename cell_t::env_ts_t& ea, const cell_t& b, const typename cell_t::env_ts_t& eb, bool by_area) {
+                const auto& ga = a.geo;
+                const auto& gb = b.geo;
+                const auto& fa = ga.land_type_fractions_info();
+                const auto& fb = gb.land_type_fractions_info();
+                if (a.parameter != b.parameter || ga.mid_point().z != gb.mid_point().z || ga.radiation_slope_factor() != gb.radiation_slope_factor()
+                    || fa.glacier() != fb.glacier() || fa.lake() != fb.lake() || fa.reservoir() != fb.reservoir() || fa.forest() != fb.forest()
+                    || (by_area ? ga.area() != gb.area() : ga.catchment_ix != gb.catchment_ix))
+                    return false;
+                auto same_ts = [](const auto& x, const auto& y) {
+                    const size_t n = x.size();
+                    if (n != y.size())
+                        return false;
+                    for (size_t i = 0; i < n; ++i) {
+                        const double u = x.value(i), v = y.value(i);
+                        if (u != v && !(std::isnan(u) && std::isnan(v)))
+                            return false;
+                    }
+                    return true;
+                };
+                return same_ts(ea.temperature, eb.temperature) && same_ts(ea.precipitation, eb.precipitation)
+                    && same_ts(ea.radiation, eb.radiation) && same_ts(ea.rel_hum, eb.rel_hum)
+                    && same_ts(ea.wind_speed, eb.wind_speed) && a.state == b.state;
+            }
+
+            /** the representatives of catchment aggregating collectors add the response of the unit area */
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<has_catchment_accumulator<RC>::value>::type set_hru_scale(const std::vector<double>& unit_area) {
+                for (auto r : hru_reps) {
+                    auto& c = (*cells)[r];
+                    c.rc.scale = c.geo.area() > 0.0 ? unit_area[r]/c.geo.area() : 1.0;
+                }
+            }
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<!has_catchment_accumulator<RC>::value>::type set_hru_scale(const std::vector<double>&) {}
+
+            /** \brief copy the results of the unit representatives to the other cells of the units */
+            void hru_fan_out(size_t use_ncore) {
+                if (hru_rep_of.empty())
+                    return;
+                cell_pool()->parallel_for(cells->size(), 0, [this](size_t i0, size_t i1) {
+                    for (size_t i = i0; i < i1; ++i) {
+                        const auto r = hru_rep_of[i];
+                        if (r == i)
+                            continue;
+                        auto& c = (*cells)[i];
+                        const auto& rc = (*cells)[r];
+                        c.state = rc.state;
+                        c.sc = rc.sc;
+                        copy_response(c, rc);
+                    }
+                }, use_ncore);
+            }
+            template <class RC = typename cell_t::response_collector_t>
+            static typename std::enable_if<!has_catchment_accumulator<RC>::value>::type copy_response(cell_t& c, const cell_t& r) { c.rc = r.rc; }
+            template <class RC = typename cell_t::response_collector_t>
+            static typename std::enable_if<has_catchment_accumulator<RC>::value>::type copy_response(cell_t&, const cell_t&) {}// the representative added the unit
+
+            /** \brief clear the catchment sums for the run, and wire the cells to them (catchment aggregating collectors only) */
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<has_catchment_accumulator<RC>::value>::type prepare_catchment_sums(int start_step, int n_steps) {
+                if (!catchment_sums)
+                    catchment_sums = std::make_shared<catchment_accumulator>();// not shared with clones
+                catchment_sums->reset(n_catchments, time_axis.size(), size_t(start_step), n_steps > 0 ? size_t(start_step + n_steps) : time_axis.size());
+                for (auto& c : *cells) {
+                    if (c.rc.accumulator != catchment_sums)
+                        c.rc.accumulator = catchment_sums;
+                    c.rc.catchment_ix = c.geo.catchment_ix;
+                    c.rc.scale = 1.0;// ref. set_hru_scale
+                }
+            }
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<!has_catchment_accumulator<RC>::value>::type prepare_catchment_sums(int, int) {}
+
+            template <class TSV>
+            void catchment_sum(TSV& cr, catchment_accumulator::response_ix r, std::true_type) const {
+                typedef typename TSV::value_type ts_t;
+                cr.clear();
+                cr.reserve(n_catchments);
+                const bool valid = catchment_sums && catchment_sums->n_catchments() == n_catchments && catchment_sums->n_steps() == time_axis.size();
+                for (size_t i = 0; i < n_catchments; ++i) {
+                    cr.emplace_back(ts_t(time_axis, 0.0));
+                    if (valid && is_calculated_by_catchment_ix(i))
+                        cr.back().add(pts_t(time_axis, catchment_sums->sum(i, r), ts_point_fx::POINT_AVERAGE_VALUE));
+                }
+            }
+
+            template <class TSV>
+            void catchment_sum(TSV& cr, catchment_accumulator::response_ix r, std::false_type) const {
+                typedef typename TSV::value_type ts_t;
+                cr.clear();
+                cr.reserve(n_catchments);
+                for (size_t i = 0; i < n_catchments; ++i) {
+                    cr.emplace_back(ts_t(time_axis, 0.0));
+                }
+                std::vector<std::vector<size_t>> rebuilt;
+                const auto* cc = &catchment_cells;
+                if (!catchment_cells_current()) {
+                    rebuilt = make_catchment_cells();
+                    cc = &rebuilt;
+                }
+                // each catchment sums its own cells, so the catchments are summed in parallel without merging
+                cell_pool()->parallel_for(std::min(n_catchments, cc->size()), 1, [this, &cr, r, cc](size_t k0, size_t k1) {
+                    for (size_t k = k0; k < k1; ++k) {
+                        if (!is_calculated_by_catchment_ix(k))
+                            continue;
+                        for (auto i : (*cc)[k]) {
+                            const auto& c = (*cells)[i];
+                            cr[k].add(r == catchment_accumulator::discharge ? c.rc.avg_discharge : c.rc.charge_m3s);
+                        }
+                    }
+                }, ncore);
+            }
+        public:
+
 			/**\brief state adjustment to achieve wanted/observed flow
 			 *
 			 * This function provides an easy and consistent way to adjust the
@@ -605,9 +1471,31 @@ namespace shyft {
                 adjust_state_model<region_model> a(*this,cids, start_step);
                 double q_adj=a.tune_flow(wanted_flow_m3s);
                 catchment_filter=old_catchment_filter;
+                update_calc_cells();
 				return q_adj;
 			}
 
+            /** \brief state adjustment to achieve the wanted/observed flow of each catchment
+             *
+             * As adjust_state_to_target_flow, but each catchment of cids is tuned to its own flow, and all of them
+             * are solved together, so each iteration of the search is one time-step run of the selected cells,
+             * ref. adjust_state_model::tune_flows.
+             *
+             * \param wanted_flow_m3s the average flow first time-step we want to achieve, one for each catchment of cids
+             * \param cids catchments, represented by catchment-ids that should be adjusted
+             * \param start_step, specifies the time_axis start-step/period to use during adjustment
+             * \return obtained flow in m3/s units, for each catchment of cids
+             * \throw runtime_error if the number of wanted flows and catchments differ
+             */
+            std::vector<double> adjust_state_to_target_flows(const std::vector<double>& wanted_flow_m3s, const std::vector<int>& cids, size_t start_step = 0) {
+                auto old_catchment_filter = catchment_filter;
+                adjust_state_model<region_model> a(*this, cids, start_step);
+                auto q_adj = a.tune_flows(wanted_flow_m3s);
+                catchment_filter = old_catchment_filter;
+                update_calc_cells();
+                return q_adj;
+            }
+
             /** \brief set the region parameter, apply it to all cells
              *        that do not have catchment specific parameters.
              * \note that if there already exist a region parameter
@@ -697,7 +1585,8 @@ namespace shyft {
                 } else {
                     catchment_filter.clear();
                 }
-
+                update_geo_table();// the geo of the cells are public, so pick up changes
+                update_calc_cells();
             }
 
             /** \brief set/reset the catchment and river based calculation filter.
@@ -717,6 +1606,8 @@ namespace shyft {
                         catchment_filter[cid_to_cix[cid]] = true;// then assign true
                     }
                 }
+                update_geo_table();
+                update_calc_cells();
             }
 
             /**compute the unique set of catchments feeding into this river_id, or any river upstream */
@@ -743,6 +1634,79 @@ namespace shyft {
 
             bool is_calculated_by_catchment_ix(size_t cix) const {return catchment_filter.size() == 0 || (catchment_filter[cix]);}
 
+            /** \brief call fx(i) with the index i of each cell calculated by the catchment filter, in ascending order
+             *
+             * With an active filter, only the indices kept by set_catchment_calculation_filter are visited,
+             * so a filter selecting a few catchments of a large region costs just those cells.
+             */
+            template <class F>
+            void for_each_calculated_cell(F&& fx) const {
+                if (catchment_filter.empty()) {
+                    for (size_t i = 0; i < cells->size(); ++i) fx(i);
+                } else {
+                    for (auto i : calc_cells) fx(i);
+                }
+            }
+
+            /** \brief reorder the cells, grouped by catchment, along a hilbert curve over their mid-points
+             *
+             * Cells arrive in the order of the repository, while the idw neighbours of nearby cells share sources,
+             * and the catchment sums visit the cells of one catchment, so keeping them close in memory
+             * improves the locality of run_interpolation, run_cells and catchment_discharges.
+             * The catchments keep their order of first appearance, so the catchment indices are unchanged.
+             * The cells are permuted in place, the cell vector is shared, so the change is seen by all that shares it.
+             * The cell states, initial_state and the calculation filter follows the cells, while the checkpoints
+             * and the cached idw-neighbours are dropped, and the next run_interpolation recomputes all signals.
+             *
+             * \note results by cell, like get_states, or the cells itself, are in the new order,
+             *  use original_cell_index to map them back to the order of the cells as passed
+             */
+            void order_cells_spatially() {
+                const size_t n = cells->size();
+                if (n < 2)
+                    return;
+                own_environment();
+                double x0 = std::numeric_limits<double>::max(), y0 = x0, x1 = -x0, y1 = -x0;
+                for (const auto& c : *cells) {
+                    const auto p = c.geo.mid_point();
+                    x0 = std::min(x0, p.x); x1 = std::max(x1, p.x);
+                    y0 = std::min(y0, p.y); y1 = std::max(y1, p.y);
+                }
+                const double g = double((1u << 16) - 1);
+                const double fx = x1 > x0 ? g/(x1 - x0) : 0.0;
+                const double fy = y1 > y0 ? g/(y1 - y0) : 0.0;
+                std::vector<std::pair<std::uint64_t, size_t>> key(n);
+                for (size_t i = 0; i < n; ++i) {
+                    const auto& c = (*cells)[i];
+                    const auto p = c.geo.mid_point();
+                    const auto h = hilbert_index(std::uint32_t((p.x - x0)*fx), std::uint32_t((p.y - y0)*fy));
+                    key[i] = std::make_pair((std::uint64_t(c.geo.catchment_ix) << 32) | h, i);
+                }
+                std::stable_sort(key.begin(), key.end());
+                std::vector<size_t> ix(n);
+                for (size_t i = 0; i < n; ++i) ix[i] = key[i].second;
+                auto permuted = [&ix](auto& v) {
+                    std::remove_reference_t<decltype(v)> r; r.reserve(v.size());
+                    for (auto i : ix) r.push_back(std::move(v[i]));
+                    v = std::move(r);
+                };
+                permuted(*cells);
+                if (initial_state.size() == n) permuted(initial_state);
+                if (state_changed.size() == n) permuted(state_changed);
+                if (original_cell_index.size() == n) permuted(original_cell_index);
+                else original_cell_index = std::move(ix);
+                checkpoints.clear();
+                for (auto& t : idw_neighbours) t.clear();
+                ip_fingerprint.valid = false;
+                std::atomic_store(&routing_cache, std::shared_ptr<const routing_flows_t>());
+                update_geo_table();
+                update_calc_cells();
+                update_catchment_cells();
+            }
+
+            /** \brief original_cell_index[i] is the index, in the cells as passed, of cell i, empty unless reordered, ref. order_cells_spatially */
+            std::vector<size_t> original_cell_index;
+
             size_t cix_from_cid(size_t cid) const {
                 auto cix=cid_to_cix.find(cid);
                 if(cix == cid_to_cix.end())
@@ -772,15 +1736,62 @@ namespace shyft {
                     throw runtime_error("Length of the state vector must equal number of cells");
                 auto state_iter = begin(states);
                 for(auto& cell:*cells) cell.set_state(*(state_iter++));
+                states_tracked = false;
                 if (initial_state.size() != states.size())
                     initial_state = states;// if first time, or different copy the state
             }
+            /** \brief collects current state from all the cells into a structure of arrays
+             * \tparam SOA state_soa type for the method stack, e.g. pt_gs_k::state_soa, ref. state_soa_base
+             * \param soa resized to the number of cells, and filled in order of appearance
+             */
+            template <class SOA>
+            void get_states_soa(SOA& soa) const {
+                gather_states(begin(*cells), end(*cells), soa);
+            }
+
+            /** \brief set current state for all the cells in the model from a structure of arrays
+             * \note like set_states, the first call also establishes the initial_state
+             * \throw runtime_error if soa.size() is different from cells.size
+             */
+            template <class SOA>
+            void set_states_soa(const SOA& soa) {
+                scatter_states(soa, begin(*cells), end(*cells));
+                states_tracked = false;
+                if (initial_state.size() != soa.size())
+                    initial_state = soa.to_vector();
+            }
+
             /**\brief revert cell states to the initial state (if it exists)
-            */
+             *
+             * Only the states of the cells changed since the last revert are copied, that is the cells calculated
+             * by run_cells, ref. set_catchment_calculation_filter, and the cells of adjust_q.
+             * Any other change of the states, like set_states, makes the next revert copy all the states.
+             * \note after changing the state of cells directly, use mark_state_changed or forget_state_changes
+             */
             void revert_to_initial_state() {
                 if (initial_state.size() == 0)
                     throw runtime_error("Initial state not yet established or set");
-                set_states(initial_state);
+                if (!states_tracked || initial_state.size() != cells->size()) {
+                    set_states(initial_state);
+                } else {
+                    for (size_t i = 0; i < cells->size(); ++i)
+                        if (state_changed[i])
+                            (*cells)[i].set_state(initial_state[i]);
+                }
+                track_states_from_initial_state();
+            }
+
+            /** \brief note that the state of cell i is changed directly, e.g. by cell.state.adjust_q(), ref. revert_to_initial_state */
+            void mark_state_changed(size_t i) {
+                if (states_tracked) state_changed[i] = 1;
+            }
+
+            /** \brief forget which cells are changed, so that the next revert_to_initial_state copies all cell states */
+            void forget_state_changes() { states_tracked = false; }
+
+            /** \return the number of cells the next revert_to_initial_state copies */
+            size_t n_changed_states() const {
+                return states_tracked ? size_t(std::count(begin(state_changed), end(state_changed), char(1))) : cells->size();
             }
 
             /** \brief adjust the content of ground storage by scale-factor
@@ -795,9 +1806,11 @@ namespace shyft {
             * \param cids if empty, all cells are in scope, otherwise only cells that have specified catchment ids.
             */
             void adjust_q(double q_scale,vector<int>&cids ) {
-                for(auto& cell:*cells) {
+                for(size_t i = 0; i < cells->size(); ++i) {
+                    auto& cell = (*cells)[i];
                     if(cids.size()==0 || (find(begin(cids),end(cids),cell.geo.catchment_id())!=end(cids) )) {
                         cell.state.adjust_q(q_scale);
+                        mark_state_changed(i);
                     }
                 }
             }
@@ -838,31 +1851,30 @@ namespace shyft {
              */
             template <class TSV>
             void catchment_discharges( TSV& cr) const {
-                typedef typename TSV::value_type ts_t;
-                cr.clear();
-                cr.reserve(n_catchments);
-                for(size_t i=0;i<n_catchments;++i) {
-                    cr.emplace_back(ts_t(time_axis, 0.0));
-                }
-                for(const auto& c: *cells) {
-                    if ( is_calculated_by_catchment_ix(c.geo.catchment_ix))
-                        cr[c.geo.catchment_ix].add(c.rc.avg_discharge);
-                }
+                catchment_sum(cr, catchment_accumulator::discharge, has_catchment_accumulator<typename cell_t::response_collector_t>());
             }
 
+            /** \brief catchment_charges, as catchment_discharges, but for the charge [m3/s] */
             template <class TSV>
             void catchment_charges(TSV& cr) const {
-                typedef typename TSV::value_type ts_t;
-                cr.clear();
-                cr.reserve(n_catchments);
-                for (size_t i = 0;i < n_catchments;++i) {
-                    cr.emplace_back(ts_t(time_axis, 0.0));
-                }
-                for (const auto& c : *cells) {
-                    if (is_calculated_by_catchment_ix(c.geo.catchment_ix)) {
-                        cr[c.geo.catchment_ix].add(c.rc.charge_m3s);
-                    }
-                }
+                catchment_sum(cr, catchment_accumulator::charge, has_catchment_accumulator<typename cell_t::response_collector_t>());
+            }
+
+            /** \brief add the accumulated response r of the catchments cids to v, for cells that aggregate to catchments
+             *
+             * Reads the merged catchment sums directly, without creating a time-series for each catchment, ref. has_catchment_accumulator.
+             * \param cids the catchment ids to sum
+             * \param r the response, snow_sca and snow_swe are value x area sums, ref. set_snow_sca_swe_collection
+             * \param v resized to time_axis.size() if needed, and the sums added
+             * \return false if there are no valid sums, from a run with the current time_axis and catchments
+             */
+            bool add_catchment_sum(const std::vector<int>& cids, catchment_accumulator::response_ix r, std::vector<double>& v) const {
+                v.resize(time_axis.size(), 0.0);
+                if (!(catchment_sums && catchment_sums->n_catchments() == n_catchments && catchment_sums->n_steps() == time_axis.size()))
+                    return false;
+                for (auto cid : cids)
+                    catchment_sums->add_sum_to(cix_from_cid(cid), r, v.data());
+                return true;
             }
 
             /**\brief return all discharges at the output of the routing points
@@ -874,45 +1886,59 @@ namespace shyft {
              */
             template <class TSV>
             void routing_discharges( TSV& cr) const {
-                //typedef typename TSV::value_type ts_t;
                 cr.clear();
                 if(has_routing()) {
-                    //TODO: iterate over the routing model, return results
-                    routing::model<C> rn(river_network,cells,time_axis);
-                    std::vector<int> rids;
-                    for(auto r:river_network.rid_map)
-                        rids.push_back(r.first);
-                    std::sort(begin(rids),end(rids));// ascending order!
-                    for(auto rid:rids) {
-                        cr.emplace_back(rn.output_m3s(rid));
-                    }
+                    auto f = routing_flows();
+                    for(const auto& r : f->output_m3s)// std::map, so ascending routing id order
+                        cr.emplace_back(r.second);
                 }
-                return cr;
             }
             std::shared_ptr<pts_t> river_output_flow_m3s(int rid) const {
                 auto r= std::make_shared<pts_t>(time_axis,0.0,time_series::ts_point_fx::POINT_AVERAGE_VALUE);
                 if(has_routing()) {
-                    routing::model<C> rn(river_network,cells,time_axis);
-                    r=std::make_shared<pts_t>(rn.output_m3s(rid));
+                    river_network.check_rid(rid);
+                    r=std::make_shared<pts_t>(routing_flows()->output_m3s.find(rid)->second);
                 }
                 return r;
             }
             std::shared_ptr<pts_t> river_upstream_inflow_m3s(int rid) const {
                 auto r= std::make_shared<pts_t>(time_axis,0.0,time_series::ts_point_fx::POINT_AVERAGE_VALUE);
                 if(has_routing()) {
-                    routing::model<C> rn(river_network,cells,time_axis);
-                    r=std::make_shared<pts_t>(rn.upstream_inflow(rid));
+                    river_network.check_rid(rid);
+                    r=std::make_shared<pts_t>(routing_flows()->upstream_inflow.find(rid)->second);
                 }
                 return r;
             }
             std::shared_ptr<pts_t> river_local_inflow_m3s(int rid) const {
                 auto r= std::make_shared<pts_t>(time_axis,0.0,time_series::ts_point_fx::POINT_AVERAGE_VALUE);
                 if(has_routing()) {
-                    routing::model<C> rn(river_network,cells,time_axis);
-                    r=std::make_shared<pts_t>(rn.local_inflow(rid));
+                    river_network.check_rid(rid);
+                    r=std::make_shared<pts_t>(routing_flows()->local_inflow.find(rid)->second);
                 }
                 return r;
             }
+
+            /** \brief the flows of all rivers, as routed by the last run, ref. routing::model::evaluate
+             *
+             * The result is kept until the next run_cells, so queries for several rivers share the same computation.
+             * If the river network or the cell routing is changed after the run, the flows are recomputed.
+             */
+            std::shared_ptr<const routing_flows_t> routing_flows() const {
+                auto rn = routing_model();
+                auto f = std::atomic_load(&routing_cache);
+                if (!f || !rn.is_current(*f)) {
+                    f = rn.evaluate(cell_pool());
+                    std::atomic_store(&routing_cache, f);
+                }
+                return f;
+            }
+
+            /** \return the routing model of the river network and cells, over the time-axis, using the uhgs cache */
+            routing::model<C> routing_model() const {
+                routing::model<C> rn(river_network, cells, time_axis);
+                rn.uhgs = uhgs;
+                return rn;
+            }
         protected:
             /** \brief parallell_run using a mid-point split + async to engange multicore execution
              *
@@ -927,19 +1953,19 @@ namespace shyft {
                         //& cell:boost::make_iterator_range(beg,endc)) {
 
                      if (is_calculated_by_catchment_ix(cell->geo.catchment_ix))
-                        cell->run(time_axis,start_step,n_steps);
+                        run_cell(size_t(cell - cells->begin()), time_axis, start_step, n_steps);
                 }
             }
-            /** \brief uses async to execute the single_run, partitioning the cell range into thread-cell count
+            /** \brief uses the persistent work_stealing_pool to execute the single_run, partitioning the cell range into chunks
              *
-             * \throw runtime_error if thread_cell_count is zero
+             * \throw runtime_error if use_ncore is zero
              * \return when all cells calculated
              * \param time_axis time-axis to use
              * \param start_step of time-axis
              * \param n_steps number of steps to run
              * \param 'beg' the beginning of the cell-range
              * \param 'endc' the end of cell range
-             * \param thread_cell_count number of cells given to each async thread
+             * \param use_ncore number of threads, including the calling thread, that works on the cells
              */
             void parallel_run(const timeaxis_t& time_axis, int start_step, int  n_steps, cell_iterator beg, cell_iterator endc,int use_ncore) {
                 size_t len = distance(beg, endc);
@@ -947,58 +1973,74 @@ namespace shyft {
                     return;
                 if(use_ncore == 0)
                     throw runtime_error("parallel_run: use_ncore is zero ");
-                vector<future<void>> calcs;
-                mutex pos_mx;
-                size_t pos = 0;
-                for (int i = 0;i < use_ncore;++i) { // using ncore = logical available core saturates cpu 100%
-                    calcs.emplace_back(
-                        async(launch::async,
-                            [this,&pos,&pos_mx,len,&time_axis,&beg,start_step,n_steps]() {
-                                while (true) {
-                                    size_t ci;
-                                    { lock_guard<decltype(pos_mx)> lock(pos_mx);// get work item here
-                                        if (pos < len)
-                                            ci = pos++;
-                                        else
-                                            break;
-                                    }
-                                    this->single_run(time_axis, start_step, n_steps, beg + ci, beg + ci + 1);// just for one cell
-                                }
-                            }
-                        )
-                    );
-                }
-                for(auto &f:calcs)
-                    f.get();
-                return;
-            }
-            void run_routing(int start_step,int n_steps) {
-                // TODO: implement
-                // things to consider:
-                //  a) start_step,n_steps could be a problem due to the time-delay/convolution window.
-                //     so data is not available through the convolution until after window-size.
-                //     possible solutions:
-                //         1) leave it to the user
-                //         2)  always run from start_step=0 ?
-                //         3) as the routing model for the largest delay counted in timesteps, start - longest delay
-                //  b) for convolution, we can base the approach on 'pull', calculate on demand, possibly with memory-cached result time-series
-                //     in that scenario, we would need a 'dirty' bit to be set (initially) and when starting the run-cells step.
-                //         1) optimization, maybe later
-                //  c) the catchment filter, based on cids, could also be extended to routing ids (rids).
-                //     also: if routing, only rids type of filter allowed ?
-                //           if rids, cell to rid is possibly multi-step lookup. Need to make a rids-filter, where members are all reachable
-                //           cells from wanted rids (to be calculated).
-                //         1) leave it to user
-                //         2) make alg. given rid's: compute cid's needed
-                //         3) if river_network available, deny cids based filter, insist on rids ?
-                //
-                //  d) consistency: if cids are used, and routing (and rids) are enabled, auto-extend the cids so that all connected cells(and corresponding cids)
-                //     are calculated (avoid partial calculation of something that goes into a routing network...
-                //     question: how much of this consistency/complexity should we put to the user setting the calculation filter
-                if(!has_routing())
+                method_stack::profiling::accumulator acc;
+                const auto rl = run_list();
+                if (rl && beg == cells->begin() && endc == cells->end()) {
+                    // only the cells of the filter, or the unit representatives, are handed to the threads, not the no-ops of the others
+                    if (rl->empty())
+                        return;
+                    auto fx = [this,rl,&acc,&time_axis,start_step,n_steps](size_t i0,size_t i1) {
+                        trace::scope ts("cells", i0, i1);
+                        acc.measure([&]() {
+                            for (size_t k = i0; k < i1; ++k)
+                                run_cell((*rl)[k], time_axis, start_step, n_steps);
+                        });
+                    };
+                    if (numa_partitioning)
+                        cell_pool()->parallel_for_partitioned(rl->size(), cell_chunk_size, fx, use_ncore);
+                    else
+                        cell_pool()->parallel_for(rl->size(), cell_chunk_size, fx, use_ncore);
+                    stack_counters += acc.sum;
                     return;
+                }
+                auto fx = [this,&acc,&time_axis,beg,start_step,n_steps](size_t i0,size_t i1) {
+                    trace::scope ts("cells", i0, i1);
+                    acc.measure([&]() { this->single_run(time_axis, start_step, n_steps, beg + i0, beg + i1); });
+                };
+                if (numa_partitioning)
+                    cell_pool()->parallel_for_partitioned(len, cell_chunk_size, fx, use_ncore);
+                else
+                    cell_pool()->parallel_for(len, cell_chunk_size, fx, use_ncore);
+                stack_counters += acc.sum;
+            }
 
+            /** \brief the pool to use for cells and interpolation, the private one if set, otherwise the process-wide executor
+             *
+             * The pool threads are persistent, so repeated runs, like during calibration, do not pay thread start-up cost,
+             * and several region-models in the same process share the same bounded set of threads.
+             */
+            std::shared_ptr<work_stealing_pool> cell_pool() const {
+                return pool ? pool : executor::instance();
+            }
+            /** \brief route the cell discharges through the river network, and keep the flows for the routing queries
+             *
+             * Independent rivers, like the rivers of separate sub-basins, and the rivers of each level of a tree,
+             * are routed concurrently on the cell pool, ref. routing::model::evaluate.
+             * If the routing_state is valid at the start_step, the routing continues from it, computing only the steps
+             * from start_step, and the flows before start_step are kept from the previous run, if any.
+             * Otherwise the complete time-axis is routed, since the convolution window reaches into the steps before start_step.
+             * In both cases the routing_state is left at the end of the time-axis.
+             * \note cells aggregating their response to catchments, ref. has_catchment_accumulator, have no routing
+             */
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<!has_catchment_accumulator<RC>::value>::type run_routing(int start_step,int /*n_steps*/) {
+                std::shared_ptr<const routing_flows_t> f;
+                if (has_routing()) {
+                    trace::scope ts("routing");
+                    auto rn = routing_model();
+                    if (!routing_state.empty() && routing_state.dt == time_axis.delta() && routing_state.t == time_axis.time(size_t(start_step))) {
+                        auto prior = std::atomic_load(&routing_cache);
+                        f = rn.evaluate_from(cell_pool(), size_t(start_step), routing_state, prior.get());
+                    } else {
+                        routing_state = routing::state();
+                        f = rn.evaluate_from(cell_pool(), 0, routing_state);
+                    }
+                }
+                std::atomic_store(&routing_cache, f);
             }
+
+            template <class RC = typename cell_t::response_collector_t>
+            typename std::enable_if<has_catchment_accumulator<RC>::value>::type run_routing(int, int) {}
         };
 
     } // core
@@ -13,11 +13,13 @@
 #include <stdexcept>
 #include <future>
 #include <mutex>
+#include <tuple>
 #include <boost/math/distributions/gamma.hpp>
 
 #include "geo_cell_data.h"
 #include "time_axis.h"
 #include "time_series.h"
+#include "thread_pool.h"
 
 namespace shyft {
     namespace core {
@@ -75,10 +77,60 @@ namespace shyft {
                 double velocity= 1.0;///< in units of [m/s]
                 double alpha=7.0; ///< gamma function alpha factor
                 double beta =0.0; ///< base-line offset, added to pdf(gamma(alpha,1.0))
+                bool operator==(const uhg_parameter& o) const { return velocity == o.velocity && alpha == o.alpha && beta == o.beta; }
+                bool operator!=(const uhg_parameter& o) const { return !operator==(o); }
             };
 
             inline std::vector<double>  make_uhg_from_gamma(int n_steps, double alpha, double beta);// fwd decl
 
+            /** \brief thread-safe cache of uhg weight vectors, shared by the cells and rivers with the same uhg
+             *
+             * The uhg of make_uhg_from_gamma is given by the number of steps, alpha and beta only,
+             * where the steps are determined by distance, velocity and dt, so these are the key.
+             * A change of the routing parameters, or of the network, just leads to new keys,
+             * and the cache is cleared when it exceeds its capacity, like after many calibration iterations.
+             */
+            class uhg_cache {
+                typedef std::tuple<int, double, double> key_t;// n_steps, alpha, beta
+                std::map<key_t, std::shared_ptr<const std::vector<double>>> uhgs;
+                mutable std::mutex mx;
+            public:
+                size_t capacity;///< max number of uhgs kept
+                explicit uhg_cache(size_t capacity = 4096) : capacity(capacity) {}
+
+                /** \return the uhg of make_uhg_from_gamma(n_steps,alpha,beta), computed on first request */
+                std::shared_ptr<const std::vector<double>> get(int n_steps, double alpha, double beta) {
+                    const key_t k(n_steps, alpha, beta);
+                    {
+                        std::lock_guard<std::mutex> lock(mx);
+                        auto f = uhgs.find(k);
+                        if (f != uhgs.end())
+                            return f->second;
+                    }
+                    auto w = std::make_shared<const std::vector<double>>(make_uhg_from_gamma(n_steps, alpha, beta));
+                    std::lock_guard<std::mutex> lock(mx);
+                    if (uhgs.size() >= capacity)
+                        uhgs.clear();
+                    return uhgs.emplace(k, std::move(w)).first->second;
+                }
+                size_t size() const {
+                    std::lock_guard<std::mutex> lock(mx);
+                    return uhgs.size();
+                }
+                /** \return approx. heap bytes of the uhgs and the map */
+                size_t heap_bytes() const {
+                    std::lock_guard<std::mutex> lock(mx);
+                    size_t b = 0;
+                    for (const auto& u : uhgs)
+                        b += sizeof(u) + 4*sizeof(void*) + sizeof(std::vector<double>) + u.second->capacity()*sizeof(double);
+                    return b;
+                }
+                void clear() {
+                    std::lock_guard<std::mutex> lock(mx);
+                    uhgs.clear();
+                }
+            };
+
             ///< valid routing|river id, rid, must be >0. 0 or less than 0 is interpreted as null
             inline bool valid_routing_id(int rid ) {return rid>0;}
 
@@ -115,10 +167,17 @@ namespace shyft {
                  * and the velocity parameter. The shape of the uhg is determined by alpha&beta parameters.
                  */
                 std::vector<double> uhg(utctimespan dt) const {
+                    return make_uhg_from_gamma(uhg_steps(dt), parameter.alpha, parameter.beta);
+                }
+                /** \return the length of the uhg, in steps of dt, from the downstream distance and the velocity */
+                int uhg_steps(utctimespan dt) const {
                     double steps = (downstream.distance / parameter.velocity) / dt;// time = distance / velocity[s] // dt[s]
-                    int n_steps = int(steps + 0.5);
-                    return make_uhg_from_gamma(n_steps, parameter.alpha, parameter.beta);
+                    return int(steps + 0.5);
+                }
+                bool operator==(const river& o) const {
+                    return id == o.id && downstream.id == o.downstream.id && downstream.distance == o.downstream.distance && parameter == o.parameter;
                 }
+                bool operator!=(const river& o) const { return !operator==(o); }
             };
 
             /**
@@ -233,6 +292,49 @@ namespace shyft {
                     return rid_map.find(rid)->second.downstream.id;
                 }
 
+                /** \return all river ids, ordered so that each river comes after all of its upstream rivers
+                 * \throw runtime_error if the network contains a directed cycle
+                 */
+                std::vector<int> topological_order() const {
+                    std::map<int, size_t> n_upstreams;
+                    for (const auto& r : rid_map) n_upstreams[r.first];
+                    for (const auto& r : rid_map)
+                        if (valid_routing_id(r.second.downstream.id))
+                            ++n_upstreams[r.second.downstream.id];
+                    std::vector<int> order; order.reserve(rid_map.size());
+                    for (const auto& u : n_upstreams)
+                        if (u.second == 0) order.push_back(u.first);
+                    for (size_t i = 0; i < order.size(); ++i) {
+                        int downstream_id = int(rid_map.find(order[i])->second.downstream.id);
+                        if (valid_routing_id(downstream_id) && --n_upstreams[downstream_id] == 0)
+                            order.push_back(downstream_id);
+                    }
+                    if (order.size() != rid_map.size())
+                        throw std::runtime_error("the river network contains a directed cycle");
+                    return order;
+                }
+
+                /** \return the river ids in levels, where all upstream rivers of a river are in earlier levels,
+                 * so the rivers of one level are independent, and can be routed concurrently.
+                 * The first level is the rivers with no upstream rivers.
+                 */
+                std::vector<std::vector<int>> topological_levels() const {
+                    std::map<int, size_t> level;
+                    std::vector<std::vector<int>> r;
+                    for (int rid : topological_order()) {// all upstreams are visited before rid, so its level is final
+                        const size_t l = level[rid];
+                        if (r.size() <= l) r.resize(l + 1);
+                        r[l].push_back(rid);
+                        int downstream_id = int(rid_map.find(rid)->second.downstream.id);
+                        if (valid_routing_id(downstream_id))
+                            level[downstream_id] = std::max(level[downstream_id], l + 1);
+                    }
+                    return r;
+                }
+
+                bool operator==(const river_network& o) const { return rid_map == o.rid_map; }
+                bool operator!=(const river_network& o) const { return !operator==(o); }
+
                 void set_downstream_by_id(int rid,int downstream_rid) {
                     check_rid(rid);
                     if(valid_routing_id(downstream_rid))
@@ -247,6 +349,57 @@ namespace shyft {
                 }
             };
 
+            /** \brief the routing state at time t, the pending convolution tails of all rivers
+             *
+             * The uhg convolutions of the routing reach (uhg size - 1) steps ahead, so at time t the flows
+             * before t still contribute to the flows at t, t+dt, ..
+             * For each river, local_tail[rid][k] is the pending contribution of the cell discharges before t
+             * to the local inflow at t + k*dt, summed over all cells of the river, and output_tail[rid][k]
+             * likewise for the output of the river.
+             * Routing continued from t with this state, ref. model::evaluate_from, gives the same flows as routing
+             * the complete history, at a cost proportional to the length of the continued period.
+             * \note the state is only valid for the river network, cell routing and dt it was computed with
+             */
+            struct state {
+                utctime t = no_utctime;///< the state is valid at t, the start of the first step to continue with
+                utctimespan dt = 0;///< the time-step of the tails
+                std::map<int, std::vector<double>> local_tail;
+                std::map<int, std::vector<double>> output_tail;
+
+                bool empty() const { return t == no_utctime; }
+                bool operator==(const state& o) const {
+                    return t == o.t && dt == o.dt && local_tail == o.local_tail && output_tail == o.output_tail;
+                }
+                bool operator!=(const state& o) const { return !operator==(o); }
+                x_serialize_decl();
+            };
+
+            /** \brief add the pending contribution of x, convolved by w, to tail
+             *
+             * tail[k] += sum w[j]*x[n+k-j], j > k, that is the contribution of the n values of x
+             * to the k'th value after x.
+             */
+            inline void add_convolve_tail(std::vector<double>& tail, const std::vector<double>& x, const std::vector<double>& w) {
+                const size_t n = x.size(), m = w.size();
+                if (m < 2 || n == 0) return;
+                if (tail.size() < m - 1) tail.resize(m - 1, 0.0);
+                for (size_t k = 0; k + 1 < m; ++k) {
+                    double v = 0.0;
+                    const size_t j_end = std::min(m, n + k + 1);
+                    for (size_t j = k + 1; j < j_end; ++j)
+                        v += w[j]*x[n + k - j];
+                    tail[k] += v;
+                }
+            }
+
+            /** \brief remove and return the first n values of tail, the pending contributions to the next n steps */
+            inline std::vector<double> pop_convolve_tail(std::vector<double>& tail, size_t n) {
+                const size_t k = std::min(n, tail.size());
+                std::vector<double> r(begin(tail), begin(tail) + k);
+                tail.erase(begin(tail), begin(tail) + k);
+                return r;
+            }
+
             /** A routing model
              *
              * Based on modelling the routing using repeated convolution of a unit hydro-graph.
@@ -261,6 +414,9 @@ namespace shyft {
              * \note implementation:
              *    technically we are currently flattening out the ts-expression tree by computing the full
              *    point representation of every flow in the directed graph.
+             *    The flows of all rivers are computed by evaluate(), visiting the rivers in topological order,
+             *    so each river is convolved exactly once, and the queries local_inflow, upstream_inflow and output_m3s
+             *    reads from the result, kept until the network or the cell routing changes.
              *    Later we could utilize a dynamic dispatch to to build the recursive
              *    accumulated expression tree at any river in the routing graph. This could
              *    improve performance and resource usage in certain scenarios.
@@ -286,6 +442,30 @@ namespace shyft {
                 std::shared_ptr<river_network> rivers;
                 std::shared_ptr<std::vector<C>> cells; ///< shared with the region_model !
                 time_axis::fixed_dt ta;///< shared with the region_model,  should be the simulation time-axis
+                std::shared_ptr<uhg_cache> uhgs;///< if set, the uhgs of cells and rivers are taken from, and kept in, this cache
+
+                /** \brief the routing of a cell into the network, all that determines its routed output, besides its discharge */
+                struct cell_route {
+                    int64_t id;
+                    double distance;
+                    uhg_parameter parameter;
+                    bool operator==(const cell_route& o) const { return id == o.id && distance == o.distance && parameter == o.parameter; }
+                };
+
+                /** \brief the flows of all the rivers of the network, computed by evaluate()
+                 *
+                 * The time-axis, network and cell routes are those used for the computation,
+                 * so that is_current() can tell if the result is still valid for the model.
+                 */
+                struct flows {
+                    time_axis::fixed_dt ta;
+                    river_network network;
+                    std::vector<cell_route> routes;
+                    std::map<int, rts_t> local_inflow;///< from the cells connected to the river
+                    std::map<int, rts_t> upstream_inflow;///< the sum of the output of the upstream rivers
+                    std::map<int, rts_t> output_m3s;///< leaving the river
+                };
+                mutable std::shared_ptr<const flows> memo;///< the result of the last evaluate() used by the queries
 
                 model(const std::shared_ptr<river_network> &rivers,
                       const std::shared_ptr<std::vector<C>>& cells,
@@ -303,6 +483,8 @@ namespace shyft {
                         rivers=c.rivers;
                         cells=c.cells;// shallow
                         ta =c.ta;
+                        memo=c.memo;
+                        uhgs=c.uhgs;
                     }
                     return *this;
                 }
@@ -310,9 +492,20 @@ namespace shyft {
                     rivers=std::move(c.rivers);
                     cells=std::move(c.cells);
                     ta =std::move(c.ta);
+                    memo=std::move(c.memo);
+                    uhgs=std::move(c.uhgs);
                     return *this;
                 }
 
+                /** \brief fx(i) for i in [0..n), on the pool if set */
+                template <class F>
+                static void for_each_ix(const std::shared_ptr<work_stealing_pool>& pool, size_t n, F&& fx) {
+                    if (pool && n > 1)
+                        pool->parallel_for(n, 1, [&fx](size_t i0, size_t i1) { for (size_t i = i0; i < i1; ++i) fx(i); });
+                    else
+                        for (size_t i = 0; i < n; ++i) fx(i);
+                }
+
                 // useful functions:
                 void verify_cell_river_connections() const {
                     for(const auto&c:*cells) {
@@ -321,10 +514,60 @@ namespace shyft {
                     }
                 }
 
-                std::vector<double> cell_uhg(const C& c, utctimespan dt) const {
+                static int cell_uhg_steps(const C& c, utctimespan dt) {
                     double steps = (c.geo.routing.distance / c.parameter->routing.velocity)/dt;// time = distance / velocity[s] // dt[s]
-                    int n_steps = int(steps + 0.5);
-                    return make_uhg_from_gamma(n_steps, c.parameter->routing.alpha, c.parameter->routing.beta);//std::vector<double>{0.1,0.5,0.2,0.1,0.05,0.030,0.020};
+                    return int(steps + 0.5);
+                }
+
+                /** \return the uhg make_uhg_from_gamma(n_steps,alpha,beta), from the uhgs cache if set */
+                std::shared_ptr<const std::vector<double>> shared_uhg(int n_steps, double alpha, double beta) const {
+                    if (uhgs)
+                        return uhgs->get(n_steps, alpha, beta);
+                    return std::make_shared<const std::vector<double>>(make_uhg_from_gamma(n_steps, alpha, beta));
+                }
+
+                std::shared_ptr<const std::vector<double>> shared_cell_uhg(const C& c, utctimespan dt) const {
+                    return shared_uhg(cell_uhg_steps(c, dt), c.parameter->routing.alpha, c.parameter->routing.beta);
+                }
+
+                std::vector<double> cell_uhg(const C& c, utctimespan dt) const {
+                    return *shared_cell_uhg(c, dt);
+                }
+
+                std::shared_ptr<const std::vector<double>> river_uhg(int rid, utctimespan dt) const {
+                    const auto& r = rivers->rid_map.find(rid)->second;
+                    return shared_uhg(r.uhg_steps(dt), r.parameter.alpha, r.parameter.beta);
+                }
+
+                /** \brief the cells routed to the same river with the same uhg, convolved once as a sum */
+                struct cell_group {
+                    std::shared_ptr<const std::vector<double>> uhg;
+                    std::vector<size_t> cell_ix;
+                };
+
+                /** \return the cells of each river, grouped by identical uhg, that is equal steps, alpha and beta
+                 * \note cells routed to rivers not in the network are left out
+                 */
+                std::map<int, std::vector<cell_group>> cell_index() const {
+                    typedef std::tuple<int, int, double, double> key_t;// rid, uhg steps, alpha, beta
+                    std::map<key_t, size_t> group_of;
+                    std::map<int, std::vector<cell_group>> r;
+                    const utctimespan dt = ta.delta();
+                    for (size_t i = 0; i < cells->size(); ++i) {
+                        const auto& c = (*cells)[i];
+                        const int rid = int(c.geo.routing.id);
+                        if (!valid_routing_id(rid) || rivers->rid_map.find(rid) == rivers->rid_map.end())
+                            continue;
+                        key_t k(rid, cell_uhg_steps(c, dt), c.parameter->routing.alpha, c.parameter->routing.beta);
+                        auto g = group_of.find(k);
+                        auto& groups = r[rid];
+                        if (g == group_of.end()) {
+                            g = group_of.emplace(k, groups.size()).first;
+                            groups.push_back(cell_group{shared_cell_uhg(c, dt), {}});
+                        }
+                        groups[g->second].cell_ix.push_back(i);
+                    }
+                    return r;
                 }
 
                 /** compute the cell_output, taking the cell-route to routing river into consideration
@@ -336,48 +579,190 @@ namespace shyft {
                 }
 
 
-                /** compute the local lateral inflow from connected shyft-cells into given river-id
+                /** \return the routes of the cells, in cell order */
+                std::vector<cell_route> cell_routes() const {
+                    std::vector<cell_route> r; r.reserve(cells->size());
+                    for (const auto& c : *cells)
+                        r.push_back(cell_route{c.geo.routing.id, c.geo.routing.distance, c.parameter->routing});
+                    return r;
+                }
+
+                /** \return true if the flows f are computed with the current time-axis, network and cell routes of the model */
+                bool is_current(const flows& f) const {
+                    if (f.ta != ta || f.network != *rivers || f.routes.size() != cells->size())
+                        return false;
+                    for (size_t i = 0; i < f.routes.size(); ++i) {
+                        const auto& c = (*cells)[i];
+                        if (!(f.routes[i] == cell_route{c.geo.routing.id, c.geo.routing.distance, c.parameter->routing}))
+                            return false;
+                    }
+                    return true;
+                }
+
+                /** \brief compute the flows of all rivers, each river exactly once
                  *
+                 * The local inflow of each river is computed from its cells, ref. cell_index(), where the discharges of
+                 * the cells of each group, with identical uhg, are summed into one buffer, then convolved once.
+                 * Then the rivers are visited level by level, ref. river_network::topological_levels(),
+                 * so that the output of all upstream rivers is complete when the output of a river is computed.
+                 * \param pool if set, the rivers, first for the local inflow, then of each level, are computed in parallel
+                 *        on the pool, they are independent, so the result is the same as without a pool.
                  */
-                rts_t local_inflow(int node_id) const {
-                    rts_t r(ta,0.0,time_series::POINT_AVERAGE_VALUE);// default null to null ts.
-                    for (const auto& c : *cells) {
-                        if (c.geo.routing.id == node_id) {
-                            auto node_output_m3s (cell_output_m3s(c));
-                            for (size_t t = 0;t < r.size();++t)
-                                r.add(t, node_output_m3s.value(t));
+                std::shared_ptr<const flows> evaluate(const std::shared_ptr<work_stealing_pool>& pool = nullptr) const {
+                    state s;
+                    return evaluate_from(pool, 0, s);
+                }
+
+                /** \brief as evaluate(), but continue the routing from start_step with the routing state s
+                 *
+                 * Only the steps from start_step are computed, using the pending convolution tails of s
+                 * for the contribution of the flows before start_step.
+                 * \param pool as for evaluate()
+                 * \param start_step the first step to compute, ta.time(start_step) must be s.t unless s is empty
+                 * \param s the state at ta.time(start_step), an empty state means no flow before start_step,
+                 *        on return the state at the end of the time-axis
+                 * \param prior flows to take the values before start_step from, used if still current, otherwise these are nan
+                 * \param lateral if set, added to the local inflow of the rivers, like the local inflow from cells of other models,
+                 *        ref. partitioned_region_model, the series must cover the time-axis
+                 * \throw runtime_error if s is not valid at start_step with the time-step of the time-axis
+                 */
+                std::shared_ptr<const flows> evaluate_from(const std::shared_ptr<work_stealing_pool>& pool, size_t start_step, state& s,
+                                                           const flows* prior = nullptr, const std::map<int, rts_t>* lateral = nullptr) const {
+                    const size_t n = ta.size();
+                    if (start_step > n)
+                        throw std::runtime_error("routing: start_step must be within the time-axis");
+                    if (!s.empty() && (s.dt != ta.delta() || s.t != (start_step < n ? ta.time(start_step) : ta.total_period().end)))
+                        throw std::runtime_error("routing: the state is not valid at the start_step of the time-axis");
+                    if (prior && !is_current(*prior))
+                        prior = nullptr;
+                    auto f = std::make_shared<flows>();
+                    f->ta = ta;
+                    f->network = *rivers;
+                    f->routes = cell_routes();
+                    const size_t nc = n - start_step;// computed steps
+                    // the values before start_step, from prior, or nan, followed by zeros
+                    auto head = [&](const std::map<int, rts_t> flows::* m, int rid) {
+                        std::vector<double> v(n, 0.0);
+                        const rts_t* p = nullptr;
+                        if (prior) {
+                            auto i = (prior->*m).find(rid);
+                            if (i != (prior->*m).end()) p = &i->second;
                         }
+                        for (size_t t = 0; t < start_step; ++t)
+                            v[t] = p ? p->v[t] : shyft::nan;
+                        return rts_t(ta, std::move(v), time_series::POINT_AVERAGE_VALUE);
+                    };
+                    auto tail_of = [](const std::map<int, std::vector<double>>& m, int rid) {
+                        auto i = m.find(rid);
+                        return i != m.end() ? i->second : std::vector<double>{};
+                    };
+                    state r;
+                    r.t = ta.total_period().end;
+                    r.dt = ta.delta();
+                    std::vector<int> rids;
+                    std::map<int, std::vector<int>> upstreams;// in ascending id order, from rid_map
+                    for (const auto& rv : rivers->rid_map) {
+                        rids.push_back(rv.first);
+                        f->local_inflow.emplace(rv.first, head(&flows::local_inflow, rv.first));
+                        f->upstream_inflow.emplace(rv.first, head(&flows::upstream_inflow, rv.first));
+                        f->output_m3s.emplace(rv.first, head(&flows::output_m3s, rv.first));
+                        r.local_tail[rv.first] = tail_of(s.local_tail, rv.first);
+                        r.output_tail[rv.first] = tail_of(s.output_tail, rv.first);
+                        if (valid_routing_id(int(rv.second.downstream.id)))
+                            upstreams[int(rv.second.downstream.id)].push_back(rv.first);
                     }
-                    return r;
+                    // the flows and tails of each river are all inserted above, so the rivers below can be computed concurrently
+                    const auto index = cell_index();
+                    for_each_ix(pool, rids.size(), [&](size_t k) {
+                        const int rid = rids[k];
+                        auto& l = f->local_inflow.find(rid)->second;
+                        auto& tail = r.local_tail.find(rid)->second;
+                        const auto pending = pop_convolve_tail(tail, nc);
+                        for (size_t t = 0; t < pending.size(); ++t)
+                            l.v[start_step + t] += pending[t];
+                        if (lateral) {
+                            auto e = lateral->find(rid);
+                            if (e != lateral->end())
+                                for (size_t t = 0; t < nc; ++t)
+                                    l.v[start_step + t] += e->second.value(start_step + t);
+                        }
+                        auto rc = index.find(rid);
+                        if (rc == index.end())
+                            return;
+                        std::vector<double> sum_discharge(nc);
+                        for (const auto& g : rc->second) {
+                            std::fill(begin(sum_discharge), end(sum_discharge), 0.0);
+                            for (auto i : g.cell_ix) {
+                                const auto& q = (*cells)[i].rc.avg_discharge;
+                                for (size_t t = 0; t < nc; ++t)
+                                    sum_discharge[t] += q.value(start_step + t);
+                            }
+                            const auto q_routed = time_series::convolve_w_values(sum_discharge, *g.uhg, time_series::convolve_policy::USE_ZERO);
+                            for (size_t t = 0; t < nc; ++t)
+                                l.v[start_step + t] += q_routed[t];
+                            add_convolve_tail(tail, sum_discharge, *g.uhg);
+                        }
+                    });
+                    const utctimespan dt = ta.delta(); // for now need to pick up delta from the sources
+                    for (const auto& level : rivers->topological_levels()) {
+                        for_each_ix(pool, level.size(), [&](size_t k) {
+                            const int rid = level[k];
+                            auto& upstream = f->upstream_inflow.find(rid)->second;
+                            auto u = upstreams.find(rid);
+                            if (u != upstreams.end()) {
+                                for (auto up_id : u->second) {
+                                    const auto& up = f->output_m3s.find(up_id)->second;
+                                    for (size_t t = start_step; t < n; ++t)
+                                        upstream.v[t] += up.v[t];
+                                }
+                            }
+                            const auto& local = f->local_inflow.find(rid)->second;
+                            std::vector<double> sum_input_m3s(nc);
+                            for (size_t t = 0; t < nc; ++t)
+                                sum_input_m3s[t] = local.v[start_step + t] + upstream.v[start_step + t];
+                            const auto uhg = river_uhg(rid, dt);
+                            const auto response = time_series::convolve_w_values(sum_input_m3s, *uhg, time_series::convolve_policy::USE_ZERO);
+                            auto& tail = r.output_tail.find(rid)->second;
+                            const auto pending = pop_convolve_tail(tail, nc);
+                            auto& output = f->output_m3s.find(rid)->second;
+                            for (size_t t = 0; t < nc; ++t)
+                                output.v[start_step + t] = response[t] + (t < pending.size() ? pending[t] : 0.0);
+                            add_convolve_tail(tail, sum_input_m3s, *uhg);
+                        });
+                    }
+                    s = std::move(r);
+                    return f;
                 }
 
-                /** Aggregate the upstream inflow that flows into this cell
-                 * Notice that this is a recursive function that will go upstream
-                 * and collect *all* upstream flow
+                /** \return the flows of all rivers, from memo if still current, otherwise evaluated and kept in memo */
+                const flows& evaluated() const {
+                    if (!memo || !is_current(*memo))
+                        memo = evaluate();
+                    return *memo;
+                }
+
+                /** compute the local lateral inflow from connected shyft-cells into given river-id
+                 *
                  */
-                rts_t upstream_inflow(int node_id) const {
-                    rts_t r(ta, 0.0, time_series::POINT_AVERAGE_VALUE);
-                    auto upstream_ids=rivers->upstreams_by_id(node_id);
-                    for(auto upstream_id:upstream_ids) {
-                        auto flow_m3s= output_m3s(upstream_id);
-                        for (size_t t = 0;t < ta.size();++t)
-                            r.add(t, flow_m3s.value(t));
+                rts_t local_inflow(int node_id) const {
+                    rivers->check_rid(node_id);
+                    return evaluated().local_inflow.find(node_id)->second;
+                }
 
-                    }
-                    return r;
+                /** Aggregate the upstream inflow that flows into this river,
+                 * the sum of the output of all its upstream rivers
+                 */
+                rts_t upstream_inflow(int node_id) const {
+                    rivers->check_rid(node_id);
+                    return evaluated().upstream_inflow.find(node_id)->second;
                 }
 
-                /** Utilizing the local_inflow and upstream_inflow function,
-                 * calculate the output_m3s leaving the specified river.
-                 * This is a walk in the park, since we can just use
-                 * already existing (possibly recursive) functions to do the work.
+                /** The output_m3s leaving the specified river, the convolution of
+                 * the sum of the local and upstream inflow with the uhg of the river.
                  */
                 rts_t output_m3s(int node_id) const {
-                    utctimespan dt = ta.delta(); // for now need to pick up delta from the sources
-                    std::vector<double> uhg_weights = rivers->river_by_id(node_id).uhg(dt);
-                    auto sum_input_m3s = local_inflow(node_id)+ upstream_inflow(node_id);
-                    auto response = time_series::convolve_w_ts<decltype(sum_input_m3s)>(sum_input_m3s, uhg_weights, time_series::convolve_policy::USE_ZERO);
-                    return rts_t(ta, ts_values(response), time_series::POINT_AVERAGE_VALUE); // flatten values
+                    rivers->check_rid(node_id);
+                    return evaluated().output_m3s.find(node_id)->second;
                 }
 
             };
@@ -421,3 +806,5 @@ namespace shyft {
         }
     }
 }
+//-- serialization support shyft
+x_serialize_export_key(shyft::core::routing::state);
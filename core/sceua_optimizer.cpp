@@ -18,7 +18,8 @@ namespace shyft {
                 double fx_solution_min,	// 2. Stop when fx is within fx_solution_min..fx_solution_max
                 double fx_solution_max,	//   (to disable, set fx_solution_min > fx_solution_max)
                 const double x_epsilon[],// 3. Stop when all x[] are just moving within x_epsilon range
-                size_t max_iterations	// 4. Stop when max iterations/invocations are reached
+                size_t max_iterations,	// 4. Stop when max iterations/invocations are reached
+                const warm_start* seed	// if set, up to half of the initial sample is taken from the best of these points
                 )
                 const
             {
@@ -29,29 +30,57 @@ namespace shyft {
                 const size_t p		=	5;		// The number of complexes
                 const size_t n_live_points	=	p*m;	// The number of "live" points in the parameter space
 
-                double **ax		= __autoalloc__(double*,m);
+                const size_t n_group = max(size_t(1), min(p, fx.concurrency()));// complexes evolved in lock-step, their candidates evaluated as a batch
+
+                double ***ax	= __autoalloc__(double**,n_group);
+                double **af		= __autoalloc__(double*,n_group);
                 double **sample = __autoalloc__(double*,n_live_points);
                 double **ssample= __autoalloc__(double*,n_live_points);
 
-                for (i=0; i<m; i++)
-                    ax[i]= __autoalloc__(double,n);
+                for (size_t c=0; c<n_group; c++) {
+                    ax[c]= __autoalloc__(double*,m);
+                    af[c]= __autoalloc__(double,m);
+                    for (i=0; i<m; i++)
+                        ax[c][i]= __autoalloc__(double,n);
+                }
                 for (i=0;i<n_live_points;i++) {// While the x table contains the full parameter vector,
                     sample[i] =__autoalloc__(double,n);	// sample does not contain any fixed parameters.
                     ssample[i]=__autoalloc__(double,n);	// Neither does sample.
                 }
                 size_t*		ind=__autoalloc__(size_t,n_live_points);
-                double*		af =__autoalloc__(double,m);
                 double*		f  =__autoalloc__(double,n_live_points);
                 double*		sf =__autoalloc__(double,n_live_points);
                 bool terminateRequested=false;
                 //  Step 1:	Draw a random sample of parameters and evaluate objective function value for each point
+                vector<vector<double>> xs(n_live_points);
+                vector<bool> known(n_live_points,false);// true if f[i] is given by the warm start
                 fastcopy(sample[0],x,n); // first sample is initial values
-                f[0] = fx.evaluate(n,x);++evaluations;
-                for (i=1;i<n_live_points;i++) {
+                xs[0].assign(x,x+n);
+                size_t n_seeded=0;
+                if (seed) {// then the best distinct points of the warm start, leaving at least half of the sample random
+                    for (auto k:seed->pick(n,n_live_points/2,false,x_min,x_max,vector<vector<double>>{xs[0]})) {
+                        xs[++n_seeded]=warm_start::clamped(seed->x[k],x_min,x_max);
+                        if (seed->reuse_fx && k<seed->fx.size() && std::isfinite(seed->fx[k])) {
+                            f[n_seeded]=seed->fx[k];
+                            known[n_seeded]=true;
+                        }
+                    }
+                }
+                for (i=1+n_seeded;i<n_live_points;i++) {
                     random_generate_x(n,x,x_min,x_max);
-                    fastcopy(sample[i],x,n);
-                    f[i]= fx.evaluate(n,x);++evaluations;
+                    xs[i].assign(x,x+n);
+                }
+                vector<vector<double>> xs_eval;
+                for (i=0;i<n_live_points;i++) {
+                    fastcopy(sample[i],xs[i].data(),n);
+                    if (!known[i])
+                        xs_eval.push_back(xs[i]);
                 }
+                vector<double> fxs;
+                fx.evaluate_batch(xs_eval,fxs);evaluations+=xs_eval.size();
+                for (i=0,j=0;i<n_live_points;i++)
+                    if (!known[i])
+                        f[i]=fxs[j++];
                 construct_sorted_pivot_table(f,ind,n_live_points);//	Step 2:	Sort the points according to value of objective function
                 for (i=0;i<n_live_points;i++) {
                     sf[i]=f[ind[i]];
@@ -60,19 +89,25 @@ namespace shyft {
 
                 //**************** Start the optimization *********************
                 while(optimizerState==Searching && !terminateRequested) {// This loop performs one "shuffling", that is, sorting the m*p points and distributing them among complexes
-                    for (ij=0; ij<p; ij++) {//	Step 3:	Partition the sample into p complexes of m points
-                        for (j=0; j<m; j++) {
-                            jj=(j)*p + ij;
-                            fastcopy(ax[j],ssample[jj],n);
-                            af[j]=sf[jj];
+                    for (size_t ig=0; ig<p; ig+=n_group) {
+                        const size_t g=min(n_group,p-ig);
+                        for (size_t c=0; c<g; c++) {//	Step 3:	Partition the sample into p complexes of m points
+                            ij=ig+c;
+                            for (j=0; j<m; j++) {
+                                jj=(j)*p + ij;
+                                fastcopy(ax[c][j],ssample[jj],n);
+                                af[c][j]=sf[jj];
+                            }
                         }
-                        //	Step 4: Evolve each complex
-                        evolve(ax,af,m,n,fx,x_min,x_max,x,evaluations,ij);
-                        //	Step 5:	Replace the evolved complexes
-                        for (j=0; j<m; j++) {
-                            jj=(j)*p+ij;
-                            fastcopy(sample[jj],ax[j],n);
-                            f[jj]=af[j];
+                        //	Step 4: Evolve each complex of the group
+                        evolve(ax,af,g,m,n,fx,x_min,x_max,evaluations);
+                        for (size_t c=0; c<g; c++) {//	Step 5:	Replace the evolved complexes
+                            ij=ig+c;
+                            for (j=0; j<m; j++) {
+                                jj=(j)*p+ij;
+                                fastcopy(sample[jj],ax[c][j],n);
+                                f[jj]=af[c][j];
+                            }
                         }
                     }
                     construct_sorted_pivot_table(f,ind,n_live_points);// Sort the points according to value of objective function
@@ -107,53 +142,89 @@ namespace shyft {
             ///	Function evolve corresponds to the competitive complex evolution (CCE),
             /// fig. 2 in Duan et. al (1993). It is called from sceua.
             void
-            sceua::evolve(double *ax[],	// ax[m][n]  are the parameter values of complex to be evolved.
-                double af[],						// af[m]     is the objective function value of the subcomplex.
+            sceua::evolve(double **ax[],	// ax[c][m][n]  are the parameter values of complex c to be evolved.
+                double *af[],						// af[c][m]     is the objective function value of complex c.
+                size_t n_complexes,					// n_complexes is the number of complexes evolved in lock-step
                 size_t m,							// m         is the n_live_points of the complex.
                 size_t n,							// n         is number of parameters to be optimized.
                 ifx& fn,			// The function (hydro model) to be evaluated
                 const double x_min[],				// x_min[n]   are the minimum values of the parameters to be optimized.
                 const double x_max[],				// maxi[n]   are the maximum values of the parameters to be optimized.
-                double x[],							// x[n]  is all the parameter vector required by the model.
-                                                    // The actual length of this vector is not required in this subroutine.
-                size_t& evaluations,				// evaluations is a counter for how many times the model is called.
-                size_t complexno					// For diagnostics: The number of this complex.
+                size_t& evaluations				// evaluations is a counter for how many times the model is called.
                 ) const
             {
-                size_t		i, j, ii, nsel;
-                double	ff, objf;
+                size_t		i, j, ii, c, nsel;
+                double	ff;
                 size_t		kk, sel, mutation;
 
-                int *selected	= __autoalloc__(int,m);
-                double *gg		= __autoalloc__(double,n);		// The center of gravity for the q-1 best points in bf.
                 double *pp		= __autoalloc__(double,m);		// The probability density of ax
                 double *cp		= __autoalloc__(double,m);		// The probability function for ax used to elect points to bf.
 
-
-                double **sax = __autoalloc__(double*,m);		// ax sorted according to af
-                for (i=0; i<m; i++)
-                    sax[i]=__autoalloc__(double,n);
                 // STEP 0: initialization of optimization parameters.
                 size_t q				= n+1;					// The n_live_points of a sub-complex
                 size_t alfa				= 1;					// The values of q, alfa and beta are selected according
                 size_t beta				= 2 * n + 1;			// to recommendations in ????? */
 
-                size_t* inda=__autoalloc__(size_t,m)	;		// The index array sorting bf in increasing order
-                double* saf =__autoalloc__(double,m);
-
-                size_t* indb=__autoalloc__(size_t,q);			// The index array sorting af in increasing order
-                double* sbf =__autoalloc__(double,q);
-                double* bf  =__autoalloc__(double,q);			// The function values for the selected complex
-
-                size_t*  ll	= __autoalloc__(size_t,q);			// The location in ax to which bx belongs
-                size_t* sll	= __autoalloc__(size_t,q);			// ll sorted according to bf.
-                double **bx	= __autoalloc__(double*,q);			// The parameter values for the selected sub-complex
-                double **sbx= __autoalloc__(double*,q);			// bx sorted according to bf
-
-                for (i=0; i<q; i++) {
-                    bx[i]	= __autoalloc__(double,n);
-                    sbx[i]	= __autoalloc__(double,n);
+                struct cce {// the work-space of each complex
+                    int *selected;
+                    double *gg;		// The center of gravity for the q-1 best points in bf.
+                    double *x;		// The candidate parameter vector
+                    double objf;	// The objective function value of x
+                    double **sax;	// ax sorted according to af
+                    size_t* inda;	// The index array sorting bf in increasing order
+                    double* saf;
+                    size_t* indb;	// The index array sorting af in increasing order
+                    double* sbf;
+                    double* bf;		// The function values for the selected complex
+                    size_t*  ll;	// The location in ax to which bx belongs
+                    size_t* sll;	// ll sorted according to bf.
+                    double **bx;	// The parameter values for the selected sub-complex
+                    double **sbx;	// bx sorted according to bf
+                };
+                cce *w = __autoalloc__(cce,n_complexes);
+                for (c=0; c<n_complexes; c++) {
+                    w[c].selected = __autoalloc__(int,m);
+                    w[c].gg = __autoalloc__(double,n);
+                    w[c].x = __autoalloc__(double,n);
+                    w[c].objf = 0.0;
+                    w[c].sax = __autoalloc__(double*,m);
+                    for (i=0; i<m; i++)
+                        w[c].sax[i]=__autoalloc__(double,n);
+                    w[c].inda = __autoalloc__(size_t,m);
+                    w[c].saf = __autoalloc__(double,m);
+                    w[c].indb = __autoalloc__(size_t,q);
+                    w[c].sbf = __autoalloc__(double,q);
+                    w[c].bf = __autoalloc__(double,q);
+                    w[c].ll = __autoalloc__(size_t,q);
+                    w[c].sll = __autoalloc__(size_t,q);
+                    w[c].bx = __autoalloc__(double*,q);
+                    w[c].sbx = __autoalloc__(double*,q);
+                    for (i=0; i<q; i++) {
+                        w[c].bx[i]	= __autoalloc__(double,n);
+                        w[c].sbx[i]	= __autoalloc__(double,n);
+                    }
                 }
+                size_t *pending = __autoalloc__(size_t,n_complexes);// the complexes with a candidate to evaluate
+                size_t n_pending = 0;
+                vector<vector<double>> xs;
+                vector<double> fxs, f_bounds;
+                auto evaluate_pending = [&](bool bounded) {// evaluate the candidates x of the pending complexes as one batch
+                    if (n_pending == 0) return;
+                    xs.resize(n_pending);
+                    for (size_t k=0; k<n_pending; k++)
+                        xs[k].assign(w[pending[k]].x, w[pending[k]].x + n);
+                    if (bounded) {// the candidate is only kept if better than bf[q-1], ref. step 3d and 3e
+                        f_bounds.resize(n_pending);
+                        for (size_t k=0; k<n_pending; k++)
+                            f_bounds[k] = w[pending[k]].bf[q-1];
+                        fn.evaluate_batch_bounded(xs,f_bounds,fxs);
+                    } else {
+                        fn.evaluate_batch(xs,fxs);	// model(x,objf);
+                    }
+                    evaluations+=n_pending;
+                    for (size_t k=0; k<n_pending; k++)
+                        w[pending[k]].objf = fxs[k];
+                };
 
                 for (i=0; i<m; i++){					// STEP 1 : Calculate the probability distribution for the points
                     // The first point (with the lowest function value)
@@ -164,95 +235,123 @@ namespace shyft {
                 }
                 // Step 5 Iterate: Repeat step 2 through 4 beta times
                 for (kk=0; kk<beta; kk++) {
-                    // Step 2 :		Create the sub-complex bf; bx fom af; ax by
-                    nsel=0;					// selecting q of m points from af;ax according to the
-                    for (i=0; i<m; i++)		// distribution specified above. The index for the
-                        selected[i]=0;		// location in the original array af;ax is stored in ll.*/
+                    for (c=0; c<n_complexes; c++) {
+                        cce& a = w[c];
+                        // Step 2 :		Create the sub-complex bf; bx fom af; ax by
+                        nsel=0;					// selecting q of m points from af;ax according to the
+                        for (i=0; i<m; i++)		// distribution specified above. The index for the
+                            a.selected[i]=0;		// location in the original array af;ax is stored in ll.*/
 
-                    while (nsel < q) {
-                        ff = random01();	// Formerly:		ff = OptUtil::ran1(idum) ;, which is now called from unif01.
-                        i = sel = 0 ;
-                        while (sel == 0 && i < m) {	// Continue until a new point is selected
-                            // or the n_live_points of af;ax is reached
-                            if (ff <= cp[i]) {
-                                if (selected[i] == 0) {	// Check whether the point already has been selected
-                                    fastcopy(bx[nsel],ax[i],n);
-                                    bf[nsel]	= af[i];
-                                    ll[nsel]	= i;
-                                    selected[i]	= 1;
-                                    sel			= 1;
-                                    nsel++;
+                        while (nsel < q) {
+                            ff = random01();	// Formerly:		ff = OptUtil::ran1(idum) ;, which is now called from unif01.
+                            i = sel = 0 ;
+                            while (sel == 0 && i < m) {	// Continue until a new point is selected
+                                // or the n_live_points of af;ax is reached
+                                if (ff <= cp[i]) {
+                                    if (a.selected[i] == 0) {	// Check whether the point already has been selected
+                                        fastcopy(a.bx[nsel],ax[c][i],n);
+                                        a.bf[nsel]	= af[c][i];
+                                        a.ll[nsel]	= i;
+                                        a.selected[i]	= 1;
+                                        sel			= 1;
+                                        nsel++;
+                                    }
                                 }
+                                i++;
                             }
-                            i++;
                         }
                     }
 
                     for (ii=0; ii<alfa; ii++) {		// step 3f : Repeat steps 3a trough 3e alfa times
-                        construct_sorted_pivot_table(bf,indb,q);		// Step 3a: Sort the selected points.
-                        for(i=0; i<q; i++) {		// indb is an index array that sorts bf in increasing order,
-                            // sbx is the sorted sub-complex, sll is the sortet index array
-                            fastcopy(sbx[i],bx[indb[i]],n);
-                            sll[i] = ll[indb[i]];
-                            sbf[i] = bf[indb[i]];
-                        }
+                        for (c=0; c<n_complexes; c++) {
+                            cce& a = w[c];
+                            construct_sorted_pivot_table(a.bf,a.indb,q);		// Step 3a: Sort the selected points.
+                            for(i=0; i<q; i++) {		// indb is an index array that sorts bf in increasing order,
+                                // sbx is the sorted sub-complex, sll is the sortet index array
+                                fastcopy(a.sbx[i],a.bx[a.indb[i]],n);
+                                a.sll[i] = a.ll[a.indb[i]];
+                                a.sbf[i] = a.bf[a.indb[i]];
+                            }
 
-                        for (i=0 ;i<n ;i++)			// Step 3a continues + step 3b:  Compute the centroid
-                            gg[i] = 0.0;			// of the q-1 best points in bf;bx
-                        mutation = 0;				// gg is the centroid, newp is the new parameter vector
+                            for (i=0 ;i<n ;i++)			// Step 3a continues + step 3b:  Compute the centroid
+                                a.gg[i] = 0.0;			// of the q-1 best points in bf;bx
+                            mutation = 0;				// gg is the centroid, newp is the new parameter vector
 
-                        for (i=0; i<n; i++) {
-                            for (j=0; j<q-1; j++)
-                                gg[i] = gg[i] + sbx[j][i]/(q-1);
-                            x[i]= 2.0*gg[i] - sbx[q-1][i]; // here we might break integral rules for x[]
+                            for (i=0; i<n; i++) {
+                                for (j=0; j<q-1; j++)
+                                    a.gg[i] = a.gg[i] + a.sbx[j][i]/(q-1);
+                                a.x[i]= 2.0*a.gg[i] - a.sbx[q-1][i]; // here we might break integral rules for x[]
 
-                            if(x[i]<x_min[i] || x[i]>x_max[i])	// Step 3c: Check if new point is within inital parameter space
-                                mutation=1;							// If outside, select the new point by a mutation step
-                            // mutate is the subroutine that performs the mutation step
-                        }
+                                if(a.x[i]<x_min[i] || a.x[i]>x_max[i])	// Step 3c: Check if new point is within inital parameter space
+                                    mutation=1;							// If outside, select the new point by a mutation step
+                                // mutate is the subroutine that performs the mutation step
+                            }
 
-                        if (mutation == 1) {
-                            mutate(ax,x, m,n);
+                            if (mutation == 1) {
+                                mutate(ax[c],a.x, m,n);
+                            }
+                            pending[c] = c;
                         }
-                        objf = fn.evaluate(n, x);++evaluations;	// model(x,objf);
+                        n_pending = n_complexes;
+                        evaluate_pending(true);
 
-                        if(objf < bf[q-1]) {			// Step 3d : Check whether step 3c step gives a better objective function.
-                            ;// If this is the case, continue to step 3f,
-                            //	( go to the end of the alfa-loop )
-                        } else {// otherwise a contraction step is performed.
-                            for(i=0;i<n;i++) {
-                                x[i]= (gg[i]+sbx[q-1][i]) / 2.0; // here we might break rules for the x[] integrity
+                        size_t n_contracted = 0;
+                        for (size_t k=0; k<n_pending; k++) {
+                            cce& a = w[pending[k]];
+                            if(a.objf < a.bf[q-1]) {			// Step 3d : Check whether step 3c step gives a better objective function.
+                                ;// If this is the case, continue to step 3f,
+                                //	( go to the end of the alfa-loop )
+                            } else {// otherwise a contraction step is performed.
+                                for(i=0;i<n;i++) {
+                                    a.x[i]= (a.gg[i]+a.sbx[q-1][i]) / 2.0; // here we might break rules for the x[] integrity
+                                }
+                                pending[n_contracted++] = pending[k];
                             }
-                            objf = fn.evaluate(n,x);++evaluations;
-                            if ( objf < bf[q-1] ) {	// Step 3e: Check whether the contraction step gives a better objective function
+                        }
+                        n_pending = n_contracted;
+                        evaluate_pending(true);
+
+                        size_t n_mutated = 0;
+                        for (size_t k=0; k<n_pending; k++) {
+                            cce& a = w[pending[k]];
+                            if ( a.objf < a.bf[q-1] ) {	// Step 3e: Check whether the contraction step gives a better objective function
                                 ;// Step 3d OK
                             } else {				// Mutation step
-                                mutate(ax, x, m, n);
-                                objf = fn.evaluate(n, x);++evaluations;
+                                mutate(ax[pending[k]], a.x, m, n);
+                                pending[n_mutated++] = pending[k];
                             }
                         }	// End contraction step
-                        sbf[q-1]=objf;//store result generated in above if-else-if-else
-                        fastcopy(sbx[q-1],x,n);
+                        n_pending = n_mutated;
+                        evaluate_pending(false);
 
-                        fastcopy(ll,sll,q);
-                        fastcopy(bf,sbf,q);
-                        for(i=0;i<q;i++) {		// Book-keeping
-                            fastcopy(bx[i],sbx[i],n);
+                        for (c=0; c<n_complexes; c++) {
+                            cce& a = w[c];
+                            a.sbf[q-1]=a.objf;//store result generated in above if-else-if-else
+                            fastcopy(a.sbx[q-1],a.x,n);
+
+                            fastcopy(a.ll,a.sll,q);
+                            fastcopy(a.bf,a.sbf,q);
+                            for(i=0;i<q;i++) {		// Book-keeping
+                                fastcopy(a.bx[i],a.sbx[i],n);
+                            }
                         }
                     }   /*alfa  loop */
 
-                    for(i=0;i<q;i++) {			    // Step 4 :  Replace bx into ax (and bf into af)
-                        fastcopy(ax[ll[i]],bx[i],n);// using the original locations stored in ll
-                        af[ll[i]] = bf[i];	 	    // Sorts then the parent complex af  and ax.
-                    }
-                    construct_sorted_pivot_table(af,inda,m);// sort the 'parent complex' af and ax
-                    for (i=0; i<m; i++) {
-                        saf[i] = af[inda[i]];
-                        fastcopy(sax[i],ax[inda[i]],n);
-                    }
-                    fastcopy(af,saf,m);
-                    for (i=0; i<m; i++) {
-                        fastcopy(ax[i],sax[i],n);
+                    for (c=0; c<n_complexes; c++) {
+                        cce& a = w[c];
+                        for(i=0;i<q;i++) {			    // Step 4 :  Replace bx into ax (and bf into af)
+                            fastcopy(ax[c][a.ll[i]],a.bx[i],n);// using the original locations stored in ll
+                            af[c][a.ll[i]] = a.bf[i];	 	    // Sorts then the parent complex af  and ax.
+                        }
+                        construct_sorted_pivot_table(af[c],a.inda,m);// sort the 'parent complex' af and ax
+                        for (i=0; i<m; i++) {
+                            a.saf[i] = af[c][a.inda[i]];
+                            fastcopy(a.sax[i],ax[c][a.inda[i]],n);
+                        }
+                        fastcopy(af[c],a.saf,m);
+                        for (i=0; i<m; i++) {
+                            fastcopy(ax[c][i],a.sax[i],n);
+                        }
                     }
                 }   /*  beta loop */
             }
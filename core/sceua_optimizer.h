@@ -78,24 +78,25 @@ namespace shyft {
                     double fx_solution_min,	///< 2. Stop when fx is within fx_solution_min..fx_solution_max
                     double fx_solution_max,	///<   (to disable, set fx_solution_min > fx_solution_max)
                     const double x_epsilon[],///< 3. Stop when all x[] are just moving within x_epsilon range
-                    size_t max_iterations	///< 4. Stop when max_iterations/invocations are reached
+                    size_t max_iterations,	///< 4. Stop when max_iterations/invocations are reached
+                    const warm_start* seed=nullptr	///< if set, up to half of the initial sample is the best distinct points of the seed, ref. warm_start::pick
                     )
                     const;
             private:
 				/// \brief Evolve ..
                 /// Function evolve corresponds to the competitive complex evolution (CCE),
                 /// fig. 2 in Duan et. al (1993). It is called from sceua.
-                void evolve(double *ax[],		///< ax[m][n]  are the parameter values of complex to be evolved.
-                    double af[],				///< af[m]     is the objective function value of the sub-complex.
+                /// The complexes of the group are evolved in lock-step, so that the candidates of each step,
+                /// one from each complex, are evaluated as one batch, ref. ifx::evaluate_batch.
+                void evolve(double **ax[],		///< ax[c][m][n]  are the parameter values of complex c of the group to be evolved.
+                    double *af[],				///< af[c][m]     is the objective function value of complex c.
+                    size_t n_complexes,			///< n_complexes is the number of complexes in the group
                     size_t m,					///< m         is the size of the complex.
                     size_t n,					///< n         is number of parameters to be optimized.
                     ifx& fn,	///< The function (hydrological model) to be evaluated
                     const double x_min[],		///< x_min[n]   are the minimum values of the parameters to be optimized.
                     const double x_max[],		///< x_max[n]   are the maximum values of the parameters to be optimized.
-                    double x[],					///< x[n]  is all the parameter vector required by the model.
-                                                ///< The actual length of this vector is not required in this subroutine.
-                    size_t& evaluations,		///< evaluations is a counter for how many times the model is called.
-                    size_t complexno			///< For diagnostics: The number of this complex.
+                    size_t& evaluations		///< evaluations is a counter for how many times the model is called.
                     )
                     const;
 
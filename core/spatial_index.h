@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+
+namespace shyft {
+    namespace core {
+
+        /** \brief a static 3d k-d tree for neighbour search among a fixed set of points
+         *
+         * Used by the interpolation routines to find the sources near a destination cell,
+         * without computing the distance to all sources.
+         * The tree is implicit, stored as one vector of points, where the median of each
+         * range [lo..hi) along axis depth%3 is placed at (lo+hi)/2.
+         *
+         * Distances are plain euclidean squared distances of the stored coordinates,
+         * so scaling, like the idw zscale, is applied to the coordinates before insertion.
+         */
+        class kd_tree_3d {
+        public:
+            struct point {
+                std::array<double, 3> c;///< coordinates
+                size_t ix;///< user supplied index, like position of the source in a vector
+            };
+        private:
+            std::vector<point> pts;
+
+            static double distance2(const point& p, const double* q) {
+                const double dx = p.c[0] - q[0], dy = p.c[1] - q[1], dz = p.c[2] - q[2];
+                return dx*dx + dy*dy + dz*dz;
+            }
+
+            void build(size_t lo, size_t hi, size_t depth) {
+                if (hi - lo < 2) return;
+                const size_t mid = (lo + hi) / 2;
+                const size_t axis = depth % 3;
+                std::nth_element(pts.begin() + lo, pts.begin() + mid, pts.begin() + hi,
+                    [axis](const point& a, const point& b) { return a.c[axis] < b.c[axis]; });
+                build(lo, mid, depth + 1);
+                build(mid + 1, hi, depth + 1);
+            }
+
+            void knn(size_t lo, size_t hi, size_t depth, const double* q, size_t k, double& bound, std::vector<double>& heap) const {
+                if (lo >= hi) return;
+                const size_t mid = (lo + hi) / 2;
+                const size_t axis = depth % 3;
+                const double d2 = distance2(pts[mid], q);
+                if (d2 <= bound) {
+                    heap.push_back(d2); std::push_heap(heap.begin(), heap.end());
+                    if (heap.size() > k) { std::pop_heap(heap.begin(), heap.end()); heap.pop_back(); }
+                    if (heap.size() == k) bound = heap.front();
+                }
+                const double diff = q[axis] - pts[mid].c[axis];
+                if (diff < 0.0) {
+                    knn(lo, mid, depth + 1, q, k, bound, heap);
+                    if (diff*diff <= bound) knn(mid + 1, hi, depth + 1, q, k, bound, heap);
+                } else {
+                    knn(mid + 1, hi, depth + 1, q, k, bound, heap);
+                    if (diff*diff <= bound) knn(lo, mid, depth + 1, q, k, bound, heap);
+                }
+            }
+
+            void within(size_t lo, size_t hi, size_t depth, const double* q, double r2, std::vector<size_t>& r) const {
+                if (lo >= hi) return;
+                const size_t mid = (lo + hi) / 2;
+                const size_t axis = depth % 3;
+                if (distance2(pts[mid], q) <= r2)
+                    r.push_back(pts[mid].ix);
+                const double diff = q[axis] - pts[mid].c[axis];
+                if (diff < 0.0 || diff*diff <= r2) within(lo, mid, depth + 1, q, r2, r);
+                if (diff >= 0.0 || diff*diff <= r2) within(mid + 1, hi, depth + 1, q, r2, r);
+            }
+
+        public:
+            kd_tree_3d() = default;
+            explicit kd_tree_3d(std::vector<point>&& v) { build(std::move(v)); }
+
+            void build(std::vector<point>&& v) {
+                pts = std::move(v);
+                build(0, pts.size(), 0);
+            }
+
+            size_t size() const { return pts.size(); }
+
+            /** \return the squared distance to the k'th nearest point of q, considering only points within r2,
+             *  if there are fewer than k points within r2, r2 is returned
+             */
+            double kth_distance2(const std::array<double, 3>& q, size_t k, double r2) const {
+                if (k == 0) return 0.0;
+                std::vector<double> heap; heap.reserve(k + 1);
+                double bound = r2;
+                knn(0, pts.size(), 0, q.data(), k, bound, heap);
+                return heap.size() == k ? heap.front() : r2;
+            }
+
+            /** \brief append the .ix of all points within squared distance r2 of q to r, in tree order */
+            void within(const std::array<double, 3>& q, double r2, std::vector<size_t>& r) const {
+                within(0, pts.size(), 0, q.data(), r2, r);
+            }
+        };
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+#include "utctime_utilities.h"
+
+namespace shyft {
+    namespace core {
+
+        /** \brief a checkpoint keeps the complete state of all cells, valid at time t
+         *
+         * The state is the state at the *start* of the time-step beginning at t,
+         * i.e. the result after running all steps before t.
+         */
+        template <class S>
+        struct state_checkpoint {
+            utctime t = no_utctime;///< the state is valid at the start of period starting at t
+            std::vector<S> states;///< one state pr. cell, in cell order
+        };
+
+        /** \brief fixed capacity ring-buffer of state_checkpoints
+         *
+         * Used by the region_model to keep intermediate cell states during run_cells,
+         * so that a later run can resume from the nearest checkpoint, instead of re-running
+         * the spin-up period. Checkpoints are keyed by time, not time-axis index, so that
+         * they remain usable when the time-axis of the region-model moves forward.
+         *
+         * When full, inserting a new checkpoint replaces the one with the oldest insert order.
+         * Inserting at a time already present replaces that checkpoint in place.
+         */
+        template <class S>
+        class state_checkpoint_ring {
+            std::vector<state_checkpoint<S>> buf;
+            size_t cap = 0;
+            size_t next = 0;///< position to overwrite when full
+        public:
+            explicit state_checkpoint_ring(size_t capacity = 0) :cap(capacity) { buf.reserve(capacity); }
+
+            size_t capacity() const { return cap; }
+            size_t size() const { return buf.size(); }
+            /** \return approx. heap bytes of the checkpoints */
+            size_t heap_bytes() const {
+                size_t b = buf.capacity()*sizeof(state_checkpoint<S>);
+                for (auto const& c : buf) b += c.states.capacity()*sizeof(S);
+                return b;
+            }
+            bool empty() const { return buf.empty(); }
+            void clear() { buf.clear(); next = 0; }
+
+            /** \brief set new capacity, drops all checkpoints */
+            void reset(size_t capacity) { clear(); cap = capacity; buf.reserve(cap); }
+
+            /** \brief insert or replace the checkpoint at time t */
+            void put(utctime t, std::vector<S>&& states) {
+                if (cap == 0) return;
+                for (auto& c : buf) {
+                    if (c.t == t) {
+                        c.states = std::move(states);
+                        return;
+                    }
+                }
+                if (buf.size() < cap) {
+                    buf.push_back(state_checkpoint<S>{t, std::move(states)});
+                } else {
+                    buf[next] = state_checkpoint<S>{t, std::move(states)};
+                    next = (next + 1) % cap;
+                }
+            }
+
+            /** \return pointer to the latest checkpoint with t0 <= .t <= t, or nullptr if none */
+            const state_checkpoint<S>* nearest(utctime t, utctime t0 = min_utctime) const {
+                const state_checkpoint<S>* r = nullptr;
+                for (auto const& c : buf)
+                    if (c.t <= t && c.t >= t0 && (!r || c.t > r->t))
+                        r = &c;
+                return r;
+            }
+
+            /** \return the sorted times of the checkpoints kept */
+            std::vector<utctime> times() const {
+                std::vector<utctime> r; r.reserve(buf.size());
+                for (auto const& c : buf) r.push_back(c.t);
+                std::sort(r.begin(), r.end());
+                return r;
+            }
+        };
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <armadillo>
+
+/**
+ * Contains the radial basis function surrogate of an expensive goal function, used to pre-screen optimizer candidates
+ */
+
+namespace shyft {
+    namespace core {
+        namespace optimizer {
+            using namespace std;
+
+            /** \brief cubic radial basis function interpolant, with a linear tail, of samples f(x) of a goal function
+             *
+             *   s(x) = sum_j w_j*|x - x_j|^3 + c_0 + sum_i c_i*x[i]
+             *
+             * The weights solve the usual augmented system [phi p; p' 0][w;c] = [f;0], ref. Regis and Shoemaker (2007), that
+             * has a unique solution when the samples are distinct, and not all on a hyperplane.
+             * The parameters x are expected to be scaled to comparable ranges, like the [0..1] used by the optimizers.
+             */
+            class rbf_surrogate {
+                arma::mat centers;///< n x k, one sample in each column
+                arma::vec w;///< k rbf weights, then n+1 tail coefficients
+                double f_lo = 0.0;
+                double f_hi = 0.0;
+
+                static double phi(double r) { return r*r*r; }
+
+                static double distance(const arma::mat& c, size_t j, const double* x) {
+                    double s = 0.0;
+                    for (size_t i = 0; i < c.n_rows; ++i) {
+                        const double d = c.at(i, j) - x[i];
+                        s += d*d;
+                    }
+                    return std::sqrt(s);
+                }
+
+            public:
+                /** \brief fit the surrogate to the samples f(xs[j])= fs[j], skipping non-finite values and repeated points
+                 * \return true if the surrogate is usable, that is at least n+2 distinct samples and a solvable system
+                 */
+                bool fit(const vector<vector<double>>& xs, const vector<double>& fs) {
+                    centers.reset(); w.reset();
+                    if (xs.empty() || xs.size() != fs.size())
+                        return false;
+                    const size_t n = xs.front().size();
+                    vector<size_t> used;
+                    for (size_t j = 0; j < xs.size(); ++j) {
+                        if (!std::isfinite(fs[j]) || xs[j].size() != n)
+                            continue;
+                        bool repeated = false;
+                        for (auto u : used) {
+                            double s = 0.0;
+                            for (size_t i = 0; i < n; ++i) s += (xs[u][i] - xs[j][i])*(xs[u][i] - xs[j][i]);
+                            if (s < 1e-20) { repeated = true; break; }
+                        }
+                        if (!repeated) used.push_back(j);
+                    }
+                    const size_t k = used.size();
+                    if (k < n + 2)
+                        return false;
+                    arma::mat c(n, k);
+                    for (size_t j = 0; j < k; ++j)
+                        for (size_t i = 0; i < n; ++i) c.at(i, j) = xs[used[j]][i];
+                    const size_t m = k + n + 1;
+                    arma::mat a(m, m, arma::fill::zeros);
+                    arma::vec b(m, arma::fill::zeros);
+                    f_lo = f_hi = fs[used[0]];
+                    for (size_t j = 0; j < k; ++j) {
+                        for (size_t l = 0; l < k; ++l)
+                            a.at(j, l) = phi(distance(c, l, c.colptr(j)));
+                        a.at(j, k) = a.at(k, j) = 1.0;
+                        for (size_t i = 0; i < n; ++i)
+                            a.at(j, k + 1 + i) = a.at(k + 1 + i, j) = c.at(i, j);
+                        b(j) = fs[used[j]];
+                        f_lo = std::min(f_lo, b(j));
+                        f_hi = std::max(f_hi, b(j));
+                    }
+                    arma::vec x;
+                    if (!arma::solve(x, a, b, arma::solve_opts::no_approx))
+                        return false;
+                    centers = c;
+                    w = x;
+                    return true;
+                }
+
+                bool valid() const { return centers.n_cols > 0; }
+                size_t size() const { return centers.n_cols; }
+                size_t dimension() const { return centers.n_rows; }
+                /** \return the range, max - min, of the goal function values fitted */
+                double range() const { return f_hi - f_lo; }
+
+                /** \return the surrogate value s(x), x.size() must match the fitted samples */
+                double operator()(const vector<double>& x) const {
+                    const size_t n = centers.n_rows, k = centers.n_cols;
+                    double s = w(k);
+                    for (size_t i = 0; i < n; ++i) s += w(k + 1 + i)*x[i];
+                    for (size_t j = 0; j < k; ++j) s += w(j)*phi(distance(centers, j, x.data()));
+                    return s;
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace shyft {
+    namespace core {
+        using std::size_t;
+
+        /** \brief work_stealing_pool, a persistent set of worker threads executing chunked index ranges
+         *
+         * The pool is intended to replace the pattern used in region_model where each run creates
+         * fresh std::async threads that draws one cell at a time from a mutex protected counter.
+         *
+         * A call to parallel_for(n,chunk_size,fx) splits the index range [0..n) into chunks,
+         * and distributes the chunks round-robin into one deque for each worker (+ one for the caller).
+         * Each worker pops chunks from the front of its own deque, and when empty, it steals
+         * from the back of the other deques. The calling thread participates as a worker, so
+         * a pool with zero worker threads simply executes everything in the calling thread,
+         * and nested calls to parallel_for from inside a chunk can not dead-lock.
+         *
+         * Several threads can call parallel_for concurrently, each call is a separate job,
+         * and idle workers helps out on any active job.
+         *
+         * \note exceptions raised by fx are captured, the remaining chunks of the job is skipped,
+         *       and the first exception is rethrown in the calling thread when all running chunks are done.
+         */
+        class work_stealing_pool {
+            struct chunk_range { size_t i0; size_t i1; };
+
+            struct chunk_queue {
+                std::mutex mx;
+                std::deque<chunk_range> q;
+            };
+
+            struct job {
+                std::function<void(size_t, size_t)> fx;
+                std::vector<chunk_queue> queues;///< [0] is the caller, [1..] is the helping workers
+                std::atomic<size_t> helpers{0};///< number of workers that joined this job, limited to queues.size()-1
+                bool fixed_queues = false;///< if true, worker w always takes queue w+1, ref. parallel_for_partitioned
+                std::vector<bool> claimed;///< for fixed_queues, queue taken by its worker, protected by the pool mx
+                std::atomic<size_t> remaining{0};///< chunks not yet completed
+                std::atomic<bool> failed{false};
+                std::mutex done_mx;
+                std::condition_variable done_cv;
+                std::exception_ptr ex;
+
+                explicit job(size_t n_queues) :queues(n_queues) {}
+
+                bool pop_front(size_t qi, chunk_range& r) {
+                    auto& cq = queues[qi];
+                    std::lock_guard<std::mutex> lock(cq.mx);
+                    if (cq.q.empty()) return false;
+                    r = cq.q.front(); cq.q.pop_front();
+                    return true;
+                }
+
+                bool steal_back(size_t qi, chunk_range& r) {
+                    const size_t n = queues.size();
+                    for (size_t k = 1; k < n; ++k) {
+                        auto& cq = queues[(qi + k) % n];
+                        std::lock_guard<std::mutex> lock(cq.mx);
+                        if (!cq.q.empty()) {
+                            r = cq.q.back(); cq.q.pop_back();
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                /** execute one chunk, own queue first, then steal, return false if nothing left to take */
+                bool run_one(size_t qi) {
+                    chunk_range r;
+                    if (!pop_front(qi, r) && !steal_back(qi, r))
+                        return false;
+                    if (!failed) {
+                        try {
+                            fx(r.i0, r.i1);
+                        } catch (...) {
+                            std::lock_guard<std::mutex> lock(done_mx);
+                            if (!ex) ex = std::current_exception();
+                            failed = true;
+                        }
+                    }
+                    if (--remaining == 0) {
+                        std::lock_guard<std::mutex> lock(done_mx);
+                        done_cv.notify_all();
+                    }
+                    return true;
+                }
+            };
+
+            std::vector<std::thread> workers;
+            std::mutex mx;///< protects active and stopping
+            std::condition_variable cv;
+            std::vector<std::shared_ptr<job>> active;
+            bool stopping = false;
+
+            void retire(const std::shared_ptr<job>& j) {
+                std::lock_guard<std::mutex> lock(mx);
+                auto f = std::find(begin(active), end(active), j);
+                if (f != end(active))
+                    active.erase(f);
+            }
+
+            /** find an active job that still accepts helpers, and join it, return queue index >0 if success  */
+            size_t join_some_job(std::shared_ptr<job>& j, size_t wid) {
+                for (auto& a : active) {
+                    if (a->fixed_queues) {
+                        if (wid + 1 < a->queues.size() && !a->claimed[wid + 1]) {
+                            a->claimed[wid + 1] = true;
+                            ++a->helpers;
+                            j = a;
+                            return wid + 1;
+                        }
+                    } else if (a->helpers < a->queues.size() - 1) {
+                        j = a;
+                        return ++a->helpers;
+                    }
+                }
+                return 0;
+            }
+
+            void worker_loop(size_t wid) {
+                while (true) {
+                    std::shared_ptr<job> j;
+                    size_t qi = 0;
+                    {
+                        std::unique_lock<std::mutex> lock(mx);
+                        cv.wait(lock, [this, &j, &qi, wid]() {return stopping || (qi = join_some_job(j, wid)) > 0; });
+                        if (stopping)
+                            return;
+                    }
+                    while (j->run_one(qi));
+                    retire(j);// when we get here, all chunks are taken
+                }
+            }
+
+            static void pin_to_core(std::thread& t, size_t core) {
+#ifdef __linux__
+                static const std::vector<int> cpus = numa_cpu_order();
+                if (cpus.empty()) return;
+                cpu_set_t cpu_set;
+                CPU_ZERO(&cpu_set);
+                CPU_SET(cpus[core % cpus.size()], &cpu_set);
+                pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &cpu_set);// best effort, ignore failure
+#else
+                (void)t; (void)core;
+#endif
+            }
+
+        public:
+            /** \brief the cpus of the machine, ordered by numa node, then by cpu number
+             *
+             * Read from /sys/devices/system/node/node<n>/cpulist on linux, if not available,
+             * or on other platforms, it is 0..hardware_concurrency()-1.
+             * Consecutive workers of a pinned pool are thus on the same node, so
+             * the contiguous slabs of parallel_for_partitioned stays node-local.
+             */
+            static std::vector<int> numa_cpu_order() {
+                std::vector<int> r;
+#ifdef __linux__
+                for (int node = 0; ; ++node) {
+                    std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                    if (!f) break;
+                    std::string line; std::getline(f, line);
+                    std::stringstream ss(line);
+                    std::string range;
+                    while (std::getline(ss, range, ',')) {// format is like 0-7,16-23
+                        auto dash = range.find('-');
+                        try {
+                            int a = std::stoi(range.substr(0, dash));
+                            int b = dash == std::string::npos ? a : std::stoi(range.substr(dash + 1));
+                            for (int c = a; c <= b; ++c) r.push_back(c);
+                        } catch (...) {}
+                    }
+                }
+#endif
+                if (r.empty())
+                    for (size_t c = 0; c < std::thread::hardware_concurrency(); ++c) r.push_back(int(c));
+                return r;
+            }
+
+            /** \brief create a pool with n_workers threads, in addition the caller of parallel_for participates
+             * \param n_workers number of worker threads, 0 is valid, and gives serial execution in the calling thread
+             * \param pin_threads if true, worker i is pinned to cpu (i+1) of numa_cpu_order(), modulo available cpus (linux only)
+             */
+            explicit work_stealing_pool(size_t n_workers, bool pin_threads = false) {
+                workers.reserve(n_workers);
+                for (size_t i = 0; i < n_workers; ++i) {
+                    workers.emplace_back([this, i]() {worker_loop(i); });
+                    if (pin_threads)
+                        pin_to_core(workers.back(), i + 1);
+                }
+            }
+
+            work_stealing_pool(const work_stealing_pool&) = delete;
+            work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+            ~work_stealing_pool() {
+                {
+                    std::lock_guard<std::mutex> lock(mx);
+                    stopping = true;
+                }
+                cv.notify_all();
+                for (auto& w : workers)
+                    if (w.joinable()) w.join();
+            }
+
+            /** \return number of worker threads, excluding the calling thread */
+            size_t size() const { return workers.size(); }
+
+            /** \brief execute fx(i0,i1) for chunks covering [0..n), using the pool threads and the calling thread
+             *
+             * \tparam F callable with signature void(size_t i0,size_t i1), must be thread-safe for disjoint ranges
+             * \param n the number of items to process
+             * \param chunk_size number of items in each chunk, if 0, a reasonable value is computed
+             * \param fx the callable to execute for each chunk
+             * \param max_threads limits the number of threads, including the caller, that works on this call, 0 means no limit
+             * \throw rethrows the first exception raised by fx
+             */
+            template <class F>
+            void parallel_for(size_t n, size_t chunk_size, F&& fx, size_t max_threads = 0) {
+                if (n == 0)
+                    return;
+                size_t n_queues = queue_count(max_threads);
+                if (chunk_size == 0)
+                    chunk_size = std::max(size_t(1), n / (4 * n_queues));
+                auto j = std::make_shared<job>(n_queues);
+                j->fx = std::forward<F>(fx);
+                size_t n_chunks = 0;
+                for (size_t i0 = 0; i0 < n; i0 += chunk_size, ++n_chunks)
+                    j->queues[n_chunks%n_queues].q.push_back(chunk_range{i0, std::min(n, i0 + chunk_size)});
+                run_job(j, n_chunks);
+            }
+
+            /** \brief as parallel_for, but [0..n) is split in one contiguous slab for each thread, and worker w always gets slab w+1
+             *
+             * With the same n and max_threads, a given index is always processed by the same thread, unless
+             * that thread is busy and the chunk is stolen. Combined with a pinned pool, memory allocated
+             * (first-touched) for an item in one call, is then local to the numa node of the thread that
+             * process the item in later calls. The calling thread takes slab 0.
+             * Stealing starts with the neighbour slabs, which are on the same node, ref. numa_cpu_order.
+             */
+            template <class F>
+            void parallel_for_partitioned(size_t n, size_t chunk_size, F&& fx, size_t max_threads = 0) {
+                if (n == 0)
+                    return;
+                size_t n_queues = queue_count(max_threads);
+                auto j = std::make_shared<job>(n_queues);
+                j->fx = std::forward<F>(fx);
+                j->fixed_queues = true;
+                j->claimed.assign(n_queues, false);
+                size_t n_chunks = 0;
+                for (size_t q = 0; q < n_queues; ++q) {
+                    size_t s0 = slab_begin(n, n_queues, q), s1 = slab_begin(n, n_queues, q + 1);
+                    size_t cs = chunk_size ? chunk_size : std::max(size_t(1), (s1 - s0) / 4);
+                    for (size_t i0 = s0; i0 < s1; i0 += cs, ++n_chunks)
+                        j->queues[q].q.push_back(chunk_range{i0, std::min(s1, i0 + cs)});
+                }
+                run_job(j, n_chunks);
+            }
+
+            /** \return start of slab q of n_slabs, when [0..n) is partitioned as by parallel_for_partitioned */
+            static size_t slab_begin(size_t n, size_t n_slabs, size_t q) { return n_slabs ? (n*q) / n_slabs : 0; }
+
+            /** \return number of threads, including the caller, that is used for a call with max_threads */
+            size_t queue_count(size_t max_threads) const {
+                size_t n_queues = workers.size() + 1;
+                if (max_threads > 0 && max_threads < n_queues)
+                    n_queues = max_threads;
+                return n_queues;
+            }
+
+        private:
+            void run_job(const std::shared_ptr<job>& j, size_t n_chunks) {
+                const size_t n_queues = j->queues.size();
+                j->remaining = n_chunks;
+                if (n_chunks > 1 && n_queues > 1) {
+                    {
+                        std::lock_guard<std::mutex> lock(mx);
+                        active.push_back(j);
+                    }
+                    cv.notify_all();
+                }
+                while (j->run_one(0));
+                retire(j);
+                {
+                    std::unique_lock<std::mutex> lock(j->done_mx);
+                    j->done_cv.wait(lock, [&j]() {return j->remaining == 0; });
+                }
+                if (j->ex)
+                    std::rethrow_exception(j->ex);
+            }
+        };
+
+        /** \brief the process-wide executor, shared by all region-models, interpolation and calibration
+         *
+         * Running several region-models in the same process, each with its own set of threads,
+         * gives ncore x n_models threads competing for the cores. Instead, all parallel work
+         * is submitted to one work_stealing_pool, so that total concurrency stays bounded,
+         * and thread creation is done once, not in the hot loop.
+         *
+         * The default size is hardware_concurrency()-1 workers (the submitting thread participates).
+         * Use configure() early, before any work is submitted, to change size or pin the threads.
+         * Work in progress keeps the previous pool alive until it completes.
+         */
+        struct executor {
+            /** \return the shared pool, created on first use */
+            static std::shared_ptr<work_stealing_pool> instance() {
+                std::lock_guard<std::mutex> lock(mx());
+                auto& p = pool();
+                if (!p) {
+                    size_t n = std::thread::hardware_concurrency();
+                    p = std::make_shared<work_stealing_pool>(n > 1 ? n - 1 : 0);
+                }
+                return p;
+            }
+
+            /** \brief replace the shared pool with a new one
+             * \param n_threads total number of threads, including the submitting thread, 0 means hardware_concurrency()
+             * \param pin_threads pin each worker thread to a core (linux only)
+             */
+            static void configure(size_t n_threads, bool pin_threads = false) {
+                if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+                auto p = std::make_shared<work_stealing_pool>(n_threads > 1 ? n_threads - 1 : 0, pin_threads);
+                std::lock_guard<std::mutex> lock(mx());
+                pool().swap(p);
+            }
+
+            /** \return total number of threads (workers + the submitting thread) of the shared pool */
+            static size_t size() { return instance()->size() + 1; }
+
+        private:
+            static std::mutex& mx() { static std::mutex m; return m; }
+            static std::shared_ptr<work_stealing_pool>& pool() { static std::shared_ptr<work_stealing_pool> p; return p; }
+        };
+    }
+}
@@ -4,10 +4,13 @@
 #include <stdexcept>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <stdexcept>
 #include <type_traits>
 #include <algorithm>
+#include <new>
+#include <unordered_map>
 #include "core_serialization.h"
 #include "utctime_utilities.h"
 namespace shyft {
@@ -107,18 +110,109 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief fixed interval time-axis with microsecond resolution
+         *
+         * Same layout and arithmetic as fixed_dt, but t and dt are utctime_us,
+         * for sub-second series like intraday market data and event time-stamps.
+         * The *_us functions gives the exact times.
+         * The utctime based time(i),period(i) and index_of(t) used by the time-series algorithms
+         * converts at the boundary, rounding down to whole seconds, so they are exact when dt is whole seconds.
+         */
+        struct fixed_dt_us: continuous<true> {
+            utctime_us t;
+            utctimespan_us dt;
+            size_t n;
+            fixed_dt_us( utctime_us start=no_utctime, utctimespan_us deltat=0, size_t n_periods=0 ) : t( start ), dt( deltat ), n( n_periods ) {}
+            explicit fixed_dt_us(const fixed_dt& f) : t(to_utctime_us(f.t)), dt(f.dt*us_per_second), n(f.n) {}
+            size_t size() const {return n;}
+            bool operator==(const fixed_dt_us& other) const {return t==other.t && dt== other.dt && n==other.n;}
+            bool operator!=(const fixed_dt_us& other) const { return !this->operator==(other); }
+
+            utctime_us time_us( size_t i ) const {
+                if( i < n ) return t + utctimespan_us(i) * dt;
+                throw std::out_of_range( "fixed_dt_us.time_us(i)" );
+            }
+            size_t index_of_us( utctime_us tx ) const {
+                if( tx < t || dt == 0 ) return std::string::npos;
+                size_t r = ( tx - t ) / dt;
+                if( r < n ) return r;
+                return std::string::npos;
+            }
+
+            utcperiod total_period() const {
+                return n == 0 ?
+                       utcperiod( min_utctime, min_utctime ) :
+                       utcperiod( from_utctime_us(t), from_utctime_us(t + utctimespan_us(n) * dt) );
+            }
+            utctime time( size_t i ) const {return from_utctime_us(time_us(i));}
+            utcperiod period( size_t i ) const {
+                if( i < n ) return utcperiod( from_utctime_us(t + utctimespan_us(i) * dt), from_utctime_us(t + utctimespan_us(i + 1) * dt) );
+                throw std::out_of_range( "fixed_dt_us.period(i)" );
+            }
+            size_t index_of( utctime tx ) const {
+                if( tx == no_utctime ) return std::string::npos;
+                return index_of_us(to_utctime_us(tx));
+            }
+            size_t open_range_index_of( utctime tx, size_t ix_hint=std::string::npos ) const {
+                return n > 0 && tx != no_utctime && ( tx >= total_period().end ) ? n - 1 : index_of( tx );
+            }
+
+            ///< true if t and dt are whole seconds, so that it can be represented as fixed_dt
+            bool is_whole_seconds() const {return t % us_per_second == 0 && dt % us_per_second == 0;}
+            /** \brief returns the equal fixed_dt, throws runtime_error if t or dt are not whole seconds */
+            fixed_dt to_fixed_dt() const {
+                if( !is_whole_seconds() )
+                    throw std::runtime_error( "fixed_dt_us.to_fixed_dt() requires whole seconds t and dt" );
+                return fixed_dt( from_utctime_us(t), dt / us_per_second, n );
+            }
+            x_serialize_decl();
+        };
+
+        /** \brief the interval start times of a calendar_dt, computed once and shared between its copies
+         *
+         * The table keeps the parameters it was built for, so that a calendar_dt with
+         * members changed after construction falls back to the calendar computations.
+         */
+        struct calendar_dt_table {
+            const calendar* cal;
+            utctime t;
+            utctimespan dt;
+            size_t n;
+            calendar_dt_table(const calendar* cal, utctime t, utctimespan dt, size_t n) : cal(cal), t(t), dt(dt), n(n) {}
+
+            bool matches(const calendar* c_cal, utctime c_t, utctimespan c_dt, size_t c_n) const {
+                return cal == c_cal && t == c_t && dt == c_dt && n == c_n;
+            }
+            /** \return the n+1 points t_i, where t_i[i] = cal->add(t, dt, i), built by the first caller */
+            const vector<utctime>& points() {
+                std::call_once(built, [this]() {
+                    t_i.reserve(n + 1);
+                    for (size_t i = 0; i <= n; ++i)
+                        t_i.push_back(cal->add(t, dt, long(i)));
+                });
+                return t_i;
+            }
+        private:
+            std::once_flag built;
+            vector<utctime> t_i;
+        };
+
         /** A variant of time_axis that adheres to calendar periods, possibly including DST handling
         *  e.g.: a calendar day might be 23,24 or 25 hour long in a DST calendar.
-        *  If delta-t is less or equal to one hour, it's close to as efficient as time_axis
+        *  If delta-t is less or equal to one hour, it's close to as efficient as time_axis,
+        *  otherwise time(i) and index_of use a shared table of the interval start times, for n <= max_table_n.
         */
         struct calendar_dt : continuous<true> {
 
             static constexpr utctimespan dt_h = 3600;
 
+            static constexpr size_t max_table_n = 1 << 18; ///< max size for the table of interval start times, 2 MB
+
             shared_ptr<calendar> cal;
             utctime t;
             utctimespan dt;
             size_t n;
+            shared_ptr<calendar_dt_table> tbl;///< for dt > dt_h, the lazy table of start times, ref. table()
 
             shared_ptr<calendar> get_calendar() const {
                 return cal;
@@ -135,23 +229,27 @@ namespace shyft {
                 : cal( cal ),
                 t( t ),
                 dt( dt ),
-                n( n ) { }
+                n( n ),
+                tbl( make_table(cal, t, dt, n) ) { }
             calendar_dt(const calendar_dt & c)
                 : cal( c.cal ),
                 t( c.t ),
                 dt( c.dt ),
-                n( c.n ) { }
+                n( c.n ),
+                tbl( c.tbl ) { }
             calendar_dt(calendar_dt && c)
                 : cal( std::move(c.cal) ),
                 t( c.t ),
                 dt( c.dt ),
-                n( c.n ) { }
+                n( c.n ),
+                tbl( std::move(c.tbl) ) { }
 
             calendar_dt & operator=(calendar_dt && c) {
                 cal = std::move(c.cal);
                 t = c.t;
                 dt = c.dt;
                 n = c.n;
+                tbl = std::move(c.tbl);
                 return *this;
             }
             calendar_dt & operator=(const calendar_dt & x) {
@@ -160,9 +258,23 @@ namespace shyft {
                     t = x.t;
                     dt = x.dt;
                     n = x.n;
+                    tbl = x.tbl;
                 }
                 return *this;
             }
+
+            static shared_ptr<calendar_dt_table> make_table(const shared_ptr<calendar>& cal, utctime t, utctimespan dt, size_t n) {
+                if ( !cal || dt <= dt_h || n == 0 || n > max_table_n )
+                    return nullptr;
+                return make_shared<calendar_dt_table>(cal.get(), t, dt, n);
+            }
+
+            /** \return the n+1 interval start times if available for this axis, nullptr if the calendar must be used */
+            const vector<utctime>* table() const {
+                if ( tbl && tbl->matches(cal.get(), t, dt, n) )
+                    return &tbl->points();
+                return nullptr;
+            }
             /** equality, notice that calendar is equal if they refer to exactly same calendar pointer */
             bool operator==(const calendar_dt & other) const {
                 return (cal.get() == other.cal.get() || cal->tz_info->name()== other.cal->tz_info->name())
@@ -186,23 +298,34 @@ namespace shyft {
 
             utctime time(size_t i) const {
                 if ( i < n ) {
-                    return dt <= dt_h
-                        ? t + i * dt
-                        : cal->add(t, dt, long(i));
+                    if ( dt <= dt_h )
+                        return t + i * dt;
+                    auto tp = table();
+                    return tp ? (*tp)[i] : cal->add(t, dt, long(i));
                 }
                 throw out_of_range("calendar_dt.time(i)");
             }
 
             utcperiod period(size_t i) const {
                 if ( i < n ) {
-                    return dt <= dt_h
-                        ? utcperiod(t + i * dt, t + (i + 1) * dt)
+                    if ( dt <= dt_h )
+                        return utcperiod(t + i * dt, t + (i + 1) * dt);
+                    auto tp = table();
+                    return tp
+                        ? utcperiod((*tp)[i], (*tp)[i + 1])
                         : utcperiod(cal->add(t, dt, static_cast<long>(i)), cal->add(t, dt, static_cast<long>(i + 1)));
                 }
                 throw out_of_range("calendar_dt.period(i)");
             }
 
             size_t index_of(utctime tx) const {
+                if ( dt > dt_h ) {
+                    if ( auto tp = table() ) { // the interval with the last start <= tx
+                        if ( tx < tp->front() || tx >= tp->back() )
+                            return std::string::npos;
+                        return static_cast<size_t>(std::upper_bound(tp->cbegin(), tp->cend(), tx) - tp->cbegin()) - 1;
+                    }
+                }
                 auto p = total_period();
                 if ( !p.contains(tx) )
                     return std::string::npos;  // why string...? Introduce a static constant + check similar classes
@@ -212,6 +335,10 @@ namespace shyft {
             }
 
             size_t open_range_index_of(utctime tx, size_t ix_hint = std::string::npos) const {
+                if ( dt > dt_h ) {
+                    if ( auto tp = table() )
+                        return tx >= tp->back() ? n - 1 : index_of( tx );
+                }
                 return tx >= total_period().end && n > 0
                     ? n - 1
                     : index_of( tx );
@@ -224,6 +351,83 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief the time points of a point_dt, shared between copies until one of them is modified
+         *
+         * The const members reads the shared vector directly, while the members that modifies it,
+         * including mut(), first makes a private copy if it is shared (copy on write).
+         * So copying a point_dt, e.g. into the cells of a region-model, or in the expressions and the dtss cache,
+         * is a reference count, and with intern(), independently created identical axes are stored once.
+         */
+        struct time_points {
+            typedef vector<utctime> vector_t;
+            typedef vector_t::const_iterator const_iterator;
+            typedef utctime value_type;
+
+            time_points() : v(empty_points()) {}
+            time_points(const vector_t& x) : v(make_shared<vector_t>(x)) {}
+            time_points(vector_t&& x) : v(make_shared<vector_t>(std::move(x))) {}
+            time_points(const time_points& c) = default;
+            time_points(time_points&& c) : v(std::move(c.v)) { c.v = empty_points(); }
+            time_points& operator=(const time_points& c) = default;
+            time_points& operator=(time_points&& c) {
+                if (this != &c) {
+                    v = std::move(c.v);
+                    c.v = empty_points();
+                }
+                return *this;
+            }
+
+            operator const vector_t&() const { return *v; }
+            const vector_t& vec() const { return *v; }
+            /** \return the vector for modification, a private copy if it was shared */
+            vector_t& mut() {
+                if (v.use_count() > 1)
+                    v = make_shared<vector_t>(*v);
+                return *v;
+            }
+            /** \return true if this and o refers to the same stored points */
+            bool shares(const time_points& o) const { return v == o.v; }
+
+            size_t size() const { return v->size(); }
+            bool empty() const { return v->empty(); }
+            const utctime& operator[](size_t i) const { return (*v)[i]; }
+            const utctime& front() const { return v->front(); }
+            const utctime& back() const { return v->back(); }
+            const utctime* data() const { return v->data(); }
+            const_iterator begin() const { return v->cbegin(); }
+            const_iterator end() const { return v->cend(); }
+            const_iterator cbegin() const { return v->cbegin(); }
+            const_iterator cend() const { return v->cend(); }
+
+            void push_back(utctime x) { mut().push_back(x); }
+            void emplace_back(utctime x) { mut().emplace_back(x); }
+            void pop_back() { mut().pop_back(); }
+            void reserve(size_t n) { mut().reserve(n); }
+            void resize(size_t n) { mut().resize(n); }
+            void clear() { *this = time_points(); }
+            template <class It>
+            void assign(It b, It e) { mut().assign(b, e); }
+
+            friend bool operator==(const time_points& a, const time_points& b) { return a.v == b.v || *a.v == *b.v; }
+            friend bool operator!=(const time_points& a, const time_points& b) { return !(a == b); }
+            friend bool operator==(const time_points& a, const vector_t& b) { return *a.v == b; }
+            friend bool operator==(const vector_t& a, const time_points& b) { return a == *b.v; }
+
+            /** hash of the points, used by intern */
+            size_t hash() const {
+                size_t h = 14695981039346656037ull;
+                for (auto x : *v)
+                    h = (h ^ size_t(x))*1099511628211ull;
+                return h ^ v->size();
+            }
+
+            static const shared_ptr<vector_t>& empty_points() {
+                static const shared_ptr<vector_t> e = make_shared<vector_t>();
+                return e;
+            }
+            shared_ptr<vector_t> v;///< never null, the points, shared between copies
+        };
+
         /** \brief point_dt is the most generic dense time-axis.
         *
         * The representation of time-axis, are n time points + end-point,
@@ -240,11 +444,10 @@ namespace shyft {
         *        then guess the area (+-10), if within range, search there ?
         */
         struct point_dt:continuous<true>{
-            vector<utctime> t;
+            time_points t;///< the interval start times, shared between copies, ref. time_points
             utctime  t_end;// need one extra, after t.back(), to give the last period!
             point_dt()
-                : t( vector<utctime>{} ),
-                  t_end( no_utctime ) {}
+                : t_end( no_utctime ) {}
             point_dt( const vector<utctime>& t, utctime t_end ) : t( t ), t_end( t_end ) {
                 //TODO: throw if t.back()>= t_end
                 // consider t_end==no_utctime , t_end=t.back()+tick.
@@ -269,6 +472,10 @@ namespace shyft {
 				t.pop_back();
 			}
             // ms seems to need explicit move etc.
+            point_dt(const time_points& t, utctime t_end) : t(t), t_end(t_end) {
+                if (t.size()==0 || t.back()>=t_end)
+                    throw runtime_error("time_axis::point_dt() illegal initialization parameters");
+            }
             point_dt(const point_dt&c) : t(c.t), t_end(c.t_end) {}
             point_dt(point_dt &&c) :t(std::move(c.t)), t_end(c.t_end) {}
             point_dt& operator=(point_dt&&c) {
@@ -358,13 +565,15 @@ namespace shyft {
                 POINT = 2      /**< Represents storage of point_dt. */
             };
 
-            generic_type gt;
+            generic_type gt;///< selects the active member of the union, change it with set_type
 
-            fixed_dt f;
-            calendar_dt c;
-            point_dt p;
+            union { // only the member selected by gt is alive, so the size is that of the largest, not the sum
+                fixed_dt f;
+                calendar_dt c;
+                point_dt p;
+            };
 
-            generic_dt() : gt( FIXED ) { }
+            generic_dt() : gt( FIXED ), f() { }
             // provide convinience constructors, to directly create the wanted time-axis, regardless underlying rep.
             generic_dt(utctime t0, utctimespan dt, size_t n)
                 : gt(FIXED),
@@ -388,35 +597,78 @@ namespace shyft {
             explicit generic_dt(const point_dt& p)
                 : gt(POINT),
                   p(p) { }
+            explicit generic_dt(point_dt&& p)
+                : gt(POINT),
+                  p(std::move(p)) { }
 
-            // -- need move,ct etc for msc++
-            // ms seems to need explicit move etc.
             generic_dt(const generic_dt&cc)
-                : gt(cc.gt),
-                  f(cc.f),
-                  c(cc.c),
-                  p(cc.p) { }
+                : gt(cc.gt) {
+                switch ( gt ) {
+                default:
+                case FIXED:    new (&f) fixed_dt(cc.f); break;
+                case CALENDAR: new (&c) calendar_dt(cc.c); break;
+                case POINT:    new (&p) point_dt(cc.p); break;
+                }
+            }
             generic_dt(generic_dt &&cc)
-                : gt(cc.gt),
-                  f(std::move(cc.f)),
-                  c(std::move(cc.c)),
-                  p(std::move(cc.p)) { }
+                : gt(cc.gt) {
+                switch ( gt ) {
+                default:
+                case FIXED:    new (&f) fixed_dt(std::move(cc.f)); break;
+                case CALENDAR: new (&c) calendar_dt(std::move(cc.c)); break;
+                case POINT:    new (&p) point_dt(std::move(cc.p)); break;
+                }
+            }
+            ~generic_dt() { destroy(); }
+
             generic_dt& operator=(generic_dt&&cc) {
-                gt = cc.gt;
-                f = std::move(cc.f);
-                c = std::move(cc.c);
-                p = std::move(cc.p);
+                if ( this != &cc ) {
+                    set_type(cc.gt);
+                    switch ( gt ) {
+                    default:
+                    case FIXED:    f = std::move(cc.f); break;
+                    case CALENDAR: c = std::move(cc.c); break;
+                    case POINT:    p = std::move(cc.p); break;
+                    }
+                }
                 return *this;
             }
             generic_dt& operator=(const generic_dt &x) {
                 if ( this != &x ) {
-                    gt = x.gt;
-                    f = x.f;
-                    c = x.c;
-                    p = x.p;
+                    set_type(x.gt);
+                    switch ( gt ) {
+                    default:
+                    case FIXED:    f = x.f; break;
+                    case CALENDAR: c = x.c; break;
+                    case POINT:    p = x.p; break;
+                    }
                 }
                 return *this;
             }
+
+            /** \brief change the active representation to t, a default constructed one if it differs from gt */
+            void set_type(generic_type t) {
+                if ( t == gt )
+                    return;
+                destroy();
+                gt = t;
+                switch ( gt ) {
+                default:
+                case FIXED:    new (&f) fixed_dt(); break;
+                case CALENDAR: new (&c) calendar_dt(); break;
+                case POINT:    new (&p) point_dt(); break;
+                }
+            }
+        private:
+            void destroy() {
+                switch ( gt ) {
+                default:
+                case FIXED:    f.~fixed_dt(); break;
+                case CALENDAR: c.~calendar_dt(); break;
+                case POINT:    p.~point_dt(); break;
+                }
+            }
+        public:
             bool operator==(const generic_dt& other) const {
                 if ( gt != other.gt ) {// they are represented differently:
                     switch ( gt ) {
@@ -493,6 +745,67 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief registry of the interned time points, ref. intern
+         *
+         * Keeps a reference to each distinct set of points, so interned points are never modified in place,
+         * and drops the points no longer used by any time-axis when the registry has doubled in size.
+         */
+        struct time_points_registry {
+            typedef shared_ptr<time_points::vector_t> points_t;
+
+            static time_points_registry& instance() {
+                static time_points_registry r;
+                return r;
+            }
+
+            /** \return the registered points equal to p, or p, after registering it */
+            time_points intern(const time_points& p) {
+                const size_t h = p.hash();
+                std::lock_guard<std::mutex> lock(mx);
+                auto r = points.equal_range(h);
+                for (auto i = r.first; i != r.second; ++i) {
+                    if (i->second == p.v || *i->second == p.vec()) {
+                        time_points x; x.v = i->second;
+                        return x;
+                    }
+                }
+                if (points.size() >= purge_size) {
+                    purge();
+                    purge_size = std::max(size_t(1024), 2*points.size());
+                }
+                points.emplace(h, p.v);
+                return p;
+            }
+
+            size_t size() {
+                std::lock_guard<std::mutex> lock(mx);
+                return points.size();
+            }
+        private:
+            void purge() {// only the registry refers to the points, and only the registry can hand out new refs
+                for (auto i = points.begin(); i != points.end();)
+                    i = i->second.use_count() == 1 ? points.erase(i) : std::next(i);
+            }
+            std::mutex mx;
+            std::unordered_multimap<size_t, points_t> points;
+            size_t purge_size{ 1024 };
+        };
+
+        /** \brief the time-axis p with points shared with any other interned time-axis with the same points
+         *
+         * Used where many equal time-axis are created independently, like the dtss reads,
+         * so that they are stored once, and compared equal by a pointer compare.
+         */
+        inline point_dt intern(const point_dt& p) {
+            if (p.t.empty())
+                return p;
+            return point_dt(time_points_registry::instance().intern(p.t), p.t_end);
+        }
+        /** \brief intern the time-points of a point_dt representation, the others are kept as they are */
+        inline generic_dt intern(const generic_dt& ta) {
+            return ta.gt == generic_dt::POINT ? generic_dt(intern(ta.p)) : ta;
+        }
+
         /** create a new time-shifted dt time-axis */
         inline fixed_dt time_shift(const fixed_dt &src, utctimespan dt) {
             return fixed_dt(src.t+dt,src.dt,src.n);
@@ -500,15 +813,13 @@ namespace shyft {
 
         /** create a new time-shifted dt time-axis */
         inline calendar_dt time_shift(const calendar_dt& src,utctimespan dt) {
-            calendar_dt r(src);
-            r.t+=dt;
-            return r;
+            return calendar_dt(src.cal, src.t + dt, src.dt, src.n);// with its own table of start times
         }
 
         /** create a new time-shifted dt time-axis */
         inline point_dt time_shift(const point_dt& src, utctimespan dt) {
             point_dt r(src);
-            for(auto& t: r.t) t+=dt; // potential cost, we could consider other approaches with refs..
+            for(auto& t: r.t.mut()) t+=dt; // potential cost, we could consider other approaches with refs..
             r.t_end+=dt;
             return r;
         }
@@ -755,6 +1066,8 @@ namespace shyft {
                 * \param steps  Number of intervals to include. Counted from the first included interval.
                 */
                 static generic_dt as_generic(const point_dt & base, size_t skip, size_t steps) {
+                    if ( skip == 0 && steps == base.t.size() )
+                        return generic_dt(point_dt(base.t, base.t_end));// all of it, share the points
                     auto it_begin = base.t.cbegin(); std::advance(it_begin, skip);
                     auto it_end = it_begin;          std::advance(it_end, steps);
 
@@ -1172,9 +1485,63 @@ namespace shyft {
             }
         }
 
+        /** \brief the part [t0,te) of b, where t0 and te are points of b */
+        inline fixed_dt sub_axis(const fixed_dt& b, utctime t0, utctime te) {
+            return fixed_dt(t0, b.dt, size_t((te - t0)/b.dt));
+        }
+        inline calendar_dt sub_axis(const calendar_dt& b, utctime t0, utctime te) {
+            size_t i0 = b.index_of(t0);
+            size_t ie = te >= b.total_period().end ? b.size() : b.index_of(te);
+            return calendar_dt(b.cal, t0, b.dt, ie - i0);
+        }
+
+        /** \return true if t is an interval start, or the end, of the dense time-axis x */
+        template<class TX>
+        inline bool is_grid_point(const TX& x, utctime t) {
+            if( t == x.total_period().end )
+                return true;
+            size_t i = x.index_of(t);
+            return i != std::string::npos && x.time(i) == t;
+        }
+
+        /** \brief combine a and b when b is a refinement of a within [t0,te)
+         *
+         * If all the interval starts of a in [t0,te), and t0,te, are points of the regular time-axis b,
+         * the combined time-axis is just the part [t0,te) of b, and no points are merged or allocated.
+         * E.g. a daily calendar_dt, or point_dt observations on whole hours, combined with an hourly fixed_dt.
+         * \return true if r is set to the combined time-axis
+         */
+        template<class TA, class TB>
+        inline bool combine_refinement(const TA& a, const TB& b, utctime t0, utctime te, generic_dt& r) {
+            if( !is_grid_point(b, t0) || !is_grid_point(b, te) )
+                return false;
+            for( size_t i = a.index_of(t0) + 1; i < a.size(); ++i ) {
+                utctime t_i = a.time(i);
+                if( t_i >= te )
+                    break;
+                if( !is_grid_point(b, t_i) )
+                    return false;
+            }
+            r = generic_dt(sub_axis(b, t0, te));
+            return true;
+        }
+        template<class TA>
+        inline bool combine_by_refinement(const TA& a, const fixed_dt& b, utctime t0, utctime te, generic_dt& r) {
+            return combine_refinement(a, b, t0, te, r);
+        }
+        template<class TA>
+        inline bool combine_by_refinement(const TA& a, const calendar_dt& b, utctime t0, utctime te, generic_dt& r) {
+            return combine_refinement(a, b, t0, te, r);
+        }
+        template<class TA, class TB>
+        inline bool combine_by_refinement(const TA& a, const TB& b, utctime t0, utctime te, generic_dt& r) {
+            return false;// only the regular fixed_dt and calendar_dt are candidates as the refinement
+        }
+
         /** \brief combine continuous (time-axis,time-axis) template
          * for combining any continuous time-axis with another continuous time-axis
-         * \note this could have potentially linear cost of n-points
+         * \note this could have potentially linear cost of n-points,
+         *       but when one time-axis is a regular refinement of the other, ref. combine_refinement, there is no merge
          */
         template<class TA, class TB>
         inline generic_dt combine( const TA& a, const TB & b, typename enable_if < TA::continuous::value && TB::continuous::value >::type* x = 0 ) {
@@ -1192,9 +1559,12 @@ namespace shyft {
                 if( all_equal )
                     return generic_dt( a );
             }
-            // the hard way merge points in the intersection of periods
             utctime t0 = std::max( pa.start, pb.start );
             utctime te = std::min( pa.end, pb.end );
+            generic_dt rr;
+            if( combine_by_refinement( a, b, t0, te, rr ) || combine_by_refinement( b, a, t0, te, rr ) )
+                return rr;
+            // the hard way merge points in the intersection of periods
             size_t ia = a.open_range_index_of( t0 );// first possible candidate from a
             size_t ib = b.open_range_index_of( t0 );// first possible candidate from b
             size_t ea = 1 + a.open_range_index_of( te );// one past last possible candidate from a
@@ -1344,6 +1714,7 @@ namespace shyft {
 		template<class TA  > inline size_t ta_index_of(TA const&ta, utctime t, size_t ix_hint) {	return ta.index_of(t);}
 		template<> inline size_t ta_index_of(time_axis::point_dt const&ta, utctime t, size_t ix_hint) { return ta.index_of(t, ix_hint);}
 		template<> inline size_t ta_index_of(time_axis::generic_dt const&ta, utctime t, size_t ix_hint) {	return ta.index_of(t, ix_hint);	}
+		template<> inline size_t ta_index_of(time_axis::period_list const&ta, utctime t, size_t ix_hint) { return ta.index_of(t, ix_hint); }
 
 		/** \brief time_axis_transform finds index mapping from source to map-time-axis
 		*
@@ -1362,13 +1733,40 @@ namespace shyft {
 				:src(src), m(m) {}
 
 			inline size_t src_index(size_t i) {
-				if (i > m.size())
+				if (i >= m.size())
 					return string::npos;
 				src_ix = ta_index_of(src, m.time(i), src_ix);
 				return src_ix;
 			}
 		};
 
+		namespace detail {
+			/** index of fixed_dt src containing t, signed arithmetic, npos outside src */
+			inline size_t fixed_src_index(time_axis::fixed_dt const& src, utctime t) {
+				if (t < src.t || src.dt == 0)
+					return string::npos;
+				auto r = utctime((t - src.t) / src.dt);
+				return r < (utctime)src.n ? size_t(r) : string::npos;
+			}
+
+			/** index of point_dt src containing t, walking forward from ix, the index found for a previous, earlier t.
+			 * A few steps covers the case where m is as fine as, or finer than src, then it's a binary search on the remaining points,
+			 * or on all of them if t is before the ix interval.
+			 */
+			inline size_t point_src_index(time_axis::point_dt const& src, utctime t, size_t ix) {
+				const size_t n = src.t.size();
+				if (n == 0 || t < src.t[0] || t >= src.t_end)
+					return string::npos;
+				if (ix >= n || src.t[ix] > t)
+					ix = 0;
+				const size_t max_walk = 8;
+				for (size_t j = 0; j < max_walk; ++j, ++ix) {
+					if (ix + 1 == n || src.t[ix + 1] > t)
+						return ix;
+				}
+				return size_t(upper_bound(src.t.cbegin() + ix, src.t.cend(), t) - src.t.cbegin()) - 1;
+			}
+		}
 
 		/** \brief specialize for fixed_dt time-axis, that can be done really fast
 		*/
@@ -1379,10 +1777,72 @@ namespace shyft {
 
 			time_axis_map(time_axis::fixed_dt const& src, time_axis::fixed_dt const&m) :src(src), m(m) {}
 			inline size_t src_index(size_t im) const {
-				auto r = utctime((utctime(im)*m.dt + m.t - src.t) / src.dt);// (mis)using utctime as signed int64 here
-				if (r < 0 || r >= (utctime)src.n)
+				if (im >= m.n)
+					return std::string::npos;
+				return detail::fixed_src_index(src, m.t + utctimespan(im)*m.dt);
+			}
+		};
+
+		/** \brief specialize for fixed_dt source to calendar_dt, like hourly to daily,
+		* the calendar_dt time(i) is served from its table, and the src index is plain arithmetic
+		*/
+		template<>
+		struct time_axis_map<time_axis::fixed_dt, time_axis::calendar_dt> {
+			time_axis::fixed_dt src;
+			time_axis::calendar_dt m;
+
+			time_axis_map(time_axis::fixed_dt const& src, time_axis::calendar_dt const&m) :src(src), m(m) {}
+			inline size_t src_index(size_t im) const {
+				if (im >= m.size())
 					return std::string::npos;
-				return size_t(r);
+				return detail::fixed_src_index(src, m.time(im));
+			}
+		};
+
+		/** \brief specialize for point_dt source, an incremental forward walk when the map time-axis is visited in order
+		*/
+		template<class TA2>
+		struct time_axis_map<time_axis::point_dt, TA2> {
+			time_axis::point_dt const src;
+			size_t src_ix = string::npos;
+			TA2 const m;
+			time_axis_map(time_axis::point_dt const&src, TA2 const&m) :src(src), m(m) {}
+
+			inline size_t src_index(size_t i) {
+				if (i >= m.size())
+					return string::npos;
+				auto r = detail::point_src_index(src, m.time(i), src_ix);
+				if (r != string::npos)
+					src_ix = r;
+				return r;
+			}
+		};
+
+		/** \brief specialize for generic_dt, dispatch on the underlying src type once per lookup,
+		* fixed_dt src is arithmetic, point_dt src is the incremental walk, calendar_dt uses its index_of.
+		*/
+		template<>
+		struct time_axis_map<time_axis::generic_dt, time_axis::generic_dt> {
+			time_axis::generic_dt const src;
+			size_t src_ix = string::npos;
+			time_axis::generic_dt const m;
+			time_axis_map(time_axis::generic_dt const&src, time_axis::generic_dt const&m) :src(src), m(m) {}
+
+			inline size_t src_index(size_t i) {
+				if (i >= m.size())
+					return string::npos;
+				const utctime t = m.gt == generic_dt::FIXED ? m.f.t + utctimespan(i)*m.f.dt : m.time(i);
+				switch (src.gt) {
+				default:
+				case generic_dt::FIXED: return detail::fixed_src_index(src.f, t);
+				case generic_dt::CALENDAR: return src.c.index_of(t);
+				case generic_dt::POINT: {
+					auto r = detail::point_src_index(src.p, t, src_ix);
+					if (r != string::npos)
+						src_ix = r;
+					return r;
+				}
+				}
 			}
 		};
 
@@ -1520,7 +1980,9 @@ namespace shyft {
 		*           all points of a, plus points of b not covered by a
 		*/
 		inline point_dt merge(const point_dt& a, const point_dt& b, const merge_info& m) {
-			return point_dt{ merge(a.t,b.t,m),m.t_end };
+			if (m.size() == 0) // a covers b, keep sharing the points of a
+				return point_dt{ a.t,m.t_end };
+			return point_dt{ merge(a.t.vec(),b.t.vec(),m),m.t_end };
 		}
 
         /** convert any time-axis to it's point_dt equivalent */
@@ -1571,10 +2033,55 @@ namespace shyft {
 			if (!can_merge(a, b)) throw runtime_error("can not merge time-axis, not compatible or disjoint total_period");
 			return merge(a, b, compute_merge_info(a, b));
 		}
+
+		/** \brief calendar terms of each period of a time-axis, computed once and shared by all cells of a run
+		 *
+		 * Routines like gamma_snow need the day of year, and the start of the year, of each time-step.
+		 * Instead of calendar arithmetic for each cell and step, the terms are computed once for the time-axis,
+		 * and the stacks read them by index, ref. calendar_terms::shared.
+		 * The terms are computed with the utc calendar, the same as the routines use.
+		 */
+		struct calendar_terms {
+			vector<utctime> year_start;///< start of the year of each period start
+			vector<size_t> day_of_year;///< day of year of each period start, 1..366
+
+			calendar_terms() {}
+			template <class TA>
+			explicit calendar_terms(const TA& ta, const calendar& cal = calendar()) {
+				const size_t n = ta.size();
+				year_start.reserve(n);
+				day_of_year.reserve(n);
+				for (size_t i = 0; i < n; ++i) {
+					const utctime t = ta.time(i);
+					year_start.push_back(cal.trim(t, calendar::YEAR));
+					day_of_year.push_back(cal.day_of_year(t));
+				}
+			}
+			size_t size() const { return day_of_year.size(); }
+
+			/** \brief the terms of the time-axis, computed on first request, and reused as long as the time-axis is the same
+			 *
+			 * One entry is kept for each time-axis type, so the cells of a run, all using the same time-axis,
+			 * share one computation. Thread-safe.
+			 */
+			template <class TA>
+			static shared_ptr<const calendar_terms> shared(const TA& ta) {
+				static mutex mx;
+				static TA cached_ta;
+				static shared_ptr<const calendar_terms> cached;
+				lock_guard<mutex> lock(mx);
+				if (!cached || !(cached_ta == ta)) {
+					cached = make_shared<const calendar_terms>(ta);
+					cached_ta = ta;
+				}
+				return cached;
+			}
+		};
     }
 }
 //--serialization support
 x_serialize_binary(shyft::time_axis::fixed_dt);
+x_serialize_binary(shyft::time_axis::fixed_dt_us);
 x_serialize_export_key_nt(shyft::time_axis::calendar_dt);
 x_serialize_export_key_nt(shyft::time_axis::point_dt);
 x_serialize_export_key_nt(shyft::time_axis::generic_dt);
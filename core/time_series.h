@@ -11,6 +11,7 @@
 #include <type_traits>
 #include <algorithm>
 #include <sstream>
+#include <complex>
 #include "core_serialization.h"
 
 #include "utctime_utilities.h"
@@ -125,6 +126,62 @@ namespace shyft{
             typedef T type;
         };
 
+        /** Resolves compiletime to dispatch bulk value evaluation, .values(i0,n,r), where supported,
+         * otherwise the values are evaluated one by one by .value(i).
+         */
+        template <class T, typename = void>
+        struct values_dispatcher : std::false_type {
+            static void values(const T& ts, size_t i0, size_t n, double* r) {
+                for (size_t k = 0; k < n; ++k) r[k] = ts.value(i0 + k);
+            }
+        };
+
+        template <class T> struct values_dispatcher<
+            T, std::enable_if_t<std::is_same<decltype(std::declval<const T&>().values(size_t(0), size_t(0), (double*)nullptr)), void>::value>
+        > : std::true_type {
+            static void values(const T& ts, size_t i0, size_t n, double* r) { ts.values(i0, n, r); }
+        };
+
+        /** \brief bulk evaluation of values [i0..i0+n> of ts, object or shared_ptr, into r
+         *
+         * Equal to r[k]=ts.value(i0+k), but series and expressions that provide .values(i0,n,r) compute
+         * the range in one pass, e.g. without a time-axis lookup for each value.
+         * \note i0+n must be <= ts.size()
+         */
+        template <class T>
+        void values_of(const T& ts, size_t i0, size_t n, double* r) {
+            typedef typename d_ref_t<T>::type ts_t;
+            values_dispatcher<ts_t>::values(d_ref(ts), i0, n, r);
+        }
+
+
+        /** \brief ts_cursor evaluates f(t) of a series for increasing t, keeping the index of the previous t
+         *
+         * Series that provide operator()(t,ix_hint), like point_ts and ref_ts, then search the time-axis from the
+         * previous index, so a sequential scan is O(1) amortized per point also on point_dt axes.
+         * Other series are evaluated by their plain operator()(t).
+         * The cursor keeps a reference to the series, that must outlive it.
+         * \tparam TS the time-series type, object or shared_ptr
+         */
+        template <class TS>
+        class ts_cursor {
+            typedef typename d_ref_t<TS>::type ts_t;
+            const ts_t& ts;
+            size_t ix = std::string::npos;
+
+            template <class T>
+            static auto hinted(const T& s, utctime t, size_t& ix_hint, int) -> decltype(s(t, ix_hint)) { return s(t, ix_hint); }
+            template <class T>
+            static double hinted(const T& s, utctime t, size_t&, long) { return s(t); }
+          public:
+            explicit ts_cursor(const TS& ts) : ts(d_ref(ts)) {}
+            /** \return f(t), the fastest when t is increasing from call to call */
+            double operator()(utctime t) { return hinted(ts, t, ix, 0); }
+            /** \return the time-axis index of the last t, npos if unknown or outside */
+            size_t index() const { return ix; }
+            /** \brief f(t) of s, using and updating ix_hint if s supports it */
+            static double value_at(const ts_t& s, utctime t, size_t& ix_hint) { return hinted(s, t, ix_hint, 0); }
+        };
 
         /** \brief hint_based search to eliminate binary-search in irregular time-point series.
          *
@@ -174,6 +231,56 @@ namespace shyft{
             return source.index_of(p.start);// no hint given, just use binary search to establish the start.
         }
 
+        /** \brief aligned accumulate over the values of a fixed_dt source
+         *
+         * When p starts and ends on the time-points of the source, and is within its total period,
+         * the accumulate_value is a plain reduction over the values, done here in one branch-free loop
+         * that the compiler can vectorize. The nan-handling is the same as for accumulate_value:
+         * stair-case steps count only if the step value is finite, linear steps only if both ends are finite,
+         * and the last step of the source does not count for linear (no right point to form the line).
+         * \return false if p is not aligned to ta, then the caller should use the generic point-walk
+         */
+        template <class V>
+        inline bool fixed_dt_accumulate_values(const time_axis::fixed_dt& ta, const V* v, const utcperiod& p, bool linear, size_t& last_idx, utctimespan& tsum, double& area) {
+            if (ta.n == 0 || ta.dt <= 0 || p.end <= p.start || p.start < ta.t || p.end > ta.t + utctimespan(ta.n)*ta.dt)
+                return false;
+            if ((p.start - ta.t) % ta.dt != 0 || (p.end - ta.t) % ta.dt != 0)
+                return false;
+            const size_t s = (p.start - ta.t)/ta.dt;
+            const size_t e = (p.end - ta.t)/ta.dt;
+            double sum = 0.0;
+            size_t c = 0;
+            if (linear) {
+                const size_t e1 = std::min(e, ta.n - 1);
+                for (size_t j = s; j < e1; ++j) {
+                    const double a = v[j], b = v[j + 1];
+                    const bool ok = std::isfinite(a) && std::isfinite(b);
+                    sum += ok ? a + b : 0.0;
+                    c += ok;
+                }
+                sum *= 0.5;
+            } else {
+                for (size_t j = s; j < e; ++j) {
+                    const double a = v[j];
+                    const bool ok = std::isfinite(a);
+                    sum += ok ? a : 0.0;
+                    c += ok;
+                }
+            }
+            tsum = utctimespan(c)*ta.dt;
+            area = sum*ta.dt;
+            last_idx = std::min(e, ta.n - 1);
+            return true;
+        }
+
+        /** \brief fast path hook for accumulate_value, specialized below for point_ts on fixed_dt
+         * \return false if there is no fast path for S, or p
+         */
+        template <class S>
+        inline bool fixed_dt_accumulate(const S& source, const utcperiod& p, bool linear, size_t& last_idx, utctimespan& tsum, double& area) {
+            return false;
+        }
+
 
         /** \brief accumulate_value provides a projection/interpretation
         * of the values of a point source on to a time-axis as provided.
@@ -202,6 +309,11 @@ namespace shyft{
 			const bool extrapolate_flat = !linear || (linear && !strict_linear_between);
 			if (n == 0) // early exit if possible
                 return nan;
+            if (!extrapolate_flat || !linear) { // aligned fixed_dt sources are a plain reduction, ref. fixed_dt_accumulate_values
+                double area = 0.0;
+                if (fixed_dt_accumulate(source, p, linear, last_idx, tsum, area))
+                    return tsum ? area : nan;
+            }
             size_t i = hint_based_search(source, p, last_idx);  // use last_idx as hint, allowing sequential periodic average to execute at high speed(no binary searches)
 			point l;// Left point
 			bool l_finite = false;
@@ -306,6 +418,103 @@ namespace shyft{
             return tsum>0?area/tsum:nan;
         }
 
+        /** \brief prefix-integral table of a point source, giving any accumulate_value, average_value in O(log n)
+         *
+         * One linear pass over the points computes the area and the non-nan time from the first point
+         * up to each point, using the same f(t) and nan-semantics as accumulate_value with strict linear between:
+         * stair-case steps count if the step value is finite, and extends flat after the last point,
+         * linear steps count if both ends are finite, and there is no contribution after the last point.
+         * The integral over a period is then the difference of two lookups, a binary search on the points.
+         *
+         * \note the prefix areas are subtracted, so the result can differ in the last digits from accumulate_value,
+         *  more so for long series with large areas.
+         */
+        struct prefix_integral {
+            std::vector<utctime> t;///< the time of each point
+            std::vector<double> v;///< the value of each point
+            std::vector<double> area;///< area[k], the area from t[0] to t[k]
+            std::vector<utctimespan> tsum;///< tsum[k], the non-nan time from t[0] to t[k]
+            bool linear = true;
+
+            prefix_integral() = default;
+            prefix_integral(std::vector<utctime> t_, std::vector<double> v_, bool linear)
+                : t(std::move(t_)), v(std::move(v_)), linear(linear) {
+                if (t.size() != v.size())
+                    throw std::runtime_error("prefix_integral: the number of times and values differ");
+                const size_t n = t.size();
+                area.resize(n);
+                tsum.resize(n);
+                double a = 0.0;
+                utctimespan s = 0;
+                for (size_t k = 0; k < n; ++k) {
+                    area[k] = a;
+                    tsum[k] = s;
+                    if (k + 1 < n) {
+                        const utctimespan dt = t[k + 1] - t[k];
+                        if (linear ? std::isfinite(v[k]) && std::isfinite(v[k + 1]) : std::isfinite(v[k])) {
+                            a += linear ? 0.5*(v[k] + v[k + 1])*dt : v[k]*dt;
+                            s += dt;
+                        }
+                    }
+                }
+            }
+
+            /** \brief the table of the points of source S, with .size() and .get(i) */
+            template <class S>
+            static prefix_integral of(const S& source, bool linear) {
+                const size_t n = source.size();
+                std::vector<utctime> t; t.reserve(n);
+                std::vector<double> v; v.reserve(n);
+                for (size_t i = 0; i < n; ++i) {
+                    const auto p = source.get(i);
+                    t.push_back(p.t);
+                    v.push_back(p.v);
+                }
+                return prefix_integral(std::move(t), std::move(v), linear);
+            }
+
+            size_t size() const { return t.size(); }
+
+            /** \brief the area and the non-nan time from t[0] to x */
+            void at(utctime x, double& a, utctimespan& s) const {
+                a = 0.0;
+                s = 0;
+                if (t.empty() || x <= t.front())
+                    return;
+                const size_t k = size_t(std::upper_bound(t.begin(), t.end(), x) - t.begin()) - 1;
+                a = area[k];
+                s = tsum[k];
+                const utctimespan dx = x - t[k];
+                if (dx == 0 || !std::isfinite(v[k]))
+                    return;
+                if (!linear) {
+                    a += v[k]*dx;
+                    s += dx;
+                } else if (k + 1 < t.size() && std::isfinite(v[k + 1])) {
+                    const double slope = (v[k + 1] - v[k])/(t[k + 1] - t[k]);
+                    a += dx*(v[k] + 0.5*slope*dx);
+                    s += dx;
+                }
+            }
+
+            /** \brief as accumulate_value(source,p,..,tsum,linear) \return the area, nan if tsum is 0 */
+            double accumulate(const utcperiod& p, utctimespan& tsum_p) const {
+                double a0, a1;
+                utctimespan s0, s1;
+                at(p.start, a0, s0);
+                at(p.end, a1, s1);
+                tsum_p = s1 - s0;
+                return tsum_p ? a1 - a0 : nan;
+            }
+
+            /** \brief as average_value(source,p,..,linear) */
+            double average(const utcperiod& p) const {
+                utctimespan s = 0;
+                const double a = accumulate(p, s);
+                return s > 0 ? a/s : nan;
+            }
+        };
+
 
 
         /**\brief point time-series, pts, defined by
@@ -316,13 +525,19 @@ namespace shyft{
          * f(t) on each interval of the time-axis (linear or stair-case)
          * and
          * value of the i'th interval of the time-series.
+         *
+         * \tparam TA the time-axis type
+         * \tparam V the value type used for storage, default double.
+         *  float can be used to halve the memory footprint of large collections of series, like
+         *  the cell env_ts and response series, the interface (value(),set(),add etc.) is still double.
          */
-        template <class TA>
+        template <class TA, class V = double>
         struct point_ts {
 			typedef TA ta_t;
+			typedef V value_t;
 
             TA ta;
-            vector<double> v;
+            vector<V> v;
 			ts_point_fx fx_policy = POINT_INSTANT_VALUE;
 
             ts_point_fx point_interpretation() const { return fx_policy; }
@@ -334,21 +549,21 @@ namespace shyft{
 				: ta{ ta }, v(ta.size(), fill_value), fx_policy{ fx_policy } { }
 
 			point_ts(const TA & ta, const vector<double> & vx, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
-				: ta{ ta }, v{ vx }, fx_policy{ fx_policy }
+				: ta{ ta }, v( vx.begin(), vx.end() ), fx_policy{ fx_policy }
 			{
                 if(ta.size() != v.size())
                     throw runtime_error("point_ts: time-axis size is different from value-size");
             }
 
 			point_ts(TA && tax, vector<double> && vx, ts_point_fx fx_policy= POINT_INSTANT_VALUE )
-				: ta{ std::move(tax) }, v{ std::move(vx) }, fx_policy{ fx_policy }
+				: ta{ std::move(tax) }, v{ storage_values(std::move(vx), (V*)nullptr) }, fx_policy{ fx_policy }
 			{
 				if(ta.size() != v.size())
 					throw runtime_error("point_ts: time-axis size is different from value-size");
 			}
 
 			point_ts(const TA & tax, vector<double> && vx, ts_point_fx fx_policy= POINT_INSTANT_VALUE )
-				: ta{ tax }, v{ std::move(vx) }, fx_policy{ fx_policy }
+				: ta{ tax }, v{ storage_values(std::move(vx), (V*)nullptr) }, fx_policy{ fx_policy }
 			{
 				if(ta.size() != v.size())
 					throw runtime_error("point_ts: time-axis size is different from value-size");
@@ -363,21 +578,23 @@ namespace shyft{
 
             /**\brief the function value f(t) at time t, fx_policy taken into account */
             double operator()(utctime t) const {
-                size_t i = ta.index_of(t);
-                if(i == string::npos) return nan;
-                if( fx_policy==ts_point_fx::POINT_INSTANT_VALUE && i+1<ta.size() && isfinite(v[i+1])) {
-                    utctime t1=ta.time(i);
-                    utctime t2=ta.time(i+1);
-                    double f= double(t2-t)/double(t2-t1);
-                    return v[i]*f + (1.0-f)*v[i+1];
-                }
-                return v[i]; // just keep current value flat to +oo or nan
+                return value_at_index(ta.index_of(t), t);
+            }
+            /**\brief as f(t), but the time-axis search starts at ix_hint, and ix_hint is updated to the index of t
+             *
+             * Sequential access, e.g. by ts_cursor, with increasing t is then O(1) amortized per point on point_dt axes.
+             */
+            double operator()(utctime t, size_t& ix_hint) const {
+                ix_hint = time_axis::ta_index_of(ta, t, ix_hint);
+                return value_at_index(ix_hint, t);
             }
 
             /**\brief i'th value of the value,
              */
             double value(size_t i) const  { return v[i]; }
-            const vector<double> values() const {return v;};
+            const vector<double> values() const {return vector<double>(v.begin(), v.end());};
+            /** \brief values [i0..i0+n> into r, ref. values_of */
+            void values(size_t i0, size_t n, double* r) const { std::copy(v.begin() + i0, v.begin() + i0 + n, r); }
             // BW compatiblity ?
             size_t size() const { return ta.size();}
             size_t index_of(utctime t) const {return ta.index_of(t);}
@@ -390,16 +607,290 @@ namespace shyft{
             // Additional write/modify interface to operate directly on the values in the time-series
             void set(size_t i,double x) {v[i]=x;}
             void add(size_t i, double value) { v[i] += value; }
-            void add(const point_ts<TA>& other) {
-                std::transform(begin(v), end(v), other.v.cbegin(), begin(v), std::plus<double>());
+            template <class V2>
+            void add(const point_ts<TA, V2>& other) {
+                std::transform(begin(v), end(v), other.v.cbegin(), begin(v), [](double a, double b) {return a + b; });
             }
-            void add_scale(const point_ts<TA>&other,double scale) {
+            template <class V2>
+            void add_scale(const point_ts<TA, V2>&other,double scale) {
                 std::transform(begin(v), end(v), other.v.cbegin(), begin(v), [scale](double a, double b) {return a + b*scale; });
             }
             void fill(double value) { std::fill(begin(v), end(v), value); }
             void fill_range(double value, int start_step, int n_steps) { if (n_steps == 0)fill(value); else std::fill(begin(v) + start_step, begin(v) + start_step + n_steps, value); }
-            void scale_by(double value) { std::for_each(begin(v), end(v), [value](double&v){v *= value; }); }
+            void scale_by(double value) { std::for_each(begin(v), end(v), [value](V&v){v *= value; }); }
+          private:
+            double value_at_index(size_t i, utctime t) const {
+                if(i == string::npos) return nan;
+                if( fx_policy==ts_point_fx::POINT_INSTANT_VALUE && i+1<ta.size() && isfinite(v[i+1])) {
+                    utctime t1=ta.time(i);
+                    utctime t2=ta.time(i+1);
+                    double f= double(t2-t)/double(t2-t1);
+                    return v[i]*f + (1.0-f)*v[i+1];
+                }
+                return v[i]; // just keep current value flat to +oo or nan
+            }
+            static vector<double> storage_values(vector<double>&& x, double*) { return std::move(x); }
+            template <class V2>
+            static vector<V2> storage_values(vector<double>&& x, V2*) { return vector<V2>(x.begin(), x.end()); }
+          public:
+            x_serialize_decl();
+        };
+
+        /** \brief point time-series where copies share the values, until modified (copy on write)
+         *
+         * As point_ts, but a copy refers to the same value storage as the original, and
+         * the storage is copied only when one of them is modified.
+         * This allows one series, like the environment of cells with only one source, to be referenced by
+         * many cells, without copying the values into each cell.
+         * A series constructed with a fill value, or filled, keeps no storage until a value is set.
+         *
+         * \tparam TA the time-axis type
+         * \tparam V the value type used for storage, default double.
+         */
+        template <class TA, class V = double>
+        struct shared_point_ts {
+            typedef TA ta_t;
+            typedef V value_t;
+
+            TA ta;
+            ts_point_fx fx_policy = POINT_INSTANT_VALUE;
+          private:
+            shared_ptr<vector<V>> v;///< nullptr means all values are fill_value
+            double fill_value = nan;
+
+            V* writable() {
+                if (!v)
+                    v = make_shared<vector<V>>(ta.size(), V(fill_value));
+                else if (v.use_count() > 1)
+                    v = make_shared<vector<V>>(*v);
+                return v->data();
+            }
+          public:
+            ts_point_fx point_interpretation() const { return fx_policy; }
+            void set_point_interpretation(ts_point_fx point_interpretation) { fx_policy = point_interpretation; }
+
+            shared_point_ts() = default;
+            shared_point_ts(const TA& ta, double fill_value, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
+                : ta{ ta }, fx_policy{ fx_policy }, fill_value{ fill_value } {}
+            shared_point_ts(const TA& ta, const vector<double>& vx, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
+                : ta{ ta }, fx_policy{ fx_policy }, v{ make_shared<vector<V>>(vx.begin(), vx.end()) } {
+                if (ta.size() != v->size())
+                    throw runtime_error("shared_point_ts: time-axis size is different from value-size");
+            }
+            explicit shared_point_ts(const point_ts<TA, V>& o)
+                : ta{ o.ta }, fx_policy{ o.fx_policy }, v{ make_shared<vector<V>>(o.v) } {}
+
+            const TA& time_axis() const { return ta; }
+
+            /**\brief the function value f(t) at time t, fx_policy taken into account */
+            double operator()(utctime t) const { return value_at_index(ta.index_of(t), t); }
+            /**\brief as f(t), with a time-axis search hint, ref. point_ts */
+            double operator()(utctime t, size_t& ix_hint) const {
+                ix_hint = time_axis::ta_index_of(ta, t, ix_hint);
+                return value_at_index(ix_hint, t);
+            }
+            double value(size_t i) const { return v ? double((*v)[i]) : fill_value; }
+            const vector<double> values() const { return v ? vector<double>(v->begin(), v->end()) : vector<double>(ta.size(), fill_value); }
+            void values(size_t i0, size_t n, double* r) const {
+                if (v) std::copy(v->begin() + i0, v->begin() + i0 + n, r);
+                else std::fill(r, r + n, fill_value);
+            }
+            size_t size() const { return ta.size(); }
+            size_t index_of(utctime t) const { return ta.index_of(t); }
+            utcperiod total_period() const { return ta.total_period(); }
+            utctime time(size_t i) const { return ta.time(i); }
+            point get(size_t i) const { return point(ta.time(i), value(i)); }
+
+            void set(size_t i, double x) { writable()[i] = x; }
+            void add(size_t i, double value) { writable()[i] += value; }
+            void fill(double value) { v.reset(); fill_value = value; }
+            void fill_range(double value, int start_step, int n_steps) {
+                if (n_steps == 0) fill(value);
+                else std::fill(writable() + start_step, writable() + start_step + n_steps, V(value));
+            }
+            void scale_by(double value) {
+                if (!v) { fill_value *= value; return; }
+                V* w = writable();
+                std::for_each(w, w + ta.size(), [value](V& x) { x *= value; });
+            }
+
+            /** \return true if this and o refers to the same value storage */
+            bool shares_values_with(const shared_point_ts& o) const { return v && v == o.v; }
+            /** \return the heap bytes of the values, split among the series sharing them, ref. region_model::memory_usage */
+            size_t heap_bytes() const { return v ? v->capacity()*sizeof(V)/size_t(std::max(1L, long(v.use_count()))) : 0; }
+          private:
+            double value_at_index(size_t i, utctime t) const {
+                if (i == string::npos) return nan;
+                if (fx_policy == ts_point_fx::POINT_INSTANT_VALUE && i + 1 < ta.size() && isfinite(value(i + 1))) {
+                    utctime t1 = ta.time(i);
+                    utctime t2 = ta.time(i + 1);
+                    double f = double(t2 - t)/double(t2 - t1);
+                    return value(i)*f + (1.0 - f)*value(i + 1);
+                }
+                return value(i);
+            }
+        };
+
+        /** \brief non-owning point time-series view over externally owned values
+         *
+         * Same read-only ts concept as point_ts, but the values are a pointer into memory owned by someone else,
+         * like a numpy array, a memory-mapped dtss file or a cell response buffer, so it wraps them without copying.
+         * The time-axis is kept by value, the owner of the values must outlive the view, and keep the values unchanged
+         * while the view, or expressions of it, are in use.
+         *
+         * \tparam TA the time-axis type
+         * \tparam V the value type of the external buffer, default double
+         */
+        template <class TA, class V = double>
+        struct point_ts_view {
+            typedef TA ta_t;
+            typedef V value_t;
+
+            TA ta;
+            const V* v = nullptr;///< ta.size() values, not owned
+            ts_point_fx fx_policy = POINT_INSTANT_VALUE;
+
+            ts_point_fx point_interpretation() const { return fx_policy; }
+            void set_point_interpretation(ts_point_fx point_interpretation) { fx_policy = point_interpretation; }
+
+            point_ts_view() = default;
+            point_ts_view(const TA& ta, const V* v, size_t n, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
+                : ta{ ta }, v{ v }, fx_policy{ fx_policy } {
+                if (ta.size() != n)
+                    throw runtime_error("point_ts_view: time-axis size is different from value-size");
+            }
+            /** a view of the values of o, valid as long as o is not resized or destroyed */
+            explicit point_ts_view(const point_ts<TA, V>& o) : ta{ o.ta }, v{ o.v.data() }, fx_policy{ o.fx_policy } {}
+
+            const TA& time_axis() const { return ta; }
+
+            /**\brief the function value f(t) at time t, fx_policy taken into account */
+            double operator()(utctime t) const { return value_at_index(ta.index_of(t), t); }
+            /**\brief as f(t), with a time-axis search hint, ref. point_ts */
+            double operator()(utctime t, size_t& ix_hint) const {
+                ix_hint = time_axis::ta_index_of(ta, t, ix_hint);
+                return value_at_index(ix_hint, t);
+            }
+            double value(size_t i) const { return v[i]; }
+            vector<double> values() const { return vector<double>(v, v + ta.size()); }
+            /** \brief values [i0..i0+n> into r, ref. values_of */
+            void values(size_t i0, size_t n, double* r) const { std::copy(v + i0, v + i0 + n, r); }
+            /** \return the external values, ta.size() of them */
+            const V* data() const { return v; }
+            size_t size() const { return ta.size(); }
+            size_t index_of(utctime t) const { return ta.index_of(t); }
+            utcperiod total_period() const { return ta.total_period(); }
+            utctime time(size_t i) const { return ta.time(i); }
+            point get(size_t i) const { return point(ta.time(i), value(i)); }
+          private:
+            double value_at_index(size_t i, utctime t) const {
+                if (i == string::npos) return nan;
+                if (fx_policy == ts_point_fx::POINT_INSTANT_VALUE && i + 1 < ta.size() && isfinite(double(v[i + 1]))) {
+                    utctime t1 = ta.time(i);
+                    utctime t2 = ta.time(i + 1);
+                    double f = double(t2 - t)/double(t2 - t1);
+                    return v[i]*f + (1.0 - f)*v[i + 1];
+                }
+                return v[i];
+            }
+        };
+
+        /**\brief run-length encoded point time-series, for piecewise constant series
+         *
+         * Same ts concept as point_ts, but the values are kept as runs of equal values (nan equals nan),
+         * so series like restrictions, flags and regimes with long constant or nan periods takes
+         * memory proportional to the number of changes, not to the number of points.
+         * value(i) is a binary search over the runs, bulk evaluation by values(i0,n,r) fills run by run.
+         * The values are read-only, except fill and scale_by, that keeps the runs.
+         *
+         * \tparam TA the time-axis type
+         */
+        template <class TA>
+        struct rle_point_ts {
+            typedef TA ta_t;
+            TA ta;
+            ts_point_fx fx_policy = POINT_INSTANT_VALUE;
+            vector<size_t> run_start;///< first index of each run, run_start[0]==0 if not empty
+            vector<double> run_value;///< the value of each run
+
+            ts_point_fx point_interpretation() const { return fx_policy; }
+            void set_point_interpretation(ts_point_fx point_interpretation) { fx_policy = point_interpretation; }
+
+            rle_point_ts() = default;
+            rle_point_ts(const TA& ta, double fill_value, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
+                : ta{ ta }, fx_policy{ fx_policy } {
+                if (ta.size()) { run_start.push_back(0); run_value.push_back(fill_value); }
+            }
+            rle_point_ts(const TA& ta, const vector<double>& vx, ts_point_fx fx_policy = POINT_INSTANT_VALUE)
+                : ta{ ta }, fx_policy{ fx_policy } {
+                if (ta.size() != vx.size())
+                    throw runtime_error("rle_point_ts: time-axis size is different from value-size");
+                encode(vx.data(), vx.size());
+            }
+            template <class V>
+            explicit rle_point_ts(const point_ts<TA, V>& o) : ta{ o.ta }, fx_policy{ o.fx_policy } {
+                encode(o.v.data(), o.v.size());
+            }
+
+            const TA& time_axis() const { return ta; }
+            size_t size() const { return ta.size(); }
+            size_t n_runs() const { return run_start.size(); }
+            size_t index_of(utctime t) const { return ta.index_of(t); }
+            utcperiod total_period() const { return ta.total_period(); }
+            utctime time(size_t i) const { return ta.time(i); }
+            point get(size_t i) const { return point(ta.time(i), value(i)); }
+
+            double value(size_t i) const { return run_value[run_of(i)]; }
+            double operator()(utctime t) const {
+                const size_t i = ta.index_of(t);
+                if (i == string::npos) return nan;
+                const size_t r = run_of(i);
+                if (fx_policy == ts_point_fx::POINT_INSTANT_VALUE && i + 1 < ta.size()) {
+                    const double v1 = (r + 1 < run_start.size() && run_start[r + 1] == i + 1) ? run_value[r + 1] : run_value[r];
+                    if (isfinite(v1)) {
+                        utctime t1 = ta.time(i);
+                        utctime t2 = ta.time(i + 1);
+                        double f = double(t2 - t)/double(t2 - t1);
+                        return run_value[r]*f + (1.0 - f)*v1;
+                    }
+                }
+                return run_value[r];
+            }
+            /** \brief values [i0..i0+n> into r, filled run by run */
+            void values(size_t i0, size_t n, double* r) const {
+                if (n == 0) return;
+                size_t k = run_of(i0);
+                for (size_t i = i0, e = i0 + n; i < e; ++k) {
+                    const size_t run_end = std::min(k + 1 < run_start.size() ? run_start[k + 1] : ta.size(), e);
+                    std::fill(r + (i - i0), r + (run_end - i0), run_value[k]);
+                    i = run_end;
+                }
+            }
+            vector<double> values() const {
+                vector<double> r(ta.size());
+                values(0, r.size(), r.data());
+                return r;
+            }
+            void fill(double value) {
+                run_start.clear(); run_value.clear();
+                if (ta.size()) { run_start.push_back(0); run_value.push_back(value); }
+            }
+            void scale_by(double value) { for (auto& x : run_value) x *= value; }
             x_serialize_decl();
+          private:
+            size_t run_of(size_t i) const {
+                return size_t(std::upper_bound(run_start.begin(), run_start.end(), i) - run_start.begin()) - 1;
+            }
+            template <class V>
+            void encode(const V* v, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    const double x = v[i];
+                    if (run_value.empty() || !(x == run_value.back() || (std::isnan(x) && std::isnan(run_value.back())))) {
+                        run_start.push_back(i);
+                        run_value.push_back(x);
+                    }
+                }
+            }
         };
 
         /** \brief time_shift ts do a time-shift dt on the supplied ts
@@ -462,6 +953,7 @@ namespace shyft{
 
             //--
             double value(size_t i) const { return ts.value(i);}
+            void values(size_t i0, size_t n, double* r) const { values_of(ts, i0, n, r); }
             double operator()(utctime t) const { return ts(t-dt);} ///< just here we needed the dt
             x_serialize_decl();
         };
@@ -499,6 +991,14 @@ namespace shyft{
                 //TODO: make specialized pr. time-axis average_value, since average of fixed_dt is trivial compared to other ta.
                 return average_value(ts,ta.period(i),ix_hint,d_ref(ts).fx_policy == ts_point_fx::POINT_INSTANT_VALUE);// also note: average of non-nan areas !
             }
+            /** \brief values [i0..i0+n> into r, each average continues the source search from the previous period */
+            void values(size_t i0, size_t n, double* r) const {
+                if (n == 0) return;
+                size_t ix_hint = (i0*d_ref(ts).ta.size())/ta.size();
+                const bool linear = d_ref(ts).fx_policy == ts_point_fx::POINT_INSTANT_VALUE;
+                for (size_t k = 0; k < n; ++k)
+                    r[k] = average_value(ts, ta.period(i0 + k), ix_hint, linear);
+            }
             double operator()(utctime t) const {
                 size_t i=ta.index_of(t);
                 if( i==string::npos)
@@ -553,6 +1053,27 @@ namespace shyft{
                 utctimespan tsum;
                 return accumulate_value(ts, accumulate_period, ix_hint,tsum, d_ref(ts).fx_policy == ts_point_fx::POINT_INSTANT_VALUE);// also note: average of non-nan areas !
             }
+            /** \brief values [i0..i0+n> into r, each value adds the accumulation of one more period to the previous one
+             *
+             * As value(i), nan areas are skipped, and the value is nan until some non-nan area is accumulated.
+             */
+            void values(size_t i0, size_t n, double* r) const {
+                if (n == 0) return;
+                r[0] = value(i0);
+                double area = std::isfinite(r[0]) ? r[0] : 0.0;
+                bool any_area = i0 > 0 && std::isfinite(r[0]);
+                size_t ix_hint = std::string::npos;
+                const bool linear = d_ref(ts).fx_policy == ts_point_fx::POINT_INSTANT_VALUE;
+                for (size_t k = 1; k < n; ++k) {
+                    utctimespan tsum = 0;
+                    const double a = accumulate_value(ts, utcperiod(ta.time(i0 + k - 1), ta.time(i0 + k)), ix_hint, tsum, linear);
+                    if (std::isfinite(a) && tsum) {
+                        area += a;
+                        any_area = true;
+                    }
+                    r[k] = any_area ? area : nan;
+                }
+            }
             double operator()(utctime t) const {
                 size_t i = ta.index_of(t);
                 if (i == string::npos || ta.size()==0)
@@ -611,6 +1132,14 @@ namespace shyft{
             x_serialize_decl();
         };
 
+        /** \brief the period length of a time-axis with equidistant periods, 0 if the time-axis is not known to be equidistant
+         * \sa profile_accessor::values
+         */
+        template <class TA>
+        inline utctimespan equidistant_dt(const TA&) { return utctimespan(0); }
+        inline utctimespan equidistant_dt(const time_axis::fixed_dt& ta) { return ta.dt; }
+        inline utctimespan equidistant_dt(const time_axis::generic_dt& ta) { return ta.gt == time_axis::generic_dt::FIXED ? ta.f.dt : utctimespan(0); }
+
         /** \brief profile accessor that enables use of average_value etc.
          *
          * The profile accessor provide a 'point-source' compatible interface signatures
@@ -674,6 +1203,38 @@ namespace shyft{
 				utctimespan t_sum{ 0 };
                 return accumulate_value(*this, p, ix,t_sum, ts_point_fx::POINT_INSTANT_VALUE == fx_policy, false)/double(t_sum); // allow extending last point in pattern
             }
+            /** \brief returns value(i) for all the periods of the time-axis
+             *
+             * If the time-axis is equidistant with period dt, the values repeats every
+             * m = duration/gcd(duration,dt) periods, e.g. m=24 for an hourly axis and a daily profile.
+             * Then only the first m values are computed, the rest are picked by modulo index.
+             * The periods at the end, that reaches beyond the last profile point, are computed as by value(i).
+             */
+            std::vector<double> values() const {
+                std::vector<double> v;
+                v.reserve(ta.size());
+                const utctimespan dt = equidistant_dt(ta);
+                size_t m = 0;
+                if (dt > 0 && profile.dt > 0 && profile.size() > 0 && ta.size() > 0 && profile.t0 <= ta.time(0)) {
+                    utctimespan a = profile.duration(), b = dt;
+                    while (b) { auto r = a % b; a = b; b = r; }
+                    m = size_t(profile.duration()/a);
+                }
+                if (m == 0 || 2*m > ta.size()) {
+                    for (size_t i = 0; i < ta.size(); ++i)
+                        v.emplace_back(value(i));
+                    return v;
+                }
+                const utctime t_last = profile.t0 + utctimespan(size() - 1)*profile.dt;// time of the last profile point
+                const utctime t0 = ta.time(0);
+                for (size_t i = 0; i < ta.size(); ++i) {
+                    if (i < m || t0 + utctimespan(i + 1)*dt > t_last)
+                        v.emplace_back(value(i));
+                    else
+                        v.emplace_back(v[i % m]);
+                }
+                return v;
+            }
             // provided functions to the average_value<..> function
             size_t size() const { return profile.size() * (1 + ta.total_period().timespan() / profile.duration()); }
             point get(size_t i) const { return point(profile.t0 + i*profile.dt, profile(i % profile.size())); }
@@ -716,13 +1277,7 @@ namespace shyft{
             utcperiod total_period() const {return ta.total_period();}
             size_t index_of(utctime t) const { return ta.index_of(t); }
             double value(size_t i) const { return pa.value(i); }
-            std::vector<double> values() const {
-                std::vector<double> v;
-                v.reserve(ta.size());
-                for (size_t i=0; i<ta.size(); ++i)
-                    v.emplace_back(value(i));
-                return v;
-            }
+            std::vector<double> values() const { return pa.values(); }
 
             bool operator==(const periodic_ts &o) const { return fx_policy==o.fx_policy && ta==o.ta && pa.equal(o.pa,1e-30);}
             x_serialize_decl();
@@ -780,6 +1335,22 @@ namespace shyft{
                 double sca_m2_i= average_value(d_ref(sca_m2),p,ix_hint,d_ref(sca_m2).point_interpretation()==ts_point_fx::POINT_INSTANT_VALUE);
                 return shyft::core::glacier_melt::step(dtf, t_i,sca_m2_i, glacier_area_m2);
             }
+            /** \brief all the values, as value(i), computed in one pass over the time-axis
+             *
+             * The sca averaging continues from the source index of the previous period,
+             * instead of searching from i for each value.
+             */
+            vector<double> values() const {
+                const auto& ta = time_axis();
+                const auto& t_ts = d_ref(temperature);
+                const auto& sca_ts = d_ref(sca_m2);
+                const bool linear = sca_ts.point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE;
+                vector<double> r; r.reserve(ta.size());
+                size_t ix_hint = 0;
+                for (size_t i = 0; i < ta.size(); ++i)
+                    r.push_back(shyft::core::glacier_melt::step(dtf, t_ts.value(i), average_value(sca_ts, ta.period(i), ix_hint, linear), glacier_area_m2));
+                return r;
+            }
             double operator()(utctime t) const {
                 size_t i = index_of(t);
                 if (i == string::npos)
@@ -845,6 +1416,10 @@ namespace shyft{
             double operator()(utctime t) const {
                 return bts()(t);
             }
+            /**\brief as f(t), with a time-axis search hint, ref. ts_cursor */
+            double operator()(utctime t, size_t& ix_hint) const {
+                return ts_cursor<TS>::value_at(bts(), t, ix_hint);
+            }
 
             /**\brief the i'th value of ts
              */
@@ -890,6 +1465,90 @@ namespace shyft{
             USE_ZERO, ///< fill in zero for all values before value(0):shape preserving
             USE_NAN ///< nan filled in for the first length of the filter
         };
+        const size_t convolve_fft_threshold = 64;///< weight vectors of at least this size are convolved by fft overlap-add, ref. convolve_w_values
+
+        namespace fft {
+            /** \brief in-place iterative radix-2 fft, a.size() must be a power of two
+             * \param inverse if true the inverse transform, including the 1/n scaling
+             */
+            inline void transform(std::vector<std::complex<double>>& a, bool inverse) {
+                const size_t n = a.size();
+                for (size_t i = 1, j = 0; i < n; ++i) {// bit-reversal permutation
+                    size_t bit = n >> 1;
+                    for (; j & bit; bit >>= 1) j ^= bit;
+                    j ^= bit;
+                    if (i < j) std::swap(a[i], a[j]);
+                }
+                const double pi = 3.14159265358979323846;
+                for (size_t len = 2; len <= n; len <<= 1) {
+                    const double ang = 2*pi/double(len)*(inverse ? 1 : -1);
+                    const std::complex<double> wl(std::cos(ang), std::sin(ang));
+                    for (size_t i = 0; i < n; i += len) {
+                        std::complex<double> w(1.0, 0.0);
+                        for (size_t k = 0; k < len/2; ++k) {
+                            const auto u = a[i + k], v = a[i + k + len/2]*w;
+                            a[i + k] = u + v;
+                            a[i + k + len/2] = u - v;
+                            w *= wl;
+                        }
+                    }
+                }
+                if (inverse)
+                    for (auto& x : a) x /= double(n);
+            }
+        }
+
+        /** \brief the values of the convolution of x with weights w, as convolve_w_ts::value(i) for all i
+        *
+        * Short weight vectors are computed in direct form, O(n*m), while weight vectors of size convolve_fft_threshold or more,
+        * like the long unit hydro-graphs of slow rivers, are computed with fft overlap-add in blocks, O(n*log(m)).
+        * Series with nan values are always computed in direct form, so the nan only reaches the values it affects.
+        * \param x the values of the time-series
+        * \param w the weights, w[k] applies to x[i-k]
+        * \param policy how values before x[0] are resolved
+        */
+        inline std::vector<double> convolve_w_values(const std::vector<double>& x, const std::vector<double>& w, convolve_policy policy) {
+            const size_t n = x.size(), m = w.size();
+            std::vector<double> r(n, 0.0);
+            if (n == 0 || m == 0) return r;
+            const bool finite = std::all_of(begin(x), end(x), [](double v) { return std::isfinite(v); });
+            if (m < convolve_fft_threshold || !finite) {
+                for (size_t i = 0; i < n; ++i) {
+                    double v = 0.0;
+                    const size_t jn = std::min(m, i + 1);
+                    for (size_t j = 0; j < jn; ++j)
+                        v += w[j]*x[i - j];
+                    r[i] = v;
+                }
+            } else {
+                size_t nfft = 1;
+                while (nfft < 2*m) nfft <<= 1;
+                const size_t block = nfft - m + 1;
+                std::vector<std::complex<double>> fw(nfft), fx(nfft);
+                std::copy(begin(w), end(w), begin(fw));
+                fft::transform(fw, false);
+                for (size_t b = 0; b < n; b += block) {
+                    const size_t bn = std::min(block, n - b);
+                    std::fill(begin(fx), end(fx), std::complex<double>(0.0, 0.0));
+                    std::copy(begin(x) + b, begin(x) + b + bn, begin(fx));
+                    fft::transform(fx, false);
+                    for (size_t k = 0; k < nfft; ++k) fx[k] *= fw[k];
+                    fft::transform(fx, true);
+                    const size_t rn = std::min(nfft, n - b);
+                    for (size_t k = 0; k < rn; ++k) r[b + k] += fx[k].real();
+                }
+            }
+            if (policy != convolve_policy::USE_ZERO) {// the weights reaching before x[0]
+                double w_tail = 0.0;// sum of w[j], j > i
+                for (size_t i = m - 1; i-- > 0;) {
+                    w_tail += w[i + 1];
+                    if (i < n)
+                        r[i] = policy == convolve_policy::USE_FIRST ? r[i] + w_tail*x[0] : shyft::nan;
+                }
+            }
+            return r;
+        }
+
         /** \brief convolve_w convolves a time-series with weights w
         *
         * The resulting time-series value(i) is the result of convolution (ts*w)|w.size()
@@ -964,6 +1623,29 @@ namespace shyft{
             double operator()(utctime t) const {
                 return value(ts.index_of(t));
             }
+            /** \return all values, computed in one pass, using fft for long weight vectors, ref. convolve_w_values */
+            std::vector<double> values() const {
+                std::vector<double> x(ts.size());
+                values_of(ts, 0, x.size(), x.data());
+                return convolve_w_values(x, w, policy);
+            }
+            /** \brief values [i0..i0+n> into r, in direct form, the source values are evaluated once for the range */
+            void values(size_t i0, size_t n, double* r) const {
+                if (n == 0) return;
+                const size_t m = w.size();
+                const size_t j0 = i0 + 1 > m ? i0 + 1 - m : 0;// first source value reached
+                std::vector<double> x(i0 + n - j0);
+                values_of(ts, j0, x.size(), x.data());
+                const double x_before = policy == convolve_policy::USE_FIRST ? (j0 == 0 ? x[0] : ts.value(0)) :
+                                        (policy == convolve_policy::USE_ZERO ? 0.0 : nan);
+                for (size_t k = 0; k < n; ++k) {
+                    const size_t i = i0 + k;
+                    double v = 0.0;
+                    for (size_t j = 0; j < m; ++j)
+                        v += j <= i ? w[j]*x[i - j - j0] : w[j]*x_before;
+                    r[k] = v;
+                }
+            }
             x_serialize_decl();
         };
 
@@ -1026,9 +1708,18 @@ namespace shyft{
             double operator()(utctime t) const {
                 return value(index_of(t));
             }
+            /** member by member over blocks of the time-axis, so the block of the sum stays in cache, with the same result as value(i) */
             std::vector<double> values() const {
-                std::vector<double> r;r.reserve(size());
-                for (size_t i = 0;i < size();++i) r.push_back(value(i));
+                const size_t n = size(), block = 4096;
+                std::vector<double> r(n);
+                for (size_t i0 = 0;i0 < n;i0 += block) {
+                    const size_t i1 = std::min(n, i0 + block);
+                    for (size_t i = i0;i < i1;++i) r[i] = tsv[0].value(i);
+                    for (size_t j = 1;j < tsv.size();++j) {
+                        const auto& ts = tsv[j];
+                        for (size_t i = i0;i < i1;++i) r[i] += ts.value(i);
+                    }
+                }
                 return r;
             }
         };
@@ -1101,6 +1792,35 @@ namespace shyft{
                     return nan;
                 return value_at(ta.time(i));
             }
+            /** \brief values [i0..i0+n> into r, ref. values_of
+             *
+             * When both operands are on the time-axis of the result, the operands are evaluated in bulk,
+             * and combined in one straight loop, otherwise the operands are evaluated by a ts_cursor for each value.
+             */
+            void values(size_t i0, size_t n, double* r) const {
+                ensure_bound();
+                if (n == 0) return;
+                if (time_axis::equivalent_time_axis(d_ref(lhs).time_axis(), ta) && time_axis::equivalent_time_axis(d_ref(rhs).time_axis(), ta)) {
+                    std::vector<double> b(n);
+                    values_of(lhs, i0, n, r);
+                    values_of(rhs, i0, n, b.data());
+                    const double* bp = b.data();
+                    for (size_t k = 0; k < n; ++k)
+                        r[k] = op(r[k], bp[k]);
+                } else {
+                    ts_cursor<A> a(lhs);
+                    ts_cursor<B> b(rhs);
+                    for (size_t k = 0; k < n; ++k) {
+                        const utctime t = ta.time(i0 + k);
+                        r[k] = op(a(t), b(t));
+                    }
+                }
+            }
+            std::vector<double> values() const {
+                std::vector<double> r(size());
+                values(0, r.size(), r.data());
+                return r;
+            }
             size_t size() const {
 				ensure_bound();
                 return ta.size();
@@ -1159,6 +1879,15 @@ namespace shyft{
 
             double operator()(utctime t) const {return op(lhs,d_ref(rhs)(t));}
             double value(size_t i) const {return op(lhs,d_ref(rhs).value(i));}
+            void values(size_t i0, size_t n, double* r) const {
+                values_of(rhs, i0, n, r);
+                for (size_t k = 0; k < n; ++k) r[k] = op(lhs, r[k]);
+            }
+            std::vector<double> values() const {
+                std::vector<double> r(size());
+                values(0, r.size(), r.data());
+                return r;
+            }
             size_t size() const {
 				ensure_bound();
                 return ta.size();
@@ -1209,6 +1938,15 @@ namespace shyft{
             }
             double operator()(utctime t) const {return op(d_ref(lhs)(t),rhs);}
             double value(size_t i) const {return op(d_ref(lhs).value(i),rhs);}
+            void values(size_t i0, size_t n, double* r) const {
+                values_of(lhs, i0, n, r);
+                for (size_t k = 0; k < n; ++k) r[k] = op(r[k], rhs);
+            }
+            std::vector<double> values() const {
+                std::vector<double> r(size());
+                values(0, r.size(), r.data());
+                return r;
+            }
             size_t size() const {
 				ensure_bound();
                 return ta.size();
@@ -1422,8 +2160,50 @@ namespace shyft{
 
 				return flow;
 			}
+			/** Compute the flow for n levels into r, r can be the same as levels.
+			 *
+			 * Gives the same result as flow(level) for each level. The segment of the previous level is tried
+			 * first, so slowly varying levels, like water levels, seldom need a search, and the pow is computed
+			 * in blocks over the gathered segment parameters, a loop without branches that the compiler can vectorize.
+			 */
+			void flow(const double* levels, std::size_t n, double* r) const {
+				if ( segments.size() == 0 )
+					throw std::runtime_error("no rating-curve segments");
+				const std::size_t ns = segments.size();
+				const std::size_t none = ns;
+				constexpr std::size_t blk = 256;
+				double a[blk], b[blk], c[blk];
+				std::size_t s = none;
+				for ( std::size_t k0 = 0; k0 < n; k0 += blk ) {
+					const std::size_t m = std::min(blk, n - k0);
+					for ( std::size_t j = 0; j < m; ++j ) {
+						const double h = levels[k0 + j];
+						const bool same_segment = s != none && (s + 1 == ns || h < segments[s + 1].lower)
+							&& (segments[s].lower < h || (segments[s].lower == h && (s == 0 || segments[s - 1].lower < h)));// equal lower: the first one
+						if ( !same_segment )
+							s = segment_of(h);
+						if ( s == none ) {
+							a[j] = nan; b[j] = 0.0; c[j] = 1.0;
+						} else {
+							a[j] = segments[s].a; b[j] = segments[s].b; c[j] = segments[s].c;
+						}
+					}
+					for ( std::size_t j = 0; j < m; ++j )
+						r[k0 + j] = a[j] * std::pow(levels[k0 + j] - b[j], c[j]);
+				}
+			}
 
 			x_serialize_decl();
+		  private:
+			/** \return the index of the segment used for level, as flow(level), or size() if none */
+			std::size_t segment_of(double level) const {
+				auto it = std::lower_bound(segments.cbegin(), segments.cend(), level);
+				if ( it != segments.cend() && level == it->lower )
+					return std::size_t(it - segments.cbegin());
+				else if ( it != segments.cbegin() )
+					return std::size_t(it - segments.cbegin()) - 1;
+				return segments.size();
+			}
 		};
 
 		class rating_curve_parameters {
@@ -1522,6 +2302,36 @@ namespace shyft{
 
 				return flow;
 			}
+			/** Apply the rating-curve pack on n levels at the time-points ta.time(i0)..ta.time(i0+n-1).
+			 *
+			 * r holds the levels on entry, and the flows on return.
+			 * The active curve is found once, and then followed along the time-axis, so there is no
+			 * curve search per time-step, and each stretch of time-steps with the same curve is computed in bulk.
+			 */
+			template <typename TA>
+			void flow(const TA & ta, std::size_t i0, std::size_t n, double * r) const {
+				if ( n == 0u )
+					return;
+				if ( curves.empty() ) {
+					std::fill(r, r + n, nan);
+					return;
+				}
+				auto it = curves.upper_bound(ta.time(i0));// first curve starting after the current time-step
+				for ( std::size_t k = 0u; k < n; ) {
+					const utctime t = ta.time(i0 + k);
+					while ( it != curves.cend() && it->first <= t )
+						++it;
+					const utctime t_next = it == curves.cend() ? max_utctime : it->first;
+					std::size_t k_end = k + 1u;
+					while ( k_end < n && ta.time(i0 + k_end) < t_next )
+						++k_end;
+					if ( it == curves.cbegin() )
+						std::fill(r + k, r + k_end, nan);// before the first curve
+					else
+						std::prev(it)->second.flow(r + k, k_end - k, r + k);
+					k = k_end;
+				}
+			}
 
 			x_serialize_decl();
 		};
@@ -1623,6 +2433,12 @@ namespace shyft{
 				ensure_bound();
 				return rc_param.flow(time(i), level_ts.value(i));
 			}
+			/** \brief values [i0..i0+n> into r, the levels in bulk, then the flow in bulk, ref. rating_curve_parameters::flow */
+			void values(std::size_t i0, std::size_t n, double* r) const {
+				ensure_bound();
+				values_of(level_ts, i0, n, r);
+				rc_param.flow(time_axis(), i0, n, r);
+			}
 
 			x_serialize_decl();
 		};
@@ -1630,8 +2446,12 @@ namespace shyft{
 		/** The template is_ts<T> is used to enable operator overloading +-/  etc to time-series only.
 		* otherwise the operators will interfere with other libraries doing the same.
 		*/
-		template<class T> struct is_ts<point_ts<T>> {static const bool value=true;};
-		template<class T> struct is_ts<shared_ptr<point_ts<T>>> {static const bool value=true;};
+		template<class T, class V> struct is_ts<point_ts<T, V>> {static const bool value=true;};
+		template<class T, class V> struct is_ts<shared_ptr<point_ts<T, V>>> {static const bool value=true;};
+		template<class T, class V> struct is_ts<point_ts_view<T, V>> {static const bool value=true;};
+		template<class T, class V> struct is_ts<shared_ptr<point_ts_view<T, V>>> {static const bool value=true;};
+		template<class T> struct is_ts<rle_point_ts<T>> {static const bool value=true;};
+		template<class T> struct is_ts<shared_ptr<rle_point_ts<T>>> {static const bool value=true;};
 		template<class T> struct is_ts<time_shift_ts<T>> {static const bool value=true;};
 		template<class T> struct is_ts<shared_ptr<time_shift_ts<T>>> {static const bool value=true;};
 		template<class T> struct is_ts<uniform_sum_ts<T>> { static const bool value = true; };
@@ -1728,6 +2548,80 @@ namespace shyft{
             return bin_op<A,B,op_min,typename op_axis<A,B>::type> (lhs,op_min(),rhs);
         }
 
+        /** \brief fused evaluation of bin_op expressions of point_ts<fixed_dt> leaves
+         *
+         * fused_axis(e,ta) is true if all series leaves of the expression e are point_ts on one identical fixed_dt,
+         * (ta is set to the first leaf time-axis), and then fused_value(e,i) computes the i'th value of e
+         * directly from the raw leaf values, without the per-node time-axis of the bin_op's.
+         */
+        namespace fused {
+            inline bool same_axis(const time_axis::fixed_dt& a, const time_axis::fixed_dt*& ta) {
+                if (!ta) ta = &a;
+                return a == *ta;
+            }
+
+            template <class A, class B, class O, class TA> bool fused_axis(const bin_op<A, B, O, TA>& e, const time_axis::fixed_dt*& ta);
+            template <class B, class O, class TA> bool fused_axis(const bin_op<double, B, O, TA>& e, const time_axis::fixed_dt*& ta);
+            template <class A, class O, class TA> bool fused_axis(const bin_op<A, double, O, TA>& e, const time_axis::fixed_dt*& ta);
+            template <class A, class B, class O, class TA> double fused_value(const bin_op<A, B, O, TA>& e, size_t i);
+            template <class B, class O, class TA> double fused_value(const bin_op<double, B, O, TA>& e, size_t i);
+            template <class A, class O, class TA> double fused_value(const bin_op<A, double, O, TA>& e, size_t i);
+
+            template <class T>
+            bool fused_axis(const T&, const time_axis::fixed_dt*&) { return false; }
+            template <class V>
+            bool fused_axis(const point_ts<time_axis::fixed_dt, V>& ts, const time_axis::fixed_dt*& ta) { return same_axis(ts.ta, ta); }
+            template <class T>
+            bool fused_axis(const shared_ptr<T>& ts, const time_axis::fixed_dt*& ta) { return ts && fused_axis(*ts, ta); }
+            template <class A, class B, class O, class TA>
+            bool fused_axis(const bin_op<A, B, O, TA>& e, const time_axis::fixed_dt*& ta) { return fused_axis(e.lhs, ta) && fused_axis(e.rhs, ta); }
+            template <class B, class O, class TA>
+            bool fused_axis(const bin_op<double, B, O, TA>& e, const time_axis::fixed_dt*& ta) { return fused_axis(e.rhs, ta); }
+            template <class A, class O, class TA>
+            bool fused_axis(const bin_op<A, double, O, TA>& e, const time_axis::fixed_dt*& ta) { return fused_axis(e.lhs, ta); }
+
+            template <class V>
+            inline double fused_value(const point_ts<time_axis::fixed_dt, V>& ts, size_t i) { return ts.v[i]; }
+            template <class T>
+            inline double fused_value(const shared_ptr<T>& ts, size_t i) { return fused_value(*ts, i); }
+            template <class A, class B, class O, class TA>
+            inline double fused_value(const bin_op<A, B, O, TA>& e, size_t i) { return e.op(fused_value(e.lhs, i), fused_value(e.rhs, i)); }
+            template <class B, class O, class TA>
+            inline double fused_value(const bin_op<double, B, O, TA>& e, size_t i) { return e.op(e.lhs, fused_value(e.rhs, i)); }
+            template <class A, class O, class TA>
+            inline double fused_value(const bin_op<A, double, O, TA>& e, size_t i) { return e.op(fused_value(e.lhs, i), e.rhs); }
+        }
+
+        /** \brief evaluate the expression e into the point_ts r, time-axis, values and point interpretation
+         *
+         * When all leaves of e are point_ts on one identical fixed_dt time-axis, the expression tree is
+         * computed in one fused loop over the leaf values, ref. fused::fused_value,
+         * otherwise the values of e are evaluated in bulk, ref. values_of.
+         * r may be one of the leaves of e, e.g. a shared_ptr leaf, since each value only depends on the leaf values at the same index.
+         * \tparam E a time-series expression, e.g. bin_op's of point_ts
+         * \tparam TA the time-axis of r, must be constructible from the time-axis of e
+         */
+        template <class TA, class V, class E>
+        void evaluate_into(point_ts<TA, V>& r, const E& e) {
+            const time_axis::fixed_dt* fta = nullptr;
+            if (fused::fused_axis(e, fta) && fta) {
+                const time_axis::fixed_dt ta = *fta;// r might be a leaf
+                const size_t n = ta.size();
+                r.fx_policy = d_ref(e).point_interpretation();
+                r.ta = TA(ta);
+                r.v.resize(n);
+                V* rv = r.v.data();
+                for (size_t i = 0; i < n; ++i)
+                    rv[i] = V(fused::fused_value(e, i));
+            } else {
+                const auto& ex = d_ref(e);
+                vector<double> v(ex.size());
+                values_of(ex, 0, v.size(), v.data());
+                point_ts<TA, V> x(TA(ex.time_axis()), move(v), ex.point_interpretation());
+                r = move(x);
+            }
+        }
+
         /** \brief A constant_source, just return the same constant value for all points
          * \tparam TA time-axis
          */
@@ -1867,6 +2761,8 @@ namespace shyft{
          * Given sequential access, this accessor tries to be smart using previous
          * accumulated value plus the new delta to be efficient computing the
          * accumulated series from another kind of point source.
+         * A backward access builds a prefix_integral of the source, so that
+         * random access is not a walk from the start of the time-axis for each value.
          */
         template <class S, class TA>
         class accumulate_accessor {
@@ -1880,6 +2776,7 @@ namespace shyft{
             const S& source;
             std::shared_ptr<S> source_ref;// to keep ref.counting if ct with a shared-ptr. source will have a const ref to *ref
             extension_policy ext_policy = extension_policy::USE_NAN;
+            mutable std::shared_ptr<prefix_integral> prefix;// built at first backward access
           public:
             accumulate_accessor(const S& source, const TA& time_axis, extension_policy policy=extension_policy::USE_NAN)
                 : last_idx(0), q_idx(npos), q_value(0.0), time_axis(time_axis), source(source), ext_policy(policy) { /* Do nothing */
@@ -1902,6 +2799,10 @@ namespace shyft{
                         t_end=source.total_period().end; // clip to end (effect of use zero at extension
                     if (i > q_idx && q_idx != npos) { // utilize the fact that we already have computed the sum up to q_idx
                         q_value += accumulate_value(source, utcperiod(time_axis.time(q_idx), t_end), last_idx, tsum, source.point_interpretation() == POINT_INSTANT_VALUE);
+                    } else if (q_idx != npos) { // random access, use the prefix-integral of the source
+                        if (!prefix)
+                            prefix = std::make_shared<prefix_integral>(prefix_integral::of(source, source.point_interpretation() == POINT_INSTANT_VALUE));
+                        q_value = prefix->accumulate(utcperiod(time_axis.time(0), t_end), tsum);
                     } else { // just have to do the heavy work, calculate the entire sum again.
                         q_value = accumulate_value(source, utcperiod(time_axis.time(0), t_end), last_idx, tsum, source.point_interpretation() == POINT_INSTANT_VALUE);
                     }
@@ -1955,12 +2856,12 @@ namespace shyft{
          * \sa direct_accessor
          * \tparam TA the time-axis
          */
-        template <class TA>
-        class direct_accessor<point_ts<TA>, TA> {
+        template <class TA, class V>
+        class direct_accessor<point_ts<TA, V>, TA> {
           private:
-            const point_ts<TA>& source; //< \note this is a reference to the supplied point_source, so please be aware of life-time
+            const point_ts<TA, V>& source; //< \note this is a reference to the supplied point_source, so please be aware of life-time
           public:
-            direct_accessor(const point_ts<TA>& source, const TA& ta) : source(source) { }
+            direct_accessor(const point_ts<TA, V>& source, const TA& ta) : source(source) { }
 
             /** \brief Return value at pos without check since the source has its own timeaxis
              */
@@ -1970,6 +2871,28 @@ namespace shyft{
             size_t size() const { return source.size(); }
         };
 
+        /** \brief Specialization of the direct_accessor for shared_point_ts, that has its own timeaxis */
+        template <class TA, class V>
+        class direct_accessor<shared_point_ts<TA, V>, TA> {
+          private:
+            const shared_point_ts<TA, V>& source;
+          public:
+            direct_accessor(const shared_point_ts<TA, V>& source, const TA& ta) : source(source) { }
+            double value(const size_t i) const { return source.value(i); }
+            size_t size() const { return source.size(); }
+        };
+
+
+        /** \brief Specialization of the direct_accessor for point_ts_view, that has its own timeaxis */
+        template <class TA, class V>
+        class direct_accessor<point_ts_view<TA, V>, TA> {
+          private:
+            const point_ts_view<TA, V>& source;
+          public:
+            direct_accessor(const point_ts_view<TA, V>& source, const TA& ta) : source(source) { }
+            double value(const size_t i) const { return source.value(i); }
+            size_t size() const { return source.size(); }
+        };
 
         /** \brief Specialization of direct_accessor for a constant_source
          *
@@ -2065,6 +2988,10 @@ namespace shyft{
             return source.ta.open_range_index_of(p.start);
         }
         template<>
+        inline size_t hint_based_search<point_ts<time_axis::fixed_dt, float>>(const point_ts<time_axis::fixed_dt, float>& source, const utcperiod& p, size_t i) {
+            return source.ta.open_range_index_of(p.start);
+        }
+        template<>
         inline size_t hint_based_search<point_ts<time_axis::calendar_dt>>(const point_ts<time_axis::calendar_dt>& source, const utcperiod& p, size_t i) {
             return source.ta.open_range_index_of(p.start);
         }
@@ -2076,6 +3003,29 @@ namespace shyft{
         inline size_t hint_based_search<point_ts<time_axis::generic_dt>>(const point_ts<time_axis::generic_dt>& source, const utcperiod& p, size_t i) {
             return source.ta.open_range_index_of(p.start,i);
         }
+        template<>
+        inline size_t hint_based_search<rle_point_ts<time_axis::fixed_dt>>(const rle_point_ts<time_axis::fixed_dt>& source, const utcperiod& p, size_t i) {
+            return source.ta.open_range_index_of(p.start);
+        }
+        template<>
+        inline size_t hint_based_search<rle_point_ts<time_axis::generic_dt>>(const rle_point_ts<time_axis::generic_dt>& source, const utcperiod& p, size_t i) {
+            return source.ta.open_range_index_of(p.start,i);
+        }
+
+        /**specialization of the accumulate fast path for point_ts with fixed_dt storage, ref. fixed_dt_accumulate_values
+         */
+        template<>
+        inline bool fixed_dt_accumulate<point_ts<time_axis::fixed_dt>>(const point_ts<time_axis::fixed_dt>& source, const utcperiod& p, bool linear, size_t& last_idx, utctimespan& tsum, double& area) {
+            return fixed_dt_accumulate_values(source.ta, source.v.data(), p, linear, last_idx, tsum, area);
+        }
+        template<>
+        inline bool fixed_dt_accumulate<point_ts<time_axis::fixed_dt, float>>(const point_ts<time_axis::fixed_dt, float>& source, const utcperiod& p, bool linear, size_t& last_idx, utctimespan& tsum, double& area) {
+            return fixed_dt_accumulate_values(source.ta, source.v.data(), p, linear, last_idx, tsum, area);
+        }
+        template<>
+        inline bool fixed_dt_accumulate<point_ts<time_axis::generic_dt>>(const point_ts<time_axis::generic_dt>& source, const utcperiod& p, bool linear, size_t& last_idx, utctimespan& tsum, double& area) {
+            return source.ta.gt == time_axis::generic_dt::FIXED && fixed_dt_accumulate_values(source.ta.f, source.v.data(), p, linear, last_idx, tsum, area);
+        }
         /** \brief Discrete l2 norm of input time series treated as a vector: (sqrt(sum(x_i)))
          *
          * \note only used for debug/printout during calibration
@@ -2108,8 +3058,10 @@ namespace shyft{
         double nash_sutcliffe_goal_function(const TSA1& observed_ts, const TSA2& model_ts) {
             if (observed_ts.size() != model_ts.size() || observed_ts.size() == 0)
                 throw runtime_error("nash_sutcliffe needs equal sized ts accessors with elements >1");
+            // one pass, each accessor value read once, with the observed variance by Welford's running update
             double sum_of_obs_measured_diff2 = 0;
             double obs_avg = 0;
+            double sum_of_obs_obs_mean_diff2 = 0;
             size_t obs_count = 0;
             for (size_t i = 0; i < observed_ts.size(); ++i) {
                 double o = observed_ts.value(i);
@@ -2117,18 +3069,10 @@ namespace shyft{
                 if (isfinite(o) && isfinite(m)) {
                     double diff_i = o - m;
                     sum_of_obs_measured_diff2 += diff_i*diff_i;
-                    obs_avg += observed_ts.value(i);
                     ++obs_count;
-                }
-            }
-            obs_avg /= double(obs_count);
-            double sum_of_obs_obs_mean_diff2 = 0;
-            for (size_t i = 0; i < observed_ts.size(); ++i) {
-                double o = observed_ts.value(i);
-                double m = model_ts.value(i);
-                if (isfinite(o) && isfinite(m)) {
-                    double diff_i = o - obs_avg;
-                    sum_of_obs_obs_mean_diff2 += diff_i*diff_i;
+                    double d = o - obs_avg;
+                    obs_avg += d/double(obs_count);
+                    sum_of_obs_obs_mean_diff2 += d*(o - obs_avg);
                 }
             }
             return sum_of_obs_measured_diff2 / sum_of_obs_obs_mean_diff2;
@@ -2344,8 +3288,12 @@ namespace shyft{
          *  average_ts .. and family : less obvious, but they refer a ts like bin-op
          */
 
+        template<class Ta, class V>
+        struct needs_bind<point_ts<Ta, V>> {static bool const value=false;};
+        template<class Ta, class V>
+        struct needs_bind<point_ts_view<Ta, V>> {static bool const value=false;};
         template<class Ta>
-        struct needs_bind<point_ts<Ta>> {static bool const value=false;};
+        struct needs_bind<rle_point_ts<Ta>> {static bool const value=false;};
 
         // the ref_ts conditionally needs a bind, depending on if it has a ts or not
         template<class Ts>
@@ -2366,6 +3314,8 @@ x_serialize_export_key(shyft::time_series::point_ts<shyft::time_axis::fixed_dt>)
 x_serialize_export_key(shyft::time_series::point_ts<shyft::time_axis::calendar_dt>);
 x_serialize_export_key(shyft::time_series::point_ts<shyft::time_axis::point_dt>);
 x_serialize_export_key(shyft::time_series::point_ts<shyft::time_axis::generic_dt>);
+x_serialize_export_key(shyft::time_series::rle_point_ts<shyft::time_axis::fixed_dt>);
+x_serialize_export_key(shyft::time_series::rle_point_ts<shyft::time_axis::generic_dt>);
 x_serialize_export_key(shyft::time_series::convolve_w_ts<shyft::time_series::point_ts<shyft::time_axis::fixed_dt>>);
 x_serialize_export_key(shyft::time_series::convolve_w_ts<shyft::time_series::point_ts<shyft::time_axis::generic_dt>>);
 
@@ -1,5 +1,7 @@
 #include <dlib/statistics.h>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include "time_series_dd.h"
 #include "time_series_merge.h"
 #include "time_series_qm.h"
@@ -116,40 +118,39 @@ namespace shyft{
 			return do_op(lhs(t), op, rhs(t));// this might cost a 2xbin-search if not the underlying ts have smart incremental search (at the cost of thread safety)
 		}
 
-		static vector<double> ts_op_ts_values(const vector<double>& l, iop_t op, const vector<double>& r) {
-			vector<double> x; x.reserve(l.size());
+		static void ts_op_ts_values(const double* l, iop_t op, const double* r, double* x, size_t n) {
 			switch (op) {
-			case OP_ADD:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(l[i] + r[i]); return x;
-			case OP_SUB:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(l[i] - r[i]); return x;
-			case OP_MUL:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(l[i] * r[i]); return x;
-			case OP_DIV:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(l[i] / r[i]); return x;
-			case OP_MAX:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(std::max(l[i], r[i])); return x;
-			case OP_MIN:for (size_t i = 0; i < r.size(); ++i) x.emplace_back(std::min(l[i], r[i])); return x;
+			case OP_ADD:for (size_t i = 0; i < n; ++i) x[i] = l[i] + r[i]; return;
+			case OP_SUB:for (size_t i = 0; i < n; ++i) x[i] = l[i] - r[i]; return;
+			case OP_MUL:for (size_t i = 0; i < n; ++i) x[i] = l[i] * r[i]; return;
+			case OP_DIV:for (size_t i = 0; i < n; ++i) x[i] = l[i] / r[i]; return;
+			case OP_MAX:for (size_t i = 0; i < n; ++i) x[i] = std::max(l[i], r[i]); return;
+			case OP_MIN:for (size_t i = 0; i < n; ++i) x[i] = std::min(l[i], r[i]); return;
 			default: break;
 			}
 			throw runtime_error("Unsupported operation " + to_string(int(op)));
 		}
 
-		static void lhs_in_place_ts_op_ts_values(vector<double>& l, iop_t op, const vector<double>& r) {
+		static void lhs_in_place_ts_op_ts_values(double* l, iop_t op, const double* r, size_t n) {
 			switch (op) {
-			case OP_ADD:for (size_t i = 0; i < r.size(); ++i) l[i] += r[i]; return;
-			case OP_SUB:for (size_t i = 0; i < r.size(); ++i) l[i] -= r[i]; return;
-			case OP_MUL:for (size_t i = 0; i < r.size(); ++i) l[i] *= r[i]; return;
-			case OP_DIV:for (size_t i = 0; i < r.size(); ++i) l[i] /= r[i]; return;
-			case OP_MAX:for (size_t i = 0; i < r.size(); ++i) l[i] = std::max(l[i], r[i]); return;
-			case OP_MIN:for (size_t i = 0; i < r.size(); ++i) l[i] = std::min(l[i], r[i]); return;
+			case OP_ADD:for (size_t i = 0; i < n; ++i) l[i] += r[i]; return;
+			case OP_SUB:for (size_t i = 0; i < n; ++i) l[i] -= r[i]; return;
+			case OP_MUL:for (size_t i = 0; i < n; ++i) l[i] *= r[i]; return;
+			case OP_DIV:for (size_t i = 0; i < n; ++i) l[i] /= r[i]; return;
+			case OP_MAX:for (size_t i = 0; i < n; ++i) l[i] = std::max(l[i], r[i]); return;
+			case OP_MIN:for (size_t i = 0; i < n; ++i) l[i] = std::min(l[i], r[i]); return;
 			default: break;
 			}
 			throw runtime_error("Unsupported operation " + to_string(int(op)));
 		}
-		static void rhs_in_place_ts_op_ts_values(const vector<double>& l, iop_t op, vector<double>& r) {
+		static void rhs_in_place_ts_op_ts_values(const double* l, iop_t op, double* r, size_t n) {
 			switch (op) {
-			case OP_ADD:for (size_t i = 0; i < r.size(); ++i) r[i] += l[i]; return;
-			case OP_SUB:for (size_t i = 0; i < r.size(); ++i) r[i] = l[i] - r[i]; return;
-			case OP_MUL:for (size_t i = 0; i < r.size(); ++i) r[i] *= l[i]; return;
-			case OP_DIV:for (size_t i = 0; i < r.size(); ++i) r[i] = l[i] / r[i]; return;
-			case OP_MAX:for (size_t i = 0; i < r.size(); ++i) r[i] = std::max(l[i], r[i]); return;
-			case OP_MIN:for (size_t i = 0; i < r.size(); ++i) r[i] = std::min(l[i], r[i]); return;
+			case OP_ADD:for (size_t i = 0; i < n; ++i) r[i] += l[i]; return;
+			case OP_SUB:for (size_t i = 0; i < n; ++i) r[i] = l[i] - r[i]; return;
+			case OP_MUL:for (size_t i = 0; i < n; ++i) r[i] *= l[i]; return;
+			case OP_DIV:for (size_t i = 0; i < n; ++i) r[i] = l[i] / r[i]; return;
+			case OP_MAX:for (size_t i = 0; i < n; ++i) r[i] = std::max(l[i], r[i]); return;
+			case OP_MIN:for (size_t i = 0; i < n; ++i) r[i] = std::min(l[i], r[i]); return;
 			default: break;
 			}
 			throw runtime_error("Unsupported operation " + to_string(int(op)));
@@ -179,33 +180,174 @@ namespace shyft{
 		* If time-axis not aligned, just compute value-by-value.
 		*
 		*/
-		std::vector<double> abin_op_ts::values() const {
-			if (lhs.time_axis() == rhs.time_axis()) {
+		std::vector<double> abin_op_ts::values() const { return ts_program::compile(*this).values(); }
+
+		void abin_op_ts::values_into(double* r, eval_buffers& b) const {
+			const size_t n = time_axis().size();
+			if (aligned) {
 				const vector<double>* lhs_v{ terminal_values(lhs) };
 				const vector<double>* rhs_v{ terminal_values(rhs) };
 				if (lhs_v && rhs_v) {
-					return ts_op_ts_values(*lhs_v, op, *rhs_v);
+					ts_op_ts_values(lhs_v->data(), op, rhs_v->data(), r, n);
 				} else if (lhs_v) {
-					auto r{ rhs.values() };
-					rhs_in_place_ts_op_ts_values(*lhs_v, op, r);
-					return r;
+					rhs.ts->values_into(r, b);
+					rhs_in_place_ts_op_ts_values(lhs_v->data(), op, r, n);
 				} else if (rhs_v) {
-					auto l{ lhs.values() };
-					lhs_in_place_ts_op_ts_values(l, op, *rhs_v);
-					return l;
+					lhs.ts->values_into(r, b);
+					lhs_in_place_ts_op_ts_values(r, op, rhs_v->data(), n);
 				} else {
-					auto l{ lhs.values() };
-					auto r{ rhs.values() };
-					lhs_in_place_ts_op_ts_values(l, op, r);
-					return l;
+					lhs.ts->values_into(r, b);
+					auto t = b.get(n);// the only temporary, reused by the next node that needs one
+					rhs.ts->values_into(t.data(), b);
+					lhs_in_place_ts_op_ts_values(r, op, t.data(), n);
+					b.put(std::move(t));
 				}
 			} else {
-				std::vector<double> r; r.reserve(time_axis().size());
-				for (size_t i = 0; i < time_axis().size(); ++i) {
-					r.push_back(value(i));//TODO: improve speed using accessors with ix-hint for lhs/rhs stepwise traversal
+				for (size_t i = 0; i < n; ++i)
+					r[i] = value(i);//TODO: improve speed using accessors with ix-hint for lhs/rhs stepwise traversal
+			}
+		}
+
+		constexpr size_t sum_ts::group_size;
+		constexpr size_t sum_ts::max_groups;
+
+		sum_ts::sum_ts(const std::vector<apoint_ts>& tsv, bool compensated) :tsv(tsv), compensated(compensated) {
+			if (tsv.empty())
+				throw runtime_error("sum_ts: at least one time-series is required");
+			if (!needs_bind())
+				local_do_bind();
+		}
+
+		void sum_ts::local_do_bind() {
+			if (!bound) {
+				fx_policy = tsv[0].point_interpretation();
+				ta = tsv[0].time_axis();
+				for (size_t j = 1; j < tsv.size(); ++j) {
+					fx_policy = result_policy(fx_policy, tsv[j].point_interpretation());
+					if (!(tsv[j].time_axis() == ta))
+						ta = time_axis::combine(ta, tsv[j].time_axis());
 				}
-				return r;
+				set_aligned();
+				bound = true;
+			}
+		}
+
+		void sum_ts::set_aligned() {
+			aligned.resize(tsv.size());
+			for (size_t j = 0; j < tsv.size(); ++j)
+				aligned[j] = tsv[j].time_axis() == ta;
+		}
+
+		bool sum_ts::needs_bind() const {
+			for (const auto& ts : tsv)
+				if (ts.needs_bind())
+					return true;
+			return false;
+		}
+
+		void sum_ts::do_bind() {
+			for (auto& ts : tsv)
+				ts.do_bind();
+			local_do_bind();
+		}
+
+		/** s += x, or if c, the Kahan compensated s += x with compensation c */
+		static void add_values(double* s, double* c, const double* x, size_t n) {
+			if (c) {
+				for (size_t i = 0; i < n; ++i) {
+					const double y = x[i] - c[i];
+					const double t = s[i] + y;
+					c[i] = (t - s[i]) - y;
+					s[i] = t;
+				}
+			} else {
+				for (size_t i = 0; i < n; ++i) s[i] += x[i];
+			}
+		}
+
+		/** the sum of fx(j) over the terms of s, added in the same order as by sum_ts::values_into */
+		template <class F>
+		static double grouped_sum(const sum_ts& s, F&& fx) {
+			const size_t m = s.tsv.size(), n_g = s.n_groups();
+			double r = 0.0, rc = 0.0;// group 0 sums directly into r
+			for (size_t g = 0; g < n_g; ++g) {
+				double p = 0.0, pc = 0.0;
+				double* ps = g > 0 ? &p : &r;
+				double* pcs = g > 0 ? &pc : &rc;
+				for (size_t j = g*m/n_g; j < (g + 1)*m/n_g; ++j) {
+					const double x = fx(j);
+					add_values(ps, s.compensated ? pcs : nullptr, &x, 1);
+				}
+				if (g > 0)
+					add_values(&r, s.compensated ? &rc : nullptr, &p, 1);
 			}
+			return r;
+		}
+
+		double sum_ts::value_at(utctime t) const {
+			if (!time_axis().total_period().contains(t))
+				return nan;
+			return grouped_sum(*this, [this, t](size_t j) { return tsv[j](t); });
+		}
+
+		double sum_ts::value(size_t i) const {
+			if (i == std::string::npos || i >= time_axis().size())
+				return nan;
+			const utctime t = ta.time(i);
+			return grouped_sum(*this, [this, i, t](size_t j) { return aligned[j] ? tsv[j].value(i) : tsv[j](t); });
+		}
+
+		std::vector<double> sum_ts::values() const {
+			std::vector<double> r(time_axis().size());
+			eval_buffers b;
+			values_into(r.data(), b);
+			return r;
+		}
+
+		void sum_ts::values_into(double* r, eval_buffers& b) const {
+			const size_t n = time_axis().size(), m = tsv.size(), n_g = n_groups();
+			std::vector<std::vector<double>> partial(n_g - 1);// group 0 sums directly into r
+			std::vector<std::vector<double>> comp(compensated ? n_g : 0);
+			auto sum_group = [&](size_t g, eval_buffers& gb) {
+				double* s = r;
+				if (g > 0) {
+					partial[g - 1].assign(n, 0.0);
+					s = partial[g - 1].data();
+				} else {
+					std::fill(r, r + n, 0.0);
+				}
+				double* c = nullptr;
+				if (compensated) {
+					comp[g].assign(n, 0.0);
+					c = comp[g].data();
+				}
+				auto x = gb.get(n);
+				for (size_t j = g*m/n_g; j < (g + 1)*m/n_g; ++j) {
+					const vector<double>* v = aligned[j] ? terminal_values(tsv[j]) : nullptr;
+					if (!v) {
+						if (aligned[j]) {
+							tsv[j].ts->values_into(x.data(), gb);
+						} else {
+							for (size_t i = 0; i < n; ++i)
+								x[i] = tsv[j](ta.time(i));
+						}
+						v = &x;
+					}
+					add_values(s, c, v->data(), n);
+				}
+				gb.put(std::move(x));
+			};
+			if (n_g == 1) {
+				sum_group(0, b);
+				return;
+			}
+			shyft::core::executor::instance()->parallel_for(n_g, 1, [&sum_group](size_t g0, size_t g1) {
+				eval_buffers gb;// one for each thread
+				for (size_t g = g0; g < g1; ++g)
+					sum_group(g, gb);
+			});
+			for (size_t g = 1; g < n_g; ++g)// in group order, independent of the threads
+				add_values(r, compensated ? comp[0].data() : nullptr, partial[g - 1].data(), n);
 		}
 
 
@@ -215,28 +357,61 @@ namespace shyft{
 		* at highest possible speed
 		*/
 		template < class FX, class TA, class TS, class ATA >
-		static std::vector<double> make_interval(FX&&fx, const TA &ta, const TS& ts, const ATA& avg_ta) {
+		static void make_interval(FX&&fx, const TA &ta, const TS& ts, const ATA& avg_ta, double* r, eval_buffers& b) {
 			auto pfx = ts->point_interpretation();
 			const bool linear_interpretation = pfx == ts_point_fx::POINT_INSTANT_VALUE;
-			const vector<double>* src_v{ terminal_values(ts) };//fetch terminal value
-			if (src_v) {// if values are already in place, use reference
-				const ts_src<TA> rts{ ta,*src_v };
-				std::vector<double> r; r.reserve(avg_ta.size());
+			auto fill = [&](const vector<double>& v) {
+				const ts_src<TA> rts{ ta,v };
 				size_t ix_hint = ta.index_of(avg_ta.time(0));
 				for (size_t i = 0; i < avg_ta.size(); ++i)
-					r.emplace_back(fx(rts, avg_ta.period(i), ix_hint, linear_interpretation));
-				return r;
+					r[i] = fx(rts, avg_ta.period(i), ix_hint, linear_interpretation);
+			};
+			const vector<double>* src_v{ terminal_values(ts) };//fetch terminal value
+			if (src_v) {// if values are already in place, use reference
+				fill(*src_v);
 			} else {
-				auto tsv{ ts->values() };// pull out values from underlying expression.
-				const ts_src<TA> rts{ ta,tsv };// note that ->values() deflates any underlying expression, this could be sub optimal in some cases.
-				std::vector<double> r; r.reserve(avg_ta.size());
-				size_t ix_hint = ta.index_of(avg_ta.time(0));
-				for (size_t i = 0; i < avg_ta.size(); ++i)
-					r.emplace_back(fx(rts, avg_ta.period(i), ix_hint, linear_interpretation));
-				return r;
+				auto tsv = b.get(ts->size());// pull out values from underlying expression into a pooled buffer
+				ts->values_into(tsv.data(), b);
+				fill(tsv);
+				b.put(std::move(tsv));
 			}
 		}
 
+		static std::atomic<std::uint64_t> terminal_changes{0};
+
+		std::uint64_t terminal_change_count() { return terminal_changes.load(std::memory_order_acquire); }
+		void mark_terminal_changed() { terminal_changes.fetch_add(1, std::memory_order_acq_rel); }
+
+		std::shared_ptr<const prefix_integral_cache::table> prefix_integral_cache::of(const ipoint_ts& ts) const {
+			const auto stamp = terminal_change_count();// read before the values, so a change while building gives a rebuild
+			auto r = std::atomic_load(&t);
+			if (!r || r->stamp != stamp) {
+				const size_t n = ts.size();
+				std::vector<utctime> tp; tp.reserve(n);
+				for (size_t i = 0; i < n; ++i)
+					tp.push_back(ts.time(i));
+				r = std::make_shared<const table>(table{ stamp, ts.total_period().end,
+					prefix_integral(std::move(tp), ts.values(), ts.point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE) });
+				std::atomic_store(&t, r);
+			}
+			return r;
+		}
+
+		double prefix_integral_cache::accumulate(const ipoint_ts& ts, const utcperiod& p, utctimespan& tsum) const {
+			auto r = of(ts);
+			if (r->p.size() == 0 || p.start >= r->end) {// as accumulate_value, that finds no point to start from
+				tsum = 0;
+				return nan;
+			}
+			return r->p.accumulate(p, tsum);
+		}
+
+		double prefix_integral_cache::average(const ipoint_ts& ts, const utcperiod& p) const {
+			utctimespan tsum = 0;
+			const double a = accumulate(ts, p, tsum);
+			return tsum > 0 ? a/tsum : nan;
+		}
+
 		/** Implementation of the average_ts::values
 		*
 		*  Important here is to ensure that accessing the time-axis is
@@ -244,15 +419,39 @@ namespace shyft{
 		*  (avoid switch every single lookup during integration)
 		*/
 		std::vector<double> average_ts::values() const {
+			return cache.active() ? cache.values([this]() {return evaluate();}) : evaluate();
+		}
+
+		std::vector<double> average_ts::evaluate() const {
 			if (ts->time_axis() == ta && ts->point_interpretation() == ts_point_fx::POINT_AVERAGE_VALUE) {
 				return ts->values(); // elide trivial average_ts cases
 			}
+			std::vector<double> r(ta.size());
+			eval_buffers b;
+			evaluate_into(r.data(), b);
+			return r;
+		}
+
+		void average_ts::values_into(double* r, eval_buffers& b) const {
+			if (cache.active()) {
+				const auto& v = cache.values([this]() {return evaluate();});
+				std::copy(v.begin(), v.end(), r);
+			} else {
+				evaluate_into(r, b);
+			}
+		}
+
+		void average_ts::evaluate_into(double* r, eval_buffers& b) const {
+			if (ts->time_axis() == ta && ts->point_interpretation() == ts_point_fx::POINT_AVERAGE_VALUE) {
+				ts->values_into(r, b); // elide trivial average_ts cases
+				return;
+			}
 			switch (ts->time_axis().gt) { // pull out the real&fast time-axis before doing computations here:
-			case time_axis::generic_dt::FIXED:    return make_interval(average_value<ts_src<time_axis::fixed_dt>>, ts->time_axis().f, ts, ta);
-			case time_axis::generic_dt::CALENDAR: return make_interval(average_value<ts_src<time_axis::calendar_dt>>, ts->time_axis().c, ts, ta);
-			case time_axis::generic_dt::POINT:    return make_interval(average_value<ts_src<time_axis::point_dt>>, ts->time_axis().p, ts, ta);
+			case time_axis::generic_dt::FIXED:    return make_interval(average_value<ts_src<time_axis::fixed_dt>>, ts->time_axis().f, ts, ta, r, b);
+			case time_axis::generic_dt::CALENDAR: return make_interval(average_value<ts_src<time_axis::calendar_dt>>, ts->time_axis().c, ts, ta, r, b);
+			case time_axis::generic_dt::POINT:    return make_interval(average_value<ts_src<time_axis::point_dt>>, ts->time_axis().p, ts, ta, r, b);
 			}
-			return make_interval(average_value<ts_src<time_axis::generic_dt>>, ts->time_axis(), ts, ta);
+			make_interval(average_value<ts_src<time_axis::generic_dt>>, ts->time_axis(), ts, ta, r, b);
 		}
 
 		template<class S>
@@ -262,12 +461,32 @@ namespace shyft{
 		}
 
 		std::vector<double> integral_ts::values() const {
+			return cache.active() ? cache.values([this]() {return evaluate();}) : evaluate();
+		}
+
+		std::vector<double> integral_ts::evaluate() const {
+			std::vector<double> r(ta.size());
+			eval_buffers b;
+			evaluate_into(r.data(), b);
+			return r;
+		}
+
+		void integral_ts::values_into(double* r, eval_buffers& b) const {
+			if (cache.active()) {
+				const auto& v = cache.values([this]() {return evaluate();});
+				std::copy(v.begin(), v.end(), r);
+			} else {
+				evaluate_into(r, b);
+			}
+		}
+
+		void integral_ts::evaluate_into(double* r, eval_buffers& b) const {
 			switch (ts->time_axis().gt) { // pull out the real&fast time-axis before doing computations here:
-			case time_axis::generic_dt::FIXED:    return make_interval(integral_value<ts_src<time_axis::fixed_dt>>, ts->time_axis().f, ts, ta);
-			case time_axis::generic_dt::CALENDAR: return make_interval(integral_value<ts_src<time_axis::calendar_dt>>, ts->time_axis().c, ts, ta);
-			case time_axis::generic_dt::POINT:    return make_interval(integral_value<ts_src<time_axis::point_dt>>, ts->time_axis().p, ts, ta);
+			case time_axis::generic_dt::FIXED:    return make_interval(integral_value<ts_src<time_axis::fixed_dt>>, ts->time_axis().f, ts, ta, r, b);
+			case time_axis::generic_dt::CALENDAR: return make_interval(integral_value<ts_src<time_axis::calendar_dt>>, ts->time_axis().c, ts, ta, r, b);
+			case time_axis::generic_dt::POINT:    return make_interval(integral_value<ts_src<time_axis::point_dt>>, ts->time_axis().p, ts, ta, r, b);
 			}
-			return make_interval(integral_value<ts_src<time_axis::generic_dt>>, ts->time_axis(), ts, ta);
+			make_interval(integral_value<ts_src<time_axis::generic_dt>>, ts->time_axis(), ts, ta, r, b);
 		}
 
 		// implement popular ct for apoint_ts to make it easy to expose & use
@@ -299,6 +518,7 @@ namespace shyft{
 			} else {
 				throw runtime_error("the supplied argument time-series must be a point ts or something that directly resolves to one");
 			}
+			mark_terminal_changed();
 
 		}
 		string apoint_ts::id() const {
@@ -394,6 +614,9 @@ namespace shyft{
 				find_ts_bind_info(bin_op->lhs.ts, r);
 			} else if (dynamic_cast<const abs_ts*>(its.get())) {
 				find_ts_bind_info(dynamic_cast<const abs_ts*>(its.get())->ts, r);
+			} else if (dynamic_cast<const sum_ts*>(its.get())) {
+				for (const auto& ts : dynamic_cast<const sum_ts*>(its.get())->tsv)
+					find_ts_bind_info(ts.ts, r);
 			} else if (dynamic_cast<const extend_ts*>(its.get())) {
 				auto ext = dynamic_cast<const extend_ts*>(its.get());
 				find_ts_bind_info(ext->lhs.ts, r);
@@ -511,61 +734,90 @@ namespace shyft{
                     throw runtime_error("self.merge_points_from:self ts must be a concrete point ts");
                 }
             }
+            mark_terminal_changed();
             return *this;
         }
 
-		template<class TSV>
-		static bool all_same_generic_time_axis_type(const TSV&tsv) {
-			if (tsv.size() == 0) return true;
-			auto gt = tsv[0].time_axis().gt;
-			for (const auto&ts : tsv) {
-				if (ts.time_axis().gt != gt)
-					return false;
-			}
-			return true;
+		/** \return the points of ts if it is a concrete, or bound reference to a, point ts, otherwise nullptr */
+		static const gts_t* concrete_points(const apoint_ts& ts) {
+			if (auto g = dynamic_cast<const gpoint_ts*>(ts.ts.get()))
+				return &g->core_ts();
+			if (auto r = dynamic_cast<const aref_ts*>(ts.ts.get()))
+				return r->rep ? &r->core_ts() : nullptr;
+			return nullptr;
 		}
 
-		std::vector<apoint_ts> percentiles(const std::vector<apoint_ts>& tsv1, const gta_t& ta, const vector<int>& percentile_list) {
+		/** The members are averaged to ta directly into a member x time-step matrix, in parallel over the members,
+		 *  a concrete member read in place, and an expression evaluated one at the time by each thread,
+		 *  so the members are not kept as evaluated time-series too. The extremes are of the points,
+		 *  as calculate_percentiles, so they are taken while each member is at hand.
+		 */
+		std::vector<apoint_ts> percentiles(const std::vector<apoint_ts>& tsv, const gta_t& ta, const vector<int>& percentile_list) {
 			std::vector<apoint_ts> r; r.reserve(percentile_list.size());
-			auto tsvx = deflate_ts_vector<gts_t>(tsv1);
-			// check of all tsvx.time_axis is of same type
-			//  make that vector type (move values), and run percentile calc for that
-			//  the objective is to avoid traffic over the 'switch' in generic_dt
-			//  and provide direct access to representative time-axis instead
-			if (all_same_generic_time_axis_type(tsvx)) {
-				if (tsvx.size()) {
-					auto gt = tsvx[0].time_axis().gt;
-					switch (gt) {
-					case time_axis::generic_dt::FIXED: {
-						std::vector<point_ts<time_axis::fixed_dt>> tsv; tsv.reserve(tsvx.size());
-						for (auto&ts : tsvx) tsv.emplace_back(move(ts.ta.f), move(ts.v), ts.fx_policy);
-						auto rp = shyft::time_series::calculate_percentiles(ta, tsv, percentile_list);
-						for (auto&ts : rp) r.emplace_back(ta, std::move(ts.v), POINT_AVERAGE_VALUE);
-					} break;
-					case time_axis::generic_dt::CALENDAR: {
-						std::vector<point_ts<time_axis::calendar_dt>> tsv; tsv.reserve(tsvx.size());
-						for (auto&ts : tsvx) tsv.emplace_back(move(ts.ta.c), move(ts.v), ts.fx_policy);
-						auto rp = shyft::time_series::calculate_percentiles(ta, tsv, percentile_list);
-						for (auto&ts : rp) r.emplace_back(ta, std::move(ts.v), POINT_AVERAGE_VALUE);
-					} break;
-					case time_axis::generic_dt::POINT: {
-						std::vector<point_ts<time_axis::point_dt>> tsv; tsv.reserve(tsvx.size());
-						for (auto&ts : tsvx) tsv.emplace_back(move(ts.ta.p), move(ts.v), ts.fx_policy);
-						auto rp = shyft::time_series::calculate_percentiles(ta, tsv, percentile_list);
-						for (auto&ts : rp) r.emplace_back(ta, std::move(ts.v), POINT_AVERAGE_VALUE);
-					} break;
+			if (tsv.empty()) {
+				for (size_t i = 0; i < percentile_list.size(); ++i)
+					r.emplace_back(ta, shyft::nan, POINT_AVERAGE_VALUE);
+				return r;
+			}
+			const size_t n = ta.size(), n_members = tsv.size();
+			const bool want_min = std::find(percentile_list.begin(), percentile_list.end(), int(statistics_property::MIN_EXTREME)) != percentile_list.end();
+			const bool want_max = std::find(percentile_list.begin(), percentile_list.end(), int(statistics_property::MAX_EXTREME)) != percentile_list.end();
+			std::vector<double> m(n_members*n);
+			std::vector<double> x_min(want_min ? n : 0, shyft::nan), x_max(want_max ? n : 0, shyft::nan);
+			std::mutex mx;// protects x_min and x_max
+			auto member_range = [&](size_t i0, size_t i1) {
+				gts_t e;// the evaluated expression member, replaced by the next one
+				std::vector<double> l_min(x_min.size(), shyft::nan), l_max(x_max.size(), shyft::nan);
+				for (size_t i = i0; i < i1; ++i) {
+					const gts_t* s = concrete_points(tsv[i]);
+					if (!s) {
+						if (!tsv[i].ts || tsv[i].needs_bind())
+							throw runtime_error("percentiles: the time-series must be bound, member " + std::to_string(i) + " is not");
+						e = gts_t(tsv[i].time_axis(), tsv[i].values(), tsv[i].point_interpretation());
+						s = &e;
+					}
+					average_accessor<gts_t, gta_t> tsa(*s, ta);
+					double* mi = m.data() + i*n;
+					for (size_t k = 0; k < n; ++k)
+						mi[k] = tsa.value(k);
+					if (want_min) {
+						auto x = extract_statistics(*s, ta, nan_min);
+						for (size_t k = 0; k < n; ++k) l_min[k] = nan_min(l_min[k], x[k]);
+					}
+					if (want_max) {
+						auto x = extract_statistics(*s, ta, nan_max);
+						for (size_t k = 0; k < n; ++k) l_max[k] = nan_max(l_max[k], x[k]);
 					}
-				} else {
-					for (size_t i = 0; i < percentile_list.size(); ++i)
-						r.emplace_back(ta, shyft::nan, POINT_AVERAGE_VALUE);
 				}
-			} else {
-				auto rp = shyft::time_series::calculate_percentiles(ta, tsvx, percentile_list);
-				for (auto&ts : rp) r.emplace_back(ta, std::move(ts.v), POINT_AVERAGE_VALUE);
+				if (want_min || want_max) {
+					std::lock_guard<std::mutex> guard(mx);
+					for (size_t k = 0; k < l_min.size(); ++k) x_min[k] = nan_min(x_min[k], l_min[k]);
+					for (size_t k = 0; k < l_max.size(); ++k) x_max[k] = nan_max(x_max[k], l_max[k]);
+				}
+			};
+			auto pool = shyft::core::executor::instance();
+			const size_t n_q = pool->queue_count(0);
+			// small chunks, as for deflate_ts_vector, the cost of each expression varies a lot
+			pool->parallel_for(n_members, std::max(size_t(1), n_members/(8*n_q)), member_range, 0);
+			auto rp = shyft::time_series::calculate_percentiles_of_matrix(ta, m, n_members, percentile_list);
+			for (size_t p = 0; p < rp.size(); ++p) {
+				if (percentile_list[p] == statistics_property::MIN_EXTREME)
+					rp[p].v = x_min;
+				else if (percentile_list[p] == statistics_property::MAX_EXTREME)
+					rp[p].v = x_max;
+				r.emplace_back(ta, std::move(rp[p].v), POINT_AVERAGE_VALUE);
 			}
 			return r;
 		}
 
+		std::vector<apoint_ts> aggregates(const std::vector<apoint_ts>& tsv1, const gta_t& ta, const vector<int>& aggregate_list, const vector<double>& weights, const vector<double>& bins) {
+			std::vector<apoint_ts> r;
+			auto rp = shyft::time_series::calculate_aggregates(ta, deflate_ts_vector<gts_t>(tsv1), aggregate_list, weights, bins);
+			r.reserve(rp.size());
+			for (auto&ts : rp) r.emplace_back(ta, std::move(ts.v), POINT_AVERAGE_VALUE);
+			return r;
+		}
+
 		std::vector<apoint_ts> percentiles(const std::vector<apoint_ts>& ts_list, const time_axis::fixed_dt& ta, const vector<int>& percentile_list) {
 			return percentiles(ts_list, time_axis::generic_dt(ta), percentile_list);
 		}
@@ -573,6 +825,8 @@ namespace shyft{
 		double abin_op_ts::value(size_t i) const {
 			if (i == std::string::npos || i >= time_axis().size())
 				return nan;
+			if (aligned)// same index into both, no time-axis searches
+				return do_op(lhs.value(i), op, rhs.value(i));
 			return value_at(time_axis().time(i));
 		}
 		double abin_op_scalar_ts::value_at(utctime t) const {
@@ -584,34 +838,30 @@ namespace shyft{
 			return do_op(lhs, op, rhs.value(i));
 		}
 
-		std::vector<double> abin_op_scalar_ts::values() const {
+		/** x[i] = l op r[i], x can be r */
+		static void scalar_op_ts_values(double l, iop_t op, const double* r, double* x, size_t n) {
+			switch (op) {
+			case OP_ADD:for (size_t i = 0; i < n; ++i) x[i] = r[i] + l; return;
+			case OP_SUB:for (size_t i = 0; i < n; ++i) x[i] = l - r[i]; return;
+			case OP_MUL:for (size_t i = 0; i < n; ++i) x[i] = l * r[i]; return;
+			case OP_DIV:for (size_t i = 0; i < n; ++i) x[i] = l / r[i]; return;
+			case OP_MAX:for (size_t i = 0; i < n; ++i) x[i] = std::max(r[i], l); return;
+			case OP_MIN:for (size_t i = 0; i < n; ++i) x[i] = std::min(r[i], l); return;
+			default: throw runtime_error("Unsupported operation " + to_string(int(op)));
+			}
+		}
+
+		std::vector<double> abin_op_scalar_ts::values() const { return ts_program::compile(*this).values(); }
+
+		void abin_op_scalar_ts::values_into(double* r, eval_buffers& b) const {
 			bind_check();
+			const size_t n = ta.size();
 			const vector<double> *rhs_v{ terminal_values(rhs) };
 			if (rhs_v) {
-				const auto& r_v = *rhs_v;
-				std::vector<double> r; r.reserve(r_v.size());
-				auto l = lhs;
-				switch (op) {
-				case OP_ADD:for (const auto&v : r_v) r.emplace_back(v + l); return r;
-				case OP_SUB:for (const auto&v : r_v) r.emplace_back(l - v); return r;
-				case OP_MUL:for (const auto&v : r_v) r.emplace_back(l*v); return r;
-				case OP_DIV:for (const auto&v : r_v) r.emplace_back(l / v); return r;
-				case OP_MAX:for (const auto&v : r_v) r.emplace_back(std::max(v, l)); return r;
-				case OP_MIN:for (const auto&v : r_v) r.emplace_back(std::min(v, l)); return r;
-				default: throw runtime_error("Unsupported operation " + to_string(int(op)));
-				}
+				scalar_op_ts_values(lhs, op, rhs_v->data(), r, n);
 			} else {
-				std::vector<double> r(rhs.values());
-				auto l = lhs;
-				switch (op) {
-				case OP_ADD:for (size_t i = 0; i < r.size(); ++i) r[i] += l; return r;
-				case OP_SUB:for (size_t i = 0; i < r.size(); ++i) r[i] = l - r[i]; return r;
-				case OP_MUL:for (size_t i = 0; i < r.size(); ++i) r[i] *= l; return r;
-				case OP_DIV:for (size_t i = 0; i < r.size(); ++i) r[i] = l / r[i]; return r;
-				case OP_MAX:for (size_t i = 0; i < r.size(); ++i) r[i] = std::max(r[i], l); return r;
-				case OP_MIN:for (size_t i = 0; i < r.size(); ++i) r[i] = std::min(r[i], l); return r;
-				default: throw runtime_error("Unsupported operation " + to_string(int(op)));
-				}
+				rhs.ts->values_into(r, b);
+				scalar_op_ts_values(lhs, op, r, r, n);
 			}
 		}
 
@@ -623,36 +873,387 @@ namespace shyft{
 			bind_check();
 			return do_op(lhs.value(i), op, rhs);
 		}
-		std::vector<double> abin_op_ts_scalar::values() const {
+		/** x[i] = l[i] op r, x can be l */
+		static void ts_op_scalar_values(const double* l, iop_t op, double r, double* x, size_t n) {
+			switch (op) {
+			case OP_ADD:for (size_t i = 0; i < n; ++i) x[i] = l[i] + r; return;
+			case OP_SUB:for (size_t i = 0; i < n; ++i) x[i] = l[i] - r; return;
+			case OP_MUL:for (size_t i = 0; i < n; ++i) x[i] = l[i] * r; return;
+			case OP_DIV:for (size_t i = 0; i < n; ++i) x[i] = l[i] / r; return;
+			case OP_MAX:for (size_t i = 0; i < n; ++i) x[i] = std::max(l[i], r); return;
+			case OP_MIN:for (size_t i = 0; i < n; ++i) x[i] = std::min(l[i], r); return;
+			default: throw runtime_error("Unsupported operation " + to_string(int(op)));
+			}
+		}
+
+		std::vector<double> abin_op_ts_scalar::values() const { return ts_program::compile(*this).values(); }
+
+		void abin_op_ts_scalar::values_into(double* r, eval_buffers& b) const {
 			bind_check();
+			const size_t n = ta.size();
 			const vector<double>* lhs_v{ terminal_values(lhs) };
-			if (lhs_v) { // avoid a copy, but does not help much..
-				std::vector<double> r; r.reserve(lhs_v->size());
-				auto rv = rhs;
-				switch (op) {
-				case OP_ADD:for (const auto&lv : *lhs_v) r.emplace_back(lv + rv); return r;
-				case OP_SUB:for (const auto&lv : *lhs_v) r.emplace_back(lv - rv); return r;
-				case OP_MUL:for (const auto&lv : *lhs_v) r.emplace_back(lv*rv); return r;
-				case OP_DIV:for (const auto&lv : *lhs_v) r.emplace_back(lv / rv); return r;
-				case OP_MAX:for (const auto&lv : *lhs_v) r.emplace_back(std::max(lv, rv)); return r;
-				case OP_MIN:for (const auto&lv : *lhs_v) r.emplace_back(std::min(lv, rv)); return r;
-				default: throw runtime_error("Unsupported operation " + to_string(int(op)));
+			if (lhs_v) {
+				ts_op_scalar_values(lhs_v->data(), op, rhs, r, n);
+			} else {
+				lhs.ts->values_into(r, b);
+				ts_op_scalar_values(r, op, rhs, r, n);
+			}
+		}
+
+		/** builds a ts_program by a depth first walk of the expression, ref. ts_program::compile */
+		struct ts_program_compiler {
+			ts_program& p;
+			std::map<const ipoint_ts*, int> regs;///< nodes already compiled, so shared nodes are computed once
+			int n_registers = 0;
+
+			int add_input(const ipoint_ts& ts, const vector<double>* v) {
+				p.inputs.push_back(ts_program::input{ n_registers, &ts, v });
+				return n_registers++;
+			}
+
+			int emit(ts_program::opcode code, iop_t op, int a, int b, double x) {
+				p.code.push_back(ts_program::instruction{ code, op, n_registers, a, b, x });
+				return n_registers++;
+			}
+
+			static const vector<double>* terminal(const ipoint_ts& ts) {
+				if (auto g = dynamic_cast<const gpoint_ts*>(&ts))
+					return &g->core_ts().v;
+				if (auto r = dynamic_cast<const aref_ts*>(&ts))
+					return r->rep ? &r->core_ts().v : nullptr;
+				return nullptr;
+			}
+
+			int reg(const ipoint_ts& ts) {
+				auto f = regs.find(&ts);
+				if (f != regs.end())
+					return f->second;
+				int r = -1;
+				const auto bo = dynamic_cast<const abin_op_ts*>(&ts);
+				const auto ts_s = dynamic_cast<const abin_op_ts_scalar*>(&ts);
+				const auto s_ts = dynamic_cast<const abin_op_scalar_ts*>(&ts);
+				const auto abs_n = dynamic_cast<const abs_ts*>(&ts);
+				const auto shift_n = dynamic_cast<const time_shift_ts*>(&ts);
+				if (auto v = terminal(ts)) {
+					r = add_input(ts, v);
+				} else if (bo && bo->aligned) {
+					const int a = reg(*bo->lhs.ts), b = reg(*bo->rhs.ts);
+					r = emit(ts_program::opcode::TS_OP_TS, bo->op, a, b, 0.0);
+				} else if (ts_s && ts_s->bound) {
+					r = emit(ts_program::opcode::TS_OP_SCALAR, ts_s->op, reg(*ts_s->lhs.ts), -1, ts_s->rhs);
+				} else if (s_ts && s_ts->bound) {
+					r = emit(ts_program::opcode::SCALAR_OP_TS, s_ts->op, reg(*s_ts->rhs.ts), -1, s_ts->lhs);
+				} else if (abs_n) {
+					r = emit(ts_program::opcode::ABS, iop_t::OP_NONE, reg(*abs_n->ts), -1, 0.0);
+				} else if (shift_n) {
+					r = reg(*shift_n->ts);// same values, only the time-axis differs
+				} else {
+					r = add_input(ts, nullptr);
+				}
+				regs[&ts] = r;
+				return r;
+			}
+
+			/** assign block buffers to the instruction results, reusing a buffer after the last use of its register */
+			void allocate_slots() {
+				vector<int> last_use(n_registers, -1);
+				for (size_t k = 0; k < p.code.size(); ++k) {
+					const auto& i = p.code[k];
+					last_use[i.a] = int(k);
+					if (i.b >= 0) last_use[i.b] = int(k);
+				}
+				p.slot.assign(n_registers, -1);
+				vector<int> free_slots;
+				for (size_t k = 0; k < p.code.size(); ++k) {
+					const auto& i = p.code[k];
+					if (free_slots.empty()) {
+						p.slot[i.dst] = int(p.n_slots++);
+					} else {
+						p.slot[i.dst] = free_slots.back();
+						free_slots.pop_back();
+					}
+					for (int x : {i.a, i.b})// after dst is assigned, so dst never aliases an operand
+						if (x >= 0 && p.slot[x] >= 0 && last_use[x] == int(k) && (x != i.b || i.a != i.b))
+							free_slots.push_back(p.slot[x]);
 				}
+			}
+		};
+
+		constexpr size_t ts_program::block_size;
+
+		ts_program ts_program::compile(const ipoint_ts& e) {
+			ts_program p;
+			p.n = e.size();
+			ts_program_compiler c{ p };
+			if (e.needs_bind())// let the node report the unbound usage
+				p.result = c.add_input(e, nullptr);
+			else
+				p.result = c.reg(e);
+			c.allocate_slots();
+			return p;
+		}
+
+		void ts_program::execute(double* r, eval_buffers& b) const {
+			vector<const double*> in(slot.size(), nullptr);
+			vector<vector<double>> owned; owned.reserve(inputs.size());
+			for (const auto& i : inputs) {
+				if (i.values) {
+					in[i.reg] = i.values->data();
+				} else {
+					owned.emplace_back(b.get(n));
+					i.ts->values_into(owned.back().data(), b);
+					in[i.reg] = owned.back().data();
+				}
+			}
+			if (code.empty()) {
+				std::copy(in[result], in[result] + n, r);
 			} else {
-				std::vector<double> l(lhs.values());
-				auto r = rhs;
-				switch (op) {
-				case OP_ADD:for (size_t i = 0; i < l.size(); ++i) l[i] += r; return l;
-				case OP_SUB:for (size_t i = 0; i < l.size(); ++i) l[i] -= r; return l;
-				case OP_MUL:for (size_t i = 0; i < l.size(); ++i) l[i] *= r; return l;
-				case OP_DIV:for (size_t i = 0; i < l.size(); ++i) l[i] /= r; return l;
-				case OP_MAX:for (size_t i = 0; i < l.size(); ++i) l[i] = std::max(l[i], r); return l;
-				case OP_MIN:for (size_t i = 0; i < l.size(); ++i) l[i] = std::min(l[i], r); return l;
-				default: throw runtime_error("Unsupported operation " + to_string(int(op)));
+				auto blocks = b.get(n_slots*block_size);
+				execute_blocks(in, r, 0, n, blocks.data());
+				b.put(std::move(blocks));
+			}
+			for (auto& v : owned)
+				b.put(std::move(v));
+		}
+
+		void ts_program::execute_blocks(const vector<const double*>& in, double* r, size_t i_begin, size_t i_end, double* blocks) const {
+			for (size_t i0 = i_begin; i0 < i_end; i0 += block_size) {
+				const size_t m = std::min(block_size, i_end - i0);
+				auto src = [&](int x) -> const double* { return slot[x] < 0 ? in[x] + i0 : blocks + slot[x]*block_size; };
+				auto dst = [&](int x) -> double* { return x == result ? r + i0 : blocks + slot[x]*block_size; };
+				for (const auto& i : code) {
+					switch (i.code) {
+					case opcode::TS_OP_TS: ts_op_ts_values(src(i.a), i.op, src(i.b), dst(i.dst), m); break;
+					case opcode::TS_OP_SCALAR: ts_op_scalar_values(src(i.a), i.op, i.x, dst(i.dst), m); break;
+					case opcode::SCALAR_OP_TS: scalar_op_ts_values(i.x, i.op, src(i.a), dst(i.dst), m); break;
+					case opcode::ABS: {
+						const double* a = src(i.a);
+						double* d = dst(i.dst);
+						for (size_t j = 0; j < m; ++j) d[j] = std::abs(a[j]);
+					} break;
+					}
+				}
+			}
+		}
+
+		void ts_program::execute_parallel(double* r, size_t max_threads) const {
+			auto pool = shyft::core::executor::instance();
+			const size_t n_blocks = (n + block_size - 1)/block_size;
+			if (max_threads == 1 || pool->size() == 0 || n_blocks < 2) {
+				eval_buffers b;
+				execute(r, b);
+				return;
+			}
+			vector<const double*> in(slot.size(), nullptr);
+			vector<const input*> evaluated;// the inputs that are not terminals
+			for (const auto& i : inputs) {
+				if (i.values)
+					in[i.reg] = i.values->data();
+				else
+					evaluated.push_back(&i);
+			}
+			vector<vector<double>> owned(evaluated.size());
+			pool->parallel_for(evaluated.size(), 1, [&evaluated, &owned, this](size_t k0, size_t k1) {
+				eval_buffers b;
+				for (size_t k = k0; k < k1; ++k) {
+					owned[k].resize(n);
+					evaluated[k]->ts->values_into(owned[k].data(), b);
+				}
+			}, max_threads);
+			for (size_t k = 0; k < evaluated.size(); ++k)
+				in[evaluated[k]->reg] = owned[k].data();
+			if (code.empty()) {
+				std::copy(in[result], in[result] + n, r);
+				return;
+			}
+			pool->parallel_for(n_blocks, 0, [&in, r, this](size_t b0, size_t b1) {
+				vector<double> blocks(n_slots*block_size);// each range of blocks has its own block buffers
+				execute_blocks(in, r, b0*block_size, std::min(n, b1*block_size), blocks.data());
+			}, max_threads);
+		}
+
+		vector<double> ts_program::values() const {
+			vector<double> r(n);
+			eval_buffers b;
+			execute(r.data(), b);
+			return r;
+		}
+
+		/** the smallest period covering a and b, where an invalid period is empty */
+		static utcperiod cover(const utcperiod& a, const utcperiod& b) {
+			if (!a.valid()) return b;
+			if (!b.valid()) return a;
+			return utcperiod(std::min(a.start, b.start), std::max(a.end, b.end));
+		}
+
+		/** the intervals [i0..i1] of ta that overlaps p, false if none */
+		static bool overlapping_intervals(const gta_t& ta, const utcperiod& p, size_t& i0, size_t& i1) {
+			const auto tp = ta.total_period();
+			if (ta.size() == 0 || !p.valid() || !p.overlaps(tp))
+				return false;
+			i0 = p.start <= tp.start ? 0 : ta.index_of(p.start);
+			i1 = p.end >= tp.end ? ta.size() - 1 : ta.index_of(p.end - 1);
+			return i0 != std::string::npos && i1 != std::string::npos && i0 <= i1;
+		}
+
+		/** p extended to whole intervals of ta, and n intervals before and after */
+		static utcperiod interval_cover(const gta_t& ta, const utcperiod& p, size_t n_before = 0, size_t n_after = 0) {
+			size_t i0, i1;
+			if (!overlapping_intervals(ta, p, i0, i1))
+				return utcperiod();
+			i0 = i0 > n_before ? i0 - n_before : 0;
+			i1 = std::min(ta.size() - 1, i1 + n_after);
+			return utcperiod(ta.period(i0).start, ta.period(i1).end);
+		}
+
+		static utcperiod affected_period(const shared_ptr<ipoint_ts>& its, const std::string& id, const utcperiod& p) {
+			if (!its)
+				return utcperiod();
+			const ipoint_ts* ts = its.get();
+			const bool linear = ts->point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE;
+			if (auto r = dynamic_cast<const aref_ts*>(ts)) {
+				if (r->id != id)
+					return utcperiod();
+				if (!r->rep)
+					return p;
+				return interval_cover(r->time_axis(), p, linear ? 1 : 0, 0);// linear f(t) before a point uses its value
+			}
+			if (auto b = dynamic_cast<const abin_op_ts*>(ts))
+				return cover(affected_period(b->lhs.ts, id, p), affected_period(b->rhs.ts, id, p));
+			if (auto b = dynamic_cast<const abin_op_ts_scalar*>(ts))
+				return affected_period(b->lhs.ts, id, p);
+			if (auto b = dynamic_cast<const abin_op_scalar_ts*>(ts))
+				return affected_period(b->rhs.ts, id, p);
+			if (auto a = dynamic_cast<const abs_ts*>(ts))
+				return affected_period(a->ts, id, p);
+			if (auto a = dynamic_cast<const sum_ts*>(ts)) {
+				utcperiod c;
+				for (const auto& t : a->tsv)
+					c = cover(c, affected_period(t.ts, id, p));
+				return c;
+			}
+			if (auto r = dynamic_cast<const rating_curve_ts*>(ts))
+				return affected_period(r->ts.level_ts.ts, id, p);
+			if (auto s = dynamic_cast<const time_shift_ts*>(ts)) {
+				auto c = affected_period(s->ts, id, p);
+				return c.valid() ? utcperiod(c.start + s->dt, c.end + s->dt) : c;
+			}
+			if (auto a = dynamic_cast<const average_ts*>(ts))
+				return interval_cover(a->ta, affected_period(a->ts, id, p));
+			if (auto a = dynamic_cast<const integral_ts*>(ts))
+				return interval_cover(a->ta, affected_period(a->ts, id, p));
+			if (auto a = dynamic_cast<const accumulate_ts*>(ts)) {
+				auto c = interval_cover(a->ta, affected_period(a->ts, id, p));
+				return c.valid() ? utcperiod(c.start, a->ta.total_period().end) : c;
+			}
+			if (auto c = dynamic_cast<const convolve_w_ts*>(ts)) {
+				const size_t w = c->ts_impl.w.size();
+				return interval_cover(c->time_axis(), affected_period(c->ts_impl.ts.ts, id, p), w, w);
+			}
+			// the other nodes are fully affected if any of the sources are
+			utcperiod c;
+			if (auto e = dynamic_cast<const extend_ts*>(ts))
+				c = cover(affected_period(e->lhs.ts, id, p), affected_period(e->rhs.ts, id, p));
+			else if (auto q = dynamic_cast<const qac_ts*>(ts))
+				c = cover(affected_period(q->ts, id, p), affected_period(q->cts, id, p));
+			else if (auto k = dynamic_cast<const krls_interpolation_ts*>(ts))
+				c = affected_period(k->ts.ts, id, p);
+			return c.valid() ? ts->total_period() : c;
+		}
+
+		utcperiod affected_period(const apoint_ts& e, const std::string& id, utcperiod p) {
+			return affected_period(e.ts, id, p);
+		}
+
+		size_t update_values(const apoint_ts& e, utcperiod p, std::vector<double>& v) {
+			if (v.size() != e.size()) {
+				v = e.values();
+				return v.size();
+			}
+			size_t i0, i1;
+			if (!overlapping_intervals(e.time_axis(), p, i0, i1))
+				return 0;
+			for (size_t i = i0; i <= i1; ++i)
+				v[i] = e.value(i);
+			return i1 - i0 + 1;
+		}
+
+		/** the children of its, for the nodes that can have references in their sub-expressions */
+		static void push_children(const ipoint_ts* its, std::vector<const std::shared_ptr<ipoint_ts>*>& s) {
+			auto push = [&s](const std::shared_ptr<ipoint_ts>& c) { if (c) s.push_back(&c); };
+			if (auto a = dynamic_cast<const average_ts*>(its)) push(a->ts);
+			else if (auto a = dynamic_cast<const integral_ts*>(its)) push(a->ts);
+			else if (auto a = dynamic_cast<const accumulate_ts*>(its)) push(a->ts);
+			else if (auto a = dynamic_cast<const time_shift_ts*>(its)) push(a->ts);
+			else if (auto a = dynamic_cast<const abs_ts*>(its)) push(a->ts);
+			else if (auto a = dynamic_cast<const sum_ts*>(its)) { for (const auto& t : a->tsv) push(t.ts); }
+			else if (auto a = dynamic_cast<const abin_op_ts*>(its)) { push(a->lhs.ts); push(a->rhs.ts); }
+			else if (auto a = dynamic_cast<const abin_op_scalar_ts*>(its)) push(a->rhs.ts);
+			else if (auto a = dynamic_cast<const abin_op_ts_scalar*>(its)) push(a->lhs.ts);
+			else if (auto a = dynamic_cast<const extend_ts*>(its)) { push(a->lhs.ts); push(a->rhs.ts); }
+			else if (auto a = dynamic_cast<const rating_curve_ts*>(its)) push(a->ts.level_ts.ts);
+			else if (auto a = dynamic_cast<const krls_interpolation_ts*>(its)) push(a->ts.ts);
+			else if (auto a = dynamic_cast<const convolve_w_ts*>(its)) push(a->ts_impl.ts.ts);
+			else if (auto a = dynamic_cast<const qac_ts*>(its)) { push(a->ts); push(a->cts); }
+		}
+
+		ts_bind_set::ts_bind_set(const std::vector<apoint_ts>& tsv) {
+			std::unordered_map<std::string, size_t> index;// id -> position in ids
+			std::unordered_set<const ipoint_ts*> visited;
+			std::vector<const std::shared_ptr<ipoint_ts>*> s;// the owners, so that the aref_ts can be shared with refs
+			for (const auto& ats : tsv) {
+				if (ats.ts) s.push_back(&ats.ts);
+				while (s.size()) {
+					auto sts = s.back(); s.pop_back();
+					auto its = sts->get();
+					if (!visited.insert(its).second)
+						continue;
+					if (auto rts = dynamic_cast<const aref_ts*>(its)) {
+						auto f = index.emplace(rts->id, ids.size());
+						if (f.second) {
+							ids.push_back(rts->id);
+							refs.emplace_back();
+						}
+						refs[f.first->second].push_back(apoint_ts(*sts));
+					} else {
+						auto n = s.size();
+						push_children(its, s);
+						std::reverse(s.begin() + n, s.end());// visit lhs first, so ids are in order of appearance
+					}
 				}
 			}
 		}
 
+		void ts_bind_set::bind(size_t i, const apoint_ts& bts) {
+			for (auto& r : refs[i])
+				r.bind(bts);
+		}
+
+		ts_dependency_index::ts_dependency_index(const std::vector<apoint_ts>& tsv) {
+			for (size_t i = 0; i < tsv.size(); ++i) {
+				for (const auto& bi : tsv[i].find_ts_bind_info()) {
+					auto& x = expressions[bi.reference];
+					if (x.empty() || x.back() != i)
+						x.push_back(i);
+				}
+			}
+		}
+
+		size_t ts_dependency_index::update(const std::vector<apoint_ts>& tsv, std::vector<std::vector<double>>& values, const std::string& id, utcperiod p) const {
+			if (values.size() != tsv.size())
+				throw runtime_error("ts_dependency_index.update: values and expressions must have the same size");
+			auto f = expressions.find(id);
+			if (f == expressions.end())
+				return 0;
+			size_t n = 0;
+			for (auto i : f->second) {
+				auto ap = affected_period(tsv[i], id, p);
+				if (ap.valid() || values[i].size() != tsv[i].size())
+					n += update_values(tsv[i], ap, values[i]);
+			}
+			return n;
+		}
+
 		apoint_ts time_shift(const apoint_ts& ts, utctimespan dt) {
 			return apoint_ts(std::make_shared<time_shift_ts>(ts, dt));
 		}
@@ -661,6 +1262,44 @@ namespace shyft{
 			return apoint_ts(std::make_shared<abs_ts>(ts));
 		}
 
+		apoint_ts sum(const std::vector<apoint_ts>& tsv, bool compensated) {
+			return apoint_ts(std::make_shared<sum_ts>(tsv, compensated));
+		}
+
+		std::vector<double> apoint_ts::parallel_values(size_t max_threads) const {
+			if (!ts)
+				return std::vector<double>();
+			const auto& e = *sts();
+			std::vector<double> r(e.size());
+			ts_program::compile(e).execute_parallel(r.data(), max_threads);
+			return r;
+		}
+
+		apoint_ts apoint_ts::run_length_encoded() const {
+			if (dynamic_pointer_cast<grle_ts>(sts()))
+				return *this;
+			return apoint_ts(std::make_shared<grle_ts>(time_axis(), values(), point_interpretation()));
+		}
+
+		template <class T>
+		static shared_ptr<ipoint_ts> memoized_copy(const shared_ptr<ipoint_ts>& ts) {
+			auto p = dynamic_pointer_cast<T>(ts);
+			if (!p)
+				return nullptr;
+			auto r = make_shared<T>(*p);
+			r->cache.set_active(true);
+			return r;
+		}
+
+		apoint_ts apoint_ts::memoized() const {
+			auto s = sts();
+			shared_ptr<ipoint_ts> r;
+			if ((r = memoized_copy<average_ts>(s)) || (r = memoized_copy<integral_ts>(s)) ||
+				(r = memoized_copy<accumulate_ts>(s)) || (r = memoized_copy<convolve_w_ts>(s)))
+				return apoint_ts(r);
+			return *this;
+		}
+
 		apoint_ts apoint_ts::min_max_check_linear_fill(double min_x, double max_x, utctimespan max_dt) const {
 			return apoint_ts(make_shared<qac_ts>(*this, qac_parameter{ max_dt,min_x,max_x }));
 		}
@@ -704,8 +1343,11 @@ namespace shyft{
 			virtual double value(size_t i) const { return gm.value(i); }
 			virtual double value_at(utctime t) const { return gm(t); }
 			virtual std::vector<double> values() const {
-				std::vector<double> r; r.reserve(size());
-				for (size_t i = 0; i < size(); ++i) r.push_back(value(i));
+				// evaluate the temperature, and the sca averaged to the same time-axis, as whole vectors, then apply the melt in one pass
+				std::vector<double> r{ gm.temperature->values() };
+				const std::vector<double> sca_m2{ average_ts(time_axis(), gm.sca_m2).values() };
+				for (size_t i = 0; i < r.size(); ++i)
+					r[i] = shyft::core::glacier_melt::step(gm.dtf, r[i], sca_m2[i], gm.glacier_area_m2);
 				return r;
 			}
 			virtual bool needs_bind() const { return gm.temperature->needs_bind() || gm.sca_m2->needs_bind(); }
@@ -1051,14 +1693,125 @@ namespace shyft{
 			return a * t + b; // otherwise linear interpolation
 		}
 
+		/** same rules as qac_ts::value(i), but in one sweep over the source values:
+		 * a gap between two valid points j and k is linear filled when t(k)-t(j) <= max_timespan, otherwise nan,
+		 * and a gap without a valid point on both sides remains nan.
+		 */
 		vector<double> qac_ts::values() const {
-			const size_t n{ size() };
-			vector<double> r; r.reserve(n);
-			for (size_t i = 0; i < n; ++i)
-				r.emplace_back(value(i));
+			auto r = ts->values();
+			const size_t n{ r.size() };
+			const auto& ta = ts->time_axis();
+			if (cts) {
+				for (size_t i = 0; i < n; ++i)
+					if (!p.is_ok_quality(r[i]))
+						r[i] = cts->value_at(ta.time(i)); // we do not check this value, assume ok!
+				return r;
+			}
+			const size_t npos{ string::npos };
+			size_t j = npos;// the previous valid point
+			size_t g = npos;// the first point of the current gap
+			for (size_t k = 0; k < n; ++k) {
+				if (!p.is_ok_quality(r[k])) {
+					if (g == npos) g = k;
+					continue;
+				}
+				if (g != npos) { // fill the gap g..k-1 between j and k
+					utctime t0 = j == npos ? utctime(0) : ta.time(j);
+					utctime t1 = ta.time(k);
+					if (j != npos && p.max_timespan != 0 && t1 - t0 <= p.max_timespan) {
+						double x0 = r[j], x1 = r[k];
+						double a = (x1 - x0) / (t1 - t0);
+						double b = x0 - a * t0;// x= a*t + b -> b= x- a*t
+						for (size_t i = g; i < k; ++i)
+							r[i] = a * ta.time(i) + b;
+					} else {
+						for (size_t i = g; i < k; ++i)
+							r[i] = shyft::nan;
+					}
+					g = npos;
+				}
+				j = k;
+			}
+			if (g != npos) // no valid point after the last gap
+				for (size_t i = g; i < n; ++i)
+					r[i] = shyft::nan;
 			return r;
 		}
+
+		ats_matrix::ats_matrix(const gta_t& ta, size_t n_members, double fill_value, ts_point_fx fx_policy)
+			:ta(ta), fx_policy(fx_policy), n_members(n_members), v(n_members*ta.size(), fill_value) {}
+
+		ats_matrix::ats_matrix(const ats_vector& tsv) :n_members(tsv.size()) {
+			if (tsv.size() == 0)
+				return;
+			ta = tsv[0].time_axis();
+			fx_policy = tsv[0].point_interpretation();
+			for (size_t m = 1; m < tsv.size(); ++m)
+				if (tsv[m].time_axis() != ta)
+					throw runtime_error("ats_matrix: all members must have the same time-axis, member " + std::to_string(m) + " differs");
+			v.resize(n_members*ta.size());
+			shyft::core::executor::instance()->parallel_for(n_members, 1, [this, &tsv](size_t m0, size_t m1) {
+				eval_buffers b;
+				for (size_t m = m0; m < m1; ++m)
+					tsv[m].sts()->values_into(row(m), b);
+			});
+		}
+
+		ats_vector ats_matrix::to_ats_vector() const {
+			ats_vector r; r.reserve(n_members);
+			for (size_t m = 0; m < n_members; ++m)
+				r.emplace_back(ta, vector<double>(row(m), row(m) + ta.size()), fx_policy);
+			return r;
+		}
+
+		/** reduce the rows of the matrix by op into one row, starting with the first */
+		static apoint_ts reduce_members(const ats_matrix& a, iop_t op) {
+			const size_t n = a.n_steps();
+			vector<double> r(n, a.n_members ? 0.0 : shyft::nan);
+			if (a.n_members)
+				std::copy(a.row(0), a.row(0) + n, r.data());
+			for (size_t m = 1; m < a.n_members; ++m)
+				lhs_in_place_ts_op_ts_values(r.data(), op, a.row(m), n);
+			return apoint_ts(a.ta, std::move(r), a.fx_policy);
+		}
+
+		apoint_ts ats_matrix::sum() const { return reduce_members(*this, iop_t::OP_ADD); }
+		apoint_ts ats_matrix::min() const { return reduce_members(*this, iop_t::OP_MIN); }
+		apoint_ts ats_matrix::max() const { return reduce_members(*this, iop_t::OP_MAX); }
+		apoint_ts ats_matrix::average() const {
+			auto r = reduce_members(*this, iop_t::OP_ADD);
+			if (n_members > 1)
+				r.scale_by(1.0/double(n_members));
+			return r;
+		}
+
+		ats_matrix& ats_matrix::apply(iop_t op, double x) {
+			ts_op_scalar_values(v.data(), op, x, v.data(), v.size());
+			return *this;
+		}
+		ats_matrix& ats_matrix::apply(double x, iop_t op) {
+			scalar_op_ts_values(x, op, v.data(), v.data(), v.size());
+			return *this;
+		}
+		ats_matrix& ats_matrix::apply(iop_t op, const ats_matrix& o) {
+			if (o.n_members != n_members || o.ta != ta)
+				throw runtime_error("ats_matrix: operands must have the same number of members, and the same time-axis");
+			lhs_in_place_ts_op_ts_values(v.data(), op, o.v.data(), v.size());
+			return *this;
+		}
+
+		ats_matrix operator+(ats_matrix a, double b) { return std::move(a.apply(iop_t::OP_ADD, b)); }
+		ats_matrix operator-(ats_matrix a, double b) { return std::move(a.apply(iop_t::OP_SUB, b)); }
+		ats_matrix operator*(ats_matrix a, double b) { return std::move(a.apply(iop_t::OP_MUL, b)); }
+		ats_matrix operator/(ats_matrix a, double b) { return std::move(a.apply(iop_t::OP_DIV, b)); }
+		ats_matrix operator+(double a, ats_matrix b) { return std::move(b.apply(a, iop_t::OP_ADD)); }
+		ats_matrix operator-(double a, ats_matrix b) { return std::move(b.apply(a, iop_t::OP_SUB)); }
+		ats_matrix operator*(double a, ats_matrix b) { return std::move(b.apply(a, iop_t::OP_MUL)); }
+		ats_matrix operator/(double a, ats_matrix b) { return std::move(b.apply(a, iop_t::OP_DIV)); }
+		ats_matrix operator+(ats_matrix a, const ats_matrix& b) { return std::move(a.apply(iop_t::OP_ADD, b)); }
+		ats_matrix operator-(ats_matrix a, const ats_matrix& b) { return std::move(a.apply(iop_t::OP_SUB, b)); }
+		ats_matrix operator*(ats_matrix a, const ats_matrix& b) { return std::move(a.apply(iop_t::OP_MUL, b)); }
+		ats_matrix operator/(ats_matrix a, const ats_matrix& b) { return std::move(a.apply(iop_t::OP_DIV, b)); }
 		}
     }
 }
-
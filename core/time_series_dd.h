@@ -6,6 +6,9 @@
 #include <memory>
 #include <utility>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #include "core_serialization.h"
 
@@ -14,6 +17,7 @@
 #include "time_series.h"
 #include "time_series_statistics.h"
 #include "predictions.h"
+#include "thread_pool.h"
 
 namespace shyft {
 	namespace time_series {
@@ -58,6 +62,97 @@ namespace shyft {
         using gts_t=point_ts<gta_t>;
         using rts_t=point_ts<time_axis::fixed_dt>;
 
+        /** \brief pool of value buffers for one evaluation of an expression, ref. ipoint_ts::values_into
+         *
+         * A node that needs a temporary for an operand takes it from the pool, and gives it back when done,
+         * so a deep expression reuses a few buffers sized by the time-axis, instead of allocating a vector for each node.
+         * \note not thread-safe, use one for each evaluation
+         */
+        struct eval_buffers {
+            std::vector<std::vector<double>> free;
+            std::vector<double> get(size_t n) {
+                if (free.empty())
+                    return std::vector<double>(n);
+                auto v = std::move(free.back());
+                free.pop_back();
+                v.resize(n);
+                return v;
+            }
+            void put(std::vector<double>&& v) { free.emplace_back(std::move(v)); }
+        };
+
+        /** \brief lazily computed values of an expression node, ref. apoint_ts::memoized
+         *
+         * When active, the first access computes all the values of the node in one sequential pass,
+         * and then value(i) is O(1). The values are computed once, thread-safe by std::call_once,
+         * and are not updated if the terminals of the expression are modified later.
+         * A copy of a node get its own empty cache, with the same active state.
+         */
+        struct value_cache {
+            struct state {
+                std::once_flag once;
+                std::vector<double> v;
+            };
+            std::shared_ptr<state> s;///< null when not active
+
+            value_cache()=default;
+            value_cache(const value_cache& o) {set_active(o.active());}
+            value_cache& operator=(const value_cache& o) {if(this != &o) set_active(o.active()); return *this;}
+
+            bool active() const {return s != nullptr;}
+            void set_active(bool a) {s = a ? std::make_shared<state>() : nullptr;}
+
+            /** \return the values, computed by fx() at first call */
+            template <class F>
+            const std::vector<double>& values(F&& fx) const {
+                std::call_once(s->once, [this, &fx]() {s->v = fx();});
+                return s->v;
+            }
+            template <class F>
+            double value(size_t i, F&& fx) const {
+                const auto& v = values(std::forward<F>(fx));
+                return i < v.size() ? v[i] : shyft::nan;
+            }
+        };
+
+        /** \brief the number of changes of terminal series done through the api
+         *
+         * Counted by the terminals set, fill, scale_by and set_point_interpretation, and by apoint_ts bind and merge_points,
+         * so that a table derived from the values of an expression can tell that it might be stale, ref. prefix_integral_cache.
+         * \note changes done directly on gpoint_ts::rep are not counted
+         */
+        std::uint64_t terminal_change_count();
+        void mark_terminal_changed();
+
+        struct ipoint_ts;
+
+        /** \brief lazily computed prefix_integral of the source of an integral, accumulate or average node
+         *
+         * The first random access value(i) or value_at(t) of the node builds the table in one pass over the source,
+         * and then each value is two lookups, instead of a walk over the points of the source.
+         * Unlike the value_cache, the table is rebuilt at the next access if a terminal was changed since it was built,
+         * ref. terminal_change_count. A copy of a node get its own empty table.
+         */
+        struct prefix_integral_cache {
+            struct table {
+                std::uint64_t stamp;///< the terminal_change_count when built
+                utctime end;///< the end of the total_period of the source
+                prefix_integral p;
+            };
+            mutable std::shared_ptr<const table> t;///< null until first use, set by std::atomic_store
+
+            prefix_integral_cache()=default;
+            prefix_integral_cache(const prefix_integral_cache&) {}
+            prefix_integral_cache& operator=(const prefix_integral_cache&) {return *this;}
+
+            /** \brief as accumulate_value(ts,p,..,tsum,linear), that is nan if p starts at or after the end of ts */
+            double accumulate(const ipoint_ts& ts, const utcperiod& p, utctimespan& tsum) const;
+            /** \brief as average_value(ts,p,..,linear) */
+            double average(const ipoint_ts& ts, const utcperiod& p) const;
+          private:
+            /** \return the table of ts, computed at first call, or when a terminal has changed */
+            std::shared_ptr<const table> of(const ipoint_ts& ts) const;
+        };
 
         /** \brief A virtual abstract interface (thus the prefix i) base for point_ts
          *
@@ -114,6 +209,16 @@ namespace shyft {
              */
             virtual std::vector<double> values() const =0;
 
+            /** \brief the values, as values(), into r, that must have room for size() values
+             *
+             * Expressions that override it compute directly into r, and takes the temporaries for
+             * their operands from b, so a deep expression is evaluated without a vector for each node.
+             */
+            virtual void values_into(double* r, eval_buffers& b) const {
+                auto v = values();
+                std::copy(v.begin(), v.end(), r);
+            }
+
             /** for internal computation and expression trees, we need to know *if*
              * there are unbound symbolic ts in the chain of this ts
              * We know that a point-ts never do not need a binding, but
@@ -241,6 +346,12 @@ namespace shyft {
             double value(size_t i) const {return sts()->value(i);};///< get the i'th value
             double operator()(utctime t) const  {return sts()->value_at(t);};
             std::vector<double> values() const {return ts?ts->values():std::vector<double>();}
+            /** \brief the values, as values(), with the time-axis split in ranges of blocks evaluated in parallel, ref. ts_program::execute_parallel
+             *
+             * For a single long expression, e.g. decades of 15 minute values, where values() uses one thread.
+             * \param max_threads limits the threads, including the caller, of the shared core::executor, 0 means no limit
+             */
+            std::vector<double> parallel_values(size_t max_threads=0) const;
 
             //-- then some useful functions/properties
             apoint_ts extend( const apoint_ts & ts,
@@ -268,6 +379,15 @@ namespace shyft {
             apoint_ts min_max_check_ts_fill(double min_x,double max_x,utctimespan max_dt,const apoint_ts& cts) const;
 
             apoint_ts merge_points(const apoint_ts& o);
+            /** \brief a copy of self where the values of an average, integral, accumulate or convolve_w node
+             * are computed once, at first access, so that repeated value(i) calls are O(1).
+             * Other nodes are returned as is.
+             * \note the values are not updated if the terminals of the expression are modified later,
+             *       and the cache is not serialized.
+             */
+            apoint_ts memoized() const;
+            /** \return a concrete copy of self, stored as runs of equal values, ref. grle_ts */
+            apoint_ts run_length_encoded() const;
             //-- in case the underlying ipoint_ts is a gpoint_ts (concrete points)
             //   we would like these to be working (exception if it's not possible,i.e. an expression)
             point get(size_t i) const {return point(time(i),value(i));}
@@ -335,7 +455,7 @@ namespace shyft {
             gpoint_ts() = default; // default for serialization conv
             // implement ipoint_ts contract:
             virtual ts_point_fx point_interpretation() const {return rep.point_interpretation();}
-            virtual void set_point_interpretation(ts_point_fx point_interpretation) {rep.set_point_interpretation(point_interpretation);}
+            virtual void set_point_interpretation(ts_point_fx point_interpretation) {rep.set_point_interpretation(point_interpretation);mark_terminal_changed();}
             virtual const gta_t& time_axis() const {return rep.time_axis();}
             virtual utcperiod total_period() const {return rep.total_period();}
             virtual size_t index_of(utctime t) const {return rep.index_of(t);}
@@ -344,10 +464,11 @@ namespace shyft {
             virtual double value(size_t i) const {return rep.v[i];}
             virtual double value_at(utctime t) const {return rep(t);}
             virtual std::vector<double> values() const {return rep.v;}
+            virtual void values_into(double* r, eval_buffers&) const {std::copy(rep.v.begin(), rep.v.end(), r);}
             // implement some extra functions to manipulate the points
-            void set(size_t i, double x) {rep.set(i,x);}
-            void fill(double x) {rep.fill(x);}
-            void scale_by(double x) {rep.scale_by(x);}
+            void set(size_t i, double x) {rep.set(i,x);mark_terminal_changed();}
+            void fill(double x) {rep.fill(x);mark_terminal_changed();}
+            void scale_by(double x) {rep.scale_by(x);mark_terminal_changed();}
             virtual bool needs_bind() const { return false;}
             virtual void do_bind()  {}
             gts_t & core_ts() {return rep;}
@@ -355,6 +476,38 @@ namespace shyft {
             x_serialize_decl();
         };
 
+        /** \brief grle_ts a generic concrete run-length encoded point ts, a terminal, not an expression
+         *
+         * Same role as gpoint_ts, but for piecewise constant series, like restrictions, flags and regimes,
+         * where the values are stored as runs, ref. rle_point_ts.
+         * Created by apoint_ts::run_length_encoded(), the values are read-only.
+         * \note in serialized expressions, e.g. to/from the dtss, it appears as a dense gpoint_ts
+         */
+        struct grle_ts:ipoint_ts {
+            using rep_t=rle_point_ts<gta_t>;
+            rep_t rep;
+            grle_ts(rep_t&&x):rep(std::move(x)){}
+            grle_ts(const rep_t&x):rep(x){}
+            grle_ts(const gta_t&ta,const std::vector<double>& v,ts_point_fx point_fx=POINT_INSTANT_VALUE):rep(ta,v,point_fx) {}
+            grle_ts() = default; // default for serialization conv
+            // implement ipoint_ts contract:
+            virtual ts_point_fx point_interpretation() const {return rep.point_interpretation();}
+            virtual void set_point_interpretation(ts_point_fx point_interpretation) {rep.set_point_interpretation(point_interpretation);mark_terminal_changed();}
+            virtual const gta_t& time_axis() const {return rep.time_axis();}
+            virtual utcperiod total_period() const {return rep.total_period();}
+            virtual size_t index_of(utctime t) const {return rep.index_of(t);}
+            virtual size_t size() const {return rep.size();}
+            virtual utctime time(size_t i) const {return rep.time(i);};
+            virtual double value(size_t i) const {return rep.value(i);}
+            virtual double value_at(utctime t) const {return rep(t);}
+            virtual std::vector<double> values() const {return rep.values();}
+            virtual void values_into(double* r, eval_buffers&) const {rep.values(0, rep.size(), r);}
+            virtual bool needs_bind() const { return false;}
+            virtual void do_bind()  {}
+            const rep_t& core_ts() const {return rep;}
+            x_serialize_decl();
+        };
+
         struct aref_ts:ipoint_ts {
             using ref_ts_t=shared_ptr<gpoint_ts>;// shyft::time_series::ref_ts<gts_t> ref_ts_t;
             ref_ts_t rep;
@@ -372,6 +525,7 @@ namespace shyft {
             virtual double value(size_t i) const {return rep->value(i);}
             virtual double value_at(utctime t) const {return rep->value_at(t);}
             virtual std::vector<double> values() const {return rep->values();}
+            virtual void values_into(double* r, eval_buffers& b) const {rep->values_into(r, b);}
             // implement some extra functions to manipulate the points
             void set(size_t i, double x) {rep->set(i,x);}
             void fill(double x) {rep->fill(x);}
@@ -421,6 +575,8 @@ namespace shyft {
             average_ts(gta_t&& ta,const std::shared_ptr<ipoint_ts> &ts ):ta(std::move(ta)),ts(ts){}
             // std copy ct and assign
             average_ts()=default;
+            value_cache cache;///< if active, the values are computed once, ref. apoint_ts::memoized
+            prefix_integral_cache prefix;///< the prefix-integral of ts, for random access value(i)
             // implement ipoint_ts contract:
             virtual ts_point_fx point_interpretation() const {return ts_point_fx::POINT_AVERAGE_VALUE;}
             virtual void set_point_interpretation(ts_point_fx point_interpretation) {;}
@@ -430,12 +586,13 @@ namespace shyft {
             virtual size_t size() const {return ta.size();}
             virtual utctime time(size_t i) const {return ta.time(i);};
             virtual double value(size_t i) const {
+                if (cache.active())
+                    return cache.value(i, [this]() {return evaluate();});
                 #ifdef _DEBUG
                 if(i>ta.size())
                     return nan;
                 #endif
-                size_t ix_hint=(i*ts->size())/ta.size();// assume almost fixed delta-t.
-                return average_value(*ts,ta.period(i),ix_hint,ts->point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE);
+                return prefix.average(*ts,ta.period(i));
             }
             virtual double value_at(utctime t) const {
                 // return true average at t
@@ -444,8 +601,11 @@ namespace shyft {
                 return value(index_of(t));
             }
 			virtual std::vector<double> values() const;
+            virtual void values_into(double* r, eval_buffers& b) const;
             virtual bool needs_bind() const { return ts->needs_bind();}
             virtual void do_bind() {ts->do_bind();}
+            std::vector<double> evaluate() const;///< the values, not using the cache
+            void evaluate_into(double* r, eval_buffers& b) const;
             x_serialize_decl();
 
         };
@@ -480,6 +640,8 @@ namespace shyft {
             integral_ts(gta_t&& ta, const std::shared_ptr<ipoint_ts> &ts) :ta(std::move(ta)), ts(ts) {}
             // std copy ct and assign
             integral_ts()=default;
+            value_cache cache;///< if active, the values are computed once, ref. apoint_ts::memoized
+            prefix_integral_cache prefix;///< the prefix-integral of ts, for random access value(i)
             // implement ipoint_ts contract:
             virtual ts_point_fx point_interpretation() const { return ts_point_fx::POINT_AVERAGE_VALUE; }
             virtual void set_point_interpretation(ts_point_fx point_interpretation) { ; }
@@ -489,11 +651,12 @@ namespace shyft {
             virtual size_t size() const { return ta.size(); }
             virtual utctime time(size_t i) const { return ta.time(i); };
             virtual double value(size_t i) const {
+                if (cache.active())
+                    return cache.value(i, [this]() {return evaluate();});
                 if (i>ta.size())
                     return nan;
-                size_t ix_hint = (i*ts->size()) / ta.size();// assume almost fixed delta-t.
                 utctimespan tsum = 0;
-                return accumulate_value(*ts, ta.period(i), ix_hint,tsum, ts->point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE);
+                return prefix.accumulate(*ts, ta.period(i), tsum);
             }
             virtual double value_at(utctime t) const {
                 // return true average at t
@@ -502,8 +665,11 @@ namespace shyft {
                 return value(index_of(t));
             }
             virtual std::vector<double> values() const ;
+            virtual void values_into(double* r, eval_buffers& b) const;
             virtual bool needs_bind() const { return ts->needs_bind();}
             virtual void do_bind() {ts->do_bind();}
+            std::vector<double> evaluate() const;///< the values, not using the cache
+            void evaluate_into(double* r, eval_buffers& b) const;
             x_serialize_decl();
 
         };
@@ -544,6 +710,8 @@ namespace shyft {
             accumulate_ts(gta_t&& ta, const std::shared_ptr<ipoint_ts> &ts) :ta(std::move(ta)), ts(ts) {}
             // std copy ct and assign
             accumulate_ts()=default;
+            value_cache cache;///< if active, the values are computed once, ref. apoint_ts::memoized
+            prefix_integral_cache prefix;///< the prefix-integral of ts, for random access value(i)
             // implement ipoint_ts contract:
             virtual ts_point_fx point_interpretation() const { return ts_point_fx::POINT_INSTANT_VALUE; }
             virtual void set_point_interpretation(ts_point_fx point_interpretation) { ; }// we could throw here..
@@ -553,13 +721,14 @@ namespace shyft {
             virtual size_t size() const { return ta.size(); }
             virtual utctime time(size_t i) const { return ta.time(i); };
             virtual double value(size_t i) const {
+                if (cache.active())
+                    return cache.value(i, [this]() {return evaluate();});
                 if (i>ta.size())
                     return nan;
                 if (i == 0)// by definition,0.0 at i=0
                     return 0.0;
-                size_t ix_hint = 0;// assume almost fixed delta-t.
                 utctimespan tsum;
-                return accumulate_value(*ts, utcperiod(ta.time(0), ta.time(i)), ix_hint, tsum, ts->point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE);
+                return prefix.accumulate(*ts, utcperiod(ta.time(0), ta.time(i)), tsum);
             }
             virtual double value_at(utctime t) const {
                 // return true accumulated value at t
@@ -568,10 +737,13 @@ namespace shyft {
                 if (t == ta.time(0))
                     return 0.0; // by definition
                 utctimespan tsum;
-                size_t ix_hint = 0;
-                return accumulate_value(*this, utcperiod(ta.time(0), t), ix_hint, tsum, ts->point_interpretation() == ts_point_fx::POINT_INSTANT_VALUE);// also note: average of non-nan areas !;
+                return prefix.accumulate(*ts, utcperiod(ta.time(0), t), tsum);// also note: average of non-nan areas !;
             }
             virtual std::vector<double> values() const {
+                return cache.active() ? cache.values([this]() {return evaluate();}) : evaluate();
+            }
+            /** the values, not using the cache */
+            std::vector<double> evaluate() const {
                 std::vector<double> r;r.reserve(ta.size());
                 accumulate_accessor<ipoint_ts, gta_t> accumulate(*ts, ta);// use accessor, that
                 for (size_t i = 0;i<ta.size();++i) {                      // given sequential access
@@ -646,6 +818,7 @@ namespace shyft {
             virtual double value(size_t i) const {return ts->value(i);}
             virtual double value_at(utctime t) const {return ts->value_at(t-dt);}
             virtual std::vector<double> values() const {return ts->values();}
+            virtual void values_into(double* r, eval_buffers& b) const {ts->values_into(r, b);}
             virtual bool needs_bind() const { return ts->needs_bind();}
             virtual void do_bind() {ts->do_bind();local_do_bind();}
             x_serialize_decl();
@@ -701,6 +874,10 @@ namespace shyft {
                 for (auto &v : vv) v = abs(v);
                 return vv;
             }
+            virtual void values_into(double* r, eval_buffers& b) const {
+                ts->values_into(r, b);
+                for (size_t i = 0; i < ta.size(); ++i) r[i] = abs(r[i]);
+            }
             virtual bool needs_bind() const { return ts->needs_bind(); }
             virtual void do_bind() { ts->do_bind(); local_do_bind(); }
             x_serialize_decl();
@@ -763,6 +940,7 @@ namespace shyft {
 
             // std.ct
             convolve_w_ts() =default;
+            value_cache cache;///< if active, the values are computed once, ref. apoint_ts::memoized
 
             // implement ipoint_ts contract
             virtual ts_point_fx point_interpretation() const { return ts_impl.point_interpretation(); }
@@ -772,13 +950,16 @@ namespace shyft {
             virtual size_t index_of(utctime t) const { return ts_impl.index_of(t); }
             virtual size_t size() const { return ts_impl.size(); }
             virtual utctime time(size_t i) const { return ts_impl.time(i); }
-            virtual double value(size_t i) const { return ts_impl.value(i); }
+            virtual double value(size_t i) const {
+                return cache.active() ? cache.value(i, [this]() {return evaluate();}) : ts_impl.value(i);
+            }
             virtual double value_at(utctime t) const { return value(index_of(t)); }
             virtual vector<double> values() const {
-                vector<double> r;r.reserve(size());
-                for (size_t i = 0;i<size();++i)
-                    r.push_back(ts_impl.value(i));
-                return r;
+                return cache.active() ? cache.values([this]() {return evaluate();}) : evaluate();
+            }
+            /** the values, not using the cache */
+            vector<double> evaluate() const {
+                return shyft::time_series::convolve_w_values(ts_impl.ts.values(), ts_impl.w, ts_impl.policy);
             }
             virtual bool needs_bind() const { return ts_impl.needs_bind();}
             virtual void do_bind() {ts_impl.do_bind();}
@@ -923,9 +1104,9 @@ namespace shyft {
 			virtual double value(std::size_t i) const { return ts.value(i); }
 			// -----
 			virtual std::vector<double> values() const {
-				std::size_t dim = size();
-				std::vector<double> ret; ret.reserve(dim);
-				for ( std::size_t i = 0u; i < dim; ++i ) { ret.emplace_back(value(i)); }
+				ts.ensure_bound();
+				std::vector<double> ret = ts.level_ts.values();// levels in bulk, then the flows in bulk
+				ts.rc_param.flow(ts.time_axis(), 0u, ret.size(), ret.data());
 				return ret;
 			}
 
@@ -941,7 +1122,8 @@ namespace shyft {
             krls_p predictor;
 
             bool bound=false;
-            
+            vector<double> v;///< the predictions at the time-points of ts, made once by local_do_bind, not serialized
+
             template <class TS_, class PRED_>
             krls_interpolation_ts(TS_&&ts, PRED_&& p):ts(std::forward<TS_>(ts)),predictor(std::forward<PRED_>(p)) {
                 if (!needs_bind())
@@ -980,6 +1162,8 @@ namespace shyft {
                     predictor.train(ts);
                     bound=true;
                 }
+                if (v.size() != ts.size())
+                    v = predictor.predict_vec(ts.time_axis());
             }
             void bind_check() const {
                 if ( ! bound ) {
@@ -998,11 +1182,11 @@ namespace shyft {
             virtual double value_at(utctime t) const { bind_check(); return predictor.predict(t); }
             // -----
             virtual utctime time(std::size_t i) const { return ts.time(i); }
-            virtual double value(std::size_t i) const { bind_check(); return predictor.predict(ts.time(i)); }
+            virtual double value(std::size_t i) const { bind_check(); return i < v.size() ? v[i] : predictor.predict(ts.time(i)); }
             // -----
             virtual std::vector<double> values() const {
                 bind_check();
-                return predictor.predict_vec(ts.time_axis());
+                return v.size() == ts.size() ? v : predictor.predict_vec(ts.time_axis());
             }
 
             x_serialize_decl();
@@ -1154,6 +1338,7 @@ namespace shyft {
             gta_t ta;
             ts_point_fx fx_policy=POINT_AVERAGE_VALUE;
             bool bound=false;
+            bool aligned=false;///< lhs and rhs have identical time-axis, so value(i) is op(lhs.value(i),rhs.value(i)), set at bind
 
             ts_point_fx point_interpretation() const {return fx_policy;}
             void set_point_interpretation(ts_point_fx x) {fx_policy=x;}
@@ -1162,6 +1347,7 @@ namespace shyft {
                 if(!bound) {
                     fx_policy=result_policy(lhs.point_interpretation(),rhs.point_interpretation());
                     ta=time_axis::combine(lhs.time_axis(),rhs.time_axis());
+                    aligned= lhs.time_axis()==rhs.time_axis();
                     bound=true;
                 }
             }
@@ -1181,12 +1367,59 @@ namespace shyft {
             double value_at(utctime t) const ;
             double value(size_t i) const;// return op( lhs(t), rhs(t)) ..
             std::vector<double> values() const;
+            void values_into(double* r, eval_buffers& b) const;
             bool needs_bind() const {return lhs.needs_bind() || rhs.needs_bind(); }
             virtual void do_bind() {lhs.do_bind();rhs.do_bind();local_do_bind();}
             x_serialize_decl();
 
         };
 
+        /** \brief the sum of n time-series, as one flat node, ref. dd::sum
+         *
+         * Evaluates as the chain tsv[0]+tsv[1]+..., the time-axis is the combined time-axis of the terms,
+         * and the point interpretation the result_policy of them, but without the depth of the chain.
+         * values_into splits the terms into a fixed number of groups, by the number of terms only,
+         * that are summed in parallel, each into its own partial sum, with dense loops over the values,
+         * then the partials are added in group order, so the result does not depend on the threads used.
+         * Terms with the time-axis of the sum are read in place if concrete, the others are evaluated at the time-points.
+         * If compensated, each partial sum is Kahan compensated, this assumes finite terms.
+         */
+        struct sum_ts:ipoint_ts {
+            std::vector<apoint_ts> tsv;
+            bool compensated=false;
+            gta_t ta;
+            ts_point_fx fx_policy=POINT_AVERAGE_VALUE;
+            bool bound=false;
+            std::vector<char> aligned;///< aligned[j] if tsv[j] has the time-axis of the sum, set at bind
+
+            static constexpr size_t group_size=64;///< min. terms of each group
+            static constexpr size_t max_groups=16;
+
+            ts_point_fx point_interpretation() const {return fx_policy;}
+            void set_point_interpretation(ts_point_fx x) {fx_policy=x;}
+
+            void local_do_bind();
+            void set_aligned();
+
+            sum_ts()=default;
+            explicit sum_ts(const std::vector<apoint_ts>& tsv, bool compensated=false);
+            void bind_check() const {if(!bound) throw runtime_error("attempting to use unbound timeseries, context sum_ts");}
+            virtual utcperiod total_period() const {return time_axis().total_period();}
+            const gta_t& time_axis() const {bind_check(); return ta;};
+            size_t index_of(utctime t) const{return time_axis().index_of(t);};
+            size_t size() const {return time_axis().size();};
+            utctime time( size_t i) const {return time_axis().time(i);};
+            double value_at(utctime t) const;
+            double value(size_t i) const;
+            std::vector<double> values() const;
+            void values_into(double* r, eval_buffers& b) const;
+            bool needs_bind() const;
+            virtual void do_bind();
+            /** \return the number of groups the terms are summed in */
+            size_t n_groups() const {return std::max(size_t(1), std::min(max_groups, tsv.size()/group_size));}
+            x_serialize_decl();
+        };
+
         /** \brief  binary operation for type ts op double
          *
          * The resulting time-axis and point interpretation policy is equal to the ts.
@@ -1228,6 +1461,7 @@ namespace shyft {
               double value_at(utctime t) const ;
               double value(size_t i) const ;
               std::vector<double> values() const ;
+              void values_into(double* r, eval_buffers& b) const;
               bool needs_bind() const {return rhs.needs_bind(); }
               virtual void do_bind() {rhs.do_bind();local_do_bind();}
               x_serialize_decl();
@@ -1270,6 +1504,7 @@ namespace shyft {
               double value_at(utctime t) const;
               double value(size_t i) const;
               std::vector<double> values() const;
+              void values_into(double* r, eval_buffers& b) const;
               bool needs_bind() const {return lhs.needs_bind(); }
               virtual void do_bind() {lhs.do_bind();local_do_bind();}
               x_serialize_decl();
@@ -1323,10 +1558,140 @@ namespace shyft {
         ///< percentiles, need to include several forms of time_axis for python
         std::vector<apoint_ts> percentiles(const std::vector<apoint_ts>& ts_list,const gta_t & ta,const vector<int>& percentiles);
         std::vector<apoint_ts> percentiles(const std::vector<apoint_ts>& ts_list,const time_axis::fixed_dt & ta,const vector<int>& percentiles);
+        /** \brief the sum of the time-series of tsv, as one sum_ts node instead of a chain of abin_op_ts
+         * \param tsv the terms, at least one
+         * \param compensated if true, Kahan compensated summation
+         * \throw runtime_error if tsv is empty
+         */
+        apoint_ts sum(const std::vector<apoint_ts>& tsv, bool compensated=false);
+        ///< aggregates, sum, mean, weighted, histogram etc. across the ts_list, ref. calculate_aggregates and aggregate_property
+        std::vector<apoint_ts> aggregates(const std::vector<apoint_ts>& ts_list,const gta_t & ta,const vector<int>& aggregates,const vector<double>& weights,const vector<double>& bins);
 
         ///< time_shift i.e. same ts values, but time-axis is time-axis + dt
         apoint_ts time_shift(const apoint_ts &ts, utctimespan dt);
 
+        /** \brief a bound expression, lowered to a flat instruction list over registers
+         *
+         * The element-wise part of the expression, that is abin_op_ts with aligned operands,
+         * the scalar ops, abs_ts and time_shift_ts, is compiled into instructions, in dependency order,
+         * where each register is the values of one node. The other nodes are inputs of the program:
+         * terminals are referenced in place, and the others (average, integral, unaligned bin-ops, etc.)
+         * are evaluated once, by ipoint_ts::values_into, before the instructions are executed.
+         *
+         * The instructions are executed in blocks of block_size points, so the registers of the
+         * intermediate nodes are block sized, and stays in cache, instead of one vector for each node.
+         * Nodes referenced more than once in the expression are computed once.
+         *
+         * Used by values() of the binary operation nodes, and thus by deflate_ts_vector (dtss, ats_vector.values()).
+         * \note the program references the nodes of the expression, that must outlive it
+         */
+        struct ts_program {
+            enum class opcode : int8_t {
+                TS_OP_TS,///< r[dst] = r[a] op r[b]
+                TS_OP_SCALAR,///< r[dst] = r[a] op x
+                SCALAR_OP_TS,///< r[dst] = x op r[a]
+                ABS///< r[dst] = abs(r[a])
+            };
+            struct instruction {
+                opcode code;
+                iop_t op;
+                int dst;
+                int a;
+                int b;
+                double x;
+            };
+            struct input {
+                int reg;
+                const ipoint_ts* ts;///< the node to evaluate by values_into, if values is null
+                const std::vector<double>* values;///< the values of a terminal, referenced in place
+            };
+            static constexpr size_t block_size = 1024;
+
+            size_t n = 0;///< number of points, the size of all registers
+            std::vector<input> inputs;
+            std::vector<instruction> code;///< in order of execution
+            std::vector<int> slot;///< for each register, the block buffer of an instruction result, -1 for inputs
+            size_t n_slots = 0;///< block buffers needed, buffers are reused when a result is no longer needed
+            int result = -1;///< the register with the values of the expression
+
+            /** \brief compile the bound expression e */
+            static ts_program compile(const ipoint_ts& e);
+            static ts_program compile(const apoint_ts& e) { return compile(*e.sts()); }
+
+            /** \brief values of the expression into r, that must have room for n values */
+            void execute(double* r, eval_buffers& b) const;
+            /** \brief as execute, with the ranges of blocks, and the inputs, evaluated in parallel on the shared core::executor
+             *
+             * The instructions are element-wise, so each range of blocks is independent, and each thread executes
+             * its ranges with block buffers of its own, into its part of r.
+             * The nodes with state across time, like average, integral, accumulate and convolve_w, are inputs,
+             * evaluated once each over the whole time-axis, concurrently with the other inputs,
+             * so the result equals execute, bit by bit.
+             * \param max_threads limits the threads, including the caller, 0 means no limit, 1 is execute
+             */
+            void execute_parallel(double* r, size_t max_threads = 0) const;
+            std::vector<double> values() const;
+            /** \brief execute the instructions for the points [i_begin..i_end), starting at a block boundary,
+             * with the values of the inputs in, and n_slots*block_size block buffers */
+            void execute_blocks(const std::vector<const double*>& in, double* r, size_t i_begin, size_t i_end, double* blocks) const;
+        };
+
+        /** \brief the period where f(t) of the expression e can change, when the terminal id gets new values in the period p
+         *
+         * The changes are followed through the nodes: element-wise nodes keep the period, time_shift_ts shifts it,
+         * average and integral extends it to the intervals of their time-axis, accumulate to the end of its time-axis,
+         * and linear interpretation to the neighbour points. Other nodes that depends on id are
+         * conservatively fully affected.
+         * \return the affected period of e, or an invalid period if e is not affected
+         */
+        utcperiod affected_period(const apoint_ts& e, const std::string& id, utcperiod p);
+
+        /** \brief recompute the values v of the expression e, for the points that overlaps the period p
+         *
+         * If v does not have the size of e, e.g. the time-axis has been extended, all values are recomputed.
+         * \return the number of recomputed values
+         */
+        size_t update_values(const apoint_ts& e, utcperiod p, std::vector<double>& v);
+
+        /** \brief reverse index from the terminal ids, of the aref_ts, to the expressions that depend on them
+         *
+         * Used to keep the evaluated values of a set of bound expressions up to date,
+         * when one terminal gets new values, without recomputing the other expressions,
+         * or the parts of the affected expressions that did not change, ref. update.
+         */
+        struct ts_dependency_index {
+            std::map<std::string, std::vector<size_t>> expressions;///< id -> index of the expressions that depend on it
+
+            ts_dependency_index() = default;
+            explicit ts_dependency_index(const std::vector<apoint_ts>& tsv);
+
+            /** \brief update values[i] of the expressions tsv[i] depending on id, for the changes in period p
+             *  \return total number of recomputed values
+             */
+            size_t update(const std::vector<apoint_ts>& tsv, std::vector<std::vector<double>>& values, const std::string& id, utcperiod p) const;
+        };
+
+        /** \brief the references of a vector of expressions, collected in one pass, as one unique id list
+         *
+         * Walks the expressions once, visiting nodes shared between, or within, the expressions only once,
+         * and interns the ids of the aref_ts, so that each id is read once by the dtss,
+         * regardless of how many expressions that refers to it.
+         * Compared to calling apoint_ts::find_ts_bind_info for each expression, no string or
+         * ts_bind_info is copied per occurrence, and deep shared sub-expressions are visited once.
+         */
+        struct ts_bind_set {
+            std::vector<std::string> ids;///< the unique ids, in order of first appearance in the expressions
+            std::vector<std::vector<apoint_ts>> refs;///< refs[i] are the aref_ts nodes that refers to ids[i]
+
+            ts_bind_set() = default;
+            explicit ts_bind_set(const std::vector<apoint_ts>& tsv);
+
+            size_t size() const { return ids.size(); }
+
+            /** binds all the references to ids[i] to the point ts bts, ref. apoint_ts::bind */
+            void bind(size_t i, const apoint_ts& bts);
+        };
+
         apoint_ts extend(
             const apoint_ts & lhs_ts, const apoint_ts & rhs_ts,
             extend_ts_split_policy split_policy, extend_ts_fill_policy fill_policy,
@@ -1336,27 +1701,24 @@ namespace shyft {
          * equivalent concrete point-time-series of the expressions in the
          * preferred destination type Ts
          * Useful for the dtss,
-         * evaluates the expressions in parallell
+         * evaluates the expressions in parallell, on the shared core::executor pool,
+         * each result is at the position of its expression.
+         * \param tsv1 the bound expressions, const and thread-safe to evaluate
+         * \param max_threads limits the threads, including the caller, used for this call, 0 means all of the pool,
+         *        so that a large vector from one client can not take all the threads from concurrent calls
          */
         template <class Ts,class TsV>
         std::vector<Ts>
-        deflate_ts_vector(TsV &&tsv1) {
+        deflate_ts_vector(TsV &&tsv1, size_t max_threads=0) {
             std::vector<Ts> tsv2(tsv1.size());
-
-            auto deflate_range=[&tsv1,&tsv2](size_t i0,size_t n) {
-                for(size_t i=i0;i<i0+n;++i)
+            auto deflate_range=[&tsv1,&tsv2](size_t i0,size_t i1) {
+                for(size_t i=i0;i<i1;++i)
                     tsv2[i]= Ts(tsv1[i].time_axis(),tsv1[i].values(),tsv1[i].point_interpretation());
             };
-            auto n_threads =  thread::hardware_concurrency();
-            if(n_threads <2) n_threads=4;// hard coded minimum
-            std::vector<std::future<void>> calcs;
-            size_t ps= 1 + tsv1.size()/n_threads;
-            for (size_t p = 0;p < tsv1.size(); ) {
-                size_t np = p + ps <= tsv1.size() ? ps : tsv1.size() - p;
-                calcs.push_back(std::async(std::launch::async, deflate_range, p, np));
-                p += np;
-            }
-            for (auto &f : calcs) f.get();
+            auto pool = shyft::core::executor::instance();
+            const size_t n_q = pool->queue_count(max_threads);
+            // small chunks, the cost of each expression varies a lot, and idle threads steals the rest
+            pool->parallel_for(tsv1.size(), std::max(size_t(1), tsv1.size()/(8*n_q)), deflate_range, max_threads);
             return tsv2;
         }
 
@@ -1397,20 +1759,30 @@ namespace shyft {
             bool operator !() const { // can't expose it as op, due to math promotion
                 return !(size() > 0);
             }
+            /** \return the value at t of each ts, evaluated in parallel on the shared core::executor */
             vector<double> values_at_time(utctime t) const {
-                std::vector<double> r;r.reserve(size());
-                for (auto const &ts : *this ) r.push_back(ts(t));
+                std::vector<double> r(size());
+                shyft::core::executor::instance()->parallel_for(size(), 0, [this, &r, t](size_t i0, size_t i1) {
+                    for (size_t i = i0; i < i1; ++i) r[i] = (*this)[i](t);
+                });
                 return r;
             }
+            /** \return the concrete point ts of each bound expression, evaluated in parallel, ref. deflate_ts_vector
+             * \param max_threads limits the threads, including the caller, of the executor used, 0 means no limit
+             */
+            ats_vector evaluate(size_t max_threads=0) const {
+                return ats_vector(deflate_ts_vector<apoint_ts>(*this, max_threads));
+            }
             ats_vector percentiles(gta_t const &ta,vector<int> const& percentile_list) const {
-                ats_vector r;r.reserve(percentile_list.size());
-                auto rp= shyft::time_series::calculate_percentiles(ta,deflate_ts_vector<gts_t>(*this),percentile_list);
-                for(auto&ts:rp) r.emplace_back(ta,std::move(ts.v),POINT_AVERAGE_VALUE);
-                return r;
+                return dd::percentiles(*this,ta,percentile_list);
             }
             ats_vector percentiles_f(time_axis::fixed_dt const&ta,vector<int> const& percentile_list) const {
                 return percentiles(gta_t(ta),percentile_list);
             }
+            /** \return the sum of the members, as one sum_ts node, ref. dd::sum */
+            apoint_ts sum(bool compensated=false) const {
+                return dd::sum(*this,compensated);
+            }
             ats_vector slice(vector<int>const& slice_spec) const {
                 if(slice_spec.size()==0) {
                     return ats_vector(*this);// just a clone of this
@@ -1478,6 +1850,23 @@ namespace shyft {
             apoint_ts forecast_merge(utctimespan lead_time,utctimespan fc_interval) const;
             ats_vector average_slice(utctimespan t0_offset,utctimespan dt, int n) const ;
             double nash_sutcliffe(apoint_ts const &obs,utctimespan t0_offset,utctimespan dt, int n)const ;
+
+            /** \brief serialize each ts into a blob of its own, in parallel, concatenated with an offset table
+             *
+             * Each ts is serialized as apoint_ts::serialize, so common sub-expressions shared between the
+             * series are written once for each ts that references them.
+             *   <blob>   -> <magic> uint64_t <n> uint64_t <offset> uint64_t[n+1] <ts-blob>[n]
+             * where offset[i] is the start of the i'th ts-blob, relative to the first, and offset[n] their total size,
+             * so the i'th ts can be read without reading the others, ref. deserialize_indexed_at.
+             * \param max_threads limits the threads, including the caller, of the executor used, 0 means no limit
+             */
+            std::vector<char> serialize_indexed(size_t max_threads=0) const;
+            /** \return the ts-vector of a blob from serialize_indexed, deserialized in parallel, throws if not a valid blob */
+            static ats_vector deserialize_indexed(const std::vector<char>& blob, size_t max_threads=0);
+            /** \return the number of ts of a blob from serialize_indexed, throws if not a valid blob */
+            static size_t indexed_size(const std::vector<char>& blob);
+            /** \return the i'th ts of a blob from serialize_indexed, throws if not a valid blob, or i is out of range */
+            static apoint_ts deserialize_indexed_at(const std::vector<char>& blob, size_t i);
             x_serialize_decl();
         };
         // quantile-mapping
@@ -1525,6 +1914,59 @@ namespace shyft {
         ats_vector max(ats_vector const &a, apoint_ts const & b);
         ats_vector max(apoint_ts const &b, ats_vector const &a);
         ats_vector max(ats_vector const &a, ats_vector const & b);
+
+        /** \brief ats_matrix, the values of an ensemble of time-series with one common time-axis, as one member x time-step matrix
+         *
+         * Where ats_vector keeps each member as its own expression node, ats_matrix stores the evaluated values
+         * of member m contiguous at v[m*n_steps() .. (m+1)*n_steps()), so that element-wise operations
+         * and reductions over the members are dense loops over one array.
+         * view(m) gives a member as a core point_ts_view, without copying, and to_ats_vector() gives
+         * the members back as concrete apoint_ts.
+         */
+        struct ats_matrix {
+            gta_t ta;
+            ts_point_fx fx_policy=POINT_AVERAGE_VALUE;
+            size_t n_members=0;
+            std::vector<double> v;///< member major, v[m*ta.size()+i]
+
+            ats_matrix()=default;
+            ats_matrix(const gta_t& ta, size_t n_members, double fill_value, ts_point_fx fx_policy);
+            /** \brief evaluate the members of tsv, in parallel, into the matrix
+             * \throw runtime_error if the members have different time-axis
+             */
+            explicit ats_matrix(const ats_vector& tsv);
+
+            size_t size() const {return n_members;}
+            size_t n_steps() const {return ta.size();}
+            double* row(size_t m) {return v.data() + m*ta.size();}
+            const double* row(size_t m) const {return v.data() + m*ta.size();}
+            /** a view of member m, valid as long as the matrix is not modified in size or destroyed */
+            point_ts_view<gta_t> view(size_t m) const {return point_ts_view<gta_t>(ta, row(m), ta.size(), fx_policy);}
+            ats_vector to_ats_vector() const;
+
+            //-- reductions over the members, for each time-step
+            apoint_ts sum() const;
+            apoint_ts average() const;
+            apoint_ts min() const;
+            apoint_ts max() const;
+
+            //-- element-wise, in place
+            ats_matrix& apply(iop_t op, double x);///< v = v op x
+            ats_matrix& apply(iop_t op, const ats_matrix& o);///< v = v op o.v, o of same shape and time-axis
+            ats_matrix& apply(double x, iop_t op);///< v = x op v
+        };
+        ats_matrix operator+(ats_matrix a, double b);
+        ats_matrix operator-(ats_matrix a, double b);
+        ats_matrix operator*(ats_matrix a, double b);
+        ats_matrix operator/(ats_matrix a, double b);
+        ats_matrix operator+(double a, ats_matrix b);
+        ats_matrix operator-(double a, ats_matrix b);
+        ats_matrix operator*(double a, ats_matrix b);
+        ats_matrix operator/(double a, ats_matrix b);
+        ats_matrix operator+(ats_matrix a, const ats_matrix& b);
+        ats_matrix operator-(ats_matrix a, const ats_matrix& b);
+        ats_matrix operator*(ats_matrix a, const ats_matrix& b);
+        ats_matrix operator/(ats_matrix a, const ats_matrix& b);
     }
 	}
     namespace time_series {
@@ -1541,6 +1983,7 @@ namespace shyft {
 //-- serialization support
 x_serialize_export_key(shyft::time_series::dd::ipoint_ts);
 x_serialize_export_key(shyft::time_series::dd::gpoint_ts);
+x_serialize_export_key(shyft::time_series::dd::grle_ts);
 x_serialize_export_key(shyft::time_series::dd::average_ts);
 x_serialize_export_key(shyft::time_series::dd::integral_ts);
 x_serialize_export_key(shyft::time_series::dd::accumulate_ts);
@@ -1559,5 +2002,6 @@ x_serialize_export_key(shyft::time_series::dd::krls_interpolation_ts);
 x_serialize_export_key_nt(shyft::time_series::dd::apoint_ts);
 x_serialize_export_key(shyft::time_series::dd::ats_vector);
 x_serialize_export_key(shyft::time_series::dd::abs_ts);
+x_serialize_export_key(shyft::time_series::dd::sum_ts);
 x_serialize_export_key(shyft::time_series::dd::qac_ts);
 x_serialize_binary(shyft::time_series::dd::qac_parameter);
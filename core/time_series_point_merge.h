@@ -6,6 +6,60 @@
 #include "time_series.h"
 namespace shyft{namespace time_series {
 
+namespace detail {
+    /** \brief merge the points of b into the tail of a, where a have a point time-axis
+     *
+     * Only the points of a at or after b.time(0) are merged with b, the points before are kept in place,
+     * so appending a short b to a long a is O(b.size()) for a.v, and for the time-points
+     * of a unless they are shared with other time-axis (then they are copied once, ref. time_points).
+     * \return false if a is not a point time-axis
+     */
+    template<class t_axis_a,class ts_b>
+    bool ts_point_merge_tail(point_ts<t_axis_a>&, const ts_b&) { return false; }
+
+    template<class ts_b>
+    bool ts_point_merge_tail(point_ts<time_axis::generic_dt>&a, const ts_b& b) {
+        if(a.ta.gt != time_axis::generic_dt::POINT)
+            return false;
+        const auto& at=a.ta.p.t;
+        const size_t ia0 = static_cast<size_t>(std::lower_bound(at.begin(), at.end(), b.time(0)) - at.begin());
+        vector<utctime> t;t.reserve(a.size() - ia0 + b.size());//the merged tail, assume worst case
+        vector<double> v;v.reserve(a.size() - ia0 + b.size());
+        size_t ia=ia0;size_t ib=0;
+        while(ia<a.size() && ib<b.size()) {
+            auto ta=at[ia];
+            auto tb=b.time(ib);
+            if(ta==tb) { // b replaces value in a
+                t.emplace_back(tb);
+                v.emplace_back(b.value(ib));
+                ++ia;++ib;
+            } else if(ta<tb) { // a contribute with it's own point
+                t.emplace_back(ta);
+                v.emplace_back(a.v[ia]);
+                ++ia;
+            } else { // b contribute with it's own point
+                t.emplace_back(tb);
+                v.emplace_back(b.value(ib));
+                ++ib;
+            }
+        }
+        while(ia<a.size()) {
+            t.emplace_back(at[ia]);
+            v.emplace_back(a.v[ia++]);
+        }
+        while(ib<b.size()) {
+            t.emplace_back(b.time(ib));
+            v.emplace_back(b.value(ib++));
+        }
+        utctime t_end = std::max(a.ta.p.t_end,b.time_axis().total_period().end);
+        auto& mt=a.ta.p.t.mut();
+        mt.resize(ia0);mt.insert(mt.end(),t.begin(),t.end());
+        a.v.resize(ia0);a.v.insert(a.v.end(),v.begin(),v.end());
+        a.ta.p.t_end=t_end;
+        return true;
+    }
+}
+
 /** \brief merge points from b into a 
  *
  * The result of the merge operation is the unique union set of time-points
@@ -16,6 +70,9 @@ namespace shyft{namespace time_series {
  * 
  * The function is assumed to be useful in the data-collection or
  * time-series point manipulation tasks
+ *
+ * If a have a point time-axis, only the tail of a from b.time(0) is rebuilt,
+ * so appending new points to a is O(b.size()), ref. detail::ts_point_merge_tail.
  * 
  */
 template<class t_axis_a,class ts_b>    
@@ -25,6 +82,8 @@ void ts_point_merge (point_ts<t_axis_a>&a, const ts_b& b) {
         a.ta=b.time_axis();
         a.v=b.values();
         a.fx_policy=b.point_interpretation();//kind of ok, practical?
+    } else if(detail::ts_point_merge_tail(a,b)) { // a point time-axis, merged from b.time(0) and on
+        return;
     } else { // a straight forward, not neccessary optimal algorithm for merge:
         vector<utctime> t;t.reserve(a.size()+b.size());//assume worst case
         vector<double> v;v.reserve(a.size()+b.size());
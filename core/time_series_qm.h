@@ -7,11 +7,73 @@
 
 #include "utctime_utilities.h"
 #include "time_series.h"
+#include "thread_pool.h"
 
 namespace shyft {
     namespace qm {
         using namespace std;
 
+        /** \brief the values of a ts-vector on a time-axis, sampled once, as a dense matrix
+        *
+        * The values of one time-step are adjacent, v[t*n_ts + i] is the value of the i'th ts at the t'th period,
+        * so the per time-step sort and quantiles of the quantile mapping reads contiguous memory,
+        * and the accessors are evaluated once, not for each comparison.
+        */
+        struct dense_values {
+            size_t n_ts = 0;///< number of time-series
+            size_t n_t = 0;///< number of time-steps
+            vector<double> v;///< [n_t][n_ts], time-step major
+            double value(size_t i, size_t t) const { return v[t*n_ts + i]; }
+            const double* step(size_t t) const { return v.data() + t*n_ts; }
+        };
+
+        /** \brief sample the values of tsv on ta, in parallel over the series, using tsa_t(ts,ta,a...) accessors
+        * \tparam tsa_t time-series accessor type, ref. quantile_index
+        */
+        template <class tsa_t, class tsv_t, class ta_t, class ...A>
+        dense_values dense_values_of(tsv_t const &tsv, ta_t const &ta, A... a) {
+            dense_values d;
+            d.n_ts = tsv.size();
+            d.n_t = ta.size();
+            d.v.resize(d.n_ts*d.n_t);
+            vector<double> rows(d.n_ts*d.n_t);// series major, so each series is written by one thread
+            auto pool = core::executor::instance();
+            pool->parallel_for(d.n_ts, 1, [&](size_t i0, size_t i1) {
+                for (size_t i = i0; i < i1; ++i) {
+                    tsa_t tsa(tsv[i], ta, a...);
+                    for (size_t t = 0; t < d.n_t; ++t)
+                        rows[i*d.n_t + t] = tsa.value(t);
+                }
+            });
+            pool->parallel_for(d.n_t, 0, [&d, &rows](size_t t0, size_t t1) {// then transposed, by blocks of time-steps
+                for (size_t t = t0; t < t1; ++t)
+                    for (size_t i = 0; i < d.n_ts; ++i)
+                        d.v[t*d.n_ts + i] = rows[i*d.n_t + t];
+            });
+            return d;
+        }
+
+        /** \brief quantile_index of the sampled values d, in parallel over the time-steps
+        * \return vector<vector<int>> that have dimension [d.n_t][finite values] holding the indexes of the by-value in time-step ordered list
+        */
+        inline vector<vector<int>> quantile_index(dense_values const &d) {
+            vector<vector<int>> qi(d.n_t); // result vector, qi[i] -> a vector of index-order tsv[i].value(t)
+            core::executor::instance()->parallel_for(d.n_t, 0, [&d, &qi](size_t t0, size_t t1) {
+                for (size_t t = t0; t < t1; ++t) {
+                    const double* v = d.step(t);
+                    vector<int> pi; pi.reserve(d.n_ts); // get rid of nan-members before sort
+                    for (size_t i = 0; i < d.n_ts; ++i) {
+                        if (isfinite(v[i])) {
+                            pi.emplace_back(i);
+                        }
+                    }
+                    sort(begin(pi), end(pi), [v](int a, int b)->bool {return v[a] < v[b]; });
+                    qi[t] = std::move(pi);
+                }
+            });
+            return qi;
+        }
+
         /**\brief quantile_index generates a pr. time-step index for order by value
         * \tparam tsa_t time-series accessor type that fits to tsv_t::value_type and ta_t, thread-safe fast access to the value aspect
         *               of the time-series for each period in the specified time-axis
@@ -28,23 +90,7 @@ namespace shyft {
         */
         template <class tsa_t, class tsv_t, class ta_t>
         vector<vector<int>> quantile_index(tsv_t const &tsv, ta_t const &ta) {
-            vector < tsa_t> tsa; tsa.reserve(tsv.size()); // create ts-accessors to enable fast thread-safe access to ts value aspect
-            for (const auto& ts : tsv) tsa.emplace_back(ts, ta, shyft::time_series::extension_policy::USE_NAN);
-
-            vector<vector<int>> qi(ta.size()); // result vector, qi[i] -> a vector of index-order tsv[i].value(t)
-            //vector<int> pi(tsv.size()); for (size_t i = 0; i<tsv.size(); ++i) pi[i] = i;//initial order 0..n-1, and we re-use it in the loop
-            for (size_t t = 0; t<ta.size(); ++t) {
-				vector<int> pi;pi.reserve(pi.size()); // get rid of nan-members before sort
-				for (size_t i = 0; i<tsa.size(); ++i) {
-					if (isfinite(tsa[i].value(t))) {
-						pi.emplace_back(i);
-					}
-				}
-                sort(begin(pi), end(pi), [&tsa, t](int a, int b)->int {return tsa[a].value(t)<tsa[b].value(t); });
-                // Filter away the nans, which signal that we have time series that don't extend this far
-                qi[t] = pi; // it's a copy assignment, ok, since sort above will start out with previous time-step order
-            }
-            return qi;
+            return quantile_index(dense_values_of<tsa_t>(tsv, ta, shyft::time_series::extension_policy::USE_NAN));
         }
 
 
@@ -205,6 +251,22 @@ namespace shyft {
             double value(size_t i) const { return tsv[ordered_ix[t_ix][i]].value(t_ix); }
         };
 
+        /**\brief a Weight Value Ordered collection of one time-step of dense_values, ref. wvo_accessor */
+        struct dense_wvo_accessor {
+            vector<int>const& ordered_ix; ///<index ordering of the time-step
+            vector<double>const & w;///< weights of each ts
+            const double* v;///< the values of the time-step, ref. dense_values::step
+            double w_sum = 0.0;///< sum of the weights of the ordered_ix
+            dense_wvo_accessor(vector<int> const&ordered_ix, vector<double> const&w, const double* v)
+                :ordered_ix(ordered_ix), w(w), v(v) {
+                for (size_t i = 0; i<ordered_ix.size(); ++i)
+                    w_sum += w[ordered_ix[i]];
+            }
+            size_t size() const { return ordered_ix.size(); }
+            double weight(size_t i) const { return w[ordered_ix[i]] / w_sum; }
+            double value(size_t i) const { return v[ordered_ix[i]]; }
+        };
+
         /**\brief The main quantile mapping function, which, using quantile
         * calculations, maps the values of the weighted 'forecast' time
         * series vectors onto the 'prior' time series. This mapping is done
@@ -259,11 +321,46 @@ namespace shyft {
                 core::utctime const &interpolation_start,
                 core::utctime const interpolation_end = core::no_utctime,
                 bool interpolated_quantiles = false) {
+            return quantile_mapping_sampled(pri_tsv, dense_values_of<tsa_t>(pri_tsv, time_axis), fc_tsv, dense_values_of<tsa_t>(fc_tsv, time_axis),
+                pri_idx_v, fc_idx_v, fc_weights, time_axis, interpolation_start, interpolation_end, interpolated_quantiles);
+        }
 
-            vector<tsa_t> pri_accessor_vec;
-            pri_accessor_vec.reserve(pri_tsv.size());
+        /**\brief quantile_mapping of the sampled values pri and fc, of pri_tsv and fc_tsv on time_axis, ref. dense_values_of
+        *
+        * The time-steps are mapped in parallel, into a dense result, and the resulting
+        * time-series are then made in parallel, one for each of pri_tsv.
+        * \see quantile_mapping
+        */
+        template <class tsv_t, class ta_t>
+        tsv_t quantile_mapping_sampled(tsv_t const &pri_tsv, dense_values const &pri,
+                tsv_t const &fc_tsv, dense_values const &fc,
+                vector<vector<int>> const &pri_idx_v,
+                vector<vector<int>> const &fc_idx_v,
+                vector<double> const &fc_weights,
+                ta_t const &time_axis,
+                core::utctime const &interpolation_start,
+                core::utctime const interpolation_end = core::no_utctime,
+                bool interpolated_quantiles = false) {
+            vector<time_series::ts_point_fx> pri_fx; pri_fx.reserve(pri_tsv.size());
             for (const auto& ts : pri_tsv)
-                pri_accessor_vec.emplace_back(ts, time_axis);
+                pri_fx.emplace_back(ts.point_interpretation());
+            return quantile_mapping_sampled(pri_fx, pri, 0, pri_idx_v, fc_tsv, fc, fc_idx_v, fc_weights,
+                time_axis, interpolation_start, interpolation_end, interpolated_quantiles);
+        }
+
+        /**\brief quantile_mapping, as above, where the t'th step of time_axis is the (pri_t0+t)'th step of pri and pri_idx_v
+        * \param pri_fx the point interpretation of each of the resulting time-series
+        */
+        template <class tsv_t, class ta_t>
+        tsv_t quantile_mapping_sampled(vector<time_series::ts_point_fx> const &pri_fx, dense_values const &pri, size_t pri_t0,
+                vector<vector<int>> const &pri_idx_v,
+                tsv_t const &fc_tsv, dense_values const &fc,
+                vector<vector<int>> const &fc_idx_v,
+                vector<double> const &fc_weights,
+                ta_t const &time_axis,
+                core::utctime const &interpolation_start,
+                core::utctime const interpolation_end = core::no_utctime,
+                bool interpolated_quantiles = false) {
 
             core::utcperiod fc_period; // compute the maximum forecast period
             for (const auto&ts : fc_tsv) {
@@ -290,45 +387,131 @@ namespace shyft {
                 interpolation_period = core::utcperiod();
             }
 
-            vector<tsa_t> fc_accessor_vec;
-            pri_accessor_vec.reserve(fc_tsv.size());
-            for (const auto& ts : fc_tsv)
-                fc_accessor_vec.emplace_back(ts, time_axis);
+            const size_t n_pri = pri_fx.size();
+            vector<double> r(time_axis.size()*n_pri, nan);// [t][i], as dense_values
+            auto pool = core::executor::instance();
+            pool->parallel_for(time_axis.size(), 0, [&](size_t t0, size_t t1) {
+                for (size_t t = t0; t < t1; ++t) {
+                    dense_wvo_accessor wvo_fc(fc_idx_v[t], fc_weights, fc.step(t));
+                    const auto& pri_ix = pri_idx_v[pri_t0 + t];
+                    const double* pri_v = pri.step(pri_t0 + t);
+                    double* r_t = r.data() + t*n_pri;
+                    size_t num_pri_cases = pri_ix.size();
+                    if (wvo_fc.size() > 0 && (!core::is_valid(interpolation_period.end) || time_axis.time(t)<interpolation_period.end)) {
+                        vector<double> quantile_vals;
+                        if (interpolated_quantiles) {
+                            quantile_vals = compute_interp_weighted_quantiles(num_pri_cases, wvo_fc);
+                        } else {
+                            quantile_vals = compute_weighted_quantiles(num_pri_cases, wvo_fc);
+                        }
+                        if ( (interpolation_period.contains(time_axis.time(t)) ||
+                                interpolation_period.end == time_axis.time(t))) {
+                            core::utctime start = interpolation_period.start;
+                            core::utctime end = interpolation_period.end;
+                            double interp_weight = (static_cast<double>(time_axis.time(t) - start)/(end - start));
+                            for (size_t i = 0; i < num_pri_cases; ++i)
+                                r_t[pri_ix[i]] = (1.0 - interp_weight)*quantile_vals[i] + interp_weight*pri_v[pri_ix[i]];
+                        } else {
+                            for (size_t i = 0; i < num_pri_cases; ++i)  r_t[pri_ix[i]] = quantile_vals[i];
+                        }
+                    } else { // if no more forecast available, or after valid end, use the prior scenario value for the specified time-points
+                        for (size_t i = 0; i < num_pri_cases; ++i)  r_t[pri_ix[i]] = pri_v[pri_ix[i]];
+                    }
+                }
+            });
+            vector<vector<double>> values(n_pri);
+            pool->parallel_for(n_pri, 1, [&](size_t i0, size_t i1) {
+                for (size_t i = i0; i < i1; ++i) {
+                    values[i].resize(time_axis.size());
+                    for (size_t t = 0; t < time_axis.size(); ++t)
+                        values[i][t] = r[t*n_pri + i];
+                }
+            });
+            tsv_t output;
+            output.reserve(n_pri);
+            for (size_t i = 0; i < n_pri; ++i)
+                output.emplace_back(time_axis, std::move(values[i]), pri_fx[i]);
+            return output;
+        }
 
-            auto wvo_fc = wvo_accessor<tsa_t>(fc_idx_v, fc_weights, fc_accessor_vec);
+        /** \brief the by-value order of the prior, historical, series at each step of a time-axis, computed once and reused
+        *
+        * The priors of the quantile mapping do not change between the runs, so the prior values and their
+        * ordering can be made once, on a time-axis covering the forecast periods to come, and passed to quantile_mapping,
+        * so that each run only samples and sorts the forecast members.
+        * The time-axis of a mapping must then be a contiguous range of the periods of the ranking time-axis, ref. step_of.
+        * \tparam ta_t the time-axis type of the ranking
+        */
+        template <class ta_t>
+        struct prior_ranking {
+            ta_t ta;///< the time-axis of the ranking
+            dense_values values;///< the prior values, sampled on ta
+            vector<vector<int>> ix;///< [ta.size()] the by-value order of the finite values, ref. quantile_index
+            vector<time_series::ts_point_fx> fx;///< the point interpretation of each prior
 
+            prior_ranking() = default;
 
-            tsv_t output;
-            output.reserve(pri_tsv.size());
-            for (size_t i = 0; i<pri_tsv.size(); ++i) {
-                output.emplace_back(time_axis, nan, pri_tsv[i].point_interpretation());
+            /** make the ranking of the tsv priors on ta, using tsa_t accessors, ref. quantile_index */
+            template <class tsa_t, class tsv_t>
+            static prior_ranking make(tsv_t const &tsv, ta_t const &ta) {
+                prior_ranking r;
+                r.ta = ta;
+                r.values = dense_values_of<tsa_t>(tsv, ta);
+                r.ix = quantile_index(r.values);
+                r.fx.reserve(tsv.size());
+                for (const auto& ts : tsv)
+                    r.fx.emplace_back(ts.point_interpretation());
+                return r;
             }
-            for (size_t t = 0; t<time_axis.size(); ++t) {
-                wvo_fc.t_ix = t;
-                size_t num_pri_cases = pri_idx_v[t].size();
-                if (wvo_fc.size() > 0 && (!core::is_valid(interpolation_period.end) || time_axis.time(t)<interpolation_period.end)) {
-                    vector<double> quantile_vals;
-                    if (interpolated_quantiles) {
-                        quantile_vals = compute_interp_weighted_quantiles(num_pri_cases, wvo_fc);
-                    } else {
-                        quantile_vals = compute_weighted_quantiles(num_pri_cases, wvo_fc);
-                    }
-                    if ( (interpolation_period.contains(time_axis.time(t)) ||
-                            interpolation_period.end == time_axis.time(t))) {
-                        core::utctime start = interpolation_period.start;
-                        core::utctime end = interpolation_period.end;
-                        double interp_weight = (static_cast<double>(time_axis.time(t) - start)/(end - start));
-                        for (size_t i = 0; i < num_pri_cases; ++i)
-                            output[pri_idx_v[t][i]].set(t,(1.0 - interp_weight)*quantile_vals[i] + interp_weight*pri_accessor_vec[pri_idx_v[t][i]].value(t));
-                    } else {
-                        for (size_t i = 0; i < num_pri_cases; ++i)  output[pri_idx_v[t][i]].set(t, quantile_vals[i]);
-                    }
-                } else { // if no more forecast available, or after valid end, use the prior scenario value for the specified time-points
-                    for (size_t i = 0; i < num_pri_cases; ++i)  output[pri_idx_v[t][i]].set(t, pri_accessor_vec[pri_idx_v[t][i]].value(t));
-                }
+
+            size_t size() const { return fx.size(); }
+
+            /** \return the step of ta that is the first period of time_axis, throws if time_axis is not a range of the periods of ta */
+            template <class mta_t>
+            size_t step_of(mta_t const &time_axis) const {
+                if (time_axis.size() == 0)
+                    return 0;
+                const size_t t0 = ta.index_of(time_axis.time(0));
+                if (t0 == string::npos || t0 + time_axis.size() > ta.size())
+                    throw runtime_error("qm: the time-axis is not covered by the prior ranking");
+                for (size_t t = 0; t < time_axis.size(); ++t)
+                    if (ta.period(t0 + t) != time_axis.period(t))
+                        throw runtime_error("qm: the time-axis periods differ from the prior ranking");
+                return t0;
             }
+        };
 
-            return output;
+        /**\brief quantile_mapping of fc_tsv to the precomputed prior ranking, ref. prior_ranking
+        *
+        * Equal to quantile_mapping of the priors of the ranking, but only the forecasts are sampled and sorted.
+        * \tparam tsa_t time-series accessor type, ref. quantile_index, for the forecasts
+        * \param pri the prior ranking, its time-axis should contain the periods of time_axis
+        * \see quantile_mapping
+        */
+        template <class tsa_t, class tsv_t, class ta_t, class pta_t>
+        tsv_t quantile_mapping(prior_ranking<pta_t> const &pri, tsv_t const &fc_tsv,
+                vector<double> const &fc_weights,
+                ta_t const &time_axis,
+                core::utctime const &interpolation_start,
+                core::utctime const interpolation_end = core::no_utctime,
+                bool interpolated_quantiles = false) {
+            const size_t pri_t0 = pri.step_of(time_axis);
+            const auto fc = dense_values_of<tsa_t>(fc_tsv, time_axis);
+            return quantile_mapping_sampled(pri.fx, pri.values, pri_t0, pri.ix, fc_tsv, fc, quantile_index(fc), fc_weights,
+                time_axis, interpolation_start, interpolation_end, interpolated_quantiles);
+        }
+
+        /** unpack the forecast sets into one ts-vector, and the weight of the set of each member */
+        template <class tsv_t>
+        void unpack_forecast_sets(vector<tsv_t> const &forecast_sets, vector<double> const &set_weights, tsv_t &forecasts, vector<double> &weights) {
+            for (size_t i = 0; i<forecast_sets.size(); ++i) {
+                forecasts.reserve(forecasts.size() + forecast_sets[i].size());
+                weights.reserve(weights.size() + forecast_sets[i].size());
+                for (size_t j = 0; j<forecast_sets[i].size(); ++j) {
+                    forecasts.emplace_back(forecast_sets[i][j]);
+                    weights.emplace_back(set_weights[i]);
+                }
+            }
         }
 
         /** \brief the quantile_map_forecast applies quantile_mapping to weighted forecast_set and historical data
@@ -363,22 +546,33 @@ namespace shyft {
             bool interpolated_quantiles=false) {
             tsv_t forecasts_unpacked;
             vector<double> weights_unpacked;
-            for (size_t i = 0; i<forecast_sets.size(); ++i) {
-                forecasts_unpacked.reserve(forecasts_unpacked.size() + forecast_sets[i].size());
-                weights_unpacked.reserve(weights_unpacked.size() + forecast_sets[i].size());
-                for (size_t j = 0; j<forecast_sets[i].size(); ++j) {
-                    forecasts_unpacked.emplace_back(forecast_sets[i][j]);
-                    weights_unpacked.emplace_back(set_weights[i]);
-                }
-            }
-
-            auto historical_indices_handle = async(launch::async, quantile_index<tsa_t, tsv_t, ta_t>, historical_data, time_axis);
-            auto forecast_indices = quantile_index<tsa_t>(forecasts_unpacked, time_axis);
+            unpack_forecast_sets(forecast_sets, set_weights, forecasts_unpacked, weights_unpacked);
 
-            return quantile_mapping<tsa_t>(historical_data, forecasts_unpacked,
-                historical_indices_handle.get(), forecast_indices, weights_unpacked,
+            // each accessor is evaluated once, the sort and quantiles use the sampled values
+            const auto historical_values = dense_values_of<tsa_t>(historical_data, time_axis);
+            const auto forecast_values = dense_values_of<tsa_t>(forecasts_unpacked, time_axis);
+            return quantile_mapping_sampled(historical_data, historical_values, forecasts_unpacked, forecast_values,
+                quantile_index(historical_values), quantile_index(forecast_values), weights_unpacked,
                 time_axis, interpolation_start,interpolation_end,
                 interpolated_quantiles);
         }
+
+        /** \brief quantile_map_forecast, as above, to the precomputed ranking of the historical data, ref. prior_ranking
+        *
+        * Only the forecast members are sampled and sorted, so repeated runs with the same priors
+        * reuse the ranking, as long as its time-axis covers the time_axis of each run.
+        */
+        template <class tsa_t, class tsv_t, class ta_t, class pta_t>
+        tsv_t quantile_map_forecast(vector<tsv_t> const &forecast_sets,
+            vector<double> const &set_weights, prior_ranking<pta_t> const &historical_ranking,
+            ta_t const &time_axis,
+            core::utctime interpolation_start,core::utctime interpolation_end=core::no_utctime,
+            bool interpolated_quantiles=false) {
+            tsv_t forecasts_unpacked;
+            vector<double> weights_unpacked;
+            unpack_forecast_sets(forecast_sets, set_weights, forecasts_unpacked, weights_unpacked);
+            return quantile_mapping<tsa_t>(historical_ranking, forecasts_unpacked, weights_unpacked,
+                time_axis, interpolation_start, interpolation_end, interpolated_quantiles);
+        }
     }
 }
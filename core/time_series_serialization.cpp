@@ -24,8 +24,12 @@
 #include "time_series_info.h"
 #include "predictions.h"
 #include "dtss_cache.h"
+#include "dtss_scheduler.h"
+#include "thread_pool.h"
 
 #include <dlib/serialize.h>
+#include <cstring>
+#include <streambuf>
 
 //
 // 2. Then implement each class serialization support
@@ -36,15 +40,25 @@ using namespace shyft::core;
 
 
 //-- time-series serialization
-template <class Ta>
+template <class Ta, class V>
 template <class Archive>
-void shyft::time_series::point_ts<Ta>::serialize(Archive & ar, const unsigned int version) {
+void shyft::time_series::point_ts<Ta, V>::serialize(Archive & ar, const unsigned int version) {
 	ar
 		& core_nvp("time_axis", ta)
 		& core_nvp("fx_policy", fx_policy)
 		& core_nvp("values", v)
 		;
 }
+template <class Ta>
+template <class Archive>
+void shyft::time_series::rle_point_ts<Ta>::serialize(Archive & ar, const unsigned int version) {
+	ar
+		& core_nvp("time_axis", ta)
+		& core_nvp("fx_policy", fx_policy)
+		& core_nvp("run_start", run_start)
+		& core_nvp("run_value", run_value)
+		;
+}
 template <class TS>
 template <class Archive>
 void shyft::time_series::ref_ts<TS>::serialize(Archive & ar, const unsigned int version) {
@@ -246,6 +260,24 @@ void shyft::dtss::cache_stats::serialize(Arcive& ar, const unsigned int file_ver
 		& core_nvp("id_count", id_count)
 		& core_nvp("point_count", point_count)
 		& core_nvp("fragment_count", fragment_count)
+		& core_nvp("byte_count", byte_count)
+		& core_nvp("result_count", result_count)
+		& core_nvp("result_byte_count", result_byte_count)
+		;
+}
+
+template <class Arcive>
+void shyft::dtss::scheduler_stats::serialize(Arcive& ar, const unsigned int file_version) {
+	ar
+		& core_nvp("workers", workers)
+		& core_nvp("running", running)
+		& core_nvp("queued", queued)
+		& core_nvp("max_queued", max_queued)
+		& core_nvp("admitted", admitted)
+		& core_nvp("rejected", rejected)
+		& core_nvp("clients", clients)
+		& core_nvp("queued_cost", queued_cost)
+		& core_nvp("wait_ms", wait_ms)
 		;
 }
 
@@ -264,6 +296,14 @@ void shyft::time_series::dd::gpoint_ts::serialize(Archive & ar, const unsigned i
 }
 
 
+template<class Archive>
+void shyft::time_series::dd::grle_ts::serialize(Archive & ar, const unsigned int version) {
+	ar
+		& core_nvp("ipoint_ts", base_object<shyft::time_series::dd::ipoint_ts>(*this))
+		& core_nvp("rep", rep)
+		;
+}
+
 template<class Archive>
 void shyft::time_series::dd::aref_ts::serialize(Archive & ar, const unsigned int version) {
 	ar
@@ -407,6 +447,8 @@ void shyft::time_series::dd::abin_op_ts::serialize(Archive & ar, const unsigned
 		& core_nvp("fx_policy", fx_policy)
 		& core_nvp("bound", bound)
 		;
+	if (Archive::is_loading::value)// derived from the time-axis of the bound lhs,rhs
+		aligned = bound && !needs_bind() && lhs.time_axis() == rhs.time_axis();
 }
 
 template<class Archive>
@@ -443,6 +485,20 @@ void shyft::time_series::dd::abs_ts::serialize(Archive & ar, const unsigned int
 		;
 }
 
+template<class Archive>
+void shyft::time_series::dd::sum_ts::serialize(Archive & ar, const unsigned int version) {
+	ar
+		& core_nvp("ipoint_ts", base_object<shyft::time_series::dd::ipoint_ts>(*this))
+		& core_nvp("tsv", tsv)
+		& core_nvp("compensated", compensated)
+		& core_nvp("ta", ta)
+		& core_nvp("fx_policy", fx_policy)
+		& core_nvp("bound", bound)
+		;
+	if (Archive::is_loading::value && bound && !needs_bind())// derived from the time-axis of the bound terms
+		set_aligned();
+}
+
 template<class Archive>
 void shyft::time_series::dd::qac_ts::serialize(Archive & ar, const unsigned int version) {
 	ar
@@ -474,12 +530,15 @@ void shyft::time_series::dd::apoint_ts::serialize(Archive & ar, const unsigned i
 //-- export dtss stuff
 x_serialize_implement(shyft::dtss::ts_info);
 x_serialize_implement(shyft::dtss::cache_stats);
+x_serialize_implement(shyft::dtss::scheduler_stats);
 
 //-- export core time-series (except binary-ops)
 x_serialize_implement(shyft::time_series::point_ts<shyft::time_axis::fixed_dt>);
 x_serialize_implement(shyft::time_series::point_ts<shyft::time_axis::calendar_dt>);
 x_serialize_implement(shyft::time_series::point_ts<shyft::time_axis::point_dt>);
 x_serialize_implement(shyft::time_series::point_ts<shyft::time_axis::generic_dt>);
+x_serialize_implement(shyft::time_series::rle_point_ts<shyft::time_axis::fixed_dt>);
+x_serialize_implement(shyft::time_series::rle_point_ts<shyft::time_axis::generic_dt>);
 
 x_serialize_implement(shyft::time_series::ref_ts<shyft::time_series::point_ts<shyft::time_axis::fixed_dt>>);
 x_serialize_implement(shyft::time_series::ref_ts<shyft::time_series::point_ts<shyft::time_axis::calendar_dt>>);
@@ -511,11 +570,13 @@ x_serialize_implement(shyft::time_series::rating_curve_ts<shyft::time_series::po
 
 x_serialize_implement(shyft::time_series::dd::ipoint_ts);
 x_serialize_implement(shyft::time_series::dd::gpoint_ts);
+x_serialize_implement(shyft::time_series::dd::grle_ts);
 x_serialize_implement(shyft::time_series::dd::aref_ts);
 x_serialize_implement(shyft::time_series::dd::average_ts);
 x_serialize_implement(shyft::time_series::dd::integral_ts);
 x_serialize_implement(shyft::time_series::dd::accumulate_ts);
 x_serialize_implement(shyft::time_series::dd::abs_ts);
+x_serialize_implement(shyft::time_series::dd::sum_ts);
 x_serialize_implement(shyft::time_series::dd::time_shift_ts);
 x_serialize_implement(shyft::time_series::dd::periodic_ts);
 x_serialize_implement(shyft::time_series::convolve_w_ts<shyft::time_series::dd::apoint_ts>);
@@ -546,6 +607,8 @@ x_arch(shyft::time_series::point_ts<shyft::time_axis::fixed_dt>);
 x_arch(shyft::time_series::point_ts<shyft::time_axis::calendar_dt>);
 x_arch(shyft::time_series::point_ts<shyft::time_axis::point_dt>);
 x_arch(shyft::time_series::point_ts<shyft::time_axis::generic_dt>);
+x_arch(shyft::time_series::rle_point_ts<shyft::time_axis::fixed_dt>);
+x_arch(shyft::time_series::rle_point_ts<shyft::time_axis::generic_dt>);
 
 x_arch(shyft::time_series::convolve_w_ts<shyft::time_series::point_ts<shyft::time_axis::fixed_dt>>);
 x_arch(shyft::time_series::convolve_w_ts<shyft::time_series::point_ts<shyft::time_axis::generic_dt>>);
@@ -575,14 +638,17 @@ x_arch(shyft::time_series::rating_curve_ts<shyft::time_series::point_ts<shyft::t
 
 x_arch(shyft::prediction::krls_rbf_predictor);
 x_arch(shyft::dtss::cache_stats);
+x_arch(shyft::dtss::scheduler_stats);
 
 x_arch(shyft::time_series::dd::ipoint_ts);
 x_arch(shyft::time_series::dd::gpoint_ts);
+x_arch(shyft::time_series::dd::grle_ts);
 x_arch(shyft::time_series::dd::aref_ts);
 x_arch(shyft::time_series::dd::average_ts);
 x_arch(shyft::time_series::dd::integral_ts);
 x_arch(shyft::time_series::dd::accumulate_ts);
 x_arch(shyft::time_series::dd::abs_ts);
+x_arch(shyft::time_series::dd::sum_ts);
 x_arch(shyft::time_series::dd::time_shift_ts);
 x_arch(shyft::time_series::dd::periodic_ts);
 x_arch(shyft::time_series::convolve_w_ts<shyft::time_series::dd::apoint_ts>);
@@ -614,3 +680,92 @@ shyft::time_series::dd::apoint_ts shyft::time_series::dd::apoint_ts::deserialize
 	ia >> core_nvp("ats", ats);
 	return ats;
 }
+
+namespace {
+    using std::uint64_t;
+    constexpr uint64_t indexed_magic = 0x3130585354594853ull;///< "SHYTSX01"
+    constexpr size_t indexed_header = 2*sizeof(uint64_t);
+
+    /** read-only stream over a block of memory */
+    struct memory_streambuf : std::streambuf {
+        memory_streambuf(const char* d, size_t sz) {
+            char* b = const_cast<char*>(d);// only read, the get area is never written
+            setg(b, b, b + sz);
+        }
+    };
+
+    uint64_t get_u64(const char* d) { uint64_t v; std::memcpy(&v, d, sizeof(v)); return v; }
+
+    /** \return the number of ts of the indexed blob b, throws unless the header and offset table are valid */
+    size_t indexed_count(const std::vector<char>& b) {
+        auto fail = []() { throw std::runtime_error("ts-vector: not a valid indexed blob"); };
+        if (b.size() < indexed_header || get_u64(b.data()) != indexed_magic)
+            fail();
+        const uint64_t n = get_u64(b.data() + sizeof(uint64_t));
+        if (n >= (b.size() - indexed_header)/sizeof(uint64_t))
+            fail();
+        const size_t data = indexed_header + (size_t(n) + 1)*sizeof(uint64_t);
+        if (get_u64(b.data() + indexed_header) != 0 || data + get_u64(b.data() + data - sizeof(uint64_t)) != b.size())
+            fail();
+        return size_t(n);
+    }
+
+    shyft::time_series::dd::apoint_ts indexed_at(const std::vector<char>& b, size_t n, size_t i) {
+        const char* offsets = b.data() + indexed_header;
+        const char* data = offsets + (n + 1)*sizeof(uint64_t);
+        const uint64_t o0 = get_u64(offsets + i*sizeof(uint64_t)), o1 = get_u64(offsets + (i + 1)*sizeof(uint64_t));
+        if (o0 > o1 || o1 > size_t(b.data() + b.size() - data))
+            throw std::runtime_error("ts-vector: not a valid indexed blob");
+        memory_streambuf mb(data + o0, size_t(o1 - o0));
+        std::istream in(&mb);
+        core_iarchive ia(in, core_arch_flags);
+        shyft::time_series::dd::apoint_ts ats;
+        ia >> core_nvp("ats", ats);
+        return ats;
+    }
+}
+
+std::vector<char> shyft::time_series::dd::ats_vector::serialize_indexed(size_t max_threads) const {
+    const size_t n = size();
+    std::vector<std::string> blobs(n);
+    executor::instance()->parallel_for(n, 0, [this, &blobs](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i)
+            blobs[i] = (*this)[i].serialize();
+    }, max_threads);
+    const size_t data = indexed_header + (n + 1)*sizeof(uint64_t);
+    uint64_t o = 0;
+    for (const auto& x : blobs) o += x.size();
+    std::vector<char> r(data + size_t(o));
+    auto put = [&r](size_t at, uint64_t v) { std::memcpy(r.data() + at, &v, sizeof(v)); };
+    put(0, indexed_magic);
+    put(sizeof(uint64_t), n);
+    o = 0;
+    for (size_t i = 0; i < n; ++i) {
+        put(indexed_header + i*sizeof(uint64_t), o);
+        std::memcpy(r.data() + data + o, blobs[i].data(), blobs[i].size());
+        o += blobs[i].size();
+    }
+    put(data - sizeof(uint64_t), o);
+    return r;
+}
+
+shyft::time_series::dd::ats_vector shyft::time_series::dd::ats_vector::deserialize_indexed(const std::vector<char>& blob, size_t max_threads) {
+    const size_t n = indexed_count(blob);
+    ats_vector r(n);
+    executor::instance()->parallel_for(n, 0, [&blob, &r, n](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i)
+            r[i] = indexed_at(blob, n, i);
+    }, max_threads);
+    return r;
+}
+
+size_t shyft::time_series::dd::ats_vector::indexed_size(const std::vector<char>& blob) {
+    return indexed_count(blob);
+}
+
+shyft::time_series::dd::apoint_ts shyft::time_series::dd::ats_vector::deserialize_indexed_at(const std::vector<char>& blob, size_t i) {
+    const size_t n = indexed_count(blob);
+    if (i >= n)
+        throw std::runtime_error("ts-vector: index " + std::to_string(i) + " out of range of the indexed blob of " + std::to_string(n));
+    return indexed_at(blob, n, i);
+}
@@ -6,7 +6,9 @@
 #include <cmath>
 #include <limits>
 #include <future>
+#include <thread>
 #include <utility>
+#include <stdexcept>
 
 
 #include "utctime_utilities.h"
@@ -108,54 +110,109 @@ namespace shyft {
         };
         /// http://en.wikipedia.org/wiki/Percentile NIST definitions, we use R7, as R and excel
         /// http://www.itl.nist.gov/div898/handbook/prc/section2/prc262.htm
-        /// calculate percentile using full sort.. works nice for a larger set of percentiles.
-        inline vector<double> calculate_percentiles_excel_method_full_sort(vector<double>& samples, const vector<int>& percentiles) {
+        /// the percentiles of n_samples ordered samples, where at(k) gives the k'th smallest, and avg() the mean value
+        template <class At, class Avg>
+        inline vector<double> calculate_percentiles_excel_method(int n_samples, const vector<int>& percentiles, At&& at, Avg&& avg) {
             vector<double> result; result.reserve(percentiles.size());
-            const int n_samples = (int)samples.size();
             const double silent_nan = std::numeric_limits<double>::quiet_NaN();
             if (n_samples == 0) {
                 for (size_t i = 0; i < percentiles.size(); ++i)
                     result.emplace_back(silent_nan);
-            } else {
-                //TODO: filter out Nans
-                sort(begin(samples), end(samples));
-                for (auto i : percentiles) {
-                    // use NIST definition for percentile
-                    if (i == statistics_property::AVERAGE ) { // hack: -1,  aka. the mean value..
-                        double sum = 0; int n = 0;
-                        for (auto x : samples) {
-                            if (std::isfinite(x)) { sum += x; ++n; }
-                        }
-                        result.emplace_back(n > 0 ? sum / n : silent_nan);
-                    } else if (i >= 0 && i <= 100) {
-                        const double eps = 1e-30;
-                        // use Hyndman and fam R7 definition, excel, R, and python
-                        double nd = 1.0 + (n_samples - 1)*double(i) / 100.0;
-                        int  n = int(nd);
-                        double delta = nd - n;
-                        --n;//0 based index
-                        if (n <= 0 && delta <= eps) result.emplace_back(samples.front());
-                        else if (n >= n_samples) result.emplace_back(samples.back());
-                        else {
-
-                            if (delta < eps) { //direct hit on the index, use just one.
-                                result.emplace_back(samples[n]);
-                            } else { // in-between two samples, use positional weight
-                                auto lower = samples[n];
-                                if (n < n_samples - 1)
-                                    n++;
-                                auto upper = samples[n];
-                                result.emplace_back(lower + (delta)*(upper - lower));
-                            }
+                return result;
+            }
+            for (auto i : percentiles) {
+                // use NIST definition for percentile
+                if (i == statistics_property::AVERAGE ) { // hack: -1,  aka. the mean value..
+                    result.emplace_back(avg());
+                } else if (i >= 0 && i <= 100) {
+                    const double eps = 1e-30;
+                    // use Hyndman and fam R7 definition, excel, R, and python
+                    double nd = 1.0 + (n_samples - 1)*double(i) / 100.0;
+                    int  n = int(nd);
+                    double delta = nd - n;
+                    --n;//0 based index
+                    if (n <= 0 && delta <= eps) result.emplace_back(at(0));
+                    else if (n >= n_samples) result.emplace_back(at(n_samples - 1));
+                    else {
+
+                        if (delta < eps) { //direct hit on the index, use just one.
+                            result.emplace_back(at(n));
+                        } else { // in-between two samples, use positional weight
+                            auto lower = at(n);
+                            if (n < n_samples - 1)
+                                n++;
+                            auto upper = at(n);
+                            result.emplace_back(lower + (delta)*(upper - lower));
                         }
-                    } else {
-                        result.emplace_back(silent_nan);//some other statistics property we don't compute here
                     }
+                } else {
+                    result.emplace_back(silent_nan);//some other statistics property we don't compute here
                 }
             }
             return result;
         }
 
+        /// mean of the finite samples, or nan
+        inline double finite_mean(const vector<double>& samples) {
+            double sum = 0; int n = 0;
+            for (auto x : samples) {
+                if (std::isfinite(x)) { sum += x; ++n; }
+            }
+            return n > 0 ? sum / n : std::numeric_limits<double>::quiet_NaN();
+        }
+
+        /// calculate percentile using full sort.. works nice for a larger set of percentiles.
+        inline vector<double> calculate_percentiles_excel_method_full_sort(vector<double>& samples, const vector<int>& percentiles) {
+            //TODO: filter out Nans
+            sort(begin(samples), end(samples));
+            return calculate_percentiles_excel_method((int)samples.size(), percentiles,
+                [&samples](int k) { return samples[k]; }, [&samples]() { return finite_mean(samples); });
+        }
+
+        /** calculate percentile using selection, nth_element, of only the ranks needed by the percentiles
+         *
+         * Gives the same result as calculate_percentiles_excel_method_full_sort, at O(n) instead of O(n log n)
+         * for the usual few percentiles, the samples are partially reordered.
+         */
+        inline vector<double> calculate_percentiles_excel_method_select(vector<double>& samples, const vector<int>& percentiles) {
+            const int n_samples = (int)samples.size();
+            const double mean = finite_mean(samples);// summed in sample order, so it can differ in the last bits from the full sort
+            vector<int> ranks;
+            calculate_percentiles_excel_method(n_samples, percentiles, [&ranks](int k) { ranks.push_back(k); return 0.0; }, []() { return 0.0; });
+            sort(begin(ranks), end(ranks));
+            ranks.erase(unique(begin(ranks), end(ranks)), end(ranks));
+            auto lo = begin(samples);
+            for (auto k : ranks) { // each nth_element leaves the larger ones after k, so the next search is to the right
+                nth_element(lo, begin(samples) + k, end(samples));
+                lo = begin(samples) + k + 1;
+            }
+            return calculate_percentiles_excel_method(n_samples, percentiles,
+                [&samples](int k) { return samples[k]; }, [mean]() { return mean; });
+        }
+
+        /** \brief the percentiles of the columns [0..n) of the member x time-step matrix m, with rows of s values, set at the time-steps i0.. of result
+         *
+         * The MIN_EXTREME and MAX_EXTREME results are left as they are, ref. calculate_percentiles.
+         */
+        template <class ta_t>
+        inline void column_percentiles(const double* m, size_t n_members, size_t s, size_t i0, size_t n, const std::vector<int>& percentiles, bool skip_nans,
+                                       std::vector<point_ts<ta_t>>& result) {
+            std::vector<double> samples;samples.reserve(n_members);
+            for (size_t k = 0; k < n; ++k) {//each time step t in the partition of the time-axis
+                samples.clear();
+                for (size_t i = 0; i < n_members; ++i) { // get samples from all the members
+                    auto v = m[i*s + k];
+                    if(!skip_nans || isfinite(v))
+                        samples.emplace_back(v);
+                }
+                std::vector<double> percentiles_at_t(calculate_percentiles_excel_method_select(samples, percentiles));
+                for (size_t p = 0; p < result.size(); ++p) {
+                    if(!(percentiles[p]==statistics_property::MAX_EXTREME || percentiles[p]==statistics_property::MIN_EXTREME))
+                        result[p].set(i0 + k, percentiles_at_t[p]);
+                }
+            }
+        }
+
         /** \brief calculate specified percentiles for supplied list of time-series over the specified time-axis
 
         Percentiles for a set of timeseries, over a time-axis
@@ -175,6 +232,7 @@ namespace shyft {
             percentiles_timeseries[timestep_i]= calculate_percentiles(..)
 
 
+        \param min_t_steps the minimum number of time-steps in each parallel partition of the time-axis
         \return percentiles_timeseries
 
         */
@@ -186,27 +244,15 @@ namespace shyft {
                 result.emplace_back(ta, 0.0, fx_p);
 
             auto partition_calc = [&result, &ts_list, &ta, &percentiles,skip_nans](size_t i0, size_t n) {
-
-                std::vector < average_accessor<ts_t, ta_t>> tsa_list; tsa_list.reserve(ts_list.size());
-                for (const auto& ts : ts_list) // initialize the ts accessors to we can accumulate to time-axis ta e.g.(hour->day)
-                    tsa_list.emplace_back(ts, ta);
-
-                std::vector<double> samples;samples.reserve(tsa_list.size());
-
-                for (size_t t = i0; t < i0 + n; ++t) {//each time step t in the time-axis, here we could do parallel partition
-                    samples.clear();
-                    for (size_t i = 0; i < tsa_list.size(); ++i) { // get samples from all the "tsa"
-                        auto v=tsa_list[i].value(t);
-                        if(!skip_nans || isfinite(v))
-                            samples.emplace_back(v);
-                    }
-                    // possible with pipe-line to percentile calc here !
-                    std::vector<double> percentiles_at_t(calculate_percentiles_excel_method_full_sort(samples, percentiles));
-                    for (size_t p = 0; p < result.size(); ++p) {
-                        if(!(percentiles[p]==statistics_property::MAX_EXTREME || percentiles[p]==statistics_property::MIN_EXTREME))
-                            result[p].set(t, percentiles_at_t[p]);
-                    }
+                // pre-sample a member x timestep matrix, one accessor at the time, so each accessor is used sequentially
+                std::vector<double> m(ts_list.size()*n);
+                for (size_t i = 0; i < ts_list.size(); ++i) { // accumulate to time-axis ta e.g.(hour->day)
+                    average_accessor<ts_t, ta_t> tsa(ts_list[i], ta);
+                    double* mi = m.data() + i*n;
+                    for (size_t k = 0; k < n; ++k)
+                        mi[k] = tsa.value(i0 + k);
                 }
+                column_percentiles(m.data(), ts_list.size(), n, i0, n, percentiles, skip_nans, result);
             };
             auto extreme_calc = [&result, &ts_list, &ta, &percentiles](size_t x) {
                 result[x].v = extract_statistic_from_vector(ts_list, ta, percentiles[x] == statistics_property::MIN_EXTREME?nan_min:nan_max);
@@ -224,8 +270,11 @@ namespace shyft {
                 }
             } else {
                 vector<future<void>> calcs;
+                // at least min_t_steps in each partition, and not more partitions than cores
+                const size_t n_cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+                const size_t block_size = std::max(min_t_steps, (ta.size() + n_cores - 1)/n_cores);
                 for (size_t p = 0;p < ta.size(); ) {
-                    size_t np = p + min_t_steps <= ta.size() ? min_t_steps : ta.size() - p;
+                    size_t np = p + block_size <= ta.size() ? block_size : ta.size() - p;
                     calcs.push_back(std::async(std::launch::async, partition_calc, p, np));
                     p += np;
                 }
@@ -241,5 +290,283 @@ namespace shyft {
 
             return result;
         }
+
+        /** \brief calculate the percentiles over ta of members already averaged to ta, the rows of the member x time-step matrix m
+         *
+         * As calculate_percentiles, for members evaluated directly into m, like by dd::percentiles,
+         * so that they are not kept as time-series too. The time-axis is partitioned over the cores in the same way.
+         * The MIN_EXTREME and MAX_EXTREME results are filled with 0.0, the extremes of the points are not in m,
+         * so the caller sets them.
+         * \param m n_members rows of ta.size() values
+         */
+        template <class ta_t>
+        inline std::vector< point_ts<ta_t> > calculate_percentiles_of_matrix(const ta_t& ta, const std::vector<double>& m, size_t n_members, const std::vector<int>& percentiles,
+                                                                            ts_point_fx fx_p = POINT_AVERAGE_VALUE, size_t min_t_steps = 1000, bool skip_nans = true) {
+            if (m.size() != n_members*ta.size())
+                throw runtime_error("calculate_percentiles_of_matrix: the matrix must have n_members rows of ta.size() values");
+            std::vector<point_ts<ta_t>> result;
+            for (size_t r = 0; r < percentiles.size(); ++r)
+                result.emplace_back(ta, 0.0, fx_p);
+            auto partition_calc = [&result, &m, n_members, &ta, &percentiles, skip_nans](size_t i0, size_t n) {
+                column_percentiles(m.data() + i0, n_members, ta.size(), i0, n, percentiles, skip_nans, result);
+            };
+            if (ta.size() < min_t_steps) {
+                partition_calc(0, ta.size());
+            } else {
+                vector<future<void>> calcs;
+                const size_t n_cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+                const size_t block_size = std::max(min_t_steps, (ta.size() + n_cores - 1)/n_cores);
+                for (size_t p = 0;p < ta.size(); ) {
+                    size_t np = p + block_size <= ta.size() ? block_size : ta.size() - p;
+                    calcs.push_back(std::async(std::launch::async, partition_calc, p, np));
+                    p += np;
+                }
+                for (auto &f : calcs)
+                    f.get();
+            }
+            return result;
+        }
+
+        /** \brief reduce-style statistics across a list of time-series, per time-step, ref. calculate_aggregates */
+        enum aggregate_property {
+            SUM=0,///< sum of the finite values
+            MEAN=1,///< mean of the finite values
+            MINIMUM=2,///< min of the finite values
+            MAXIMUM=3,///< max of the finite values
+            WEIGHTED_SUM=4,///< sum of weight*value of the finite values, e.g. area-weighted
+            WEIGHTED_MEAN=5,///< WEIGHTED_SUM divided by the sum of the weights of the finite values
+            HISTOGRAM=6///< number of finite values in each bin [bins[j],bins[j+1]), one series for each bin
+        };
+
+        /** \brief calculate aggregates of the ts_list on the time-axis ta
+         *
+         * Each member is averaged over each time-step of ta, as for calculate_percentiles, and the aggregates are
+         * accumulated one member at the time, so the memory needed is that of the result.
+         *
+         * \param aggregates list of aggregate_property
+         * \param weights one for each member of ts_list, used by WEIGHTED_SUM and WEIGHTED_MEAN
+         * \param bins the ascending edges of the bins, used by HISTOGRAM
+         * \return one series for each of the aggregates, but bins.size()-1 series for HISTOGRAM, nan where there are no finite values
+         */
+        template <class ts_t, class ta_t>
+        inline std::vector< point_ts<ta_t> > calculate_aggregates(const ta_t& ta, const std::vector<ts_t>& ts_list, const std::vector<int>& aggregates,
+                                                                 const std::vector<double>& weights, const std::vector<double>& bins) {
+            bool weighted = false, histogram = false;
+            for (auto a : aggregates) {
+                if (a < SUM || a > HISTOGRAM)
+                    throw runtime_error("calculate_aggregates: unknown aggregate " + std::to_string(a));
+                weighted = weighted || a == WEIGHTED_SUM || a == WEIGHTED_MEAN;
+                histogram = histogram || a == HISTOGRAM;
+            }
+            if (weighted && weights.size() != ts_list.size())
+                throw runtime_error("calculate_aggregates: weighted aggregates requires one weight for each time-series");
+            if (histogram && (bins.size() < 2 || !std::is_sorted(bins.begin(), bins.end())))
+                throw runtime_error("calculate_aggregates: histogram requires at least two ascending bin edges");
+            const double silent_nan = std::numeric_limits<double>::quiet_NaN();
+            const size_t n = ta.size();
+            const size_t n_bins = histogram ? bins.size() - 1 : 0;
+            std::vector<size_t> count(n, 0);
+            std::vector<double> sum(n, 0.0), min_v(n, silent_nan), max_v(n, silent_nan);
+            std::vector<double> w_sum(weighted ? n : 0, 0.0), w_total(weighted ? n : 0, 0.0);
+            std::vector<std::vector<double>> hist(n_bins, std::vector<double>(n, 0.0));
+            for (size_t i = 0; i < ts_list.size(); ++i) {
+                average_accessor<ts_t, ta_t> tsa(ts_list[i], ta);
+                for (size_t k = 0; k < n; ++k) {
+                    const double v = tsa.value(k);
+                    if (!isfinite(v))
+                        continue;
+                    ++count[k];
+                    sum[k] += v;
+                    min_v[k] = nan_min(min_v[k], v);
+                    max_v[k] = nan_max(max_v[k], v);
+                    if (weighted) {
+                        w_sum[k] += weights[i]*v;
+                        w_total[k] += weights[i];
+                    }
+                    if (histogram && v >= bins.front() && v < bins.back())
+                        hist[size_t(std::upper_bound(bins.begin(), bins.end(), v) - bins.begin()) - 1][k] += 1.0;
+                }
+            }
+            std::vector<point_ts<ta_t>> result;
+            auto add = [&result, &ta, &count, silent_nan](auto&& fx) {
+                result.emplace_back(ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
+                for (size_t k = 0; k < count.size(); ++k)
+                    result.back().set(k, count[k] ? fx(k) : silent_nan);
+            };
+            for (auto a : aggregates) {
+                switch (a) {
+                case SUM: add([&sum](size_t k) { return sum[k]; }); break;
+                case MEAN: add([&sum, &count](size_t k) { return sum[k]/double(count[k]); }); break;
+                case MINIMUM: add([&min_v](size_t k) { return min_v[k]; }); break;
+                case MAXIMUM: add([&max_v](size_t k) { return max_v[k]; }); break;
+                case WEIGHTED_SUM: add([&w_sum](size_t k) { return w_sum[k]; }); break;
+                case WEIGHTED_MEAN: add([&w_sum, &w_total, silent_nan](size_t k) { return w_total[k] != 0.0 ? w_sum[k]/w_total[k] : silent_nan; }); break;
+                case HISTOGRAM:
+                    for (size_t j = 0; j < n_bins; ++j)
+                        result.emplace_back(ta, hist[j], ts_point_fx::POINT_AVERAGE_VALUE);// a count, also where it is 0
+                    break;
+                }
+            }
+            return result;
+        }
+
+        /** \brief running min/max/mean/variance, Welford's algorithm, nan values are ignored */
+        struct running_statistics {
+            size_t n = 0;
+            double min_v = std::numeric_limits<double>::quiet_NaN();
+            double max_v = std::numeric_limits<double>::quiet_NaN();
+            double mean_v = 0.0;
+            double m2 = 0.0;///< sum of squares of differences from the current mean
+            void add(double x) {
+                if (!std::isfinite(x)) return;
+                if (n++ == 0) {
+                    min_v = max_v = mean_v = x;
+                    m2 = 0.0;
+                    return;
+                }
+                min_v = std::min(min_v, x);
+                max_v = std::max(max_v, x);
+                const double d = x - mean_v;
+                mean_v += d/double(n);
+                m2 += d*(x - mean_v);
+            }
+            double mean() const { return n ? mean_v : std::numeric_limits<double>::quiet_NaN(); }
+            /** \return the sample variance, nan if less than two values */
+            double variance() const { return n > 1 ? m2/double(n - 1) : std::numeric_limits<double>::quiet_NaN(); }
+        };
+
+        /** \brief constant memory quantile estimate, the P-square algorithm of Jain and Chlamtac(1985)
+         *
+         * Keeps five markers, the middle one is the estimate of the p-quantile.
+         * Until five values are seen, the quantile is computed from the values, using the R7 definition,
+         * as calculate_percentiles.
+         */
+        struct p2_quantile {
+            double p = 0.5;
+            size_t count = 0;
+            double q[5] = {0, 0, 0, 0, 0};///< marker heights
+            double np[5] = {0, 0, 0, 0, 0};///< desired marker positions
+            double ni[5] = {0, 1, 2, 3, 4};///< actual marker positions
+            p2_quantile() : p2_quantile(0.5) {}
+            explicit p2_quantile(double p) : p(p), np{0, 2*p, 4*p, 2 + 2*p, 4} {}
+
+            void add(double x) {
+                if (!std::isfinite(x)) return;
+                if (count < 5) {
+                    q[count++] = x;
+                    std::sort(q, q + count);
+                    return;
+                }
+                ++count;
+                int k;
+                if (x < q[0]) { q[0] = x; k = 0; }
+                else if (x >= q[4]) { q[4] = x; k = 3; }
+                else { k = 0; while (x >= q[k + 1]) ++k; }
+                const double dn[5] = {0, p/2, p, (1 + p)/2, 1};
+                for (int i = k + 1; i < 5; ++i) ni[i] += 1;
+                for (int i = 0; i < 5; ++i) np[i] += dn[i];
+                for (int i = 1; i < 4; ++i) {
+                    double d = np[i] - ni[i];
+                    if ((d >= 1 && ni[i + 1] - ni[i] > 1) || (d <= -1 && ni[i - 1] - ni[i] < -1)) {
+                        const int s = d > 0 ? 1 : -1;
+                        const double qp = q[i] + s/(ni[i + 1] - ni[i - 1])*((ni[i] - ni[i - 1] + s)*(q[i + 1] - q[i])/(ni[i + 1] - ni[i])
+                                                                          + (ni[i + 1] - ni[i] - s)*(q[i] - q[i - 1])/(ni[i] - ni[i - 1]));
+                        if (q[i - 1] < qp && qp < q[i + 1])
+                            q[i] = qp; // parabolic
+                        else
+                            q[i] = q[i] + s*(q[i + s] - q[i])/(ni[i + s] - ni[i]); // linear
+                        ni[i] += s;
+                    }
+                }
+            }
+            double value() const {
+                if (count == 0) return std::numeric_limits<double>::quiet_NaN();
+                if (count >= 5) return q[2];
+                const double nd = 1.0 + (count - 1)*p;// R7, on the sorted few values
+                const size_t n = size_t(nd) - 1;
+                return n + 1 < count ? q[n] + (nd - (n + 1))*(q[n + 1] - q[n]) : q[count - 1];
+            }
+        };
+
+        /** \brief the statistics of one interval, as emitted by streaming_statistics */
+        struct interval_statistics {
+            size_t n = 0;///< number of finite values
+            double min_v = std::numeric_limits<double>::quiet_NaN();
+            double max_v = std::numeric_limits<double>::quiet_NaN();
+            double mean = std::numeric_limits<double>::quiet_NaN();
+            double variance = std::numeric_limits<double>::quiet_NaN();
+            vector<double> quantiles;///< estimates, one for each of the requested quantiles
+        };
+
+        /** \brief streaming statistics of a ts over the intervals of a time-axis
+         *
+         * The source ts, a point ts or an expression, is evaluated in chunks of chunk_size values, by values_of,
+         * and each value updates the running statistics of the interval that contains its time-point
+         * (the same selection of values as extract_statistics).
+         * The result of each interval of ta is emitted, in order, as soon as the source passes it,
+         * so neither the source values nor the results are kept in memory, only one chunk.
+         * Quantiles are estimated by p2_quantile, min/max/mean/variance are exact.
+         *
+         * \tparam Ts a ts type, with .size(), .time_axis(), and .value(i) or .values(i0,n,r), also apoint_ts
+         * \tparam Ta time-axis type, with .size(), .period(i), .index_of(t)
+         * \tparam Fx callable as emit(size_t i,const interval_statistics& s), called once for each interval of ta
+         * \param quantiles in range [0..1], e.g. {0.1,0.5,0.9}
+         * \param chunk_size number of source values evaluated in each chunk
+         */
+        template <class Ts, class Ta, class Fx>
+        void streaming_statistics(const Ts& ts, const Ta& ta, const vector<double>& quantiles, Fx&& emit, size_t chunk_size = 8192) {
+            if (chunk_size == 0)
+                throw runtime_error("streaming_statistics: chunk_size must be > 0");
+            running_statistics rs;
+            vector<p2_quantile> qs;
+            size_t i_current = 0;// the interval that we accumulate into
+            auto reset = [&]() {
+                rs = running_statistics();
+                qs.clear();
+                for (auto p : quantiles) qs.emplace_back(p);
+            };
+            auto flush_until = [&](size_t i_end) {// emit intervals [i_current..i_end>
+                for (; i_current < i_end; ++i_current) {
+                    interval_statistics s;
+                    s.n = rs.n;
+                    s.min_v = rs.min_v;
+                    s.max_v = rs.max_v;
+                    s.mean = rs.mean();
+                    s.variance = rs.variance();
+                    for (const auto& q : qs) s.quantiles.push_back(q.value());
+                    emit(i_current, s);
+                    reset();
+                }
+            };
+            reset();
+            const size_t n_ts = ts.size();
+            if (ta.size() == 0)
+                return;
+            const auto& src_ta = ts.time_axis();
+            const utcperiod tp = ta.total_period();
+            vector<double> chunk(std::min(chunk_size, std::max<size_t>(n_ts, 1)));
+            for (size_t j0 = 0; j0 < n_ts; j0 += chunk.size()) {
+                const size_t n = std::min(chunk.size(), n_ts - j0);
+                values_of(ts, j0, n, chunk.data());
+                for (size_t k = 0; k < n; ++k) {
+                    const utctime t = src_ta.time(j0 + k);
+                    if (t < tp.start)
+                        continue;
+                    if (t >= tp.end) {
+                        flush_until(ta.size());
+                        return;
+                    }
+                    if (!ta.period(i_current).contains(t)) {
+                        const size_t i = ta.index_of(t);
+                        if (i == string::npos)
+                            continue;// in a gap of the time-axis
+                        flush_until(i);
+                    }
+                    rs.add(chunk[k]);
+                    for (auto& q : qs) q.add(chunk[k]);
+                }
+            }
+            flush_until(ta.size());
+        }
     }
 }
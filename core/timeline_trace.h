@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <ostream>
+
+namespace shyft {
+    namespace core {
+        /** \brief opt-in timeline tracing of the phases of a run, dumped as chrome trace json
+         *
+         * The traced phases, like the interpolation tasks, the cell batches of parallel_run, the routing,
+         * and the goal function evaluations of the calibration, are marked by a trace::scope.
+         * When the tracer is stopped, the default, a scope costs a relaxed atomic load.
+         * When started, each thread records its events into its own ring, keeping the latest capacity events,
+         * so the threads do not contend, and a long run keeps the end of the timeline.
+         * The json of chrome_json can be loaded in chrome://tracing or https://ui.perfetto.dev
+         */
+        namespace trace {
+            using std::size_t;
+            using std::int64_t;
+
+            /** \brief one completed phase on a thread, the cell, or index, range [i0..i1) if it has one, otherwise i0=i1=-1 */
+            struct event {
+                const char* name{ nullptr };///< a string literal, ref. scope
+                int64_t t0{ 0 };///< start, ns since the tracer was started
+                int64_t t1{ 0 };///< end, ns since the tracer was started
+                int64_t i0{ -1 };
+                int64_t i1{ -1 };
+            };
+
+            /** \brief the events of one thread, the latest capacity of them */
+            struct ring {
+                explicit ring(size_t tid) :tid(tid) {}
+                const size_t tid;///< the trace thread id, in order of the first event of the thread
+                std::mutex mx;///< only contended by the reader of the tracer
+                std::vector<event> ev;
+                size_t next{ 0 };///< the slot of the next event
+                size_t n{ 0 };///< events recorded since clear, n - ev.size() is the dropped ones
+            };
+
+            /** \brief the process-wide tracer, ref. scope */
+            class tracer {
+                std::atomic<bool> on{ false };
+                std::atomic<size_t> cap{ 0 };
+                std::atomic<int64_t> origin{ clock_ns() };///< steady_clock ns at start
+                mutable std::mutex mx;///< protects rings
+                std::vector<std::shared_ptr<ring>> rings;
+                size_t n_threads{ 0 };///< threads that have recorded, protected by mx
+
+                /** the ring of the calling thread, registered with the first event of the thread */
+                ring& thread_ring() {
+                    thread_local std::shared_ptr<ring> r;
+                    if (!r) {
+                        std::lock_guard<std::mutex> guard(mx);
+                        r = std::make_shared<ring>(n_threads++);
+                        rings.push_back(r);
+                    }
+                    return *r;
+                }
+
+              public:
+                static constexpr size_t default_capacity = 1 << 16;///< events kept per thread
+
+                static tracer& instance() {
+                    static tracer t;
+                    return t;
+                }
+
+                bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+                /** clear the events, and start recording at most capacity events per thread */
+                void start(size_t capacity = default_capacity) {
+                    if (capacity == 0)
+                        throw std::runtime_error("trace::tracer::start: capacity must be > 0");
+                    on = false;
+                    clear();
+                    cap = capacity;
+                    origin = clock_ns();
+                    on = true;
+                }
+
+                /** stop recording, the events are kept until the next start or clear */
+                void stop() { on = false; }
+
+                /** remove the events, and the rings of the threads that are gone */
+                void clear() {
+                    std::lock_guard<std::mutex> guard(mx);
+                    std::vector<std::shared_ptr<ring>> alive;
+                    for (auto& r : rings) {
+                        std::lock_guard<std::mutex> rg(r->mx);
+                        r->ev.clear();
+                        r->next = r->n = 0;
+                        if (r.use_count() > 1)
+                            alive.push_back(r);
+                    }
+                    rings.swap(alive);
+                }
+
+                /** \return ns since start */
+                int64_t now() const { return clock_ns() - origin.load(std::memory_order_relaxed); }
+
+                void record(const char* name, int64_t t0, int64_t t1, int64_t i0, int64_t i1) {
+                    if (!enabled())
+                        return;
+                    auto& r = thread_ring();
+                    std::lock_guard<std::mutex> guard(r.mx);
+                    const size_t c = cap.load(std::memory_order_relaxed);
+                    if (r.ev.size() != c) {
+                        r.ev.assign(c, event{});
+                        r.next = r.n = 0;
+                    }
+                    r.ev[r.next] = event{ name, t0, t1, i0, i1 };
+                    r.next = (r.next + 1) % c;
+                    ++r.n;
+                }
+
+                /** \return the events kept, and the number dropped as the rings wrapped around */
+                std::pair<size_t, size_t> size() const {
+                    std::lock_guard<std::mutex> guard(mx);
+                    size_t kept = 0, dropped = 0;
+                    for (auto& r : rings) {
+                        std::lock_guard<std::mutex> rg(r->mx);
+                        const size_t k = std::min(r->n, r->ev.size());
+                        kept += k;
+                        dropped += r->n - k;
+                    }
+                    return std::make_pair(kept, dropped);
+                }
+
+                /** write the events as chrome trace json, complete events with ts and dur in us, and the range as args */
+                void write_chrome_json(std::ostream& os) const {
+                    std::lock_guard<std::mutex> guard(mx);
+                    os << "{\"traceEvents\":[";
+                    bool first = true;
+                    auto sep = [&os, &first]() { if (!first) os << ",\n"; first = false; };
+                    for (auto& r : rings) {
+                        std::lock_guard<std::mutex> rg(r->mx);
+                        const size_t k = std::min(r->n, r->ev.size());
+                        if (k == 0)
+                            continue;
+                        sep();
+                        os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->tid
+                           << ",\"args\":{\"name\":\"thread " << r->tid << "\"}}";
+                        const size_t b = (r->next + r->ev.size() - k) % r->ev.size();// the oldest kept
+                        for (size_t j = 0; j < k; ++j) {
+                            const auto& e = r->ev[(b + j) % r->ev.size()];
+                            sep();
+                            os << "{\"name\":\"" << e.name << "\",\"cat\":\"shyft\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->tid
+                               << ",\"ts\":" << e.t0/1000 << '.' << digits3(e.t0%1000)
+                               << ",\"dur\":" << (e.t1 - e.t0)/1000 << '.' << digits3((e.t1 - e.t0)%1000);
+                            if (e.i0 >= 0)
+                                os << ",\"args\":{\"i0\":" << e.i0 << ",\"i1\":" << e.i1 << "}";
+                            os << "}";
+                        }
+                    }
+                    os << "]}\n";
+                }
+
+                std::string chrome_json() const {
+                    std::ostringstream os;
+                    write_chrome_json(os);
+                    return os.str();
+                }
+
+                /** write chrome_json to file_path */
+                void save(const std::string& file_path) const {
+                    std::ofstream f(file_path, std::ios::binary | std::ios::trunc);
+                    if (!f)
+                        throw std::runtime_error("trace::tracer::save: can not open " + file_path);
+                    write_chrome_json(f);
+                }
+
+              private:
+                static int64_t clock_ns() {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+                static std::string digits3(int64_t v) {
+                    std::string s = std::to_string(v);
+                    return std::string(3 - std::min<size_t>(3, s.size()), '0') + s;
+                }
+            };
+
+            /** \brief marks a phase, from construction to destruction, on the calling thread
+             * \param name a string literal, or other string that outlives the trace
+             * \param i0 the start of the cell, or index, range of the phase, if any
+             * \param i1 the end of the range
+             */
+            struct scope {
+                explicit scope(const char* name, int64_t i0 = -1, int64_t i1 = -1) :name(name), i0(i0), i1(i1) {
+                    if (tracer::instance().enabled())
+                        t0 = tracer::instance().now();
+                }
+                ~scope() {
+                    if (t0 >= 0)
+                        tracer::instance().record(name, t0, tracer::instance().now(), i0, i1);
+                }
+                scope(const scope&) = delete;
+                scope& operator=(const scope&) = delete;
+              private:
+                const char* name;
+                int64_t i0, i1;
+                int64_t t0{ -1 };
+            };
+        }
+    }
+}
@@ -78,19 +78,57 @@ namespace shyft {
             return 7 * (jdn / 7);// jd starts on monday.
         }
 
-        utctime calendar::time(YMDhms c) const {
+        namespace {
+            /** utc-offset of the tz_info, one lookup for each t */
+            struct utc_offset_fx {
+                const time_zone::tz_info_t& tz;
+                explicit utc_offset_fx(const time_zone::tz_info_t& tz):tz(tz) {}
+                utctimespan operator()(utctime t) const {return tz.utc_offset(t);}
+            };
+
+            /** utc-offset of the tz_info, reusing the offset while t stays within the same dst period
+             * used by the batch functions, where t typically is ordered.
+             */
+            struct utc_offset_cursor {
+                const time_zone::tz_info_t& tz;
+                utcperiod p;///< the period where dt is valid
+                utctimespan dt=0;
+                explicit utc_offset_cursor(const time_zone::tz_info_t& tz):tz(tz) {}
+                utctimespan operator()(utctime t) {
+                    if(!p.contains(t))
+                        dt=tz.utc_offset(t,p);
+                    return dt;
+                }
+            };
+        }
+
+        template <class O>
+        static utctime time_of(const YMDhms& c, O& utc_offset) {
             if(c.is_null()) return no_utctime;
             if(c==YMDhms::max()) return max_utctime;
             if(c==YMDhms::min()) return min_utctime;
             if (!c.is_valid_coordinates())
                 throw std::runtime_error("calendar.time with invalid YMDhms coordinates attempted");
 
-            utctime r= ((int(day_number(c)) - UnixDay)*DAY) + seconds(c.hour, c.minute, c.second);
-            auto utc_diff_1= tz_info->utc_offset(r);// detect if we are in the dst-shift hour
-            auto utc_diff_2= tz_info->utc_offset(r-utc_diff_1);
+            utctime r= ((int(calendar::day_number(c)) - calendar::UnixDay)*calendar::DAY) + calendar::seconds(c.hour, c.minute, c.second);
+            auto utc_diff_1= utc_offset(r);// detect if we are in the dst-shift hour
+            auto utc_diff_2= utc_offset(r-utc_diff_1);
             return (utc_diff_1==utc_diff_2)?r-utc_diff_1: r-utc_diff_2;
         }
 
+        utctime calendar::time(YMDhms c) const {
+            utc_offset_fx fx(*tz_info);
+            return time_of(c,fx);
+        }
+
+        vector<utctime> calendar::time(const vector<YMDhms>& c) const {
+            vector<utctime> r;r.reserve(c.size());
+            utc_offset_cursor cursor(*tz_info);
+            for(const auto& x:c)
+                r.push_back(time_of(x,cursor));
+            return r;
+        }
+
         utctime calendar::time_from_week(int Y, int W, int wd, int h, int m, int s) const {
             return time(YWdhms(Y, W, wd, h, m, s));
         }
@@ -132,19 +170,46 @@ namespace shyft {
             return r;
         }
 
-        YMDhms  calendar::calendar_units(utctime t) const {
+        template <class O>
+        static YMDhms units_of(utctime t, O& utc_offset) {
             if (t == no_utctime)  return YMDhms();
             if (t == max_utctime) return YMDhms::max();
             if (t == min_utctime) return YMDhms::min();
-            auto tz_dt=tz_info->utc_offset(t);
+            auto tz_dt=utc_offset(t);
             t += tz_dt;
-            auto jdn = day_number(t);
-            auto x = from_day_number(jdn);
+            auto jdn = calendar::day_number(t);
+            auto x = calendar::from_day_number(jdn);
             YMDhms r;
             r.year = x.year; r.month = x.month; r.day = x.day;
             return fill_in_hms_from_t(t, r);
         }
 
+        YMDhms  calendar::calendar_units(utctime t) const {
+            utc_offset_fx fx(*tz_info);
+            return units_of(t,fx);
+        }
+
+        vector<YMDhms> calendar::calendar_units(const vector<utctime>& t) const {
+            vector<YMDhms> r;r.reserve(t.size());
+            utc_offset_cursor cursor(*tz_info);
+            int jdn_x=-1;YMDhms x;// the last day computed, reused while t stays within it
+            for(auto ti:t) {
+                if (ti == no_utctime || ti == max_utctime || ti == min_utctime) {
+                    r.push_back(units_of(ti,cursor));
+                    continue;
+                }
+                ti += cursor(ti);
+                auto jdn = day_number(ti);
+                if(jdn != jdn_x) {
+                    auto d = from_day_number(jdn);
+                    x.year = d.year; x.month = d.month; x.day = d.day;
+                    jdn_x = jdn;
+                }
+                r.push_back(fill_in_hms_from_t(ti, x));
+            }
+            return r;
+        }
+
         YWdhms calendar::calendar_week_units(utctime t) const {
             if (t == no_utctime)  return YWdhms();
             if (t == max_utctime) return YWdhms::max();
@@ -200,65 +265,71 @@ namespace shyft {
             auto cu = calendar_units(t);
             return 1+ mq[cu.month - 1]/3;
         }
-        utctime calendar::trim(utctime t, utctimespan deltaT) const {
+        /** trim, using utc-offset a for t, and b for the result */
+        template <class O>
+        static utctime trim_of(utctime t, utctimespan deltaT, O& a, O& b) {
+            using c_=calendar;
             if (t == no_utctime || t == min_utctime || t == max_utctime || deltaT==utctimespan(0))
                 return t;
             switch (deltaT) {
-            case YEAR: {
-                auto c = calendar_units(t);
+            case c_::YEAR: {
+                auto c = units_of(t,a);
                 c.month = c.day = 1; c.hour = c.minute = c.second = 0;
-                return time(c);
+                return time_of(c,b);
             }break;
-            case QUARTER: {
-                auto c = calendar_units(t);
-                return time(YMDhms(c.year, mq[c.month - 1], 1));
+            case c_::QUARTER: {
+                auto c = units_of(t,a);
+                return time_of(YMDhms(c.year, mq[c.month - 1], 1),b);
             }break;
-            case MONTH: {
-                auto c = calendar_units(t);
+            case c_::MONTH: {
+                auto c = units_of(t,a);
                 c.day = 1; c.hour = c.minute = c.second = 0;
-                return time(c);
+                return time_of(c,b);
             }break;
-            case DAY: {
-                auto c = calendar_units(t);
+            case c_::DAY: {
+                auto c = units_of(t,a);
                 c.hour = c.minute = c.second = 0;
-                return time(c);
+                return time_of(c,b);
             }break;
             }
-            auto tz_offset=tz_info->utc_offset(t);
-            const utctime t0 = utctime(+3LL * DAY) + utctime(WEEK * 52L * 2000LL);// + 3 days to get to a isoweek monday, then add 2000 years to get a positive number
+            auto tz_offset=a(t);
+            const utctime t0 = utctime(+3LL * c_::DAY) + utctime(c_::WEEK * 52L * 2000LL);// + 3 days to get to a isoweek monday, then add 2000 years to get a positive number
             t += t0 + tz_offset;
             t= deltaT*(t / deltaT) - t0 ;
-            return  t - tz_info->utc_offset(t);
+            return  t - b(t);
         }
 
-        utctime calendar::add(utctime t, utctimespan deltaT, long n) const {
+        /** add, using utc-offset a for t, and b for the result */
+        template <class O>
+        static utctime add_of(utctime t, utctimespan deltaT, long n, O& a, O& b) {
+            using c_=calendar;
             auto dt=n*deltaT;
             switch (deltaT) {
-                case YEAR: {
-                    auto c=calendar_units(t);
-                    c.year += int(dt/YEAR);// gives signed number of units.
-                    return time(c);
+                case c_::YEAR: {
+                    auto c=units_of(t,a);
+                    c.year += int(dt/c_::YEAR);// gives signed number of units.
+                    return time_of(c,b);
                 } break;
-                case QUARTER://just let it appear as 3xmonth
-                    deltaT = MONTH;
+                case c_::QUARTER://just let it appear as 3xmonth
+                    deltaT = c_::MONTH;
                     n = 3 * n;
                     // fall through to month
-                case MONTH:{
-                    auto c=calendar_units(t);
+                case c_::MONTH:{
+                    auto c=units_of(t,a);
                     // calculate number of years..
-                    int nyears= int(dt/MONTH/12); // with correct sign
+                    int nyears= int(dt/c_::MONTH/12); // with correct sign
                     c.year +=  nyears; // done with years, now single step remaining months.
                     int nmonths= n-nyears*12;// remaining months to deal with
                     c.month += nmonths;// just add them
                     if(c.month <1) {c.month+=12; c.year--;}// then repair underflow
                     else if(c.month >12 ) {c.month -=12;c.year++;}// or overflow
-                    return time(c);
+                    return time_of(c,b);
                 } break;
                 default: break;
             }
             utctime r = t + dt; //naive first estimate
-            auto utc_diff_1=tz_info->utc_offset(t);
-            auto utc_diff_2=tz_info->utc_offset(r);
+            auto utc_diff_1=a(t);
+            auto utc_diff_2=b(r);
             return r + (utc_diff_1-utc_diff_2);
             // explanation: if t and r are in different dst, compensate for difference
             // e.g.: t+ calendar day, in dst, will be 23, 24 or 25 hours long, this way
@@ -272,6 +343,43 @@ namespace shyft {
             //      ret r +( 1h - 2h), eg. sub one hour, and we get a 23h day.
         };
 
+        utctime calendar::trim(utctime t, utctimespan deltaT) const {
+            utc_offset_fx fx(*tz_info);
+            return trim_of(t,deltaT,fx,fx);
+        }
+
+        vector<utctime> calendar::trim(const vector<utctime>& t, utctimespan deltaT) const {
+            vector<utctime> r;r.reserve(t.size());
+            utc_offset_cursor a(*tz_info),b(*tz_info);
+            const bool calendar_unit = deltaT == DAY || deltaT == MONTH || deltaT == QUARTER || deltaT == YEAR;
+            utcperiod p;// the calendar unit of the last result, any t within it trims to p.start
+            for(auto ti:t) {
+                if(calendar_unit && p.contains(ti)) {
+                    r.push_back(p.start);
+                    continue;
+                }
+                auto x=trim_of(ti,deltaT,a,b);
+                if(calendar_unit && x != no_utctime && x != min_utctime && x != max_utctime)
+                    p=utcperiod(x,add_of(x,deltaT,1,b,b));
+                r.push_back(x);
+            }
+            return r;
+        }
+
+        utctime calendar::add(utctime t, utctimespan deltaT, long n) const {
+            utc_offset_fx fx(*tz_info);
+            return add_of(t,deltaT,n,fx,fx);
+        }
+
+        vector<utctime> calendar::add(const vector<utctime>& t, utctimespan deltaT, long n) const {
+            vector<utctime> r;r.reserve(t.size());
+            utc_offset_cursor a(*tz_info),b(*tz_info);
+            for(auto ti:t)
+                r.push_back(add_of(ti,deltaT,n,a,b));
+            return r;
+        }
+
+
         utctimespan calendar::diff_units(utctime t1, utctime t2, utctimespan deltaT, utctimespan &remainder) const {
             if (t1 == no_utctime || t2 == no_utctime || deltaT == 0L) {
                 remainder = 0L;
@@ -325,6 +433,40 @@ namespace shyft {
             using namespace boost::posix_time;
             using namespace std;
 
+            utctimespan tz_table::dst_offset(utctime t, utcperiod& p) const {
+                if(!is_dst()) {
+                    p=utcperiod(min_utctime,max_utctime);
+                    return utctimespan(0);
+                }
+                auto year_start=[](int y) {return utctime(int(calendar::day_number(YMDhms(y,1,1))) - calendar::UnixDay)*calendar::DAY;};
+                auto year=calendar::utc_year(t);
+                if(year < start_year) {
+                    p=utcperiod(min_utctime,year_start(int(start_year)));
+                    return utctimespan(0);
+                }
+                if(year-start_year >= (int) dst.size()) {
+                    p=utcperiod(year_start(int(start_year+dst.size())),max_utctime);
+                    return utctimespan(0);
+                }
+                auto y0=year_start(year),y1=year_start(year+1);
+                auto s=dst_start(year);
+                auto e=dst_end(year);
+                auto dt_y=dt[year-start_year];
+                utctimespan r;
+                if(s<e) {
+                    if(t<s) {p=utcperiod(y0,s);r=utctimespan(0);}
+                    else if(t<e) {p=utcperiod(s,e);r=dt_y;}
+                    else {p=utcperiod(e,y1);r=utctimespan(0);}
+                } else {
+                    if(t<e) {p=utcperiod(y0,e);r=dt_y;}
+                    else if(t<s) {p=utcperiod(e,s);r=utctimespan(0);}
+                    else {p=utcperiod(s,y1);r=dt_y;}
+                }
+                p.start=std::max(p.start,y0);// dst_offset(t) is by the utc year of t, so the period is within it
+                p.end=std::min(p.end,y1);
+                return r;
+            }
+
             ///< just a local adapter to the tz_table generator
             struct boost_tz_info { // limitation is posix time, def from 1901 and onward
                 ptime posix_t1970;///< epoch reference in ptime, needed to convert to utctime
@@ -64,6 +64,35 @@ namespace shyft {
 
         inline bool is_valid(utctime t) {return t != no_utctime;}
 
+        /** \brief utctime_us, utctime with microsecond resolution
+         *
+         * For sub-second series and event time-stamps, like intraday market data.
+         * It keeps the 64 bit integer layout of utctime, counting microseconds since 1970-01-01,
+         * which covers approx. +-292000 years.
+         * The special values max_utctime, min_utctime and no_utctime are the same in both representations.
+         * Conversion to/from utctime is done at the boundaries, \sa to_utctime_us, from_utctime_us.
+         */
+        typedef int64_t utctime_us;
+        typedef int64_t utctimespan_us;///< timespan in microseconds
+        const int64_t us_per_second = 1000000;
+
+        ///< returns utctimespan_us equal to n milliseconds
+        inline utctimespan_us deltamilliseconds(int64_t n) { return n*1000; }
+
+        /** \brief convert utctime t to utctime_us, throws runtime_error if it is out of the utctime_us range */
+        inline utctime_us to_utctime_us(utctime t) {
+            if (t == no_utctime || t == max_utctime || t == min_utctime) return utctime_us(t);
+            if (t > max_utctime/us_per_second || t < min_utctime/us_per_second)
+                throw std::runtime_error("to_utctime_us: utctime out of range");
+            return utctime_us(t)*us_per_second;
+        }
+
+        /** \brief convert utctime_us t to utctime, rounded down to whole seconds */
+        inline utctime from_utctime_us(utctime_us t) {
+            if (t == utctime_us(no_utctime) || t == utctime_us(max_utctime) || t == utctime_us(min_utctime)) return utctime(t);
+            return utctime(t >= 0 ? t/us_per_second : -((us_per_second - 1 - t)/us_per_second));
+        }
+
         /** \brief utcperiod is defined
          *  as period on the utctime space, like
          * [start..end>, where end >=start to be valid
@@ -149,6 +178,12 @@ namespace shyft {
                 utctime dst_start(int year) const {return is_dst()?dst[year-start_year].start:no_utctime;}
                 utctime dst_end (int year) const {return is_dst()?dst[year-start_year].end:no_utctime;}
                 utctimespan dst_offset(utctime t) const ;
+                /**\brief dst_offset(t), and the period p around t where the dst offset is constant
+                 *
+                 * Lets a sequence of lookups reuse the offset while t stays within p,
+                 * so walking a monotonic sequence of t visits each dst period of the table once.
+                 */
+                utctimespan dst_offset(utctime t, utcperiod& p) const;
                 x_serialize_decl();
             };
 
@@ -164,6 +199,8 @@ namespace shyft {
                 utctimespan base_offset() const {return base_tz;}
                 utctimespan utc_offset(utctime t) const {return base_tz + tz.dst_offset(t);}
                 bool is_dst(utctime t) const {return tz.dst_offset(t)!=utctimespan(0);}
+                ///< utc_offset(t), and the period p around t where it is constant, \sa tz_table::dst_offset
+                utctimespan utc_offset(utctime t, utcperiod& p) const {return base_tz + tz.dst_offset(t, p);}
                 x_serialize_decl();
             };
 
@@ -368,6 +405,12 @@ namespace shyft {
 			 */
 			utctime time(YMDhms c) const;
             utctime time(YWdhms c) const;
+            /**\brief batch version of time(YMDhms), equal to calling time(c[i]) for each element
+             *
+             * The tz-offsets are looked up once for each dst period,
+             * so it pays off when c is ordered, like the points of a time-axis.
+             */
+            std::vector<utctime> time(const std::vector<YMDhms>& c) const;
 
             ///<short hand for calendar::time(YMDhms)
             utctime time(int Y,int M=1,int D=1,int h=0,int m=0,int s=0) const {
@@ -389,6 +432,12 @@ namespace shyft {
              * \return calendar units YMDhms
              */
 			YMDhms  calendar_units(utctime t) const ;
+            /**\brief batch version of calendar_units(t), equal to calling calendar_units(t[i]) for each element
+             *
+             * The tz-offsets are looked up once for each dst period, and the date once for each day,
+             * so it pays off when t is ordered, like the points of a time-axis.
+             */
+            std::vector<YMDhms> calendar_units(const std::vector<utctime>& t) const;
 
             /**\brief return the calendar iso week units of t taking timezone and dst into account
             *
@@ -428,6 +477,12 @@ namespace shyft {
              * \return a trimmed utctime
              */
 			utctime trim(utctime t, utctimespan deltaT) const ;
+            /**\brief batch version of trim(t,deltaT), equal to calling trim(t[i],deltaT) for each element
+             *
+             * For ordered t, the tz-offsets are looked up once for each dst period, and
+             * for calendar::DAY,MONTH,QUARTER,YEAR the result is computed once for each interval.
+             */
+            std::vector<utctime> trim(const std::vector<utctime>& t, utctimespan deltaT) const;
 
 			/**\brief calendar semantic add
 			 *
@@ -451,6 +506,11 @@ namespace shyft {
 			 * \return new calculated utctime
 			 */
 			utctime add(utctime t, utctimespan deltaT, long n) const ;
+            /**\brief batch version of add(t,deltaT,n), equal to calling add(t[i],deltaT,n) for each element
+             *
+             * For ordered t, the tz-offsets are looked up once for each dst period.
+             */
+            std::vector<utctime> add(const std::vector<utctime>& t, utctimespan deltaT, long n) const;
 
 			/**\brief calculate the distance t1..t2 in specified units
 			 *
@@ -476,7 +536,7 @@ namespace shyft {
             inline utctimespan tz_table::dst_offset(utctime t) const {
                 if(!is_dst()) return  utctimespan(0);
                 auto year=calendar::utc_year(t);
-                if(year-start_year >= (int) dst.size()) return utctimespan(0);
+                if(year < start_year || year-start_year >= (int) dst.size()) return utctimespan(0);
                 auto s=dst_start(year);
                 auto e=dst_end(year);
                 return (s<e? (t>=s&&t<e):(t<e || t>=s))?dt[year-start_year]:utctimespan(0);
@@ -27,6 +27,7 @@ PTGSKOptModel.state = property(lambda self:PTGSKCellOptStateHandler(self.get_cel
 PTGSKOptModel.statistics = property(lambda self:PTGSKCellOptStatistics(self.get_cells()))
 
 PTGSKOptModel.optimizer_t = PTGSKOptimizer
+PTGSKOptModel.calibration_batch_t = PTGSKOptimizerBatch
 PTGSKOptModel.full_model_t =PTGSKModel
 PTGSKModel.opt_model_t =PTGSKOptModel
 PTGSKModel.create_opt_model_clone = lambda self: create_opt_model_clone(self)
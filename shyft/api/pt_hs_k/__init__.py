@@ -25,6 +25,7 @@ PTHSKOptModel.state = property(lambda self:PTHSKCellOptStateHandler(self.get_cel
 PTHSKOptModel.statistics = property(lambda self:PTHSKCellOptStatistics(self.get_cells()))
 
 PTHSKOptModel.optimizer_t = PTHSKOptimizer
+PTHSKOptModel.calibration_batch_t = PTHSKOptimizerBatch
 
 PTHSKOptModel.full_model_t =PTHSKModel
 PTHSKModel.opt_model_t =PTHSKOptModel
@@ -26,6 +26,7 @@ PTSSKOptModel.state = property(lambda self:PTSSKCellOptStateHandler(self.get_cel
 PTSSKOptModel.statistics = property(lambda self:PTSSKCellOptStatistics(self.get_cells()))
 
 PTSSKOptModel.optimizer_t = PTSSKOptimizer
+PTSSKOptModel.calibration_batch_t = PTSSKOptimizerBatch
 PTSSKOptModel.full_model_t =PTSSKModel
 PTSSKModel.opt_model_t =PTSSKOptModel
 PTSSKModel.create_opt_model_clone = lambda self: create_opt_model_clone(self)
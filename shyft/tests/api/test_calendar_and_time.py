@@ -1,6 +1,7 @@
 ﻿from shyft import api
 import unittest
 import datetime as dt
+import numpy as np
 
 
 class Calendar(unittest.TestCase):
@@ -150,6 +151,23 @@ class Calendar(unittest.TestCase):
         self.assertTrue(p3.overlaps(p1))
         self.assertTrue(p3.overlaps(p2))
 
+    def test_batch_conversions(self):
+        osl = api.Calendar("Europe/Oslo")
+        t = api.UtcTimeVector.from_numpy(np.arange(osl.time(2017, 3, 25), osl.time(2017, 3, 28), 1800, dtype=np.int64))
+        cu = osl.calendar_units(t)
+        self.assertEqual(len(cu), len(t))
+        for i in range(len(t)):
+            self.assertEqual(cu[i], osl.calendar_units(t[i]))
+        self.assertEqual(list(osl.time(cu)), list(t))
+        c2 = api.YMDhmsVector.create_from_arrays(cu.year, cu.month, cu.day, cu.hour, cu.minute, cu.second)
+        self.assertEqual(list(osl.time(c2)), list(t))
+        t_day = osl.trim(t, api.Calendar.DAY)
+        t_add = osl.add(t, api.Calendar.DAY, 1)
+        for i in range(len(t)):
+            self.assertEqual(t_day[i], osl.trim(t[i], api.Calendar.DAY))
+            self.assertEqual(t_add[i], osl.add(t[i], api.Calendar.DAY, 1))
+        self.assertEqual(t_day.to_numpy()[0], osl.time(2017, 3, 25))
+
     def test_swig_python_time(self):
         """
         This particular test is here to point out a platform specific bug detected
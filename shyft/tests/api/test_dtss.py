@@ -1,7 +1,9 @@
 import re
+import os
 import socket
 import tempfile
 import unittest
+from concurrent.futures import ThreadPoolExecutor
 from contextlib import closing
 
 import numpy as np
@@ -9,9 +11,12 @@ from time import clock as time_now
 from numpy.testing import assert_array_almost_equal
 
 from shyft.api import Calendar
+from shyft.api import CachePolicy
 from shyft.api import DtsClient
 from shyft.api import DtsServer
 from shyft.api import IntVector
+from shyft.api import DoubleVector
+from shyft.api import aggregate_property
 from shyft.api import UtcTimeVector
 from shyft.api import StringVector
 from shyft.api import TimeAxis
@@ -148,6 +153,7 @@ class DtssTestCase(unittest.TestCase):
         r1 = dts.evaluate(tsv, ta.total_period())
         r2 = dts.percentiles(tsv, ta.total_period(), ta24, percentile_list)
         r3 = dts.find('netcdf://dummy\.nc/ts\d')
+        r4 = dts.aggregates(tsv, ta.total_period(), ta24, IntVector([aggregate_property.SUM, aggregate_property.MEAN]), DoubleVector(), DoubleVector())
         self.rd_throws = True
         ex_count = 0
         try:
@@ -166,7 +172,10 @@ class DtssTestCase(unittest.TestCase):
         dtss.clear()  # close server
         self.assertEqual(ex_count, 2)
         self.assertEqual(len(r1), len(tsv))
-        self.assertEqual(self.callback_count, 3)
+        self.assertEqual(self.callback_count, 4)
+        self.assertEqual(len(r4), 2)
+        self.assertEqual(r4[0].time_axis, ta24)
+        assert_array_almost_equal(r4[0].values.to_numpy()/len(tsv), r4[1].values.to_numpy(), decimal=6)
         for i in range(n_ts - 1):
             self.assertEqual(r1[i].time_axis, tsv[i].time_axis)
             assert_array_almost_equal(r1[i].values.to_numpy(), tsv[i].values.to_numpy(), decimal=4)
@@ -190,6 +199,266 @@ class DtssTestCase(unittest.TestCase):
         for i in range(len(store_tsv)):
             self.assertEqual(self.stored_tsv[0][i].ts_id(), store_tsv[i].ts_id())
 
+    def test_batched_read_callback_with_futures(self):
+        utc = Calendar()
+        ta = TimeAxis(utc.time(2016, 1, 1), deltahours(1), 240)
+        tsv = TsVector()
+        for i in range(10):
+            tsv.append(TimeSeries(fake_store_url('{0}'.format(i))))
+        dtss = DtsServer()
+        port_no = find_free_port()
+        dtss.set_listening_port(port_no)
+        with ThreadPoolExecutor(max_workers=2) as executor:
+            dtss.cb = lambda ts_ids, read_period: executor.submit(self.dtss_read_callback, ts_ids, read_period)  # a future is also ok
+            self.assertEqual(dtss.get_read_batch_window(), 0)
+            dtss.set_read_batching(window_us=2000, threads=2)
+            self.assertEqual(dtss.get_read_batch_window(), 2000)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            r = dts.evaluate(tsv, ta.total_period())
+            dts.close()
+            dtss.clear()
+        self.assertEqual(self.callback_count, 1)
+        self.assertEqual(len(r), len(tsv))
+        for ts in r:
+            self.assertEqual(ts.time_axis, ta)
+            assert_array_almost_equal(ts.values.to_numpy(), np.full(ta.size(), 1.0))
+
+    def test_subscription(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            store_tsv = TsVector()
+            tsv = TsVector()
+            for i in range(3):
+                ts_id = shyft_store_url("s{0}".format(i))
+                store_tsv.append(TimeSeries(ts_id, TimeSeries(ta, fill_value=float(i), point_fx=point_fx.POINT_AVERAGE_VALUE)))
+                tsv.append(2.0*TimeSeries(ts_id))
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", c_dir)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            dts.store_ts(store_tsv)
+            sid, r = dts.subscribe(tsv, ta.total_period())
+            self.assertEqual(len(r), 3)
+            self.assertAlmostEqual(r[2].value(0), 4.0)
+            ix, changed = dts.read_subscription(sid, 0)
+            self.assertEqual(len(ix), 0)
+            update = TsVector()
+            update.append(TimeSeries(shyft_store_url("s1"), TimeSeries(ta, fill_value=10.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            dts.store_ts(update)
+            ix, changed = dts.read_subscription(sid, 1000)
+            self.assertEqual(list(ix), [1])  # only the changed expression
+            self.assertEqual(len(changed), 1)
+            self.assertAlmostEqual(changed[0].value(0), 20.0)
+            dts.unsubscribe(sid)
+            self.assertRaises(RuntimeError, dts.read_subscription, sid, 0)
+            dts.close()
+            dtss.clear()
+
+    def test_cluster(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            ports = [find_free_port() for i in range(3)]
+            host_ports = StringVector(['localhost:{0}'.format(p) for p in ports])
+            nodes = []
+            for i, port_no in enumerate(ports):
+                dtss = DtsServer()
+                dtss.set_listening_port(port_no)
+                dtss.set_container("test", os.path.join(c_dir, str(i)))
+                dtss.set_cluster(host_ports, i, 2)
+                dtss.start_async()
+                nodes.append(dtss)
+            store_tsv = TsVector()
+            tsv = TsVector()
+            for i in range(10):
+                ts_id = shyft_store_url("c{0}".format(i))
+                store_tsv.append(TimeSeries(ts_id, TimeSeries(ta, fill_value=float(i), point_fx=point_fx.POINT_AVERAGE_VALUE)))
+                tsv.append(TimeSeries(ts_id))
+            dts = DtsClient(host_ports, True, 1000)
+            dts.set_cluster(2)
+            dts.store_ts(store_tsv)
+            for n in nodes:
+                n.flush_replication()
+                self.assertEqual(n.get_replication_failures(), 0)
+            r = dts.evaluate(tsv, ta.total_period())
+            self.assertEqual(len(r), 10)
+            for i in range(10):
+                self.assertAlmostEqual(r[i].value(0), float(i))
+            single = DtsClient(host_ports[0])  # any node reads any series
+            r = single.evaluate(tsv, ta.total_period())
+            self.assertAlmostEqual(r[9].value(0), 9.0)
+            single.close()
+            dts.close()
+            for n in nodes:
+                n.clear()
+
+    def test_live_containers(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            self.assertRaises(RuntimeError, dts.store_ts, tsv)
+            dtss.set_container("test", c_dir)  # while running
+            dts.store_ts(tsv)
+            self.assertEqual(list(dtss.get_container_names()), ["test"])
+            self.assertTrue(dtss.remove_container("test"))
+            self.assertFalse(dtss.remove_container("test"))
+            self.assertRaises(RuntimeError, dts.store_ts, tsv)
+            dts.close()
+            dtss.clear()
+
+    def test_request_scheduling(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", c_dir)
+            dtss.set_scheduling(2, 100)
+            dtss.set_client_weight("127.0.0.1", 2.0)
+            dtss.start_async()
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            expr = TsVector()
+            expr.append(TimeSeries(shyft_store_url("x")))
+
+            def evaluate(i):
+                c = DtsClient('localhost:{0}'.format(port_no))
+                r = c.evaluate(expr, ta.total_period())
+                c.close()
+                return r[0].value(0)
+
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            dts.store_ts(tsv)
+            with ThreadPoolExecutor(max_workers=4) as pool:
+                self.assertEqual(list(pool.map(evaluate, range(8))), [1.0]*8)
+            s = dts.scheduler_stats
+            self.assertEqual(s.workers, 2)
+            self.assertEqual(s.admitted, 9)
+            self.assertEqual(s.rejected, 0)
+            self.assertEqual(dtss.scheduler_stats.running, 0)
+            dts.close()
+            dtss.clear()
+
+    def test_cache_warm_up(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            hot_set = os.path.join(c_dir, "hot_set.txt")
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            expr = TsVector()
+            expr.append(TimeSeries(shyft_store_url("x")))
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", os.path.join(c_dir, "test"))
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            dts.store_ts(tsv)
+            dts.evaluate(expr, ta.total_period(), use_ts_cached_read=True, update_ts_cache=True)
+            dtss.set_cache_hot_set_recording(hot_set, 3600*1000)
+            dtss.set_cache_hot_set_recording(hot_set, 0)  # records once more as it stops
+            self.assertTrue(os.path.exists(hot_set))
+            dts.close()
+            dtss.clear()
+            del dtss
+            restarted = DtsServer()
+            restarted.set_container("test", os.path.join(c_dir, "test"))
+            restarted.start_warm_cache(hot_set)
+            self.assertEqual(restarted.wait_warm_cache(), 1)
+            self.assertEqual(restarted.cache_stats.id_count, 1)
+
+    def test_cache_snapshot(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            snapshot = os.path.join(c_dir, "cache.snapshot")
+            dtss = DtsServer()
+            self.assertEqual(dtss.set_cache_snapshot(snapshot), 0)
+            dtss.cache(StringVector(["a", "b"]), TsVector([TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE),
+                                                           TimeSeries(ta, fill_value=2.0, point_fx=point_fx.POINT_AVERAGE_VALUE)]))
+            del dtss  # saved when destroyed
+            restarted = DtsServer()
+            self.assertEqual(restarted.set_cache_snapshot(snapshot), 2)
+            self.assertEqual(restarted.cache_stats.id_count, 2)
+            restarted.save_cache_snapshot(snapshot)
+            self.assertEqual(DtsServer().load_cache_snapshot(snapshot), 2)
+
+    def test_metrics(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", c_dir)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            dts.store_ts(tsv)
+            m = dts.get_metrics()
+            self.assertEqual(len(m), 1)
+            self.assertTrue('dtss_request_seconds_count{type="STORE_TS"} 1' in m[0])
+            self.assertTrue('dtss_connections 1' in dtss.metrics)
+            dts.close()
+            dtss.clear()
+
+    def test_result_cache(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", c_dir)
+            dtss.result_cache_max_items = 100
+            self.assertEqual(dtss.result_cache_max_items, 100)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            dts.store_ts(tsv)
+            e = TsVector()
+            e.append(TimeSeries(shyft_store_url("x"))*2.0)
+            r = dts.evaluate(e, ta.total_period(), use_ts_cached_read=True, update_ts_cache=False)
+            self.assertAlmostEqual(r[0].value(0), 2.0)
+            r = dts.evaluate(e, ta.total_period(), use_ts_cached_read=True, update_ts_cache=False)
+            self.assertAlmostEqual(r[0].value(0), 2.0)
+            self.assertTrue('dtss_result_cache_hits_total 1' in dtss.metrics)
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=3.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            dts.store_ts(tsv)
+            r = dts.evaluate(e, ta.total_period(), use_ts_cached_read=True, update_ts_cache=False)
+            self.assertAlmostEqual(r[0].value(0), 6.0)
+            dts.close()
+            dtss.clear()
+
+    def test_get_ts_info(self):
+        with tempfile.TemporaryDirectory() as c_dir:
+            ta = TimeAxis(Calendar().time(2016, 1, 1), deltahours(1), 24)
+            dtss = DtsServer()
+            port_no = find_free_port()
+            dtss.set_listening_port(port_no)
+            dtss.set_container("test", c_dir)
+            dtss.start_async()
+            dts = DtsClient('localhost:{0}'.format(port_no))
+            tsv = TsVector()
+            tsv.append(TimeSeries(shyft_store_url("x"), TimeSeries(ta, fill_value=1.0, point_fx=point_fx.POINT_AVERAGE_VALUE)))
+            dts.store_ts(tsv)
+            r = dts.get_ts_info(StringVector([shyft_store_url("x"), shyft_store_url("none")]))
+            self.assertEqual(len(r), 2)
+            self.assertEqual(r[0].name, shyft_store_url("x"))
+            self.assertEqual(r[0].data_period, ta.total_period())
+            self.assertEqual(r[1].name, shyft_store_url("none"))
+            self.assertFalse(r[1].data_period.valid())
+            dts.close()
+            dtss.clear()
+
     def test_ts_store(self):
         """
         This test verifies the shyft internal time-series store,
@@ -246,8 +515,13 @@ class DtssTestCase(unittest.TestCase):
             std_max_items = dtss.cache_max_items
             dtss.cache_max_items = 3000
             tst_max_items = dtss.cache_max_items
+            std_max_bytes = dtss.cache_max_bytes
+            dtss.cache_max_bytes = 100*1000*1000
+            tst_max_bytes = dtss.cache_max_bytes
+            std_policy = dtss.cache_policy
+            dtss.cache_policy = CachePolicy.TWO_Q
             dtss.set_listening_port(port_no)
-            dtss.set_container("test", c_dir)  # notice we set container 'test' to point to c_dir directory
+            dtss.set_container("test", c_dir, compress=True)  # notice we set container 'test' to point to c_dir directory, with compressed values
             dtss.start_async()  # the internal shyft time-series will be stored to that container
             # also notice that we dont have to setup callbacks in this case (but we could, and they would work)
             #
@@ -266,11 +540,42 @@ class DtssTestCase(unittest.TestCase):
                 self.assertFalse(True, 'This did not work out')
             except RuntimeError as rex:
                 self.assertIsNotNone(rex)
+            # pipelined async evaluations, results fetched in any order
+            rid_x = dts.evaluate_async(tsvx, ta.total_period())
+            rid_1 = dts.evaluate_async(tsv, ta.total_period())
+            rid_2 = dts.evaluate_async(tsv_krls, ta.total_period())
+            a2 = dts.evaluate_result(rid_2)
+            a1 = dts.evaluate_result(rid_1)
+            self.assertRaises(RuntimeError, dts.evaluate_result, rid_x)
+            self.assertRaises(RuntimeError, dts.evaluate_result, rid_x)  # already fetched
+            self.assertTrue(dts.flat_replies)
+            dts.flat_replies = False  # replies as boost archives
+            r1_archive = dts.evaluate(tsv, ta.total_period())
+            dts.flat_replies = True
+            dts.compress_replies = True
+            r1_compressed = dts.evaluate(tsv, ta.total_period())
+            dts.compress_replies = False
+            chunks = []
+            dts.evaluate_stream(tsv, ta.total_period(), 3, lambda i0, c: chunks.append((i0, c)))
 
             dts.close()  # close connection (will use context manager later)
             dtss.clear()  # close server
 
             # now the moment of truth:
+            self.assertEqual(len(a1), len(r1))
+            self.assertEqual(len(a2), len(r2))
+            self.assertEqual(len(r1_archive), len(r1))
+            self.assertEqual([i0 for i0, c in chunks], list(range(0, len(r1), 3)))
+            streamed = [ts for i0, c in chunks for ts in c]
+            self.assertEqual(len(streamed), len(r1))
+            for i in range(len(r1)):
+                assert_array_almost_equal(streamed[i].values.to_numpy(), r1[i].values.to_numpy(), decimal=4)
+            for i in range(len(r1)):
+                self.assertEqual(a1[i].time_axis, r1[i].time_axis)
+                assert_array_almost_equal(a1[i].values.to_numpy(), r1[i].values.to_numpy(), decimal=4)
+                self.assertEqual(r1_archive[i].time_axis, r1[i].time_axis)
+                assert_array_almost_equal(r1_compressed[i].values.to_numpy(), r1[i].values.to_numpy(), decimal=4)
+                assert_array_almost_equal(r1_archive[i].values.to_numpy(), r1[i].values.to_numpy(), decimal=4)
             self.assertEqual(len(r1), len(tsv))
             for i in range(n_ts - 1):
                 self.assertEqual(r1[i].time_axis, store_tsv[i].time_axis)
@@ -281,6 +586,12 @@ class DtssTestCase(unittest.TestCase):
             assert_array_almost_equal(r2[1].values.to_numpy(), r2[2].values.to_numpy(),decimal=4)
             self.assertEqual(1000000,std_max_items)
             self.assertEqual(3000,tst_max_items)
+            self.assertEqual(0,std_max_bytes)
+            self.assertEqual(100*1000*1000,tst_max_bytes)
+            self.assertEqual(CachePolicy.LRU,std_policy)
+            self.assertEqual(CachePolicy.TWO_Q,dtss.cache_policy)
+            two_q_stats = dtss.cache_policy_stats(CachePolicy.TWO_Q)
+            self.assertEqual(dtss.cache_stats.hits, two_q_stats.hits)
 
     def test_ts_cache(self):
         """ Verify dtss ts-cache functions exposed to python """
@@ -315,7 +626,7 @@ class DtssTestCase(unittest.TestCase):
             host_port = 'localhost:{0}'.format(port_no)
             dtss.set_auto_cache(True)
             dtss.set_listening_port(port_no)
-            dtss.set_container("test", c_dir)  # notice we set container 'test' to point to c_dir directory
+            dtss.set_container("test", c_dir, wal=True)  # notice we set container 'test' to point to c_dir directory, with a write-ahead log
             dtss.start_async()  # the internal shyft time-series will be stored to that container
 
             dts = DtsClient(host_port, auto_connect=False)  # demonstrate object life-time connection
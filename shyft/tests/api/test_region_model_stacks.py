@@ -1,6 +1,7 @@
 ﻿from numpy import random
 import unittest
 import tempfile
+import threading
 from os import path
 
 from shyft import api
@@ -220,6 +221,12 @@ class RegionModel(unittest.TestCase):
         self.assertIsNotNone(ae_pot_ratio)
         self.assertAlmostEqual(ae_pot_ratio.values.to_numpy().min(),0.9999330003895371)
         self.assertAlmostEqual(ae_pot_ratio.values.to_numpy().max(), 1.0)
+        counters = model.stack_counters  # only counted in profiled builds
+        self.assertIn('snow', api.MethodStackCounters.routine_names())
+        if api.method_stack_profiling_enabled():
+            self.assertEqual(counters.calls('snow'), model.size()*model.time_axis.size())
+        else:
+            self.assertEqual(counters.total_cycles(), 0)
         opt_model.run_cells()  # starting out with the same state, same interpolated values, and region-parameters, we should get same results
         sum_discharge_opt_value= opt_model.statistics.discharge_value(cids, 0)
         self.assertAlmostEqual(sum_discharge_opt_value,sum_discharge_value,3)  # verify the opt_model clone gives same value
@@ -309,6 +316,67 @@ class RegionModel(unittest.TestCase):
         self.assertAlmostEqual(q_x, q_avg*x, 3)
         pass
 
+    def test_run_models_in_threads(self):
+        # run_interpolation and run_cells release the GIL, so models can run concurrently in python threads
+        num_cells = 20
+        cal = api.Calendar()
+        time_axis = api.TimeAxisFixedDeltaT(cal.time(2015, 1, 1, 0, 0, 0), api.deltahours(1), 240)
+        models = [self.build_model(pt_gs_k.PTGSKOptModel, pt_gs_k.PTGSKParameter, num_cells) for i in range(4)]
+        re = self.create_dummy_region_environment(time_axis, models[0].get_cells()[int(num_cells/2)].geo.mid_point())
+        s0 = pt_gs_k.PTGSKStateVector()
+        for i in range(num_cells):
+            si = pt_gs_k.PTGSKState()
+            si.kirchner.q = 40.0
+            s0.append(si)
+
+        def run(model):
+            model.run_interpolation(api.InterpolationParameter(), time_axis, re)
+            model.set_states(s0)
+            model.run_cells(use_ncore=1)
+
+        threads = [threading.Thread(target=run, args=(m,)) for m in models]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        cids = api.IntVector()
+        expected = models[0].statistics.discharge_value(cids, 0)
+        self.assertGreaterEqual(expected, 130.0)
+        for m in models[1:]:
+            self.assertAlmostEqual(m.statistics.discharge_value(cids, 0), expected)
+
+    def test_feature_and_state_arrays(self):
+        num_cells = 20
+        cal = api.Calendar()
+        time_axis = api.TimeAxisFixedDeltaT(cal.time(2015, 1, 1, 0, 0, 0), api.deltahours(1), 24)
+        model = self.build_model(pt_gs_k.PTGSKOptModel, pt_gs_k.PTGSKParameter, num_cells)
+        re = self.create_dummy_region_environment(time_axis, model.get_cells()[int(num_cells/2)].geo.mid_point())
+        model.run_interpolation(api.InterpolationParameter(), time_axis, re)
+        s0 = pt_gs_k.PTGSKStateVector()
+        for i in range(num_cells):
+            si = pt_gs_k.PTGSKState()
+            si.kirchner.q = 40.0 + i
+            s0.append(si)
+        model.set_states(s0)
+        model.run_cells()
+        cids = api.IntVector()
+        q = model.statistics.discharge_matrix(cids)
+        self.assertEqual(q.shape, (num_cells, time_axis.size()))
+        q_sum = model.statistics.discharge(cids).values.to_numpy()
+        for j in range(time_axis.size()):
+            self.assertAlmostEqual(q[:, j].sum(), q_sum[j], places=6)
+        fields = pt_gs_k.PTGSKOptModel.state_array_fields()
+        self.assertEqual(fields[-1], "kirchner.q")
+        s = model.get_states_array()
+        self.assertEqual(s.shape, (num_cells, len(fields)))
+        s[:, -1] = 2.0
+        model.set_states_array(s)
+        sv = pt_gs_k.PTGSKStateVector()
+        model.get_states(sv)
+        for i in range(num_cells):
+            self.assertAlmostEqual(sv[i].kirchner.q, 2.0)
+        self.assertRaises(RuntimeError, model.set_states_array, s[:, 1:])
+
     def test_optimization_model(self):
         num_cells = 20
         model_type = pt_gs_k.PTGSKOptModel
@@ -572,6 +640,26 @@ class RegionModel(unittest.TestCase):
         for i in range(len(ms_2x)):
             self.assertAlmostEqual(ms_2x[i].state.kirchner.q, 200 + i)
 
+        # the flat snapshot, to and from bytes
+        flat = pt_gs_k.serialize_flat(ms_2)
+        self.assertIsInstance(flat, bytes)
+        ms_2f = pt_gs_k.deserialize_flat(flat)
+        self.assertEqual(len(ms_2f), len(ms_2))
+        for i in range(len(ms_2f)):
+            self.assertEqual(ms_2f[i].id, ms_2[i].id)
+            self.assertAlmostEqual(ms_2f[i].state.kirchner.q, 200 + i)
+        self.assertRaises(RuntimeError, pt_gs_k.deserialize_flat, flat[:-1])
+        self.assertRaises(RuntimeError, pt_hs_k.deserialize_flat, flat)
+
+        snapshot = model.get_states_snapshot()
+        for i in range(len(ms_12)):
+            ms_12[i].state.kirchner.q = 1.0
+        model.state.apply_state(ms_12, cids_unspecified)
+        model.set_states_snapshot(snapshot)
+        ms_2 = model.state.extract_state(cids_2)
+        for i in range(len(ms_2)):
+            self.assertAlmostEqual(ms_2[i].state.kirchner.q, 200 + i)
+
 
 if __name__ == "__main__":
     unittest.main()
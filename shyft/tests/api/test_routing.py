@@ -5,6 +5,7 @@ from shyft.api import River
 from shyft.api import RoutingInfo
 from shyft.api import UHGParameter
 from shyft.api import RiverNetwork
+from shyft.api import RoutingState
 
 
 class Routing(unittest.TestCase):
@@ -87,3 +88,13 @@ class Routing(unittest.TestCase):
         r3.downstream.distance = 1234.0  # got a reference We can modify
         r3b = rn.river_by_id(3)  # pull out the reference once again
         self.assertAlmostEqual(r3b.downstream.distance, 1234.0)  # verify its modified
+
+    def test_routing_state(self):
+        s = RoutingState()
+        self.assertTrue(s.empty())
+        s.t = 3600*24
+        s.dt = deltahours(1)
+        self.assertFalse(s.empty())
+        s2 = RoutingState.deserialize(s.serialize())
+        self.assertEqual(s, s2)
+        self.assertEqual(s2.dt, deltahours(1))
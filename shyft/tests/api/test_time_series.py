@@ -98,6 +98,87 @@ class TimeSeries(unittest.TestCase):
         del tsfixed
         assert_array_almost_equal(dv, ref_v.to_numpy())
 
+    def test_values_view(self):
+        ta = api.TimeAxis(self.t, self.d, self.n)
+        a = api.TimeSeries.from_numpy(ta, np.arange(self.n, dtype=np.float64), api.POINT_AVERAGE_VALUE)
+        self.assertEqual(a.size(), self.n)
+        assert_array_almost_equal(a.values.to_numpy(), np.arange(self.n))
+        v = a.values_view()
+        assert_array_almost_equal(v, np.arange(self.n))
+        self.assertFalse(v.flags.writeable)  # the values might be shared by other time-series
+        a.set(1, 10.0)
+        self.assertAlmostEqual(v[1], 10.0)  # a view, not a copy
+        del a  # the view keeps the values alive
+        self.assertAlmostEqual(v[1], 10.0)
+        b = api.TimeSeries(ta, fill_value=1.0, point_fx=api.POINT_AVERAGE_VALUE)
+        assert_array_almost_equal((b*2.0).values_view(), np.full(self.n, 2.0))  # an expression is evaluated
+        with self.assertRaises(RuntimeError):
+            api.TimeSeries.from_numpy(ta, np.arange(self.n + 1, dtype=np.float64), api.POINT_AVERAGE_VALUE)
+        tsf = api.TsFixed(self.ta, api.DoubleVector.from_numpy(np.arange(self.n, dtype=np.float64)), api.POINT_AVERAGE_VALUE)
+        fv = tsf.values_view()
+        fv[0] = 5.0
+        self.assertAlmostEqual(tsf.value(0), 5.0)
+
+    def test_ts_vector_numpy(self):
+        ta = api.TimeAxis(self.t, self.d, self.n)
+        a = np.arange(3*self.n, dtype=np.float64).reshape(3, self.n)
+        tsv = api.TsVector.from_numpy(ta, a, api.POINT_AVERAGE_VALUE)
+        self.assertEqual(len(tsv), 3)
+        self.assertEqual(tsv[2].time_axis, ta)
+        assert_array_almost_equal(tsv[1].values.to_numpy(), a[1])
+        assert_array_almost_equal(tsv.to_numpy(), a)
+        assert_array_almost_equal((tsv*2.0).to_numpy(), 2.0*a)  # expressions are evaluated
+        assert_array_almost_equal(api.TsVector.from_numpy(ta, a[:, ::-1], api.POINT_AVERAGE_VALUE).to_numpy(), a[:, ::-1])  # not contiguous
+        self.assertEqual(api.TsVector().to_numpy().shape, (0, 0))
+        with self.assertRaises(RuntimeError):
+            api.TsVector.from_numpy(ta, np.zeros((2, self.n + 1)), api.POINT_AVERAGE_VALUE)
+        tsv.append(api.TimeSeries(api.TimeAxis(self.t, self.d, self.n + 1), fill_value=1.0, point_fx=api.POINT_AVERAGE_VALUE))
+        with self.assertRaises(RuntimeError):
+            tsv.to_numpy()
+
+    def test_ts_vector_sum(self):
+        ta = api.TimeAxis(self.t, self.d, self.n)
+        a = np.arange(200*self.n, dtype=np.float64).reshape(200, self.n)
+        tsv = api.TsVector.from_numpy(ta, a, api.POINT_AVERAGE_VALUE)
+        s = tsv.sum()
+        self.assertEqual(s.time_axis, ta)
+        assert_array_almost_equal(s.values.to_numpy(), a.sum(axis=0))
+        assert_array_almost_equal((tsv*2.0).sum(compensated=True).values.to_numpy(), 2.0*a.sum(axis=0))
+        self.assertTrue(api.ts_stringify(s).startswith('sum('))
+        with self.assertRaises(RuntimeError):
+            api.TsVector().sum()
+
+    def test_ts_vector_evaluate(self):
+        ta = api.TimeAxis(self.t, self.d, self.n)
+        a = np.arange(100*self.n, dtype=np.float64).reshape(100, self.n)
+        tsv = api.TsVector.from_numpy(ta, a, api.POINT_AVERAGE_VALUE)*2.0 + 1.0
+        e = tsv.evaluate()
+        self.assertEqual(len(e), len(tsv))
+        self.assertEqual(e[3].time_axis, ta)
+        self.assertEqual(e[3].point_interpretation(), api.POINT_AVERAGE_VALUE)
+        assert_array_almost_equal(e.to_numpy(), 2.0*a + 1.0)
+        assert_array_almost_equal(tsv.evaluate(max_threads=1).to_numpy(), 2.0*a + 1.0)
+        assert_array_almost_equal(tsv.values_at(ta.time(5)).to_numpy(), 2.0*a[:, 5] + 1.0)
+        self.assertEqual(len(api.TsVector().evaluate()), 0)
+        # the GIL is released, so python threads can run the bulk operations concurrently
+        from concurrent.futures import ThreadPoolExecutor
+        with ThreadPoolExecutor(max_workers=4) as x:
+            r = list(x.map(lambda k: (tsv*float(k)).evaluate().to_numpy(), range(4)))
+        for k in range(4):
+            assert_array_almost_equal(r[k], float(k)*(2.0*a + 1.0))
+        unbound = api.TsVector()
+        unbound.append(api.TimeSeries('a'))
+        with self.assertRaises(RuntimeError):
+            unbound.evaluate()
+
+    def test_ts_parallel_values(self):
+        n = 10000  # several blocks of the evaluation
+        ta = api.TimeAxis(self.t, api.deltaminutes(15), n)
+        a = api.TimeSeries.from_numpy(ta, np.sin(np.arange(n)*0.01), api.POINT_AVERAGE_VALUE)
+        e = (a*a + 2.0).abs()/(a + 3.0) - a.average(ta)  # the average is evaluated once, the rest in blocks
+        assert_array_almost_equal(e.parallel_values(), e.values.to_numpy(), 15)
+        assert_array_almost_equal(e.parallel_values(max_threads=2), e.values.to_numpy(), 15)
+
     def test_ts_point(self):
         dv=np.arange(self.ta.size())
         v=api.DoubleVector.from_numpy(dv)
@@ -29,6 +29,17 @@ class Vectors(unittest.TestCase):
         # this does not work yet
         # nv= api.DoubleVector(dv_np).. would be very nice!
 
+    def test_double_vector_view(self):
+        dv = api.DoubleVector.from_numpy(np.arange(10.0))
+        v = dv.view()
+        assert_array_almost_equal(v, np.arange(10.0))
+        v[2] = 42.0  # the view shares the values with the vector
+        self.assertAlmostEqual(dv[2], 42.0)
+        dv[3] = 43.0
+        self.assertAlmostEqual(v[3], 43.0)
+        del dv  # the view keeps the vector alive
+        self.assertAlmostEqual(v[2], 42.0)
+
     def test_int_vector(self):
         dv_from_list = api.IntVector([x for x in range(10)])
         dv_np = np.arange(10, dtype=np.int32)  # notice, default is int64, which does not convert automatically to int32
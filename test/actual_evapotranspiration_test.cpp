@@ -46,6 +46,17 @@ TEST_CASE("test_scale_factor") {
     TS_ASSERT(act_evap_small_scale > act_evap_large_scale);
 
 }
-}
-
 
+TEST_CASE("test_batch_equals_scalar") {
+    const size_t n = 257;
+    std::vector<double> water(n), pot_evap(n), sca(n), ae(n, -1.0);
+    for (size_t i = 0; i < n; ++i) {
+        water[i] = 0.01*i;
+        pot_evap[i] = 0.5 + 0.001*i;
+        sca[i] = (i % 10)/10.0;
+    }
+    calculate_step_batch(water.data(), pot_evap.data(), 1.5, sca.data(), ae.data(), n);
+    for (size_t i = 0; i < n; ++i)
+        FAST_CHECK_EQ(ae[i], calculate_step(water[i], pot_evap[i], 1.5, sca[i], deltahours(1)));
+}
+}
@@ -11,6 +11,9 @@
 #include "api/pt_ss_k.h"
 #include "api/pt_hs_k.h"
 #include "api/api_state.h"
+#include "api/api_windowed_run.h"
+#include "api/api_model_server.h"
+#include "api/api_partitioned_model.h"
 
 using namespace std;
 using namespace shyft::core;
@@ -188,4 +191,210 @@ TEST_CASE("test_state_with_id_functionality") {
     TS_ASSERT_EQUALS(m0_y.size(), 1u);
     TS_ASSERT_EQUALS(m0_y[0], 0);
 }
+TEST_CASE("test_windowed_run") {
+    typedef shyft::core::region_model<pt_gs_k::cell_discharge_response_t, a_region_environment> model_t;
+    calendar utc;
+    time_axis::fixed_dt ta(utc.time(2016, 1, 1), deltahours(3), 8*20);
+    auto cells = make_shared<vector<pt_gs_k::cell_discharge_response_t>>();
+    for (size_t j = 0; j < 12; ++j) {
+        pt_gs_k::cell_discharge_response_t c;
+        c.geo = geo_cell_data(geo_point(1000.0*(j % 4), 1000.0*(j/4), 100.0 + 50.0*j), 1000.0*1000.0, int(j % 3));
+        c.state.kirchner.q = 1.0;
+        cells->push_back(c);
+    }
+    pt_gs_k::parameter_t p;
+    model_t m(cells, p);
+    model_t ref(m);
+    time_axis::fixed_dt sta(ta.time(0), deltahours(1), 3*ta.size());// the sources, hourly
+    map<string, apoint_ts> db;
+    auto source = [&db, &sta](const string& id, double a, double b) {
+        vector<double> v(sta.size());
+        for (size_t i = 0; i < v.size(); ++i) v[i] = a + b*std::sin(0.05*i);
+        db[id] = apoint_ts(sta, v, time_series::POINT_AVERAGE_VALUE);
+        return apoint_ts("shyft://test/" + id);
+    };
+    a_region_environment env;
+    env.temperature->push_back(TemperatureSource(geo_point(0, 0, 100), source("t0", -2.0, 6.0)));
+    env.temperature->push_back(TemperatureSource(geo_point(3000, 2000, 600), source("t1", -4.0, 5.0)));
+    env.precipitation->push_back(PrecipitationSource(geo_point(0, 0, 100), source("p0", 1.0, 1.0)));
+    env.radiation->push_back(RadiationSource(geo_point(0, 0, 100), source("r0", 150.0, 50.0)));
+    env.wind_speed->push_back(WindSpeedSource(geo_point(0, 0, 100), apoint_ts(sta, 2.0, time_series::POINT_AVERAGE_VALUE)));// bound, kept as is
+    env.rel_hum->push_back(RelHumSource(geo_point(0, 0, 100), source("h0", 0.7, 0.1)));
+    vector<utcperiod> reads;
+    ts_reader_t read = [&db, &reads](const ats_vector& tsv, utcperiod p) {
+        reads.push_back(p);
+        vector<apoint_ts> r;
+        for (const auto& ts : tsv) r.push_back(db.at(ts.id().substr(string("shyft://test/").size())));
+        return r;
+    };
+    interpolation_parameter ip;
+    ip.use_idw_for_temperature = true;
+    auto q = windowed_run(m, ip, ta, env, read, 48);
+    FAST_REQUIRE_EQ(reads.size(), 4u);// 48+48+48+16 steps
+    FAST_CHECK_EQ(reads[1], utcperiod(ta.time(48) - ta.delta(), ta.time(96) + ta.delta()));
+    FAST_CHECK_EQ(m.time_axis.size(), 16u);// the last window
+    auto bound = window_environment(env, sta.total_period(), read);
+    ref.run_interpolation(ip, ta, bound);
+    ref.run_cells();
+    vector<result_ts_t> rq;
+    ref.catchment_discharges(rq);
+    FAST_REQUIRE_EQ(q.size(), rq.size());
+    FAST_REQUIRE_EQ(q.size(), 3u);
+    for (size_t k = 0; k < q.size(); ++k) {
+        FAST_REQUIRE_EQ(q[k].size(), ta.size());
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(q[k].value(i), doctest::Approx(rq[k].value(i)));
+    }
+    for (size_t j = 0; j < cells->size(); ++j)
+        FAST_CHECK_EQ((*m.get_cells())[j].state, (*ref.get_cells())[j].state);
+    CHECK_THROWS_AS(windowed_run(m, ip, ta, env, read, 0), std::runtime_error);
+}
+TEST_CASE("test_model_server") {
+    typedef shyft::core::region_model<pt_gs_k::cell_discharge_response_t, a_region_environment> model_t;
+    calendar utc;
+    time_axis::fixed_dt ta(utc.time(2016, 1, 1), deltahours(1), 24*5);
+    auto cells = make_shared<vector<pt_gs_k::cell_discharge_response_t>>();
+    for (size_t j = 0; j < 6; ++j) {
+        pt_gs_k::cell_discharge_response_t c;
+        c.geo = geo_cell_data(geo_point(1000.0*j, 500.0, 100.0 + 50.0*j), 1000.0*1000.0, int(1 + j % 2));
+        c.state.kirchner.q = 1.0;
+        cells->push_back(c);
+    }
+    pt_gs_k::parameter_t p;
+    auto m = make_shared<model_t>(cells, p);
+    model_t ref(*m);
+    auto ts = [&ta](double a, double b) {
+        vector<double> v(ta.size());
+        for (size_t i = 0; i < v.size(); ++i) v[i] = a + b*std::sin(0.1*i);
+        return apoint_ts(ta, v, time_series::POINT_AVERAGE_VALUE);
+    };
+    a_region_environment env;
+    env.temperature->push_back(TemperatureSource(geo_point(0, 0, 100), ts(2.0, 4.0)));
+    env.precipitation->push_back(PrecipitationSource(geo_point(0, 0, 100), ts(1.0, 1.0)));
+    env.radiation->push_back(RadiationSource(geo_point(0, 0, 100), ts(150.0, 50.0)));
+    env.wind_speed->push_back(WindSpeedSource(geo_point(0, 0, 100), ts(2.0, 0.0)));
+    env.rel_hum->push_back(RelHumSource(geo_point(0, 0, 100), ts(0.7, 0.1)));
+    interpolation_parameter ip;
+    model_server<model_t> srv;
+    srv.add_model("m", m, ip);
+    int port_no = 20531;
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(port_no);
+    srv.start_async();
+    {
+        model_client c("localhost:" + std::to_string(port_no));
+        FAST_CHECK_EQ(c.model_ids(), vector<string>{"m"});
+        auto s0 = c.get_states("m", vector<int>{});
+        c.set_environment("m", env);
+        FAST_CHECK_UNARY(c.run("m", ta));
+        auto q = c.catchment_discharges("m", vector<int>{2, 1});
+        ref.run_interpolation(ip, ta, env);
+        ref.run_cells();
+        vector<result_ts_t> rq;
+        ref.catchment_discharges(rq);
+        FAST_REQUIRE_EQ(q.size(), 2u);
+        for (size_t i = 0; i < ta.size(); ++i) {
+            FAST_CHECK_EQ(q[0].value(i), doctest::Approx(rq[ref.cix_from_cid(2)].value(i)));
+            FAST_CHECK_EQ(q[1].value(i), doctest::Approx(rq[ref.cix_from_cid(1)].value(i)));
+        }
+        auto s1 = c.get_states("m", vector<int>{});
+        FAST_CHECK_NE(s1, s0);
+        FAST_CHECK_EQ(c.set_states("m", s0, vector<int>{}).size(), 0u);// back to the start, as the initial state
+        FAST_CHECK_EQ(c.get_states("m", vector<int>{}), s0);
+        c.run("m", ta);
+        FAST_CHECK_EQ(c.get_states("m", vector<int>{}), s1);
+        CHECK_THROWS_AS(c.run("nonexisting", ta), std::runtime_error);
+        FAST_CHECK_EQ(c.model_ids().size(), 1u);// the connection is still usable after a failed request
+        c.close();
+    }
+    srv.clear();
+}
+TEST_CASE("test_partitioned_region_model") {
+    typedef shyft::core::region_model<pt_gs_k::cell_discharge_response_t, a_region_environment> model_t;
+    calendar utc;
+    time_axis::fixed_dt ta(utc.time(2016, 1, 1), deltahours(1), 24*5);
+    vector<pt_gs_k::cell_discharge_response_t> cells;
+    for (size_t j = 0; j < 9; ++j) {// catchment 1 and 3 to river 1, 2 to river 2, below 1
+        pt_gs_k::cell_discharge_response_t c;
+        c.geo = geo_cell_data(geo_point(1000.0*j, 500.0, 100.0 + 50.0*j), 1000.0*1000.0, int(1 + j % 3));
+        c.geo.routing = routing_info(j % 3 == 1 ? 2 : 1, 5000.0);
+        c.state.kirchner.q = 1.0;
+        cells.push_back(c);
+    }
+    routing::river_network rn;
+    rn.add(routing::river(2, routing_info(0)));
+    rn.add(routing::river(1, routing_info(2, 7200.0)));
+    auto ts = [&ta](double a, double b) {
+        vector<double> v(ta.size());
+        for (size_t i = 0; i < v.size(); ++i) v[i] = a + b*std::sin(0.1*i);
+        return apoint_ts(ta, v, time_series::POINT_AVERAGE_VALUE);
+    };
+    a_region_environment env;
+    env.temperature->push_back(TemperatureSource(geo_point(0, 0, 100), ts(2.0, 4.0)));
+    env.precipitation->push_back(PrecipitationSource(geo_point(0, 0, 100), ts(1.0, 1.0)));
+    env.radiation->push_back(RadiationSource(geo_point(0, 0, 100), ts(150.0, 50.0)));
+    env.wind_speed->push_back(WindSpeedSource(geo_point(0, 0, 100), ts(2.0, 0.0)));
+    env.rel_hum->push_back(RelHumSource(geo_point(0, 0, 100), ts(0.7, 0.1)));
+    interpolation_parameter ip;
+    pt_gs_k::parameter_t p;
+    auto ref_cells = make_shared<vector<pt_gs_k::cell_discharge_response_t>>(cells);
+    model_t ref(ref_cells, p);
+    ref.river_network = rn;
+    auto parts = partition_catchments(cells, 2);
+    FAST_REQUIRE_EQ(parts.size(), 2u);
+    FAST_CHECK_EQ(parts[0].size() + parts[1].size(), 3u);
+    model_server<model_t> srv[2];
+    vector<partitioned_region_model<model_t>::partition> pp;
+    for (size_t k = 0; k < 2; ++k) {
+        auto part_cells = cells_of_catchments(cells, parts[k]);
+        auto m = make_shared<model_t>(part_cells, p);
+        m->river_network = rn;
+        m->get_states(m->initial_state);
+        srv[k].add_model("m", m, ip);
+        srv[k].set_listening_ip("127.0.0.1");
+        srv[k].set_listening_port(20551 + k);
+        srv[k].start_async();
+        pp.push_back({"localhost:" + std::to_string(20551 + k), "m", parts[k]});
+    }
+    {
+        partitioned_region_model<model_t> pm(pp, rn);
+        FAST_CHECK_EQ(pm.number_of_catchments(), 3u);
+        auto s0 = pm.get_states();
+        FAST_CHECK_EQ(s0->size(), cells.size());
+        pm.run_interpolation(ta, env);
+        pm.run_cells();
+        FAST_CHECK_UNARY(pm.interpolation_ok);
+        ref.run_interpolation(ip, ta, env);
+        ref.run_cells();
+        vector<result_ts_t> q, rq, r, rr;
+        pm.catchment_discharges(q);
+        ref.catchment_discharges(rq);
+        pm.routing_discharges(r);
+        ref.routing_discharges(rr);
+        FAST_REQUIRE_EQ(q.size(), rq.size());
+        FAST_REQUIRE_EQ(r.size(), 2u);
+        FAST_REQUIRE_EQ(rr.size(), 2u);
+        for (size_t i = 0; i < ta.size(); ++i) {
+            for (size_t k = 0; k < q.size(); ++k)
+                FAST_CHECK_EQ(q[k].value(i), doctest::Approx(rq[k].value(i)));
+            for (size_t k = 0; k < r.size(); ++k)
+                FAST_CHECK_EQ(r[k].value(i), doctest::Approx(rr[k].value(i)));
+            FAST_CHECK_EQ(pm.river_local_inflow_m3s(1)->value(i), doctest::Approx(ref.river_local_inflow_m3s(1)->value(i)));// from both partitions
+        }
+        // the states are gathered from, and split to, the partitions
+        auto s1 = pm.get_states(vector<int>{2});
+        FAST_CHECK_EQ(s1->size(), 3u);
+        auto missing = pm.set_states(s0);
+        FAST_CHECK_EQ(missing.size(), 0u);
+        pm.revert_to_initial_state();
+        pm.run_cells();
+        vector<result_ts_t> q2;
+        pm.catchment_discharges(q2);
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(q2[0].value(i), doctest::Approx(q[0].value(i)));
+        CHECK_THROWS_AS(pm.get_states(vector<int>{7}), std::runtime_error);
+    }
+    srv[0].clear();
+    srv[1].clear();
+}
 }
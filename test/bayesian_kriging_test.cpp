@@ -272,6 +272,57 @@ TEST_CASE("test_interpolation") {
 	}
 }
 
+TEST_CASE("test_reduced_operators_cache") {
+	Parameter params;
+	using namespace shyft::time_series;
+	using namespace shyfttest;
+	const size_t n_times = 8;
+	shyft::time_series::utctime dt = 3600;
+	vector<utctime> times;
+	for (size_t i = 0; i <= n_times; ++i)
+		times.emplace_back(dt*i);
+	const time_axis::point_dt ta(times);
+	SourceList s0;
+	DestinationList d0;
+	build_sources_and_dests(3, 3, 4, 4, n_times, dt, ta, false, s0, d0);
+	// source 0 drops out every second step, source 4 in step 5, so the patterns repeats
+	auto is_valid = [](size_t i, size_t t) { return !(i == 0 && t % 2 == 1) && !(i == 4 && t == 5); };
+	SourceList sources;
+	for (size_t i = 0; i < s0.size(); ++i) {
+		vector<double> v;
+		for (size_t t = 0; t < n_times; ++t)
+			v.push_back(is_valid(i, t) ? s0[i].temperatures().value(0) + 0.1*t : shyft::nan);
+		sources.emplace_back(s0[i].mid_point(), xpts_t(ta, v, POINT_AVERAGE_VALUE));
+	}
+	typedef average_accessor<shyfttest::xpts_t, time_axis::point_dt> tsa_t;
+	DestinationList d(d0), d_no_cache(d0);
+	btk_interpolation<tsa_t>(begin(sources), end(sources), begin(d), end(d), ta, params);
+	btk_interpolation<tsa_t>(begin(sources), end(sources), begin(d_no_cache), end(d_no_cache), ta, params, 0);
+	for (size_t i = 0; i < d.size(); ++i)
+		for (size_t t = 0; t < n_times; ++t)
+			TS_ASSERT_DELTA(d[i].temperature(t), d_no_cache[i].temperature(t), 1e-12);
+	for (size_t t = 0; t < n_times; ++t) { // each step equals interpolation with just the valid sources
+		SourceList valid;
+		for (size_t i = 0; i < sources.size(); ++i)
+			if (is_valid(i, t)) valid.push_back(sources[i]);
+		DestinationList d_ref(d0);
+		btk_interpolation<tsa_t>(begin(valid), end(valid), begin(d_ref), end(d_ref), ta, params);
+		for (size_t i = 0; i < d.size(); ++i)
+			TS_ASSERT_DELTA(d[i].temperature(t), d_ref[i].temperature(t), 1e-9);
+	}
+	// cache keeps the most recently used entries
+	operator_cache c(2);
+	std::vector<arma::uword> a{0, 1}, b{1, 2}, e{0, 2};
+	auto op = std::make_shared<btk_operators>();
+	c.insert(a, op); c.insert(b, op);
+	TS_ASSERT(c.find(a) == op);// a is now most recently used
+	c.insert(e, op);
+	TS_ASSERT_EQUALS(c.size(), 2u);
+	TS_ASSERT(c.find(b) == nullptr);
+	TS_ASSERT(c.find(a) == op);
+	TS_ASSERT(c.find(e) == op);
+}
+
 TEST_CASE("test_performance") {
     Parameter params;
     SourceList sources;
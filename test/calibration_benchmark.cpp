@@ -0,0 +1,235 @@
+/** \brief calibration throughput benchmark, goal function evaluations per second for the method stacks
+ *
+ * Builds a synthetic region, interpolates synthetic sources to the cells, and takes the discharge of the
+ * unchanged model as the targets, one nash-sutcliffe target for each catchment. Then the goal function is
+ * evaluated for a number of parameter sets, as the optimizers do, and the throughput and time split reported.
+ *
+ * usage: calibration_benchmark [cells=1000] [catchments=10] [sources=20] [years=1] [dt_hours=24] [iterations=20] [stack=all]
+ *        stack is one of all, pt_gs_k, pt_hs_k, pt_ss_k or hbv_stack
+ *
+ * The time split is interpolation (once, as for a calibration), cells (revert_to_initial_state and run_cells,
+ * measured separately), and goal, the rest of each evaluation. The peak rss is of the process so far,
+ * so run one stack at the time to get the peak of each.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "core/utctime_utilities.h"
+#include "core/time_axis.h"
+#include "core/time_series.h"
+#include "core/geo_cell_data.h"
+#include "core/region_model.h"
+#include "core/model_calibration.h"
+#include "core/pt_gs_k_cell_model.h"
+#include "core/pt_hs_k_cell_model.h"
+#include "core/pt_ss_k_cell_model.h"
+#include "core/hbv_stack_cell_model.h"
+
+using namespace std;
+using namespace shyft::core;
+namespace st = shyft::time_series;
+namespace mc = shyft::core::model_calibration;
+
+namespace {
+    typedef shyft::time_axis::fixed_dt ta_t;
+    typedef st::point_ts<ta_t> ts_t;
+    typedef geo_point_ts<ts_t> gts_t;
+    typedef region_environment<gts_t, gts_t, gts_t, gts_t, gts_t> env_t;
+
+    struct options {
+        size_t cells = 1000;
+        size_t catchments = 10;
+        size_t sources = 20;
+        size_t years = 1;
+        size_t dt_hours = 24;
+        size_t iterations = 20;
+        string stack = "all";
+    };
+
+    options parse(int argc, char* argv[]) {
+        options o;
+        for (int i = 1; i < argc; ++i) {
+            string a(argv[i]);
+            auto eq = a.find('=');
+            if (eq == string::npos)
+                throw runtime_error("expected key=value, got " + a);
+            string k = a.substr(0, eq), v = a.substr(eq + 1);
+            if (k == "stack") { o.stack = v; continue; }
+            size_t n = size_t(std::stoul(v));
+            if (k == "cells") o.cells = n;
+            else if (k == "catchments") o.catchments = n;
+            else if (k == "sources") o.sources = n;
+            else if (k == "years") o.years = n;
+            else if (k == "dt_hours") o.dt_hours = n;
+            else if (k == "iterations") o.iterations = n;
+            else throw runtime_error("unknown option " + k);
+        }
+        if (o.cells == 0 || o.catchments == 0 || o.sources == 0 || o.years == 0 || o.dt_hours == 0 || o.iterations == 0)
+            throw runtime_error("all sizes must be > 0");
+        o.catchments = std::min(o.catchments, o.cells);
+        return o;
+    }
+
+    double peak_rss_mb() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            return double(pmc.PeakWorkingSetSize)/(1024.0*1024.0);
+        return 0.0;
+#else
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+        return double(ru.ru_maxrss)/(1024.0*1024.0);// bytes
+#else
+        return double(ru.ru_maxrss)/1024.0;// kB
+#endif
+#endif
+    }
+
+    double seconds_since(chrono::steady_clock::time_point t0) {
+        return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    }
+
+    /** a square km grid of cells, rising to the north-east, catchments in contiguous blocks of cells */
+    vector<geo_cell_data> make_geo(const options& o) {
+        vector<geo_cell_data> r;
+        const size_t nx = size_t(std::ceil(std::sqrt(double(o.cells))));
+        for (size_t i = 0; i < o.cells; ++i) {
+            const double x = 1000.0*(i%nx), y = 1000.0*(i/nx);
+            const double z = 100.0 + 1400.0*(x + y)/(2000.0*nx);
+            r.emplace_back(geo_point(x, y, z), 1000.0*1000.0, int(i*o.catchments/o.cells));
+        }
+        return r;
+    }
+
+    /** sources spread over the region, with seasonal and diurnal temperature, and some rain events */
+    env_t make_env(const options& o, const ta_t& ta) {
+        env_t env;
+        env.temperature = make_shared<vector<gts_t>>();
+        env.precipitation = make_shared<vector<gts_t>>();
+        env.radiation = make_shared<vector<gts_t>>();
+        env.wind_speed = make_shared<vector<gts_t>>();
+        env.rel_hum = make_shared<vector<gts_t>>();
+        const double extent = 1000.0*std::ceil(std::sqrt(double(o.cells)));
+        const double pi = 3.14159265358979;
+        for (size_t s = 0; s < o.sources; ++s) {
+            const double f = double(s)/double(o.sources);
+            geo_point p(extent*f, extent*std::fmod(f*7.0, 1.0), 100.0 + 1400.0*f);
+            ts_t t(ta, 0.0, st::POINT_AVERAGE_VALUE), pr(ta, 0.0, st::POINT_AVERAGE_VALUE), r(ta, 0.0, st::POINT_AVERAGE_VALUE);
+            for (size_t i = 0; i < ta.size(); ++i) {
+                const double h = double(ta.time(i) - ta.time(0))/3600.0;
+                t.set(i, 4.0 + 10.0*std::sin(2.0*pi*h/8760.0) + 3.0*std::sin(2.0*pi*h/24.0) - 0.006*p.z);
+                pr.set(i, std::fmod(h/24.0 + 3.0*f, 5.0) < 1.5 ? 2.0 : 0.0);
+                r.set(i, std::max(0.0, 250.0*std::sin(2.0*pi*h/24.0)) + 50.0);
+            }
+            env.temperature->push_back(gts_t{p, t});
+            env.precipitation->push_back(gts_t{p, pr});
+            env.radiation->push_back(gts_t{p, r});
+            env.wind_speed->push_back(gts_t{p, ts_t(ta, 2.0, st::POINT_AVERAGE_VALUE)});
+            env.rel_hum->push_back(gts_t{p, ts_t(ta, 0.7, st::POINT_AVERAGE_VALUE)});
+        }
+        return env;
+    }
+
+    template <class cell_t>
+    void run_stack(const string& name, const options& o) {
+        typedef region_model<cell_t, env_t> model_t;
+        typedef typename cell_t::parameter_t parameter_t;
+        calendar utc;
+        ta_t ta(utc.time(2015, 1, 1), deltahours(int(o.dt_hours)), size_t(o.years*365*24/o.dt_hours));
+        parameter_t p;
+        model_t m(make_geo(o), p);
+        auto env = make_env(o, ta);
+        interpolation_parameter ip;
+        auto t0 = chrono::steady_clock::now();
+        m.run_interpolation(ip, ta, env);
+        const double t_interpolation = seconds_since(t0);
+
+        m.run_cells();// the targets are the discharge of the unchanged model
+        vector<ts_t> q;
+        m.catchment_discharges(q);
+        vector<mc::target_specification<ts_t>> targets;
+        for (size_t c = 0; c < o.catchments; ++c)
+            targets.emplace_back(q[c], vector<int>{int(c)}, 1.0, mc::NASH_SUTCLIFFE);
+        vector<double> pv(p.size());
+        for (size_t i = 0; i < p.size(); ++i) pv[i] = p.get(i);
+        parameter_t p_min = p, p_max = p;
+        vector<double> v_min = pv, v_max = pv;
+        for (size_t i = 0; i < std::min(size_t(4), pv.size()); ++i) {// a few active parameters, evaluations cost the same anyway
+            v_min[i] = pv[i] - 0.1*std::fabs(pv[i]) - 0.01;
+            v_max[i] = pv[i] + 0.1*std::fabs(pv[i]) + 0.01;
+        }
+        p_min.set(v_min);
+        p_max.set(v_max);
+        mc::optimizer<model_t, parameter_t, ts_t> opt(m);
+        opt.set_target_specification(targets, p_min, p_max);
+        opt.prepare_optimize();
+
+        t0 = chrono::steady_clock::now();
+        double f_sum = 0.0;
+        for (size_t k = 0; k < o.iterations; ++k) {
+            vector<double> v = pv;
+            const double w = double(k + 1)/double(o.iterations + 1);
+            for (size_t i = 0; i < v.size(); ++i) v[i] = v_min[i] + w*(v_max[i] - v_min[i]);
+            parameter_t pk;
+            pk.set(v);
+            f_sum += opt.calculate_goal_function(pk);
+        }
+        const double t_evaluations = seconds_since(t0);
+
+        t0 = chrono::steady_clock::now();
+        for (size_t k = 0; k < o.iterations; ++k) {
+            m.revert_to_initial_state();
+            m.run_cells();
+        }
+        const double t_cells = seconds_since(t0);
+        const double n = double(o.iterations);
+        cout << setw(10) << name
+             << fixed << setprecision(2)
+             << setw(10) << n/t_evaluations
+             << setw(14) << 1000.0*t_interpolation
+             << setw(12) << 1000.0*t_cells/n
+             << setw(12) << 1000.0*std::max(0.0, t_evaluations - t_cells)/n
+             << setw(12) << peak_rss_mb()
+             << "   (goal sum " << setprecision(6) << f_sum << ")" << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const auto o = parse(argc, argv);
+        map<string, void(*)(const string&, const options&)> stacks{
+            {"pt_gs_k", &run_stack<pt_gs_k::cell_discharge_response_t>},
+            {"pt_hs_k", &run_stack<pt_hs_k::cell_discharge_response_t>},
+            {"pt_ss_k", &run_stack<pt_ss_k::cell_discharge_response_t>},
+            {"hbv_stack", &run_stack<hbv_stack::cell_discharge_response_t>}
+        };
+        if (o.stack != "all" && !stacks.count(o.stack))
+            throw runtime_error("unknown stack " + o.stack);
+        cout << "cells=" << o.cells << " catchments=" << o.catchments << " sources=" << o.sources << " years=" << o.years
+             << " dt_hours=" << o.dt_hours << " iterations=" << o.iterations << "\n";
+        cout << setw(10) << "stack" << setw(10) << "evals/s" << setw(14) << "interp[ms]" << setw(12) << "cells[ms]"
+             << setw(12) << "goal[ms]" << setw(12) << "rss[MB]" << endl;
+        for (const auto& s : stacks)
+            if (o.stack == "all" || o.stack == s.first)
+                s.second(s.first, o);
+    } catch (const exception& e) {
+        cerr << "calibration_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include "core/pt_gs_k.h"
 #include "core/pt_gs_k_cell_model.h"
 #include "core/model_calibration.h"
+#include "core/calibration_batch.h"
+#include "core/calibration_distributed.h"
+#include <thread>
 
 namespace shyft {
 namespace time_series {
@@ -293,6 +296,51 @@ namespace shyfttest {
 		}
     };
 
+    /** the TestModel, evaluating batches of up to n parameter sets, like model_calibration::optimizer */
+    struct TestBatchModel : TestModel {
+        size_t n;
+        size_t max_batch = 0;
+        size_t n_batches = 0;
+        TestBatchModel(const std::vector<double> target, const std::vector<double> p_min, const std::vector<double> p_max, size_t n)
+         : TestModel(target, p_min, p_max), n(n) {}
+        size_t concurrency() const { return n; }
+        void evaluate_batch(const vector<vector<double>>& p_s, vector<double>& fx) {
+            max_batch = std::max(max_batch, p_s.size());
+            ++n_batches;
+            fx.resize(p_s.size());
+            for (size_t i = 0; i < p_s.size(); ++i) fx[i] = (*this)(p_s[i]);
+        }
+    };
+
+    /** a pt_gs_k region_model of 6 cells in two catchments, with env_ts filled in, ready for run_cells */
+    template <class C>
+    region_model<C> make_region_model(const ta::fixed_dt& ta) {
+        auto cells = make_shared<vector<C>>();
+        for (size_t j = 0; j < 6; ++j) {
+            C c;
+            c.geo = geo_cell_data(geo_point(1000.0*j, 1000.0, 100.0 + 10.0*j), 1000.0*1000.0*(1.0 + 0.1*j), int(j % 2));
+            c.state.kirchner.q = 1.0 + 0.01*j;
+            c.state.gs.acc_melt = 10.0;
+            c.state.gs.sdc_melt_mean = 20.0;
+            c.state.gs.lwc = 0.1;
+            cells->push_back(c);
+        }
+        pt_gs_k::parameter_t p0;
+        region_model<C> rm(cells, p0);
+        rm.initialize_cell_environment(ta);
+        for (size_t j = 0; j < cells->size(); ++j) {
+            auto& c = (*rm.get_cells())[j];
+            for (size_t i = 0; i < ta.size(); ++i) {
+                c.env_ts.temperature.set(i, 1.0 + 5.0*sin(i/24.0) - 0.1*j);
+                c.env_ts.precipitation.set(i, (i + j) % 5 < 2 ? 1.5 : 0.0);
+                c.env_ts.radiation.set(i, 150.0);
+                c.env_ts.rel_hum.set(i, 0.75);
+                c.env_ts.wind_speed.set(i, 2.0);
+            }
+        }
+        return rm;
+    }
+
 } //  shyfttest
 
 TEST_SUITE("calibration") {
@@ -328,6 +376,676 @@ TEST_CASE("test_dummy") {
 }
 
 
+TEST_CASE("test_dummy_batch") {
+    std::vector<double> target = {-5.0,1.0,1.0,1.0};
+    std::vector<double> lower = {-10, 0, 0, 0};
+    std::vector<double> upper = {-4, 2, 2, 2};
+    std::vector<double> x2 = {-9.0, 0.5, 0.9, 0.3};
+    std::vector<double> x3 = {-9.0, 0.5, 0.9, 0.3};
+    shyfttest::TestBatchModel model(target, lower, upper, 3);
+    double residual2 = model_calibration::min_dream(model, x2, 10000);
+    TS_ASSERT_DELTA(residual2, 0.0, 1.0e-1);
+    for (size_t i = 0; i < x2.size(); ++i)
+        TS_ASSERT_DELTA(x2[i], target[i], 0.3);
+    FAST_CHECK_GT(model.n_batches, 0u);
+    FAST_CHECK_EQ(model.max_batch, x2.size());// the initial chains, then up to 3 chains in each batch
+
+    model.max_batch = model.n_batches = 0;
+    double residual3 = model_calibration::min_sceua(model, x3, 10000, 0.001, 0.0001);
+    TS_ASSERT_DELTA(residual3, 0.0, 1.0e-1);
+    for (size_t i = 0; i < x3.size(); ++i)
+        TS_ASSERT_DELTA(x3[i], target[i], 0.02);
+    FAST_CHECK_EQ(model.max_batch, 5*(2*x3.size() + 1));// the initial population, then up to 3 complexes in each batch
+    FAST_CHECK_GT(model.n_batches, 1u);
+}
+
+TEST_CASE("test_pattern_search") {
+    using shyfttest::TestModel;
+    using shyfttest::TestBatchModel;
+    std::vector<double> target = {-5.0,1.0,1.0,1.0};
+    std::vector<double> lower = {-10, 0, 0, 0};
+    std::vector<double> upper = {-4, 2, 2, 2};
+    std::vector<double> x = {-9.0, 0.5, 0.9, 0.3};
+    TestModel model(target, lower, upper);
+    double residual = model_calibration::min_pattern_search(model, x, 2000, 0.1, 1.0e-9);
+    TS_ASSERT_DELTA(residual, 0.0, 1.0e-12);
+    for (size_t i = 0; i < x.size(); ++i)
+        TS_ASSERT_DELTA(x[i], target[i], 1.0e-6);
+
+    shyft::core::optimizer::pattern_search ps;
+    model_calibration::sceua_fx<TestModel> fx(model);
+    std::vector<double> x0 = {-9.0, 0.5, 0.9, 0.3};
+    auto x_s = model.to_scaled(x0);
+    ps.find_min(fx, x_s, 2000, 0.1, 1.0e-9);
+    const size_t n_iterations = ps.n_iterations;
+    for (size_t k : {3, 32}) {// fewer than the poll of 2n points, and enough for the polls of the smaller steps too
+        TestBatchModel batch_model(target, lower, upper, k);
+        model_calibration::sceua_fx<TestBatchModel> fx_k(batch_model);
+        auto xk_s = batch_model.to_scaled(x0);
+        double rk = ps.find_min(fx_k, xk_s, 2000, 0.1, 1.0e-9);
+        TS_ASSERT_DELTA(rk, 0.0, 1.0e-12);
+        FAST_CHECK_EQ(batch_model.n_batches, ps.n_iterations);// one batch for each iteration
+        if (k < 2*x0.size()) {
+            FAST_CHECK_EQ(batch_model.max_batch, 2*x0.size() + 1);// x and the poll, then the pattern point and the poll
+            FAST_CHECK_EQ(ps.n_iterations, n_iterations);// the same path as the sequential search
+        } else {
+            FAST_CHECK_LE(batch_model.max_batch, k);
+            FAST_CHECK_LT(2*ps.n_iterations, n_iterations);// the polls of the smaller steps saves iterations
+        }
+    }
+    std::vector<double> x_bad = {-9.0, 0.5, 0.9, 0.3};
+    CHECK_THROWS_AS(ps.find_min(fx, x_bad, 10, 0.0, 1.0e-5), std::runtime_error);
+    x_s = model.to_scaled(x_bad);
+    ps.find_min(fx, x_s, 10);
+    FAST_CHECK_EQ(ps.n_evaluations, 10u);// the evaluation budget is kept
+}
+
+TEST_CASE("test_optimizer_concurrent_evaluations") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<point_ts<ta::fixed_dt>> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<point_ts<ta::fixed_dt>>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, point_ts<ta::fixed_dt>> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    opt.set_concurrent_evaluations(3);
+    FAST_CHECK_EQ(opt.concurrency(), 3u);
+    auto pv = [](const pt_gs_k::parameter_t& p) { vector<double> r; for (size_t i = 0; i < p.size(); ++i) r.push_back(p.get(i)); return r; };
+    vector<double> p_full = pv(p0);
+    // the sequential goal functions of some scaled parameter sets
+    vector<vector<double>> p_s{{0.1, 0.2}, {0.9, 0.5}, {0.5, 0.5}, {0.3, 0.8}, {0.7, 0.1}};
+    vector<double> fx_expected;
+    opt.prepare_optimize();
+    opt.calculate_goal_function(p_full);// sets the full parameter vector
+    for (const auto& x : p_s) fx_expected.push_back(opt(x));
+    opt.prepare_optimize();// with the replicas, and an empty trace
+    vector<double> fx;
+    opt.evaluate_batch(p_s, fx);
+    FAST_REQUIRE_EQ(fx.size(), p_s.size());
+    FAST_REQUIRE_EQ(opt.trace_size(), int(p_s.size()));
+    for (size_t i = 0; i < p_s.size(); ++i) {
+        FAST_CHECK_EQ(fx[i], doctest::Approx(fx_expected[i]).epsilon(1e-12));
+        FAST_CHECK_EQ(opt.trace_goal_fn(int(i)), fx[i]);
+        auto pi = opt.trace_parameter(int(i));
+        FAST_CHECK_EQ(pi.kirchner.c1, doctest::Approx(-3.0 + p_s[i][0]));
+        FAST_CHECK_EQ(pi.kirchner.c2, doctest::Approx(0.5 + 0.5*p_s[i][1]));
+    }
+    // the optimizers pass the batches through the fx adapters
+    vector<double> x = {-2.5, 0.75};
+    double gf = min_sceua(opt, x, 300, 0.001, 0.001);
+    FAST_CHECK_LE(gf, *std::min_element(fx_expected.begin(), fx_expected.end()));
+    auto p_start = p0;
+    p_start.kirchner.c1 = -2.9; p_start.kirchner.c2 = 0.6;
+    auto p_ps = opt.optimize_pattern_search(p_start, 300);
+    FAST_CHECK_GT(opt.trace_size(), 0);
+    FAST_CHECK_LE(opt.calculate_goal_function(p_ps), *std::min_element(fx_expected.begin(), fx_expected.end()));
+}
+
+TEST_CASE("test_optimizer_remote_evaluations") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef model_calibration::optimizer<model_t, pt_gs_k::parameter_t, point_ts<ta::fixed_dt>> optimizer_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<point_ts<ta::fixed_dt>> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<point_ts<ta::fixed_dt>>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    auto pv = [](const pt_gs_k::parameter_t& p) { vector<double> r; for (size_t i = 0; i < p.size(); ++i) r.push_back(p.get(i)); return r; };
+    vector<double> p_full = pv(p0);
+    vector<vector<double>> p_s{{0.1, 0.2}, {0.9, 0.5}, {0.5, 0.5}, {0.3, 0.8}, {0.7, 0.1}, {0.2, 0.6}, {0.8, 0.9}};
+    // the local goal functions
+    auto rm_local = rm;
+    optimizer_t local(rm_local);
+    local.set_target_specification(targets, p_min, p_max);
+    local.prepare_optimize();
+    local.calculate_goal_function(p_full);
+    vector<double> fx_expected;
+    for (const auto& x : p_s) fx_expected.push_back(local(x));
+    // two workers, each with its own replica of the model and optimizer, as on other nodes
+    auto rm_w1 = rm, rm_w2 = rm;
+    optimizer_t opt_w1(rm_w1), opt_w2(rm_w2);
+    for (auto o : {&opt_w1, &opt_w2}) {
+        o->set_target_specification(targets, p_min, p_max);
+        o->set_concurrent_evaluations(2);
+        o->prepare_optimize();
+    }
+    calibration_worker w1([&opt_w1](const vector<vector<double>>& ps, size_t n) { return opt_w1.evaluate_parameter_sets(ps, n); });
+    calibration_worker w2([&opt_w2](const vector<vector<double>>& ps, size_t n) { return opt_w2.evaluate_parameter_sets(ps, n); });
+    w1.set_listening_ip("127.0.0.1"); w1.set_listening_port(20541); w1.start_async();
+    w2.set_listening_ip("127.0.0.1"); w2.set_listening_port(20542); w2.start_async();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    // and a third worker that is down, so its chunks are re-dispatched to the others
+    calibration_dispatcher d({"127.0.0.1:20541", "127.0.0.1:20542", "127.0.0.1:20543"}, 10000, 2);
+    auto rm_master = rm;
+    optimizer_t opt(rm_master);
+    opt.set_target_specification(targets, p_min, p_max);
+    opt.set_remote_evaluation(std::ref(d), 4);
+    opt.set_evaluation_cache(1e-9);
+    FAST_CHECK_EQ(opt.concurrency(), 4u);
+    opt.prepare_optimize();
+    opt.calculate_goal_function(p_full);// sets the full parameter vector, evaluated locally
+    const int trace_0 = opt.trace_size();
+    vector<double> fx;
+    opt.evaluate_batch(p_s, fx);
+    FAST_REQUIRE_EQ(fx.size(), p_s.size());
+    FAST_CHECK_EQ(opt.trace_size(), trace_0 + int(p_s.size()));
+    for (size_t i = 0; i < p_s.size(); ++i)
+        FAST_CHECK_EQ(fx[i], doctest::Approx(fx_expected[i]).epsilon(1e-12));
+    FAST_CHECK_EQ(w1.n_evaluated + w2.n_evaluated, p_s.size());
+    FAST_CHECK_GE(d.n_redispatched, 1u);
+    FAST_CHECK_EQ(d.n_alive, 2u);
+    // the cached candidates are not sent again
+    const size_t n_evaluated = w1.n_evaluated + w2.n_evaluated;
+    opt.evaluate_batch(p_s, fx);
+    FAST_CHECK_EQ(w1.n_evaluated + w2.n_evaluated, n_evaluated);
+    // a worker evaluation that fails is passed to the caller, and a batch without workers throws
+    calibration_worker w_bad([](const vector<vector<double>>&, size_t) -> vector<double> { throw runtime_error("bad model"); });
+    w_bad.set_listening_ip("127.0.0.1"); w_bad.set_listening_port(20544); w_bad.start_async();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    calibration_dispatcher d_bad({"127.0.0.1:20544"}, 10000);
+    CHECK_THROWS_AS(d_bad(p_s, 0), runtime_error);
+    calibration_dispatcher d_none({"127.0.0.1:20543"}, 1000);
+    CHECK_THROWS_AS(d_none(p_s, 0), runtime_error);
+    w1.clear(); w2.clear(); w_bad.clear();
+}
+
+TEST_CASE("test_optimizer_catchment_sums") {
+    // the calibration fast path, cells adding directly to catchment sums, gives the same goal functions as the per cell series
+    using namespace shyft::core::model_calibration;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<pt_gs_k::cell_discharge_response_t>(ta);
+    auto cm = shyfttest::make_region_model<pt_gs_k::cell_catchment_response_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    vector<target_specification<ts_t>> targets;
+    ta::fixed_dt ta_daily(ta.time(0), deltahours(24), 5);
+    auto obs = [&ta_daily](double a, double b) { ts_t r(ta_daily, 0.0, POINT_AVERAGE_VALUE); for (size_t i = 0; i < ta_daily.size(); ++i) r.set(i, a + b*i); return r; };
+    targets.emplace_back(obs(2.0, 0.3), vector<int>{0, 1}, 1.0, NASH_SUTCLIFFE);
+    targets.emplace_back(obs(1.0, 0.1), vector<int>{1}, 0.5, KLING_GUPTA);
+    targets.emplace_back(obs(0.9, -0.1), vector<int>{0, 1}, 0.5, NASH_SUTCLIFFE, 1.0, 1.0, 1.0, SNOW_COVERED_AREA);
+    targets.emplace_back(obs(20.0, -1.0), vector<int>{0}, 0.5, RMSE, 1.0, 1.0, 1.0, SNOW_WATER_EQUIVALENT);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.gs.tx = -1.0; p_max.gs.tx = 1.0;
+    model_calibration::optimizer<region_model<pt_gs_k::cell_discharge_response_t>, pt_gs_k::parameter_t, ts_t> r_opt(rm);
+    model_calibration::optimizer<region_model<pt_gs_k::cell_catchment_response_t>, pt_gs_k::parameter_t, ts_t> c_opt(cm);
+    r_opt.set_target_specification(targets, p_min, p_max);
+    c_opt.set_target_specification(targets, p_min, p_max);
+    r_opt.prepare_optimize();
+    c_opt.prepare_optimize();
+    for (auto tx : {-0.5, 0.0, 0.7}) {
+        auto p = p0;
+        p.gs.tx = tx;
+        double r_gf = r_opt.calculate_goal_function(p);
+        double c_gf = c_opt.calculate_goal_function(p);
+        FAST_CHECK_UNARY(std::isfinite(r_gf));
+        FAST_CHECK_EQ(c_gf, doctest::Approx(r_gf).epsilon(1e-9));
+    }
+}
+
+TEST_CASE("test_optimizer_early_termination") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    ta::fixed_dt ta_daily(ta.time(0), deltahours(24), 5);
+    auto daily = [&ta_daily](const ts_t& ts) { ts_t r(ta_daily, 0.0, POINT_AVERAGE_VALUE); average_accessor<ts_t, ta::fixed_dt> a(ts, ta_daily); for (size_t i = 0; i < ta_daily.size(); ++i) r.set(i, a.value(i)); return r; };
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    targets.emplace_back(daily(q[1]), vector<int>{1}, 0.5, RMSE);
+    targets.emplace_back(daily(q[1]), vector<int>{1}, 0.2, ABS_DIFF);
+    targets.emplace_back(daily(q[0]), vector<int>{0}, 0.3, KLING_GUPTA);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    FAST_CHECK_EQ(opt.early_termination(), 0u);
+    vector<vector<double>> p_s{{0.1, 0.2}, {0.9, 0.5}, {0.3, 0.8}};
+    vector<double> fx_full;
+    opt.prepare_optimize();
+    opt.calculate_goal_function(p0);// sets the full parameter vector
+    for (const auto& x : p_s) fx_full.push_back(opt(x));
+    opt.set_early_termination(4);
+    opt.prepare_optimize();
+    for (size_t i = 0; i < p_s.size(); ++i) {
+        // runs in segments that are not stopped give the goal function of the complete run
+        vector<double> fx;
+        const double no_bound = shyft::nan;
+        opt.evaluate_batch_bounded(vector<vector<double>>(4, p_s[i]), vector<double>{no_bound, fx_full[i] + 1.0, 0.0, 0.5*fx_full[i]}, fx);
+        FAST_REQUIRE_EQ(fx.size(), 4u);
+        FAST_CHECK_EQ(fx[0], doctest::Approx(fx_full[i]).epsilon(1e-12));
+        FAST_CHECK_EQ(fx[1], doctest::Approx(fx_full[i]).epsilon(1e-12));
+        // stopped runs give a lower bound, above the bound passed
+        FAST_CHECK_GT(fx[2], 0.0);
+        FAST_CHECK_LE(fx[2], fx_full[i]);
+        FAST_CHECK_GT(fx[3], 0.5*fx_full[i]);
+        FAST_CHECK_LE(fx[3], fx_full[i]);
+    }
+    // sceua finds the same optimum, with fewer complete runs
+    opt.set_early_termination(0);
+    opt.goal_fn_trace.clear();
+    vector<double> x_full = {-2.5, 0.75};
+    double gf_full = min_sceua(opt, x_full, 300, 0.001, 0.001);
+    const vector<double> trace_full = opt.goal_fn_trace;
+    opt.goal_fn_trace.clear();
+    opt.set_early_termination(4);
+    vector<double> x_early = {-2.5, 0.75};
+    double gf_early = min_sceua(opt, x_early, 300, 0.001, 0.001);
+    FAST_REQUIRE_EQ(opt.goal_fn_trace.size(), trace_full.size());
+    size_t n_stopped = 0;// the stopped candidates have a lower bound in the trace
+    for (size_t i = 0; i < trace_full.size(); ++i) {
+        FAST_CHECK_LE(opt.goal_fn_trace[i], trace_full[i]*(1 + 1e-12));
+        if (opt.goal_fn_trace[i] < trace_full[i]*(1 - 1e-12)) ++n_stopped;
+    }
+    FAST_CHECK_GT(n_stopped, 0u);
+    FAST_CHECK_EQ(gf_early, doctest::Approx(gf_full).epsilon(1e-12));
+    FAST_REQUIRE_EQ(x_early.size(), x_full.size());
+    for (size_t i = 0; i < x_full.size(); ++i)
+        FAST_CHECK_EQ(x_early[i], doctest::Approx(x_full[i]).epsilon(1e-12));
+}
+
+TEST_CASE("test_aligned_target") {
+    // the aligned target periods give the same simulated averages as the average_accessor, also for unaligned periods
+    using namespace shyft::core::model_calibration;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 50);
+    ts_t sim(ta, 0.0, POINT_AVERAGE_VALUE);
+    for (size_t i = 0; i < ta.size(); ++i) sim.set(i, i % 7 == 3 ? shyft::nan : 1.0 + 0.1*i);
+    for (auto t_dt : vector<pair<utctimespan, utctimespan>>{{0, deltahours(24)}, {-deltaminutes(90), deltahours(5)}, {0, deltahours(1)}, {deltaminutes(30), deltaminutes(45)}}) {
+        ta::fixed_dt tta(ta.time(0) + t_dt.first, t_dt.second, size_t(deltahours(60)/t_dt.second));// extends beyond the model time-axis
+        ts_t obs(tta, 1.0, POINT_AVERAGE_VALUE);
+        obs.set(1, shyft::nan);
+        aligned_target a(obs, ta);
+        FAST_REQUIRE_EQ(a.size(), tta.size() - 1);
+        vector<double> s;
+        a.simulated(sim.v, a.size(), s);
+        average_accessor<ts_t, ta::fixed_dt> expected(sim, tta);
+        for (size_t i = 0, j = 0; i < tta.size(); ++i) {
+            if (i == 1) continue;
+            FAST_CHECK_EQ(a.end[j], tta.period(i).end);
+            if (isfinite(expected.value(i)))
+                FAST_CHECK_EQ(s[j], doctest::Approx(expected.value(i)).epsilon(1e-15));
+            else
+                FAST_CHECK_UNARY_FALSE(isfinite(s[j]));
+            ++j;
+        }
+    }
+}
+
+TEST_CASE("test_rbf_surrogate") {
+    using shyft::core::optimizer::rbf_surrogate;
+    auto f = [](const vector<double>& x) { return (x[0] - 0.3)*(x[0] - 0.3) + 2.0*(x[1] - 0.6)*(x[1] - 0.6); };
+    vector<vector<double>> xs;
+    vector<double> fs;
+    for (size_t j = 0; j < 40; ++j) {
+        vector<double> x{std::fmod(0.618034*j, 1.0), std::fmod(0.414214*j + 0.1, 1.0)};// low discrepancy points in [0..1]^2
+        xs.push_back(x);
+        fs.push_back(f(x));
+    }
+    rbf_surrogate s;
+    FAST_CHECK_UNARY_FALSE(s.valid());
+    FAST_CHECK_UNARY_FALSE(s.fit(vector<vector<double>>(xs.begin(), xs.begin() + 3), vector<double>(fs.begin(), fs.begin() + 3)));// n + 2 samples needed
+    FAST_REQUIRE_UNARY(s.fit(xs, fs));
+    FAST_CHECK_EQ(s.size(), 40u);
+    FAST_CHECK_EQ(s.dimension(), 2u);
+    for (size_t j = 0; j < xs.size(); ++j)
+        FAST_CHECK_EQ(s(xs[j]), doctest::Approx(fs[j]).epsilon(1e-6));
+    for (auto x : vector<vector<double>>{{0.3, 0.6}, {0.5, 0.5}, {0.15, 0.85}})
+        FAST_CHECK_LT(std::fabs(s(x) - f(x)), 0.02);
+    // repeated points and nans are skipped
+    xs.push_back(xs[0]); fs.push_back(fs[0]);
+    xs.push_back({0.5, 0.25}); fs.push_back(shyft::nan);
+    FAST_REQUIRE_UNARY(s.fit(xs, fs));
+    FAST_CHECK_EQ(s.size(), 40u);
+}
+
+TEST_CASE("test_optimizer_surrogate_screening") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    opt.prepare_optimize();
+    opt.calculate_goal_function(p0);// sets the full parameter vector
+    const vector<double> x0 = {-2.9, 0.55};
+    vector<double> x_full = x0;
+    opt.prepare_optimize();
+    double gf_full = min_sceua(opt, x_full, 400, 0.001, 0.001);
+    const size_t n_full = opt.goal_fn_trace.size();
+    FAST_CHECK_EQ(opt.surrogate_screened(), 0u);
+
+    opt.set_surrogate_screening(20, 0.1);
+    opt.prepare_optimize();
+    vector<double> x_screened = x0;
+    double gf_screened = min_sceua(opt, x_screened, 400, 0.001, 0.001);
+    FAST_CHECK_GT(opt.surrogate_screened(), 0u);
+    FAST_CHECK_LT(opt.goal_fn_trace.size(), n_full);// fewer model runs
+    FAST_CHECK_LT(gf_screened, 0.01);// the true parameters are still found
+    FAST_CHECK_LT(gf_full, 0.01);
+    FAST_CHECK_EQ(x_screened[0], doctest::Approx(p0.kirchner.c1).epsilon(0.05));
+
+    opt.set_surrogate_screening(0);
+    opt.prepare_optimize();
+    vector<double> x_off = x0;
+    FAST_CHECK_EQ(min_sceua(opt, x_off, 400, 0.001, 0.001), gf_full);// off is as before
+    FAST_CHECK_EQ(opt.surrogate_screened(), 0u);
+}
+
+TEST_CASE("test_optimizer_evaluation_cache") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    opt.prepare_optimize();
+    opt.calculate_goal_function(p0);// sets the full parameter vector
+    const vector<double> x0 = {-2.9, 0.55};
+    vector<double> x_full = x0;
+    opt.prepare_optimize();
+    double gf_full = min_sceua(opt, x_full, 400, 0.001, 0.001);
+    const size_t n_full = opt.goal_fn_trace.size();
+    FAST_CHECK_EQ(opt.evaluation_cache_misses(), 0u);// off
+
+    CHECK_THROWS_AS(opt.set_evaluation_cache(-1.0), std::runtime_error);
+    opt.set_evaluation_cache(1e-9);
+    opt.prepare_optimize();
+    vector<double> fx;
+    opt.evaluate_batch(vector<vector<double>>{{0.1, 0.2}, {0.7, 0.4}}, fx);
+    FAST_CHECK_EQ(opt.evaluation_cache_misses(), 2u);
+    FAST_CHECK_EQ(opt.evaluation_cache_size(), 2u);
+    vector<double> fx2;
+    opt.evaluate_batch(vector<vector<double>>{{0.7, 0.4 + 1e-12}, {0.1, 0.2}}, fx2);
+    FAST_CHECK_EQ(opt.evaluation_cache_hits(), 2u);
+    FAST_CHECK_EQ(opt.goal_fn_trace.size(), 2u);// not run again
+    FAST_CHECK_EQ(fx2[0], fx[1]);
+    FAST_CHECK_EQ(fx2[1], fx[0]);
+    FAST_CHECK_EQ(opt(vector<double>{0.1, 0.2}), fx[0]);
+    FAST_CHECK_EQ(opt.evaluation_cache_hits(), 3u);
+
+    opt.prepare_optimize();
+    FAST_CHECK_EQ(opt.evaluation_cache_size(), 0u);
+    vector<double> x_cached = x0;
+    FAST_CHECK_EQ(min_sceua(opt, x_cached, 400, 0.001, 0.001), gf_full);// the same search
+    FAST_CHECK_EQ(opt.goal_fn_trace.size() + opt.evaluation_cache_hits(), n_full);
+    FAST_CHECK_EQ(opt.evaluation_cache_misses(), opt.goal_fn_trace.size());
+}
+
+TEST_CASE("test_optimizer_staged") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    auto p_start = p0;
+    p_start.kirchner.c1 = -2.9; p_start.kirchner.c2 = 0.55;
+    CHECK_THROWS_AS(opt.optimize_staged(p_start, vector<calibration_stage>{}), std::runtime_error);
+    CHECK_THROWS_AS(opt.optimize_staged(p_start, vector<calibration_stage>{calibration_stage(deltahours(2), deltahours(3), SCEUA, 100)}), std::runtime_error);
+    FAST_CHECK_EQ(opt.targets[0].ts.size(), q[0].size());// restored after the failure
+
+    vector<calibration_stage> stages{
+        calibration_stage(deltahours(48), deltahours(6), SCEUA, 400),// two days, 6h targets
+        calibration_stage(0, 0, SCEUA, 400)// refined on the full period
+    };
+    auto r = opt.optimize_staged(p_start, stages);
+    FAST_CHECK_EQ(r.kirchner.c1, doctest::Approx(p0.kirchner.c1).epsilon(0.02));
+    FAST_CHECK_EQ(r.kirchner.c2, doctest::Approx(p0.kirchner.c2).epsilon(0.02));
+    FAST_CHECK_LT(opt.calculate_goal_function(r), 0.001);
+    FAST_REQUIRE_EQ(opt.targets.size(), 1u);
+    FAST_CHECK_EQ(opt.targets[0].ts.size(), q[0].size());
+    FAST_CHECK_EQ(opt.warm_start_size(), 0u);
+}
+
+TEST_CASE("test_epsilon_archive") {
+    using shyft::core::optimizer::epsilon_archive;
+    CHECK_THROWS_AS(epsilon_archive(vector<double>{0.1, 0.0}), std::runtime_error);
+    epsilon_archive a(vector<double>{0.1, 0.1});
+    FAST_CHECK_UNARY(a.add({0.0}, {0.55, 0.55}));
+    FAST_CHECK_UNARY_FALSE(a.add({1.0}, {0.65, 0.75}));// box dominated
+    FAST_CHECK_UNARY(a.add({2.0}, {0.51, 0.51}));// same box, closer to the corner
+    FAST_CHECK_EQ(a.size(), 1u);
+    FAST_CHECK_EQ(a.x()[0][0], 2.0);
+    FAST_CHECK_UNARY(a.add({3.0}, {0.15, 0.95}));// a trade-off
+    FAST_CHECK_UNARY(a.add({4.0}, {0.95, 0.15}));
+    FAST_CHECK_UNARY_FALSE(a.add({5.0}, {shyft::nan, 0.0}));
+    FAST_CHECK_EQ(a.size(), 3u);
+    FAST_CHECK_UNARY(a.add({6.0}, {0.12, 0.12}));// dominates all the others
+    FAST_REQUIRE_EQ(a.size(), 1u);
+    FAST_CHECK_EQ(a.x()[0][0], 6.0);
+}
+
+TEST_CASE("test_optimizer_pareto") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q_a, q_b;
+    rm.catchment_discharges(q_a);
+    auto p1 = p0;
+    p1.kirchner.c1 = p0.kirchner.c1 + 0.3;// a second, conflicting, target
+    rm.set_region_parameter(p1);
+    rm.revert_to_initial_state();
+    rm.run_cells();
+    rm.catchment_discharges(q_b);
+    rm.set_region_parameter(p0);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q_a[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    targets.emplace_back(q_b[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    CHECK_THROWS_AS(opt.optimize_pareto(p0, 10, vector<double>{0.01, 0.01, 0.01}), std::runtime_error);
+    auto n = opt.optimize_pareto(p0, 400, vector<double>{0.002}, 20);
+    FAST_CHECK_EQ(opt.goal_fn_trace.size(), 400u);
+    FAST_REQUIRE_UNARY(n > 2u);
+    FAST_REQUIRE_EQ(opt.pareto_goal_functions.size(), n);
+    double f_a = 1.0, f_b = 1.0;
+    for (size_t i = 0; i < n; ++i) {
+        const auto& f = opt.pareto_goal_functions[i];
+        f_a = std::min(f_a, f[0]);
+        f_b = std::min(f_b, f[1]);
+        for (size_t j = 0; j < n; ++j)
+            FAST_CHECK_UNARY_FALSE(shyft::core::optimizer::epsilon_archive::dominates(opt.pareto_goal_functions[j], f));
+        // the front follows c1 between the two truths
+        FAST_CHECK_GE(opt.pareto_parameters[i].kirchner.c1, p0.kirchner.c1 - 0.05);
+        FAST_CHECK_LE(opt.pareto_parameters[i].kirchner.c1, p1.kirchner.c1 + 0.05);
+    }
+    FAST_CHECK_LT(f_a, 0.01);// both ends of the trade-off
+    FAST_CHECK_LT(f_b, 0.01);
+    FAST_CHECK_EQ(opt.calculate_goal_function(opt.pareto_parameters[0]),
+                  doctest::Approx(0.5*(opt.pareto_goal_functions[0][0] + opt.pareto_goal_functions[0][1])));
+}
+
+TEST_CASE("test_calibration_batch") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    const size_t n_jobs = 4;
+    vector<unique_ptr<model_t>> models;
+    for (size_t i = 0; i < n_jobs; ++i)
+        models.emplace_back(new model_t(shyfttest::make_region_model<cell_t>(ta)));
+    calibration_batch<model_t, pt_gs_k::parameter_t, ts_t> b;
+    vector<double> c1_start = {-2.9, -2.1, -2.5, -2.2};
+    for (size_t i = 0; i < n_jobs; ++i) {
+        auto p_start = p0;
+        p_start.kirchner.c1 = c1_start[i];
+        p_start.kirchner.c2 = 0.55;
+        b.add_job(*models[i], targets, p_min, p_max, p_start, SCEUA, 400);
+    }
+    CHECK_THROWS_AS(b.add_job(*models[0], targets, p_min, p_max, p0, SCEUA), runtime_error);// models are not shared
+    FAST_REQUIRE_EQ(b.size(), n_jobs);
+    b.cancel(2);// a pending job is skipped
+    FAST_CHECK_EQ(b.status(2), CANCELLED);
+    b.run(2);
+    for (auto i : {size_t(0), size_t(1), size_t(3)}) {
+        FAST_CHECK_EQ(b.status(i), DONE);
+        FAST_CHECK_EQ(b.error(i), string());
+        FAST_CHECK_GT(b.n_evaluations(i), 0u);
+        FAST_CHECK_EQ(b.n_evaluations(i), b.get_optimizer(i)->goal_fn_trace.size() - 1);// + the final goal function
+        FAST_CHECK_EQ(b.goal_function(i), doctest::Approx(b.get_optimizer(i)->goal_fn_trace.back()));
+        FAST_CHECK_LE(b.result(i).kirchner.c1, p_max.kirchner.c1);
+        FAST_CHECK_GE(b.result(i).kirchner.c1, p_min.kirchner.c1);
+        FAST_CHECK_LT(b.goal_function(i), 0.01);
+        FAST_CHECK_EQ(b.result(i).kirchner.c1, doctest::Approx(p0.kirchner.c1).epsilon(0.05));
+    }
+    FAST_CHECK_EQ(b.n_evaluations(2), 0u);
+    CHECK(std::isnan(b.goal_function(2)));
+    FAST_CHECK_LT(b.best(), n_jobs);
+    FAST_CHECK_NE(b.best(), 2u);
+
+    // the same sceua job alone gives the same result, so the jobs do not interfere
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    auto p_start = p0;
+    p_start.kirchner.c1 = c1_start[0];
+    p_start.kirchner.c2 = 0.55;
+    auto r = opt.optimize_sceua(p_start, 400);
+    FAST_CHECK_EQ(r.kirchner.c1, doctest::Approx(b.result(0).kirchner.c1).epsilon(1e-12));
+    FAST_CHECK_EQ(r.kirchner.c2, doctest::Approx(b.result(0).kirchner.c2).epsilon(1e-12));
+
+    // a running job is stopped at the next evaluation after cancel, here dream, that runs until its chains converge
+    calibration_batch<model_t, pt_gs_k::parameter_t, ts_t> c;
+    c.add_job(*models[0], targets, p_min, p_max, p0, DREAM, 1000000);
+    thread canceller([&c]() {
+        while (c.n_evaluations(0) < 10)
+            this_thread::yield();
+        c.cancel(0);
+    });
+    c.run();
+    canceller.join();
+    FAST_CHECK_EQ(c.status(0), CANCELLED);
+    FAST_CHECK_LT(c.n_evaluations(0), 1000000u);
+}
+
+TEST_CASE("test_optimizer_warm_start") {
+    using namespace shyft::core::model_calibration;
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    typedef region_model<cell_t> model_t;
+    typedef point_ts<ta::fixed_dt> ts_t;
+    calendar cal;
+    ta::fixed_dt ta(cal.time(2016, 1, 1), deltahours(1), 24*5);
+    auto rm = shyfttest::make_region_model<cell_t>(ta);
+    pt_gs_k::parameter_t p0 = rm.get_region_parameter();
+    rm.run_cells();
+    vector<ts_t> q;
+    rm.catchment_discharges(q);
+    vector<target_specification<ts_t>> targets;
+    targets.emplace_back(q[0], vector<int>{0}, 1.0, NASH_SUTCLIFFE);
+    auto p_min = p0, p_max = p0;
+    p_min.kirchner.c1 = -3.0; p_max.kirchner.c1 = -2.0;
+    p_min.kirchner.c2 = 0.5; p_max.kirchner.c2 = 1.0;
+    model_calibration::optimizer<model_t, pt_gs_k::parameter_t, ts_t> opt(rm);
+    opt.set_target_specification(targets, p_min, p_max);
+    auto p_start = p0;
+    p_start.kirchner.c1 = -2.9;
+    p_start.kirchner.c2 = 0.55;
+    auto r_cold = opt.optimize_sceua(p_start, 1500, 0.001, 0.001);
+    const size_t n_cold = opt.goal_fn_trace.size();
+    const auto ps = opt.parameters_trace;
+    const auto fs = opt.goal_fn_trace;
+    FAST_CHECK_EQ(opt.warm_start_size(), 0u);
+    CHECK_THROWS_AS(opt.set_warm_start(ps, vector<double>(1, 0.0)), runtime_error);
+    // re-calibration, with unchanged model and targets, so the goal function values can be reused
+    opt.set_warm_start_from_trace(true);
+    FAST_CHECK_EQ(opt.warm_start_size(), n_cold);
+    auto r_warm = opt.optimize_sceua(p_start, 1500, 0.001, 0.001);
+    FAST_CHECK_LT(opt.goal_fn_trace.size(), n_cold);
+    FAST_CHECK_LT(opt.calculate_goal_function(r_warm), 0.01);
+    FAST_CHECK_EQ(r_warm.kirchner.c1, doctest::Approx(r_cold.kirchner.c1).epsilon(0.05));
+    // without the values, the picked points are run again, still warm
+    opt.set_warm_start(ps, fs);
+    auto r_rerun = opt.optimize_sceua(p_start, 1500, 0.001, 0.001);
+    FAST_CHECK_LT(opt.calculate_goal_function(r_rerun), 0.01);
+    opt.clear_warm_start();
+    FAST_CHECK_EQ(opt.warm_start_size(), 0u);
+}
+
 TEST_CASE("test_simple") {
     using namespace shyft::core::model_calibration;
     // Make a simple model setup
@@ -98,6 +98,69 @@ TEST_CASE("cell_builder_test::test_read_geo_region_data_from_files") {
 
 }
 
+TEST_CASE("cell_builder_test::test_geo_cell_data_computer") {
+	using namespace shyft::experimental;
+	using namespace shyft::experimental::io;
+	namespace ec = shyft::core;
+	auto square = [](double x0, double y0, double x1, double y1) {
+		polygon p;
+		geo::convert(box(point_xy(x0, y0), point_xy(x1, y1)), p);
+		return p;
+	};
+	region_grid grid(point_xy(0.0, 0.0), 6, 4, 1000.0, 1000.0);
+	multi_polygon catchm{ square(500.0, 0.0, 5500.0, 3000.0) };
+	multi_polygon forest{ square(0.0, 0.0, 1000.0, 1000.0), square(2000.0, 0.0, 2500.0, 4000.0), square(5000.0, 2000.0, 6000.0, 3000.0) };
+	multi_polygon lake{ square(3000.0, 1000.0, 3250.0, 1500.0) };
+	multi_polygon none;
+	auto equal = [](const vector<ec::geo_cell_data>& a, const vector<ec::geo_cell_data>& b) {// field by field, exact
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); ++i) {
+			const auto& fa = a[i].land_type_fractions_info();
+			const auto& fb = b[i].land_type_fractions_info();
+			if (!(a[i].mid_point() == b[i].mid_point()) || a[i].area() != b[i].area() || a[i].catchment_id() != b[i].catchment_id()
+				|| a[i].radiation_slope_factor() != b[i].radiation_slope_factor() || a[i].routing.id != b[i].routing.id || a[i].routing.distance != b[i].routing.distance
+				|| fa.glacier() != fb.glacier() || fa.lake() != fb.lake() || fa.reservoir() != fb.reservoir() || fa.forest() != fb.forest())
+				return false;
+		}
+		return true;
+	};
+	geo_cell_data_computer region;
+
+	auto gcd = region.catchment_geo_cell_data(grid, 7, 0.9, catchm, none, lake, none, forest);
+
+	TS_ASSERT_EQUALS(gcd.size(), 6u*3u);// the catchment covers 6x3 cells, the first and last column by half
+	double a = 0.0, fa = 0.0, la = 0.0;
+	for (const auto& g : gcd) {
+		a += g.area();
+		fa += g.area()*g.land_type_fractions_info().forest();
+		la += g.area()*g.land_type_fractions_info().lake();
+		TS_ASSERT_EQUALS(g.catchment_id(), 7u);
+	}
+	TS_ASSERT_DELTA(a, 5000.0*3000.0, 1e-3);
+	TS_ASSERT_DELTA(fa, 500.0*1000.0 + 500.0*3000.0 + 500.0*1000.0, 1e-3);
+	TS_ASSERT_DELTA(la, 250.0*500.0, 1e-3);
+	TS_ASSERT_EQUALS(region.area_errors.load(), 0);
+	for (size_t k = 1; k < gcd.size(); ++k) // grid (i,j) order
+		TS_ASSERT(gcd[k - 1].mid_point().x < gcd[k].mid_point().x || (gcd[k - 1].mid_point().x == gcd[k].mid_point().x && gcd[k - 1].mid_point().y < gcd[k].mid_point().y));
+	auto gcd1 = region.catchment_geo_cell_data(grid, 7, 0.9, catchm, none, lake, none, forest, 1);
+	TS_ASSERT(equal(gcd1, gcd));
+
+	// the flat file keeps the cells as computed
+	auto fn = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("gcd_%%%%-%%%%.bin")).string();
+	vector<ec::geo_cell_data> rgcd;
+	TS_ASSERT(!read_geo_cell_data(fn, rgcd));
+	gcd[3].routing = ec::routing_info(12, 345.0);
+	gcd[3].catchment_ix = 2;
+	write_geo_cell_data(fn, gcd);
+	TS_ASSERT(read_geo_cell_data(fn, rgcd));
+	TS_ASSERT(equal(rgcd, gcd));
+	TS_ASSERT_EQUALS(rgcd[3].catchment_ix, 2u);
+	TS_ASSERT_DELTA(rgcd[5].radiation_slope_factor(), 0.9, 1e-12);
+	boost::filesystem::resize_file(fn, boost::filesystem::file_size(fn) - 1);
+	TS_ASSERT_THROWS_ANYTHING(read_geo_cell_data(fn, rgcd));
+	boost::filesystem::remove(fn);
+}
+
 TEST_CASE("cell_builder_test::test_read_geo_point_map") {
 	using namespace shyft::experimental;
 	using namespace shyfttest;
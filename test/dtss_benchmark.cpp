@@ -0,0 +1,269 @@
+/** \brief dtss load test, latency percentiles and throughput of concurrent clients against an in-process server
+ *
+ * Starts a server on localhost, with a container of synthetic series, stored by one client, then runs
+ * the clients concurrently for the given seconds, each doing requests of batch series drawn at random,
+ * in the proportions of mix, and reports count, requests/s, series/s, p50, p99 and max latency for each kind.
+ *
+ * usage: dtss_benchmark [series=1000] [points=8760] [axis=fixed] [clients=8] [seconds=10] [batch=10]
+ *                       [mix=read:4,evaluate:3,percentiles:1,store:1,merge:1] [cache=1] [port=20100] [seed=1]
+ *        axis is fixed, calendar or point, the hourly time-axis of the series
+ *        mix is kind:weight, of read, evaluate (average to days of 2*a+b), percentiles (to days), store (overwrite) and merge (last day)
+ *        cache=1 lets the requests use and update the server cache, cache=0 reads and writes the container only
+ *
+ * The random draws of each client are seeded by seed and the client number, so a run is repeatable,
+ * but the interleaving of the clients, and so the cache contents, are not.
+ * The container is made in a fresh temporary directory, removed at exit.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include "core/dtss.h"
+#include "core/dtss_client.h"
+
+using namespace std;
+using namespace shyft::core;
+using namespace shyft::dtss;
+namespace fs = boost::filesystem;
+
+namespace {
+    const char* kinds[] = { "read", "evaluate", "percentiles", "store", "merge" };
+    constexpr size_t n_kinds = 5;
+
+    struct options {
+        size_t series = 1000;
+        size_t points = 8760;
+        string axis = "fixed";
+        size_t clients = 8;
+        size_t seconds = 10;
+        size_t batch = 10;
+        vector<double> mix{ 4, 3, 1, 1, 1 };
+        bool cache = true;
+        int port = 20100;
+        size_t seed = 1;
+    };
+
+    vector<double> parse_mix(const string& m) {
+        vector<double> w(n_kinds, 0.0);
+        size_t b = 0;
+        while (b < m.size()) {
+            auto e = m.find(',', b);
+            if (e == string::npos) e = m.size();
+            const string kv = m.substr(b, e - b);
+            const auto c = kv.find(':');
+            if (c == string::npos)
+                throw runtime_error("expected kind:weight in mix, got " + kv);
+            const auto k = find(begin(kinds), end(kinds), kv.substr(0, c));
+            if (k == end(kinds))
+                throw runtime_error("unknown kind in mix " + kv.substr(0, c));
+            w[size_t(k - begin(kinds))] = std::stod(kv.substr(c + 1));
+            b = e + 1;
+        }
+        return w;
+    }
+
+    options parse(int argc, char* argv[]) {
+        options o;
+        for (int i = 1; i < argc; ++i) {
+            string a(argv[i]);
+            auto eq = a.find('=');
+            if (eq == string::npos)
+                throw runtime_error("expected key=value, got " + a);
+            string k = a.substr(0, eq), v = a.substr(eq + 1);
+            if (k == "axis") { o.axis = v; continue; }
+            if (k == "mix") { o.mix = parse_mix(v); continue; }
+            size_t n = size_t(std::stoul(v));
+            if (k == "series") o.series = n;
+            else if (k == "points") o.points = n;
+            else if (k == "clients") o.clients = n;
+            else if (k == "seconds") o.seconds = n;
+            else if (k == "batch") o.batch = n;
+            else if (k == "cache") o.cache = n != 0;
+            else if (k == "port") o.port = int(n);
+            else if (k == "seed") o.seed = n;
+            else throw runtime_error("unknown option " + k);
+        }
+        if (o.axis != "fixed" && o.axis != "calendar" && o.axis != "point")
+            throw runtime_error("axis must be fixed, calendar or point");
+        if (o.series == 0 || o.points < 48 || o.clients == 0 || o.batch == 0 || o.batch > o.series)
+            throw runtime_error("require series > 0, points >= 48, clients > 0 and 0 < batch <= series");
+        double w = 0.0;
+        for (auto x : o.mix) w += x;
+        if (!(w > 0.0))
+            throw runtime_error("the mix must have a positive weight");
+        return o;
+    }
+
+    const utctime t0 = calendar().time(2000, 1, 1);
+    const utctimespan dt = deltahours(1);
+
+    gta_t make_ta(const options& o, utctime t, size_t n) {
+        if (o.axis == "calendar")
+            return gta_t(make_shared<calendar>(), t, dt, n);
+        if (o.axis == "point") {
+            vector<utctime> tp; tp.reserve(n);
+            for (size_t i = 0; i < n; ++i) tp.push_back(t + utctimespan(i)*dt);
+            return gta_t(tp, t + utctimespan(n)*dt);
+        }
+        return gta_t(t, dt, n);
+    }
+
+    string ts_url(size_t i) { return shyft_url("bench", "s" + std::to_string(i)); }
+
+    apoint_ts make_ts(const gta_t& ta, size_t i, double offset) {
+        vector<double> v(ta.size());
+        for (size_t j = 0; j < v.size(); ++j) v[j] = offset + double(i%100) + std::sin(0.01*double(j));
+        return apoint_ts(ta, std::move(v), shyft::time_series::POINT_AVERAGE_VALUE);
+    }
+
+    /** the latencies, in seconds, and the series, of each kind of one client */
+    struct client_result {
+        vector<double> latency[n_kinds];
+        size_t series[n_kinds] = {};
+        size_t failures = 0;
+        string first_failure;
+    };
+
+    void run_client(const options& o, size_t ci, chrono::steady_clock::time_point deadline, client_result& r) {
+        mt19937_64 rng(o.seed*1000003u + ci);
+        discrete_distribution<size_t> pick_kind(o.mix.begin(), o.mix.end());
+        uniform_int_distribution<size_t> pick_id(0, o.series - 1);
+        const auto ta = make_ta(o, t0, o.points);
+        const auto p = ta.total_period();
+        const gta_t days(t0, deltahours(24), o.points/24);
+        const auto last_day = make_ta(o, t0 + utctimespan(o.points - 24)*dt, 24);
+        const vector<int64_t> pct{ 10, 50, 90 };
+        client c("localhost:" + std::to_string(o.port));
+        while (chrono::steady_clock::now() < deadline) {
+            const size_t k = pick_kind(rng);
+            vector<size_t> ids; ids.reserve(o.batch);
+            while (ids.size() < o.batch) {// distinct, as merge requires
+                const auto id = pick_id(rng);
+                if (find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(id);
+            }
+            ts_vector_t tsv; tsv.reserve(o.batch);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                switch (k) {
+                case 0: tsv.push_back(apoint_ts(ts_url(ids[i]))); break;
+                case 1: tsv.push_back((2.0*apoint_ts(ts_url(ids[i])) + apoint_ts(ts_url(ids[(i + 1)%ids.size()]))).average(days)); break;
+                case 2: tsv.push_back(apoint_ts(ts_url(ids[i]))); break;
+                case 3: tsv.push_back(apoint_ts(ts_url(ids[i]), make_ts(ta, ids[i], double(rng()%10)))); break;
+                default: tsv.push_back(apoint_ts(ts_url(ids[i]), make_ts(last_day, ids[i], double(rng()%10)))); break;
+                }
+            }
+            const auto t = chrono::steady_clock::now();
+            try {
+                switch (k) {
+                case 0: case 1: c.evaluate(tsv, p, o.cache, o.cache); break;
+                case 2: c.percentiles(tsv, p, days, pct, o.cache, o.cache); break;
+                case 3: c.store_ts(tsv, true, o.cache); break;
+                default: c.merge_store_ts(tsv, o.cache); break;
+                }
+            } catch (const exception& e) {
+                if (r.failures++ == 0) r.first_failure = e.what();
+                c.reopen();
+                continue;
+            }
+            r.latency[k].push_back(chrono::duration<double>(chrono::steady_clock::now() - t).count());
+            r.series[k] += tsv.size();
+        }
+        c.close();
+    }
+
+    double percentile(const vector<double>& sorted, double q) {
+        if (sorted.empty()) return 0.0;
+        return sorted[std::min(sorted.size() - 1, size_t(q*double(sorted.size())))];
+    }
+
+    void report(const string& name, vector<double> l, size_t series, double elapsed) {
+        sort(l.begin(), l.end());
+        cout << setw(12) << left << name << right
+             << setw(10) << l.size()
+             << fixed << setprecision(1)
+             << setw(12) << double(l.size())/elapsed
+             << setw(12) << double(series)/elapsed
+             << setprecision(3)
+             << setw(10) << 1e3*percentile(l, 0.50)
+             << setw(10) << 1e3*percentile(l, 0.99)
+             << setw(10) << (l.empty() ? 0.0 : 1e3*l.back()) << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    fs::path dir;
+    try {
+        const auto o = parse(argc, argv);
+        dir = fs::temp_directory_path()/fs::unique_path("dtss_benchmark_%%%%-%%%%");
+        server srv;
+        srv.add_container("bench", dir.string());
+        srv.set_listening_ip("127.0.0.1");
+        srv.set_listening_port(o.port);
+        srv.start_async();
+        {
+            const auto ta = make_ta(o, t0, o.points);
+            client c("localhost:" + std::to_string(o.port));
+            const auto t = chrono::steady_clock::now();
+            for (size_t i0 = 0; i0 < o.series; i0 += 100) {
+                ts_vector_t tsv;
+                for (size_t i = i0; i < std::min(o.series, i0 + 100); ++i)
+                    tsv.push_back(apoint_ts(ts_url(i), make_ts(ta, i, 0.0)));
+                c.store_ts(tsv, true, o.cache);
+            }
+            c.close();
+            cout << "series=" << o.series << " points=" << o.points << " axis=" << o.axis << " clients=" << o.clients
+                 << " seconds=" << o.seconds << " batch=" << o.batch << " cache=" << o.cache
+                 << " (stored in " << fixed << setprecision(2) << chrono::duration<double>(chrono::steady_clock::now() - t).count() << " s)\n";
+        }
+        vector<client_result> results(o.clients);
+        vector<thread> clients;
+        const auto t = chrono::steady_clock::now();
+        const auto deadline = t + chrono::seconds(o.seconds);
+        for (size_t i = 0; i < o.clients; ++i)
+            clients.emplace_back([&o, i, deadline, &results]() { run_client(o, i, deadline, results[i]); });
+        for (auto& c : clients)
+            c.join();
+        const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - t).count();
+        cout << setw(12) << left << "kind" << right << setw(10) << "requests" << setw(12) << "req/s" << setw(12) << "series/s"
+             << setw(10) << "p50 ms" << setw(10) << "p99 ms" << setw(10) << "max ms" << endl;
+        vector<double> all;
+        size_t all_series = 0, failures = 0;
+        for (size_t k = 0; k < n_kinds; ++k) {
+            vector<double> l;
+            size_t series = 0;
+            for (const auto& r : results) {
+                l.insert(l.end(), r.latency[k].begin(), r.latency[k].end());
+                series += r.series[k];
+            }
+            if (l.empty()) continue;
+            all.insert(all.end(), l.begin(), l.end());
+            all_series += series;
+            report(kinds[k], std::move(l), series, elapsed);
+        }
+        report("all", std::move(all), all_series, elapsed);
+        for (const auto& r : results) {
+            if (r.failures && failures == 0)
+                cout << "first failure: " << r.first_failure << "\n";
+            failures += r.failures;
+        }
+        const auto cs = srv.get_cache_stats();
+        cout << "failures=" << failures << " cache hits=" << cs.hits << " misses=" << cs.misses
+             << " coverage_misses=" << cs.coverage_misses << endl;
+        srv.clear();
+    } catch (const exception& e) {
+        cerr << "dtss_benchmark: " << e.what() << endl;
+        if (!dir.empty()) fs::remove_all(dir);
+        return 1;
+    }
+    fs::remove_all(dir);
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include "core/dtss.h"
 #include "core/dtss_cache.h"
 #include "core/dtss_client.h"
+#include "core/dtss_msg_flat.h"
 
 #include "core/utctime_utilities.h"
 #include "core/time_axis.h"
@@ -11,6 +12,7 @@
 
 
 #include <future>
+#include <random>
 #include <mutex>
 #include <regex>
 #include <boost/filesystem.hpp>
@@ -115,6 +117,149 @@ TEST_CASE("dtss_lru_cache") {
 		FAST_CHECK_EQ(string("c"), mru[1]);
 	}
 }
+TEST_CASE("dtss_cache_policy_two_q") {
+	using shyft::dtss::lru_cache;
+	using shyft::dtss::cache_policy;
+	using std::map;
+	using std::vector;
+	using std::string;
+	using std::to_string;
+	auto hot = [](size_t i) {return "hot" + to_string(i);};
+	auto scan = [](lru_cache<string, int, map>& c) {
+		for (int i = 0; i < 100; ++i)
+			c.add_item("scan" + to_string(i), i);// each read once
+	};
+	int r = 0;
+	SUBCASE("lru_scan_flushes_hot_items") {
+		lru_cache<string, int, map> c(8);
+		for (size_t i = 0; i < 4; ++i) { c.add_item(hot(i), int(i)); c.get_item(hot(i)); }
+		scan(c);
+		for (size_t i = 0; i < 4; ++i)
+			FAST_CHECK_UNARY_FALSE(c.try_get_item(hot(i), r));
+	}
+	SUBCASE("two_q_keeps_hot_items") {
+		lru_cache<string, int, map> c(8, cache_policy::two_q);
+		for (size_t i = 0; i < 4; ++i) { c.add_item(hot(i), int(i)); c.get_item(hot(i)); }// second access promotes to protected
+		scan(c);
+		FAST_CHECK_EQ(c.size(), 8u);
+		for (size_t i = 0; i < 4; ++i) {
+			FAST_CHECK_UNARY(c.try_get_item(hot(i), r));
+			FAST_CHECK_EQ(r, int(i));
+		}
+		FAST_CHECK_UNARY(c.try_get_item("scan99", r));// the most recent of the scan is in probation
+		FAST_CHECK_UNARY_FALSE(c.try_get_item("scan0", r));
+	}
+	SUBCASE("two_q_protected_segment_is_bounded") {
+		lru_cache<string, int, map> c(8, cache_policy::two_q);
+		for (size_t i = 0; i < 8; ++i) { c.add_item(hot(i), int(i)); c.get_item(hot(i)); }// 6 protected, hot0 and hot1 demoted
+		vector<string> mru; c.get_mru_keys(back_inserter(mru));
+		FAST_REQUIRE_EQ(mru.size(), 8u);
+		FAST_CHECK_EQ(mru[0], hot(7));
+		FAST_CHECK_EQ(mru[5], hot(2));
+		FAST_CHECK_EQ(mru[6], hot(1));// most recent demoted first in probation
+		c.add_item("x", 0);
+		FAST_CHECK_UNARY_FALSE(c.try_get_item(hot(0), r));// lru of probation evicted
+		FAST_CHECK_UNARY(c.try_get_item(hot(2), r));
+	}
+	SUBCASE("switch_policy_keeps_items") {
+		lru_cache<string, int, map> c(8, cache_policy::two_q);
+		for (size_t i = 0; i < 8; ++i) c.add_item(hot(i), int(i));// all in probation
+		c.get_item(hot(3));
+		c.set_policy(cache_policy::lru);
+		FAST_CHECK_EQ(c.get_policy(), cache_policy::lru);
+		FAST_CHECK_EQ(c.size(), 8u);
+		vector<string> mru; c.get_mru_keys(back_inserter(mru));
+		FAST_CHECK_EQ(mru[0], hot(3));
+		FAST_CHECK_EQ(mru[1], hot(7));
+		c.add_item("x", 0);
+		FAST_CHECK_UNARY_FALSE(c.try_get_item(hot(0), r));
+		c.set_policy(cache_policy::two_q);
+		FAST_CHECK_EQ(c.size(), 8u);
+		c.set_capacity(4);
+		FAST_CHECK_EQ(c.size(), 4u);
+		FAST_CHECK_UNARY(c.try_get_item("x", r));
+	}
+	SUBCASE("policy_stats_of_cache") {
+		using shyft::dtss::apoint_ts_frag;
+		using dtss_cache = shyft::dtss::cache<apoint_ts_frag, apoint_ts>;
+		dtss_cache c(10);
+		gta_t ta(0, 1, 10);
+		apoint_ts x;
+		c.add("a", apoint_ts(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE));
+		c.try_get("a", ta.total_period(), x);
+		c.set_policy(cache_policy::two_q);
+		FAST_CHECK_EQ(c.get_policy(), cache_policy::two_q);
+		c.try_get("a", ta.total_period(), x);
+		c.try_get("b", ta.total_period(), x);
+		auto lru = c.get_policy_stats(cache_policy::lru);
+		auto two_q = c.get_policy_stats(cache_policy::two_q);
+		FAST_CHECK_EQ(lru.hits, 1u);
+		FAST_CHECK_EQ(lru.misses, 0u);
+		FAST_CHECK_EQ(two_q.hits, 1u);
+		FAST_CHECK_EQ(two_q.misses, 1u);
+		FAST_CHECK_EQ(c.get_cache_stats().hits, 2u);
+		c.clear_cache_stats();
+		FAST_CHECK_EQ(c.get_policy_stats(cache_policy::two_q).hits, 0u);
+	}
+}
+
+TEST_CASE("dtss_flat_lru_cache") {
+	using shyft::dtss::lru_cache;
+	using shyft::dtss::flat_lru_cache;
+	using shyft::dtss::cache_policy;
+	using std::map;
+	using std::vector;
+	using std::string;
+	using std::to_string;
+	// same operations on the flat and the list based cache, require same items in same order
+	for (auto policy : {cache_policy::lru, cache_policy::two_q}) {
+		lru_cache<string, int, map> e(50, policy);
+		flat_lru_cache<string, int> f(50, policy);
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<int> key(0, 199), op(0, 99);
+		int re = 0, rf = 0;
+		for (int n = 0; n < 20000; ++n) {
+			const string k = "shyft://test/" + to_string(key(rng));// > small string size, allocated
+			const int o = op(rng);
+			if (o < 40) {
+				e.add_item(k, n); f.add_item(k, n);
+			} else if (o < 90) {
+				FAST_CHECK_EQ(e.try_get_item(k, re), f.try_get_item(k, rf));
+				FAST_CHECK_EQ(re, rf);
+			} else if (o < 97) {
+				e.remove_item(k); f.remove_item(k);
+			} else if (o < 98) {
+				const size_t c = 10 + size_t(key(rng))/4;
+				e.set_capacity(c); f.set_capacity(c);
+			} else if (o < 99) {
+				const auto p = e.get_policy() == cache_policy::lru ? cache_policy::two_q : cache_policy::lru;
+				e.set_policy(p); f.set_policy(p);
+			} else {
+				int m = key(rng);// evict until an item with value below m
+				auto fx = [m](const string&, int v) { return v >= m; };
+				e.evict_while(fx); f.evict_while(fx);
+			}
+			FAST_REQUIRE_EQ(e.size(), f.size());
+			if (n % 97 == 0) {
+				vector<string> me, mf;
+				e.get_mru_keys(back_inserter(me));
+				f.get_mru_keys(back_inserter(mf));
+				FAST_REQUIRE_EQ(me, mf);
+			}
+		}
+		size_t sum_e = 0, sum_f = 0;
+		e.apply_to_items([&sum_e](const string&, int v) { sum_e += size_t(v); });
+		f.apply_to_items([&sum_f](const string&, int v) { sum_f += size_t(v); });
+		FAST_CHECK_EQ(sum_e, sum_f);
+		f.flush();
+		FAST_CHECK_EQ(f.size(), 0u);
+		FAST_CHECK_UNARY_FALSE(f.item_exists("shyft://test/1"));
+		f.add_item("a", 1);
+		FAST_CHECK_EQ(f.get_item("a"), 1);
+		CHECK_THROWS_AS(f.get_item("b"), std::runtime_error);
+	}
+}
+
 TEST_CASE("dtss_ts_cache") {
     using std::vector;
     using std::string;
@@ -208,6 +353,454 @@ TEST_CASE("dtss_ts_cache") {
     FAST_CHECK_EQ(s.id_count, 0);
 
 }
+TEST_CASE("dtss_ts_cache_sharded") {
+    using std::vector;
+    using std::string;
+    using shyft::dtss::cache_stats;
+    using shyft::dtss::apoint_ts_frag;
+    using dtss_cache=shyft::dtss::cache<apoint_ts_frag,apoint_ts>;
+    const auto stair_case=shyft::time_series::POINT_AVERAGE_VALUE;
+
+    FAST_CHECK_EQ(dtss_cache::default_shard_count(10), 1u);
+    FAST_CHECK_EQ(dtss_cache::default_shard_count(1000000), size_t(dtss_cache::max_shard_count));
+    FAST_CHECK_EQ(dtss_cache(1000000).get_shard_count(), size_t(dtss_cache::max_shard_count));
+
+    const size_t n_shards = 8, n_ids = 800;
+    dtss_cache c(n_ids, n_shards);
+    FAST_CHECK_EQ(c.get_shard_count(), n_shards);
+    FAST_CHECK_EQ(c.get_capacity(), n_ids);
+    gta_t ta{utctime(0), deltahours(1), 3};
+    vector<string> ids;
+    vector<apoint_ts> tss;
+    for (size_t i = 0; i < n_ids/2; ++i) {
+        ids.push_back("shyft://a/" + std::to_string(i));
+        tss.emplace_back(ta, double(i), stair_case);
+    }
+    c.add(ids, tss);
+    auto r = c.get(ids, ta.total_period());
+    FAST_REQUIRE_EQ(r.size(), ids.size());
+    for (size_t i = 0; i < ids.size(); ++i)
+        FAST_CHECK_EQ(r[ids[i]].value(0), double(i));
+    auto s = c.get_cache_stats();// the sum of all shards
+    FAST_CHECK_EQ(s.id_count, ids.size());
+    FAST_CHECK_EQ(s.hits, ids.size());
+    FAST_CHECK_EQ(s.point_count, 3*ids.size());
+
+    SUBCASE("batched_add_merges_in_order") {// as the server cache update on write
+        gta_t ta2{utctime(deltahours(3)), deltahours(1), 3};
+        c.add(vector<string>{ids[0], ids[1], ids[0]}, vector<apoint_ts>{apoint_ts(ta2, -1.0, stair_case), apoint_ts(ta2, -2.0, stair_case), apoint_ts(ta, -3.0, stair_case)});
+        auto m = c.get(vector<string>{ids[0], ids[1]}, utcperiod(utctime(0), utctime(deltahours(6))));
+        FAST_REQUIRE_EQ(m.size(), 2u);
+        FAST_CHECK_EQ(m[ids[0]].value(0), -3.0);
+        FAST_CHECK_EQ(m[ids[0]].value(3), -1.0);
+        FAST_CHECK_EQ(m[ids[1]].value(0), 1.0);
+        FAST_CHECK_EQ(m[ids[1]].value(3), -2.0);
+        FAST_CHECK_EQ(c.get_cache_stats().id_count, ids.size());
+    }
+    SUBCASE("concurrent_add_get") {
+        c.clear_cache_stats();
+        const size_t n_threads = 8, n_gets = 500;
+        vector<std::future<void>> w;
+        for (size_t t = 0; t < n_threads; ++t) {
+            w.emplace_back(std::async(std::launch::async, [&c, &ids, &ta, t, stair_case]() {
+                for (size_t i = 0; i < n_gets; ++i) {
+                    apoint_ts x;
+                    auto const& id = ids[(i*7 + t) % ids.size()];
+                    if (i % 5 == 0)
+                        c.add("shyft://b/" + std::to_string(t) + "/" + std::to_string(i), apoint_ts(ta, 1.0, stair_case));
+                    c.try_get(id, ta.total_period(), x);
+                }
+            }));
+        }
+        for (auto& f : w) f.get();
+        s = c.get_cache_stats();
+        FAST_CHECK_EQ(s.hits + s.misses, n_threads*n_gets);
+        FAST_CHECK_LE(s.id_count, n_ids);
+    }
+    SUBCASE("capacity_spread_over_shards") {
+        c.set_capacity(80);
+        FAST_CHECK_EQ(c.get_capacity(), 80u);
+        FAST_CHECK_LE(c.get_cache_stats().id_count, 80u);
+        for (size_t i = 0; i < n_ids; ++i)
+            c.add("shyft://c/" + std::to_string(i), apoint_ts(ta, 1.0, stair_case));
+        s = c.get_cache_stats();
+        FAST_CHECK_LE(s.id_count, 80u);
+        FAST_CHECK_GE(s.id_count, 70u);// each shard keeps its 10 most recent, unless the hash is very uneven
+        c.remove(ids);
+        c.flush();
+        FAST_CHECK_EQ(c.get_cache_stats().id_count, 0u);
+    }
+}
+
+TEST_CASE("dtss_ts_cache_byte_capacity") {
+    using std::vector;
+    using std::string;
+    using shyft::dtss::apoint_ts_frag;
+    using dtss_cache=shyft::dtss::cache<apoint_ts_frag,apoint_ts>;
+    const auto stair_case=shyft::time_series::POINT_AVERAGE_VALUE;
+
+    dtss_cache c(1000, 1);
+    FAST_CHECK_EQ(c.get_byte_capacity(), 0u);
+    gta_t small{utctime(0), deltahours(1), 10};
+    gta_t big{utctime(0), deltahours(1), 10000};
+    for (size_t i = 0; i < 20; ++i)
+        c.add("s" + std::to_string(i), apoint_ts(small, 1.0, stair_case));
+    const size_t b20 = c.get_byte_count();
+    FAST_CHECK_GT(b20, 20*10*sizeof(double));
+    FAST_CHECK_LT(b20, 20*1000u);
+    FAST_CHECK_EQ(c.get_cache_stats().byte_count, b20);
+
+    c.set_byte_capacity(b20/2);// evicts the least recently used half
+    FAST_CHECK_EQ(c.get_byte_capacity(), b20/2);
+    FAST_CHECK_LE(c.get_byte_count(), b20/2);
+    apoint_ts x;
+    FAST_CHECK_EQ(c.try_get("s0", small.total_period(), x), false);
+    FAST_CHECK_EQ(c.try_get("s19", small.total_period(), x), true);
+
+    c.set_byte_capacity(100000);// room for one big, and the smalls
+    c.add("b0", apoint_ts(big, 1.0, stair_case));
+    FAST_CHECK_EQ(c.try_get("b0", big.total_period(), x), true);
+    FAST_CHECK_EQ(c.try_get("s19", small.total_period(), x), true);
+    c.add("b1", apoint_ts(big, 2.0, stair_case));// evicts the lru, b0, not many small ones
+    FAST_CHECK_LE(c.get_byte_count(), 100000u);
+    FAST_CHECK_EQ(c.try_get("b1", big.total_period(), x), true);
+    FAST_CHECK_EQ(c.try_get("b0", big.total_period(), x), false);
+    FAST_CHECK_EQ(c.try_get("s19", small.total_period(), x), true);
+
+    c.add("b2", apoint_ts(gta_t{utctime(0), deltahours(1), 20000}, 1.0, stair_case));// alone above the budget, not kept
+    FAST_CHECK_EQ(c.try_get("b2", big.total_period(), x), false);
+    FAST_CHECK_EQ(c.try_get("b1", big.total_period(), x), true);// and the others are kept
+    FAST_CHECK_LE(c.get_byte_count(), 100000u);
+
+    const size_t b = c.get_byte_count();
+    c.add("s19", apoint_ts(gta_t{deltahours(100), deltahours(1), 10}, 1.0, stair_case));// a new fragment adds to the entry
+    FAST_CHECK_GT(c.get_byte_count(), b);
+    c.remove("s19");
+    FAST_CHECK_LT(c.get_byte_count(), b);
+    c.flush();
+    FAST_CHECK_EQ(c.get_byte_count(), 0u);
+    c.set_byte_capacity(0);// no byte limit
+    c.add("b3", apoint_ts(gta_t{utctime(0), deltahours(1), 20000}, 1.0, stair_case));
+    FAST_CHECK_EQ(c.try_get("b3", big.total_period(), x), true);
+}
+
+TEST_CASE("dtss_single_flight") {
+    using shyft::dtss::single_flight;
+    using std::vector;
+    using std::string;
+    single_flight<string, int> sf;
+    std::atomic<int> n_work{0};
+    auto read = [&sf, &n_work](vector<string> const& keys, bool fail) {// the way do_read uses it
+        vector<bool> lead;
+        auto f = sf.join(keys, lead);
+        vector<int> r(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!lead[i]) continue;
+            ++n_work;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (fail) sf.fail(keys[i], f[i], std::make_exception_ptr(std::runtime_error("read failed")));
+            else sf.complete(keys[i], f[i], int(keys[i].size()));
+        }
+        for (size_t i = 0; i < keys.size(); ++i)
+            r[i] = f[i]->f.get();
+        return r;
+    };
+    SUBCASE("concurrent_same_keys_read_once") {
+        vector<std::future<vector<int>>> w;
+        for (size_t t = 0; t < 8; ++t)
+            w.emplace_back(std::async(std::launch::async, [&read, t]() {
+                return read(t % 2 ? vector<string>{"a", "bb"} : vector<string>{"bb", "a", "a"}, false);
+            }));
+        for (size_t t = 0; t < w.size(); ++t) {
+            auto r = w[t].get();
+            const vector<int> expected = t % 2 ? vector<int>{1, 2} : vector<int>{2, 1, 1};
+            FAST_CHECK_EQ(r, expected);
+        }
+        FAST_CHECK_LE(n_work.load(), 4);// once per key, unless a thread came after the first completed
+        FAST_CHECK_GE(n_work.load(), 2);
+        FAST_CHECK_EQ(sf.size(), 0u);
+        n_work = 0;
+        read({"a"}, false);// completed flights are removed, so this is a new read
+        FAST_CHECK_EQ(n_work.load(), 1);
+    }
+    SUBCASE("failure_propagates_to_followers") {
+        n_work = 0;
+        auto leader = std::async(std::launch::async, [&read]() { return read({"x"}, true); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto follower = std::async(std::launch::async, [&read]() { return read({"x"}, true); });
+        CHECK_THROWS_AS(leader.get(), std::runtime_error);
+        CHECK_THROWS_AS(follower.get(), std::runtime_error);
+        FAST_CHECK_EQ(n_work.load(), 1);
+        FAST_CHECK_EQ(sf.size(), 0u);
+    }
+    SUBCASE("forgotten_flights_are_not_joined") {
+        vector<bool> lead;
+        auto f = sf.join({"a", "b"}, lead);
+        FAST_CHECK_EQ(sf.forget_if([](const string& k) { return k == "a"; }), 1u);
+        vector<bool> lead2;
+        auto f2 = sf.join({"a", "b"}, lead2);
+        FAST_CHECK_UNARY(lead2[0]);// a new flight for the forgotten key
+        FAST_CHECK_UNARY(!lead2[1]);
+        sf.complete("a", f[0], 1);// the forgotten flight is still completed, and leaves the new one
+        FAST_CHECK_EQ(sf.size(), 2u);
+        sf.complete("a", f2[0], 2);
+        sf.complete("b", f[1], 3);
+        FAST_CHECK_EQ(f[0]->f.get(), 1);
+        FAST_CHECK_EQ(f2[0]->f.get(), 2);
+        FAST_CHECK_EQ(f2[1]->f.get(), 3);
+        FAST_CHECK_EQ(sf.size(), 0u);
+    }
+}
+
+TEST_CASE("dtss_coalesced_reads") {
+    using namespace shyft::dtss;
+    gta_t ta(utctime(0), deltahours(1), 24);
+    std::atomic<int> n_cb{0};
+    std::atomic<bool> throw_exception{false};
+    read_call_back_t cb = [ta, &n_cb, &throw_exception](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ++n_cb;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));// like a slow backend, so the other requests arrive meanwhile
+        if (throw_exception)
+            throw std::runtime_error("test exception");
+        ts_vector_t r;
+        for (size_t i = 0; i < ts_ids.size(); ++i)
+            r.emplace_back(ta, double(ts_ids[i].size()), shyft::time_series::POINT_AVERAGE_VALUE);
+        return r;
+    };
+    server our_server(cb);
+    const id_vector_t ids{"a.prod", "bb.prod"};
+    auto concurrent_reads = [&]() {
+        vector<std::future<ts_vector_t>> w;
+        for (size_t t = 0; t < 6; ++t)
+            w.emplace_back(std::async(std::launch::async, [&]() { return our_server.do_read(ids, ta.total_period(), false, false); }));
+        return w;
+    };
+    auto w = concurrent_reads();
+    for (auto& f : w) {
+        auto r = f.get();
+        FAST_REQUIRE_EQ(r.size(), 2u);
+        FAST_CHECK_EQ(r[0].value(0), 6.0);
+        FAST_CHECK_EQ(r[1].value(0), 7.0);
+    }
+    FAST_CHECK_EQ(n_cb.load(), 1);// the backend is hit once, not once per request
+    FAST_CHECK_EQ(our_server.ts_reads.size(), 0u);
+    our_server.do_read(ids, ta.total_period(), false, false);
+    FAST_CHECK_EQ(n_cb.load(), 2);// not cached, so a later read goes to the backend
+    our_server.do_read(ids, ta.total_period(), false, false, false);
+    FAST_CHECK_EQ(n_cb.load(), 3);
+    throw_exception = true;
+    w = concurrent_reads();
+    for (auto& f : w)
+        CHECK_THROWS_AS(f.get(), std::runtime_error);// the followers get the exception of the leader
+    FAST_CHECK_EQ(n_cb.load(), 4);
+    FAST_CHECK_EQ(our_server.ts_reads.size(), 0u);
+}
+
+TEST_CASE("dtss_coalesced_reads_after_store") {
+    using namespace shyft::dtss;
+    gta_t ta(utctime(0), deltahours(1), 24);
+    std::mutex mx;
+    std::map<string, double> backend{ {"a.prod", 1.0} };
+    std::atomic<int> n_cb{0};
+    read_call_back_t cb = [&](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ts_vector_t r;
+        {
+            std::lock_guard<std::mutex> lock(mx);
+            for (const auto& id : ts_ids)
+                r.emplace_back(ta, backend[id], shyft::time_series::POINT_AVERAGE_VALUE);
+        }
+        if (n_cb++ == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));// the first read is slow, and returns the values from before the store
+        return r;
+    };
+    server our_server(cb);
+    our_server.store_ts_cb = [&](const ts_vector_t& tsv) {
+        std::lock_guard<std::mutex> lock(mx);
+        for (const auto& ts : tsv)
+            backend[ts.id()] = ts.value(0);
+    };
+    const id_vector_t ids{"a.prod"};
+    auto slow = std::async(std::launch::async, [&]() { return our_server.do_read(ids, ta.total_period(), false, false); });
+    while (our_server.ts_reads.size() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto follower = std::async(std::launch::async, [&]() { return our_server.do_read(ids, ta.total_period(), false, false); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));// joins the slow read, before the store
+    ts_vector_t tsv;
+    tsv.push_back(apoint_ts("a.prod", apoint_ts(ta, 2.0, shyft::time_series::POINT_AVERAGE_VALUE)));
+    our_server.do_store_ts(tsv, true, false);
+    auto r = our_server.do_read(ids, ta.total_period(), false, false);// issued after the store is done, so it is a new read
+    FAST_REQUIRE_EQ(r.size(), 1u);
+    FAST_CHECK_EQ(r[0].value(0), 2.0);
+    FAST_CHECK_EQ(slow.get()[0].value(0), 1.0);
+    FAST_CHECK_EQ(follower.get()[0].value(0), 1.0);
+    FAST_CHECK_EQ(n_cb.load(), 2);
+    FAST_CHECK_EQ(our_server.ts_reads.size(), 0u);
+}
+
+TEST_CASE("dtss_partial_cached_reads") {
+    using namespace shyft::dtss;
+    const auto dt = deltahours(1);
+    vector<core::utcperiod> reads;
+    bool empty_reads = false;
+    read_call_back_t cb = [&](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        reads.push_back(p);
+        ts_vector_t r;
+        for (size_t i = 0; i < ts_ids.size(); ++i) {
+            if (empty_reads) {
+                r.emplace_back();
+                continue;
+            }
+            gta_t ta(p.start, dt, size_t((p.end - p.start)/dt));
+            vector<double> v;
+            for (size_t j = 0; j < ta.size(); ++j)
+                v.push_back(double(ta.time(j)/dt));// value is the hour, so the stitched parts can be verified
+            r.emplace_back(ta, v, shyft::time_series::POINT_AVERAGE_VALUE);
+        }
+        return r;
+    };
+    server our_server(cb);
+    const id_vector_t ids{"a.prod", "b.prod"};
+    auto check_hours = [&](const ts_vector_t& r, core::utcperiod p) {
+        FAST_REQUIRE_EQ(r.size(), ids.size());
+        for (const auto& ts : r) {
+            FAST_CHECK_UNARY(ts.total_period().contains(p));
+            for (size_t j = 0; j < ts.size(); ++j)
+                FAST_CHECK_EQ(ts.value(j), double(ts.time(j)/dt));
+        }
+    };
+    auto p0 = core::utcperiod(0, 24*dt);
+    check_hours(our_server.do_read(ids, p0, true, true), p0);
+    FAST_REQUIRE_EQ(reads.size(), 1u);
+    auto p1 = core::utcperiod(0, 36*dt);
+    auto r = our_server.do_read(ids, p1, true, true);
+    check_hours(r, p1);
+    FAST_REQUIRE_EQ(reads.size(), 2u);
+    FAST_CHECK_EQ(reads[1], core::utcperiod(24*dt, 36*dt));// only the gap is read, for both ids in one call
+    FAST_CHECK_EQ(r[0].size(), 36u);
+    auto p2 = core::utcperiod(-12*dt, 48*dt);
+    check_hours(our_server.do_read(ids, p2, true, true), p2);
+    FAST_REQUIRE_EQ(reads.size(), 4u);
+    FAST_CHECK_EQ(reads[2], core::utcperiod(-12*dt, 0));
+    FAST_CHECK_EQ(reads[3], core::utcperiod(36*dt, 48*dt));
+    FAST_CHECK_EQ(our_server.get_cache_stats().fragment_count, 2u);// the gaps are merged into one fragment per id
+    our_server.do_read(ids, p2, true, true);
+    FAST_CHECK_EQ(reads.size(), 4u);// now all from cache
+    auto p3 = core::utcperiod(48*dt, 60*dt);
+    our_server.do_read(ids, core::utcperiod(p3.start + 6*dt, p3.end), true, false);
+    FAST_CHECK_EQ(reads.size(), 5u);
+    our_server.do_read(ids, core::utcperiod(0, 60*dt), false, false);
+    FAST_CHECK_EQ(reads.size(), 6u);
+    FAST_CHECK_EQ(reads[5], core::utcperiod(0, 60*dt));// not using the cache, the full period is read
+    empty_reads = true;
+    our_server.do_read(ids, core::utcperiod(0, 60*dt), true, false);
+    FAST_REQUIRE_EQ(reads.size(), 8u);
+    FAST_CHECK_EQ(reads[6], core::utcperiod(48*dt, 60*dt));
+    FAST_CHECK_EQ(reads[7], core::utcperiod(0, 60*dt));// a gap without data, falls back to the full period
+}
+
+TEST_CASE("dtss_batched_external_reads") {
+    using namespace shyft::dtss;
+    gta_t ta(utctime(0), deltahours(1), 24);
+    std::atomic<int> n_cb{0};
+    std::atomic<size_t> n_ids{0};
+    std::atomic<bool> throw_exception{false};
+    read_call_back_t cb = [ta, &n_cb, &n_ids, &throw_exception](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ++n_cb;
+        n_ids += ts_ids.size();
+        if (throw_exception)
+            throw std::runtime_error("test exception");
+        ts_vector_t r;
+        for (size_t i = 0; i < ts_ids.size(); ++i)
+            r.emplace_back(ta, double(ts_ids[i].size()), shyft::time_series::POINT_AVERAGE_VALUE);
+        return r;
+    };
+    server our_server(cb);
+    FAST_CHECK_EQ(our_server.get_read_batch_window().count(), 0);
+    FAST_CHECK_UNARY(!our_server.get_read_batcher());// off by default
+    our_server.set_read_batching(std::chrono::milliseconds(200), 2);
+    FAST_CHECK_EQ(our_server.get_read_batch_threads(), 2u);
+    auto concurrent_reads = [&](core::utcperiod p2) {
+        vector<std::future<ts_vector_t>> w;
+        for (size_t t = 0; t < 6; ++t) {
+            w.emplace_back(std::async(std::launch::async, [&our_server, t, p2, &ta]() {
+                id_vector_t ids{"a.prod", string(t + 3, 'x')};// one shared id, one of each request
+                return our_server.do_read(ids, t % 2 ? p2 : ta.total_period(), false, false, false);
+            }));
+        }
+        return w;
+    };
+    auto w = concurrent_reads(ta.total_period());
+    for (size_t t = 0; t < w.size(); ++t) {
+        auto r = w[t].get();
+        FAST_REQUIRE_EQ(r.size(), 2u);
+        FAST_CHECK_EQ(r[0].value(0), 6.0);
+        FAST_CHECK_EQ(r[1].value(0), double(t + 3));
+    }
+    FAST_CHECK_EQ(n_cb.load(), 1);// all in one call
+    FAST_CHECK_EQ(n_ids.load(), 7u);// with the shared id once
+    n_cb = 0;
+    w = concurrent_reads(core::utcperiod(0, deltahours(12)));
+    for (auto& f : w)
+        FAST_CHECK_EQ(f.get().size(), 2u);
+    FAST_CHECK_EQ(n_cb.load(), 2);// one call for each period
+    throw_exception = true;
+    w = concurrent_reads(ta.total_period());
+    for (auto& f : w)
+        CHECK_THROWS_AS(f.get(), std::runtime_error);// each request gets the exception of the call
+    FAST_CHECK_EQ(n_cb.load(), 3);
+    throw_exception = false;
+    our_server.set_read_batching(std::chrono::microseconds(0));
+    FAST_CHECK_UNARY(!our_server.get_read_batcher());
+    our_server.do_read(id_vector_t{"a.prod"}, ta.total_period(), false, false);
+    FAST_CHECK_EQ(n_cb.load(), 4);
+}
+
+TEST_CASE("dtss_parallel_container_reads") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.parallel.test");
+    gta_t ta(utctime(0), deltahours(1), 24);
+    std::atomic<int> n_cb{0};
+    read_call_back_t cb = [ta, &n_cb](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ++n_cb;
+        ts_vector_t r;
+        for (size_t i = 0; i < ts_ids.size(); ++i)
+            r.emplace_back(ta, -double(ts_ids[i].size()), shyft::time_series::POINT_AVERAGE_VALUE);
+        return r;
+    };
+    server our_server(cb);
+    our_server.add_container("test", tmpdir.string());
+    FAST_CHECK_EQ(our_server.get_max_io_threads(), 8u);
+    id_vector_t ids;
+    for (size_t i = 0; i < 50; ++i) {
+        our_server.internal("test")->save("ts" + std::to_string(i), gts_t(ta, double(i), shyft::time_series::POINT_AVERAGE_VALUE));
+        ids.push_back(shyft_url("test", "ts" + std::to_string(i)));
+        if (i % 10 == 0)
+            ids.push_back("x" + std::to_string(i) + ".prod");// mixed with external ids
+    }
+    auto check_read = [&]() {
+        auto r = our_server.do_read(ids, ta.total_period(), false, false);
+        FAST_REQUIRE_EQ(r.size(), ids.size());
+        for (size_t i = 0, k = 0; i < ids.size(); ++i) {
+            if (ids[i][0] == 'x') {
+                FAST_CHECK_EQ(r[i].value(0), -double(ids[i].size()));
+            } else {
+                FAST_CHECK_EQ(r[i].value(0), double(k++));
+            }
+        }
+    };
+    check_read();
+    FAST_CHECK_EQ(n_cb.load(), 1);// the external ids in one call
+    our_server.set_max_io_threads(1);// sequential
+    check_read();
+    our_server.set_max_io_threads(0);// clamped to 1
+    FAST_CHECK_EQ(our_server.get_max_io_threads(), 1u);
+    our_server.set_max_io_threads(4);
+    check_read();
+    ids.push_back(shyft_url("test", "not.there"));
+    CHECK_THROWS_AS(our_server.do_read(ids, ta.total_period(), false, false), std::runtime_error);// a failed read is rethrown
+    fs::remove_all(tmpdir);
+}
+
 TEST_CASE("dtss_mini_frag") {
     using std::vector;
     using std::string;
@@ -302,6 +895,25 @@ TEST_CASE("dtss_mini_frag") {
     m.add(tst_frag{-1,27});
     FAST_CHECK_EQ(m.count_fragments(),1);
 
+    m.add(tst_frag{30,35});
+    m.add(tst_frag{40,45});// now [-1,27) [30,35) [40,45)
+    auto g = m.gaps(utcperiod{-5,50});
+    FAST_REQUIRE_EQ(g.size(),4u);
+    FAST_CHECK_EQ(g[0],utcperiod(-5,-1));
+    FAST_CHECK_EQ(g[1],utcperiod(27,30));
+    FAST_CHECK_EQ(g[2],utcperiod(35,40));
+    FAST_CHECK_EQ(g[3],utcperiod(45,50));
+    g = m.gaps(utcperiod{31,42});
+    FAST_REQUIRE_EQ(g.size(),1u);
+    FAST_CHECK_EQ(g[0],utcperiod(35,40));
+    FAST_CHECK_EQ(m.gaps(utcperiod{31,34}).size(),0u);
+    g = m.gaps(utcperiod{50,60});
+    FAST_REQUIRE_EQ(g.size(),1u);
+    FAST_CHECK_EQ(g[0],utcperiod(50,60));
+    FAST_CHECK_EQ(m.overlapping(utcperiod{31,42}).count_fragments(),2u);
+    FAST_CHECK_EQ(m.overlapping(utcperiod{27,30}).count_fragments(),0u);
+    FAST_CHECK_EQ(m.overlapping(utcperiod{-10,60}).count_fragments(),3u);
+
 }
 
 TEST_CASE("dlib_server_basics") {
@@ -471,6 +1083,1134 @@ TEST_CASE("dlib_multi_server_basics") {
     dlog << dlib::LINFO << "done";
 }
 
+TEST_CASE("dtss_client_connection_pool") {
+    using namespace shyft::dtss;
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    auto dt = deltahours(1);
+    time_axis::fixed_dt ta(t, dt, 24);
+    bool throw_exception = false;
+    read_call_back_t rcb = [ta, &throw_exception](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        if (throw_exception)
+            throw std::runtime_error("test exception");
+        ts_vector_t r;
+        for (size_t i = 0; i < ts_ids.size(); ++i)
+            r.emplace_back(ta, double(i));
+        return r;
+    };
+    int port_no = 20030;
+    string host_port = string("localhost:") + to_string(port_no);
+    auto start_server = [&rcb, port_no]() {
+        auto srv = make_unique<server>(rcb);
+        srv->set_listening_ip("127.0.0.1");
+        srv->set_listening_port(port_no);
+        srv->start_async();
+        return srv;
+    };
+    ts_vector_t tsv;
+    for (size_t i = 0; i < 3; ++i)
+        tsv.push_back(2.0*apoint_ts(string("netcdf://group/path/ts") + std::to_string(i)));
+    auto srv = start_server();
+    client c(host_port);
+    auto& pool = *c.srv_pool[0];
+    FAST_CHECK_EQ(pool.idle_count(), 0u);
+    for (size_t i = 0; i < 3; ++i) {
+        auto r = c.evaluate(tsv, ta.total_period(), false, false);
+        FAST_REQUIRE_EQ(r.size(), tsv.size());
+        FAST_CHECK_EQ(r[2].value(0), 4.0);
+        FAST_CHECK_EQ(pool.idle_count(), 1u);// the connection is kept, and reused by the next call
+    }
+    // a server exception leaves the connection unused, and the next call connects again
+    throw_exception = true;
+    CHECK_THROWS_AS(c.evaluate(tsv, ta.total_period(), false, false), std::runtime_error);
+    FAST_CHECK_EQ(pool.idle_count(), 0u);
+    throw_exception = false;
+    FAST_CHECK_EQ(c.evaluate(tsv, ta.total_period(), false, false).size(), tsv.size());
+    // concurrent calls gets a connection each, and at most max_idle are kept
+    pool.max_idle = 2;
+    vector<future<size_t>> calls;
+    for (size_t i = 0; i < 6; ++i)
+        calls.push_back(std::async(std::launch::async, [&c, &tsv, &ta]() { return c.evaluate(tsv, ta.total_period(), false, false).size(); }));
+    for (auto& f : calls)
+        FAST_CHECK_EQ(f.get(), tsv.size());
+    FAST_CHECK_LE(pool.idle_count(), 2u);
+    FAST_CHECK_GE(pool.idle_count(), 1u);
+    // a restarted server closes the idle connections, the call is retried on a new connection
+    srv->clear();
+    srv = start_server();
+    FAST_CHECK_EQ(c.evaluate(tsv, ta.total_period(), false, false).size(), tsv.size());
+    FAST_CHECK_EQ(pool.idle_count(), 1u);
+    FAST_CHECK_EQ(c.find("").size(), 0u);// also for the other calls
+    // connections idle too long are not reused
+    pool.max_idle_time = std::chrono::milliseconds(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    FAST_CHECK_EQ(c.evaluate(tsv, ta.total_period(), false, false).size(), tsv.size());
+    FAST_CHECK_EQ(pool.idle_count(), 1u);
+    c.close();
+    FAST_CHECK_EQ(pool.idle_count(), 0u);
+    srv->clear();
+}
+
+TEST_CASE("dtss_client_pipelined_requests") {
+    using namespace shyft::dtss;
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    auto dt = deltahours(1);
+    time_axis::fixed_dt ta(t, dt, 24);
+    read_call_back_t rcb = [ta](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ts_vector_t r;
+        for (const auto& id : ts_ids) {
+            if (id.find("slow") != string::npos)
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            if (id.find("throw") != string::npos)
+                throw std::runtime_error("test exception");
+            r.emplace_back(ta, double(std::stoi(id.substr(id.rfind('/') + 1))));
+        }
+        return r;
+    };
+    int port_no = 20031;
+    string host_port = string("localhost:") + to_string(port_no);
+    server srv(rcb);
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(port_no);
+    srv.start_async();
+    {
+        client c(host_port);
+        auto mk_tsv = [](const string& kind, int v) {
+            ts_vector_t tsv;
+            tsv.push_back(2.0*apoint_ts(string("netcdf://") + kind + "/" + std::to_string(v)));
+            return tsv;
+        };
+        // a slow request does not hold back the replies to the requests after it
+        auto slow = c.evaluate_async(mk_tsv("slow", 1), ta.total_period(), false, false);
+        auto fast = c.evaluate_async(mk_tsv("fast", 2), ta.total_period(), false, false);
+        auto r_fast = fast.get();
+        FAST_CHECK_EQ(r_fast[0].value(0), 4.0);
+        FAST_CHECK_UNARY(slow.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready);
+        FAST_CHECK_EQ(slow.get()[0].value(0), 2.0);
+        // more requests than are in flight, exceptions goes to the failed request only
+        vector<std::future<vector<apoint_ts>>> f;
+        for (int i = 0; i < 50; ++i)
+            f.push_back(c.evaluate_async(mk_tsv(i == 7 ? "throw" : "fast", i), ta.total_period(), false, false));
+        FAST_CHECK_EQ(c.evaluate(mk_tsv("fast", 3), ta.total_period(), false, false)[0].value(0), 6.0);// plain requests still works
+        for (int i = 0; i < 50; ++i) {
+            if (i == 7) {
+                CHECK_THROWS_AS(f[i].get(), std::runtime_error);
+            } else {
+                FAST_CHECK_EQ(f[i].get()[0].value(0), 2.0*i);
+            }
+        }
+        FAST_CHECK_UNARY(!c.next_pipeline()->broken());
+        c.close();
+    }
+    srv.clear();
+}
+
+TEST_CASE("dtss_client_multi_server_evaluate") {
+    using namespace shyft::dtss;
+    // partitions are balanced by cost, and covers all the series once
+    auto parts = partition_by_cost(vector<double>{5.0, 1.0, 1.0, 1.0, 1.0, 1.0, 2.0}, 3);
+    FAST_REQUIRE_EQ(parts.size(), 3u);
+    FAST_CHECK_EQ(parts[0], vector<size_t>{0});
+    FAST_CHECK_EQ(parts[1].size() + parts[2].size(), 6u);
+    FAST_CHECK_EQ(partition_by_cost(vector<double>{1.0, 1.0}, 4)[3].size(), 0u);
+    FAST_CHECK_EQ(estimated_cost(apoint_ts(string("a://b")) + apoint_ts(string("a://c"))), 3.0);
+
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    time_axis::fixed_dt ta(t, deltahours(1), 24);
+    read_call_back_t rcb = [ta](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ts_vector_t r;
+        for (const auto& id : ts_ids)
+            r.emplace_back(ta, double(std::stoi(id.substr(id.rfind('/') + 1))));
+        return r;
+    };
+    const int n_srv = 4;
+    vector<unique_ptr<server>> srv;
+    vector<string> host_ports;
+    for (int i = 0; i < n_srv; ++i) {
+        int port_no = 20032 + i;
+        srv.emplace_back(new server(rcb));
+        srv.back()->set_listening_ip("127.0.0.1");
+        srv.back()->set_listening_port(port_no);
+        srv.back()->start_async();
+        host_ports.push_back(string("localhost:") + to_string(port_no));
+    }
+    {
+        client c(host_ports, true, 1000);
+        for (size_t n : {1u, 3u, 5u, 9u}) {// fewer and more series than servers
+            ts_vector_t tsv;
+            for (size_t i = 0; i < n; ++i) {
+                apoint_ts e(string("netcdf://a/") + to_string(i));
+                for (size_t j = 0; j < i % 3; ++j)// uneven cost
+                    e = e + apoint_ts(string("netcdf://b/0"));
+                tsv.push_back(e);
+            }
+            auto r = c.evaluate(tsv, ta.total_period(), false, false);
+            FAST_REQUIRE_EQ(r.size(), n);
+            for (size_t i = 0; i < n; ++i)
+                FAST_CHECK_EQ(r[i].value(0), double(i));
+        }
+        c.close();
+    }
+    for (auto& s : srv)
+        s->clear();
+}
+
+TEST_CASE("dtss_flat_wire_format") {
+    using namespace shyft::dtss;
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    auto osl = make_shared<calendar>("Europe/Oslo");
+    auto utc1 = make_shared<calendar>(deltahours(1));
+    ts_vector_t tsv;
+    tsv.emplace_back(gta_t(t, deltahours(1), 24), vector<double>(24, 1.5), time_series::POINT_AVERAGE_VALUE);
+    tsv.emplace_back(gta_t(osl, t, deltahours(24), 3), vector<double>{1.0, shyft::nan, 3.0}, time_series::POINT_INSTANT_VALUE);
+    tsv.emplace_back(gta_t(utc1, t, deltahours(24), 2), vector<double>{1.0, 2.0}, time_series::POINT_AVERAGE_VALUE);
+    tsv.emplace_back(gta_t(vector<utctime>{t, t + 10, t + 30}, t + 40), vector<double>{1.0, 2.0, 3.0}, time_series::POINT_AVERAGE_VALUE);
+    tsv.emplace_back();
+    tsv.emplace_back(2.0*tsv[0]);// an expression, written evaluated
+    std::stringstream buf;
+    msg::write_flat_ts_vector(tsv, buf);
+    FAST_REQUIRE_EQ(msg::read_type(buf), message_type::FLAT_TS_VECTOR);
+    auto r = msg::read_flat_ts_vector(buf);
+    FAST_REQUIRE_EQ(r.size(), tsv.size());
+    for (size_t i = 0; i < r.size(); ++i) {
+        if (i == 4) {
+            FAST_CHECK_UNARY(!r[i].ts);
+            continue;
+        }
+        FAST_CHECK_EQ(r[i].time_axis(), tsv[i].time_axis());
+        FAST_CHECK_EQ(r[i].point_interpretation(), tsv[i].point_interpretation());
+        auto v = r[i].values(), e = tsv[i].values();
+        FAST_REQUIRE_EQ(v.size(), e.size());
+        for (size_t j = 0; j < v.size(); ++j)
+            FAST_CHECK_UNARY(v[j] == e[j] || (std::isnan(v[j]) && std::isnan(e[j])));
+    }
+    FAST_CHECK_EQ(r[1].time_axis().c.cal->tz_info->name(), string("Europe/Oslo"));
+    FAST_CHECK_EQ(r[2].time_axis().c.cal->tz_info->name(), utc1->tz_info->name());
+    std::stringstream whole;
+    msg::write_flat_ts_vector(tsv, whole);
+    std::stringstream tin(whole.str().substr(sizeof(int32_t), 40));// after the type, truncated
+    CHECK_THROWS_AS(msg::read_flat_ts_vector(tin), std::runtime_error);
+
+    // compressed values, only for the larger series, when smaller
+    vector<double> slow(1000);
+    for (size_t i = 0; i < slow.size(); ++i)
+        slow[i] = 10.0 + double(i / 100);
+    tsv.emplace_back(gta_t(t, deltahours(1), slow.size()), slow, time_series::POINT_AVERAGE_VALUE);
+    std::stringstream raw, compressed;
+    msg::write_flat_ts_vector(tsv, raw);
+    msg::write_flat_ts_vector(tsv, compressed, true);
+    FAST_CHECK_LT(compressed.str().size(), raw.str().size()/2);
+    FAST_REQUIRE_EQ(msg::read_type(compressed), message_type::FLAT_TS_VECTOR);
+    auto rc = msg::read_flat_ts_vector(compressed);
+    FAST_REQUIRE_EQ(rc.size(), tsv.size());
+    FAST_CHECK_EQ(rc.back().values(), slow);
+    FAST_CHECK_EQ(rc[0].values(), tsv[0].values());
+    FAST_CHECK_UNARY(!rc[4].ts);
+
+    // the client asks for flat replies when the server supports it, the result is the same
+    time_axis::fixed_dt ta(t, deltahours(1), 24);
+    read_call_back_t rcb = [ta](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ts_vector_t r;
+        for (const auto& id : ts_ids)
+            r.emplace_back(ta, double(std::stoi(id.substr(id.rfind('/') + 1))));
+        return r;
+    };
+    int port_no = 20036;
+    string host_port = string("localhost:") + to_string(port_no);
+    server srv(rcb);
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(port_no);
+    srv.start_async();
+    {
+        client c(host_port);
+        ts_vector_t etsv;
+        for (int i = 0; i < 10; ++i)
+            etsv.push_back(3.0*apoint_ts(string("netcdf://a/") + to_string(i)));
+        auto r_flat = c.evaluate(etsv, ta.total_period(), false, false);
+        FAST_CHECK_EQ(c.srv_con[0].wire_version, int(msg::flat_wire_version));
+        c.flat_replies = false;
+        auto r_archive = c.evaluate(etsv, ta.total_period(), false, false);
+        FAST_REQUIRE_EQ(r_flat.size(), r_archive.size());
+        for (size_t i = 0; i < r_flat.size(); ++i) {
+            FAST_CHECK_EQ(r_flat[i].time_axis(), r_archive[i].time_axis());
+            FAST_CHECK_EQ(r_flat[i].values(), r_archive[i].values());
+            FAST_CHECK_EQ(r_flat[i].value(0), 3.0*i);
+        }
+        c.flat_replies = true;
+        FAST_CHECK_EQ(c.evaluate_async(etsv, ta.total_period(), false, false).get()[9].value(0), 27.0);
+        c.compress_replies = true;
+        auto r_compressed = c.evaluate(etsv, ta.total_period(), false, false);
+        FAST_REQUIRE_EQ(r_compressed.size(), r_flat.size());
+        for (size_t i = 0; i < r_flat.size(); ++i)
+            FAST_CHECK_EQ(r_compressed[i].values(), r_flat[i].values());
+        FAST_CHECK_EQ(c.evaluate_async(etsv, ta.total_period(), false, false).get()[9].value(0), 27.0);
+        size_t n_streamed = 0;
+        c.evaluate_stream(etsv, ta.total_period(), false, false, 4, [&n_streamed](size_t, ts_vector_t&& r) { n_streamed += r.size(); });
+        FAST_CHECK_EQ(n_streamed, etsv.size());
+        c.close();
+    }
+    srv.clear();
+}
+
+TEST_CASE("dtss_client_evaluate_stream") {
+    using namespace shyft::dtss;
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    time_axis::fixed_dt ta(t, deltahours(1), 24);
+    std::atomic<int> n_reads{0};
+    read_call_back_t rcb = [ta, &n_reads](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ++n_reads;
+        ts_vector_t r;
+        for (const auto& id : ts_ids) {
+            if (id.find("throw") != string::npos)
+                throw std::runtime_error("test exception");
+            r.emplace_back(ta, double(std::stoi(id.substr(id.rfind('/') + 1))));
+        }
+        return r;
+    };
+    int port_no = 20037;
+    string host_port = string("localhost:") + to_string(port_no);
+    server srv(rcb);
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(port_no);
+    srv.start_async();
+    {
+        client c(host_port);
+        ts_vector_t tsv;
+        for (int i = 0; i < 25; ++i)
+            tsv.push_back(2.0*apoint_ts(string("netcdf://a/") + to_string(i)));
+        for (bool flat : {true, false}) {// streamed, and all at once from a server without streaming
+            c.flat_replies = flat;
+            n_reads = 0;
+            vector<size_t> chunks;
+            size_t n = 0;
+            c.evaluate_stream(tsv, ta.total_period(), false, false, 10, [&](size_t i0, ts_vector_t&& r) {
+                FAST_CHECK_EQ(i0, n);
+                chunks.push_back(r.size());
+                for (size_t i = 0; i < r.size(); ++i)
+                    FAST_CHECK_EQ(r[i].value(0), 2.0*(i0 + i));
+                n += r.size();
+            });
+            FAST_CHECK_EQ(n, tsv.size());
+            FAST_CHECK_EQ(chunks, (vector<size_t>{10, 10, 5}));
+            FAST_CHECK_EQ(n_reads.load(), flat ? 3 : 1);// the server reads one chunk at the time
+        }
+        // an error in a later chunk comes after the chunks before it
+        c.flat_replies = true;
+        tsv[15] = apoint_ts(string("netcdf://throw/0"));
+        size_t n = 0;
+        CHECK_THROWS_AS(c.evaluate_stream(tsv, ta.total_period(), false, false, 10, [&n](size_t, ts_vector_t&& r) { n += r.size(); }), std::runtime_error);
+        FAST_CHECK_EQ(n, 10u);
+        ts_vector_t one; one.push_back(tsv[0]);
+        FAST_CHECK_EQ(c.evaluate(one, ta.total_period(), false, false)[0].value(0), 0.0);// still works
+        c.close();
+    }
+    srv.clear();
+}
+
+TEST_CASE("dtss_server_aggregates") {
+    using namespace shyft::dtss;
+    using namespace shyft::time_series;
+    calendar utc;
+    auto t = utc.time(2016, 1, 1);
+    time_axis::fixed_dt ta(t, deltahours(1), 48);
+    gta_t ta24(t, deltahours(24), 2);
+    read_call_back_t rcb = [ta](id_vector_t ts_ids, core::utcperiod p)->ts_vector_t {
+        ts_vector_t r;
+        for (const auto& id : ts_ids)
+            r.emplace_back(ta, double(std::stoi(id.substr(id.rfind('/') + 1))));
+        return r;
+    };
+    vector<unique_ptr<server>> srv;
+    vector<string> host_ports;
+    for (int i = 0; i < 2; ++i) {
+        int port_no = 20038 + i;
+        srv.emplace_back(new server(rcb));
+        srv.back()->set_listening_ip("127.0.0.1");
+        srv.back()->set_listening_port(port_no);
+        srv.back()->start_async();
+        host_ports.push_back(string("localhost:") + to_string(port_no));
+    }
+    ts_vector_t tsv;
+    vector<double> w;
+    for (int i = 0; i < 10; ++i) {
+        tsv.push_back(apoint_ts(string("netcdf://a/") + to_string(i)));
+        w.push_back(i < 5 ? 1.0 : 3.0);
+    }
+    const vector<int64_t> spec{SUM, MEAN, WEIGHTED_MEAN, HISTOGRAM};
+    const vector<double> bins{0.0, 5.0, 10.0};
+    auto verify = [&](const vector<apoint_ts>& r) {
+        FAST_REQUIRE_EQ(r.size(), 5u);
+        for (size_t k = 0; k < ta24.size(); ++k) {
+            FAST_CHECK_EQ(r[0].value(k), doctest::Approx(45.0));
+            FAST_CHECK_EQ(r[1].value(k), doctest::Approx(4.5));
+            FAST_CHECK_EQ(r[2].value(k), doctest::Approx((10.0 + 3*35.0)/20.0));
+            FAST_CHECK_EQ(r[3].value(k), doctest::Approx(5.0));
+            FAST_CHECK_EQ(r[4].value(k), doctest::Approx(5.0));
+        }
+        FAST_CHECK_EQ(r[0].time_axis(), ta24);
+    };
+    {
+        client c(host_ports[0]);
+        verify(c.aggregates(tsv, ta.total_period(), ta24, spec, w, bins, false, false));// aggregated by the server
+        FAST_CHECK_GE(c.srv_con[0].wire_version, int(msg::wire_version_aggregate));
+        c.compress_expressions = false;
+        verify(c.aggregates(tsv, ta.total_period(), ta24, spec, w, bins, false, false));
+        CHECK_THROWS_AS(c.aggregates(tsv, ta.total_period(), ta24, spec, vector<double>{1.0}, bins, false, false), std::runtime_error);
+        c.close();
+    }
+    {
+        client c(host_ports, true, 1000);
+        verify(c.aggregates(tsv, ta.total_period(), ta24, spec, w, bins, false, false));// aggregated by the client
+        c.close();
+    }
+    for (auto& s : srv)
+        s->clear();
+}
+
+TEST_CASE("dtss_subscriptions") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.subscription.test");
+    gta_t ta(utctime(0), deltahours(1), 24);
+    server srv;
+    srv.add_container("test", tmpdir.string());
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20040);
+    srv.start_async();
+    const string host_port("localhost:20040");
+    auto store = [&](const string& name, double v, bool merge) {
+        client w(host_port);
+        ts_vector_t s;
+        s.push_back(apoint_ts(shyft_url("test", name), apoint_ts(ta, v, shyft::time_series::POINT_AVERAGE_VALUE)));
+        if (merge)
+            w.merge_store_ts(s, false);
+        else
+            w.store_ts(s, true, false);
+        w.close();
+    };
+    store("a", 1.0, false);
+    store("b", 2.0, false);
+    apoint_ts a(shyft_url("test", "a")), b(shyft_url("test", "b"));
+    ts_vector_t tsv;
+    tsv.push_back(2.0*a);
+    tsv.push_back(b + 1.0);
+    tsv.push_back(a + b);
+    {
+        client c(host_port);
+        ts_vector_t r;
+        auto sid = c.subscribe(tsv, ta.total_period(), true, false, r);
+        FAST_REQUIRE_EQ(r.size(), 3u);
+        FAST_CHECK_EQ(r[0].value(0), 2.0);
+        FAST_CHECK_EQ(r[1].value(0), 3.0);
+        FAST_CHECK_EQ(r[2].value(0), 3.0);
+        FAST_CHECK_EQ(srv.subscriptions.size(), 1u);
+        ts_vector_t changed;
+        FAST_CHECK_EQ(c.read_subscription(sid, std::chrono::milliseconds(0), changed).size(), 0u);// nothing changed
+        FAST_CHECK_EQ(changed.size(), 0u);
+        store("a", 10.0, false);
+        auto ix = c.read_subscription(sid, std::chrono::milliseconds(1000), changed);
+        FAST_REQUIRE_EQ(ix.size(), 2u);// only those referencing a
+        FAST_CHECK_EQ(ix[0], 0u);
+        FAST_CHECK_EQ(ix[1], 2u);
+        FAST_REQUIRE_EQ(changed.size(), 2u);
+        FAST_CHECK_EQ(changed[0].value(0), 20.0);
+        FAST_CHECK_EQ(changed[1].value(0), 12.0);
+        auto waiting = std::async(std::launch::async, [&]() { ts_vector_t x; auto i = c.read_subscription(sid, std::chrono::milliseconds(10000), x); return i; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const auto t0 = timing::now();
+        store("b", 5.0, true);// a merge store notifies as well
+        ix = waiting.get();
+        FAST_CHECK_LT(elapsed_ms(t0, timing::now()), 5000);// woken by the store, not by the max wait
+        FAST_REQUIRE_EQ(ix.size(), 2u);
+        FAST_CHECK_EQ(ix[0], 1u);
+        FAST_CHECK_EQ(ix[1], 2u);
+        c.compress_expressions = false;
+        ts_vector_t r2;
+        auto sid2 = c.subscribe(tsv, ta.total_period(), false, false, r2);
+        FAST_CHECK_NE(sid2, sid);
+        FAST_CHECK_EQ(r2[2].value(0), 15.0);
+        c.unsubscribe(sid);
+        CHECK_THROWS_AS(c.read_subscription(sid, std::chrono::milliseconds(0), changed), std::runtime_error);
+        FAST_CHECK_EQ(srv.subscriptions.size(), 1u);
+        c.unsubscribe(sid);// not there, ignored
+        c.close();
+    }
+    for (int i = 0; i < 100 && srv.subscriptions.size(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    FAST_CHECK_EQ(srv.subscriptions.size(), 0u);// removed with the connection
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_hash_ring") {
+    using namespace shyft::dtss;
+    hash_ring r3(3), r4(4);
+    FAST_CHECK_EQ(r3.size(), 3u);
+    FAST_CHECK_EQ(hash_ring().nodes_of("x", 2).size(), 0u);
+    vector<size_t> count(3, 0);
+    size_t moved = 0;
+    const size_t n = 3000;
+    for (size_t i = 0; i < n; ++i) {
+        auto id = shyft_url("test", "ts" + std::to_string(i));
+        auto nodes = r3.nodes_of(id, 2);
+        FAST_REQUIRE_EQ(nodes.size(), 2u);
+        FAST_CHECK_NE(nodes[0], nodes[1]);
+        FAST_CHECK_EQ(nodes[0], r3.primary_of(id));
+        FAST_CHECK_EQ(r3.nodes_of(id, 5).size(), 3u);// at most all nodes
+        ++count[nodes[0]];
+        auto p4 = r4.primary_of(id);
+        if (p4 != nodes[0]) {
+            ++moved;
+            FAST_CHECK_EQ(p4, 3u);// only to the new node
+        }
+    }
+    for (auto c : count) {
+        FAST_CHECK_GT(c, n/5);// roughly even
+        FAST_CHECK_LT(c, n/2);
+    }
+    FAST_CHECK_LT(moved, n/2);
+    auto parts = partition_by_cost(vector<double>{ 1.0, 1.0, 1.0, 1.0 }, 3, vector<vector<size_t>>{ {1}, {1, 2}, {}, {1} });
+    FAST_CHECK_EQ(parts[1], (vector<size_t>{ 0, 3 }));
+    FAST_CHECK_EQ(parts[2], (vector<size_t>{ 1 }));
+    FAST_CHECK_EQ(parts[0], (vector<size_t>{ 2 }));
+}
+
+TEST_CASE("dtss_cluster") {
+    using namespace shyft::dtss;
+    const size_t n_nodes = 3;
+    gta_t ta(utctime(0), deltahours(1), 24);
+    vector<string> host_ports;
+    vector<fs::path> dirs;
+    vector<unique_ptr<server>> nodes;
+    for (size_t i = 0; i < n_nodes; ++i)
+        host_ports.push_back("localhost:" + std::to_string(20041 + i));
+    for (size_t i = 0; i < n_nodes; ++i) {
+        dirs.push_back(fs::temp_directory_path()/("ts.db.cluster.test." + std::to_string(i)));
+        nodes.emplace_back(new server());
+        nodes[i]->add_container("test", dirs[i].string());
+        nodes[i]->set_cluster(host_ports, i, 2);
+        nodes[i]->set_listening_ip("127.0.0.1");
+        nodes[i]->set_listening_port(20041 + i);
+        nodes[i]->start_async();
+    }
+    auto flush = [&]() { for (auto& s : nodes) s->flush_replication(); };
+    const size_t n = 30;
+    ts_vector_t tsv, refs;
+    for (size_t i = 0; i < n; ++i) {
+        tsv.push_back(apoint_ts(shyft_url("test", "s" + std::to_string(i)), apoint_ts(ta, double(i), shyft::time_series::POINT_AVERAGE_VALUE)));
+        refs.push_back(apoint_ts(shyft_url("test", "s" + std::to_string(i))));
+    }
+    client c(host_ports, true, 1000);
+    c.set_cluster(2);
+    c.store_ts(tsv, true, false);// each series to its primary, that replicates it
+    flush();
+    hash_ring ring(n_nodes);
+    for (size_t k = 0; k < n_nodes; ++k) {
+        FAST_CHECK_EQ(nodes[k]->get_replication_pending(), 0u);
+        FAST_CHECK_EQ(nodes[k]->get_replication_failures(), 0u);
+        size_t expected = 0;
+        for (size_t i = 0; i < n; ++i) {
+            auto rn = ring.nodes_of(shyft_url("test", "s" + std::to_string(i)), 2);
+            if (std::find(rn.begin(), rn.end(), k) != rn.end()) ++expected;
+        }
+        FAST_CHECK_EQ(nodes[k]->internal("test")->find("s.*").size(), expected);
+    }
+    // any node evaluates any series, reading those on other nodes from there
+    for (size_t k = 0; k < n_nodes; ++k) {
+        client ck(host_ports[k]);
+        auto r = ck.evaluate(refs, ta.total_period(), false, false);
+        FAST_REQUIRE_EQ(r.size(), n);
+        for (size_t i = 0; i < n; ++i)
+            FAST_CHECK_EQ(r[i].value(0), double(i));
+        ck.close();
+    }
+    ts_vector_t sums;
+    for (size_t i = 0; i + 1 < n; ++i)
+        sums.push_back(refs[i] + refs[i + 1]);
+    auto r = c.evaluate(sums, ta.total_period(), false, false);
+    FAST_REQUIRE_EQ(r.size(), n - 1);
+    for (size_t i = 0; i + 1 < n; ++i)
+        FAST_CHECK_EQ(r[i].value(0), double(2*i + 1));
+    // a merge store through any node is merged at the primary, and replicated
+    {
+        client c0(host_ports[0]);
+        ts_vector_t m;
+        for (size_t i = 0; i < n; ++i)
+            m.push_back(apoint_ts(shyft_url("test", "s" + std::to_string(i)), apoint_ts(ta, 100.0 + i, shyft::time_series::POINT_AVERAGE_VALUE)));
+        c0.merge_store_ts(m, false);
+        c0.close();
+    }
+    flush();
+    for (size_t k = 0; k < n_nodes; ++k) {
+        for (size_t i = 0; i < n; ++i) {
+            auto path = "s" + std::to_string(i);
+            auto rn = ring.nodes_of(shyft_url("test", path), 2);
+            if (std::find(rn.begin(), rn.end(), k) == rn.end())
+                continue;
+            auto ts = nodes[k]->internal("test")->read(path, ta.total_period());// the replica has the merge
+            FAST_REQUIRE_EQ(ts.size(), ta.size());
+            FAST_CHECK_EQ(ts.value(0), 100.0 + i);
+            FAST_CHECK_EQ(ts.value(23), 100.0 + i);
+        }
+    }
+    c.close();
+    for (size_t k = 0; k < n_nodes; ++k) {
+        nodes[k]->clear();
+        fs::remove_all(dirs[k]);
+    }
+}
+
+TEST_CASE("dtss_container_registry") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.registry.test");
+    {
+        container_registry reg;
+        FAST_CHECK_EQ(reg.size(), 0u);
+        FAST_CHECK_UNARY(!reg.find("a"));
+        fs::create_directories(tmpdir);
+        auto a = make_shared<ts_db>((tmpdir/"a").string());
+        reg.add("a", a);
+        auto before = reg.snapshot();
+        reg.add("b", make_shared<ts_db>((tmpdir/"b").string()));
+        FAST_CHECK_EQ(before->size(), 1u);// a snapshot is not changed by later adds
+        FAST_CHECK_EQ(reg.names(), (vector<string>{ "a", "b" }));
+        FAST_CHECK_EQ(reg.find("a").get(), a.get());
+        FAST_CHECK_UNARY(reg.remove("a"));
+        FAST_CHECK_UNARY(!reg.remove("a"));
+        FAST_CHECK_UNARY(!reg.find("a"));
+        // concurrent lookups while containers are added and removed
+        std::atomic<bool> done{false};
+        std::atomic<size_t> misses{0};
+        vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t)
+            readers.emplace_back([&]() {
+                while (!done)
+                    if (!reg.find("b")) ++misses;// b is there all the time
+            });
+        for (int i = 0; i < 200; ++i) {
+            reg.add("c" + std::to_string(i%10), a);
+            reg.remove("c" + std::to_string((i + 5)%10));
+        }
+        done = true;
+        for (auto& t : readers)
+            t.join();
+        FAST_CHECK_EQ(misses.load(), 0u);
+    }
+    // containers added and removed on a running server
+    server srv;
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20044);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    ts_vector_t tsv;
+    tsv.push_back(apoint_ts(shyft_url("late", "x"), apoint_ts(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE)));
+    client c("localhost:20044");
+    CHECK_THROWS_AS(c.store_ts(tsv, true, false), std::runtime_error);
+    srv.add_container("late", (tmpdir/"late").string());
+    c.store_ts(tsv, true, false);
+    ts_vector_t refs; refs.push_back(apoint_ts(shyft_url("late", "x")));
+    auto r = c.evaluate(refs, ta.total_period(), false, false);
+    FAST_REQUIRE_EQ(r.size(), 1u);
+    FAST_CHECK_EQ(r[0].value(0), 1.0);
+    FAST_CHECK_EQ(srv.get_container_names(), (vector<string>{ "late" }));
+    FAST_CHECK_UNARY(srv.remove_container("late"));
+    CHECK_THROWS_AS(c.evaluate(refs, ta.total_period(), false, false), std::runtime_error);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_request_scheduler") {
+    using namespace shyft::dtss;
+    request_scheduler rs;
+    FAST_CHECK_EQ(rs.stats().workers, 0u);
+    { auto t = rs.admit(1, 1e9); }// off, runs at once
+    FAST_CHECK_EQ(rs.stats().admitted, 0u);
+    rs.configure(1);
+    rs.connect(1, "batch");
+    rs.connect(2, "user");
+    std::mutex order_mx;
+    vector<string> order;
+    vector<std::thread> waiters;
+    auto wait_queued = [&rs](size_t n) {
+        for (int i = 0; i < 1000 && rs.stats().queued != n; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        FAST_REQUIRE_EQ(rs.stats().queued, n);
+    };
+    auto request = [&](std::uint64_t cid, const string& name, double cost) {
+        waiters.emplace_back([&, cid, name, cost]() {
+            auto t = rs.admit(cid, cost);
+            std::lock_guard<std::mutex> guard(order_mx);
+            order.push_back(name);
+        });
+    };
+    {
+        auto running = rs.admit(1, 100.0);// the batch job holds the worker
+        for (int i = 0; i < 4; ++i) {
+            request(1, "b" + std::to_string(i), 100.0);
+            wait_queued(i + 1);
+        }
+        request(2, "u", 1.0);// arrives last, with a small request
+        wait_queued(5);
+        auto s = rs.stats();
+        FAST_CHECK_EQ(s.running, 1u);
+        FAST_CHECK_EQ(s.clients, 2u);
+        FAST_CHECK_EQ(s.queued_cost, 401.0);
+    }
+    for (auto& w : waiters)
+        w.join();
+    FAST_REQUIRE_EQ(order.size(), 5u);
+    FAST_CHECK_EQ(order[0], "u");// the fair share of user is not behind the queued batch requests
+    FAST_CHECK_EQ(order[1], "b0");
+    FAST_CHECK_EQ(order[4], "b3");
+    FAST_CHECK_EQ(rs.stats().admitted, 6u);
+    FAST_CHECK_EQ(rs.stats().running, 0u);
+    // admission control, the requests beyond a full queue are rejected
+    waiters.clear();
+    rs.configure(1, 2);
+    {
+        auto running = rs.admit(1, 1.0);
+        request(1, "q0", 1.0);
+        request(2, "q1", 1.0);
+        wait_queued(2);
+        CHECK_THROWS_AS(rs.admit(2, 1.0), std::runtime_error);
+        FAST_CHECK_EQ(rs.stats().rejected, 1u);
+    }
+    for (auto& w : waiters)
+        w.join();
+    FAST_CHECK_EQ(rs.stats().queued, 0u);
+    CHECK_THROWS_AS(rs.set_weight("user", 0.0), std::runtime_error);
+}
+
+TEST_CASE("dtss_server_scheduling") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.scheduling.test");
+    server srv;
+    srv.add_container("test", tmpdir.string());
+    srv.set_scheduling(2, 10);
+    srv.set_client_weight("127.0.0.1", 4.0);
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20045);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    ts_vector_t tsv, refs;
+    for (int i = 0; i < 4; ++i) {
+        tsv.push_back(apoint_ts(shyft_url("test", "s" + std::to_string(i)), apoint_ts(ta, double(i), shyft::time_series::POINT_AVERAGE_VALUE)));
+        refs.push_back(apoint_ts(shyft_url("test", "s" + std::to_string(i))));
+    }
+    client c("localhost:20045");
+    c.store_ts(tsv, true, false);
+    vector<std::future<vector<apoint_ts>>> calcs;
+    for (int i = 0; i < 8; ++i)
+        calcs.push_back(std::async(std::launch::async, [&refs, &ta]() {
+            client w("localhost:20045");
+            auto r = w.evaluate(refs, ta.total_period(), false, false);
+            w.close();
+            return r;
+        }));
+    for (auto& f : calcs)
+        FAST_CHECK_EQ(f.get()[3].value(0), 3.0);
+    auto s = c.get_scheduler_stats();
+    FAST_CHECK_EQ(s.workers, 2u);
+    FAST_CHECK_EQ(s.max_queued, 10u);
+    FAST_CHECK_EQ(s.admitted, 9u);// the store and the evaluations
+    FAST_CHECK_EQ(s.running, 0u);
+    FAST_CHECK_EQ(s.rejected, 0u);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_cache_warm_up") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.warm_up.test");
+    fs::create_directories(tmpdir);
+    const string log = (tmpdir/"hot_set.txt").string();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    gta_t ta2(utctime(0), deltahours(1), 12);
+    ts_vector_t tsv;
+    for (int i = 0; i < 3; ++i)
+        tsv.push_back(apoint_ts(shyft_url("c", "x" + std::to_string(i)), apoint_ts(ta, double(i), shyft::time_series::POINT_AVERAGE_VALUE)));
+    {
+        server a;
+        a.add_container("c", (tmpdir/"c").string());
+        a.do_store_ts(tsv, true, false);
+        a.do_read(id_vector_t{ shyft_url("c", "x0") }, ta.total_period(), true, true);
+        a.do_read(id_vector_t{ shyft_url("c", "x2") }, ta2.total_period(), true, true);
+        a.save_cache_hot_set(log);
+        auto hs = read_hot_set(log);
+        FAST_REQUIRE_EQ(hs.size(), 2u);
+        std::sort(hs.begin(), hs.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+        FAST_CHECK_EQ(hs[0].first, shyft_url("c", "x0"));
+        FAST_CHECK_EQ(hs[0].second, ta.total_period());
+        FAST_CHECK_EQ(hs[1].first, shyft_url("c", "x2"));
+        FAST_CHECK_EQ(hs[1].second, ta2.total_period());
+        a.save_cache_hot_set(log, 1);
+        FAST_CHECK_EQ(read_hot_set(log).size(), 1u);
+        // recorded periodically, and once more when stopped
+        fs::remove(log);
+        a.set_cache_hot_set_recording(log, std::chrono::milliseconds(3600*1000));
+        a.set_cache_hot_set_recording(log, std::chrono::milliseconds(0));
+        FAST_CHECK_EQ(read_hot_set(log).size(), 2u);
+    }
+    auto hs = read_hot_set(log);
+    hs.emplace_back(shyft_url("gone", "y"), ta.total_period());// a removed container is skipped
+    write_hot_set(log, hs);
+    server b;
+    b.add_container("c", (tmpdir/"c").string());
+    FAST_CHECK_EQ(b.wait_warm_cache(), 0u);
+    b.start_warm_cache(log);
+    FAST_CHECK_EQ(b.wait_warm_cache(), 2u);
+    auto cs = b.get_cache_stats();
+    FAST_CHECK_EQ(cs.id_count, 2u);
+    auto r = b.do_read(id_vector_t{ shyft_url("c", "x2") }, ta2.total_period(), true, false);
+    FAST_CHECK_EQ(b.get_cache_stats().hits, cs.hits + 1);
+    FAST_CHECK_EQ(r[0].value(0), 2.0);
+    FAST_CHECK_EQ(b.warm_cache((tmpdir/"none.txt").string()), 0u);// no file, nothing to warm
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_cache_snapshot") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.snapshot.test");
+    fs::remove_all(tmpdir);
+    fs::create_directories(tmpdir);
+    const string file = (tmpdir/"cache.snapshot").string();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    gta_t ta2(utctime(0) + deltahours(48), deltahours(1), 24);// a second fragment of a
+    gta_t tp(vector<utctime>{ utctime(0), utctime(10), utctime(30) }, utctime(40));
+    id_vector_t ids{ "a", "b", "a", "c" };
+    ts_vector_t tss;
+    tss.push_back(apoint_ts(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE));
+    tss.push_back(apoint_ts(ta, vector<double>(24, 2.0), shyft::time_series::POINT_AVERAGE_VALUE));
+    tss.push_back(apoint_ts(ta2, 3.0, shyft::time_series::POINT_AVERAGE_VALUE));
+    tss.push_back(apoint_ts(tp, vector<double>{ 1.0, 2.0, 3.0 }, shyft::time_series::POINT_INSTANT_VALUE));
+    vector<string> lru_order;
+    {
+        server a;
+        FAST_CHECK_EQ(a.set_cache_snapshot(file), 0u);// no snapshot yet
+        a.add_to_cache(ids, tss);
+        for (const auto& x : a.ts_cache.get_mru_items())
+            lru_order.insert(lru_order.begin(), x.first);
+    }// saved when destroyed
+    vector<string> read_order;
+    FAST_CHECK_EQ(read_cache_snapshot(file, [&](const string& id, const ts_vector_t&) { read_order.push_back(id); }), 3u);
+    FAST_CHECK_EQ(read_order, lru_order);
+    server b;
+    FAST_CHECK_EQ(b.load_cache_snapshot(file), 3u);
+    auto cs = b.get_cache_stats();
+    FAST_CHECK_EQ(cs.id_count, 3u);
+    FAST_CHECK_EQ(cs.fragment_count, 4u);
+    auto r = b.do_read(id_vector_t{ "a" }, ta2.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(0), 3.0);
+    r = b.do_read(id_vector_t{ "b", "c" }, tp.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(5), 2.0);
+    FAST_CHECK_EQ(r[1].time_axis(), tp);
+    FAST_CHECK_EQ(r[1].value(2), 3.0);
+    FAST_CHECK_EQ(b.get_cache_stats().hits, cs.hits + 3);
+    {
+        std::ofstream bad(file, std::ios::trunc); bad << "not a snapshot";
+    }
+    CHECK_THROWS_AS(b.load_cache_snapshot(file), std::runtime_error);
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_server_metrics") {
+    using namespace shyft::dtss;
+    {
+        latency_histogram h;
+        h.observe(std::chrono::microseconds(10));
+        h.observe(std::chrono::microseconds(700));
+        h.observe(std::chrono::seconds(60));
+        FAST_CHECK_EQ(h.count(), 3u);
+        std::ostringstream os;
+        h.write(os, "x_seconds", "a=\"b\"");
+        const auto text = os.str();
+        FAST_CHECK_NE(text.find("x_seconds_bucket{a=\"b\",le=\"5e-05\"} 1\n"), string::npos);
+        FAST_CHECK_NE(text.find("x_seconds_bucket{a=\"b\",le=\"0.001\"} 2\n"), string::npos);// cumulative
+        FAST_CHECK_NE(text.find("x_seconds_bucket{a=\"b\",le=\"+Inf\"} 3\n"), string::npos);
+        FAST_CHECK_NE(text.find("x_seconds_count{a=\"b\"} 3\n"), string::npos);
+    }
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.metrics.test");
+    server srv;
+    srv.add_container("c", tmpdir.string());
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20046);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    ts_vector_t tsv;
+    tsv.push_back(apoint_ts(shyft_url("c", "x"), apoint_ts(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE)));
+    ts_vector_t refs; refs.push_back(apoint_ts(shyft_url("c", "x")));
+    client c("localhost:20046");
+    c.store_ts(tsv, true, false);
+    c.evaluate(refs, ta.total_period(), false, false);
+    ts_vector_t missing; missing.push_back(apoint_ts(shyft_url("none", "x")));
+    CHECK_THROWS_AS(c.evaluate(missing, ta.total_period(), false, false), std::runtime_error);
+    auto m = c.get_metrics();
+    FAST_REQUIRE_EQ(m.size(), 1u);
+    FAST_CHECK_NE(m[0].find("dtss_request_seconds_count{type=\"STORE_TS\"} 1\n"), string::npos);
+    FAST_CHECK_NE(m[0].find("dtss_phase_seconds_count{phase=\"bind\"} 2\n"), string::npos);
+    FAST_CHECK_NE(m[0].find("dtss_ts_db_seconds_count{op=\"write\"} 1\n"), string::npos);
+    FAST_CHECK_NE(m[0].find("dtss_ts_db_seconds_count{op=\"read\"} 2\n"), string::npos);// also the failed one
+    FAST_CHECK_NE(m[0].find("dtss_requests_failed_total 1\n"), string::npos);
+    FAST_CHECK_NE(m[0].find("dtss_connections 1\n"), string::npos);
+    FAST_CHECK_GT(srv.metrics.bytes_received.load(), 0u);
+    FAST_CHECK_GT(srv.metrics.bytes_sent.load(), 0u);
+    // scraped over http
+    const int port = srv.start_metrics_http(20047, "127.0.0.1");
+    FAST_CHECK_EQ(port, 20047);
+    auto http_get = [](const string& path) {
+        dlib::iosockstream s;
+        s.open("localhost:20047");
+        s << "GET " << path << " HTTP/1.0\r\nHost: localhost\r\n\r\n";
+        s.flush();
+        std::ostringstream r;
+        r << s.rdbuf();
+        return r.str();
+    };
+    auto r = http_get("/metrics");
+    FAST_CHECK_EQ(r.find("HTTP/1.0 200 OK\r\n"), 0u);
+    FAST_CHECK_NE(r.find("dtss_cache_hits_total"), string::npos);
+    FAST_CHECK_EQ(http_get("/other").find("HTTP/1.0 404"), 0u);
+    srv.stop_metrics_http();
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_expression_result_cache") {
+    using namespace shyft::dtss;
+    {
+        expression_result_cache<int> rc;
+        rc.add("k", 1, id_vector_t{"a"}, rc.generation());
+        FAST_CHECK_EQ(rc.size(), 0u);// off
+        rc.set_capacity(2);
+        rc.add("k1", 1, id_vector_t{"a", "b"}, rc.generation());
+        rc.add("k2", 2, id_vector_t{"b"}, rc.generation());
+        int r{0};
+        FAST_CHECK_UNARY(rc.try_get("k1", r));
+        FAST_CHECK_EQ(r, 1);
+        rc.add("k3", 3, id_vector_t{"c"}, rc.generation());// evicts k2, the least recently used
+        FAST_CHECK_EQ(rc.size(), 2u);
+        FAST_CHECK_UNARY_FALSE(rc.try_get("k2", r));
+        rc.invalidate(id_vector_t{"a"});
+        FAST_CHECK_UNARY_FALSE(rc.try_get("k1", r));
+        FAST_CHECK_UNARY(rc.try_get("k3", r));
+        const auto gen = rc.generation();// evaluating k4 ..
+        rc.invalidate(id_vector_t{"d"});// .. while d is stored
+        rc.add("k4", 4, id_vector_t{"d"}, gen);
+        FAST_CHECK_UNARY_FALSE(rc.try_get("k4", r));// the stale result is dropped
+        rc.add("k4", 4, id_vector_t{"d"}, rc.generation());
+        FAST_CHECK_UNARY(rc.try_get("k4", r));
+        FAST_CHECK_EQ(rc.hits(), 3u);
+        FAST_CHECK_EQ(rc.misses(), 3u);
+        const size_t b = rc.estimate_bytes([](int) { return size_t(1000); });
+        FAST_CHECK_GT(b, 2*1000u);
+        FAST_CHECK_LT(b, 2*1000u + 1000u);
+        rc.flush();
+        FAST_CHECK_EQ(rc.estimate_bytes([](int) { return size_t(1000); }), 0u);
+        FAST_CHECK_EQ(rc.size(), 0u);
+    }
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.result_cache.test");
+    fs::remove_all(tmpdir);
+    server srv;
+    srv.add_container("c", tmpdir.string());
+    srv.set_result_cache_size(100);
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20048);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    auto store = [&ta](client& c, double v) {
+        ts_vector_t tsv;
+        tsv.push_back(apoint_ts(shyft_url("c", "x"), apoint_ts(ta, v, shyft::time_series::POINT_AVERAGE_VALUE)));
+        c.store_ts(tsv, true, true);
+    };
+    ts_vector_t e; e.push_back(2.0*apoint_ts(shyft_url("c", "x")));
+    client c("localhost:20048");
+    store(c, 1.0);
+    auto r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_REQUIRE_EQ(r.size(), 1u);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(2.0));
+    FAST_CHECK_EQ(srv.result_cache.size(), 1u);
+    auto cs = c.get_cache_stats();
+    FAST_CHECK_EQ(cs.result_count, 1u);
+    FAST_CHECK_GT(cs.result_byte_count, 24*sizeof(double));
+    FAST_CHECK_GT(cs.byte_count, 24*sizeof(double));
+    r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(2.0));
+    FAST_CHECK_EQ(srv.result_cache.hits(), 1u);
+    c.evaluate(e, ta.total_period(), false, false);// reading the sources, not cached
+    FAST_CHECK_EQ(srv.result_cache.hits(), 1u);
+    store(c, 3.0);// invalidates the result
+    FAST_CHECK_EQ(srv.result_cache.size(), 0u);
+    r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(6.0));
+    FAST_CHECK_EQ(srv.result_cache.misses(), 2u);
+    FAST_CHECK_NE(c.get_metrics()[0].find("dtss_result_cache_hits_total 1\n"), string::npos);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_get_ts_info") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.ts_info.test");
+    fs::remove_all(tmpdir);
+    server srv;
+    srv.add_container("c", tmpdir.string());
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20049);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    ts_vector_t tsv;
+    tsv.push_back(apoint_ts(shyft_url("c", "a"), apoint_ts(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE)));
+    tsv.push_back(apoint_ts(shyft_url("c", "b/x"), apoint_ts(ta, 2.0, shyft::time_series::POINT_INSTANT_VALUE)));
+    client c("localhost:20049");
+    c.store_ts(tsv, true, false);
+    id_vector_t ext_ids{ "ext://a" };
+    ts_vector_t ext; ext.push_back(apoint_ts(ta, 3.0, shyft::time_series::POINT_INSTANT_VALUE));
+    srv.add_to_cache(ext_ids, ext);
+    const auto hits = srv.get_cache_stats().hits;
+    auto r = c.get_ts_info(id_vector_t{ shyft_url("c", "a"), shyft_url("c", "none"), "ext://a", shyft_url("c", "b/x"), shyft_url("none", "a"), "ext://none" });
+    FAST_REQUIRE_EQ(r.size(), 6u);
+    FAST_CHECK_EQ(r[0].name, shyft_url("c", "a"));
+    FAST_CHECK_EQ(r[0].data_period, ta.total_period());
+    FAST_CHECK_EQ(r[0].point_fx, shyft::time_series::POINT_AVERAGE_VALUE);
+    FAST_CHECK_UNARY(r[0].modified != no_utctime);
+    FAST_CHECK_EQ(r[1].name, shyft_url("c", "none"));
+    FAST_CHECK_UNARY_FALSE(r[1].data_period.valid());
+    FAST_CHECK_EQ(r[2].name, "ext://a");
+    FAST_CHECK_EQ(r[2].data_period, ta.total_period());
+    FAST_CHECK_EQ(r[2].point_fx, shyft::time_series::POINT_INSTANT_VALUE);
+    FAST_CHECK_EQ(r[2].delta_t, deltahours(1));
+    FAST_CHECK_EQ(r[3].point_fx, shyft::time_series::POINT_INSTANT_VALUE);
+    FAST_CHECK_EQ(r[3].data_period, ta.total_period());
+    FAST_CHECK_UNARY_FALSE(r[4].data_period.valid());
+    FAST_CHECK_UNARY_FALSE(r[5].data_period.valid());
+    FAST_CHECK_EQ(srv.get_cache_stats().hits, hits);// the cache is only inspected
+    // a file written by other means, not in the catalogue, is read from the file
+    fs::copy_file(tmpdir/"a", tmpdir/"copy");
+    auto cr = srv.internal("c")->get_ts_infos(id_vector_t{ "copy" });
+    FAST_REQUIRE_EQ(cr.size(), 1u);
+    FAST_CHECK_EQ(cr[0].name, "copy");
+    FAST_CHECK_EQ(cr[0].data_period, ta.total_period());
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_validated_cache") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.validated_cache.test");
+    fs::remove_all(tmpdir);
+    server srv;
+    srv.add_container("c", tmpdir.string());
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20050);
+    srv.start_async();
+    gta_t ta(utctime(0), deltahours(1), 24);
+    auto store = [&ta](client& c, const string& name, double v) {
+        ts_vector_t tsv;
+        tsv.push_back(apoint_ts(shyft_url("c", name), apoint_ts(ta, v, shyft::time_series::POINT_AVERAGE_VALUE)));
+        c.store_ts(tsv, true, true);
+    };
+    id_vector_t ext_ids{ "ext://a" };
+    ts_vector_t ext; ext.push_back(apoint_ts(ta, 5.0, shyft::time_series::POINT_AVERAGE_VALUE));
+    srv.add_to_cache(ext_ids, ext);
+    ts_vector_t e;
+    e.push_back(2.0*apoint_ts(shyft_url("c", "x")));
+    e.push_back(apoint_ts(shyft_url("c", "x")) + apoint_ts(shyft_url("c", "y")));
+    e.push_back(apoint_ts("ext://a"));// not versioned, always evaluated
+    client c("localhost:20050");
+    c.set_validated_cache_size(10);
+    store(c, "x", 1.0);
+    store(c, "y", 10.0);
+    auto r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_REQUIRE_EQ(r.size(), 3u);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(2.0));
+    FAST_CHECK_EQ(r[1].value(0), doctest::Approx(11.0));
+    FAST_CHECK_EQ(r[2].value(0), doctest::Approx(5.0));
+    FAST_CHECK_EQ(c.validated_cache.size(), 2u);
+    FAST_CHECK_EQ(c.validated_cache.hits(), 0u);
+    r[0].set(0, 100.0);// the caller's copy, not the cached result
+    r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(2.0));
+    FAST_CHECK_EQ(r[1].value(0), doctest::Approx(11.0));
+    FAST_CHECK_EQ(r[2].value(0), doctest::Approx(5.0));
+    FAST_CHECK_EQ(c.validated_cache.hits(), 2u);
+    store(c, "y", 20.0);// only the expression reading y is modified, also within the same second
+    r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(2.0));
+    FAST_CHECK_EQ(r[1].value(0), doctest::Approx(21.0));
+    FAST_CHECK_EQ(c.validated_cache.hits(), 3u);
+    r = c.evaluate(e, utcperiod(utctime(0), deltahours(12)), true, false);// another period, another key
+    FAST_CHECK_EQ(c.validated_cache.hits(), 3u);
+    FAST_CHECK_EQ(c.validated_cache.size(), 4u);
+    srv.flush_cache();// a new epoch, all versions changes
+    srv.add_to_cache(ext_ids, ext);
+    r = c.evaluate(e, ta.total_period(), true, false);
+    FAST_CHECK_EQ(r[1].value(0), doctest::Approx(21.0));
+    FAST_CHECK_EQ(c.validated_cache.hits(), 3u);
+    FAST_CHECK_EQ(c.validated_cache.validated(), 15u);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_read_ahead") {
+    using namespace shyft::dtss;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.read_ahead.test");
+    fs::remove_all(tmpdir);
+    server srv;
+    srv.add_container("c", tmpdir.string());
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20052);
+    srv.start_async();
+    const auto day = deltahours(24);
+    gta_t ta(utctime(0), deltahours(1), 24*90);
+    vector<double> v(ta.size());
+    for (size_t i = 0; i < v.size(); ++i) v[i] = double(i);
+    client c("localhost:20052");
+    ts_vector_t tsv;
+    tsv.push_back(apoint_ts(shyft_url("c", "x"), apoint_ts(ta, v, shyft::time_series::POINT_AVERAGE_VALUE)));
+    c.store_ts(tsv, true, false);
+    ts_vector_t e;
+    e.push_back(apoint_ts(shyft_url("c", "x")));
+    auto window = [day](int k) { return utcperiod(utctime(0) + k*10*day, utctime(0) + (k + 1)*10*day); };
+    c.evaluate(e, window(0), true, false);
+    c.evaluate(e, window(1), true, false);
+    srv.wait_read_ahead();
+    FAST_CHECK_EQ(srv.get_read_ahead_stats().first, 0u);// off by default
+    FAST_CHECK_EQ(srv.get_cache_stats().id_count, 0u);// the client does not update the cache
+    srv.set_read_ahead(1);
+    c.evaluate(e, window(3), true, false);// not adjacent to the previous read
+    c.evaluate(e, window(4), true, false);// window(5) is read ahead
+    srv.wait_read_ahead();
+    FAST_CHECK_EQ(srv.get_read_ahead_stats().first, 1u);
+    auto served = [&srv]() { auto s = srv.get_cache_stats(); return s.hits - s.coverage_misses; };// a hit is by id, covered or not
+    auto s0 = served();
+    auto r = c.evaluate(e, window(5), true, false);
+    FAST_REQUIRE_EQ(r.size(), 1u);
+    FAST_CHECK_EQ(r[0].value(0), doctest::Approx(24*50.0));
+    srv.wait_read_ahead();// window(6)
+    FAST_CHECK_EQ(served(), s0 + 1);// window(5) from the cache
+    FAST_CHECK_EQ(srv.get_read_ahead_stats().first, 2u);
+    c.evaluate(e, window(4), true, false);// paging backwards, window(3) is read ahead
+    srv.wait_read_ahead();
+    FAST_CHECK_EQ(srv.get_read_ahead_stats().first, 3u);
+    FAST_CHECK_EQ(srv.get_read_ahead_stats().second, 0u);
+    s0 = served();
+    c.evaluate(e, window(3), true, false);
+    srv.wait_read_ahead();
+    FAST_CHECK_EQ(served(), s0 + 1);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
 TEST_CASE("dlib_server_performance") {
     dlog.set_level(dlib::LALL);
     dlib::set_all_logging_output_streams(std::cout);
@@ -695,6 +2435,42 @@ TEST_CASE("dtss_store_basics") {
             db.remove(fn);
         }
 
+        TEST_SECTION("mmap_read_equals_stdio_read") {
+            vector<gts_t> tsv{
+                gts_t(gta_t(fta), 1.0, time_series::ts_point_fx::POINT_AVERAGE_VALUE),
+                gts_t(gta_t(cta2), 2.0, time_series::ts_point_fx::POINT_INSTANT_VALUE),
+                gts_t(gta_t(time_axis::calendar_dt(osl, t, core::deltahours(24), 400)), 3.0, time_series::ts_point_fx::POINT_AVERAGE_VALUE),
+                gts_t(gta_t(pta), 4.0, time_series::ts_point_fx::POINT_AVERAGE_VALUE)
+            };
+            for (auto& ts : tsv)
+                for (std::size_t i = 0; i < ts.size(); ++i) ts.set(i, double(i));
+            std::mt19937 rg(17);
+            for (std::size_t k = 0; k < tsv.size(); ++k) {
+                std::string fn("mmap/ts." + std::to_string(k) + ".db");
+                db.save(fn, tsv[k]);
+                auto tp = tsv[k].total_period();
+                std::uniform_int_distribution<int64_t> rt(int64_t(tp.start - core::deltahours(50)), int64_t(tp.end + core::deltahours(50)));
+                vector<utcperiod> ps{ utcperiod{}, tp, utcperiod{ tp.start - dt, tp.start }, utcperiod{ tp.end, tp.end + dt } };
+                for (int i = 0; i < 100; ++i) {
+                    auto a = utctime(rt(rg)), b = utctime(rt(rg));
+                    ps.emplace_back(std::min(a, b), std::max(a, b) + 1);
+                }
+                for (const auto& p : ps) {
+                    db.mmap_read = true;
+                    auto rm = db.read(fn, p);
+                    db.mmap_read = false;
+                    auto rs = db.read(fn, p);
+                    FAST_CHECK_EQ(rm.time_axis(), rs.time_axis());
+                    FAST_CHECK_EQ(rm.point_interpretation(), rs.point_interpretation());
+                    FAST_REQUIRE_EQ(rm.size(), rs.size());
+                    bool equal_values = rm.v == rs.v;
+                    FAST_CHECK_UNARY(equal_values);
+                }
+                db.mmap_read = true;
+                db.remove(fn);
+            }
+        }
+
         TEST_SECTION("dtss_db_speed") {
 			int n_ts = 120;
 			vector<gts_t> tsv; tsv.reserve(n_ts);
@@ -2096,6 +3872,628 @@ TEST_CASE("dtss_store_merge_write") {
     }
 }
 
+TEST_CASE("dtss_store_blocked_point_format") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    namespace ta = shyft::time_axis;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.blocked.test");
+    dtss::ts_db db1(tmpdir.string());// TS1, reference
+    db1.point_block_n = 0;
+    dtss::ts_db db2(tmpdir.string());// TS2, small blocks to get many of them
+    db2.point_block_n = 7;
+    std::mt19937 rg(11);
+    const core::utctime t0 = core::utctime(0);
+    auto mk_ts = [&rg, t0](core::utctime t_min, std::size_t n) {
+        std::uniform_int_distribution<int> rdt(1, 5);
+        vector<core::utctime> t;
+        core::utctime tx = t_min;
+        for (std::size_t i = 0; i < n; ++i) {
+            t.push_back(tx);
+            tx += core::deltahours(rdt(rg));
+        }
+        vector<double> v;
+        for (std::size_t i = 0; i < n; ++i) v.push_back(double(rg() % 1000));
+        return gts_t(gta_t(ta::point_dt(t, tx)), v, shyft::time_series::POINT_AVERAGE_VALUE);
+    };
+    auto is_ts2 = [&tmpdir](const std::string& fn) {
+        dtss::ts_db_header h;
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> fh{ std::fopen((tmpdir/fn).string().c_str(), "rb"), &std::fclose };
+        return fh && std::fread(&h, sizeof(h), 1, fh.get()) == 1 && h.signature[2] == '2';
+    };
+    auto check_equal_reads = [&](const std::string& fn1, const std::string& fn2, core::utcperiod tp) {
+        std::uniform_int_distribution<int64_t> rt(int64_t(tp.start - core::deltahours(10)), int64_t(tp.end + core::deltahours(10)));
+        vector<core::utcperiod> ps{ core::utcperiod{}, tp };
+        for (int i = 0; i < 50; ++i) {
+            auto a = core::utctime(rt(rg)), b = core::utctime(rt(rg));
+            ps.emplace_back(std::min(a, b), std::max(a, b) + 1);
+        }
+        for (const auto& p : ps) {
+            auto r1 = db1.read(fn1, p);
+            auto r2 = db2.read(fn2, p);
+            FAST_CHECK_EQ(r1.time_axis(), r2.time_axis());
+            bool equal_values = r1.v.size() == r2.v.size() && std::equal(r1.v.begin(), r1.v.end(), r2.v.begin(), [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); });
+            FAST_CHECK_UNARY(equal_values);
+        }
+    };
+    SUBCASE("read") {
+        for (std::size_t n : { 1, 6, 7, 8, 50 }) {
+            auto o = mk_ts(t0, n);
+            db1.save("ts1.db", o);
+            db2.save("ts2.db", o);
+            FAST_CHECK_UNARY(!is_ts2("ts1.db"));
+            FAST_CHECK_UNARY(is_ts2("ts2.db"));
+            auto r = db2.read("ts2.db", core::utcperiod{});
+            FAST_CHECK_EQ(r.time_axis(), o.time_axis());
+            check_equal_reads("ts1.db", "ts2.db", o.total_period());
+            // TS1 files are still readable with TS2 enabled
+            auto r1 = db2.read("ts1.db", core::utcperiod{});
+            FAST_CHECK_EQ(r1.time_axis(), o.time_axis());
+        }
+        db1.remove("ts1.db");
+        db2.remove("ts2.db");
+    }
+    SUBCASE("merge") {
+        auto o = mk_ts(t0 + core::deltahours(200), 30);
+        db1.save("m1.db", o);
+        db2.save("m2.db", o);
+        std::uniform_int_distribution<int64_t> r_start(0, 600);
+        std::uniform_int_distribution<int> r_n(1, 25);
+        for (int i = 0; i < 200; ++i) {
+            auto x = (i % 3 == 0) ? // every third is an append
+                mk_ts(db1.read("m1.db", core::utcperiod{}).total_period().end + core::deltahours(r_start(rg) % 3), r_n(rg)) :
+                mk_ts(t0 + core::deltahours(r_start(rg)), r_n(rg));
+            db1.save("m1.db", x, false);
+            db2.save("m2.db", x, false);
+            FAST_REQUIRE_UNARY(is_ts2("m2.db"));
+            auto r1 = db1.read("m1.db", core::utcperiod{});
+            check_equal_reads("m1.db", "m2.db", r1.total_period());
+        }
+        db1.remove("m1.db");
+        db2.remove("m2.db");
+    }
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_store_append_tail") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    using shyft::time_series::POINT_AVERAGE_VALUE;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.append.test");
+    fs::remove_all(tmpdir);
+    dtss::ts_db db(tmpdir.string());
+    const core::utctime t0 = core::utctime(0);
+    const auto dt = core::deltahours(1);
+    const std::string fn = "a.db";
+    db.save(fn, gts_t(gta_t(t0, dt, 24), 0.0, POINT_AVERAGE_VALUE));
+    for (size_t i = 0; i < 48; ++i)// the newest hour, contiguous, appended in place
+        db.save(fn, gts_t(gta_t(t0 + dt*(24 + i), dt, 1), double(i + 1), POINT_AVERAGE_VALUE), false);
+    db.save(fn, gts_t(gta_t(t0 + dt*72, dt, 3), vector<double>{ 100.0, 101.0, 102.0 }, POINT_AVERAGE_VALUE), false);
+    auto r = db.read(fn, core::utcperiod{});
+    FAST_REQUIRE_EQ(r.size(), 75u);
+    FAST_CHECK_EQ(r.time_axis(), gta_t(t0, dt, 75));
+    for (size_t i = 0; i < 24; ++i)
+        FAST_CHECK_EQ(r.value(i), 0.0);
+    for (size_t i = 0; i < 48; ++i)
+        FAST_CHECK_EQ(r.value(24 + i), double(i + 1));
+    FAST_CHECK_EQ(r.value(74), 102.0);
+    FAST_CHECK_EQ(fs::file_size(tmpdir/fn), sizeof(dtss::ts_db_header) + 2*sizeof(int64_t) + 75*sizeof(double));
+    FAST_CHECK_EQ(db.get_ts_info(fn).data_period, core::utcperiod(t0, t0 + dt*75));
+    FAST_CHECK_EQ(db.find("a.db")[0].data_period, core::utcperiod(t0, t0 + dt*75));
+    // not contiguous, or another dt, is not an append, and is merged as before
+    db.save(fn, gts_t(gta_t(t0 + dt*77, dt, 1), 7.0, POINT_AVERAGE_VALUE), false);
+    r = db.read(fn, core::utcperiod{});
+    FAST_REQUIRE_EQ(r.size(), 78u);
+    FAST_CHECK_UNARY(std::isnan(r.value(75)));
+    FAST_CHECK_EQ(r.value(77), 7.0);
+    CHECK_THROWS_AS(db.save(fn, gts_t(gta_t(t0 + dt*78, dt*2, 1), 1.0, POINT_AVERAGE_VALUE), false), std::runtime_error);
+    FAST_CHECK_EQ(db.read(fn, core::utcperiod{}).size(), 78u);
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_store_concurrent_read_write") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    using shyft::time_series::POINT_AVERAGE_VALUE;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.rw.test");
+    fs::remove_all(tmpdir);
+    dtss::ts_db db(tmpdir.string());
+    const core::utctime t0 = core::utctime(0);
+    const auto dt = core::deltahours(1);
+    db.save("w.db", gts_t(gta_t(t0, dt, 24), 0.0, POINT_AVERAGE_VALUE));
+    db.save("u.db", gts_t(gta_t(t0, dt, 24), -1.0, POINT_AVERAGE_VALUE));
+    const size_t n_versions = 200, n_readers = 4;
+    std::atomic<bool> done{ false };
+    std::atomic<size_t> n_torn{ 0 }, n_reads{ 0 };
+    std::thread writer([&]() {
+        for (size_t k = 1; k <= n_versions; ++k) {// each version has all values k, and alternating length
+            gts_t ts(gta_t(t0, dt, k % 2 ? 48 : 24), double(k), POINT_AVERAGE_VALUE);
+            db.save("w.db", ts, k % 6 != 3);// a merge covering the stored series rewrites the file too
+        }
+        done = true;
+    });
+    vector<std::thread> readers;
+    for (size_t i = 0; i < n_readers; ++i) {
+        readers.emplace_back([&, i]() {
+            const string fn = i % 2 ? "u.db" : "w.db";// the unrelated series is never blocked by the writer
+            do {
+                auto r = db.read(fn, core::utcperiod{});
+                bool ok = r.size() == 24 || r.size() == 48;
+                for (size_t j = 0; ok && j < r.size(); ++j)
+                    ok = r.value(j) == r.value(0);
+                if (!ok) ++n_torn;
+                ++n_reads;
+            } while (!done);
+        });
+    }
+    writer.join();
+    for (auto& t : readers) t.join();
+    FAST_CHECK_EQ(n_torn.load(), 0u);
+    FAST_CHECK_GE(n_reads.load(), n_readers);
+    auto r = db.read("w.db", core::utcperiod{});
+    FAST_CHECK_EQ(r.size(), 24u);
+    FAST_CHECK_EQ(r.value(23), double(n_versions));
+    FAST_CHECK_EQ(db.read("u.db", core::utcperiod{}).value(0), -1.0);
+    FAST_CHECK_EQ(db.get_ts_info("w.db").data_period, core::utcperiod(t0, t0 + dt*24));
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_store_normalized_time_axis") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    namespace ta = shyft::time_axis;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    using shyft::time_series::POINT_AVERAGE_VALUE;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.normalize.test");
+    fs::remove_all(tmpdir);
+    dtss::ts_db db(tmpdir.string());
+    db.normalize_time_axis = true;
+    core::calendar utc;
+    const core::utctime t0 = utc.time(2016, 1, 1);
+    auto points = [](const gta_t& a) { vector<core::utctime> t; for (std::size_t i = 0; i < a.size(); ++i) t.push_back(a.time(i)); return gts_t(gta_t(ta::point_dt(t, a.total_period().end)), 0.0, POINT_AVERAGE_VALUE); };
+    auto fill = [](gts_t ts) { for (std::size_t i = 0; i < ts.size(); ++i) ts.set(i, 0.5*i); return ts; };
+    auto check_read = [&db](const std::string& fn, const gts_t& o, ta::generic_dt::generic_type gt) {
+        auto r = db.read(fn, core::utcperiod{});
+        FAST_CHECK_EQ(r.ta.gt, gt);
+        FAST_REQUIRE_EQ(r.size(), o.size());
+        FAST_CHECK_EQ(r.total_period(), o.total_period());
+        for (std::size_t i = 0; i < o.size(); ++i) {
+            FAST_CHECK_EQ(r.time(i), o.time(i));
+            FAST_CHECK_EQ(r.value(i), o.value(i));
+        }
+    };
+    auto hourly = fill(points(gta_t(t0, core::deltahours(1), 100)));
+    auto monthly = fill(points(gta_t(std::make_shared<core::calendar>(), t0, core::calendar::MONTH, 24)));
+    auto irregular = fill(gts_t(gta_t(ta::point_dt({ t0, t0 + core::deltahours(1), t0 + core::deltahours(3) }, t0 + core::deltahours(4))), 0.0, POINT_AVERAGE_VALUE));
+    db.save("h.db", hourly);
+    check_read("h.db", hourly, ta::generic_dt::FIXED);
+    db.save("m.db", monthly);
+    check_read("m.db", monthly, ta::generic_dt::CALENDAR);
+    db.save("i.db", irregular);
+    check_read("i.db", irregular, ta::generic_dt::POINT);
+    gts_t r;
+    FAST_CHECK_UNARY(!db.normalized(irregular, r));
+    FAST_CHECK_UNARY(!db.normalized(gts_t(gta_t(t0, core::deltahours(1), 10), 1.0, POINT_AVERAGE_VALUE), r));
+    // a merge into a stored point_dt series keeps its time-axis
+    auto tail = fill(points(gta_t(t0 + core::deltahours(4), core::deltahours(1), 2)));
+    db.save("i.db", tail, false);
+    auto m = db.read("i.db", core::utcperiod{});
+    FAST_CHECK_EQ(m.ta.gt, ta::generic_dt::POINT);
+    FAST_REQUIRE_EQ(m.size(), 5u);
+    FAST_CHECK_EQ(m.value(1), 0.5);
+    FAST_CHECK_EQ(m.value(4), 0.5);
+    db.normalize_time_axis = false;
+    db.save("p.db", hourly);
+    check_read("p.db", hourly, ta::generic_dt::POINT);
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_db_xor_codec") {
+    namespace codec = shyft::dtss::codec;
+    std::mt19937 rg(5);
+    std::uniform_real_distribution<double> rv(-1000.0, 1000.0);
+    vector<vector<double>> vs{
+        {},
+        { 0.0 },
+        vector<double>(100, 3.5),// constant
+        { 1.0, shyft::nan, shyft::nan, -0.0, 0.0, std::numeric_limits<double>::infinity(), 2.0, shyft::nan },
+    };
+    vector<double> smooth, random;
+    for (int i = 0; i < 1000; ++i) {
+        smooth.push_back(10.0 + std::sin(i / 100.0));
+        random.push_back(rv(rg));
+    }
+    vs.push_back(smooth);
+    vs.push_back(random);
+    for (const auto& v : vs) {
+        vector<uint8_t> d{ 42 };// encoding appends
+        codec::xor_encode(v.data(), v.size(), d);
+        vector<double> r(v.size());
+        codec::xor_decode(d.data() + 1, d.size() - 1, v.size(), r.data());
+        bool equal_bits = std::memcmp(v.data(), r.data(), sizeof(double)*v.size()) == 0;
+        FAST_CHECK_UNARY(equal_bits);
+        if (v.size() > 1)
+            CHECK_THROWS_AS(codec::xor_decode(d.data() + 1, d.size() - 2, v.size(), r.data()), std::runtime_error);
+    }
+    vector<uint8_t> dc;
+    codec::xor_encode(vs[2].data(), vs[2].size(), dc);
+    FAST_CHECK_EQ(dc.size(), vs[2].size() + 2);// one tag each, and the two significant bytes of 3.5
+}
+
+TEST_CASE("dtss_store_compressed_values") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    namespace ta = shyft::time_axis;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.compressed.test");
+    dtss::ts_db db1(tmpdir.string());// raw, reference
+    dtss::ts_db db2(tmpdir.string(), dtss::ts_db_encoding::xor_delta);
+    db2.value_chunk_n = 10;// small chunks to get many of them
+    db1.point_block_n = db2.point_block_n = 0;// point_dt as TS1, so it is encoded as well
+    auto utc = std::make_shared<core::calendar>();
+    auto osl = std::make_shared<core::calendar>("Europe/Oslo");
+    const core::utctime t0 = utc->time(2016, 3, 20);
+    std::mt19937 rg(13);
+    auto fill = [&rg](gts_t& ts) {
+        for (std::size_t i = 0; i < ts.size(); ++i)
+            ts.set(i, (rg() % 4 == 0) ? double(rg() % 100) : (i ? ts.value(i - 1) : 1.5));
+        return ts;
+    };
+    auto read_file_size = [&tmpdir](const std::string& fn) { return fs::file_size(tmpdir/fn); };
+    auto check_equal_reads = [&](const std::string& fn1, const std::string& fn2, core::utcperiod tp) {
+        std::uniform_int_distribution<int64_t> rt(int64_t(tp.start - core::deltahours(30)), int64_t(tp.end + core::deltahours(30)));
+        vector<core::utcperiod> ps{ core::utcperiod{}, tp };
+        for (int i = 0; i < 50; ++i) {
+            auto a = core::utctime(rt(rg)), b = core::utctime(rt(rg));
+            ps.emplace_back(std::min(a, b), std::max(a, b) + 1);
+        }
+        for (const auto& p : ps) {
+            auto r1 = db1.read(fn1, p);
+            auto r2 = db2.read(fn2, p);
+            FAST_CHECK_EQ(r1.time_axis(), r2.time_axis());
+            FAST_CHECK_EQ(r1.point_interpretation(), r2.point_interpretation());
+            bool equal_values = r1.v.size() == r2.v.size() && std::equal(r1.v.begin(), r1.v.end(), r2.v.begin(), [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); });
+            FAST_CHECK_UNARY(equal_values);
+        }
+    };
+    vector<core::utctime> tp; for (int i = 0; i < 100; ++i) tp.push_back(t0 + core::deltahours(i*i % 7 + 3*i));
+    vector<gts_t> tsv{
+        gts_t(gta_t(t0, core::deltahours(1), 1000), 0.0, shyft::time_series::POINT_AVERAGE_VALUE),
+        gts_t(gta_t(osl, t0, core::deltahours(1), 1000), 0.0, shyft::time_series::POINT_INSTANT_VALUE),
+        gts_t(gta_t(osl, t0, core::deltahours(24), 95), 0.0, shyft::time_series::POINT_AVERAGE_VALUE),
+        gts_t(gta_t(ta::point_dt(tp, tp.back() + core::deltahours(2))), 0.0, shyft::time_series::POINT_AVERAGE_VALUE)
+    };
+    for (std::size_t k = 0; k < tsv.size(); ++k) {
+        auto o = fill(tsv[k]);
+        const std::string fn1 = "raw." + std::to_string(k) + ".db", fn2 = "xor." + std::to_string(k) + ".db";
+        db1.save(fn1, o);
+        db2.save(fn2, o);
+        FAST_CHECK_LT(read_file_size(fn2), read_file_size(fn1));
+        check_equal_reads(fn1, fn2, o.total_period());
+        // merge before, inside, after and with a gap, the encoded file is rewritten with the same result
+        const auto& ota = o.ta;
+        const std::size_t n = o.size();
+        vector<gts_t> mv;
+        if (ota.gt == ta::generic_dt::POINT) {
+            mv.emplace_back(gta_t(ta::point_dt({ tp[0] - core::deltahours(5), tp[0] - core::deltahours(1) }, tp[0] + core::deltahours(1))), 7.0, o.point_interpretation());
+            mv.emplace_back(gta_t(ta::point_dt({ tp[10], tp[10] + core::deltahours(1) }, tp[12])), 8.0, o.point_interpretation());
+            mv.emplace_back(gta_t(ta::point_dt({ tp.back() + core::deltahours(10) }, tp.back() + core::deltahours(11))), 9.0, o.point_interpretation());
+        } else if (ota.gt == ta::generic_dt::FIXED) {
+            mv.emplace_back(gta_t(ota.f.t - 3*ota.f.dt, ota.f.dt, 5), 7.0, o.point_interpretation());
+            mv.emplace_back(gta_t(ota.f.t + 100*ota.f.dt, ota.f.dt, 17), 8.0, o.point_interpretation());
+            mv.emplace_back(gta_t(ota.f.t + (n + 4)*ota.f.dt, ota.f.dt, 3), 9.0, o.point_interpretation());
+        } else {
+            auto c = ota.c.cal;
+            mv.emplace_back(gta_t(c, c->add(ota.c.t, ota.c.dt, -3), ota.c.dt, 5), 7.0, o.point_interpretation());
+            mv.emplace_back(gta_t(c, c->add(ota.c.t, ota.c.dt, long(n/2)), ota.c.dt, 17), 8.0, o.point_interpretation());
+            mv.emplace_back(gta_t(c, c->add(ota.c.t, ota.c.dt, long(n + 4)), ota.c.dt, 3), 9.0, o.point_interpretation());
+        }
+        for (const auto& m : mv) {
+            db1.save(fn1, m, false);
+            db2.save(fn2, m, false);
+            check_equal_reads(fn1, fn2, db1.read(fn1, core::utcperiod{}).total_period());
+        }
+        // the encoding is read from the file
+        auto r = db1.read(fn2, core::utcperiod{});
+        FAST_CHECK_EQ(r.time_axis(), db2.read(fn2, core::utcperiod{}).time_axis());
+        db1.remove(fn1);
+        db2.remove(fn2);
+    }
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_db_catalogue") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    FAST_CHECK_EQ(dtss::ts_db_catalogue::literal_prefix("^a/b/c.*"), string("a/b/c"));
+    FAST_CHECK_EQ(dtss::ts_db_catalogue::literal_prefix("^a/bc?d"), string("a/b"));
+    FAST_CHECK_EQ(dtss::ts_db_catalogue::literal_prefix("^a/b|c"), string(""));
+    FAST_CHECK_EQ(dtss::ts_db_catalogue::literal_prefix("a/b"), string(""));// not anchored, matches anywhere
+
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.catalogue.test");
+    fs::remove_all(tmpdir);
+    const vector<string> names{ "a/b/x1.db", "a/b/x2.db", "a/B/x3.db", "a/c/y1.db", "b/a/x1.db", "ab.db", "Ab/z.db" };
+    const vector<string> patterns{ ".*", "^a/", "^A/b", "^a/b?", "x1", "^b/.*x", "\\.db$", "^ab", "nothing" };
+    auto expected_find = [](const vector<string>& v, const string& match) {
+        std::regex r(match, std::regex_constants::ECMAScript | std::regex_constants::icase);
+        vector<string> e;
+        for (const auto& n : v) if (std::regex_search(n, r)) e.push_back(n);
+        std::sort(e.begin(), e.end());
+        return e;
+    };
+    auto found = [](const vector<dtss::ts_info>& f) {
+        vector<string> r;
+        for (const auto& i : f) r.push_back(i.name);
+        std::sort(r.begin(), r.end());
+        return r;
+    };
+    auto check_find = [&](const dtss::ts_db& db, const vector<string>& v) {
+        for (const auto& m : patterns) {
+            FAST_CHECK_EQ(found(db.find(m)), expected_find(v, m));
+        }
+    };
+    gta_t ta(core::utctime(0), core::deltahours(1), 24);
+    {
+        dtss::ts_db db(tmpdir.string());
+        for (const auto& n : names)
+            db.save(n, gts_t(ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE));
+        check_find(db, names);
+        FAST_CHECK_UNARY(fs::exists(tmpdir/dtss::ts_db_catalogue::log_name()));
+        // merge updates the period
+        db.save(names[0], gts_t(gta_t(core::utctime(0) + core::deltahours(24), core::deltahours(1), 24), 2.0, shyft::time_series::POINT_AVERAGE_VALUE), false);
+        auto f = db.find("^" + names[0]);
+        FAST_REQUIRE_EQ(f.size(), 1u);
+        FAST_CHECK_EQ(f[0].data_period, core::utcperiod(core::utctime(0), core::utctime(0) + core::deltahours(48)));
+        FAST_CHECK_EQ(f[0].data_period, db.get_ts_info(names[0]).data_period);
+        FAST_CHECK_EQ(f[0].point_fx, shyft::time_series::POINT_AVERAGE_VALUE);
+        dtss::ts_db db2(tmpdir.string());// shares the catalogue
+        db2.remove(names[1]);
+        check_find(db, vector<string>{ names[0], names[2], names[3], names[4], names[5], names[6] });
+    }
+    vector<string> live{ names[0], names[2], names[3], names[4], names[5], names[6] };
+    {
+        dtss::ts_db db(tmpdir.string());// replays the log
+        check_find(db, live);
+        fs::copy_file(tmpdir/names[0], tmpdir/"a/b/copy.db");// not seen until rebuild
+        check_find(db, live);
+        db.rebuild_catalogue();
+        live.push_back("a/b/copy.db");
+        check_find(db, live);
+    }
+    {
+        auto log = tmpdir/dtss::ts_db_catalogue::log_name();
+        fs::resize_file(log, fs::file_size(log) - 3);// damaged, e.g. a crash while appending
+        dtss::ts_db db(tmpdir.string());// rebuilt by scanning
+        check_find(db, live);
+    }
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_db_write_ahead_log") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    using shyft::time_series::POINT_AVERAGE_VALUE;
+    using shyft::time_series::POINT_INSTANT_VALUE;
+    using batch_t = vector<pair<string, const gts_t*>>;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.wal.test");
+    fs::remove_all(tmpdir);
+    fs::create_directories(tmpdir);
+    auto utc = make_shared<core::calendar>();
+    auto osl = make_shared<core::calendar>("Europe/Oslo");
+    const core::utctime t0 = utc->time(2018, 1, 1);
+    const auto dt = core::deltahours(1);
+    auto equal_ts = [](const gts_t& a, const gts_t& b) {
+        if (a.time_axis() != b.time_axis() || a.point_interpretation() != b.point_interpretation() || a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (a.value(i) != b.value(i)) return false;
+        return true;
+    };
+    const gts_t f1(gta_t(t0, dt, 24), 1.0, POINT_AVERAGE_VALUE);
+    const gts_t f2(gta_t(t0 + 12*dt, dt, 24), 2.0, POINT_AVERAGE_VALUE);
+    const gts_t c1(gta_t(osl, t0, core::deltahours(24), 10), 3.0, POINT_AVERAGE_VALUE);
+    const gts_t p1(gta_t(vector<core::utctime>{ t0, t0 + dt, t0 + 5*dt }, t0 + 6*dt), 4.0, POINT_INSTANT_VALUE);
+    const gts_t p2(gta_t(vector<core::utctime>{ t0 + 2*dt, t0 + 7*dt }, t0 + 8*dt), 5.0, POINT_INSTANT_VALUE);
+    const vector<string> names{ "f.db", "c/c.db", "p/p.db" };
+    const core::utcperiod all(t0 - core::deltahours(48), t0 + core::deltahours(24*20));
+
+    SUBCASE("same_content_as_direct_save") {
+        dtss::ts_db db((tmpdir/"wal").string()), ref((tmpdir/"ref").string());
+        db.enable_wal();
+        FAST_CHECK_UNARY(db.wal_enabled());
+        FAST_CHECK_UNARY(!ref.wal_enabled());
+        for (auto* x : { &f1, &c1, &p1 }) FAST_CHECK_UNARY(equal_ts(db.wal_ts(db.wal_payload(*x)), *x));
+        const batch_t b1{ { names[0], &f1 }, { names[1], &c1 }, { names[2], &p1 } };
+        const batch_t b2{ { names[0], &f2 }, { names[2], &p2 } };
+        for (auto* x : { &db, &ref }) {
+            x->save(b1, true);
+            x->save(b2, false);// merge, in order after the first batch
+        }
+        for (const auto& n : names) {
+            FAST_CHECK_UNARY(equal_ts(db.read(n, all), ref.read(n, all)));// read applies the pending saves of n
+            FAST_CHECK_EQ(db.get_ts_info(n).data_period, ref.get_ts_info(n).data_period);
+        }
+        FAST_CHECK_EQ(db.find(".*").size(), names.size());
+        db.flush_wal();
+        FAST_CHECK_EQ(db.wal_errors().size(), 0u);
+        // errors of the background write are kept, as the client has been acknowledged
+        const gts_t f_instant(gta_t(t0, dt, 24), 1.0, POINT_INSTANT_VALUE);
+        db.save(batch_t{ { names[0], &f_instant } }, false);
+        db.flush_wal();
+        FAST_CHECK_EQ(db.wal_errors().size(), 1u);
+        FAST_CHECK_UNARY(equal_ts(db.read(names[0], all), ref.read(names[0], all)));
+    }
+    SUBCASE("concurrent_stores") {
+        dtss::ts_db db((tmpdir/"mt").string());
+        db.enable_wal(false);
+        const size_t n_threads = 8, n_stores = 20;
+        vector<std::thread> w;
+        for (size_t i = 0; i < n_threads; ++i) {
+            w.emplace_back([&db, i, t0, dt]() {
+                for (size_t j = 0; j < n_stores; ++j) {
+                    gts_t ts(gta_t(t0 + core::deltahours(24*j), dt, 24), double(i*100 + j), POINT_AVERAGE_VALUE);
+                    db.save(batch_t{ { "t/" + std::to_string(i) + ".db", &ts } }, j == 0);// merge the days into one series
+                }
+            });
+        }
+        for (auto& t : w) t.join();
+        for (size_t i = 0; i < n_threads; ++i) {
+            auto r = db.read("t/" + std::to_string(i) + ".db", all);
+            FAST_REQUIRE_EQ(r.size(), 24*n_stores);
+            for (size_t j = 0; j < n_stores; ++j)
+                FAST_CHECK_EQ(r.value(24*j), double(i*100 + j));
+        }
+        FAST_CHECK_EQ(db.wal_errors().size(), 0u);
+    }
+    SUBCASE("replay_after_crash") {
+        dtss::ts_db ref((tmpdir/"ref").string()), db((tmpdir/"crash").string());
+        ref.save(batch_t{ { names[0], &f1 }, { names[2], &p1 } }, true);
+        ref.save(batch_t{ { names[0], &f2 }, { names[2], &p2 } }, false);
+        std::promise<void> go;
+        auto gof = go.get_future().share();
+        {
+            fs::create_directory(tmpdir/"live");
+            dtss::ts_db_wal wal((tmpdir/"live").string(), [gof](const string&, bool, const string&) { gof.wait(); });// the compactor is stuck
+            vector<dtss::ts_db_wal::record> rs{
+                { names[0], true, db.wal_payload(f1) }, { names[2], true, db.wal_payload(p1) },
+                { names[0], false, db.wal_payload(f2) }, { names[2], false, db.wal_payload(p2) } };
+            wal.append(rs);// durable when returning, so a crash now keeps the records
+            fs::copy_file(tmpdir/"live"/dtss::ts_db_wal::log_name(), tmpdir/"crash"/dtss::ts_db_wal::log_name());
+            go.set_value();
+        }
+        {   // a record torn by the crash is ignored
+            std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen((tmpdir/"crash"/dtss::ts_db_wal::log_name()).string().c_str(), "ab"), &std::fclose };
+            std::fwrite("W\x05\0\0\0f", 1, 6, f.get());
+        }
+        db.enable_wal();// replays the log
+        FAST_CHECK_EQ(fs::file_size(tmpdir/"crash"/dtss::ts_db_wal::log_name()), 0u);
+        for (auto i : { 0, 2 })
+            FAST_CHECK_UNARY(equal_ts(db.read(names[i], all), ref.read(names[i], all)));
+        FAST_CHECK_EQ(db.find(".*").size(), 2u);// the log is not a ts
+        FAST_CHECK_EQ(db.wal_errors().size(), 0u);
+    }
+    fs::remove_all(tmpdir);
+}
+
+TEST_CASE("dtss_db_pack") {
+    namespace core = shyft::core;
+    namespace dtss = shyft::dtss;
+    using shyft::time_series::dd::gta_t;
+    using gts_t = shyft::time_series::point_ts<gta_t>;
+    using shyft::time_series::POINT_AVERAGE_VALUE;
+    using shyft::time_series::POINT_INSTANT_VALUE;
+    using batch_t = vector<pair<string, const gts_t*>>;
+    auto tmpdir = (fs::temp_directory_path()/"ts.db.pack.test");
+    fs::remove_all(tmpdir);
+    fs::create_directories(tmpdir);
+    auto utc = make_shared<core::calendar>();
+    auto osl = make_shared<core::calendar>("Europe/Oslo");
+    const core::utctime t0 = utc->time(2018, 1, 1);
+    const auto dt = core::deltahours(1);
+    auto equal_ts = [](const gts_t& a, const gts_t& b) {
+        if (a.time_axis() != b.time_axis() || a.point_interpretation() != b.point_interpretation() || a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (a.value(i) != b.value(i) && !(std::isnan(a.value(i)) && std::isnan(b.value(i)))) return false;
+        return true;
+    };
+    const gts_t f1(gta_t(t0, dt, 24), 1.0, POINT_AVERAGE_VALUE);
+    const gts_t f2(gta_t(t0 + 30*dt, dt, 24), 2.0, POINT_AVERAGE_VALUE);// a gap
+    const gts_t c1(gta_t(osl, t0, core::deltahours(24), 10), 3.0, POINT_AVERAGE_VALUE);
+    const gts_t p1(gta_t(vector<core::utctime>{ t0, t0 + dt, t0 + 5*dt }, t0 + 6*dt), 4.0, POINT_INSTANT_VALUE);
+    const gts_t p2(gta_t(vector<core::utctime>{ t0 + 2*dt, t0 + 7*dt }, t0 + 8*dt), 5.0, POINT_INSTANT_VALUE);
+    const vector<string> names{ "f.db", "c/c.db", "p/p.db" };
+    const vector<core::utcperiod> periods{ core::utcperiod(), core::utcperiod(t0 + 3*dt, t0 + 40*dt), core::utcperiod(t0 - 10*dt, t0 + dt), core::utcperiod(t0 + 100*dt, t0 + 200*dt) };
+    dtss::ts_db ref((tmpdir/"ref").string());
+    ref.save(batch_t{ { names[0], &f1 }, { names[1], &c1 }, { names[2], &p1 } }, true);
+    ref.save(batch_t{ { names[0], &f2 }, { names[2], &p2 } }, false);
+    auto check_same = [&](const dtss::ts_db_pack& db) {
+        for (const auto& n : names) {
+            for (const auto& p : periods)
+                FAST_CHECK_UNARY(equal_ts(db.read(n, p), ref.read(n, p)));
+            FAST_CHECK_EQ(db.get_ts_info(n).data_period, ref.get_ts_info(n).data_period);
+        }
+    };
+    {
+        dtss::ts_db_pack db((tmpdir/"pack").string(), 1024);// small packs, so there are several
+        db.save(batch_t{ { names[0], &f1 }, { names[1], &c1 }, { names[2], &p1 } }, true);
+        db.save(batch_t{ { names[0], &f2 }, { names[2], &p2 } }, false);// merged as the file of ts_db
+        check_same(db);
+        for (size_t i = 0; i < 100; ++i)
+            db.save("s/" + std::to_string(i) + "/t", gts_t(gta_t(t0, dt, 24), double(i), POINT_AVERAGE_VALUE));
+        FAST_CHECK_EQ(db.size(), 103u);
+        FAST_CHECK_GT(db.pack_count(), 1u);
+        FAST_CHECK_EQ(db.find("^S/1.*/t").size(), 11u);// icase, as ts_db
+        FAST_CHECK_EQ(db.find("/t$").size(), 100u);
+        db.remove("s/0/t");
+        db.remove("s/0/t");// not there, as ts_db
+        CHECK_THROWS_AS(db.read("s/0/t", periods[0]), std::runtime_error);
+        auto infos = db.get_ts_infos(vector<string>{ "s/1/t", "s/0/t" });
+        FAST_CHECK_EQ(infos[0].data_period, f1.total_period());
+        FAST_CHECK_EQ(infos[1].name, string("s/0/t"));
+        FAST_CHECK_UNARY(!infos[1].data_period.valid());
+        CHECK_THROWS_AS(db.save("", f1), std::runtime_error);
+    }
+    {   // a record torn by a crash is dropped, the records before it are kept
+        auto last = (tmpdir/"pack"/(string(dtss::ts_db_pack::pack_prefix()) + "0")).string();
+        for (size_t k = 1; fs::exists(tmpdir/"pack"/(string(dtss::ts_db_pack::pack_prefix()) + std::to_string(k))); ++k)
+            last = (tmpdir/"pack"/(string(dtss::ts_db_pack::pack_prefix()) + std::to_string(k))).string();
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> f{ std::fopen(last.c_str(), "ab"), &std::fclose };
+        std::fwrite("P\x05\0\0\0f", 1, 6, f.get());
+    }
+    {
+        dtss::ts_db_pack db((tmpdir/"pack").string(), 1024);// reads the index from the packs
+        FAST_CHECK_EQ(db.size(), 102u);
+        check_same(db);
+        for (size_t i = 1; i < 100; ++i)
+            db.remove("s/" + std::to_string(i) + "/t");
+        const auto n_packs = db.pack_count();
+        FAST_CHECK_EQ(db.compact(), n_packs - 1);// the closed packs are mostly removed series
+        FAST_CHECK_EQ(db.compact(0.0), 0u);// no pack has less than nothing live
+        FAST_CHECK_EQ(db.size(), 3u);
+        check_same(db);
+    }
+    {
+        dtss::ts_db_pack db((tmpdir/"pack").string(), 1024);
+        FAST_CHECK_EQ(db.size(), 3u);
+        FAST_CHECK_EQ(db.find(".*").size(), 3u);
+        check_same(db);
+    }
+    // a packed container of a server
+    dtss::server srv;
+    srv.set_listening_ip("127.0.0.1");
+    srv.set_listening_port(20051);
+    srv.start_async();
+    CHECK_THROWS_AS(srv.add_container("w", (tmpdir/"w").string(), false, true, true), std::runtime_error);
+    srv.add_container("p", (tmpdir/"srv").string(), false, false, true);
+    dtss::ts_vector_t tsv;
+    for (size_t i = 0; i < 10; ++i)
+        tsv.push_back(dtss::apoint_ts(dtss::shyft_url("p", "s/" + std::to_string(i)), dtss::apoint_ts(gta_t(t0, dt, 24), double(i), POINT_AVERAGE_VALUE)));
+    dtss::client c("localhost:20051");
+    c.store_ts(tsv, true, false);
+    dtss::ts_vector_t refs;
+    refs.push_back(dtss::apoint_ts(dtss::shyft_url("p", "s/7")));
+    auto r = c.evaluate(refs, core::utcperiod(t0, t0 + 24*dt), false, false);
+    FAST_REQUIRE_EQ(r.size(), 1u);
+    FAST_CHECK_EQ(r[0].value(0), 7.0);
+    FAST_CHECK_EQ(c.find(dtss::shyft_url("p", "s/.*")).size(), 10u);
+    FAST_CHECK_EQ(srv.internal("p")->find("s/.*").size(), 10u);
+    c.close();
+    srv.clear();
+    fs::remove_all(tmpdir);
+}
+
 TEST_CASE("dtss_baseline") {
     using namespace shyft::dtss;
     using namespace shyft::time_series::dd;
@@ -245,4 +245,54 @@ TEST_CASE("test_forest_altitude_dependent_snow_cv") {
     TS_ASSERT_DELTA(p.effective_snow_cv(1.0,0.0),p.snow_cv+0.1,0.0000001);// verify increase in forest direction
     TS_ASSERT_DELTA(p.effective_snow_cv(0.0,1000.0),p.snow_cv +0.1, 0.0000001);// verify increase in altitude direction
 }
+TEST_CASE("test_fast_gamma_p_against_boost") {
+    // cover the shape range [0.1, 1/(snow_cv^2)] for snow_cv down to 0.1, and lambda/scale up to the 1.3*shape + 20 cut-off
+    double max_err = 0.0;
+    for (double a = 0.1; a <= 100.0; a *= 1.1) {
+        const double x_max = 1.3*a + 20.0;
+        for (size_t i = 0; i <= 200; ++i) {
+            const double x = x_max*i/200.0;
+            const auto g = gs::fast_gamma_p(a, x);
+            const double p = boost::math::gamma_p(a, x);
+            const double p1 = boost::math::gamma_p(a + 1.0, x);
+            max_err = std::max(max_err, std::max(fabs(g.p - p), fabs(g.p1 - p1)));
+        }
+        TS_ASSERT_DELTA(gs::fast_lgamma(a), boost::math::lgamma(a), 1e-12*std::max(1.0, fabs(boost::math::lgamma(a))));
+    }
+    TS_ASSERT_LESS_THAN(max_err, 1e-8);
+}
+
+TEST_CASE("test_fast_math_step_equals_boost_step") {
+    gs::calculator<gs::parameter, gs::state, gs::response> gs;
+    gs::parameter p_boost;
+    gs::parameter p_fast;
+    p_fast.fast_math = true;
+    auto dt = shyft::core::deltahours(3);
+    gs::state s_boost(0.6, 0.0, 0.0, 1.0/(p_boost.snow_cv*p_boost.snow_cv), 0.0, -1.0, 0.0, 0.0);
+    gs::state s_fast(s_boost);
+    gs::response r_boost, r_fast;
+    const size_t n = 8*200;// accumulation, then melt, including the lwc correction of snowfall on wet snow
+    double clock_boost = 0.0, clock_fast = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const double temp = i < n/2 ? (i % 16 < 12 ? -4.0 : 1.5) : 3.0 + 4.0*sin(i*0.26);
+        const double prec = i % 5 == 0 ? 2.0 : 0.0;
+        const double rad = i % 8 < 4 ? 250.0 : 0.0;
+        std::clock_t c0 = std::clock();
+        gs.step(s_boost, r_boost, i*dt, dt, p_boost, temp, rad, prec, 2.0, 0.8, 0.0, 0.0);
+        std::clock_t c1 = std::clock();
+        gs.step(s_fast, r_fast, i*dt, dt, p_fast, temp, rad, prec, 2.0, 0.8, 0.0, 0.0);
+        std::clock_t c2 = std::clock();
+        clock_boost += double(c1 - c0);
+        clock_fast += double(c2 - c1);
+        // the boost path uses 5 digits precision for shape >= 2, so compare on that level
+        TS_ASSERT_DELTA(r_fast.sca, r_boost.sca, 1e-5);
+        TS_ASSERT_DELTA(r_fast.storage, r_boost.storage, 1e-5*std::max(1.0, r_boost.storage));
+        TS_ASSERT_DELTA(r_fast.outflow, r_boost.outflow, 1e-5*std::max(1.0, r_boost.outflow));
+        TS_ASSERT_DELTA(s_fast.lwc, s_boost.lwc, 1e-5*std::max(1.0, s_boost.lwc));
+    }
+    TS_ASSERT(s_boost.acc_melt > 0.0);// verify the melt season was covered
+    if (getenv("SHYFT_VERBOSE")) {
+        std::cout << "gamma_snow boost: " << 1000*clock_boost/CLOCKS_PER_SEC << " ms, fast_math: " << 1000*clock_fast/CLOCKS_PER_SEC << " ms" << std::endl;
+    }
+}
 }
@@ -1,6 +1,9 @@
 #include "test_pch.h"
 #include "core/glacier_melt.h"
 #include "core/time_series.h"
+#include "core/time_series_dd.h"
+#include <vector>
+#include <limits>
 
 namespace glacier_test_constant {
     const double EPS = 1.0e-10;
@@ -76,4 +79,55 @@ TEST_CASE("test_melt_ts") {
     auto b = a*3.0;
 #endif
 }
+
+TEST_CASE("test_melt_batch_equals_scalar") {
+    const double dtf = 6.0;
+    std::vector<double> t{-2.0, 0.0, 0.5, 3.0, 10.0, std::numeric_limits<double>::quiet_NaN(), 4.0};
+    std::vector<double> sca{0.0, 0.2, 1.0, 0.5, 0.1, 0.0, 0.0};
+    std::vector<double> area(t.size(), 1.0e6);
+    std::vector<double> glacier_area{5.0e5, 5.0e5, 5.0e5, 5.0e5, 1.0e6, 2.0e5, 0.0};
+    std::vector<double> out(t.size(), -1.0);
+    glacier_melt::step_batch(dtf, t.data(), sca.data(), area.data(), glacier_area.data(), out.data(), t.size());
+    for (size_t j = 0; j < t.size(); ++j) {
+        const double expected = glacier_melt::step(dtf, t[j], area[j]*sca[j], glacier_area[j]);
+        if (std::isfinite(expected))
+            TS_ASSERT_EQUALS(out[j], expected);
+        else
+            TS_ASSERT(!std::isfinite(out[j]));
+    }
+}
+
+TEST_CASE("test_melt_ts_values") {
+    using namespace shyft::time_series;
+    namespace ta = shyft::time_axis;
+    calendar utc;
+    const size_t n = 48;
+    ta::fixed_dt t_ta(utc.time(2016, 5, 1), deltahours(1), n);
+    ta::fixed_dt sca_ta(utc.time(2016, 5, 1), deltahours(3), n/3 + 1);// covers the last hours of temperature, for the linear interpretation
+    point_ts<ta::fixed_dt> temperature(t_ta, 0.0, ts_point_fx::POINT_AVERAGE_VALUE);
+    point_ts<ta::fixed_dt> sca_m2(sca_ta, 0.0, ts_point_fx::POINT_INSTANT_VALUE);
+    for (size_t i = 0; i < n; ++i) temperature.set(i, -3.0 + 0.25*i);
+    for (size_t i = 0; i < sca_ta.size(); ++i) sca_m2.set(i, 5.0e5*(1.0 - double(i)/sca_ta.size()));
+    const double glacier_area_m2 = 4.0e5, dtf = 6.0;
+    glacier_melt_ts<point_ts<ta::fixed_dt>> melt(temperature, sca_m2, glacier_area_m2, dtf);
+    auto v = melt.values();
+    FAST_REQUIRE_EQ(v.size(), n);
+    size_t n_melt = 0;
+    for (size_t i = 0; i < n; ++i) {
+        TS_ASSERT_DELTA(v[i], melt.value(i), 1e-12);
+        if (v[i] > 0.0) ++n_melt;
+    }
+    TS_ASSERT(n_melt > 0);
+
+    // the dd expression, evaluated by values(), equals the point by point evaluation
+    dd::apoint_ts a_temp(dd::gta_t(t_ta), temperature.v, ts_point_fx::POINT_AVERAGE_VALUE);
+    dd::apoint_ts a_sca(dd::gta_t(sca_ta), sca_m2.v, ts_point_fx::POINT_INSTANT_VALUE);
+    auto a_melt = dd::create_glacier_melt_ts_m3s(a_temp, a_sca, glacier_area_m2, dtf);
+    auto av = a_melt.values();
+    FAST_REQUIRE_EQ(av.size(), n);
+    for (size_t i = 0; i < n; ++i) {
+        TS_ASSERT_DELTA(av[i], a_melt.value(i), 1e-12);
+        TS_ASSERT_DELTA(av[i], v[i], 1e-12);
+    }
+}
 }
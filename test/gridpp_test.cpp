@@ -1,6 +1,7 @@
 #include "test_pch.h"
 #include "mocks.h"
 #include "core/region_model.h"
+#include "core/gridpp.h"
 #include "api/api.h" // looking for GeoPointSource, and TemperatureSource(realistic case)
 #include "core/time_series_dd.h" // looking for apoint_ts, the api exposed ts-type(realistic case)
 
@@ -15,6 +16,7 @@ namespace shyfttest {
         mock_cell(geo_point loc=geo_point()):location(loc){}
         geo_point location;
         const geo_point& mid_point() const {return location;}
+        double area() const {return 1000.0*1000.0;}///< the cells are on a 1km grid, ref. the conservative grid remap
         pts_t ts;
         void initialize(const ta::fixed_dt& ta) {
             ts=pts_t(ta,0.0,stair_case);/// initialize and prepare cell before interpolation step, notice that the lambda to idw uses ts.set(ix,value)
@@ -123,6 +125,109 @@ TEST_CASE("test_sih_workbench") {
 
 }
 
+TEST_CASE("test_grid_remap") {
+    using namespace std;
+    namespace gr = shyft::core::grid_remap;
+    namespace idw = shyft::core::inverse_distance;
+    typedef geo_point_ts<pts_t> gpts_t;
+    typedef shyft::time_series::average_accessor<pts_t, ta::fixed_dt> tsa_t;
+    typedef idw_compliant_geo_point_ts<gpts_t, tsa_t, ta::fixed_dt> idw_gts_t;
+    typedef idw::wind_speed_model<idw_gts_t, mock_cell, idw::parameter, geo_point> model_t;// transform is identity
+
+    calendar utc;
+    ta::fixed_dt ta(utc.time(2000, 1, 1), deltahours(1), 3);
+    gr::regular_grid g(0.0, 0.0, 2500.0, 2500.0, 10, 10);
+    auto field = [](double x, double y) {return 1.0 + 0.001*x + 0.002*y;};
+    vector<gpts_t> grid;
+    for (size_t x = 0; x < g.nx; ++x) // x-major, like the arome grid above, the order is resolved by location
+        for (size_t y = 0; y < g.ny; ++y) {
+            geo_point p(x*g.dx, y*g.dy, 100.0);
+            grid.push_back(gpts_t{p, pts_t(ta, field(p.x, p.y), stair_case)});
+        }
+    vector<mock_cell> cells;
+    for (size_t x = 0; x < 25; ++x)
+        for (size_t y = 0; y < 25; ++y)
+            cells.emplace_back(geo_point(x*1000.0, y*1000.0, 0.0));
+    auto fx_set = [](mock_cell& d, size_t ix, double value) {d.ts.set(ix, value);};
+    idw::parameter idw_p;
+
+    SUBCASE("bilinear_is_exact_for_linear_field") {
+        for (auto& c : cells) c.initialize(ta);
+        gr::run_interpolation<model_t, idw_gts_t>(ta, grid, gr::parameter(gr::remap_method::bilinear, g), idw_p, cells, fx_set);
+        for (auto const& c : cells) {
+            auto p = c.mid_point();
+            double x = std::min(p.x, 22500.0), y = std::min(p.y, 22500.0);// clamped outside the grid
+            FAST_CHECK_EQ(c.ts.value(1), doctest::Approx(field(x, y)));
+        }
+    }
+    SUBCASE("conservative_uses_box_overlap_areas") {
+        for (auto& c : cells) c.initialize(ta);
+        gr::run_interpolation<model_t, idw_gts_t>(ta, grid, gr::parameter(gr::remap_method::conservative, g), idw_p, cells, fx_set);
+        FAST_CHECK_EQ(cells[0].ts.value(0), doctest::Approx(field(0.0, 0.0)));// inside box of node (0,0)
+        FAST_CHECK_EQ(cells[2*25 + 2].ts.value(0), doctest::Approx(field(2500.0, 2500.0)));// inside box of node (1,1)
+        FAST_CHECK_EQ(cells[1*25 + 0].ts.value(0), doctest::Approx(0.75*field(0.0, 0.0) + 0.25*field(2500.0, 0.0)));// x in [500..1500]
+    }
+    SUBCASE("nan_sources_are_left_out") {
+        for (auto& c : cells) c.initialize(ta);
+        for (auto& s : grid)
+            if (s.location.x == 0.0 && s.location.y == 0.0) s.ts.set(0, shyft::nan);
+        gr::run_interpolation<model_t, idw_gts_t>(ta, grid, gr::parameter(gr::remap_method::bilinear, g), idw_p, cells, fx_set);
+        FAST_CHECK_EQ(cells[1*25 + 0].ts.value(0), doctest::Approx(field(2500.0, 0.0)));// weights re-normalized to the remaining node
+        FAST_CHECK_EQ(cells[1*25 + 0].ts.value(1), doctest::Approx(field(1000.0, 0.0)));
+        FAST_CHECK_UNARY(!std::isfinite(cells[0].ts.value(0)));// on the nan node
+    }
+    SUBCASE("sources_must_match_grid") {
+        gr::regular_grid h(0.0, 0.0, 2000.0, 2500.0, 10, 10);
+        CHECK_THROWS_AS(gr::node_sources(h, grid), std::runtime_error);
+        gr::regular_grid k(0.0, 0.0, 2500.0, 2500.0, 10, 11);
+        CHECK_THROWS_AS(gr::node_sources(k, grid), std::runtime_error);
+    }
+}
+
+TEST_CASE("test_bias_correction_pipeline") {
+    using namespace std;
+    namespace idw = shyft::core::inverse_distance;
+    calendar utc;
+    ta::fixed_dt ta(utc.time(2000, 1, 1), deltahours(3), 8*10);// 10 days, at the filter resolution
+    auto truth = [&utc](utctime t, const geo_point& p) {return 10.0 + 0.0001*p.x + 3.0*sin(2*3.1415*utc.calendar_units(t).hour/24.0);};
+    auto fc_bias = [&utc](utctime t, const geo_point& p) {return 2.0 + 0.5*cos(2*3.1415*utc.calendar_units(t).hour/24.0) + 0.00001*p.y;};// smooth daily pattern, and in space
+    vector<geo_point> grid;
+    for (size_t x = 0; x < 20; ++x)
+        for (size_t y = 0; y < 20; ++y)
+            grid.emplace_back(x*1000.0, y*1000.0, 100.0);
+    vector<geo_point> sites;
+    for (size_t x = 0; x < 4; ++x)
+        for (size_t y = 0; y < 4; ++y)
+            sites.emplace_back(2500.0 + x*5000.0, 2500.0 + y*5000.0, 100.0);
+    vector<pts_t> fc, obs;
+    for (const auto& g : grid) {
+        pts_t ts(ta, 0.0, stair_case);
+        for (size_t i = 0; i < ta.size(); ++i) ts.set(i, truth(ta.time(i), g) + fc_bias(ta.time(i), g));
+        fc.push_back(ts);
+    }
+    for (const auto& s : sites) {
+        pts_t ts(ta, 0.0, stair_case);
+        for (size_t i = 0; i < ta.size(); ++i) ts.set(i, i % 7 == 3 ? shyft::nan : truth(ta.time(i), s));// with some missing observations
+        obs.push_back(ts);
+    }
+    kalman::filter f(kalman::parameter(8, 0.93, 0.5, 2.0, 0.22));
+    idw::parameter idw_p(4, 10000.0);
+    gridpp::bias_correction bc(f, grid, sites, idw_p);
+    FAST_CHECK_EQ(bc.grid_size(), grid.size());
+    FAST_CHECK_EQ(bc.site_size(), sites.size());
+    bc.update(fc, obs, ta);
+
+    for (size_t p = 0; p < sites.size(); ++p) // the site filters have learned the daily bias pattern
+        for (int i = 0; i < 8; ++i)
+            TS_ASSERT_DELTA(bc.s.x_at(i, p), fc_bias(ta.time(i), sites[p]), 0.3);
+    auto corrected = bc.correct(fc, ta);
+    FAST_REQUIRE_EQ(corrected.size(), grid.size());
+    for (size_t g = 0; g < grid.size(); ++g)
+        for (size_t i = ta.size() - 8; i < ta.size(); ++i) // after learning, the corrected forecast should be close to the truth
+            TS_ASSERT_DELTA(corrected[g].value(i), truth(ta.time(i), grid[g]), 0.3);
+    CHECK_THROWS_AS(bc.update(vector<pts_t>(), obs, ta), std::runtime_error);
+}
+
 TEST_CASE("test_interpolate_sources_should_populate_grids") {
 
     calendar utc;
@@ -179,5 +179,30 @@ TEST_CASE("test_mass_balance_melt_no_precip") {
     TS_ASSERT_DELTA(total_water_before, total_water_after, 1.0e-8);
 }
 
+TEST_CASE("test_calculator_fixed_storage") {
+    state state;
+    state.swe = 10.0;
+    state.sca = 0.5;
+    parameter p_many(vector<double>(max_quantiles + 1, 1.0), vector<double>(max_quantiles + 1, 0.0));
+    CHECK_THROWS_AS(SnowModel(p_many, state), runtime_error);
+    parameter p_mismatch(vector<double>{1.0, 1.0, 1.0}, vector<double>{0.0, 0.5, 0.75, 1.0});
+    CHECK_THROWS_AS(SnowModel(p_mismatch, state), runtime_error);
+
+    vector<double> a(max_quantiles);
+    for (size_t i = 0; i < max_quantiles; ++i) a[i] = double(i)/(max_quantiles - 1);
+    parameter p(vector<double>(max_quantiles, 1.0), a);
+    SnowModel snow_model(p, state);
+    SnowModel copy = snow_model;// value semantics, the copy steps independently
+    hbv_snow::state state_copy = state;
+    response r, r_copy;
+    for (utctime t = 0; t < 48*3600; t += 3600) {
+        snow_model.step(state, r, t, t + 3600, p, 0.5, 2.0);
+        copy.step(state_copy, r_copy, t, t + 3600, p, 0.5, 2.0);
+        CHECK(r.outflow == r_copy.outflow);
+    }
+    CHECK(state.swe == state_copy.swe);
+    CHECK(state.sca == state_copy.sca);
+}
+
 }
 /* vim: set filetype=cpp: */
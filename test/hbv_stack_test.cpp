@@ -91,4 +91,58 @@ TEST_CASE("test_call_stack") {
 	for (size_t i = 0; i < snow_swe.size(); ++i)
 		TS_ASSERT(std::isfinite(snow_swe.get(i).v) && snow_swe.get(i).v >= 0);
 }
+
+TEST_CASE("test_run_batch_equals_cell_run") {
+	// verify that the timestep-major batch execution gives identical results as cell.run
+	calendar cal;
+	utctime t0 = cal.time(2014, 10, 1, 0, 0, 0);
+	const size_t n = 24*120;
+	ta::fixed_dt tax(t0, deltahours(1), n);
+	auto p5 = make_shared<parameter>();
+	p5->snow = snow::parameter({1.4, 1.2, 1.0, 0.8, 0.6}, {0.0, 0.25, 0.5, 0.75, 1.0}, 0.0, 2.0, 0.0, 0.1, 0.5);
+	auto p11 = make_shared<parameter>();// 11 quantiles, not batched, run by cell.run
+	vector<double> s11, i11;
+	for (size_t k = 0; k < 11; ++k) { s11.push_back(1.5 - 0.1*k); i11.push_back(0.1*k); }
+	p11->snow = snow::parameter(s11, i11);
+	typedef cell_complete_response_t cell_t;
+	vector<cell_t> cm(7);
+	for (size_t j = 0; j < cm.size(); ++j) {
+		auto& c = cm[j];
+		c.geo = geo_cell_data(geo_point(1000.0*j, 1000.0, 100.0 + 200.0*j), 1000.0*1000.0, 0);
+		if (j == 2) c.geo.set_land_type_fractions(land_type_fractions(0.2, 0.1, 0.1, 0.0, 0.6));
+		c.set_parameter(j % 3 == 2 ? p11 : p5);
+		c.init_env_ts(tax);
+		for (size_t i = 0; i < n; ++i) {
+			c.env_ts.temperature.set(i, -4.0 + 8.0*sin(i/(24.0*9.0)) + 0.5*j + 2.0*sin(i*0.26));// snow seasons and melt events
+			c.env_ts.precipitation.set(i, (i % 11) < 4 ? 1.0 + 0.1*j : 0.0);
+			c.env_ts.radiation.set(i, 100.0 + 20.0*j);
+			c.env_ts.rel_hum.set(i, 0.7);
+			c.env_ts.wind_speed.set(i, 2.0);
+		}
+		c.state.snow = snow::state(j*10.0, j ? 1.0 : 0.0);
+		c.state.soil.sm = 50.0 + j;
+		c.set_state_collection(true);
+	}
+	auto tm = cm;// timestep-major copy
+	for (auto& c : cm)
+		c.run(tax, 0, 0);
+	vector<cell_t*> batch;
+	for (auto& c : tm) batch.push_back(&c);
+	run_batch(tax, 0, 0, batch.data(), batch.size());
+	for (size_t j = 0; j < cm.size(); ++j) {
+		FAST_CHECK_EQ(tm[j].state, cm[j].state);
+		FAST_REQUIRE_EQ(tm[j].rc.avg_discharge.size(), n);
+		for (size_t i = 0; i < n; ++i) {
+			FAST_CHECK_EQ(tm[j].rc.avg_discharge.value(i), cm[j].rc.avg_discharge.value(i));
+			FAST_CHECK_EQ(tm[j].rc.charge_m3s.value(i), cm[j].rc.charge_m3s.value(i));
+			FAST_CHECK_EQ(tm[j].sc.snow_swe.value(i), cm[j].sc.snow_swe.value(i));
+			FAST_CHECK_EQ(tm[j].sc.tank_lz.value(i), cm[j].sc.tank_lz.value(i));
+		}
+		FAST_CHECK_EQ(tm[j].sc.snow_swe.value(n), cm[j].sc.snow_swe.value(n));
+		FAST_CHECK_EQ(tm[j].rc.end_reponse.total_discharge, cm[j].rc.end_reponse.total_discharge);
+	}
+	double max_swe = 0.0;
+	for (size_t i = 0; i < n; ++i) max_swe = std::max(max_swe, cm[0].sc.snow_swe.value(i));
+	FAST_CHECK_GT(max_swe, 10.0);// verify the snow routine was exercised
+}
 }
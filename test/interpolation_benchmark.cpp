@@ -0,0 +1,299 @@
+/** \brief interpolation scaling benchmark, time and memory of idw, local kriging and btk over cells, sources and time-steps
+ *
+ * Builds a square km grid of cells, rising to the north-east, and sources spread at random over the same region,
+ * with hourly temperature, precipitation and radiation, where a fraction of the source values are nan.
+ * Each case interpolates the sources to all the cells, and reports the best of reps runs, for the sizes
+ * given by the decades from min_cells to max_cells, and min_sources to max_sources.
+ *
+ * usage: interpolation_benchmark [min_cells=1000] [max_cells=100000] [min_sources=10] [max_sources=1000] [steps=24]
+ *                                [nan=0] [ncore=-1] [reps=3] [btk_max=20000000] [case=all] [format=text]
+ *        nan is the percent of source values that are nan, source 0 is always valid, so each time-step has a value,
+ *        ncore is the threads of the run_interpolation, -1 all of the executor pool,
+ *        case is all, or a prefix of the case names, idw/temperature, idw/precipitation, idw/radiation, kriging/temperature or btk/temperature,
+ *        format is text, csv or json, the latter one json object for each line, so results can be compared between builds
+ *
+ * The cold time of the idw and kriging cases includes making the neighbour_table, the warm time reuses it from
+ * a neighbour_table_cache, as region_model::cache_idw_neighbours, and table is its heap bytes.
+ * The btk case has no neighbour table, its dense source x cell matrices are skipped beyond btk_max sources*cells.
+ * The peak rss is of the process so far, so run one case and size at the time to get the peak of each.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "core/utctime_utilities.h"
+#include "core/time_axis.h"
+#include "core/time_series.h"
+#include "core/geo_point.h"
+#include "core/region_model.h"
+
+using namespace std;
+using namespace shyft::core;
+namespace st = shyft::time_series;
+namespace idw = shyft::core::inverse_distance;
+namespace btk = shyft::core::bayesian_kriging;
+namespace ok = shyft::core::kriging::ordinary;
+
+namespace {
+    typedef shyft::time_axis::fixed_dt ta_t;
+    typedef st::point_ts<ta_t> ts_t;
+    typedef geo_point_ts<ts_t> gts_t;
+    typedef st::average_accessor<ts_t, ta_t> tsa_t;
+    typedef idw_compliant_geo_point_ts<gts_t, tsa_t, ta_t> igts_t;
+
+    struct options {
+        size_t min_cells = 1000;
+        size_t max_cells = 100000;
+        size_t min_sources = 10;
+        size_t max_sources = 1000;
+        size_t steps = 24;
+        size_t nan = 0;
+        int ncore = -1;
+        size_t reps = 3;
+        size_t btk_max = 20000000;
+        string name = "all";
+        string format = "text";
+    };
+
+    options parse(int argc, char* argv[]) {
+        options o;
+        for (int i = 1; i < argc; ++i) {
+            string a(argv[i]);
+            auto eq = a.find('=');
+            if (eq == string::npos)
+                throw runtime_error("expected key=value, got " + a);
+            string k = a.substr(0, eq), v = a.substr(eq + 1);
+            if (k == "case") { o.name = v; continue; }
+            if (k == "format") { o.format = v; continue; }
+            if (k == "ncore") { o.ncore = std::stoi(v); continue; }
+            size_t n = size_t(std::stoul(v));
+            if (k == "min_cells") o.min_cells = n;
+            else if (k == "max_cells") o.max_cells = n;
+            else if (k == "min_sources") o.min_sources = n;
+            else if (k == "max_sources") o.max_sources = n;
+            else if (k == "steps") o.steps = n;
+            else if (k == "nan") o.nan = n;
+            else if (k == "reps") o.reps = n;
+            else if (k == "btk_max") o.btk_max = n;
+            else throw runtime_error("unknown option " + k);
+        }
+        if (o.min_cells == 0 || o.max_cells < o.min_cells || o.min_sources == 0 || o.max_sources < o.min_sources)
+            throw runtime_error("require 0 < min_cells <= max_cells and 0 < min_sources <= max_sources");
+        if (o.steps == 0 || o.reps == 0)
+            throw runtime_error("steps and reps must be > 0");
+        if (o.nan >= 100)
+            throw runtime_error("nan must be a percent < 100");
+        if (o.format != "text" && o.format != "csv" && o.format != "json")
+            throw runtime_error("format must be text, csv or json, got " + o.format);
+        return o;
+    }
+
+    double peak_rss_mb() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            return double(pmc.PeakWorkingSetSize)/(1024.0*1024.0);
+        return 0.0;
+#else
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+        return double(ru.ru_maxrss)/(1024.0*1024.0);// bytes
+#else
+        return double(ru.ru_maxrss)/1024.0;// kB
+#endif
+#endif
+    }
+
+    double seconds_since(chrono::steady_clock::time_point t) {
+        return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+    }
+
+    /** a cell as seen by the interpolation, like the cell_proxy of region_model::interpolate_signals, the values in a shared buffer */
+    struct destination {
+        geo_point p;
+        double slope{ 1.0 };
+        double* v{ nullptr };///< steps values
+        geo_point mid_point() const { return p; }
+        double slope_factor() const { return slope; }
+        void set_temperature(size_t ix, double x) { v[ix] = x; }
+    };
+
+    struct region {
+        ta_t ta;
+        vector<double> values;///< cells x steps
+        vector<destination> cells;
+        vector<gts_t> temperature, precipitation, radiation;
+    };
+
+    /** deterministic uniform [0..1) from i, so the sizes are comparable between runs and builds */
+    double uniform(uint64_t i) {
+        i = (i + 0x9e3779b97f4a7c15ull)*0xbf58476d1ce4e5b9ull;
+        i = (i ^ (i >> 31))*0x94d049bb133111ebull;
+        return double((i ^ (i >> 29)) >> 11)*(1.0/9007199254740992.0);
+    }
+
+    region make_region(size_t n_cells, size_t n_sources, const options& o) {
+        region r;
+        r.ta = ta_t(calendar().time(2000, 1, 1), deltahours(1), o.steps);
+        r.values.assign(n_cells*o.steps, 0.0);
+        const size_t nx = size_t(std::ceil(std::sqrt(double(n_cells))));
+        const double extent = 1000.0*nx;
+        r.cells.reserve(n_cells);
+        for (size_t i = 0; i < n_cells; ++i) {
+            const double x = 1000.0*(i%nx), y = 1000.0*(i/nx);
+            r.cells.push_back(destination{ geo_point(x, y, 100.0 + 1400.0*(x + y)/(2.0*extent)), 0.8 + 0.4*uniform(3*i), &r.values[i*o.steps] });
+        }
+        const double pi = 3.14159265358979;
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        for (size_t s = 0; s < n_sources; ++s) {
+            const double x = extent*uniform(7*s + 1), y = extent*uniform(7*s + 2);
+            geo_point p(x, y, 100.0 + 1400.0*(x + y)/(2.0*extent) + 200.0*(uniform(7*s + 3) - 0.5));
+            ts_t t(r.ta, 0.0, st::POINT_AVERAGE_VALUE), pr(r.ta, 0.0, st::POINT_AVERAGE_VALUE), rad(r.ta, 0.0, st::POINT_AVERAGE_VALUE);
+            for (size_t i = 0; i < o.steps; ++i) {
+                const double h = double(i);
+                const bool missing = s > 0 && uniform((s << 20) + i)*100.0 < double(o.nan);
+                t.set(i, missing ? nan : 8.0 + 3.0*std::sin(2.0*pi*h/24.0) - 0.006*p.z + uniform(7*s + 4));
+                pr.set(i, missing ? nan : (std::fmod(h/6.0 + 5.0*uniform(7*s + 5), 5.0) < 1.5 ? 2.0 : 0.0));
+                rad.set(i, missing ? nan : std::max(0.0, 250.0*std::sin(2.0*pi*h/24.0)) + 50.0);
+            }
+            r.temperature.push_back(gts_t{ p, t });
+            r.precipitation.push_back(gts_t{ p, pr });
+            r.radiation.push_back(gts_t{ p, rad });
+        }
+        return r;
+    }
+
+    /** one run of a case, with the neighbour table cache to use, nullptr for none */
+    typedef function<void(region&, idw::neighbour_table_cache*, int)> run_t;
+
+    struct bench_case {
+        string name;
+        run_t run;
+        bool has_table;///< uses a neighbour table, so it has a warm run
+    };
+
+    auto setter = [](destination& d, size_t ix, double v) { d.v[ix] = v; };
+
+    vector<bench_case> make_cases() {
+        typedef idw::temperature_model<igts_t, destination, idw::temperature_parameter, geo_point, idw::temperature_gradient_scale_computer> idw_temperature_t;
+        typedef idw::precipitation_model<igts_t, destination, idw::precipitation_parameter, geo_point> idw_precipitation_t;
+        typedef idw::radiation_model<igts_t, destination, idw::parameter, geo_point> idw_radiation_t;
+        vector<bench_case> r;
+        r.push_back(bench_case{ "idw/temperature", [](region& g, idw::neighbour_table_cache* c, int ncore) {
+            idw::temperature_parameter p(-0.006, 20, 200000.0, true);// with the gradient by equation
+            idw::run_interpolation<idw_temperature_t, igts_t>(g.ta, g.temperature, p, g.cells, setter, ncore, c);
+        }, true });
+        r.push_back(bench_case{ "idw/precipitation", [](region& g, idw::neighbour_table_cache* c, int ncore) {
+            idw::run_interpolation<idw_precipitation_t, igts_t>(g.ta, g.precipitation, idw::precipitation_parameter(), g.cells, setter, ncore, c);
+        }, true });
+        r.push_back(bench_case{ "idw/radiation", [](region& g, idw::neighbour_table_cache* c, int ncore) {
+            idw::run_interpolation<idw_radiation_t, igts_t>(g.ta, g.radiation, idw::parameter(), g.cells, setter, ncore, c);
+        }, true });
+        r.push_back(bench_case{ "kriging/temperature", [](region& g, idw::neighbour_table_cache* c, int ncore) {
+            ok::local_parameter p;
+            p.z_gradient = -0.006;
+            ok::run_interpolation<igts_t>(g.ta, g.temperature, p, g.cells, setter, ncore, c);
+        }, true });
+        r.push_back(bench_case{ "btk/temperature", [](region& g, idw::neighbour_table_cache*, int) {
+            btk::btk_interpolation<tsa_t>(begin(g.temperature), end(g.temperature), begin(g.cells), end(g.cells), g.ta, btk::parameter());
+        }, false });
+        return r;
+    }
+
+    /** \return the best of reps runs, in ms */
+    double best_ms(const bench_case& c, region& g, idw::neighbour_table_cache* cache, const options& o) {
+        double best = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < o.reps; ++i) {
+            const auto t = chrono::steady_clock::now();
+            c.run(g, cache, o.ncore);
+            best = std::min(best, 1000.0*seconds_since(t));
+        }
+        return best;
+    }
+
+    void print_header(const options& o) {
+        if (o.format == "text") {
+            cout << "min_cells=" << o.min_cells << " max_cells=" << o.max_cells << " min_sources=" << o.min_sources << " max_sources=" << o.max_sources
+                 << " steps=" << o.steps << " nan=" << o.nan << "% ncore=" << o.ncore << " reps=" << o.reps << "\n";
+            cout << setw(20) << left << "case" << right << setw(10) << "cells" << setw(10) << "sources" << setw(12) << "cold[ms]" << setw(12) << "warm[ms]"
+                 << setw(14) << "ns/cell-step" << setw(12) << "table[MB]" << setw(10) << "rss[MB]" << endl;
+        } else if (o.format == "csv") {
+            cout << "case,cells,sources,steps,nan,cold_ms,warm_ms,ns_per_cell_step,table_bytes,rss_mb" << endl;
+        }
+    }
+
+    /** warm_ms is < 0 for the cases without a table, and ns/cell-step is of the warm run if any, otherwise of the cold */
+    void print_result(const options& o, const string& name, size_t cells, size_t sources, double cold_ms, double warm_ms, size_t table_bytes, double rss_mb) {
+        const double ns = 1e6*(warm_ms >= 0.0 ? warm_ms : cold_ms)/double(cells*o.steps);
+        if (o.format == "text") {
+            cout << setw(20) << left << name << right << setw(10) << cells << setw(10) << sources << fixed << setprecision(2)
+                 << setw(12) << cold_ms;
+            if (warm_ms >= 0.0) cout << setw(12) << warm_ms; else cout << setw(12) << "-";
+            cout << setw(14) << ns << setw(12) << double(table_bytes)/(1024.0*1024.0) << setprecision(1) << setw(10) << rss_mb << endl;
+        } else if (o.format == "csv") {
+            cout << name << ',' << cells << ',' << sources << ',' << o.steps << ',' << o.nan << ',' << fixed << setprecision(3) << cold_ms << ','
+                 << (warm_ms >= 0.0 ? warm_ms : 0.0) << ',' << ns << ',' << table_bytes << ',' << setprecision(1) << rss_mb << endl;
+        } else {
+            cout << "{\"case\":\"" << name << "\",\"cells\":" << cells << ",\"sources\":" << sources << ",\"steps\":" << o.steps << ",\"nan\":" << o.nan
+                 << fixed << setprecision(3) << ",\"cold_ms\":" << cold_ms << ",\"warm_ms\":" << (warm_ms >= 0.0 ? warm_ms : 0.0)
+                 << ",\"ns_per_cell_step\":" << ns << ",\"table_bytes\":" << table_bytes << ",\"rss_mb\":" << setprecision(1) << rss_mb << "}" << endl;
+        }
+    }
+
+    void run_case(const bench_case& c, const options& o) {
+        for (size_t ns = o.min_sources; ns <= o.max_sources; ns *= 10) {
+            for (size_t nc = o.min_cells; nc <= o.max_cells; nc *= 10) {
+                if (c.has_table || ns*nc <= o.btk_max) {
+                    region g = make_region(nc, ns, o);
+                    const double cold = best_ms(c, g, nullptr, o);
+                    double warm = -1.0;
+                    idw::neighbour_table_cache cache;
+                    if (c.has_table) {
+                        c.run(g, &cache, o.ncore);// fills the cache
+                        warm = best_ms(c, g, &cache, o);
+                    }
+                    print_result(o, c.name, nc, ns, cold, warm, cache.heap_bytes(), peak_rss_mb());
+                }
+                if (nc > o.max_cells/10) break;
+            }
+            if (ns > o.max_sources/10) break;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const auto o = parse(argc, argv);
+        const auto cases = make_cases();
+        print_header(o);
+        size_t n_run = 0;
+        for (const auto& c : cases) {
+            if (o.name != "all" && c.name.compare(0, o.name.size(), o.name) != 0)
+                continue;
+            run_case(c, o);
+            ++n_run;
+        }
+        if (n_run == 0)
+            throw runtime_error("no case matches " + o.name);
+    } catch (const exception& e) {
+        cerr << "interpolation_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
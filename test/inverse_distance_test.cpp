@@ -327,6 +327,24 @@ TEST_CASE("test_using_up_to_max_sources") {
 	TS_ASSERT_EQUALS(count_if(begin(d), end(d), [expected_v](const MCell&d) { return fabs(d.v - expected_v) < 1e-7; }), nx*ny);
 }
 
+TEST_CASE("test_sources_sampled_once_pr_timestep") {
+	utctime Tstart = 3600L * 24L * 365L * 44L;
+	const size_t n = 5;
+	ta::fixed_dt ta(Tstart, 3600L, n);
+	vector<Source> s(Source::GenerateTestSourceGrid(ta, 6, 6, -500.0, -500.0, 2000.0));
+	vector<MCell> d(MCell::GenerateTestGrid(10, 10));
+	Parameter p(3000.0, 4);
+	run_interpolation<TestTemperatureModel>(begin(s), end(s), begin(d), end(d), idw_timeaxis<ta::fixed_dt>(ta), p,
+		[](MCell& d, size_t ix, double v) {d.set_value(ix, v); });
+	TS_ASSERT_EQUALS(count_if(begin(d), end(d), [n](const MCell&d) { return d.set_count == int(n); }), d.size());
+	size_t n_used = 0;
+	for (const auto& x : s) {
+		FAST_CHECK_UNARY(x.get_count == 0 || x.get_count == int(n));// once pr. step, not once pr. destination and step
+		if (x.get_count) ++n_used;
+	}
+	FAST_CHECK_GT(n_used, 4u);
+}
+
 TEST_CASE("test_handling_different_sources_pr_timesteps") {
 	//
 	// Arrange
@@ -393,6 +411,89 @@ TEST_CASE("interpolation_ts_nan_outside_defined_period") {
     CHECK(cell_values[n-1]== doctest::Approx(10.0));// at last, only one 10degC contribute
 }
 
+TEST_CASE("test_neighbour_table_cache") {
+    using namespace shyft;
+    utctime Tstart = calendar().time(2000, 1, 1);
+    utctimespan dt = 3600L;
+    size_t n = 6;
+    ta::fixed_dt ta(Tstart, dt, n);
+    gta_t gta(ta);
+    api::a_region_environment re;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            re.temperature->emplace_back(geo_point(2500.0*i, 3000.0*j, 100.0*(i + j)), api::apoint_ts(gta, 10.0 - i + 0.5*j, POINT_AVERAGE_VALUE));
+    vector<MCell> d{MCell::GenerateTestGrid(7, 5)};
+    Parameter p(6000.0, 4);
+    using temperature_tsa_t=shyft::time_series::average_accessor<api::apoint_ts, timeaxis_t>;
+    using idw_compliant_temperature_gts_t=idw_compliant_geo_point_ts<api::TemperatureSource, temperature_tsa_t, timeaxis_t>;
+    using idw_temperature_model_t=idw::temperature_model  <idw_compliant_temperature_gts_t, MCell, Parameter, geo_point, idw::temperature_gradient_scale_computer>;
+    auto interpolate = [&](int ncore, neighbour_table_cache* cache) {
+        vector<double> r(d.size()*n, shyft::nan);
+        auto d0 = &d[0];
+        run_interpolation<idw_temperature_model_t, idw_compliant_temperature_gts_t>(ta, *re.temperature, p, d,
+            [&r, d0, n](MCell& c, size_t ix, double v) { r[(&c - d0)*n + ix] = v; }, ncore, cache);
+        return r;
+    };
+    auto expected = interpolate(1, nullptr);
+    neighbour_table_cache cache;
+    for (int ncore : {1, 3}) {
+        cache.clear();
+        auto r = interpolate(ncore, &cache);
+        FAST_REQUIRE_UNARY(cache.table != nullptr);
+        FAST_CHECK_EQ(cache.table->size(), d.size());
+        FAST_CHECK_EQ(r, expected);
+        auto t0 = cache.table;
+        FAST_CHECK_EQ(interpolate(ncore, &cache), expected);
+        FAST_CHECK_UNARY(cache.table == t0);// reused
+    }
+    SUBCASE("invalidated_by_parameters_and_locations") {
+        auto t0 = cache.table;
+        p.max_distance = 4000.0;
+        auto r = interpolate(1, &cache);
+        FAST_CHECK_UNARY(cache.table != t0);
+        FAST_CHECK_EQ(r, interpolate(1, nullptr));
+        auto t1 = cache.table;
+        (*re.temperature)[0].mid_point_.x += 1.0;
+        interpolate(1, &cache);
+        FAST_CHECK_UNARY(cache.table != t1);
+        auto t2 = cache.table;
+        d[0].point.z += 1.0;
+        interpolate(1, &cache);
+        FAST_CHECK_UNARY(cache.table != t2);
+    }
+}
+
+TEST_CASE("test_parallel_destination_ranges") {
+    using namespace shyft;
+    utctime Tstart = calendar().time(2000, 1, 1);
+    utctimespan dt = 3600L;
+    size_t n = 5;
+    ta::fixed_dt ta(Tstart, dt, n);
+    gta_t gta(ta);
+    api::a_region_environment re;
+    for (int i = 0; i < 6; ++i)
+        for (int j = 0; j < 6; ++j)
+            re.temperature->emplace_back(geo_point(1500.0*i, 1500.0*j, 50.0*i + 120.0*j), api::apoint_ts(gta, 12.0 - 0.7*i - 0.006*(50.0*i + 120.0*j), POINT_AVERAGE_VALUE));
+    vector<MCell> d{MCell::GenerateTestGrid(23, 17)};
+    Parameter p(50000.0, 6);
+    p.gradient_by_equation = true;// the per destination gradient is computed in the ranges as well
+    using temperature_tsa_t=shyft::time_series::average_accessor<api::apoint_ts, timeaxis_t>;
+    using idw_compliant_temperature_gts_t=idw_compliant_geo_point_ts<api::TemperatureSource, temperature_tsa_t, timeaxis_t>;
+    using idw_temperature_model_t=idw::temperature_model  <idw_compliant_temperature_gts_t, MCell, Parameter, geo_point, idw::temperature_gradient_scale_computer>;
+    auto pool = make_shared<work_stealing_pool>(3);
+    auto interpolate = [&](int ncore) {
+        vector<double> r(d.size()*n, shyft::nan);
+        auto d0 = &d[0];
+        run_interpolation<idw_temperature_model_t, idw_compliant_temperature_gts_t>(ta, *re.temperature, p, d,
+            [&r, d0, n](MCell& c, size_t ix, double v) { r[(&c - d0)*n + ix] = v; }, ncore, nullptr, pool);
+        return r;
+    };
+    auto expected = interpolate(1);
+    FAST_CHECK_EQ(count_if(begin(expected), end(expected), [](double x) { return !isfinite(x); }), 0);
+    for (int ncore : {2, 4, -1})
+        FAST_CHECK_EQ(interpolate(ncore), expected);// bitwise equal, independent of the partitioning
+}
+
 TEST_CASE("test_performance") {
     using namespace shyft;
     //
@@ -500,6 +601,53 @@ TEST_CASE("test_zscale_distance") {
 	TS_ASSERT_DELTA(geo_point::distance_measure(p0, p1, 1, 10), pow(1+1+10*10*1,0.5), 1e-9);
 	TS_ASSERT_DELTA(geo_point::distance_measure(p0, p1, 2.0, 1.0), pow(1 + 1 + 1, 2.0 / 2.0), 1e-9);
 }
+
+TEST_CASE("test_indexed_neighbours_equals_full_search") {
+	utctime Tstart = 3600L * 24L * 365L * 44L;
+	ta::fixed_dt ta(Tstart, 3600L, 1);
+	vector<Source> s(Source::GenerateTestSourceGrid(ta, 15, 12, -2000.0, -3000.0, 1300.0));// regular grid, lots of equal distances
+	s.emplace_back(geo_point(4500.0, 4500.0, 300.0), 8.0);// duplicate location of a cell, clamped max weight
+	s.emplace_back(geo_point(4500.0, 4500.5, 300.0), 8.0);
+	vector<MCell> d(MCell::GenerateTestGrid(12, 9));
+	for (double zscale : {1.0, 20.0}) {
+		for (size_t max_members : {size_t(1), size_t(4), size_t(9), size_t(500)}) {
+			for (double max_distance : {1000.0, 5000.0, 200000.0}) {
+				Parameter p(max_distance, max_members);
+				p.zscale = zscale;
+				vector<vector<source_weight<Source const*>>> full, indexed;
+				make_cell_neighbours<TestTemperatureModel>(begin(s), end(s), begin(d), end(d), p, full);
+				make_cell_neighbours_indexed<TestTemperatureModel>(begin(s), end(s), begin(d), end(d), p, indexed);
+				TS_ASSERT_EQUALS(full.size(), d.size());
+				TS_ASSERT_EQUALS(indexed.size(), d.size());
+				for (size_t i = 0; i < full.size(); ++i) {
+					TS_ASSERT_EQUALS(indexed[i].size(), full[i].size());
+					if (indexed[i].size() != full[i].size()) continue;
+					for (size_t j = 0; j < full[i].size(); ++j) {
+						TS_ASSERT_EQUALS(indexed[i][j].source, full[i][j].source);
+						TS_ASSERT_EQUALS(indexed[i][j].weight, full[i][j].weight);
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("test_kd_tree_3d") {
+	vector<kd_tree_3d::point> pts;
+	for (size_t i = 0; i < 100; ++i)
+		pts.push_back(kd_tree_3d::point{{{double(i % 10), double(i / 10), 0.0}}, i});
+	kd_tree_3d t(std::move(pts));
+	TS_ASSERT_EQUALS(t.size(), 100u);
+	std::array<double, 3> q{{4.0, 4.0, 0.0}};
+	TS_ASSERT_DELTA(t.kth_distance2(q, 1, 1e9), 0.0, 1e-12);
+	TS_ASSERT_DELTA(t.kth_distance2(q, 5, 1e9), 1.0, 1e-12);// self + 4 at distance 1
+	TS_ASSERT_DELTA(t.kth_distance2(q, 6, 1e9), 2.0, 1e-12);
+	TS_ASSERT_DELTA(t.kth_distance2(q, 6, 1.5), 1.5, 1e-12);// fewer than k within r2
+	vector<size_t> r;
+	t.within(q, 1.0, r);
+	std::sort(begin(r), end(r));
+	TS_ASSERT_EQUALS(r, (vector<size_t>{34, 43, 44, 45, 54}));
+}
 }
 
 /* vim: set filetype=cpp: */
@@ -162,4 +162,62 @@ TEST_CASE("test_running_predictor") {
         TS_ASSERT_DELTA(fx.bias_offset(t),bias_ts.value(i),0.2);// at the end it should have a quite correct pattern
     }
 }
+
+TEST_CASE("test_batch_filter") {
+    using namespace shyfttest;
+    kalman::parameter p;
+    kalman::filter f(p);
+    const size_t n_points = 5;
+    kalman::batch_state bs(f.create_initial_state(), n_points);
+    std::vector<kalman::state> ss(n_points, f.create_initial_state());
+    temperature fx(0.1);
+    std::vector<double> b(n_points);
+    for (int i = 0; i < 8*3; ++i) {
+        utctime t = fx.t0 + deltahours(3*i);
+        for (size_t j = 0; j < n_points; ++j) {
+            b[j] = (i + j) % 4 == 0 ? shyft::nan : fx.bias(t) + 0.1*j;// some missing observations pr. point
+            if (std::isfinite(b[j])) f.update(b[j], t, ss[j]);// the batch skips nan's like bias_predictor
+        }
+        f.update_batch(b.data(), t, bs, 0, 2);// two ranges, as used by the threads
+        f.update_batch(b.data(), t, bs, 2, n_points);
+    }
+    for (size_t j = 0; j < n_points; ++j) {
+        auto s = bs.point_state(j);
+        for (int i = 0; i < s.size(); ++i) {
+            TS_ASSERT_DELTA(s.x(i), ss[j].x(i), 1e-12);
+            TS_ASSERT_DELTA(s.k(i), ss[j].k(i), 1e-12);
+            for (int k = 0; k < s.size(); ++k)
+                TS_ASSERT_DELTA(s.P.at(i, k), ss[j].P.at(i, k), 1e-12);
+        }
+    }
+}
+
+TEST_CASE("test_batch_filter_blocks") {
+    using namespace shyfttest;
+    kalman::parameter p;
+    kalman::filter f(p);
+    const size_t n_points = 1000;// more than one block of the update
+    kalman::batch_state bs(f.create_initial_state(), n_points);
+    TS_ASSERT_EQUALS(bs.P.size(), n_points*p.n_daily_observations*(p.n_daily_observations + 1)/2);
+    kalman::state s0 = f.create_initial_state(), s1 = f.create_initial_state();
+    temperature fx(0.1);
+    std::vector<double> b(n_points);
+    for (int i = 0; i < 8*3; ++i) {
+        utctime t = fx.t0 + deltahours(3*i);
+        for (size_t j = 0; j < n_points; ++j)
+            b[j] = fx.bias(t) + (j == n_points - 1 ? 0.5 : 0.0);
+        f.update(b[0], t, s0);
+        f.update(b[n_points - 1], t, s1);
+        f.update_batch(b.data(), t, bs, 0, n_points);
+    }
+    auto r0 = bs.point_state(0), r1 = bs.point_state(n_points - 1);
+    for (int i = 0; i < r0.size(); ++i) {
+        TS_ASSERT_DELTA(r0.x(i), s0.x(i), 1e-12);
+        TS_ASSERT_DELTA(r1.x(i), s1.x(i), 1e-12);
+        for (int k = 0; k < r0.size(); ++k) {
+            TS_ASSERT_DELTA(r1.P.at(i, k), s1.P.at(i, k), 1e-12);
+            TS_ASSERT_DELTA(bs.P_at(i, k, n_points/2), bs.P_at(k, i, n_points/2), 0.0);
+        }
+    }
+}
 }
@@ -112,4 +112,48 @@ TEST_CASE("test_composite_average_loads") {
     }
 }
 
+TEST_CASE("test_fixed_step_solver") {
+    using namespace shyft::core;
+    parameter p;
+    calculator<kirchner::trapezoidal_average, parameter> k(p);
+    calculator<kirchner::fixed_step_trapezoidal_average, parameter> kf(p);
+    // a varying sequence, with wetting and drying periods, for hourly, 3 hourly and daily steps
+    for (auto dt : {deltahours(1), deltahours(3), deltahours(24)}) {
+        double q = 1.0, qf = 1.0, qa = 0.0, qfa = 0.0;
+        for (size_t i = 0; i < 500; ++i) {
+            const double P = (i % 20) < 6 ? 4.0 + sin(0.3*i) : 0.0;
+            const double E = 0.2;
+            k.step(0, dt, q, qa, P, E);
+            kf.step(0, dt, qf, qfa, P, E);
+            TS_ASSERT_DELTA(qf, q, 0.005*std::max(0.1, q));
+            TS_ASSERT_DELTA(qfa, qa, 0.02*std::max(0.1, qa));// the reference average uses the few internal steps of dopri5
+        }
+    }
+    SUBCASE("steady_state") {
+        double q = 1.0, qa = 0.0;
+        for (size_t i = 0; i < 10000; ++i)
+            kf.step(0, deltahours(1), q, qa, 10.0, 0.0);
+        TS_ASSERT_DELTA(q, 10.0, 0.001);
+        TS_ASSERT_DELTA(qa, 10.0, 0.001);
+    }
+    SUBCASE("drying_keeps_q_positive") {
+        double q = 0.1, qa = 0.0;
+        kf.step(0, deltahours(24), q, qa, 0.0, 5.0);
+        TS_ASSERT(q > 0.0);
+        TS_ASSERT(qa > 0.0);
+        TS_ASSERT(qa < 0.1);
+    }
+    if (getenv("SHYFT_VERBOSE")) {
+        const size_t n = 200*300;
+        double Q, Q_avg;
+        std::clock_t start = std::clock();
+        for (size_t i = 0; i < n; ++i) { Q = 1.0; k.step(0, deltahours(1), Q, Q_avg, 0.5, 0.2); }
+        const std::clock_t t_dopri = std::clock() - start;
+        start = std::clock();
+        for (size_t i = 0; i < n; ++i) { Q = 1.0; kf.step(0, deltahours(1), Q, Q_avg, 0.5, 0.2); }
+        const std::clock_t t_fixed = std::clock() - start;
+        std::cout << "Stepping Kirchner " << n << " times, dopri5: " << 1000*t_dopri/double(CLOCKS_PER_SEC) << " ms, fixed step: " << 1000*t_fixed/double(CLOCKS_PER_SEC) << " ms" << std::endl;
+    }
+}
+
 }
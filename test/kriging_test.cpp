@@ -1,5 +1,6 @@
 #include "test_pch.h"
 #include "core/kriging.h"
+#include "core/inverse_distance.h"
 #include "core/time_series.h"
 #include "core/geo_point.h"
 
@@ -8,6 +9,7 @@ namespace shyfttest {
     using namespace shyft::core;
     /** just a stub class for location concept*/
     struct location{
+        typedef geo_point geo_point_t;
         geo_point p;
         double v;
         geo_point mid_point() const { return p; }
@@ -149,4 +151,59 @@ TEST_CASE("test_interpolation") {
         // for debug/validation
         //cout<<"\ngrid values (should be between 0.6..1.2)\n"<<grid_values<<endl;
 }
+TEST_CASE("test_local_interpolation") {
+    namespace ok = kriging::ordinary;
+    namespace idw = inverse_distance;
+    vector<location> s;
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 4; ++j)
+            s.push_back(location{ geo_point(2000.0*i, 2500.0*j, 50.0*(i + j)), 1.0 + 0.1*i - 0.05*j*j });
+    vector<location> d;
+    for (double x = 500.0; x < 8000.0; x += 1500.0)
+        d.push_back(location{ geo_point(x, 0.7*x, 120.0), 0.0 });
+    d.push_back(location{ s[7].p, 0.0 });// at a source location
+    ok::local_parameter p(1.0, 0.0, 6000.0, 1.0, s.size(), 100000.0, 0.0);
+    idw::idw_timeaxis<shyft::time_axis::fixed_dt> ta(shyft::time_axis::fixed_dt(0, 3600, 2));
+    auto run = [&](const vector<location>& src, const ok::local_parameter& px) {
+        auto nt = idw::make_neighbour_table<ok::neighbour_model>(begin(src), end(src), begin(d), end(d), px.neighbour_parameter());
+        vector<double> r(d.size()*ta.size(), shyft::nan);
+        ok::run_interpolation(begin(src), end(src), begin(d), end(d), nt, 0, ta, px,
+            [&r, &d, &ta](location& x, size_t i, double v) { r[(&x - &d[0])*ta.size() + i] = v; });
+        return r;
+    };
+    SUBCASE("all_members_equals_global_kriging") {
+        auto r = run(s, p);
+        kriging::covariance::exponential ex(p.sill, p.range);
+        auto f_cov = [&ex](const location& a, const location& b) { return ex(geo_point::zscaled_distance(a.p, b.p, 1.0)); };
+        arma::mat X = arma::solve(kriging::ordinary::build(begin(s), end(s), f_cov), kriging::ordinary::build(begin(s), end(s), begin(d), end(d), f_cov));
+        for (size_t j = 0; j < d.size(); ++j) {
+            double v = 0.0;
+            for (size_t i = 0; i < s.size(); ++i) v += X.at(i, j)*s[i].v;
+            TS_ASSERT_DELTA(r[j*ta.size()], v, 1e-9);
+            TS_ASSERT_DELTA(r[j*ta.size() + 1], v, 1e-9);
+        }
+        TS_ASSERT_DELTA(r[(d.size() - 1)*ta.size()], s[7].v, 1e-9);// exact at source, no nugget
+    }
+    SUBCASE("invalid_sources_excluded") {
+        auto s_nan = s;
+        s_nan[7].v = shyft::nan;
+        auto s_ex = s;
+        s_ex.erase(s_ex.begin() + 7);
+        auto r = run(s_nan, p);
+        auto e = run(s_ex, p);
+        for (size_t k = 0; k < r.size(); ++k)
+            TS_ASSERT_DELTA(r[k], e[k], 1e-9);
+    }
+    SUBCASE("z_gradient") {
+        auto s_z = s;
+        for (auto& x : s_z) x.v = 4.0 - 0.006*x.p.z;
+        auto pz = p;
+        pz.z_gradient = -0.006;
+        pz.max_members = 4;
+        pz.nug = 0.1;
+        auto r = run(s_z, pz);
+        for (size_t j = 0; j < d.size(); ++j)
+            TS_ASSERT_DELTA(r[j*ta.size()], 4.0 - 0.006*d[j].p.z, 1e-9);
+    }
+}
 }
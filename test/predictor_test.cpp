@@ -85,4 +85,32 @@ TEST_CASE("predictor_serialization") {
     }
 }
 
+TEST_CASE("predictor_train_many") {
+    core::utctime t0 = core::utctime_now();
+    core::utctimespan dt = core::deltahours(3);
+    std::size_t n = 1000u;
+    sta::fixed_dt time_ax = sta::fixed_dt(t0, dt, n);
+    std::vector<sts::point_ts<sta::fixed_dt>> tsv;
+    std::vector<sp::krls_rbf_predictor> preds;
+    for ( std::size_t i = 0u; i < 5u; ++i ) {
+        auto v = make_sine(time_ax);
+        for ( auto & x : v ) x += double(i);
+        v[i*10] = shyft::nan;
+        tsv.emplace_back(time_ax, v, sts::ts_point_fx::POINT_AVERAGE_VALUE);
+        preds.emplace_back(dt, 1E-6, 0.001, 100000u);
+    }
+    auto mse = sp::krls_rbf_predictor::train_batch(preds, tsv);
+    FAST_REQUIRE_EQ(mse.size(), tsv.size());
+    for ( std::size_t i = 0u; i < tsv.size(); ++i ) {
+        sp::krls_rbf_predictor p{ dt, 1E-6, 0.001, 100000u };
+        FAST_CHECK_EQ(p.train(tsv[i]), doctest::Approx(mse[i]));
+        auto pv = preds[i].predict_vec(time_ax);
+        FAST_REQUIRE_EQ(pv.size(), n);
+        for ( std::size_t j = 0u; j < n; j += 97u )
+            FAST_CHECK_EQ(pv[j], doctest::Approx(p.predict(time_ax.time(j))));
+    }
+    std::vector<sp::krls_rbf_predictor> too_few(1u);
+    CHECK_THROWS_AS(sp::krls_rbf_predictor::train_batch(too_few, tsv), std::runtime_error);
+}
+
 }
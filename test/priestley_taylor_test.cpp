@@ -1,5 +1,8 @@
 #include "test_pch.h"
 #include "core/priestley_taylor.h"
+#include <vector>
+#include <limits>
+#include <ctime>
 
 using namespace shyft::core;
 namespace pt = shyft::core::priestley_taylor;
@@ -20,4 +23,33 @@ TEST_CASE("priestley_taylor_test::test_regression") {
     for(double r=10.0; r < 900.0; r += 50.0)
         TS_ASSERT(pt.potential_evapotranspiration(15, r, 60)<pt.potential_evapotranspiration(15, r + 50.0, 60));
 }
+TEST_CASE("priestley_taylor_test::test_batch_equals_scalar") {
+    pt::calculator pt(0.2, 1.26);
+    const size_t n = 1000;
+    std::vector<double> t(n), r(n), rh(n), pet(n, -1.0);
+    for (size_t i = 0; i < n; ++i) {
+        t[i] = -30.0 + 60.0*i/double(n);// covers both sets of constants
+        r[i] = (i*37) % 900;
+        rh[i] = 0.05 + 0.9*((i*13) % 100)/100.0;
+    }
+    t[n/2] = std::numeric_limits<double>::quiet_NaN();
+    pt.potential_evapotranspiration_batch(t.data(), r.data(), rh.data(), pet.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i == n/2)
+            FAST_CHECK_UNARY(!std::isfinite(pet[i]));
+        else
+            FAST_CHECK_EQ(pet[i], pt.potential_evapotranspiration(t[i], r[i], rh[i]));
+    }
+    if (getenv("SHYFT_VERBOSE")) {
+        const size_t n_steps = 1000;
+        double sum = 0.0;
+        const std::clock_t start = std::clock();
+        for (size_t k = 0; k < n_steps; ++k) {
+            pt.potential_evapotranspiration_batch(t.data(), r.data(), rh.data(), pet.data(), n);
+            sum += pet[k % (n/2)];
+        }
+        const double secs = (std::clock() - start)/double(CLOCKS_PER_SEC);
+        std::cout << "priestley_taylor batch: " << n*n_steps/secs/1e6 << " M cells/s pr. core (" << sum << ")" << std::endl;
+    }
+}
 }
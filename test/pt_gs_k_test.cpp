@@ -2,6 +2,7 @@
 #include "core/pt_gs_k.h"
 #include "core/cell_model.h"
 #include "core/pt_gs_k_cell_model.h"
+#include "core/pt_gs_k_batch.h"
 #include "core/geo_cell_data.h"
 #include "core/geo_point.h"
 #include "mocks.h"
@@ -270,4 +271,126 @@ TEST_CASE("test_mass_balance") {
     }
 }
 
+
+TEST_CASE("test_run_batch_equals_cell_run") {
+    // verify that the timestep-major batch execution gives identical results as the cell-major cell.run
+    calendar cal;
+    utctime t0 = cal.time(2014, 3, 1, 0, 0, 0);
+    const size_t n = 24*30;
+    ta::fixed_dt tax(t0, deltahours(1), n);
+    auto p = make_shared<parameter>();
+    auto p2 = make_shared<parameter>();// a second group of cells sharing a parameter
+    p2->gm.direct_response = 0.3;
+    p2->kirchner.c1 = -2.5;
+    typedef pt_gs_k::cell_complete_response_t cell_t;
+    vector<cell_t> cm(5);
+    for (size_t j = 0; j < cm.size(); ++j) {
+        auto& c = cm[j];
+        c.geo = geo_cell_data(geo_point(1000.0*j, 1000.0, 100.0 + 200.0*j), 1000.0*1000.0, 0);
+        if (j == 3) c.geo.set_land_type_fractions(land_type_fractions(0.2, 0.1, 0.1, 0.0, 0.6));
+        c.set_parameter(j % 2 ? p2 : p);
+        c.init_env_ts(tax);
+        for (size_t i = 0; i < n; ++i) {
+            c.env_ts.temperature.set(i, -5.0 + 10.0*sin(i/24.0) + j);
+            c.env_ts.precipitation.set(i, (i % 7) < 3 ? 1.0 + 0.1*j : 0.0);
+            c.env_ts.radiation.set(i, 200.0 + 50.0*j);
+            c.env_ts.rel_hum.set(i, 0.7);
+            c.env_ts.wind_speed.set(i, 2.0);
+        }
+        c.state.kirchner.q = 1.0 + j;
+        c.set_state_collection(true);
+    }
+    auto tm = cm;// timestep-major copy
+    for (auto& c : cm)
+        c.run(tax, 0, 0);
+    vector<cell_t*> batch;
+    for (auto& c : tm) batch.push_back(&c);
+    cell_t::run_batch(tax, 0, 0, batch.data(), batch.size());
+    for (size_t j = 0; j < cm.size(); ++j) {
+        FAST_CHECK_EQ(tm[j].state, cm[j].state);
+        FAST_REQUIRE_EQ(tm[j].rc.avg_discharge.size(), n);
+        for (size_t i = 0; i < n; ++i) {
+            FAST_CHECK_EQ(tm[j].rc.avg_discharge.value(i), cm[j].rc.avg_discharge.value(i));
+            FAST_CHECK_EQ(tm[j].rc.snow_swe.value(i), cm[j].rc.snow_swe.value(i));
+            FAST_CHECK_EQ(tm[j].sc.kirchner_discharge.value(i), cm[j].sc.kirchner_discharge.value(i));
+        }
+        FAST_CHECK_EQ(tm[j].rc.end_reponse.total_discharge, cm[j].rc.end_reponse.total_discharge);
+    }
+}
+
+TEST_CASE("test_run_batch_offload_equals_cell_run") {
+    // the batch staged in soa buffers, forcing in, discharge and charge out, gives the same results as cell.run
+    calendar cal;
+    utctime t0 = cal.time(2014, 3, 1, 0, 0, 0);
+    const size_t n = 24*30;
+    ta::fixed_dt tax(t0, deltahours(1), n);
+    auto p = make_shared<parameter>();
+    typedef pt_gs_k::cell_discharge_response_t cell_t;
+    vector<cell_t> cm(5);
+    for (size_t j = 0; j < cm.size(); ++j) {
+        auto& c = cm[j];
+        c.geo = geo_cell_data(geo_point(1000.0*j, 1000.0, 100.0 + 200.0*j), 1000.0*1000.0, 0);
+        c.set_parameter(p);
+        c.init_env_ts(tax);
+        for (size_t i = 0; i < n; ++i) {
+            c.env_ts.temperature.set(i, -5.0 + 10.0*sin(i/24.0) + j);
+            c.env_ts.precipitation.set(i, (i % 7) < 3 ? 1.0 + 0.1*j : 0.0);
+            c.env_ts.radiation.set(i, 200.0 + 50.0*j);
+            c.env_ts.rel_hum.set(i, 0.7);
+            c.env_ts.wind_speed.set(i, 2.0);
+        }
+        c.state.kirchner.q = 1.0 + j;
+        c.rc.collect_snow = j % 2 == 0;
+    }
+    auto tm = cm;
+    for (auto& c : cm)
+        c.run(tax, 24, n - 48);
+    vector<cell_t*> batch;
+    for (auto& c : tm) batch.push_back(&c);
+    run_batch_offload(tax, 24, int(n - 48), batch.data(), batch.size());
+    for (size_t j = 0; j < cm.size(); ++j) {
+        FAST_CHECK_EQ(tm[j].state, cm[j].state);
+        FAST_REQUIRE_EQ(tm[j].rc.avg_discharge.size(), cm[j].rc.avg_discharge.size());
+        for (size_t i = 24; i < n - 24; ++i) {
+            FAST_CHECK_EQ(tm[j].rc.avg_discharge.value(i), cm[j].rc.avg_discharge.value(i));
+            FAST_CHECK_EQ(tm[j].rc.charge_m3s.value(i), cm[j].rc.charge_m3s.value(i));
+            if (j % 2 == 0)
+                FAST_CHECK_EQ(tm[j].rc.snow_swe.value(i), cm[j].rc.snow_swe.value(i));
+        }
+        FAST_CHECK_EQ(tm[j].rc.end_response.total_discharge, cm[j].rc.end_response.total_discharge);
+    }
+}
+
+TEST_CASE("test_fixed_step_kirchner") {
+    // verify the stack can be instantiated with the fixed-step kirchner solver, and gives close to the same discharge
+    calendar cal;
+    utctime t0 = cal.time(2014, 8, 1, 0, 0, 0);
+    const size_t n = 24*20;
+    ta::fixed_dt tax(t0, deltahours(1), n);
+    ta::fixed_dt tax_state(t0, deltahours(1), n + 1);
+    parameter parameter{pt::parameter(), gs::parameter(), ae::parameter(), kr::parameter(), pc::parameter()};
+    pts_t temp(tax, 12.0);
+    pts_t prec(tax, 0.0);
+    pts_t rel_hum(tax, 0.8);
+    pts_t wind_speed(tax, 2.0);
+    pts_t radiation(tax, 300.0);
+    for (size_t i = 0; i < n; ++i) prec.set(i, (i % 48) < 10 ? 2.0 : 0.0);
+    gs::state gs_state;
+    gs_state.lwc = 0.0;
+    gs_state.acc_melt = -1;
+    state s_ref{gs_state, kr::state{1.0}};
+    state s_fix{s_ref};
+    const double cell_area = 1000*1000;
+    geo_cell_data gcd(geo_point(1000, 1000, 100));
+    pt_gs_k::state_collector sc;
+    sc.initialize(tax_state, 0, 0, cell_area);
+    pt_gs_k::all_response_collector rc_ref, rc_fix;
+    rc_ref.initialize(tax, 0, 0, cell_area);
+    rc_fix.initialize(tax, 0, 0, cell_area);
+    pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response>(gcd, parameter, tax, 0, 0, temp, prec, wind_speed, rel_hum, radiation, s_ref, sc, rc_ref);
+    pt_gs_k::run_pt_gs_k<direct_accessor, pt_gs_k::response, kr::fixed_step_trapezoidal_average>(gcd, parameter, tax, 0, 0, temp, prec, wind_speed, rel_hum, radiation, s_fix, sc, rc_fix);
+    for (size_t i = 0; i < n; ++i)
+        FAST_CHECK_EQ(rc_fix.avg_discharge.value(i), doctest::Approx(rc_ref.avg_discharge.value(i)).epsilon(0.02));
+    FAST_CHECK_EQ(s_fix.kirchner.q, doctest::Approx(s_ref.kirchner.q).epsilon(0.005));
+}
 }
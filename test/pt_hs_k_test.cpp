@@ -36,6 +36,33 @@ namespace shyfttest {
         }
     };
 }; // End namespace shyfttest
+namespace {
+    /** counts the collect calls, a null collector if Null is true */
+    template <bool Null>
+    struct counting_collector {
+        typedef std::integral_constant<bool, Null> is_null_collector;
+        size_t n = 0;
+        template <class X> void collect(size_t, const X&) { ++n; }
+        template <class X> void set_end_response(const X&) {}
+    };
+    struct add_one {
+        template <class X> explicit add_one(const X&) {}
+        template <class X> void step(X& x) { x.v += 1.0; }
+    };
+    struct snow_add_one : add_one {
+        typedef std::integral_constant<method_stack::profiling::routine, method_stack::profiling::snow> profile_routine;
+        template <class X> explicit snow_add_one(const X& x) : add_one(x) {}
+    };
+    struct twice {
+        double f;
+        template <class X> explicit twice(const X& x) : f(x.factor) {}
+        template <class X> void step(X& x) { x.v *= f; }
+    };
+    struct test_context {
+        double factor = 2.0;
+        double v = 0.0;
+    };
+}
 TEST_SUITE("pt_hs_k") {
 TEST_CASE("test_call_stack") {
     xpts_t temp;
@@ -88,4 +115,73 @@ TEST_CASE("test_call_stack") {
     for (size_t i = 0; i < snow_swe.size(); ++i)
         TS_ASSERT(std::isfinite(snow_swe.get(i).v) && snow_swe.get(i).v >= 0);
 }
+TEST_CASE("test_method_stack_composition") {
+    test_context x;
+    method_stack::stack<add_one, twice, add_one> composed(x);
+    composed.step(x);
+    TS_ASSERT_DELTA(x.v, 3.0, 1e-12);// (0 + 1)*2 + 1
+    composed.step(x);
+    TS_ASSERT_DELTA(x.v, 9.0, 1e-12);
+    TS_ASSERT(method_stack::is_null_collector<counting_collector<true>>::value);
+    TS_ASSERT(!method_stack::is_null_collector<counting_collector<false>>::value);
+
+    // run the pt_hs_k stack, with null and ordinary collectors
+    xpts_t temp, prec, rel_hum, wind_speed, radiation;
+    calendar cal;
+    utctime t0 = cal.time(YMDhms(2014, 8, 1, 0, 0, 0));
+    size_t n = 3*24;
+    shyfttest::create_time_series(temp, prec, rel_hum, wind_speed, radiation, t0, deltahours(1), n);
+    ta::fixed_dt time_axis(t0, deltahours(1), n);
+    parameter p(pt::parameter(), hs::parameter({1.0, 1.0, 1.0, 1.0, 1.0}, {0.0, 0.25, 0.5, 0.75, 1.0}), ae::parameter(), kr::parameter(), pc::parameter());
+    geo_cell_data gcd;
+    state s0 {hs::state(10.0, 0.5), kr::state{5.0}};
+    state s1 = s0;
+    counting_collector<false> sc, rc;
+    counting_collector<true> null_sc;
+    pt_hs_k::run<direct_accessor, response>(gcd, p, time_axis, 0, 0, temp, prec, wind_speed, rel_hum, radiation, s0, sc, rc);
+    pt_hs_k::run<direct_accessor, response>(gcd, p, time_axis, 0, 0, temp, prec, wind_speed, rel_hum, radiation, s1, null_sc, rc);
+    TS_ASSERT_EQUALS(sc.n, n + 1);
+    TS_ASSERT_EQUALS(null_sc.n, 0u);
+    TS_ASSERT_EQUALS(rc.n, 2*n);
+    TS_ASSERT(s0 == s1);
+}
+TEST_CASE("test_method_stack_profiling") {
+    namespace prof = method_stack::profiling;
+    TS_ASSERT(prof::routine_of<snow_add_one>::value == prof::snow);
+    TS_ASSERT(prof::routine_of<add_one>::value == prof::other);
+    TS_ASSERT_EQUALS(std::string(prof::routine_name(prof::actual_evapotranspiration)), std::string("actual_evapotranspiration"));
+    // the enabled timer counts one call for each routine visited, into the thread counters
+    prof::accumulator acc;
+    test_context x;
+    method_stack::stack<add_one, snow_add_one, twice> composed(x);
+    acc.measure([&]() {
+        for (int i = 0; i < 3; ++i) {
+            prof::basic_timer<true> tm(prof::input);
+            composed.step(x, tm);
+        }
+    });
+    TS_ASSERT_DELTA(x.v, 28.0, 1e-9);// (((0 + 2)*2 + 2)*2 + 2)*2
+    if (prof::enabled) {
+        TS_ASSERT(acc.sum.calls[prof::snow] >= 3u);// and any stack run by measure in the profiled build
+    } else {
+        TS_ASSERT_EQUALS(acc.sum.calls[prof::input], 0u);// measure does not count in the ordinary build
+    }
+    const prof::counters c0 = prof::thread_counters();
+    {
+        prof::basic_timer<true> tm(prof::input);
+        composed.step(x, tm);
+    }
+    const prof::counters d = prof::thread_counters() - c0;
+    TS_ASSERT_EQUALS(d.calls[prof::input], 1u);
+    TS_ASSERT_EQUALS(d.calls[prof::snow], 1u);
+    TS_ASSERT_EQUALS(d.calls[prof::other], 2u);
+    TS_ASSERT_EQUALS(d.calls[prof::collect], 0u);
+    TS_ASSERT(d.total_cycles() >= d.cycles[prof::snow]);
+    prof::counters sum;
+    sum += d;
+    sum += d;
+    TS_ASSERT_EQUALS(sum.calls[prof::other], 4u);
+    sum.clear();
+    TS_ASSERT(sum == prof::counters());
+}
 }
@@ -555,4 +555,42 @@ TEST_SUITE("qm") {
         }
 
     }
+    TEST_CASE("qm_prior_ranking") {
+        //Arrange
+        const auto fx_avg = time_series::ts_point_fx::POINT_AVERAGE_VALUE;
+        core::calendar utc;
+        const auto t0 = utc.time(2017, 1, 1, 0, 0, 0);
+        ta_t pri_ta(t0, core::deltahours(24), 30);// the ranking covers the days of several runs
+        tsv_t prior_ts_v;
+        for (size_t i = 0; i<20; ++i) {
+            vector<double> v;
+            for (size_t t = 0; t<pri_ta.size(); ++t) v.emplace_back(static_cast<double>((i*7 + t*3)%20));
+            prior_ts_v.emplace_back(pri_ta, v, fx_avg);
+        }
+        auto pri = qm::prior_ranking<ta_t>::make<tsa_t>(prior_ts_v, pri_ta);
+        FAST_CHECK_EQ(pri.size(), 20u);
+
+        //Act, Assert: each daily run equals the mapping with the priors sorted again
+        for (size_t day = 0; day<3; ++day) {
+            ta_t ta(t0 + core::deltahours(24*day), core::deltahours(24), 5);
+            tsv_t fc;
+            vector<double> weights;
+            for (size_t j = 0; j<4; ++j) {
+                fc.emplace_back(ta, vector<double>{ 1.0*j + day, 2.0*j, 3.0 - j, 4.0*j, 1.0 }, fx_avg);
+                weights.emplace_back(1.0 + j);
+            }
+            auto expected = qm::quantile_mapping<tsa_t>(prior_ts_v, fc, qm::quantile_index<tsa_t>(prior_ts_v, ta), qm::quantile_index<tsa_t>(fc, ta), weights, ta, core::no_utctime);
+            auto result = qm::quantile_mapping<tsa_t>(pri, fc, weights, ta, core::no_utctime);
+            FAST_REQUIRE_EQ(result.size(), expected.size());
+            for (size_t i = 0; i<result.size(); ++i) {
+                FAST_CHECK_EQ(result[i].time_axis(), ta);
+                for (size_t t = 0; t<ta.size(); ++t)
+                    FAST_CHECK_EQ(result[i].value(t), doctest::Approx(expected[i].value(t)));
+            }
+        }
+        auto mapped = qm::quantile_map_forecast<tsa_t>(vector<tsv_t>{ tsv_t{ ts_t(pri_ta, 1.0, fx_avg) } }, vector<double>{ 1.0 }, pri, pri_ta, core::no_utctime);
+        FAST_CHECK_EQ(mapped.size(), 20u);
+        CHECK_THROWS_AS(qm::quantile_mapping<tsa_t>(pri, tsv_t{}, vector<double>{}, ta_t(t0 + core::deltahours(1), core::deltahours(24), 2), core::no_utctime), std::runtime_error);
+        CHECK_THROWS_AS(qm::quantile_mapping<tsa_t>(pri, tsv_t{}, vector<double>{}, ta_t(t0, core::deltahours(24), 31), core::no_utctime), std::runtime_error);
+    }
 }
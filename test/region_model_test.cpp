@@ -1,4 +1,6 @@
 #include "test_pch.h"
+#include <set>
+#include <boost/filesystem.hpp>
 
 
 // from core pull in the basic templated algorithms
@@ -40,6 +42,60 @@ typedef st::point_ts<ta::fixed_dt> pts_t;
 typedef st::constant_timeseries<ta::fixed_dt> cts_t;
 typedef ta::fixed_dt ta_t;
 
+namespace {
+    typedef pt_gs_k::cell_complete_response_t test_cell_t;
+    typedef sc::region_model<test_cell_t> test_region_model_t;
+
+    /** n_cells cells in two catchments, at x=0,1000.., with geo and initial state, but no env_ts */
+    template <class CT = test_cell_t>
+    shared_ptr<vector<CT>> make_test_cells(size_t n_cells) {
+        auto cells = make_shared<vector<CT>>();
+        for (size_t j = 0; j < n_cells; ++j) {
+            CT c;
+            c.geo = sc::geo_cell_data(sc::geo_point(1000.0*j, 1000.0, 100.0 + 10.0*j), 1000.0*1000.0, j % 2);
+            c.state.kirchner.q = 1.0 + 0.01*j;
+            cells->push_back(c);
+        }
+        return cells;
+    }
+
+    /** a region-model of make_test_cells, with env_ts filled in, ready for run_cells */
+    template <class CT = test_cell_t>
+    sc::region_model<CT> make_test_region_model(size_t n_cells, const ta_t& ta) {
+        auto cells = make_test_cells<CT>(n_cells);
+        pt_gs_k::parameter_t p;
+        sc::region_model<CT> rm(cells, p);
+        rm.initialize_cell_environment(ta);
+        for (size_t j = 0; j < n_cells; ++j) {
+            auto& c = (*rm.get_cells())[j];
+            for (size_t i = 0; i < ta.size(); ++i) {
+                c.env_ts.temperature.set(i, -3.0 + 8.0*sin(i/24.0) + 0.01*j);
+                c.env_ts.precipitation.set(i, (i + j) % 5 < 2 ? 1.5 : 0.0);
+                c.env_ts.radiation.set(i, 150.0);
+                c.env_ts.rel_hum.set(i, 0.75);
+                c.env_ts.wind_speed.set(i, 2.0);
+            }
+        }
+        return rm;
+    }
+
+    /** the test region-model, with the cells in n_units units of identical cells, and areas that differ within a unit */
+    template <class CT = test_cell_t>
+    sc::region_model<CT> make_hru_region_model(size_t n_cells, size_t n_units, const ta_t& ta) {
+        auto rm = make_test_region_model<CT>(n_cells, ta);
+        auto cells = rm.get_cells();
+        for (size_t j = 0; j < n_cells; ++j) {
+            auto& c = (*cells)[j];
+            const auto& u = (*cells)[j % n_units];
+            c.geo = sc::geo_cell_data(sc::geo_point(1000.0*j, 1000.0, 100.0 + 10.0*(j % n_units)), 1000.0*1000.0*(1 + (j/n_units) % 2), j % 2);
+            c.geo.catchment_ix = j % 2;// as mapped by the model
+            c.env_ts = u.env_ts;
+            c.state = u.state;
+        }
+        return rm;
+    }
+}
+
 TEST_SUITE("region_model") {
 TEST_CASE("test_build") {
 
@@ -166,6 +222,33 @@ TEST_CASE("test_build") {
         rm.run_cells();
         FAST_CHECK_EQ((*rm.get_cells())[0].rc.avg_discharge.ta, ta2);
     }
+    SUBCASE("state_soa") {
+        vector<pt_gs_k::state_t> s0;
+        for (size_t i = 0; i < rm.size(); ++i) {
+            pt_gs_k::state_t s{gss, ks};
+            s.kirchner.q = 1.0 + i;
+            s.gs.acc_melt = 10.0 + i;
+            s0.push_back(s);
+        }
+        rm.set_states(s0);
+        shyft::core::pt_gs_k::state_soa soa;
+        rm.get_states_soa(soa);
+        FAST_REQUIRE_EQ(soa.size(), rm.size());
+        for (size_t i = 0; i < soa.size(); ++i) {
+            FAST_CHECK_EQ(soa.get(i), s0[i]);
+            FAST_CHECK_EQ(soa.q()[i], doctest::Approx(s0[i].kirchner.q));
+            FAST_CHECK_EQ(soa.gs_acc_melt()[i], doctest::Approx(s0[i].gs.acc_melt));
+        }
+        for (auto& q : soa.q()) q *= 2.0;
+        rm.set_states_soa(soa);
+        vector<pt_gs_k::state_t> s1;
+        rm.get_states(s1);
+        for (size_t i = 0; i < s1.size(); ++i)
+            FAST_CHECK_EQ(s1[i].kirchner.q, doctest::Approx(2.0*s0[i].kirchner.q));
+        shyft::core::pt_gs_k::state_soa soa_short;
+        soa_short.resize(1);
+        CHECK_THROWS_AS(rm.set_states_soa(soa_short), runtime_error);
+    }
     ptgsk_region_model_t rm_copy(rm);
     auto p1 = rm.get_region_parameter();
     auto p2 = rm_copy.get_region_parameter();
@@ -225,5 +308,894 @@ TEST_CASE("test_region_vs_catchment_parameters") {
 
 
 }
+
+TEST_CASE("test_work_stealing_pool") {
+    sc::work_stealing_pool pool(3);
+    FAST_CHECK_EQ(pool.size(), 3u);
+    const size_t n = 1000;
+    vector<int> hits(n, 0);
+    pool.parallel_for(n, 7, [&hits](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) hits[i]++;
+    });
+    for (size_t i = 0; i < n; ++i)
+        FAST_CHECK_EQ(hits[i], 1);
+    // nested calls from a chunk must not dead-lock
+    std::atomic<size_t> sum{0};
+    pool.parallel_for(10, 1, [&pool, &sum](size_t, size_t) {
+        pool.parallel_for(10, 1, [&sum](size_t i0, size_t i1) { sum += i1 - i0; });
+    });
+    FAST_CHECK_EQ(sum.load(), 100u);
+    // exceptions are propagated to the caller
+    CHECK_THROWS_AS(pool.parallel_for(100, 1, [](size_t i0, size_t) {
+        if (i0 == 42) throw runtime_error("chunk failed");
+    }), runtime_error);
+    // zero workers executes in the calling thread
+    sc::work_stealing_pool serial(0);
+    size_t cnt = 0;
+    serial.parallel_for(n, 0, [&cnt](size_t i0, size_t i1) { cnt += i1 - i0; });
+    FAST_CHECK_EQ(cnt, n);
+    // max_threads limits the number of participating threads
+    std::mutex mx;
+    std::set<std::thread::id> ids;
+    pool.parallel_for(n, 1, [&mx, &ids](size_t, size_t) {
+        std::lock_guard<std::mutex> lock(mx);
+        ids.insert(std::this_thread::get_id());
+    }, 2);
+    FAST_CHECK_LE(ids.size(), 2u);
+}
+
+TEST_CASE("test_timeline_trace") {
+    auto& tr = sc::trace::tracer::instance();
+    sc::work_stealing_pool pool(3);
+    auto run = [&pool]() {
+        pool.parallel_for(100, 10, [](size_t i0, size_t i1) { sc::trace::scope ts("cells", i0, i1); });
+    };
+    run();// not recording
+    FAST_CHECK_EQ(tr.size().first, 0u);
+    tr.start(4);
+    FAST_CHECK_UNARY(tr.enabled());
+    run();
+    tr.stop();
+    run();
+    auto s = tr.size();
+    FAST_CHECK_EQ(s.first + s.second, 10u);
+    FAST_CHECK_LE(s.first, 4u*4u);// at most capacity kept per thread
+    auto json = tr.chrome_json();
+    FAST_CHECK_EQ(json.find("{\"traceEvents\":["), 0u);
+    FAST_CHECK_NE(json.find("\"name\":\"cells\",\"cat\":\"shyft\",\"ph\":\"X\""), string::npos);
+    FAST_CHECK_NE(json.find("\"thread_name\""), string::npos);
+    FAST_CHECK_NE(json.find("\"i1\":"), string::npos);
+    tr.clear();
+    FAST_CHECK_EQ(tr.size().first, 0u);
+    FAST_CHECK_EQ(tr.chrome_json(), string("{\"traceEvents\":[]}\n"));
+}
+
+TEST_CASE("test_partitioned_pool") {
+    sc::work_stealing_pool pool(3, true);
+    FAST_CHECK_UNARY(sc::work_stealing_pool::numa_cpu_order().size() > 0);
+    const size_t n = 1001;
+    vector<int> hits(n, 0);
+    pool.parallel_for_partitioned(n, 0, [&hits](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) hits[i]++;
+    });
+    for (size_t i = 0; i < n; ++i)
+        FAST_CHECK_EQ(hits[i], 1);
+    FAST_CHECK_EQ(sc::work_stealing_pool::slab_begin(n, 4, 0), 0u);
+    FAST_CHECK_EQ(sc::work_stealing_pool::slab_begin(n, 4, 4), n);
+    // the calling thread owns slab 0, with zero workers it gets everything
+    sc::work_stealing_pool serial(0);
+    size_t cnt = 0;
+    serial.parallel_for_partitioned(n, 10, [&cnt](size_t i0, size_t i1) { cnt += i1 - i0; });
+    FAST_CHECK_EQ(cnt, n);
+    CHECK_THROWS_AS(pool.parallel_for_partitioned(100, 1, [](size_t i0, size_t) {
+        if (i0 == 60) throw runtime_error("chunk failed");
+    }), runtime_error);
+    // run_cells with numa partitioning gives same result
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 48);
+    auto a = make_test_region_model(40, ta);
+    auto b = make_test_region_model(40, ta);
+    b.numa_partitioning = true;
+    b.initialize_cell_environment(ta);
+    auto const& ac = *a.get_cells();
+    auto& bc = *b.get_cells();
+    for (size_t j = 0; j < bc.size(); ++j) bc[j].env_ts = ac[j].env_ts;
+    a.run_cells();
+    b.run_cells();
+    for (size_t j = 0; j < ac.size(); ++j)
+        FAST_CHECK_EQ(bc[j].state, ac[j].state);
+}
+
+TEST_CASE("test_shared_executor") {
+    sc::executor::configure(3);
+    FAST_CHECK_EQ(sc::executor::size(), 3u);
+    auto p1 = sc::executor::instance();
+    auto p2 = sc::executor::instance();
+    FAST_CHECK_EQ(p1.get(), p2.get());// same process-wide pool
+    std::atomic<size_t> cnt{0};
+    p1->parallel_for(100, 0, [&cnt](size_t i0, size_t i1) { cnt += i1 - i0; });
+    FAST_CHECK_EQ(cnt.load(), 100u);
+    sc::executor::configure(0);// back to default hardware concurrency
+    FAST_CHECK_NE(sc::executor::instance().get(), p1.get());
+}
+
+TEST_CASE("test_run_cells_timestep_major") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*10);
+    auto cm = make_test_region_model(130, ta);
+    test_region_model_t tm(cm);
+    cm.run_cells();
+    tm.run_cells_timestep_major(0, 0, 0, 16);
+    FAST_REQUIRE_EQ(cm.size(), tm.size());
+    auto const& cc = *cm.get_cells();
+    auto const& tc = *tm.get_cells();
+    for (size_t j = 0; j < cc.size(); ++j) {
+        FAST_CHECK_EQ(tc[j].state, cc[j].state);
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(tc[j].rc.avg_discharge.value(i), cc[j].rc.avg_discharge.value(i));
+    }
+    SUBCASE("with_catchment_filter_and_steps") {
+        auto a = make_test_region_model(20, ta);
+        test_region_model_t b(a);
+        a.set_catchment_calculation_filter(vector<int>{1});
+        b.set_catchment_calculation_filter(vector<int>{1});
+        a.run_cells(0, 24, 48);
+        b.run_cells_timestep_major(0, 24, 48, 3);
+        for (size_t j = 0; j < a.size(); ++j)
+            FAST_CHECK_EQ((*b.get_cells())[j].state, (*a.get_cells())[j].state);
+    }
+}
+
+TEST_CASE("test_autotune") {
+    auto& store = sc::autotune_store::instance();
+    store.clear();
+    auto cs = sc::autotune_candidates(8, 1000);
+    FAST_CHECK_EQ(cs.size(), 9u);// 8,4,2 threads, each with auto, 1 and n/(t*16) chunks
+    FAST_CHECK_EQ(cs.front().n_threads, 8u);
+    FAST_CHECK_EQ(sc::autotune_candidates(1, 10).size(), 2u);// auto and 1, the third is 0 as well
+    FAST_CHECK_EQ(sc::autotune_key("a b", 1000), sc::autotune_key("a_b", 600));// rounded to 1024
+    FAST_CHECK_NE(sc::autotune_key("a", 1000), sc::autotune_key("a", 1100));
+    sc::autotuner tuner;
+    vector<sc::autotune_setting> seen;
+    for (size_t i = 0; i < cs.size(); ++i) {
+        FAST_CHECK_EQ(tuner.tuning() || i == 0, true);
+        auto s = tuner.next("x", 1000, 8);
+        FAST_CHECK_EQ(std::find(seen.begin(), seen.end(), s) == seen.end(), true);// a new candidate each run
+        seen.push_back(s);
+        tuner.measured("x", 1000, s, s.n_threads == 4 && s.chunk_size == 1 ? 1.0 : 2.0);
+    }
+    FAST_CHECK_EQ(tuner.tuning(), false);
+    FAST_CHECK_EQ(store.size(), 1u);
+    auto b = tuner.next("x", 1000, 8);
+    FAST_CHECK_EQ(b.n_threads, 4u);
+    FAST_CHECK_EQ(b.chunk_size, 1u);
+    sc::autotuner other;
+    FAST_CHECK_EQ(other.next("x", 900, 8), b);// shared by the tuners of the process
+    FAST_CHECK_EQ(other.next("x", 9000, 8, false).chunk_size, 0u);// other size, not tuned yet
+
+    SUBCASE("file") {
+        auto fn = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("autotune_%%%%-%%%%.txt")).string();
+        store.set_file(fn);
+        store.put("y", sc::autotune_setting{3, 7});
+        store.clear();
+        sc::autotune_setting s;
+        FAST_CHECK_EQ(store.get("y", s), false);
+        store.set_file(fn);// loads the settings of the file
+        FAST_CHECK_EQ(store.get("y", s), true);
+        FAST_CHECK_EQ(s.n_threads, 3u);
+        FAST_CHECK_EQ(s.chunk_size, 7u);
+        FAST_CHECK_EQ(store.get("x/1024/" + sc::autotune_machine_key(), s), true);
+        store.set_file("");
+        boost::filesystem::remove(fn);
+    }
+    SUBCASE("region_model") {
+        sc::calendar cal;
+        ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24);
+        auto cm = make_test_region_model(40, ta);
+        test_region_model_t tm(cm);
+        cm.run_cells();
+        tm.autotune_threads = true;
+        const size_t n = store.size();
+        for (size_t r = 0; r < 20 && store.size() == n; ++r) {
+            if (r) tm.revert_to_initial_state();
+            tm.run_cells();
+            for (size_t j = 0; j < cm.size(); ++j)
+                FAST_CHECK_EQ((*tm.get_cells())[j].state, (*cm.get_cells())[j].state);
+        }
+        FAST_CHECK_EQ(store.size(), n + 1);// tuned within the first runs
+        FAST_CHECK_GE(tm.ncore, 1u);
+    }
+    store.clear();
+}
+
+TEST_CASE("test_catchment_filter_run_list") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*2);
+    auto a = make_test_region_model(21, ta);
+    test_region_model_t b(a);
+    vector<size_t> visited;
+    a.for_each_calculated_cell([&visited](size_t i) { visited.push_back(i); });
+    FAST_CHECK_EQ(visited.size(), a.size());
+    a.set_catchment_calculation_filter(vector<int>{1});
+    visited.clear();
+    a.for_each_calculated_cell([&visited](size_t i) { visited.push_back(i); });
+    FAST_REQUIRE_EQ(visited.size(), 10u);
+    for (size_t k = 0; k < visited.size(); ++k)
+        FAST_CHECK_EQ(visited[k], 2*k + 1);// ascending, only the cells of catchment 1
+    test_region_model_t c(a);// the clone keeps the filter
+    a.run_cells();
+    c.run_cells();
+    b.run_cells();
+    for (size_t j = 0; j < a.size(); ++j) {
+        auto const& ac = (*a.get_cells())[j];
+        if (j % 2) {
+            FAST_CHECK_EQ(ac.state, (*b.get_cells())[j].state);
+            FAST_CHECK_EQ(ac.state, (*c.get_cells())[j].state);
+        } else {
+            FAST_CHECK_EQ(ac.state.kirchner.q, doctest::Approx(1.0 + 0.01*j));// not run
+        }
+    }
+    a.set_catchment_calculation_filter(vector<int>{});
+    visited.clear();
+    a.for_each_calculated_cell([&visited](size_t i) { visited.push_back(i); });
+    FAST_CHECK_EQ(visited.size(), a.size());
+}
+
+TEST_CASE("test_order_cells_spatially") {
+    FAST_CHECK_EQ(sc::hilbert_index(0, 0, 1), 0u);
+    FAST_CHECK_EQ(sc::hilbert_index(0, 1, 1), 1u);
+    FAST_CHECK_EQ(sc::hilbert_index(1, 1, 1), 2u);
+    FAST_CHECK_EQ(sc::hilbert_index(1, 0, 1), 3u);
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*2);
+    auto a = make_test_region_model(21, ta);
+    test_region_model_t b(a);
+    a.set_catchment_calculation_filter(vector<int>{1});
+    b.set_catchment_calculation_filter(vector<int>{1});
+    FAST_CHECK_EQ(a.original_cell_index.size(), 0u);
+    a.order_cells_spatially();
+    auto const& ac = *a.get_cells();
+    auto const& bc = *b.get_cells();
+    FAST_REQUIRE_EQ(a.original_cell_index.size(), a.size());
+    vector<size_t> seen(a.size(), 0);
+    for (size_t j = 0; j < a.size(); ++j) {
+        auto o = a.original_cell_index[j];
+        FAST_REQUIRE_LT(o, a.size());
+        ++seen[o];
+        FAST_CHECK_EQ(ac[j].geo.catchment_id(), bc[o].geo.catchment_id());
+        FAST_CHECK_EQ(ac[j].geo.catchment_ix, j < 11 ? 0u : 1u);// grouped by catchment, in order of first appearance
+    }
+    FAST_CHECK_EQ(std::count(seen.begin(), seen.end(), size_t(1)), long(a.size()));
+    size_t n_calculated = 0;
+    a.for_each_calculated_cell([&](size_t i) { FAST_CHECK_EQ(ac[i].geo.catchment_id(), 1u); ++n_calculated; });
+    FAST_CHECK_EQ(n_calculated, 10u);
+    a.set_catchment_calculation_filter(vector<int>{});
+    b.set_catchment_calculation_filter(vector<int>{});
+    a.run_cells();
+    b.run_cells();
+    for (size_t j = 0; j < a.size(); ++j)
+        FAST_CHECK_EQ(ac[j].state, bc[a.original_cell_index[j]].state);
+    vector<pts_t> aq, bq;
+    a.catchment_discharges(aq);
+    b.catchment_discharges(bq);
+    FAST_REQUIRE_EQ(aq.size(), bq.size());
+    for (size_t k = 0; k < aq.size(); ++k)
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(aq[k].value(i), doctest::Approx(bq[k].value(i)));
+    auto first = a.original_cell_index;
+    a.order_cells_spatially();// already ordered, the mapping is kept
+    FAST_CHECK_EQ(a.original_cell_index, first);
+}
+
+TEST_CASE("test_geo_cell_table") {
+    sc::land_type_fractions f;
+    f.set_fractions(0.1, 0.2, 0.05, 0.4);
+    vector<sc::geo_cell_data> gcd{
+        sc::geo_cell_data(sc::geo_point(0.0, 0.0, 10.0), 2000.0, 7, 0.8, f),
+        sc::geo_cell_data(sc::geo_point(1.0, 0.0, 20.0), 3000.0) };
+    sc::geo_cell_table g(gcd);
+    FAST_REQUIRE_EQ(g.size(), 2u);
+    FAST_CHECK_EQ(g.area[0], 2000.0);
+    FAST_CHECK_EQ(g.catchment_id[0], 7);
+    FAST_CHECK_EQ(g.catchment_id[1], -1);
+    FAST_CHECK_EQ(g.radiation_slope_factor[0], doctest::Approx(0.8));
+    FAST_CHECK_EQ(g.glacier[0], doctest::Approx(0.1));
+    FAST_CHECK_EQ(g.forest[0], doctest::Approx(0.4));
+    FAST_CHECK_EQ(g.unspecified[0], doctest::Approx(0.25));
+    FAST_CHECK_EQ(g.unspecified[1], 1.0f);
+    FAST_CHECK_EQ(g.sum_area(vector<size_t>{ 0, 1 }), 5000.0);
+
+    auto cells = make_test_cells(21);
+    test_region_model_t a(cells, pt_gs_k::parameter_t());
+    const auto& t = a.get_geo_cell_table();
+    FAST_REQUIRE_EQ(t.size(), a.size());
+    for (size_t j = 0; j < a.size(); ++j) {
+        FAST_CHECK_EQ(t.catchment_ix[j], (*a.get_cells())[j].geo.catchment_ix);
+        FAST_CHECK_EQ(t.catchment_id[j], int(j % 2));
+        FAST_CHECK_EQ(t.area[j], 1000.0*1000.0);
+    }
+    (*a.get_cells())[4].geo.set_land_type_fractions(f);// the geo of the cells are public
+    a.set_catchment_calculation_filter(vector<int>{0});
+    FAST_CHECK_EQ(a.get_geo_cell_table().glacier[4], doctest::Approx(0.1));
+    size_t n_calculated = 0;
+    a.for_each_calculated_cell([&](size_t i) { FAST_CHECK_EQ(t.catchment_id[i], 0); ++n_calculated; });
+    FAST_CHECK_EQ(n_calculated, 11u);
+    a.order_cells_spatially();
+    for (size_t j = 0; j < a.size(); ++j)
+        FAST_CHECK_EQ(a.get_geo_cell_table().catchment_ix[j], (*a.get_cells())[j].geo.catchment_ix);
+}
+
+TEST_CASE("test_hru_deduplication") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*3);
+    SUBCASE("cell_collectors") {
+        auto a = make_hru_region_model(40, 4, ta);
+        test_region_model_t b(a);
+        a.hru_deduplication = true;
+        a.run_cells();
+        b.run_cells();
+        auto const& ac = *a.get_cells();
+        auto const& bc = *b.get_cells();
+        for (size_t j = 0; j < ac.size(); ++j) {
+            FAST_CHECK_EQ(ac[j].state, bc[j].state);
+            for (size_t i = 0; i < ta.size(); ++i)
+                FAST_CHECK_EQ(ac[j].rc.avg_discharge.value(i), doctest::Approx(bc[j].rc.avg_discharge.value(i)));
+        }
+        a.set_catchment_calculation_filter(vector<int>{1});
+        b.set_catchment_calculation_filter(vector<int>{1});
+        a.run_cells_timestep_major(0, 24, 24);
+        b.run_cells_timestep_major(0, 24, 24);
+        for (size_t j = 0; j < ac.size(); ++j)
+            FAST_CHECK_EQ(ac[j].state, bc[j].state);
+    }
+    SUBCASE("catchment_collector") {
+        auto a = make_hru_region_model<pt_gs_k::cell_catchment_response_t>(40, 4, ta);
+        auto d = make_hru_region_model<pt_gs_k::cell_discharge_response_t>(40, 4, ta);
+        a.hru_deduplication = true;
+        a.run_cells();
+        d.run_cells();
+        for (size_t j = 0; j < a.size(); ++j)
+            FAST_CHECK_EQ((*a.get_cells())[j].state, (*d.get_cells())[j].state);
+        vector<pts_t> aq, dq, ac, dc;
+        a.catchment_discharges(aq); d.catchment_discharges(dq);
+        a.catchment_charges(ac); d.catchment_charges(dc);
+        FAST_REQUIRE_EQ(aq.size(), size_t(2));
+        FAST_REQUIRE_EQ(dq.size(), aq.size());
+        for (size_t k = 0; k < aq.size(); ++k) {
+            for (size_t i = 0; i < ta.size(); ++i) {
+                FAST_CHECK_EQ(aq[k].value(i), doctest::Approx(dq[k].value(i)));
+                FAST_CHECK_EQ(ac[k].value(i), doctest::Approx(dc[k].value(i)));
+            }
+        }
+        a.hru_deduplication = false;// the scale of the representatives is reset
+        a.initial_state.clear();
+        for (size_t j = 0; j < a.size(); ++j) (*a.get_cells())[j].set_state((*d.get_cells())[j].state);
+        a.run_cells(0, 24, 24);
+        d.run_cells(0, 24, 24);
+        a.catchment_discharges(aq); d.catchment_discharges(dq);
+        for (size_t i = 24; i < 48; ++i)
+            FAST_CHECK_EQ(aq[1].value(i), doctest::Approx(dq[1].value(i)));
+    }
+}
+
+TEST_CASE("test_catchment_statistics") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 48);
+    auto rm = make_test_region_model(300, ta);// 150 cells in each catchment, summed in several parts
+    rm.run_cells();
+    auto const& cells = *rm.get_cells();
+    typedef sc::cell_statistics cs;
+    auto l = cs::catchment_cell_lists(cells, vector<int>{1, 0, 1});
+    FAST_REQUIRE_EQ(l.size(), 3u);
+    FAST_CHECK_EQ(l[0].size(), 150u);
+    FAST_CHECK_EQ(l[0], l[2]);
+    FAST_CHECK_EQ(l[1][0], 0u);
+    CHECK_THROWS_AS(cs::catchment_cell_lists(cells, vector<int>{0, 2}), std::runtime_error);
+    FAST_CHECK_EQ(cs::catchment_cell_lists(cells, vector<int>{})[0].size(), cells.size());
+
+    auto q = [](const test_cell_t& c) -> const pts_t& { return c.rc.avg_discharge; };
+    auto t = [](const test_cell_t& c) { return c.env_ts.temperature; };
+    auto qs = cs::sum_catchment_features(cells, vector<int>{0, 1}, q);
+    auto ts = cs::sum_catchment_features(cells, vector<int>{0, 1}, t, true);
+    vector<pts_t> cq;
+    rm.catchment_discharges(cq);
+    FAST_REQUIRE_EQ(cq.size(), 2u);
+    for (size_t k = 0; k < 2; ++k) {
+        auto q1 = cs::sum_catchment_feature(cells, vector<int>{int(k)}, q);
+        auto t1 = cs::average_catchment_feature(cells, vector<int>{int(k)}, t);
+        for (size_t i = 0; i < ta.size(); ++i) {
+            double sq = 0.0, st = 0.0, a = 0.0;
+            for (const auto& c : cells) {
+                if (c.geo.catchment_id() != k) continue;
+                sq += c.rc.avg_discharge.value(i);
+                st += c.env_ts.temperature.value(i)*c.geo.area();
+                a += c.geo.area();
+            }
+            FAST_CHECK_EQ(qs[k]->value(i), doctest::Approx(sq));
+            FAST_CHECK_EQ(q1->value(i), doctest::Approx(sq));
+            FAST_CHECK_EQ(cq[k].value(i), doctest::Approx(sq));
+            FAST_CHECK_EQ(ts[k]->value(i), doctest::Approx(st/a));
+            FAST_CHECK_EQ(t1->value(i), doctest::Approx(st/a));
+            FAST_CHECK_EQ(cs::sum_catchment_feature_value(cells, vector<int>{int(k)}, q, i), doctest::Approx(sq));
+        }
+    }
+    auto qa = cs::sum_catchment_feature(cells, vector<int>{}, q);
+    for (size_t i = 0; i < ta.size(); ++i)
+        FAST_CHECK_EQ(qa->value(i), doctest::Approx(qs[0]->value(i) + qs[1]->value(i)));
+}
+
+TEST_CASE("test_fork") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*3);
+    auto base = make_test_region_model(20, ta);
+    vector<test_region_model_t::state_t> s0;
+    base.get_states(s0);
+    test_region_model_t a(base), b(base);// deep copies, as reference
+    b.get_region_parameter().p_corr.scale_factor = 1.5;
+    auto fa = base.fork();
+    auto fb = base.fork();
+    fb.get_region_parameter().p_corr.scale_factor = 1.5;
+    FAST_CHECK_UNARY(fa.shares_environment());
+    FAST_CHECK_UNARY(!base.shares_environment());
+    FAST_CHECK_EQ((*fa.get_cells())[3].env_ts.temperature.size(), 0u);
+    FAST_CHECK_EQ(base.get_region_parameter().p_corr.scale_factor, doctest::Approx(1.0));
+    std::thread t([&fa]() { fa.run_cells(); });
+    fb.run_cells_timestep_major();
+    t.join();
+    a.run_cells();
+    b.run_cells();
+    vector<pts_t> aq, bq, faq, fbq;
+    a.catchment_discharges(aq); b.catchment_discharges(bq);
+    fa.catchment_discharges(faq); fb.catchment_discharges(fbq);
+    FAST_REQUIRE_EQ(faq.size(), aq.size());
+    for (size_t k = 0; k < aq.size(); ++k) {
+        for (size_t i = 0; i < ta.size(); ++i) {
+            FAST_CHECK_EQ(faq[k].value(i), doctest::Approx(aq[k].value(i)));
+            FAST_CHECK_EQ(fbq[k].value(i), doctest::Approx(bq[k].value(i)));
+        }
+    }
+    for (size_t j = 0; j < base.size(); ++j) {
+        FAST_CHECK_EQ((*fa.get_cells())[j].state, (*a.get_cells())[j].state);
+        FAST_CHECK_EQ((*fb.get_cells())[j].state, (*b.get_cells())[j].state);
+        FAST_CHECK_EQ((*base.get_cells())[j].state, s0[j]);// the base is not changed
+        FAST_CHECK_EQ((*fa.get_cells())[j].env_ts.temperature.size(), 0u);// released after the run
+    }
+    auto ff = fa.fork();// a fork of a fork shares the base
+    FAST_CHECK_UNARY(ff.shares_environment());
+    test_region_model_t fc(fa);
+    FAST_CHECK_UNARY(fc.shares_environment());
+    ff.initialize_cell_environment(ta);// copy-on-write, now it has its own
+    FAST_CHECK_UNARY(!ff.shares_environment());
+    FAST_CHECK_EQ((*ff.get_cells())[3].env_ts.temperature.size(), ta.size());
+    FAST_CHECK_EQ((*base.get_cells())[3].env_ts.temperature.value(5), doctest::Approx(-3.0 + 8.0*sin(5/24.0) + 0.03));
+}
+
+TEST_CASE("test_method_stack_counters") {
+    namespace prof = sc::method_stack::profiling;
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*3);
+    auto cm = make_test_region_model(10, ta);
+    test_region_model_t tm(cm);
+    cm.set_catchment_calculation_filter(vector<int>{1});
+    cm.run_cells();
+    tm.run_cells_timestep_major(0, 0, 0, 4);
+    if (prof::enabled) {
+        FAST_CHECK_EQ(cm.stack_counters.calls[prof::snow], 5*ta.size());// only the cells of catchment 1
+        FAST_CHECK_EQ(cm.stack_counters.calls[prof::response], 5*ta.size());
+        FAST_CHECK_EQ(tm.stack_counters.calls[prof::snow], 10*ta.size());
+        FAST_CHECK_GT(cm.stack_counters.total_cycles(), 0u);
+        cm.run_cells(0, 0, 24);// the counters are for the last run
+        FAST_CHECK_EQ(cm.stack_counters.calls[prof::snow], 5*24u);
+    } else {
+        FAST_CHECK_EQ(cm.stack_counters, prof::counters());
+        FAST_CHECK_EQ(tm.stack_counters, prof::counters());
+    }
 }
 
+TEST_CASE("test_routing_flows") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*3);
+    auto rm = make_test_region_model(10, ta);
+    rm.river_network.add(sc::routing::river(2, sc::routing_info(0)));
+    rm.river_network.add(sc::routing::river(1, sc::routing_info(2, 7200.0)));
+    rm.connect_catchment_to_river(0, 1);
+    rm.connect_catchment_to_river(1, 2);
+    for (auto& c : *rm.get_cells()) c.geo.routing.distance = 5000.0;
+    rm.run_cells();
+    vector<pts_t> q;
+    rm.routing_discharges(q);
+    FAST_REQUIRE_EQ(q.size(), 2u);
+    sc::routing::model<test_cell_t> rn(rm.river_network, rm.get_cells(), ta);
+    auto q1 = rn.output_m3s(1);
+    auto u2 = rm.river_upstream_inflow_m3s(2);
+    auto f = rm.routing_flows();
+    FAST_CHECK_EQ(f.get(), rm.routing_flows().get());// computed once
+    for (size_t i = 0; i < ta.size(); ++i) {
+        FAST_CHECK_EQ(q[0].value(i), q1.value(i));
+        FAST_CHECK_EQ(u2->value(i), q1.value(i));
+        FAST_CHECK_EQ(rm.river_output_flow_m3s(2)->value(i), q[1].value(i));
+    }
+    rm.connect_catchment_to_river(1, 1);// changes the routing, recomputed
+    FAST_CHECK_NE(f.get(), rm.routing_flows().get());
+    auto f2 = rm.routing_flows();
+    FAST_CHECK_GT(rm.river_local_inflow_m3s(1)->value(30), f->local_inflow.find(1)->second.value(30));
+    rm.run_cells();// a new run drops the flows
+    FAST_CHECK_NE(f2.get(), rm.routing_flows().get());
+}
+
+TEST_CASE("test_routing_state") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*3);
+    const size_t n0 = 48;
+    auto with_routing = [](sc::region_model<test_cell_t>& rm) {
+        rm.river_network.add(sc::routing::river(2, sc::routing_info(0)));
+        rm.river_network.add(sc::routing::river(1, sc::routing_info(2, 36000.0)));
+        rm.connect_catchment_to_river(0, 1);
+        rm.connect_catchment_to_river(1, 2);
+        for (auto& c : *rm.get_cells()) c.geo.routing.distance = 20000.0;
+    };
+    auto ref = make_test_region_model(10, ta);
+    with_routing(ref);
+    ref.run_cells();
+    FAST_CHECK_EQ(ref.routing_state.t, ta.total_period().end);
+    // the first n0 steps, then continued by a model for the remaining steps, as for an operational forecast
+    auto a = make_test_region_model(10, ta_t(ta.time(0), ta.delta(), n0));
+    with_routing(a);
+    a.run_cells();
+    FAST_CHECK_EQ(a.routing_state.t, ta.time(n0));
+    vector<test_cell_t::state_t> s;
+    a.get_states(s);
+    ta_t ta_b(ta.time(n0), ta.delta(), ta.size() - n0);
+    for (int cold = 0; cold < 2; ++cold) {
+        auto b = make_test_region_model(10, ta_b);
+        with_routing(b);
+        auto const& rc = *ref.get_cells();
+        auto& bc = *b.get_cells();
+        for (size_t j = 0; j < bc.size(); ++j) {
+            for (size_t i = 0; i < ta_b.size(); ++i) {
+                bc[j].env_ts.temperature.set(i, rc[j].env_ts.temperature.value(n0 + i));
+                bc[j].env_ts.precipitation.set(i, rc[j].env_ts.precipitation.value(n0 + i));
+            }
+        }
+        b.set_states(s);
+        if (!cold)
+            b.routing_state = a.routing_state;
+        b.run_cells();
+        for (int rid = 1; rid <= 2; ++rid) {
+            auto q_ref = ref.river_output_flow_m3s(rid);
+            auto q = b.river_output_flow_m3s(rid);
+            if (cold)
+                FAST_CHECK_LT(q->value(0), q_ref->value(n0));// the flow of the routing history is missing
+            else
+                for (size_t i = 0; i < ta_b.size(); ++i)
+                    FAST_CHECK_EQ(q->value(i), doctest::Approx(q_ref->value(n0 + i)));
+        }
+    }
+}
+
+TEST_CASE("test_run_cells_checkpoints") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*10);
+    auto ref = make_test_region_model(20, ta);
+    auto rm = make_test_region_model(20, ta);
+    ref.run_cells();
+    rm.set_checkpoints(vector<size_t>{120, 24, 48, ta.size()});
+    FAST_CHECK_EQ(rm.checkpoints.capacity(), 4u);
+    rm.run_cells();
+    FAST_CHECK_EQ(rm.checkpoints.size(), 4u);
+    auto const& rc = *ref.get_cells();
+    auto const& mc = *rm.get_cells();
+    for (size_t j = 0; j < rc.size(); ++j) {// splitting the run at checkpoints should not change the result
+        FAST_CHECK_EQ(mc[j].state, rc[j].state);
+        FAST_CHECK_EQ(mc[j].rc.avg_discharge.value(200), doctest::Approx(rc[j].rc.avg_discharge.value(200)));
+    }
+    // now destroy the state, and the results after 130, then resume from the checkpoint before 130
+    for (auto& c : *rm.get_cells()) {
+        c.state.kirchner.q = 100.0;
+        c.rc.avg_discharge.fill_range(shyft::nan, 130, ta.size() - 130);
+    }
+    auto cix = rm.run_cells_from_checkpoint(130);
+    FAST_CHECK_EQ(cix, 120u);
+    for (size_t j = 0; j < rc.size(); ++j) {
+        FAST_CHECK_EQ(mc[j].state, rc[j].state);
+        for (size_t i = 120; i < ta.size(); ++i)
+            FAST_CHECK_EQ(mc[j].rc.avg_discharge.value(i), doctest::Approx(rc[j].rc.avg_discharge.value(i)));
+    }
+    FAST_CHECK_EQ(rm.run_cells_from_checkpoint(ta.size()), ta.size());// end-state, nothing to run
+    CHECK_THROWS_AS(rm.run_cells_from_checkpoint(10), runtime_error);// no checkpoint before 24
+    SUBCASE("ring_capacity") {
+        sc::state_checkpoint_ring<int> r(2);
+        r.put(10, vector<int>{1});
+        r.put(20, vector<int>{2});
+        r.put(30, vector<int>{3});// replaces the oldest, 10
+        FAST_CHECK_EQ(r.size(), 2u);
+        FAST_CHECK_UNARY(r.nearest(15) == nullptr);
+        FAST_CHECK_EQ(r.nearest(25)->states[0], 2);
+        r.put(20, vector<int>{4});// replace in place
+        FAST_CHECK_EQ(r.nearest(29)->states[0], 4);
+        FAST_CHECK_EQ(r.times(), (vector<sc::utctime>{20, 30}));
+    }
+}
+
+TEST_CASE("test_incremental_interpolation") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 48);
+    typedef sc::geo_point_ts<pts_t> gpts_t;
+    typedef sc::region_environment<gpts_t, gpts_t, gpts_t, gpts_t, gpts_t> env_t;
+    auto cells = make_test_cells(10);
+    sc::region_model<test_cell_t, env_t> m(cells, pt_gs_k::parameter_t());
+    env_t env;
+    env.temperature = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{sc::geo_point(0.0, 0.0, 100.0), pts_t(ta, 2.0)}});
+    env.precipitation = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{sc::geo_point(0.0, 0.0, 100.0), pts_t(ta, 1.0, st::POINT_AVERAGE_VALUE)}});
+    sc::interpolation_parameter ip;
+    m.incremental_interpolation = true;
+    m.run_interpolation(ip, ta, env);
+    auto& c0 = (*m.get_cells())[0];
+    FAST_CHECK_EQ(c0.env_ts.temperature.value(0), doctest::Approx(2.0));
+    double p0 = c0.env_ts.precipitation.value(0);
+    FAST_CHECK_UNARY(std::isfinite(p0));
+    c0.env_ts.temperature.set(0, -99.0);// marker, stays as long as temperature is not re-interpolated
+    (*env.precipitation)[0].ts.set(0, 2.0);// precipitation changed in place
+    m.run_interpolation(ip, ta, env);
+    FAST_CHECK_EQ(c0.env_ts.temperature.value(0), doctest::Approx(-99.0));
+    FAST_CHECK_EQ(c0.env_ts.precipitation.value(0), doctest::Approx(2.0*p0));
+    m.run_interpolation(ip, ta, env);// nothing changed
+    FAST_CHECK_EQ(c0.env_ts.temperature.value(0), doctest::Approx(-99.0));
+    ip.temperature_idw.default_temp_gradient = -0.005;
+    ip.use_idw_for_temperature = true;// temperature parameter changed
+    m.run_interpolation(ip, ta, env);
+    FAST_CHECK_EQ(c0.env_ts.temperature.value(0), doctest::Approx(2.0));
+    c0.env_ts.temperature.set(0, -99.0);
+    m.incremental_interpolation = false;// turned off, all signals are interpolated
+    m.run_interpolation(ip, ta, env);
+    FAST_CHECK_EQ(c0.env_ts.temperature.value(0), doctest::Approx(2.0));
+}
+TEST_CASE("test_kriging_for_temperature") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24);
+    typedef sc::geo_point_ts<pts_t> gpts_t;
+    typedef sc::region_environment<gpts_t, gpts_t, gpts_t, gpts_t, gpts_t> env_t;
+    auto cells = make_test_cells(10);
+    sc::region_model<test_cell_t, env_t> m(cells, pt_gs_k::parameter_t());
+    env_t env;
+    env.temperature = make_shared<vector<gpts_t>>();
+    for (auto p : {sc::geo_point(0.0, 0.0, 100.0), sc::geo_point(5000.0, 3000.0, 600.0), sc::geo_point(9000.0, -2000.0, 1200.0)})
+        env.temperature->push_back(gpts_t{p, pts_t(ta, 5.0 - 0.006*p.z, st::POINT_AVERAGE_VALUE)});
+    sc::interpolation_parameter ip;
+    ip.use_kriging_for_temperature = true;// the temperature_kriging default gradient is -0.006
+    FAST_CHECK_UNARY(m.run_interpolation(ip, ta, env));
+    for (auto const& c : *m.get_cells())
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(c.env_ts.temperature.value(i), doctest::Approx(5.0 - 0.006*c.geo.mid_point().z));
+}
+
+TEST_CASE("test_grid_remap_by_signal") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24);
+    typedef sc::geo_point_ts<pts_t> gpts_t;
+    typedef sc::region_environment<gpts_t, gpts_t, gpts_t, gpts_t, gpts_t> env_t;
+    auto cells = make_test_cells(10);
+    sc::region_model<test_cell_t, env_t> m(cells, pt_gs_k::parameter_t());// cells at x=0..9000, y=1000
+    sc::grid_remap::regular_grid g(-500.0, 0.0, 2500.0, 2500.0, 5, 2);
+    env_t env;
+    env.temperature = make_shared<vector<gpts_t>>();
+    env.wind_speed = make_shared<vector<gpts_t>>();
+    for (size_t iy = 0; iy < g.ny; ++iy)
+        for (size_t ix = 0; ix < g.nx; ++ix) {
+            sc::geo_point p(g.x0 + ix*g.dx, g.y0 + iy*g.dy, 0.0);
+            env.temperature->push_back(gpts_t{p, pts_t(ta, 5.0, st::POINT_AVERAGE_VALUE)});
+            env.wind_speed->push_back(gpts_t{p, pts_t(ta, 1.0 + 0.0001*p.x, st::POINT_AVERAGE_VALUE)});
+        }
+    sc::interpolation_parameter ip;
+    ip.temperature_grid = sc::grid_remap::parameter(sc::grid_remap::remap_method::bilinear, g);// height adjusted with the default gradient
+    ip.wind_speed_grid = sc::grid_remap::parameter(sc::grid_remap::remap_method::bilinear, g);
+    FAST_CHECK_UNARY(m.run_interpolation(ip, ta, env));
+    for (auto const& c : *m.get_cells()) {
+        FAST_CHECK_EQ(c.env_ts.temperature.value(3), doctest::Approx(5.0 - 0.006*c.geo.mid_point().z));
+        FAST_CHECK_EQ(c.env_ts.wind_speed.value(3), doctest::Approx(1.0 + 0.0001*c.geo.mid_point().x));
+    }
+    ip.wind_speed_grid.grid.dx = 2000.0;// sources no longer on the grid nodes
+    FAST_CHECK_UNARY_FALSE(m.run_interpolation(ip, ta, env, true));
+}
+
+TEST_CASE("test_single_source_shared_env_ts") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 48);
+    typedef sc::geo_point_ts<pts_t> gpts_t;
+    typedef sc::region_environment<gpts_t, gpts_t, gpts_t, gpts_t, gpts_t> env_t;
+    auto r_cells = make_test_cells<pt_gs_k::cell_discharge_response_t>(6);
+    auto s_cells = make_test_cells<pt_gs_k::cell_discharge_response_shared_t>(6);
+    sc::region_model<pt_gs_k::cell_discharge_response_t, env_t> rm(r_cells, pt_gs_k::parameter_t());
+    sc::region_model<pt_gs_k::cell_discharge_response_shared_t, env_t> sm(s_cells, pt_gs_k::parameter_t());
+    env_t env;
+    pts_t t(ta, 0.0, st::POINT_AVERAGE_VALUE);
+    for (size_t i = 0; i < ta.size(); ++i) t.set(i, -2.0 + 0.2*i);
+    sc::geo_point p(500.0, 1000.0, 120.0);
+    env.temperature = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{p, t}});
+    env.precipitation = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{p, pts_t(ta, 1.0, st::POINT_AVERAGE_VALUE)}});
+    env.radiation = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{p, pts_t(ta, 150.0, st::POINT_AVERAGE_VALUE)}});
+    env.wind_speed = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{p, pts_t(ta, 2.0, st::POINT_AVERAGE_VALUE)}});
+    env.rel_hum = make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{p, pts_t(ta, 0.7, st::POINT_AVERAGE_VALUE)}});
+    sc::interpolation_parameter ip;
+    FAST_CHECK_UNARY(rm.run_interpolation(ip, ta, env));
+    FAST_CHECK_UNARY(sm.run_interpolation(ip, ta, env));
+    auto const& rc = *rm.get_cells();
+    auto const& sc_ = *sm.get_cells();
+    for (size_t j = 0; j < sc_.size(); ++j) {
+        FAST_CHECK_UNARY(sc_[j].env_ts.temperature.shares_values_with(sc_[0].env_ts.temperature));// one copy for all cells
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(sc_[j].env_ts.temperature.value(i), rc[j].env_ts.temperature.value(i));
+    }
+    rm.run_cells();
+    sm.run_cells();
+    for (size_t j = 0; j < sc_.size(); ++j)
+        FAST_CHECK_EQ(sc_[j].state, rc[j].state);
+    FAST_CHECK_LE(sm.memory_usage().env_ts + 5*ta.size()*sizeof(double), rm.memory_usage().env_ts);// the shared temperature is counted once
+}
+
+TEST_CASE("test_catchment_collector") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*5);
+    auto dm = make_test_region_model<pt_gs_k::cell_discharge_response_t>(150, ta);
+    auto cm = make_test_region_model<pt_gs_k::cell_catchment_response_t>(150, ta);
+    dm.run_cells();
+    cm.run_cells(0, 0, 0);
+    vector<pts_t> dq, cq, dc, cc;
+    dm.catchment_discharges(dq); cm.catchment_discharges(cq);
+    dm.catchment_charges(dc); cm.catchment_charges(cc);
+    FAST_REQUIRE_EQ(cq.size(), size_t(2));
+    FAST_REQUIRE_EQ(dq.size(), cq.size());
+    for (size_t k = 0; k < cq.size(); ++k) {
+        FAST_REQUIRE_EQ(cq[k].size(), ta.size());
+        for (size_t i = 0; i < ta.size(); ++i) {
+            FAST_CHECK_EQ(cq[k].value(i), doctest::Approx(dq[k].value(i)));
+            FAST_CHECK_EQ(cc[k].value(i), doctest::Approx(dc[k].value(i)));
+        }
+    }
+    SUBCASE("partial_run_and_filter") {
+        dm.run_cells(0, 24, 48);// re-run part of the period, the sums outside must remain
+        cm.run_cells_timestep_major(0, 24, 48);
+        dm.set_catchment_calculation_filter(vector<int>{1});
+        cm.set_catchment_calculation_filter(vector<int>{1});
+        dm.run_cells(0, 24, 48);
+        cm.run_cells(0, 24, 48);
+        dm.catchment_discharges(dq); cm.catchment_discharges(cq);
+        FAST_CHECK_EQ(cq[0].value(30), doctest::Approx(0.0));
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(cq[1].value(i), doctest::Approx(dq[1].value(i)));
+    }
+}
+TEST_CASE("test_adjust_state_to_target_flows") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*5);
+    auto rm = make_test_region_model<pt_gs_k::cell_discharge_response_t>(40, ta);
+    rm.run_cells();
+    rm.get_states(rm.initial_state);
+    vector<int> cids{0, 1};
+    vector<double> q_wanted{20.0, 5.0};
+    sc::adjust_state_model<decltype(rm)> a(rm, cids, 2);
+    vector<double> q_1 = a.discharges(vector<double>(2, 1.0), a.cell_slots());
+    FAST_CHECK_EQ(q_1[0] + q_1[1], doctest::Approx(a.discharge(1.0)));
+    auto s_0 = a.s0;
+    auto q = rm.adjust_state_to_target_flows(q_wanted, cids, 2);
+    FAST_REQUIRE_EQ(q.size(), cids.size());
+    for (size_t k = 0; k < cids.size(); ++k) {
+        FAST_CHECK_EQ(q[k], doctest::Approx(q_wanted[k]).epsilon(0.005));
+        // the same as tuning each catchment alone
+        auto rk = make_test_region_model<pt_gs_k::cell_discharge_response_t>(40, ta);
+        rk.set_states(s_0);
+        double qk = rk.adjust_state_to_target_flow(q_wanted[k], vector<int>{cids[k]}, 2);
+        FAST_CHECK_EQ(qk, doctest::Approx(q[k]).epsilon(0.005));
+    }
+    // the returned state gives the tuned flows
+    sc::adjust_state_model<decltype(rm)> b(rm, cids, 2);
+    auto q_check = b.discharges(vector<double>(2, 1.0), b.cell_slots());
+    for (size_t k = 0; k < cids.size(); ++k)
+        FAST_CHECK_EQ(q_check[k], doctest::Approx(q[k]));
+    CHECK_THROWS_AS(rm.adjust_state_to_target_flows(vector<double>{1.0}, cids, 2), std::runtime_error);
+}
+TEST_CASE("test_revert_to_initial_state_copies_changed_cells") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24);
+    auto rm = make_test_region_model<pt_gs_k::cell_discharge_response_t>(40, ta);
+    auto const& cells = *rm.get_cells();
+    rm.run_cells();// snaps the initial state, and changes all cells
+    FAST_CHECK_EQ(rm.n_changed_states(), cells.size());
+    auto check_reverted = [&]() {
+        rm.revert_to_initial_state();
+        FAST_CHECK_EQ(rm.n_changed_states(), 0u);
+        for (size_t i = 0; i < cells.size(); ++i)
+            FAST_CHECK_EQ(cells[i].state, rm.initial_state[i]);
+    };
+    check_reverted();
+    rm.set_catchment_calculation_filter(vector<int>{1});
+    rm.run_cells();
+    FAST_CHECK_EQ(rm.n_changed_states(), cells.size()/2);// only the calculated cells
+    check_reverted();
+    rm.set_catchment_calculation_filter(vector<int>{});
+    vector<int> cids{0};
+    rm.adjust_q(2.0, cids);
+    FAST_CHECK_EQ(rm.n_changed_states(), cells.size()/2);
+    check_reverted();
+    (*rm.get_cells())[3].state.kirchner.q = 7.0;
+    rm.mark_state_changed(3);
+    FAST_CHECK_EQ(rm.n_changed_states(), 1u);
+    check_reverted();
+    vector<pt_gs_k::state_t> s;
+    rm.get_states(s);
+    rm.set_states(s);// any other change, and all states are copied
+    FAST_CHECK_EQ(rm.n_changed_states(), cells.size());
+    check_reverted();
+}
+TEST_CASE("test_float_storage_cells") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 24*5);
+    auto dm = make_test_region_model(20, ta);
+    auto fm = make_test_region_model<pt_gs_k::cell_complete_response_f32_t>(20, ta);
+    FAST_CHECK_EQ(sizeof((*fm.get_cells())[0].env_ts.temperature.v[0]), sizeof(float));
+    dm.run_cells();
+    fm.run_cells_timestep_major();
+    vector<pts_t> dq, fq;
+    dm.catchment_discharges(dq);
+    fm.catchment_discharges(fq);
+    FAST_REQUIRE_EQ(fq.size(), dq.size());
+    for (size_t k = 0; k < fq.size(); ++k)
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(fq[k].value(i), doctest::Approx(dq[k].value(i)).epsilon(1e-4));
+    auto const& fc = (*fm.get_cells())[3];
+    auto const& dc = (*dm.get_cells())[3];
+    FAST_CHECK_EQ(fc.state.kirchner.q, doctest::Approx(dc.state.kirchner.q).epsilon(1e-4));
+    FAST_CHECK_EQ(fc.rc.snow_swe.value(50), doctest::Approx(dc.rc.snow_swe.value(50)).epsilon(1e-4));
+    auto du = dm.memory_usage();
+    auto fu = fm.memory_usage();
+    FAST_CHECK_GE(du.env_ts, 20*5*ta.size()*sizeof(double));
+    FAST_CHECK_EQ(du.env_ts, 2*fu.env_ts);
+    FAST_CHECK_EQ(du.response_collectors, 2*fu.response_collectors);
+    FAST_CHECK_GE(du.response_collectors, 20*8*ta.size()*sizeof(double));
+    FAST_CHECK_EQ(du.cells, dm.get_cells()->capacity()*sizeof(dc) + dm.get_geo_cell_table().heap_bytes());
+    FAST_CHECK_EQ(du.total(), du.cells + du.env_ts + du.response_collectors + du.state_collectors + du.states + du.interpolation_caches + du.routing_caches);
+}
+TEST_CASE("test_run_ensemble") {
+    sc::calendar cal;
+    ta_t ta(cal.time(2016, 1, 1), sc::deltahours(1), 48);
+    typedef sc::geo_point_ts<pts_t> gpts_t;
+    typedef sc::region_environment<gpts_t, gpts_t, gpts_t, gpts_t, gpts_t> env_t;
+    auto cells = make_test_cells<pt_gs_k::cell_discharge_response_t>(12);
+    sc::region_model<pt_gs_k::cell_discharge_response_t, env_t> m(cells, pt_gs_k::parameter_t());
+    m.initialize_cell_environment(ta);
+    auto src = [&ta](double v, st::ts_point_fx fx) {
+        return make_shared<vector<gpts_t>>(vector<gpts_t>{gpts_t{sc::geo_point(0.0, 0.0, 100.0), pts_t(ta, v, fx)}});
+    };
+    vector<env_t> members;
+    for (size_t k = 0; k < 5; ++k) {
+        env_t e;
+        e.temperature = src(-2.0 + 2.0*k, st::POINT_INSTANT_VALUE);
+        e.precipitation = src(0.5*k, st::POINT_AVERAGE_VALUE);
+        e.radiation = src(100.0, st::POINT_AVERAGE_VALUE);
+        e.wind_speed = src(2.0, st::POINT_INSTANT_VALUE);
+        e.rel_hum = src(0.7, st::POINT_INSTANT_VALUE);
+        members.push_back(e);
+    }
+    vector<pt_gs_k::state_t> s0;
+    m.get_states(s0);
+    sc::interpolation_parameter ip;
+    auto r = m.run_ensemble(ip, members, s0, 3);
+    FAST_REQUIRE_EQ(r.size(), members.size());
+    vector<pt_gs_k::state_t> s_after;
+    m.get_states(s_after);
+    FAST_CHECK_EQ(s_after[0], s0[0]);// the model itself is not touched
+    for (size_t k = 0; k < members.size(); ++k) {
+        m.set_states(s0);
+        m.run_interpolation(ip, ta, members[k]);
+        m.run_cells();
+        vector<pts_t> q;
+        m.catchment_discharges(q);
+        FAST_REQUIRE_EQ(r[k].size(), q.size());
+        for (size_t c = 0; c < q.size(); ++c)
+            for (size_t i = 0; i + 1 < ta.size(); ++i)// last step is nan due to instant value sources
+                FAST_CHECK_EQ(r[k][c].value(i), doctest::Approx(q[c].value(i)));
+    }
+    FAST_CHECK_GT(r[4][0].value(40), r[0][0].value(40));
+    CHECK_THROWS_AS(m.run_ensemble(ip, members, vector<pt_gs_k::state_t>()), runtime_error);
+}
+}
@@ -4,6 +4,7 @@
 #include "core/geo_cell_data.h"
 #include "core/routing.h"
 #include "core/time_series_dd.h"
+#include <functional>
 
 namespace shyft {
     namespace core {
@@ -94,6 +95,20 @@ TEST_CASE("test_build_valid_river_network") {
 
 
 
+TEST_CASE("test_uhg_cache") {
+    using namespace shyft::core;
+    routing::uhg_cache c(3);
+    auto a = c.get(10, 3.0, 0.0);
+    FAST_CHECK_EQ(*a, routing::make_uhg_from_gamma(10, 3.0, 0.0));
+    FAST_CHECK_EQ(a.get(), c.get(10, 3.0, 0.0).get());// computed once
+    FAST_CHECK_NE(a.get(), c.get(10, 3.5, 0.0).get());
+    c.get(12, 3.0, 0.0);
+    FAST_CHECK_EQ(c.size(), 3u);
+    c.get(1, 3.0, 0.0);// exceeds the capacity, and starts over
+    FAST_CHECK_EQ(c.size(), 1u);
+    FAST_CHECK_EQ(*a, routing::make_uhg_from_gamma(10, 3.0, 0.0));// still valid, shared with the caller
+}
+
 TEST_CASE("test_routing_model") {
     using namespace shyft::core;
     using ta_t = shyft::time_axis::fixed_dt;
@@ -171,5 +186,216 @@ TEST_CASE("test_routing_model") {
     //    TS_ASSERT_DELTA(observation_m3s.value(i),expected_m3s[i],0.001);
 
 
+}
+TEST_CASE("test_routing_model_evaluate") {
+    using namespace shyft::core;
+    using ta_t = shyft::time_axis::fixed_dt;
+    using ts_t = shyft::time_series::point_ts<ta_t>;
+    using cell_t = routing::cell_node<ts_t>;
+    calendar utc;
+    ta_t ta(utc.time(2016, 1, 1), deltahours(1), 48);
+    // a binary tree of rivers, 1 is the outlet, river i routes to i/2, and every river has a local cell
+    const int n_rivers = 15;
+    routing::model<cell_t> m;
+    m.ta = ta;
+    m.rivers = std::make_shared<routing::river_network>();
+    m.cells = std::make_shared<std::vector<cell_t>>();
+    for (int rid = 1; rid <= n_rivers; ++rid) {
+        m.rivers->add(routing::river{rid, routing_info(rid/2, 3600.0*(rid % 3)), routing::uhg_parameter(1.0)});
+        cell_t c;
+        c.geo.routing.id = rid;
+        c.geo.routing.distance = 10000;
+        c.parameter = std::make_shared<routing::cell_parameter>();
+        c.parameter->routing.velocity = c.geo.routing.distance/((2 + rid % 5)*3600.0);
+        c.rc.avg_discharge = ts_t(ta, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+        c.rc.avg_discharge.set(rid % 7, 1.0*rid);
+        m.cells->push_back(c);
+    }
+    auto order = m.rivers->topological_order();
+    FAST_REQUIRE_EQ(order.size(), size_t(n_rivers));
+    std::vector<size_t> pos(n_rivers + 1);
+    for (size_t i = 0; i < order.size(); ++i) pos[order[i]] = i;
+    for (int rid = 2; rid <= n_rivers; ++rid)
+        FAST_CHECK_LT(pos[rid], pos[rid/2]);// upstream before downstream
+
+    auto levels = m.rivers->topological_levels();
+    FAST_REQUIRE_EQ(levels.size(), 4u);// 8..15, 4..7, 2..3, 1
+    FAST_CHECK_EQ(levels[0].size(), 8u);
+    FAST_CHECK_EQ(levels[3], std::vector<int>{1});
+    for (size_t l = 1; l < levels.size(); ++l)
+        for (auto rid : levels[l])
+            for (auto u : m.rivers->upstreams_by_id(rid))
+                FAST_CHECK_LT(pos[u], pos[rid]);
+
+    // the recursive definition, each river computed on demand
+    std::function<ts_t(int)> output_m3s = [&](int rid) {
+        ts_t sum(ta, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+        for (const auto& c : *m.cells)
+            if (c.geo.routing.id == rid) {
+                auto o = m.cell_output_m3s(c);
+                for (size_t t = 0; t < ta.size(); ++t) sum.add(t, o.value(t));
+            }
+        for (auto u : m.rivers->upstreams_by_id(rid)) {
+            auto o = output_m3s(u);
+            for (size_t t = 0; t < ta.size(); ++t) sum.add(t, o.value(t));
+        }
+        auto r = shyft::time_series::convolve_w_ts<ts_t>(sum, m.rivers->river_by_id(rid).uhg(ta.delta()), shyft::time_series::convolve_policy::USE_ZERO);
+        return ts_t(ta, routing::ts_values(r), shyft::time_series::POINT_AVERAGE_VALUE);
+    };
+    auto f = m.evaluate();
+    for (int rid = 1; rid <= n_rivers; ++rid) {
+        auto expected = output_m3s(rid);
+        const auto& o = f->output_m3s.find(rid)->second;
+        for (size_t t = 0; t < ta.size(); ++t)
+            TS_ASSERT_DELTA(o.value(t), expected.value(t), 1e-9);
+    }
+    // routed in parallel on the pool, the rivers of each level are independent, so the result is identical
+    auto fp = m.evaluate(std::make_shared<work_stealing_pool>(3));
+    for (int rid = 1; rid <= n_rivers; ++rid) {
+        FAST_CHECK_EQ(fp->output_m3s.find(rid)->second.v, f->output_m3s.find(rid)->second.v);
+        FAST_CHECK_EQ(fp->local_inflow.find(rid)->second.v, f->local_inflow.find(rid)->second.v);
+    }
+    // with a uhg cache, the cells and rivers with the same uhg share one weight vector
+    routing::model<cell_t> mc(m);
+    mc.uhgs = std::make_shared<routing::uhg_cache>();
+    auto fc = mc.evaluate();
+    for (int rid = 1; rid <= n_rivers; ++rid)
+        FAST_CHECK_EQ(fc->output_m3s.find(rid)->second.v, f->output_m3s.find(rid)->second.v);
+    FAST_CHECK_LE(mc.uhgs->size(), 5u + 3u);// at most 5 cell and 3 river delays
+    const auto n_uhgs = mc.uhgs->size();
+    mc.evaluate();
+    FAST_CHECK_EQ(mc.uhgs->size(), n_uhgs);
+    // all water ends up at the outlet, as long as the delays are within the time-axis
+    double sum_in = 0.0, sum_out = 0.0;
+    for (const auto& c : *m.cells) for (size_t t = 0; t < ta.size(); ++t) sum_in += c.rc.avg_discharge.value(t);
+    for (size_t t = 0; t < ta.size(); ++t) sum_out += m.output_m3s(1).value(t);
+    TS_ASSERT_DELTA(sum_out, sum_in, 1e-6*sum_in);
+    // the queries are served from the memo, until the network or the cell routes changes
+    TS_ASSERT(m.is_current(*f));
+    m.output_m3s(1);
+    auto memo = m.memo;
+    m.upstream_inflow(2);
+    FAST_CHECK_EQ(memo.get(), m.memo.get());
+    m.rivers->river_by_id(4).parameter.velocity = 0.5;
+    TS_ASSERT(!m.is_current(*memo));
+    auto slower = output_m3s(2);
+    for (size_t t = 0; t < ta.size(); ++t)
+        TS_ASSERT_DELTA(m.output_m3s(2).value(t), slower.value(t), 1e-9);
+    FAST_CHECK_NE(memo.get(), m.memo.get());
+    (*m.cells)[3].geo.routing.id = 5;
+    TS_ASSERT(!m.is_current(*m.memo));
+    // a river without a local cell has zero local inflow
+    auto l4 = m.local_inflow(4);
+    for (size_t t = 0; t < ta.size(); ++t) FAST_CHECK_EQ(l4.value(t), 0.0);
+    CHECK_THROWS_AS(m.output_m3s(n_rivers + 1), std::runtime_error);
+}
+TEST_CASE("test_routing_cell_index") {
+    using namespace shyft::core;
+    using ta_t = shyft::time_axis::fixed_dt;
+    using ts_t = shyft::time_series::point_ts<ta_t>;
+    using cell_t = routing::cell_node<ts_t>;
+    calendar utc;
+    ta_t ta(utc.time(2016, 1, 1), deltahours(1), 36);
+    routing::model<cell_t> m;
+    m.ta = ta;
+    m.rivers = std::make_shared<routing::river_network>();
+    m.rivers->add(routing::river{1, routing_info(0), routing::uhg_parameter(1.0)});
+    m.cells = std::make_shared<std::vector<cell_t>>();
+    auto slow = std::make_shared<routing::cell_parameter>();
+    slow->routing.velocity = 10000/(10*3600.0);
+    auto fast = std::make_shared<routing::cell_parameter>();
+    fast->routing.velocity = 10000/(3*3600.0);
+    for (size_t i = 0; i < 7; ++i) {
+        cell_t c;
+        c.geo.routing.id = i == 6 ? 2 : 1;// the last one routes to a river that is not in the network
+        c.geo.routing.distance = 10000;
+        c.parameter = i % 3 == 0 ? fast : slow;
+        c.rc.avg_discharge = ts_t(ta, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+        c.rc.avg_discharge.set(i, 1.0 + i);
+        m.cells->push_back(c);
+    }
+    auto ix = m.cell_index();
+    FAST_REQUIRE_EQ(ix.size(), 1u);
+    const auto& groups = ix.find(1)->second;
+    FAST_REQUIRE_EQ(groups.size(), 2u);
+    FAST_CHECK_EQ(groups[0].cell_ix, std::vector<size_t>{0, 3});
+    FAST_CHECK_EQ(groups[1].cell_ix, std::vector<size_t>{1, 2, 4, 5});
+    // the grouped convolution equals the sum of the cell outputs
+    auto l = m.local_inflow(1);
+    for (size_t t = 0; t < ta.size(); ++t) {
+        double expected = 0.0;
+        for (size_t i = 0; i < 6; ++i) expected += m.cell_output_m3s((*m.cells)[i]).value(t);
+        TS_ASSERT_DELTA(l.value(t), expected, 1e-12);
+    }
+}
+TEST_CASE("test_routing_state") {
+    using namespace shyft::core;
+    using ta_t = shyft::time_axis::fixed_dt;
+    using ts_t = shyft::time_series::point_ts<ta_t>;
+    using cell_t = routing::cell_node<ts_t>;
+    calendar utc;
+    const size_t n = 60, n0 = 25;
+    ta_t ta(utc.time(2016, 1, 1), deltahours(1), n);
+    // two rivers into an outlet, with delays longer than the continued steps below
+    routing::model<cell_t> m;
+    m.ta = ta;
+    m.rivers = std::make_shared<routing::river_network>();
+    m.rivers->add(routing::river{1, routing_info(0), routing::uhg_parameter(1.0)});
+    m.rivers->add(routing::river{2, routing_info(1, 3600.0*8), routing::uhg_parameter(1.0)});
+    m.rivers->add(routing::river{3, routing_info(1, 3600.0*3), routing::uhg_parameter(1.0)});
+    m.cells = std::make_shared<std::vector<cell_t>>();
+    for (int i = 0; i < 6; ++i) {
+        cell_t c;
+        c.geo.routing.id = 1 + i % 3;
+        c.geo.routing.distance = 10000;
+        c.parameter = std::make_shared<routing::cell_parameter>();
+        c.parameter->routing.velocity = c.geo.routing.distance/((4 + 3*i)*3600.0);
+        c.rc.avg_discharge = ts_t(ta, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+        for (size_t t = 0; t < n; ++t) c.rc.avg_discharge.set(t, 1.0 + ((t*(i + 3)) % 5));
+        m.cells->push_back(c);
+    }
+    auto f = m.evaluate();
+    auto check_from = [&](const routing::model<cell_t>::flows& g, size_t i0) {
+        for (int rid = 1; rid <= 3; ++rid) {
+            for (size_t t = i0; t < n; ++t) {
+                TS_ASSERT_DELTA(g.output_m3s.find(rid)->second.value(t), f->output_m3s.find(rid)->second.value(t), 1e-9);
+                TS_ASSERT_DELTA(g.local_inflow.find(rid)->second.value(t), f->local_inflow.find(rid)->second.value(t), 1e-9);
+                TS_ASSERT_DELTA(g.upstream_inflow.find(rid)->second.value(t), f->upstream_inflow.find(rid)->second.value(t), 1e-9);
+            }
+        }
+    };
+    // route the first n0 steps, then continue from the state
+    routing::model<cell_t> m0(m);
+    m0.ta = ta_t(ta.time(0), ta.delta(), n0);
+    routing::state s;
+    m0.evaluate_from(nullptr, 0, s);
+    FAST_CHECK_EQ(s.t, ta.time(n0));
+    FAST_CHECK_EQ(s.dt, ta.delta());
+    FAST_CHECK_EQ(s.output_tail.size(), 3u);
+    FAST_CHECK_GT(s.local_tail.find(3)->second.size(), 10u);
+    auto s0 = s;
+    auto g = m.evaluate_from(nullptr, n0, s);
+    check_from(*g, n0);
+    TS_ASSERT(std::isnan(g->output_m3s.find(1)->second.value(n0 - 1)));// no prior flows
+    FAST_CHECK_EQ(s.t, ta.total_period().end);
+    // the values before n0 are taken from prior flows, when given
+    auto s1 = s0;
+    auto gp = m.evaluate_from(nullptr, n0, s1, f.get());
+    for (size_t t = 0; t < n0; ++t)
+        FAST_CHECK_EQ(gp->output_m3s.find(1)->second.value(t), f->output_m3s.find(1)->second.value(t));
+    FAST_CHECK_EQ(s1, s);
+    // continued one step at the time, the tails reach beyond each step
+    routing::state s2 = s0;
+    routing::model<cell_t> mi(m);
+    for (size_t i = n0; i < n; ++i) {
+        mi.ta = ta_t(ta.time(0), ta.delta(), i + 1);
+        auto gi = mi.evaluate_from(nullptr, i, s2);
+        for (int rid = 1; rid <= 3; ++rid)
+            TS_ASSERT_DELTA(gi->output_m3s.find(rid)->second.value(i), f->output_m3s.find(rid)->second.value(i), 1e-9);
+    }
+    FAST_CHECK_EQ(s2.t, ta.total_period().end);
+    // a state that does not match the start_step is rejected
+    auto bad = s0;
+    CHECK_THROWS_AS(m.evaluate_from(nullptr, n0 + 1, bad), std::runtime_error);
 }
 }
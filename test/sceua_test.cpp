@@ -26,6 +26,26 @@ struct fx_complex:public ifx {
         return y;
     }
 };
+/** fx_complex, evaluated in batches of up to n_concurrent */
+struct fx_complex_batch:public fx_complex {
+    size_t n_concurrent=3;
+    size_t max_batch=0;
+    size_t concurrency() const override { return n_concurrent; }
+    void evaluate_batch(const vector<vector<double>>& xs, vector<double>& fxs) override {
+        if(n_eval>0) max_batch=std::max(max_batch,xs.size());// skip the initial population
+        fx_complex::evaluate_batch(xs,fxs);
+    }
+};
+/** fx_complex, recording the evaluated points */
+struct fx_complex_recorder:public fx_complex {
+    warm_start trace;
+    double evaluate(const vector<double>& xv) {
+        double y=fx_complex::evaluate(xv);
+        trace.x.push_back(xv);
+        trace.fx.push_back(y);
+        return y;
+    }
+};
 TEST_SUITE("sceua") {
 TEST_CASE("test_basic") {
     sceua opt;
@@ -79,4 +99,58 @@ TEST_CASE("test_complex") {
         cout<<endl<<"2. approximate Found solution x{"<<x[0]<<","<<x[1]<<"}(r="<<rr <<") -> "<<y<<endl<<"\t n_iterations:"<<f_complex.n_eval<<endl;
     }
 }
+TEST_CASE("test_complex_batch") {
+    sceua opt;
+    const size_t n=2;
+    double x[2]={-4.01, -7.5};
+    double x_min[2]= {-10,-10};
+    double x_max[2]= { 10, 10.0};
+    const double eps=1e-5;
+    double x_eps[2]= {eps,eps};
+    double y=-1;
+    fx_complex_batch f;
+    auto r=opt.find_min(n,x_min,x_max,x,y,f,1e-3, -1,-2,x_eps,150000);
+    TS_ASSERT_EQUALS(r,OptimizerState::FinishedFxConvergence);
+    TS_ASSERT_DELTA(y,0.7028,1e-3);
+    TS_ASSERT_DELTA(sqrt(x[0]*x[0]+x[1]*x[1]),2.5,1e-2);
+    TS_ASSERT_EQUALS(f.max_batch,f.n_concurrent);// the complexes are evolved 3 at the time
+}
+TEST_CASE("test_warm_start") {
+    sceua opt;
+    const size_t n=2;
+    double x_min[2]= {-10,-10};
+    double x_max[2]= { 10, 10.0};
+    const double eps=1e-5;
+    double x_eps[2]= {eps,eps};
+    double y=-1;
+    fx_complex_recorder f;
+    double x[2]={-4.01, -7.5};
+    auto r=opt.find_min(n,x_min,x_max,x,y,f,1e-3, -1,-2,x_eps,150000);
+    TS_ASSERT_EQUALS(r,OptimizerState::FinishedFxConvergence);
+    const size_t n_cold=f.n_eval;
+    // seeded with the trace of the first search, reusing the known values
+    warm_start seed=f.trace;
+    seed.reuse_fx=true;
+    auto picked=seed.pick(n,5*(2*n+1)/2,false,x_min,x_max,vector<vector<double>>{});
+    TS_ASSERT_EQUALS(picked.size(),size_t(5*(2*n+1)/2));
+    TS_ASSERT_DELTA(seed.fx[picked[0]],y,1e-12);// the best first
+    for(size_t k=1;k<picked.size();++k)
+        TS_ASSERT(seed.fx[picked[k-1]]<=seed.fx[picked[k]]);
+    fx_complex_recorder g;
+    x[0]=-4.01;x[1]=-7.5;
+    double y_warm=-1;
+    r=opt.find_min(n,x_min,x_max,x,y_warm,g,1e-3, -1,-2,x_eps,150000,&seed);
+    TS_ASSERT_EQUALS(r,OptimizerState::FinishedFxConvergence);
+    TS_ASSERT_DELTA(y_warm,0.7028,1e-3);
+    TS_ASSERT_DELTA(sqrt(x[0]*x[0]+x[1]*x[1]),2.5,1e-2);
+    TS_ASSERT_LESS_THAN(g.n_eval,n_cold);
+    for(auto k:picked)// the reused points are not evaluated again
+        for(const auto& xe:g.trace.x)
+            TS_ASSERT(!(xe==seed.x[k]));
+    // points of wrong dimension are skipped, and duplicates are picked once
+    warm_start bad;
+    bad.x={{1.0},{1.0,2.0},{1.0,2.0},{1.0,2.0,3.0}};
+    TS_ASSERT_EQUALS(bad.pick(n,10,false,x_min,x_max,vector<vector<double>>{}).size(),size_t(1));
+    TS_ASSERT_EQUALS(bad.pick(n,10,false,x_min,x_max,vector<vector<double>>{{1.0,2.0}}).size(),size_t(0));
+}
 }
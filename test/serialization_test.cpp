@@ -1,6 +1,8 @@
 #include "test_pch.h"
 #include "core/expression_serialization.h"
+#include "core/expression_simplify.h"
 #include "core/core_archive.h"
+#include "core/routing.h"
 
 using namespace std;
 using namespace shyft;
@@ -99,6 +101,10 @@ TEST_CASE("test_serialization") {
     TS_ASSERT_EQUALS(ta.dt,ta2.dt);
     TS_ASSERT_EQUALS(ta.n,ta2.n);
 
+    time_axis::fixed_dt_us ta_us(to_utctime_us(ta.t)+deltamilliseconds(1),deltamilliseconds(100),24);
+    auto ta_us2 = serialize_loop(ta_us);
+    TS_ASSERT_EQUALS(ta_us,ta_us2);
+
     time_axis::calendar_dt tac(osl,osl->time(2016,7,1),deltahours(1),24);
 
     auto tac2 = serialize_loop(tac);
@@ -621,6 +627,191 @@ TEST_CASE("study_apoint_ts_expression_speed") {
 		}
 	}
 }
+TEST_CASE("test_rle_ts_serialization") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),240);
+    vector<double> v(ta.size(),1.0);
+    for (size_t i = 50; i < 120; ++i) v[i] = shyft::nan;
+    for (size_t i = 120; i < ta.size(); ++i) v[i] = 3.0;
+    apoint_ts a(ta,v,time_series::POINT_AVERAGE_VALUE);
+    auto r = a.run_length_encoded();
+    FAST_REQUIRE_UNARY(dynamic_pointer_cast<grle_ts>(r.ts) != nullptr);
+    FAST_CHECK_EQ(dynamic_pointer_cast<grle_ts>(r.ts)->core_ts().n_runs(), 3u);
+    auto r2 = serialize_loop(r);
+    FAST_REQUIRE_UNARY(dynamic_pointer_cast<grle_ts>(r2.ts) != nullptr);
+    FAST_CHECK_EQ(r2.values().size(), a.size());
+    for (size_t i = 0; i < a.size(); ++i)
+        FAST_CHECK_UNARY((std::isfinite(a.value(i)) ? r2.value(i) == a.value(i) : !std::isfinite(r2.value(i))));
+    // in expressions it is transferred as a dense gpoint_ts
+    vector<apoint_ts> e{ r*2.0 + a };
+    auto ce = serialize_loop(expression_compressor::compress(e));
+    auto e2 = expression_decompressor::decompress(ce);
+    FAST_REQUIRE_EQ(e2.size(), 1u);
+    for (size_t i = 0; i < a.size(); ++i)
+        FAST_CHECK_UNARY((std::isfinite(e[0].value(i)) ? e2[0].value(i) == e[0].value(i) : !std::isfinite(e2[0].value(i))));
+}
+TEST_CASE("test_sum_ts_serialization") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),48);
+    ats_vector tsv;
+    for (size_t i = 0; i < 130; ++i)
+        tsv.push_back(apoint_ts(ta, double(i), time_series::POINT_AVERAGE_VALUE)*1.5);
+    auto s = tsv.sum(true);
+    auto s2 = serialize_loop(s);
+    FAST_REQUIRE_UNARY(dynamic_pointer_cast<sum_ts>(s2.ts) != nullptr);
+    FAST_CHECK_UNARY(dynamic_pointer_cast<sum_ts>(s2.ts)->compensated);
+    FAST_CHECK_EQ(s2.values(), s.values());
+    // as expression, with an unbound reference, as sent to the dtss
+    apoint_ts r("shyft://a");
+    vector<apoint_ts> e{ sum(vector<apoint_ts>{ r, tsv[0], r*2.0 }) };
+    auto ce = serialize_loop(expression_compressor::compress(e));
+    auto e2 = expression_decompressor::decompress(ce);
+    FAST_REQUIRE_EQ(e2.size(), 1u);
+    auto bi = e2[0].find_ts_bind_info();
+    FAST_REQUIRE_EQ(bi.size(), 2u);
+    FAST_CHECK_EQ(bi[0].reference, string("shyft://a"));
+    bi[0].ts.bind(apoint_ts(ta, 2.0, time_series::POINT_AVERAGE_VALUE));
+    e2[0].do_bind();
+    FAST_CHECK_EQ(e2[0].value(3), doctest::Approx(2.0 + 0.0 + 4.0));
+}
+TEST_CASE("test_expression_cse") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),48);
+    gta_t ta24(utc.time(2016,1,1),deltahours(24),2);
+    vector<double> v(ta.size());
+    for (size_t i = 0; i < v.size(); ++i) v[i] = double(i);
+    apoint_ts a(ta,v,time_series::POINT_AVERAGE_VALUE);
+    apoint_ts bts(ta,2.0,time_series::POINT_AVERAGE_VALUE);
+    apoint_ts r1("shyft://x"), r2("shyft://x");// equal id, different objects
+    vector<apoint_ts> e{
+        r1.average(ta24)*2.0,
+        r2.average(ta24) + a,// average(shyft://x,ta24) is shared
+        (a + 1.0).average(ta24),// no shared nodes, kept as is
+        r2.average(ta24)*2.0,// equal to e[0]
+        r1.average(ta)// different time-axis
+    };
+    for (auto& ats : e) {
+        for (auto& bi : ats.find_ts_bind_info())
+            bi.ts.bind(bts);
+        ats.do_bind();
+    }
+    size_t n_shared = 0;
+    auto r = expression_cse::eliminate(e, &n_shared);
+    FAST_REQUIRE_EQ(r.size(), e.size());
+    FAST_CHECK_EQ(n_shared, 2u);// the average, and the e[0]/e[3] expression
+    FAST_CHECK_UNARY(dynamic_pointer_cast<gpoint_ts>(r[0].ts) != nullptr);
+    FAST_CHECK_EQ(r[0].ts, r[3].ts);
+    auto b1 = dynamic_pointer_cast<abin_op_ts>(r[1].ts);
+    FAST_REQUIRE_UNARY(b1 != nullptr);
+    FAST_CHECK_UNARY(dynamic_pointer_cast<gpoint_ts>(b1->lhs.ts) != nullptr);
+    FAST_CHECK_EQ(b1->rhs.ts, a.ts);// terminals are kept
+    FAST_CHECK_EQ(r[2].ts, e[2].ts);
+    FAST_CHECK_EQ(r[4].ts, e[4].ts);
+    for (size_t i = 0; i < e.size(); ++i)
+        FAST_CHECK_UNARY(is_equal(r[i], e[i]));
+}
+TEST_CASE("test_expression_simplify") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),48);
+    gta_t ta24(utc.time(2016,1,1),deltahours(24),2);
+    vector<double> v(ta.size());
+    for (size_t i = 0; i < v.size(); ++i) v[i] = i % 5 == 0 ? shyft::nan : double(i) - 20.0;
+    apoint_ts a(ta,v,time_series::POINT_AVERAGE_VALUE);
+    auto shared = a.abs().abs();
+    vector<apoint_ts> e{
+        a.time_shift(deltahours(2)).time_shift(deltahours(3)),
+        a.time_shift(deltahours(2)).time_shift(-deltahours(2)),
+        shared,
+        a.average(ta24).average(ta24),
+        ((a + 1.0) - 3.0) + 0.5,
+        ((a*2.0)/4.0)*3.0,
+        a*1.0,
+        0.0 + a,
+        shared + a.average(ta).average(ta24)// different time-axis, kept
+    };
+    vector<vector<double>> expected;
+    for (const auto& x : e) expected.push_back(x.values());
+    const auto n = expression_simplifier::simplify(e);
+    FAST_CHECK_GE(n, 8u);
+    auto ts0 = dynamic_pointer_cast<time_shift_ts>(e[0].ts);
+    FAST_REQUIRE_UNARY(ts0 != nullptr);
+    FAST_CHECK_EQ(ts0->dt, deltahours(5));
+    FAST_CHECK_EQ(ts0->ts, a.ts);
+    FAST_CHECK_EQ(e[1].ts, a.ts);
+    FAST_CHECK_EQ(dynamic_pointer_cast<abs_ts>(e[2].ts)->ts, a.ts);
+    FAST_CHECK_EQ(dynamic_pointer_cast<average_ts>(e[3].ts)->ts, a.ts);
+    auto s4 = dynamic_pointer_cast<abin_op_ts_scalar>(e[4].ts);
+    FAST_REQUIRE_UNARY(s4 != nullptr);
+    FAST_CHECK_EQ(s4->lhs.ts, a.ts);
+    FAST_CHECK_EQ(s4->rhs, doctest::Approx(-1.5));
+    auto s5 = dynamic_pointer_cast<abin_op_ts_scalar>(e[5].ts);
+    FAST_REQUIRE_UNARY(s5 != nullptr);
+    FAST_CHECK_EQ(s5->lhs.ts, a.ts);
+    FAST_CHECK_EQ(s5->rhs, doctest::Approx(1.5));
+    FAST_CHECK_EQ(e[6].ts, a.ts);
+    FAST_CHECK_EQ(e[7].ts, a.ts);
+    auto b8 = dynamic_pointer_cast<abin_op_ts>(e[8].ts);
+    FAST_REQUIRE_UNARY(b8 != nullptr);
+    FAST_CHECK_EQ(b8->lhs.ts, e[2].ts);// still shared
+    FAST_CHECK_UNARY(dynamic_pointer_cast<average_ts>(dynamic_pointer_cast<average_ts>(b8->rhs.ts)->ts) != nullptr);
+    for (size_t k = 0; k < e.size(); ++k) {
+        auto r = e[k].values();
+        FAST_REQUIRE_EQ(r.size(), expected[k].size());
+        for (size_t i = 0; i < r.size(); ++i) {
+            if (std::isfinite(expected[k][i]))
+                FAST_CHECK_EQ(r[i], doctest::Approx(expected[k][i]));
+            else
+                FAST_CHECK_UNARY(!std::isfinite(r[i]));
+        }
+    }
+    FAST_CHECK_EQ(e[0].time(0), a.time(0) + deltahours(5));
+}
+TEST_CASE("test_expression_compress_shared") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),48);
+    gta_t ta24(utc.time(2016,1,1),deltahours(24),2);
+    vector<apoint_ts> e;
+    for (size_t i = 0; i < 100; ++i)// each built separately, as a planner would
+        e.push_back(apoint_ts("shyft://x").average(ta24)*double(i%10) + apoint_ts("shyft://y/" + std::to_string(i%10)));
+    auto blob = [](const compressed_ts_expression& c) {
+        stringstream ss;
+        core_oarchive oa(ss, core_arch_flags);
+        oa << core_nvp("c", c);
+        return ss.str().size();
+    };
+    auto c = expression_compressor::compress(e);
+    auto cs = expression_compressor::compress_shared(e);
+    FAST_CHECK_EQ(cs.rts.size(), 11u);// shyft://x, and the ten shyft://y/..
+    FAST_CHECK_EQ(std::get<vector<srep::saverage_ts>>(cs.ts_reps).size(), 1u);
+    FAST_CHECK_EQ(std::get<vector<srep::saverage_ts>>(c.ts_reps).size(), e.size());
+    FAST_CHECK_LT(5*blob(cs), blob(c));
+    auto cs2 = serialize_loop(cs);
+    auto r = expression_decompressor::decompress(cs2);
+    FAST_REQUIRE_EQ(r.size(), e.size());
+    vector<double> v(ta.size());
+    for (size_t i = 0; i < v.size(); ++i) v[i] = double(i);
+    apoint_ts a(ta, v, time_series::POINT_AVERAGE_VALUE);
+    auto bind_all = [&a](vector<apoint_ts>& x) {
+        for (auto& ats : x) {
+            for (auto& bi : ats.find_ts_bind_info())
+                if (bi.ts.needs_bind()) bi.ts.bind(a);
+            ats.do_bind();
+        }
+    };
+    bind_all(e);
+    bind_all(r);
+    for (size_t i = 0; i < e.size(); ++i)
+        FAST_CHECK_UNARY(is_equal(r[i], e[i]));
+    // bound refs, with the same id, are kept apart
+    apoint_ts b1("shyft://z", a), b2("shyft://z", a*2.0);
+    auto cb = expression_compressor::compress_shared(vector<apoint_ts>{ b1, b2 });
+    FAST_CHECK_EQ(cb.rts.size(), 2u);
+}
 TEST_CASE("test_tuple_serialization") {
     using namespace shyft::time_series::dd;
 	compressed_ts_expression xtra;
@@ -632,4 +823,49 @@ TEST_CASE("test_tuple_serialization") {
     FAST_CHECK_EQ(std::get<0>(xtra.ts_reps)[0], std::get<0>(xtra2.ts_reps)[0]);
 }
 
+TEST_CASE("test_routing_state_serialization") {
+    calendar utc;
+    routing::state s;
+    s.t = utc.time(2016, 1, 1);
+    s.dt = deltahours(1);
+    s.local_tail[1] = vector<double>{0.5, 0.25};
+    s.local_tail[2] = vector<double>{};
+    s.output_tail[1] = vector<double>{1.0, 2.0, 3.0};
+    s.output_tail[2] = vector<double>{4.0};
+    auto s2 = serialize_loop(s);
+    FAST_CHECK_EQ(s, s2);
+    FAST_CHECK_EQ(serialize_loop(routing::state()).empty(), true);
+}
+TEST_CASE("test_ts_vector_indexed_serialization") {
+    using namespace shyft::time_series::dd;
+    calendar utc;
+    gta_t ta(utc.time(2016,1,1),deltahours(1),240);
+    gta_t ta24(utc.time(2016,1,1),deltahours(24),10);
+    ats_vector tsv;
+    for (size_t i = 0; i < 100; ++i) {
+        vector<double> v(ta.size());
+        for (size_t j = 0; j < v.size(); ++j) v[j] = double(i) + 0.1*double(j);
+        apoint_ts a(ta,v,time_series::POINT_AVERAGE_VALUE);
+        tsv.push_back(i % 3 == 0 ? apoint_ts("shyft://x/" + std::to_string(i)) : (i % 3 == 1 ? a : (a*2.0).average(ta24)));
+    }
+    auto b = tsv.serialize_indexed();
+    FAST_CHECK_EQ(ats_vector::indexed_size(b), tsv.size());
+    auto tsv2 = ats_vector::deserialize_indexed(b, 2);
+    FAST_REQUIRE_EQ(tsv2.size(), tsv.size());
+    for (size_t i = 0; i < tsv.size(); ++i) {
+        if (i % 3 == 0) {
+            FAST_CHECK_EQ(tsv2[i].id(), tsv[i].id());
+        } else {
+            FAST_CHECK_UNARY(is_equal(tsv2[i], tsv[i]));
+        }
+    }
+    FAST_CHECK_UNARY(is_equal(ats_vector::deserialize_indexed_at(b, 52), tsv[52]));
+    CHECK_THROWS_AS(ats_vector::deserialize_indexed_at(b, tsv.size()), std::runtime_error);
+    auto bad = b; bad.pop_back();
+    CHECK_THROWS_AS(ats_vector::indexed_size(bad), std::runtime_error);
+    CHECK_THROWS_AS(ats_vector::indexed_size(vector<char>(4, 0)), std::runtime_error);
+    auto e = ats_vector().serialize_indexed();
+    FAST_CHECK_EQ(ats_vector::deserialize_indexed(e).size(), 0u);
+}
+
 } // end TEST_SUITE
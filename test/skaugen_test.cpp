@@ -1,5 +1,8 @@
 #include "test_pch.h"
 #include "core/skaugen.h"
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
 
 
 using namespace shyft::core::skaugen;
@@ -161,4 +164,58 @@ TEST_CASE("test_lwc") {
 
     return;
 }
+
+TEST_CASE("test_float_and_tabulated_statistics") {
+    // direct comparison of the relative sca reduction
+    for (double nu_a : {0.5, 4.0, 40.0, 400.0, 4000.0}) {
+        for (unsigned long u : {1ul, 10ul, 100ul, 500ul, 900ul}) {
+            const unsigned long n = 1000;
+            const double alpha = 4.0;
+            const double r = statistics::sca_rel_red(u, n, 0.1, nu_a, alpha);
+            TS_ASSERT_DELTA(float_statistics::sca_rel_red(u, n, 0.1, nu_a, alpha), r, 1.0e-5);
+            TS_ASSERT_DELTA(tabulated_statistics::sca_rel_red(u, n, 0.1, nu_a, alpha), r, 1.0e-3);
+            TS_ASSERT_DELTA(tabulated_statistics::sca_rel_red(3*u, 3*n, 0.1, nu_a, 3*alpha), r, 1.0e-3);// only u/n and nu_a matters
+        }
+    }
+    // a season of accumulation, and melt with a diurnal temperature cycle
+    parameter p(40.77, 113.0, 0.1, 0.1, 0.16, 2.50, 0.14, 0.01);
+    auto run = [&p](auto& model, double& outflow) {
+        state s(p.alpha_0*p.unit_size, p.alpha_0);
+        response r;
+        outflow = 0.0;
+        const size_t n_days = 115;
+        const shyft::time_series::utctimespan dt = 3600;
+        for (size_t i = 0; i < 24*n_days; ++i) {
+            const double day = i/24.0;
+            const double temp = day < 60 ? -4.0 + 3.0*std::sin(day) : -2.0 + 0.1*(day - 60) + 4.0*std::sin(2*3.1415926*day);
+            const double prec = day < 60 && (i % 37) < 5 ? 1.2 : 0.0;
+            model.step(dt, p, temp, prec, 0.0, 0.0, s, r);
+            outflow += r.outflow;
+        }
+        return s;
+    };
+    calculator<parameter, state, response> model;
+    calculator<parameter, state, response, float_statistics> float_model;
+    calculator<parameter, state, response, tabulated_statistics> tabulated_model;
+    double q = 0.0, q_float = 0.0, q_tabulated = 0.0;
+    std::clock_t t0 = std::clock();
+    const state s = run(model, q);
+    std::clock_t t1 = std::clock();
+    const state s_float = run(float_model, q_float);
+    std::clock_t t2 = std::clock();
+    const state s_tabulated = run(tabulated_model, q_tabulated);
+    std::clock_t t3 = std::clock();
+    TS_ASSERT(s.sca > 0.3 && s.sca < 0.9);// in the middle of the melt season
+    TS_ASSERT_DELTA(q_float, q, 1.0e-3*q);
+    TS_ASSERT_DELTA(q_tabulated, q, 1.0e-2*q);
+    TS_ASSERT_DELTA(s_float.sca, s.sca, 1.0e-3);
+    TS_ASSERT_DELTA(s_tabulated.sca, s.sca, 1.0e-2);
+    TS_ASSERT_DELTA(s_float.swe*s_float.sca, s.swe*s.sca, 1.0e-3*(1.0 + s.swe));
+    TS_ASSERT_DELTA(s_tabulated.swe*s_tabulated.sca, s.swe*s.sca, 1.0e-2*(1.0 + s.swe));
+    if (getenv("SHYFT_VERBOSE")) {
+        std::cout << "skaugen season, double: " << double(t1 - t0)/CLOCKS_PER_SEC << " s, float: " << double(t2 - t1)/CLOCKS_PER_SEC
+                  << " s, tabulated: " << double(t3 - t2)/CLOCKS_PER_SEC << " s, q=" << q << "," << q_float << "," << q_tabulated
+                  << " sca=" << s.sca << "," << s_float.sca << "," << s_tabulated.sca << std::endl;
+    }
+}
 }
@@ -0,0 +1,278 @@
+/** \brief time-axis and calendar micro-benchmark, ns/op and allocations for core/time_axis.h and the calendar
+ *
+ * Each case builds its time-axis, or time-points, once, then evaluates the operation over all of them
+ * repeatedly until at least min_ms has passed, and reports the time per operation and the heap allocations per evaluation.
+ * The sizes are the decades from min_n to max_n, the number of intervals, or calendar operations.
+ *
+ * usage: time_axis_benchmark [min_n=1000] [max_n=10000000] [min_ms=200] [case=all] [format=text]
+ *        case is all, or a prefix of the case names, like index_of, time, combine, merge or calendar,
+ *        format is text, csv or json, the latter one json object for each line, so results can be compared between builds
+ *
+ * The calendar_dt cases are hourly, and daily, calendar_dt_day, with n days, where b of combine and merge starts at the day of the middle hour of a.
+ *
+ * \note at max_n=1e8 the point_dt and calendar cases keeps 800 MB of time-points for each axis in memory,
+ *       the combine and merge cases two of them, and the result.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#include "core/utctime_utilities.h"
+#include "core/time_axis.h"
+
+using namespace std;
+using namespace shyft::core;
+namespace ta = shyft::time_axis;
+
+namespace {
+    std::atomic<size_t> n_allocations{ 0 };
+}
+
+// count the heap allocations, so the cases can report allocations per evaluation
+void* operator new(size_t sz) {
+    ++n_allocations;
+    if (void* p = std::malloc(sz ? sz : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    struct options {
+        size_t min_n = 1000;
+        size_t max_n = 10000000;
+        size_t min_ms = 200;
+        string name = "all";
+        string format = "text";
+    };
+
+    options parse(int argc, char* argv[]) {
+        options o;
+        for (int i = 1; i < argc; ++i) {
+            string a(argv[i]);
+            auto eq = a.find('=');
+            if (eq == string::npos)
+                throw runtime_error("expected key=value, got " + a);
+            string k = a.substr(0, eq), v = a.substr(eq + 1);
+            if (k == "case") { o.name = v; continue; }
+            if (k == "format") { o.format = v; continue; }
+            size_t n = size_t(std::stoul(v));
+            if (k == "min_n") o.min_n = n;
+            else if (k == "max_n") o.max_n = n;
+            else if (k == "min_ms") o.min_ms = n;
+            else throw runtime_error("unknown option " + k);
+        }
+        if (o.min_n == 0 || o.max_n < o.min_n)
+            throw runtime_error("require 0 < min_n <= max_n");
+        if (o.format != "text" && o.format != "csv" && o.format != "json")
+            throw runtime_error("format must be text, csv or json, got " + o.format);
+        return o;
+    }
+
+    typedef function<double()> run_t;///< one evaluation, returns a checksum so the work is not optimized away
+    typedef function<run_t(size_t)> case_t;///< builds the time-axis for n intervals, and returns the evaluation
+
+    const utctime t0 = calendar().time(2000, 1, 1);
+    const utctimespan dt = deltahours(1);
+
+    /** hourly points, every 7th shifted 10 minutes, so the point_dt can not be reduced to fixed arithmetic */
+    vector<utctime> hourly_points(size_t n, utctime t_start = t0) {
+        vector<utctime> t; t.reserve(n);
+        for (size_t i = 0; i < n; ++i) t.push_back(t_start + utctimespan(i)*dt + (i%7 == 3 ? deltaminutes(10) : 0));
+        return t;
+    }
+
+    typedef function<ta::generic_dt(size_t, utctime)> make_ta_t;///< n intervals starting at t, as generic_dt, then narrowed
+
+    template <class TA> TA narrow(const ta::generic_dt& g);
+    template <> ta::fixed_dt narrow(const ta::generic_dt& g) { return g.f; }
+    template <> ta::calendar_dt narrow(const ta::generic_dt& g) { return g.c; }
+    template <> ta::point_dt narrow(const ta::generic_dt& g) { return g.p; }
+    template <> ta::generic_dt narrow(const ta::generic_dt& g) { return g; }
+
+    /** index_of at the middle of each interval, visited in order */
+    template <class TA>
+    case_t index_of_case(make_ta_t make_ta) {
+        return [make_ta](size_t n) -> run_t {
+            auto tax = make_shared<TA>(narrow<TA>(make_ta(n, t0)));
+            auto tm = make_shared<vector<utctime>>();
+            tm->reserve(n);
+            for (size_t i = 0; i < n; ++i) tm->push_back(tax->time(i) + dt/2);
+            return [tax, tm]() {
+                size_t s = 0;
+                for (auto t : *tm) s += tax->index_of(t);
+                return double(s);
+            };
+        };
+    }
+
+    template <class TA>
+    case_t time_case(make_ta_t make_ta) {
+        return [make_ta](size_t n) -> run_t {
+            auto tax = make_shared<TA>(narrow<TA>(make_ta(n, t0)));
+            return [tax]() {
+                utctime s = 0;
+                for (size_t i = 0; i < tax->size(); ++i) s += tax->time(i) - t0;
+                return double(s);
+            };
+        };
+    }
+
+    /** combine a and b, where b starts at the middle of a, per interval of a */
+    template <class TA>
+    case_t combine_case(make_ta_t make_ta) {
+        return [make_ta](size_t n) -> run_t {
+            auto a = make_shared<TA>(narrow<TA>(make_ta(n, t0)));
+            auto b = make_shared<TA>(narrow<TA>(make_ta(n, t0 + utctimespan(n/2)*dt)));
+            return [a, b]() { return double(ta::combine(*a, *b).size()); };
+        };
+    }
+
+    /** merge a and b, where b starts at the middle of a and extends it, per interval of a */
+    template <class TA>
+    case_t merge_case(make_ta_t make_ta) {
+        return [make_ta](size_t n) -> run_t {
+            auto a = make_shared<TA>(narrow<TA>(make_ta(n, t0)));
+            auto b = make_shared<TA>(narrow<TA>(make_ta(n, t0 + utctimespan(n/2)*dt)));
+            return [a, b]() { return double(ta::merge(*a, *b).size()); };
+        };
+    }
+
+    /** f(cal, t) for n hourly time-points */
+    case_t calendar_case(shared_ptr<calendar> cal, function<utctime(const calendar&, utctime)> f) {
+        return [cal, f](size_t n) -> run_t {
+            auto tp = make_shared<vector<utctime>>(hourly_points(n));
+            return [cal, f, tp]() {
+                utctime s = 0;
+                for (auto t : *tp) s += f(*cal, t) - t0;
+                return double(s);
+            };
+        };
+    }
+
+    /** f(cal, tv) for a vector of n hourly time-points, the batch conversions */
+    case_t calendar_batch_case(shared_ptr<calendar> cal, function<vector<utctime>(const calendar&, const vector<utctime>&)> f) {
+        return [cal, f](size_t n) -> run_t {
+            auto tp = make_shared<vector<utctime>>(hourly_points(n));
+            return [cal, f, tp]() {
+                auto r = f(*cal, *tp);
+                return double(r[r.size()/2] - t0);
+            };
+        };
+    }
+
+    double seconds_since(chrono::steady_clock::time_point t) {
+        return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+    }
+
+    void print_header(const options& o) {
+        if (o.format == "text") {
+            cout << "min_n=" << o.min_n << " max_n=" << o.max_n << " min_ms=" << o.min_ms << "\n";
+            cout << setw(42) << left << "case" << right << setw(10) << "n" << setw(12) << "ns/op" << setw(10) << "reps"
+                 << setw(12) << "allocs" << endl;
+        } else if (o.format == "csv") {
+            cout << "case,n,ns_per_op,reps,allocs" << endl;
+        }
+    }
+
+    void print_result(const options& o, const string& name, size_t n, double ns_per_op, size_t reps, double allocs, double check) {
+        if (o.format == "text") {
+            cout << setw(42) << left << name << right
+                 << setw(10) << n
+                 << fixed << setprecision(3)
+                 << setw(12) << ns_per_op
+                 << setw(10) << reps
+                 << setprecision(1) << setw(12) << allocs
+                 << "   (" << setprecision(3) << check << ")" << endl;
+        } else if (o.format == "csv") {
+            cout << name << ',' << n << ',' << fixed << setprecision(3) << ns_per_op << ',' << reps << ',' << setprecision(1) << allocs << endl;
+        } else {
+            cout << "{\"case\":\"" << name << "\",\"n\":" << n << ",\"ns_per_op\":" << fixed << setprecision(3) << ns_per_op
+                 << ",\"reps\":" << reps << ",\"allocs\":" << setprecision(1) << allocs << "}" << endl;
+        }
+    }
+
+    void run_case(const string& name, const case_t& c, const options& o) {
+        for (size_t n = o.min_n; n <= o.max_n; n *= 10) {
+            run_t f = c(n);
+            double check = f();// warm up, and the first touch of the memory
+            size_t reps = 0;
+            const size_t a0 = n_allocations;
+            const auto t = chrono::steady_clock::now();
+            double elapsed = 0.0;
+            do {
+                check += f();
+                ++reps;
+                elapsed = seconds_since(t);
+            } while (elapsed*1000.0 < double(o.min_ms));
+            print_result(o, name, n, 1e9*elapsed/double(reps*n), reps, double(n_allocations - a0)/double(reps), check/double(reps + 1));
+            if (n > o.max_n/10) break;
+        }
+    }
+
+    /** the index_of, time, combine and merge cases of the time-axis types, TA is the type the cases are evaluated on */
+    template <class TA>
+    void add_axis_cases(vector<pair<string, case_t>>& cases, const string& ta_name, make_ta_t make_ta) {
+        cases.emplace_back("index_of/" + ta_name, index_of_case<TA>(make_ta));
+        cases.emplace_back("time/" + ta_name, time_case<TA>(make_ta));
+        cases.emplace_back("combine/" + ta_name, combine_case<TA>(make_ta));
+        cases.emplace_back("merge/" + ta_name, merge_case<TA>(make_ta));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const auto o = parse(argc, argv);
+        vector<pair<string, case_t>> cases;
+        const vector<string> tz_names{"UTC", "Europe/Oslo", "Australia/Sydney"};
+        auto fixed_ta = [](size_t n, utctime t) { return ta::generic_dt(t, dt, n); };
+        auto point_ta = [](size_t n, utctime t) { return ta::generic_dt(hourly_points(n, t), t + utctimespan(n)*dt); };
+        add_axis_cases<ta::fixed_dt>(cases, "fixed_dt", fixed_ta);
+        for (const auto& tz : tz_names) {
+            auto cal = tz == "UTC" ? make_shared<calendar>() : make_shared<calendar>(tz);
+            add_axis_cases<ta::calendar_dt>(cases, "calendar_dt(" + tz + ")",
+                [cal](size_t n, utctime t) { return ta::generic_dt(cal, t, dt, n); });
+            add_axis_cases<ta::calendar_dt>(cases, "calendar_dt_day(" + tz + ")",
+                [cal](size_t n, utctime t) { return ta::generic_dt(cal, cal->trim(t, calendar::DAY), calendar::DAY, n); });
+        }
+        add_axis_cases<ta::point_dt>(cases, "point_dt", point_ta);
+        add_axis_cases<ta::generic_dt>(cases, "generic_dt(f)", fixed_ta);
+        add_axis_cases<ta::generic_dt>(cases, "generic_dt(p)", point_ta);
+        for (const auto& tz : tz_names) {
+            auto cal = tz == "UTC" ? make_shared<calendar>() : make_shared<calendar>(tz);
+            const string s = "/" + tz;
+            cases.emplace_back("calendar/add_hour" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.add(t, calendar::HOUR, 1); }));
+            cases.emplace_back("calendar/add_day" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.add(t, calendar::DAY, 1); }));
+            cases.emplace_back("calendar/add_month" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.add(t, calendar::MONTH, 1); }));
+            cases.emplace_back("calendar/diff_day" + s, calendar_case(cal, [](const calendar& c, utctime t) { return t0 + c.diff_units(t0, t, calendar::DAY); }));
+            cases.emplace_back("calendar/diff_month" + s, calendar_case(cal, [](const calendar& c, utctime t) { return t0 + c.diff_units(t0, t, calendar::MONTH); }));
+            cases.emplace_back("calendar/trim_day" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.trim(t, calendar::DAY); }));
+            cases.emplace_back("calendar/trim_week" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.trim(t, calendar::WEEK); }));
+            cases.emplace_back("calendar/trim_month" + s, calendar_case(cal, [](const calendar& c, utctime t) { return c.trim(t, calendar::MONTH); }));
+            cases.emplace_back("calendar/batch_trim_day" + s, calendar_batch_case(cal, [](const calendar& c, const vector<utctime>& tv) { return c.trim(tv, calendar::DAY); }));
+            cases.emplace_back("calendar/batch_add_day" + s, calendar_batch_case(cal, [](const calendar& c, const vector<utctime>& tv) { return c.add(tv, calendar::DAY, 1); }));
+        }
+        print_header(o);
+        bool found = false;
+        for (const auto& c : cases) {
+            if (o.name == "all" || c.first.compare(0, o.name.size(), o.name) == 0) {
+                found = true;
+                run_case(c.first, c.second, o);
+            }
+        }
+        if (!found)
+            throw runtime_error("no case named " + o.name);
+    } catch (const exception& e) {
+        cerr << "time_axis_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
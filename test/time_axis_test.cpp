@@ -846,4 +846,219 @@ TEST_CASE("time_axis_map") {
 	//auto ix_map = tat.map(a, b);
 	//FAST_CHECK_EQ(ix_map.size(), b.size());
 }
+
+TEST_CASE("time_axis_map_specializations") {
+	using namespace shyft;
+	using namespace shyft::core;
+	using namespace std;
+	auto osl = make_shared<calendar>("Europe/Oslo");
+	calendar utc;
+	auto t0 = utc.time(2016, 3, 20);
+	auto dt = deltahours(1);
+	vector<utctime> tp;
+	for (size_t i = 0; i < 24*20; ++i)
+		tp.push_back(t0 + utctimespan(i)*dt + (i%5 == 0 ? deltaminutes(13) : 0));
+	time_axis::point_dt p(tp, t0 + utctimespan(tp.size())*dt);
+	time_axis::fixed_dt f(t0 + deltaminutes(30), dt, 24*20);
+	time_axis::calendar_dt c(osl, t0 - calendar::DAY, calendar::DAY, 25);// extends before and after src, and crosses dst
+	time_axis::fixed_dt mf(t0 - deltaminutes(17), deltaminutes(17), 24*20*4);
+
+	auto verify = [](auto const& src, auto const& m) {// vs. plain index_of of the src, visiting m in order, then backwards
+		auto x = time_axis::make_time_axis_map(src, m);
+		size_t n_found = 0;
+		for (size_t i = 0; i < m.size(); ++i) {
+			auto ix = x.src_index(i);
+			FAST_CHECK_EQ(ix, src.index_of(m.time(i)));
+			if (ix != string::npos) ++n_found;
+		}
+		for (size_t i = m.size(); i-- > 0;)
+			FAST_CHECK_EQ(x.src_index(i), src.index_of(m.time(i)));
+		FAST_CHECK_EQ(x.src_index(m.size()), string::npos);
+		return n_found;
+	};
+	FAST_CHECK_GT(verify(p, f), 0u);
+	FAST_CHECK_GT(verify(p, c), 0u);
+	FAST_CHECK_GT(verify(p, mf), 0u);
+	FAST_CHECK_GT(verify(f, c), 0u);
+	FAST_CHECK_GT(verify(f, mf), 0u);
+	FAST_CHECK_GT(verify(mf, f), 0u);
+	const vector<time_axis::generic_dt> g{time_axis::generic_dt(p), time_axis::generic_dt(f), time_axis::generic_dt(c), time_axis::generic_dt(mf)};
+	for (auto const& a : g)
+		for (auto const& b : g)
+			FAST_CHECK_GT(verify(a, b), 0u);
+	SUBCASE("empty src") {
+		time_axis::point_dt e;
+		FAST_CHECK_EQ(verify(e, f), 0u);
+		FAST_CHECK_EQ(verify(time_axis::generic_dt(e), time_axis::generic_dt(f)), 0u);
+	}
+}
+
+TEST_CASE("time_axis_calendar_terms") {
+	calendar utc;
+	time_axis::fixed_dt ta(utc.time(2015, 12, 30), deltahours(6), 4*5);
+	time_axis::calendar_terms ct(ta);
+	FAST_REQUIRE_EQ(ct.size(), ta.size());
+	for (size_t i = 0; i < ta.size(); ++i) {
+		FAST_CHECK_EQ(ct.day_of_year[i], utc.day_of_year(ta.time(i)));
+		FAST_CHECK_EQ(ct.year_start[i], utc.trim(ta.time(i), calendar::YEAR));
+	}
+	FAST_CHECK_EQ(ct.year_start.back(), utc.time(2016, 1, 1));
+	auto a = time_axis::calendar_terms::shared(ta);
+	auto b = time_axis::calendar_terms::shared(time_axis::fixed_dt(ta.t, ta.dt, ta.n));
+	FAST_CHECK_EQ(a.get(), b.get());// same time-axis, computed once
+	auto c = time_axis::calendar_terms::shared(time_axis::fixed_dt(ta.t, ta.dt, ta.n + 1));
+	FAST_CHECK_NE(a.get(), c.get());
+	FAST_CHECK_EQ(c->size(), ta.size() + 1);
+	FAST_CHECK_EQ(a->day_of_year, ct.day_of_year);
+}
+
+TEST_CASE("generic_dt_storage") {
+	using namespace shyft::time_axis;
+	auto utc = make_shared<calendar>();
+	// only one of the representations is stored
+	FAST_CHECK_LT(sizeof(generic_dt), sizeof(fixed_dt) + sizeof(calendar_dt) + sizeof(point_dt));
+	generic_dt a(0, deltahours(1), 24);
+	generic_dt b(utc, 0, deltahours(24), 10);
+	generic_dt c(vector<utctime>{0, 10, 30}, 40);
+	generic_dt x;
+	for (const auto& s : {a, b, c, a, c, b, b}) { // assign across the representations
+		x = s;
+		FAST_CHECK_EQ(x.gt, s.gt);
+		FAST_CHECK_EQ(x, s);
+		generic_dt y(s), z;
+		z = std::move(y);
+		FAST_CHECK_EQ(z, s);
+		generic_dt w(std::move(z));
+		FAST_CHECK_EQ(w, s);
+	}
+	x = x;
+	FAST_CHECK_EQ(x, b);
+	x.set_type(generic_dt::POINT);
+	FAST_CHECK_EQ(x.gt, generic_dt::POINT);
+	FAST_CHECK_EQ(x.size(), 0u);
+	x.p = c.p;
+	FAST_CHECK_EQ(x, c);
+	x.set_type(generic_dt::CALENDAR);
+	FAST_CHECK_EQ(x.size(), 0u);
+}
+
+
+TEST_CASE("calendar_dt_table") {
+	auto osl = make_shared<calendar>("Europe/Oslo");
+	utctime t0 = osl->time(2016, 1, 1);
+	for (auto dt : {calendar::DAY, calendar::WEEK, calendar::MONTH, deltahours(3)}) {
+		time_axis::calendar_dt ta(osl, t0, dt, 400);
+		FAST_REQUIRE_UNARY(ta.table() != nullptr);
+		time_axis::calendar_dt tc(ta);
+		FAST_CHECK_EQ(tc.table(), ta.table());// shared between copies
+		tc.n = 401;// changed members, no longer the table of tc
+		FAST_CHECK_UNARY(tc.table() == nullptr);
+		tc.n = ta.n;
+		for (size_t i = 0; i < ta.size(); ++i) {
+			FAST_CHECK_EQ(ta.time(i), osl->add(t0, dt, long(i)));
+			FAST_CHECK_EQ(ta.period(i), utcperiod(osl->add(t0, dt, long(i)), osl->add(t0, dt, long(i + 1))));
+			for (auto tx : {ta.time(i), ta.time(i) + deltahours(1), ta.period(i).end - 1})
+				FAST_CHECK_EQ(ta.index_of(tx), i);
+		}
+		FAST_CHECK_EQ(ta.index_of(t0 - 1), std::string::npos);
+		FAST_CHECK_EQ(ta.index_of(ta.total_period().end), std::string::npos);
+		FAST_CHECK_EQ(ta.open_range_index_of(ta.total_period().end), ta.size() - 1);
+		FAST_CHECK_EQ(ta.open_range_index_of(t0 - 1), std::string::npos);
+		auto ts = time_axis::time_shift(ta, deltahours(24));
+		FAST_CHECK_UNARY(ts.table() != nullptr);
+		FAST_CHECK_EQ(ts.time(3), osl->add(t0 + deltahours(24), dt, 3));
+	}
+	time_axis::calendar_dt th(osl, t0, deltahours(1), 10);
+	FAST_CHECK_UNARY(th.table() == nullptr);// hourly is computed directly
+}
+
+
+TEST_CASE("time_axis_combine_refinement") {
+	using namespace shyft::time_axis;
+	auto osl = make_shared<calendar>("Europe/Oslo");
+	utctime t0 = osl->time(2016, 3, 1);
+	fixed_dt h(t0 - deltahours(5), deltahours(1), 24*60);
+	calendar_dt d(osl, t0, calendar::DAY, 40);// spans the DST change, still on whole hours
+	auto c = combine(generic_dt(d), generic_dt(h));
+	FAST_CHECK_EQ(c.gt, generic_dt::FIXED);
+	TS_ASSERT(test_if_equal(fixed_dt(t0, deltahours(1), size_t((d.total_period().end - t0)/deltahours(1))), c));
+	FAST_CHECK_EQ(combine(h, d), c);
+
+	calendar_dt w(osl, osl->trim(t0, calendar::WEEK), calendar::WEEK, 4);
+	auto cw = combine(w, d);// weeks are whole days in the same calendar
+	FAST_CHECK_EQ(cw.gt, generic_dt::CALENDAR);
+	TS_ASSERT(test_if_equal(sub_axis(d, t0, w.total_period().end), cw));
+
+	point_dt p(vector<utctime>{t0, t0 + deltahours(3), t0 + deltahours(7)}, t0 + deltahours(10));
+	auto cp = combine(p, h);// observations on whole hours
+	FAST_CHECK_EQ(cp.gt, generic_dt::FIXED);
+	TS_ASSERT(test_if_equal(fixed_dt(t0, deltahours(1), 10), cp));
+
+	point_dt q(vector<utctime>{t0, t0 + deltahours(3) + 60}, t0 + deltahours(4));
+	auto cq = combine(q, h);// off the grid, merged into points
+	FAST_CHECK_EQ(cq.gt, generic_dt::POINT);
+	FAST_CHECK_EQ(cq.size(), 5u);
+	FAST_CHECK_EQ(cq.time(4), t0 + deltahours(3) + 60);
+}
+
+
+TEST_CASE("point_dt_shared_points") {
+	using namespace shyft::time_axis;
+	vector<utctime> t{0, 10, 30, 60};
+	point_dt a(t, 100);
+	point_dt b(a);// copies shares the points
+	FAST_CHECK_UNARY(b.t.shares(a.t));
+	b.t.push_back(70);// until modified
+	FAST_CHECK_UNARY(!b.t.shares(a.t));
+	FAST_CHECK_EQ(a.t, t);
+	FAST_CHECK_EQ(b.size(), 5u);
+	auto s = time_shift(a, 5);
+	FAST_CHECK_EQ(a.time(1), 10);
+	FAST_CHECK_EQ(s.time(1), 15);
+
+	auto x = intern(point_dt(t, 100));
+	auto y = intern(point_dt(t, 100));// created independently, stored once
+	FAST_CHECK_UNARY(x.t.shares(y.t));
+	FAST_CHECK_EQ(x, y);
+	FAST_CHECK_UNARY(!intern(point_dt(vector<utctime>{0, 10, 31, 60}, 100)).t.shares(x.t));
+	auto g = intern(generic_dt(point_dt(t, 100)));
+	FAST_CHECK_EQ(g.gt, generic_dt::POINT);
+	FAST_CHECK_UNARY(g.p.t.shares(x.t));
+	FAST_CHECK_EQ(intern(generic_dt(0, 10, 3)), generic_dt(0, 10, 3));
+	x.t.mut()[0] = -10;// interned points are never changed in place
+	FAST_CHECK_EQ(y.time(0), 0);
+	point_dt m(std::move(x));
+	FAST_CHECK_EQ(m.time(0), -10);
+	FAST_CHECK_EQ(x.size(), 0u);
+}
+
+TEST_CASE("fixed_dt_us") {
+    calendar utc;
+    utctime t0 = utc.time(2017, 1, 1);
+    FAST_CHECK_EQ(from_utctime_us(to_utctime_us(t0)), t0);
+    FAST_CHECK_EQ(from_utctime_us(utctime_us(-1)), utctime(-1));// rounded down
+    FAST_CHECK_EQ(from_utctime_us(-us_per_second), utctime(-1));
+    FAST_CHECK_EQ(to_utctime_us(no_utctime), utctime_us(no_utctime));
+    FAST_CHECK_EQ(from_utctime_us(to_utctime_us(max_utctime)), max_utctime);
+    CHECK_THROWS_AS(to_utctime_us(max_utctime - 1), std::runtime_error);
+
+    time_axis::fixed_dt_us a(to_utctime_us(t0) + deltamilliseconds(250), deltamilliseconds(500), 10);
+    FAST_CHECK_EQ(a.size(), 10u);
+    FAST_CHECK_EQ(a.time_us(1), to_utctime_us(t0) + deltamilliseconds(750));
+    FAST_CHECK_EQ(a.time(1), t0);// by whole seconds
+    FAST_CHECK_EQ(a.time(2), t0 + 1);
+    FAST_CHECK_EQ(a.index_of_us(to_utctime_us(t0) + deltamilliseconds(800)), 1u);
+    FAST_CHECK_EQ(a.index_of(t0 + 1), 1u);// t0+1 s is within [0.75 .. 1.25> s
+    FAST_CHECK_EQ(a.index_of(t0), string::npos);
+    FAST_CHECK_EQ(a.total_period(), utcperiod(t0, t0 + 5));
+    FAST_CHECK_EQ(a.open_range_index_of(t0 + 100), 9u);
+    FAST_CHECK_EQ(a.is_whole_seconds(), false);
+    CHECK_THROWS_AS(a.to_fixed_dt(), std::runtime_error);
+
+    time_axis::fixed_dt f(t0, deltahours(1), 24);
+    time_axis::fixed_dt_us b(f);
+    FAST_CHECK_EQ(b.is_whole_seconds(), true);
+    FAST_CHECK_EQ(b.to_fixed_dt(), f);
+    FAST_CHECK_EQ(test_if_equal(f, b), true);
+}
 }
@@ -430,4 +430,50 @@ TEST_SUITE("time_series") {
             CHECK( i_src.value(i) == doctest::Approx(1.0));
 
     }
+    TEST_CASE("ts_prefix_integral") {
+        using ts_t = point_ts<point_dt>;
+        calendar utc{};
+        const utctime t0 = utc.time(2017,10,16);
+        vector<utctime> t;
+        for (int i = 0; i < 50; ++i)
+            t.push_back(t0 + deltahours(2*i + i%2));// uneven steps
+        point_dt ta_s(t, t.back() + deltahours(2));
+        vector<double> v;
+        for (size_t i = 0; i < t.size(); ++i)
+            v.push_back(i%7 == 3 || i == 20 || i == 21 ? shyft::nan : 1.0 + 0.5*i - 0.01*i*i);
+        for (auto fx : {POINT_INSTANT_VALUE, POINT_AVERAGE_VALUE}) {
+            ts_t src(ta_s, v, fx);
+            const bool linear = fx == POINT_INSTANT_VALUE;
+            auto pi = prefix_integral::of(src, linear);
+            for (utctimespan s = -deltahours(3); s < deltahours(80); s += deltaminutes(50)) {
+                for (utctimespan dt : {deltaminutes(10), deltahours(1), deltahours(7), deltahours(100)}) {
+                    utcperiod p(t0 + s, t0 + s + dt);
+                    size_t ix_hint = 0;
+                    utctimespan tsum_a = 0, tsum_p = 0;
+                    const double a = accumulate_value(src, p, ix_hint, tsum_a, linear);
+                    const double b = pi.accumulate(p, tsum_p);
+                    CHECK(tsum_a == tsum_p);
+                    if (std::isfinite(a)) {
+                        CHECK(b == doctest::Approx(a));
+                        CHECK(pi.average(p) == doctest::Approx(a/tsum_a));
+                    } else {
+                        CHECK(!std::isfinite(b));
+                    }
+                }
+            }
+            // backward access on the accumulate_accessor uses the prefix_integral
+            fixed_dt ta(t0, deltahours(1), 40);
+            accumulate_accessor<ts_t, fixed_dt> rnd(src, ta);
+            for (size_t i = ta.size(); i-- > 1;) {
+                size_t ix_hint = 0;
+                utctimespan tsum = 0;
+                const double a = accumulate_value(src, utcperiod(ta.time(0), ta.time(i)), ix_hint, tsum, linear);
+                const double r = rnd.value(i);
+                if (std::isfinite(a))
+                    CHECK(r == doctest::Approx(a));
+                else
+                    CHECK(!std::isfinite(r));
+            }
+        }
+    }
 }
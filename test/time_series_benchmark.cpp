@@ -0,0 +1,272 @@
+/** \brief time-series micro-benchmark, ns/point and allocations for the core/time_series.h templates
+ *
+ * Each case builds its series once, then evaluates them repeatedly until at least min_ms has passed,
+ * and reports the time per source point and the heap allocations per evaluation.
+ * The sizes are the decades from min_n to max_n points.
+ *
+ * usage: time_series_benchmark [min_n=1000] [max_n=10000000] [min_ms=200] [case=all]
+ *        case is all, or a prefix of the case names, like point_ts, bin_op, accessor, convolve_w, uniform_sum, time_shift or percentiles
+ *
+ * \note at max_n=1e7 the uniform_sum and percentiles cases keeps several series of 80 MB each in memory.
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#include "core/utctime_utilities.h"
+#include "core/time_axis.h"
+#include "core/time_series.h"
+#include "core/time_series_statistics.h"
+
+using namespace std;
+using namespace shyft::core;
+namespace st = shyft::time_series;
+namespace ta = shyft::time_axis;
+
+namespace {
+    std::atomic<size_t> n_allocations{ 0 };
+}
+
+// count the heap allocations, so the cases can report allocations per evaluation
+void* operator new(size_t sz) {
+    ++n_allocations;
+    if (void* p = std::malloc(sz ? sz : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    struct options {
+        size_t min_n = 1000;
+        size_t max_n = 10000000;
+        size_t min_ms = 200;
+        string name = "all";
+    };
+
+    options parse(int argc, char* argv[]) {
+        options o;
+        for (int i = 1; i < argc; ++i) {
+            string a(argv[i]);
+            auto eq = a.find('=');
+            if (eq == string::npos)
+                throw runtime_error("expected key=value, got " + a);
+            string k = a.substr(0, eq), v = a.substr(eq + 1);
+            if (k == "case") { o.name = v; continue; }
+            size_t n = size_t(std::stoul(v));
+            if (k == "min_n") o.min_n = n;
+            else if (k == "max_n") o.max_n = n;
+            else if (k == "min_ms") o.min_ms = n;
+            else throw runtime_error("unknown option " + k);
+        }
+        if (o.min_n == 0 || o.max_n < o.min_n)
+            throw runtime_error("require 0 < min_n <= max_n");
+        return o;
+    }
+
+    typedef function<double()> run_t;///< one evaluation, returns a checksum so the work is not optimized away
+    typedef function<run_t(size_t)> case_t;///< builds the series for n points, and returns the evaluation
+
+    const utctime t0 = calendar().time(2000, 1, 1);
+    const utctimespan dt = deltahours(1);
+
+    double value_of(size_t i) { return 10.0 + std::sin(0.01*double(i)) + 0.001*double(i%97); }
+
+    template <class TA>
+    st::point_ts<TA> make_ts(const TA& tax, st::ts_point_fx fx = st::POINT_AVERAGE_VALUE) {
+        vector<double> v(tax.size());
+        for (size_t i = 0; i < v.size(); ++i) v[i] = value_of(i);
+        return st::point_ts<TA>(tax, v, fx);
+    }
+
+    vector<utctime> hourly_points(size_t n) {
+        vector<utctime> t; t.reserve(n);
+        for (size_t i = 0; i < n; ++i) t.push_back(t0 + utctimespan(i)*dt);
+        return t;
+    }
+
+    /** f(t) at the middle of each interval, the index_of cost of the time-axis */
+    template <class TA>
+    case_t point_ts_f_of_t(function<TA(size_t)> make_ta) {
+        return [make_ta](size_t n) -> run_t {
+            auto ts = make_shared<st::point_ts<TA>>(make_ts(make_ta(n)));
+            return [ts]() {
+                double s = 0.0;
+                const auto& tax = ts->time_axis();
+                for (size_t i = 0; i < tax.size(); ++i) s += (*ts)(tax.time(i) + dt/2);
+                return s;
+            };
+        };
+    }
+
+    /** the expression a + a + .. with D operators, evaluated by values_of */
+    template <int D>
+    struct chain {
+        template <class A>
+        static auto make(const A& a) -> decltype(chain<D - 1>::make(a) + a) { return chain<D - 1>::make(a) + a; }
+    };
+    template <>
+    struct chain<0> {
+        template <class A>
+        static A make(const A& a) { return a; }
+    };
+
+    template <int D>
+    case_t bin_op_chain() {
+        return [](size_t n) -> run_t {
+            auto a = make_shared<st::point_ts<ta::fixed_dt>>(make_ts(ta::fixed_dt(t0, dt, n)));
+            typedef decltype(chain<D>::make(a)) e_t;
+            auto e = make_shared<e_t>(chain<D>::make(a));
+            auto r = make_shared<vector<double>>(n);
+            return [e, r]() {
+                st::values_of(*e, 0, r->size(), r->data());
+                return (*r)[r->size()/2];
+            };
+        };
+    }
+
+    /** hourly source to a 3-hour time-axis, by accessor A */
+    template <template <class, class> class A>
+    case_t accessor_case() {
+        return [](size_t n) -> run_t {
+            auto ts = make_shared<st::point_ts<ta::fixed_dt>>(make_ts(ta::fixed_dt(t0, dt, n)));
+            ta::fixed_dt ta3(t0, 3*dt, n/3);
+            return [ts, ta3]() {
+                A<st::point_ts<ta::fixed_dt>, ta::fixed_dt> acc(*ts, ta3);
+                double s = 0.0;
+                for (size_t i = 0; i < ta3.size(); ++i) s += acc.value(i);
+                return s;
+            };
+        };
+    }
+
+    run_t convolve_w_case(size_t n) {
+        typedef st::point_ts<ta::fixed_dt> ts_t;
+        auto cts = make_shared<st::convolve_w_ts<ts_t>>(make_ts(ta::fixed_dt(t0, dt, n)), vector<double>{0.1, 0.2, 0.4, 0.2, 0.1});
+        auto r = make_shared<vector<double>>(n);
+        return [cts, r]() {
+            st::values_of(*cts, 0, r->size(), r->data());
+            return (*r)[r->size()/2];
+        };
+    }
+
+    run_t uniform_sum_case(size_t n) {
+        typedef st::point_ts<ta::fixed_dt> ts_t;
+        vector<ts_t> tsv;
+        for (size_t i = 0; i < 4; ++i) tsv.push_back(make_ts(ta::fixed_dt(t0, dt, n)));
+        auto sts = make_shared<st::uniform_sum_ts<ts_t>>(tsv);// by lvalue, the ct checks the size of its argument
+        auto r = make_shared<vector<double>>(n);
+        return [sts, r]() {
+            st::values_of(*sts, 0, r->size(), r->data());
+            return (*r)[r->size()/2];
+        };
+    }
+
+    run_t time_shift_case(size_t n) {
+        auto tts = make_shared<st::time_shift_ts<st::point_ts<ta::fixed_dt>>>(make_ts(ta::fixed_dt(t0, dt, n)), deltahours(24*365));
+        return [tts]() {
+            double s = 0.0;
+            const auto& tax = tts->time_axis();
+            for (size_t i = 0; i < tax.size(); ++i) s += (*tts)(tax.time(i) + dt/2);
+            return s;
+        };
+    }
+
+    /** 5 hourly members to percentiles on a daily time-axis */
+    run_t percentiles_case(size_t n) {
+        typedef st::point_ts<ta::fixed_dt> ts_t;
+        auto members = make_shared<vector<ts_t>>();
+        for (size_t m = 0; m < 5; ++m) {
+            auto ts = make_ts(ta::fixed_dt(t0, dt, n));
+            ts.scale_by(1.0 + 0.1*double(m));
+            members->push_back(std::move(ts));
+        }
+        ta::fixed_dt ta24(t0, 24*dt, std::max(size_t(1), n/24));
+        return [members, ta24]() {
+            auto r = st::calculate_percentiles(ta24, *members, vector<int>{0, 10, 50, -1, 90, 100});
+            return r[2].value(0);
+        };
+    }
+
+    double seconds_since(chrono::steady_clock::time_point t) {
+        return chrono::duration<double>(chrono::steady_clock::now() - t).count();
+    }
+
+    void run_case(const string& name, const case_t& c, const options& o) {
+        for (size_t n = o.min_n; n <= o.max_n; n *= 10) {
+            run_t f = c(n);
+            double check = f();// warm up, and the first touch of the memory
+            size_t reps = 0;
+            const size_t a0 = n_allocations;
+            const auto t = chrono::steady_clock::now();
+            double elapsed = 0.0;
+            do {
+                check += f();
+                ++reps;
+                elapsed = seconds_since(t);
+            } while (elapsed*1000.0 < double(o.min_ms));
+            const double allocs = double(n_allocations - a0)/double(reps);
+            cout << setw(24) << left << name << right
+                 << setw(10) << n
+                 << fixed << setprecision(3)
+                 << setw(12) << 1e9*elapsed/double(reps*n)
+                 << setw(10) << reps
+                 << setprecision(1) << setw(12) << allocs
+                 << "   (" << setprecision(3) << check/double(reps + 1) << ")" << endl;
+            if (n > o.max_n/10) break;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const auto o = parse(argc, argv);
+        auto cal = make_shared<calendar>();
+        vector<pair<string, case_t>> cases{
+            {"point_ts/fixed_dt", point_ts_f_of_t<ta::fixed_dt>([](size_t n) { return ta::fixed_dt(t0, dt, n); })},
+            {"point_ts/calendar_dt", point_ts_f_of_t<ta::calendar_dt>([cal](size_t n) { return ta::calendar_dt(cal, t0, dt, n); })},
+            {"point_ts/point_dt", point_ts_f_of_t<ta::point_dt>([](size_t n) { return ta::point_dt(hourly_points(n), t0 + utctimespan(n)*dt); })},
+            {"point_ts/generic_dt", point_ts_f_of_t<ta::generic_dt>([](size_t n) { return ta::generic_dt(t0, dt, n); })},
+            {"point_ts/generic_dt(p)", point_ts_f_of_t<ta::generic_dt>([](size_t n) { return ta::generic_dt(hourly_points(n), t0 + utctimespan(n)*dt); })},
+            {"bin_op/1", bin_op_chain<1>()},
+            {"bin_op/2", bin_op_chain<2>()},
+            {"bin_op/3", bin_op_chain<3>()},
+            {"bin_op/4", bin_op_chain<4>()},
+            {"bin_op/5", bin_op_chain<5>()},
+            {"bin_op/6", bin_op_chain<6>()},
+            {"bin_op/7", bin_op_chain<7>()},
+            {"bin_op/8", bin_op_chain<8>()},
+            {"accessor/average", accessor_case<st::average_accessor>()},
+            {"accessor/accumulate", accessor_case<st::accumulate_accessor>()},
+            {"convolve_w", convolve_w_case},
+            {"uniform_sum/4", uniform_sum_case},
+            {"time_shift", time_shift_case},
+            {"percentiles/5", percentiles_case}
+        };
+        cout << "min_n=" << o.min_n << " max_n=" << o.max_n << " min_ms=" << o.min_ms << "\n";
+        cout << setw(24) << left << "case" << right << setw(10) << "n" << setw(12) << "ns/point" << setw(10) << "reps"
+             << setw(12) << "allocs" << endl;
+        bool found = false;
+        for (const auto& c : cases) {
+            if (o.name == "all" || c.first.compare(0, o.name.size(), o.name) == 0) {
+                found = true;
+                run_case(c.first, c.second, o);
+            }
+        }
+        if (!found)
+            throw runtime_error("no case named " + o.name);
+    } catch (const exception& e) {
+        cerr << "time_series_benchmark: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -101,4 +101,37 @@ TEST_SUITE("time_series") {
         FAST_CHECK_EQ(ts->value(4),doctest::Approx(cts.value(4)));// own value replaces -20.1
     }
 
+
+    TEST_CASE("qac_ts_values") {
+        // the bulk values() must equal value(i), for gaps at the ends, long gaps, and uneven time-steps
+        vector<shyft::core::utctime> t;
+        for (int i = 0; i < 40; ++i) t.push_back(10*i + (i%3)*2);
+        generic_dt ta{t, 10*40 + 5};
+        vector<double> v;
+        for (size_t i = 0; i < t.size(); ++i)
+            v.push_back((i < 2 || i%7 == 3 || (i > 20 && i < 26) || i == 39) ? shyft::nan : (i%11 == 5 ? 100.0 : double(i)));
+        apoint_ts src(ta, v, ts_point_fx::POINT_INSTANT_VALUE);
+        for (auto max_dt : {shyft::core::utctimespan(0), shyft::core::utctimespan(15), shyft::core::utctimespan(25), shyft::core::utctimespan(80), shyft::core::max_utctime}) {
+            for (double max_x : {shyft::nan, 50.0}) {
+                qac_parameter qp; qp.max_timespan = max_dt; qp.max_x = max_x;
+                qac_ts ts(src, qp);
+                auto qv = ts.values();
+                FAST_REQUIRE_EQ(qv.size(), ts.size());
+                for (size_t i = 0; i < ts.size(); ++i) {
+                    auto e = ts.value(i);
+                    if (isfinite(e))
+                        FAST_CHECK_EQ(qv[i], doctest::Approx(e));
+                    else
+                        FAST_CHECK_UNARY(!isfinite(qv[i]));
+                }
+            }
+        }
+        apoint_ts cts{ta, -1.0, ts_point_fx::POINT_AVERAGE_VALUE};
+        qac_parameter qp;
+        auto cv = qac_ts(src, qp, cts).values();
+        FAST_CHECK_EQ(cv[0], doctest::Approx(-1.0));
+        FAST_CHECK_EQ(cv[2], doctest::Approx(2.0));
+        FAST_CHECK_EQ(cv[39], doctest::Approx(-1.0));
+    }
+
 }
@@ -7,6 +7,9 @@
 #include "core/time_series_dd.h"
 #include "core/time_series_statistics.h"
 #include "core/time_series_point_merge.h"
+#include <numeric>
+#include <random>
+#include <ctime>
 
 using shyft::time_series::dd::gta_t;
 
@@ -426,6 +429,65 @@ TEST_SUITE("time_series") {
         }
     }
 
+    TEST_CASE("test_shared_point_ts_copy_on_write") {
+        calendar utc;
+        time_axis::fixed_dt ta(utc.time(2015, 5, 1), deltahours(1), 10);
+        shared_point_ts<time_axis::fixed_dt> a(ta, 3.0, POINT_AVERAGE_VALUE);
+        FAST_CHECK_EQ(a.value(9), doctest::Approx(3.0));// no storage yet
+        for (size_t i = 0; i < ta.size(); ++i) a.set(i, double(i));
+        auto b = a;
+        auto c = b;
+        FAST_CHECK_UNARY(b.shares_values_with(a));
+        FAST_CHECK_UNARY(c.shares_values_with(a));
+        c.set(2, -1.0);// c gets its own copy, a and b are unchanged
+        FAST_CHECK_UNARY(!c.shares_values_with(a));
+        FAST_CHECK_UNARY(b.shares_values_with(a));
+        FAST_CHECK_EQ(a.value(2), doctest::Approx(2.0));
+        FAST_CHECK_EQ(c.value(2), doctest::Approx(-1.0));
+        FAST_CHECK_EQ(c.value(3), doctest::Approx(3.0));
+        b.fill(1.0);
+        FAST_CHECK_UNARY(!b.shares_values_with(a));
+        FAST_CHECK_EQ(b.value(5), doctest::Approx(1.0));
+        FAST_CHECK_EQ(a.value(5), doctest::Approx(5.0));
+        direct_accessor<shared_point_ts<time_axis::fixed_dt>, time_axis::fixed_dt> da(a, ta);
+        FAST_CHECK_EQ(da.value(7), doctest::Approx(7.0));
+        FAST_CHECK_EQ(a(ta.time(4) + deltaminutes(30)), doctest::Approx(4.0));// stair-case
+    }
+
+    TEST_CASE("test_point_ts_view") {
+        calendar utc;
+        time_axis::fixed_dt ta(utc.time(2015, 5, 1), deltahours(1), 10);
+        vector<double> buf(ta.size());
+        for (size_t i = 0; i < buf.size(); ++i) buf[i] = double(i);
+        point_ts_view<time_axis::fixed_dt> a(ta, buf.data(), buf.size(), POINT_AVERAGE_VALUE);
+        FAST_CHECK_EQ(a.data(), buf.data());// no copy
+        FAST_CHECK_EQ(a.value(3), doctest::Approx(3.0));
+        buf[3] = -3.0;// changes are seen through the view
+        FAST_CHECK_EQ(a.value(3), doctest::Approx(-3.0));
+        FAST_CHECK_EQ(a(ta.time(4) + deltaminutes(30)), doctest::Approx(4.0));// stair-case
+        a.set_point_interpretation(POINT_INSTANT_VALUE);
+        FAST_CHECK_EQ(a(ta.time(4) + deltaminutes(30)), doctest::Approx(4.5));
+        CHECK_THROWS_AS(point_ts_view<time_axis::fixed_dt>(ta, buf.data(), 3u), std::runtime_error);
+
+        point_ts<time_axis::fixed_dt, float> f(ta, 2.0, POINT_AVERAGE_VALUE);
+        point_ts_view<time_axis::fixed_dt, float> fv(f);
+        FAST_CHECK_EQ(fv.data(), f.v.data());
+        FAST_CHECK_EQ(fv.value(9), doctest::Approx(2.0));
+
+        // usable in expressions and accessors as point_ts
+        auto c = a*2.0 + fv;
+        time_axis::fixed_dt ta2(ta.time(0), deltahours(2), 5);
+        a.set_point_interpretation(POINT_AVERAGE_VALUE);
+        average_accessor<decltype(a), time_axis::fixed_dt> avg(a, ta2);
+        vector<double> r(ta.size());
+        values_of(a, 0, r.size(), r.data());
+        for (size_t i = 0; i < ta.size(); ++i) {
+            FAST_CHECK_EQ(r[i], buf[i]);
+            FAST_CHECK_EQ(c.value(i), doctest::Approx(2.0*buf[i] + 2.0));
+        }
+        FAST_CHECK_EQ(avg.value(1), doctest::Approx((2.0 - 3.0)/2.0));
+    }
+
     TEST_CASE("test_hint_based_bsearch") {
         calendar utc;
         auto t=utc.time(YMDhms(2015,5,1,0,0,0));
@@ -873,6 +935,251 @@ TEST_SUITE("time_series") {
 			FAST_CHECK_EQ(av[i], doctest::Approx(deltahours(3)));
 		}
 	}
+    TEST_CASE("test_api_ts_values_into") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 20 }, ta2{ 0, 20, 10 }, tb{ 5, 10, 20 };
+        vector<double> av, bv;
+        for (size_t i = 0; i < ta.size(); ++i) { av.push_back(1.0 + i); bv.push_back(10.0 - 0.5*i); }
+        apoint_ts a{ ta, av, shyft::time_series::POINT_AVERAGE_VALUE };
+        apoint_ts b{ ta, bv, shyft::time_series::POINT_INSTANT_VALUE };
+        apoint_ts c{ tb, 2.0, shyft::time_series::POINT_AVERAGE_VALUE };// not aligned to a, b
+        apoint_ts x = (a*b - 2.0*(a + b)).abs();
+        vector<apoint_ts> exprs{
+            a + b, a - 3.0, 3.0 / (b + 1.0),
+            max((a + b)*(a - b), min(a/b, 2.0)),
+            x + a.time_shift(10).time_shift(-10) - (a*(b + a) + c),
+            average(x + a, ta2)*integral(a - b, ta2) + average(b, ta),
+            (x + x)*(a + (b - (a*b + (b + a)/4.0)))
+        };
+        for (const auto& e : exprs) {
+            auto v = e.values();
+            FAST_REQUIRE_EQ(v.size(), e.size());
+            for (size_t i = 0; i < e.size(); ++i) {
+                if (std::isfinite(e.value(i)))
+                    FAST_CHECK_EQ(v[i], doctest::Approx(e.value(i)));
+                else
+                    FAST_CHECK_UNARY(!std::isfinite(v[i]));
+            }
+        }
+        eval_buffers b_pool;// a deep expression only needs a temporary at some of its nodes, and reuses them
+        vector<double> r(exprs.back().size());
+        exprs.back().ts->values_into(r.data(), b_pool);
+        FAST_CHECK_EQ(r, exprs.back().values());
+        FAST_CHECK_LE(b_pool.free.size(), 2u);
+    }
+    TEST_CASE("test_ts_program") {
+        using namespace shyft::time_series::dd;
+        const size_t n = 3*ts_program::block_size + 17;// several blocks, and a partial one
+        gta_t ta{ 0, 10, n }, ta2{ 0, 20, n/2 };
+        vector<double> av, bv;
+        for (size_t i = 0; i < n; ++i) { av.push_back(1.0 + 0.01*i); bv.push_back(i % 13 ? 2.0 - 0.001*i : shyft::nan); }
+        apoint_ts a{ ta, av, shyft::time_series::POINT_AVERAGE_VALUE };
+        apoint_ts b{ ta, bv, shyft::time_series::POINT_AVERAGE_VALUE };
+        auto s = a*b - 1.0;// referenced twice
+        auto avg = average(a, ta2);// not element-wise, an input
+        auto e = max(s, 0.5)/(1.0 + s.abs()) + s.time_shift(10).time_shift(-10) - a.average(ta);
+
+        auto p = ts_program::compile(e);
+        FAST_CHECK_EQ(p.n, n);
+        FAST_CHECK_EQ(p.inputs.size(), 3u);// a, b, and the average
+        FAST_CHECK_EQ(p.code.size(), 8u);// s is compiled once
+        FAST_CHECK_LT(p.n_slots, p.code.size());// block buffers are reused
+        auto ev = p.values();
+        FAST_CHECK_EQ(ev.size(), n);
+        for (size_t i = 0; i < n; ++i) {
+            if (std::isfinite(e.value(i)))
+                FAST_CHECK_EQ(ev[i], doctest::Approx(e.value(i)));
+            else
+                FAST_CHECK_UNARY(!std::isfinite(ev[i]));
+        }
+        auto px = ts_program::compile(a + avg);// unaligned, the expression is the only input
+        FAST_CHECK_EQ(px.inputs.size(), 1u);
+        FAST_CHECK_EQ(px.code.size(), 0u);
+        FAST_CHECK_EQ(px.values().size(), (a + avg).size());
+        for (size_t max_threads : {0u, 1u, 2u}) {// the blocks in parallel, equal to the sequential, bit by bit
+            auto pv = e.parallel_values(max_threads);
+            FAST_REQUIRE_EQ(pv.size(), n);
+            for (size_t i = 0; i < n; ++i)
+                FAST_CHECK_UNARY(pv[i] == ev[i] || (std::isnan(pv[i]) && std::isnan(ev[i])));
+        }
+        FAST_CHECK_EQ(avg.parallel_values(), avg.values());// the expression is the only input
+        FAST_CHECK_EQ(apoint_ts().parallel_values().size(), 0u);
+        apoint_ts u("a_ref");
+        CHECK_THROWS(ts_program::compile(u + 1.0).values());
+        CHECK_THROWS((u + 1.0).parallel_values());
+    }
+    TEST_CASE("test_api_ts_aligned_bin_op") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 30 }, tb{ 5, 10, 30 }, ta3{ 0, 30, 10 };
+        vector<double> av;
+        for (size_t i = 0; i < ta.size(); ++i) av.push_back(i % 7 ? 1.0 + i : shyft::nan);
+        apoint_ts a{ ta, av, shyft::time_series::POINT_INSTANT_VALUE };
+        apoint_ts b{ ta, 2.0, shyft::time_series::POINT_AVERAGE_VALUE };
+        apoint_ts c{ tb, 3.0, shyft::time_series::POINT_AVERAGE_VALUE };
+        auto e = (a + b)*a;
+        auto f = a + c;
+        FAST_CHECK_UNARY(dynamic_pointer_cast<abin_op_ts>(e.ts)->aligned);
+        FAST_CHECK_UNARY(!dynamic_pointer_cast<abin_op_ts>(f.ts)->aligned);
+        auto ev = e.values();
+        for (size_t i = 0; i < e.size(); ++i) {// value(i) by the aligned path equals f(t) at the points
+            auto x = e(e.time(i));
+            if (std::isfinite(x)) {
+                FAST_CHECK_EQ(e.value(i), doctest::Approx(x));
+                FAST_CHECK_EQ(ev[i], doctest::Approx(x));
+            } else {
+                FAST_CHECK_UNARY(!std::isfinite(e.value(i)));
+            }
+        }
+        auto g = a + b;// linear between the points, so the average equals the average over its values
+        apoint_ts gc{ ta, g.values(), g.point_interpretation() };
+        auto avg_g = g.average(ta3), avg_gc = gc.average(ta3);
+        for (size_t i = 0; i + 1 < ta3.size(); ++i)// the last interval ends after the last point
+            FAST_CHECK_EQ(avg_g.value(i), doctest::Approx(avg_gc.value(i)));
+    }
+    TEST_CASE("test_api_ts_memoized") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 100 }, ta3{ 0, 30, 33 };
+        vector<double> av;
+        for (size_t i = 0; i < ta.size(); ++i) av.push_back(i % 11 ? 1.0 + 0.5*i : shyft::nan);
+        apoint_ts a{ ta, av, shyft::time_series::POINT_INSTANT_VALUE };
+        vector<apoint_ts> exprs{ a.average(ta3), a.integral(ta3), (a*2.0).accumulate(ta3),
+            a.convolve_w(vector<double>{0.25, 0.5, 0.25}, shyft::time_series::USE_ZERO) };
+        for (const auto& e : exprs) {
+            auto m = e.memoized();
+            FAST_REQUIRE_UNARY(m.ts != e.ts);
+            auto ev = e.values();
+            auto mv = m.values();
+            FAST_REQUIRE_EQ(mv.size(), ev.size());
+            for (size_t i = 0; i < e.size(); ++i) {
+                if (std::isfinite(e.value(i))) {
+                    FAST_CHECK_EQ(m.value(i), doctest::Approx(e.value(i)));
+                    FAST_CHECK_EQ(mv[i], doctest::Approx(ev[i]));
+                } else {
+                    FAST_CHECK_UNARY(!std::isfinite(m.value(i)));
+                }
+            }
+            auto m1 = (m + 1.0).values();// via values_into
+            for (size_t i = 0; i < ev.size(); ++i)
+                FAST_CHECK_UNARY(std::isfinite(ev[i]) ? m1[i] == doctest::Approx(ev[i] + 1.0) : !std::isfinite(m1[i]));
+        }
+        auto m = exprs[0].memoized();
+        double m0 = m.value(1);
+        a.set(4, 1000.0);// the cache is filled at first access, and is not updated
+        FAST_CHECK_EQ(m.value(1), doctest::Approx(m0));
+        FAST_CHECK_UNARY(std::fabs(exprs[0].value(1) - m0) > 1.0);
+        FAST_CHECK_EQ(a.memoized().ts, a.ts);// terminals are returned as is
+    }
+    TEST_CASE("test_api_ts_accumulate_value_at") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 10 };
+        vector<double> av;
+        for (size_t i = 0; i < ta.size(); ++i) av.push_back(1.0 + 0.5*i);
+        apoint_ts a{ ta, av, shyft::time_series::POINT_AVERAGE_VALUE };
+        auto acc = a.accumulate(ta);
+        FAST_CHECK_EQ(acc(0), doctest::Approx(0.0));
+        FAST_CHECK_EQ(acc(25), doctest::Approx(10*1.0 + 10*1.5 + 5*2.0));// the area of a, not of acc itself
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_EQ(acc(ta.time(i)), doctest::Approx(acc.value(i)));
+        a.set(0, 3.0);// the prefix-integral of a non-memoized node follows the terminals
+        FAST_CHECK_EQ(acc.value(2), doctest::Approx(10*3.0 + 10*1.5));
+        FAST_CHECK_EQ(acc(25), doctest::Approx(10*3.0 + 10*1.5 + 5*2.0));
+    }
+    TEST_CASE("test_incremental_update") {
+        using namespace shyft::time_series::dd;
+        const utctimespan h = deltahours(1);
+        gta_t ta{ 0, h, 24*10 }, ta_day{ 0, 24*h, 10 };
+        apoint_ts a_ref("a"), b_ref("b");
+        vector<apoint_ts> tsv{
+            (a_ref*2.0 + b_ref).average(ta_day),// daily average
+            b_ref + 1.0,
+            a_ref.time_shift(h).accumulate(ta),
+            a_ref.integral(ta_day) - b_ref.average(ta_day)
+        };
+        apoint_ts a{ ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE };
+        apoint_ts b{ ta, 2.0, shyft::time_series::POINT_INSTANT_VALUE };
+        for (auto& e : tsv)
+            for (auto& bi : e.find_ts_bind_info())
+                bi.ts.bind(bi.reference == "a" ? a : b);
+        for (auto& e : tsv) e.do_bind();
+        ts_dependency_index dx(tsv);
+        FAST_CHECK_EQ(dx.expressions["a"], (vector<size_t>{ 0, 2, 3 }));
+        FAST_CHECK_EQ(dx.expressions["b"], (vector<size_t>{ 0, 1, 3 }));
+        vector<vector<double>> values;
+        for (auto& e : tsv) values.push_back(e.values());
+
+        // new values for the last 3 hours of a
+        const utcperiod p{ ta.time(ta.size() - 3), ta.total_period().end };
+        for (size_t i = ta.size() - 3; i < ta.size(); ++i) a.set(i, 5.0);
+        FAST_CHECK_EQ(affected_period(tsv[0], "a", p), ta_day.period(9));// only the last daily average
+        FAST_CHECK_UNARY(!affected_period(tsv[1], "a", p).valid());
+        FAST_CHECK_EQ(affected_period(tsv[2], "a", p), utcperiod(p.start + h, ta.total_period().end));
+        auto n = dx.update(tsv, values, "a", p);
+        FAST_CHECK_EQ(n, 1u + 2u + 1u);
+        for (size_t k = 0; k < tsv.size(); ++k) {
+            auto full = tsv[k].values();
+            FAST_REQUIRE_EQ(full.size(), values[k].size());
+            for (size_t i = 0; i < full.size(); ++i) {
+                if (std::isfinite(full[i]))
+                    FAST_CHECK_EQ(values[k][i], doctest::Approx(full[i]));
+            }
+        }
+        // linear b, a new value at one point changes f(t) back to the previous point
+        const utcperiod pb{ ta.time(30), ta.time(31) };
+        FAST_CHECK_EQ(affected_period(tsv[1], "b", pb), utcperiod(ta.time(29), ta.time(31)));
+        FAST_CHECK_EQ(dx.update(tsv, values, "c", pb), 0u);
+    }
+    TEST_CASE("test_ts_bind_set") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 20 };
+        apoint_ts a_ref("a"), b_ref("b"), c_ref("c");
+        auto s = a_ref + b_ref;// shared between the expressions
+        vector<apoint_ts> tsv{
+            s*2.0,
+            s.average(ta) - apoint_ts("a"),
+            c_ref.convolve_w(vector<double>{ 0.5, 0.5 }, shyft::time_series::convolve_policy::USE_FIRST),
+            b_ref.min_max_check_ts_fill(0.0, 10.0, 20, apoint_ts("c"))
+        };
+        ts_bind_set bs(tsv);
+        FAST_REQUIRE_EQ(bs.size(), 3u);
+        FAST_CHECK_EQ(bs.ids, (vector<string>{ "a", "b", "c" }));
+        FAST_CHECK_EQ(bs.refs[0].size(), 2u);// the shared a_ref node once, and the other "a" node of tsv[1]
+        FAST_CHECK_EQ(bs.refs[1].size(), 1u);// the same b_ref node in s and in the qac
+        FAST_CHECK_EQ(bs.refs[2].size(), 2u);// found in convolve_w and in qac
+        for (size_t i = 0; i < bs.size(); ++i)
+            bs.bind(i, apoint_ts{ ta, double(i + 1), shyft::time_series::POINT_AVERAGE_VALUE });
+        for (auto& e : tsv) e.do_bind();
+        FAST_CHECK_EQ(tsv[0].value(0), doctest::Approx(6.0));
+        FAST_CHECK_EQ(tsv[1].value(0), doctest::Approx(2.0));
+        FAST_CHECK_EQ(tsv[2].value(5), doctest::Approx(3.0));
+        FAST_CHECK_EQ(tsv[3].value(5), doctest::Approx(2.0));
+        FAST_CHECK_EQ(ts_bind_set(vector<apoint_ts>{}).size(), 0u);
+    }
+    TEST_CASE("test_deflate_ts_vector_order") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 100 };
+        apoint_ts a{ ta, 1.0, shyft::time_series::POINT_AVERAGE_VALUE };
+        vector<apoint_ts> tsv;
+        for (size_t i = 0; i < 1000; ++i)
+            tsv.push_back(i % 3 ? a*double(i) : (a + double(i)).average(gta_t{ 0, 20, 50 }));
+        for (size_t max_threads : {0u, 1u, 2u}) {
+            auto r = deflate_ts_vector<apoint_ts>(tsv, max_threads);
+            FAST_REQUIRE_EQ(r.size(), tsv.size());
+            for (size_t i = 0; i < tsv.size(); ++i) {
+                FAST_CHECK_EQ(r[i].time_axis(), tsv[i].time_axis());
+                FAST_CHECK_EQ(r[i].value(0), doctest::Approx(i % 3 ? double(i) : 1.0 + i));
+            }
+        }
+        ats_vector av(tsv);
+        auto e = av.evaluate(2);// as deflate_ts_vector, in parallel, for TsVector.evaluate
+        FAST_REQUIRE_EQ(e.size(), av.size());
+        auto v = av.values_at_time(15);
+        FAST_REQUIRE_EQ(v.size(), av.size());
+        for (size_t i = 0; i < av.size(); ++i) {
+            FAST_CHECK_EQ(e[i].value(1), doctest::Approx(i % 3 ? double(i) : 1.0 + i));
+            FAST_CHECK_EQ(v[i], doctest::Approx(i % 3 ? double(i) : 1.0 + i));
+        }
+        FAST_CHECK_EQ(ats_vector().evaluate().size(), 0u);
+    }
 
 	TEST_CASE("extend_calendar_and_fixed_dt") {
 		using namespace shyft::time_series::dd;
@@ -884,6 +1191,48 @@ TEST_SUITE("time_series") {
 
 	}
 
+    TEST_CASE("test_ats_matrix") {
+        using namespace shyft::time_series::dd;
+        gta_t ta{ 0, 10, 50 };
+        ats_vector tsv;
+        for (size_t m = 0; m < 5; ++m) {
+            vector<double> v;
+            for (size_t i = 0; i < ta.size(); ++i) v.push_back(double(m) + 0.1*i);
+            apoint_ts a{ ta, v, shyft::time_series::POINT_AVERAGE_VALUE };
+            tsv.push_back(m % 2 ? a : 2.0*a - a);// members can be expressions
+        }
+        ats_matrix x(tsv);
+        FAST_REQUIRE_EQ(x.size(), tsv.size());
+        FAST_CHECK_EQ(x.n_steps(), ta.size());
+        auto v2 = x.view(2);
+        FAST_CHECK_EQ(v2.data(), x.row(2));// a view, no copy
+        FAST_CHECK_EQ(v2.value(7), doctest::Approx(tsv[2].value(7)));
+        auto y = (x*2.0 + 1.0 - x)/x;// element-wise over the matrix
+        auto s = x.sum(), avg = x.average(), mn = y.min(), mx = y.max();
+        auto back = y.to_ats_vector();
+        FAST_REQUIRE_EQ(back.size(), tsv.size());
+        for (size_t i = 0; i < ta.size(); ++i) {
+            double e_sum = 0.0, e_min = shyft::nan, e_max = shyft::nan;
+            for (size_t m = 0; m < tsv.size(); ++m) {
+                const double xv = tsv[m].value(i), yv = (xv*2.0 + 1.0 - xv)/xv;
+                e_sum += xv;
+                e_min = m == 0 ? yv : std::min(e_min, yv);
+                e_max = m == 0 ? yv : std::max(e_max, yv);
+                if (std::isfinite(yv))
+                    FAST_CHECK_EQ(back[m].value(i), doctest::Approx(yv));
+            }
+            FAST_CHECK_EQ(s.value(i), doctest::Approx(e_sum));
+            FAST_CHECK_EQ(avg.value(i), doctest::Approx(e_sum/tsv.size()));
+            if (i > 0) {// member 0 at i=0 is 0/0
+                FAST_CHECK_EQ(mn.value(i), doctest::Approx(e_min));
+                FAST_CHECK_EQ(mx.value(i), doctest::Approx(e_max));
+            }
+        }
+        FAST_CHECK_EQ(back[0].time_axis(), ta);
+        tsv.push_back(apoint_ts{ gta_t{ 0, 20, 50 }, 1.0, shyft::time_series::POINT_AVERAGE_VALUE });
+        CHECK_THROWS_AS(ats_matrix{ tsv }, std::runtime_error);
+        CHECK_THROWS_AS(x + ats_matrix(ta, 2, 0.0, shyft::time_series::POINT_AVERAGE_VALUE), std::runtime_error);
+    }
     TEST_CASE("test_rating_curve_ts") {
         namespace core = shyft::core;
         namespace ta = shyft::core::time_axis;
@@ -1054,6 +1403,42 @@ TEST_SUITE("time_series") {
             FAST_REQUIRE_EQ(rcsts_2.size(), data.size());
         }
     }
+    TEST_CASE("test_rating_curve_bulk_flow") {
+        calendar utc;
+        const utctime t0 = utc.time(2016, 1, 1);
+        rating_curve_function f1;
+        f1.add_segment(0.0, 1.0, 0.0, 1.5);
+        f1.add_segment(2.0, 2.0, 0.5, 1.2);
+        f1.add_segment(2.0, 3.0, 0.5, 1.1);// equal lower, flow(2.0) uses the first of them
+        f1.add_segment(4.0, 1.5, 1.0, 2.0);
+        rating_curve_function f2;
+        f2.add_segment(1.0, 4.0, 1.0, 1.3);
+        rating_curve_parameters rcp;
+        rcp.add_curve(t0 + deltahours(10), f1);// before that, no curve
+        rcp.add_curve(t0 + deltahours(300), f2);
+        rcp.add_curve(t0 + deltahours(301), f1);
+        tta_t ta(t0, deltahours(1), 1000);
+        vector<double> h;
+        for (size_t i = 0; i < ta.size(); ++i) h.push_back(i%50 == 7 ? shyft::nan : (i%250 == 3 ? 2.0 : 3.0 + 3.2*std::sin(0.02*i)));
+        tts_t level(ta, h, POINT_AVERAGE_VALUE);
+        rating_curve_ts<tts_t> q(level, rcp);
+        vector<double> r(ta.size());
+        q.values(0, r.size(), r.data());
+        for (size_t i = 0; i < ta.size(); ++i) {
+            const double e = q.value(i);
+            FAST_CHECK_EQ(std::isfinite(r[i]), std::isfinite(e));
+            if (std::isfinite(e)) FAST_CHECK_EQ(r[i], e);// the same computation, exactly
+        }
+        vector<double> r5(20);
+        q.values(295, r5.size(), r5.data());// a sub range starting inside a curve period
+        for (size_t k = 0; k < r5.size(); ++k)
+            if (std::isfinite(q.value(295 + k))) FAST_CHECK_EQ(r5[k], q.value(295 + k));
+        vector<double> fb(h.size());
+        f1.flow(h.data(), h.size(), fb.data());
+        for (size_t i = 0; i < h.size(); ++i)
+            if (std::isfinite(f1.flow(h[i]))) FAST_CHECK_EQ(fb[i], f1.flow(h[i]));
+            else FAST_CHECK_UNARY(!std::isfinite(fb[i]));
+    }
 
     /** just verify that it calculate the right things */
     TEST_CASE("test_ts_statistics_calculations") {
@@ -1092,6 +1477,181 @@ TEST_SUITE("time_series") {
         }
     }
 
+    TEST_CASE("test_ts_aggregates_calculations") {
+        calendar utc;
+        auto t0 = utc.time(2015, 1, 1);
+        auto fx_1 = [](size_t i, utctime t)->double {return double( i );};// 0..9 constant ts
+        tta_t  ta(t0, calendar::HOUR, 48);
+        tta_t tad(t0, calendar::DAY, 2);
+        auto tsv1 = create_test_ts(10, ta, fx_1);
+        tsv1.push_back(tts_t(ta, shyft::nan, POINT_AVERAGE_VALUE));// ignored
+        vector<double> w(tsv1.size(), 1.0);
+        w[9] = 11.0;
+        auto r = calculate_aggregates(tad, tsv1, {SUM, MEAN, MINIMUM, MAXIMUM, WEIGHTED_SUM, WEIGHTED_MEAN, HISTOGRAM}, w, {0.0, 5.0, 8.0});
+        FAST_REQUIRE_EQ(r.size(), size_t(8));
+        for (size_t k = 0; k < tad.size(); ++k) {
+            TS_ASSERT_DELTA(r[0].value(k), 45.0, 1e-9);
+            TS_ASSERT_DELTA(r[1].value(k), 4.5, 1e-9);
+            TS_ASSERT_DELTA(r[2].value(k), 0.0, 1e-9);
+            TS_ASSERT_DELTA(r[3].value(k), 9.0, 1e-9);
+            TS_ASSERT_DELTA(r[4].value(k), 36.0 + 99.0, 1e-9);
+            TS_ASSERT_DELTA(r[5].value(k), (36.0 + 99.0)/20.0, 1e-9);
+            TS_ASSERT_DELTA(r[6].value(k), 5.0, 1e-9);// 0..4
+            TS_ASSERT_DELTA(r[7].value(k), 3.0, 1e-9);// 5..7, edge 8 and 9 are outside
+        }
+        auto rn = calculate_aggregates(tad, vector<tts_t>{tts_t(ta, shyft::nan, POINT_AVERAGE_VALUE)}, {SUM, HISTOGRAM}, {}, {0.0, 1.0});
+        FAST_CHECK_UNARY(!std::isfinite(rn[0].value(0)));// no finite values
+        TS_ASSERT_DELTA(rn[1].value(0), 0.0, 1e-9);// but the count is 0
+        CHECK_THROWS_AS(calculate_aggregates(tad, tsv1, {WEIGHTED_SUM}, {1.0}, {}), std::runtime_error);
+        CHECK_THROWS_AS(calculate_aggregates(tad, tsv1, {HISTOGRAM}, {}, {1.0}), std::runtime_error);
+        CHECK_THROWS_AS(calculate_aggregates(tad, tsv1, {42}, {}, {}), std::runtime_error);
+    }
+
+    TEST_CASE("test_percentiles_select_equals_full_sort") {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> u(-10.0, 10.0);
+        const vector<int> pct{0,1,10,25,50,statistics_property::AVERAGE,70,90,99,100,statistics_property::MAX_EXTREME};
+        for (size_t n : {0, 1, 2, 3, 7, 51, 200}) {
+            vector<double> s;
+            for (size_t i = 0; i < n; ++i) s.push_back(i%5 == 3 ? 1.5 : u(gen));// some duplicates
+            auto s1 = s, s2 = s;
+            auto a = calculate_percentiles_excel_method_full_sort(s1, pct);
+            auto b = calculate_percentiles_excel_method_select(s2, pct);
+            FAST_REQUIRE_EQ(a.size(), b.size());
+            for (size_t i = 0; i < a.size(); ++i) {
+                FAST_CHECK_EQ(std::isfinite(a[i]), std::isfinite(b[i]));
+                if (std::isfinite(a[i])) FAST_CHECK_EQ(a[i], doctest::Approx(b[i]).epsilon(1e-12));
+            }
+        }
+    }
+
+    TEST_CASE("test_dd_percentiles_equals_deflated") {
+        namespace dd = shyft::time_series::dd;
+        calendar utc;
+        auto t0 = utc.time(2015, 1, 1);
+        gta_t hourly(time_axis::fixed_dt(t0, deltahours(1), 24*40));
+        gta_t daily(time_axis::calendar_dt(make_shared<calendar>(), t0, calendar::DAY, 40));
+        vector<utctime> tp;
+        for (size_t i = 0; i < 24*40; i += 3) tp.push_back(t0 + deltahours(i));
+        gta_t points(time_axis::point_dt(tp, t0 + deltahours(24*40)));
+        vector<dd::apoint_ts> tsv;
+        for (size_t i = 0; i < 12; ++i) {
+            const gta_t& ta = i%3 == 0 ? hourly : (i%3 == 1 ? daily : points);
+            vector<double> v(ta.size());
+            for (size_t k = 0; k < v.size(); ++k) v[k] = (k*7 + i*13)%29 == 0 ? shyft::nan : std::sin(0.01*k*i) + double(i);
+            dd::apoint_ts ts(ta, v, i%2 ? POINT_AVERAGE_VALUE : POINT_INSTANT_VALUE);
+            tsv.push_back(i%4 == 0 ? ts*2.0 + 1.0 : ts);// concrete and expression members
+        }
+        gta_t ta6(time_axis::fixed_dt(t0, deltahours(6), 4*39));
+        const vector<int> pct{0, 10, 50, 90, 100, statistics_property::AVERAGE, statistics_property::MIN_EXTREME, statistics_property::MAX_EXTREME};
+        auto r = dd::percentiles(tsv, ta6, pct);
+        auto e = calculate_percentiles(ta6, dd::deflate_ts_vector<dd::gts_t>(tsv), pct);
+        FAST_REQUIRE_EQ(r.size(), e.size());
+        for (size_t p = 0; p < pct.size(); ++p) {
+            for (size_t k = 0; k < ta6.size(); ++k) {
+                FAST_CHECK_EQ(std::isfinite(r[p].value(k)), std::isfinite(e[p].value(k)));
+                if (std::isfinite(e[p].value(k))) FAST_CHECK_EQ(r[p].value(k), doctest::Approx(e[p].value(k)).epsilon(1e-12));
+            }
+        }
+        auto r0 = dd::percentiles(vector<dd::apoint_ts>{}, ta6, pct);
+        FAST_REQUIRE_EQ(r0.size(), pct.size());
+        FAST_CHECK_UNARY(!std::isfinite(r0[2].value(0)));
+        CHECK_THROWS_AS(dd::percentiles(vector<dd::apoint_ts>{dd::apoint_ts("unbound")}, ta6, pct), std::runtime_error);
+    }
+
+    TEST_CASE("test_dd_sum_ts") {
+        namespace dd = shyft::time_series::dd;
+        calendar utc;
+        auto t0 = utc.time(2015, 1, 1);
+        gta_t hourly(time_axis::fixed_dt(t0, deltahours(1), 24*10));
+        vector<utctime> tp;
+        for (size_t i = 0; i < 24*12; i += 3) tp.push_back(t0 + deltahours(i));
+        gta_t points(time_axis::point_dt(tp, t0 + deltahours(24*12)));
+        dd::ats_vector tsv;
+        for (size_t i = 0; i < 300; ++i) {// several groups, concrete and expression members, and one on another time-axis
+            const gta_t& ta = i == 150 ? points : hourly;
+            vector<double> v(ta.size());
+            for (size_t k = 0; k < v.size(); ++k) v[k] = std::sin(0.01*k*i) + double(i%7);
+            dd::apoint_ts ts(ta, v, POINT_AVERAGE_VALUE);
+            tsv.push_back(i%5 == 0 ? ts*2.0 + 1.0 : ts);
+        }
+        auto s = tsv.sum();
+        auto c = tsv[0];
+        for (size_t i = 1; i < tsv.size(); ++i) c = c + tsv[i];
+        FAST_REQUIRE_UNARY(dynamic_pointer_cast<dd::sum_ts>(s.ts) != nullptr);
+        FAST_CHECK_GT(dynamic_pointer_cast<dd::sum_ts>(s.ts)->n_groups(), 1u);
+        FAST_REQUIRE_EQ(s.time_axis(), c.time_axis());
+        FAST_CHECK_EQ(s.point_interpretation(), c.point_interpretation());
+        auto sv = s.values();
+        FAST_REQUIRE_EQ(sv.size(), c.size());
+        for (size_t k = 0; k < sv.size(); ++k) {
+            FAST_CHECK_EQ(sv[k], doctest::Approx(c.value(k)).epsilon(1e-12));
+            FAST_CHECK_EQ(s.value(k), sv[k]);// same order of summation
+        }
+        FAST_CHECK_EQ(s(t0 + deltaminutes(90)), doctest::Approx(c(t0 + deltaminutes(90))).epsilon(1e-12));
+        FAST_CHECK_UNARY(!std::isfinite(s(t0 - deltahours(1))));
+        // compensated summation keeps the small terms
+        dd::ats_vector x;
+        x.push_back(dd::apoint_ts(hourly, 1e16, POINT_AVERAGE_VALUE));
+        for (size_t i = 0; i < 200; ++i) x.push_back(dd::apoint_ts(hourly, 1.0, POINT_AVERAGE_VALUE));
+        x.push_back(dd::apoint_ts(hourly, -1e16, POINT_AVERAGE_VALUE));
+        FAST_CHECK_EQ(x.sum(true).value(0), doctest::Approx(200.0).epsilon(1e-12));
+        FAST_CHECK_EQ(x.sum(true).values()[3], x.sum(true).value(3));
+        // unbound terms, bound later, and an empty sum
+        dd::apoint_ts a("a");
+        auto u = dd::sum(vector<dd::apoint_ts>{a, tsv[1], a});
+        FAST_CHECK_UNARY(u.needs_bind());
+        FAST_CHECK_EQ(u.find_ts_bind_info().size(), 2u);
+        a.bind(tsv[2]);
+        u.do_bind();
+        FAST_CHECK_EQ(u.value(5), doctest::Approx(tsv[1].value(5) + 2*tsv[2].value(5)));
+        CHECK_THROWS_AS(dd::sum(vector<dd::apoint_ts>{}), std::runtime_error);
+    }
+
+    TEST_CASE("test_streaming_statistics") {
+        calendar utc;
+        auto t0 = utc.time(2015, 1, 1);
+        tta_t ta(t0, deltaminutes(15), 4*24*60);
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        vector<double> v;
+        for (size_t i = 0; i < ta.size(); ++i) v.push_back(i%97 == 5 ? shyft::nan : u(gen));
+        tts_t a(ta, v, POINT_AVERAGE_VALUE);
+        auto e = a*2.0 + 1.0;// expressions are evaluated in chunks as well
+        tta_t tad(t0 - deltahours(24), calendar::DAY, 62);// starts before, and ends after the source
+        auto mx = extract_statistics(a, tad, nan_max);
+        auto mn = extract_statistics(a, tad, nan_min);
+        size_t n_emitted = 0;
+        streaming_statistics(e, tad, {0.1, 0.5, 0.9}, [&](size_t i, const interval_statistics& s) {
+            FAST_CHECK_EQ(i, n_emitted++);
+            running_statistics r;// brute force reference
+            for (size_t j = 0; j < a.size(); ++j)
+                if (tad.period(i).contains(ta.time(j))) r.add(e.value(j));
+            FAST_CHECK_EQ(s.n, r.n);
+            FAST_CHECK_EQ(std::isfinite(s.max_v), std::isfinite(mx[i]));
+            if (s.n == 0) return;
+            FAST_CHECK_EQ(s.max_v, doctest::Approx(2.0*mx[i] + 1.0));
+            FAST_CHECK_EQ(s.min_v, doctest::Approx(2.0*mn[i] + 1.0));
+            double sum = 0, sum2 = 0;
+            for (size_t j = 0; j < a.size(); ++j)
+                if (tad.period(i).contains(ta.time(j)) && std::isfinite(e.value(j))) { sum += e.value(j); sum2 += e.value(j)*e.value(j); }
+            const double mean = sum/s.n;
+            FAST_CHECK_EQ(s.mean, doctest::Approx(mean));
+            FAST_CHECK_EQ(s.variance, doctest::Approx((sum2 - s.n*mean*mean)/(s.n - 1)));
+            FAST_REQUIRE_EQ(s.quantiles.size(), 3u);
+            vector<double> x;
+            for (size_t j = 0; j < a.size(); ++j)
+                if (tad.period(i).contains(ta.time(j)) && std::isfinite(e.value(j))) x.push_back(e.value(j));
+            auto q = calculate_percentiles_excel_method_full_sort(x, {10, 50, 90});
+            for (size_t k = 0; k < q.size(); ++k)
+                FAST_CHECK_LT(std::fabs(s.quantiles[k] - q[k]), 0.2);// estimate from ~100 values on [1..3]
+        }, 1000);
+        FAST_CHECK_EQ(n_emitted, tad.size());
+        p2_quantile q(0.5);// few values, exact R7
+        q.add(3.0); q.add(1.0); q.add(2.0); q.add(10.0);
+        FAST_CHECK_EQ(q.value(), doctest::Approx(2.5));
+    }
+
     /** just verify that it calculate at full speed */
     TEST_CASE("test_ts_statistics_speed") {
         calendar utc;
@@ -1355,6 +1915,37 @@ TEST_SUITE("time_series") {
         TS_ASSERT_EQUALS(v[2], 4.0);
     }
 
+    TEST_CASE("test_periodic_ts_values_by_phase") {
+        // values() computes one profile period and repeats it, should equal value(i) for all i
+        std::vector<double> pv = { 1, 2, shyft::nan, 4, 5, 6, 7, 8 };
+        calendar utc;
+        utctime t0 = utc.time(2015, 1, 1);
+        for (auto fx : { ts_point_fx::POINT_AVERAGE_VALUE, ts_point_fx::POINT_INSTANT_VALUE }) {
+            for (auto ta_dt : { deltahours(1), deltahours(3), deltahours(10), deltahours(48), deltaminutes(7) }) {
+                for (auto pd_t0 : { t0, t0 - deltahours(5), t0 - deltahours(100) }) {
+                    time_axis::fixed_dt ta(t0, ta_dt, 1000);
+                    periodic_ts<time_axis::fixed_dt> fun(profile_description(pd_t0, deltahours(3), pv), ta, fx);
+                    auto v = fun.values();
+                    REQUIRE(v.size() == ta.size());
+                    size_t n_diff = 0;
+                    for (size_t i = 0; i < ta.size(); ++i) {
+                        auto e = fun.value(i);
+                        if (std::isfinite(e) != std::isfinite(v[i]) || (std::isfinite(e) && e != v[i]))
+                            ++n_diff;
+                    }
+                    FAST_CHECK_EQ(n_diff, 0u);
+                    periodic_ts<time_axis::generic_dt> gfun(profile_description(pd_t0, deltahours(3), pv), time_axis::generic_dt(ta), fx);
+                    auto gv = gfun.values();
+                    n_diff = 0;
+                    for (size_t i = 0; i < ta.size(); ++i)
+                        if (std::isfinite(gv[i]) != std::isfinite(v[i]) || (std::isfinite(v[i]) && gv[i] != v[i]))
+                            ++n_diff;
+                    FAST_CHECK_EQ(n_diff, 0u);
+                }
+            }
+        }
+    }
+
     TEST_CASE("test_accumulate_value") {
         calendar utc;
         auto t = utc.time(2015, 5, 1, 0, 0, 0);
@@ -1559,6 +2150,15 @@ TEST_SUITE("time_series") {
 
     }
 
+    /** a normalized, hydro-graph like, weight vector of size m */
+    static std::vector<double> routing_uhg(size_t m) {
+        std::vector<double> w(m);
+        double s = 0.0;
+        for (size_t k = 0; k < m; ++k) s += (w[k] = (k + 1.0)*std::exp(-6.0*k/double(m)));
+        for (auto& x : w) x /= s;
+        return w;
+    }
+
     TEST_CASE("test_convolution_w") {
         using namespace shyft::core;
         using namespace shyft;
@@ -1608,6 +2208,63 @@ TEST_SUITE("time_series") {
 
     }
 
+    TEST_CASE("test_convolution_w_values") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        time_axis::fixed_dt ta(utc.time(2016, 1, 1), deltahours(1), 2000);
+        time_series::point_ts<decltype(ta)> ts(ta, 0.0, shyft::time_series::POINT_AVERAGE_VALUE);
+        for (size_t i = 0; i < ta.size(); ++i)
+            ts.set(i, 5.0 + 4.0*std::sin(i/37.0) + (i % 97 == 0 ? 50.0 : 0.0));
+        for (size_t m : {5u, 63u, 64u, 300u, 2500u}) {// direct, and fft in one or more blocks, or weights longer than the series
+            auto w = routing_uhg(m);
+            for (auto policy : {time_series::USE_FIRST, time_series::USE_ZERO, time_series::USE_NAN}) {
+                time_series::convolve_w_ts<decltype(ts)> cts(ts, w, policy);
+                auto v = cts.values();
+                FAST_REQUIRE_EQ(v.size(), ts.size());
+                auto check = [&](size_t i) {
+                    const double e = cts.value(i);
+                    if (std::isfinite(e)) {
+                        TS_ASSERT_DELTA(v[i], e, 1e-9);
+                    } else {
+                        TS_ASSERT(!std::isfinite(v[i]));
+                    }
+                };
+                for (size_t i = 0; i < v.size(); i += 7) check(i);
+                check(v.size() - 1);
+            }
+        }
+        // a nan in the series only affects the values it reaches, also for long weight vectors
+        ts.set(1000, shyft::nan);
+        auto w = routing_uhg(200);
+        time_series::convolve_w_ts<decltype(ts)> cts(ts, w, time_series::USE_ZERO);
+        auto v = cts.values();
+        TS_ASSERT(std::isfinite(v[999]));
+        TS_ASSERT(!std::isfinite(v[1000]));
+        TS_ASSERT(!std::isfinite(v[1199]));
+        TS_ASSERT(std::isfinite(v[1200]));
+        TS_ASSERT_DELTA(v[1500], cts.value(1500), 1e-9);
+        // and through the dd convolve_w expression
+        ts.set(1000, 1.0);
+        time_series::dd::apoint_ts a(time_series::dd::gta_t(ta), ts.v, time_series::POINT_AVERAGE_VALUE);
+        auto c = a.convolve_w(w, time_series::USE_FIRST);
+        auto cv = c.values();
+        time_series::convolve_w_ts<decltype(ts)> cts_first(ts, w, time_series::USE_FIRST);
+        for (size_t i = 0; i < cv.size(); i += 11)
+            TS_ASSERT_DELTA(cv[i], cts_first.value(i), 1e-9);
+        if (getenv("SHYFT_VERBOSE")) {
+            auto wl = routing_uhg(720);
+            std::clock_t t0 = std::clock();
+            double s = 0.0;
+            for (size_t i = 0; i < ts.size(); ++i) s += time_series::convolve_w_ts<decltype(ts)>(ts, wl, time_series::USE_ZERO).value(i);
+            std::clock_t t1 = std::clock();
+            auto vl = time_series::convolve_w_ts<decltype(ts)>(ts, wl, time_series::USE_ZERO).values();
+            std::clock_t t2 = std::clock();
+            std::cout << "convolve " << ts.size() << " x " << wl.size() << ", direct: " << double(t1 - t0)/CLOCKS_PER_SEC
+                      << " s, fft: " << double(t2 - t1)/CLOCKS_PER_SEC << " s, " << s << "=" << std::accumulate(begin(vl), end(vl), 0.0) << std::endl;
+        }
+    }
+
     TEST_CASE("test_uniform_sum_ts") {
         using namespace shyft::core;
         using namespace shyft;
@@ -1644,6 +2301,293 @@ TEST_SUITE("time_series") {
             TS_ASSERT_DELTA(sum_ts.value(t)+sum_ts.value(t), cc.value(t), 0.0001);
         }
     }
+    TEST_CASE("test_bulk_values") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        utctime t0 = utc.time(2016, 1, 1);
+        utctimespan dt = deltahours(1);
+        time_axis::fixed_dt ta(t0, dt, 48);
+        using ts_t = time_series::point_ts<decltype(ta)>;
+        ts_t a(ta, 0.0, time_series::POINT_AVERAGE_VALUE);
+        auto b = make_shared<ts_t>(ta, 0.0, time_series::POINT_INSTANT_VALUE);
+        for (size_t i = 0; i < ta.size(); ++i) {
+            a.set(i, 1.0 + std::sin(0.3*i));
+            b->set(i, 2.0 + std::cos(0.2*i));
+        }
+        a.set(7, shyft::nan);
+        b->set(20, shyft::nan);
+        auto equal_bulk = [](const auto& ts, size_t i0, size_t n) {
+            vector<double> r(n, -1.0);
+            time_series::values_of(ts, i0, n, r.data());
+            for (size_t k = 0; k < n; ++k) {
+                const double e = d_ref(ts).value(i0 + k);
+                if (std::isfinite(e)) {
+                    FAST_CHECK_UNARY(std::fabs(e - r[k]) < 1e-9);
+                } else {
+                    FAST_CHECK_UNARY(!std::isfinite(r[k]));
+                }
+            }
+        };
+        auto c = (a + b)*2.0 - 3.0/b;// aligned operands, bulk
+        equal_bulk(c, 0, ta.size());
+        equal_bulk(c, 5, 20);
+        FAST_CHECK_EQ(c.values().size(), ta.size());
+        time_axis::fixed_dt ta2(t0 + deltaminutes(30), dt, 24);
+        auto d = a + ts_t(ta2, 1.0, time_series::POINT_AVERAGE_VALUE);// combined time-axis, per point
+        equal_bulk(d, 0, d.size());
+        equal_bulk(time_series::time_shift_ts<ts_t>(a, deltahours(2)), 3, 10);
+        time_axis::fixed_dt ta3(t0, deltahours(3), 16);
+        equal_bulk(time_series::average_ts<ts_t, decltype(ta3)>(a, ta3), 0, ta3.size());
+        equal_bulk(time_series::average_ts<ts_t, decltype(ta3)>(*b, ta3), 2, 10);
+        equal_bulk(time_series::accumulate_ts<ts_t, decltype(ta3)>(a, ta3), 0, ta3.size());
+        equal_bulk(time_series::accumulate_ts<ts_t, decltype(ta3)>(*b, ta3), 3, 13);
+        vector<double> w{0.1, 0.15, 0.5, 0.15, 0.1};
+        for (auto policy : {time_series::convolve_policy::USE_FIRST, time_series::convolve_policy::USE_ZERO, time_series::convolve_policy::USE_NAN}) {
+            time_series::convolve_w_ts<ts_t> cw(*b, w, policy);
+            equal_bulk(cw, 0, ta.size());
+            equal_bulk(cw, 2, 30);
+            equal_bulk(cw*2.0 + a, 1, 40);
+        }
+    }
+    TEST_CASE("test_evaluate_into") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        time_axis::fixed_dt ta(utc.time(2016, 1, 1), deltahours(1), 100);
+        using ts_t = time_series::point_ts<decltype(ta)>;
+        ts_t a(ta, 1.0, time_series::POINT_AVERAGE_VALUE), b(ta, 2.0, time_series::POINT_AVERAGE_VALUE);
+        auto c = make_shared<ts_t>(ta, 0.5, time_series::POINT_AVERAGE_VALUE);
+        for (size_t i = 0; i < ta.size(); ++i) {
+            a.set(i, 0.1*i);
+            c->set(i, 1.0 + 0.01*i);
+        }
+        auto e = max(a*2.0 + b - c, 3.0)/c;
+        const time_axis::fixed_dt* e_ta = nullptr;
+        FAST_CHECK_UNARY(time_series::fused::fused_axis(e, e_ta));
+        ts_t r;
+        time_series::evaluate_into(r, e);
+        FAST_REQUIRE_EQ(r.size(), ta.size());
+        FAST_CHECK_EQ(r.ta, ta);
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_UNARY(std::fabs(r.value(i) - e.value(i)) < 1e-12);
+        vector<double> expected = e.values();
+        time_series::evaluate_into(*c, e);// into one of the leaves
+        for (size_t i = 0; i < ta.size(); ++i)
+            FAST_CHECK_UNARY(std::fabs(c->value(i) - expected[i]) < 1e-12);
+        // not the same time-axis, then by bulk evaluation of the combined time-axis
+        ts_t d(time_axis::fixed_dt(ta.time(10), deltahours(1), 20), 1.0, time_series::POINT_AVERAGE_VALUE);
+        auto f = a + d;
+        const time_axis::fixed_dt* fta = nullptr;
+        FAST_CHECK_UNARY(!time_series::fused::fused_axis(f, fta));
+        time_series::point_ts<time_axis::generic_dt> g;
+        time_series::evaluate_into(g, f);
+        FAST_REQUIRE_EQ(g.size(), f.size());
+        for (size_t i = 0; i < g.size(); ++i)
+            FAST_CHECK_UNARY(std::fabs(g.value(i) - f.value(i)) < 1e-12);
+    }
+    TEST_CASE("test_ts_cursor") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        utctime t0 = utc.time(2016, 1, 1);
+        vector<utctime> tp;
+        for (size_t i = 0; i < 200; ++i) tp.push_back(t0 + deltaminutes(int(10*i + (i%3)*3)));
+        time_axis::point_dt ta(tp, tp.back() + deltaminutes(10));
+        using ts_t = time_series::point_ts<decltype(ta)>;
+        ts_t a(ta, 0.0, time_series::POINT_INSTANT_VALUE);
+        for (size_t i = 0; i < ta.size(); ++i) a.set(i, std::sin(0.1*i));
+        a.set(50, shyft::nan);
+        time_series::ts_cursor<ts_t> c(a);
+        for (utctime t = t0 - deltaminutes(20); t < ta.total_period().end + deltaminutes(20); t += deltaminutes(7)) {
+            const double e = a(t), v = c(t);
+            FAST_CHECK_EQ(std::isfinite(e), std::isfinite(v));
+            if (std::isfinite(e)) FAST_CHECK_EQ(e, doctest::Approx(v));
+        }
+        const utctime t_back = ta.time(17) + deltaminutes(1);// going backwards is still correct
+        FAST_CHECK_EQ(c(t_back), doctest::Approx(a(t_back)));
+        FAST_CHECK_EQ(c.index(), 17u);
+        // ref_ts forwards to the hinted point_ts evaluation
+        time_series::ref_ts<ts_t> r("a");
+        r.set_ts(make_shared<ts_t>(a));
+        time_series::ts_cursor<time_series::ref_ts<ts_t>> rc(r);
+        for (size_t i = 0; i + 1 < ta.size(); i += 3) {
+            const utctime t = ta.time(i) + deltaminutes(2);
+            FAST_CHECK_EQ(rc(t), doctest::Approx(a(t)));
+        }
+        // series without a hinted evaluation use the plain f(t)
+        auto b = a*2.0;
+        time_series::ts_cursor<decltype(b)> bc(b);
+        FAST_CHECK_EQ(bc(ta.time(3)), doctest::Approx(2.0*a(ta.time(3))));
+    }
+    TEST_CASE("test_fixed_dt_aligned_average") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        utctime t0 = utc.time(2016, 1, 1);
+        const size_t n = 24*10;
+        time_axis::fixed_dt fta(t0, deltahours(1), n);
+        vector<utctime> tp;
+        for (size_t i = 0; i < n; ++i) tp.push_back(fta.time(i));
+        time_axis::point_dt pta(tp, fta.total_period().end);
+        vector<double> v;
+        for (size_t i = 0; i < n; ++i) v.push_back(std::cos(0.3*i));
+        for (size_t i = 30; i < 60; ++i) v[i] = shyft::nan;// partly nan day, and a full nan day
+        v[100] = v[150]=shyft::nan;
+        time_axis::fixed_dt daily(t0, deltahours(24), 11);// last period beyond the source end
+        time_axis::calendar_dt cdaily(make_shared<calendar>(), t0 + deltahours(5), calendar::DAY, 9);// not aligned to days, but to hours
+        time_axis::fixed_dt unaligned(t0 + deltaminutes(30), deltahours(6), 30);
+        for (auto fx : {time_series::POINT_AVERAGE_VALUE, time_series::POINT_INSTANT_VALUE}) {
+            time_series::point_ts<decltype(fta)> fast(fta, v, fx);
+            time_series::point_ts<decltype(pta)> walk(pta, v, fx);// generic point-walk as reference
+            auto check = [&](const auto& ta) {
+                time_series::average_accessor<decltype(fast), std::decay_t<decltype(ta)>> fa(fast, ta);
+                time_series::average_accessor<decltype(walk), std::decay_t<decltype(ta)>> wa(walk, ta);
+                for (size_t i = 0; i < ta.size(); ++i) {
+                    FAST_CHECK_EQ(std::isfinite(fa.value(i)), std::isfinite(wa.value(i)));
+                    if (std::isfinite(wa.value(i)))
+                        FAST_CHECK_EQ(fa.value(i), doctest::Approx(wa.value(i)));
+                }
+                time_series::accumulate_accessor<decltype(fast), std::decay_t<decltype(ta)>> fc(fast, ta);
+                time_series::accumulate_accessor<decltype(walk), std::decay_t<decltype(ta)>> wc(walk, ta);
+                for (size_t i = 0; i < ta.size(); ++i) {
+                    FAST_CHECK_EQ(std::isfinite(fc.value(i)), std::isfinite(wc.value(i)));
+                    if (std::isfinite(wc.value(i)))
+                        FAST_CHECK_EQ(fc.value(i), doctest::Approx(wc.value(i)));
+                }
+            };
+            check(daily);
+            check(cdaily);
+            check(unaligned);
+        }
+    }
+    TEST_CASE("test_fixed_dt_aligned_average_dst") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        auto osl = make_shared<calendar>("Europe/Oslo");
+        const size_t n = 24*240;// both dst changes of 2016
+        vector<double> v;
+        for (size_t i = 0; i < n; ++i) v.push_back(1.0 + std::sin(0.1*i));
+        for (size_t i = 24*8; i < 24*8 + 30; ++i) v[i] = shyft::nan;
+        time_axis::calendar_dt cdaily(osl, osl->time(2016, 3, 19), calendar::DAY, 245);// starts before, and ends after the sources
+        FAST_CHECK_EQ(cdaily.period(8).timespan(), deltahours(23));// 2016.03.27
+        FAST_CHECK_EQ(cdaily.period(225).timespan(), deltahours(25));// 2016.10.30
+        for (auto t0 : {utc.time(2016, 3, 20, 5), utc.time(2016, 3, 20, 5, 30)}) {// local days on the hours of the source, or not at all
+            time_axis::fixed_dt fta(t0, deltahours(1), n);
+            vector<utctime> tp;
+            for (size_t i = 0; i < n; ++i) tp.push_back(fta.time(i));
+            time_axis::point_dt pta(tp, fta.total_period().end);
+            for (auto fx : {time_series::POINT_AVERAGE_VALUE, time_series::POINT_INSTANT_VALUE}) {
+                time_series::point_ts<decltype(fta)> fast(fta, v, fx);
+                time_series::point_ts<decltype(pta)> walk(pta, v, fx);// generic point-walk as reference
+                time_series::average_accessor<decltype(fast), decltype(cdaily)> fa(fast, cdaily);
+                time_series::average_accessor<decltype(walk), decltype(cdaily)> wa(walk, cdaily);
+                time_series::accumulate_accessor<decltype(fast), decltype(cdaily)> fc(fast, cdaily);
+                time_series::accumulate_accessor<decltype(walk), decltype(cdaily)> wc(walk, cdaily);
+                for (size_t i = 0; i < cdaily.size(); ++i) {
+                    FAST_CHECK_EQ(std::isfinite(fa.value(i)), std::isfinite(wa.value(i)));
+                    if (std::isfinite(wa.value(i)))
+                        FAST_CHECK_EQ(fa.value(i), doctest::Approx(wa.value(i)));
+                    FAST_CHECK_EQ(std::isfinite(fc.value(i)), std::isfinite(wc.value(i)));
+                    if (std::isfinite(wc.value(i)))
+                        FAST_CHECK_EQ(fc.value(i), doctest::Approx(wc.value(i)));
+                }
+            }
+        }
+    }
+    TEST_CASE("test_rle_point_ts") {
+        using namespace shyft::core;
+        using namespace shyft;
+        calendar utc;
+        utctime t0 = utc.time(2016, 1, 1);
+        time_axis::fixed_dt ta(t0, deltahours(1), 24*10);
+        vector<double> v(ta.size(), 2.0);
+        for (size_t i = 30; i < 80; ++i) v[i] = shyft::nan;
+        for (size_t i = 80; i < 81; ++i) v[i] = 5.0;
+        for (size_t i = 81; i < ta.size(); ++i) v[i] = -1.0;
+        for (auto fx : {time_series::POINT_AVERAGE_VALUE, time_series::POINT_INSTANT_VALUE}) {
+            time_series::point_ts<decltype(ta)> a(ta, v, fx);
+            time_series::rle_point_ts<decltype(ta)> r(a);
+            FAST_CHECK_EQ(r.n_runs(), 4u);
+            FAST_CHECK_EQ(r.size(), a.size());
+            for (size_t i = 0; i < a.size(); ++i) {
+                FAST_CHECK_EQ(std::isfinite(r.value(i)), std::isfinite(a.value(i)));
+                if (std::isfinite(a.value(i))) FAST_CHECK_EQ(r.value(i), doctest::Approx(a.value(i)));
+            }
+            for (utctime t = t0 - deltaminutes(30); t < ta.total_period().end + deltahours(1); t += deltaminutes(25)) {
+                FAST_CHECK_EQ(std::isfinite(r(t)), std::isfinite(a(t)));
+                if (std::isfinite(a(t))) FAST_CHECK_EQ(r(t), doctest::Approx(a(t)));
+            }
+            vector<double> rv(20);
+            r.values(25, rv.size(), rv.data());// across runs
+            for (size_t k = 0; k < rv.size(); ++k)
+                FAST_CHECK_EQ(std::isfinite(rv[k]), std::isfinite(a.value(25 + k)));
+            // usable in expressions and accessors as any point ts
+            auto e = r*2.0 + a;
+            for (size_t i = 0; i < a.size(); i += 7)
+                if (std::isfinite(a.value(i))) FAST_CHECK_EQ(e.value(i), doctest::Approx(3.0*a.value(i)));
+            time_axis::fixed_dt daily(t0, deltahours(24), 10);
+            time_series::average_accessor<decltype(r), decltype(daily)> ra(r, daily);
+            time_series::average_accessor<decltype(a), decltype(daily)> aa(a, daily);
+            for (size_t i = 0; i < daily.size(); ++i) {
+                FAST_CHECK_EQ(std::isfinite(ra.value(i)), std::isfinite(aa.value(i)));
+                if (std::isfinite(aa.value(i))) FAST_CHECK_EQ(ra.value(i), doctest::Approx(aa.value(i)));
+            }
+        }
+        time_series::rle_point_ts<decltype(ta)> f(ta, 1.5);
+        FAST_CHECK_EQ(f.n_runs(), 1u);
+        f.scale_by(2.0);
+        FAST_CHECK_EQ(f.value(ta.size() - 1), doctest::Approx(3.0));
+        CHECK_THROWS_AS(time_series::rle_point_ts<decltype(ta)>(ta, vector<double>(3, 1.0)), std::runtime_error);
+    }
+    TEST_CASE("ts_point_merge_tail") {
+        // merge into a point time-axis only rebuilds the tail, and keeps other axes sharing the points unchanged
+        using gts_t=point_ts<time_axis::generic_dt>;
+        calendar utc;
+        utctime t0=utc.time(2016,1,1);
+        utctimespan dt=deltahours(1);
+        const size_t n=1000;
+        vector<utctime> tp;vector<double> vp;
+        for(size_t i=0;i<n;++i) {tp.push_back(t0+utctimespan(i)*dt);vp.push_back(double(i));}
+        gts_t a(time_axis::generic_dt(tp,t0+utctimespan(n)*dt),vp,POINT_AVERAGE_VALUE);
+        a.v.reserve(n+10);a.ta.p.t.reserve(n+10);
+        const auto a_t=a.ta.p.t.data();
+        const auto a_v=a.v.data();
+        // append after the end
+        gts_t b(time_axis::generic_dt(vector<utctime>{t0+utctimespan(n+1)*dt,t0+utctimespan(n+2)*dt},t0+utctimespan(n+3)*dt),vector<double>{-1.0,-2.0},POINT_AVERAGE_VALUE);
+        ts_point_merge(a,b);
+        FAST_REQUIRE_EQ(a.size(),n+2);
+        FAST_CHECK_EQ(a.ta.p.t.data(),a_t);// in place
+        FAST_CHECK_EQ(a.v.data(),a_v);
+        FAST_CHECK_EQ(a.time(n),t0+utctimespan(n+1)*dt);
+        FAST_CHECK_EQ(a.value(n+1),-2.0);
+        FAST_CHECK_EQ(a.total_period().end,t0+utctimespan(n+3)*dt);
+        FAST_CHECK_EQ(a.value(n-1),double(n-1));
+        // overlap the tail, b replaces equal points, and adds the one in between
+        auto a_copy=a;// shares the points
+        gts_t c(time_axis::generic_dt(vector<utctime>{t0+utctimespan(n-1)*dt+dt/2,t0+utctimespan(n+1)*dt},t0+utctimespan(n+2)*dt),vector<double>{10.0,11.0},POINT_AVERAGE_VALUE);
+        ts_point_merge(a,c);
+        FAST_REQUIRE_EQ(a.size(),n+3);
+        FAST_CHECK_EQ(a.time(n-1),t0+utctimespan(n-1)*dt);
+        FAST_CHECK_EQ(a.time(n),t0+utctimespan(n-1)*dt+dt/2);
+        FAST_CHECK_EQ(a.value(n),10.0);
+        FAST_CHECK_EQ(a.value(n+1),11.0);
+        FAST_CHECK_EQ(a.value(n+2),-2.0);
+        FAST_CHECK_EQ(a.total_period().end,t0+utctimespan(n+3)*dt);
+        FAST_CHECK_EQ(a_copy.size(),n+2);// not affected
+        FAST_CHECK_EQ(a_copy.time(n),t0+utctimespan(n+1)*dt);
+        FAST_CHECK_EQ(a_copy.value(n),-1.0);
+        // b before all of a
+        gts_t d(time_axis::generic_dt(vector<utctime>{t0-dt},t0),vector<double>{5.0},POINT_AVERAGE_VALUE);
+        ts_point_merge(a,d);
+        FAST_REQUIRE_EQ(a.size(),n+4);
+        FAST_CHECK_EQ(a.time(0),t0-dt);
+        FAST_CHECK_EQ(a.value(0),5.0);
+        FAST_CHECK_EQ(a.value(1),0.0);
+        FAST_CHECK_EQ(a.total_period().end,t0+utctimespan(n+3)*dt);
+    }
+
     TEST_CASE("ts_point_merge") {
         using namespace shyft::core;
         using namespace shyft;
@@ -364,4 +364,41 @@ TEST_CASE("calendar_iso_week") {
             FAST_CHECK_EQ(c.time(2015, 1, 1 + d, 0, 0, 0), c.time(YWdhms(2015, 1, 4 + d, 0, 0, 0)));
     }
 }
+TEST_CASE("calendar_batch_conversions") {
+    // the batch functions should give exactly the same results as the scalar ones
+    calendar utc;
+    calendar osl("Europe/Oslo");
+    calendar syd("Australia/Sydney");// dst over new year
+    vector<utctime> t;
+    for (utctime x = utc.time(2015, 12, 1);x < utc.time(2018, 2, 1);x += deltaminutes(20)) t.push_back(x);
+    vector<utctime> u{ utc.time(2017, 3, 26, 1, 30), utc.time(2000, 1, 1), no_utctime, max_utctime, min_utctime, utc.time(2017, 10, 29, 0, 30), utc.time(1930, 6, 1) };// unordered, special values
+    for (const auto& c : {utc, osl, syd}) {
+        for (const auto& tv : {t, u}) {
+            auto r = c.calendar_units(tv);
+            REQUIRE(r.size() == tv.size());
+            size_t n_diff = 0;
+            for (size_t i = 0;i < tv.size();++i) if (r[i] != c.calendar_units(tv[i])) ++n_diff;
+            FAST_CHECK_EQ(n_diff, 0u);
+            auto tr = c.time(r);
+            n_diff = 0;
+            for (size_t i = 0;i < tv.size();++i) if (tr[i] != c.time(r[i])) ++n_diff;
+            FAST_CHECK_EQ(n_diff, 0u);
+            for (auto dt : {calendar::YEAR, calendar::QUARTER, calendar::MONTH, calendar::WEEK, calendar::DAY, calendar::HOUR_3, calendar::HOUR, deltaminutes(15), utctimespan(0)}) {
+                auto x = c.trim(tv, dt);
+                size_t n_trim_diff = 0;
+                for (size_t i = 0;i < tv.size();++i) if (x[i] != c.trim(tv[i], dt)) ++n_trim_diff;
+                FAST_CHECK_EQ(n_trim_diff, 0u);
+                vector<utctime> ta;// add of special values is not defined
+                for (auto ti : tv) if (ti != no_utctime && ti != max_utctime && ti != min_utctime) ta.push_back(ti);
+                for (long n : {-13L, -1L, 1L, 5L}) {
+                    auto a = c.add(ta, dt, n);
+                    size_t n_add_diff = 0;
+                    for (size_t i = 0;i < ta.size();++i) if (a[i] != c.add(ta[i], dt, n)) ++n_add_diff;
+                    FAST_CHECK_EQ(n_add_diff, 0u);
+                }
+            }
+        }
+    }
+    FAST_CHECK_EQ(utc.calendar_units(vector<utctime>{}).size(), 0u);
+}
 }